@@ -0,0 +1,430 @@
+/*********************************************************************
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Benchmark for the allocations of the operations.
+
+  Every operation is run a few times, and the allocations that it does are
+  counted per call, along with the bytes allocated and the peak of the
+  memory in use above the one before the call.  There are two counts:
+
+    hook  the internal buffers that go through the allocator of Blosc
+          (see blosc2_set_allocator()), which is replaced by a counting one
+    heap  all the allocations of the process, which malloc(), calloc(),
+          realloc() and the aligned allocations are wrapped for (only with
+          glibc, and not with the sanitizers; '-' otherwise)
+
+  The heap bytes are the usable sizes of the allocations.  The operations
+  are run on contexts and super-chunks that are already created (what is
+  done on the hot paths), except for the ones that create them:
+
+    cctx_create     blosc2_create_cctx() + blosc2_free_ctx()
+    compress        blosc2_compress_ctx()
+    decompress      blosc2_decompress_ctx()
+    getitem         blosc2_getitem_ctx() of a few items
+    schunk_append   blosc2_schunk_append_buffer() (in memory)
+    schunk_get      blosc2_schunk_decompress_chunk() (in memory)
+    frame_open      blosc2_schunk_open() + blosc2_schunk_free() of a file
+    frame_get       blosc2_schunk_decompress_chunk() on a file
+    b2nd_slice      b2nd_get_slice_cbuffer() of a 2-dim array (in memory)
+
+  Usage: alloc_bench [nthreads] [ncalls]
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosc2.h"
+#include "b2nd.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)
+  #if defined(__has_feature)
+    #if !__has_feature(address_sanitizer) && !__has_feature(thread_sanitizer) && \
+        !__has_feature(memory_sanitizer)
+      #define COUNT_HEAP
+    #endif
+  #else
+    #define COUNT_HEAP
+  #endif
+#endif
+
+#if defined(COUNT_HEAP)
+  #include <malloc.h>
+#endif
+
+#define CHUNK_NITEMS (1000 * 1000)
+#define NCHUNKS 8
+#define NCALLS 20
+#define URLPATH "alloc_bench.b2frame"
+
+
+/* The counts of the allocations (all of them are updated atomically) */
+typedef struct {
+  int64_t nallocs;
+  int64_t nbytes;
+  int64_t inuse;
+  int64_t peak;  /* the peak of inuse since the last reset */
+} alloc_counts;
+
+static alloc_counts hook_counts;
+static alloc_counts heap_counts;
+
+
+static void count_alloc(alloc_counts* counts, int64_t nbytes) {
+  __atomic_add_fetch(&counts->nallocs, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&counts->nbytes, nbytes, __ATOMIC_RELAXED);
+  int64_t inuse = __atomic_add_fetch(&counts->inuse, nbytes, __ATOMIC_RELAXED);
+  int64_t peak = __atomic_load_n(&counts->peak, __ATOMIC_RELAXED);
+  while (inuse > peak &&
+         !__atomic_compare_exchange_n(&counts->peak, &peak, inuse, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+static void count_free(alloc_counts* counts, int64_t nbytes) {
+  __atomic_sub_fetch(&counts->inuse, nbytes, __ATOMIC_RELAXED);
+}
+
+/* A snapshot of the counts, with the peak starting over from the memory in use */
+static alloc_counts reset_counts(alloc_counts* counts) {
+  alloc_counts snapshot;
+  snapshot.nallocs = __atomic_load_n(&counts->nallocs, __ATOMIC_RELAXED);
+  snapshot.nbytes = __atomic_load_n(&counts->nbytes, __ATOMIC_RELAXED);
+  snapshot.inuse = __atomic_load_n(&counts->inuse, __ATOMIC_RELAXED);
+  __atomic_store_n(&counts->peak, snapshot.inuse, __ATOMIC_RELAXED);
+  snapshot.peak = snapshot.inuse;
+  return snapshot;
+}
+
+
+/* The counting allocator of Blosc, which keeps the size before the buffers */
+
+#define HOOK_HEADER 64  /* a multiple of the alignments that are asked for */
+
+static void* hook_malloc(size_t size, size_t alignment, void* params) {
+  (void)params;
+  size_t header = alignment > HOOK_HEADER ? alignment : HOOK_HEADER;
+  uint8_t* block = NULL;
+  if (posix_memalign((void**)&block, header, header + size) != 0) {
+    return NULL;
+  }
+  memcpy(block + header - 2 * sizeof(size_t), &header, sizeof(size_t));
+  memcpy(block + header - sizeof(size_t), &size, sizeof(size_t));
+  count_alloc(&hook_counts, (int64_t)size);
+  return block + header;
+}
+
+static void hook_free(void* ptr, void* params) {
+  (void)params;
+  if (ptr == NULL) {
+    return;
+  }
+  size_t header, size;
+  memcpy(&header, (uint8_t*)ptr - 2 * sizeof(size_t), sizeof(size_t));
+  memcpy(&size, (uint8_t*)ptr - sizeof(size_t), sizeof(size_t));
+  count_free(&hook_counts, (int64_t)size);
+  free((uint8_t*)ptr - header);
+}
+
+
+#if defined(COUNT_HEAP)
+/* The wrappers of the allocation functions of glibc, which every allocation of the process goes through */
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void* ptr);
+
+static void* counted(void* ptr) {
+  if (ptr != NULL) {
+    count_alloc(&heap_counts, (int64_t)malloc_usable_size(ptr));
+  }
+  return ptr;
+}
+
+void* malloc(size_t size) {
+  return counted(__libc_malloc(size));
+}
+
+void* calloc(size_t nmemb, size_t size) {
+  return counted(__libc_calloc(nmemb, size));
+}
+
+void free(void* ptr) {
+  if (ptr != NULL) {
+    count_free(&heap_counts, (int64_t)malloc_usable_size(ptr));
+  }
+  __libc_free(ptr);
+}
+
+void* realloc(void* ptr, size_t size) {
+  int64_t old_size = ptr != NULL ? (int64_t)malloc_usable_size(ptr) : 0;
+  void* new_ptr = __libc_realloc(ptr, size);
+  if (new_ptr != NULL || size == 0) {
+    count_free(&heap_counts, old_size);
+    counted(new_ptr);
+  }
+  return new_ptr;
+}
+
+void* memalign(size_t alignment, size_t size) {
+  return counted(__libc_memalign(alignment, size));
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  return counted(__libc_memalign(alignment, size));
+}
+
+int posix_memalign(void** memptr, size_t alignment, size_t size) {
+  if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+    return 22;  /* EINVAL */
+  }
+  void* ptr = counted(__libc_memalign(alignment, size));
+  if (ptr == NULL) {
+    return 12;  /* ENOMEM */
+  }
+  *memptr = ptr;
+  return 0;
+}
+#endif  /* COUNT_HEAP */
+
+
+/* The operations */
+
+enum {
+  OP_CCTX_CREATE,
+  OP_COMPRESS,
+  OP_DECOMPRESS,
+  OP_GETITEM,
+  OP_SCHUNK_APPEND,
+  OP_SCHUNK_GET,
+  OP_FRAME_OPEN,
+  OP_FRAME_GET,
+  OP_B2ND_SLICE,
+  NOPERATIONS,
+};
+
+static const char* op_names[NOPERATIONS] = {
+  "cctx_create", "compress", "decompress", "getitem", "schunk_append", "schunk_get",
+  "frame_open", "frame_get", "b2nd_slice",
+};
+
+typedef struct {
+  int nthreads;
+  blosc2_cparams cparams;
+  blosc2_dparams dparams;
+  int32_t* src;
+  int32_t* dest;
+  uint8_t* chunk;
+  int32_t cbytes;
+  blosc2_context* cctx;
+  blosc2_context* dctx;
+  blosc2_schunk* schunk;
+  blosc2_schunk* frame;
+  b2nd_array_t* array;
+  int ncall;
+} bench_state;
+
+
+/* One call of an operation; returns a negative value on errors */
+static int run_op(bench_state* st, int op) {
+  int32_t chunksize = CHUNK_NITEMS * (int32_t)sizeof(int32_t);
+  int64_t rc;
+  int nchunk = st->ncall % NCHUNKS;
+  switch (op) {
+    case OP_CCTX_CREATE: {
+      blosc2_context* cctx = blosc2_create_cctx(st->cparams);
+      if (cctx == NULL) {
+        return -1;
+      }
+      blosc2_free_ctx(cctx);
+      return 0;
+    }
+    case OP_COMPRESS:
+      rc = blosc2_compress_ctx(st->cctx, st->src, chunksize, st->chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+      st->cbytes = (int32_t)rc;
+      return rc > 0 ? 0 : -1;
+    case OP_DECOMPRESS:
+      rc = blosc2_decompress_ctx(st->dctx, st->chunk, st->cbytes, st->dest, chunksize);
+      return rc == chunksize ? 0 : -1;
+    case OP_GETITEM:
+      rc = blosc2_getitem_ctx(st->dctx, st->chunk, st->cbytes, 1000 + st->ncall * 12345, 100, st->dest,
+                              chunksize);
+      return rc > 0 ? 0 : -1;
+    case OP_SCHUNK_APPEND:
+      rc = blosc2_schunk_append_buffer(st->schunk, st->src, chunksize);
+      return rc > 0 ? 0 : -1;
+    case OP_SCHUNK_GET:
+      rc = blosc2_schunk_decompress_chunk(st->schunk, nchunk, st->dest, chunksize);
+      return rc == chunksize ? 0 : -1;
+    case OP_FRAME_OPEN: {
+      blosc2_schunk* schunk = blosc2_schunk_open(URLPATH);
+      if (schunk == NULL) {
+        return -1;
+      }
+      blosc2_schunk_free(schunk);
+      return 0;
+    }
+    case OP_FRAME_GET:
+      rc = blosc2_schunk_decompress_chunk(st->frame, nchunk, st->dest, chunksize);
+      return rc == chunksize ? 0 : -1;
+    default: {
+      // A 100 x 100 slice that crosses the chunks of the 1000 x 1000 array
+      int64_t start[2] = {450 - st->ncall % 100, 450};
+      int64_t stop[2] = {start[0] + 100, start[1] + 100};
+      int64_t shape[2] = {100, 100};
+      return b2nd_get_slice_cbuffer(st->array, start, stop, st->dest, shape, 100 * 100 * sizeof(int32_t));
+    }
+  }
+}
+
+static int setup(bench_state* st) {
+  int32_t chunksize = CHUNK_NITEMS * (int32_t)sizeof(int32_t);
+  st->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  st->cparams.typesize = sizeof(int32_t);
+  st->cparams.nthreads = (int16_t)st->nthreads;
+  st->dparams = BLOSC2_DPARAMS_DEFAULTS;
+  st->dparams.nthreads = (int16_t)st->nthreads;
+  st->cctx = blosc2_create_cctx(st->cparams);
+  st->dctx = blosc2_create_dctx(st->dparams);
+  if (st->cctx == NULL || st->dctx == NULL) {
+    return -1;
+  }
+  st->cbytes = blosc2_compress_ctx(st->cctx, st->src, chunksize, st->chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+  if (st->cbytes <= 0) {
+    return -1;
+  }
+
+  blosc2_storage storage = {.cparams=&st->cparams, .dparams=&st->dparams};
+  st->schunk = blosc2_schunk_new(&storage);
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_storage fstorage = {.cparams=&st->cparams, .dparams=&st->dparams, .contiguous=true, .urlpath=URLPATH};
+  blosc2_schunk* frame = blosc2_schunk_new(&fstorage);
+  if (st->schunk == NULL || frame == NULL) {
+    return -1;
+  }
+  for (int i = 0; i < NCHUNKS; i++) {
+    if (blosc2_schunk_append_buffer(st->schunk, st->src, chunksize) < 0 ||
+        blosc2_schunk_append_buffer(frame, st->src, chunksize) < 0) {
+      return -1;
+    }
+  }
+  blosc2_schunk_free(frame);
+  st->frame = blosc2_schunk_open(URLPATH);
+  if (st->frame == NULL) {
+    return -1;
+  }
+
+  int64_t shape[2] = {1000, 1000};
+  int32_t chunkshape[2] = {250, 250};
+  int32_t blockshape[2] = {50, 50};
+  b2nd_context_t* ctx = b2nd_create_ctx(&storage, 2, shape, chunkshape, blockshape, NULL, 0, NULL, 0);
+  if (ctx == NULL) {
+    return -1;
+  }
+  int rc = b2nd_from_cbuffer(ctx, &st->array, st->src, chunksize);
+  b2nd_free_ctx(ctx);
+  return rc;
+}
+
+static void teardown(bench_state* st) {
+  if (st->array != NULL) {
+    b2nd_free(st->array);
+  }
+  if (st->frame != NULL) {
+    blosc2_schunk_free(st->frame);
+  }
+  if (st->schunk != NULL) {
+    blosc2_schunk_free(st->schunk);
+  }
+  if (st->cctx != NULL) {
+    blosc2_free_ctx(st->cctx);
+  }
+  if (st->dctx != NULL) {
+    blosc2_free_ctx(st->dctx);
+  }
+  blosc2_remove_urlpath(URLPATH);
+}
+
+
+static void print_counts(const alloc_counts* before, const alloc_counts* after, int ncalls, bool available) {
+  if (!available) {
+    printf(" %10s %12s %12s", "-", "-", "-");
+    return;
+  }
+  printf(" %10.1f %12.0f %12" PRId64, (double)(after->nallocs - before->nallocs) / ncalls,
+         (double)(after->nbytes - before->nbytes) / ncalls, after->peak - before->inuse);
+}
+
+
+int main(int argc, char* argv[]) {
+  int nthreads = 1;
+  int ncalls = NCALLS;
+  if (argc > 3 ||
+      (argc > 1 && (nthreads = (int)strtol(argv[1], NULL, 10)) <= 0) ||
+      (argc > 2 && (ncalls = (int)strtol(argv[2], NULL, 10)) <= 0)) {
+    printf("Usage: alloc_bench [nthreads] [ncalls]\n");
+    return 1;
+  }
+#if defined(COUNT_HEAP)
+  bool heap = true;
+#else
+  bool heap = false;
+#endif
+
+  blosc2_init();
+  blosc2_allocator allocator = {hook_malloc, hook_free, NULL};
+  blosc2_set_allocator(&allocator);
+
+  bench_state st = {.nthreads = nthreads};
+  st.src = malloc(CHUNK_NITEMS * sizeof(int32_t));
+  st.dest = malloc(CHUNK_NITEMS * sizeof(int32_t));
+  st.chunk = malloc(CHUNK_NITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  for (int i = 0; i < CHUNK_NITEMS; i++) {
+    st.src[i] = i / 8;
+  }
+
+  int rc = setup(&st);
+  if (rc < 0) {
+    printf("Cannot set the benchmark up\n");
+  }
+
+  printf("Blosc version: %s (%s)\n", BLOSC2_VERSION_STRING, BLOSC2_VERSION_DATE);
+  printf("Allocations per call (average of %d calls), with %d thread(s)\n\n", ncalls, nthreads);
+  printf("%-14s %10s %12s %12s %10s %12s %12s\n", "operation", "hook/call", "bytes/call", "peak",
+         "heap/call", "bytes/call", "peak");
+  for (int op = 0; op < NOPERATIONS && rc >= 0; op++) {
+    // A first call, so that the caches and the buffers that are kept are not counted
+    st.ncall = 0;
+    rc = run_op(&st, op);
+    alloc_counts hook_before = reset_counts(&hook_counts);
+    alloc_counts heap_before = reset_counts(&heap_counts);
+    for (st.ncall = 1; st.ncall <= ncalls && rc >= 0; st.ncall++) {
+      rc = run_op(&st, op);
+    }
+    if (rc < 0) {
+      printf("Error in %s\n", op_names[op]);
+      break;
+    }
+    alloc_counts hook_after = hook_counts;
+    alloc_counts heap_after = heap_counts;
+    printf("%-14s", op_names[op]);
+    print_counts(&hook_before, &hook_after, ncalls, true);
+    print_counts(&heap_before, &heap_after, ncalls, heap);
+    printf("\n");
+  }
+
+  teardown(&st);
+  free(st.src);
+  free(st.dest);
+  free(st.chunk);
+  blosc2_set_allocator(NULL);
+  blosc2_destroy();
+
+  return rc < 0 ? 1 : 0;
+}
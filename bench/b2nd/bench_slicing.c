@@ -0,0 +1,491 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Benchmark for the access patterns of b2nd arrays, for choosing their
+  chunkshape and blockshape.
+
+  An array of doubles is built, and then read with slices of thickness one
+  across every axis, boxes spanning chunk boundaries, orthogonal selections
+  and as a whole, copied to an array with other chunkshape and blockshape,
+  resized and appended to.  Besides the times, the blocks decompressed per
+  operation are reported, and for the reads, the blocks that the operation
+  needs (the ones that the selection touches), so that the ratio of both
+  (the read amplification) says how well the partitions fit the pattern.
+  The blocks are counted by a no-op filter that is added to the pipeline of
+  the arrays, which is why everything runs in a single thread.
+
+  Usage: b2nd_bench_slicing [-d ndim] [-s shape] [-c chunkshape] [-b blockshape]
+                            [-C copy chunkshape] [-B copy blockshape] [-r repeats]
+                            [-k selected items per axis]
+
+  where the shapes are comma-separated, with ndim items.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "b2nd.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DATA_TYPE double
+#define DEFAULT_NITEMS (2 * 1024 * 1024)
+#define COUNTING_FILTER BLOSC2_USER_REGISTERED_FILTERS_START
+#define MB (1024. * 1024.)
+
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int32_t copy_chunkshape[B2ND_MAX_DIM];
+  int32_t copy_blockshape[B2ND_MAX_DIM];
+  int repeats;
+  int nselected;
+} slicing_options;
+
+typedef struct {
+  int64_t nops;
+  double secs;
+  int64_t nbytes;          /* the bytes of the selections */
+  int64_t decompressed;    /* the blocks decompressed */
+  int64_t needed;          /* the blocks touched by the selections (-1 if it does not apply) */
+  int64_t compressed;      /* the blocks compressed */
+} op_stats;
+
+
+/* The filter counting the blocks that go through the pipeline */
+
+static int64_t blocks_compressed;
+static int64_t blocks_decompressed;
+
+static int counting_forward(const uint8_t *src, uint8_t *dest, int32_t size, uint8_t meta,
+                            blosc2_cparams *cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(cparams);
+  BLOSC_UNUSED_PARAM(id);
+  memcpy(dest, src, size);
+  blocks_compressed++;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+static int counting_backward(const uint8_t *src, uint8_t *dest, int32_t size, uint8_t meta,
+                             blosc2_dparams *dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(id);
+  memcpy(dest, src, size);
+  blocks_decompressed++;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+static void op_start(op_stats *stats, blosc_timestamp_t *start) {
+  stats->decompressed -= blocks_decompressed;
+  stats->compressed -= blocks_compressed;
+  blosc_set_timestamp(start);
+}
+
+static void op_end(op_stats *stats, blosc_timestamp_t start) {
+  blosc_timestamp_t end;
+  blosc_set_timestamp(&end);
+  stats->secs += blosc_elapsed_secs(start, end);
+  stats->decompressed += blocks_decompressed;
+  stats->compressed += blocks_compressed;
+  stats->nops++;
+}
+
+static void print_stats(const char *name, const op_stats *stats) {
+  double nops = (double) stats->nops;
+  printf("%-16s %6" PRId64 " %10.3f", name, stats->nops, stats->secs / nops * 1000.);
+  if (stats->nbytes > 0) {
+    printf(" %10.1f", (double) stats->nbytes / stats->secs / MB);
+  } else {
+    printf(" %10s", "-");
+  }
+  printf(" %12.1f", (double) stats->decompressed / nops);
+  if (stats->needed >= 0) {
+    printf(" %12.1f", (double) stats->needed / nops);
+    if (stats->needed > 0) {
+      printf(" %9.2f", (double) stats->decompressed / (double) stats->needed);
+    } else {
+      printf(" %9s", "-");
+    }
+  } else {
+    printf(" %12s %9s", "-", "-");
+  }
+  printf(" %12.1f\n", (double) stats->compressed / nops);
+}
+
+
+static uint32_t rand_state = 12345;
+
+static uint32_t next_rand(void) {
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+static int compare_int64(const void *a, const void *b) {
+  int64_t x = *(const int64_t *) a;
+  int64_t y = *(const int64_t *) b;
+  return (x > y) - (x < y);
+}
+
+
+/* The blocks along an axis that items [start, stop) touch */
+static int64_t blocks_in_range(const b2nd_array_t *arr, int dim, int64_t start, int64_t stop) {
+  int64_t chunk_len = arr->chunkshape[dim];
+  int64_t block_len = arr->blockshape[dim];
+  int64_t nblocks = 0;
+  for (int64_t x = start; x < stop; nblocks++) {
+    int64_t chunk_start = x / chunk_len * chunk_len;
+    int64_t block_end = chunk_start + ((x - chunk_start) / block_len + 1) * block_len;
+    if (block_end > chunk_start + chunk_len) {
+      block_end = chunk_start + chunk_len;
+    }
+    x = block_end;
+  }
+  return nblocks;
+}
+
+/* The blocks along an axis that some (sorted) items touch */
+static int64_t blocks_in_items(const b2nd_array_t *arr, int dim, const int64_t *items, int64_t nitems) {
+  int64_t nblocks = 0;
+  int64_t last_chunk = -1, last_block = -1;
+  for (int64_t i = 0; i < nitems; i++) {
+    int64_t nchunk = items[i] / arr->chunkshape[dim];
+    int64_t nblock = (items[i] % arr->chunkshape[dim]) / arr->blockshape[dim];
+    if (nchunk != last_chunk || nblock != last_block) {
+      nblocks++;
+      last_chunk = nchunk;
+      last_block = nblock;
+    }
+  }
+  return nblocks;
+}
+
+
+static int get_slice(const b2nd_array_t *arr, const int64_t *start, const int64_t *stop, op_stats *stats) {
+  int64_t slice_shape[B2ND_MAX_DIM];
+  int64_t nbytes = arr->sc->typesize;
+  int64_t needed = 1;
+  for (int i = 0; i < arr->ndim; i++) {
+    slice_shape[i] = stop[i] - start[i];
+    nbytes *= slice_shape[i];
+    needed *= blocks_in_range(arr, i, start[i], stop[i]);
+  }
+  void *buffer = malloc(nbytes);
+  blosc_timestamp_t t0;
+  op_start(stats, &t0);
+  int rc = b2nd_get_slice_cbuffer(arr, start, stop, buffer, slice_shape, nbytes);
+  op_end(stats, t0);
+  free(buffer);
+  stats->nbytes += nbytes;
+  stats->needed += needed;
+  return rc;
+}
+
+static int get_orthogonal_selection(const b2nd_array_t *arr, int nselected, op_stats *stats) {
+  int64_t *selection[B2ND_MAX_DIM];
+  int64_t selection_size[B2ND_MAX_DIM];
+  int64_t nbytes = arr->sc->typesize;
+  int64_t needed = 1;
+  for (int i = 0; i < arr->ndim; i++) {
+    selection_size[i] = nselected < arr->shape[i] ? nselected : arr->shape[i];
+    selection[i] = malloc(selection_size[i] * sizeof(int64_t));
+    for (int64_t j = 0; j < selection_size[i]; j++) {
+      selection[i][j] = next_rand() % arr->shape[i];
+    }
+    qsort(selection[i], selection_size[i], sizeof(int64_t), compare_int64);
+    nbytes *= selection_size[i];
+    needed *= blocks_in_items(arr, i, selection[i], selection_size[i]);
+  }
+  void *buffer = malloc(nbytes);
+  blosc_timestamp_t t0;
+  op_start(stats, &t0);
+  int rc = b2nd_get_orthogonal_selection(arr, selection, selection_size, buffer, selection_size, nbytes);
+  op_end(stats, t0);
+  free(buffer);
+  for (int i = 0; i < arr->ndim; i++) {
+    free(selection[i]);
+  }
+  stats->nbytes += nbytes;
+  stats->needed += needed;
+  return rc;
+}
+
+
+static int run_bench(const slicing_options *options) {
+  int8_t ndim = options->ndim;
+  int32_t typesize = sizeof(DATA_TYPE);
+  int64_t nitems = 1;
+  for (int i = 0; i < ndim; i++) {
+    nitems *= options->shape[i];
+  }
+  int64_t nbytes = nitems * typesize;
+  DATA_TYPE *src = malloc(nbytes);
+  for (int64_t i = 0; i < nitems; i++) {
+    src[i] = (DATA_TYPE) i * 0.5 + (DATA_TYPE) (i % 7);
+  }
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  cparams.nthreads = 1;
+  cparams.filters[0] = COUNTING_FILTER;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 1;
+  blosc2_storage b2_storage = {.cparams=&cparams, .dparams=&dparams};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, options->shape, options->chunkshape,
+                                        options->blockshape, NULL, 0, NULL, 0);
+  b2nd_context_t *copy_ctx = b2nd_create_ctx(&b2_storage, ndim, options->shape, options->copy_chunkshape,
+                                             options->copy_blockshape, NULL, 0, NULL, 0);
+  if (ctx == NULL || copy_ctx == NULL) {
+    printf("Wrong shapes\n");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  printf("%-16s %6s %10s %10s %12s %12s %9s %12s\n", "op", "nops", "ms/op", "MB/s", "decomp/op",
+         "needed/op", "read_amp", "comp/op");
+  blosc_timestamp_t t0;
+  b2nd_array_t *arr;
+  op_stats stats = {0};
+  stats.needed = -1;
+  op_start(&stats, &t0);
+  BLOSC_ERROR(b2nd_from_cbuffer(ctx, &arr, src, nbytes));
+  op_end(&stats, t0);
+  stats.nbytes = nbytes;
+  print_stats("from_cbuffer", &stats);
+
+  // Slices of one item of thickness across every axis
+  for (int dim = 0; dim < ndim; dim++) {
+    int64_t start[B2ND_MAX_DIM] = {0};
+    int64_t stop[B2ND_MAX_DIM];
+    memcpy(stop, arr->shape, sizeof(stop));
+    memset(&stats, 0, sizeof(stats));
+    for (int r = 0; r < options->repeats; r++) {
+      start[dim] = next_rand() % arr->shape[dim];
+      stop[dim] = start[dim] + 1;
+      BLOSC_ERROR(get_slice(arr, start, stop, &stats));
+    }
+    char name[32];
+    sprintf(name, "slice_axis%d", dim);
+    print_stats(name, &stats);
+  }
+
+  // Boxes of a chunk and half a block, so that they cross the boundaries of both
+  memset(&stats, 0, sizeof(stats));
+  for (int r = 0; r < options->repeats; r++) {
+    int64_t start[B2ND_MAX_DIM];
+    int64_t stop[B2ND_MAX_DIM];
+    for (int i = 0; i < ndim; i++) {
+      int64_t len = arr->chunkshape[i] + arr->blockshape[i] / 2;
+      len = len < arr->shape[i] ? len : arr->shape[i];
+      start[i] = next_rand() % (arr->shape[i] - len + 1);
+      stop[i] = start[i] + len;
+    }
+    BLOSC_ERROR(get_slice(arr, start, stop, &stats));
+  }
+  print_stats("box", &stats);
+
+  memset(&stats, 0, sizeof(stats));
+  for (int r = 0; r < options->repeats; r++) {
+    BLOSC_ERROR(get_orthogonal_selection(arr, options->nselected, &stats));
+  }
+  print_stats("orthogonal", &stats);
+
+  memset(&stats, 0, sizeof(stats));
+  {
+    int64_t start[B2ND_MAX_DIM] = {0};
+    BLOSC_ERROR(get_slice(arr, start, arr->shape, &stats));
+  }
+  print_stats("whole", &stats);
+
+  // The copy needs every block of the source
+  memset(&stats, 0, sizeof(stats));
+  b2nd_array_t *copy;
+  op_start(&stats, &t0);
+  BLOSC_ERROR(b2nd_copy(copy_ctx, arr, &copy));
+  op_end(&stats, t0);
+  stats.nbytes = nbytes;
+  stats.needed = 1;
+  for (int i = 0; i < ndim; i++) {
+    stats.needed *= blocks_in_range(arr, i, 0, arr->shape[i]);
+  }
+  print_stats("copy", &stats);
+  BLOSC_ERROR(b2nd_free(copy));
+
+  // Growing an axis by half a chunk every time, so that the last chunks are partial
+  BLOSC_ERROR(b2nd_copy(ctx, arr, &copy));
+  memset(&stats, 0, sizeof(stats));
+  stats.needed = -1;
+  for (int r = 0; r < options->repeats; r++) {
+    int64_t new_shape[B2ND_MAX_DIM];
+    memcpy(new_shape, copy->shape, sizeof(new_shape));
+    int dim = r % ndim;
+    new_shape[dim] += copy->chunkshape[dim] / 2 + 1;
+    op_start(&stats, &t0);
+    BLOSC_ERROR(b2nd_resize(copy, new_shape, NULL));
+    op_end(&stats, t0);
+  }
+  print_stats("resize", &stats);
+  BLOSC_ERROR(b2nd_free(copy));
+
+  BLOSC_ERROR(b2nd_copy(ctx, arr, &copy));
+  memset(&stats, 0, sizeof(stats));
+  stats.needed = -1;
+  int64_t append_nbytes = nbytes / arr->shape[0] * (arr->chunkshape[0] / 2 + 1);
+  append_nbytes = append_nbytes < nbytes ? append_nbytes : nbytes;
+  for (int r = 0; r < options->repeats; r++) {
+    op_start(&stats, &t0);
+    BLOSC_ERROR(b2nd_append(copy, src, append_nbytes, 0));
+    op_end(&stats, t0);
+    stats.nbytes += append_nbytes;
+  }
+  print_stats("append", &stats);
+  BLOSC_ERROR(b2nd_free(copy));
+
+  free(src);
+  BLOSC_ERROR(b2nd_free(arr));
+  BLOSC_ERROR(b2nd_free_ctx(ctx));
+  BLOSC_ERROR(b2nd_free_ctx(copy_ctx));
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+static int parse_shape(const char *arg, int64_t *values) {
+  int n = 0;
+  char *end;
+  while (n < B2ND_MAX_DIM) {
+    values[n++] = strtoll(arg, &end, 10);
+    if (end == arg || values[n - 1] <= 0 || (*end != ',' && *end != '\0')) {
+      return -1;
+    }
+    if (*end == '\0') {
+      return n;
+    }
+    arg = end + 1;
+  }
+  return -1;
+}
+
+static void usage(void) {
+  printf("Usage: b2nd_bench_slicing [-d ndim] [-s shape] [-c chunkshape] [-b blockshape]\n"
+         "                          [-C copy chunkshape] [-B copy blockshape] [-r repeats]\n"
+         "                          [-k selected items per axis]\n");
+}
+
+
+int main(int argc, char *argv[]) {
+  slicing_options options = {.ndim = 3, .repeats = 10, .nselected = 10};
+  int64_t values[5][B2ND_MAX_DIM];
+  int nvalues[5] = {0};
+  const char *shape_options = "scbCB";
+  for (int i = 1; i < argc; i++) {
+    if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 == argc) {
+      usage();
+      return 1;
+    }
+    const char *arg = argv[++i];
+    char option = argv[i - 1][1];
+    const char *shape_option = strchr(shape_options, option);
+    if (shape_option != NULL) {
+      int n = (int) (shape_option - shape_options);
+      nvalues[n] = parse_shape(arg, values[n]);
+      if (nvalues[n] < 0) {
+        usage();
+        return 1;
+      }
+      continue;
+    }
+    int value = (int) strtol(arg, NULL, 10);
+    switch (option) {
+      case 'd':
+        options.ndim = (int8_t) value;
+        break;
+      case 'r':
+        options.repeats = value;
+        break;
+      case 'k':
+        options.nselected = value;
+        break;
+      default:
+        value = 0;
+    }
+    if (value <= 0 || options.ndim > B2ND_MAX_DIM) {
+      usage();
+      return 1;
+    }
+  }
+  int8_t ndim = options.ndim;
+  for (int n = 0; n < 5; n++) {
+    if (nvalues[n] != 0 && nvalues[n] != ndim) {
+      printf("The shapes must have %d items\n", ndim);
+      return 1;
+    }
+  }
+
+  // By default, cubes of some millions of items, with chunks of a quarter of the side, and
+  // blocks of a quarter of a chunk, but along the last axis (the rows are kept), and the copy
+  // with the chunkshape and blockshape reversed
+  int64_t side = 1;
+  for (;;) {
+    int64_t nitems = 1;
+    for (int i = 0; i < ndim; i++) {
+      nitems *= side + 1;
+    }
+    if (nitems > DEFAULT_NITEMS) {
+      break;
+    }
+    side++;
+  }
+  for (int i = 0; i < ndim; i++) {
+    options.shape[i] = nvalues[0] ? values[0][i] : side;
+  }
+  for (int i = 0; i < ndim; i++) {
+    int64_t chunk_len = nvalues[1] ? values[1][i] : (options.shape[i] + 3) / 4;
+    int64_t block_len = nvalues[2] ? values[2][i] : (ndim > 1 && i == ndim - 1) ? chunk_len : (chunk_len + 3) / 4;
+    options.chunkshape[i] = (int32_t) chunk_len;
+    options.blockshape[i] = (int32_t) block_len;
+  }
+  for (int i = 0; i < ndim; i++) {
+    options.copy_chunkshape[i] = nvalues[3] ? (int32_t) values[3][i] : options.chunkshape[ndim - 1 - i];
+    options.copy_blockshape[i] = nvalues[4] ? (int32_t) values[4][i] : options.blockshape[ndim - 1 - i];
+  }
+
+  blosc2_init();
+  blosc2_filter counting_filter = {0};
+  counting_filter.id = COUNTING_FILTER;
+  counting_filter.name = "counting";
+  counting_filter.version = 1;
+  counting_filter.forward = counting_forward;
+  counting_filter.backward = counting_backward;
+  blosc2_register_filter(&counting_filter);
+
+  printf("Blosc version: %s (%s)\n", BLOSC2_VERSION_STRING, BLOSC2_VERSION_DATE);
+  const char *labels[] = {"shape", "chunkshape", "blockshape", "copy chunkshape", "copy blockshape"};
+  for (int n = 0; n < 5; n++) {
+    printf("%-16s", labels[n]);
+    for (int i = 0; i < ndim; i++) {
+      int64_t value = (n == 0) ? options.shape[i] : (n == 1) ? options.chunkshape[i] :
+                      (n == 2) ? options.blockshape[i] : (n == 3) ? options.copy_chunkshape[i] :
+                      options.copy_blockshape[i];
+      printf(" %" PRId64, value);
+    }
+    printf("\n");
+  }
+  printf("\n");
+
+  int rc = run_bench(&options);
+
+  blosc2_destroy();
+  return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,501 @@
+/*********************************************************************
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Benchmark driver that sweeps the compression parameters on a dataset
+  and emits the results in a machine-readable format (JSON or CSV), so
+  that they can be tracked across releases or used for choosing the
+  parameters for some data.
+
+  Every combination of codecs x filters x clevels x typesizes x
+  blocksizes x nthreads is run on every dataset.  A dataset is a .b2nd
+  file (its items are used, with the typesize of the array unless -t is
+  given), a raw binary file, or some synthetic data (like the one of
+  b2bench) when no file is given.  The dataset is split in chunks, and
+  the times of compressing and decompressing every chunk for all the
+  repetitions are reported as their 50th and 99th percentiles.
+
+  Usage: b2sweep [-c codecs] [-f filters] [-l clevels] [-t typesizes]
+                 [-b blocksizes] [-n nthreads] [-s chunksize] [-r repeats]
+                 [-o json | csv] [file...]
+
+  where the lists are comma-separated, the codecs are the names of
+  blosc2_compname_to_compcode(), the filters are nofilter, shuffle,
+  bitshuffle and bytedelta (the latter after a shuffle), and a blocksize
+  of 0 means the automatic one.  For example:
+
+  $ b2sweep -c lz4,zstd -f shuffle,bitshuffle -l 1,5,9 -n 1,4 -o csv data.b2nd
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosc2.h"
+#include "blosc2/filters-registry.h"
+#include "b2nd.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define KB  1024
+#define MB  (1024 * KB)
+
+#define MAX_VALUES 32    /* maximum number of values in a list */
+
+
+typedef struct {
+  const char* name;
+  uint8_t filters[2];
+} sweep_filter;
+
+static const sweep_filter known_filters[] = {
+  {"nofilter", {BLOSC_NOFILTER, BLOSC_NOFILTER}},
+  {"shuffle", {BLOSC_NOFILTER, BLOSC_SHUFFLE}},
+  {"bitshuffle", {BLOSC_NOFILTER, BLOSC_BITSHUFFLE}},
+  {"bytedelta", {BLOSC_SHUFFLE, BLOSC_FILTER_BYTEDELTA}},
+};
+
+typedef struct {
+  char* name;
+  uint8_t* data;
+  int64_t nbytes;
+  int32_t typesize;  /* 0 if the dataset does not have one */
+} sweep_dataset;
+
+typedef struct {
+  int ncodecs;
+  int codecs[MAX_VALUES];
+  int nfilters;
+  const sweep_filter* filters[MAX_VALUES];
+  int nclevels;
+  int clevels[MAX_VALUES];
+  int ntypesizes;
+  int typesizes[MAX_VALUES];
+  int nblocksizes;
+  int blocksizes[MAX_VALUES];
+  int nnthreads;
+  int nthreads[MAX_VALUES];
+  int32_t chunksize;
+  int repeats;
+  bool csv;
+} sweep_options;
+
+
+static void usage(void) {
+  printf("Usage: b2sweep [-c codecs] [-f filters] [-l clevels] [-t typesizes]\n"
+         "               [-b blocksizes] [-n nthreads] [-s chunksize] [-r repeats]\n"
+         "               [-o json | csv] [file...]\n");
+}
+
+
+/* Parse a comma-separated list of integers */
+static int parse_ints(const char* arg, int* values) {
+  int n = 0;
+  char* end;
+  while (n < MAX_VALUES) {
+    values[n++] = (int)strtol(arg, &end, 10);
+    if (end == arg || (*end != ',' && *end != '\0')) {
+      return -1;
+    }
+    if (*end == '\0') {
+      return n;
+    }
+    arg = end + 1;
+  }
+  return -1;
+}
+
+
+/* Parse a comma-separated list of names, calling lookup on each of them */
+static int parse_names(const char* arg, int (*lookup)(const char* name, int n, sweep_options* options),
+                       sweep_options* options) {
+  char name[64];
+  int n = 0;
+  while (n < MAX_VALUES) {
+    size_t len = strcspn(arg, ",");
+    if (len == 0 || len >= sizeof(name)) {
+      return -1;
+    }
+    memcpy(name, arg, len);
+    name[len] = '\0';
+    if (lookup(name, n++, options) < 0) {
+      return -1;
+    }
+    if (arg[len] == '\0') {
+      return n;
+    }
+    arg += len + 1;
+  }
+  return -1;
+}
+
+static int lookup_codec(const char* name, int n, sweep_options* options) {
+  int compcode = blosc2_compname_to_compcode(name);
+  if (compcode < 0) {
+    fprintf(stderr, "Codec '%s' is not available in this build\n", name);
+    return -1;
+  }
+  options->codecs[n] = compcode;
+  return 0;
+}
+
+static int lookup_filter(const char* name, int n, sweep_options* options) {
+  for (size_t i = 0; i < sizeof(known_filters) / sizeof(known_filters[0]); i++) {
+    if (strcmp(name, known_filters[i].name) == 0) {
+      options->filters[n] = &known_filters[i];
+      return 0;
+    }
+  }
+  fprintf(stderr, "Unknown filter '%s'\n", name);
+  return -1;
+}
+
+
+/* The synthetic data of b2bench, with 19 significant bits out of 32 */
+static int synthetic_dataset(sweep_dataset* dataset) {
+  int64_t nitems = 8 * MB / sizeof(int32_t);
+  int32_t* data = malloc(nitems * sizeof(int32_t));
+  if (data == NULL) {
+    return -1;
+  }
+  for (int32_t i = 0; i < nitems; i++) {
+    data[i] = ((i << 26) ^ (i << 18) ^ (i << 11) ^ (i << 3) ^ i) & ((1 << 19) - 1);
+  }
+  dataset->name = strdup("synthetic");
+  dataset->data = (uint8_t*)data;
+  dataset->nbytes = nitems * sizeof(int32_t);
+  dataset->typesize = sizeof(int32_t);
+  return 0;
+}
+
+
+static int load_dataset(char* filename, sweep_dataset* dataset) {
+  dataset->name = strdup(filename);
+  size_t len = strlen(filename);
+  if (len > 5 && strcmp(filename + len - 5, ".b2nd") == 0) {
+    b2nd_array_t* array;
+    if (b2nd_open(filename, &array) < 0) {
+      fprintf(stderr, "Cannot open the array in '%s'\n", filename);
+      return -1;
+    }
+    dataset->typesize = array->sc->typesize;
+    dataset->nbytes = array->nitems * dataset->typesize;
+    dataset->data = malloc(dataset->nbytes);
+    if (dataset->data == NULL || b2nd_to_cbuffer(array, dataset->data, dataset->nbytes) < 0) {
+      fprintf(stderr, "Cannot read the items of the array in '%s'\n", filename);
+      b2nd_free(array);
+      return -1;
+    }
+    b2nd_free(array);
+    return 0;
+  }
+
+  FILE* f = fopen(filename, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "Cannot open '%s'\n", filename);
+    return -1;
+  }
+  fseek(f, 0, SEEK_END);
+  dataset->nbytes = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  dataset->typesize = 0;
+  dataset->data = malloc(dataset->nbytes > 0 ? dataset->nbytes : 1);
+  if (dataset->data == NULL || fread(dataset->data, 1, dataset->nbytes, f) != (size_t)dataset->nbytes) {
+    fprintf(stderr, "Cannot read '%s'\n", filename);
+    fclose(f);
+    return -1;
+  }
+  fclose(f);
+  return 0;
+}
+
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of some sorted samples */
+static double percentile(const double* samples, int nsamples, double p) {
+  int rank = (int)(p / 100. * nsamples + 0.999999);
+  if (rank < 1) {
+    rank = 1;
+  }
+  return samples[rank - 1];
+}
+
+
+typedef struct {
+  int64_t cbytes;
+  double ctimes[2];   /* p50 and p99 of the compression time of a chunk, in usecs */
+  double dtimes[2];   /* same for the decompression */
+  int32_t chunkbytes; /* the bytes of a (full) chunk, for computing the speeds */
+} sweep_result;
+
+static int run_config(const sweep_dataset* dataset, const sweep_options* options, int compcode,
+                      const sweep_filter* filter, int clevel, int32_t typesize, int32_t blocksize,
+                      int16_t nthreads, sweep_result* result) {
+  // Chunks with whole items
+  int32_t chunksize = options->chunksize - options->chunksize % typesize;
+  if (chunksize == 0) {
+    chunksize = typesize;
+  }
+  int64_t nchunks = (dataset->nbytes + chunksize - 1) / chunksize;
+  int nsamples = (int)(nchunks * options->repeats);
+  double* ctimes = malloc(nsamples * sizeof(double));
+  double* dtimes = malloc(nsamples * sizeof(double));
+  uint8_t* chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  uint8_t* dest = malloc(chunksize);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.compcode = (uint8_t)compcode;
+  cparams.clevel = (uint8_t)clevel;
+  cparams.typesize = typesize;
+  cparams.blocksize = blocksize;
+  cparams.nthreads = nthreads;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = filter->filters[0];
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter->filters[1];
+  if (filter->filters[1] == BLOSC_FILTER_BYTEDELTA) {
+    // There is no schunk to take the typesize from
+    cparams.filters_meta[BLOSC2_MAX_FILTERS - 1] = (uint8_t)typesize;
+  }
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context* cctx = blosc2_create_cctx(cparams);
+  blosc2_context* dctx = blosc2_create_dctx(dparams);
+
+  int rc = 0;
+  if (ctimes == NULL || dtimes == NULL || chunk == NULL || dest == NULL || cctx == NULL || dctx == NULL) {
+    fprintf(stderr, "Cannot allocate the resources for a configuration\n");
+    rc = -1;
+    goto out;
+  }
+  result->cbytes = 0;
+  result->chunkbytes = (dataset->nbytes < chunksize) ? (int32_t)dataset->nbytes : chunksize;
+  for (int r = 0; r < options->repeats; r++) {
+    for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+      const uint8_t* src = dataset->data + nchunk * chunksize;
+      int32_t nbytes = (int32_t)((nchunk < nchunks - 1) ? chunksize : dataset->nbytes - nchunk * chunksize);
+      blosc_timestamp_t last, current;
+      blosc_set_timestamp(&last);
+      int csize = blosc2_compress_ctx(cctx, src, nbytes, chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+      blosc_set_timestamp(&current);
+      ctimes[r * nchunks + nchunk] = 1e-3 * blosc_elapsed_nsecs(last, current);
+      blosc_set_timestamp(&last);
+      int dsize = blosc2_decompress_ctx(dctx, chunk, csize, dest, chunksize);
+      blosc_set_timestamp(&current);
+      dtimes[r * nchunks + nchunk] = 1e-3 * blosc_elapsed_nsecs(last, current);
+      if (csize <= 0 || dsize != nbytes) {
+        fprintf(stderr, "Error compressing or decompressing chunk %" PRId64 " (%d, %d)\n", nchunk, csize, dsize);
+        rc = -1;
+        goto out;
+      }
+      if (r == 0) {
+        if (memcmp(src, dest, nbytes) != 0) {
+          fprintf(stderr, "Decompressed data of chunk %" PRId64 " differs\n", nchunk);
+          rc = -1;
+          goto out;
+        }
+        result->cbytes += csize;
+      }
+    }
+  }
+  qsort(ctimes, nsamples, sizeof(double), compare_doubles);
+  qsort(dtimes, nsamples, sizeof(double), compare_doubles);
+  result->ctimes[0] = percentile(ctimes, nsamples, 50);
+  result->ctimes[1] = percentile(ctimes, nsamples, 99);
+  result->dtimes[0] = percentile(dtimes, nsamples, 50);
+  result->dtimes[1] = percentile(dtimes, nsamples, 99);
+
+  out:
+  if (cctx != NULL) {
+    blosc2_free_ctx(cctx);
+  }
+  if (dctx != NULL) {
+    blosc2_free_ctx(dctx);
+  }
+  free(ctimes);
+  free(dtimes);
+  free(chunk);
+  free(dest);
+  return rc;
+}
+
+
+/* Print a string quoted for JSON or CSV */
+static void print_quoted(const char* str, bool csv) {
+  putchar('"');
+  for (; *str != '\0'; str++) {
+    if (*str == '"') {
+      printf(csv ? "\"\"" : "\\\"");
+    }
+    else if (*str == '\\' && !csv) {
+      printf("\\\\");
+    }
+    else {
+      putchar(*str);
+    }
+  }
+  putchar('"');
+}
+
+
+static void print_result(const sweep_dataset* dataset, const sweep_options* options, int compcode,
+                         const sweep_filter* filter, int clevel, int32_t typesize, int32_t blocksize,
+                         int16_t nthreads, const sweep_result* result, bool first) {
+  const char* compname;
+  blosc2_compcode_to_compname(compcode, &compname);
+  double cratio = (double)dataset->nbytes / (double)result->cbytes;
+  // The speeds of a chunk taking the percentile times, in MB/s
+  double cspeeds[2], dspeeds[2];
+  for (int i = 0; i < 2; i++) {
+    cspeeds[i] = result->chunkbytes / (result->ctimes[i] * 1e-6 * MB);
+    dspeeds[i] = result->chunkbytes / (result->dtimes[i] * 1e-6 * MB);
+  }
+
+  if (options->csv) {
+    if (first) {
+      printf("dataset,codec,filter,clevel,typesize,blocksize,nthreads,nbytes,cbytes,cratio,"
+             "ctime_p50_us,ctime_p99_us,dtime_p50_us,dtime_p99_us,"
+             "cspeed_p50_mbps,cspeed_p99_mbps,dspeed_p50_mbps,dspeed_p99_mbps\n");
+    }
+    print_quoted(dataset->name, true);
+    printf(",%s,%s,%d,%d,%d,%d,%" PRId64 ",%" PRId64 ",%.4f,%.2f,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f\n",
+           compname, filter->name, clevel, typesize, blocksize, nthreads,
+           dataset->nbytes, result->cbytes, cratio, result->ctimes[0], result->ctimes[1],
+           result->dtimes[0], result->dtimes[1], cspeeds[0], cspeeds[1], dspeeds[0], dspeeds[1]);
+    return;
+  }
+  printf("%s    {\"dataset\": ", first ? "" : ",\n");
+  print_quoted(dataset->name, false);
+  printf(", \"codec\": \"%s\", \"filter\": \"%s\", \"clevel\": %d, "
+         "\"typesize\": %d, \"blocksize\": %d, \"nthreads\": %d, \"nbytes\": %" PRId64 ", "
+         "\"cbytes\": %" PRId64 ", \"cratio\": %.4f, "
+         "\"ctime_us\": {\"p50\": %.2f, \"p99\": %.2f}, \"dtime_us\": {\"p50\": %.2f, \"p99\": %.2f}, "
+         "\"cspeed_mbps\": {\"p50\": %.1f, \"p99\": %.1f}, \"dspeed_mbps\": {\"p50\": %.1f, \"p99\": %.1f}}",
+         compname, filter->name, clevel, typesize, blocksize, nthreads,
+         dataset->nbytes, result->cbytes, cratio, result->ctimes[0], result->ctimes[1],
+         result->dtimes[0], result->dtimes[1], cspeeds[0], cspeeds[1], dspeeds[0], dspeeds[1]);
+}
+
+
+int main(int argc, char* argv[]) {
+  sweep_options options = {
+      .ncodecs = 1, .codecs = {BLOSC_BLOSCLZ},
+      .nfilters = 1, .filters = {&known_filters[1]},
+      .nclevels = 1, .clevels = {5},
+      .ntypesizes = 0,
+      .nblocksizes = 1, .blocksizes = {0},
+      .nnthreads = 1, .nthreads = {1},
+      .chunksize = 4 * MB,
+      .repeats = 10,
+      .csv = false,
+  };
+  int ndatasets = 0;
+  char** filenames = malloc(argc * sizeof(char*));
+
+  blosc2_init();
+  for (int i = 1; i < argc; i++) {
+    int n = 0;
+    if (argv[i][0] != '-') {
+      filenames[ndatasets++] = argv[i];
+      continue;
+    }
+    if (argv[i][1] == '\0' || argv[i][2] != '\0' || i + 1 == argc) {
+      usage();
+      return 1;
+    }
+    const char* arg = argv[++i];
+    int values[MAX_VALUES];
+    switch (argv[i - 1][1]) {
+      case 'c':
+        n = options.ncodecs = parse_names(arg, lookup_codec, &options);
+        break;
+      case 'f':
+        n = options.nfilters = parse_names(arg, lookup_filter, &options);
+        break;
+      case 'l':
+        n = options.nclevels = parse_ints(arg, options.clevels);
+        break;
+      case 't':
+        n = options.ntypesizes = parse_ints(arg, options.typesizes);
+        break;
+      case 'b':
+        n = options.nblocksizes = parse_ints(arg, options.blocksizes);
+        break;
+      case 'n':
+        n = options.nnthreads = parse_ints(arg, options.nthreads);
+        break;
+      case 's':
+        n = parse_ints(arg, values);
+        options.chunksize = values[0];
+        break;
+      case 'r':
+        n = parse_ints(arg, values);
+        options.repeats = values[0];
+        break;
+      case 'o':
+        n = (strcmp(arg, "json") == 0 || strcmp(arg, "csv") == 0) ? 1 : -1;
+        options.csv = strcmp(arg, "csv") == 0;
+        break;
+      default:
+        n = -1;
+    }
+    if (n <= 0 || options.chunksize <= 0 || options.repeats <= 0) {
+      usage();
+      return 1;
+    }
+  }
+
+  int rc = 0;
+  bool first = true;
+  if (!options.csv) {
+    printf("{\"blosc_version\": \"%s\", \"chunksize\": %d, \"repeats\": %d, \"results\": [\n",
+           BLOSC2_VERSION_STRING, options.chunksize, options.repeats);
+  }
+  for (int d = 0; d < (ndatasets > 0 ? ndatasets : 1) && rc == 0; d++) {
+    sweep_dataset dataset = {0};
+    rc = (ndatasets > 0) ? load_dataset(filenames[d], &dataset) : synthetic_dataset(&dataset);
+    if (rc < 0 || dataset.nbytes == 0) {
+      free(dataset.name);
+      free(dataset.data);
+      continue;
+    }
+    // The typesize of the dataset, if any, unless some are given
+    int ntypesizes = options.ntypesizes;
+    int* typesizes = options.typesizes;
+    int dataset_typesize = (dataset.typesize > 0) ? dataset.typesize : 1;
+    if (ntypesizes == 0) {
+      ntypesizes = 1;
+      typesizes = &dataset_typesize;
+    }
+    for (int c = 0; c < options.ncodecs && rc == 0; c++)
+    for (int f = 0; f < options.nfilters && rc == 0; f++)
+    for (int l = 0; l < options.nclevels && rc == 0; l++)
+    for (int t = 0; t < ntypesizes && rc == 0; t++)
+    for (int b = 0; b < options.nblocksizes && rc == 0; b++)
+    for (int n = 0; n < options.nnthreads && rc == 0; n++) {
+      sweep_result result;
+      rc = run_config(&dataset, &options, options.codecs[c], options.filters[f], options.clevels[l],
+                      typesizes[t], options.blocksizes[b], (int16_t)options.nthreads[n], &result);
+      if (rc == 0) {
+        print_result(&dataset, &options, options.codecs[c], options.filters[f], options.clevels[l],
+                     typesizes[t], options.blocksizes[b], (int16_t)options.nthreads[n], &result, first);
+        fflush(stdout);
+        first = false;
+      }
+    }
+    free(dataset.name);
+    free(dataset.data);
+  }
+  if (!options.csv) {
+    printf("\n]}\n");
+  }
+
+  free(filenames);
+  blosc2_destroy();
+  return rc < 0 ? 1 : 0;
+}
@@ -0,0 +1,262 @@
+/*********************************************************************
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Microbenchmark for the filters, out of the compression pipeline.
+
+  The shuffle, unshuffle, bitshuffle and bitunshuffle routines are run
+  for every implementation built in shuffle.c that the host processor
+  supports (the first one being the one that the dispatch chooses), and
+  the other filters (delta, trunc_prec, bytedelta) for the code that
+  they choose themselves, for some typesizes and block sizes.  The
+  outputs of the accelerated shuffles are checked against the generic
+  ones.  The speeds are the best ones out of several runs, in GB/s of
+  block.
+
+  Usage: filter_bench [typesizes] [blocksizes]
+
+  where the lists are comma-separated (by default, 1,2,4,8,16 and
+  16384,262144,2097152).
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosc2.h"
+#include "shuffle.h"
+#include "delta.h"
+#include "trunc-prec.h"
+#include "../plugins/filters/bytedelta/bytedelta.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_VALUES 16
+#define NRUNS 5
+#define MIN_RUN_BYTES (64 * 1024 * 1024)  /* the bytes processed in a run at least */
+
+
+typedef struct {
+  int32_t typesize;
+  int32_t blocksize;
+  const uint8_t* src;
+  const uint8_t* dref;
+  uint8_t* dest;
+  uint8_t* tmp;
+  const shuffle_implementation_t* impl;
+} bench_args;
+
+typedef void (*bench_func)(const bench_args* args);
+
+
+static void run_shuffle(const bench_args* args) {
+  args->impl->shuffle(args->typesize, args->blocksize, args->src, args->dest);
+}
+
+static void run_unshuffle(const bench_args* args) {
+  args->impl->unshuffle(args->typesize, args->blocksize, args->src, args->dest);
+}
+
+/* The bitshuffles only take a multiple of 8 elements, as in shuffle.c */
+static void run_bitshuffle(const bench_args* args) {
+  size_t nelems = (args->blocksize / args->typesize) & ~(size_t)7;
+  args->impl->bitshuffle((void*)args->src, args->dest, nelems, args->typesize, args->tmp);
+}
+
+static void run_bitunshuffle(const bench_args* args) {
+  size_t nelems = (args->blocksize / args->typesize) & ~(size_t)7;
+  args->impl->bitunshuffle((void*)args->src, args->dest, nelems, args->typesize, args->tmp);
+}
+
+/* A block which is not the reference one */
+static void run_delta_encoder(const bench_args* args) {
+  delta_encoder(args->dref, args->blocksize, args->blocksize, args->typesize, BLOSC_DELTA_DREF,
+                args->src, args->dest);
+}
+
+static void run_delta_decoder(const bench_args* args) {
+  delta_decoder(args->dref, args->blocksize, args->blocksize, args->typesize, BLOSC_DELTA_DREF,
+                args->dest);
+}
+
+static void run_delta_elements(const bench_args* args) {
+  delta_encoder(args->dref, args->blocksize, args->blocksize, args->typesize, BLOSC_DELTA_ELEMENTS,
+                args->src, args->dest);
+}
+
+static void run_delta_encoder_shuffle(const bench_args* args) {
+  delta_encoder_shuffle(args->dref, args->blocksize, args->blocksize, args->typesize, BLOSC_DELTA_DREF,
+                        args->src, args->dest);
+}
+
+static void run_delta_decoder_unshuffle(const bench_args* args) {
+  delta_decoder_unshuffle(args->dref, args->blocksize, args->blocksize, args->typesize, BLOSC_DELTA_DREF,
+                          args->src, args->dest);
+}
+
+static void run_truncate_precision(const bench_args* args) {
+  truncate_precision(10, args->typesize, args->blocksize, args->src, args->dest);
+}
+
+static void run_truncate_precision_shuffle(const bench_args* args) {
+  truncate_precision_shuffle(10, args->typesize, args->blocksize, args->src, args->dest);
+}
+
+static void run_bytedelta_forward(const bench_args* args) {
+  bytedelta_forward(args->src, args->dest, args->blocksize, (uint8_t)args->typesize, NULL, 0);
+}
+
+static void run_bytedelta_backward(const bench_args* args) {
+  bytedelta_backward(args->src, args->dest, args->blocksize, (uint8_t)args->typesize, NULL, 0);
+}
+
+
+/* The best speed out of some runs, in GB/s */
+static double bench_speed(bench_func func, const bench_args* args) {
+  int niters = MIN_RUN_BYTES / args->blocksize;
+  if (niters < 1) {
+    niters = 1;
+  }
+  double best = 0.;
+  for (int run = 0; run < NRUNS; run++) {
+    blosc_timestamp_t last, current;
+    blosc_set_timestamp(&last);
+    for (int i = 0; i < niters; i++) {
+      func(args);
+    }
+    blosc_set_timestamp(&current);
+    double speed = (double)args->blocksize * niters / blosc_elapsed_nsecs(last, current);
+    if (speed > best) {
+      best = speed;
+    }
+  }
+  return best;
+}
+
+static void print_speed(const char* impl, const char* routine, const bench_args* args, double speed,
+                        const char* note) {
+  printf("%-10s %-26s %8d %10d %10.2f%s\n", impl, routine, args->typesize, args->blocksize, speed, note);
+}
+
+
+static int parse_ints(const char* arg, int* values) {
+  int n = 0;
+  char* end;
+  while (n < MAX_VALUES) {
+    values[n++] = (int)strtol(arg, &end, 10);
+    if (end == arg || values[n - 1] <= 0 || (*end != ',' && *end != '\0')) {
+      return -1;
+    }
+    if (*end == '\0') {
+      return n;
+    }
+    arg = end + 1;
+  }
+  return -1;
+}
+
+
+int main(int argc, char* argv[]) {
+  int typesizes[MAX_VALUES] = {1, 2, 4, 8, 16};
+  int ntypesizes = 5;
+  int blocksizes[MAX_VALUES] = {16 * 1024, 256 * 1024, 2 * 1024 * 1024};
+  int nblocksizes = 3;
+  if (argc > 3 ||
+      (argc > 1 && (ntypesizes = parse_ints(argv[1], typesizes)) < 0) ||
+      (argc > 2 && (nblocksizes = parse_ints(argv[2], blocksizes)) < 0)) {
+    printf("Usage: filter_bench [typesizes] [blocksizes]\n");
+    return 1;
+  }
+  int max_blocksize = 0;
+  for (int b = 0; b < nblocksizes; b++) {
+    max_blocksize = (blocksizes[b] > max_blocksize) ? blocksizes[b] : max_blocksize;
+  }
+
+  blosc2_init();
+  shuffle_implementation_t impls[SHUFFLE_MAX_IMPLEMENTATIONS];
+  int nimpls = shuffle_implementations(impls, SHUFFLE_MAX_IMPLEMENTATIONS);
+
+  // Slowly varying doubles, so that the values make sense for any typesize
+  uint8_t* src = malloc(max_blocksize);
+  uint8_t* dref = malloc(max_blocksize);
+  uint8_t* dest = malloc(max_blocksize);
+  uint8_t* expected = malloc(max_blocksize);
+  uint8_t* tmp = malloc(max_blocksize);
+  for (int i = 0; i < max_blocksize / 8; i++) {
+    ((double*)src)[i] = 100. + i * 0.001 + (i % 17) * 1e-7;
+  }
+  memset(src + max_blocksize / 8 * 8, 0x5a, max_blocksize % 8);
+  for (int i = 0; i < max_blocksize; i++) {
+    dref[i] = src[i] ^ (uint8_t)(i % 3);
+  }
+
+  printf("Blosc version: %s (%s)\n", BLOSC2_VERSION_STRING, BLOSC2_VERSION_DATE);
+  printf("Shuffle implementations:");
+  for (int i = 0; i < nimpls; i++) {
+    printf(" %s%s", impls[i].name, (i == 0) ? " (dispatched)" : "");
+  }
+  printf("\n\n%-10s %-26s %8s %10s %10s\n", "impl", "routine", "typesize", "blocksize", "GB/s");
+
+  int rc = 0;
+  const shuffle_implementation_t* generic = &impls[nimpls - 1];
+  for (int t = 0; t < ntypesizes; t++) {
+    for (int b = 0; b < nblocksizes; b++) {
+      bench_args args = {typesizes[t], blocksizes[b], src, dref, dest, tmp, NULL};
+      if (args.blocksize < args.typesize) {
+        continue;
+      }
+      for (int i = 0; i < nimpls; i++) {
+        args.impl = &impls[i];
+        const char* name = impls[i].name;
+        // The outputs have to match the ones of the generic implementation
+        const char* note = "";
+        bench_args check = args;
+        check.dest = expected;
+        check.impl = generic;
+        run_shuffle(&check);
+        run_shuffle(&args);
+        if (memcmp(dest, expected, args.blocksize) != 0) {
+          note = "  MISMATCH";
+          rc = 1;
+        }
+        print_speed(name, "shuffle", &args, bench_speed(run_shuffle, &args), note);
+        print_speed(name, "unshuffle", &args, bench_speed(run_unshuffle, &args), "");
+        note = "";
+        size_t nbytes = ((args.blocksize / args.typesize) & ~(size_t)7) * args.typesize;
+        run_bitshuffle(&check);
+        run_bitshuffle(&args);
+        if (memcmp(dest, expected, nbytes) != 0) {
+          note = "  MISMATCH";
+          rc = 1;
+        }
+        print_speed(name, "bitshuffle", &args, bench_speed(run_bitshuffle, &args), note);
+        print_speed(name, "bitunshuffle", &args, bench_speed(run_bitunshuffle, &args), "");
+      }
+
+      // The filters that choose their code by themselves
+      print_speed("-", "delta_encoder", &args, bench_speed(run_delta_encoder, &args), "");
+      print_speed("-", "delta_decoder", &args, bench_speed(run_delta_decoder, &args), "");
+      print_speed("-", "delta_encoder(elements)", &args, bench_speed(run_delta_elements, &args), "");
+      print_speed("-", "delta_encoder_shuffle", &args, bench_speed(run_delta_encoder_shuffle, &args), "");
+      print_speed("-", "delta_decoder_unshuffle", &args, bench_speed(run_delta_decoder_unshuffle, &args), "");
+      if (args.typesize == 4 || args.typesize == 8) {
+        print_speed("-", "truncate_precision", &args, bench_speed(run_truncate_precision, &args), "");
+        print_speed("-", "truncate_precision_shuffle", &args,
+                    bench_speed(run_truncate_precision_shuffle, &args), "");
+      }
+      if (args.typesize < 256) {
+        print_speed("-", "bytedelta_forward", &args, bench_speed(run_bytedelta_forward, &args), "");
+        print_speed("-", "bytedelta_backward", &args, bench_speed(run_bytedelta_backward, &args), "");
+      }
+    }
+  }
+
+  free(src);
+  free(dref);
+  free(dest);
+  free(expected);
+  free(tmp);
+  blosc2_destroy();
+  return rc;
+}
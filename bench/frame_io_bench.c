@@ -0,0 +1,618 @@
+/*********************************************************************
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Benchmark for the I/O patterns of the frames.
+
+  A super-chunk is built (appends) and then reopened, read (whole chunks at
+  random, a few items of a chunk through its lazy chunk, slices spanning
+  several chunks) and modified (updates, inserts and deletes), for every
+  storage backend: in-memory frames, contiguous and sparse frames on files,
+  and contiguous frames through the memory-mapped, io_uring and direct ios.
+
+  Every backend is run twice with the same (pseudo-random) operations: once
+  with its io as is, for the timings, and once through a wrapper io that
+  counts the bytes going to and coming from the io, for the amplification
+  (the bytes read from the io per logical byte that is asked for).  The
+  wrapper hides the mapping of the memory-mapped io, so chunks are copied
+  instead of being used in place in the counting run; that is why both runs
+  are needed.  Any other io (e.g. a registered blosc2_io_cb) can be measured
+  by adding it to the backends below.
+
+  Usage: frame_io_bench [nchunks [nops]]
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosc2.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define KB  1024.
+#define MB  (1024*KB)
+
+#define NCHUNKS 100
+#define NOPS 200
+#define CHUNK_NITEMS (256 * 1024)   /* int32 items, for 1 MB chunks */
+#define LAZY_NITEMS 100             /* the items read from a lazy chunk */
+#define COUNTING_IO BLOSC2_IO_REGISTERED  /* plus the id of the wrapped io */
+
+#define URLPATH_CFRAME "frame_io_bench.b2frame"
+#define URLPATH_SFRAME "frame_io_bench.b2sframe"
+
+
+/* The super-chunks to measure */
+typedef struct {
+  const char* name;
+  bool persistent;
+  bool contiguous;
+  uint8_t io_id;
+} backend_t;
+
+static const backend_t backends[] = {
+  {"memory", false, true, BLOSC2_IO_FILESYSTEM},
+  {"cframe", true, true, BLOSC2_IO_FILESYSTEM},
+  {"sframe", true, false, BLOSC2_IO_FILESYSTEM},
+#if !defined(_WIN32)
+  {"mmap", true, true, BLOSC2_IO_FILESYSTEM_MMAP},
+  {"uring", true, true, BLOSC2_IO_FILESYSTEM_URING},
+  {"direct", true, true, BLOSC2_IO_FILESYSTEM_DIRECT},
+#endif
+};
+
+/* The params of the ios that need them (a new set for every open) */
+typedef struct {
+  blosc2_stdio_mmap mmap;
+  blosc2_stdio_uring uring;
+  blosc2_stdio_direct direct;
+} backend_params_t;
+
+enum {
+  OP_APPEND,
+  OP_REOPEN,
+  OP_CHUNK,
+  OP_LAZY_ITEMS,
+  OP_SLICE,
+  OP_UPDATE,
+  OP_INSERT,
+  OP_DELETE,
+  NOPERATIONS,
+};
+
+static const char* op_names[NOPERATIONS] = {
+  "append", "reopen", "chunk", "lazy_items", "slice", "update", "insert", "delete",
+};
+
+typedef struct {
+  int64_t nops;
+  double secs;
+  int64_t logical;      /* the bytes asked for (the uncompressed ones) */
+  int64_t nreads;
+  int64_t read_bytes;   /* the bytes read from the io */
+  int64_t write_bytes;  /* the bytes written to the io */
+} op_stats;
+
+
+/* The counting wrapper io */
+
+typedef struct {
+  uint8_t base_id;
+  void* base_params;
+} counting_params;
+
+typedef struct {
+  const blosc2_io_cb* base;
+  const blosc2_io_cb_ext* base_ext;
+  void* stream;
+} counting_stream;
+
+typedef struct {
+  blosc2_io_request* request;
+  blosc2_io_done_cb done;
+} counting_request;
+
+static struct {
+  int64_t nreads;
+  int64_t read_bytes;
+  int64_t write_bytes;
+} io_counts;
+
+static void count_read(int64_t nbytes) {
+  io_counts.nreads++;
+  if (nbytes > 0) {
+    io_counts.read_bytes += nbytes;
+  }
+}
+
+static void count_write(int64_t nbytes) {
+  if (nbytes > 0) {
+    io_counts.write_bytes += nbytes;
+  }
+}
+
+static void* counting_open(const char* urlpath, const char* mode, void* params) {
+  counting_params* cparams = params;
+  const blosc2_io_cb* base = blosc2_get_io_cb(cparams->base_id);
+  if (base == NULL) {
+    return NULL;
+  }
+  void* base_stream = base->open(urlpath, mode, cparams->base_params);
+  if (base_stream == NULL) {
+    return NULL;
+  }
+  counting_stream* stream = malloc(sizeof(counting_stream));
+  stream->base = base;
+  stream->base_ext = blosc2_get_io_cb_ext(cparams->base_id);
+  stream->stream = base_stream;
+  return stream;
+}
+
+static int counting_close(void* stream) {
+  counting_stream* cstream = stream;
+  int rc = cstream->base->close(cstream->stream);
+  free(cstream);
+  return rc;
+}
+
+static int64_t counting_tell(void* stream) {
+  counting_stream* cstream = stream;
+  return cstream->base->tell(cstream->stream);
+}
+
+static int counting_seek(void* stream, int64_t offset, int whence) {
+  counting_stream* cstream = stream;
+  return cstream->base->seek(cstream->stream, offset, whence);
+}
+
+static int64_t counting_write(const void* ptr, int64_t size, int64_t nitems, void* stream) {
+  counting_stream* cstream = stream;
+  int64_t n = cstream->base->write(ptr, size, nitems, cstream->stream);
+  count_write(n * size);
+  return n;
+}
+
+static int64_t counting_read(void* ptr, int64_t size, int64_t nitems, void* stream) {
+  counting_stream* cstream = stream;
+  int64_t n = cstream->base->read(ptr, size, nitems, cstream->stream);
+  count_read(n * size);
+  return n;
+}
+
+static int counting_truncate(void* stream, int64_t size) {
+  counting_stream* cstream = stream;
+  return cstream->base->truncate(cstream->stream, size);
+}
+
+static int64_t counting_pread(void* ptr, int64_t size, int64_t nitems, int64_t position, void* stream) {
+  counting_stream* cstream = stream;
+  int64_t n = cstream->base_ext->pread(ptr, size, nitems, position, cstream->stream);
+  count_read(n * size);
+  return n;
+}
+
+static int64_t counting_pwrite(const void* ptr, int64_t size, int64_t nitems, int64_t position, void* stream) {
+  counting_stream* cstream = stream;
+  int64_t n = cstream->base_ext->pwrite(ptr, size, nitems, position, cstream->stream);
+  count_write(n * size);
+  return n;
+}
+
+static void counting_done(blosc2_io_request* request) {
+  counting_request* crequest = request->user_data;
+  crequest->request->result = request->result;
+  count_read(request->result);
+  crequest->done(crequest->request);
+}
+
+/* The requests go to the wrapped io with its streams, and come back through counting_done() */
+static int counting_pread_batch(blosc2_io_request* requests, int64_t nrequests, blosc2_io_done_cb done) {
+  if (nrequests <= 0) {
+    return 0;
+  }
+  const blosc2_io_cb_ext* base_ext = ((counting_stream*)requests[0].stream)->base_ext;
+  blosc2_io_request* base_requests = malloc(nrequests * sizeof(blosc2_io_request));
+  counting_request* crequests = malloc(nrequests * sizeof(counting_request));
+  for (int64_t i = 0; i < nrequests; i++) {
+    base_requests[i] = requests[i];
+    base_requests[i].stream = ((counting_stream*)requests[i].stream)->stream;
+    base_requests[i].user_data = &crequests[i];
+    crequests[i].request = &requests[i];
+    crequests[i].done = done;
+  }
+  int rc = base_ext->pread_batch(base_requests, nrequests, counting_done);
+  free(base_requests);
+  free(crequests);
+  return rc;
+}
+
+/* A counting io for every io wrapped, so that the optional callbacks are the ones of the wrapped io */
+static int register_counting_io(uint8_t base_id) {
+  if (blosc2_get_io_cb(COUNTING_IO + base_id) != NULL) {
+    return 0;
+  }
+  const blosc2_io_cb* base = blosc2_get_io_cb(base_id);
+  const blosc2_io_cb_ext* base_ext = blosc2_get_io_cb_ext(base_id);
+  if (base == NULL) {
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  blosc2_io_cb io_cb = {0};
+  io_cb.id = COUNTING_IO + base_id;
+  io_cb.name = "counting";
+  io_cb.open = counting_open;
+  io_cb.close = counting_close;
+  io_cb.tell = counting_tell;
+  io_cb.seek = counting_seek;
+  io_cb.write = counting_write;
+  io_cb.read = counting_read;
+  io_cb.truncate = counting_truncate;
+  int rc = blosc2_register_io_cb(&io_cb);
+  if (rc < 0) {
+    return rc;
+  }
+  blosc2_io_cb_ext io_cb_ext = {0};
+  io_cb_ext.pread = (base_ext->pread != NULL) ? counting_pread : NULL;
+  io_cb_ext.pwrite = (base_ext->pwrite != NULL) ? counting_pwrite : NULL;
+  io_cb_ext.pread_batch = (base_ext->pread_batch != NULL) ? counting_pread_batch : NULL;
+  return blosc2_register_io_cb_ext(io_cb.id, &io_cb_ext);
+}
+
+
+/* The backends */
+
+static const char* backend_urlpath(const backend_t* backend) {
+  if (!backend->persistent) {
+    return NULL;
+  }
+  return backend->contiguous ? URLPATH_CFRAME : URLPATH_SFRAME;
+}
+
+/* The params for a new open of the file (create is for making it) */
+static void* backend_params(const backend_t* backend, backend_params_t* params, bool create) {
+  switch (backend->io_id) {
+    case BLOSC2_IO_FILESYSTEM_MMAP:
+      params->mmap = BLOSC2_STDIO_MMAP_DEFAULTS;
+      params->mmap.mode = create ? "w+" : "r+";
+      return &params->mmap;
+    case BLOSC2_IO_FILESYSTEM_URING:
+      params->uring = BLOSC2_STDIO_URING_DEFAULTS;
+      return &params->uring;
+    case BLOSC2_IO_FILESYSTEM_DIRECT:
+      params->direct = BLOSC2_STDIO_DIRECT_DEFAULTS;
+      return &params->direct;
+    default:
+      return NULL;
+  }
+}
+
+/* To be called once the super-chunk using the params is freed */
+static int backend_release(const backend_t* backend, backend_params_t* params) {
+  switch (backend->io_id) {
+    case BLOSC2_IO_FILESYSTEM_MMAP:
+      return blosc2_stdio_mmap_destroy(&params->mmap);
+    case BLOSC2_IO_FILESYSTEM_DIRECT:
+      return blosc2_stdio_direct_destroy(&params->direct);
+    default:
+      return 0;
+  }
+}
+
+static void backend_io(const backend_t* backend, bool counting, void* params,
+                       counting_params* wrapper_params, blosc2_io* io) {
+  if (counting) {
+    wrapper_params->base_id = backend->io_id;
+    wrapper_params->base_params = params;
+    io->id = COUNTING_IO + backend->io_id;
+    io->name = "counting";
+    io->params = wrapper_params;
+  }
+  else {
+    io->id = backend->io_id;
+    io->name = blosc2_get_io_cb(backend->io_id)->name;
+    io->params = params;
+  }
+}
+
+
+/* The data and the operations */
+
+static uint32_t rand_state;
+
+static uint32_t next_rand(void) {
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return rand_state;
+}
+
+/* A ramp with some noise in the low bits, so that chunks compress 3x or so */
+static void fill_chunk(int32_t* data, int64_t nchunk) {
+  for (int i = 0; i < CHUNK_NITEMS; i++) {
+    data[i] = (int32_t)(nchunk * CHUNK_NITEMS + i) + (int32_t)(next_rand() & 0x3ff);
+  }
+}
+
+static void op_start(op_stats* stats, blosc_timestamp_t* start) {
+  stats->read_bytes -= io_counts.read_bytes;
+  stats->nreads -= io_counts.nreads;
+  stats->write_bytes -= io_counts.write_bytes;
+  blosc_set_timestamp(start);
+}
+
+static void op_end(op_stats* stats, blosc_timestamp_t start) {
+  blosc_timestamp_t end;
+  blosc_set_timestamp(&end);
+  stats->secs += blosc_elapsed_secs(start, end);
+  stats->read_bytes += io_counts.read_bytes;
+  stats->nreads += io_counts.nreads;
+  stats->write_bytes += io_counts.write_bytes;
+}
+
+
+/* Run all the operations on a backend, with the same sequence of them every time */
+static int run_backend(const backend_t* backend, bool counting, int nchunks, int nops, op_stats* stats) {
+  const char* urlpath = backend_urlpath(backend);
+  int32_t chunksize = CHUNK_NITEMS * (int32_t)sizeof(int32_t);
+  int32_t* data = malloc(chunksize);
+  int32_t* dest = malloc(chunksize);
+  int64_t slice_nitems = CHUNK_NITEMS + CHUNK_NITEMS / 2;
+  int32_t* slice = malloc(slice_nitems * sizeof(int32_t));
+  uint8_t* chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  backend_params_t params;
+  counting_params wrapper;
+  blosc_timestamp_t start;
+  int rc = 0;
+
+  memset(stats, 0, NOPERATIONS * sizeof(op_stats));
+  rand_state = 12345;
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.clevel = 5;
+  cparams.nthreads = 1;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 1;
+  blosc2_io io;
+  backend_io(backend, counting, backend_params(backend, &params, true), &wrapper, &io);
+  blosc2_storage storage = {.contiguous=backend->contiguous, .urlpath=(char*)urlpath,
+                            .cparams=&cparams, .dparams=&dparams, .io=&io};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  if (schunk == NULL) {
+    printf("Cannot create the super-chunk for %s\n", backend->name);
+    rc = 1;
+    goto out;
+  }
+
+  op_stats* st = &stats[OP_APPEND];
+  for (int nchunk = 0; nchunk < nchunks; nchunk++) {
+    fill_chunk(data, nchunk);
+    op_start(st, &start);
+    int64_t n = blosc2_schunk_append_buffer(schunk, data, chunksize);
+    op_end(st, start);
+    if (n != nchunk + 1) {
+      printf("Error appending chunk %d for %s\n", nchunk, backend->name);
+      rc = 1;
+      goto out;
+    }
+    st->nops++;
+    st->logical += chunksize;
+  }
+
+  if (backend->persistent) {
+    blosc2_schunk_free(schunk);
+    schunk = NULL;
+    backend_release(backend, &params);
+    st = &stats[OP_REOPEN];
+    int nreopens = nops / 10 > 0 ? nops / 10 : 1;
+    for (int i = 0; i <= nreopens; i++) {
+      backend_io(backend, counting, backend_params(backend, &params, false), &wrapper, &io);
+      // The last open is the one for the operations below
+      if (i < nreopens) {
+        op_start(st, &start);
+      }
+      schunk = blosc2_schunk_open_udio(urlpath, &io);
+      if (i < nreopens) {
+        op_end(st, start);
+        st->nops++;
+      }
+      if (schunk == NULL) {
+        printf("Cannot reopen the super-chunk for %s\n", backend->name);
+        rc = 1;
+        goto out;
+      }
+      if (i < nreopens) {
+        blosc2_schunk_free(schunk);
+        schunk = NULL;
+        backend_release(backend, &params);
+      }
+    }
+  }
+
+  st = &stats[OP_CHUNK];
+  for (int i = 0; i < nops; i++) {
+    int64_t nchunk = next_rand() % schunk->nchunks;
+    op_start(st, &start);
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, dest, chunksize);
+    op_end(st, start);
+    if (dsize != chunksize) {
+      printf("Error decompressing chunk %" PRId64 " for %s\n", nchunk, backend->name);
+      rc = 1;
+      goto out;
+    }
+    st->nops++;
+    st->logical += chunksize;
+  }
+
+  st = &stats[OP_LAZY_ITEMS];
+  for (int i = 0; i < nops; i++) {
+    int64_t nchunk = next_rand() % schunk->nchunks;
+    int start_item = (int)(next_rand() % (CHUNK_NITEMS - LAZY_NITEMS));
+    uint8_t* lazychunk;
+    bool needs_free;
+    op_start(st, &start);
+    int cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &lazychunk, &needs_free);
+    int dsize = -1;
+    if (cbytes >= 0) {
+      dsize = blosc2_getitem_ctx(schunk->dctx, lazychunk, cbytes, start_item, LAZY_NITEMS,
+                                 dest, chunksize);
+      if (needs_free) {
+        free(lazychunk);
+      }
+    }
+    op_end(st, start);
+    if (dsize != LAZY_NITEMS * (int)sizeof(int32_t)) {
+      printf("Error getting items of chunk %" PRId64 " for %s\n", nchunk, backend->name);
+      rc = 1;
+      goto out;
+    }
+    st->nops++;
+    st->logical += dsize;
+  }
+
+  st = &stats[OP_SLICE];
+  int64_t nitems = schunk->nbytes / (int64_t)sizeof(int32_t);
+  if (nitems > slice_nitems) {
+    for (int i = 0; i < nops; i++) {
+      int64_t start_item = next_rand() % (nitems - slice_nitems);
+      op_start(st, &start);
+      int err = blosc2_schunk_get_slice_buffer(schunk, start_item, start_item + slice_nitems, slice);
+      op_end(st, start);
+      if (err < 0) {
+        printf("Error getting a slice for %s\n", backend->name);
+        rc = 1;
+        goto out;
+      }
+      st->nops++;
+      st->logical += slice_nitems * (int64_t)sizeof(int32_t);
+    }
+  }
+
+  fill_chunk(data, 0);
+  int csize = blosc2_compress_ctx(schunk->cctx, data, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+  if (csize <= 0) {
+    printf("Error compressing a chunk for %s\n", backend->name);
+    rc = 1;
+    goto out;
+  }
+  for (int op = OP_UPDATE; op <= OP_DELETE; op++) {
+    st = &stats[op];
+    for (int i = 0; i < nops; i++) {
+      // Some inserts for every delete, so that the number of chunks does not go down too much
+      if (op == OP_DELETE && i >= nops / 2) {
+        break;
+      }
+      int64_t nchunk = next_rand() % schunk->nchunks;
+      op_start(st, &start);
+      int64_t n;
+      switch (op) {
+        case OP_UPDATE:
+          n = blosc2_schunk_update_chunk(schunk, nchunk, chunk, true);
+          break;
+        case OP_INSERT:
+          n = blosc2_schunk_insert_chunk(schunk, nchunk, chunk, true);
+          break;
+        default:
+          n = blosc2_schunk_delete_chunk(schunk, nchunk);
+          break;
+      }
+      op_end(st, start);
+      if (n < 0) {
+        printf("Error in %s of chunk %" PRId64 " for %s\n", op_names[op], nchunk, backend->name);
+        rc = 1;
+        goto out;
+      }
+      st->nops++;
+      st->logical += chunksize;
+    }
+  }
+
+  out:
+  if (schunk != NULL) {
+    blosc2_schunk_free(schunk);
+    backend_release(backend, &params);
+  }
+  blosc2_remove_urlpath(urlpath);
+  free(data);
+  free(dest);
+  free(slice);
+  free(chunk);
+  return rc;
+}
+
+
+static void print_stats(const char* backend, const char* op, bool reads, const op_stats* timing,
+                        const op_stats* counts) {
+  if (timing->nops == 0) {
+    return;
+  }
+  double iops = (double)timing->nops / timing->secs;
+  printf("%-8s %-10s %6" PRId64 " %10.0f", backend, op, timing->nops, iops);
+  if (timing->logical > 0) {
+    printf(" %10.1f", (double)timing->logical / timing->secs / MB);
+  }
+  else {
+    printf(" %10s", "-");
+  }
+  if (counts == NULL) {
+    printf(" %9s %12s %9s %12s\n", "-", "-", "-", "-");
+    return;
+  }
+  printf(" %9.1f %12.0f", (double)counts->nreads / (double)counts->nops,
+         (double)counts->read_bytes / (double)counts->nops);
+  // The amplification only makes sense for the reads of some data
+  if (reads && counts->logical > 0) {
+    printf(" %9.3f", (double)counts->read_bytes / (double)counts->logical);
+  }
+  else {
+    printf(" %9s", "-");
+  }
+  printf(" %12.0f\n", (double)counts->write_bytes / (double)counts->nops);
+}
+
+
+int main(int argc, char* argv[]) {
+  int nchunks = NCHUNKS;
+  int nops = NOPS;
+  if (argc > 3 || (argc > 1 && (nchunks = (int)strtol(argv[1], NULL, 10)) < 2) ||
+      (argc > 2 && (nops = (int)strtol(argv[2], NULL, 10)) < 1)) {
+    printf("Usage: frame_io_bench [nchunks [nops]]\n");
+    return 1;
+  }
+
+  blosc2_init();
+  printf("Blosc version: %s (%s)\n", BLOSC2_VERSION_STRING, BLOSC2_VERSION_DATE);
+  printf("%d chunks of %.1f MB, %d operations of every kind\n\n", nchunks,
+         CHUNK_NITEMS * sizeof(int32_t) / MB, nops);
+  printf("%-8s %-10s %6s %10s %10s %9s %12s %9s %12s\n", "backend", "op", "nops", "IOPS", "MB/s",
+         "reads/op", "rbytes/op", "read_amp", "wbytes/op");
+
+  int rc = 0;
+  op_stats timing[NOPERATIONS];
+  op_stats counts[NOPERATIONS];
+  for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+    const backend_t* backend = &backends[b];
+    if (run_backend(backend, false, nchunks, nops, timing) != 0) {
+      rc = 1;
+      continue;
+    }
+    // Only the persistent backends use the io
+    bool counted = backend->persistent;
+    if (counted) {
+      if (register_counting_io(backend->io_id) < 0 ||
+          run_backend(backend, true, nchunks, nops, counts) != 0) {
+        rc = 1;
+        continue;
+      }
+    }
+    for (int op = 0; op < NOPERATIONS; op++) {
+      print_stats(backend->name, op_names[op], op >= OP_CHUNK && op <= OP_SLICE, &timing[op], counted ? &counts[op] : NULL);
+    }
+  }
+
+  blosc2_destroy();
+  return rc;
+}
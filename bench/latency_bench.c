@@ -0,0 +1,245 @@
+/*********************************************************************
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Benchmark for the latency of the calls on small buffers.
+
+  On buffers of a few KB, the fixed costs of a call (creating a context,
+  reading the environment variables, writing the header, waking up the
+  threads, getting the dictionaries ready...) can take longer than the
+  compression itself.  Every call is timed on its own, for the APIs that
+  small messages usually go through:
+
+    simple      blosc2_compress() / blosc2_decompress() (the global context)
+    ctx_create  a new context for every call, freed right after it
+    ctx         blosc2_compress_ctx() / blosc2_decompress_ctx() on contexts
+                that are reused
+    schunk      blosc2_schunk_append_buffer() / blosc2_schunk_decompress_chunk()
+                on an in-memory super-chunk
+
+  and the percentiles of the times (in microseconds) are reported, for
+  every buffer size and number of threads.
+
+  Usage: latency_bench [sizes] [nthreads] [ncalls]
+
+  where the lists are comma-separated sizes in bytes (by default,
+  1024,4096,16384,65536) and numbers of threads (by default, 1,2,4),
+  and ncalls is the number of timed calls of every kind (10000).
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosc2.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_VALUES 16
+#define NCALLS 10000
+#define NWARMUP 100  /* the untimed calls before the timed ones */
+#define SCHUNK_MAX_CHUNKS 1000  /* the chunks in the super-chunk before it is made anew */
+
+
+enum {
+  API_SIMPLE,
+  API_CTX_CREATE,
+  API_CTX,
+  API_SCHUNK,
+  NAPIS,
+};
+
+static const char* api_names[NAPIS] = {"simple", "ctx_create", "ctx", "schunk"};
+
+typedef struct {
+  int api;
+  int32_t size;
+  int nthreads;
+  const uint8_t* src;
+  uint8_t* dest;
+  uint8_t* chunk;
+  int32_t cbytes;
+  blosc2_cparams cparams;
+  blosc2_dparams dparams;
+  blosc2_context* cctx;
+  blosc2_context* dctx;
+  blosc2_schunk* schunk;
+} bench_state;
+
+
+/* One call of the compression or the decompression; returns a negative value on errors */
+static int run_call(bench_state* state, bool compress) {
+  int32_t destsize = state->size + BLOSC2_MAX_OVERHEAD;
+  blosc2_context* ctx;
+  int rc;
+  switch (state->api) {
+    case API_SIMPLE:
+      if (compress) {
+        rc = state->cbytes = blosc2_compress(state->cparams.clevel, BLOSC_SHUFFLE, state->cparams.typesize,
+                                             state->src, state->size, state->chunk, destsize);
+      }
+      else {
+        rc = blosc2_decompress(state->chunk, state->cbytes, state->dest, state->size);
+      }
+      return rc;
+    case API_CTX_CREATE:
+      if (compress) {
+        ctx = blosc2_create_cctx(state->cparams);
+        rc = state->cbytes = blosc2_compress_ctx(ctx, state->src, state->size, state->chunk, destsize);
+      }
+      else {
+        ctx = blosc2_create_dctx(state->dparams);
+        rc = blosc2_decompress_ctx(ctx, state->chunk, state->cbytes, state->dest, state->size);
+      }
+      blosc2_free_ctx(ctx);
+      return rc;
+    case API_CTX:
+      if (compress) {
+        rc = state->cbytes = blosc2_compress_ctx(state->cctx, state->src, state->size, state->chunk, destsize);
+      }
+      else {
+        rc = blosc2_decompress_ctx(state->dctx, state->chunk, state->cbytes, state->dest, state->size);
+      }
+      return rc;
+    default:
+      if (compress) {
+        int64_t nchunks = blosc2_schunk_append_buffer(state->schunk, (void*)state->src, state->size);
+        return nchunks < 0 ? (int)nchunks : 0;
+      }
+      return blosc2_schunk_decompress_chunk(state->schunk, state->schunk->nchunks - 1, state->dest, state->size);
+  }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/* The percentile p (in %) of the sorted times */
+static double percentile(const double* times, int ntimes, double p) {
+  int i = (int)(p / 100. * ntimes);
+  return times[i < ntimes ? i : ntimes - 1];
+}
+
+/* Time ncalls calls (after a few untimed ones) and print their percentiles */
+static int bench_calls(bench_state* state, bool compress, int ncalls, double* times) {
+  blosc_timestamp_t start, end;
+  for (int i = -NWARMUP; i < ncalls; i++) {
+    if (compress && state->api == API_SCHUNK && state->schunk->nchunks == SCHUNK_MAX_CHUNKS) {
+      // Keep the super-chunk (and its memory) from growing for ever
+      blosc2_schunk_free(state->schunk);
+      blosc2_storage storage = {.cparams=&state->cparams, .dparams=&state->dparams};
+      state->schunk = blosc2_schunk_new(&storage);
+    }
+    blosc_set_timestamp(&start);
+    int rc = run_call(state, compress);
+    blosc_set_timestamp(&end);
+    if (rc < 0) {
+      printf("Error in %s (%s): %d\n", api_names[state->api], compress ? "compress" : "decompress", rc);
+      return rc;
+    }
+    if (i >= 0) {
+      times[i] = blosc_elapsed_nsecs(start, end) / 1000.;
+    }
+  }
+  qsort(times, ncalls, sizeof(double), compare_doubles);
+  printf("%-11s %-11s %8d %8d %10.2f %10.2f %10.2f %10.2f\n", api_names[state->api],
+         compress ? "compress" : "decompress", state->size, state->nthreads, percentile(times, ncalls, 50),
+         percentile(times, ncalls, 99), percentile(times, ncalls, 99.9), times[ncalls - 1]);
+  return 0;
+}
+
+
+static int parse_ints(const char* arg, int* values) {
+  int n = 0;
+  char* end;
+  while (n < MAX_VALUES) {
+    values[n++] = (int)strtol(arg, &end, 10);
+    if (end == arg || values[n - 1] <= 0 || (*end != ',' && *end != '\0')) {
+      return -1;
+    }
+    if (*end == '\0') {
+      return n;
+    }
+    arg = end + 1;
+  }
+  return -1;
+}
+
+
+int main(int argc, char* argv[]) {
+  int sizes[MAX_VALUES] = {1024, 4096, 16384, 65536};
+  int nsizes = 4;
+  int nthreads_list[MAX_VALUES] = {1, 2, 4};
+  int nnthreads = 3;
+  int ncalls = NCALLS;
+  if (argc > 4 ||
+      (argc > 1 && (nsizes = parse_ints(argv[1], sizes)) < 0) ||
+      (argc > 2 && (nnthreads = parse_ints(argv[2], nthreads_list)) < 0) ||
+      (argc > 3 && (ncalls = (int)strtol(argv[3], NULL, 10)) <= 0)) {
+    printf("Usage: latency_bench [sizes] [nthreads] [ncalls]\n");
+    return 1;
+  }
+  int max_size = 0;
+  for (int s = 0; s < nsizes; s++) {
+    max_size = (sizes[s] > max_size) ? sizes[s] : max_size;
+  }
+
+  blosc2_init();
+
+  // Slowly varying int32 with some noise, like the values of typical messages
+  uint8_t* src = malloc(max_size);
+  uint8_t* dest = malloc(max_size);
+  uint8_t* chunk = malloc(max_size + BLOSC2_MAX_OVERHEAD);
+  double* times = malloc(ncalls * sizeof(double));
+  uint32_t seed = 1;
+  for (int i = 0; i < max_size / 4; i++) {
+    seed = seed * 1103515245u + 12345u;
+    ((int32_t*)src)[i] = i / 16 + (int32_t)(seed >> 28);
+  }
+  memset(src + max_size / 4 * 4, 0, max_size % 4);
+
+  printf("Blosc version: %s (%s)\n", BLOSC2_VERSION_STRING, BLOSC2_VERSION_DATE);
+  printf("Latency of %d calls (in us)\n\n", ncalls);
+  printf("%-11s %-11s %8s %8s %10s %10s %10s %10s\n", "api", "call", "size", "nthreads",
+         "p50", "p99", "p99.9", "max");
+
+  int rc = 0;
+  for (int t = 0; t < nnthreads && rc == 0; t++) {
+    blosc2_set_nthreads((int16_t)nthreads_list[t]);
+    for (int s = 0; s < nsizes && rc == 0; s++) {
+      for (int api = 0; api < NAPIS && rc == 0; api++) {
+        bench_state state = {.api=api, .size=sizes[s], .nthreads=nthreads_list[t],
+                             .src=src, .dest=dest, .chunk=chunk};
+        state.cparams = BLOSC2_CPARAMS_DEFAULTS;
+        state.cparams.typesize = sizeof(int32_t);
+        state.cparams.nthreads = (int16_t)nthreads_list[t];
+        state.dparams = BLOSC2_DPARAMS_DEFAULTS;
+        state.dparams.nthreads = (int16_t)nthreads_list[t];
+        state.cctx = blosc2_create_cctx(state.cparams);
+        state.dctx = blosc2_create_dctx(state.dparams);
+        blosc2_storage storage = {.cparams=&state.cparams, .dparams=&state.dparams};
+        state.schunk = blosc2_schunk_new(&storage);
+
+        rc = bench_calls(&state, true, ncalls, times);
+        if (rc == 0) {
+          rc = bench_calls(&state, false, ncalls, times);
+        }
+
+        blosc2_free_ctx(state.cctx);
+        blosc2_free_ctx(state.dctx);
+        blosc2_schunk_free(state.schunk);
+      }
+    }
+  }
+
+  free(src);
+  free(dest);
+  free(chunk);
+  free(times);
+  blosc2_destroy();
+
+  return rc == 0 ? 0 : 1;
+}
@@ -0,0 +1,688 @@
+/*********************************************************************
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Performance regression checks against the results of a baseline.
+
+  A curated set of scenarios is measured and every result is compared
+  with the one in a baseline file (JSON), so that a slowdown of the
+  shuffles, the codecs, the frames or b2nd shows up before a release.
+  The scenarios come in groups:
+
+    codecs   compression and decompression speed (GB/s) of the codecs
+             (blosclz, lz4, zstd) with the filters (noshuffle, shuffle,
+             bitshuffle) for several typesizes (2, 4, 8)
+    latency  the median time (us) of compressing and decompressing small
+             buffers with contexts that are reused
+    frame    appending the chunks to a frame on disk and reading them
+             back (GB/s), and opening the frame (us)
+    b2nd     getting slices of a 2-dim array, inside a chunk and across
+             the chunks (GB/s)
+
+  Every result is the best one of a few runs.  A result is a regression
+  when it is slower than the one in the baseline by more than the
+  tolerance (a fraction of the baseline): the one of the scenario in the
+  baseline, or else the global one.  The baseline looks like:
+
+    {
+      "tolerance": 0.2,
+      "results": {
+        "codecs/lz4/shuffle/4/compress": {"value": 5.37, "unit": "GB/s"},
+        "latency/4096/compress": {"value": 3.1, "unit": "us", "tolerance": 0.5},
+        ...
+      }
+    }
+
+  The results depend heavily on the machine, so the baseline has to be
+  recorded (with --update) on the machine where the checks are run.
+
+  Usage: perf_regression [--update] [--tolerance=X] baseline.json [groups]
+
+  where groups is a comma-separated list of groups (by default, all of
+  them).  With --update, the results are written to the baseline (the
+  tolerances in it are kept) instead of being compared.  The exit code is
+  0 when there is no regression, 1 when there is some and 77 (skipped)
+  when there is no baseline to compare with.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosc2.h"
+#include "b2nd.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_RESULTS 256
+#define NAME_LEN 64
+#define NRUNS 5
+#define MIN_RUN_BYTES (64 * 1024 * 1024)  /* the bytes processed in a run at least */
+#define DEFAULT_TOLERANCE 0.2
+#define EXIT_SKIPPED 77  /* what ctest takes as a skipped test (SKIP_RETURN_CODE) */
+
+#define CHUNKSIZE (4 * 1024 * 1024)
+#define NLATENCY_CALLS 2000
+#define FRAME_NCHUNKS 16
+#define URLPATH "perf_regression.b2frame"
+
+static const char* all_groups = "codecs,latency,frame,b2nd";
+static const char* codecs[] = {"blosclz", "lz4", "zstd"};
+static const int filters[] = {BLOSC_NOSHUFFLE, BLOSC_SHUFFLE, BLOSC_BITSHUFFLE};
+static const char* filter_names[] = {"noshuffle", "shuffle", "bitshuffle"};
+static const int32_t typesizes[] = {2, 4, 8};
+static const int32_t latency_sizes[] = {4096, 65536};
+
+
+typedef struct {
+  char name[NAME_LEN];
+  double value;
+  bool higher_is_better;  /* GB/s when true, us when false */
+  double tolerance;  /* < 0 for the global one */
+} result;
+
+typedef struct {
+  double tolerance;
+  int nresults;
+  result results[MAX_RESULTS];
+} result_set;
+
+
+static result* find_result(result_set* set, const char* name) {
+  for (int i = 0; i < set->nresults; i++) {
+    if (strcmp(set->results[i].name, name) == 0) {
+      return &set->results[i];
+    }
+  }
+  return NULL;
+}
+
+static result* add_result(result_set* set, const char* name) {
+  result* res = find_result(set, name);
+  if (res == NULL && set->nresults < MAX_RESULTS) {
+    res = &set->results[set->nresults++];
+    snprintf(res->name, NAME_LEN, "%s", name);
+    res->value = 0;
+    res->higher_is_better = true;
+    res->tolerance = -1;
+  }
+  return res;
+}
+
+
+/* A minimal parser for the baseline: objects, strings without escapes other than \" and \\,
+   numbers and literals (which are skipped) */
+typedef struct {
+  const char* p;
+} json_parser;
+
+static void json_skip_ws(json_parser* js) {
+  while (isspace((unsigned char)*js->p)) {
+    js->p++;
+  }
+}
+
+static bool json_expect(json_parser* js, char c) {
+  json_skip_ws(js);
+  if (*js->p != c) {
+    return false;
+  }
+  js->p++;
+  return true;
+}
+
+static bool json_string(json_parser* js, char* str, int maxlen) {
+  if (!json_expect(js, '"')) {
+    return false;
+  }
+  int len = 0;
+  while (*js->p != '"') {
+    if (*js->p == '\0') {
+      return false;
+    }
+    if (*js->p == '\\' && js->p[1] != '\0') {
+      js->p++;
+    }
+    if (len < maxlen - 1) {
+      str[len++] = *js->p;
+    }
+    js->p++;
+  }
+  str[len] = '\0';
+  js->p++;
+  return true;
+}
+
+static bool json_number(json_parser* js, double* value) {
+  json_skip_ws(js);
+  char* end;
+  *value = strtod(js->p, &end);
+  if (end == js->p) {
+    return false;
+  }
+  js->p = end;
+  return true;
+}
+
+static bool json_skip_value(json_parser* js) {
+  json_skip_ws(js);
+  char c = *js->p;
+  if (c == '"') {
+    char str[NAME_LEN];
+    return json_string(js, str, NAME_LEN);
+  }
+  if (c == '{' || c == '[') {
+    char close = c == '{' ? '}' : ']';
+    js->p++;
+    if (json_expect(js, close)) {
+      return true;
+    }
+    do {
+      char key[NAME_LEN];
+      if (c == '{' && (!json_string(js, key, NAME_LEN) || !json_expect(js, ':'))) {
+        return false;
+      }
+      if (!json_skip_value(js)) {
+        return false;
+      }
+    } while (json_expect(js, ','));
+    return json_expect(js, close);
+  }
+  double value;
+  if (json_number(js, &value)) {
+    return true;
+  }
+  while (isalpha((unsigned char)*js->p)) {
+    js->p++;
+  }
+  return true;
+}
+
+/* Parse the members of an object, calling member() on every key (which parses its value) */
+static bool json_object(json_parser* js, bool (*member)(json_parser*, const char*, void*), void* data) {
+  if (!json_expect(js, '{')) {
+    return false;
+  }
+  if (json_expect(js, '}')) {
+    return true;
+  }
+  do {
+    char key[NAME_LEN];
+    if (!json_string(js, key, NAME_LEN) || !json_expect(js, ':') || !member(js, key, data)) {
+      return false;
+    }
+  } while (json_expect(js, ','));
+  return json_expect(js, '}');
+}
+
+static bool parse_result_member(json_parser* js, const char* key, void* data) {
+  result* res = data;
+  if (strcmp(key, "value") == 0) {
+    return json_number(js, &res->value);
+  }
+  if (strcmp(key, "tolerance") == 0) {
+    return json_number(js, &res->tolerance);
+  }
+  if (strcmp(key, "unit") == 0) {
+    char unit[NAME_LEN];
+    if (!json_string(js, unit, NAME_LEN)) {
+      return false;
+    }
+    res->higher_is_better = strcmp(unit, "us") != 0;
+    return true;
+  }
+  return json_skip_value(js);
+}
+
+static bool parse_results_member(json_parser* js, const char* key, void* data) {
+  result* res = add_result(data, key);
+  if (res == NULL) {
+    return false;
+  }
+  return json_object(js, parse_result_member, res);
+}
+
+static bool parse_baseline_member(json_parser* js, const char* key, void* data) {
+  result_set* set = data;
+  if (strcmp(key, "tolerance") == 0) {
+    return json_number(js, &set->tolerance);
+  }
+  if (strcmp(key, "results") == 0) {
+    return json_object(js, parse_results_member, set);
+  }
+  return json_skip_value(js);
+}
+
+/* Read the baseline; returns 0 when it is read, 1 when it does not exist and -1 on errors */
+static int read_baseline(const char* path, result_set* set) {
+  FILE* fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return 1;
+  }
+  fseek(fp, 0, SEEK_END);
+  long size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+  char* content = malloc(size + 1);
+  size_t nread = fread(content, 1, size, fp);
+  fclose(fp);
+  content[nread] = '\0';
+
+  json_parser js = {content};
+  bool ok = json_object(&js, parse_baseline_member, set);
+  free(content);
+  if (!ok) {
+    printf("Cannot parse the baseline %s\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+static int write_baseline(const char* path, const result_set* set) {
+  FILE* fp = fopen(path, "w");
+  if (fp == NULL) {
+    printf("Cannot write the baseline %s\n", path);
+    return -1;
+  }
+  fprintf(fp, "{\n  \"blosc_version\": \"%s\",\n  \"tolerance\": %g,\n  \"results\": {\n",
+          BLOSC2_VERSION_STRING, set->tolerance);
+  for (int i = 0; i < set->nresults; i++) {
+    const result* res = &set->results[i];
+    fprintf(fp, "    \"%s\": {\"value\": %.4g, \"unit\": \"%s\"", res->name, res->value,
+            res->higher_is_better ? "GB/s" : "us");
+    if (res->tolerance >= 0) {
+      fprintf(fp, ", \"tolerance\": %g", res->tolerance);
+    }
+    fprintf(fp, "}%s\n", i < set->nresults - 1 ? "," : "");
+  }
+  fprintf(fp, "  }\n}\n");
+  fclose(fp);
+  return 0;
+}
+
+
+static void add_speed(result_set* set, const char* name, int64_t nbytes, double secs) {
+  result* res = add_result(set, name);
+  if (res != NULL) {
+    res->value = (double)nbytes / secs / 1e9;
+    res->higher_is_better = true;
+  }
+}
+
+static void add_latency(result_set* set, const char* name, double usecs) {
+  result* res = add_result(set, name);
+  if (res != NULL) {
+    res->value = usecs;
+    res->higher_is_better = false;
+  }
+}
+
+
+/* The best time of a few runs of the compression or the decompression of a chunk */
+static double time_ctx_calls(blosc2_context* ctx, bool compress, const uint8_t* src, int32_t srcsize,
+                             uint8_t* dest, int32_t destsize, int32_t nbytes) {
+  int ncalls = MIN_RUN_BYTES / nbytes;
+  ncalls = ncalls > 0 ? ncalls : 1;
+  double best = -1;
+  for (int run = 0; run < NRUNS; run++) {
+    blosc_timestamp_t start, end;
+    blosc_set_timestamp(&start);
+    for (int i = 0; i < ncalls; i++) {
+      int rc = compress ? blosc2_compress_ctx(ctx, src, srcsize, dest, destsize) :
+                          blosc2_decompress_ctx(ctx, src, srcsize, dest, destsize);
+      if (rc <= 0) {
+        printf("Error in the %s: %d\n", compress ? "compression" : "decompression", rc);
+        return -1;
+      }
+    }
+    blosc_set_timestamp(&end);
+    double secs = blosc_elapsed_secs(start, end) / ncalls;
+    best = (best < 0 || secs < best) ? secs : best;
+  }
+  return best;
+}
+
+static int bench_codecs(result_set* set, const uint8_t* src, uint8_t* chunk, uint8_t* dest) {
+  for (size_t c = 0; c < sizeof(codecs) / sizeof(codecs[0]); c++) {
+    int compcode = blosc2_compname_to_compcode(codecs[c]);
+    if (compcode < 0) {
+      printf("%s not in this build\n", codecs[c]);
+      continue;
+    }
+    for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+      for (size_t t = 0; t < sizeof(typesizes) / sizeof(typesizes[0]); t++) {
+        blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+        cparams.compcode = (uint8_t)compcode;
+        cparams.clevel = 5;
+        cparams.typesize = typesizes[t];
+        cparams.filters[BLOSC2_MAX_FILTERS - 1] = (uint8_t)filters[f];
+        blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+        blosc2_context* cctx = blosc2_create_cctx(cparams);
+        blosc2_context* dctx = blosc2_create_dctx(dparams);
+
+        char name[NAME_LEN];
+        double csecs = time_ctx_calls(cctx, true, src, CHUNKSIZE, chunk, CHUNKSIZE + BLOSC2_MAX_OVERHEAD,
+                                      CHUNKSIZE);
+        int32_t cbytes = blosc2_compress_ctx(cctx, src, CHUNKSIZE, chunk, CHUNKSIZE + BLOSC2_MAX_OVERHEAD);
+        double dsecs = time_ctx_calls(dctx, false, chunk, cbytes, dest, CHUNKSIZE, CHUNKSIZE);
+        blosc2_free_ctx(cctx);
+        blosc2_free_ctx(dctx);
+        if (csecs < 0 || dsecs < 0 || memcmp(src, dest, CHUNKSIZE) != 0) {
+          printf("Wrong round trip for %s/%s/%d\n", codecs[c], filter_names[f], typesizes[t]);
+          return -1;
+        }
+        snprintf(name, NAME_LEN, "codecs/%s/%s/%d/compress", codecs[c], filter_names[f], typesizes[t]);
+        add_speed(set, name, CHUNKSIZE, csecs);
+        snprintf(name, NAME_LEN, "codecs/%s/%s/%d/decompress", codecs[c], filter_names[f], typesizes[t]);
+        add_speed(set, name, CHUNKSIZE, dsecs);
+      }
+    }
+  }
+  return 0;
+}
+
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static int bench_latency(result_set* set, const uint8_t* src, uint8_t* chunk, uint8_t* dest) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_context* cctx = blosc2_create_cctx(cparams);
+  blosc2_context* dctx = blosc2_create_dctx(dparams);
+  double* times = malloc(NLATENCY_CALLS * sizeof(double));
+  int rc = 0;
+
+  for (size_t s = 0; s < sizeof(latency_sizes) / sizeof(latency_sizes[0]) && rc == 0; s++) {
+    int32_t size = latency_sizes[s];
+    int32_t cbytes = 0;
+    for (int compress = 1; compress >= 0 && rc == 0; compress--) {
+      for (int i = -NLATENCY_CALLS / 10; i < NLATENCY_CALLS; i++) {
+        blosc_timestamp_t start, end;
+        blosc_set_timestamp(&start);
+        int n = compress ? (cbytes = blosc2_compress_ctx(cctx, src, size, chunk, size + BLOSC2_MAX_OVERHEAD)) :
+                           blosc2_decompress_ctx(dctx, chunk, cbytes, dest, size);
+        blosc_set_timestamp(&end);
+        if (n <= 0) {
+          printf("Error in the latency of %d bytes: %d\n", size, n);
+          rc = -1;
+          break;
+        }
+        if (i >= 0) {
+          times[i] = blosc_elapsed_nsecs(start, end) / 1000.;
+        }
+      }
+      qsort(times, NLATENCY_CALLS, sizeof(double), compare_doubles);
+      char name[NAME_LEN];
+      snprintf(name, NAME_LEN, "latency/%d/%s", size, compress ? "compress" : "decompress");
+      add_latency(set, name, times[NLATENCY_CALLS / 2]);
+    }
+  }
+
+  free(times);
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  return rc;
+}
+
+
+static int bench_frame(result_set* set, const uint8_t* src, uint8_t* dest) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .contiguous=true, .urlpath=URLPATH};
+  double append_secs = -1, read_secs = -1, open_secs = -1;
+  int rc = 0;
+
+  for (int run = 0; run < NRUNS && rc == 0; run++) {
+    blosc_timestamp_t start, end;
+    blosc2_remove_urlpath(URLPATH);
+    blosc_set_timestamp(&start);
+    blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+    for (int i = 0; i < FRAME_NCHUNKS && schunk != NULL; i++) {
+      if (blosc2_schunk_append_buffer(schunk, (void*)src, CHUNKSIZE) < 0) {
+        blosc2_schunk_free(schunk);
+        schunk = NULL;
+      }
+    }
+    if (schunk == NULL) {
+      printf("Cannot append to the frame\n");
+      rc = -1;
+      break;
+    }
+    blosc2_schunk_free(schunk);
+    blosc_set_timestamp(&end);
+    double secs = blosc_elapsed_secs(start, end);
+    append_secs = (append_secs < 0 || secs < append_secs) ? secs : append_secs;
+
+    blosc_set_timestamp(&start);
+    schunk = blosc2_schunk_open(URLPATH);
+    blosc_set_timestamp(&end);
+    if (schunk == NULL) {
+      printf("Cannot open the frame\n");
+      rc = -1;
+      break;
+    }
+    secs = blosc_elapsed_secs(start, end);
+    open_secs = (open_secs < 0 || secs < open_secs) ? secs : open_secs;
+
+    blosc_set_timestamp(&start);
+    for (int i = 0; i < FRAME_NCHUNKS && rc == 0; i++) {
+      if (blosc2_schunk_decompress_chunk(schunk, i, dest, CHUNKSIZE) != CHUNKSIZE) {
+        printf("Cannot read the chunk %d of the frame\n", i);
+        rc = -1;
+      }
+    }
+    blosc_set_timestamp(&end);
+    blosc2_schunk_free(schunk);
+    secs = blosc_elapsed_secs(start, end);
+    read_secs = (read_secs < 0 || secs < read_secs) ? secs : read_secs;
+  }
+  blosc2_remove_urlpath(URLPATH);
+
+  if (rc == 0) {
+    add_speed(set, "frame/append", (int64_t)FRAME_NCHUNKS * CHUNKSIZE, append_secs);
+    add_speed(set, "frame/read", (int64_t)FRAME_NCHUNKS * CHUNKSIZE, read_secs);
+    add_latency(set, "frame/open", open_secs * 1e6);
+  }
+  return rc;
+}
+
+
+static int bench_b2nd(result_set* set, const uint8_t* src, uint8_t* dest) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams};
+  // A 1024 x 1024 array of int32 (the 4 MB of the source)
+  int64_t shape[2] = {1024, 1024};
+  int32_t chunkshape[2] = {256, 256};
+  int32_t blockshape[2] = {64, 64};
+  b2nd_context_t* ctx = b2nd_create_ctx(&storage, 2, shape, chunkshape, blockshape, NULL, 0, NULL, 0);
+  b2nd_array_t* array = NULL;
+  if (ctx == NULL || b2nd_from_cbuffer(ctx, &array, src, CHUNKSIZE) < 0) {
+    printf("Cannot create the b2nd array\n");
+    b2nd_free_ctx(ctx);
+    return -1;
+  }
+  b2nd_free_ctx(ctx);
+
+  // The slices inside a chunk and across 4 chunks
+  const char* names[2] = {"b2nd/slice/inner", "b2nd/slice/cross"};
+  int64_t starts[2][2] = {{256, 256}, {128, 128}};
+  int64_t slice_shape[2] = {256, 256};
+  int64_t slice_nbytes = 256 * 256 * (int64_t)sizeof(int32_t);
+  int nslices = (int)(MIN_RUN_BYTES / 4 / slice_nbytes);
+  int rc = 0;
+  for (int s = 0; s < 2 && rc == 0; s++) {
+    int64_t stop[2] = {starts[s][0] + slice_shape[0], starts[s][1] + slice_shape[1]};
+    double best = -1;
+    for (int run = 0; run < NRUNS && rc == 0; run++) {
+      blosc_timestamp_t start, end;
+      blosc_set_timestamp(&start);
+      for (int i = 0; i < nslices && rc == 0; i++) {
+        rc = b2nd_get_slice_cbuffer(array, starts[s], stop, dest, slice_shape, slice_nbytes);
+      }
+      blosc_set_timestamp(&end);
+      double secs = blosc_elapsed_secs(start, end);
+      best = (best < 0 || secs < best) ? secs : best;
+    }
+    if (rc < 0) {
+      printf("Cannot get the slice of %s: %d\n", names[s], rc);
+      break;
+    }
+    add_speed(set, names[s], slice_nbytes * nslices, best);
+  }
+
+  b2nd_free(array);
+  return rc;
+}
+
+
+static bool in_groups(const char* groups, const char* group) {
+  size_t len = strlen(group);
+  const char* next = groups;
+  while ((next = strstr(next, group)) != NULL) {
+    if ((next == groups || next[-1] == ',') && (next[len] == ',' || next[len] == '\0')) {
+      return true;
+    }
+    next += len;
+  }
+  return false;
+}
+
+/* Compare the results with the baseline and return the number of regressions */
+static int compare_results(const result_set* results, result_set* baseline) {
+  int nregressions = 0;
+  printf("\n%-40s %10s %10s %8s %6s  %s\n", "scenario", "baseline", "current", "change", "unit", "status");
+  for (int i = 0; i < results->nresults; i++) {
+    const result* res = &results->results[i];
+    const result* base = find_result(baseline, res->name);
+    const char* unit = res->higher_is_better ? "GB/s" : "us";
+    if (base == NULL || base->value <= 0) {
+      printf("%-40s %10s %10.3g %8s %6s  %s\n", res->name, "-", res->value, "-", unit, "new");
+      continue;
+    }
+    double tolerance = base->tolerance >= 0 ? base->tolerance : baseline->tolerance;
+    // The slowdown as a fraction of the baseline (negative when faster)
+    double change = (res->value - base->value) / base->value;
+    double slowdown = res->higher_is_better ? -change : change;
+    bool regression = slowdown > tolerance;
+    nregressions += regression;
+    printf("%-40s %10.3g %10.3g %+7.1f%% %6s  %s\n", res->name, base->value, res->value, 100. * change,
+           unit, regression ? "REGRESSION" : "ok");
+  }
+  return nregressions;
+}
+
+
+int main(int argc, char* argv[]) {
+  bool update = false;
+  double tolerance = -1;
+  const char* baseline_path = NULL;
+  const char* groups = all_groups;
+  int npositional = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--update") == 0) {
+      update = true;
+    }
+    else if (strncmp(argv[i], "--tolerance=", 12) == 0) {
+      tolerance = strtod(argv[i] + 12, NULL);
+    }
+    else if (npositional == 0) {
+      baseline_path = argv[i];
+      npositional++;
+    }
+    else if (npositional == 1) {
+      groups = argv[i];
+      npositional++;
+    }
+    else {
+      npositional = -1;
+      break;
+    }
+  }
+  if (baseline_path == NULL || npositional < 0 || (tolerance < 0 && tolerance != -1)) {
+    printf("Usage: perf_regression [--update] [--tolerance=X] baseline.json [groups]\n");
+    return 1;
+  }
+
+  blosc2_init();
+
+  result_set* baseline = calloc(1, sizeof(result_set));
+  result_set* results = calloc(1, sizeof(result_set));
+  baseline->tolerance = DEFAULT_TOLERANCE;
+  int rc = read_baseline(baseline_path, baseline);
+  bool has_baseline = rc == 0;
+  if (tolerance >= 0) {
+    baseline->tolerance = tolerance;
+  }
+
+  // A ramp of int32 with some noise in the low bits, which compresses 3x or so
+  int32_t* src = malloc(CHUNKSIZE);
+  uint8_t* chunk = malloc(CHUNKSIZE + BLOSC2_MAX_OVERHEAD);
+  uint8_t* dest = malloc(CHUNKSIZE);
+  uint32_t seed = 1;
+  for (int32_t i = 0; i < CHUNKSIZE / 4; i++) {
+    seed = seed * 1103515245u + 12345u;
+    src[i] = i + (int32_t)(seed >> 22);
+  }
+
+  printf("Blosc version: %s (%s)\n", BLOSC2_VERSION_STRING, BLOSC2_VERSION_DATE);
+  printf("Groups: %s, baseline: %s%s\n", groups, baseline_path,
+         has_baseline ? "" : " (not found)");
+
+  rc = rc < 0 ? rc : 0;
+  if (rc == 0 && in_groups(groups, "codecs")) {
+    rc = bench_codecs(results, (uint8_t*)src, chunk, dest);
+  }
+  if (rc == 0 && in_groups(groups, "latency")) {
+    rc = bench_latency(results, (uint8_t*)src, chunk, dest);
+  }
+  if (rc == 0 && in_groups(groups, "frame")) {
+    rc = bench_frame(results, (uint8_t*)src, dest);
+  }
+  if (rc == 0 && in_groups(groups, "b2nd")) {
+    rc = bench_b2nd(results, (uint8_t*)src, dest);
+  }
+
+  int exit_code = rc == 0 ? 0 : 1;
+  if (rc == 0 && update) {
+    compare_results(results, baseline);
+    // Keep the results of the groups that were not run, and the tolerances
+    for (int i = 0; i < results->nresults; i++) {
+      result* res = add_result(baseline, results->results[i].name);
+      if (res != NULL) {
+        res->value = results->results[i].value;
+        res->higher_is_better = results->results[i].higher_is_better;
+      }
+    }
+    exit_code = write_baseline(baseline_path, baseline) == 0 ? 0 : 1;
+    printf("\nBaseline written to %s\n", baseline_path);
+  }
+  else if (rc == 0) {
+    int nregressions = compare_results(results, baseline);
+    if (!has_baseline) {
+      printf("\nNo baseline to compare with (record one with --update)\n");
+      exit_code = EXIT_SKIPPED;
+    }
+    else if (nregressions > 0) {
+      printf("\n%d regression(s) beyond the tolerance\n", nregressions);
+      exit_code = 1;
+    }
+  }
+
+  free(src);
+  free(chunk);
+  free(dest);
+  free(baseline);
+  free(results);
+  blosc2_destroy();
+
+  return exit_code;
+}
@@ -0,0 +1,187 @@
+/*********************************************************************
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Benchmark for the scaling of the compression and the decompression
+  with the number of threads.
+
+  The same chunk is compressed and decompressed with every codec for 1
+  up to N threads, and the speed of the best run is reported along with
+  the parallel efficiency (the speedup over 1 thread divided by the
+  threads).  Where the time of the threads goes comes from the statistics
+  of the contexts (blosc2_ctx_get_stats()), as a share of the time of all
+  the threads engaged (the threads times the wall time):
+
+    work    the filters, the codecs and the copies of the blocks
+    wakeup  from the start of a job until the threads begin to work on it
+    sched   taking the next block from the shared counter (or from other
+            threads) and the lock of the context at the end of the job
+    idle    waiting for the slowest thread at the end of the job
+    sync    the caller waiting after the slowest thread is done (barriers)
+
+  Usage: thread_scaling [max_nthreads] [codecs] [chunksize] [blocksize]
+
+  where codecs is a comma-separated list of codec names (by default, all
+  the ones in the build), the chunksize is 16 MB and the blocksize is
+  the automatic one (0) by default, and max_nthreads is the number of cores.
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "blosc2.h"
+#include "stune.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CHUNKSIZE (16 * 1024 * 1024)
+#define NRUNS 5
+#define MIN_RUN_BYTES (256 * 1024 * 1024)  /* the bytes processed in a run at least */
+
+static const char* all_codecs = "blosclz,lz4,lz4hc,zlib,zstd";
+
+
+typedef struct {
+  double secs;  /* the wall time of the best run */
+  blosc2_ctx_stats stats;  /* the statistics of that run */
+  int ncalls;
+} run_result;
+
+
+/* Time several runs of a few calls and keep the best one (and its statistics) */
+static int bench_run(blosc2_context* ctx, bool compress, const uint8_t* src, int32_t srcsize,
+                     uint8_t* dest, int32_t destsize, run_result* result) {
+  int ncalls = (int)(MIN_RUN_BYTES / (compress ? srcsize : destsize));
+  ncalls = ncalls > 0 ? ncalls : 1;
+  result->secs = -1;
+  result->ncalls = ncalls;
+  for (int run = 0; run < NRUNS; run++) {
+    blosc_timestamp_t start, end;
+    blosc2_ctx_reset_stats(ctx);
+    blosc_set_timestamp(&start);
+    for (int i = 0; i < ncalls; i++) {
+      int rc = compress ? blosc2_compress_ctx(ctx, src, srcsize, dest, destsize) :
+                          blosc2_decompress_ctx(ctx, src, srcsize, dest, destsize);
+      if (rc <= 0) {
+        printf("Error in the %s: %d\n", compress ? "compression" : "decompression", rc);
+        return rc < 0 ? rc : -1;
+      }
+    }
+    blosc_set_timestamp(&end);
+    double secs = blosc_elapsed_secs(start, end);
+    if (result->secs < 0 || secs < result->secs) {
+      result->secs = secs;
+      blosc2_ctx_get_stats(ctx, &result->stats);
+    }
+  }
+  return 0;
+}
+
+static void print_result(const char* codec, bool compress, int nthreads, int32_t nbytes,
+                         const run_result* result, double secs_1thread) {
+  const blosc2_ctx_stats* st = &result->stats;
+  double total_ns = result->secs * 1e9 * nthreads;
+  double work_ns = (double)(st->filters_ns + st->codec_ns + st->memcpy_ns + st->cipher_ns);
+  printf("%-8s %-10s %8d %10.2f %8.2f %8.1f%% %7.1f%% %7.1f%% %7.1f%% %7.1f%% %7.1f%%\n", codec,
+         compress ? "compress" : "decompress", nthreads,
+         (double)nbytes * result->ncalls / result->secs / 1e9,
+         secs_1thread / result->secs, 100. * secs_1thread / result->secs / nthreads,
+         100. * work_ns / total_ns, 100. * (double)st->wakeup_ns / total_ns,
+         100. * (double)st->sched_ns / total_ns, 100. * (double)st->idle_ns / total_ns,
+         100. * (double)st->sync_ns / total_ns);
+}
+
+
+int main(int argc, char* argv[]) {
+  int max_nthreads = 0;
+  const char* codecs = all_codecs;
+  int32_t chunksize = CHUNKSIZE;
+  int32_t blocksize = 0;
+  if (argc > 5 ||
+      (argc > 1 && (max_nthreads = (int)strtol(argv[1], NULL, 10)) <= 0) ||
+      (argc > 3 && (chunksize = (int32_t)strtol(argv[3], NULL, 10)) <= 0) ||
+      (argc > 4 && (blocksize = (int32_t)strtol(argv[4], NULL, 10)) < 0)) {
+    printf("Usage: thread_scaling [max_nthreads] [codecs] [chunksize] [blocksize]\n");
+    return 1;
+  }
+  if (argc > 2) {
+    codecs = argv[2];
+  }
+
+  blosc2_init();
+  if (max_nthreads == 0) {
+    max_nthreads = blosc_stune_cpu_info()->ncores;
+    max_nthreads = max_nthreads > 0 ? max_nthreads : 8;
+  }
+
+  // A ramp of int32 with some noise in the low bits, which compresses 3x or so
+  int32_t* src = malloc(chunksize);
+  uint8_t* chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  uint8_t* dest = malloc(chunksize);
+  uint32_t seed = 1;
+  for (int32_t i = 0; i < chunksize / 4; i++) {
+    seed = seed * 1103515245u + 12345u;
+    src[i] = i + (int32_t)(seed >> 22);
+  }
+
+  printf("Blosc version: %s (%s)\n", BLOSC2_VERSION_STRING, BLOSC2_VERSION_DATE);
+  printf("Chunksize: %d, blocksize: %d, threads: 1..%d\n\n", chunksize, blocksize, max_nthreads);
+  printf("%-8s %-10s %8s %10s %8s %9s %8s %8s %8s %8s %8s\n", "codec", "call", "nthreads", "GB/s",
+         "speedup", "effic.", "work", "wakeup", "sched", "idle", "sync");
+
+  int rc = 0;
+  char codec[32];
+  const char* next = codecs;
+  while (*next != '\0' && rc == 0) {
+    size_t len = strcspn(next, ",");
+    snprintf(codec, sizeof(codec), "%.*s", (int)len, next);
+    next += len + (next[len] == ',');
+    int compcode = blosc2_compname_to_compcode(codec);
+    if (compcode < 0) {
+      printf("%-8s not in this build\n", codec);
+      continue;
+    }
+
+    double csecs_1thread = 0, dsecs_1thread = 0;
+    for (int nthreads = 1; nthreads <= max_nthreads && rc == 0; nthreads++) {
+      blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+      cparams.compcode = (uint8_t)compcode;
+      cparams.typesize = sizeof(int32_t);
+      cparams.blocksize = blocksize;
+      cparams.nthreads = (int16_t)nthreads;
+      blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+      dparams.nthreads = (int16_t)nthreads;
+      blosc2_context* cctx = blosc2_create_cctx(cparams);
+      blosc2_context* dctx = blosc2_create_dctx(dparams);
+
+      run_result result;
+      rc = bench_run(cctx, true, (uint8_t*)src, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD, &result);
+      if (rc == 0) {
+        csecs_1thread = nthreads == 1 ? result.secs : csecs_1thread;
+        print_result(codec, true, nthreads, chunksize, &result, csecs_1thread);
+        int32_t cbytes = blosc2_compress_ctx(cctx, src, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+        rc = bench_run(dctx, false, chunk, cbytes, dest, chunksize, &result);
+      }
+      if (rc == 0) {
+        dsecs_1thread = nthreads == 1 ? result.secs : dsecs_1thread;
+        print_result(codec, false, nthreads, chunksize, &result, dsecs_1thread);
+        if (memcmp(src, dest, chunksize) != 0) {
+          printf("Wrong decompressed values for %s\n", codec);
+          rc = 1;
+        }
+      }
+
+      blosc2_free_ctx(cctx);
+      blosc2_free_ctx(dctx);
+    }
+  }
+
+  free(src);
+  free(chunk);
+  free(dest);
+  blosc2_destroy();
+
+  return rc == 0 ? 0 : 1;
+}
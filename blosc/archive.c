@@ -0,0 +1,424 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Archives of many named frames in a single file (see README_ARCHIVE_FORMAT.rst) */
+
+#include "frame.h"
+#include "blosc-private.h"
+#include "b2nd.h"
+#include "blosc2.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARCHIVE_MAGIC "b2archiv"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER_LEN 16
+#define ARCHIVE_TRAILER_LEN 24
+#define ARCHIVE_RECORD_LEN 24  // the fixed part of the records of the directory
+#define ARCHIVE_ALIGNMENT 8
+
+typedef struct {
+  char* name;
+  int64_t offset;
+  int64_t length;
+  int32_t typesize;
+  int8_t ndim;
+  int64_t shape[BLOSC2_MAX_DIM];
+} archive_entry;
+
+struct blosc2_archive_writer_s {
+  FILE* fp;
+  int64_t pos;              //!< The number of bytes written so far
+  archive_entry* entries;
+  int64_t nentries;
+  int64_t entries_cap;
+  int rc;                   //!< The first error of a write, which breaks the archive for good
+};
+
+struct blosc2_archive_s {
+  uint8_t* map;             //!< The whole file
+  int64_t len;
+  bool mapped;              //!< Whether `map` is a memory mapping (true) or a buffer of our own
+  int64_t index_pos;        //!< The position of the index of the directory
+  int64_t nentries;
+};
+
+
+static void archive_put64(uint8_t* dest, int64_t value) {
+  for (int i = 0; i < 8; i++) {
+    dest[i] = (uint8_t)((uint64_t)value >> (8 * i));
+  }
+}
+
+static int64_t archive_get64(const uint8_t* src) {
+  uint64_t value = 0;
+  for (int i = 0; i < 8; i++) {
+    value |= (uint64_t)src[i] << (8 * i);
+  }
+  return (int64_t)value;
+}
+
+static int archive_write(blosc2_archive_writer* writer, const void* data, int64_t size) {
+  if (writer->rc < 0) {
+    return writer->rc;
+  }
+  if (size > 0 && fwrite(data, 1, (size_t)size, writer->fp) != (size_t)size) {
+    BLOSC_TRACE_ERROR("Cannot write to the archive.");
+    writer->rc = BLOSC2_ERROR_FILE_WRITE;
+    return writer->rc;
+  }
+  writer->pos += size;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Pad with zeros up to the alignment of the frames and the records */
+static int archive_align(blosc2_archive_writer* writer) {
+  static const uint8_t zeros[ARCHIVE_ALIGNMENT] = {0};
+  int64_t padding = (ARCHIVE_ALIGNMENT - writer->pos % ARCHIVE_ALIGNMENT) % ARCHIVE_ALIGNMENT;
+  return archive_write(writer, zeros, padding);
+}
+
+
+blosc2_archive_writer* blosc2_archive_writer_new(const char* urlpath) {
+  FILE* fp = fopen(urlpath, "wb");
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Cannot create the archive %s.", urlpath);
+    return NULL;
+  }
+  blosc2_archive_writer* writer = calloc(1, sizeof(blosc2_archive_writer));
+  writer->fp = fp;
+  uint8_t header[ARCHIVE_HEADER_LEN] = {0};
+  memcpy(header, ARCHIVE_MAGIC, 8);
+  header[8] = ARCHIVE_VERSION;
+  if (archive_write(writer, header, ARCHIVE_HEADER_LEN) < 0) {
+    fclose(fp);
+    free(writer);
+    return NULL;
+  }
+  return writer;
+}
+
+
+/* The shape of b2nd arrays, or the number of items of plain super-chunks */
+static int archive_shape(blosc2_schunk* schunk, archive_entry* entry) {
+  entry->typesize = schunk->typesize;
+  if (blosc2_meta_exists(schunk, "b2nd") < 0) {
+    entry->ndim = 1;
+    entry->shape[0] = schunk->nbytes / (schunk->typesize > 0 ? schunk->typesize : 1);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t* smeta;
+  int32_t smeta_len;
+  if (blosc2_meta_get(schunk, "b2nd", &smeta, &smeta_len) < 0) {
+    return BLOSC2_ERROR_METALAYER_NOT_FOUND;
+  }
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  char* dtype = NULL;
+  int8_t dtype_format;
+  int rc = b2nd_deserialize_meta(smeta, smeta_len, &entry->ndim, entry->shape, chunkshape, blockshape,
+                                 &dtype, &dtype_format);
+  free(smeta);
+  free(dtype);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t blosc2_archive_writer_add_schunk(blosc2_archive_writer* writer, const char* name,
+                                         blosc2_schunk* schunk) {
+  if (writer->rc < 0) {
+    return writer->rc;
+  }
+  if (name == NULL || strlen(name) > UINT16_MAX - 1) {
+    BLOSC_TRACE_ERROR("The frames of archives need a name shorter than %d bytes.", UINT16_MAX);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  archive_entry entry = {0};
+  int rc = archive_shape(schunk, &entry);
+  if (rc < 0) {
+    return rc;
+  }
+  uint8_t* cframe;
+  bool needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  if (cframe_len < 0) {
+    return cframe_len;
+  }
+  rc = archive_align(writer);
+  entry.offset = writer->pos;
+  entry.length = cframe_len;
+  if (rc == 0) {
+    rc = archive_write(writer, cframe, cframe_len);
+  }
+  if (needs_free) {
+    free(cframe);
+  }
+  if (rc < 0) {
+    return rc;
+  }
+
+  if (writer->nentries == writer->entries_cap) {
+    writer->entries_cap = writer->entries_cap > 0 ? 2 * writer->entries_cap : 64;
+    writer->entries = realloc(writer->entries, writer->entries_cap * sizeof(archive_entry));
+  }
+  entry.name = strdup(name);
+  writer->entries[writer->nentries++] = entry;
+  return entry.offset;
+}
+
+
+static int compare_entries(const void* a, const void* b) {
+  return strcmp(((const archive_entry*)a)->name, ((const archive_entry*)b)->name);
+}
+
+int64_t blosc2_archive_writer_close(blosc2_archive_writer* writer) {
+  qsort(writer->entries, (size_t)writer->nentries, sizeof(archive_entry), compare_entries);
+  for (int64_t i = 1; i < writer->nentries && writer->rc == 0; i++) {
+    if (strcmp(writer->entries[i - 1].name, writer->entries[i].name) == 0) {
+      BLOSC_TRACE_ERROR("The name %s is repeated in the archive.", writer->entries[i].name);
+      writer->rc = BLOSC2_ERROR_INVALID_PARAM;
+    }
+  }
+
+  // The records, and then the index of their positions in the order of the names
+  int64_t* positions = malloc((writer->nentries > 0 ? writer->nentries : 1) * sizeof(int64_t));
+  uint8_t record[ARCHIVE_RECORD_LEN + 8 * BLOSC2_MAX_DIM];
+  for (int64_t i = 0; i < writer->nentries && writer->rc == 0; i++) {
+    archive_entry* entry = &writer->entries[i];
+    archive_align(writer);
+    positions[i] = writer->pos;
+    uint16_t namelen = (uint16_t)strlen(entry->name);
+    memset(record, 0, ARCHIVE_RECORD_LEN);
+    archive_put64(record, entry->offset);
+    archive_put64(record + 8, entry->length);
+    _sw32(record + 16, entry->typesize);
+    record[20] = (uint8_t)entry->ndim;
+    record[22] = (uint8_t)(namelen & 0xff);
+    record[23] = (uint8_t)(namelen >> 8);
+    for (int8_t dim = 0; dim < entry->ndim; dim++) {
+      archive_put64(record + ARCHIVE_RECORD_LEN + 8 * dim, entry->shape[dim]);
+    }
+    archive_write(writer, record, ARCHIVE_RECORD_LEN + 8 * entry->ndim);
+    archive_write(writer, entry->name, namelen + 1);
+  }
+  archive_align(writer);
+  int64_t index_pos = writer->pos;
+  uint8_t pos[8];
+  for (int64_t i = 0; i < writer->nentries && writer->rc == 0; i++) {
+    archive_put64(pos, positions[i]);
+    archive_write(writer, pos, 8);
+  }
+  free(positions);
+  uint8_t trailer[ARCHIVE_TRAILER_LEN];
+  archive_put64(trailer, index_pos);
+  archive_put64(trailer + 8, writer->nentries);
+  memcpy(trailer + 16, ARCHIVE_MAGIC, 8);
+  archive_write(writer, trailer, ARCHIVE_TRAILER_LEN);
+
+  if (fclose(writer->fp) != 0 && writer->rc == 0) {
+    BLOSC_TRACE_ERROR("Cannot close the archive.");
+    writer->rc = BLOSC2_ERROR_FILE_WRITE;
+  }
+  int64_t rc = writer->rc < 0 ? writer->rc : writer->nentries;
+  for (int64_t i = 0; i < writer->nentries; i++) {
+    free(writer->entries[i].name);
+  }
+  free(writer->entries);
+  free(writer);
+  return rc;
+}
+
+
+/* Map the whole file, or read it in one go where there are no mappings */
+static uint8_t* archive_map(const char* urlpath, int64_t* len, bool* mapped) {
+#if defined(_WIN32)
+  FILE* fp = fopen(urlpath, "rb");
+  if (fp == NULL) {
+    return NULL;
+  }
+  _fseeki64(fp, 0, SEEK_END);
+  *len = _ftelli64(fp);
+  _fseeki64(fp, 0, SEEK_SET);
+  uint8_t* map = *len > 0 ? malloc((size_t)*len) : NULL;
+  if (map != NULL && fread(map, 1, (size_t)*len, fp) != (size_t)*len) {
+    free(map);
+    map = NULL;
+  }
+  fclose(fp);
+  *mapped = false;
+  return map;
+#else
+  int fd = open(urlpath, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    close(fd);
+    return NULL;
+  }
+  *len = file_stat.st_size;
+  uint8_t* map = mmap(NULL, (size_t)*len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  *mapped = true;
+  return map == MAP_FAILED ? NULL : map;
+#endif
+}
+
+static void archive_unmap(uint8_t* map, int64_t len, bool mapped) {
+#if !defined(_WIN32)
+  if (mapped) {
+    munmap(map, (size_t)len);
+    return;
+  }
+#endif
+  BLOSC_UNUSED_PARAM(len);
+  BLOSC_UNUSED_PARAM(mapped);
+  free(map);
+}
+
+
+blosc2_archive* blosc2_archive_open(const char* urlpath) {
+  int64_t len;
+  bool mapped;
+  uint8_t* map = archive_map(urlpath, &len, &mapped);
+  if (map == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the archive %s.", urlpath);
+    return NULL;
+  }
+  int64_t index_pos = 0;
+  int64_t nentries = -1;
+  if (len >= ARCHIVE_HEADER_LEN + ARCHIVE_TRAILER_LEN && memcmp(map, ARCHIVE_MAGIC, 8) == 0 &&
+      map[8] == ARCHIVE_VERSION && memcmp(map + len - 8, ARCHIVE_MAGIC, 8) == 0) {
+    index_pos = archive_get64(map + len - ARCHIVE_TRAILER_LEN);
+    nentries = archive_get64(map + len - ARCHIVE_TRAILER_LEN + 8);
+  }
+  int64_t index_end = len - ARCHIVE_TRAILER_LEN;
+  if (index_pos < ARCHIVE_HEADER_LEN || index_pos > index_end || nentries < 0 ||
+      nentries > (index_end - index_pos) / 8) {
+    BLOSC_TRACE_ERROR("The file %s is not an archive.", urlpath);
+    archive_unmap(map, len, mapped);
+    return NULL;
+  }
+  blosc2_archive* archive = calloc(1, sizeof(blosc2_archive));
+  archive->map = map;
+  archive->len = len;
+  archive->mapped = mapped;
+  archive->index_pos = index_pos;
+  archive->nentries = nentries;
+  return archive;
+}
+
+
+int64_t blosc2_archive_nentries(const blosc2_archive* archive) {
+  return archive->nentries;
+}
+
+
+int blosc2_archive_get_entry(const blosc2_archive* archive, int64_t nentry, blosc2_archive_entry* entry) {
+  if (nentry < 0 || nentry >= archive->nentries) {
+    BLOSC_TRACE_ERROR("The archive does not have an entry %" PRId64 ".", nentry);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int64_t pos = archive_get64(archive->map + archive->index_pos + 8 * nentry);
+  if (pos < ARCHIVE_HEADER_LEN || pos > archive->index_pos - ARCHIVE_RECORD_LEN) {
+    BLOSC_TRACE_ERROR("The directory of the archive is corrupted.");
+    return BLOSC2_ERROR_DATA;
+  }
+  const uint8_t* record = archive->map + pos;
+  entry->offset = archive_get64(record);
+  entry->length = archive_get64(record + 8);
+  entry->typesize = sw32_(record + 16);
+  entry->ndim = (int8_t)record[20];
+  int64_t namelen = record[22] | (record[23] << 8);
+  int64_t name_pos = pos + ARCHIVE_RECORD_LEN + 8 * (int64_t)entry->ndim;
+  if (entry->ndim < 0 || entry->ndim > BLOSC2_MAX_DIM || name_pos + namelen >= archive->index_pos ||
+      archive->map[name_pos + namelen] != '\0' || entry->offset < ARCHIVE_HEADER_LEN || entry->length < 0 ||
+      entry->offset > archive->index_pos - entry->length) {
+    BLOSC_TRACE_ERROR("The directory of the archive is corrupted.");
+    return BLOSC2_ERROR_DATA;
+  }
+  for (int8_t dim = 0; dim < entry->ndim; dim++) {
+    entry->shape[dim] = archive_get64(record + ARCHIVE_RECORD_LEN + 8 * dim);
+  }
+  entry->name = (const char*)archive->map + name_pos;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t blosc2_archive_find(const blosc2_archive* archive, const char* name) {
+  int64_t lo = 0;
+  int64_t hi = archive->nentries;
+  blosc2_archive_entry entry;
+  while (lo < hi) {
+    int64_t mid = lo + (hi - lo) / 2;
+    int rc = blosc2_archive_get_entry(archive, mid, &entry);
+    if (rc < 0) {
+      return rc;
+    }
+    int cmp = strcmp(entry.name, name);
+    if (cmp == 0) {
+      return mid;
+    }
+    if (cmp < 0) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return BLOSC2_ERROR_NOT_FOUND;
+}
+
+
+blosc2_schunk* blosc2_archive_open_schunk(blosc2_archive* archive, const char* name) {
+  int64_t nentry = blosc2_archive_find(archive, name);
+  if (nentry < 0) {
+    BLOSC_TRACE_ERROR("The archive does not have a frame called %s.", name);
+    return NULL;
+  }
+  blosc2_archive_entry entry;
+  if (blosc2_archive_get_entry(archive, nentry, &entry) < 0) {
+    return NULL;
+  }
+  uint8_t* cframe = archive->map + entry.offset;
+  if (entry.length < FRAME_HEADER_MINLEN + FRAME_TRAILER_MINLEN ||
+      memcmp(cframe + FRAME_HEADER_MAGIC, "b2frame\0", 8) != 0) {
+    BLOSC_TRACE_ERROR("The frame %s of the archive is corrupted.", name);
+    return NULL;
+  }
+  blosc2_frame_s* frame = frame_from_cframe(cframe, entry.length, false);
+  if (frame == NULL) {
+    return NULL;
+  }
+  // The frame is borrowed from the mapping, which is shared by every super-chunk of the archive
+  frame->read_only = true;
+  return frame_to_schunk(frame, false, &BLOSC2_IO_DEFAULTS);
+}
+
+
+int blosc2_archive_close(blosc2_archive* archive) {
+  archive_unmap(archive->map, archive->len, archive->mapped);
+  free(archive);
+  return BLOSC2_ERROR_SUCCESS;
+}
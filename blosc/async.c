@@ -0,0 +1,210 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+
+  Asynchronous (de-)compression.  The work is queued in the shared pool
+  of threads when there is one, or run in a thread of its own otherwise.
+
+*********************************************************************/
+
+#include "blosc2.h"
+#include "threadpool.h"
+
+#if defined(_WIN32) && !defined(__GNUC__)
+#include "win32/pthread.h"
+#else
+#include <pthread.h>
+#endif
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+
+struct blosc2_future {
+  blosc2_context *context;
+  const void *src;
+  int32_t srcsize;
+  void *dest;
+  int32_t destsize;
+  bool compress;
+  blosc2_completion_cb callback;
+  void *user_data;
+  int result;
+  bool done;
+  bool own_thread;  /* whether the work runs in a thread of its own */
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t done_cv;
+  int fds[2];  /* pipe for the poll fd; -1 if not requested */
+};
+
+
+/* Notify the fd of a future (future mutex must be held) */
+static void notify_fd(blosc2_future *future) {
+#if !defined(_WIN32)
+  char byte = 1;
+  if (write(future->fds[1], &byte, 1) != 1) {
+    BLOSC_TRACE_WARNING("Cannot notify the completion of a future.");
+  }
+#endif
+}
+
+static void future_job(void *data) {
+  blosc2_future *future = (blosc2_future *)data;
+  int result;
+  if (future->compress) {
+    result = blosc2_compress_ctx(future->context, future->src, future->srcsize,
+                                 future->dest, future->destsize);
+  }
+  else {
+    result = blosc2_decompress_ctx(future->context, future->src, future->srcsize,
+                                   future->dest, future->destsize);
+  }
+  future->result = result;
+  if (future->callback != NULL) {
+    future->callback(future, result, future->user_data);
+  }
+
+  pthread_mutex_lock(&future->mutex);
+  future->done = true;
+  if (future->fds[1] >= 0) {
+    notify_fd(future);
+  }
+  pthread_cond_broadcast(&future->done_cv);
+  pthread_mutex_unlock(&future->mutex);
+}
+
+static void* future_thread(void *data) {
+  future_job(data);
+  return NULL;
+}
+
+
+static blosc2_future* submit_future(blosc2_context* context, const void* src, int32_t srcsize,
+                                    void* dest, int32_t destsize, bool compress,
+                                    blosc2_completion_cb callback, void *user_data) {
+  BLOSC_ERROR_NULL(context, NULL);
+  blosc2_future *future = (blosc2_future *)calloc(1, sizeof(blosc2_future));
+  BLOSC_ERROR_NULL(future, NULL);
+  future->context = context;
+  future->src = src;
+  future->srcsize = srcsize;
+  future->dest = dest;
+  future->destsize = destsize;
+  future->compress = compress;
+  future->callback = callback;
+  future->user_data = user_data;
+  future->fds[0] = future->fds[1] = -1;
+  pthread_mutex_init(&future->mutex, NULL);
+  pthread_cond_init(&future->done_cv, NULL);
+
+  if (blosc_pool_submit(future_job, future) == BLOSC2_ERROR_SUCCESS) {
+    return future;
+  }
+  future->own_thread = true;
+  int rc = pthread_create(&future->thread, NULL, future_thread, future);
+  if (rc) {
+    BLOSC_TRACE_ERROR("Return code from pthread_create() is %d.\n"
+                      "\tError detail: %s\n", rc, strerror(rc));
+    pthread_mutex_destroy(&future->mutex);
+    pthread_cond_destroy(&future->done_cv);
+    free(future);
+    return NULL;
+  }
+  return future;
+}
+
+
+blosc2_future* blosc2_compress_ctx_async(blosc2_context* context, const void* src, int32_t srcsize,
+                                         void* dest, int32_t destsize,
+                                         blosc2_completion_cb callback, void *user_data) {
+  return submit_future(context, src, srcsize, dest, destsize, true, callback, user_data);
+}
+
+
+blosc2_future* blosc2_decompress_ctx_async(blosc2_context* context, const void* src, int32_t srcsize,
+                                           void* dest, int32_t destsize,
+                                           blosc2_completion_cb callback, void *user_data) {
+  return submit_future(context, src, srcsize, dest, destsize, false, callback, user_data);
+}
+
+
+bool blosc2_future_test(blosc2_future *future, int *result) {
+  pthread_mutex_lock(&future->mutex);
+  bool done = future->done;
+  pthread_mutex_unlock(&future->mutex);
+  if (done && result != NULL) {
+    *result = future->result;
+  }
+  return done;
+}
+
+
+int blosc2_future_wait(blosc2_future *future) {
+  pthread_mutex_lock(&future->mutex);
+  while (!future->done) {
+    pthread_cond_wait(&future->done_cv, &future->mutex);
+  }
+  pthread_mutex_unlock(&future->mutex);
+  return future->result;
+}
+
+
+int blosc2_future_get_fd(blosc2_future *future) {
+#if defined(_WIN32)
+  BLOSC_TRACE_ERROR("Poll fds are not supported on Windows.");
+  return BLOSC2_ERROR_FAILURE;
+#else
+  pthread_mutex_lock(&future->mutex);
+  if (future->fds[0] < 0) {
+    if (pipe(future->fds) != 0) {
+      future->fds[0] = future->fds[1] = -1;
+      pthread_mutex_unlock(&future->mutex);
+      BLOSC_TRACE_ERROR("Cannot create the pipe for the future.");
+      return BLOSC2_ERROR_FAILURE;
+    }
+    fcntl(future->fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(future->fds[1], F_SETFD, FD_CLOEXEC);
+    if (future->done) {
+      notify_fd(future);
+    }
+  }
+  int fd = future->fds[0];
+  pthread_mutex_unlock(&future->mutex);
+  return fd;
+#endif
+}
+
+
+int blosc2_future_free(blosc2_future *future) {
+  if (future == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int result = blosc2_future_wait(future);
+  if (future->own_thread) {
+    pthread_join(future->thread, NULL);
+  }
+#if !defined(_WIN32)
+  if (future->fds[0] >= 0) {
+    close(future->fds[0]);
+    close(future->fds[1]);
+  }
+#endif
+  pthread_mutex_destroy(&future->mutex);
+  pthread_cond_destroy(&future->done_cv);
+  free(future);
+  return result;
+}
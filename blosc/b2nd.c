@@ -11,10 +11,16 @@
 #include "b2nd.h"
 #include "b2nd_utils.h"
 #include "context.h"
+#include "blosc-private.h"
+#include "blosc-atomic.h"
+#include "threadpool.h"
+#include "stune.h"
 #include "blosc2/blosc2-common.h"
+#include "blosc2/codecs-registry.h"
 #include "blosc2.h"
 
 #include <inttypes.h>
+#include <math.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
@@ -96,6 +102,26 @@ int b2nd_serialize_meta(int8_t ndim, const int64_t *shape, const int32_t *chunks
 }
 
 
+/* Serialize the b2nd metalayer of an array, with the order of its chunks when it is not the C one */
+static int32_t serialize_array_meta(const b2nd_array_t *array, uint8_t **smeta) {
+  int32_t smeta_len = b2nd_serialize_meta(array->ndim, array->shape, array->chunkshape, array->blockshape,
+                                          array->dtype, array->dtype_format, smeta);
+  if (smeta_len < 0 || array->chunk_order == B2ND_CHUNK_ORDER_C) {
+    return smeta_len;
+  }
+  // An 8th entry, which the readers that do not know about it skip
+  uint8_t *smeta_ = realloc(*smeta, (size_t) smeta_len + 1);
+  if (smeta_ == NULL) {
+    free(*smeta);
+    BLOSC_ERROR(BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  smeta_[0] = 0x90 + 8;
+  smeta_[smeta_len] = (uint8_t) array->chunk_order;  // positive fixnum (7-bit positive integer)
+  *smeta = smeta_;
+  return smeta_len + 1;
+}
+
+
 int update_shape(b2nd_array_t *array, int8_t ndim, const int64_t *shape,
                  const int32_t *chunkshape, const int32_t *blockshape) {
   array->ndim = ndim;
@@ -172,9 +198,7 @@ int update_shape(b2nd_array_t *array, int8_t ndim, const int64_t *shape,
   if (array->sc) {
     uint8_t *smeta = NULL;
     // Serialize the dimension info ...
-    int32_t smeta_len =
-            b2nd_serialize_meta(array->ndim, array->shape, array->chunkshape, array->blockshape,
-                                array->dtype, array->dtype_format, &smeta);
+    int32_t smeta_len = serialize_array_meta(array, &smeta);
     if (smeta_len < 0) {
       BLOSC_TRACE_ERROR("Error during serializing dims info for Blosc2 NDim");
       BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
@@ -217,6 +241,9 @@ int array_without_schunk(b2nd_context_t *ctx, b2nd_array_t **array) {
   }
 
   (*array)->dtype_format = ctx->dtype_format;
+  (*array)->write_cache = NULL;
+  (*array)->chunk_order = ctx->chunk_order;
+  (*array)->pyramid = NULL;
 
   // The partition cache (empty initially)
   (*array)->chunk_cache.data = NULL;
@@ -226,7 +253,8 @@ int array_without_schunk(b2nd_context_t *ctx, b2nd_array_t **array) {
 }
 
 
-int array_new(b2nd_context_t *ctx, int special_value, b2nd_array_t **array) {
+/* A new array with the chunks of `special_value`, which repeat `fill_value` for BLOSC2_SPECIAL_VALUE */
+int array_new(b2nd_context_t *ctx, int special_value, const void *fill_value, b2nd_array_t **array) {
   BLOSC_ERROR(array_without_schunk(ctx, array));
 
   blosc2_schunk *sc = blosc2_schunk_new(ctx->b2_storage);
@@ -241,13 +269,7 @@ int array_new(b2nd_context_t *ctx, int special_value, b2nd_array_t **array) {
     return BLOSC2_ERROR_FAILURE;
   }
   uint8_t *smeta = NULL;
-  int32_t smeta_len = b2nd_serialize_meta(ctx->ndim,
-                                          (*array)->shape,
-                                          (*array)->chunkshape,
-                                          (*array)->blockshape,
-                                          (*array)->dtype,
-                                          (*array)->dtype_format,
-                                          &smeta);
+  int32_t smeta_len = serialize_array_meta(*array, &smeta);
   if (smeta_len < 0) {
     BLOSC_TRACE_ERROR("error during serializing dims info for Blosc2 NDim");
     return BLOSC2_ERROR_FAILURE;
@@ -279,7 +301,12 @@ int array_new(b2nd_context_t *ctx, int special_value, b2nd_array_t **array) {
     int64_t nchunks = (*array)->extnitems / (*array)->chunknitems;
     int64_t nitems = nchunks * (*array)->extchunknitems;
     // blosc2_schunk_fill_special(sc, nitems, BLOSC2_SPECIAL_ZERO, chunksize);
-    BLOSC_ERROR(blosc2_schunk_fill_special(sc, nitems, special_value, chunksize));
+    if (special_value == BLOSC2_SPECIAL_VALUE) {
+      BLOSC_ERROR(blosc2_schunk_fill_repeatval(sc, nitems, fill_value, chunksize));
+    }
+    else {
+      BLOSC_ERROR(blosc2_schunk_fill_special(sc, nitems, special_value, chunksize));
+    }
   }
   (*array)->sc = sc;
 
@@ -291,7 +318,17 @@ int b2nd_uninit(b2nd_context_t *ctx, b2nd_array_t **array) {
   BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
-  BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_UNINIT, array));
+  BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_UNINIT, NULL, array));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_virtual(b2nd_context_t *ctx, b2nd_array_t **array) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+
+  BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_VIRTUAL, NULL, array));
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -301,9 +338,9 @@ int b2nd_empty(b2nd_context_t *ctx, b2nd_array_t **array) {
   BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
-  // BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_UNINIT, array));
+  // BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_UNINIT, NULL, array));
   // Avoid variable cratios
-  BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_ZERO, array));
+  BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_ZERO, NULL, array));
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -313,7 +350,7 @@ int b2nd_zeros(b2nd_context_t *ctx, b2nd_array_t **array) {
   BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
-  BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_ZERO, array));
+  BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_ZERO, NULL, array));
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -322,35 +359,580 @@ int b2nd_zeros(b2nd_context_t *ctx, b2nd_array_t **array) {
 int b2nd_full(b2nd_context_t *ctx, b2nd_array_t **array, const void *fill_value) {
   BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(fill_value, BLOSC2_ERROR_NULL_POINTER);
 
-  BLOSC_ERROR(b2nd_empty(ctx, array));
+  // All the chunks share a single one that repeats the value
+  BLOSC_ERROR(array_new(ctx, BLOSC2_SPECIAL_VALUE, fill_value, array));
 
-  int32_t chunkbytes = (int32_t) (*array)->extchunknitems * (*array)->sc->typesize;
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  blosc2_cparams *cparams;
-  if (blosc2_schunk_get_cparams((*array)->sc, &cparams) != 0) {
-    BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+
+// Pyramids of levels of lower resolution
+
+#define PYRAMID_VLMETA "b2nd_pyramid"
+#define PYRAMID_VERSION 1
+
+typedef struct {
+  int8_t reduction;
+  int nlevels;
+  int32_t factors[B2ND_MAX_DIM];
+  b2nd_array_t **levels;  // levels[k] is the level k + 1
+} pyramid;
+
+/* Reduce every window of `factors` items of src (in C order) to an item of dst */
+typedef void (*pyramid_kernel)(int8_t reduction, int8_t ndim, const int32_t *factors,
+                               const uint8_t *src, const int64_t *src_shape, uint8_t *dst, const int64_t *dst_shape);
+
+// The windows of the items at the edges of src are smaller than the rest
+#define PYRAMID_KERNEL(NAME, T, ROUND)                                                            \
+static void pyramid_kernel_##NAME(int8_t reduction, int8_t ndim, const int32_t *factors,          \
+                                  const uint8_t *src, const int64_t *src_shape, uint8_t *dst,     \
+                                  const int64_t *dst_shape) {                                     \
+  const T *src_ = (const T *) src;                                                                \
+  T *dst_ = (T *) dst;                                                                            \
+  int64_t strides[B2ND_MAX_DIM];                                                                  \
+  int64_t dst_nitems = 1;                                                                         \
+  strides[ndim - 1] = 1;                                                                          \
+  for (int i = ndim - 1; i >= 0; --i) {                                                           \
+    if (i < ndim - 1) {                                                                           \
+      strides[i] = strides[i + 1] * src_shape[i + 1];                                             \
+    }                                                                                             \
+    dst_nitems *= dst_shape[i];                                                                   \
+  }                                                                                               \
+  int64_t index[B2ND_MAX_DIM] = {0};                                                              \
+  for (int64_t n = 0; n < dst_nitems; ++n) {                                                      \
+    int64_t wshape[B2ND_MAX_DIM];                                                                 \
+    int64_t offset = 0;                                                                           \
+    int64_t count = 1;                                                                            \
+    for (int i = 0; i < ndim; ++i) {                                                              \
+      int64_t wstart = index[i] * factors[i];                                                     \
+      wshape[i] = src_shape[i] - wstart < factors[i] ? src_shape[i] - wstart : factors[i];        \
+      offset += wstart * strides[i];                                                              \
+      count *= wshape[i];                                                                         \
+    }                                                                                             \
+    double sum = 0;                                                                               \
+    T best = src_[offset];                                                                        \
+    int64_t w[B2ND_MAX_DIM] = {0};                                                                \
+    for (int64_t k = 0; k < count; ++k) {                                                         \
+      T x = src_[offset];                                                                         \
+      sum += (double) x;                                                                          \
+      best = x > best ? x : best;                                                                 \
+      for (int i = ndim - 1; i >= 0; --i) {                                                       \
+        offset += strides[i];                                                                     \
+        if (++w[i] < wshape[i]) {                                                                 \
+          break;                                                                                  \
+        }                                                                                         \
+        offset -= wshape[i] * strides[i];                                                         \
+        w[i] = 0;                                                                                 \
+      }                                                                                           \
+    }                                                                                             \
+    if (reduction == B2ND_PYRAMID_MEAN) {                                                         \
+      double value = sum / (double) count;                                                        \
+      dst_[n] = (T) (ROUND);                                                                      \
+    }                                                                                             \
+    else {                                                                                        \
+      dst_[n] = best;                                                                             \
+    }                                                                                             \
+    for (int i = ndim - 1; i >= 0; --i) {                                                         \
+      if (++index[i] < dst_shape[i]) {                                                            \
+        break;                                                                                    \
+      }                                                                                           \
+      index[i] = 0;                                                                               \
+    }                                                                                             \
+  }                                                                                               \
+}
+
+PYRAMID_KERNEL(f8, double, value)
+PYRAMID_KERNEL(f4, float, value)
+PYRAMID_KERNEL(i8, int64_t, round(value))
+PYRAMID_KERNEL(i4, int32_t, round(value))
+PYRAMID_KERNEL(i2, int16_t, round(value))
+PYRAMID_KERNEL(i1, int8_t, round(value))
+PYRAMID_KERNEL(u8, uint64_t, round(value))
+PYRAMID_KERNEL(u4, uint32_t, round(value))
+PYRAMID_KERNEL(u2, uint16_t, round(value))
+PYRAMID_KERNEL(u1, uint8_t, round(value))
+
+static int reduce_kind(const b2nd_array_t *array);
+
+/* The kernel reducing the items of an array, or NULL if they are not numbers */
+static pyramid_kernel get_pyramid_kernel(const b2nd_array_t *array) {
+  switch (reduce_kind(array)) {
+    case BLOSC2_ZONEMAP_FLOAT:
+      return array->sc->typesize == 8 ? pyramid_kernel_f8 : array->sc->typesize == 4 ? pyramid_kernel_f4 : NULL;
+    case BLOSC2_ZONEMAP_INT:
+      switch (array->sc->typesize) {
+        case 8: return pyramid_kernel_i8;
+        case 4: return pyramid_kernel_i4;
+        case 2: return pyramid_kernel_i2;
+        case 1: return pyramid_kernel_i1;
+        default: return NULL;
+      }
+    case BLOSC2_ZONEMAP_UINT:
+      switch (array->sc->typesize) {
+        case 8: return pyramid_kernel_u8;
+        case 4: return pyramid_kernel_u4;
+        case 2: return pyramid_kernel_u2;
+        case 1: return pyramid_kernel_u1;
+        default: return NULL;
+      }
+    default:
+      return NULL;
   }
+}
 
-  int32_t chunksize = BLOSC_EXTENDED_HEADER_LENGTH + (*array)->sc->typesize;
-  uint8_t *chunk = malloc(chunksize);
-  BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
-  if (blosc2_chunk_repeatval(*cparams, chunkbytes, chunk, chunksize, fill_value) < 0) {
-    BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+/* The nearest items are the first ones of the windows */
+static void pyramid_nearest(int8_t ndim, int32_t typesize, const int32_t *factors,
+                            const uint8_t *src, const int64_t *src_shape, uint8_t *dst, const int64_t *dst_shape) {
+  int64_t src_strides[B2ND_MAX_DIM];
+  int64_t dst_strides[B2ND_MAX_DIM];
+  src_strides[ndim - 1] = (int64_t) typesize * factors[ndim - 1];
+  dst_strides[ndim - 1] = typesize;
+  for (int i = ndim - 2; i >= 0; --i) {
+    src_strides[i] = src_strides[i + 1] / factors[i + 1] * src_shape[i + 1] * factors[i];
+    dst_strides[i] = dst_strides[i + 1] * dst_shape[i + 1];
   }
-  free(cparams);
+  b2nd_copy_buffer_strided(ndim, (uint8_t) typesize, dst_shape, src, src_strides, dst, dst_strides);
+}
 
-  for (int i = 0; i < (*array)->sc->nchunks; ++i) {
-    if (blosc2_schunk_update_chunk((*array)->sc, i, chunk, true) < 0) {
-      BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+
+/* Recompute the items in [start, stop) of the level `dst` from the level below it, one chunk of dst at a time */
+static int pyramid_update_level(const pyramid *pyr, b2nd_array_t *src, b2nd_array_t *dst,
+                                const int64_t *start, const int64_t *stop) {
+  int8_t ndim = dst->ndim;
+  int32_t typesize = dst->sc->typesize;
+  pyramid_kernel kernel = get_pyramid_kernel(dst);
+  int64_t first[B2ND_MAX_DIM];
+  int64_t ntiles[B2ND_MAX_DIM];
+  int64_t total = 1;
+  for (int i = 0; i < ndim; ++i) {
+    if (start[i] >= stop[i]) {
+      return BLOSC2_ERROR_SUCCESS;
+    }
+    first[i] = start[i] / dst->chunkshape[i];
+    ntiles[i] = (stop[i] - 1) / dst->chunkshape[i] + 1 - first[i];
+    total *= ntiles[i];
+  }
+
+  uint8_t *src_buffer = NULL;
+  uint8_t *dst_buffer = NULL;
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int64_t ntile = 0; ntile < total && rc >= 0; ++ntile) {
+    int64_t tile[B2ND_MAX_DIM];
+    blosc2_unidim_to_multidim(ndim, ntiles, ntile, tile);
+    int64_t tile_start[B2ND_MAX_DIM];
+    int64_t tile_stop[B2ND_MAX_DIM];
+    int64_t tile_shape[B2ND_MAX_DIM];
+    int64_t src_start[B2ND_MAX_DIM];
+    int64_t src_stop[B2ND_MAX_DIM];
+    int64_t src_shape[B2ND_MAX_DIM];
+    int64_t src_nitems = 1;
+    int64_t dst_nitems = 1;
+    for (int i = 0; i < ndim; ++i) {
+      tile_start[i] = (first[i] + tile[i]) * dst->chunkshape[i];
+      tile_stop[i] = tile_start[i] + dst->chunkshape[i];
+      tile_start[i] = tile_start[i] < start[i] ? start[i] : tile_start[i];
+      tile_stop[i] = tile_stop[i] > stop[i] ? stop[i] : tile_stop[i];
+      tile_shape[i] = tile_stop[i] - tile_start[i];
+      src_start[i] = tile_start[i] * pyr->factors[i];
+      src_stop[i] = tile_stop[i] * pyr->factors[i];
+      src_stop[i] = src_stop[i] > src->shape[i] ? src->shape[i] : src_stop[i];
+      src_shape[i] = src_stop[i] - src_start[i];
+      src_nitems *= src_shape[i];
+      dst_nitems *= tile_shape[i];
+    }
+    // The tiles are at most a chunk of dst, so the buffers for a whole one fit them all
+    if (src_buffer == NULL) {
+      int64_t max_nitems = 1;
+      int64_t window = 1;
+      for (int i = 0; i < ndim; ++i) {
+        max_nitems *= dst->chunkshape[i];
+        window *= pyr->factors[i];
+      }
+      src_buffer = malloc(max_nitems * window * typesize);
+      dst_buffer = malloc(max_nitems * typesize);
+      if (src_buffer == NULL || dst_buffer == NULL) {
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        break;
+      }
+    }
+    rc = b2nd_get_slice_cbuffer(src, src_start, src_stop, src_buffer, src_shape, src_nitems * typesize);
+    if (rc < 0) {
+      break;
+    }
+    if (pyr->reduction == B2ND_PYRAMID_NEAREST) {
+      pyramid_nearest(ndim, typesize, pyr->factors, src_buffer, src_shape, dst_buffer, tile_shape);
+    }
+    else {
+      kernel(pyr->reduction, ndim, pyr->factors, src_buffer, src_shape, dst_buffer, tile_shape);
+    }
+    rc = b2nd_set_slice_cbuffer(dst_buffer, tile_shape, dst_nitems * typesize, tile_start, tile_stop, dst);
+  }
+  free(src_buffer);
+  free(dst_buffer);
+  return rc;
+}
+
+
+/* Recompute the items of the levels of the pyramid of an array that depend on the items in
+ * [start, stop) of it, resizing the levels along with the array first */
+static int pyramid_update(b2nd_array_t *array, const int64_t *start, const int64_t *stop) {
+  pyramid *pyr = (pyramid *) array->pyramid;
+  if (pyr == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int8_t ndim = array->ndim;
+  int64_t level_start[B2ND_MAX_DIM];
+  int64_t level_stop[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    level_start[i] = start[i];
+    level_stop[i] = stop[i];
+  }
+  b2nd_array_t *src = array;
+  for (int level = 0; level < pyr->nlevels; ++level) {
+    b2nd_array_t *dst = pyr->levels[level];
+    int64_t shape[B2ND_MAX_DIM];
+    bool resize = false;
+    for (int i = 0; i < ndim; ++i) {
+      shape[i] = (src->shape[i] + pyr->factors[i] - 1) / pyr->factors[i];
+      resize |= shape[i] != dst->shape[i];
+      level_start[i] /= pyr->factors[i];
+      level_stop[i] = (level_stop[i] + pyr->factors[i] - 1) / pyr->factors[i];
+    }
+    if (resize) {
+      BLOSC_ERROR(b2nd_resize(dst, shape, NULL));
+    }
+    BLOSC_ERROR(pyramid_update_level(pyr, src, dst, level_start, level_stop));
+    src = dst;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Free the levels of the pyramid of an array (and their files if `remove`) */
+static void pyramid_free(b2nd_array_t *array, bool remove) {
+  pyramid *pyr = (pyramid *) array->pyramid;
+  if (pyr == NULL) {
+    return;
+  }
+  for (int level = 0; level < pyr->nlevels; ++level) {
+    if (pyr->levels[level] == NULL) {
+      continue;
+    }
+    char *urlpath = pyr->levels[level]->sc->storage->urlpath;
+    urlpath = remove && urlpath != NULL ? strdup(urlpath) : NULL;
+    b2nd_free(pyr->levels[level]);
+    if (urlpath != NULL) {
+      blosc2_remove_urlpath(urlpath);
+      free(urlpath);
+    }
+  }
+  free(pyr->levels);
+  free(pyr);
+  array->pyramid = NULL;
+}
+
+
+/* The urlpath of a level of the pyramid of an array on disk (NULL for arrays in memory) */
+static char *pyramid_level_urlpath(const b2nd_array_t *array, int level) {
+  const char *urlpath = array->sc->storage->urlpath;
+  if (urlpath == NULL) {
+    return NULL;
+  }
+  char *level_urlpath = malloc(strlen(urlpath) + 16);
+  if (level_urlpath != NULL) {
+    sprintf(level_urlpath, "%s.level%d", urlpath, level + 1);
+  }
+  return level_urlpath;
+}
+
+
+/* Open the levels of the pyramid of an array on disk, as told by its metalayer */
+static int pyramid_load(b2nd_array_t *array) {
+  if (array->sc->storage->urlpath == NULL || blosc2_vlmeta_exists(array->sc, PYRAMID_VLMETA) < 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t *content;
+  int32_t content_len;
+  BLOSC_ERROR(blosc2_vlmeta_get(array->sc, PYRAMID_VLMETA, &content, &content_len));
+  int8_t ndim = array->ndim;
+  if (content_len != 4 + 4 * ndim || content[0] != PYRAMID_VERSION || content[3] != ndim) {
+    free(content);
+    BLOSC_TRACE_ERROR("The metalayer of the pyramid does not go with the array");
+    return BLOSC2_ERROR_INVALID_HEADER;
+  }
+  pyramid *pyr = calloc(1, sizeof(pyramid));
+  BLOSC_ERROR_NULL(pyr, BLOSC2_ERROR_MEMORY_ALLOC);
+  pyr->reduction = (int8_t) content[1];
+  pyr->nlevels = content[2];
+  for (int i = 0; i < ndim; ++i) {
+    memcpy(&pyr->factors[i], content + 4 + 4 * i, sizeof(int32_t));
+    pyr->factors[i] = sw32_(&pyr->factors[i]);
+  }
+  free(content);
+  array->pyramid = pyr;
+  pyr->levels = calloc(pyr->nlevels, sizeof(b2nd_array_t *));
+  int rc = pyr->levels != NULL ? BLOSC2_ERROR_SUCCESS : BLOSC2_ERROR_MEMORY_ALLOC;
+  for (int level = 0; level < pyr->nlevels && rc >= 0; ++level) {
+    char *urlpath = pyramid_level_urlpath(array, level);
+    if (urlpath == NULL) {
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      break;
+    }
+    blosc2_schunk *sc = blosc2_schunk_open(urlpath);
+    free(urlpath);
+    rc = sc != NULL ? b2nd_from_schunk(sc, &pyr->levels[level]) : BLOSC2_ERROR_FILE_OPEN;
+  }
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot open the levels of the pyramid of the array");
+    pyramid_free(array, false);
+  }
+  return rc;
+}
+
+
+int b2nd_pyramid_new(b2nd_array_t *array, int nlevels, const int32_t *factors, int8_t reduction) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  int8_t ndim = array->ndim;
+  if (nlevels < 0 || nlevels > B2ND_PYRAMID_MAX_LEVELS || ndim == 0) {
+    BLOSC_TRACE_ERROR("The pyramids have up to %d levels, and are for arrays with some dimension",
+                      B2ND_PYRAMID_MAX_LEVELS);
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  if (nlevels > 0) {
+    BLOSC_ERROR_NULL(factors, BLOSC2_ERROR_NULL_POINTER);
+    bool reduced = false;
+    for (int i = 0; i < ndim; ++i) {
+      if (factors[i] < 1) {
+        BLOSC_TRACE_ERROR("The factors of a pyramid must be positive");
+        BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+      }
+      reduced |= factors[i] > 1;
+    }
+    if (!reduced) {
+      BLOSC_TRACE_ERROR("The levels of a pyramid must be reduced along some dimension");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+    bool reducible = (reduction == B2ND_PYRAMID_MEAN || reduction == B2ND_PYRAMID_MAX) &&
+                     get_pyramid_kernel(array) != NULL;
+    if (reduction != B2ND_PYRAMID_NEAREST && !reducible) {
+      BLOSC_TRACE_ERROR("The items of dtype %s cannot be reduced that way",
+                        array->dtype != NULL ? array->dtype : "(none)");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+  }
+
+  // A previous pyramid goes away
+  pyramid_free(array, true);
+  if (blosc2_vlmeta_exists(array->sc, PYRAMID_VLMETA) >= 0) {
+    BLOSC_ERROR(blosc2_vlmeta_delete(array->sc, PYRAMID_VLMETA));
+  }
+  if (nlevels == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  pyramid *pyr = calloc(1, sizeof(pyramid));
+  BLOSC_ERROR_NULL(pyr, BLOSC2_ERROR_MEMORY_ALLOC);
+  pyr->reduction = reduction;
+  pyr->nlevels = nlevels;
+  for (int i = 0; i < ndim; ++i) {
+    pyr->factors[i] = factors[i];
+  }
+  pyr->levels = calloc(nlevels, sizeof(b2nd_array_t *));
+  array->pyramid = pyr;
+  BLOSC_ERROR_NULL(pyr->levels, BLOSC2_ERROR_MEMORY_ALLOC);
+
+  // The levels are compressed like the array, and stored next to it
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  blosc2_cparams array_cparams;
+  blosc2_ctx_get_cparams(array->sc->cctx, &array_cparams);
+  cparams.compcode = array_cparams.compcode;
+  cparams.compcode_meta = array_cparams.compcode_meta;
+  cparams.clevel = array_cparams.clevel;
+  cparams.typesize = array_cparams.typesize;
+  cparams.splitmode = array_cparams.splitmode;
+  cparams.nthreads = array_cparams.nthreads;
+  memcpy(cparams.filters, array_cparams.filters, sizeof(cparams.filters));
+  memcpy(cparams.filters_meta, array_cparams.filters_meta, sizeof(cparams.filters_meta));
+  int rc = BLOSC2_ERROR_SUCCESS;
+  int64_t shape[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    shape[i] = array->shape[i];
+  }
+  for (int level = 0; level < nlevels && rc >= 0; ++level) {
+    int32_t chunkshape[B2ND_MAX_DIM];
+    int32_t blockshape[B2ND_MAX_DIM];
+    for (int i = 0; i < ndim; ++i) {
+      shape[i] = (shape[i] + factors[i] - 1) / factors[i];
+      chunkshape[i] = shape[i] > 0 && shape[i] < array->chunkshape[i] ? (int32_t) shape[i] : array->chunkshape[i];
+      blockshape[i] = array->blockshape[i] < chunkshape[i] ? array->blockshape[i] : chunkshape[i];
+    }
+    blosc2_storage storage = {.cparams=&cparams, .contiguous=array->sc->storage->contiguous};
+    storage.urlpath = pyramid_level_urlpath(array, level);
+    if (storage.urlpath != NULL) {
+      blosc2_remove_urlpath(storage.urlpath);
+    }
+    b2nd_context_t *ctx = b2nd_create_ctx(&storage, ndim, shape, chunkshape, blockshape,
+                                          array->dtype, array->dtype_format, NULL, 0);
+    rc = ctx != NULL ? b2nd_zeros(ctx, &pyr->levels[level]) : BLOSC2_ERROR_FAILURE;
+    if (ctx != NULL) {
+      b2nd_free_ctx(ctx);
     }
+    free(storage.urlpath);
   }
-  free(chunk);
+  if (rc >= 0) {
+    int64_t start[B2ND_MAX_DIM] = {0};
+    rc = pyramid_update(array, start, array->shape);
+  }
+  if (rc >= 0 && array->sc->storage->urlpath != NULL) {
+    // The levels are opened along with the array
+    uint8_t content[4 + 4 * B2ND_MAX_DIM];
+    content[0] = PYRAMID_VERSION;
+    content[1] = (uint8_t) reduction;
+    content[2] = (uint8_t) nlevels;
+    content[3] = (uint8_t) ndim;
+    for (int i = 0; i < ndim; ++i) {
+      int32_t factor = sw32_(&factors[i]);
+      memcpy(content + 4 + 4 * i, &factor, sizeof(int32_t));
+    }
+    rc = blosc2_vlmeta_add(array->sc, PYRAMID_VLMETA, content, 4 + 4 * ndim, NULL);
+  }
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot build the pyramid of the array");
+    pyramid_free(array, true);
+    return rc;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
 
+
+int b2nd_pyramid_nlevels(const b2nd_array_t *array) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  const pyramid *pyr = (const pyramid *) array->pyramid;
+  return pyr != NULL ? pyr->nlevels : 0;
+}
+
+
+int b2nd_pyramid_get_level(const b2nd_array_t *array, int level, b2nd_array_t **level_array) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(level_array, BLOSC2_ERROR_NULL_POINTER);
+  if (level < 0 || level > b2nd_pyramid_nlevels(array)) {
+    BLOSC_TRACE_ERROR("The array has no level %d", level);
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  *level_array = level == 0 ? (b2nd_array_t *) array : ((pyramid *) array->pyramid)->levels[level - 1];
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
+int b2nd_pyramid_get_slice_cbuffer(const b2nd_array_t *array, const int64_t *start, const int64_t *stop,
+                                   const int64_t *step, void *buffer, const int64_t *buffershape,
+                                   int64_t buffersize) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(step, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffershape, BLOSC2_ERROR_NULL_POINTER);
+  int8_t ndim = array->ndim;
+  const pyramid *pyr = (const pyramid *) array->pyramid;
+  for (int i = 0; i < ndim; ++i) {
+    if (step[i] < 1 || start[i] < 0 || stop[i] < start[i] || stop[i] > array->shape[i]) {
+      BLOSC_TRACE_ERROR("The slice is out of the array, or its steps are not positive");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+  }
+
+  // The coarsest level whose items are not further apart than the steps
+  int level = 0;
+  int64_t scale[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    scale[i] = 1;
+  }
+  while (pyr != NULL && level < pyr->nlevels) {
+    bool fits = true;
+    for (int i = 0; i < ndim; ++i) {
+      fits &= scale[i] * pyr->factors[i] <= step[i];
+    }
+    if (!fits) {
+      break;
+    }
+    for (int i = 0; i < ndim; ++i) {
+      scale[i] *= pyr->factors[i];
+    }
+    level++;
+  }
+  const b2nd_array_t *src = level == 0 ? array : pyr->levels[level - 1];
+
+  // The items go with the ones of the level in which they fall
+  int64_t level_start[B2ND_MAX_DIM];
+  int64_t level_stop[B2ND_MAX_DIM];
+  int64_t level_step[B2ND_MAX_DIM];
+  bool exact = true;
+  for (int i = 0; i < ndim; ++i) {
+    level_start[i] = start[i] / scale[i];
+    level_step[i] = step[i] / scale[i];
+    exact &= step[i] % scale[i] == 0;
+    int64_t nitems = (stop[i] - start[i] + step[i] - 1) / step[i];
+    level_stop[i] = nitems > 0 ? (start[i] + (nitems - 1) * step[i]) / scale[i] + 1 : level_start[i];
+  }
+  if (exact && ndim > 0) {
+    return b2nd_get_slice_cbuffer_step(src, level_start, level_stop, level_step, buffer, buffershape, buffersize);
+  }
+
+  // Else the bounding box of the items in the level is read, and the items gathered from it
+  int32_t typesize = array->sc->typesize;
+  int64_t box_shape[B2ND_MAX_DIM];
+  int64_t box_nitems = 1;
+  int64_t nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    box_shape[i] = level_stop[i] - level_start[i];
+    box_nitems *= box_shape[i];
+    int64_t n = (stop[i] - start[i] + step[i] - 1) / step[i];
+    if (n > buffershape[i]) {
+      BLOSC_TRACE_ERROR("The buffer shape can not be smaller than the slice shape");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+    nitems *= buffershape[i];
+  }
+  if (buffersize < nitems * typesize) {
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  if (box_nitems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t *box = malloc(box_nitems * typesize);
+  BLOSC_ERROR_NULL(box, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = b2nd_get_slice_cbuffer(src, level_start, level_stop, box, box_shape, box_nitems * typesize);
+  if (rc >= 0) {
+    int64_t out_shape[B2ND_MAX_DIM];
+    int64_t out_nitems = 1;
+    for (int i = 0; i < ndim; ++i) {
+      out_shape[i] = (stop[i] - start[i] + step[i] - 1) / step[i];
+      out_nitems *= out_shape[i];
+    }
+    int64_t index[B2ND_MAX_DIM] = {0};
+    for (int64_t n = 0; n < out_nitems; ++n) {
+      int64_t box_offset = 0;
+      int64_t out_offset = 0;
+      for (int i = 0; i < ndim; ++i) {
+        box_offset = box_offset * box_shape[i] + (start[i] + index[i] * step[i]) / scale[i] - level_start[i];
+        out_offset = out_offset * buffershape[i] + index[i];
+      }
+      memcpy((uint8_t *) buffer + out_offset * typesize, box + box_offset * typesize, typesize);
+      for (int i = ndim - 1; i >= 0; --i) {
+        if (++index[i] < out_shape[i]) {
+          break;
+        }
+        index[i] = 0;
+      }
+    }
+  }
+  free(box);
+  return rc;
+}
+
+
 int b2nd_from_schunk(blosc2_schunk *schunk, b2nd_array_t **array) {
   BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
@@ -379,9 +961,16 @@ int b2nd_from_schunk(blosc2_schunk *schunk, b2nd_array_t **array) {
       BLOSC_ERROR(BLOSC2_ERROR_METALAYER_NOT_FOUND);
     }
   }
-  BLOSC_ERROR(b2nd_deserialize_meta(smeta, smeta_len, &params.ndim, params.shape,
-                                    params.chunkshape, params.blockshape, &params.dtype,
-                                    &params.dtype_format));
+  int slen = b2nd_deserialize_meta(smeta, smeta_len, &params.ndim, params.shape,
+                                   params.chunkshape, params.blockshape, &params.dtype,
+                                   &params.dtype_format);
+  if (slen < 0) {
+    free(smeta);
+    BLOSC_ERROR(slen);
+  }
+  if (smeta[0] == 0x90 + 8 && slen < smeta_len) {
+    params.chunk_order = (int8_t) smeta[slen];
+  }
   free(smeta);
 
   BLOSC_ERROR(array_without_schunk(&params, array));
@@ -393,6 +982,10 @@ int b2nd_from_schunk(blosc2_schunk *schunk, b2nd_array_t **array) {
     BLOSC_TRACE_ERROR("Error creating a b2nd container from a frame");
     return BLOSC2_ERROR_NULL_POINTER;
   }
+  // The array is usable without its pyramid
+  if (pyramid_load(*array) < 0) {
+    BLOSC_TRACE_WARNING("Cannot open the pyramid of the array; going without it");
+  }
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -405,6 +998,9 @@ int b2nd_to_cframe(const b2nd_array_t *array, uint8_t **cframe, int64_t *cframe_
   BLOSC_ERROR_NULL(cframe_len, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(needs_free, BLOSC2_ERROR_NULL_POINTER);
 
+  // The chunks in the write cache have to be in the super-chunk
+  BLOSC_ERROR(b2nd_flush((b2nd_array_t *) array));
+
   *cframe_len = blosc2_schunk_to_buffer(array->sc, cframe, needs_free);
   if (*cframe_len <= 0) {
     BLOSC_TRACE_ERROR("Error serializing the b2nd array");
@@ -456,17 +1052,62 @@ int b2nd_open_offset(const char *urlpath, b2nd_array_t **array, int64_t offset)
 }
 
 
+int b2nd_open_udio(const char *urlpath, b2nd_array_t **array, const blosc2_io *udio) {
+  BLOSC_ERROR_NULL(urlpath, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(udio, BLOSC2_ERROR_NULL_POINTER);
+
+  blosc2_schunk *sc = blosc2_schunk_open_udio(urlpath, udio);
+
+  // ...and create a b2nd array out of it
+  BLOSC_ERROR(b2nd_from_schunk(sc, array));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_archive_add(blosc2_archive_writer *writer, const char *name, const b2nd_array_t *array) {
+  BLOSC_ERROR_NULL(writer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+
+  int64_t offset = blosc2_archive_writer_add_schunk(writer, name, array->sc);
+  return offset < 0 ? (int) offset : BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_archive_open(blosc2_archive *archive, const char *name, b2nd_array_t **array) {
+  BLOSC_ERROR_NULL(archive, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+
+  blosc2_schunk *sc = blosc2_archive_open_schunk(archive, name);
+  if (sc == NULL) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  int rc = b2nd_from_schunk(sc, array);
+  if (rc < 0) {
+    blosc2_schunk_free(sc);
+  }
+  return rc;
+}
+
+
 int b2nd_free(b2nd_array_t *array) {
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
+  int rc = BLOSC2_ERROR_SUCCESS;
   if (array) {
+    if (array->write_cache != NULL) {
+      // The cache is gone even if the chunks cannot be written back
+      rc = b2nd_set_write_cache(array, 0);
+    }
+    pyramid_free(array, false);
     if (array->sc != NULL) {
       blosc2_schunk_free(array->sc);
     }
     free(array->dtype);
     free(array);
   }
-  return BLOSC2_ERROR_SUCCESS;
+  return rc;
 }
 
 
@@ -516,66 +1157,406 @@ int b2nd_to_cbuffer(const b2nd_array_t *array, void *buffer,
 }
 
 
-// Setting and getting slices
-int get_set_slice(void *buffer, int64_t buffersize, const int64_t *start, const int64_t *stop,
-                  const int64_t *shape, b2nd_array_t *array, bool set_slice) {
-  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-  if (buffersize < 0) {
-    BLOSC_TRACE_ERROR("buffersize is < 0");
-    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
-  }
+// The orders of the chunks along space-filling curves
 
-  uint8_t *buffer_b = (uint8_t *) buffer;
-  const int64_t *buffer_start = start;
-  const int64_t *buffer_stop = stop;
-  const int64_t *buffer_shape = shape;
+/* A chunk, with its coordinates in the grid of chunks (transformed for the curve of the order) */
+typedef struct {
+  int64_t index;
+  int8_t ndim;
+  uint64_t coords[B2ND_MAX_DIM];
+} curve_point;
 
-  int8_t ndim = array->ndim;
 
-  // 0-dim case
-  if (ndim == 0) {
-    if (set_slice) {
-      int32_t chunk_size = array->sc->typesize + BLOSC2_MAX_OVERHEAD;
-      uint8_t *chunk = malloc(chunk_size);
-      BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
-      if (blosc2_compress_ctx(array->sc->cctx, buffer_b, array->sc->typesize, chunk, chunk_size) < 0) {
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-      }
-      if (blosc2_schunk_update_chunk(array->sc, 0, chunk, false) < 0) {
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-      }
+/* Whether the most significant bit set in x is below the one set in y */
+static bool less_msb(uint64_t x, uint64_t y) {
+  return x < y && x < (x ^ y);
+}
 
-    } else {
-      if (blosc2_schunk_decompress_chunk(array->sc, 0, buffer_b, array->sc->typesize) < 0) {
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-      }
+/* In the order of the bits of the coordinates interleaved, the first dimension going first */
+static int compare_curve_points(const void *a, const void *b) {
+  const curve_point *point_a = (const curve_point *) a;
+  const curve_point *point_b = (const curve_point *) b;
+  int msd = 0;
+  for (int i = 1; i < point_a->ndim; ++i) {
+    if (less_msb(point_a->coords[msd] ^ point_b->coords[msd], point_a->coords[i] ^ point_b->coords[i])) {
+      msd = i;
     }
-    return BLOSC2_ERROR_SUCCESS;
   }
+  return (point_a->coords[msd] > point_b->coords[msd]) - (point_a->coords[msd] < point_b->coords[msd]);
+}
 
-  int32_t data_nbytes = (int32_t) array->extchunknitems * array->sc->typesize;
-  uint8_t *data = malloc(data_nbytes);
-  BLOSC_ERROR_NULL(data, BLOSC2_ERROR_MEMORY_ALLOC);
-
-  int64_t chunks_in_array[B2ND_MAX_DIM] = {0};
-  for (int i = 0; i < ndim; ++i) {
-    chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
+/* Transform the coordinates into the transposed index of the Hilbert curve (J. Skilling, 2004),
+   whose bits interleaved give the position along the curve */
+static void hilbert_transpose(uint64_t *x, int8_t ndim, int nbits) {
+  uint64_t m = (uint64_t) 1 << (nbits - 1);
+  for (uint64_t q = m; q > 1; q >>= 1) {
+    uint64_t p = q - 1;
+    for (int i = 0; i < ndim; ++i) {
+      if (x[i] & q) {
+        x[0] ^= p;
+      }
+      else {
+        uint64_t t = (x[0] ^ x[i]) & p;
+        x[0] ^= t;
+        x[i] ^= t;
+      }
+    }
   }
-
+  for (int i = 1; i < ndim; ++i) {
+    x[i] ^= x[i - 1];
+  }
+  uint64_t t = 0;
+  for (uint64_t q = m; q > 1; q >>= 1) {
+    if (x[ndim - 1] & q) {
+      t ^= q - 1;
+    }
+  }
+  for (int i = 0; i < ndim; ++i) {
+    x[i] ^= t;
+  }
+}
+
+/* Sort chunks in the order of the array.  The positions of the chunks (in nchunks) go to order. */
+static int order_chunks(const b2nd_array_t *array, int64_t n, const int64_t *nchunks, int64_t *order) {
+  curve_point *points = malloc(n * sizeof(curve_point));
+  BLOSC_ERROR_NULL(points, BLOSC2_ERROR_MEMORY_ALLOC);
+  int64_t chunks_in_array[B2ND_MAX_DIM];
+  int nbits = 1;
+  for (int i = 0; i < array->ndim; ++i) {
+    chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
+    while (nbits < 63 && ((int64_t) 1 << nbits) < chunks_in_array[i]) {
+      nbits++;
+    }
+  }
+  for (int64_t j = 0; j < n; ++j) {
+    int64_t coords[B2ND_MAX_DIM];
+    blosc2_unidim_to_multidim(array->ndim, chunks_in_array, nchunks[j], coords);
+    points[j].index = j;
+    points[j].ndim = array->ndim;
+    for (int i = 0; i < array->ndim; ++i) {
+      points[j].coords[i] = (uint64_t) coords[i];
+    }
+    if (array->chunk_order == B2ND_CHUNK_ORDER_HILBERT) {
+      hilbert_transpose(points[j].coords, array->ndim, nbits);
+    }
+  }
+  qsort(points, n, sizeof(curve_point), compare_curve_points);
+  for (int64_t j = 0; j < n; ++j) {
+    order[j] = points[j].index;
+  }
+  free(points);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Whether the chunks of an array go in other than the C order */
+static bool curve_order(const b2nd_array_t *array) {
+  return array->chunk_order != B2ND_CHUNK_ORDER_C && array->ndim > 1;
+}
+
+
+int b2nd_reorder_chunks(b2nd_array_t *array) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(b2nd_flush(array));
+  blosc2_schunk *sc = array->sc;
+  if (sc->frame == NULL || !sc->storage->contiguous || sc->nchunks == 0) {
+    // The chunks are not one after the other anyway
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  int64_t *nchunks = malloc(sc->nchunks * sizeof(int64_t));
+  int64_t *order = malloc(sc->nchunks * sizeof(int64_t));
+  if (nchunks == NULL || order == NULL) {
+    free(nchunks);
+    free(order);
+    BLOSC_ERROR(BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  for (int64_t nchunk = 0; nchunk < sc->nchunks; ++nchunk) {
+    nchunks[nchunk] = nchunk;
+  }
+  int rc = BLOSC2_ERROR_SUCCESS;
+  if (curve_order(array)) {
+    rc = order_chunks(array, sc->nchunks, nchunks, order);
+  }
+  else {
+    memcpy(order, nchunks, sc->nchunks * sizeof(int64_t));
+  }
+
+  // Every chunk goes to the end of the frame in turn, and the old slots are reclaimed afterwards
+  for (int64_t j = 0; rc >= 0 && j < sc->nchunks; ++j) {
+    int64_t nchunk = order[j];
+    blosc2_chunk_info info;
+    rc = blosc2_schunk_get_chunk_info(sc, nchunk, &info);
+    if (rc < 0 || info.special != BLOSC2_NO_SPECIAL) {
+      // Nothing is stored for the special chunks
+      continue;
+    }
+    uint8_t *chunk;
+    bool needs_free;
+    int cbytes = blosc2_schunk_get_chunk(sc, nchunk, &chunk, &needs_free);
+    if (cbytes < 0) {
+      rc = cbytes;
+      break;
+    }
+    // A copy, as the chunk may be in the frame being written
+    uint8_t *copy = malloc(cbytes);
+    if (copy == NULL) {
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    else {
+      memcpy(copy, chunk, cbytes);
+    }
+    if (needs_free) {
+      free(chunk);
+    }
+    if (copy == NULL) {
+      break;
+    }
+    // The chunk is let go first, as otherwise it would go back into its own slot
+    int32_t nbytes;
+    uint8_t uninit[BLOSC_EXTENDED_HEADER_LENGTH];
+    rc = blosc2_cbuffer_sizes(copy, &nbytes, NULL, NULL);
+    if (rc >= 0) {
+      rc = blosc2_chunk_uninit(*sc->storage->cparams, nbytes, uninit, BLOSC_EXTENDED_HEADER_LENGTH);
+    }
+    int64_t rc_ = rc < 0 ? rc : blosc2_schunk_update_chunk(sc, nchunk, uninit, true);
+    if (rc_ >= 0) {
+      rc_ = blosc2_schunk_update_chunk(sc, nchunk, copy, false);
+    }
+    else {
+      free(copy);
+    }
+    rc = rc_ < 0 ? (int) rc_ : BLOSC2_ERROR_SUCCESS;
+  }
+  free(nchunks);
+  free(order);
+  BLOSC_ERROR(rc);
+
+  int64_t reclaimed = blosc2_schunk_compact(sc, true);
+  BLOSC_ERROR(reclaimed < 0 ? (int) reclaimed : BLOSC2_ERROR_SUCCESS);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+// The write-back cache of dirty chunks
+
+/* A decompressed chunk that has been set, but not written back yet */
+typedef struct {
+  int64_t nchunk;
+  uint8_t *data;
+  int64_t last_use;
+} write_cache_entry;
+
+/* The write-back cache of an array (see b2nd_set_write_cache()) */
+typedef struct {
+  int max_entries;
+  int nentries;
+  int nalloc;  // the entries taken so far
+  int64_t nuses;
+  write_cache_entry *entries;
+} write_cache;
+
+
+/* Compress a dirty chunk and write it to the super-chunk */
+static int write_back(b2nd_array_t *array, write_cache_entry *entry) {
+  int32_t data_nbytes = (int32_t) array->extchunknitems * array->sc->typesize;
+  int32_t chunk_nbytes = data_nbytes + BLOSC2_MAX_OVERHEAD;
+  uint8_t *chunk = malloc(chunk_nbytes);
+  BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = blosc2_compress_ctx(array->sc->cctx, entry->data, data_nbytes, chunk, chunk_nbytes);
+  if (rc < 0) {
+    free(chunk);
+    BLOSC_TRACE_ERROR("Blosc can not compress the data");
+    return rc;
+  }
+  int64_t nchunks = blosc2_schunk_update_chunk(array->sc, entry->nchunk, chunk, false);
+  if (nchunks < 0) {
+    BLOSC_TRACE_ERROR("Blosc can not update the chunk");
+    return (int) nchunks;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+static int compare_entries(const void *a, const void *b) {
+  int64_t nchunk_a = ((const write_cache_entry *) a)->nchunk;
+  int64_t nchunk_b = ((const write_cache_entry *) b)->nchunk;
+  return (nchunk_a > nchunk_b) - (nchunk_a < nchunk_b);
+}
+
+
+/* Sort the entries in the order of the array along its curve */
+static int sort_entries(const b2nd_array_t *array, write_cache *cache) {
+  int64_t *nchunks = malloc(cache->nentries * sizeof(int64_t));
+  int64_t *order = malloc(cache->nentries * sizeof(int64_t));
+  write_cache_entry *entries = malloc(cache->nentries * sizeof(write_cache_entry));
+  int rc = nchunks == NULL || order == NULL || entries == NULL ? BLOSC2_ERROR_MEMORY_ALLOC : BLOSC2_ERROR_SUCCESS;
+  for (int i = 0; rc == BLOSC2_ERROR_SUCCESS && i < cache->nentries; i++) {
+    nchunks[i] = cache->entries[i].nchunk;
+  }
+  if (rc == BLOSC2_ERROR_SUCCESS) {
+    rc = order_chunks(array, cache->nentries, nchunks, order);
+  }
+  if (rc == BLOSC2_ERROR_SUCCESS) {
+    for (int i = 0; i < cache->nentries; i++) {
+      entries[i] = cache->entries[order[i]];
+    }
+    memcpy(cache->entries, entries, cache->nentries * sizeof(write_cache_entry));
+  }
+  free(nchunks);
+  free(order);
+  free(entries);
+  return rc;
+}
+
+
+int b2nd_flush(b2nd_array_t *array) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  write_cache *cache = (write_cache *) array->write_cache;
+  if (cache == NULL || cache->nentries == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // In the order of the chunks, which is the one of the frame too
+  qsort(cache->entries, cache->nentries, sizeof(write_cache_entry), compare_entries);
+  if (curve_order(array)) {
+    BLOSC_ERROR(sort_entries(array, cache));
+  }
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int i = 0; i < cache->nentries; i++) {
+    if (rc == BLOSC2_ERROR_SUCCESS) {
+      rc = write_back(array, &cache->entries[i]);
+    }
+    free(cache->entries[i].data);
+  }
+  cache->nentries = 0;
+  return rc;
+}
+
+
+int b2nd_set_write_cache(b2nd_array_t *array, int64_t max_nbytes) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  if (max_nbytes < 0) {
+    BLOSC_TRACE_ERROR("The size of the write cache cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int64_t data_nbytes = array->extchunknitems * array->sc->typesize;
+  if (max_nbytes > 0 && max_nbytes < data_nbytes) {
+    BLOSC_TRACE_ERROR("The write cache has to hold a chunk (%" PRId64 " bytes) at least.", data_nbytes);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int rc = b2nd_flush(array);
+  write_cache *cache = (write_cache *) array->write_cache;
+  if (cache != NULL) {
+    free(cache->entries);
+    free(cache);
+    array->write_cache = NULL;
+  }
+  if (rc < 0 || max_nbytes == 0) {
+    return rc;
+  }
+
+  cache = calloc(1, sizeof(write_cache));
+  BLOSC_ERROR_NULL(cache, BLOSC2_ERROR_MEMORY_ALLOC);
+  int64_t max_entries = max_nbytes / data_nbytes;
+  // The entries are taken as needed, as the cache may be much larger than the array
+  cache->max_entries = max_entries > INT32_MAX ? INT32_MAX : (int) max_entries;
+  array->write_cache = cache;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* The dirty chunk `nchunk` in the write cache (NULL if not there) */
+static uint8_t *write_cache_find(b2nd_array_t *array, int64_t nchunk) {
+  write_cache *cache = (write_cache *) array->write_cache;
+  if (cache == NULL) {
+    return NULL;
+  }
+  for (int i = 0; i < cache->nentries; i++) {
+    if (cache->entries[i].nchunk == nchunk) {
+      cache->entries[i].last_use = cache->nuses++;
+      return cache->entries[i].data;
+    }
+  }
+  return NULL;
+}
+
+
+/* Make room for a new chunk in the write cache, writing back the least recently used one if full */
+static write_cache_entry *write_cache_new_entry(b2nd_array_t *array) {
+  write_cache *cache = (write_cache *) array->write_cache;
+  if (cache->nentries == cache->max_entries) {
+    int lru = 0;
+    for (int i = 1; i < cache->nentries; i++) {
+      if (cache->entries[i].last_use < cache->entries[lru].last_use) {
+        lru = i;
+      }
+    }
+    write_cache_entry *entry = &cache->entries[lru];
+    int rc = write_back(array, entry);
+    free(entry->data);
+    *entry = cache->entries[--cache->nentries];
+    if (rc < 0) {
+      return NULL;
+    }
+  }
+  else if (cache->nentries == cache->nalloc) {
+    int nalloc = cache->nalloc > 0 ? 2 * cache->nalloc : 16;
+    if (nalloc > cache->max_entries) {
+      nalloc = cache->max_entries;
+    }
+    write_cache_entry *entries = realloc(cache->entries, nalloc * sizeof(write_cache_entry));
+    if (entries == NULL) {
+      BLOSC_TRACE_ERROR("Cannot grow the write cache.");
+      return NULL;
+    }
+    cache->entries = entries;
+    cache->nalloc = nalloc;
+  }
+  write_cache_entry *entry = &cache->entries[cache->nentries];
+  memset(entry, 0, sizeof(write_cache_entry));
+  return entry;
+}
+
+
+// Setting and getting slices
+
+/* A chunk of an array that intersects a slice */
+typedef struct {
+  int64_t nchunk;
+  int64_t start[B2ND_MAX_DIM];  // where the chunk starts in the array
+  int64_t stop[B2ND_MAX_DIM];  // where the chunk stops (within the shape of the array)
+} slice_chunk;
+
+/* A slice being set or got, and the chunks that it intersects */
+typedef struct {
+  b2nd_array_t *array;
+  uint8_t *buffer;
+  const int64_t *start;
+  const int64_t *stop;
+  const int64_t *shape;
+  const int64_t *strides;  // the strides (in bytes) of the buffer, when it is not C-ordered in shape
+  const int64_t *steps;  // the distance between the items got along every dimension (NULL for 1)
+  bool set_slice;
+  bool append;  // the chunks are new, and go at the end of the super-chunk
+  int64_t nchunks;
+  slice_chunk *chunks;
+} slice_job_data;
+
+
+/* Fill the chunks that intersect the slice.  Returns the number of them. */
+static int64_t get_slice_chunks(b2nd_array_t *array, const int64_t *start, const int64_t *stop,
+                                slice_chunk **chunks) {
+  int8_t ndim = array->ndim;
+  int64_t chunks_in_array[B2ND_MAX_DIM] = {0};
+  for (int i = 0; i < ndim; ++i) {
+    chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
+  }
+
   int64_t chunks_in_array_strides[B2ND_MAX_DIM];
   chunks_in_array_strides[ndim - 1] = 1;
   for (int i = ndim - 2; i >= 0; --i) {
     chunks_in_array_strides[i] = chunks_in_array_strides[i + 1] * chunks_in_array[i + 1];
   }
 
-  int64_t blocks_in_chunk[B2ND_MAX_DIM] = {0};
-  for (int i = 0; i < ndim; ++i) {
-    blocks_in_chunk[i] = array->extchunkshape[i] / array->blockshape[i];
-  }
-
   // Compute the number of chunks to update
   int64_t update_start[B2ND_MAX_DIM];
   int64_t update_shape[B2ND_MAX_DIM];
@@ -583,914 +1564,2618 @@ int get_set_slice(void *buffer, int64_t buffersize, const int64_t *start, const
   int64_t update_nchunks = 1;
   for (int i = 0; i < ndim; ++i) {
     int64_t pos = 0;
-    while (pos <= buffer_start[i]) {
+    while (pos <= start[i]) {
       pos += array->chunkshape[i];
     }
     update_start[i] = pos / array->chunkshape[i] - 1;
-    while (pos < buffer_stop[i]) {
+    while (pos < stop[i]) {
       pos += array->chunkshape[i];
     }
     update_shape[i] = pos / array->chunkshape[i] - update_start[i];
     update_nchunks *= update_shape[i];
   }
 
-  for (int update_nchunk = 0; update_nchunk < update_nchunks; ++update_nchunk) {
+  *chunks = malloc(update_nchunks * sizeof(slice_chunk));
+  BLOSC_ERROR_NULL(*chunks, BLOSC2_ERROR_MEMORY_ALLOC);
+  int64_t nchunks = 0;
+  for (int64_t update_nchunk = 0; update_nchunk < update_nchunks; ++update_nchunk) {
+    slice_chunk *chunk = &(*chunks)[nchunks];
     int64_t nchunk_ndim[B2ND_MAX_DIM] = {0};
     blosc2_unidim_to_multidim(ndim, update_shape, update_nchunk, nchunk_ndim);
     for (int i = 0; i < ndim; ++i) {
       nchunk_ndim[i] += update_start[i];
     }
-    int64_t nchunk;
-    blosc2_multidim_to_unidim(nchunk_ndim, ndim, chunks_in_array_strides, &nchunk);
+    blosc2_multidim_to_unidim(nchunk_ndim, ndim, chunks_in_array_strides, &chunk->nchunk);
 
     // Check if the chunk needs to be updated
-    int64_t chunk_start[B2ND_MAX_DIM] = {0};
-    int64_t chunk_stop[B2ND_MAX_DIM] = {0};
     for (int i = 0; i < ndim; ++i) {
-      chunk_start[i] = nchunk_ndim[i] * array->chunkshape[i];
-      chunk_stop[i] = chunk_start[i] + array->chunkshape[i];
-      if (chunk_stop[i] > array->shape[i]) {
-        chunk_stop[i] = array->shape[i];
+      chunk->start[i] = nchunk_ndim[i] * array->chunkshape[i];
+      chunk->stop[i] = chunk->start[i] + array->chunkshape[i];
+      if (chunk->stop[i] > array->shape[i]) {
+        chunk->stop[i] = array->shape[i];
       }
     }
     bool chunk_empty = false;
     for (int i = 0; i < ndim; ++i) {
-      chunk_empty |= (chunk_stop[i] <= buffer_start[i] || chunk_start[i] >= buffer_stop[i]);
+      chunk_empty |= (chunk->stop[i] <= start[i] || chunk->start[i] >= stop[i]);
     }
-    if (chunk_empty) {
-      continue;
+    if (!chunk_empty) {
+      nchunks++;
     }
+  }
 
-    int32_t nblocks = (int32_t) array->extchunknitems / array->blocknitems;
+  return nchunks;
+}
 
 
-    if (set_slice) {
-      // Check if all the chunk is going to be updated and avoid the decompression
-      bool decompress_chunk = false;
-      for (int i = 0; i < ndim; ++i) {
-        decompress_chunk |= (chunk_start[i] < buffer_start[i] || chunk_stop[i] > buffer_stop[i]);
-      }
+/* The number of items of the slice in [start, stop) along dimension `i` (which are `steps[i]`
+ * apart), and the first of them in `first` */
+static int64_t slice_step_items(const slice_job_data *slice, int i, int64_t start, int64_t stop, int64_t *first) {
+  int64_t step = slice->steps != NULL ? slice->steps[i] : 1;
+  if (start < slice->start[i]) {
+    start = slice->start[i];
+  }
+  if (stop > slice->stop[i]) {
+    stop = slice->stop[i];
+  }
+  *first = slice->start[i] + (start - slice->start[i] + step - 1) / step * step;
+  return *first < stop ? (stop - *first + step - 1) / step : 0;
+}
 
-      if (decompress_chunk) {
-        int err = blosc2_schunk_decompress_chunk(array->sc, nchunk, data, data_nbytes);
-        if (err < 0) {
-          BLOSC_TRACE_ERROR("Error decompressing chunk");
-          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-        }
-      } else {
-        // Avoid writing non zero padding from previous chunk
-        memset(data, 0, data_nbytes);
-      }
-    } else {
-      bool *block_maskout = malloc(nblocks);
-      BLOSC_ERROR_NULL(block_maskout, BLOSC2_ERROR_MEMORY_ALLOC);
-      for (int nblock = 0; nblock < nblocks; ++nblock) {
-        int64_t nblock_ndim[B2ND_MAX_DIM] = {0};
-        blosc2_unidim_to_multidim(ndim, blocks_in_chunk, nblock, nblock_ndim);
-
-        // Check if the block needs to be updated
-        int64_t block_start[B2ND_MAX_DIM] = {0};
-        int64_t block_stop[B2ND_MAX_DIM] = {0};
-        for (int i = 0; i < ndim; ++i) {
-          block_start[i] = nblock_ndim[i] * array->blockshape[i];
-          block_stop[i] = block_start[i] + array->blockshape[i];
-          block_start[i] += chunk_start[i];
-          block_stop[i] += chunk_start[i];
-
-          if (block_start[i] > chunk_stop[i]) {
-            block_start[i] = chunk_stop[i];
-          }
-          if (block_stop[i] > chunk_stop[i]) {
-            block_stop[i] = chunk_stop[i];
-          }
-        }
 
-        bool block_empty = false;
-        for (int i = 0; i < ndim; ++i) {
-          block_empty |= (block_stop[i] <= start[i] || block_start[i] >= stop[i]);
-        }
-        block_maskout[nblock] = block_empty ? true : false;
-      }
+/* Whether there are items of the slice in the box [start, stop) */
+static bool slice_has_items(const slice_job_data *slice, const int64_t *start, const int64_t *stop) {
+  for (int i = 0; i < slice->array->ndim; ++i) {
+    int64_t first;
+    if (slice_step_items(slice, i, start[i], stop[i], &first) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
 
-      if (blosc2_set_maskout(array->sc->dctx, block_maskout, nblocks) != BLOSC2_ERROR_SUCCESS) {
-        BLOSC_TRACE_ERROR("Error setting the maskout");
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-      }
 
-      int err = blosc2_schunk_decompress_chunk(array->sc, nchunk, data, data_nbytes);
-      if (err < 0) {
-        BLOSC_TRACE_ERROR("Error decompressing chunk");
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-      }
+/* Whether the slice only covers a part of the chunk (which has to be decompressed then for setting it) */
+static bool slice_covers_part(const slice_job_data *slice, const slice_chunk *chunk) {
+  bool part = false;
+  for (int i = 0; i < slice->array->ndim; ++i) {
+    part |= (chunk->start[i] < slice->start[i] || chunk->stop[i] > slice->stop[i]);
+  }
+  return part;
+}
 
-      free(block_maskout);
-    }
 
-    // Iterate over blocks
+/* Whether the chunk has items out of the array (or in the padding of its blocks) */
+static bool chunk_has_padding(const b2nd_array_t *array, const slice_chunk *chunk) {
+  bool padding = false;
+  for (int i = 0; i < array->ndim; ++i) {
+    padding |= (chunk->stop[i] - chunk->start[i] != array->extchunkshape[i]);
+  }
+  return padding;
+}
 
-    for (int nblock = 0; nblock < nblocks; ++nblock) {
-      int64_t nblock_ndim[B2ND_MAX_DIM] = {0};
-      blosc2_unidim_to_multidim(ndim, blocks_in_chunk, nblock, nblock_ndim);
 
-      // Check if the block needs to be updated
-      int64_t block_start[B2ND_MAX_DIM] = {0};
-      int64_t block_stop[B2ND_MAX_DIM] = {0};
-      for (int i = 0; i < ndim; ++i) {
-        block_start[i] = nblock_ndim[i] * array->blockshape[i];
-        block_stop[i] = block_start[i] + array->blockshape[i];
-        block_start[i] += chunk_start[i];
-        block_stop[i] += chunk_start[i];
+/* Where block `nblock` of the chunk starts and stops in the array */
+static void get_block_limits(const b2nd_array_t *array, const slice_chunk *chunk, int nblock,
+                             int64_t *block_start, int64_t *block_stop) {
+  int8_t ndim = array->ndim;
+  int64_t blocks_in_chunk[B2ND_MAX_DIM] = {0};
+  for (int i = 0; i < ndim; ++i) {
+    blocks_in_chunk[i] = array->extchunkshape[i] / array->blockshape[i];
+  }
 
-        if (block_start[i] > chunk_stop[i]) {
-          block_start[i] = chunk_stop[i];
-        }
-        if (block_stop[i] > chunk_stop[i]) {
-          block_stop[i] = chunk_stop[i];
-        }
-      }
-      int64_t block_shape[B2ND_MAX_DIM] = {0};
-      for (int i = 0; i < ndim; ++i) {
-        block_shape[i] = block_stop[i] - block_start[i];
-      }
-      bool block_empty = false;
-      for (int i = 0; i < ndim; ++i) {
-        block_empty |= (block_stop[i] <= start[i] || block_start[i] >= stop[i]);
-      }
-      if (block_empty) {
-        continue;
-      }
+  int64_t nblock_ndim[B2ND_MAX_DIM] = {0};
+  blosc2_unidim_to_multidim(ndim, blocks_in_chunk, nblock, nblock_ndim);
+  for (int i = 0; i < ndim; ++i) {
+    block_start[i] = nblock_ndim[i] * array->blockshape[i];
+    block_stop[i] = block_start[i] + array->blockshape[i];
+    block_start[i] += chunk->start[i];
+    block_stop[i] += chunk->start[i];
 
-      // compute the start of the slice inside the block
-      int64_t slice_start[B2ND_MAX_DIM] = {0};
-      for (int i = 0; i < ndim; ++i) {
-        if (block_start[i] < buffer_start[i]) {
-          slice_start[i] = buffer_start[i] - block_start[i];
-        } else {
-          slice_start[i] = 0;
-        }
-        slice_start[i] += block_start[i];
-      }
+    if (block_start[i] > chunk->stop[i]) {
+      block_start[i] = chunk->stop[i];
+    }
+    if (block_stop[i] > chunk->stop[i]) {
+      block_stop[i] = chunk->stop[i];
+    }
+  }
+}
 
-      int64_t slice_stop[B2ND_MAX_DIM] = {0};
-      for (int i = 0; i < ndim; ++i) {
-        if (block_stop[i] > buffer_stop[i]) {
-          slice_stop[i] = block_shape[i] - (block_stop[i] - buffer_stop[i]);
-        } else {
-          slice_stop[i] = block_stop[i] - block_start[i];
-        }
-        slice_stop[i] += block_start[i];
-      }
 
-      int64_t slice_shape[B2ND_MAX_DIM] = {0};
+/* Set the blocks of the chunk that do not intersect the slice in the maskout of `dctx`, so
+ * that only the rest are read (for lazy chunks) and decompressed.  With the fixed-rate ZFP codec,
+ * the part of every block in the slice is set too, so that only the cells in there are decoded. */
+static int set_slice_maskout(const slice_job_data *slice, const slice_chunk *chunk, blosc2_context *dctx) {
+  b2nd_array_t *array = slice->array;
+  int8_t ndim = array->ndim;
+  int32_t nblocks = (int32_t) array->extchunknitems / array->blocknitems;
+  bool *block_maskout = ctx_malloc(dctx, nblocks);
+  BLOSC_ERROR_NULL(block_maskout, BLOSC2_ERROR_MEMORY_ALLOC);
+  int64_t *boxes = NULL;
+  if (array->sc->compcode == BLOSC_CODEC_ZFP_FIXED_RATE) {
+    boxes = ctx_malloc(dctx, (size_t) nblocks * 2 * ndim * sizeof(int64_t));
+    if (boxes == NULL) {
+      ctx_free(dctx, block_maskout);
+      BLOSC_TRACE_ERROR("Error allocating the boxes of the blocks");
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+  }
+  bool any_maskout = false;
+  bool any_box = false;
+  for (int nblock = 0; nblock < nblocks; ++nblock) {
+    int64_t block_start[B2ND_MAX_DIM] = {0};
+    int64_t block_stop[B2ND_MAX_DIM] = {0};
+    get_block_limits(array, chunk, nblock, block_start, block_stop);
+
+    bool block_empty = !slice_has_items(slice, block_start, block_stop);
+    block_maskout[nblock] = block_empty ? true : false;
+    any_maskout |= block_empty;
+
+    if (boxes != NULL) {
+      // The starts and then the stops of the slice in the block (the whole block if start[0] < 0)
+      int64_t *box_start = boxes + (int64_t) nblock * 2 * ndim;
+      int64_t *box_stop = box_start + ndim;
+      bool whole = true;
       for (int i = 0; i < ndim; ++i) {
-        slice_shape[i] = slice_stop[i] - slice_start[i];
+        int64_t start = slice->start[i] > block_start[i] ? slice->start[i] : block_start[i];
+        int64_t stop = slice->stop[i] < block_stop[i] ? slice->stop[i] : block_stop[i];
+        box_start[i] = start - block_start[i];
+        box_stop[i] = stop - block_start[i];
+        whole &= (box_start[i] == 0 && box_stop[i] == array->blockshape[i]);
       }
+      if (block_empty || whole) {
+        box_start[0] = -1;
+      }
+      any_box |= !(block_empty || whole);
+    }
+  }
 
-      uint8_t *src = &buffer_b[0];
-      const int64_t *src_pad_shape = buffer_shape;
+  // A mask with every block in would just get in the way of the static scheduling
+  int rc = BLOSC2_ERROR_SUCCESS;
+  if (any_maskout && blosc2_set_maskout(dctx, block_maskout, nblocks) != BLOSC2_ERROR_SUCCESS) {
+    BLOSC_TRACE_ERROR("Error setting the maskout");
+    rc = BLOSC2_ERROR_FAILURE;
+  }
+  ctx_free(dctx, block_maskout);
+  if (any_box && rc == BLOSC2_ERROR_SUCCESS) {
+    if (dctx->zfp_boxes != NULL) {
+      ctx_free(dctx, dctx->zfp_boxes);
+    }
+    dctx->zfp_boxes = boxes;
+    dctx->zfp_boxes_ndim = ndim;
+    dctx->zfp_boxes_nitems = nblocks;
+  } else if (boxes != NULL) {
+    ctx_free(dctx, boxes);
+  }
+  return rc;
+}
 
-      int64_t src_start[B2ND_MAX_DIM] = {0};
-      int64_t src_stop[B2ND_MAX_DIM] = {0};
-      for (int i = 0; i < ndim; ++i) {
-        src_start[i] = slice_start[i] - buffer_start[i];
-        src_stop[i] = slice_stop[i] - buffer_start[i];
-      }
 
-      uint8_t *dst = &data[nblock * array->blocknitems * array->sc->typesize];
-      int64_t dst_pad_shape[B2ND_MAX_DIM];
+/* Copy the part of the slice in the chunk between the buffer and the decompressed chunk */
+static void copy_slice_chunk(const slice_job_data *slice, const slice_chunk *chunk, uint8_t *chunk_data) {
+  b2nd_array_t *array = slice->array;
+  int8_t ndim = array->ndim;
+  const int64_t *buffer_start = slice->start;
+  const int64_t *buffer_stop = slice->stop;
+  const int64_t *buffer_shape = slice->shape;
+  int32_t nblocks = (int32_t) array->extchunknitems / array->blocknitems;
+
+  // Iterate over blocks
+
+  for (int nblock = 0; nblock < nblocks; ++nblock) {
+    // Check if the block needs to be updated
+    int64_t block_start[B2ND_MAX_DIM] = {0};
+    int64_t block_stop[B2ND_MAX_DIM] = {0};
+    get_block_limits(array, chunk, nblock, block_start, block_stop);
+    int64_t block_shape[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      block_shape[i] = block_stop[i] - block_start[i];
+    }
+    bool block_empty = false;
+    for (int i = 0; i < ndim; ++i) {
+      block_empty |= (block_stop[i] <= buffer_start[i] || block_start[i] >= buffer_stop[i]);
+    }
+    if (block_empty) {
+      continue;
+    }
+
+    uint8_t *dst = &chunk_data[nblock * array->blocknitems * array->sc->typesize];
+    if (slice->steps != NULL) {
+      // Gather the items of the block that are `steps` apart (this is only for getting slices)
+      int64_t copy_shape[B2ND_MAX_DIM];
+      int64_t block_strides[B2ND_MAX_DIM];
+      int64_t buffer_strides[B2ND_MAX_DIM];
+      block_strides[ndim - 1] = array->sc->typesize;
+      buffer_strides[ndim - 1] = array->sc->typesize;
+      for (int i = ndim - 2; i >= 0; --i) {
+        block_strides[i] = block_strides[i + 1] * array->blockshape[i + 1];
+        buffer_strides[i] = buffer_strides[i + 1] * buffer_shape[i + 1];
+      }
+      const int64_t *dst_strides = slice->strides != NULL ? slice->strides : buffer_strides;
+      uint8_t *bblock = dst;
+      uint8_t *bbuffer = slice->buffer;
       for (int i = 0; i < ndim; ++i) {
-        dst_pad_shape[i] = array->blockshape[i];
+        int64_t first;
+        copy_shape[i] = slice_step_items(slice, i, block_start[i], block_stop[i], &first);
+        bblock += (first - block_start[i]) * block_strides[i];
+        bbuffer += (first - buffer_start[i]) / slice->steps[i] * dst_strides[i];
+        block_strides[i] *= slice->steps[i];
       }
+      b2nd_copy_buffer_strided(ndim, (uint8_t) array->sc->typesize, copy_shape,
+                               bblock, block_strides, bbuffer, dst_strides);
+      continue;
+    }
 
-      int64_t dst_start[B2ND_MAX_DIM] = {0};
-      int64_t dst_stop[B2ND_MAX_DIM] = {0};
-      for (int i = 0; i < ndim; ++i) {
-        dst_start[i] = slice_start[i] - block_start[i];
-        dst_stop[i] = dst_start[i] + slice_shape[i];
+    // compute the start of the slice inside the block
+    int64_t slice_start[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      if (block_start[i] < buffer_start[i]) {
+        slice_start[i] = buffer_start[i] - block_start[i];
+      } else {
+        slice_start[i] = 0;
       }
+      slice_start[i] += block_start[i];
+    }
 
-      if (set_slice) {
-        b2nd_copy_buffer(ndim, array->sc->typesize,
-                         src, src_pad_shape, src_start, src_stop,
-                         dst, dst_pad_shape, dst_start);
+    int64_t slice_stop[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      if (block_stop[i] > buffer_stop[i]) {
+        slice_stop[i] = block_shape[i] - (block_stop[i] - buffer_stop[i]);
       } else {
-        b2nd_copy_buffer(ndim, array->sc->typesize,
-                         dst, dst_pad_shape, dst_start, dst_stop,
-                         src, src_pad_shape, src_start);
+        slice_stop[i] = block_stop[i] - block_start[i];
       }
+      slice_stop[i] += block_start[i];
     }
 
-    if (set_slice) {
-      // Recompress the data
-      int32_t chunk_nbytes = data_nbytes + BLOSC2_MAX_OVERHEAD;
-      uint8_t *chunk = malloc(chunk_nbytes);
-      BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
-      int brc;
-      brc = blosc2_compress_ctx(array->sc->cctx, data, data_nbytes, chunk, chunk_nbytes);
-      if (brc < 0) {
-        BLOSC_TRACE_ERROR("Blosc can not compress the data");
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+    int64_t slice_shape[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      slice_shape[i] = slice_stop[i] - slice_start[i];
+    }
+
+    if (slice->strides != NULL) {
+      // Straight between the block and the (strided) buffer
+      int64_t block_strides[B2ND_MAX_DIM];
+      block_strides[ndim - 1] = array->sc->typesize;
+      for (int i = ndim - 2; i >= 0; --i) {
+        block_strides[i] = block_strides[i + 1] * array->blockshape[i + 1];
       }
-      int64_t brc_ = blosc2_schunk_update_chunk(array->sc, nchunk, chunk, false);
-      if (brc_ < 0) {
-        BLOSC_TRACE_ERROR("Blosc can not update the chunk");
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      uint8_t *bbuffer = slice->buffer;
+      uint8_t *bblock = dst;
+      for (int i = 0; i < ndim; ++i) {
+        bbuffer += (slice_start[i] - buffer_start[i]) * slice->strides[i];
+        bblock += (slice_start[i] - block_start[i]) * block_strides[i];
       }
+      if (slice->set_slice) {
+        b2nd_copy_buffer_strided(ndim, (uint8_t) array->sc->typesize, slice_shape,
+                                 bbuffer, slice->strides, bblock, block_strides);
+      } else {
+        b2nd_copy_buffer_strided(ndim, (uint8_t) array->sc->typesize, slice_shape,
+                                 bblock, block_strides, bbuffer, slice->strides);
+      }
+      continue;
     }
-  }
 
-  free(data);
+    uint8_t *src = &slice->buffer[0];
+    const int64_t *src_pad_shape = buffer_shape;
 
-  return BLOSC2_ERROR_SUCCESS;
-}
+    int64_t src_start[B2ND_MAX_DIM] = {0};
+    int64_t src_stop[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      src_start[i] = slice_start[i] - buffer_start[i];
+      src_stop[i] = slice_stop[i] - buffer_start[i];
+    }
 
+    int64_t dst_pad_shape[B2ND_MAX_DIM];
+    for (int i = 0; i < ndim; ++i) {
+      dst_pad_shape[i] = array->blockshape[i];
+    }
 
-int b2nd_get_slice_cbuffer(const b2nd_array_t *array, const int64_t *start, const int64_t *stop,
-                           void *buffer, const int64_t *buffershape, int64_t buffersize) {
-  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(buffershape, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+    int64_t dst_start[B2ND_MAX_DIM] = {0};
+    int64_t dst_stop[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      dst_start[i] = slice_start[i] - block_start[i];
+      dst_stop[i] = dst_start[i] + slice_shape[i];
+    }
 
-  int64_t size = array->sc->typesize;
-  for (int i = 0; i < array->ndim; ++i) {
-    if (stop[i] - start[i] > buffershape[i]) {
-      BLOSC_TRACE_ERROR("The buffer shape can not be smaller than the slice shape");
-      return BLOSC2_ERROR_INVALID_PARAM;
+    if (slice->set_slice) {
+      b2nd_copy_buffer(ndim, array->sc->typesize,
+                       src, src_pad_shape, src_start, src_stop,
+                       dst, dst_pad_shape, dst_start);
+    } else {
+      b2nd_copy_buffer(ndim, array->sc->typesize,
+                       dst, dst_pad_shape, dst_start, dst_stop,
+                       src, src_pad_shape, src_start);
     }
-    size *= buffershape[i];
   }
+}
 
-  if (array->nitems == 0) {
-    return BLOSC2_ERROR_SUCCESS;
-  }
 
-  if (buffersize < size) {
-    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+/* The chunks of a slice shared by the jobs that process them in parallel */
+typedef struct {
+  slice_job_data *slice;
+  volatile int32_t next_chunk;
+  uint8_t **srcs;  // the (lazy) chunks to decompress, NULL for the chunks that are fully set
+  int32_t *srcsizes;
+  bool *needs_free;
+  uint8_t **dests;  // the compressed chunks, for setting the slice
+  int *rcs;
+} slice_batch;
+
+/* A job processing chunks of a slice_batch with its own (single-threaded) contexts */
+typedef struct {
+  slice_batch *batch;
+  blosc2_context *dctx;
+  blosc2_context *cctx;
+  uint8_t *data;
+} slice_chunks_job;
+
+static int process_batch_chunk(slice_chunks_job *job, int32_t i) {
+  slice_batch *batch = job->batch;
+  slice_job_data *slice = batch->slice;
+  const slice_chunk *chunk = &slice->chunks[i];
+  int32_t data_nbytes = (int32_t) slice->array->extchunknitems * slice->array->sc->typesize;
+
+  if (batch->srcs[i] != NULL) {
+    if (!slice->set_slice) {
+      BLOSC_ERROR(set_slice_maskout(slice, chunk, job->dctx));
+    }
+    int rc = blosc2_decompress_ctx(job->dctx, batch->srcs[i], batch->srcsizes[i], job->data, data_nbytes);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Error decompressing chunk");
+      return rc;
+    }
+  } else if (chunk_has_padding(slice->array, chunk)) {
+    // Avoid writing non zero padding from previous chunk
+    memset(job->data, 0, data_nbytes);
   }
-  BLOSC_ERROR(get_set_slice(buffer, buffersize, start, stop, buffershape, (b2nd_array_t *)array, false));
 
+  copy_slice_chunk(slice, chunk, job->data);
+
+  if (slice->set_slice) {
+    int32_t chunk_nbytes = data_nbytes + BLOSC2_MAX_OVERHEAD;
+    batch->dests[i] = malloc(chunk_nbytes);
+    BLOSC_ERROR_NULL(batch->dests[i], BLOSC2_ERROR_MEMORY_ALLOC);
+    int rc = blosc2_compress_ctx(job->cctx, job->data, data_nbytes, batch->dests[i], chunk_nbytes);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Blosc can not compress the data");
+      return rc;
+    }
+  }
   return BLOSC2_ERROR_SUCCESS;
 }
 
-
-int b2nd_set_slice_cbuffer(const void *buffer, const int64_t *buffershape, int64_t buffersize,
-                           const int64_t *start, const int64_t *stop,
-                           b2nd_array_t *array) {
-  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-
-  int64_t size = array->sc->typesize;
-  for (int i = 0; i < array->ndim; ++i) {
-    size *= stop[i] - start[i];
+static void process_slice_chunks(void *data) {
+  slice_chunks_job *job = (slice_chunks_job *) data;
+  slice_batch *batch = job->batch;
+  int32_t i;
+  while ((i = blosc_atomic_add32(&batch->next_chunk, 1)) < batch->slice->nchunks) {
+    batch->rcs[i] = process_batch_chunk(job, i);
   }
+}
 
-  if (buffersize < size) {
-    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
-  }
 
-  if (array->nitems == 0) {
-    return BLOSC2_ERROR_SUCCESS;
+/* Whether `nchunks` chunks of an array can be processed in parallel on the shared pool */
+static bool parallel_chunks(const b2nd_array_t *array, int64_t nchunks, bool set) {
+  blosc2_schunk *sc = array->sc;
+  // The chunks in the write cache are set and got there, in turns, and the ones with deltas
+  // are decoded against the previous ones
+  if (nchunks < 2 || blosc_pool_nthreads() == 0 || array->write_cache != NULL || sc->xdelta != NULL) {
+    return false;
   }
+  if (set) {
+    // Prefilters, dicts and stateful tuners depend on the state of the super-chunk context
+    return sc->cctx->prefilter == NULL && !sc->cctx->use_dict && sc->cctx->tuner_id == BLOSC_STUNE &&
+           sc->cctx->tuner_params == NULL && sc->dctx->postfilter == NULL;
+  }
+  // Postfilters may depend on the current chunk, and the chunk cache is not meant for concurrent use
+  return sc->dctx->postfilter == NULL && sc->chunk_cache == NULL;
+}
 
-  BLOSC_ERROR(get_set_slice((void*)buffer, buffersize, start, stop, (int64_t *)buffershape, array, true));
 
-  return BLOSC2_ERROR_SUCCESS;
+/* Whether the chunks of the slice can be processed in parallel on the shared pool */
+static bool parallel_slice(const slice_job_data *slice) {
+  return parallel_chunks(slice->array, slice->nchunks, slice->set_slice);
 }
 
 
-int b2nd_get_slice(b2nd_context_t *ctx, b2nd_array_t **array, const b2nd_array_t *src, const int64_t *start,
-                   const int64_t *stop) {
-  BLOSC_ERROR_NULL(src, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+/* Process the chunks of a slice in parallel, each with contexts of its own.  The chunks to be
+ * decompressed are fetched first, because the backing storage must not be read concurrently
+ * (but the blocks of the lazy chunks can). */
+static int get_set_slice_parallel(slice_job_data *slice) {
+  blosc2_schunk *sc = slice->array->sc;
+  int32_t nchunks = (int32_t) slice->nchunks;
+  int32_t data_nbytes = (int32_t) slice->array->extchunknitems * sc->typesize;
+  int njobs = blosc_pool_nthreads() + 1;
+  if (njobs > nchunks) {
+    njobs = nchunks;
+  }
 
-  ctx->ndim = src->ndim;
-  for (int i = 0; i < src->ndim; ++i) {
-    ctx->shape[i] = stop[i] - start[i];
+  slice_batch batch = {0};
+  batch.slice = slice;
+  batch.srcs = calloc(nchunks, sizeof(uint8_t *));
+  batch.srcsizes = calloc(nchunks, sizeof(int32_t));
+  batch.needs_free = calloc(nchunks, sizeof(bool));
+  batch.dests = calloc(nchunks, sizeof(uint8_t *));
+  batch.rcs = calloc(nchunks, sizeof(int));
+  slice_chunks_job *jobs = calloc(njobs, sizeof(slice_chunks_job));
+  int rc = BLOSC2_ERROR_SUCCESS;
+  if (batch.srcs == NULL || batch.srcsizes == NULL || batch.needs_free == NULL || batch.dests == NULL ||
+      batch.rcs == NULL || jobs == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate the batch of chunks.");
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto end;
   }
 
-  // Add data
-  BLOSC_ERROR(b2nd_empty(ctx, array));
+  for (int32_t i = 0; i < nchunks; i++) {
+    if (slice->set_slice && (slice->append || !slice_covers_part(slice, &slice->chunks[i]))) {
+      continue;
+    }
+    int cbytes = blosc2_schunk_get_lazychunk(sc, slice->chunks[i].nchunk, &batch.srcs[i], &batch.needs_free[i]);
+    if (cbytes <= 0) {
+      BLOSC_TRACE_ERROR("Cannot get the chunk %" PRId64 ".", slice->chunks[i].nchunk);
+      rc = cbytes < 0 ? cbytes : BLOSC2_ERROR_NOT_FOUND;
+      goto end;
+    }
+    batch.srcsizes[i] = cbytes;
+  }
 
-  if ((*array)->nitems == 0) {
-    return BLOSC2_ERROR_SUCCESS;
+  blosc2_cparams cparams;
+  blosc2_ctx_get_cparams(sc->cctx, &cparams);
+  cparams.nthreads = 1;
+  blosc2_dparams dparams;
+  blosc2_ctx_get_dparams(sc->dctx, &dparams);
+  dparams.nthreads = 1;
+  for (int i = 0; i < njobs; i++) {
+    jobs[i].batch = &batch;
+    jobs[i].dctx = blosc2_create_dctx(dparams);
+    jobs[i].cctx = slice->set_slice ? blosc2_create_cctx(cparams) : NULL;
+    jobs[i].data = malloc(data_nbytes);
+    if (jobs[i].dctx == NULL || (slice->set_slice && jobs[i].cctx == NULL) || jobs[i].data == NULL) {
+      BLOSC_TRACE_ERROR("Cannot create the contexts for the batch.");
+      rc = BLOSC2_ERROR_FAILURE;
+      goto end;
+    }
   }
+  batch.next_chunk = 0;
+  blosc_pool_run(NULL, process_slice_chunks, njobs, sizeof(slice_chunks_job), jobs);
 
-  int8_t ndim = (*array)->ndim;
-  int64_t chunks_in_array[B2ND_MAX_DIM] = {0};
-  for (int i = 0; i < ndim; ++i) {
-    chunks_in_array[i] = (*array)->extshape[i] / (*array)->chunkshape[i];
+  for (int32_t i = 0; i < nchunks; i++) {
+    if (batch.rcs[i] < 0) {
+      rc = batch.rcs[i];
+      goto end;
+    }
   }
-  int64_t nchunks = (*array)->sc->nchunks;
-  for (int nchunk = 0; nchunk < nchunks; ++nchunk) {
-    int64_t nchunk_ndim[B2ND_MAX_DIM] = {0};
-    blosc2_unidim_to_multidim(ndim, chunks_in_array, nchunk, nchunk_ndim);
 
-    // Check if the chunk needs to be updated
-    int64_t chunk_start[B2ND_MAX_DIM] = {0};
-    int64_t chunk_stop[B2ND_MAX_DIM] = {0};
-    int64_t chunk_shape[B2ND_MAX_DIM] = {0};
-    for (int i = 0; i < ndim; ++i) {
-      chunk_start[i] = nchunk_ndim[i] * (*array)->chunkshape[i];
-      chunk_stop[i] = chunk_start[i] + (*array)->chunkshape[i];
-      if (chunk_stop[i] > (*array)->shape[i]) {
-        chunk_stop[i] = (*array)->shape[i];
+  // The sources are not needed anymore, and updating chunks may invalidate them
+  for (int32_t i = 0; i < nchunks; i++) {
+    if (batch.needs_free[i]) {
+      free(batch.srcs[i]);
+    }
+    batch.needs_free[i] = false;
+  }
+  if (slice->set_slice) {
+    // The offsets of the frame must be updated in order
+    for (int32_t i = 0; i < nchunks; i++) {
+      int64_t nchunks_;
+      if (slice->append) {
+        nchunks_ = blosc2_schunk_append_chunk(sc, batch.dests[i], false);
+      } else {
+        nchunks_ = blosc2_schunk_update_chunk(sc, slice->chunks[i].nchunk, batch.dests[i], false);
+      }
+      batch.dests[i] = NULL;
+      if (nchunks_ < 0) {
+        BLOSC_TRACE_ERROR("Blosc can not update the chunk");
+        rc = (int) nchunks_;
+        goto end;
       }
-      chunk_shape[i] = chunk_stop[i] - chunk_start[i];
     }
+  }
 
-    int64_t src_start[B2ND_MAX_DIM] = {0};
-    int64_t src_stop[B2ND_MAX_DIM] = {0};
-    for (int i = 0; i < ndim; ++i) {
-      src_start[i] = chunk_start[i] + start[i];
-      src_stop[i] = chunk_stop[i] + start[i];
+  end:
+  if (jobs != NULL) {
+    for (int i = 0; i < njobs; i++) {
+      if (jobs[i].dctx != NULL) {
+        blosc2_free_ctx(jobs[i].dctx);
+      }
+      if (jobs[i].cctx != NULL) {
+        blosc2_free_ctx(jobs[i].cctx);
+      }
+      free(jobs[i].data);
     }
-    int64_t buffersize = ctx->b2_storage->cparams->typesize;
-    for (int i = 0; i < ndim; ++i) {
-      buffersize *= chunk_shape[i];
+  }
+  for (int32_t i = 0; i < nchunks; i++) {
+    if (batch.needs_free != NULL && batch.needs_free[i]) {
+      free(batch.srcs[i]);
+    }
+    if (batch.dests != NULL) {
+      free(batch.dests[i]);
     }
-    uint8_t *buffer = malloc(buffersize);
-    BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
-    BLOSC_ERROR(b2nd_get_slice_cbuffer(src, src_start, src_stop, buffer, chunk_shape,
-                                       buffersize));
-    BLOSC_ERROR(b2nd_set_slice_cbuffer(buffer, chunk_shape, buffersize, chunk_start,
-                                       chunk_stop, *array));
-    free(buffer);
   }
-
-  return BLOSC2_ERROR_SUCCESS;
+  free(jobs);
+  free(batch.srcs);
+  free(batch.srcsizes);
+  free(batch.needs_free);
+  free(batch.dests);
+  free(batch.rcs);
+  return rc;
 }
 
 
-int b2nd_squeeze(b2nd_array_t *array) {
-  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-
-  bool index[B2ND_MAX_DIM];
+/* The chunk in the write cache for setting the slice into it (read first when the slice only covers a part of it) */
+static int write_cache_get_chunk(const slice_job_data *slice, const slice_chunk *chunk, uint8_t **data) {
+  b2nd_array_t *array = slice->array;
+  *data = write_cache_find(array, chunk->nchunk);
+  if (*data != NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
 
-  for (int i = 0; i < array->ndim; ++i) {
-    if (array->shape[i] != 1) {
-      index[i] = false;
-    } else {
-      index[i] = true;
+  int32_t data_nbytes = (int32_t) array->extchunknitems * array->sc->typesize;
+  uint8_t *chunk_data = malloc(data_nbytes);
+  BLOSC_ERROR_NULL(chunk_data, BLOSC2_ERROR_MEMORY_ALLOC);
+  if (slice_covers_part(slice, chunk)) {
+    int rc = blosc2_schunk_decompress_chunk(array->sc, chunk->nchunk, chunk_data, data_nbytes);
+    if (rc < 0) {
+      free(chunk_data);
+      BLOSC_TRACE_ERROR("Error decompressing chunk");
+      return rc;
     }
+  } else if (chunk_has_padding(array, chunk)) {
+    // Avoid writing non zero padding from previous chunk
+    memset(chunk_data, 0, data_nbytes);
   }
-  BLOSC_ERROR(b2nd_squeeze_index(array, index));
 
+  write_cache_entry *entry = write_cache_new_entry(array);
+  if (entry == NULL) {
+    free(chunk_data);
+    return BLOSC2_ERROR_FAILURE;
+  }
+  write_cache *cache = (write_cache *) array->write_cache;
+  entry->nchunk = chunk->nchunk;
+  entry->data = chunk_data;
+  entry->last_use = cache->nuses++;
+  cache->nentries++;
+  *data = chunk_data;
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int b2nd_squeeze_index(b2nd_array_t *array, const bool *index) {
-  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+/* Sort the chunks of a slice in the order of the array along its curve */
+static int sort_slice_chunks(slice_job_data *slice) {
+  int64_t *nchunks = malloc(slice->nchunks * sizeof(int64_t));
+  int64_t *order = malloc(slice->nchunks * sizeof(int64_t));
+  slice_chunk *chunks = malloc(slice->nchunks * sizeof(slice_chunk));
+  int rc = nchunks == NULL || order == NULL || chunks == NULL ? BLOSC2_ERROR_MEMORY_ALLOC : BLOSC2_ERROR_SUCCESS;
+  for (int64_t i = 0; rc == BLOSC2_ERROR_SUCCESS && i < slice->nchunks; ++i) {
+    nchunks[i] = slice->chunks[i].nchunk;
+  }
+  if (rc == BLOSC2_ERROR_SUCCESS) {
+    rc = order_chunks(slice->array, slice->nchunks, nchunks, order);
+  }
+  if (rc == BLOSC2_ERROR_SUCCESS) {
+    for (int64_t i = 0; i < slice->nchunks; ++i) {
+      chunks[i] = slice->chunks[order[i]];
+    }
+    free(slice->chunks);
+    slice->chunks = chunks;
+    chunks = NULL;
+  }
+  free(nchunks);
+  free(order);
+  free(chunks);
+  return rc;
+}
 
-  uint8_t nones = 0;
-  int64_t newshape[B2ND_MAX_DIM];
-  int32_t newchunkshape[B2ND_MAX_DIM];
-  int32_t newblockshape[B2ND_MAX_DIM];
 
-  for (int i = 0; i < array->ndim; ++i) {
-    if (index[i] == true) {
-      if (array->shape[i] != 1) {
-        BLOSC_ERROR(BLOSC2_ERROR_INVALID_INDEX);
+/* Set or get the chunks intersecting a slice, in parallel when possible */
+static int process_slice(slice_job_data *slice) {
+  b2nd_array_t *array = slice->array;
+  bool set_slice = slice->set_slice;
+  slice->nchunks = get_slice_chunks(array, slice->start, slice->stop, &slice->chunks);
+  if (slice->nchunks < 0) {
+    BLOSC_ERROR((int) slice->nchunks);
+  }
+  if (slice->steps != NULL) {
+    // The chunks in between the items are not even read
+    int64_t nchunks = 0;
+    for (int64_t i = 0; i < slice->nchunks; ++i) {
+      if (slice_has_items(slice, slice->chunks[i].start, slice->chunks[i].stop)) {
+        slice->chunks[nchunks++] = slice->chunks[i];
       }
-    } else {
-      newshape[nones] = array->shape[i];
-      newchunkshape[nones] = array->chunkshape[i];
-      newblockshape[nones] = array->blockshape[i];
-      nones += 1;
     }
+    slice->nchunks = nchunks;
   }
-
-  for (int i = 0; i < B2ND_MAX_DIM; ++i) {
-    if (i < nones) {
-      array->chunkshape[i] = newchunkshape[i];
-      array->blockshape[i] = newblockshape[i];
-    } else {
-      array->chunkshape[i] = 1;
-      array->blockshape[i] = 1;
+  if (set_slice && !slice->append && curve_order(array) && slice->nchunks > 1) {
+    // The chunks are written to the end of the frame, so in the order of the array
+    int rc = sort_slice_chunks(slice);
+    if (rc < 0) {
+      free(slice->chunks);
+      BLOSC_ERROR(rc);
     }
   }
 
-  BLOSC_ERROR(update_shape(array, nones, newshape, newchunkshape, newblockshape));
-
-  return BLOSC2_ERROR_SUCCESS;
-}
-
-
-int b2nd_copy(b2nd_context_t *ctx, const b2nd_array_t *src, b2nd_array_t **array) {
-  BLOSC_ERROR_NULL(src, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-
-  ctx->ndim = src->ndim;
+  int rc = BLOSC2_ERROR_SUCCESS;
+  uint8_t *data = NULL;
+  uint8_t *chunk_ = NULL;
 
-  for (int i = 0; i < src->ndim; ++i) {
-    ctx->shape[i] = src->shape[i];
+  // Chunks with few blocks leave most of the threads of a context idle, so go for whole chunks
+  if (parallel_slice(slice)) {
+    rc = get_set_slice_parallel(slice);
+    goto end;
   }
 
-  bool equals = true;
-  for (int i = 0; i < src->ndim; ++i) {
-    if (src->chunkshape[i] != ctx->chunkshape[i]) {
-      equals = false;
-      break;
-    }
-    if (src->blockshape[i] != ctx->blockshape[i]) {
-      equals = false;
-      break;
-    }
+  int32_t data_nbytes = (int32_t) array->extchunknitems * array->sc->typesize;
+  data = ctx_malloc(array->sc->dctx, data_nbytes);
+  if (data == NULL) {
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto end;
   }
 
-  if (equals) {
-    BLOSC_ERROR(array_without_schunk(ctx, array));
-
-    blosc2_schunk *new_sc = blosc2_schunk_copy(src->sc, ctx->b2_storage);
+  for (int64_t i = 0; i < slice->nchunks; ++i) {
+    const slice_chunk *chunk = &slice->chunks[i];
+    int64_t nchunk = chunk->nchunk;
 
-    if (new_sc == NULL) {
-      return BLOSC2_ERROR_FAILURE;
+    // The dirty chunks are set in the write cache, and written back later
+    if (set_slice && !slice->append && array->write_cache != NULL) {
+      uint8_t *chunk_data;
+      BLOSC_ERROR(write_cache_get_chunk(slice, chunk, &chunk_data));
+      copy_slice_chunk(slice, chunk, chunk_data);
+      continue;
     }
-    (*array)->sc = new_sc;
 
-  } else {
-    int64_t start[B2ND_MAX_DIM] = {0};
-
-    int64_t stop[B2ND_MAX_DIM];
-    for (int i = 0; i < src->ndim; ++i) {
-      stop[i] = src->shape[i];
+    // The decompressed chunk (it is owned by the write cache of the array or the chunk cache of
+    // the super-chunk when read from there)
+    uint8_t *chunk_data = data;
+    int cache_rc = BLOSC2_ERROR_NOT_FOUND;
+    if (!set_slice) {
+      uint8_t *dirty_data = write_cache_find(array, nchunk);
+      if (dirty_data != NULL) {
+        chunk_data = dirty_data;
+        cache_rc = BLOSC2_ERROR_SUCCESS;
+      }
+      else {
+        cache_rc = schunk_cache_get_chunk(array->sc, nchunk, &chunk_data);
+      }
+      if (cache_rc < 0 && cache_rc != BLOSC2_ERROR_NOT_FOUND) {
+        BLOSC_TRACE_ERROR("Error decompressing chunk");
+        rc = BLOSC2_ERROR_FAILURE;
+        goto end;
+      }
     }
-    // Copy metalayers
-    b2nd_context_t params_meta;
-    memcpy(&params_meta, ctx, sizeof(params_meta));
-    int j = 0;
 
-    for (int i = 0; i < src->sc->nmetalayers; ++i) {
-      if (strcmp(src->sc->metalayers[i]->name, "b2nd") == 0) {
-        continue;
+    if (set_slice) {
+      // Check if all the chunk is going to be updated and avoid the decompression
+      if (!slice->append && slice_covers_part(slice, chunk)) {
+        int err = blosc2_schunk_decompress_chunk(array->sc, nchunk, data, data_nbytes);
+        if (err < 0) {
+          BLOSC_TRACE_ERROR("Error decompressing chunk");
+          rc = BLOSC2_ERROR_FAILURE;
+          goto end;
+        }
+      } else if (chunk_has_padding(array, chunk)) {
+        // Avoid writing non zero padding from previous chunk
+        memset(data, 0, data_nbytes);
+      }
+    } else if (cache_rc < 0) {
+      // The maskout is for the context decompressing the chunk (see blosc2_schunk_set_concurrent_reads())
+      blosc2_context *dctx = schunk_acquire_dctx(array->sc);
+      if (dctx == NULL) {
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        goto end;
+      }
+      int err = set_slice_maskout(slice, chunk, dctx);
+      if (err >= 0) {
+        err = schunk_decompress_chunk_ctx(array->sc, dctx, nchunk, data, data_nbytes);
+      }
+      schunk_release_dctx(array->sc, dctx);
+      if (err < 0) {
+        BLOSC_TRACE_ERROR("Error decompressing chunk");
+        rc = BLOSC2_ERROR_FAILURE;
+        goto end;
       }
-      blosc2_metalayer *meta = &params_meta.metalayers[j];
-      meta->name = src->sc->metalayers[i]->name;
-      meta->content = src->sc->metalayers[i]->content;
-      meta->content_len = src->sc->metalayers[i]->content_len;
-      j++;
     }
-    params_meta.nmetalayers = j;
 
-    // Copy data
-    BLOSC_ERROR(b2nd_get_slice(&params_meta, array, src, start, stop));
+    copy_slice_chunk(slice, chunk, chunk_data);
 
-    // Copy vlmetayers
-    for (int i = 0; i < src->sc->nvlmetalayers; ++i) {
-      uint8_t *content;
-      int32_t content_len;
-      if (blosc2_vlmeta_get(src->sc, src->sc->vlmetalayers[i]->name, &content,
-                            &content_len) < 0) {
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+    if (set_slice) {
+      // Recompress the data
+      int32_t chunk_nbytes = data_nbytes + BLOSC2_MAX_OVERHEAD;
+      chunk_ = malloc(chunk_nbytes);
+      if (chunk_ == NULL) {
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        goto end;
+      }
+      int brc;
+      brc = blosc2_compress_ctx(array->sc->cctx, data, data_nbytes, chunk_, chunk_nbytes);
+      if (brc < 0) {
+        BLOSC_TRACE_ERROR("Blosc can not compress the data");
+        rc = BLOSC2_ERROR_FAILURE;
+        goto end;
+      }
+      int64_t brc_;
+      if (slice->append) {
+        brc_ = blosc2_schunk_append_chunk(array->sc, chunk_, false);
+      } else {
+        brc_ = blosc2_schunk_update_chunk(array->sc, nchunk, chunk_, false);
+      }
+      // The super-chunk took the chunk over
+      chunk_ = NULL;
+      if (brc_ < 0) {
+        BLOSC_TRACE_ERROR("Blosc can not update the chunk");
+        rc = BLOSC2_ERROR_FAILURE;
+        goto end;
       }
-      BLOSC_ERROR(blosc2_vlmeta_add((*array)->sc, src->sc->vlmetalayers[i]->name, content, content_len,
-                                      (*array)->sc->storage->cparams));
-      free(content);
     }
   }
+
+  end:
+  free(chunk_);
+  if (data != NULL) {
+    ctx_free(array->sc->dctx, data);
+  }
+  free(slice->chunks);
+  BLOSC_ERROR(rc);
+
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int b2nd_save(const b2nd_array_t *array, char *urlpath) {
+static int get_set_slice_strided(void *buffer, int64_t buffersize, const int64_t *start, const int64_t *stop,
+                                 const int64_t *shape, const int64_t *strides, b2nd_array_t *array,
+                                 bool set_slice) {
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(urlpath, BLOSC2_ERROR_NULL_POINTER);
-
-  b2nd_array_t *tmp;
-  blosc2_storage b2_storage = BLOSC2_STORAGE_DEFAULTS;
-  b2nd_context_t params = {.b2_storage=&b2_storage};
-  b2_storage.urlpath = urlpath;
-  b2_storage.contiguous = array->sc->storage->contiguous;
+  if (buffersize < 0) {
+    BLOSC_TRACE_ERROR("buffersize is < 0");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
 
-  for (int i = 0; i < array->ndim; ++i) {
-    params.chunkshape[i] = array->chunkshape[i];
-    params.blockshape[i] = array->blockshape[i];
+  uint8_t *buffer_b = (uint8_t *) buffer;
+
+  int8_t ndim = array->ndim;
+
+  // 0-dim case
+  if (ndim == 0) {
+    if (set_slice) {
+      int32_t chunk_size = array->sc->typesize + BLOSC2_MAX_OVERHEAD;
+      uint8_t *chunk = malloc(chunk_size);
+      BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+      if (blosc2_compress_ctx(array->sc->cctx, buffer_b, array->sc->typesize, chunk, chunk_size) < 0) {
+        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      }
+      if (blosc2_schunk_update_chunk(array->sc, 0, chunk, false) < 0) {
+        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      }
+
+    } else {
+      if (blosc2_schunk_decompress_chunk(array->sc, 0, buffer_b, array->sc->typesize) < 0) {
+        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      }
+    }
+    return BLOSC2_ERROR_SUCCESS;
   }
 
-  BLOSC_ERROR(b2nd_copy(&params, array, &tmp));
-  BLOSC_ERROR(b2nd_free(tmp));
+  slice_job_data slice = {.array = array, .buffer = buffer_b, .start = start, .stop = stop,
+                          .shape = shape, .strides = strides, .set_slice = set_slice};
+  BLOSC_ERROR(process_slice(&slice));
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int b2nd_print_meta(const b2nd_array_t *array) {
+
+int get_set_slice(void *buffer, int64_t buffersize, const int64_t *start, const int64_t *stop,
+                  const int64_t *shape, b2nd_array_t *array, bool set_slice) {
+  return get_set_slice_strided(buffer, buffersize, start, stop, shape, NULL, array, set_slice);
+}
+
+
+int b2nd_get_slice_cbuffer(const b2nd_array_t *array, const int64_t *start, const int64_t *stop,
+                           void *buffer, const int64_t *buffershape, int64_t buffersize) {
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-  int8_t ndim;
-  int64_t shape[B2ND_MAX_DIM];
-  int32_t chunkshape[B2ND_MAX_DIM];
-  int32_t blockshape[B2ND_MAX_DIM];
-  char *dtype;
-  int8_t dtype_format;
-  uint8_t *smeta;
-  int32_t smeta_len;
-  if (blosc2_meta_get(array->sc, "b2nd", &smeta, &smeta_len) < 0) {
-    // Try with a caterva metalayer; we are meant to be backward compatible with it
-    if (blosc2_meta_get(array->sc, "caterva", &smeta, &smeta_len) < 0) {
-      BLOSC_ERROR(BLOSC2_ERROR_METALAYER_NOT_FOUND);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffershape, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+
+  int64_t size = array->sc->typesize;
+  for (int i = 0; i < array->ndim; ++i) {
+    if (stop[i] - start[i] > buffershape[i]) {
+      BLOSC_TRACE_ERROR("The buffer shape can not be smaller than the slice shape");
+      return BLOSC2_ERROR_INVALID_PARAM;
     }
+    size *= buffershape[i];
   }
-  BLOSC_ERROR(b2nd_deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape,
-                                    &dtype, &dtype_format));
-  free(smeta);
 
-  printf("b2nd metalayer parameters:\n Ndim:       %d", ndim);
-  printf("\n shape:      %" PRId64 "", shape[0]);
-  for (int i = 1; i < ndim; ++i) {
-    printf(", %" PRId64 "", shape[i]);
-  }
-  printf("\n chunkshape: %d", chunkshape[0]);
-  for (int i = 1; i < ndim; ++i) {
-    printf(", %d", chunkshape[i]);
-  }
-  if (dtype != NULL) {
-    printf("\n dtype: %s", dtype);
-    free(dtype);
+  if (array->nitems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
   }
 
-  printf("\n blockshape: %d", blockshape[0]);
-  for (int i = 1; i < ndim; ++i) {
-    printf(", %d", blockshape[i]);
+  if (buffersize < size) {
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
   }
-  printf("\n");
+  BLOSC_ERROR(get_set_slice(buffer, buffersize, start, stop, buffershape, (b2nd_array_t *)array, false));
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int extend_shape(b2nd_array_t *array, const int64_t *new_shape, const int64_t *start) {
+int b2nd_set_slice_cbuffer(const void *buffer, const int64_t *buffershape, int64_t buffersize,
+                           const int64_t *start, const int64_t *stop,
+                           b2nd_array_t *array) {
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(new_shape, BLOSC2_ERROR_NULL_POINTER);
 
-  int8_t ndim = array->ndim;
-  int64_t diffs_shape[B2ND_MAX_DIM];
-  int64_t diffs_sum = 0;
-  for (int i = 0; i < ndim; i++) {
-    diffs_shape[i] = new_shape[i] - array->shape[i];
-    diffs_sum += diffs_shape[i];
-    if (diffs_shape[i] < 0) {
-      BLOSC_TRACE_ERROR("The new shape must be greater than the old one");
-      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
-    }
-    if (array->shape[i] == 0) {
-      BLOSC_TRACE_ERROR("Cannot extend array with shape[%d] = 0", i);
-      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
-    }
+  int64_t size = array->sc->typesize;
+  for (int i = 0; i < array->ndim; ++i) {
+    size *= stop[i] - start[i];
   }
-  if (diffs_sum == 0) {
-    // Shapes are equal. Do nothing.
+
+  if (buffersize < size) {
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+
+  if (array->nitems == 0) {
     return BLOSC2_ERROR_SUCCESS;
   }
 
-  int64_t old_nchunks = array->sc->nchunks;
-  // aux array to keep old shapes
-  b2nd_array_t *aux = malloc(sizeof(b2nd_array_t));
-  BLOSC_ERROR_NULL(aux, BLOSC2_ERROR_MEMORY_ALLOC);
-  aux->sc = NULL;
-  BLOSC_ERROR(update_shape(aux, ndim, array->shape, array->chunkshape, array->blockshape));
+  BLOSC_ERROR(get_set_slice((void*)buffer, buffersize, start, stop, (int64_t *)buffershape, array, true));
+  BLOSC_ERROR(pyramid_update(array, start, stop));
 
-  BLOSC_ERROR(update_shape(array, ndim, new_shape, array->chunkshape, array->blockshape));
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  int64_t nchunks = array->extnitems / array->chunknitems;
-  int64_t nchunks_;
-  int64_t nchunk_ndim[B2ND_MAX_DIM];
-  blosc2_cparams *cparams;
-  BLOSC_ERROR(blosc2_schunk_get_cparams(array->sc, &cparams));
-  void *chunk;
-  int64_t csize;
-  if (nchunks != old_nchunks) {
-    if (start == NULL) {
-      start = aux->shape;
-    }
-    int64_t chunks_in_array[B2ND_MAX_DIM] = {0};
-    for (int i = 0; i < ndim; ++i) {
-      chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
-    }
-    for (int i = 0; i < nchunks; ++i) {
-      blosc2_unidim_to_multidim(ndim, chunks_in_array, i, nchunk_ndim);
-      for (int j = 0; j < ndim; ++j) {
-        if (start[j] <= (array->chunkshape[j] * nchunk_ndim[j])
-            && (array->chunkshape[j] * nchunk_ndim[j]) < (start[j] + new_shape[j] - aux->shape[j])) {
-          chunk = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
-          BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
-          csize = blosc2_chunk_zeros(*cparams, array->sc->chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
-          if (csize < 0) {
-            free(aux);
-            free(cparams);
-            BLOSC_TRACE_ERROR("Blosc error when creating a chunk");
-            return BLOSC2_ERROR_FAILURE;
-          }
-          nchunks_ = blosc2_schunk_insert_chunk(array->sc, i, chunk, false);
-          if (nchunks_ < 0) {
-            free(aux);
-            free(cparams);
-            BLOSC_TRACE_ERROR("Blosc error when inserting a chunk");
-            return BLOSC2_ERROR_FAILURE;
-          }
-          break;
-        }
-      }
-    }
+
+int b2nd_get_slice_cbuffer_strided(const b2nd_array_t *array, const int64_t *start, const int64_t *stop,
+                                   void *buffer, const int64_t *bufferstrides) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(bufferstrides, BLOSC2_ERROR_NULL_POINTER);
+
+  if (array->nitems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
   }
-  free(aux);
-  free(cparams);
+
+  BLOSC_ERROR(get_set_slice_strided(buffer, 0, start, stop, NULL, bufferstrides, (b2nd_array_t *)array, false));
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int shrink_shape(b2nd_array_t *array, const int64_t *new_shape, const int64_t *start) {
+int b2nd_get_slice_cbuffer_step(const b2nd_array_t *array, const int64_t *start, const int64_t *stop,
+                                const int64_t *step, void *buffer, const int64_t *buffershape,
+                                int64_t buffersize) {
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(new_shape, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(step, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffershape, BLOSC2_ERROR_NULL_POINTER);
 
-  int8_t ndim = array->ndim;
-  int64_t diffs_shape[B2ND_MAX_DIM];
-  int64_t diffs_sum = 0;
-  for (int i = 0; i < ndim; i++) {
-    diffs_shape[i] = new_shape[i] - array->shape[i];
-    diffs_sum += diffs_shape[i];
-    if (diffs_shape[i] > 0) {
-      BLOSC_TRACE_ERROR("The new shape must be smaller than the old one");
-      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  int64_t size = array->sc->typesize;
+  for (int i = 0; i < array->ndim; ++i) {
+    if (step[i] < 1 || stop[i] < start[i]) {
+      BLOSC_TRACE_ERROR("The steps must be positive, and the slice cannot stop before it starts");
+      return BLOSC2_ERROR_INVALID_PARAM;
     }
-    if (array->shape[i] == 0) {
-      BLOSC_TRACE_ERROR("Cannot shrink array with shape[%d] = 0", i);
-      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    if ((stop[i] - start[i] + step[i] - 1) / step[i] > buffershape[i]) {
+      BLOSC_TRACE_ERROR("The buffer shape can not be smaller than the slice shape");
+      return BLOSC2_ERROR_INVALID_PARAM;
     }
+    size *= buffershape[i];
   }
-  if (diffs_sum == 0) {
-    // Shapes are equal. Do nothing.
+
+  if (array->nitems == 0) {
     return BLOSC2_ERROR_SUCCESS;
   }
 
-  int64_t old_nchunks = array->sc->nchunks;
-  // aux array to keep old shapes
-  b2nd_array_t *aux = malloc(sizeof(b2nd_array_t));
-  BLOSC_ERROR_NULL(aux, BLOSC2_ERROR_MEMORY_ALLOC);
-  aux->sc = NULL;
-  BLOSC_ERROR(update_shape(aux, ndim, array->shape, array->chunkshape, array->blockshape));
-
-  BLOSC_ERROR(update_shape(array, ndim, new_shape, array->chunkshape, array->blockshape));
-
-  // Delete chunks if needed
-  int64_t chunks_in_array_old[B2ND_MAX_DIM] = {0};
-  for (int i = 0; i < ndim; ++i) {
-    chunks_in_array_old[i] = aux->extshape[i] / aux->chunkshape[i];
+  if (buffersize < size) {
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
   }
-  if (start == NULL) {
-    start = new_shape;
+  if (array->ndim == 0) {
+    return get_set_slice(buffer, buffersize, start, stop, buffershape, (b2nd_array_t *)array, false);
   }
-
-  int64_t nchunk_ndim[B2ND_MAX_DIM] = {0};
-  int64_t nchunks_;
-  for (int i = (int) old_nchunks - 1; i >= 0; --i) {
-    blosc2_unidim_to_multidim(ndim, chunks_in_array_old, i, nchunk_ndim);
-    for (int j = 0; j < ndim; ++j) {
-      if (start[j] <= (array->chunkshape[j] * nchunk_ndim[j])
-          && (array->chunkshape[j] * nchunk_ndim[j]) < (start[j] + aux->shape[j] - new_shape[j])) {
-        nchunks_ = blosc2_schunk_delete_chunk(array->sc, i);
-        if (nchunks_ < 0) {
-          free(aux);
-          BLOSC_TRACE_ERROR("Blosc error when deleting a chunk");
-          return BLOSC2_ERROR_FAILURE;
-        }
-        break;
-      }
+  for (int i = 0; i < array->ndim; ++i) {
+    if (stop[i] == start[i]) {
+      return BLOSC2_ERROR_SUCCESS;
     }
   }
-  free(aux);
+  slice_job_data slice = {.array = (b2nd_array_t *)array, .buffer = buffer, .start = start, .stop = stop,
+                          .shape = buffershape, .steps = step, .set_slice = false};
+  BLOSC_ERROR(process_slice(&slice));
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int b2nd_resize(b2nd_array_t *array, const int64_t *new_shape,
-                const int64_t *start) {
-  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(new_shape, BLOSC2_ERROR_NULL_POINTER);
-
-  if (start != NULL) {
-    for (int i = 0; i < array->ndim; ++i) {
-      if (start[i] > array->shape[i]) {
-        BLOSC_TRACE_ERROR("`start` must be lower or equal than old array shape in all dims");
-        BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
-      }
-      if ((new_shape[i] > array->shape[i] && start[i] != array->shape[i])
-          || (new_shape[i] < array->shape[i]
-              && (start[i] + array->shape[i] - new_shape[i]) != array->shape[i])) {
-        // Chunks cannot be cut unless they are in the last position
-        if (start[i] % array->chunkshape[i] != 0) {
-          BLOSC_TRACE_ERROR("If array end is not being modified "
-                              "`start` must be a multiple of chunkshape in all dims");
-          BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
-        }
-        if ((new_shape[i] - array->shape[i]) % array->chunkshape[i] != 0) {
-          BLOSC_TRACE_ERROR("If array end is not being modified "
-                              "`(new_shape - shape)` must be multiple of chunkshape in all dims");
-          BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
-        }
-      }
+/* Get the strides of a C-ordered buffer whose dimensions are the ones of the slice in the order of axes */
+static int get_permuted_strides(const b2nd_array_t *array, const int64_t *start, const int64_t *stop,
+                                const int8_t *axes, int64_t *strides, int64_t *nbytes) {
+  int8_t ndim = array->ndim;
+  bool seen[B2ND_MAX_DIM] = {false};
+  for (int i = 0; i < ndim; ++i) {
+    if (axes[i] < 0 || axes[i] >= ndim || seen[axes[i]]) {
+      BLOSC_TRACE_ERROR("The axes are not a permutation of the dimensions of the array");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
     }
-  }
-
-  // Get shrunk shape
-  int64_t shrunk_shape[B2ND_MAX_DIM] = {0};
-  for (int i = 0; i < array->ndim; ++i) {
-    if (new_shape[i] <= array->shape[i]) {
-      shrunk_shape[i] = new_shape[i];
-    } else {
-      shrunk_shape[i] = array->shape[i];
+    seen[axes[i]] = true;
+    if (stop[axes[i]] < start[axes[i]]) {
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
     }
   }
 
-  BLOSC_ERROR(shrink_shape(array, shrunk_shape, start));
-  BLOSC_ERROR(extend_shape(array, new_shape, start));
+  *nbytes = array->sc->typesize;
+  for (int i = ndim - 1; i >= 0; --i) {
+    strides[axes[i]] = *nbytes;
+    *nbytes *= stop[axes[i]] - start[axes[i]];
+  }
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int b2nd_insert(b2nd_array_t *array, const void *buffer, int64_t buffersize,
-                int8_t axis, int64_t insert_start) {
-
+int b2nd_get_slice_cbuffer_permuted(const b2nd_array_t *array, const int64_t *start, const int64_t *stop,
+                                    const int8_t *axes, void *buffer, int64_t buffersize) {
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(axes, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
 
-  if (axis >= array->ndim) {
-    BLOSC_TRACE_ERROR("`axis` cannot be greater than the number of dimensions");
-    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
-  }
-
-  int64_t axis_size = array->sc->typesize;
-  int64_t buffershape[B2ND_MAX_DIM];
-  for (int i = 0; i < array->ndim; ++i) {
-    if (i != axis) {
-      axis_size *= array->shape[i];
-      buffershape[i] = array->shape[i];
-    }
-  }
-  if (buffersize % axis_size != 0) {
-    BLOSC_TRACE_ERROR("`buffersize` must be multiple of the array");
+  int64_t strides[B2ND_MAX_DIM];
+  int64_t nbytes;
+  BLOSC_ERROR(get_permuted_strides(array, start, stop, axes, strides, &nbytes));
+  if (buffersize < nbytes) {
     BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
   }
-  int64_t newshape[B2ND_MAX_DIM];
-  memcpy(newshape, array->shape, array->ndim * sizeof(int64_t));
-  newshape[axis] += buffersize / axis_size;
-  buffershape[axis] = newshape[axis] - array->shape[axis];
-  int64_t start[B2ND_MAX_DIM] = {0};
-  start[axis] = insert_start;
-
-  if (insert_start == array->shape[axis]) {
-    BLOSC_ERROR(b2nd_resize(array, newshape, NULL));
-  } else {
-    BLOSC_ERROR(b2nd_resize(array, newshape, start));
+  if (nbytes == 0) {
+    return BLOSC2_ERROR_SUCCESS;
   }
 
-  int64_t stop[B2ND_MAX_DIM];
-  memcpy(stop, array->shape, sizeof(int64_t) * array->ndim);
-  stop[axis] = start[axis] + buffershape[axis];
-  BLOSC_ERROR(b2nd_set_slice_cbuffer(buffer, buffershape, buffersize, start, stop, array));
+  BLOSC_ERROR(get_set_slice_strided(buffer, buffersize, start, stop, NULL, strides, (b2nd_array_t *)array, false));
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int b2nd_append(b2nd_array_t *array, const void *buffer, int64_t buffersize,
-                int8_t axis) {
+int b2nd_to_cbuffer_permuted(const b2nd_array_t *array, const int8_t *axes, void *buffer, int64_t buffersize) {
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+
+  int64_t start[B2ND_MAX_DIM] = {0};
+  BLOSC_ERROR(b2nd_get_slice_cbuffer_permuted(array, start, array->shape, axes, buffer, buffersize));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_set_slice_cbuffer_strided(const void *buffer, const int64_t *bufferstrides,
+                                   const int64_t *start, const int64_t *stop, b2nd_array_t *array) {
   BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(bufferstrides, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
-  BLOSC_ERROR(b2nd_insert(array, buffer, buffersize, axis, array->shape[axis]));
+  if (array->nitems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  BLOSC_ERROR(get_set_slice_strided((void*)buffer, 0, start, stop, NULL, bufferstrides, array, true));
+  BLOSC_ERROR(pyramid_update(array, start, stop));
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int b2nd_delete(b2nd_array_t *array, const int8_t axis,
-                int64_t delete_start, int64_t delete_len) {
+int b2nd_get_slice(b2nd_context_t *ctx, b2nd_array_t **array, const b2nd_array_t *src, const int64_t *start,
+                   const int64_t *stop) {
+  BLOSC_ERROR_NULL(src, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
-  if (axis >= array->ndim) {
-    BLOSC_TRACE_ERROR("axis cannot be greater than the number of dimensions");
-    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  ctx->ndim = src->ndim;
+  for (int i = 0; i < src->ndim; ++i) {
+    ctx->shape[i] = stop[i] - start[i];
   }
 
+  // Add data
+  BLOSC_ERROR(b2nd_empty(ctx, array));
 
-  int64_t newshape[B2ND_MAX_DIM];
-  memcpy(newshape, array->shape, array->ndim * sizeof(int64_t));
-  newshape[axis] -= delete_len;
-  int64_t start[B2ND_MAX_DIM] = {0};
-  start[axis] = delete_start;
+  if ((*array)->nitems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
 
-  if (delete_start == (array->shape[axis] - delete_len)) {
-    BLOSC_ERROR(b2nd_resize(array, newshape, NULL));
-  } else {
-    BLOSC_ERROR(b2nd_resize(array, newshape, start));
+  int8_t ndim = (*array)->ndim;
+  int64_t chunks_in_array[B2ND_MAX_DIM] = {0};
+  for (int i = 0; i < ndim; ++i) {
+    chunks_in_array[i] = (*array)->extshape[i] / (*array)->chunkshape[i];
+  }
+  int64_t nchunks = (*array)->sc->nchunks;
+  for (int nchunk = 0; nchunk < nchunks; ++nchunk) {
+    int64_t nchunk_ndim[B2ND_MAX_DIM] = {0};
+    blosc2_unidim_to_multidim(ndim, chunks_in_array, nchunk, nchunk_ndim);
+
+    // Check if the chunk needs to be updated
+    int64_t chunk_start[B2ND_MAX_DIM] = {0};
+    int64_t chunk_stop[B2ND_MAX_DIM] = {0};
+    int64_t chunk_shape[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      chunk_start[i] = nchunk_ndim[i] * (*array)->chunkshape[i];
+      chunk_stop[i] = chunk_start[i] + (*array)->chunkshape[i];
+      if (chunk_stop[i] > (*array)->shape[i]) {
+        chunk_stop[i] = (*array)->shape[i];
+      }
+      chunk_shape[i] = chunk_stop[i] - chunk_start[i];
+    }
+
+    int64_t src_start[B2ND_MAX_DIM] = {0};
+    int64_t src_stop[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      src_start[i] = chunk_start[i] + start[i];
+      src_stop[i] = chunk_stop[i] + start[i];
+    }
+    int64_t buffersize = ctx->b2_storage->cparams->typesize;
+    for (int i = 0; i < ndim; ++i) {
+      buffersize *= chunk_shape[i];
+    }
+    uint8_t *buffer = malloc(buffersize);
+    BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+    BLOSC_ERROR(b2nd_get_slice_cbuffer(src, src_start, src_stop, buffer, chunk_shape,
+                                       buffersize));
+    BLOSC_ERROR(b2nd_set_slice_cbuffer(buffer, chunk_shape, buffersize, chunk_start,
+                                       chunk_stop, *array));
+    free(buffer);
   }
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
-// Indexing
 
-typedef struct {
-    int64_t value;
-    int64_t index;
-} b2nd_selection_t;
+int b2nd_squeeze(b2nd_array_t *array) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
+  bool index[B2ND_MAX_DIM];
 
-int compare_selection(const void *a, const void *b) {
-  int res = (int) (((b2nd_selection_t *) a)->value - ((b2nd_selection_t *) b)->value);
-  // In case values are equal, sort by index
-  if (res == 0) {
-    res = (int) (((b2nd_selection_t *) a)->index - ((b2nd_selection_t *) b)->index);
+  for (int i = 0; i < array->ndim; ++i) {
+    if (array->shape[i] != 1) {
+      index[i] = false;
+    } else {
+      index[i] = true;
+    }
   }
-  return res;
+  BLOSC_ERROR(b2nd_squeeze_index(array, index));
+
+  return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int copy_block_buffer_data(b2nd_array_t *array,
-                           int8_t ndim,
-                           int64_t *block_selection_size,
-                           b2nd_selection_t **chunk_selection,
-                           b2nd_selection_t **p_block_selection_0,
-                           b2nd_selection_t **p_block_selection_1,
-                           uint8_t *block,
-                           uint8_t *buffer,
-                           int64_t *buffershape,
-                           int64_t *bufferstrides,
-                           bool get) {
-  p_block_selection_0[ndim] = chunk_selection[ndim];
-  p_block_selection_1[ndim] = chunk_selection[ndim];
-  while (p_block_selection_1[ndim] - p_block_selection_0[ndim] < block_selection_size[ndim]) {
-    if (ndim == array->ndim - 1) {
+int b2nd_squeeze_index(b2nd_array_t *array, const bool *index) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
 
-      int64_t index_in_block_n[B2ND_MAX_DIM];
-      for (int i = 0; i < array->ndim; ++i) {
-        index_in_block_n[i] = p_block_selection_1[i]->value % array->chunkshape[i] % array->blockshape[i];
-      }
-      int64_t index_in_block = 0;
-      for (int i = 0; i < array->ndim; ++i) {
-        index_in_block += index_in_block_n[i] * array->item_block_strides[i];
-      }
+  uint8_t nones = 0;
+  int64_t newshape[B2ND_MAX_DIM];
+  int32_t newchunkshape[B2ND_MAX_DIM];
+  int32_t newblockshape[B2ND_MAX_DIM];
 
-      int64_t index_in_buffer_n[B2ND_MAX_DIM];
-      for (int i = 0; i < array->ndim; ++i) {
-        index_in_buffer_n[i] = p_block_selection_1[i]->index;
-      }
-      int64_t index_in_buffer = 0;
-      for (int i = 0; i < array->ndim; ++i) {
-        index_in_buffer += index_in_buffer_n[i] * bufferstrides[i];
-      }
-      if (get) {
-        memcpy(&buffer[index_in_buffer * array->sc->typesize],
-               &block[index_in_block * array->sc->typesize],
-               array->sc->typesize);
-      } else {
-        memcpy(&block[index_in_block * array->sc->typesize],
-               &buffer[index_in_buffer * array->sc->typesize],
-               array->sc->typesize);
+  for (int i = 0; i < array->ndim; ++i) {
+    if (index[i] == true) {
+      if (array->shape[i] != 1) {
+        BLOSC_ERROR(BLOSC2_ERROR_INVALID_INDEX);
       }
     } else {
-      BLOSC_ERROR(copy_block_buffer_data(array, (int8_t) (ndim + 1), block_selection_size,
-                                         chunk_selection,
-                                         p_block_selection_0, p_block_selection_1, block,
-                                         buffer, buffershape, bufferstrides, get)
-      );
+      newshape[nones] = array->shape[i];
+      newchunkshape[nones] = array->chunkshape[i];
+      newblockshape[nones] = array->blockshape[i];
+      nones += 1;
+    }
+  }
+
+  for (int i = 0; i < B2ND_MAX_DIM; ++i) {
+    if (i < nones) {
+      array->chunkshape[i] = newchunkshape[i];
+      array->blockshape[i] = newblockshape[i];
+    } else {
+      array->chunkshape[i] = 1;
+      array->blockshape[i] = 1;
     }
-    p_block_selection_1[ndim]++;
   }
+
+  BLOSC_ERROR(update_shape(array, nones, newshape, newchunkshape, newblockshape));
+
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int iter_block_copy(b2nd_array_t *array, int8_t ndim,
-                    int64_t *chunk_selection_size,
-                    b2nd_selection_t **ordered_selection,
-                    b2nd_selection_t **chunk_selection_0,
-                    b2nd_selection_t **chunk_selection_1,
-                    uint8_t *data,
-                    uint8_t *buffer,
-                    int64_t *buffershape,
-                    int64_t *bufferstrides,
-                    bool get) {
-  chunk_selection_0[ndim] = ordered_selection[ndim];
-  chunk_selection_1[ndim] = ordered_selection[ndim];
-  while (chunk_selection_1[ndim] - ordered_selection[ndim] < chunk_selection_size[ndim]) {
-    int64_t block_index_ndim = ((*chunk_selection_1[ndim]).value % array->chunkshape[ndim]) / array->blockshape[ndim];
-    while (chunk_selection_1[ndim] - ordered_selection[ndim] < chunk_selection_size[ndim] &&
-           block_index_ndim == ((*chunk_selection_1[ndim]).value % array->chunkshape[ndim]) / array->blockshape[ndim]) {
-      chunk_selection_1[ndim]++;
-    }
-    if (ndim == array->ndim - 1) {
-      int64_t block_chunk_strides[B2ND_MAX_DIM];
-      block_chunk_strides[array->ndim - 1] = 1;
+static int64_t gcd64(int64_t a, int64_t b) {
+  while (b != 0) {
+    int64_t r = a % b;
+    a = b;
+    b = r;
+  }
+  return a;
+}
+
+/* The size of the items of `array` in a region (clipped by the shape) */
+static int64_t region_size(const b2nd_array_t *array, const int64_t *region) {
+  int64_t size = array->sc->typesize;
+  for (int i = 0; i < array->ndim; ++i) {
+    size *= region[i] < array->shape[i] ? region[i] : array->shape[i];
+  }
+  return size;
+}
+
+/* Grow a region by whole multiples of itself, from the last dimension on (the one with
+ * contiguous items), while it takes less than `max_mem` bytes */
+static void grow_region(const b2nd_array_t *array, int64_t *region, int64_t max_mem) {
+  int64_t size = region_size(array, region);
+  for (int i = array->ndim - 1; i >= 0; --i) {
+    int64_t nregions = (array->shape[i] + region[i] - 1) / region[i];
+    int64_t factor = max_mem / size;
+    if (factor > nregions) {
+      factor = nregions;
+    }
+    if (factor > 1) {
+      region[i] *= factor;
+      size = region_size(array, region);
+    }
+    if (factor < nregions) {
+      break;
+    }
+  }
+}
+
+/* Whether the chunks of `array` in a region are all made of zeros (and have no items to be read) */
+static bool region_is_zeros(const b2nd_array_t *array, const int64_t *start, const int64_t *stop) {
+  slice_chunk *chunks;
+  int64_t nchunks = get_slice_chunks((b2nd_array_t *) array, start, stop, &chunks);
+  if (nchunks < 0) {
+    return false;
+  }
+  bool zeros = true;
+  for (int64_t i = 0; i < nchunks && zeros; ++i) {
+    blosc2_chunk_info info;
+    zeros = blosc2_schunk_get_chunk_info(array->sc, chunks[i].nchunk, &info) >= 0 &&
+            info.special == BLOSC2_SPECIAL_ZERO;
+  }
+  free(chunks);
+  return zeros;
+}
+
+/* Copy the items of `src` into `array` a region at a time.  The regions must be multiples of
+ * the chunks of both, so that every chunk of `src` is decompressed once, and the chunks of
+ * `array` are compressed with no previous decompression. */
+static int rechunk_pass(const b2nd_array_t *src, b2nd_array_t *array, const int64_t *region) {
+  int8_t ndim = src->ndim;
+  int64_t nregions[B2ND_MAX_DIM];
+  int64_t total = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nregions[i] = (src->shape[i] + region[i] - 1) / region[i];
+    total *= nregions[i];
+  }
+  uint8_t *buffer = malloc(region_size(src, region));
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  int64_t coords[B2ND_MAX_DIM];
+  for (int64_t nregion = 0; nregion < total && rc >= 0; ++nregion) {
+    blosc2_unidim_to_multidim(ndim, nregions, nregion, coords);
+    int64_t start[B2ND_MAX_DIM];
+    int64_t stop[B2ND_MAX_DIM];
+    int64_t shape[B2ND_MAX_DIM];
+    int64_t size = src->sc->typesize;
+    for (int i = 0; i < ndim; ++i) {
+      start[i] = coords[i] * region[i];
+      stop[i] = start[i] + region[i] < src->shape[i] ? start[i] + region[i] : src->shape[i];
+      shape[i] = stop[i] - start[i];
+      size *= shape[i];
+    }
+    // The chunks of `array` start as zeros, so the sparse regions of `src` are left alone
+    if (region_is_zeros(src, start, stop)) {
+      continue;
+    }
+    rc = b2nd_get_slice_cbuffer(src, start, stop, buffer, shape, size);
+    if (rc >= 0) {
+      rc = b2nd_set_slice_cbuffer(buffer, shape, size, start, stop, array);
+    }
+  }
+  free(buffer);
+  return rc;
+}
+
+/* Copy the items of `src` into a new array with the chunks of `ctx`, with at most `max_mem`
+ * bytes of items in flight (but for a chunk of each array, which is the least) */
+static int rechunk(b2nd_context_t *ctx, const b2nd_array_t *src, int64_t max_mem, const char *tmp_urlpath,
+                   b2nd_array_t **array) {
+  int8_t ndim = src->ndim;
+  BLOSC_ERROR(b2nd_empty(ctx, array));
+  if ((*array)->nitems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  // The smallest regions with whole chunks of both arrays
+  int64_t region[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    region[i] = src->chunkshape[i] / gcd64(src->chunkshape[i], ctx->chunkshape[i]) * ctx->chunkshape[i];
+  }
+  if (region_size(src, region) <= max_mem) {
+    grow_region(src, region, max_mem);
+    int rc = rechunk_pass(src, *array, region);
+    if (rc < 0) {
+      b2nd_free(*array);
+      *array = NULL;
+    }
+    return rc;
+  }
+
+  // Else the items go through an intermediate array, with chunks that divide both the regions
+  // read from `src` and the ones written to `array` (each fitting in `max_mem` on its own)
+  int64_t read[B2ND_MAX_DIM];
+  int64_t write[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    read[i] = src->chunkshape[i];
+    write[i] = ctx->chunkshape[i];
+  }
+  grow_region(src, read, max_mem);
+  grow_region(*array, write, max_mem);
+  for (int i = 0; i < ndim; ++i) {
+    int64_t chunkitems = gcd64(read[i], write[i]);
+    // A chunk past the shape is in a single region of both
+    chunkshape[i] = (int32_t) (chunkitems < src->shape[i] ? chunkitems : src->shape[i]);
+    blockshape[i] = chunkshape[i] < ctx->blockshape[i] ? chunkshape[i] : ctx->blockshape[i];
+  }
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = src->sc->typesize;
+  cparams.clevel = 1;
+  cparams.nthreads = (*array)->sc->storage->cparams->nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = cparams.nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .contiguous=true,
+                            .urlpath=(char *) tmp_urlpath};
+  blosc2_remove_urlpath(tmp_urlpath);
+  b2nd_context_t *tmp_ctx = b2nd_create_ctx(&storage, ndim, src->shape, chunkshape, blockshape,
+                                            NULL, 0, NULL, 0);
+  b2nd_array_t *tmp = NULL;
+  int rc = tmp_ctx == NULL ? BLOSC2_ERROR_FAILURE : b2nd_empty(tmp_ctx, &tmp);
+  if (rc >= 0) {
+    rc = rechunk_pass(src, tmp, read);
+  }
+  if (rc >= 0) {
+    rc = rechunk_pass(tmp, *array, write);
+  }
+  if (tmp != NULL) {
+    b2nd_free(tmp);
+  }
+  if (tmp_ctx != NULL) {
+    b2nd_free_ctx(tmp_ctx);
+  }
+  blosc2_remove_urlpath(tmp_urlpath);
+  if (rc < 0) {
+    b2nd_free(*array);
+    *array = NULL;
+  }
+  return rc;
+}
+
+static int copy_array(b2nd_context_t *ctx, const b2nd_array_t *src, int64_t max_mem, const char *tmp_urlpath,
+                      b2nd_array_t **array) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(src, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+
+  // The chunks in the write cache have to be in the super-chunk
+  BLOSC_ERROR(b2nd_flush((b2nd_array_t *) src));
+
+  ctx->ndim = src->ndim;
+
+  for (int i = 0; i < src->ndim; ++i) {
+    ctx->shape[i] = src->shape[i];
+  }
+
+  // The b2nd metalayer of a copy of the super-chunk is the one of the source
+  bool equals = ctx->chunk_order == src->chunk_order;
+  for (int i = 0; i < src->ndim; ++i) {
+    if (src->chunkshape[i] != ctx->chunkshape[i]) {
+      equals = false;
+      break;
+    }
+    if (src->blockshape[i] != ctx->blockshape[i]) {
+      equals = false;
+      break;
+    }
+  }
+
+  if (equals) {
+    BLOSC_ERROR(array_without_schunk(ctx, array));
+
+    blosc2_schunk *new_sc = blosc2_schunk_copy(src->sc, ctx->b2_storage);
+
+    if (new_sc == NULL) {
+      return BLOSC2_ERROR_FAILURE;
+    }
+    (*array)->sc = new_sc;
+    if (curve_order(*array)) {
+      // They are copied in the C order
+      BLOSC_ERROR(b2nd_reorder_chunks(*array));
+    }
+
+  } else {
+    // Copy metalayers
+    b2nd_context_t params_meta;
+    memcpy(&params_meta, ctx, sizeof(params_meta));
+    int j = 0;
+
+    for (int i = 0; i < src->sc->nmetalayers; ++i) {
+      if (strcmp(src->sc->metalayers[i]->name, "b2nd") == 0) {
+        continue;
+      }
+      blosc2_metalayer *meta = &params_meta.metalayers[j];
+      meta->name = src->sc->metalayers[i]->name;
+      meta->content = src->sc->metalayers[i]->content;
+      meta->content_len = src->sc->metalayers[i]->content_len;
+      j++;
+    }
+    params_meta.nmetalayers = j;
+
+    // Copy data
+    BLOSC_ERROR(rechunk(&params_meta, src, max_mem, tmp_urlpath, array));
+
+    // Copy vlmetayers
+    for (int i = 0; i < src->sc->nvlmetalayers; ++i) {
+      uint8_t *content;
+      int32_t content_len;
+      if (blosc2_vlmeta_get(src->sc, src->sc->vlmetalayers[i]->name, &content,
+                            &content_len) < 0) {
+        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      }
+      BLOSC_ERROR(blosc2_vlmeta_add((*array)->sc, src->sc->vlmetalayers[i]->name, content, content_len,
+                                      (*array)->sc->storage->cparams));
+      free(content);
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_copy(b2nd_context_t *ctx, const b2nd_array_t *src, b2nd_array_t **array) {
+  return copy_array(ctx, src, B2ND_DEFAULT_RECHUNK_MEM, NULL, array);
+}
+
+
+int b2nd_rechunk(b2nd_context_t *ctx, const b2nd_array_t *src, int64_t max_mem, const char *tmp_urlpath,
+                 b2nd_array_t **array) {
+  if (max_mem <= 0) {
+    BLOSC_TRACE_ERROR("`max_mem` must be positive");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  return copy_array(ctx, src, max_mem, tmp_urlpath, array);
+}
+
+
+/* Whether a chunk is made of a value repeated (and holds no compressed items) */
+static bool is_fill_chunk(const b2nd_array_t *array, int64_t nchunk, int *rc) {
+  blosc2_chunk_info info;
+  *rc = blosc2_schunk_get_chunk_info(array->sc, nchunk, &info);
+  return *rc >= 0 && info.special != BLOSC2_NO_SPECIAL && info.special != BLOSC2_SPECIAL_VIRTUAL;
+}
+
+/* The region of the items of a chunk (clipped by the shape).  Returns the number of them. */
+static int64_t chunk_region(const b2nd_array_t *array, int64_t nchunk, int64_t *start, int64_t *stop) {
+  int64_t chunks_in_array[B2ND_MAX_DIM];
+  for (int i = 0; i < array->ndim; ++i) {
+    chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
+  }
+  int64_t coords[B2ND_MAX_DIM];
+  blosc2_unidim_to_multidim(array->ndim, chunks_in_array, nchunk, coords);
+  int64_t nitems = 1;
+  for (int i = 0; i < array->ndim; ++i) {
+    start[i] = coords[i] * array->chunkshape[i];
+    stop[i] = start[i] + array->chunkshape[i] < array->shape[i] ? start[i] + array->chunkshape[i] : array->shape[i];
+    nitems *= stop[i] - start[i];
+  }
+  return nitems;
+}
+
+
+int b2nd_count_fill(const b2nd_array_t *array, int64_t *nfill_chunks, int64_t *nfill_items) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(nfill_chunks, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(nfill_items, BLOSC2_ERROR_NULL_POINTER);
+
+  // The chunks in the write cache have to be in the super-chunk
+  BLOSC_ERROR(b2nd_flush((b2nd_array_t *) array));
+
+  *nfill_chunks = 0;
+  *nfill_items = 0;
+  if (array->nitems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // Only the headers are read, a batch of chunks at a time
+  enum { BATCH = 1024 };
+  blosc2_chunk_info *info = malloc(BATCH * sizeof(blosc2_chunk_info));
+  BLOSC_ERROR_NULL(info, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int64_t nchunk = 0; nchunk < array->sc->nchunks && rc >= 0; nchunk += BATCH) {
+    int64_t stop = nchunk + BATCH < array->sc->nchunks ? nchunk + BATCH : array->sc->nchunks;
+    rc = blosc2_schunk_get_chunks_info(array->sc, nchunk, stop, info);
+    for (int64_t i = nchunk; i < stop && rc >= 0; ++i) {
+      int special = info[i - nchunk].special;
+      if (special != BLOSC2_NO_SPECIAL && special != BLOSC2_SPECIAL_VIRTUAL) {
+        int64_t start_[B2ND_MAX_DIM];
+        int64_t stop_[B2ND_MAX_DIM];
+        (*nfill_chunks)++;
+        *nfill_items += chunk_region(array, i, start_, stop_);
+      }
+    }
+  }
+  free(info);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+struct b2nd_sparse_iter_s {
+  const b2nd_array_t *array;
+  int64_t nchunk;  // the next chunk to look at
+  uint8_t *data;   // the items of the last chunk, in C order
+};
+
+int b2nd_sparse_iter_new(const b2nd_array_t *array, b2nd_sparse_iter_t **iter) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(iter, BLOSC2_ERROR_NULL_POINTER);
+
+  // The chunks in the write cache have to be in the super-chunk
+  BLOSC_ERROR(b2nd_flush((b2nd_array_t *) array));
+
+  *iter = calloc(1, sizeof(b2nd_sparse_iter_t));
+  BLOSC_ERROR_NULL(*iter, BLOSC2_ERROR_MEMORY_ALLOC);
+  (*iter)->array = array;
+  (*iter)->data = malloc(array->chunknitems * array->sc->typesize);
+  if ((*iter)->data == NULL) {
+    free(*iter);
+    *iter = NULL;
+    BLOSC_ERROR(BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+int b2nd_sparse_iter_next(b2nd_sparse_iter_t *iter, int64_t *start, int64_t *stop, void **data) {
+  BLOSC_ERROR_NULL(iter, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(data, BLOSC2_ERROR_NULL_POINTER);
+
+  const b2nd_array_t *array = iter->array;
+  if (array->nitems == 0) {
+    return 0;
+  }
+  int rc = BLOSC2_ERROR_SUCCESS;
+  while (iter->nchunk < array->sc->nchunks && is_fill_chunk(array, iter->nchunk, &rc)) {
+    iter->nchunk++;
+  }
+  BLOSC_ERROR(rc);
+  if (iter->nchunk == array->sc->nchunks) {
+    return 0;
+  }
+  int64_t nitems = chunk_region(array, iter->nchunk, start, stop);
+  int64_t shape[B2ND_MAX_DIM];
+  for (int i = 0; i < array->ndim; ++i) {
+    shape[i] = stop[i] - start[i];
+  }
+  BLOSC_ERROR(b2nd_get_slice_cbuffer(array, start, stop, iter->data, shape, nitems * array->sc->typesize));
+  iter->nchunk++;
+  *data = iter->data;
+  return 1;
+}
+
+int b2nd_sparse_iter_free(b2nd_sparse_iter_t *iter) {
+  if (iter != NULL) {
+    free(iter->data);
+    free(iter);
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+struct b2nd_block_iter_s {
+  const b2nd_array_t *array;
+  blosc2_context *dctx;    // for reading the next chunk ahead (NULL if it cannot be)
+  int64_t nchunk;          // the chunk in `data`
+  int64_t nblock;          // the next block of it
+  int64_t nblocks;         // in a chunk
+  int64_t blocks_in_chunk[B2ND_MAX_DIM];
+  uint8_t *data;           // the items of the chunk, block by block
+  uint8_t *next_data;      // the items of the next chunk, while they are decompressed
+  uint8_t *next_chunk;     // the next chunk (compressed)
+  bool next_needs_free;
+  blosc2_future *future;   // the decompression of the next chunk (NULL if there is none)
+};
+
+/* Start decompressing a chunk into `next_data` while the blocks of the current one are used */
+static int read_ahead_chunk(b2nd_block_iter_t *iter, int64_t nchunk) {
+  blosc2_schunk *sc = iter->array->sc;
+  if (iter->dctx == NULL || nchunk >= sc->nchunks) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int cbytes = blosc2_schunk_get_lazychunk(sc, nchunk, &iter->next_chunk, &iter->next_needs_free);
+  if (cbytes < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the chunk %" PRId64 ".", nchunk);
+    return cbytes;
+  }
+  int32_t nbytes = (int32_t) iter->array->extchunknitems * sc->typesize;
+  iter->future = blosc2_decompress_ctx_async(iter->dctx, iter->next_chunk, cbytes, iter->next_data, nbytes,
+                                             NULL, NULL);
+  if (iter->future == NULL) {
+    BLOSC_TRACE_ERROR("Cannot read the chunk %" PRId64 " ahead.", nchunk);
+    return BLOSC2_ERROR_FAILURE;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Wait for the chunk read ahead (if any) and release it.  Returns the decompression result. */
+static int end_read_ahead(b2nd_block_iter_t *iter) {
+  if (iter->future == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int rc = blosc2_future_free(iter->future);
+  iter->future = NULL;
+  if (iter->next_needs_free) {
+    free(iter->next_chunk);
+  }
+  iter->next_chunk = NULL;
+  return rc;
+}
+
+/* Make the following chunk the current one, and read the one after it ahead */
+static int next_chunk(b2nd_block_iter_t *iter) {
+  blosc2_schunk *sc = iter->array->sc;
+  int32_t nbytes = (int32_t) iter->array->extchunknitems * sc->typesize;
+  iter->nchunk++;
+  iter->nblock = 0;
+  if (iter->future != NULL) {
+    int rc = end_read_ahead(iter);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot decompress the chunk %" PRId64 ".", iter->nchunk);
+      return rc;
+    }
+    uint8_t *data = iter->data;
+    iter->data = iter->next_data;
+    iter->next_data = data;
+  }
+  else {
+    int rc = blosc2_schunk_decompress_chunk(sc, iter->nchunk, iter->data, nbytes);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot decompress the chunk %" PRId64 ".", iter->nchunk);
+      return rc;
+    }
+  }
+  return read_ahead_chunk(iter, iter->nchunk + 1);
+}
+
+
+int b2nd_iter_blocks(const b2nd_array_t *array, b2nd_block_iter_t **iter) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(iter, BLOSC2_ERROR_NULL_POINTER);
+
+  // The chunks in the write cache have to be in the super-chunk
+  BLOSC_ERROR(b2nd_flush((b2nd_array_t *) array));
+
+  b2nd_block_iter_t *it = calloc(1, sizeof(b2nd_block_iter_t));
+  BLOSC_ERROR_NULL(it, BLOSC2_ERROR_MEMORY_ALLOC);
+  it->array = array;
+  it->nchunk = -1;
+  it->nblocks = 1;
+  for (int i = 0; i < array->ndim; ++i) {
+    it->blocks_in_chunk[i] = array->extchunkshape[i] / array->blockshape[i];
+    it->nblocks *= it->blocks_in_chunk[i];
+  }
+  it->nblock = it->nblocks;
+  int64_t nbytes = array->extchunknitems * array->sc->typesize;
+  it->data = malloc(nbytes);
+  it->next_data = malloc(nbytes);
+  // Postfilters may depend on the current chunk, so the chunks are not read ahead with them
+  if (array->sc->dctx->postfilter == NULL) {
+    blosc2_dparams dparams;
+    blosc2_ctx_get_dparams(array->sc->dctx, &dparams);
+    it->dctx = blosc2_create_dctx(dparams);
+  }
+  int rc = BLOSC2_ERROR_MEMORY_ALLOC;
+  if (it->data != NULL && it->next_data != NULL) {
+    rc = array->nitems == 0 ? BLOSC2_ERROR_SUCCESS : read_ahead_chunk(it, 0);
+  }
+  if (rc < 0) {
+    b2nd_block_iter_free(it);
+    BLOSC_ERROR(rc);
+  }
+  *iter = it;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+int b2nd_block_iter_next(b2nd_block_iter_t *iter, int64_t *start, int64_t *stop, void **data) {
+  BLOSC_ERROR_NULL(iter, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(data, BLOSC2_ERROR_NULL_POINTER);
+
+  const b2nd_array_t *array = iter->array;
+  if (array->nitems == 0) {
+    return 0;
+  }
+  int64_t chunks_in_array[B2ND_MAX_DIM];
+  for (int i = 0; i < array->ndim; ++i) {
+    chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
+  }
+  while (true) {
+    if (iter->nblock == iter->nblocks) {
+      if (iter->nchunk + 1 >= array->sc->nchunks) {
+        return 0;
+      }
+      BLOSC_ERROR(next_chunk(iter));
+    }
+    int64_t chunk_coords[B2ND_MAX_DIM];
+    int64_t block_coords[B2ND_MAX_DIM];
+    blosc2_unidim_to_multidim(array->ndim, chunks_in_array, iter->nchunk, chunk_coords);
+    blosc2_unidim_to_multidim(array->ndim, iter->blocks_in_chunk, iter->nblock, block_coords);
+    int64_t nblock = iter->nblock++;
+    // The blocks in the padding of the chunk have no items
+    bool padding = false;
+    for (int i = 0; i < array->ndim; ++i) {
+      start[i] = chunk_coords[i] * array->chunkshape[i] + block_coords[i] * array->blockshape[i];
+      int64_t chunk_stop = (chunk_coords[i] + 1) * array->chunkshape[i];
+      if (chunk_stop > array->shape[i]) {
+        chunk_stop = array->shape[i];
+      }
+      stop[i] = start[i] + array->blockshape[i] < chunk_stop ? start[i] + array->blockshape[i] : chunk_stop;
+      padding |= start[i] >= stop[i];
+    }
+    if (!padding) {
+      *data = iter->data + nblock * array->blocknitems * array->sc->typesize;
+      return 1;
+    }
+  }
+}
+
+int b2nd_block_iter_free(b2nd_block_iter_t *iter) {
+  if (iter != NULL) {
+    end_read_ahead(iter);
+    if (iter->dctx != NULL) {
+      blosc2_free_ctx(iter->dctx);
+    }
+    free(iter->data);
+    free(iter->next_data);
+    free(iter);
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* How the items of an array are reduced (as a BLOSC2_ZONEMAP_* kind), or -1 if they cannot be */
+static int reduce_kind(const b2nd_array_t *array) {
+  const char *dtype = array->dtype;
+  if (dtype == NULL || array->dtype_format != DTYPE_NUMPY_FORMAT || strlen(dtype) < 3) {
+    return -1;
+  }
+  // Big endian items would have to be swapped first
+  if ((dtype[0] != '<' && dtype[0] != '|' && dtype[0] != '=') || atoi(dtype + 2) != array->sc->typesize) {
+    return -1;
+  }
+  switch (dtype[1]) {
+    case 'i':
+      return BLOSC2_ZONEMAP_INT;
+    case 'u':
+    case 'b':
+      return BLOSC2_ZONEMAP_UINT;
+    case 'f':
+      return BLOSC2_ZONEMAP_FLOAT;
+    default:
+      return -1;
+  }
+}
+
+
+int b2nd_reduce(const b2nd_array_t *array, int ops, blosc2_reduction *result) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(result, BLOSC2_ERROR_NULL_POINTER);
+
+  // The chunks in the write cache have to be in the super-chunk
+  BLOSC_ERROR(b2nd_flush((b2nd_array_t *) array));
+
+  int kind = reduce_kind(array);
+  if (kind < 0) {
+    BLOSC_TRACE_ERROR("The items of dtype %s cannot be reduced", array->dtype != NULL ? array->dtype : "(none)");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  reduce_layout layout;
+  layout.ndim = array->ndim;
+  for (int i = 0; i < array->ndim; ++i) {
+    layout.shape[i] = array->shape[i];
+    layout.chunkshape[i] = array->chunkshape[i];
+    layout.extchunkshape[i] = array->extchunkshape[i];
+    layout.blockshape[i] = array->blockshape[i];
+  }
+  return schunk_reduce(array->sc, &layout, kind, ops, result);
+}
+
+
+int b2nd_save(const b2nd_array_t *array, char *urlpath) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(urlpath, BLOSC2_ERROR_NULL_POINTER);
+
+  b2nd_array_t *tmp;
+  blosc2_storage b2_storage = BLOSC2_STORAGE_DEFAULTS;
+  b2nd_context_t params = {.b2_storage=&b2_storage};
+  b2_storage.urlpath = urlpath;
+  b2_storage.contiguous = array->sc->storage->contiguous;
+
+  for (int i = 0; i < array->ndim; ++i) {
+    params.chunkshape[i] = array->chunkshape[i];
+    params.blockshape[i] = array->blockshape[i];
+  }
+
+  BLOSC_ERROR(b2nd_copy(&params, array, &tmp));
+  BLOSC_ERROR(b2nd_free(tmp));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_print_meta(const b2nd_array_t *array) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  char *dtype;
+  int8_t dtype_format;
+  uint8_t *smeta;
+  int32_t smeta_len;
+  if (blosc2_meta_get(array->sc, "b2nd", &smeta, &smeta_len) < 0) {
+    // Try with a caterva metalayer; we are meant to be backward compatible with it
+    if (blosc2_meta_get(array->sc, "caterva", &smeta, &smeta_len) < 0) {
+      BLOSC_ERROR(BLOSC2_ERROR_METALAYER_NOT_FOUND);
+    }
+  }
+  BLOSC_ERROR(b2nd_deserialize_meta(smeta, smeta_len, &ndim, shape, chunkshape, blockshape,
+                                    &dtype, &dtype_format));
+  free(smeta);
+
+  printf("b2nd metalayer parameters:\n Ndim:       %d", ndim);
+  printf("\n shape:      %" PRId64 "", shape[0]);
+  for (int i = 1; i < ndim; ++i) {
+    printf(", %" PRId64 "", shape[i]);
+  }
+  printf("\n chunkshape: %d", chunkshape[0]);
+  for (int i = 1; i < ndim; ++i) {
+    printf(", %d", chunkshape[i]);
+  }
+  if (dtype != NULL) {
+    printf("\n dtype: %s", dtype);
+    free(dtype);
+  }
+
+  printf("\n blockshape: %d", blockshape[0]);
+  for (int i = 1; i < ndim; ++i) {
+    printf(", %d", blockshape[i]);
+  }
+  printf("\n");
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int extend_shape(b2nd_array_t *array, const int64_t *new_shape, const int64_t *start) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(new_shape, BLOSC2_ERROR_NULL_POINTER);
+
+  int8_t ndim = array->ndim;
+  int64_t diffs_shape[B2ND_MAX_DIM];
+  int64_t diffs_sum = 0;
+  for (int i = 0; i < ndim; i++) {
+    diffs_shape[i] = new_shape[i] - array->shape[i];
+    diffs_sum += diffs_shape[i];
+    if (diffs_shape[i] < 0) {
+      BLOSC_TRACE_ERROR("The new shape must be greater than the old one");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+    if (array->shape[i] == 0) {
+      BLOSC_TRACE_ERROR("Cannot extend array with shape[%d] = 0", i);
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+  }
+  if (diffs_sum == 0) {
+    // Shapes are equal. Do nothing.
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  int64_t old_nchunks = array->sc->nchunks;
+  // aux array to keep old shapes
+  b2nd_array_t *aux = malloc(sizeof(b2nd_array_t));
+  BLOSC_ERROR_NULL(aux, BLOSC2_ERROR_MEMORY_ALLOC);
+  aux->sc = NULL;
+  BLOSC_ERROR(update_shape(aux, ndim, array->shape, array->chunkshape, array->blockshape));
+
+  BLOSC_ERROR(update_shape(array, ndim, new_shape, array->chunkshape, array->blockshape));
+
+  int64_t nchunks = array->extnitems / array->chunknitems;
+  int64_t nchunks_;
+  int64_t nchunk_ndim[B2ND_MAX_DIM];
+  blosc2_cparams *cparams;
+  BLOSC_ERROR(blosc2_schunk_get_cparams(array->sc, &cparams));
+  void *chunk;
+  int64_t csize;
+  if (nchunks != old_nchunks) {
+    if (start == NULL) {
+      start = aux->shape;
+    }
+    int64_t chunks_in_array[B2ND_MAX_DIM] = {0};
+    for (int i = 0; i < ndim; ++i) {
+      chunks_in_array[i] = array->extshape[i] / array->chunkshape[i];
+    }
+    for (int i = 0; i < nchunks; ++i) {
+      blosc2_unidim_to_multidim(ndim, chunks_in_array, i, nchunk_ndim);
+      for (int j = 0; j < ndim; ++j) {
+        if (start[j] <= (array->chunkshape[j] * nchunk_ndim[j])
+            && (array->chunkshape[j] * nchunk_ndim[j]) < (start[j] + new_shape[j] - aux->shape[j])) {
+          chunk = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
+          BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+          csize = blosc2_chunk_zeros(*cparams, array->sc->chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+          if (csize < 0) {
+            free(aux);
+            free(cparams);
+            BLOSC_TRACE_ERROR("Blosc error when creating a chunk");
+            return BLOSC2_ERROR_FAILURE;
+          }
+          nchunks_ = blosc2_schunk_insert_chunk(array->sc, i, chunk, false);
+          if (nchunks_ < 0) {
+            free(aux);
+            free(cparams);
+            BLOSC_TRACE_ERROR("Blosc error when inserting a chunk");
+            return BLOSC2_ERROR_FAILURE;
+          }
+          break;
+        }
+      }
+    }
+  }
+  free(aux);
+  free(cparams);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int shrink_shape(b2nd_array_t *array, const int64_t *new_shape, const int64_t *start) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(new_shape, BLOSC2_ERROR_NULL_POINTER);
+
+  int8_t ndim = array->ndim;
+  int64_t diffs_shape[B2ND_MAX_DIM];
+  int64_t diffs_sum = 0;
+  for (int i = 0; i < ndim; i++) {
+    diffs_shape[i] = new_shape[i] - array->shape[i];
+    diffs_sum += diffs_shape[i];
+    if (diffs_shape[i] > 0) {
+      BLOSC_TRACE_ERROR("The new shape must be smaller than the old one");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+    if (array->shape[i] == 0 && diffs_shape[i] != 0) {
+      BLOSC_TRACE_ERROR("Cannot shrink array with shape[%d] = 0", i);
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+  }
+  if (diffs_sum == 0) {
+    // Shapes are equal. Do nothing.
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  int64_t old_nchunks = array->sc->nchunks;
+  // aux array to keep old shapes
+  b2nd_array_t *aux = malloc(sizeof(b2nd_array_t));
+  BLOSC_ERROR_NULL(aux, BLOSC2_ERROR_MEMORY_ALLOC);
+  aux->sc = NULL;
+  BLOSC_ERROR(update_shape(aux, ndim, array->shape, array->chunkshape, array->blockshape));
+
+  BLOSC_ERROR(update_shape(array, ndim, new_shape, array->chunkshape, array->blockshape));
+
+  // Delete chunks if needed
+  int64_t chunks_in_array_old[B2ND_MAX_DIM] = {0};
+  for (int i = 0; i < ndim; ++i) {
+    chunks_in_array_old[i] = aux->extshape[i] / aux->chunkshape[i];
+  }
+  if (start == NULL) {
+    start = new_shape;
+  }
+
+  int64_t nchunk_ndim[B2ND_MAX_DIM] = {0};
+  int64_t nchunks_;
+  for (int i = (int) old_nchunks - 1; i >= 0; --i) {
+    blosc2_unidim_to_multidim(ndim, chunks_in_array_old, i, nchunk_ndim);
+    for (int j = 0; j < ndim; ++j) {
+      if (start[j] <= (array->chunkshape[j] * nchunk_ndim[j])
+          && (array->chunkshape[j] * nchunk_ndim[j]) < (start[j] + aux->shape[j] - new_shape[j])) {
+        nchunks_ = blosc2_schunk_delete_chunk(array->sc, i);
+        if (nchunks_ < 0) {
+          free(aux);
+          BLOSC_TRACE_ERROR("Blosc error when deleting a chunk");
+          return BLOSC2_ERROR_FAILURE;
+        }
+        break;
+      }
+    }
+  }
+  free(aux);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Set the items of `array` from `from` to `to` along `axis` to the ones `shift` positions
+ * before them (or to zeros), a region of whole chunks at a time.  The regions go in the
+ * order that reads the items before they are overwritten. */
+static int shift_items(b2nd_array_t *array, int8_t axis, int64_t from, int64_t to, int64_t shift,
+                       bool zeros) {
+  int8_t ndim = array->ndim;
+  if (from >= to) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int64_t region[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    region[i] = array->chunkshape[i];
+  }
+  grow_region(array, region, B2ND_DEFAULT_RECHUNK_MEM);
+  // The regions along `axis` (the first and last ones are cut), and then the ones across it
+  int64_t first = from / region[axis];
+  int64_t nslabs = (to + region[axis] - 1) / region[axis] - first;
+  int64_t nregions[B2ND_MAX_DIM];
+  int64_t total = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nregions[i] = i == axis ? 1 : (array->shape[i] + region[i] - 1) / region[i];
+    total *= nregions[i];
+  }
+  uint8_t *buffer = zeros ? calloc(1, region_size(array, region)) : malloc(region_size(array, region));
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  int64_t coords[B2ND_MAX_DIM];
+  for (int64_t nslab = 0; nslab < nslabs && rc >= 0; ++nslab) {
+    int64_t slab = shift > 0 ? first + nslabs - 1 - nslab : first + nslab;
+    for (int64_t nregion = 0; nregion < total && rc >= 0; ++nregion) {
+      blosc2_unidim_to_multidim(ndim, nregions, nregion, coords);
+      coords[axis] = slab;
+      int64_t start[B2ND_MAX_DIM];
+      int64_t stop[B2ND_MAX_DIM];
+      int64_t src_start[B2ND_MAX_DIM];
+      int64_t src_stop[B2ND_MAX_DIM];
+      int64_t shape[B2ND_MAX_DIM];
+      int64_t size = array->sc->typesize;
+      for (int i = 0; i < ndim; ++i) {
+        int64_t lower = i == axis ? from : 0;
+        int64_t upper = i == axis ? to : array->shape[i];
+        start[i] = coords[i] * region[i] > lower ? coords[i] * region[i] : lower;
+        stop[i] = (coords[i] + 1) * region[i] < upper ? (coords[i] + 1) * region[i] : upper;
+        src_start[i] = i == axis ? start[i] - shift : start[i];
+        src_stop[i] = i == axis ? stop[i] - shift : stop[i];
+        shape[i] = stop[i] - start[i];
+        size *= shape[i];
+      }
+      if (!zeros) {
+        rc = b2nd_get_slice_cbuffer(array, src_start, src_stop, buffer, shape, size);
+      }
+      if (rc >= 0) {
+        rc = b2nd_set_slice_cbuffer(buffer, shape, size, start, stop, array);
+      }
+    }
+  }
+  free(buffer);
+  return rc;
+}
+
+/* Delete `len` items from `start` on along `axis`.  The chunks in between are dropped as they
+ * are, and so are the ones past when `len` is a multiple of the chunks (but for the chunk of
+ * `start`).  Else the items past go to other positions of their chunks, which are rewritten. */
+static int delete_items(b2nd_array_t *array, int8_t axis, int64_t start, int64_t len) {
+  int8_t ndim = array->ndim;
+  int64_t chunkitems = array->chunkshape[axis];
+  int64_t new_shape[B2ND_MAX_DIM];
+  memcpy(new_shape, array->shape, ndim * sizeof(int64_t));
+  int64_t chunk_start[B2ND_MAX_DIM] = {0};
+  if (len == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (start + len == array->shape[axis]) {
+    new_shape[axis] -= len;
+    BLOSC_ERROR(shrink_shape(array, new_shape, NULL));
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  // The chunks within the deleted items
+  int64_t first = (start + chunkitems - 1) / chunkitems;
+  int64_t last = (start + len) / chunkitems;
+  if (last > first) {
+    new_shape[axis] -= (last - first) * chunkitems;
+    chunk_start[axis] = first * chunkitems;
+    BLOSC_ERROR(shrink_shape(array, new_shape, chunk_start));
+    len -= (last - first) * chunkitems;
+  }
+  if (len == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  new_shape[axis] -= len;
+  if (len % chunkitems == 0) {
+    // The rest of the chunk of `start` comes from the last deleted chunk
+    int64_t next = (start / chunkitems + 1) * chunkitems;
+    BLOSC_ERROR(shift_items(array, axis, start, next < new_shape[axis] ? next : new_shape[axis], -len, false));
+    chunk_start[axis] = next;
+    BLOSC_ERROR(shrink_shape(array, new_shape, chunk_start));
+  }
+  else {
+    BLOSC_ERROR(shift_items(array, axis, start, new_shape[axis], -len, false));
+    BLOSC_ERROR(shrink_shape(array, new_shape, NULL));
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Insert `len` zeros at `start` along `axis`, as whole zeroed chunks when `len` is a multiple
+ * of the chunks (moving the rest of the chunk of `start` past them).  Else the items past
+ * go to other positions of their chunks, which are rewritten. */
+static int insert_zeros(b2nd_array_t *array, int8_t axis, int64_t start, int64_t len) {
+  int8_t ndim = array->ndim;
+  int64_t chunkitems = array->chunkshape[axis];
+  int64_t new_shape[B2ND_MAX_DIM];
+  memcpy(new_shape, array->shape, ndim * sizeof(int64_t));
+  new_shape[axis] += len;
+  int64_t chunk_start[B2ND_MAX_DIM] = {0};
+  if (len == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (start == array->shape[axis]) {
+    BLOSC_ERROR(extend_shape(array, new_shape, NULL));
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  if (len % chunkitems == 0) {
+    int64_t next = (start + chunkitems - 1) / chunkitems * chunkitems;
+    chunk_start[axis] = next;
+    BLOSC_ERROR(extend_shape(array, new_shape, chunk_start));
+    if (next > start) {
+      int64_t stop = next + len < new_shape[axis] ? next + len : new_shape[axis];
+      BLOSC_ERROR(shift_items(array, axis, start + len, stop, len, false));
+      BLOSC_ERROR(shift_items(array, axis, start, next, 0, true));
+    }
+  }
+  else {
+    BLOSC_ERROR(extend_shape(array, new_shape, NULL));
+    BLOSC_ERROR(shift_items(array, axis, start + len, new_shape[axis], len, false));
+    BLOSC_ERROR(shift_items(array, axis, start, start + len, 0, true));
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_resize(b2nd_array_t *array, const int64_t *new_shape,
+                const int64_t *start) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(new_shape, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(b2nd_flush(array));
+
+  if (start != NULL) {
+    for (int i = 0; i < array->ndim; ++i) {
+      if (start[i] > array->shape[i] || (new_shape[i] < array->shape[i] && start[i] > new_shape[i])) {
+        BLOSC_TRACE_ERROR("`start` must be lower or equal than old array shape in all dims, "
+                          "and than the new one where it is shrunk");
+        BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+      }
+    }
+    // The items go away or the zeros come in at `start`, one dimension after the other
+    for (int8_t i = 0; i < array->ndim; ++i) {
+      if (new_shape[i] < array->shape[i]) {
+        BLOSC_ERROR(delete_items(array, i, start[i], array->shape[i] - new_shape[i]));
+      }
+      else {
+        BLOSC_ERROR(insert_zeros(array, i, start[i], new_shape[i] - array->shape[i]));
+      }
+    }
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  // Get shrunk shape
+  int64_t shrunk_shape[B2ND_MAX_DIM] = {0};
+  for (int i = 0; i < array->ndim; ++i) {
+    if (new_shape[i] <= array->shape[i]) {
+      shrunk_shape[i] = new_shape[i];
+    } else {
+      shrunk_shape[i] = array->shape[i];
+    }
+  }
+
+  BLOSC_ERROR(shrink_shape(array, shrunk_shape, start));
+  BLOSC_ERROR(extend_shape(array, new_shape, start));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_insert(b2nd_array_t *array, const void *buffer, int64_t buffersize,
+                int8_t axis, int64_t insert_start) {
+
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(b2nd_flush(array));
+
+  if (axis >= array->ndim) {
+    BLOSC_TRACE_ERROR("`axis` cannot be greater than the number of dimensions");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+
+  int64_t axis_size = array->sc->typesize;
+  int64_t buffershape[B2ND_MAX_DIM];
+  for (int i = 0; i < array->ndim; ++i) {
+    if (i != axis) {
+      axis_size *= array->shape[i];
+      buffershape[i] = array->shape[i];
+    }
+  }
+  if (buffersize % axis_size != 0) {
+    BLOSC_TRACE_ERROR("`buffersize` must be multiple of the array");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  int64_t newshape[B2ND_MAX_DIM];
+  memcpy(newshape, array->shape, array->ndim * sizeof(int64_t));
+  newshape[axis] += buffersize / axis_size;
+  buffershape[axis] = newshape[axis] - array->shape[axis];
+  int64_t start[B2ND_MAX_DIM] = {0};
+  start[axis] = insert_start;
+
+  if (insert_start == array->shape[axis]) {
+    BLOSC_ERROR(b2nd_resize(array, newshape, NULL));
+  } else {
+    BLOSC_ERROR(b2nd_resize(array, newshape, start));
+  }
+
+  int64_t stop[B2ND_MAX_DIM];
+  memcpy(stop, array->shape, sizeof(int64_t) * array->ndim);
+  stop[axis] = start[axis] + buffershape[axis];
+  BLOSC_ERROR(b2nd_set_slice_cbuffer(buffer, buffershape, buffersize, start, stop, array));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Append whole new chunks along the first axis, compressing them straight from the buffer
+ * (instead of inserting zeroed chunks and then decompressing and updating them) */
+static int append_chunks(b2nd_array_t *array, const void *buffer, int64_t buffersize) {
+  int8_t ndim = array->ndim;
+  int64_t axis_size = array->sc->typesize;
+  for (int i = 1; i < ndim; ++i) {
+    axis_size *= array->shape[i];
+  }
+  if (buffersize % axis_size != 0) {
+    BLOSC_TRACE_ERROR("`buffersize` must be multiple of the array");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+
+  int64_t start[B2ND_MAX_DIM] = {0};
+  start[0] = array->shape[0];
+  int64_t new_shape[B2ND_MAX_DIM];
+  int64_t buffershape[B2ND_MAX_DIM];
+  memcpy(new_shape, array->shape, ndim * sizeof(int64_t));
+  memcpy(buffershape, array->shape, ndim * sizeof(int64_t));
+  buffershape[0] = buffersize / axis_size;
+  new_shape[0] += buffershape[0];
+  BLOSC_ERROR(update_shape(array, ndim, new_shape, array->chunkshape, array->blockshape));
+
+  slice_job_data slice = {.array = array, .buffer = (uint8_t *) buffer, .start = start, .stop = new_shape,
+                          .shape = buffershape, .set_slice = true, .append = true};
+  BLOSC_ERROR(process_slice(&slice));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_append(b2nd_array_t *array, const void *buffer, int64_t buffersize,
+                int8_t axis) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(b2nd_flush(array));
+
+  // The levels of the pyramid are updated with the items appended
+  int64_t start[B2ND_MAX_DIM] = {0};
+  if (array->ndim > 0) {
+    start[axis] = array->shape[axis];
+  }
+
+  // The chunks are in C order, so the ones after a whole chunk of the first axis are all new
+  if (axis == 0 && array->ndim > 0 && array->shape[0] % array->chunkshape[0] == 0 &&
+      array->sc->nchunks == array->extnitems / array->chunknitems) {
+    // (which also works for arrays with no items along the first axis yet)
+    bool empty = false;
+    for (int i = 1; i < array->ndim; ++i) {
+      empty |= array->shape[i] == 0;
+    }
+    if (!empty && buffersize > 0) {
+      BLOSC_ERROR(append_chunks(array, buffer, buffersize));
+      BLOSC_ERROR(pyramid_update(array, start, array->shape));
+      return BLOSC2_ERROR_SUCCESS;
+    }
+  }
+
+  BLOSC_ERROR(b2nd_insert(array, buffer, buffersize, axis, array->shape[axis]));
+  BLOSC_ERROR(pyramid_update(array, start, array->shape));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* The index of the chunk at `coords` in a grid of `nchunks` chunks per dimension (C order) */
+static int64_t chunk_index(int8_t ndim, const int64_t *nchunks, const int64_t *coords) {
+  int64_t index = 0;
+  for (int i = 0; i < ndim; ++i) {
+    index = index * nchunks[i] + coords[i];
+  }
+  return index;
+}
+
+/* Move the chunks of `src` as they are into the (already reshaped) grid of `array`, past
+ * the first `offset` chunks along `axis` */
+static int move_chunks(b2nd_array_t *array, const b2nd_array_t *src, int8_t axis, int64_t offset) {
+  int8_t ndim = array->ndim;
+  int64_t nchunks[B2ND_MAX_DIM];
+  int64_t src_nchunks[B2ND_MAX_DIM];
+  int64_t total = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nchunks[i] = array->extshape[i] / array->chunkshape[i];
+    src_nchunks[i] = src->extshape[i] / src->chunkshape[i];
+    total *= nchunks[i];
+  }
+  // The chunks are inserted in the order they end up in, so the ones of `array` keep their place
+  int64_t coords[B2ND_MAX_DIM];
+  for (int64_t nchunk = 0; nchunk < total; ++nchunk) {
+    blosc2_unidim_to_multidim(ndim, nchunks, nchunk, coords);
+    if (coords[axis] < offset) {
+      continue;
+    }
+    coords[axis] -= offset;
+    uint8_t *chunk;
+    bool needs_free;
+    int rc = blosc2_schunk_get_chunk(src->sc, chunk_index(ndim, src_nchunks, coords), &chunk, &needs_free);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the chunk to move");
+      return rc;
+    }
+    int64_t nchunks_ = blosc2_schunk_insert_chunk(array->sc, nchunk, chunk, !needs_free);
+    if (nchunks_ < 0) {
+      if (needs_free) {
+        free(chunk);
+      }
+      BLOSC_TRACE_ERROR("Cannot insert the moved chunk");
+      return (int) nchunks_;
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Decompress the items of `src` into the chunks of `array` (already resized) that they go
+ * to, past `offset` along `axis`, one chunk of `array` at a time */
+static int copy_items(b2nd_array_t *array, const b2nd_array_t *src, int8_t axis, int64_t offset) {
+  int8_t ndim = array->ndim;
+  int64_t nchunks[B2ND_MAX_DIM];
+  int64_t total = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nchunks[i] = array->extshape[i] / array->chunkshape[i];
+    total *= nchunks[i];
+  }
+  int64_t chunksize = array->chunknitems * array->sc->typesize;
+  uint8_t *buffer = malloc(chunksize);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  int64_t coords[B2ND_MAX_DIM];
+  for (int64_t nchunk = 0; nchunk < total && rc >= 0; ++nchunk) {
+    blosc2_unidim_to_multidim(ndim, nchunks, nchunk, coords);
+    if ((coords[axis] + 1) * array->chunkshape[axis] <= offset ||
+        coords[axis] * array->chunkshape[axis] >= offset + src->shape[axis]) {
+      continue;
+    }
+    int64_t start[B2ND_MAX_DIM];
+    int64_t stop[B2ND_MAX_DIM];
+    int64_t src_start[B2ND_MAX_DIM];
+    int64_t src_stop[B2ND_MAX_DIM];
+    int64_t shape[B2ND_MAX_DIM];
+    int64_t size = array->sc->typesize;
+    for (int i = 0; i < ndim; ++i) {
+      start[i] = coords[i] * array->chunkshape[i];
+      stop[i] = start[i] + array->chunkshape[i] < array->shape[i] ? start[i] + array->chunkshape[i] : array->shape[i];
+      if (i == axis) {
+        // The chunks with the items of other arrays too
+        start[i] = start[i] > offset ? start[i] : offset;
+        stop[i] = stop[i] < offset + src->shape[i] ? stop[i] : offset + src->shape[i];
+      }
+      src_start[i] = i == axis ? start[i] - offset : start[i];
+      src_stop[i] = i == axis ? stop[i] - offset : stop[i];
+      shape[i] = stop[i] - start[i];
+      size *= shape[i];
+    }
+    rc = b2nd_get_slice_cbuffer(src, src_start, src_stop, buffer, shape, size);
+    if (rc >= 0) {
+      rc = b2nd_set_slice_cbuffer(buffer, shape, size, start, stop, array);
+    }
+  }
+  free(buffer);
+  return rc;
+}
+
+/* Append the items of `src` to `array` along `axis` */
+static int concat_into(b2nd_array_t *array, const b2nd_array_t *src, int8_t axis) {
+  int8_t ndim = array->ndim;
+  if (src->ndim != ndim || axis < 0 || axis >= ndim) {
+    BLOSC_TRACE_ERROR("The arrays must have the same dimensions, and `axis` be one of them");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  if (src->sc->typesize != array->sc->typesize) {
+    BLOSC_TRACE_ERROR("The arrays must have the same typesize");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  bool aligned = array->shape[axis] % array->chunkshape[axis] == 0;
+  bool tail = true;
+  for (int i = 0; i < ndim; ++i) {
+    if (i != axis && src->shape[i] != array->shape[i]) {
+      BLOSC_TRACE_ERROR("The arrays must have the same shape but for `axis`");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+    aligned &= src->chunkshape[i] == array->chunkshape[i] && src->blockshape[i] == array->blockshape[i];
+    // The chunks of `src` go after the ones of `array` when there is one chunk before `axis`
+    tail &= i >= axis || array->shape[i] <= array->chunkshape[i];
+  }
+  if (src->nitems == 0) {
+    int64_t new_shape[B2ND_MAX_DIM];
+    memcpy(new_shape, array->shape, ndim * sizeof(int64_t));
+    new_shape[axis] += src->shape[axis];
+    BLOSC_ERROR(update_shape(array, ndim, new_shape, array->chunkshape, array->blockshape));
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // Chunks referencing a shared dictionary cannot go to another super-chunk
+  aligned &= blosc2_vlmeta_exists(src->sc, SHARED_DICT_VLMETA) < 0;
+  aligned &= array->sc->nchunks == array->extnitems / array->chunknitems;
+
+  int64_t offset = array->shape[axis];
+  int64_t new_shape[B2ND_MAX_DIM];
+  memcpy(new_shape, array->shape, ndim * sizeof(int64_t));
+  new_shape[axis] += src->shape[axis];
+  if (aligned && tail) {
+    // All the chunks in one go
+    BLOSC_ERROR((int) blosc2_schunk_concat(array->sc, src->sc));
+    BLOSC_ERROR(update_shape(array, ndim, new_shape, array->chunkshape, array->blockshape));
+  }
+  else if (aligned) {
+    BLOSC_ERROR(update_shape(array, ndim, new_shape, array->chunkshape, array->blockshape));
+    BLOSC_ERROR(move_chunks(array, src, axis, offset / array->chunkshape[axis]));
+  }
+  else {
+    // Only the chunk across the edge mixes items of both arrays, but the ones of `src`
+    // are at other positions in the chunks of `array`
+    BLOSC_ERROR(b2nd_resize(array, new_shape, NULL));
+    BLOSC_ERROR(copy_items(array, src, axis, offset));
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_concatenate(b2nd_context_t *ctx, const b2nd_array_t *src1, const b2nd_array_t *src2,
+                     int8_t axis, bool copy, b2nd_array_t **array) {
+  BLOSC_ERROR_NULL(src1, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(src2, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(b2nd_flush((b2nd_array_t *) src1));
+  BLOSC_ERROR(b2nd_flush((b2nd_array_t *) src2));
+
+  if (copy) {
+    BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+    BLOSC_ERROR(b2nd_copy(ctx, src1, array));
+  }
+  else {
+    *array = (b2nd_array_t *) src1;
+  }
+  int rc = concat_into(*array, src2, axis);
+  if (rc < 0 && copy) {
+    b2nd_free(*array);
+    *array = NULL;
+  }
+  return rc;
+}
+
+
+/* A view of `src` with a new dimension of one item (and one chunk) at `axis`, which does
+ * not change the order of the chunks nor the one of their items */
+static void expand_view(const b2nd_array_t *src, int8_t axis, b2nd_array_t *view) {
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  for (int i = 0, j = 0; i < src->ndim + 1; ++i) {
+    bool new_dim = i == axis;
+    shape[i] = new_dim ? 1 : src->shape[j];
+    chunkshape[i] = new_dim ? 1 : src->chunkshape[j];
+    blockshape[i] = new_dim ? 1 : src->blockshape[j];
+    j += !new_dim;
+  }
+  *view = *src;
+  view->sc = NULL;
+  update_shape(view, (int8_t) (src->ndim + 1), shape, chunkshape, blockshape);
+  view->sc = src->sc;
+  view->chunk_cache.data = NULL;
+  view->chunk_cache.nchunk = -1;
+  view->write_cache = NULL;
+}
+
+
+int b2nd_stack(b2nd_context_t *ctx, const b2nd_array_t **srcs, int nsrcs, int8_t axis,
+               b2nd_array_t **array) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(srcs, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  if (nsrcs < 1 || axis < 0 || axis > srcs[0]->ndim || srcs[0]->ndim + 1 > B2ND_MAX_DIM) {
+    BLOSC_TRACE_ERROR("Cannot stack %d arrays along axis %d", nsrcs, axis);
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  for (int n = 1; n < nsrcs; ++n) {
+    if (srcs[n]->ndim != srcs[0]->ndim ||
+        memcmp(srcs[n]->shape, srcs[0]->shape, srcs[0]->ndim * sizeof(int64_t)) != 0) {
+      BLOSC_TRACE_ERROR("The arrays to stack must have the same shape");
+      BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+    }
+  }
+  for (int n = 0; n < nsrcs; ++n) {
+    BLOSC_ERROR(b2nd_flush((b2nd_array_t *) srcs[n]));
+  }
+
+  b2nd_array_t view;
+  expand_view(srcs[0], axis, &view);
+  bool aligned = ctx->ndim == view.ndim &&
+                 memcmp(ctx->chunkshape, view.chunkshape, view.ndim * sizeof(int32_t)) == 0 &&
+                 memcmp(ctx->blockshape, view.blockshape, view.ndim * sizeof(int32_t)) == 0 &&
+                 blosc2_vlmeta_exists(view.sc, SHARED_DICT_VLMETA) < 0;
+  ctx->ndim = view.ndim;
+  memcpy(ctx->shape, view.shape, view.ndim * sizeof(int64_t));
+  // The chunks are appended to an array empty along `axis` (its metalayer cannot grow once it
+  // has chunks), else the items are copied to their place in the whole array
+  ctx->shape[axis] = aligned ? 0 : nsrcs;
+  BLOSC_ERROR(b2nd_empty(ctx, array));
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int n = 0; n < nsrcs && rc >= 0; ++n) {
+    expand_view(srcs[n], axis, &view);
+    rc = aligned ? concat_into(*array, &view, axis) : copy_items(*array, &view, axis, n);
+  }
+  if (rc < 0) {
+    b2nd_free(*array);
+    *array = NULL;
+  }
+  return rc;
+}
+
+
+int b2nd_delete(b2nd_array_t *array, const int8_t axis,
+                int64_t delete_start, int64_t delete_len) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(b2nd_flush(array));
+
+  if (axis >= array->ndim) {
+    BLOSC_TRACE_ERROR("axis cannot be greater than the number of dimensions");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+
+
+  int64_t newshape[B2ND_MAX_DIM];
+  memcpy(newshape, array->shape, array->ndim * sizeof(int64_t));
+  newshape[axis] -= delete_len;
+  int64_t start[B2ND_MAX_DIM] = {0};
+  start[axis] = delete_start;
+
+  if (delete_start == (array->shape[axis] - delete_len)) {
+    BLOSC_ERROR(b2nd_resize(array, newshape, NULL));
+  } else {
+    BLOSC_ERROR(b2nd_resize(array, newshape, start));
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+// Indexing
+
+typedef struct {
+    int64_t value;
+    int64_t index;
+} b2nd_selection_t;
+
+
+int compare_selection(const void *a, const void *b) {
+  int res = (int) (((b2nd_selection_t *) a)->value - ((b2nd_selection_t *) b)->value);
+  // In case values are equal, sort by index
+  if (res == 0) {
+    res = (int) (((b2nd_selection_t *) a)->index - ((b2nd_selection_t *) b)->index);
+  }
+  return res;
+}
+
+
+int copy_block_buffer_data(b2nd_array_t *array,
+                           int8_t ndim,
+                           int64_t *block_selection_size,
+                           b2nd_selection_t **chunk_selection,
+                           b2nd_selection_t **p_block_selection_0,
+                           b2nd_selection_t **p_block_selection_1,
+                           uint8_t *block,
+                           uint8_t *buffer,
+                           int64_t *buffershape,
+                           int64_t *bufferstrides,
+                           bool get) {
+  p_block_selection_0[ndim] = chunk_selection[ndim];
+  p_block_selection_1[ndim] = chunk_selection[ndim];
+  while (p_block_selection_1[ndim] - p_block_selection_0[ndim] < block_selection_size[ndim]) {
+    if (ndim == array->ndim - 1) {
+
+      int64_t index_in_block_n[B2ND_MAX_DIM];
+      for (int i = 0; i < array->ndim; ++i) {
+        index_in_block_n[i] = p_block_selection_1[i]->value % array->chunkshape[i] % array->blockshape[i];
+      }
+      int64_t index_in_block = 0;
+      for (int i = 0; i < array->ndim; ++i) {
+        index_in_block += index_in_block_n[i] * array->item_block_strides[i];
+      }
+
+      int64_t index_in_buffer_n[B2ND_MAX_DIM];
+      for (int i = 0; i < array->ndim; ++i) {
+        index_in_buffer_n[i] = p_block_selection_1[i]->index;
+      }
+      int64_t index_in_buffer = 0;
+      for (int i = 0; i < array->ndim; ++i) {
+        index_in_buffer += index_in_buffer_n[i] * bufferstrides[i];
+      }
+      if (get) {
+        memcpy(&buffer[index_in_buffer * array->sc->typesize],
+               &block[index_in_block * array->sc->typesize],
+               array->sc->typesize);
+      } else {
+        memcpy(&block[index_in_block * array->sc->typesize],
+               &buffer[index_in_buffer * array->sc->typesize],
+               array->sc->typesize);
+      }
+    } else {
+      BLOSC_ERROR(copy_block_buffer_data(array, (int8_t) (ndim + 1), block_selection_size,
+                                         chunk_selection,
+                                         p_block_selection_0, p_block_selection_1, block,
+                                         buffer, buffershape, bufferstrides, get)
+      );
+    }
+    p_block_selection_1[ndim]++;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int iter_block_copy(b2nd_array_t *array, int8_t ndim,
+                    int64_t *chunk_selection_size,
+                    b2nd_selection_t **ordered_selection,
+                    b2nd_selection_t **chunk_selection_0,
+                    b2nd_selection_t **chunk_selection_1,
+                    uint8_t *data,
+                    uint8_t *buffer,
+                    int64_t *buffershape,
+                    int64_t *bufferstrides,
+                    bool get) {
+  chunk_selection_0[ndim] = ordered_selection[ndim];
+  chunk_selection_1[ndim] = ordered_selection[ndim];
+  while (chunk_selection_1[ndim] - ordered_selection[ndim] < chunk_selection_size[ndim]) {
+    int64_t block_index_ndim = ((*chunk_selection_1[ndim]).value % array->chunkshape[ndim]) / array->blockshape[ndim];
+    while (chunk_selection_1[ndim] - ordered_selection[ndim] < chunk_selection_size[ndim] &&
+           block_index_ndim == ((*chunk_selection_1[ndim]).value % array->chunkshape[ndim]) / array->blockshape[ndim]) {
+      chunk_selection_1[ndim]++;
+    }
+    if (ndim == array->ndim - 1) {
+      int64_t block_chunk_strides[B2ND_MAX_DIM];
+      block_chunk_strides[array->ndim - 1] = 1;
       for (int i = array->ndim - 2; i >= 0; --i) {
         block_chunk_strides[i] = block_chunk_strides[i + 1] * (array->extchunkshape[i + 1] / array->blockshape[i + 1]);
       }
@@ -1512,265 +4197,1364 @@ int iter_block_copy(b2nd_array_t *array, int8_t ndim,
         block_selection_size[i] = chunk_selection_1[i] - chunk_selection_0[i];
       }
 
-      BLOSC_ERROR(copy_block_buffer_data(array,
-                                         (int8_t) 0,
-                                         block_selection_size,
-                                         chunk_selection_0,
-                                         p_block_selection_0,
-                                         p_block_selection_1,
-                                         &data[nblock * array->blocknitems * array->sc->typesize],
-                                         buffer,
-                                         buffershape,
-                                         bufferstrides,
-                                         get)
-      );
-      free(p_block_selection_0);
-      free(p_block_selection_1);
-      free(block_selection_size);
-    } else {
-      BLOSC_ERROR(iter_block_copy(array, (int8_t) (ndim + 1), chunk_selection_size,
-                                  ordered_selection, chunk_selection_0, chunk_selection_1,
-                                  data, buffer, buffershape, bufferstrides, get)
-      );
+      BLOSC_ERROR(copy_block_buffer_data(array,
+                                         (int8_t) 0,
+                                         block_selection_size,
+                                         chunk_selection_0,
+                                         p_block_selection_0,
+                                         p_block_selection_1,
+                                         &data[nblock * array->blocknitems * array->sc->typesize],
+                                         buffer,
+                                         buffershape,
+                                         bufferstrides,
+                                         get)
+      );
+      free(p_block_selection_0);
+      free(p_block_selection_1);
+      free(block_selection_size);
+    } else {
+      BLOSC_ERROR(iter_block_copy(array, (int8_t) (ndim + 1), chunk_selection_size,
+                                  ordered_selection, chunk_selection_0, chunk_selection_1,
+                                  data, buffer, buffershape, bufferstrides, get)
+      );
+    }
+    chunk_selection_0[ndim] = chunk_selection_1[ndim];
+
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int iter_block_maskout(b2nd_array_t *array, int8_t ndim,
+                       int64_t *sel_block_size,
+                       b2nd_selection_t **o_selection,
+                       b2nd_selection_t **p_o_sel_block_0,
+                       b2nd_selection_t **p_o_sel_block_1,
+                       bool *maskout) {
+  p_o_sel_block_0[ndim] = o_selection[ndim];
+  p_o_sel_block_1[ndim] = o_selection[ndim];
+  while (p_o_sel_block_1[ndim] - o_selection[ndim] < sel_block_size[ndim]) {
+    int64_t block_index_ndim = ((*p_o_sel_block_1[ndim]).value % array->chunkshape[ndim]) / array->blockshape[ndim];
+    while (p_o_sel_block_1[ndim] - o_selection[ndim] < sel_block_size[ndim] &&
+           block_index_ndim == ((*p_o_sel_block_1[ndim]).value % array->chunkshape[ndim]) / array->blockshape[ndim]) {
+      p_o_sel_block_1[ndim]++;
+    }
+    if (ndim == array->ndim - 1) {
+      int64_t block_chunk_strides[B2ND_MAX_DIM];
+      block_chunk_strides[array->ndim - 1] = 1;
+      for (int i = array->ndim - 2; i >= 0; --i) {
+        block_chunk_strides[i] = block_chunk_strides[i + 1] * (array->extchunkshape[i + 1] / array->blockshape[i + 1]);
+      }
+      int64_t block_index[B2ND_MAX_DIM];
+      for (int i = 0; i < array->ndim; ++i) {
+        block_index[i] = ((*p_o_sel_block_0[i]).value % array->chunkshape[i]) / array->blockshape[i];
+      }
+      int64_t nblock = 0;
+      for (int i = 0; i < array->ndim; ++i) {
+        nblock += block_index[i] * block_chunk_strides[i];
+      }
+      maskout[nblock] = false;
+    } else {
+      BLOSC_ERROR(iter_block_maskout(array, (int8_t) (ndim + 1), sel_block_size,
+                                     o_selection, p_o_sel_block_0, p_o_sel_block_1,
+                                     maskout)
+      );
+    }
+    p_o_sel_block_0[ndim] = p_o_sel_block_1[ndim];
+
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int iter_chunk(b2nd_array_t *array, int8_t ndim,
+               int64_t *selection_size,
+               b2nd_selection_t **ordered_selection,
+               b2nd_selection_t **p_ordered_selection_0,
+               b2nd_selection_t **p_ordered_selection_1,
+               uint8_t *buffer,
+               int64_t *buffershape,
+               int64_t *bufferstrides,
+               bool get) {
+  p_ordered_selection_0[ndim] = ordered_selection[ndim];
+  p_ordered_selection_1[ndim] = ordered_selection[ndim];
+  while (p_ordered_selection_1[ndim] - ordered_selection[ndim] < selection_size[ndim]) {
+    int64_t chunk_index_ndim = (*p_ordered_selection_1[ndim]).value / array->chunkshape[ndim];
+    while (p_ordered_selection_1[ndim] - ordered_selection[ndim] < selection_size[ndim] &&
+           chunk_index_ndim == (*p_ordered_selection_1[ndim]).value / array->chunkshape[ndim]) {
+      p_ordered_selection_1[ndim]++;
+    }
+    if (ndim == array->ndim - 1) {
+      int64_t chunk_array_strides[B2ND_MAX_DIM];
+      chunk_array_strides[array->ndim - 1] = 1;
+      for (int i = array->ndim - 2; i >= 0; --i) {
+        chunk_array_strides[i] = chunk_array_strides[i + 1] *
+                                 (array->extshape[i + 1] / array->chunkshape[i + 1]);
+      }
+      int64_t chunk_index[B2ND_MAX_DIM];
+      for (int i = 0; i < array->ndim; ++i) {
+        chunk_index[i] = (*p_ordered_selection_0[i]).value / array->chunkshape[i];
+      }
+      int64_t nchunk = 0;
+      for (int i = 0; i < array->ndim; ++i) {
+        nchunk += chunk_index[i] * chunk_array_strides[i];
+      }
+
+      int64_t nblocks = array->extchunknitems / array->blocknitems;
+      b2nd_selection_t **p_chunk_selection_0 = malloc(array->ndim * sizeof(b2nd_selection_t *));
+      BLOSC_ERROR_NULL(p_chunk_selection_0, BLOSC2_ERROR_MEMORY_ALLOC);
+      b2nd_selection_t **p_chunk_selection_1 = malloc(array->ndim * sizeof(b2nd_selection_t *));
+      BLOSC_ERROR_NULL(p_chunk_selection_1, BLOSC2_ERROR_MEMORY_ALLOC);
+      int64_t *chunk_selection_size = malloc(array->ndim * sizeof(int64_t));
+      BLOSC_ERROR_NULL(chunk_selection_size, BLOSC2_ERROR_MEMORY_ALLOC);
+      for (int i = 0; i < array->ndim; ++i) {
+        chunk_selection_size[i] = p_ordered_selection_1[i] - p_ordered_selection_0[i];
+      }
+
+      int data_nitems = (int) array->extchunknitems;
+      int data_nbytes = data_nitems * array->sc->typesize;
+      uint8_t *data = malloc(data_nitems * array->sc->typesize);
+      BLOSC_ERROR_NULL(data, BLOSC2_ERROR_MEMORY_ALLOC);
+
+      // The maskout is for the context decompressing the chunk (see blosc2_schunk_set_concurrent_reads())
+      blosc2_context *dctx = schunk_acquire_dctx(array->sc);
+      BLOSC_ERROR_NULL(dctx, BLOSC2_ERROR_MEMORY_ALLOC);
+      if (get) {
+        bool *maskout = calloc(nblocks, sizeof(bool));
+        for (int i = 0; i < nblocks; ++i) {
+          maskout[i] = true;
+        }
+
+        int rc = iter_block_maskout(array, (int8_t) 0,
+                                    chunk_selection_size,
+                                    p_ordered_selection_0,
+                                    p_chunk_selection_0,
+                                    p_chunk_selection_1,
+                                    maskout);
+        if (rc >= 0) {
+          rc = blosc2_set_maskout(dctx, maskout, (int) nblocks);
+        }
+        free(maskout);
+        if (rc != BLOSC2_ERROR_SUCCESS) {
+          schunk_release_dctx(array->sc, dctx);
+          BLOSC_TRACE_ERROR("Error setting the maskout");
+          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+        }
+      }
+      int err = schunk_decompress_chunk_ctx(array->sc, dctx, nchunk, data, data_nbytes);
+      schunk_release_dctx(array->sc, dctx);
+      if (err < 0) {
+        BLOSC_TRACE_ERROR("Error decompressing chunk");
+        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+      }
+      BLOSC_ERROR(iter_block_copy(array, 0, chunk_selection_size,
+                                  p_ordered_selection_0, p_chunk_selection_0, p_chunk_selection_1,
+                                  data, buffer, buffershape, bufferstrides, get));
+
+      if (!get) {
+        int32_t chunk_size = data_nbytes + BLOSC_EXTENDED_HEADER_LENGTH;
+        uint8_t *chunk = malloc(chunk_size);
+        BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+        err = blosc2_compress_ctx(array->sc->cctx, data, data_nbytes, chunk, chunk_size);
+        if (err < 0) {
+          BLOSC_TRACE_ERROR("Error compressing data");
+          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+        }
+        err = (int) blosc2_schunk_update_chunk(array->sc, nchunk, chunk, false);
+        if (err < 0) {
+          BLOSC_TRACE_ERROR("Error updating chunk");
+          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+        }
+      }
+      free(data);
+      free(chunk_selection_size);
+      free(p_chunk_selection_0);
+      free(p_chunk_selection_1);
+    } else {
+      BLOSC_ERROR(iter_chunk(array, (int8_t) (ndim + 1), selection_size,
+                             ordered_selection, p_ordered_selection_0, p_ordered_selection_1,
+                             buffer, buffershape, bufferstrides, get));
+    }
+
+    p_ordered_selection_0[ndim] = p_ordered_selection_1[ndim];
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int orthogonal_selection(b2nd_array_t *array, int64_t **selection, int64_t *selection_size, void *buffer,
+                         int64_t *buffershape, int64_t buffersize, bool get) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(selection, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(selection_size, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(b2nd_flush(array));
+
+  int8_t ndim = array->ndim;
+
+  for (int i = 0; i < ndim; ++i) {
+    BLOSC_ERROR_NULL(selection[i], BLOSC2_ERROR_NULL_POINTER);
+    // Check that indexes are not larger than array shape
+    for (int j = 0; j < selection_size[i]; ++j) {
+      if (selection[i][j] > array->shape[i]) {
+        BLOSC_ERROR(BLOSC2_ERROR_INVALID_INDEX);
+      }
+    }
+  }
+
+  // Check buffer size
+  int64_t sel_size = array->sc->typesize;
+  for (int i = 0; i < ndim; ++i) {
+    sel_size *= selection_size[i];
+  }
+
+  if (sel_size < buffersize) {
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+
+  // Sort selections
+  b2nd_selection_t **ordered_selection = malloc(ndim * sizeof(b2nd_selection_t *));
+  BLOSC_ERROR_NULL(ordered_selection, BLOSC2_ERROR_MEMORY_ALLOC);
+  for (int i = 0; i < ndim; ++i) {
+    ordered_selection[i] = malloc(selection_size[i] * sizeof(b2nd_selection_t));
+    for (int j = 0; j < selection_size[i]; ++j) {
+      ordered_selection[i][j].index = j;
+      ordered_selection[i][j].value = selection[i][j];
+    }
+    qsort(ordered_selection[i], selection_size[i], sizeof(b2nd_selection_t), compare_selection);
+  }
+
+  // Define pointers to iterate over ordered_selection data
+  b2nd_selection_t **p_ordered_selection_0 = malloc(ndim * sizeof(b2nd_selection_t *));
+  BLOSC_ERROR_NULL(p_ordered_selection_0, BLOSC2_ERROR_MEMORY_ALLOC);
+  b2nd_selection_t **p_ordered_selection_1 = malloc(ndim * sizeof(b2nd_selection_t *));
+  BLOSC_ERROR_NULL(p_ordered_selection_1, BLOSC2_ERROR_MEMORY_ALLOC);
+
+  int64_t bufferstrides[B2ND_MAX_DIM];
+  bufferstrides[array->ndim - 1] = 1;
+  for (int i = array->ndim - 2; i >= 0; --i) {
+    bufferstrides[i] = bufferstrides[i + 1] * buffershape[i + 1];
+  }
+
+  BLOSC_ERROR(iter_chunk(array, 0,
+                         selection_size, ordered_selection,
+                         p_ordered_selection_0,
+                         p_ordered_selection_1,
+                         buffer, buffershape, bufferstrides, get));
+
+  // Free allocated memory
+  free(p_ordered_selection_0);
+  free(p_ordered_selection_1);
+  for (int i = 0; i < ndim; ++i) {
+    free(ordered_selection[i]);
+  }
+  free(ordered_selection);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_get_orthogonal_selection(const b2nd_array_t *array, int64_t **selection, int64_t *selection_size, void *buffer,
+                                  int64_t *buffershape, int64_t buffersize) {
+  return orthogonal_selection((b2nd_array_t *)array, selection, selection_size, buffer, buffershape, buffersize, true);
+}
+
+
+int b2nd_set_orthogonal_selection(b2nd_array_t *array, int64_t **selection, int64_t *selection_size, const void *buffer,
+                                  int64_t *buffershape, int64_t buffersize) {
+  return orthogonal_selection(array, selection, selection_size, (void*)buffer, buffershape, buffersize, false);
+}
+
+
+// Lazy views
+
+struct b2nd_view_s {
+  const b2nd_array_t *array;
+  int8_t ndim;
+  int8_t axes[B2ND_MAX_DIM];    // the axis of the array of every dimension of the view
+  int64_t start[B2ND_MAX_DIM];  // the first index along every axis of the array
+  int64_t step[B2ND_MAX_DIM];   // the step along every axis of the array
+  int64_t count[B2ND_MAX_DIM];  // the number of indices along every axis of the array
+};
+
+int b2nd_view_new(const b2nd_array_t *array, b2nd_view_t **view) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(view, BLOSC2_ERROR_NULL_POINTER);
+  *view = malloc(sizeof(b2nd_view_t));
+  BLOSC_ERROR_NULL(*view, BLOSC2_ERROR_MEMORY_ALLOC);
+  (*view)->array = array;
+  (*view)->ndim = array->ndim;
+  for (int i = 0; i < array->ndim; ++i) {
+    (*view)->axes[i] = (int8_t) i;
+    (*view)->start[i] = 0;
+    (*view)->step[i] = 1;
+    (*view)->count[i] = array->shape[i];
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Compose a slice of `src` into `view` */
+static int slice_view(const b2nd_view_t *src, const int64_t *start, const int64_t *stop, const int64_t *step,
+                      b2nd_view_t *view) {
+  *view = *src;
+  for (int i = 0; i < src->ndim; ++i) {
+    int8_t axis = src->axes[i];
+    int64_t step_ = step != NULL ? step[i] : 1;
+    if (start[i] < 0 || start[i] > stop[i] || stop[i] > src->count[axis]) {
+      BLOSC_TRACE_ERROR("The slice [%" PRId64 ", %" PRId64 ") is out of the %" PRId64 " items of dimension %d",
+                        start[i], stop[i], src->count[axis], i);
+      return BLOSC2_ERROR_INVALID_INDEX;
     }
-    chunk_selection_0[ndim] = chunk_selection_1[ndim];
+    if (step_ <= 0) {
+      BLOSC_TRACE_ERROR("The steps have to be positive");
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    view->start[axis] = src->start[axis] + start[i] * src->step[axis];
+    view->step[axis] = src->step[axis] * step_;
+    view->count[axis] = (stop[i] - start[i] + step_ - 1) / step_;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
 
+int b2nd_view_slice(const b2nd_view_t *src, const int64_t *start, const int64_t *stop, const int64_t *step,
+                    b2nd_view_t **view) {
+  BLOSC_ERROR_NULL(src, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(view, BLOSC2_ERROR_NULL_POINTER);
+  *view = malloc(sizeof(b2nd_view_t));
+  BLOSC_ERROR_NULL(*view, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = slice_view(src, start, stop, step, *view);
+  if (rc < 0) {
+    free(*view);
+    *view = NULL;
   }
+  return rc;
+}
 
+int b2nd_view_squeeze(b2nd_view_t *view) {
+  BLOSC_ERROR_NULL(view, BLOSC2_ERROR_NULL_POINTER);
+  int8_t ndim = 0;
+  for (int i = 0; i < view->ndim; ++i) {
+    if (view->count[view->axes[i]] != 1) {
+      view->axes[ndim++] = view->axes[i];
+    }
+  }
+  view->ndim = ndim;
   return BLOSC2_ERROR_SUCCESS;
 }
 
+int b2nd_view_get_shape(const b2nd_view_t *view, int8_t *ndim, int64_t *shape) {
+  BLOSC_ERROR_NULL(view, BLOSC2_ERROR_NULL_POINTER);
+  if (ndim != NULL) {
+    *ndim = view->ndim;
+  }
+  for (int i = 0; shape != NULL && i < view->ndim; ++i) {
+    shape[i] = view->count[view->axes[i]];
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-int iter_block_maskout(b2nd_array_t *array, int8_t ndim,
-                       int64_t *sel_block_size,
-                       b2nd_selection_t **o_selection,
-                       b2nd_selection_t **p_o_sel_block_0,
-                       b2nd_selection_t **p_o_sel_block_1,
-                       bool *maskout) {
-  p_o_sel_block_0[ndim] = o_selection[ndim];
-  p_o_sel_block_1[ndim] = o_selection[ndim];
-  while (p_o_sel_block_1[ndim] - o_selection[ndim] < sel_block_size[ndim]) {
-    int64_t block_index_ndim = ((*p_o_sel_block_1[ndim]).value % array->chunkshape[ndim]) / array->blockshape[ndim];
-    while (p_o_sel_block_1[ndim] - o_selection[ndim] < sel_block_size[ndim] &&
-           block_index_ndim == ((*p_o_sel_block_1[ndim]).value % array->chunkshape[ndim]) / array->blockshape[ndim]) {
-      p_o_sel_block_1[ndim]++;
+int b2nd_view_to_cbuffer(const b2nd_view_t *view, void *buffer, int64_t buffersize) {
+  BLOSC_ERROR_NULL(view, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  const b2nd_array_t *array = view->array;
+  // The dimensions squeezed out take a single item, so the items are in the same order
+  int64_t size = array->sc->typesize;
+  bool steps = false;
+  int64_t stop[B2ND_MAX_DIM];
+  for (int i = 0; i < array->ndim; ++i) {
+    size *= view->count[i];
+    steps |= view->step[i] != 1 && view->count[i] > 1;
+    stop[i] = view->start[i] + view->count[i];
+  }
+  if (buffersize < size) {
+    BLOSC_TRACE_ERROR("The buffer (%" PRId64 " bytes) is smaller than the view (%" PRId64 " bytes)",
+                      buffersize, size);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (size == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (!steps) {
+    return b2nd_get_slice_cbuffer(array, view->start, stop, buffer, view->count, size);
+  }
+
+  // The indices along every axis
+  int64_t *selection[B2ND_MAX_DIM] = {0};
+  int64_t selection_size[B2ND_MAX_DIM];
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int i = 0; i < array->ndim && rc == BLOSC2_ERROR_SUCCESS; ++i) {
+    selection_size[i] = view->count[i];
+    selection[i] = malloc(view->count[i] * sizeof(int64_t));
+    if (selection[i] == NULL) {
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      break;
     }
-    if (ndim == array->ndim - 1) {
-      int64_t block_chunk_strides[B2ND_MAX_DIM];
-      block_chunk_strides[array->ndim - 1] = 1;
-      for (int i = array->ndim - 2; i >= 0; --i) {
-        block_chunk_strides[i] = block_chunk_strides[i + 1] * (array->extchunkshape[i + 1] / array->blockshape[i + 1]);
+    for (int64_t j = 0; j < view->count[i]; ++j) {
+      selection[i][j] = view->start[i] + j * view->step[i];
+    }
+  }
+  if (rc == BLOSC2_ERROR_SUCCESS) {
+    int64_t buffershape[B2ND_MAX_DIM];
+    memcpy(buffershape, view->count, sizeof(buffershape));
+    rc = b2nd_get_orthogonal_selection(array, selection, selection_size, buffer, buffershape, size);
+  }
+  for (int i = 0; i < array->ndim; ++i) {
+    free(selection[i]);
+  }
+  return rc;
+}
+
+int b2nd_view_get_slice_cbuffer(const b2nd_view_t *view, const int64_t *start, const int64_t *stop,
+                                void *buffer, int64_t buffersize) {
+  BLOSC_ERROR_NULL(view, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(start, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stop, BLOSC2_ERROR_NULL_POINTER);
+  b2nd_view_t slice;
+  BLOSC_ERROR(slice_view(view, start, stop, NULL, &slice));
+  return b2nd_view_to_cbuffer(&slice, buffer, buffersize);
+}
+
+int b2nd_view_free(b2nd_view_t *view) {
+  free(view);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+// Lazy expressions
+
+enum {
+  EXPR_ARRAY,
+  EXPR_SCALAR,
+  EXPR_OP,
+};
+
+/* An instruction of the (postfix) program of an expression */
+typedef struct {
+  int8_t kind;
+  int32_t arg;  // the index of the array, or the operation
+  double value;
+} expr_instr;
+
+struct b2nd_expr_s {
+  expr_instr *program;
+  int32_t ninstrs;
+  int32_t capacity;
+  const b2nd_array_t *arrays[B2ND_EXPR_MAX_ARRAYS];
+  int32_t narrays;
+  int32_t depth;     // the operands left on the stack
+  int32_t maxdepth;  // the most operands ever on the stack
+};
+
+/* Apply an operation to n items of a and b (or to the scalars that they point to, as given by mode) */
+typedef void (*expr_kernel)(int op, int mode, const uint8_t *a, const uint8_t *b, uint8_t *out, int32_t n);
+/* Store a scalar as an item */
+typedef void (*expr_convert)(double value, uint8_t *item);
+
+enum {
+  EXPR_VECTORS,
+  EXPR_VECTOR_SCALAR,
+  EXPR_SCALAR_VECTOR,
+};
+
+#define EXPR_APPLY(T, EXPR)                                                 \
+  switch (mode) {                                                           \
+    case EXPR_VECTORS:                                                      \
+      for (int32_t i = 0; i < n; i++) { T x = a_[i]; T y = b_[i]; out_[i] = (EXPR); } \
+      break;                                                                \
+    case EXPR_VECTOR_SCALAR: {                                              \
+      T y = b_[0];                                                          \
+      for (int32_t i = 0; i < n; i++) { T x = a_[i]; out_[i] = (EXPR); }    \
+      break;                                                                \
+    }                                                                       \
+    default: {                                                              \
+      T x = a_[0];                                                          \
+      for (int32_t i = 0; i < n; i++) { T y = b_[i]; out_[i] = (EXPR); }    \
+    }                                                                       \
+  }
+
+// Plain loops over typed items, so that the compiler vectorizes them
+#define EXPR_KERNEL(NAME, T, DIV)                                                                 \
+static void expr_kernel_##NAME(int op, int mode, const uint8_t *a, const uint8_t *b, uint8_t *out, int32_t n) { \
+  const T *a_ = (const T *) a;                                                                    \
+  const T *b_ = (const T *) b;                                                                    \
+  T *out_ = (T *) out;                                                                            \
+  switch (op) {                                                                                   \
+    case B2ND_EXPR_ADD:                                                                           \
+      EXPR_APPLY(T, x + y)                                                                        \
+      break;                                                                                      \
+    case B2ND_EXPR_SUB:                                                                           \
+      EXPR_APPLY(T, x - y)                                                                        \
+      break;                                                                                      \
+    case B2ND_EXPR_MUL:                                                                           \
+      EXPR_APPLY(T, x * y)                                                                        \
+      break;                                                                                      \
+    case B2ND_EXPR_DIV:                                                                           \
+      EXPR_APPLY(T, DIV)                                                                          \
+      break;                                                                                      \
+    case B2ND_EXPR_MIN:                                                                           \
+      EXPR_APPLY(T, x < y ? x : y)                                                                \
+      break;                                                                                      \
+    default:                                                                                      \
+      EXPR_APPLY(T, x > y ? x : y)                                                                \
+  }                                                                                               \
+}                                                                                                 \
+static void expr_convert_##NAME(double value, uint8_t *item) {                                    \
+  T value_ = (T) value;                                                                           \
+  memcpy(item, &value_, sizeof(T));                                                               \
+}
+
+EXPR_KERNEL(f8, double, x / y)
+EXPR_KERNEL(f4, float, x / y)
+EXPR_KERNEL(i8, int64_t, y != 0 ? x / y : 0)
+EXPR_KERNEL(i4, int32_t, y != 0 ? x / y : 0)
+EXPR_KERNEL(u8, uint64_t, y != 0 ? x / y : 0)
+EXPR_KERNEL(u4, uint32_t, y != 0 ? x / y : 0)
+
+/* An operand on the stack of the evaluation of a block */
+typedef struct {
+  const uint8_t *data;  // NULL for scalars
+  uint8_t scalar[8];
+} expr_operand;
+
+/* The evaluation of an expression, shared by the threads that compress the chunks of the result */
+typedef struct {
+  const b2nd_expr_t *expr;
+  expr_kernel kernel;
+  int32_t typesize;
+  int32_t blocksize;
+  uint8_t (*scalars)[8];       // the scalars of the program, as items
+  const uint8_t *chunks[B2ND_EXPR_MAX_ARRAYS];  // the chunks of the operands being evaluated
+  int32_t cbytes[B2ND_EXPR_MAX_ARRAYS];
+  blosc2_context **dctxs;      // one per thread
+  uint8_t *scratch;            // the blocks of the operands and the temporaries of every thread
+  int64_t scratch_nbytes;      // per thread
+  expr_operand *stacks;        // one per thread
+} expr_eval_state;
+
+/* Evaluate the block of an expression that goes with the block being compressed */
+static int expr_prefilter(blosc2_prefilter_params *params) {
+  expr_eval_state *state = (expr_eval_state *) params->user_data;
+  const b2nd_expr_t *expr = state->expr;
+  int32_t typesize = state->typesize;
+  int32_t nitems = params->output_size / typesize;
+  uint8_t *scratch = state->scratch + params->tid * state->scratch_nbytes;
+  expr_operand *stack = state->stacks + params->tid * expr->maxdepth;
+
+  // The blocks of the operands
+  for (int i = 0; i < expr->narrays; i++) {
+    uint8_t *block = scratch + i * state->blocksize;
+    if (blosc2_getitem_ctx(state->dctxs[params->tid], state->chunks[i], state->cbytes[i],
+                           params->output_offset / typesize, nitems, block, params->output_size) < 0) {
+      BLOSC_TRACE_ERROR("Cannot decompress the block %d of an operand", params->nblock);
+      return BLOSC2_ERROR_FAILURE;
+    }
+  }
+
+  // The results at a position of the stack go to the temporary of the position, the first being the output
+  int32_t sp = 0;
+  for (int32_t k = 0; k < expr->ninstrs; k++) {
+    const expr_instr *instr = &expr->program[k];
+    switch (instr->kind) {
+      case EXPR_ARRAY:
+        stack[sp].data = scratch + instr->arg * state->blocksize;
+        sp++;
+        break;
+      case EXPR_SCALAR:
+        stack[sp].data = NULL;
+        memcpy(stack[sp].scalar, state->scalars[k], typesize);
+        sp++;
+        break;
+      default: {
+        sp--;
+        expr_operand *a = &stack[sp - 1];
+        const expr_operand *b = &stack[sp];
+        if (a->data == NULL && b->data == NULL) {
+          state->kernel(instr->arg, EXPR_VECTORS, a->scalar, b->scalar, a->scalar, 1);
+          break;
+        }
+        uint8_t *out = sp == 1 ? params->output : scratch + (expr->narrays + sp - 2) * state->blocksize;
+        if (b->data == NULL) {
+          state->kernel(instr->arg, EXPR_VECTOR_SCALAR, a->data, b->scalar, out, nitems);
+        }
+        else if (a->data == NULL) {
+          state->kernel(instr->arg, EXPR_SCALAR_VECTOR, a->scalar, b->data, out, nitems);
+        }
+        else {
+          state->kernel(instr->arg, EXPR_VECTORS, a->data, b->data, out, nitems);
+        }
+        a->data = out;
       }
-      int64_t block_index[B2ND_MAX_DIM];
-      for (int i = 0; i < array->ndim; ++i) {
-        block_index[i] = ((*p_o_sel_block_0[i]).value % array->chunkshape[i]) / array->blockshape[i];
+    }
+  }
+
+  if (stack[0].data == NULL) {
+    for (int32_t i = 0; i < nitems; i++) {
+      memcpy(params->output + i * typesize, stack[0].scalar, typesize);
+    }
+  }
+  else if (stack[0].data != params->output) {
+    memcpy(params->output, stack[0].data, params->output_size);
+  }
+  return 0;
+}
+
+int b2nd_expr_new(b2nd_expr_t **expr) {
+  BLOSC_ERROR_NULL(expr, BLOSC2_ERROR_NULL_POINTER);
+  *expr = calloc(1, sizeof(b2nd_expr_t));
+  BLOSC_ERROR_NULL(*expr, BLOSC2_ERROR_MEMORY_ALLOC);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+static int expr_push(b2nd_expr_t *expr, int8_t kind, int32_t arg, double value) {
+  if (expr->ninstrs == expr->capacity) {
+    int32_t capacity = expr->capacity > 0 ? 2 * expr->capacity : 16;
+    expr_instr *program = realloc(expr->program, capacity * sizeof(expr_instr));
+    BLOSC_ERROR_NULL(program, BLOSC2_ERROR_MEMORY_ALLOC);
+    expr->program = program;
+    expr->capacity = capacity;
+  }
+  expr_instr *instr = &expr->program[expr->ninstrs++];
+  instr->kind = kind;
+  instr->arg = arg;
+  instr->value = value;
+  if (kind == EXPR_OP) {
+    expr->depth--;
+  }
+  else if (++expr->depth > expr->maxdepth) {
+    expr->maxdepth = expr->depth;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+int b2nd_expr_push_array(b2nd_expr_t *expr, const b2nd_array_t *array) {
+  BLOSC_ERROR_NULL(expr, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  // The arrays repeated are decompressed once
+  int32_t index = 0;
+  while (index < expr->narrays && expr->arrays[index] != array) {
+    index++;
+  }
+  if (index == expr->narrays) {
+    if (expr->narrays == B2ND_EXPR_MAX_ARRAYS) {
+      BLOSC_TRACE_ERROR("Expressions cannot have more than %d arrays", B2ND_EXPR_MAX_ARRAYS);
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    expr->arrays[expr->narrays++] = array;
+  }
+  return expr_push(expr, EXPR_ARRAY, index, 0);
+}
+
+int b2nd_expr_push_scalar(b2nd_expr_t *expr, double value) {
+  BLOSC_ERROR_NULL(expr, BLOSC2_ERROR_NULL_POINTER);
+  return expr_push(expr, EXPR_SCALAR, 0, value);
+}
+
+int b2nd_expr_push_op(b2nd_expr_t *expr, int op) {
+  BLOSC_ERROR_NULL(expr, BLOSC2_ERROR_NULL_POINTER);
+  if (op < B2ND_EXPR_ADD || op > B2ND_EXPR_MAX) {
+    BLOSC_TRACE_ERROR("Unknown operation: %d", op);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (expr->depth < 2) {
+    BLOSC_TRACE_ERROR("The operation %d needs two operands, but there are %d", op, expr->depth);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  return expr_push(expr, EXPR_OP, op, 0);
+}
+
+/* The kernels for the items of an array, or -1 if there are none */
+static int expr_kernels(const b2nd_array_t *array, expr_kernel *kernel, expr_convert *convert) {
+  int kind = reduce_kind(array);
+  int32_t typesize = array->sc->typesize;
+  if (kind == BLOSC2_ZONEMAP_FLOAT && typesize == 8) {
+    *kernel = expr_kernel_f8;
+    *convert = expr_convert_f8;
+  }
+  else if (kind == BLOSC2_ZONEMAP_FLOAT && typesize == 4) {
+    *kernel = expr_kernel_f4;
+    *convert = expr_convert_f4;
+  }
+  else if (kind == BLOSC2_ZONEMAP_INT && typesize == 8) {
+    *kernel = expr_kernel_i8;
+    *convert = expr_convert_i8;
+  }
+  else if (kind == BLOSC2_ZONEMAP_INT && typesize == 4) {
+    *kernel = expr_kernel_i4;
+    *convert = expr_convert_i4;
+  }
+  else if (kind == BLOSC2_ZONEMAP_UINT && typesize == 8) {
+    *kernel = expr_kernel_u8;
+    *convert = expr_convert_u8;
+  }
+  else if (kind == BLOSC2_ZONEMAP_UINT && typesize == 4) {
+    *kernel = expr_kernel_u4;
+    *convert = expr_convert_u4;
+  }
+  else {
+    return -1;
+  }
+  return 0;
+}
+
+/* Whether the operands of an expression go block by block with each other */
+static int check_operands(const b2nd_expr_t *expr) {
+  const b2nd_array_t *first = expr->arrays[0];
+  for (int32_t k = 1; k < expr->narrays; k++) {
+    const b2nd_array_t *array = expr->arrays[k];
+    bool same = array->ndim == first->ndim && array->sc->typesize == first->sc->typesize &&
+                strcmp(array->dtype, first->dtype) == 0;
+    for (int i = 0; same && i < first->ndim; i++) {
+      same = array->shape[i] == first->shape[i] && array->chunkshape[i] == first->chunkshape[i] &&
+             array->blockshape[i] == first->blockshape[i];
+    }
+    if (!same) {
+      BLOSC_TRACE_ERROR("The arrays of an expression must have the same shapes and dtype");
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Compress the chunks of the result, evaluating their blocks as they are compressed */
+static int expr_eval_chunks(const b2nd_expr_t *expr, expr_eval_state *state, b2nd_array_t *array) {
+  blosc2_schunk *sc = array->sc;
+  blosc2_cparams cparams;
+  blosc2_ctx_get_cparams(sc->cctx, &cparams);
+  blosc2_prefilter_params preparams = {0};
+  preparams.user_data = state;
+  cparams.prefilter = expr_prefilter;
+  cparams.preparams = &preparams;
+  int nthreads = cparams.nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 1;
+
+  int rc = BLOSC2_ERROR_SUCCESS;
+  int32_t chunksize = sc->chunksize;
+  uint8_t *src = calloc(1, chunksize);
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  state->dctxs = calloc(nthreads, sizeof(blosc2_context *));
+  state->scratch_nbytes = (int64_t) (expr->narrays + expr->maxdepth - 1) * state->blocksize;
+  state->scratch = malloc(nthreads * state->scratch_nbytes);
+  state->stacks = malloc(nthreads * expr->maxdepth * sizeof(expr_operand));
+  if (src == NULL || cctx == NULL || state->dctxs == NULL || state->scratch == NULL || state->stacks == NULL) {
+    BLOSC_TRACE_ERROR("Cannot create the contexts for the evaluation.");
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto end;
+  }
+  for (int i = 0; i < nthreads; i++) {
+    state->dctxs[i] = blosc2_create_dctx(dparams);
+    if (state->dctxs[i] == NULL) {
+      rc = BLOSC2_ERROR_FAILURE;
+      goto end;
+    }
+  }
+
+  bool needs_free[B2ND_EXPR_MAX_ARRAYS] = {0};
+  for (int64_t nchunk = 0; nchunk < sc->nchunks && rc >= 0; nchunk++) {
+    for (int32_t k = 0; k < expr->narrays; k++) {
+      int cbytes = blosc2_schunk_get_chunk(expr->arrays[k]->sc, nchunk, (uint8_t **) &state->chunks[k],
+                                           &needs_free[k]);
+      if (cbytes < 0) {
+        BLOSC_TRACE_ERROR("Cannot get the chunk %" PRId64 " of an operand.", nchunk);
+        rc = cbytes;
       }
-      int64_t nblock = 0;
-      for (int i = 0; i < array->ndim; ++i) {
-        nblock += block_index[i] * block_chunk_strides[i];
+      state->cbytes[k] = cbytes;
+    }
+    int32_t destsize = chunksize + BLOSC2_MAX_OVERHEAD;
+    uint8_t *chunk = rc < 0 ? NULL : malloc(destsize);
+    int csize = chunk == NULL ? BLOSC2_ERROR_MEMORY_ALLOC : blosc2_compress_ctx(cctx, src, chunksize, chunk, destsize);
+    for (int32_t k = 0; k < expr->narrays; k++) {
+      if (needs_free[k]) {
+        free((uint8_t *) state->chunks[k]);
+        needs_free[k] = false;
       }
-      maskout[nblock] = false;
-    } else {
-      BLOSC_ERROR(iter_block_maskout(array, (int8_t) (ndim + 1), sel_block_size,
-                                     o_selection, p_o_sel_block_0, p_o_sel_block_1,
-                                     maskout)
-      );
     }
-    p_o_sel_block_0[ndim] = p_o_sel_block_1[ndim];
+    if (rc < 0 || csize < 0) {
+      free(chunk);
+      rc = rc < 0 ? rc : csize;
+      break;
+    }
+    if (blosc2_schunk_update_chunk(sc, nchunk, chunk, false) < 0) {
+      free(chunk);
+      rc = BLOSC2_ERROR_CHUNK_UPDATE;
+    }
+  }
+
+  end:
+  if (state->dctxs != NULL) {
+    for (int i = 0; i < nthreads; i++) {
+      if (state->dctxs[i] != NULL) {
+        blosc2_free_ctx(state->dctxs[i]);
+      }
+    }
+  }
+  if (cctx != NULL) {
+    blosc2_free_ctx(cctx);
+  }
+  free(state->dctxs);
+  free(state->scratch);
+  free(state->stacks);
+  free(src);
+  return rc;
+}
+
+int b2nd_expr_eval(const b2nd_expr_t *expr, b2nd_context_t *ctx, b2nd_array_t **array) {
+  BLOSC_ERROR_NULL(expr, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  if (expr->narrays == 0 || expr->depth != 1) {
+    BLOSC_TRACE_ERROR("The expression must have arrays, and a single operand left (it has %d)", expr->depth);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  BLOSC_ERROR(check_operands(expr));
+  const b2nd_array_t *first = expr->arrays[0];
+  expr_eval_state state = {.expr=expr, .typesize=first->sc->typesize};
+  expr_convert convert;
+  if (expr_kernels(first, &state.kernel, &convert) < 0) {
+    BLOSC_TRACE_ERROR("The items of dtype %s cannot be evaluated", first->dtype != NULL ? first->dtype : "(none)");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  for (int32_t k = 0; k < expr->narrays; k++) {
+    // The chunks in the write cache have to be in the super-chunk
+    BLOSC_ERROR(b2nd_flush((b2nd_array_t *) expr->arrays[k]));
+  }
+
+  // The result goes block by block with the operands
+  ctx->ndim = first->ndim;
+  int32_t blocknitems = 1;
+  for (int i = 0; i < first->ndim; i++) {
+    ctx->shape[i] = first->shape[i];
+    ctx->chunkshape[i] = first->chunkshape[i];
+    ctx->blockshape[i] = first->blockshape[i];
+    blocknitems *= first->blockshape[i];
+  }
+  ctx->auto_chunkshape = false;
+  ctx->auto_blockshape = false;
+  free(ctx->dtype);
+  ctx->dtype = strdup(first->dtype);
+  ctx->dtype_format = first->dtype_format;
+  ctx->b2_storage->cparams->typesize = state.typesize;
+  ctx->b2_storage->cparams->blocksize = blocknitems * state.typesize;
+  state.blocksize = blocknitems * state.typesize;
+  BLOSC_ERROR(b2nd_uninit(ctx, array));
+
+  state.scalars = malloc(expr->ninstrs * sizeof(*state.scalars));
+  if (state.scalars == NULL) {
+    b2nd_free(*array);
+    *array = NULL;
+    BLOSC_ERROR(BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  for (int32_t k = 0; k < expr->ninstrs; k++) {
+    if (expr->program[k].kind == EXPR_SCALAR) {
+      convert(expr->program[k].value, state.scalars[k]);
+    }
+  }
+  int rc = (*array)->nitems == 0 ? BLOSC2_ERROR_SUCCESS : expr_eval_chunks(expr, &state, *array);
+  free(state.scalars);
+  if (rc >= 0 && (*array)->chunk_order != B2ND_CHUNK_ORDER_C) {
+    rc = b2nd_reorder_chunks(*array);
+  }
+  if (rc < 0) {
+    b2nd_free(*array);
+    *array = NULL;
+  }
+  return rc;
+}
+
+int b2nd_expr_free(b2nd_expr_t *expr) {
+  if (expr != NULL) {
+    free(expr->program);
+    free(expr);
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* A point of a coordinate selection */
+typedef struct {
+  int64_t nchunk;
+  int64_t offset;  // of the item in the decompressed chunk
+  int64_t index;  // of the item in the buffer
+} selection_point;
+
+static int compare_points(const void *a, const void *b) {
+  const selection_point *pa = (const selection_point *) a;
+  const selection_point *pb = (const selection_point *) b;
+  if (pa->nchunk != pb->nchunk) {
+    return pa->nchunk < pb->nchunk ? -1 : 1;
+  }
+  if (pa->offset != pb->offset) {
+    return pa->offset < pb->offset ? -1 : 1;
+  }
+  // The last of the points set to the same item wins
+  return (pa->index > pb->index) - (pa->index < pb->index);
+}
+
+/* The chunks of a coordinate selection, and the points in every one of them */
+typedef struct {
+  b2nd_array_t *array;
+  uint8_t *buffer;
+  bool get;
+  selection_point *points;  // sorted by chunk and by their place in it
+  int64_t *chunk_points;  // where the points of every chunk start (and end, for the last one)
+  int32_t nchunks;
+  volatile int32_t next_chunk;
+  uint8_t **srcs;  // the (lazy) chunks to decompress, when processed in parallel
+  int32_t *srcsizes;
+  bool *needs_free;
+  uint8_t **dests;  // the compressed chunks, for setting the points
+  int *rcs;
+} points_batch;
+
+/* A job processing chunks of a points_batch, with its own (single-threaded) contexts when in parallel */
+typedef struct {
+  points_batch *batch;
+  blosc2_context *dctx;
+  blosc2_context *cctx;
+  uint8_t *data;
+  bool *maskout;
+} points_job;
+
+
+/* Decompress the chunk `i` of the batch, only the blocks with points when getting them */
+static int decompress_points_chunk(points_job *job, int32_t i) {
+  points_batch *batch = job->batch;
+  b2nd_array_t *array = batch->array;
+  int64_t nchunk = batch->points[batch->chunk_points[i]].nchunk;
+  int32_t data_nbytes = (int32_t) array->extchunknitems * array->sc->typesize;
+  int nblocks = (int) (array->extchunknitems / array->blocknitems);
+
+  // The maskout is for the context decompressing the chunk (see blosc2_schunk_set_concurrent_reads())
+  blosc2_context *dctx = job->dctx != NULL ? job->dctx : schunk_acquire_dctx(array->sc);
+  BLOSC_ERROR_NULL(dctx, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  if (batch->get) {
+    for (int nblock = 0; nblock < nblocks; ++nblock) {
+      job->maskout[nblock] = true;
+    }
+    for (int64_t p = batch->chunk_points[i]; p < batch->chunk_points[i + 1]; ++p) {
+      job->maskout[batch->points[p].offset / array->blocknitems] = false;
+    }
+    rc = blosc2_set_maskout(dctx, job->maskout, nblocks);
+  }
+  if (rc >= 0) {
+    if (job->dctx != NULL) {
+      rc = blosc2_decompress_ctx(dctx, batch->srcs[i], batch->srcsizes[i], job->data, data_nbytes);
+    }
+    else {
+      rc = schunk_decompress_chunk_ctx(array->sc, dctx, nchunk, job->data, data_nbytes);
+    }
+  }
+  if (job->dctx == NULL) {
+    schunk_release_dctx(array->sc, dctx);
+  }
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Error decompressing chunk %" PRId64 ".", nchunk);
+    return rc;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
 
+/* Get or set the points in the chunk `i` of the batch (its compressed chunk goes to `dests` when set) */
+static int process_points_chunk(points_job *job, int32_t i) {
+  points_batch *batch = job->batch;
+  b2nd_array_t *array = batch->array;
+  int32_t typesize = array->sc->typesize;
+  int32_t data_nbytes = (int32_t) array->extchunknitems * typesize;
+
+  BLOSC_ERROR(decompress_points_chunk(job, i));
+  for (int64_t p = batch->chunk_points[i]; p < batch->chunk_points[i + 1]; ++p) {
+    const selection_point *point = &batch->points[p];
+    if (batch->get) {
+      memcpy(&batch->buffer[point->index * typesize], &job->data[point->offset * typesize], typesize);
+    }
+    else {
+      memcpy(&job->data[point->offset * typesize], &batch->buffer[point->index * typesize], typesize);
+    }
   }
 
+  if (!batch->get) {
+    int32_t chunk_nbytes = data_nbytes + BLOSC2_MAX_OVERHEAD;
+    batch->dests[i] = malloc(chunk_nbytes);
+    BLOSC_ERROR_NULL(batch->dests[i], BLOSC2_ERROR_MEMORY_ALLOC);
+    blosc2_context *cctx = job->cctx != NULL ? job->cctx : array->sc->cctx;
+    int rc = blosc2_compress_ctx(cctx, job->data, data_nbytes, batch->dests[i], chunk_nbytes);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Blosc can not compress the data");
+      return rc;
+    }
+  }
   return BLOSC2_ERROR_SUCCESS;
 }
 
+static void process_points_chunks(void *data) {
+  points_job *job = (points_job *) data;
+  points_batch *batch = job->batch;
+  int32_t i;
+  while ((i = blosc_atomic_add32(&batch->next_chunk, 1)) < batch->nchunks) {
+    batch->rcs[i] = process_points_chunk(job, i);
+  }
+}
 
-int iter_chunk(b2nd_array_t *array, int8_t ndim,
-               int64_t *selection_size,
-               b2nd_selection_t **ordered_selection,
-               b2nd_selection_t **p_ordered_selection_0,
-               b2nd_selection_t **p_ordered_selection_1,
-               uint8_t *buffer,
-               int64_t *buffershape,
-               int64_t *bufferstrides,
-               bool get) {
-  p_ordered_selection_0[ndim] = ordered_selection[ndim];
-  p_ordered_selection_1[ndim] = ordered_selection[ndim];
-  while (p_ordered_selection_1[ndim] - ordered_selection[ndim] < selection_size[ndim]) {
-    int64_t chunk_index_ndim = (*p_ordered_selection_1[ndim]).value / array->chunkshape[ndim];
-    while (p_ordered_selection_1[ndim] - ordered_selection[ndim] < selection_size[ndim] &&
-           chunk_index_ndim == (*p_ordered_selection_1[ndim]).value / array->chunkshape[ndim]) {
-      p_ordered_selection_1[ndim]++;
+
+/* Get or set the points of a coordinate selection, a chunk at a time, or the chunks in parallel (with
+ * the chunks to be decompressed fetched first, as the backing storage must not be read concurrently) */
+static int process_points(points_batch *batch) {
+  b2nd_array_t *array = batch->array;
+  blosc2_schunk *sc = array->sc;
+  int32_t nchunks = batch->nchunks;
+  bool parallel = parallel_chunks(array, nchunks, !batch->get);
+  int njobs = parallel ? blosc_pool_nthreads() + 1 : 1;
+  if (njobs > nchunks) {
+    njobs = nchunks;
+  }
+  int64_t data_nbytes = array->extchunknitems * sc->typesize;
+  int nblocks = (int) (array->extchunknitems / array->blocknitems);
+
+  batch->srcs = calloc(nchunks, sizeof(uint8_t *));
+  batch->srcsizes = calloc(nchunks, sizeof(int32_t));
+  batch->needs_free = calloc(nchunks, sizeof(bool));
+  batch->dests = calloc(nchunks, sizeof(uint8_t *));
+  batch->rcs = calloc(nchunks, sizeof(int));
+  points_job *jobs = calloc(njobs, sizeof(points_job));
+  int rc = BLOSC2_ERROR_SUCCESS;
+  if (batch->srcs == NULL || batch->srcsizes == NULL || batch->needs_free == NULL || batch->dests == NULL ||
+      batch->rcs == NULL || jobs == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate the batch of chunks.");
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto end;
+  }
+
+  blosc2_cparams cparams;
+  blosc2_ctx_get_cparams(sc->cctx, &cparams);
+  cparams.nthreads = 1;
+  blosc2_dparams dparams;
+  blosc2_ctx_get_dparams(sc->dctx, &dparams);
+  dparams.nthreads = 1;
+  for (int i = 0; i < njobs; i++) {
+    jobs[i].batch = batch;
+    if (parallel) {
+      jobs[i].dctx = blosc2_create_dctx(dparams);
+      jobs[i].cctx = batch->get ? NULL : blosc2_create_cctx(cparams);
     }
-    if (ndim == array->ndim - 1) {
-      int64_t chunk_array_strides[B2ND_MAX_DIM];
-      chunk_array_strides[array->ndim - 1] = 1;
-      for (int i = array->ndim - 2; i >= 0; --i) {
-        chunk_array_strides[i] = chunk_array_strides[i + 1] *
-                                 (array->extshape[i + 1] / array->chunkshape[i + 1]);
-      }
-      int64_t chunk_index[B2ND_MAX_DIM];
-      for (int i = 0; i < array->ndim; ++i) {
-        chunk_index[i] = (*p_ordered_selection_0[i]).value / array->chunkshape[i];
+    jobs[i].data = malloc(data_nbytes);
+    jobs[i].maskout = malloc(nblocks * sizeof(bool));
+    if ((parallel && (jobs[i].dctx == NULL || (!batch->get && jobs[i].cctx == NULL))) ||
+        jobs[i].data == NULL || jobs[i].maskout == NULL) {
+      BLOSC_TRACE_ERROR("Cannot create the contexts for the batch.");
+      rc = BLOSC2_ERROR_FAILURE;
+      goto end;
+    }
+  }
+
+  if (parallel) {
+    for (int32_t i = 0; i < nchunks; i++) {
+      int64_t nchunk = batch->points[batch->chunk_points[i]].nchunk;
+      int cbytes = blosc2_schunk_get_lazychunk(sc, nchunk, &batch->srcs[i], &batch->needs_free[i]);
+      if (cbytes <= 0) {
+        BLOSC_TRACE_ERROR("Cannot get the chunk %" PRId64 ".", nchunk);
+        rc = cbytes < 0 ? cbytes : BLOSC2_ERROR_NOT_FOUND;
+        goto end;
       }
-      int64_t nchunk = 0;
-      for (int i = 0; i < array->ndim; ++i) {
-        nchunk += chunk_index[i] * chunk_array_strides[i];
+      batch->srcsizes[i] = cbytes;
+    }
+    batch->next_chunk = 0;
+    blosc_pool_run(NULL, process_points_chunks, njobs, sizeof(points_job), jobs);
+    for (int32_t i = 0; i < nchunks; i++) {
+      if (batch->rcs[i] < 0) {
+        rc = batch->rcs[i];
+        goto end;
       }
-
-      int64_t nblocks = array->extchunknitems / array->blocknitems;
-      b2nd_selection_t **p_chunk_selection_0 = malloc(array->ndim * sizeof(b2nd_selection_t *));
-      BLOSC_ERROR_NULL(p_chunk_selection_0, BLOSC2_ERROR_MEMORY_ALLOC);
-      b2nd_selection_t **p_chunk_selection_1 = malloc(array->ndim * sizeof(b2nd_selection_t *));
-      BLOSC_ERROR_NULL(p_chunk_selection_1, BLOSC2_ERROR_MEMORY_ALLOC);
-      int64_t *chunk_selection_size = malloc(array->ndim * sizeof(int64_t));
-      BLOSC_ERROR_NULL(chunk_selection_size, BLOSC2_ERROR_MEMORY_ALLOC);
-      for (int i = 0; i < array->ndim; ++i) {
-        chunk_selection_size[i] = p_ordered_selection_1[i] - p_ordered_selection_0[i];
+    }
+    // The sources are not needed anymore, and updating chunks may invalidate them
+    for (int32_t i = 0; i < nchunks; i++) {
+      if (batch->needs_free[i]) {
+        free(batch->srcs[i]);
       }
+      batch->needs_free[i] = false;
+    }
+  }
 
-      if (get) {
-        bool *maskout = calloc(nblocks, sizeof(bool));
-        for (int i = 0; i < nblocks; ++i) {
-          maskout[i] = true;
-        }
-
-        BLOSC_ERROR(iter_block_maskout(array, (int8_t) 0,
-                                       chunk_selection_size,
-                                       p_ordered_selection_0,
-                                       p_chunk_selection_0,
-                                       p_chunk_selection_1,
-                                       maskout));
-
-        if (blosc2_set_maskout(array->sc->dctx, maskout, (int) nblocks) !=
-            BLOSC2_ERROR_SUCCESS) {
-          BLOSC_TRACE_ERROR("Error setting the maskout");
-          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-        }
-        free(maskout);
+  for (int32_t i = 0; i < nchunks; i++) {
+    if (!parallel) {
+      rc = process_points_chunk(&jobs[0], i);
+      if (rc < 0) {
+        goto end;
       }
-      int data_nitems = (int) array->extchunknitems;
-      int data_nbytes = data_nitems * array->sc->typesize;
-      uint8_t *data = malloc(data_nitems * array->sc->typesize);
-      BLOSC_ERROR_NULL(data, BLOSC2_ERROR_MEMORY_ALLOC);
-      int err = blosc2_schunk_decompress_chunk(array->sc, nchunk, data, data_nbytes);
-      if (err < 0) {
-        BLOSC_TRACE_ERROR("Error decompressing chunk");
-        BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+    }
+    if (!batch->get) {
+      // The offsets of the frame must be updated in order
+      int64_t nchunk = batch->points[batch->chunk_points[i]].nchunk;
+      int64_t nchunks_ = blosc2_schunk_update_chunk(sc, nchunk, batch->dests[i], false);
+      batch->dests[i] = NULL;
+      if (nchunks_ < 0) {
+        BLOSC_TRACE_ERROR("Blosc can not update the chunk");
+        rc = (int) nchunks_;
+        goto end;
       }
-      BLOSC_ERROR(iter_block_copy(array, 0, chunk_selection_size,
-                                  p_ordered_selection_0, p_chunk_selection_0, p_chunk_selection_1,
-                                  data, buffer, buffershape, bufferstrides, get));
+    }
+  }
 
-      if (!get) {
-        int32_t chunk_size = data_nbytes + BLOSC_EXTENDED_HEADER_LENGTH;
-        uint8_t *chunk = malloc(chunk_size);
-        BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
-        err = blosc2_compress_ctx(array->sc->cctx, data, data_nbytes, chunk, chunk_size);
-        if (err < 0) {
-          BLOSC_TRACE_ERROR("Error compressing data");
-          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-        }
-        err = (int) blosc2_schunk_update_chunk(array->sc, nchunk, chunk, false);
-        if (err < 0) {
-          BLOSC_TRACE_ERROR("Error updating chunk");
-          BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
-        }
+  end:
+  if (jobs != NULL) {
+    for (int i = 0; i < njobs; i++) {
+      if (jobs[i].dctx != NULL) {
+        blosc2_free_ctx(jobs[i].dctx);
       }
-      free(data);
-      free(chunk_selection_size);
-      free(p_chunk_selection_0);
-      free(p_chunk_selection_1);
-    } else {
-      BLOSC_ERROR(iter_chunk(array, (int8_t) (ndim + 1), selection_size,
-                             ordered_selection, p_ordered_selection_0, p_ordered_selection_1,
-                             buffer, buffershape, bufferstrides, get));
+      if (jobs[i].cctx != NULL) {
+        blosc2_free_ctx(jobs[i].cctx);
+      }
+      free(jobs[i].data);
+      free(jobs[i].maskout);
     }
-
-    p_ordered_selection_0[ndim] = p_ordered_selection_1[ndim];
   }
-  return BLOSC2_ERROR_SUCCESS;
+  for (int32_t i = 0; i < nchunks; i++) {
+    if (batch->needs_free != NULL && batch->needs_free[i]) {
+      free(batch->srcs[i]);
+    }
+    if (batch->dests != NULL) {
+      free(batch->dests[i]);
+    }
+  }
+  free(jobs);
+  free(batch->srcs);
+  free(batch->srcsizes);
+  free(batch->needs_free);
+  free(batch->dests);
+  free(batch->rcs);
+  return rc;
 }
 
 
-int orthogonal_selection(b2nd_array_t *array, int64_t **selection, int64_t *selection_size, void *buffer,
-                         int64_t *buffershape, int64_t buffersize, bool get) {
+static int coordinate_selection(b2nd_array_t *array, const int64_t *coords, int64_t npoints, uint8_t *buffer,
+                                int64_t buffersize, bool get) {
   BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(selection, BLOSC2_ERROR_NULL_POINTER);
-  BLOSC_ERROR_NULL(selection_size, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(coords, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  if (npoints < 0 || buffersize < npoints * array->sc->typesize) {
+    BLOSC_TRACE_ERROR("The buffer cannot hold the %" PRId64 " points.", npoints);
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  if (array->ndim == 0) {
+    BLOSC_TRACE_ERROR("Coordinate selections need arrays with dimensions.");
+    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  }
+  if (npoints == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  BLOSC_ERROR(b2nd_flush(array));
 
   int8_t ndim = array->ndim;
+  int64_t chunk_strides[B2ND_MAX_DIM];
+  chunk_strides[ndim - 1] = 1;
+  for (int i = ndim - 2; i >= 0; --i) {
+    chunk_strides[i] = chunk_strides[i + 1] * (array->extshape[i + 1] / array->chunkshape[i + 1]);
+  }
 
-  for (int i = 0; i < ndim; ++i) {
-    BLOSC_ERROR_NULL(selection[i], BLOSC2_ERROR_NULL_POINTER);
-    // Check that indexes are not larger than array shape
-    for (int j = 0; j < selection_size[i]; ++j) {
-      if (selection[i][j] > array->shape[i]) {
+  // Where every point is in the chunks
+  selection_point *points = malloc(npoints * sizeof(selection_point));
+  BLOSC_ERROR_NULL(points, BLOSC2_ERROR_MEMORY_ALLOC);
+  for (int64_t p = 0; p < npoints; ++p) {
+    const int64_t *coord = &coords[p * ndim];
+    int64_t nchunk = 0;
+    int64_t nblock = 0;
+    int64_t nitem = 0;
+    for (int i = 0; i < ndim; ++i) {
+      if (coord[i] < 0 || coord[i] >= array->shape[i]) {
+        free(points);
+        BLOSC_TRACE_ERROR("The point %" PRId64 " is out of the array.", p);
         BLOSC_ERROR(BLOSC2_ERROR_INVALID_INDEX);
       }
+      int64_t in_chunk = coord[i] % array->chunkshape[i];
+      nchunk += coord[i] / array->chunkshape[i] * chunk_strides[i];
+      nblock += in_chunk / array->blockshape[i] * array->block_chunk_strides[i];
+      nitem += in_chunk % array->blockshape[i] * array->item_block_strides[i];
     }
+    points[p].nchunk = nchunk;
+    points[p].offset = nblock * array->blocknitems + nitem;
+    points[p].index = p;
   }
+  qsort(points, npoints, sizeof(selection_point), compare_points);
 
-  // Check buffer size
-  int64_t sel_size = array->sc->typesize;
-  for (int i = 0; i < ndim; ++i) {
-    sel_size *= selection_size[i];
+  // Group the points by chunk
+  int64_t *chunk_points = malloc((npoints + 1) * sizeof(int64_t));
+  if (chunk_points == NULL) {
+    free(points);
+    BLOSC_ERROR(BLOSC2_ERROR_MEMORY_ALLOC);
   }
-
-  if (sel_size < buffersize) {
-    BLOSC_ERROR(BLOSC2_ERROR_INVALID_PARAM);
+  int32_t nchunks = 0;
+  for (int64_t p = 0; p < npoints; ++p) {
+    if (p == 0 || points[p].nchunk != points[p - 1].nchunk) {
+      chunk_points[nchunks++] = p;
+    }
   }
+  chunk_points[nchunks] = npoints;
 
-  // Sort selections
-  b2nd_selection_t **ordered_selection = malloc(ndim * sizeof(b2nd_selection_t *));
-  BLOSC_ERROR_NULL(ordered_selection, BLOSC2_ERROR_MEMORY_ALLOC);
-  for (int i = 0; i < ndim; ++i) {
-    ordered_selection[i] = malloc(selection_size[i] * sizeof(b2nd_selection_t));
-    for (int j = 0; j < selection_size[i]; ++j) {
-      ordered_selection[i][j].index = j;
-      ordered_selection[i][j].value = selection[i][j];
+  points_batch batch = {.array = array, .buffer = buffer, .get = get, .points = points,
+                        .chunk_points = chunk_points, .nchunks = nchunks};
+  int rc = process_points(&batch);
+  free(points);
+  free(chunk_points);
+  BLOSC_ERROR(rc);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_get_coordinate_selection(const b2nd_array_t *array, const int64_t *coords, int64_t npoints,
+                                  void *buffer, int64_t buffersize) {
+  return coordinate_selection((b2nd_array_t *) array, coords, npoints, buffer, buffersize, true);
+}
+
+
+int b2nd_set_coordinate_selection(b2nd_array_t *array, const int64_t *coords, int64_t npoints,
+                                  const void *buffer, int64_t buffersize) {
+  return coordinate_selection(array, coords, npoints, (uint8_t *) buffer, buffersize, false);
+}
+
+
+/* The coordinates of the items selected by a mask, in C order */
+static int64_t mask_coords(const b2nd_array_t *array, const bool *mask, int64_t **coords) {
+  int8_t ndim = array->ndim;
+  int64_t npoints = 0;
+  for (int64_t i = 0; i < array->nitems; ++i) {
+    npoints += mask[i];
+  }
+  *coords = malloc((npoints * ndim + 1) * sizeof(int64_t));
+  BLOSC_ERROR_NULL(*coords, BLOSC2_ERROR_MEMORY_ALLOC);
+  int64_t coord[B2ND_MAX_DIM] = {0};
+  int64_t p = 0;
+  for (int64_t i = 0; i < array->nitems; ++i) {
+    if (mask[i]) {
+      memcpy(&(*coords)[p * ndim], coord, ndim * sizeof(int64_t));
+      p++;
+    }
+    // The next item
+    for (int j = ndim - 1; j >= 0; --j) {
+      if (++coord[j] < array->shape[j]) {
+        break;
+      }
+      coord[j] = 0;
     }
-    qsort(ordered_selection[i], selection_size[i], sizeof(b2nd_selection_t), compare_selection);
   }
+  return npoints;
+}
 
-  // Define pointers to iterate over ordered_selection data
-  b2nd_selection_t **p_ordered_selection_0 = malloc(ndim * sizeof(b2nd_selection_t *));
-  BLOSC_ERROR_NULL(p_ordered_selection_0, BLOSC2_ERROR_MEMORY_ALLOC);
-  b2nd_selection_t **p_ordered_selection_1 = malloc(ndim * sizeof(b2nd_selection_t *));
-  BLOSC_ERROR_NULL(p_ordered_selection_1, BLOSC2_ERROR_MEMORY_ALLOC);
 
-  int64_t bufferstrides[B2ND_MAX_DIM];
-  bufferstrides[array->ndim - 1] = 1;
-  for (int i = array->ndim - 2; i >= 0; --i) {
-    bufferstrides[i] = bufferstrides[i + 1] * buffershape[i + 1];
+int b2nd_get_mask_selection(const b2nd_array_t *array, const bool *mask, void *buffer, int64_t buffersize,
+                            int64_t *nselected) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(mask, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(nselected, BLOSC2_ERROR_NULL_POINTER);
+
+  int64_t *coords;
+  int64_t npoints = mask_coords(array, mask, &coords);
+  if (npoints < 0) {
+    return (int) npoints;
   }
+  int rc = coordinate_selection((b2nd_array_t *) array, coords, npoints, buffer, buffersize, true);
+  free(coords);
+  BLOSC_ERROR(rc);
+  *nselected = npoints;
 
-  BLOSC_ERROR(iter_chunk(array, 0,
-                         selection_size, ordered_selection,
-                         p_ordered_selection_0,
-                         p_ordered_selection_1,
-                         buffer, buffershape, bufferstrides, get));
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  // Free allocated memory
-  free(p_ordered_selection_0);
-  free(p_ordered_selection_1);
-  for (int i = 0; i < ndim; ++i) {
-    free(ordered_selection[i]);
+
+int b2nd_set_mask_selection(b2nd_array_t *array, const bool *mask, const void *buffer, int64_t buffersize) {
+  BLOSC_ERROR_NULL(array, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(mask, BLOSC2_ERROR_NULL_POINTER);
+
+  int64_t *coords;
+  int64_t npoints = mask_coords(array, mask, &coords);
+  if (npoints < 0) {
+    return (int) npoints;
   }
-  free(ordered_selection);
+  int rc = coordinate_selection(array, coords, npoints, (uint8_t *) buffer, buffersize, false);
+  free(coords);
+  BLOSC_ERROR(rc);
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
-int b2nd_get_orthogonal_selection(const b2nd_array_t *array, int64_t **selection, int64_t *selection_size, void *buffer,
-                                  int64_t *buffershape, int64_t buffersize) {
-  return orthogonal_selection((b2nd_array_t *)array, selection, selection_size, buffer, buffershape, buffersize, true);
+/* Whether a shape is left to choose */
+static bool auto_shape(int8_t ndim, const int32_t *shape) {
+  bool zeros = true;
+  for (int i = 0; shape != NULL && i < ndim; i++) {
+    zeros &= shape[i] == 0;
+  }
+  return zeros;
 }
 
+/* Fit a shape of about `nitems` items within `bounds`, in the way that an access pattern goes */
+static void fit_shape(int8_t ndim, const int64_t *bounds, int64_t nitems, int8_t access_pattern, int8_t axis,
+                      int32_t *shape) {
+  if (access_pattern == B2ND_ACCESS_SCANS) {
+    // Whole rows of the last dimensions first
+    for (int i = ndim - 1; i >= 0; i--) {
+      int64_t edge = bounds[i] < nitems ? bounds[i] : nitems;
+      shape[i] = (int32_t) (edge > 1 ? edge : 1);
+      nitems /= shape[i];
+    }
+    return;
+  }
 
-int b2nd_set_orthogonal_selection(b2nd_array_t *array, int64_t **selection, int64_t *selection_size, const void *buffer,
-                                  int64_t *buffershape, int64_t buffersize) {
-  return orthogonal_selection(array, selection, selection_size, (void*)buffer, buffershape, buffersize, false);
+  // As close to a cube as the bounds allow, the narrow dimensions first (they take all they can)
+  int order[B2ND_MAX_DIM];
+  int nleft = 0;
+  for (int i = 0; i < ndim; i++) {
+    if (access_pattern == B2ND_ACCESS_AXIS_SLICES && i == axis) {
+      shape[i] = 1;
+      continue;
+    }
+    int j = nleft++;
+    for (; j > 0 && bounds[order[j - 1]] > bounds[i]; j--) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+  for (int j = 0; j < nleft; j++) {
+    int i = order[j];
+    int64_t edge = (int64_t) (pow((double) nitems, 1. / (nleft - j)) + 1e-9);
+    edge = bounds[i] < edge ? bounds[i] : edge;
+    shape[i] = (int32_t) (edge > 1 ? edge : 1);
+    nitems /= shape[i];
+  }
+}
+
+/* Choose the chunks and blocks left to choose for an access pattern, and the blocksize that goes with them */
+static void choose_shapes(b2nd_context_t *ctx, int8_t access_pattern, int8_t axis) {
+  const blosc_cpu_info *cpu_info = blosc_stune_cpu_info();
+  int32_t typesize = ctx->b2_storage->cparams->typesize > 0 ? ctx->b2_storage->cparams->typesize : 1;
+  int64_t bounds[B2ND_MAX_DIM];
+  if (ctx->auto_chunkshape) {
+    // The share of a core in the L3, so that the chunks of all the cores stay there
+    int64_t nbytes = cpu_info->l3 > 0 ? cpu_info->l3 : B2ND_DEFAULT_CHUNK_NBYTES;
+    nbytes = nbytes < L2 ? L2 : nbytes;
+    for (int i = 0; i < ctx->ndim; i++) {
+      bounds[i] = ctx->shape[i];
+    }
+    fit_shape(ctx->ndim, bounds, nbytes / typesize, access_pattern, axis, ctx->chunkshape);
+  }
+  if (ctx->auto_blockshape) {
+    // A thread works on a few buffers of a block at a time
+    int64_t nbytes = (cpu_info->l2 > 0 ? cpu_info->l2 : L2) / STUNE_THREAD_BUFFERS;
+    nbytes = nbytes < L1 ? L1 : nbytes;
+    for (int i = 0; i < ctx->ndim; i++) {
+      bounds[i] = ctx->chunkshape[i];
+    }
+    fit_shape(ctx->ndim, bounds, nbytes / typesize, access_pattern, axis, ctx->blockshape);
+  }
+  int32_t blocknitems = 1;
+  for (int i = 0; i < ctx->ndim; i++) {
+    blocknitems *= ctx->blockshape[i];
+  }
+  ctx->b2_storage->cparams->blocksize = blocknitems * ctx->b2_storage->cparams->typesize;
 }
 
 
@@ -1810,19 +5594,20 @@ b2nd_create_ctx(const blosc2_storage *b2_storage, int8_t ndim, const int64_t *sh
   params_b2_storage->cparams = cparams;
   ctx->b2_storage = params_b2_storage;
   ctx->ndim = ndim;
-  int32_t blocknitems = 1;
+  ctx->auto_chunkshape = auto_shape(ndim, chunkshape);
+  ctx->auto_blockshape = auto_shape(ndim, blockshape);
   for (int i = 0; i < ndim; i++) {
     ctx->shape[i] = shape[i];
-    ctx->chunkshape[i] = chunkshape[i];
-    ctx->blockshape[i] = blockshape[i];
-    blocknitems *= ctx->blockshape[i];
+    ctx->chunkshape[i] = ctx->auto_chunkshape ? 0 : chunkshape[i];
+    ctx->blockshape[i] = ctx->auto_blockshape ? 0 : blockshape[i];
   }
-  cparams->blocksize = blocknitems * cparams->typesize;
+  choose_shapes(ctx, B2ND_ACCESS_SCANS, 0);
 
   ctx->nmetalayers = nmetalayers;
   for (int i = 0; i < nmetalayers; ++i) {
     ctx->metalayers[i] = metalayers[i];
   }
+  ctx->chunk_order = B2ND_CHUNK_ORDER_C;
 
 #if defined(HAVE_PLUGINS)
   #include "blosc2/codecs-registry.h"
@@ -1851,3 +5636,43 @@ int b2nd_free_ctx(b2nd_context_t *ctx) {
 
   return BLOSC2_ERROR_SUCCESS;
 }
+
+
+int b2nd_ctx_set_access_pattern(b2nd_context_t *ctx, int8_t access_pattern, int8_t axis) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  if (access_pattern < B2ND_ACCESS_SCANS || access_pattern > B2ND_ACCESS_CUBES) {
+    BLOSC_TRACE_ERROR("Unknown access pattern: %d", access_pattern);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (access_pattern == B2ND_ACCESS_AXIS_SLICES && (axis < 0 || axis >= ctx->ndim)) {
+    BLOSC_TRACE_ERROR("The axis of the slices (%d) is out of the %d dimensions", axis, ctx->ndim);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  choose_shapes(ctx, access_pattern, axis);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_ctx_get_shapes(const b2nd_context_t *ctx, int32_t *chunkshape, int32_t *blockshape) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  for (int i = 0; i < ctx->ndim; i++) {
+    if (chunkshape != NULL) {
+      chunkshape[i] = ctx->chunkshape[i];
+    }
+    if (blockshape != NULL) {
+      blockshape[i] = ctx->blockshape[i];
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int b2nd_ctx_set_chunk_order(b2nd_context_t *ctx, int8_t chunk_order) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  if (chunk_order < B2ND_CHUNK_ORDER_C || chunk_order > B2ND_CHUNK_ORDER_HILBERT) {
+    BLOSC_TRACE_ERROR("Unknown chunk order: %d", chunk_order);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  ctx->chunk_order = chunk_order;
+  return BLOSC2_ERROR_SUCCESS;
+}
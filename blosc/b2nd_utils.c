@@ -326,3 +326,128 @@ int b2nd_copy_buffer(int8_t ndim,
 
   return BLOSC2_ERROR_SUCCESS;
 }
+
+
+/* Copy a row of items that are not contiguous in src or dst (sizes known at compile time are faster) */
+#define COPY_ITEMS(size)                                 \
+  for (int64_t k = 0; k < nitems; ++k) {                 \
+    memcpy(dst + k * dst_stride, src + k * src_stride, size); \
+  }
+
+static void copy_strided_row(uint8_t itemsize, int64_t nitems,
+                             const uint8_t *src, int64_t src_stride,
+                             uint8_t *dst, int64_t dst_stride) {
+  if (src_stride == itemsize && dst_stride == itemsize) {
+    memcpy(dst, src, nitems * itemsize);
+    return;
+  }
+  switch (itemsize) {
+    case 1:
+      COPY_ITEMS(1)
+      break;
+    case 2:
+      COPY_ITEMS(2)
+      break;
+    case 4:
+      COPY_ITEMS(4)
+      break;
+    case 8:
+      COPY_ITEMS(8)
+      break;
+    case 16:
+      COPY_ITEMS(16)
+      break;
+    default:
+      COPY_ITEMS(itemsize)
+      break;
+  }
+}
+
+/* Side of the tiles for transposing (in items), so that both the rows read and the ones written stay in L1 */
+#define TRANSPOSE_TILE 32
+
+/* Copy a 2-dim block of items where the dst is contiguous along the second dimension
+ * and the src along the first one, tile by tile so that neither side thrashes the cache */
+static void copy_transposed(uint8_t itemsize, const int64_t *shape,
+                            const uint8_t *src, const int64_t *src_strides,
+                            uint8_t *dst, const int64_t *dst_strides) {
+  for (int64_t i0 = 0; i0 < shape[0]; i0 += TRANSPOSE_TILE) {
+    int64_t n0 = shape[0] - i0 < TRANSPOSE_TILE ? shape[0] - i0 : TRANSPOSE_TILE;
+    for (int64_t i1 = 0; i1 < shape[1]; i1 += TRANSPOSE_TILE) {
+      int64_t n1 = shape[1] - i1 < TRANSPOSE_TILE ? shape[1] - i1 : TRANSPOSE_TILE;
+      const uint8_t *tile_src = src + i0 * src_strides[0] + i1 * src_strides[1];
+      uint8_t *tile_dst = dst + i0 * dst_strides[0] + i1 * dst_strides[1];
+      for (int64_t k = 0; k < n0; ++k) {
+        copy_strided_row(itemsize, n1, tile_src + k * src_strides[0], src_strides[1],
+                         tile_dst + k * dst_strides[0], dst_strides[1]);
+      }
+    }
+  }
+}
+
+void b2nd_copy_buffer_strided(int8_t ndim, uint8_t itemsize, const int64_t *copy_shape,
+                              const uint8_t *src, const int64_t *src_strides,
+                              uint8_t *dst, const int64_t *dst_strides) {
+  for (int i = 0; i < ndim; ++i) {
+    if (copy_shape[i] == 0) {
+      return;
+    }
+  }
+
+  // When the last dimension is contiguous only on one side, the data is being transposed, so look
+  // for the dimension that is contiguous on the other side and copy both of them by tiles
+  int8_t last = (int8_t) (ndim - 1);
+  int8_t tiled = -1;
+  if (src_strides[last] != dst_strides[last]) {
+    for (int8_t i = 0; i < last; ++i) {
+      if (copy_shape[i] > 1 &&
+          ((src_strides[last] == itemsize && dst_strides[i] == itemsize) ||
+           (dst_strides[last] == itemsize && src_strides[i] == itemsize))) {
+        tiled = i;
+        break;
+      }
+    }
+  }
+  int64_t tile_shape[2] = {0};
+  int64_t tile_src_strides[2] = {0};
+  int64_t tile_dst_strides[2] = {0};
+  if (tiled >= 0) {
+    // Put the dimension where the dst is contiguous second, so that the writes are sequential
+    int8_t first = dst_strides[last] == itemsize ? tiled : last;
+    int8_t second = first == last ? tiled : last;
+    tile_shape[0] = copy_shape[first];
+    tile_shape[1] = copy_shape[second];
+    tile_src_strides[0] = src_strides[first];
+    tile_src_strides[1] = src_strides[second];
+    tile_dst_strides[0] = dst_strides[first];
+    tile_dst_strides[1] = dst_strides[second];
+  }
+
+  // Walk the other dimensions like an odometer, and copy a row (or a 2-dim block) each time
+  int64_t index[B2ND_MAX_DIM] = {0};
+  while (true) {
+    if (tiled >= 0) {
+      copy_transposed(itemsize, tile_shape, src, tile_src_strides, dst, tile_dst_strides);
+    }
+    else {
+      copy_strided_row(itemsize, copy_shape[last], src, src_strides[last], dst, dst_strides[last]);
+    }
+    int i = last - 1;
+    for (; i >= 0; --i) {
+      if (i == tiled) {
+        continue;
+      }
+      src += src_strides[i];
+      dst += dst_strides[i];
+      if (++index[i] < copy_shape[i]) {
+        break;
+      }
+      src -= copy_shape[i] * src_strides[i];
+      dst -= copy_shape[i] * dst_strides[i];
+      index[i] = 0;
+    }
+    if (i < 0) {
+      break;
+    }
+  }
+}
@@ -20,4 +20,10 @@ int b2nd_copy_buffer(int8_t ndim,
                      void *dst, const int64_t *dst_pad_shape,
                      int64_t *dst_start);
 
+/* Copy an ndim-dimensional region of copy_shape items between buffers with arbitrary
+ * strides (in bytes, possibly negative), from the first item of the region in each one */
+void b2nd_copy_buffer_strided(int8_t ndim, uint8_t itemsize, const int64_t *copy_shape,
+                              const uint8_t *src, const int64_t *src_strides,
+                              uint8_t *dst, const int64_t *dst_strides);
+
 #endif /* BLOSC_B2ND_UTILS_H */
@@ -32,4 +32,15 @@ BLOSC_NO_EXPORT int64_t
     bshuf_untrans_bit_elem_avx2(void* in, void* out, const size_t size,
                                 const size_t elem_size, void* tmp_buf);
 
+/**
+  AVX2-accelerated pieces of the above, also used by the AVX512 routines.
+*/
+BLOSC_NO_EXPORT int64_t
+    bshuf_trans_byte_bitrow_avx2(void* in, void* out, const size_t size,
+                                 const size_t elem_size);
+
+BLOSC_NO_EXPORT int64_t
+    bshuf_shuffle_bit_eightelem_avx2(void* in, void* out, const size_t size,
+                                     const size_t elem_size);
+
 #endif /* BLOSC_BITSHUFFLE_AVX2_H */
@@ -0,0 +1,147 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+  Bitshuffle - Filter for improving compression of typed binary data.
+
+  Author: Kiyoshi Masui <kiyo@physics.ubc.ca>
+  Website: https://github.com/kiyo-masui/bitshuffle
+
+  Note: Adapted for c-blosc by Francesc Alted.
+
+  See LICENSES/BITSHUFFLE.txt file for details about copyright and
+  rights to use.
+**********************************************************************/
+
+#include "bitshuffle-avx512.h"
+#include "bitshuffle-avx2.h"
+#include "bitshuffle-generic.h"
+#include "shuffle-avx512.h"
+
+/* Make sure AVX512BW is available for the compilation target and compiler. */
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include <immintrin.h>
+
+#include <stdint.h>
+#include <string.h>
+
+
+/* ---- Code that requires AVX512BW. Intel Skylake-SP (2017) and later. ---- */
+
+
+/* Transpose bits within bytes. */
+int64_t bshuf_trans_bit_byte_avx512(void* in, void* out, const size_t size,
+                                    const size_t elem_size) {
+
+  char* in_b = (char*)in;
+  char* out_b = (char*)out;
+  uint64_t* out_u64;
+
+  size_t nbyte = elem_size * size;
+
+  int64_t count;
+
+  __m512i zmm;
+  __mmask64 bt;
+  size_t ii, kk;
+
+  for (ii = 0; ii + 63 < nbyte; ii += 64) {
+    zmm = _mm512_loadu_si512((__m512i*)&in_b[ii]);
+    for (kk = 0; kk < 8; kk++) {
+      bt = _mm512_movepi8_mask(zmm);
+      zmm = _mm512_slli_epi16(zmm, 1);
+      out_u64 = (uint64_t*)&out_b[((7 - kk) * nbyte + ii) / 8];
+      *out_u64 = (uint64_t)bt;
+    }
+  }
+  count = bshuf_trans_bit_byte_remainder(in, out, size, elem_size,
+                                         nbyte - nbyte % 64);
+  return count;
+}
+
+
+/* Transpose bits within elements. */
+int64_t bshuf_trans_bit_elem_avx512(void* in, void* out, const size_t size,
+                                    const size_t elem_size, void* tmp_buf) {
+
+  int64_t count;
+
+  CHECK_MULT_EIGHT(size);
+
+  /* Transposing bytes within elements is the same than a (byte) shuffle,
+     which is a mere copy for single bytes */
+  if (elem_size == 1) {
+    memcpy(out, in, size);
+  }
+  else {
+    shuffle_avx512((int32_t)elem_size, (int32_t)(size * elem_size), in, out);
+  }
+  count = bshuf_trans_bit_byte_avx512(out, tmp_buf, size, elem_size);
+  CHECK_ERR(count);
+  count = bshuf_trans_bitrow_eight(tmp_buf, out, size, elem_size);
+
+  return count;
+}
+
+
+/* Shuffle bits within the bytes of eight element blocks. */
+int64_t bshuf_shuffle_bit_eightelem_avx512(void* in, void* out, const size_t size,
+                                           const size_t elem_size) {
+
+  CHECK_MULT_EIGHT(size);
+
+  /*  With a bit of care, this could be written such that such that it is */
+  /*  in_buf = out_buf safe. */
+  char* in_b = (char*)in;
+  char* out_b = (char*)out;
+
+  size_t nbyte = elem_size * size;
+  size_t ii, jj, kk, ind;
+
+  __m512i zmm;
+  __mmask64 bt;
+
+  if (elem_size % 8) {
+    return bshuf_shuffle_bit_eightelem_avx2(in, out, size, elem_size);
+  } else {
+    for (jj = 0; jj + 63 < 8 * elem_size; jj += 64) {
+      for (ii = 0; ii + 8 * elem_size - 1 < nbyte;
+           ii += 8 * elem_size) {
+        zmm = _mm512_loadu_si512((__m512i*)&in_b[ii + jj]);
+        for (kk = 0; kk < 8; kk++) {
+          bt = _mm512_movepi8_mask(zmm);
+          zmm = _mm512_slli_epi16(zmm, 1);
+          ind = (ii + jj / 8 + (7 - kk) * elem_size);
+          *(uint64_t*)&out_b[ind] = (uint64_t)bt;
+        }
+      }
+    }
+  }
+  return (int64_t)size * (int64_t)elem_size;
+}
+
+
+/* Untranspose bits within elements. */
+int64_t bshuf_untrans_bit_elem_avx512(void* in, void* out, const size_t size,
+                                      const size_t elem_size, void* tmp_buf) {
+
+  int64_t count;
+
+  CHECK_MULT_EIGHT(size);
+
+  count = bshuf_trans_byte_bitrow_avx2(in, tmp_buf, size, elem_size);
+  CHECK_ERR(count);
+  count = bshuf_shuffle_bit_eightelem_avx512(tmp_buf, out, size, elem_size);
+
+  return count;
+}
+
+#endif /* defined(__AVX512F__) && defined(__AVX512BW__) */
@@ -0,0 +1,144 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+  Bitshuffle - Filter for improving compression of typed binary data.
+
+  Author: Kiyoshi Masui <kiyo@physics.ubc.ca>
+  Website: https://github.com/kiyo-masui/bitshuffle
+
+  Note: Adapted for c-blosc by Francesc Alted.
+
+  See LICENSES/BITSHUFFLE.txt file for details about copyright and
+  rights to use.
+**********************************************************************/
+
+#include "bitshuffle-rvv.h"
+#include "bitshuffle-generic.h"
+#include "shuffle-rvv.h"
+
+/* Make sure RVV (with the v0.12+ intrinsics) is available for the compilation
+   target and compiler. */
+#if defined(__riscv_vector) && defined(__riscv_v_intrinsic) && __riscv_v_intrinsic >= 12000
+
+#include <riscv_vector.h>
+
+#include <stdint.h>
+
+
+/* The mask registers are stored with one bit per element (in order, starting
+   from the lowest bit), so a compare followed by a mask store does the same
+   than a movemask.  The vl has to be a multiple of 8 for the stores to end
+   at a byte boundary; VLMAX always is, and the lengths below are too, so the
+   vl is never left to vsetvl for the last, partial, iteration. */
+
+/* Store the bit kk of the vl bytes in v, packed, to out. */
+static inline void
+store_bitrow_rvv(uint8_t* out, const vuint8m8_t v, const uint8_t kk, const size_t vl) {
+  const vbool1_t bits = __riscv_vmsne_vx_u8m8_b1(__riscv_vand_vx_u8m8(v, (uint8_t)(1 << kk), vl), 0, vl);
+  __riscv_vsm_v_b1(out, bits, vl);
+}
+
+
+/* Transpose bits within bytes. */
+static int64_t bshuf_trans_bit_byte_rvv(const void* in, void* out, const size_t size,
+                                        const size_t elem_size) {
+
+  const uint8_t* in_b = (const uint8_t*)in;
+  uint8_t* out_b = (uint8_t*)out;
+
+  size_t nbyte = elem_size * size;
+  size_t nbyte_bitrow = nbyte / 8;
+  const size_t vlmax = __riscv_vsetvlmax_e8m8();
+  size_t ii, vl;
+  uint8_t kk;
+
+  CHECK_MULT_EIGHT(nbyte);
+
+  for (ii = 0; ii < nbyte; ii += vl) {
+    vl = nbyte - ii < vlmax ? nbyte - ii : vlmax;
+    const vuint8m8_t v = __riscv_vle8_v_u8m8(&in_b[ii], vl);
+    for (kk = 0; kk < 8; kk++) {
+      store_bitrow_rvv(&out_b[kk * nbyte_bitrow + ii / 8], v, kk, vl);
+    }
+  }
+  return (int64_t)size * (int64_t)elem_size;
+}
+
+
+/* Transpose bits within elements. */
+int64_t bshuf_trans_bit_elem_rvv(void* in, void* out, const size_t size,
+                                 const size_t elem_size, void* tmp_buf) {
+
+  int64_t count;
+
+  CHECK_MULT_EIGHT(size);
+
+  /* Transposing bytes within elements is the same than a (byte) shuffle */
+  shuffle_rvv((int32_t)elem_size, (int32_t)(size * elem_size), in, out);
+  count = bshuf_trans_bit_byte_rvv(out, tmp_buf, size, elem_size);
+  CHECK_ERR(count);
+  count = bshuf_trans_bitrow_eight(tmp_buf, out, size, elem_size);
+
+  return count;
+}
+
+
+/* Shuffle bits within the bytes of eight element blocks. */
+static int64_t bshuf_shuffle_bit_eightelem_rvv(const void* in, void* out, const size_t size,
+                                               const size_t elem_size) {
+
+  const uint8_t* in_b = (const uint8_t*)in;
+  uint8_t* out_b = (uint8_t*)out;
+
+  size_t nbyte = elem_size * size;
+  const size_t vlmax = __riscv_vsetvlmax_e8m8();
+  size_t ii, jj, vl;
+  uint8_t kk;
+
+  CHECK_MULT_EIGHT(size);
+
+  /* A block of small elements would only fill a few bytes */
+  if (elem_size < 8) {
+    return bshuf_shuffle_bit_eightelem_scal(in, out, size, elem_size);
+  }
+
+  /* Every bit row of the 8 * elem_size bytes of a block goes to elem_size
+     consecutive bytes. */
+  for (ii = 0; ii + 8 * elem_size - 1 < nbyte; ii += 8 * elem_size) {
+    for (jj = 0; jj < 8 * elem_size; jj += vl) {
+      vl = 8 * elem_size - jj < vlmax ? 8 * elem_size - jj : vlmax;
+      const vuint8m8_t v = __riscv_vle8_v_u8m8(&in_b[ii + jj], vl);
+      for (kk = 0; kk < 8; kk++) {
+        store_bitrow_rvv(&out_b[ii + kk * elem_size + jj / 8], v, kk, vl);
+      }
+    }
+  }
+  return (int64_t)size * (int64_t)elem_size;
+}
+
+
+/* Untranspose bits within elements. */
+int64_t bshuf_untrans_bit_elem_rvv(void* in, void* out, const size_t size,
+                                   const size_t elem_size, void* tmp_buf) {
+
+  int64_t count;
+
+  CHECK_MULT_EIGHT(size);
+
+  /* Transposing the bytes of the bit rows is the same than a (byte) unshuffle
+     of elements made of 8 * elem_size bytes */
+  unshuffle_rvv((int32_t)(8 * elem_size), (int32_t)(size * elem_size), in, tmp_buf);
+  count = bshuf_shuffle_bit_eightelem_rvv(tmp_buf, out, size, elem_size);
+
+  return count;
+}
+
+#endif /* defined(__riscv_vector) && ... */
@@ -423,6 +423,51 @@ int64_t bshuf_trans_byte_bitrow_sse2(void* in, void* out, const size_t size,
 }
 
 
+/* Shuffle bits within the bytes of eight element blocks, for odd element sizes.
+   The rows of 8 bytes do not pair up within a block then, so they go two by
+   two in sequence, whatever block they are in, and only a last odd row is done
+   in scalar. */
+static void shuffle_bit_eightelem_odd_sse2(const char* in_b, char* out_b, const size_t size,
+                                           const size_t elem_size) {
+  size_t nrows = size * elem_size / 8;
+  size_t nblock = 0;  /* the block of eight elements of the row */
+  size_t nrow = 0;  /* the row in that block */
+  size_t ii, kk;
+  __m128i xmm;
+  int32_t bt;
+
+  for (ii = 0; ii + 1 < nrows; ii += 2) {
+    size_t ind0 = nblock * 8 * elem_size + nrow;
+    if (++nrow == elem_size) {
+      nrow = 0;
+      nblock++;
+    }
+    size_t ind1 = nblock * 8 * elem_size + nrow;
+    if (++nrow == elem_size) {
+      nrow = 0;
+      nblock++;
+    }
+    xmm = _mm_loadu_si128((__m128i*)&in_b[ii * 8]);
+    for (kk = 0; kk < 8; kk++) {
+      bt = _mm_movemask_epi8(xmm);
+      xmm = _mm_slli_epi16(xmm, 1);
+      out_b[ind0 + (7 - kk) * elem_size] = (char)bt;
+      out_b[ind1 + (7 - kk) * elem_size] = (char)(bt >> 8);
+    }
+  }
+  if (ii < nrows) {
+    uint64_t x, t;
+    size_t ind = nblock * 8 * elem_size + nrow;
+    memcpy(&x, &in_b[ii * 8], sizeof(x));
+    TRANS_BIT_8X8(x, t);
+    for (kk = 0; kk < 8; kk++) {
+      out_b[ind + kk * elem_size] = (char)x;
+      x = x >> 8;
+    }
+  }
+}
+
+
 /* Shuffle bits within the bytes of eight element blocks. */
 int64_t bshuf_shuffle_bit_eightelem_sse2(void* in, void* out, const size_t size,
                                          const size_t elem_size) {
@@ -441,7 +486,7 @@ int64_t bshuf_shuffle_bit_eightelem_sse2(void* in, void* out, const size_t size,
   CHECK_MULT_EIGHT(size);
 
   if (elem_size % 2) {
-    bshuf_shuffle_bit_eightelem_scal(in, out, size, elem_size);
+    shuffle_bit_eightelem_odd_sse2(in_b, (char*)out, size, elem_size);
   } else {
     for (ii = 0; ii + 8 * elem_size - 1 < nbyte;
          ii += 8 * elem_size) {
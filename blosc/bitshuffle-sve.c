@@ -0,0 +1,138 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+  Bitshuffle - Filter for improving compression of typed binary data.
+
+  Author: Kiyoshi Masui <kiyo@physics.ubc.ca>
+  Website: https://github.com/kiyo-masui/bitshuffle
+
+  Note: Adapted for c-blosc by Francesc Alted.
+
+  See LICENSES/BITSHUFFLE.txt file for details about copyright and
+  rights to use.
+**********************************************************************/
+
+#include "bitshuffle-sve.h"
+#include "bitshuffle-generic.h"
+#include "shuffle-sve.h"
+
+/* Make sure SVE is available for the compilation target and compiler. */
+#if defined(__ARM_FEATURE_SVE)
+
+#include <arm_sve.h>
+
+#include <stdint.h>
+
+
+/* SVE has no movemask, so the bit k of the 8 bytes in every 64-bit lane is
+   gathered in its top byte with a multiplication, and stored with a
+   truncating store.  The magic constant places the bit of the byte j at the
+   bit 56 + j of the product, without any carry. */
+static inline svuint64_t
+bitrow_sve(const svbool_t pg, const svuint64_t x, const uint64_t kk) {
+  const svuint64_t bits = svand_n_u64_x(pg, svlsr_n_u64_x(pg, x, kk), 0x0101010101010101ULL);
+  return svlsr_n_u64_x(pg, svmul_n_u64_x(pg, bits, 0x0102040810204080ULL), 56);
+}
+
+
+/* Transpose bits within bytes. */
+static int64_t bshuf_trans_bit_byte_sve(const void* in, void* out, const size_t size,
+                                        const size_t elem_size) {
+
+  const uint64_t* in_u64 = (const uint64_t*)in;
+  uint8_t* out_b = (uint8_t*)out;
+
+  size_t nbyte = elem_size * size;
+  size_t nbyte_bitrow = nbyte / 8;
+  size_t ii;
+  uint64_t kk;
+
+  CHECK_MULT_EIGHT(nbyte);
+
+  for (ii = 0; ii < nbyte_bitrow; ii += svcntd()) {
+    const svbool_t pg = svwhilelt_b64_u64(ii, nbyte_bitrow);
+    const svuint64_t x = svld1_u64(pg, &in_u64[ii]);
+    for (kk = 0; kk < 8; kk++) {
+      svst1b_u64(pg, &out_b[kk * nbyte_bitrow + ii], bitrow_sve(pg, x, kk));
+    }
+  }
+  return (int64_t)size * (int64_t)elem_size;
+}
+
+
+/* Transpose bits within elements. */
+int64_t bshuf_trans_bit_elem_sve(void* in, void* out, const size_t size,
+                                 const size_t elem_size, void* tmp_buf) {
+
+  int64_t count;
+
+  CHECK_MULT_EIGHT(size);
+
+  /* Transposing bytes within elements is the same than a (byte) shuffle */
+  shuffle_sve((int32_t)elem_size, (int32_t)(size * elem_size), in, out);
+  count = bshuf_trans_bit_byte_sve(out, tmp_buf, size, elem_size);
+  CHECK_ERR(count);
+  count = bshuf_trans_bitrow_eight(tmp_buf, out, size, elem_size);
+
+  return count;
+}
+
+
+/* Shuffle bits within the bytes of eight element blocks. */
+static int64_t bshuf_shuffle_bit_eightelem_sve(const void* in, void* out, const size_t size,
+                                               const size_t elem_size) {
+
+  const uint8_t* in_b = (const uint8_t*)in;
+  uint8_t* out_b = (uint8_t*)out;
+
+  size_t nbyte = elem_size * size;
+  size_t ii, jj;
+  uint64_t kk;
+
+  CHECK_MULT_EIGHT(size);
+
+  /* A block of small elements would only fill a few lanes */
+  if (elem_size < 8) {
+    return bshuf_shuffle_bit_eightelem_scal(in, out, size, elem_size);
+  }
+
+  /* The 8 * elem_size bytes of a block are elem_size consecutive lanes, and
+     every bit row of them goes to elem_size consecutive bytes. */
+  for (ii = 0; ii + 8 * elem_size - 1 < nbyte; ii += 8 * elem_size) {
+    for (jj = 0; jj < elem_size; jj += svcntd()) {
+      const svbool_t pg = svwhilelt_b64_u64(jj, elem_size);
+      const svuint64_t x = svld1_u64(pg, (const uint64_t*)&in_b[ii + 8 * jj]);
+      for (kk = 0; kk < 8; kk++) {
+        svst1b_u64(pg, &out_b[ii + kk * elem_size + jj], bitrow_sve(pg, x, kk));
+      }
+    }
+  }
+  return (int64_t)size * (int64_t)elem_size;
+}
+
+
+/* Untranspose bits within elements. */
+int64_t bshuf_untrans_bit_elem_sve(void* in, void* out, const size_t size,
+                                   const size_t elem_size, void* tmp_buf) {
+
+  int64_t count;
+
+  CHECK_MULT_EIGHT(size);
+
+  /* Transposing the bytes of the bit rows is the same than a (byte) unshuffle
+     of elements made of 8 * elem_size bytes */
+  unshuffle_sve((int32_t)(8 * elem_size), (int32_t)(size * elem_size), in, tmp_buf);
+  count = bshuf_shuffle_bit_eightelem_sve(tmp_buf, out, size, elem_size);
+
+  return count;
+}
+
+#endif /* defined(__ARM_FEATURE_SVE) */
@@ -0,0 +1,232 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+  Bitshuffle - Filter for improving compression of typed binary data.
+
+  Author: Kiyoshi Masui <kiyo@physics.ubc.ca>
+  Website: https://github.com/kiyo-masui/bitshuffle
+
+  Note: Adapted for c-blosc by Francesc Alted
+        WebAssembly SIMD128 version after the SSE2 one.
+
+  See LICENSES/BITSHUFFLE.txt file for details about copyright and
+  rights to use.
+**********************************************************************/
+
+
+#include "bitshuffle-wasm.h"
+#include "bitshuffle-generic.h"
+#include "shuffle-wasm.h"
+
+/* Make sure SIMD128 is available for the compilation target and compiler. */
+#if defined(__wasm_simd128__)
+
+#include "transpose-wasm.h"
+
+#include <wasm_simd128.h>
+
+#include <stdint.h>
+#include <string.h>
+
+
+/* Transpose bytes within elements, which is what the byte shuffle does. */
+int64_t bshuf_trans_byte_elem_wasm(void* in, void* out, const size_t size,
+                                   const size_t elem_size, void* tmp_buf) {
+  BLOSC_UNUSED_PARAM(tmp_buf);
+
+  if (elem_size == 1) {
+    memcpy(out, in, size);
+  }
+  else {
+    shuffle_wasm((int32_t)elem_size, (int32_t)(size * elem_size), (const uint8_t*)in, (uint8_t*)out);
+  }
+  return (int64_t)size * (int64_t)elem_size;
+}
+
+
+/* Transpose bits within bytes. */
+static int64_t bshuf_trans_bit_byte_wasm(void* in, void* out, const size_t size,
+                                         const size_t elem_size) {
+
+  char* in_b = (char*)in;
+  char* out_b = (char*)out;
+  uint16_t bt;
+  int64_t count;
+  size_t nbyte = elem_size * size;
+  v128_t xmm;
+  size_t ii, kk;
+
+  CHECK_MULT_EIGHT(nbyte);
+
+  for (ii = 0; ii + 15 < nbyte; ii += 16) {
+    xmm = wasm_v128_load(&in_b[ii]);
+    for (kk = 0; kk < 8; kk++) {
+      bt = (uint16_t)wasm_i8x16_bitmask(xmm);
+      xmm = wasm_i8x16_shl(xmm, 1);
+      memcpy(&out_b[((7 - kk) * nbyte + ii) / 8], &bt, sizeof(bt));
+    }
+  }
+  count = bshuf_trans_bit_byte_remainder(in, out, size, elem_size,
+                                         nbyte - nbyte % 16);
+  return count;
+}
+
+
+/* Transpose bits within elements. */
+int64_t bshuf_trans_bit_elem_wasm(void* in, void* out, const size_t size,
+                                  const size_t elem_size, void* tmp_buf) {
+
+  int64_t count;
+
+  CHECK_MULT_EIGHT(size);
+
+  count = bshuf_trans_byte_elem_wasm(in, out, size, elem_size, tmp_buf);
+  CHECK_ERR(count);
+  count = bshuf_trans_bit_byte_wasm(out, tmp_buf, size, elem_size);
+  CHECK_ERR(count);
+  count = bshuf_trans_bitrow_eight(tmp_buf, out, size, elem_size);
+
+  return count;
+}
+
+
+/* For data organized into a row for each bit (8 * elem_size rows), transpose
+ * the bytes. */
+int64_t bshuf_trans_byte_bitrow_wasm(void* in, void* out, const size_t size,
+                                     const size_t elem_size) {
+
+  char* in_b = (char*)in;
+  char* out_b = (char*)out;
+  size_t nrows = 8 * elem_size;
+  size_t nbyte_row = size / 8;
+  size_t ii, jj, kk;
+  v128_t xmm[8];
+
+  CHECK_MULT_EIGHT(size);
+
+  for (ii = 0; ii + 7 < nrows; ii += 8) {
+    for (jj = 0; jj + 15 < nbyte_row; jj += 16) {
+      for (kk = 0; kk < 8; kk++) {
+        xmm[kk] = wasm_v128_load(&in_b[(ii + kk) * nbyte_row + jj]);
+      }
+
+      /* The 16 columns of the 8 rows are like 16 elements of 8 bytes in planes,
+         so every vector ends up with two of them */
+      untranspose_nx16(xmm, 8);
+
+      for (kk = 0; kk < 8; kk++) {
+        wasm_v128_store64_lane(&out_b[(jj + 2 * kk) * nrows + ii], xmm[kk], 0);
+        wasm_v128_store64_lane(&out_b[(jj + 2 * kk + 1) * nrows + ii], xmm[kk], 1);
+      }
+    }
+    for (jj = nbyte_row - nbyte_row % 16; jj < nbyte_row; jj++) {
+      for (kk = 0; kk < 8; kk++) {
+        out_b[jj * nrows + ii + kk] = in_b[(ii + kk) * nbyte_row + jj];
+      }
+    }
+  }
+  return (int64_t)size * (int64_t)elem_size;
+}
+
+
+/* Shuffle bits within the bytes of eight element blocks, for odd element sizes.
+   As in bitshuffle-sse2.c, the rows of 8 bytes go two by two in sequence, whatever
+   block they are in, and only a last odd row is done in scalar. */
+static void shuffle_bit_eightelem_odd_wasm(const char* in_b, char* out_b, const size_t size,
+                                           const size_t elem_size) {
+  size_t nrows = size * elem_size / 8;
+  size_t nblock = 0;  /* the block of eight elements of the row */
+  size_t nrow = 0;  /* the row in that block */
+  size_t ii, kk;
+  v128_t xmm;
+  uint32_t bt;
+
+  for (ii = 0; ii + 1 < nrows; ii += 2) {
+    size_t ind0 = nblock * 8 * elem_size + nrow;
+    if (++nrow == elem_size) {
+      nrow = 0;
+      nblock++;
+    }
+    size_t ind1 = nblock * 8 * elem_size + nrow;
+    if (++nrow == elem_size) {
+      nrow = 0;
+      nblock++;
+    }
+    xmm = wasm_v128_load(&in_b[ii * 8]);
+    for (kk = 0; kk < 8; kk++) {
+      bt = wasm_i8x16_bitmask(xmm);
+      xmm = wasm_i8x16_shl(xmm, 1);
+      out_b[ind0 + (7 - kk) * elem_size] = (char)bt;
+      out_b[ind1 + (7 - kk) * elem_size] = (char)(bt >> 8);
+    }
+  }
+  if (ii < nrows) {
+    uint64_t x, t;
+    size_t ind = nblock * 8 * elem_size + nrow;
+    memcpy(&x, &in_b[ii * 8], sizeof(x));
+    TRANS_BIT_8X8(x, t);
+    for (kk = 0; kk < 8; kk++) {
+      out_b[ind + kk * elem_size] = (char)x;
+      x = x >> 8;
+    }
+  }
+}
+
+
+/* Shuffle bits within the bytes of eight element blocks. */
+int64_t bshuf_shuffle_bit_eightelem_wasm(void* in, void* out, const size_t size,
+                                         const size_t elem_size) {
+  char* in_b = (char*)in;
+  char* out_b = (char*)out;
+
+  size_t nbyte = elem_size * size;
+
+  v128_t xmm;
+  uint16_t bt;
+  size_t ii, jj, kk;
+
+  CHECK_MULT_EIGHT(size);
+
+  if (elem_size % 2) {
+    shuffle_bit_eightelem_odd_wasm(in_b, out_b, size, elem_size);
+  } else {
+    for (ii = 0; ii + 8 * elem_size - 1 < nbyte;
+         ii += 8 * elem_size) {
+      for (jj = 0; jj + 15 < 8 * elem_size; jj += 16) {
+        xmm = wasm_v128_load(&in_b[ii + jj]);
+        for (kk = 0; kk < 8; kk++) {
+          bt = (uint16_t)wasm_i8x16_bitmask(xmm);
+          xmm = wasm_i8x16_shl(xmm, 1);
+          memcpy(&out_b[ii + jj / 8 + (7 - kk) * elem_size], &bt, sizeof(bt));
+        }
+      }
+    }
+  }
+  return (int64_t)size * (int64_t)elem_size;
+}
+
+
+/* Untranspose bits within elements. */
+int64_t bshuf_untrans_bit_elem_wasm(void* in, void* out, const size_t size,
+                                    const size_t elem_size, void* tmp_buf) {
+
+  int64_t count;
+
+  CHECK_MULT_EIGHT(size);
+
+  count = bshuf_trans_byte_bitrow_wasm(in, tmp_buf, size, elem_size);
+  CHECK_ERR(count);
+  count = bshuf_shuffle_bit_eightelem_wasm(tmp_buf, out, size, elem_size);
+
+  return count;
+}
+
+#endif /* defined(__wasm_simd128__) */
@@ -0,0 +1,47 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* WebAssembly SIMD128-accelerated shuffle/unshuffle routines. */
+
+#ifndef BLOSC_BITSHUFFLE_WASM_H
+#define BLOSC_BITSHUFFLE_WASM_H
+
+#include "blosc2/blosc2-common.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+BLOSC_NO_EXPORT int64_t
+    bshuf_trans_byte_elem_wasm(void* in, void* out, const size_t size,
+                               const size_t elem_size, void* tmp_buf);
+
+BLOSC_NO_EXPORT int64_t
+    bshuf_trans_byte_bitrow_wasm(void* in, void* out, const size_t size,
+                                 const size_t elem_size);
+
+BLOSC_NO_EXPORT int64_t
+    bshuf_shuffle_bit_eightelem_wasm(void* in, void* out, const size_t size,
+                                     const size_t elem_size);
+
+/**
+  WebAssembly SIMD128-accelerated bitshuffle routine.
+*/
+BLOSC_NO_EXPORT int64_t
+    bshuf_trans_bit_elem_wasm(void* in, void* out, const size_t size,
+                              const size_t elem_size, void* tmp_buf);
+
+/**
+  WebAssembly SIMD128-accelerated bitunshuffle routine.
+*/
+BLOSC_NO_EXPORT int64_t
+    bshuf_untrans_bit_elem_wasm(void* in, void* out, const size_t size,
+                                const size_t elem_size, void* tmp_buf);
+
+#endif /* BLOSC_BITSHUFFLE_WASM_H */
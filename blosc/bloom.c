@@ -0,0 +1,68 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "bloom.h"
+#include "checksum.h"
+
+#include <string.h>
+
+
+int bloom_nhashes(int bits_per_key) {
+  // bits_per_key * ln(2), rounded
+  int nhashes = (bits_per_key * 69 + 50) / 100;
+  if (nhashes < 1) {
+    return 1;
+  }
+  return nhashes > 30 ? 30 : nhashes;
+}
+
+
+/* The halves of a single XXH3 make the rest of the hashes (Kirsch & Mitzenmacher) */
+#define BLOOM_PROBES(filter, filter_len, nhashes, key, keysize, probe)      \
+  {                                                                        \
+    uint64_t hash = checksum_xxh3(key, (size_t)(keysize));                 \
+    uint64_t h1 = hash & 0xffffffffU;                                      \
+    uint64_t h2 = (hash >> 32) | 1;                                        \
+    uint64_t nbits = (uint64_t)(filter_len) * 8;                           \
+    for (int j = 0; j < (nhashes); j++) {                                  \
+      uint64_t bit = (h1 + (uint64_t)j * h2) % nbits;                      \
+      probe;                                                               \
+    }                                                                      \
+  }
+
+
+void bloom_add(uint8_t* filter, int32_t filter_len, int nhashes, const uint8_t* src, int64_t nkeys,
+               int32_t keysize) {
+  if (filter_len <= 0) {
+    return;
+  }
+  const uint8_t* last = NULL;
+  for (int64_t i = 0; i < nkeys; i++) {
+    const uint8_t* key = src + i * keysize;
+    // Runs of the same key are hashed once
+    if (last != NULL && memcmp(last, key, keysize) == 0) {
+      continue;
+    }
+    BLOOM_PROBES(filter, filter_len, nhashes, key, keysize,
+                 filter[bit / 8] |= (uint8_t)(1U << (bit % 8)));
+    last = key;
+  }
+}
+
+
+bool bloom_may_contain(const uint8_t* filter, int32_t filter_len, int nhashes, const uint8_t* key,
+                       int32_t keysize) {
+  if (filter_len <= 0) {
+    return true;
+  }
+  BLOOM_PROBES(filter, filter_len, nhashes, key, keysize,
+               if ((filter[bit / 8] & (1U << (bit % 8))) == 0) return false);
+  return true;
+}
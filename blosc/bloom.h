@@ -0,0 +1,28 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_BLOOM_H
+#define BLOSC_BLOOM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The number of hashes of a key that give the fewest false positives with `bits_per_key` */
+int bloom_nhashes(int bits_per_key);
+
+/* Add the `nkeys` keys of `keysize` bytes in `src` to the `filter_len` bytes of `filter` */
+void bloom_add(uint8_t* filter, int32_t filter_len, int nhashes, const uint8_t* src, int64_t nkeys,
+               int32_t keysize);
+
+/* Whether `key` may have been added to `filter` (false means that it was not for sure) */
+bool bloom_may_contain(const uint8_t* filter, int32_t filter_len, int nhashes, const uint8_t* key,
+                       int32_t keysize);
+
+#endif /* BLOSC_BLOOM_H */
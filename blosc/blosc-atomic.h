@@ -0,0 +1,109 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+
+  Minimal set of atomic operations used internally by the threading
+  machinery.  GCC/Clang builtins are used where available and the
+  Interlocked family on MSVC.
+
+*********************************************************************/
+
+#ifndef BLOSC_BLOSC_ATOMIC_H
+#define BLOSC_BLOSC_ATOMIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+
+/* Add val to *ptr and return the previous value */
+static inline int32_t blosc_atomic_add32(volatile int32_t* ptr, int32_t val) {
+  return (int32_t)_InterlockedExchangeAdd((volatile long*)ptr, (long)val);
+}
+
+static inline int32_t blosc_atomic_load32(volatile int32_t* ptr) {
+  return (int32_t)_InterlockedCompareExchange((volatile long*)ptr, 0, 0);
+}
+
+static inline void blosc_atomic_store32(volatile int32_t* ptr, int32_t val) {
+  _InterlockedExchange((volatile long*)ptr, (long)val);
+}
+
+static inline int64_t blosc_atomic_add64(volatile int64_t* ptr, int64_t val) {
+  return (int64_t)_InterlockedExchangeAdd64((volatile __int64*)ptr, (__int64)val);
+}
+
+static inline int64_t blosc_atomic_load64(volatile int64_t* ptr) {
+  return (int64_t)_InterlockedCompareExchange64((volatile __int64*)ptr, 0, 0);
+}
+
+static inline void blosc_atomic_store64(volatile int64_t* ptr, int64_t val) {
+  _InterlockedExchange64((volatile __int64*)ptr, (__int64)val);
+}
+
+/* Store desired in *ptr if it equals *expected.  On failure, *expected is updated
+ * with the current value. */
+static inline bool blosc_atomic_cas64(volatile int64_t* ptr, int64_t* expected, int64_t desired) {
+  int64_t prev = (int64_t)_InterlockedCompareExchange64((volatile __int64*)ptr, desired, *expected);
+  if (prev == *expected) {
+    return true;
+  }
+  *expected = prev;
+  return false;
+}
+
+#else
+
+static inline int32_t blosc_atomic_add32(volatile int32_t* ptr, int32_t val) {
+  return __atomic_fetch_add(ptr, val, __ATOMIC_ACQ_REL);
+}
+
+static inline int32_t blosc_atomic_load32(volatile int32_t* ptr) {
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void blosc_atomic_store32(volatile int32_t* ptr, int32_t val) {
+  __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+
+static inline int64_t blosc_atomic_add64(volatile int64_t* ptr, int64_t val) {
+  return __atomic_fetch_add(ptr, val, __ATOMIC_ACQ_REL);
+}
+
+static inline int64_t blosc_atomic_load64(volatile int64_t* ptr) {
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void blosc_atomic_store64(volatile int64_t* ptr, int64_t val) {
+  __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+
+static inline bool blosc_atomic_cas64(volatile int64_t* ptr, int64_t* expected, int64_t desired) {
+  return __atomic_compare_exchange_n(ptr, expected, desired, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+#endif  /* _MSC_VER */
+
+/* Tell the cpu that the thread is spinning, so that it does not starve its sibling
+ * hyperthread (nor burn power) while waiting */
+static inline void blosc_cpu_relax(void) {
+#if defined(_MSC_VER) && !defined(__clang__) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_ia32_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__aarch64__) || defined(__arm__))
+  __asm__ __volatile__("yield");
+#endif
+}
+
+#endif  /* BLOSC_BLOSC_ATOMIC_H */
@@ -14,8 +14,10 @@
 
 #include "blosc2/blosc2-common.h"
 #include "blosc2.h"
+#include "blosc-trace.h"
 
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 
@@ -30,6 +32,15 @@
 #define to_big(dest, src, itemsize)       endian_handler(false, dest, src, itemsize)
 #define from_big(dest, src, itemsize)     endian_handler(false, dest, src, itemsize)
 
+// Prefetch the cache line at p for reading (a no-op where it is not supported)
+#if defined(__GNUC__) || defined(__clang__)
+#define BLOSC_PREFETCH(p) __builtin_prefetch((const void*)(p), 0, 3)
+#elif defined(_MSC_VER) && defined(__SSE2__)
+#define BLOSC_PREFETCH(p) _mm_prefetch((const char*)(p), _MM_HINT_T0)
+#else
+#define BLOSC_PREFETCH(p) ((void)(p))
+#endif
+
 
 // Return true if platform is little endian; else false
 static bool is_little_endian(void) {
@@ -166,6 +177,16 @@ int register_filter_private(blosc2_filter *filter);
  */
 int register_codec_private(blosc2_codec *codec);
 
+/**
+ * @brief Register the partial decoder of a codec in Blosc.
+ *
+ * @param compcode The identifier of a codec that is already registered.
+ * @param getitems The partial decoder.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int register_codec_getitems_private(uint8_t compcode, blosc2_codec_getitems_cb getitems);
+
 
 /**
  * @brief Register a tune in Blosc.
@@ -178,6 +199,401 @@ int register_tuner_private(blosc2_tuner *tuner);
 
 int fill_tuner(blosc2_tuner *tuner);
 
+/* Allocate (aligned) and release the internal buffers, i.e. the ones that are never
+ * handed over to the user, with the allocator of a context (the global one if NULL). */
+void* ctx_malloc(blosc2_context *context, size_t size);
+void ctx_free(blosc2_context *context, void *block);
+
+/* The environment variables that Blosc honors */
+typedef enum {
+  BLOSC_ENV_CLEVEL,
+  BLOSC_ENV_SHUFFLE,
+  BLOSC_ENV_DELTA,
+  BLOSC_ENV_TYPESIZE,
+  BLOSC_ENV_COMPRESSOR,
+  BLOSC_ENV_BLOCKSIZE,
+  BLOSC_ENV_NTHREADS,
+  BLOSC_ENV_NTHREADS_AFFINITY,
+  BLOSC_ENV_SPLITMODE,
+  BLOSC_ENV_NOLOCK,
+  BLOSC_ENV_BLOSC1_COMPAT,
+  BLOSC_ENV_HUGEPAGES,
+  BLOSC_ENV_BTUNE_TRADEOFF,
+  BLOSC_ENV_PLUGIN_PATH,
+  BLOSC_ENV_PARALLEL_THRESHOLD,
+  BLOSC_ENV_NVARS,
+} blosc_env_var;
+
+/* The value of an environment variable (NULL if unset) as read by blosc2_init() or
+ * blosc2_reload_env(), or straight from the environment if Blosc is not initialized. */
+const char* blosc_getenv(blosc_env_var var);
+
+/* Whether splitting `nbytes` among `nthreads` pays off waking the threads up, i.e. whether
+ * every thread gets the bytes of BLOSC_PARALLEL_THRESHOLD at least (and there are cores
+ * for them).  Otherwise, the calls run serially. */
+bool parallel_pays_off(int32_t nbytes, int16_t nthreads);
+
+/* Advise the kernel to back the (large) buffer at `ptr` with transparent huge pages,
+ * if enabled with BLOSC_HUGEPAGES.  The buffer can still be realloc()ed and free()d. */
+void hugepages_advise(void *ptr, size_t size);
+
+/* Write the header of a memcpyed chunk (with no checksums) whose `nbytes` follow it in `dest`,
+ * with the typesize and the blocksize that `cparams` would give.  Returns the length of the
+ * header, or a negative code. */
+int chunk_memcpyed_header(blosc2_cparams cparams, int32_t nbytes, void* dest);
+
+/* Same as blosc2_getitem(), but with the allocator of `context` (which is not modified,
+ * so it can be in use elsewhere). */
+int ctx_getitem(blosc2_context *context, const void *src, int32_t srcsize, int start, int nitems,
+                void *dest, int32_t destsize);
+
+/* Return in `data` the decompressed chunk `nchunk` of `schunk` out of its chunk cache
+ * (see blosc2_schunk_set_chunk_cache()), decompressing it on a miss.  The buffer is
+ * owned by the cache and is valid until the next operation on the super-chunk.
+ * Returns the size of the chunk, or BLOSC2_ERROR_NOT_FOUND when there is no cache or the
+ * chunk does not fit in it (the caller should not use the cache then). */
+int schunk_cache_get_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **data);
+
+/* Take a decompression context for reading `schunk`: a free one of its pool of concurrent
+ * reads (see blosc2_schunk_set_concurrent_reads()), or else its dctx.  It has to be given
+ * back with schunk_release_dctx().  Returns NULL if a context cannot be created. */
+blosc2_context *schunk_acquire_dctx(blosc2_schunk *schunk);
+
+/* Give back a context taken with schunk_acquire_dctx() */
+void schunk_release_dctx(blosc2_schunk *schunk, blosc2_context *dctx);
+
+/* Same as blosc2_schunk_decompress_chunk(), but with a context taken with schunk_acquire_dctx() */
+int schunk_decompress_chunk_ctx(blosc2_schunk *schunk, blosc2_context *dctx, int64_t nchunk,
+                                void *dest, int32_t nbytes);
+
+/* The vlmetalayer holding the dictionary shared by the chunks of a super-chunk
+ * (see blosc2_schunk_train_dict()), as its id (int32) followed by its bytes */
+#define SHARED_DICT_VLMETA "b2dict"
+
+/* The dictionary shared by the chunks of a super-chunk.  Chunks reference it by id. */
+typedef struct {
+  int32_t id;
+  int32_t size;
+  uint8_t* buffer;
+} shared_dict;
+
+/* Train a dictionary for the codec in `cparams` out of the `srcsize` bytes of `src`.
+ * On success, the dictionary is returned in a malloc()ed `dict`, and its size is returned.
+ * Else a negative code is returned. */
+int32_t build_shared_dict(const blosc2_cparams *cparams, const void *src, int32_t srcsize,
+                          uint8_t **dict);
+
+/* Load the shared dictionary of `schunk` out of its vlmetalayer, if it has one, and
+ * make the appends use it.  Returns 0 if succeeds (also if there is no dictionary). */
+int schunk_load_shared_dict(blosc2_schunk *schunk);
+
+/* The vlmetalayer holding what the tuner of a super-chunk has learned, as the tuner
+ * id (int32) followed by the serialized state of the tuner */
+#define TUNER_VLMETA "b2tuner"
+
+/* Serialize the state of the tuner of `cctx` in a malloc()ed `content`.  Returns 1 when
+ * there is a new state, 0 when not (or when the tuner cannot serialize it), and a
+ * negative value on errors. */
+int tuner_serialize(blosc2_context *cctx, uint8_t **content, int32_t *content_len);
+
+/* Restore the state of the tuner of `cctx` out of a serialized `content` */
+int tuner_deserialize(blosc2_context *cctx, const uint8_t *content, int32_t content_len);
+
+/* The vlmetalayer holding the stats recorded for the chunks of a super-chunk (see
+ * blosc2_schunk_get_recorded_stats()), as a version byte followed by a record per chunk */
+#define STATS_VLMETA "b2stats"
+#define STATS_VERSION 1
+
+/* The vlmetalayer holding the zone maps of the chunks of a super-chunk (see
+ * blosc2_schunk_get_zonemap()), as a version byte, the kind and the typesize, followed by
+ * a record per chunk */
+#define ZONEMAP_VLMETA "b2zonemap"
+#define ZONEMAP_VERSION 1
+
+/* The vlmetalayer holding the sequence numbers of the changes of the chunks of a super-chunk
+ * (see blosc2_schunk_track_changes()), as a version byte and the last sequence number, followed
+ * by the sequence number of the last change of every chunk (big endian int64) */
+#define CHANGES_VLMETA "b2changes"
+#define CHANGES_VERSION 1
+
+/* The vlmetalayer of the super-chunks made by blosc2_schunk_get_changes(), as a version byte,
+ * the `since` and the last sequence numbers and the number of chunks of the source, followed by
+ * the position and the sequence number of every chunk in it (big endian int64) */
+#define DELTA_VLMETA "b2delta"
+#define DELTA_VERSION 1
+
+/* The vlmetalayer holding the Bloom filters of the keys (the items) of the chunks of a
+ * super-chunk (see blosc2_schunk_set_bloom()), as a version byte, the typesize, the number of
+ * hashes and the length of the filters (int32), followed by a record per chunk: a byte telling
+ * whether the chunk has a filter, and the filter */
+#define BLOOM_VLMETA "b2bloom"
+#define BLOOM_VERSION 1
+
+/* The vlmetalayer telling that the chunks of a super-chunk are deltas wrt the previous ones
+ * (see blosc2_schunk_set_xdelta()), as a version byte and the keyframe interval (int32) */
+#define XDELTA_VLMETA "b2xdelta"
+#define XDELTA_VERSION 1
+#define XDELTA_HEADER_SIZE 5
+
+/* Set up the deltas between the chunks of `schunk` out of its vlmetalayer, if it has one.
+ * Returns 0 if succeeds (also if there are no deltas). */
+int schunk_load_xdelta(blosc2_schunk *schunk);
+
+/* Keep on recording the zone maps of `schunk` out of its vlmetalayer, if it has one
+ * for the same typesize.  Returns 0 if succeeds (also if there are no zone maps). */
+int schunk_load_zonemap(blosc2_schunk *schunk);
+
+/* The room that the trailer of a chunk of `nbytes` (the checksums and the cipher data of
+ * its blocks) may need on top of BLOSC2_MAX_OVERHEAD.  The blocks that Blosc picks on its
+ * own (a `blocksize` of 0) are taken to be 8 KB at least; a chunk that ends up with no room
+ * goes without checksums, but an encrypted one cannot be compressed at all. */
+static inline int32_t trailer_maxlen(int checksum, int cipher, int32_t nbytes, int32_t blocksize) {
+  if (nbytes <= 0) {
+    return 0;
+  }
+  if (blocksize <= 0) {
+    blocksize = 8 * 1024;
+  }
+  int32_t len = 0;
+  if (checksum != BLOSC2_CHECKSUM_NONE) {
+    len += (nbytes / blocksize + 1) * BLOSC2_CHECKSUM_SIZE;
+  }
+  if (cipher != BLOSC2_CIPHER_NONE) {
+    len += BLOSC2_CIPHER_NONCE_SIZE + (nbytes / blocksize + 1) * (int32_t)(sizeof(int32_t) + BLOSC2_CIPHER_TAG_SIZE);
+  }
+  return len;
+}
+
+/* Whether the flags of a chunk (at BLOSC2_CHUNK_FLAGS) are the ones of a hybrid chunk, which
+ * keeps the codec of every block (a byte each) right after the bstarts */
+static inline bool is_hybrid_chunk(uint8_t flags) {
+  return !(flags & BLOSC_MEMCPYED) && (flags >> 5) == BLOSC_HYBRID_FORMAT;
+}
+
+/* The size of the reference block of the delta filter that a chunk keeps as is after the
+ * bstarts (and the codecs of the blocks), which is 0 but for BLOSC_DELTA_DREF_STORED */
+static inline int32_t stored_dref_len(const uint8_t* chunk) {
+  uint8_t extended = BLOSC_DOSHUFFLE | BLOSC_DOBITSHUFFLE;
+  if ((chunk[BLOSC2_CHUNK_FLAGS] & extended) != extended || (chunk[BLOSC2_CHUNK_FLAGS] & BLOSC_MEMCPYED) ||
+      ((chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK)) {
+    return 0;
+  }
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    if (chunk[BLOSC2_CHUNK_FILTER_CODES + i] == BLOSC_DELTA &&
+        chunk[BLOSC2_CHUNK_FILTER_META + i] == BLOSC_DELTA_DREF_STORED) {
+      int32_t nbytes = sw32_(chunk + BLOSC2_CHUNK_NBYTES);
+      int32_t blocksize = sw32_(chunk + BLOSC2_CHUNK_BLOCKSIZE);
+      return nbytes < blocksize ? nbytes : blocksize;
+    }
+  }
+  return 0;
+}
+
+/* The vlmetalayer of a super-chunk being transcoded (see blosc2_schunk_transcode()), as the
+ * number of chunks and the nbytes (int64 each) of the source.  It goes away once complete. */
+#define TRANSCODE_VLMETA "b2transcode"
+
+/* How the items of the chunks of a b2nd array are laid out, so that the reductions of its
+ * super-chunk leave the padding out */
+typedef struct {
+  int8_t ndim;
+  int64_t shape[BLOSC2_MAX_DIM];
+  int32_t chunkshape[BLOSC2_MAX_DIM];
+  int64_t extchunkshape[BLOSC2_MAX_DIM];
+  int32_t blockshape[BLOSC2_MAX_DIM];
+} reduce_layout;
+
+/* Same as blosc2_schunk_reduce(), leaving the padding of the chunks out when there is a `layout` */
+int schunk_reduce(blosc2_schunk *schunk, const reduce_layout *layout, int kind, int ops,
+                  blosc2_reduction *result);
+
+/* Keep the state of the tuner of `schunk` in its vlmetalayer when it has changed */
+int schunk_save_tuner(blosc2_schunk *schunk);
+
+/* Restore the state of the tuner of `schunk` out of its vlmetalayer, if it has one
+ * for the same tuner.  Returns 0 if succeeds (also if there is no state). */
+int schunk_load_tuner(blosc2_schunk *schunk);
+
+/* The optional callbacks of a registered io */
+const blosc2_io_cb_ext *io_cb_ext(const blosc2_io_cb *io_cb);
+
+/* Read nitems of `size` bytes at `position` of an io stream, with the positional
+ * callback when the io has one. */
+static inline int64_t io_pread(const blosc2_io_cb *io_cb, void *ptr, int64_t size, int64_t nitems,
+                               int64_t position, void *stream) {
+  BLOSC_HOOK_START(start);
+  int64_t rbytes;
+  const blosc2_io_cb_ext *ext = io_cb_ext(io_cb);
+  if (ext->pread != NULL) {
+    rbytes = ext->pread(ptr, size, nitems, position, stream);
+  }
+  else {
+    io_cb->seek(stream, position, SEEK_SET);
+    rbytes = io_cb->read(ptr, size, nitems, stream);
+  }
+  BLOSC_HOOK_END(BLOSC2_TRACE_IO_READ, NULL, -1, -1, rbytes * size, start);
+  return rbytes;
+}
+
+/* Write nitems of `size` bytes at `position` of an io stream, with the positional
+ * callback when the io has one. */
+static inline int64_t io_pwrite(const blosc2_io_cb *io_cb, const void *ptr, int64_t size, int64_t nitems,
+                                int64_t position, void *stream) {
+  BLOSC_HOOK_START(start);
+  int64_t wbytes;
+  const blosc2_io_cb_ext *ext = io_cb_ext(io_cb);
+  if (ext->pwrite != NULL) {
+    wbytes = ext->pwrite(ptr, size, nitems, position, stream);
+  }
+  else {
+    io_cb->seek(stream, position, SEEK_SET);
+    wbytes = io_cb->write(ptr, size, nitems, stream);
+  }
+  BLOSC_HOOK_END(BLOSC2_TRACE_IO_WRITE, NULL, -1, -1, wbytes * size, start);
+  return wbytes;
+}
+
+/* Make the writes to an io stream durable.  Returns 0 if succeeds, or a negative code
+ * (also when the io has no sync callback). */
+static inline int io_sync(const blosc2_io_cb *io_cb, void *stream) {
+  const blosc2_io_cb_ext *ext = io_cb_ext(io_cb);
+  if (ext->sync == NULL) {
+    BLOSC_TRACE_ERROR("The '%s' io cannot sync its writes.", io_cb->name);
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  return ext->sync(stream) == 0 ? BLOSC2_ERROR_SUCCESS : BLOSC2_ERROR_FILE_WRITE;
+}
+
+/* The bytes read by a batch of requests which is done */
+static inline int64_t io_batch_nbytes(const blosc2_io_request *requests, int64_t nrequests) {
+  int64_t nbytes = 0;
+  for (int64_t i = 0; i < nrequests; i++) {
+    if (requests[i].result > 0) {
+      nbytes += requests[i].result;
+    }
+  }
+  return nbytes;
+}
+
+/* Read a batch of requests, with the batched callback when the io has one, or
+ * one request after the other otherwise. */
+static inline int io_pread_batch(const blosc2_io_cb *io_cb, blosc2_io_request *requests,
+                                 int64_t nrequests, blosc2_io_done_cb done) {
+  const blosc2_io_cb_ext *ext = io_cb_ext(io_cb);
+  if (ext->pread_batch != NULL) {
+    // The batch is reported as a single read
+    BLOSC_HOOK_START(start);
+    int rc = ext->pread_batch(requests, nrequests, done);
+    BLOSC_HOOK_END(BLOSC2_TRACE_IO_READ, NULL, -1, -1, io_batch_nbytes(requests, nrequests), start);
+    return rc;
+  }
+  int rc = 0;
+  for (int64_t i = 0; i < nrequests; i++) {
+    blosc2_io_request *request = &requests[i];
+    request->result = io_pread(io_cb, request->ptr, 1, request->size, request->position, request->stream);
+    if (request->result != request->size) {
+      rc = BLOSC2_ERROR_FILE_READ;
+    }
+    done(request);
+  }
+  return rc;
+}
+
+static inline void io_preadv_done(blosc2_io_request *request) {
+  BLOSC_UNUSED_PARAM(request);
+}
+
+/* Read several ranges of an io stream at once, with the vectored callback when the io has
+ * one, or else as a batch.  Returns the total number of bytes read, or a negative value. */
+static inline int64_t io_preadv(const blosc2_io_cb *io_cb, const blosc2_io_vec *vecs, int64_t nvecs,
+                                void *stream) {
+  int64_t rbytes = 0;
+  const blosc2_io_cb_ext *ext = io_cb_ext(io_cb);
+  if (ext->preadv != NULL) {
+    BLOSC_HOOK_START(start);
+    rbytes = ext->preadv(vecs, nvecs, stream);
+    BLOSC_HOOK_END(BLOSC2_TRACE_IO_READ, NULL, -1, -1, rbytes, start);
+    return rbytes;
+  }
+  if (ext->pread_batch != NULL) {
+    blosc2_io_request *requests = malloc(nvecs * sizeof(blosc2_io_request));
+    if (requests == NULL) {
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    for (int64_t i = 0; i < nvecs; i++) {
+      blosc2_io_request request = {stream, vecs[i].ptr, vecs[i].size, vecs[i].position, 0, NULL};
+      requests[i] = request;
+    }
+    int rc = io_pread_batch(io_cb, requests, nvecs, io_preadv_done);
+    for (int64_t i = 0; i < nvecs && rc >= 0; i++) {
+      rbytes += requests[i].result;
+    }
+    free(requests);
+    return rc < 0 ? BLOSC2_ERROR_FILE_READ : rbytes;
+  }
+  for (int64_t i = 0; i < nvecs; i++) {
+    int64_t rc = io_pread(io_cb, vecs[i].ptr, 1, vecs[i].size, vecs[i].position, stream);
+    if (rc != vecs[i].size) {
+      return BLOSC2_ERROR_FILE_READ;
+    }
+    rbytes += rc;
+  }
+  return rbytes;
+}
+
+/* The cache of file handles of the filesystem io (see blosc2-stdio.c) */
+void stdio_cache_init(void);
+void stdio_cache_destroy(void);
+
+/**
+ * @brief Close the cached file handles of @p urlpath (and of the files inside
+ * of it, if it is a directory).
+ */
+void stdio_cache_release(const char *urlpath);
+
+/**
+ * @brief Close the idle file handles (the least recently used first) until
+ * @p nbytes more fit in the memory budget.
+ */
+void stdio_cache_trim(int64_t nbytes);
+
+/**
+ * @brief Write all the @p nbytes at @p buf to the file descriptor @p fd.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int stdio_write_fd(int fd, const void *buf, int64_t nbytes);
+
+/* The global memory budget (see blosc2_set_memory_budget() and blosc2.c) */
+
+/**
+ * @brief Whether @p nbytes more fit in the memory budget.
+ */
+bool membudget_fits(int64_t nbytes);
+
+/**
+ * @brief Whether the memory budget is exceeded, counting the bytes that some
+ * cache could not get lately; caches should give up some of theirs then.
+ */
+bool membudget_over(void);
+
+/**
+ * @brief Charge @p nbytes to the memory budget, releasing idle pooled memory
+ * if needed.  Returns false (and nothing is charged) if they do not fit.
+ */
+bool membudget_charge(int64_t nbytes);
+
+/**
+ * @brief Charge @p nbytes that cannot be given up to the memory budget, even
+ * if they do not fit.
+ */
+void membudget_force(int64_t nbytes);
+
+/**
+ * @brief Give @p nbytes charged before back to the memory budget.
+ */
+void membudget_release(int64_t nbytes);
+
 extern blosc2_tuner g_tuners[256];
 extern int g_ntuners;
 
@@ -246,7 +662,53 @@ static inline const char *dlerror (void) {
 #endif
 
 
+#if defined(_WIN32)
+#define PLUGIN_PATH_SEP ';'
+#else
+#define PLUGIN_PATH_SEP ':'
+#endif
+
+/* Load the library of a plugin from the directories in the BLOSC_PLUGIN_PATH
+ * environment variable (separated by PLUGIN_PATH_SEP), where it is named
+ * libblosc2_<plugin_name>.so (.dylib on macOS, blosc2_<plugin_name>.dll on Windows). */
+static inline void* load_lib_from_path(const char *plugin_name, char *libpath) {
+#if defined(_WIN32)
+  const char* const formats[] = {"%.*s\\blosc2_%s.dll"};
+#elif defined(__APPLE__)
+  const char* const formats[] = {"%.*s/libblosc2_%s.dylib", "%.*s/libblosc2_%s.so"};
+#else
+  const char* const formats[] = {"%.*s/libblosc2_%s.so"};
+#endif
+  const char* dirs = blosc_getenv(BLOSC_ENV_PLUGIN_PATH);
+  while (dirs != NULL && *dirs != '\0') {
+    const char* sep = strchr(dirs, PLUGIN_PATH_SEP);
+    int len = sep != NULL ? (int)(sep - dirs) : (int)strlen(dirs);
+    for (size_t i = 0; len > 0 && i < sizeof(formats) / sizeof(formats[0]); i++) {
+      snprintf(libpath, PATH_MAX, formats[i], len, dirs, plugin_name);
+      FILE *fp = fopen(libpath, "rb");
+      if (fp == NULL) {
+        continue;
+      }
+      fclose(fp);
+      BLOSC_TRACE_INFO("libpath for plugin blosc2_%s: %s\n", plugin_name, libpath);
+      void* loaded_lib = dlopen(libpath, RTLD_LAZY);
+      if (loaded_lib == NULL) {
+        BLOSC_TRACE_ERROR("Attempt to load plugin in path '%s' failed with error: %s",
+                          libpath, dlerror());
+      }
+      return loaded_lib;
+    }
+    dirs = sep != NULL ? sep + 1 : NULL;
+  }
+  return NULL;
+}
+
+/* Load the library of a plugin, from BLOSC_PLUGIN_PATH or else from its Python wheel */
 static inline void* load_lib(char *plugin_name, char *libpath) {
+  void* lib = load_lib_from_path(plugin_name, libpath);
+  if (lib != NULL) {
+    return lib;
+  }
   char python_cmd[PATH_MAX] = {0};
   sprintf(python_cmd, "python -c \"import blosc2_%s; blosc2_%s.print_libpath()\"", plugin_name, plugin_name);
   FILE *fp = popen(python_cmd, "r");
@@ -0,0 +1,84 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+
+  Hooks for tracing the stages of the blocks and the I/O of the frames
+  (see blosc2_set_trace_cb()).
+
+  They are only built with the ENABLE_TRACE_HOOKS option of CMake;
+  otherwise the macros below expand to nothing.  When built, a stage
+  costs a branch unless a hook is set or a USDT probe is attached.
+
+*********************************************************************/
+
+#ifndef BLOSC_BLOSC_TRACE_H
+#define BLOSC_BLOSC_TRACE_H
+
+#include "blosc2.h"
+
+#if defined(USING_CMAKE)
+  #include "config.h"
+#endif
+
+#include <stdint.h>
+
+#if defined(HAVE_TRACE_HOOKS)
+
+#if defined(HAVE_SYS_SDT_H)
+  /* The probes are only hit when a tracer sets their semaphore */
+  #define _SDT_HAS_SEMAPHORES 1
+  #include <sys/sdt.h>
+  extern unsigned short blosc2_stage_semaphore;
+  #define BLOSC_USDT_ACTIVE() (blosc2_stage_semaphore != 0)
+#else
+  #define BLOSC_USDT_ACTIVE() 0
+#endif
+
+extern blosc2_trace_cb g_trace_cb;
+extern void *g_trace_data;
+
+/* The clock of the stages (the one of the statistics of the contexts) */
+int64_t trace_clock(void);
+
+/* Report a stage to the hook and to the USDT probe */
+void trace_stage(int stage, const blosc2_context *ctx, int32_t tid, int32_t nblock, int64_t nbytes,
+                 int64_t start_ns, int64_t end_ns);
+
+#define BLOSC_HOOKS_ACTIVE() (g_trace_cb != NULL || BLOSC_USDT_ACTIVE())
+
+/* Report a stage that went from start_ns to end_ns */
+#define BLOSC_HOOK_STAGE(stage, ctx, tid, nblock, nbytes, start_ns, end_ns)         \
+  do {                                                                              \
+    if (BLOSC_HOOKS_ACTIVE()) {                                                     \
+      trace_stage(stage, ctx, tid, nblock, nbytes, start_ns, end_ns);               \
+    }                                                                               \
+  } while (0)
+
+/* Declare `start` as the start of a stage, which is reported with BLOSC_HOOK_END */
+#define BLOSC_HOOK_START(start)                                                     \
+  int64_t start = BLOSC_HOOKS_ACTIVE() ? trace_clock() : 0
+
+#define BLOSC_HOOK_END(stage, ctx, tid, nblock, nbytes, start)                      \
+  do {                                                                              \
+    if ((start) != 0 && BLOSC_HOOKS_ACTIVE()) {                                     \
+      trace_stage(stage, ctx, tid, nblock, nbytes, start, trace_clock());           \
+    }                                                                               \
+  } while (0)
+
+#else
+
+#define BLOSC_HOOK_STAGE(stage, ctx, tid, nblock, nbytes, start_ns, end_ns)
+#define BLOSC_HOOK_START(start)
+#define BLOSC_HOOK_END(stage, ctx, tid, nblock, nbytes, start)
+
+#endif  /* HAVE_TRACE_HOOKS */
+
+#endif  /* BLOSC_BLOSC_TRACE_H */
@@ -0,0 +1,389 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+
+  Decompression of chunks into CUDA device memory.  The chunk is copied to the
+  device once, and the bstarts and the stream headers are walked on the host:
+  runs and raw streams become memsets and copies on the device, while the codec
+  streams of all the blocks go into a single nvCOMP batch.  The shuffle filter
+  is undone by a kernel afterwards (see shuffle-cuda.cu).
+**********************************************************************/
+
+#include "blosc2-cuda.h"
+#include "blosc-private.h"
+#include "context.h"
+#include "blosc2.h"
+
+#include <cuda_runtime.h>
+#include <nvcomp/lz4.h>
+#include <nvcomp/zstd.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CUDA_CHECK(call)                                                 \
+  do {                                                                   \
+    cudaError_t err_ = (call);                                           \
+    if (err_ != cudaSuccess) {                                           \
+      BLOSC_TRACE_ERROR("CUDA error: %s", cudaGetErrorString(err_));     \
+      return BLOSC2_ERROR_FAILURE;                                       \
+    }                                                                    \
+  } while (0)
+
+
+/* The batch of codec streams lives in both a (pinned) host buffer and a device
+ * buffer with the same layout, so that it is copied with a single transfer */
+typedef struct {
+  const void **comp_ptrs;
+  size_t *comp_bytes;
+  size_t *decomp_bytes;
+  void **decomp_ptrs;
+  size_t *actual_bytes;
+  nvcompStatus_t *statuses;
+} cuda_batch;
+
+typedef struct {
+  cudaStream_t stream;
+  uint8_t *chunk;  /* the device copy of the chunk */
+  size_t chunk_cap;
+  uint8_t *tmp;  /* the output of the codec before unshuffling */
+  size_t tmp_cap;
+  void *temp;  /* the scratch space of nvCOMP */
+  size_t temp_cap;
+  void *h_batch;
+  void *d_batch;
+  int64_t batch_cap;  /* in streams */
+} cuda_state;
+
+
+static size_t batch_size(int64_t nstreams) {
+  return (size_t)nstreams * (4 * sizeof(void*) + 2 * sizeof(size_t) + sizeof(nvcompStatus_t));
+}
+
+
+/* Carve the arrays of a batch out of a buffer that is sized for `cap` streams */
+static cuda_batch get_batch(void *buffer, int64_t cap) {
+  cuda_batch batch;
+  uint8_t *p = buffer;
+  batch.comp_ptrs = (const void**)p;
+  p += cap * sizeof(void*);
+  batch.comp_bytes = (size_t*)p;
+  p += cap * sizeof(size_t);
+  batch.decomp_bytes = (size_t*)p;
+  p += cap * sizeof(size_t);
+  batch.decomp_ptrs = (void**)p;
+  p += cap * sizeof(void*);
+  batch.actual_bytes = (size_t*)p;
+  p += cap * sizeof(size_t);
+  batch.statuses = (nvcompStatus_t*)p;
+  return batch;
+}
+
+
+static int grow_device(void **buffer, size_t *cap, size_t size) {
+  if (size <= *cap) {
+    return 0;
+  }
+  cudaFree(*buffer);
+  *buffer = NULL;
+  *cap = 0;
+  if (cudaMalloc(buffer, size) != cudaSuccess) {
+    BLOSC_TRACE_ERROR("Cannot allocate %zu bytes in the CUDA device.", size);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  *cap = size;
+  return 0;
+}
+
+
+static int grow_batch(cuda_state *state, int64_t nstreams) {
+  if (nstreams <= state->batch_cap) {
+    return 0;
+  }
+  cudaFreeHost(state->h_batch);
+  cudaFree(state->d_batch);
+  state->h_batch = NULL;
+  state->d_batch = NULL;
+  state->batch_cap = 0;
+  if (cudaMallocHost(&state->h_batch, batch_size(nstreams)) != cudaSuccess ||
+      cudaMalloc(&state->d_batch, batch_size(nstreams)) != cudaSuccess) {
+    BLOSC_TRACE_ERROR("Cannot allocate the batch of nvCOMP streams.");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  state->batch_cap = nstreams;
+  return 0;
+}
+
+
+static cuda_state *get_state(blosc2_context *context) {
+  if (context->cuda_state != NULL) {
+    return context->cuda_state;
+  }
+  cuda_state *state = ctx_malloc(context, sizeof(cuda_state));
+  if (state == NULL) {
+    return NULL;
+  }
+  memset(state, 0, sizeof(cuda_state));
+  if (cudaStreamCreateWithFlags(&state->stream, cudaStreamNonBlocking) != cudaSuccess) {
+    BLOSC_TRACE_ERROR("Cannot create a CUDA stream.");
+    ctx_free(context, state);
+    return NULL;
+  }
+  context->cuda_state = state;
+  return state;
+}
+
+
+void cuda_free_state(blosc2_context *context) {
+  cuda_state *state = context->cuda_state;
+  if (state == NULL) {
+    return;
+  }
+  cudaStreamDestroy(state->stream);
+  cudaFree(state->chunk);
+  cudaFree(state->tmp);
+  cudaFree(state->temp);
+  cudaFreeHost(state->h_batch);
+  cudaFree(state->d_batch);
+  ctx_free(context, state);
+  context->cuda_state = NULL;
+}
+
+
+int cuda_copy_to_device(blosc2_context *context, void *dest, const void *src, int32_t nbytes) {
+  BLOSC_UNUSED_PARAM(context);
+  CUDA_CHECK(cudaMemcpy(dest, src, (size_t)nbytes, cudaMemcpyHostToDevice));
+  return 0;
+}
+
+
+/* Whether the filters of the chunk can be undone on the device (and whether there is shuffle) */
+static bool supported_filters(blosc2_context *context, bool *shuffle) {
+  *shuffle = false;
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    if (context->filters[i] == BLOSC_SHUFFLE && !*shuffle) {
+      *shuffle = true;
+    }
+    else if (context->filters[i] != BLOSC_NOFILTER) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/* Queue the work for the streams of a block, adding its codec streams to the batch */
+static int walk_block(blosc2_context *context, cuda_state *state, cuda_batch *batch, int64_t *nbatch,
+                      int32_t nblock, uint8_t *out, int32_t *max_neblock) {
+  const uint8_t *src = context->src;
+  int32_t srcsize = context->srcsize;
+  bool leftoverblock = (nblock == context->nblocks - 1) && (context->leftover > 0);
+  int32_t bsize = leftoverblock ? context->leftover : context->blocksize;
+  int dont_split = (context->header_flags & 0x10) >> 4;
+  int32_t nstreams = (!dont_split && !leftoverblock) ? context->typesize : 1;
+  int32_t neblock = bsize / nstreams;
+  if (neblock == 0) {
+    return BLOSC2_ERROR_WRITE_BUFFER;
+  }
+  if (neblock > *max_neblock) {
+    *max_neblock = neblock;
+  }
+
+  int32_t pos = sw32_(context->bstarts + nblock);
+  if (pos <= 0 || pos >= srcsize) {
+    return BLOSC2_ERROR_DATA;
+  }
+  out += (int64_t)nblock * context->blocksize;
+  for (int32_t j = 0; j < nstreams; j++) {
+    if (srcsize - pos < (int32_t)sizeof(int32_t)) {
+      return BLOSC2_ERROR_READ_BUFFER;
+    }
+    int32_t cbytes = sw32_(src + pos);
+    pos += sizeof(int32_t);
+    uint8_t *_out = out + (int64_t)j * neblock;
+    if (cbytes == 0) {
+      // A run of 0's
+      CUDA_CHECK(cudaMemsetAsync(_out, 0, neblock, state->stream));
+    }
+    else if (cbytes < 0) {
+      if (srcsize - pos < 1) {
+        return BLOSC2_ERROR_READ_BUFFER;
+      }
+      uint8_t token = src[pos];
+      pos += 1;
+      if (!(token & 0x1) || cbytes < -255) {
+        BLOSC_TRACE_ERROR("Invalid or unsupported compressed stream token value - %d", token);
+        return BLOSC2_ERROR_RUN_LENGTH;
+      }
+      CUDA_CHECK(cudaMemsetAsync(_out, (uint8_t)-cbytes, neblock, state->stream));
+    }
+    else {
+      if (srcsize - pos < cbytes) {
+        return BLOSC2_ERROR_READ_BUFFER;
+      }
+      if (cbytes == neblock) {
+        CUDA_CHECK(cudaMemcpyAsync(_out, state->chunk + pos, neblock, cudaMemcpyDeviceToDevice,
+                                   state->stream));
+      }
+      else {
+        batch->comp_ptrs[*nbatch] = state->chunk + pos;
+        batch->comp_bytes[*nbatch] = (size_t)cbytes;
+        batch->decomp_bytes[*nbatch] = (size_t)neblock;
+        batch->decomp_ptrs[*nbatch] = _out;
+        (*nbatch)++;
+      }
+      pos += cbytes;
+    }
+  }
+  return 0;
+}
+
+
+static int run_batch(cuda_state *state, int compformat, int64_t nbatch, int32_t max_neblock) {
+  cuda_batch d_batch = get_batch(state->d_batch, state->batch_cap);
+  size_t temp_bytes = 0;
+  nvcompStatus_t status;
+  if (compformat == BLOSC_LZ4_FORMAT) {
+    status = nvcompBatchedLZ4DecompressGetTempSize((size_t)nbatch, (size_t)max_neblock, &temp_bytes);
+  }
+  else {
+    status = nvcompBatchedZstdDecompressGetTempSize((size_t)nbatch, (size_t)max_neblock, &temp_bytes);
+  }
+  if (status != nvcompSuccess) {
+    BLOSC_TRACE_ERROR("Cannot get the scratch size of nvCOMP (error %d).", (int)status);
+    return BLOSC2_ERROR_FAILURE;
+  }
+  int rc = grow_device(&state->temp, &state->temp_cap, temp_bytes);
+  if (rc < 0) {
+    return rc;
+  }
+
+  // The pointers and sizes of the batch go in a single transfer
+  size_t nbatch_ = (size_t)nbatch;
+  CUDA_CHECK(cudaMemcpyAsync(state->d_batch, state->h_batch,
+                             (uint8_t*)d_batch.actual_bytes - (uint8_t*)state->d_batch,
+                             cudaMemcpyHostToDevice, state->stream));
+  if (compformat == BLOSC_LZ4_FORMAT) {
+    status = nvcompBatchedLZ4DecompressAsync(d_batch.comp_ptrs, d_batch.comp_bytes, d_batch.decomp_bytes,
+                                             d_batch.actual_bytes, nbatch_, state->temp, temp_bytes,
+                                             d_batch.decomp_ptrs, d_batch.statuses, state->stream);
+  }
+  else {
+    status = nvcompBatchedZstdDecompressAsync(d_batch.comp_ptrs, d_batch.comp_bytes, d_batch.decomp_bytes,
+                                              d_batch.actual_bytes, nbatch_, state->temp, temp_bytes,
+                                              d_batch.decomp_ptrs, d_batch.statuses, state->stream);
+  }
+  if (status != nvcompSuccess) {
+    BLOSC_TRACE_ERROR("Cannot launch the nvCOMP decompression (error %d).", (int)status);
+    return BLOSC2_ERROR_FAILURE;
+  }
+  cuda_batch h_batch = get_batch(state->h_batch, state->batch_cap);
+  CUDA_CHECK(cudaMemcpyAsync(h_batch.actual_bytes, d_batch.actual_bytes,
+                             nbatch_ * sizeof(size_t), cudaMemcpyDeviceToHost, state->stream));
+  CUDA_CHECK(cudaMemcpyAsync(h_batch.statuses, d_batch.statuses,
+                             nbatch_ * sizeof(nvcompStatus_t), cudaMemcpyDeviceToHost, state->stream));
+  return 0;
+}
+
+
+int cuda_decompress(blosc2_context *context, int32_t *ntbytes) {
+  int32_t nbytes = context->sourcesize;
+  bool memcpyed = context->header_flags & (uint8_t)BLOSC_MEMCPYED;
+  int32_t compformat = (context->header_flags & (uint8_t)0xe0) >> 5u;
+  bool is_lazy = ((context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) &&
+                  (context->blosc2_flags & 0x08u) && !context->special_type);
+
+  // These go through the host path
+  if (is_lazy || context->postfilter != NULL || context->block_maskout != NULL ||
+      (context->blosc2_flags & BLOSC2_INSTR_CODEC) ||
+      (context->special_type == BLOSC2_SPECIAL_NAN) || (context->special_type == BLOSC2_SPECIAL_VALUE) ||
+      (context->special_type == BLOSC2_SPECIAL_VIRTUAL)) {
+    return 0;
+  }
+  bool shuffle = false;
+  if (!memcpyed && !context->special_type) {
+    if ((context->blosc2_flags & (BLOSC2_USEDICT | BLOSC2_ZSTD_PREFIX)) || !supported_filters(context, &shuffle) ||
+        (compformat != BLOSC_LZ4_FORMAT && compformat != BLOSC_ZSTD_FORMAT)) {
+      return 0;
+    }
+  }
+
+  cuda_state *state = get_state(context);
+  if (state == NULL) {
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  *ntbytes = nbytes;
+  if (nbytes == 0 || context->special_type == BLOSC2_SPECIAL_UNINIT) {
+    return 1;
+  }
+  if (context->special_type == BLOSC2_SPECIAL_ZERO) {
+    CUDA_CHECK(cudaMemsetAsync(context->dest, 0, nbytes, state->stream));
+    CUDA_CHECK(cudaStreamSynchronize(state->stream));
+    return 1;
+  }
+  if (memcpyed) {
+    CUDA_CHECK(cudaMemcpyAsync(context->dest, context->src + context->header_overhead, nbytes,
+                               cudaMemcpyHostToDevice, state->stream));
+    CUDA_CHECK(cudaStreamSynchronize(state->stream));
+    return 1;
+  }
+
+  int rc = grow_device((void**)&state->chunk, &state->chunk_cap, context->srcsize);
+  if (rc < 0) {
+    return rc;
+  }
+  uint8_t *out = context->dest;
+  if (shuffle) {
+    rc = grow_device((void**)&state->tmp, &state->tmp_cap, nbytes);
+    if (rc < 0) {
+      return rc;
+    }
+    out = state->tmp;
+  }
+  rc = grow_batch(state, (int64_t)context->nblocks * context->typesize);
+  if (rc < 0) {
+    return rc;
+  }
+  CUDA_CHECK(cudaMemcpyAsync(state->chunk, context->src, context->srcsize, cudaMemcpyHostToDevice,
+                             state->stream));
+
+  cuda_batch batch = get_batch(state->h_batch, state->batch_cap);
+  int64_t nbatch = 0;
+  int32_t max_neblock = 0;
+  for (int32_t nblock = 0; nblock < context->nblocks; nblock++) {
+    rc = walk_block(context, state, &batch, &nbatch, nblock, out, &max_neblock);
+    if (rc < 0) {
+      break;
+    }
+  }
+  if (rc == 0 && nbatch > 0) {
+    rc = run_batch(state, compformat, nbatch, max_neblock);
+  }
+  if (rc == 0 && shuffle) {
+    rc = cuda_unshuffle(context->typesize, context->blocksize, nbytes, state->tmp, context->dest,
+                        state->stream);
+  }
+  // Whatever has been queued has to finish before the buffers can be reused
+  cudaError_t err = cudaStreamSynchronize(state->stream);
+  if (rc < 0) {
+    return rc;
+  }
+  if (err != cudaSuccess) {
+    BLOSC_TRACE_ERROR("CUDA error: %s", cudaGetErrorString(err));
+    return BLOSC2_ERROR_FAILURE;
+  }
+
+  for (int64_t i = 0; i < nbatch; i++) {
+    if (batch.statuses[i] != nvcompSuccess || batch.actual_bytes[i] != batch.decomp_bytes[i]) {
+      BLOSC_TRACE_ERROR("Error %d decompressing a stream with nvCOMP.", (int)batch.statuses[i]);
+      return BLOSC2_ERROR_DATA;
+    }
+  }
+  return 1;
+}
@@ -0,0 +1,36 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Decompression of chunks straight into CUDA device memory (with nvCOMP) */
+
+#ifndef BLOSC_BLOSC2_CUDA_H
+#define BLOSC_BLOSC2_CUDA_H
+
+#include "context.h"
+
+#include <stdint.h>
+
+/* Decompress the chunk of an (already initialized) context into its (device) dest.
+ * Returns 1 and the decompressed bytes in `ntbytes` when the chunk has been handled,
+ * 0 when the chunk cannot be decompressed on the GPU (so that the caller should
+ * decompress it on the host) and a negative value on errors. */
+int cuda_decompress(blosc2_context *context, int32_t *ntbytes);
+
+/* Copy `nbytes` of host memory into device memory */
+int cuda_copy_to_device(blosc2_context *context, void *dest, const void *src, int32_t nbytes);
+
+/* Release the CUDA stream and the device buffers of a context */
+void cuda_free_state(blosc2_context *context);
+
+/* Unshuffle the blocks of `src` into `dest` (both in device memory) on `stream` */
+int cuda_unshuffle(int32_t typesize, int32_t blocksize, int32_t nbytes,
+                   const uint8_t *src, uint8_t *dest, void *stream);
+
+#endif /* BLOSC_BLOSC2_CUDA_H */
@@ -11,35 +11,313 @@
 
 #include "blosc2/blosc2-stdio.h"
 #include "blosc2.h"
+#include "blosc-private.h"
 
+#if defined(USING_CMAKE)
+#include "config.h"
+#endif /*  USING_CMAKE */
+
+#if defined(_WIN32) && !defined(__GNUC__)
+#include "win32/pthread.h"
+#else
+#include <pthread.h>
+#endif
+
+#include <sys/stat.h>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+
+/* Cache of (idle) file handles.  Reopening a file for every chunk, header or
+ * block read is expensive, so closing a read-only handle just parks it in a
+ * LRU list, where the next open of the same file can pick it up.  Handles for
+ * writing are never cached, and they flush any parked handle of their file,
+ * so that no stale buffered data can be read afterwards. */
+
+typedef struct blosc2_stdio_cached_file {
+  blosc2_stdio_file base;
+  //!< Must be the first member, as streams are handed out as blosc2_stdio_file.
+  char *urlpath;
+  bool writer;
+#if !defined(_WIN32)
+  dev_t dev;
+  ino_t ino;
+#endif
+  struct blosc2_stdio_cached_file *prev;
+  struct blosc2_stdio_cached_file *next;
+} blosc2_stdio_cached_file;
+
+#if defined(_WIN32)
+/* Open files cannot be removed or renamed on Windows */
+#define BLOSC2_STDIO_MAX_OPEN_DEFAULT 0
+#else
+#define BLOSC2_STDIO_MAX_OPEN_DEFAULT 32
+#endif
+
+/* The bytes charged to the memory budget for every idle handle (its buffer, mostly) */
+#define BLOSC2_STDIO_HANDLE_NBYTES ((int64_t) BUFSIZ + (int64_t) sizeof(blosc2_stdio_cached_file))
+
+static pthread_mutex_t g_cache_mutex;
+static bool g_cache_initialized = false;
+static int g_cache_max_open = BLOSC2_STDIO_MAX_OPEN_DEFAULT;
+static int g_cache_nopen = 0;
+static blosc2_stdio_cached_file *g_cache_head = NULL;  // most recently used
+static blosc2_stdio_cached_file *g_cache_tail = NULL;  // least recently used
+
+
+static void cache_unlink(blosc2_stdio_cached_file *my_fp) {
+  if (my_fp->prev != NULL) {
+    my_fp->prev->next = my_fp->next;
+  }
+  else {
+    g_cache_head = my_fp->next;
+  }
+  if (my_fp->next != NULL) {
+    my_fp->next->prev = my_fp->prev;
+  }
+  else {
+    g_cache_tail = my_fp->prev;
+  }
+  my_fp->prev = my_fp->next = NULL;
+  g_cache_nopen--;
+  membudget_release(BLOSC2_STDIO_HANDLE_NBYTES);
+}
+
+static int cached_file_free(blosc2_stdio_cached_file *my_fp) {
+  int err = fclose(my_fp->base.file);
+  free(my_fp->urlpath);
+  free(my_fp);
+  return err;
+}
+
+/* Whether urlpath is path or lives inside of it (the chunks of a sframe). */
+static bool path_matches(const char *urlpath, const char *path) {
+  size_t len = strlen(path);
+  if (strncmp(urlpath, path, len) != 0) {
+    return false;
+  }
+  if (len > 0 && (path[len - 1] == '/' || path[len - 1] == '\\')) {
+    return true;
+  }
+  return urlpath[len] == '\0' || urlpath[len] == '/' || urlpath[len] == '\\';
+}
+
+/* Close the parked handles of path (or all of them when NULL).  Must be
+ * called with the mutex held. */
+static void cache_release(const char *path) {
+  blosc2_stdio_cached_file *my_fp = g_cache_head;
+  while (my_fp != NULL) {
+    blosc2_stdio_cached_file *next = my_fp->next;
+    if (path == NULL || path_matches(my_fp->urlpath, path)) {
+      cache_unlink(my_fp);
+      cached_file_free(my_fp);
+    }
+    my_fp = next;
+  }
+}
+
+/* Pick a parked handle of urlpath up, if any.  Must be called with the mutex held. */
+static blosc2_stdio_cached_file *cache_get(const char *urlpath) {
+  for (blosc2_stdio_cached_file *my_fp = g_cache_head; my_fp != NULL; my_fp = my_fp->next) {
+    if (strcmp(my_fp->urlpath, urlpath) == 0) {
+      cache_unlink(my_fp);
+      return my_fp;
+    }
+  }
+  return NULL;
+}
+
+void stdio_cache_init(void) {
+  pthread_mutex_init(&g_cache_mutex, NULL);
+  g_cache_initialized = true;
+}
+
+void stdio_cache_destroy(void) {
+  if (!g_cache_initialized) {
+    return;
+  }
+  pthread_mutex_lock(&g_cache_mutex);
+  cache_release(NULL);
+  g_cache_initialized = false;
+  pthread_mutex_unlock(&g_cache_mutex);
+  pthread_mutex_destroy(&g_cache_mutex);
+}
+
+void stdio_cache_release(const char *urlpath) {
+  if (!g_cache_initialized || urlpath == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&g_cache_mutex);
+  cache_release(urlpath);
+  pthread_mutex_unlock(&g_cache_mutex);
+}
+
+void stdio_cache_trim(int64_t nbytes) {
+  if (!g_cache_initialized) {
+    return;
+  }
+  blosc2_stdio_cached_file *evicted = NULL;
+  pthread_mutex_lock(&g_cache_mutex);
+  while (g_cache_tail != NULL && !membudget_fits(nbytes)) {
+    blosc2_stdio_cached_file *lru = g_cache_tail;
+    cache_unlink(lru);
+    lru->next = evicted;
+    evicted = lru;
+  }
+  pthread_mutex_unlock(&g_cache_mutex);
+  while (evicted != NULL) {
+    blosc2_stdio_cached_file *next = evicted->next;
+    cached_file_free(evicted);
+    evicted = next;
+  }
+}
+
+int blosc2_stdio_set_max_open(int max_open) {
+  if (max_open < 0) {
+    BLOSC_TRACE_ERROR("The maximum number of cached files cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (!g_cache_initialized) {
+    int previous = g_cache_max_open;
+    g_cache_max_open = max_open;
+    return previous;
+  }
+  pthread_mutex_lock(&g_cache_mutex);
+  int previous = g_cache_max_open;
+  g_cache_max_open = max_open;
+  while (g_cache_nopen > g_cache_max_open) {
+    blosc2_stdio_cached_file *lru = g_cache_tail;
+    cache_unlink(lru);
+    cached_file_free(lru);
+  }
+  pthread_mutex_unlock(&g_cache_mutex);
+  return previous;
+}
 
 void *blosc2_stdio_open(const char *urlpath, const char *mode, void *params) {
   BLOSC_UNUSED_PARAM(params);
+  bool writer = strcmp(mode, "rb") != 0 && strcmp(mode, "r") != 0;
+
+  if (g_cache_initialized) {
+    pthread_mutex_lock(&g_cache_mutex);
+    if (writer) {
+      cache_release(urlpath);
+      pthread_mutex_unlock(&g_cache_mutex);
+    }
+    else {
+      blosc2_stdio_cached_file *my_fp = cache_get(urlpath);
+      pthread_mutex_unlock(&g_cache_mutex);
+      if (my_fp != NULL) {
+#if !defined(_WIN32)
+        /* Make sure that the file has not been replaced in the meanwhile */
+        struct stat st;
+        if (stat(urlpath, &st) != 0 || st.st_dev != my_fp->dev || st.st_ino != my_fp->ino) {
+          cached_file_free(my_fp);
+          my_fp = NULL;
+        }
+#endif
+      }
+      if (my_fp != NULL) {
+        rewind(my_fp->base.file);
+        return my_fp;
+      }
+    }
+  }
+
   FILE *file = fopen(urlpath, mode);
   if (file == NULL)
     return NULL;
-  blosc2_stdio_file *my_fp = malloc(sizeof(blosc2_stdio_file));
-  my_fp->file = file;
+  blosc2_stdio_cached_file *my_fp = calloc(1, sizeof(blosc2_stdio_cached_file));
+  my_fp->base.file = file;
+  my_fp->urlpath = strdup(urlpath);
+  my_fp->writer = writer;
+#if !defined(_WIN32)
+  struct stat st;
+  if (fstat(fileno(file), &st) == 0) {
+    my_fp->dev = st.st_dev;
+    my_fp->ino = st.st_ino;
+  }
+#endif
   return my_fp;
 }
 
 int blosc2_stdio_close(void *stream) {
-  blosc2_stdio_file *my_fp = (blosc2_stdio_file *) stream;
-  int err = fclose(my_fp->file);
-  free(my_fp);
+  blosc2_stdio_cached_file *my_fp = (blosc2_stdio_cached_file *) stream;
+  if (!g_cache_initialized) {
+    return cached_file_free(my_fp);
+  }
+
+  /* Parked handles are charged to the memory budget (before taking the mutex, as
+   * making room may close other parked handles), and closed if they do not fit */
+  bool charged = !my_fp->writer && g_cache_max_open > 0 && membudget_charge(BLOSC2_STDIO_HANDLE_NBYTES);
+  pthread_mutex_lock(&g_cache_mutex);
+  if (my_fp->writer) {
+    /* Readers opened while writing may have buffered outdated data */
+    cache_release(my_fp->urlpath);
+    pthread_mutex_unlock(&g_cache_mutex);
+    return cached_file_free(my_fp);
+  }
+  if (g_cache_max_open == 0 || !charged) {
+    pthread_mutex_unlock(&g_cache_mutex);
+    if (charged) {
+      membudget_release(BLOSC2_STDIO_HANDLE_NBYTES);
+    }
+    return cached_file_free(my_fp);
+  }
+
+  /* Park the handle as the most recently used, and evict the least recently used ones */
+  my_fp->prev = NULL;
+  my_fp->next = g_cache_head;
+  if (g_cache_head != NULL) {
+    g_cache_head->prev = my_fp;
+  }
+  g_cache_head = my_fp;
+  if (g_cache_tail == NULL) {
+    g_cache_tail = my_fp;
+  }
+  g_cache_nopen++;
+  blosc2_stdio_cached_file *evicted = NULL;
+  while (g_cache_nopen > g_cache_max_open) {
+    blosc2_stdio_cached_file *lru = g_cache_tail;
+    cache_unlink(lru);
+    lru->next = evicted;
+    evicted = lru;
+  }
+  pthread_mutex_unlock(&g_cache_mutex);
+
+  int err = 0;
+  while (evicted != NULL) {
+    blosc2_stdio_cached_file *next = evicted->next;
+    if (cached_file_free(evicted) != 0) {
+      err = EOF;
+    }
+    evicted = next;
+  }
   return err;
 }
 
 int64_t blosc2_stdio_tell(void *stream) {
   blosc2_stdio_file *my_fp = (blosc2_stdio_file *) stream;
   int64_t pos;
-#if defined(_MSC_VER)
+#if defined(_WIN32)
   pos = _ftelli64(my_fp->file);
 #else
-  pos = (int64_t)ftell(my_fp->file);
+  pos = (int64_t)ftello(my_fp->file);
 #endif
   return pos;
 }
@@ -47,10 +325,10 @@ int64_t blosc2_stdio_tell(void *stream) {
 int blosc2_stdio_seek(void *stream, int64_t offset, int whence) {
   blosc2_stdio_file *my_fp = (blosc2_stdio_file *) stream;
   int rc;
-#if defined(_MSC_VER)
+#if defined(_WIN32)
   rc = _fseeki64(my_fp->file, offset, whence);
 #else
-  rc = fseek(my_fp->file, (long) offset, whence);
+  rc = fseeko(my_fp->file, (off_t) offset, whence);
 #endif
   return rc;
 }
@@ -78,3 +356,2328 @@ int blosc2_stdio_truncate(void *stream, int64_t size) {
 #endif
   return rc;
 }
+
+/* The data of the file only (like the length), not all of its metadata */
+int blosc2_stdio_sync(void *stream) {
+  blosc2_stdio_file *my_fp = (blosc2_stdio_file *) stream;
+  if (fflush(my_fp->file) != 0) {
+    return -1;
+  }
+#if defined(_WIN32)
+  return _commit(_fileno(my_fp->file));
+#elif defined(__linux__)
+  return fdatasync(fileno(my_fp->file));
+#else
+  return fsync(fileno(my_fp->file));
+#endif
+}
+
+int stdio_write_fd(int fd, const void *buf, int64_t nbytes) {
+  const uint8_t *ptr = (const uint8_t *) buf;
+  while (nbytes > 0) {
+#if defined(_WIN32)
+    int rc = _write(fd, ptr, (unsigned int) (nbytes < INT32_MAX ? nbytes : INT32_MAX));
+#else
+    ssize_t rc = write(fd, ptr, (size_t) nbytes);
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+#endif
+    if (rc <= 0) {
+      BLOSC_TRACE_ERROR("Cannot write to the file descriptor %d.", fd);
+      return BLOSC2_ERROR_FILE_WRITE;
+    }
+    ptr += rc;
+    nbytes -= rc;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+#if !defined(_WIN32)
+
+/* The most ranges read by a single preadv() (POSIX guarantees an IOV_MAX of 16 at least) */
+#define STDIO_PREADV_MAX 16
+
+/* The positional calls bypass the buffers of the FILE, so any pending write there
+ * is flushed first.  Read-only handles have nothing to flush, and can be shared
+ * by several threads. */
+
+int64_t blosc2_stdio_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_cached_file *my_fp = (blosc2_stdio_cached_file *) stream;
+  if (size <= 0) {
+    return 0;
+  }
+  if (my_fp->writer) {
+    fflush(my_fp->base.file);
+  }
+  int fd = fileno(my_fp->base.file);
+  uint8_t *buf = (uint8_t *) ptr;
+  int64_t nbytes = size * nitems;
+  int64_t rbytes = 0;
+  while (rbytes < nbytes) {
+    ssize_t rc = pread(fd, buf + rbytes, (size_t) (nbytes - rbytes), (off_t) (position + rbytes));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    rbytes += rc;
+  }
+  return rbytes / size;
+}
+
+int64_t blosc2_stdio_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_cached_file *my_fp = (blosc2_stdio_cached_file *) stream;
+  if (size <= 0) {
+    return 0;
+  }
+  fflush(my_fp->base.file);
+  int fd = fileno(my_fp->base.file);
+  const uint8_t *buf = (const uint8_t *) ptr;
+  int64_t nbytes = size * nitems;
+  int64_t wbytes = 0;
+  while (wbytes < nbytes) {
+    ssize_t rc = pwrite(fd, buf + wbytes, (size_t) (nbytes - wbytes), (off_t) (position + wbytes));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    wbytes += rc;
+  }
+  return wbytes / size;
+}
+
+/* The runs of adjacent ranges are read with a single preadv() */
+int64_t blosc2_stdio_preadv(const blosc2_io_vec *vecs, int64_t nvecs, void *stream) {
+  blosc2_stdio_cached_file *my_fp = (blosc2_stdio_cached_file *) stream;
+  if (my_fp->writer) {
+    fflush(my_fp->base.file);
+  }
+  int fd = fileno(my_fp->base.file);
+  struct iovec iov[STDIO_PREADV_MAX];
+  int64_t rbytes = 0;
+  int64_t i = 0;
+  while (i < nvecs) {
+    int niov = 0;
+    int64_t position = vecs[i].position;
+    int64_t nbytes = 0;
+    while (i + niov < nvecs && niov < STDIO_PREADV_MAX && vecs[i + niov].position == position + nbytes) {
+      iov[niov].iov_base = vecs[i + niov].ptr;
+      iov[niov].iov_len = (size_t) vecs[i + niov].size;
+      nbytes += vecs[i + niov].size;
+      niov++;
+    }
+    ssize_t rc;
+    do {
+      rc = preadv(fd, iov, niov, (off_t) position);
+    } while (rc < 0 && errno == EINTR);
+    if (rc != nbytes) {
+      // A short read, so finish the run with plain preads
+      for (int j = 0; j < niov; j++) {
+        if (blosc2_stdio_pread(vecs[i + j].ptr, 1, vecs[i + j].size, vecs[i + j].position, stream) !=
+            vecs[i + j].size) {
+          return -1;
+        }
+      }
+    }
+    rbytes += nbytes;
+    i += niov;
+  }
+  return rbytes;
+}
+
+int64_t blosc2_stdio_copy_range(void *src, int64_t src_position, void *dest, int64_t dest_position,
+                                int64_t nbytes) {
+  blosc2_stdio_cached_file *src_fp = (blosc2_stdio_cached_file *) src;
+  blosc2_stdio_cached_file *dest_fp = (blosc2_stdio_cached_file *) dest;
+  if (src_fp->writer) {
+    fflush(src_fp->base.file);
+  }
+  fflush(dest_fp->base.file);
+  int src_fd = fileno(src_fp->base.file);
+  int dest_fd = fileno(dest_fp->base.file);
+  int64_t copied = 0;
+#if defined(__linux__) && defined(SYS_copy_file_range)
+  /* The kernel copies the range without going through user space, and file systems
+   * like btrfs or XFS just share the blocks (reflinks) */
+  while (copied < nbytes) {
+    int64_t off_in = src_position + copied;
+    int64_t off_out = dest_position + copied;
+    long rc = syscall(SYS_copy_file_range, src_fd, &off_in, dest_fd, &off_out, (size_t) (nbytes - copied), 0u);
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      // Not supported here (e.g. across file systems), so copy the rest through a buffer
+      break;
+    }
+    copied += rc;
+  }
+#endif
+  if (copied == nbytes) {
+    return copied;
+  }
+  int64_t buffer_size = nbytes - copied < (1 << 22) ? nbytes - copied : (1 << 22);
+  uint8_t *buffer = malloc((size_t) buffer_size);
+  if (buffer == NULL) {
+    return copied;
+  }
+  while (copied < nbytes) {
+    int64_t size = nbytes - copied < buffer_size ? nbytes - copied : buffer_size;
+    ssize_t rbytes = pread(src_fd, buffer, (size_t) size, (off_t) (src_position + copied));
+    if (rbytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rbytes <= 0) {
+      break;
+    }
+    if (blosc2_stdio_pwrite(buffer, 1, rbytes, dest_position + copied, dest) != rbytes) {
+      break;
+    }
+    copied += rbytes;
+  }
+  free(buffer);
+  return copied;
+}
+
+int64_t blosc2_stdio_send_range(void *src, int64_t src_position, int fd, int64_t nbytes) {
+  blosc2_stdio_cached_file *src_fp = (blosc2_stdio_cached_file *) src;
+  if (src_fp->writer) {
+    fflush(src_fp->base.file);
+  }
+  int src_fd = fileno(src_fp->base.file);
+  int64_t sent = 0;
+#if defined(__linux__)
+#if defined(SYS_copy_file_range)
+  /* Into plain files, the kernel may share the blocks (reflinks) instead of copying them */
+  struct stat st;
+  bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+  while (regular && sent < nbytes) {
+    int64_t off_in = src_position + sent;
+    long rc = syscall(SYS_copy_file_range, src_fd, &off_in, fd, NULL, (size_t) (nbytes - sent), 0u);
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    sent += rc;
+  }
+#endif
+  /* Sockets, pipes and the rest get the pages of the page cache straight away */
+  while (sent < nbytes) {
+    off_t offset = (off_t) (src_position + sent);
+    ssize_t rc = sendfile(fd, src_fd, &offset, (size_t) (nbytes - sent));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    sent += rc;
+  }
+#endif
+  if (sent == nbytes) {
+    return sent;
+  }
+  int64_t buffer_size = nbytes - sent < (1 << 22) ? nbytes - sent : (1 << 22);
+  uint8_t *buffer = malloc((size_t) buffer_size);
+  if (buffer == NULL) {
+    return sent;
+  }
+  while (sent < nbytes) {
+    int64_t size = nbytes - sent < buffer_size ? nbytes - sent : buffer_size;
+    ssize_t rbytes = pread(src_fd, buffer, (size_t) size, (off_t) (src_position + sent));
+    if (rbytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rbytes <= 0) {
+      break;
+    }
+    if (stdio_write_fd(fd, buffer, rbytes) < 0) {
+      break;
+    }
+    sent += rbytes;
+  }
+  free(buffer);
+  return sent;
+}
+
+#endif  /* _WIN32 */
+
+
+/* Memory-mapped files.  The mapping state lives in the params of the io, so
+ * that every open of the frame shares it; the streams are just a position
+ * into it. */
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>
+#include <sys/mman.h>
+
+typedef struct blosc2_stdio_mmap_region {
+  uint8_t *addr;
+  int64_t size;
+  struct blosc2_stdio_mmap_region *prev;
+  //!< The (older) mapping that this one replaced.  It is kept until the state is destroyed.
+} blosc2_stdio_mmap_region;
+
+typedef struct {
+  char *urlpath;
+  int fd;
+  bool writable;
+  int64_t file_size;
+  blosc2_stdio_mmap_region *region;
+  //!< The current mapping (NULL while the file is empty).
+  pthread_mutex_t mutex;
+} blosc2_stdio_mmap_state;
+
+typedef struct {
+  blosc2_stdio_mmap_state *state;
+  int64_t position;
+} blosc2_stdio_mmap_file;
+
+
+static blosc2_stdio_mmap_state *mmap_state_new(const char *urlpath, const char *mode) {
+  int flags;
+  bool writable = true;
+  if (strcmp(mode, "r") == 0) {
+    flags = O_RDONLY;
+    writable = false;
+  }
+  else if (strcmp(mode, "r+") == 0) {
+    flags = O_RDWR;
+  }
+  else if (strcmp(mode, "w+") == 0) {
+    flags = O_RDWR | O_CREAT | O_TRUNC;
+  }
+  else {
+    BLOSC_TRACE_ERROR("Mode '%s' is not supported for memory-mapped files (use \"r\", \"r+\" or \"w+\").",
+                      mode);
+    return NULL;
+  }
+
+  int fd = open(urlpath, flags, 0666);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  blosc2_stdio_mmap_state *state = calloc(1, sizeof(blosc2_stdio_mmap_state));
+  state->urlpath = strdup(urlpath);
+  state->fd = fd;
+  state->writable = writable;
+  state->file_size = (int64_t) st.st_size;
+  pthread_mutex_init(&state->mutex, NULL);
+  return state;
+}
+
+
+/* Make sure that the current mapping covers up to `end` (as long as the file
+ * does) and return it.  Must be called with the mutex held. */
+static blosc2_stdio_mmap_region *mmap_state_region(blosc2_stdio_mmap_state *state, int64_t end) {
+  blosc2_stdio_mmap_region *region = state->region;
+  if (region != NULL && end <= region->size) {
+    return region;
+  }
+
+  /* The file may have been grown by somebody else too */
+  struct stat st;
+  if (fstat(state->fd, &st) == 0 && (int64_t) st.st_size > state->file_size) {
+    state->file_size = (int64_t) st.st_size;
+  }
+  if (state->file_size == 0 || (region != NULL && region->size >= state->file_size)) {
+    return region;
+  }
+
+  /* Pointers into the previous mapping may still be in use, so map the whole
+   * file again instead of remapping it */
+  void *addr = mmap(NULL, (size_t) state->file_size, PROT_READ, MAP_SHARED, state->fd, 0);
+  if (addr == MAP_FAILED) {
+    BLOSC_TRACE_ERROR("Cannot map the file %s (error: %s).", state->urlpath, strerror(errno));
+    return region;
+  }
+  blosc2_stdio_mmap_region *new_region = malloc(sizeof(blosc2_stdio_mmap_region));
+  new_region->addr = addr;
+  new_region->size = state->file_size;
+  new_region->prev = region;
+  state->region = new_region;
+  return new_region;
+}
+
+
+void *blosc2_stdio_mmap_open(const char *urlpath, const char *mode, void *params) {
+  blosc2_stdio_mmap *mmap_file = (blosc2_stdio_mmap *) params;
+  if (mmap_file == NULL) {
+    BLOSC_TRACE_ERROR("The memory-mapped io needs a blosc2_stdio_mmap struct as params.");
+    return NULL;
+  }
+
+  blosc2_stdio_mmap_state *state = (blosc2_stdio_mmap_state *) mmap_file->state;
+  if (state == NULL) {
+    state = mmap_state_new(urlpath, mmap_file->mode);
+    if (state == NULL) {
+      return NULL;
+    }
+    mmap_file->state = state;
+  }
+  else if (strcmp(state->urlpath, urlpath) != 0) {
+    BLOSC_TRACE_ERROR("The memory-mapped io is already in use for %s (and cannot open %s).  "
+                      "Only contiguous frames are supported.", state->urlpath, urlpath);
+    return NULL;
+  }
+
+  if (mode[0] != 'r' && !state->writable) {
+    BLOSC_TRACE_ERROR("Cannot open %s with mode '%s' because it is mapped read-only.", urlpath, mode);
+    return NULL;
+  }
+  if (mode[0] == 'w') {
+    /* Like fopen() would do; pointers into the truncated part become invalid */
+    pthread_mutex_lock(&state->mutex);
+    int rc = ftruncate(state->fd, 0);
+    if (rc == 0) {
+      state->file_size = 0;
+    }
+    pthread_mutex_unlock(&state->mutex);
+    if (rc < 0) {
+      return NULL;
+    }
+  }
+
+  blosc2_stdio_mmap_file *my_fp = malloc(sizeof(blosc2_stdio_mmap_file));
+  my_fp->state = state;
+  my_fp->position = 0;
+  if (mode[0] == 'a') {
+    pthread_mutex_lock(&state->mutex);
+    my_fp->position = state->file_size;
+    pthread_mutex_unlock(&state->mutex);
+  }
+  return my_fp;
+}
+
+int blosc2_stdio_mmap_close(void *stream) {
+  /* The file and its mappings are kept until blosc2_stdio_mmap_destroy() */
+  free(stream);
+  return 0;
+}
+
+int64_t blosc2_stdio_mmap_tell(void *stream) {
+  blosc2_stdio_mmap_file *my_fp = (blosc2_stdio_mmap_file *) stream;
+  return my_fp->position;
+}
+
+int blosc2_stdio_mmap_seek(void *stream, int64_t offset, int whence) {
+  blosc2_stdio_mmap_file *my_fp = (blosc2_stdio_mmap_file *) stream;
+  int64_t position;
+  switch (whence) {
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = my_fp->position + offset;
+      break;
+    case SEEK_END:
+      pthread_mutex_lock(&my_fp->state->mutex);
+      position = my_fp->state->file_size + offset;
+      pthread_mutex_unlock(&my_fp->state->mutex);
+      break;
+    default:
+      return -1;
+  }
+  if (position < 0) {
+    return -1;
+  }
+  my_fp->position = position;
+  return 0;
+}
+
+int64_t blosc2_stdio_mmap_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_stdio_mmap_file *my_fp = (blosc2_stdio_mmap_file *) stream;
+  blosc2_stdio_mmap_state *state = my_fp->state;
+  if (!state->writable || size <= 0) {
+    return 0;
+  }
+
+  /* Writes go through the file, and show up in the (shared) mappings */
+  const uint8_t *buf = (const uint8_t *) ptr;
+  int64_t nbytes = size * nitems;
+  int64_t written = 0;
+  while (written < nbytes) {
+    ssize_t rc = pwrite(state->fd, buf + written, (size_t) (nbytes - written), (off_t) (my_fp->position + written));
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    written += rc;
+  }
+  my_fp->position += written;
+
+  pthread_mutex_lock(&state->mutex);
+  if (my_fp->position > state->file_size) {
+    state->file_size = my_fp->position;
+  }
+  pthread_mutex_unlock(&state->mutex);
+  return written / size;
+}
+
+int64_t blosc2_stdio_mmap_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_stdio_mmap_file *my_fp = (blosc2_stdio_mmap_file *) stream;
+  if (size <= 0) {
+    return 0;
+  }
+  int64_t nbytes = size * nitems;
+  int64_t end = my_fp->position + nbytes;
+
+  pthread_mutex_lock(&my_fp->state->mutex);
+  blosc2_stdio_mmap_region *region = mmap_state_region(my_fp->state, end);
+  pthread_mutex_unlock(&my_fp->state->mutex);
+
+  int64_t available = region != NULL ? region->size - my_fp->position : 0;
+  if (available < nbytes) {
+    /* A short read at the end of the file, like fread() */
+    nbytes = available > 0 ? available / size * size : 0;
+  }
+  if (nbytes > 0) {
+    memcpy(ptr, region->addr + my_fp->position, (size_t) nbytes);
+    my_fp->position += nbytes;
+  }
+  return nbytes / size;
+}
+
+int blosc2_stdio_mmap_truncate(void *stream, int64_t size) {
+  blosc2_stdio_mmap_file *my_fp = (blosc2_stdio_mmap_file *) stream;
+  blosc2_stdio_mmap_state *state = my_fp->state;
+  if (!state->writable) {
+    return -1;
+  }
+  pthread_mutex_lock(&state->mutex);
+  int rc = ftruncate(state->fd, (off_t) size);
+  if (rc == 0) {
+    state->file_size = size;
+  }
+  pthread_mutex_unlock(&state->mutex);
+  return rc;
+}
+
+int64_t blosc2_stdio_mmap_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_mmap_file my_fp = *(blosc2_stdio_mmap_file *) stream;
+  my_fp.position = position;
+  return blosc2_stdio_mmap_read(ptr, size, nitems, &my_fp);
+}
+
+int64_t blosc2_stdio_mmap_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_mmap_file my_fp = *(blosc2_stdio_mmap_file *) stream;
+  my_fp.position = position;
+  return blosc2_stdio_mmap_write(ptr, size, nitems, &my_fp);
+}
+
+void *blosc2_stdio_mmap_map(void *stream, int64_t offset, int64_t size) {
+  blosc2_stdio_mmap_file *my_fp = (blosc2_stdio_mmap_file *) stream;
+  if (offset < 0 || size < 0) {
+    return NULL;
+  }
+  pthread_mutex_lock(&my_fp->state->mutex);
+  blosc2_stdio_mmap_region *region = mmap_state_region(my_fp->state, offset + size);
+  pthread_mutex_unlock(&my_fp->state->mutex);
+  if (region == NULL || offset + size > region->size) {
+    return NULL;
+  }
+  return region->addr + offset;
+}
+
+int blosc2_stdio_mmap_destroy(blosc2_stdio_mmap *mmap_file) {
+  BLOSC_ERROR_NULL(mmap_file, BLOSC2_ERROR_NULL_POINTER);
+  blosc2_stdio_mmap_state *state = (blosc2_stdio_mmap_state *) mmap_file->state;
+  if (state == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int err = BLOSC2_ERROR_SUCCESS;
+  blosc2_stdio_mmap_region *region = state->region;
+  while (region != NULL) {
+    blosc2_stdio_mmap_region *prev = region->prev;
+    if (munmap(region->addr, (size_t) region->size) < 0) {
+      BLOSC_TRACE_ERROR("Cannot unmap the file %s (error: %s).", state->urlpath, strerror(errno));
+      err = BLOSC2_ERROR_FILE_WRITE;
+    }
+    free(region);
+    region = prev;
+  }
+  if (close(state->fd) < 0) {
+    err = BLOSC2_ERROR_FILE_WRITE;
+  }
+  pthread_mutex_destroy(&state->mutex);
+  free(state->urlpath);
+  free(state);
+  mmap_file->state = NULL;
+  return err;
+}
+
+#else  /* _WIN32 */
+
+void *blosc2_stdio_mmap_open(const char *urlpath, const char *mode, void *params) {
+  BLOSC_UNUSED_PARAM(urlpath);
+  BLOSC_UNUSED_PARAM(mode);
+  BLOSC_UNUSED_PARAM(params);
+  BLOSC_TRACE_ERROR("Memory-mapped files are not supported on Windows yet.");
+  return NULL;
+}
+
+int blosc2_stdio_mmap_close(void *stream) {
+  BLOSC_UNUSED_PARAM(stream);
+  return -1;
+}
+
+int64_t blosc2_stdio_mmap_tell(void *stream) {
+  BLOSC_UNUSED_PARAM(stream);
+  return -1;
+}
+
+int blosc2_stdio_mmap_seek(void *stream, int64_t offset, int whence) {
+  BLOSC_UNUSED_PARAM(stream);
+  BLOSC_UNUSED_PARAM(offset);
+  BLOSC_UNUSED_PARAM(whence);
+  return -1;
+}
+
+int64_t blosc2_stdio_mmap_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  BLOSC_UNUSED_PARAM(ptr);
+  BLOSC_UNUSED_PARAM(size);
+  BLOSC_UNUSED_PARAM(nitems);
+  BLOSC_UNUSED_PARAM(stream);
+  return 0;
+}
+
+int64_t blosc2_stdio_mmap_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  BLOSC_UNUSED_PARAM(ptr);
+  BLOSC_UNUSED_PARAM(size);
+  BLOSC_UNUSED_PARAM(nitems);
+  BLOSC_UNUSED_PARAM(stream);
+  return 0;
+}
+
+int blosc2_stdio_mmap_truncate(void *stream, int64_t size) {
+  BLOSC_UNUSED_PARAM(stream);
+  BLOSC_UNUSED_PARAM(size);
+  return -1;
+}
+
+int64_t blosc2_stdio_mmap_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  BLOSC_UNUSED_PARAM(position);
+  return blosc2_stdio_mmap_read(ptr, size, nitems, stream);
+}
+
+int64_t blosc2_stdio_mmap_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  BLOSC_UNUSED_PARAM(position);
+  return blosc2_stdio_mmap_write(ptr, size, nitems, stream);
+}
+
+void *blosc2_stdio_mmap_map(void *stream, int64_t offset, int64_t size) {
+  BLOSC_UNUSED_PARAM(stream);
+  BLOSC_UNUSED_PARAM(offset);
+  BLOSC_UNUSED_PARAM(size);
+  return NULL;
+}
+
+int blosc2_stdio_mmap_destroy(blosc2_stdio_mmap *mmap_file) {
+  BLOSC_UNUSED_PARAM(mmap_file);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+#endif  /* _WIN32 */
+
+
+/* Files accessed through plain descriptors, with batched reads through an
+ * io_uring.  A ring is set up for every batch, which is cheap compared with
+ * the reads of a batch of chunks; if the kernel refuses it (too old, or
+ * forbidden by a sandbox) the reads of the batch are done one by one. */
+
+#if !defined(_WIN32)
+
+#include <fcntl.h>
+
+#if defined(__linux__) && defined(HAVE_IO_URING)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define BLOSC_USE_IO_URING
+#endif
+#endif
+
+typedef struct {
+  int fd;
+  int64_t position;
+  int32_t queue_depth;
+} blosc2_stdio_uring_file;
+
+
+void *blosc2_stdio_uring_open(const char *urlpath, const char *mode, void *params) {
+  blosc2_stdio_uring *uring = (blosc2_stdio_uring *) params;
+  int flags;
+  bool append = false;
+  bool update = strchr(mode, '+') != NULL;
+  switch (mode[0]) {
+    case 'r':
+      flags = update ? O_RDWR : O_RDONLY;
+      break;
+    case 'w':
+      flags = (update ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+      break;
+    case 'a':
+      /* Not O_APPEND, because the positional writes would ignore the position */
+      flags = (update ? O_RDWR : O_WRONLY) | O_CREAT;
+      append = true;
+      break;
+    default:
+      BLOSC_TRACE_ERROR("Unsupported mode '%s' for %s.", mode, urlpath);
+      return NULL;
+  }
+
+  int fd = open(urlpath, flags, 0666);
+  if (fd < 0) {
+    return NULL;
+  }
+  blosc2_stdio_uring_file *my_fp = malloc(sizeof(blosc2_stdio_uring_file));
+  if (my_fp == NULL) {
+    close(fd);
+    return NULL;
+  }
+  my_fp->fd = fd;
+  my_fp->position = append ? (int64_t) lseek(fd, 0, SEEK_END) : 0;
+  my_fp->queue_depth = BLOSC2_STDIO_URING_DEFAULTS.queue_depth;
+  if (uring != NULL && uring->queue_depth > 0) {
+    my_fp->queue_depth = uring->queue_depth;
+  }
+  return my_fp;
+}
+
+int blosc2_stdio_uring_close(void *stream) {
+  blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) stream;
+  int rc = close(my_fp->fd);
+  free(my_fp);
+  return rc;
+}
+
+int64_t blosc2_stdio_uring_tell(void *stream) {
+  blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) stream;
+  return my_fp->position;
+}
+
+int blosc2_stdio_uring_seek(void *stream, int64_t offset, int whence) {
+  blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) stream;
+  int64_t position;
+  switch (whence) {
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = my_fp->position + offset;
+      break;
+    case SEEK_END:
+      position = (int64_t) lseek(my_fp->fd, 0, SEEK_END) + offset;
+      break;
+    default:
+      return -1;
+  }
+  if (position < 0) {
+    return -1;
+  }
+  my_fp->position = position;
+  return 0;
+}
+
+int64_t blosc2_stdio_uring_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) stream;
+  if (size <= 0) {
+    return 0;
+  }
+  uint8_t *buf = (uint8_t *) ptr;
+  int64_t nbytes = size * nitems;
+  int64_t rbytes = 0;
+  while (rbytes < nbytes) {
+    ssize_t rc = pread(my_fp->fd, buf + rbytes, (size_t) (nbytes - rbytes), (off_t) (position + rbytes));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    rbytes += rc;
+  }
+  return rbytes / size;
+}
+
+int64_t blosc2_stdio_uring_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) stream;
+  if (size <= 0) {
+    return 0;
+  }
+  const uint8_t *buf = (const uint8_t *) ptr;
+  int64_t nbytes = size * nitems;
+  int64_t wbytes = 0;
+  while (wbytes < nbytes) {
+    ssize_t rc = pwrite(my_fp->fd, buf + wbytes, (size_t) (nbytes - wbytes), (off_t) (position + wbytes));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      break;
+    }
+    wbytes += rc;
+  }
+  return wbytes / size;
+}
+
+int64_t blosc2_stdio_uring_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) stream;
+  int64_t nitems_ = blosc2_stdio_uring_pwrite(ptr, size, nitems, my_fp->position, stream);
+  my_fp->position += nitems_ * size;
+  return nitems_;
+}
+
+int64_t blosc2_stdio_uring_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) stream;
+  int64_t nitems_ = blosc2_stdio_uring_pread(ptr, size, nitems, my_fp->position, stream);
+  my_fp->position += nitems_ * size;
+  return nitems_;
+}
+
+int blosc2_stdio_uring_truncate(void *stream, int64_t size) {
+  blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) stream;
+  return ftruncate(my_fp->fd, (off_t) size);
+}
+
+/* Read the requests one after the other */
+static int uring_pread_serial(blosc2_io_request *requests, int64_t nrequests, blosc2_io_done_cb done) {
+  int rc = 0;
+  for (int64_t i = 0; i < nrequests; i++) {
+    blosc2_io_request *request = &requests[i];
+    request->result = blosc2_stdio_uring_pread(request->ptr, 1, request->size, request->position,
+                                               request->stream);
+    if (request->result != request->size) {
+      rc = BLOSC2_ERROR_FILE_READ;
+    }
+    done(request);
+  }
+  return rc;
+}
+
+#if defined(BLOSC_USE_IO_URING)
+
+typedef struct {
+  int fd;
+  unsigned entries;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned sq_mask;
+  unsigned *sq_array;
+  unsigned sq_pending;
+  //!< The entries queued after the last submission.
+  struct io_uring_sqe *sqes;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+} uring_ring;
+
+
+static void uring_ring_free(uring_ring *ring) {
+  if (ring->sqes != NULL) {
+    munmap(ring->sqes, ring->entries * sizeof(struct io_uring_sqe));
+  }
+  if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  if (ring->sq_ring != NULL) {
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  }
+  close(ring->fd);
+}
+
+static int uring_ring_init(uring_ring *ring, unsigned entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  memset(ring, 0, sizeof(uring_ring));
+  ring->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+  if (ring->fd < 0) {
+    return -1;
+  }
+  ring->entries = p.sq_entries;
+
+  ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+    ring->sq_ring_size = ring->cq_ring_size;
+  }
+  void *sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring->fd, IORING_OFF_SQ_RING);
+  if (sq_ring == MAP_FAILED) {
+    close(ring->fd);
+    return -1;
+  }
+  ring->sq_ring = sq_ring;
+  if (single_mmap) {
+    ring->cq_ring = sq_ring;
+  }
+  else {
+    void *cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) {
+      uring_ring_free(ring);
+      return -1;
+    }
+    ring->cq_ring = cq_ring;
+  }
+  void *sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    uring_ring_free(ring);
+    return -1;
+  }
+  ring->sqes = sqes;
+
+  uint8_t *sq = (uint8_t *) ring->sq_ring;
+  ring->sq_head = (unsigned *) (sq + p.sq_off.head);
+  ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+  ring->sq_mask = *(unsigned *) (sq + p.sq_off.ring_mask);
+  ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+  uint8_t *cq = (uint8_t *) ring->cq_ring;
+  ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+  ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+  ring->cq_mask = *(unsigned *) (cq + p.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+  return 0;
+}
+
+/* Queue a read of iov at position of fd.  Only the kernel consumes the submission
+ * queue, and never more entries than the ones in flight, so there is always room. */
+static void uring_queue_read(uring_ring *ring, int fd, struct iovec *iov, int64_t position, uint64_t user_data) {
+  unsigned tail = *ring->sq_tail + ring->sq_pending;
+  unsigned index = tail & ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = fd;
+  sqe->addr = (uint64_t) (uintptr_t) iov;
+  sqe->len = 1;
+  sqe->off = (uint64_t) position;
+  sqe->user_data = user_data;
+  ring->sq_array[index] = index;
+  ring->sq_pending++;
+}
+
+/* Submit the queued reads and wait for at least a completion */
+static int uring_submit_and_wait(uring_ring *ring) {
+  __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->sq_pending, __ATOMIC_RELEASE);
+  unsigned to_submit = ring->sq_pending;
+  ring->sq_pending = 0;
+  while (true) {
+    int rc = (int) syscall(__NR_io_uring_enter, ring->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (rc >= 0) {
+      to_submit -= (unsigned) rc < to_submit ? (unsigned) rc : to_submit;
+      if (to_submit == 0) {
+        return 0;
+      }
+    }
+    else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      return -1;
+    }
+  }
+}
+
+static int uring_pread_batch(uring_ring *ring, blosc2_io_request *requests, int64_t nrequests,
+                             blosc2_io_done_cb done) {
+  /* The iovecs must live until the reads complete; iov_base and iov_len track the progress */
+  struct iovec *iovs = malloc(nrequests * sizeof(struct iovec));
+  if (iovs == NULL) {
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  int rc = 0;
+  int64_t nqueued = 0;
+  int64_t ninflight = 0;
+  int64_t ndone = 0;
+  while (ndone < nrequests) {
+    while (nqueued < nrequests && ninflight < ring->entries) {
+      blosc2_io_request *request = &requests[nqueued];
+      blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) request->stream;
+      request->result = 0;
+      iovs[nqueued].iov_base = request->ptr;
+      iovs[nqueued].iov_len = (size_t) request->size;
+      uring_queue_read(ring, my_fp->fd, &iovs[nqueued], request->position, (uint64_t) nqueued);
+      nqueued++;
+      ninflight++;
+    }
+    if (uring_submit_and_wait(ring) < 0) {
+      /* The reads in flight could still write into the buffers */
+      BLOSC_TRACE_ERROR("Cannot submit the reads to the io_uring (errno %d).", errno);
+      abort();
+    }
+
+    unsigned head = *ring->cq_head;
+    while (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+      struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+      int64_t i = (int64_t) cqe->user_data;
+      int32_t res = cqe->res;
+      head++;
+      blosc2_io_request *request = &requests[i];
+      blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) request->stream;
+      if (res == -EINTR || res == -EAGAIN) {
+        uring_queue_read(ring, my_fp->fd, &iovs[i], request->position + request->result, (uint64_t) i);
+        continue;
+      }
+      if (res > 0) {
+        request->result += res;
+        if (request->result < request->size) {
+          /* Short read; queue the rest */
+          iovs[i].iov_base = (uint8_t *) request->ptr + request->result;
+          iovs[i].iov_len = (size_t) (request->size - request->result);
+          uring_queue_read(ring, my_fp->fd, &iovs[i], request->position + request->result, (uint64_t) i);
+          continue;
+        }
+      }
+      else if (res < 0) {
+        request->result = res;
+      }
+      if (request->result != request->size) {
+        rc = BLOSC2_ERROR_FILE_READ;
+      }
+      ninflight--;
+      ndone++;
+      done(request);
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  }
+  free(iovs);
+  return rc;
+}
+
+#endif  /* BLOSC_USE_IO_URING */
+
+int blosc2_stdio_uring_pread_batch(blosc2_io_request *requests, int64_t nrequests, blosc2_io_done_cb done) {
+  if (nrequests <= 0) {
+    return 0;
+  }
+#if defined(BLOSC_USE_IO_URING)
+  if (nrequests > 1) {
+    blosc2_stdio_uring_file *my_fp = (blosc2_stdio_uring_file *) requests[0].stream;
+    int64_t entries = nrequests < my_fp->queue_depth ? nrequests : my_fp->queue_depth;
+    uring_ring ring;
+    if (uring_ring_init(&ring, (unsigned) entries) == 0) {
+      int rc = uring_pread_batch(&ring, requests, nrequests, done);
+      uring_ring_free(&ring);
+      return rc;
+    }
+  }
+#endif
+  return uring_pread_serial(requests, nrequests, done);
+}
+
+#else  /* _WIN32 */
+
+void *blosc2_stdio_uring_open(const char *urlpath, const char *mode, void *params) {
+  BLOSC_UNUSED_PARAM(urlpath);
+  BLOSC_UNUSED_PARAM(mode);
+  BLOSC_UNUSED_PARAM(params);
+  BLOSC_TRACE_ERROR("The io_uring io is not supported on Windows.");
+  return NULL;
+}
+
+int blosc2_stdio_uring_close(void *stream) {
+  BLOSC_UNUSED_PARAM(stream);
+  return -1;
+}
+
+int64_t blosc2_stdio_uring_tell(void *stream) {
+  BLOSC_UNUSED_PARAM(stream);
+  return -1;
+}
+
+int blosc2_stdio_uring_seek(void *stream, int64_t offset, int whence) {
+  BLOSC_UNUSED_PARAM(stream);
+  BLOSC_UNUSED_PARAM(offset);
+  BLOSC_UNUSED_PARAM(whence);
+  return -1;
+}
+
+int64_t blosc2_stdio_uring_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  BLOSC_UNUSED_PARAM(ptr);
+  BLOSC_UNUSED_PARAM(size);
+  BLOSC_UNUSED_PARAM(nitems);
+  BLOSC_UNUSED_PARAM(stream);
+  return 0;
+}
+
+int64_t blosc2_stdio_uring_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  BLOSC_UNUSED_PARAM(ptr);
+  BLOSC_UNUSED_PARAM(size);
+  BLOSC_UNUSED_PARAM(nitems);
+  BLOSC_UNUSED_PARAM(stream);
+  return 0;
+}
+
+int blosc2_stdio_uring_truncate(void *stream, int64_t size) {
+  BLOSC_UNUSED_PARAM(stream);
+  BLOSC_UNUSED_PARAM(size);
+  return -1;
+}
+
+int64_t blosc2_stdio_uring_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  BLOSC_UNUSED_PARAM(position);
+  return blosc2_stdio_uring_read(ptr, size, nitems, stream);
+}
+
+int64_t blosc2_stdio_uring_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  BLOSC_UNUSED_PARAM(position);
+  return blosc2_stdio_uring_write(ptr, size, nitems, stream);
+}
+
+int blosc2_stdio_uring_pread_batch(blosc2_io_request *requests, int64_t nrequests, blosc2_io_done_cb done) {
+  for (int64_t i = 0; i < nrequests; i++) {
+    requests[i].result = -1;
+    done(&requests[i]);
+  }
+  return BLOSC2_ERROR_FILE_READ;
+}
+
+#endif  /* _WIN32 */
+
+
+/* Files written with O_DIRECT.  The state lives in the params of the io (as for
+ * memory-mapped files), and the contents of the file are split in three parts:
+ *
+ *   [0, head_size)              the head, always in memory
+ *   [head_size, tail_start)     the body, only in the file
+ *   [tail_start, file_size)     the tail, in memory (and not yet in the file)
+ *
+ * head_size and tail_start are aligned, so the (aligned) reads and writes of the
+ * body never touch the buffered parts.  When the tail buffer is full, its first
+ * half goes to the file and becomes part of the body. */
+
+#if !defined(_WIN32)
+
+#if !defined(O_DIRECT)
+#define O_DIRECT 0
+#endif
+
+#define DIRECT_HEAD_SIZE (64 * 1024)
+
+typedef struct {
+  char *urlpath;
+  int fd;
+  bool writable;
+  int64_t alignment;
+  int64_t file_size;
+  uint8_t *head;
+  int64_t head_size;
+  bool head_dirty;
+  uint8_t *tail;
+  int64_t tail_start;
+  int64_t tail_capacity;
+  bool tail_dirty;
+  pthread_mutex_t mutex;
+} blosc2_stdio_direct_state;
+
+typedef struct {
+  blosc2_stdio_direct_state *state;
+  int64_t position;
+} blosc2_stdio_direct_file;
+
+
+static int64_t direct_align_down(blosc2_stdio_direct_state *state, int64_t x) {
+  return x & ~(state->alignment - 1);
+}
+
+static int64_t direct_align_up(blosc2_stdio_direct_state *state, int64_t x) {
+  return direct_align_down(state, x + state->alignment - 1);
+}
+
+/* Read an aligned range of the file; the part beyond its end is zeroed */
+static int direct_disk_read(blosc2_stdio_direct_state *state, uint8_t *buf, int64_t nbytes, int64_t position) {
+  int64_t rbytes = 0;
+  while (rbytes < nbytes) {
+    ssize_t rc = pread(state->fd, buf + rbytes, (size_t) (nbytes - rbytes), (off_t) (position + rbytes));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot read %s (error: %s).", state->urlpath, strerror(errno));
+      return BLOSC2_ERROR_FILE_READ;
+    }
+    if (rc == 0) {
+      memset(buf + rbytes, 0, (size_t) (nbytes - rbytes));
+      break;
+    }
+    rbytes += rc;
+  }
+  return 0;
+}
+
+/* Write an aligned range of the file */
+static int direct_disk_write(blosc2_stdio_direct_state *state, const uint8_t *buf, int64_t nbytes,
+                             int64_t position) {
+  int64_t wbytes = 0;
+  while (wbytes < nbytes) {
+    ssize_t rc = pwrite(state->fd, buf + wbytes, (size_t) (nbytes - wbytes), (off_t) (position + wbytes));
+    if (rc < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rc <= 0) {
+      BLOSC_TRACE_ERROR("Cannot write %s (error: %s).", state->urlpath, strerror(errno));
+      return BLOSC2_ERROR_FILE_WRITE;
+    }
+    wbytes += rc;
+  }
+  return 0;
+}
+
+/* Read the aligned blocks of a range of the body into a bounce buffer */
+static uint8_t *direct_body_blocks(blosc2_stdio_direct_state *state, int64_t nbytes, int64_t position,
+                                   int64_t *start, int64_t *len) {
+  *start = direct_align_down(state, position);
+  *len = direct_align_up(state, position + nbytes) - *start;
+  uint8_t *buf = NULL;
+  if (posix_memalign((void **) &buf, (size_t) state->alignment, (size_t) *len) != 0) {
+    return NULL;
+  }
+  if (direct_disk_read(state, buf, *len, *start) < 0) {
+    free(buf);
+    return NULL;
+  }
+  return buf;
+}
+
+static int direct_body_read(blosc2_stdio_direct_state *state, uint8_t *dst, int64_t nbytes, int64_t position) {
+  int64_t start, len;
+  uint8_t *buf = direct_body_blocks(state, nbytes, position, &start, &len);
+  if (buf == NULL) {
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  memcpy(dst, buf + (position - start), (size_t) nbytes);
+  free(buf);
+  return 0;
+}
+
+/* Read-modify-write of the aligned blocks of a range of the body */
+static int direct_body_write(blosc2_stdio_direct_state *state, const uint8_t *src, int64_t nbytes,
+                             int64_t position) {
+  int64_t start, len;
+  uint8_t *buf = direct_body_blocks(state, nbytes, position, &start, &len);
+  if (buf == NULL) {
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  memcpy(buf + (position - start), src, (size_t) nbytes);
+  int rc = direct_disk_write(state, buf, len, start);
+  free(buf);
+  return rc;
+}
+
+/* Move the tail data before `boundary` (aligned) to the body */
+static int direct_tail_flush(blosc2_stdio_direct_state *state, int64_t boundary) {
+  int64_t nbytes = boundary - state->tail_start;
+  int rc = direct_disk_write(state, state->tail, nbytes, state->tail_start);
+  if (rc < 0) {
+    return rc;
+  }
+  int64_t tail_len = state->file_size - state->tail_start;
+  memmove(state->tail, state->tail + nbytes, (size_t) (tail_len - nbytes));
+  state->tail_start = boundary;
+  return 0;
+}
+
+/* Put data (or zeros if src is NULL) in the tail, from position (which cannot be beyond the end) */
+static int direct_tail_put(blosc2_stdio_direct_state *state, const uint8_t *src, int64_t nbytes,
+                           int64_t position) {
+  while (nbytes > 0) {
+    int64_t offset = position - state->tail_start;
+    if (offset >= state->tail_capacity) {
+      /* Keep the last half of the buffer, where the offsets and the trailer go */
+      int64_t boundary = state->file_size - state->tail_capacity / 2;
+      boundary = direct_align_down(state, position < boundary ? position : boundary);
+      int rc = direct_tail_flush(state, boundary);
+      if (rc < 0) {
+        return rc;
+      }
+      continue;
+    }
+    int64_t n = state->tail_capacity - offset;
+    n = nbytes < n ? nbytes : n;
+    if (src != NULL) {
+      memcpy(state->tail + offset, src, (size_t) n);
+      src += n;
+    }
+    else {
+      memset(state->tail + offset, 0, (size_t) n);
+    }
+    position += n;
+    nbytes -= n;
+    if (position > state->file_size) {
+      state->file_size = position;
+    }
+    state->tail_dirty = true;
+  }
+  return 0;
+}
+
+/* Write data (or zeros if src is NULL).  Must be called with the mutex held. */
+static int direct_write_range(blosc2_stdio_direct_state *state, const uint8_t *src, int64_t nbytes,
+                              int64_t position) {
+  if (position > state->file_size) {
+    int rc = direct_write_range(state, NULL, position - state->file_size, state->file_size);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  int64_t end = position + nbytes;
+  if (position < state->head_size) {
+    int64_t n = (end < state->head_size ? end : state->head_size) - position;
+    if (src != NULL) {
+      memcpy(state->head + position, src, (size_t) n);
+    }
+    else {
+      memset(state->head + position, 0, (size_t) n);
+    }
+    state->head_dirty = true;
+    if (position + n > state->file_size) {
+      state->file_size = position + n;
+    }
+  }
+  int64_t body_start = position > state->head_size ? position : state->head_size;
+  int64_t body_end = end < state->tail_start ? end : state->tail_start;
+  /* The body is before the end of the file, so the zeros for a gap never go there */
+  if (body_start < body_end && src != NULL) {
+    int rc = direct_body_write(state, src + (body_start - position), body_end - body_start, body_start);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  int64_t tail_position = position > state->tail_start ? position : state->tail_start;
+  if (tail_position < end) {
+    const uint8_t *tail_src = src != NULL ? src + (tail_position - position) : NULL;
+    return direct_tail_put(state, tail_src, end - tail_position, tail_position);
+  }
+  return 0;
+}
+
+/* Read data up to the end of the file.  Must be called with the mutex held. */
+static int64_t direct_read_range(blosc2_stdio_direct_state *state, uint8_t *dst, int64_t nbytes,
+                                 int64_t position) {
+  if (position >= state->file_size) {
+    return 0;
+  }
+  if (position + nbytes > state->file_size) {
+    nbytes = state->file_size - position;
+  }
+  int64_t end = position + nbytes;
+  if (position < state->head_size) {
+    int64_t n = (end < state->head_size ? end : state->head_size) - position;
+    memcpy(dst, state->head + position, (size_t) n);
+  }
+  int64_t body_start = position > state->head_size ? position : state->head_size;
+  int64_t body_end = end < state->tail_start ? end : state->tail_start;
+  if (body_start < body_end) {
+    int rc = direct_body_read(state, dst + (body_start - position), body_end - body_start, body_start);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  int64_t tail_position = position > state->tail_start ? position : state->tail_start;
+  if (tail_position < end) {
+    memcpy(dst + (tail_position - position), state->tail + (tail_position - state->tail_start),
+           (size_t) (end - tail_position));
+  }
+  return nbytes;
+}
+
+/* Must be called with the mutex held */
+static int direct_truncate(blosc2_stdio_direct_state *state, int64_t size) {
+  if (size >= state->file_size) {
+    return direct_write_range(state, NULL, 0, size);
+  }
+  if (size <= state->head_size) {
+    // The head beyond the end of the file is always zeroed
+    memset(state->head + size, 0, (size_t) (state->head_size - size));
+    state->head_dirty = true;
+    state->tail_start = state->head_size;
+  }
+  else if (size < state->tail_start) {
+    // The new tail starts in the body
+    int64_t tail_start = direct_align_down(state, size);
+    if (tail_start < size) {
+      int rc = direct_disk_read(state, state->tail, state->alignment, tail_start);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+    state->tail_start = tail_start;
+  }
+  state->file_size = size;
+  state->tail_dirty = true;
+  return 0;
+}
+
+/* Must be called with the mutex held */
+static int direct_flush(blosc2_stdio_direct_state *state) {
+  if (!state->writable) {
+    return 0;
+  }
+  int rc;
+  if (state->head_dirty) {
+    rc = direct_disk_write(state, state->head, state->head_size, 0);
+    if (rc < 0) {
+      return rc;
+    }
+    state->head_dirty = false;
+  }
+  if (state->tail_dirty) {
+    int64_t tail_len = state->file_size - state->tail_start;
+    if (tail_len > 0) {
+      int64_t len = direct_align_up(state, tail_len);
+      memset(state->tail + tail_len, 0, (size_t) (len - tail_len));
+      rc = direct_disk_write(state, state->tail, len, state->tail_start);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+    state->tail_dirty = false;
+  }
+  // The last aligned blocks may have gone beyond the end
+  if (ftruncate(state->fd, (off_t) state->file_size) < 0) {
+    BLOSC_TRACE_ERROR("Cannot truncate %s (error: %s).", state->urlpath, strerror(errno));
+    return BLOSC2_ERROR_FILE_TRUNCATE;
+  }
+  return 0;
+}
+
+static void direct_state_free(blosc2_stdio_direct_state *state) {
+  close(state->fd);
+  free(state->head);
+  free(state->tail);
+  free(state->urlpath);
+  pthread_mutex_destroy(&state->mutex);
+  free(state);
+}
+
+static blosc2_stdio_direct_state *direct_state_new(const char *urlpath, const char *mode,
+                                                   const blosc2_stdio_direct *params) {
+  int64_t alignment = params->alignment;
+  if (alignment <= 0 || (alignment & (alignment - 1)) != 0) {
+    BLOSC_TRACE_ERROR("The alignment of the direct io (%" PRId64 ") must be a power of 2.", alignment);
+    return NULL;
+  }
+  /* Later opens of the file may need to write it */
+  int flags = O_RDWR;
+  if (mode[0] == 'w') {
+    flags |= O_CREAT | O_TRUNC;
+  }
+  else if (mode[0] == 'a') {
+    flags |= O_CREAT;
+  }
+  bool writable = true;
+  int fd = open(urlpath, flags | O_DIRECT, 0666);
+  if (fd < 0 && errno == EINVAL && O_DIRECT != 0) {
+    // The file system does not support O_DIRECT (e.g. tmpfs)
+    fd = open(urlpath, flags, 0666);
+  }
+  if (fd < 0 && (errno == EACCES || errno == EROFS) && mode[0] == 'r' && strchr(mode, '+') == NULL) {
+    fd = open(urlpath, O_RDONLY | O_DIRECT, 0666);
+    if (fd < 0 && errno == EINVAL && O_DIRECT != 0) {
+      fd = open(urlpath, O_RDONLY, 0666);
+    }
+    writable = false;
+  }
+  if (fd < 0) {
+    return NULL;
+  }
+#if defined(__APPLE__)
+  fcntl(fd, F_NOCACHE, 1);
+#endif
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return NULL;
+  }
+
+  blosc2_stdio_direct_state *state = calloc(1, sizeof(blosc2_stdio_direct_state));
+  state->urlpath = strdup(urlpath);
+  state->fd = fd;
+  state->writable = writable;
+  state->alignment = alignment;
+  state->file_size = (int64_t) st.st_size;
+  state->head_size = direct_align_up(state, DIRECT_HEAD_SIZE);
+  int64_t capacity = params->buffer_size > 2 * alignment ? params->buffer_size : 2 * alignment;
+  state->tail_capacity = direct_align_up(state, capacity);
+  pthread_mutex_init(&state->mutex, NULL);
+  if (posix_memalign((void **) &state->head, (size_t) alignment, (size_t) state->head_size) != 0 ||
+      posix_memalign((void **) &state->tail, (size_t) alignment, (size_t) state->tail_capacity) != 0) {
+    direct_state_free(state);
+    return NULL;
+  }
+
+  int rc = direct_disk_read(state, state->head, state->head_size, 0);
+  if (rc == 0 && state->file_size < state->head_size) {
+    memset(state->head + state->file_size, 0, (size_t) (state->head_size - state->file_size));
+  }
+  state->tail_start = direct_align_down(state, state->file_size);
+  if (state->tail_start < state->head_size) {
+    state->tail_start = state->head_size;
+  }
+  if (rc == 0 && state->tail_start < state->file_size) {
+    rc = direct_disk_read(state, state->tail, state->alignment, state->tail_start);
+  }
+  if (rc < 0) {
+    direct_state_free(state);
+    return NULL;
+  }
+  return state;
+}
+
+
+void *blosc2_stdio_direct_open(const char *urlpath, const char *mode, void *params) {
+  blosc2_stdio_direct *direct_file = (blosc2_stdio_direct *) params;
+  if (direct_file == NULL) {
+    BLOSC_TRACE_ERROR("The direct io needs a blosc2_stdio_direct struct as params.");
+    return NULL;
+  }
+
+  blosc2_stdio_direct_state *state = (blosc2_stdio_direct_state *) direct_file->state;
+  if (state == NULL) {
+    state = direct_state_new(urlpath, mode, direct_file);
+    if (state == NULL) {
+      return NULL;
+    }
+    direct_file->state = state;
+  }
+  else if (strcmp(state->urlpath, urlpath) != 0) {
+    BLOSC_TRACE_ERROR("The direct io is already in use for %s (and cannot open %s).  "
+                      "Only contiguous frames are supported.", state->urlpath, urlpath);
+    return NULL;
+  }
+
+  bool write_mode = mode[0] != 'r' || strchr(mode, '+') != NULL;
+  if (write_mode && !state->writable) {
+    BLOSC_TRACE_ERROR("Cannot open %s with mode '%s' because it is read-only.", urlpath, mode);
+    return NULL;
+  }
+
+  blosc2_stdio_direct_file *my_fp = malloc(sizeof(blosc2_stdio_direct_file));
+  my_fp->state = state;
+  my_fp->position = 0;
+  pthread_mutex_lock(&state->mutex);
+  int rc = 0;
+  if (mode[0] == 'w') {
+    rc = direct_truncate(state, 0);
+  }
+  else if (mode[0] == 'a') {
+    my_fp->position = state->file_size;
+  }
+  pthread_mutex_unlock(&state->mutex);
+  if (rc < 0) {
+    free(my_fp);
+    return NULL;
+  }
+  return my_fp;
+}
+
+int blosc2_stdio_direct_close(void *stream) {
+  /* The file and its buffers are kept until blosc2_stdio_direct_destroy() */
+  free(stream);
+  return 0;
+}
+
+int64_t blosc2_stdio_direct_tell(void *stream) {
+  blosc2_stdio_direct_file *my_fp = (blosc2_stdio_direct_file *) stream;
+  return my_fp->position;
+}
+
+int blosc2_stdio_direct_seek(void *stream, int64_t offset, int whence) {
+  blosc2_stdio_direct_file *my_fp = (blosc2_stdio_direct_file *) stream;
+  int64_t position;
+  switch (whence) {
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = my_fp->position + offset;
+      break;
+    case SEEK_END:
+      pthread_mutex_lock(&my_fp->state->mutex);
+      position = my_fp->state->file_size + offset;
+      pthread_mutex_unlock(&my_fp->state->mutex);
+      break;
+    default:
+      return -1;
+  }
+  if (position < 0) {
+    return -1;
+  }
+  my_fp->position = position;
+  return 0;
+}
+
+int64_t blosc2_stdio_direct_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_stdio_direct_file *my_fp = (blosc2_stdio_direct_file *) stream;
+  blosc2_stdio_direct_state *state = my_fp->state;
+  if (!state->writable || size <= 0) {
+    return 0;
+  }
+  int64_t nbytes = size * nitems;
+  pthread_mutex_lock(&state->mutex);
+  int rc = direct_write_range(state, (const uint8_t *) ptr, nbytes, my_fp->position);
+  pthread_mutex_unlock(&state->mutex);
+  if (rc < 0) {
+    return 0;
+  }
+  my_fp->position += nbytes;
+  return nitems;
+}
+
+int64_t blosc2_stdio_direct_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_stdio_direct_file *my_fp = (blosc2_stdio_direct_file *) stream;
+  if (size <= 0) {
+    return 0;
+  }
+  pthread_mutex_lock(&my_fp->state->mutex);
+  int64_t nbytes = direct_read_range(my_fp->state, (uint8_t *) ptr, size * nitems, my_fp->position);
+  pthread_mutex_unlock(&my_fp->state->mutex);
+  if (nbytes < 0) {
+    return 0;
+  }
+  /* A short read at the end of the file, like fread() */
+  nbytes = nbytes / size * size;
+  my_fp->position += nbytes;
+  return nbytes / size;
+}
+
+int blosc2_stdio_direct_truncate(void *stream, int64_t size) {
+  blosc2_stdio_direct_file *my_fp = (blosc2_stdio_direct_file *) stream;
+  blosc2_stdio_direct_state *state = my_fp->state;
+  if (!state->writable || size < 0) {
+    return -1;
+  }
+  pthread_mutex_lock(&state->mutex);
+  int rc = direct_truncate(state, size);
+  pthread_mutex_unlock(&state->mutex);
+  return rc < 0 ? -1 : 0;
+}
+
+int64_t blosc2_stdio_direct_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_direct_file my_fp = *(blosc2_stdio_direct_file *) stream;
+  my_fp.position = position;
+  return blosc2_stdio_direct_read(ptr, size, nitems, &my_fp);
+}
+
+int64_t blosc2_stdio_direct_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_direct_file my_fp = *(blosc2_stdio_direct_file *) stream;
+  my_fp.position = position;
+  return blosc2_stdio_direct_write(ptr, size, nitems, &my_fp);
+}
+
+int blosc2_stdio_direct_flush(blosc2_stdio_direct *direct_file) {
+  BLOSC_ERROR_NULL(direct_file, BLOSC2_ERROR_NULL_POINTER);
+  blosc2_stdio_direct_state *state = (blosc2_stdio_direct_state *) direct_file->state;
+  if (state == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  pthread_mutex_lock(&state->mutex);
+  int rc = direct_flush(state);
+  pthread_mutex_unlock(&state->mutex);
+  return rc;
+}
+
+int blosc2_stdio_direct_destroy(blosc2_stdio_direct *direct_file) {
+  BLOSC_ERROR_NULL(direct_file, BLOSC2_ERROR_NULL_POINTER);
+  blosc2_stdio_direct_state *state = (blosc2_stdio_direct_state *) direct_file->state;
+  if (state == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int rc = direct_flush(state);
+  direct_state_free(state);
+  direct_file->state = NULL;
+  return rc;
+}
+
+#else  /* _WIN32 */
+
+void *blosc2_stdio_direct_open(const char *urlpath, const char *mode, void *params) {
+  BLOSC_UNUSED_PARAM(urlpath);
+  BLOSC_UNUSED_PARAM(mode);
+  BLOSC_UNUSED_PARAM(params);
+  BLOSC_TRACE_ERROR("The direct io is not supported on Windows yet.");
+  return NULL;
+}
+
+int blosc2_stdio_direct_close(void *stream) {
+  BLOSC_UNUSED_PARAM(stream);
+  return -1;
+}
+
+int64_t blosc2_stdio_direct_tell(void *stream) {
+  BLOSC_UNUSED_PARAM(stream);
+  return -1;
+}
+
+int blosc2_stdio_direct_seek(void *stream, int64_t offset, int whence) {
+  BLOSC_UNUSED_PARAM(stream);
+  BLOSC_UNUSED_PARAM(offset);
+  BLOSC_UNUSED_PARAM(whence);
+  return -1;
+}
+
+int64_t blosc2_stdio_direct_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  BLOSC_UNUSED_PARAM(ptr);
+  BLOSC_UNUSED_PARAM(size);
+  BLOSC_UNUSED_PARAM(nitems);
+  BLOSC_UNUSED_PARAM(stream);
+  return 0;
+}
+
+int64_t blosc2_stdio_direct_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  BLOSC_UNUSED_PARAM(ptr);
+  BLOSC_UNUSED_PARAM(size);
+  BLOSC_UNUSED_PARAM(nitems);
+  BLOSC_UNUSED_PARAM(stream);
+  return 0;
+}
+
+int blosc2_stdio_direct_truncate(void *stream, int64_t size) {
+  BLOSC_UNUSED_PARAM(stream);
+  BLOSC_UNUSED_PARAM(size);
+  return -1;
+}
+
+int64_t blosc2_stdio_direct_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  BLOSC_UNUSED_PARAM(position);
+  return blosc2_stdio_direct_read(ptr, size, nitems, stream);
+}
+
+int64_t blosc2_stdio_direct_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  BLOSC_UNUSED_PARAM(position);
+  return blosc2_stdio_direct_write(ptr, size, nitems, stream);
+}
+
+int blosc2_stdio_direct_flush(blosc2_stdio_direct *direct_file) {
+  BLOSC_UNUSED_PARAM(direct_file);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+int blosc2_stdio_direct_destroy(blosc2_stdio_direct *direct_file) {
+  BLOSC_UNUSED_PARAM(direct_file);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+#endif  /* _WIN32 */
+
+
+/* Objects of an object store, read with range requests.  The state lives in the params
+ * of the io (as for memory-mapped files), and keeps the sizes of the objects that have
+ * been opened and a cache of their pages, in LRU order.  The pages that the reads of a
+ * batch miss are gathered in spans, and the ones that are close enough are merged before
+ * they are requested, in parallel. */
+
+#define OBJSTORE_NBUCKETS 4096
+
+typedef struct objstore_object {
+  char *urlpath;
+  int64_t size;
+  struct objstore_object *next;
+} objstore_object;
+
+typedef struct objstore_page {
+  objstore_object *object;
+  int64_t npage;
+  uint8_t *data;
+  int64_t len;
+  struct objstore_page *hnext;  // the next page in its bucket
+  struct objstore_page *prev;   // the page used more recently
+  struct objstore_page *next;   // the page used less recently
+} objstore_page;
+
+typedef struct {
+  blosc2_stdio_objstore *params;
+  objstore_object *objects;
+  objstore_page *buckets[OBJSTORE_NBUCKETS];
+  objstore_page *head;
+  objstore_page *tail;
+  int64_t nbytes;
+  int64_t nrequests;
+  int64_t nbytes_requested;
+  pthread_mutex_t mutex;
+} blosc2_stdio_objstore_state;
+
+typedef struct {
+  blosc2_stdio_objstore_state *state;
+  objstore_object *object;
+  int64_t position;
+} blosc2_stdio_objstore_file;
+
+/* A range of an object to request */
+typedef struct {
+  objstore_object *object;
+  int64_t start;
+  int64_t len;
+  uint8_t *data;
+  int64_t result;
+} objstore_span;
+
+/* A read of `nbytes` (already clamped to the size of the object) at `position` */
+typedef struct {
+  objstore_object *object;
+  uint8_t *dest;
+  int64_t position;
+  int64_t nbytes;
+  bool failed;
+} objstore_read;
+
+
+static objstore_page **objstore_bucket(blosc2_stdio_objstore_state *state, objstore_object *object,
+                                       int64_t npage) {
+  uint64_t h = ((uint64_t) (uintptr_t) object >> 4) * 0x9E3779B97F4A7C15ULL + (uint64_t) npage;
+  return &state->buckets[(h ^ (h >> 29)) % OBJSTORE_NBUCKETS];
+}
+
+static void objstore_unlink(blosc2_stdio_objstore_state *state, objstore_page *page) {
+  if (page->prev != NULL) {
+    page->prev->next = page->next;
+  }
+  else {
+    state->head = page->next;
+  }
+  if (page->next != NULL) {
+    page->next->prev = page->prev;
+  }
+  else {
+    state->tail = page->prev;
+  }
+  page->prev = page->next = NULL;
+}
+
+static void objstore_push_front(blosc2_stdio_objstore_state *state, objstore_page *page) {
+  page->prev = NULL;
+  page->next = state->head;
+  if (state->head != NULL) {
+    state->head->prev = page;
+  }
+  state->head = page;
+  if (state->tail == NULL) {
+    state->tail = page;
+  }
+}
+
+/* The cached page, which becomes the most recently used one (NULL if it is not cached) */
+static objstore_page *objstore_find(blosc2_stdio_objstore_state *state, objstore_object *object,
+                                    int64_t npage) {
+  for (objstore_page *page = *objstore_bucket(state, object, npage); page != NULL; page = page->hnext) {
+    if (page->object == object && page->npage == npage) {
+      if (page != state->head) {
+        objstore_unlink(state, page);
+        objstore_push_front(state, page);
+      }
+      return page;
+    }
+  }
+  return NULL;
+}
+
+static void objstore_evict(blosc2_stdio_objstore_state *state, objstore_page *page) {
+  objstore_page **link = objstore_bucket(state, page->object, page->npage);
+  while (*link != page) {
+    link = &(*link)->hnext;
+  }
+  *link = page->hnext;
+  objstore_unlink(state, page);
+  state->nbytes -= page->len;
+  free(page->data);
+  free(page);
+}
+
+static void objstore_insert(blosc2_stdio_objstore_state *state, objstore_object *object, int64_t npage,
+                            const uint8_t *data, int64_t len) {
+  if (objstore_find(state, object, npage) != NULL) {
+    return;
+  }
+  objstore_page *page = calloc(1, sizeof(objstore_page));
+  if (page == NULL) {
+    return;
+  }
+  page->data = malloc(len);
+  if (page->data == NULL) {
+    free(page);
+    return;
+  }
+  memcpy(page->data, data, len);
+  page->object = object;
+  page->npage = npage;
+  page->len = len;
+  objstore_page **bucket = objstore_bucket(state, object, npage);
+  page->hnext = *bucket;
+  *bucket = page;
+  objstore_push_front(state, page);
+  state->nbytes += len;
+  while (state->nbytes > state->params->cache_size && state->tail != page) {
+    objstore_evict(state, state->tail);
+  }
+}
+
+
+static int objstore_span_cmp(const void *a, const void *b) {
+  const objstore_span *sa = (const objstore_span *) a;
+  const objstore_span *sb = (const objstore_span *) b;
+  if (sa->object != sb->object) {
+    return (uintptr_t) sa->object < (uintptr_t) sb->object ? -1 : 1;
+  }
+  return (sa->start > sb->start) - (sa->start < sb->start);
+}
+
+/* Copy what is cached of the reads to their destinations, and gather the missing pages
+ * in spans, merging the ones that are close.  Called with the mutex held. */
+static int objstore_plan(blosc2_stdio_objstore_state *state, objstore_read *reads, int64_t nreads,
+                         objstore_span **spans_, int64_t *nspans_) {
+  int64_t page_size = state->params->page_size;
+  int64_t nspans = 0;
+  int64_t cap = 16;
+  objstore_span *spans = malloc(cap * sizeof(objstore_span));
+  BLOSC_ERROR_NULL(spans, BLOSC2_ERROR_MEMORY_ALLOC);
+  for (int64_t i = 0; i < nreads; i++) {
+    objstore_read *read = &reads[i];
+    if (read->nbytes <= 0) {
+      continue;
+    }
+    objstore_object *object = read->object;
+    int64_t stop = read->position + read->nbytes;
+    bool extend = false;
+    for (int64_t npage = read->position / page_size; npage * page_size < stop; npage++) {
+      int64_t page_start = npage * page_size;
+      int64_t page_stop = page_start + page_size < object->size ? page_start + page_size : object->size;
+      objstore_page *page = objstore_find(state, object, npage);
+      if (page != NULL) {
+        int64_t start = read->position > page_start ? read->position : page_start;
+        int64_t end = stop < page_stop ? stop : page_stop;
+        memcpy(read->dest + (start - read->position), page->data + (start - page_start), end - start);
+        extend = false;
+        continue;
+      }
+      if (extend) {
+        spans[nspans - 1].len = page_stop - spans[nspans - 1].start;
+        continue;
+      }
+      if (nspans == cap) {
+        cap *= 2;
+        objstore_span *spans2 = realloc(spans, cap * sizeof(objstore_span));
+        if (spans2 == NULL) {
+          free(spans);
+          BLOSC_TRACE_ERROR("Error allocating memory!");
+          return BLOSC2_ERROR_MEMORY_ALLOC;
+        }
+        spans = spans2;
+      }
+      spans[nspans].object = object;
+      spans[nspans].start = page_start;
+      spans[nspans].len = page_stop - page_start;
+      spans[nspans].data = NULL;
+      spans[nspans].result = 0;
+      nspans++;
+      extend = true;
+    }
+  }
+
+  if (nspans > 1) {
+    qsort(spans, nspans, sizeof(objstore_span), objstore_span_cmp);
+    int64_t n = 0;
+    for (int64_t i = 1; i < nspans; i++) {
+      objstore_span *last = &spans[n];
+      if (spans[i].object == last->object && spans[i].start - (last->start + last->len) <= state->params->max_gap) {
+        int64_t end = spans[i].start + spans[i].len;
+        if (end > last->start + last->len) {
+          last->len = end - last->start;
+        }
+      }
+      else {
+        spans[++n] = spans[i];
+      }
+    }
+    nspans = n + 1;
+  }
+
+  *spans_ = spans;
+  *nspans_ = nspans;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* The requests of a batch of spans, which the threads take in turns */
+typedef struct {
+  blosc2_stdio_objstore *params;
+  objstore_span *spans;
+  int64_t nspans;
+  int64_t next;
+  pthread_mutex_t mutex;
+} objstore_job;
+
+static void *objstore_worker(void *arg) {
+  objstore_job *job = (objstore_job *) arg;
+  while (true) {
+    pthread_mutex_lock(&job->mutex);
+    int64_t i = job->next++;
+    pthread_mutex_unlock(&job->mutex);
+    if (i >= job->nspans) {
+      break;
+    }
+    objstore_span *span = &job->spans[i];
+    span->data = malloc(span->len);
+    if (span->data == NULL) {
+      span->result = -1;
+      continue;
+    }
+    span->result = job->params->get(job->params->user_data, span->object->urlpath, span->start, span->len,
+                                    span->data);
+  }
+  return NULL;
+}
+
+static void objstore_fetch(blosc2_stdio_objstore *params, objstore_span *spans, int64_t nspans) {
+  objstore_job job = {.params = params, .spans = spans, .nspans = nspans, .next = 0};
+  pthread_mutex_init(&job.mutex, NULL);
+  int64_t nthreads = params->nthreads < nspans ? params->nthreads : nspans;
+  pthread_t *threads = nthreads > 1 ? malloc((nthreads - 1) * sizeof(pthread_t)) : NULL;
+  int64_t nstarted = 0;
+  if (threads != NULL) {
+    for (; nstarted < nthreads - 1; nstarted++) {
+      if (pthread_create(&threads[nstarted], NULL, objstore_worker, &job) != 0) {
+        // The ones that are running (and this one) will do the rest
+        break;
+      }
+    }
+  }
+  objstore_worker(&job);
+  for (int64_t i = 0; i < nstarted; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  pthread_mutex_destroy(&job.mutex);
+}
+
+/* Do the reads, requesting what is not cached */
+static void objstore_do_reads(blosc2_stdio_objstore_state *state, objstore_read *reads, int64_t nreads) {
+  objstore_span *spans;
+  int64_t nspans;
+  pthread_mutex_lock(&state->mutex);
+  int rc = objstore_plan(state, reads, nreads, &spans, &nspans);
+  pthread_mutex_unlock(&state->mutex);
+  if (rc < 0) {
+    for (int64_t i = 0; i < nreads; i++) {
+      reads[i].failed = true;
+    }
+    return;
+  }
+
+  objstore_fetch(state->params, spans, nspans);
+
+  for (int64_t i = 0; i < nreads; i++) {
+    objstore_read *read = &reads[i];
+    int64_t stop = read->position + read->nbytes;
+    for (int64_t j = 0; j < nspans; j++) {
+      objstore_span *span = &spans[j];
+      int64_t start = read->position > span->start ? read->position : span->start;
+      int64_t end = stop < span->start + span->len ? stop : span->start + span->len;
+      if (span->object != read->object || start >= end) {
+        continue;
+      }
+      if (span->result != span->len) {
+        read->failed = true;
+        continue;
+      }
+      memcpy(read->dest + (start - read->position), span->data + (start - span->start), end - start);
+    }
+  }
+
+  int64_t page_size = state->params->page_size;
+  pthread_mutex_lock(&state->mutex);
+  for (int64_t j = 0; j < nspans; j++) {
+    objstore_span *span = &spans[j];
+    state->nrequests++;
+    if (span->result > 0) {
+      state->nbytes_requested += span->result;
+    }
+    if (span->result == span->len) {
+      for (int64_t offset = 0; offset < span->len; offset += page_size) {
+        int64_t len = span->len - offset < page_size ? span->len - offset : page_size;
+        objstore_insert(state, span->object, (span->start + offset) / page_size, span->data + offset, len);
+      }
+    }
+    free(span->data);
+  }
+  pthread_mutex_unlock(&state->mutex);
+  free(spans);
+}
+
+static void objstore_set_read(objstore_read *read, blosc2_stdio_objstore_file *my_fp, void *ptr, int64_t nbytes,
+                              int64_t position) {
+  objstore_object *object = my_fp->object;
+  read->object = object;
+  read->dest = (uint8_t *) ptr;
+  read->position = position;
+  read->nbytes = position >= object->size ? 0 : (nbytes < object->size - position ? nbytes : object->size - position);
+  read->failed = false;
+}
+
+
+static void objstore_state_free(blosc2_stdio_objstore_state *state) {
+  while (state->tail != NULL) {
+    objstore_evict(state, state->tail);
+  }
+  objstore_object *object = state->objects;
+  while (object != NULL) {
+    objstore_object *next = object->next;
+    free(object->urlpath);
+    free(object);
+    object = next;
+  }
+  pthread_mutex_destroy(&state->mutex);
+  free(state);
+}
+
+/* The object (with its size) at urlpath, or NULL if it does not exist */
+static objstore_object *objstore_get_object(blosc2_stdio_objstore_state *state, const char *urlpath) {
+  pthread_mutex_lock(&state->mutex);
+  for (objstore_object *object = state->objects; object != NULL; object = object->next) {
+    if (strcmp(object->urlpath, urlpath) == 0) {
+      pthread_mutex_unlock(&state->mutex);
+      return object;
+    }
+  }
+  pthread_mutex_unlock(&state->mutex);
+
+  blosc2_stdio_objstore *params = state->params;
+  int64_t size = params->size(params->user_data, urlpath);
+  pthread_mutex_lock(&state->mutex);
+  state->nrequests++;
+  objstore_object *object = NULL;
+  if (size >= 0) {
+    object = calloc(1, sizeof(objstore_object));
+    if (object != NULL) {
+      object->urlpath = malloc(strlen(urlpath) + 1);
+      strcpy(object->urlpath, urlpath);
+      object->size = size;
+      object->next = state->objects;
+      state->objects = object;
+    }
+  }
+  pthread_mutex_unlock(&state->mutex);
+  return object;
+}
+
+
+void *blosc2_stdio_objstore_open(const char *urlpath, const char *mode, void *params) {
+  blosc2_stdio_objstore *objstore = (blosc2_stdio_objstore *) params;
+  if (objstore == NULL || objstore->get == NULL || objstore->size == NULL) {
+    BLOSC_TRACE_ERROR("The object store io needs a blosc2_stdio_objstore struct (with the get and "
+                      "size callbacks) as params.");
+    return NULL;
+  }
+  if (mode[0] != 'r' || strchr(mode, '+') != NULL) {
+    BLOSC_TRACE_ERROR("Cannot open %s with mode '%s' because objects are read-only.", urlpath, mode);
+    return NULL;
+  }
+
+  blosc2_stdio_objstore_state *state = (blosc2_stdio_objstore_state *) objstore->state;
+  if (state == NULL) {
+    if (objstore->page_size <= 0 || objstore->cache_size < 0 || objstore->nthreads < 1) {
+      BLOSC_TRACE_ERROR("The page size and the number of threads of the object store io must be positive.");
+      return NULL;
+    }
+    state = calloc(1, sizeof(blosc2_stdio_objstore_state));
+    BLOSC_ERROR_NULL(state, NULL);
+    state->params = objstore;
+    pthread_mutex_init(&state->mutex, NULL);
+    objstore->state = state;
+  }
+
+  objstore_object *object = objstore_get_object(state, urlpath);
+  if (object == NULL) {
+    // The frames look for the index of sparse frames this way, so do not trace
+    return NULL;
+  }
+  blosc2_stdio_objstore_file *my_fp = malloc(sizeof(blosc2_stdio_objstore_file));
+  BLOSC_ERROR_NULL(my_fp, NULL);
+  my_fp->state = state;
+  my_fp->object = object;
+  my_fp->position = 0;
+  return my_fp;
+}
+
+int blosc2_stdio_objstore_close(void *stream) {
+  /* The sizes of the objects and their pages are kept until blosc2_stdio_objstore_destroy() */
+  free(stream);
+  return 0;
+}
+
+int64_t blosc2_stdio_objstore_tell(void *stream) {
+  blosc2_stdio_objstore_file *my_fp = (blosc2_stdio_objstore_file *) stream;
+  return my_fp->position;
+}
+
+int blosc2_stdio_objstore_seek(void *stream, int64_t offset, int whence) {
+  blosc2_stdio_objstore_file *my_fp = (blosc2_stdio_objstore_file *) stream;
+  int64_t position;
+  switch (whence) {
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = my_fp->position + offset;
+      break;
+    case SEEK_END:
+      position = my_fp->object->size + offset;
+      break;
+    default:
+      return -1;
+  }
+  if (position < 0) {
+    return -1;
+  }
+  my_fp->position = position;
+  return 0;
+}
+
+int64_t blosc2_stdio_objstore_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  BLOSC_UNUSED_PARAM(ptr);
+  BLOSC_UNUSED_PARAM(size);
+  BLOSC_UNUSED_PARAM(nitems);
+  BLOSC_UNUSED_PARAM(stream);
+  return 0;
+}
+
+int64_t blosc2_stdio_objstore_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  blosc2_stdio_objstore_file *my_fp = (blosc2_stdio_objstore_file *) stream;
+  int64_t nread = blosc2_stdio_objstore_pread(ptr, size, nitems, my_fp->position, stream);
+  my_fp->position += nread * size;
+  return nread;
+}
+
+int blosc2_stdio_objstore_truncate(void *stream, int64_t size) {
+  BLOSC_UNUSED_PARAM(stream);
+  BLOSC_UNUSED_PARAM(size);
+  return -1;
+}
+
+int64_t blosc2_stdio_objstore_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  blosc2_stdio_objstore_file *my_fp = (blosc2_stdio_objstore_file *) stream;
+  if (size <= 0 || position < 0) {
+    return 0;
+  }
+  objstore_read read;
+  objstore_set_read(&read, my_fp, ptr, size * nitems, position);
+  objstore_do_reads(my_fp->state, &read, 1);
+  if (read.failed) {
+    return 0;
+  }
+  /* A short read at the end of the object, like fread() */
+  return read.nbytes / size;
+}
+
+int64_t blosc2_stdio_objstore_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                     void *stream) {
+  BLOSC_UNUSED_PARAM(position);
+  return blosc2_stdio_objstore_write(ptr, size, nitems, stream);
+}
+
+/* The missing pages of all the ranges are requested together */
+int64_t blosc2_stdio_objstore_preadv(const blosc2_io_vec *vecs, int64_t nvecs, void *stream) {
+  blosc2_stdio_objstore_file *my_fp = (blosc2_stdio_objstore_file *) stream;
+  objstore_read *reads = malloc(nvecs * sizeof(objstore_read));
+  BLOSC_ERROR_NULL(reads, BLOSC2_ERROR_MEMORY_ALLOC);
+  for (int64_t i = 0; i < nvecs; i++) {
+    if (vecs[i].position < 0) {
+      free(reads);
+      return -1;
+    }
+    objstore_set_read(&reads[i], my_fp, vecs[i].ptr, vecs[i].size, vecs[i].position);
+  }
+  objstore_do_reads(my_fp->state, reads, nvecs);
+  int64_t rbytes = 0;
+  for (int64_t i = 0; i < nvecs; i++) {
+    if (reads[i].failed) {
+      rbytes = -1;
+      break;
+    }
+    rbytes += reads[i].nbytes;
+  }
+  free(reads);
+  return rbytes;
+}
+
+int blosc2_stdio_objstore_pread_batch(blosc2_io_request *requests, int64_t nrequests, blosc2_io_done_cb done) {
+  if (nrequests <= 0) {
+    return 0;
+  }
+  objstore_read *reads = malloc(nrequests * sizeof(objstore_read));
+  BLOSC_ERROR_NULL(reads, BLOSC2_ERROR_MEMORY_ALLOC);
+  blosc2_stdio_objstore_state *state = ((blosc2_stdio_objstore_file *) requests[0].stream)->state;
+  for (int64_t i = 0; i < nrequests; i++) {
+    blosc2_stdio_objstore_file *my_fp = (blosc2_stdio_objstore_file *) requests[i].stream;
+    objstore_set_read(&reads[i], my_fp, requests[i].ptr, requests[i].size, requests[i].position);
+    if (my_fp->state != state || requests[i].position < 0) {
+      // Only the objects of the same store can be requested together
+      reads[i].nbytes = 0;
+      reads[i].failed = true;
+    }
+  }
+  objstore_do_reads(state, reads, nrequests);
+
+  int rc = 0;
+  for (int64_t i = 0; i < nrequests; i++) {
+    requests[i].result = reads[i].failed ? -1 : reads[i].nbytes;
+    if (reads[i].failed) {
+      rc = -1;
+    }
+    done(&requests[i]);
+  }
+  free(reads);
+  return rc;
+}
+
+int blosc2_stdio_objstore_get_stats(blosc2_stdio_objstore *objstore, int64_t *nrequests, int64_t *nbytes) {
+  BLOSC_ERROR_NULL(objstore, BLOSC2_ERROR_NULL_POINTER);
+  blosc2_stdio_objstore_state *state = (blosc2_stdio_objstore_state *) objstore->state;
+  int64_t nrequests_ = 0;
+  int64_t nbytes_ = 0;
+  if (state != NULL) {
+    pthread_mutex_lock(&state->mutex);
+    nrequests_ = state->nrequests;
+    nbytes_ = state->nbytes_requested;
+    pthread_mutex_unlock(&state->mutex);
+  }
+  if (nrequests != NULL) {
+    *nrequests = nrequests_;
+  }
+  if (nbytes != NULL) {
+    *nbytes = nbytes_;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+int blosc2_stdio_objstore_destroy(blosc2_stdio_objstore *objstore) {
+  BLOSC_ERROR_NULL(objstore, BLOSC2_ERROR_NULL_POINTER);
+  blosc2_stdio_objstore_state *state = (blosc2_stdio_objstore_state *) objstore->state;
+  if (state == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  objstore_state_free(state);
+  objstore->state = NULL;
+  return BLOSC2_ERROR_SUCCESS;
+}
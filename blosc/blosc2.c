@@ -12,22 +12,37 @@
 #include "blosc2.h"
 #include "blosc-private.h"
 #include "../plugins/codecs/zfp/blosc2-zfp.h"
+#include "../plugins/codecs/bitpack/bitpack.h"
 #include "frame.h"
+#include "sframe.h"
 
 #if defined(USING_CMAKE)
   #include "config.h"
 #endif /*  USING_CMAKE */
 #include "context.h"
+#include "blosc-atomic.h"
 
 #include "shuffle.h"
 #include "delta.h"
 #include "trunc-prec.h"
 #include "blosclz.h"
+#include "fastcopy.h"
 #include "stune.h"
+#include "zonemap.h"
+#include "checksum.h"
+#include "cipher.h"
+#include "threadpool.h"
 #include "blosc2/codecs-registry.h"
 #include "blosc2/filters-registry.h"
 #include "blosc2/tuners-registry.h"
+#ifdef HAVE_CUDA
+  #include "blosc2-cuda.h"
+#endif
 
+#if defined(HAVE_INTERNAL_LZ4)
+/* The internal sources are linked in, so their static API (state resets) is available */
+#define LZ4_STATIC_LINKING_ONLY
+#endif
 #include "lz4.h"
 #include "lz4hc.h"
 #ifdef HAVE_IPP
@@ -57,6 +72,18 @@
   #define getpid _getpid
 #endif  /* _WIN32 */
 
+#if defined(__linux__)
+  #include <sys/mman.h>
+#endif
+
+#if defined(__AVX2__)
+  #include <immintrin.h>
+#elif defined(__SSE2__)
+  #include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+#endif
+
 #if defined(_WIN32) && !defined(__GNUC__)
   #include "win32/pthread.c"
 #endif
@@ -72,9 +99,14 @@
 
 /* Synchronization variables */
 
-/* Global context for non-contextual API */
-static blosc2_context* g_global_context;
-static pthread_mutex_t global_comp_mutex;
+/* The implicit contexts of the non-contextual API, one per calling thread, so that
+ * threads do not wait for each other.  The key is never deleted, so that the contexts
+ * of the threads are released when they exit, also after blosc2_destroy(). */
+static pthread_key_t g_implicit_context_key;
+static bool g_implicit_context_key_created = false;
+/* The workers that the implicit contexts share, started on their first parallel call */
+static void *g_implicit_pool = NULL;
+static pthread_mutex_t g_implicit_pool_mutex;
 static int g_compressor = BLOSC_BLOSCLZ;
 static int g_delta = 0;
 /* The default splitmode */
@@ -85,17 +117,34 @@ static int32_t g_force_blocksize = 0;
 static int g_initlib = 0;
 static blosc2_schunk* g_schunk = NULL;   /* the pointer to super-chunk */
 
+/* The environment variables (see blosc_env_var), as read by blosc2_init() or
+ * blosc2_reload_env(), so that the calls do not look them up every time */
+static const char* const g_env_names[BLOSC_ENV_NVARS] = {
+  "BLOSC_CLEVEL", "BLOSC_SHUFFLE", "BLOSC_DELTA", "BLOSC_TYPESIZE", "BLOSC_COMPRESSOR",
+  "BLOSC_BLOCKSIZE", "BLOSC_NTHREADS", "BLOSC_NTHREADS_AFFINITY", "BLOSC_SPLITMODE",
+  "BLOSC_NOLOCK", "BLOSC_BLOSC1_COMPAT", "BLOSC_HUGEPAGES", "BTUNE_TRADEOFF",
+  "BLOSC_PLUGIN_PATH", "BLOSC_PARALLEL_THRESHOLD",
+};
+static char* g_env_values[BLOSC_ENV_NVARS] = {0};
+
 blosc2_codec g_codecs[256] = {0};
 uint8_t g_ncodecs = 0;
+/* The partial decoders of the registered codecs (same order as g_codecs) */
+static blosc2_codec_getitems_cb g_codecs_getitems[256] = {0};
 
 static blosc2_filter g_filters[256] = {0};
 static uint64_t g_nfilters = 0;
 
 static blosc2_io_cb g_ios[256] = {0};
 static uint64_t g_nio = 0;
+/* The optional callbacks of the registered ios (indexed by their id) */
+static blosc2_io_cb_ext g_ios_ext[256] = {0};
 
 blosc2_tuner g_tuners[256] = {0};
 int g_ntuners = 0;
+/* The callbacks keeping the state of the registered tuners (same order as g_tuners) */
+static blosc2_tuner_serialize_cb g_tuners_serialize[256] = {0};
+static blosc2_tuner_deserialize_cb g_tuners_deserialize[256] = {0};
 
 static int g_tuner = BLOSC_STUNE;
 
@@ -103,61 +152,6 @@ static int g_tuner = BLOSC_STUNE;
 int init_threadpool(blosc2_context *context);
 int release_threadpool(blosc2_context *context);
 
-/* Macros for synchronization */
-
-/* Wait until all threads are initialized */
-#ifdef BLOSC_POSIX_BARRIERS
-#define WAIT_INIT(RET_VAL, CONTEXT_PTR)                                \
-  do {                                                                 \
-    rc = pthread_barrier_wait(&(CONTEXT_PTR)->barr_init);              \
-    if (rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD) {              \
-      BLOSC_TRACE_ERROR("Could not wait on barrier (init): %d", rc);   \
-      return((RET_VAL));                                               \
-    }                                                                  \
-  } while (0)
-#else
-#define WAIT_INIT(RET_VAL, CONTEXT_PTR)                                \
-  do {                                                                 \
-    pthread_mutex_lock(&(CONTEXT_PTR)->count_threads_mutex);           \
-    if ((CONTEXT_PTR)->count_threads < (CONTEXT_PTR)->nthreads) {      \
-      (CONTEXT_PTR)->count_threads++;                                  \
-      pthread_cond_wait(&(CONTEXT_PTR)->count_threads_cv,              \
-                        &(CONTEXT_PTR)->count_threads_mutex);          \
-    }                                                                  \
-    else {                                                             \
-      pthread_cond_broadcast(&(CONTEXT_PTR)->count_threads_cv);        \
-    }                                                                  \
-    pthread_mutex_unlock(&(CONTEXT_PTR)->count_threads_mutex);         \
-  } while (0)
-#endif
-
-/* Wait for all threads to finish */
-#ifdef BLOSC_POSIX_BARRIERS
-#define WAIT_FINISH(RET_VAL, CONTEXT_PTR)                              \
-  do {                                                                 \
-    rc = pthread_barrier_wait(&(CONTEXT_PTR)->barr_finish);            \
-    if (rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD) {              \
-      BLOSC_TRACE_ERROR("Could not wait on barrier (finish)");         \
-      return((RET_VAL));                                               \
-    }                                                                  \
-  } while (0)
-#else
-#define WAIT_FINISH(RET_VAL, CONTEXT_PTR)                              \
-  do {                                                                 \
-    pthread_mutex_lock(&(CONTEXT_PTR)->count_threads_mutex);           \
-    if ((CONTEXT_PTR)->count_threads > 0) {                            \
-      (CONTEXT_PTR)->count_threads--;                                  \
-      pthread_cond_wait(&(CONTEXT_PTR)->count_threads_cv,              \
-                        &(CONTEXT_PTR)->count_threads_mutex);          \
-    }                                                                  \
-    else {                                                             \
-      pthread_cond_broadcast(&(CONTEXT_PTR)->count_threads_cv);        \
-    }                                                                  \
-    pthread_mutex_unlock(&(CONTEXT_PTR)->count_threads_mutex);         \
-  } while (0)
-#endif
-
-
 /* global variable to change threading backend from Blosc-managed to caller-managed */
 static blosc_threads_callback threads_callback = 0;
 static void *threads_callback_data = 0;
@@ -172,33 +166,80 @@ void blosc2_set_threads_callback(blosc_threads_callback callback, void *callback
 }
 
 
+/* Whether the jobs of a context run elsewhere than in threads of its own, which need
+   the data of the threads (thread_contexts) at hand */
+static bool use_thread_contexts(blosc2_context* context) {
+  return context->task_scheduler.submit != NULL || threads_callback != NULL || blosc_pool_nthreads() > 0 ||
+         blosc_native_scheduler() != NULL || context->implicit;
+}
+
+
+/* The pool of workers of the implicit contexts, as many as the other cores (the calling
+ * threads run jobs too).  NULL if it cannot be started, and then the jobs run serially. */
+static void *get_implicit_pool(void) {
+  pthread_mutex_lock(&g_implicit_pool_mutex);
+  if (g_implicit_pool == NULL) {
+    int ncores = blosc_stune_cpu_info()->ncores;
+    int16_t nworkers = (int16_t) (ncores > 1 ? ncores - 1 : 1);
+    if (blosc_pool_new(nworkers, &g_implicit_pool) < 0) {
+      BLOSC_TRACE_ERROR("Error while starting the workers of the implicit contexts");
+    }
+  }
+  void *pool = g_implicit_pool;
+  pthread_mutex_unlock(&g_implicit_pool_mutex);
+  return pool;
+}
+
+
+/* non-threadsafe function for creating (nthreads > 0) or destroying (nthreads == 0)
+   the process-wide pool of threads */
+int blosc2_set_shared_threadpool(int16_t nthreads)
+{
+  if (nthreads < 0) {
+    BLOSC_TRACE_ERROR("nthreads cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (nthreads == 0) {
+    blosc_pool_destroy();
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  return blosc_pool_create(nthreads);
+}
+
+
+int16_t blosc2_get_shared_threadpool(void)
+{
+  return blosc_pool_nthreads();
+}
+
+
 /* A function for aligned malloc that is portable */
-static uint8_t* my_malloc(size_t size) {
+static void* default_malloc(size_t size, size_t alignment, void* params) {
+  BLOSC_UNUSED_PARAM(params);
   void* block = NULL;
   int res = 0;
 
-/* Do an alignment to 32 bytes because AVX2 is supported */
 #if defined(_WIN32)
   /* A (void *) cast needed for avoiding a warning with MINGW :-/ */
-  block = (void *)_aligned_malloc(size, 32);
+  block = (void *)_aligned_malloc(size, alignment);
 #elif _POSIX_C_SOURCE >= 200112L || _XOPEN_SOURCE >= 600
   /* Platform does have an implementation of posix_memalign */
-  res = posix_memalign(&block, 32, size);
+  res = posix_memalign(&block, alignment, size);
 #else
+  BLOSC_UNUSED_PARAM(alignment);
   block = malloc(size);
 #endif  /* _WIN32 */
 
-  if (block == NULL || res != 0) {
-    BLOSC_TRACE_ERROR("Error allocating memory!");
+  if (res != 0) {
     return NULL;
   }
-
-  return (uint8_t*)block;
+  return block;
 }
 
 
-/* Release memory booked by my_malloc */
-static void my_free(void* block) {
+/* Release memory booked by default_malloc */
+static void default_free(void* block, void* params) {
+  BLOSC_UNUSED_PARAM(params);
 #if defined(_WIN32)
   _aligned_free(block);
 #else
@@ -207,6 +248,534 @@ static void my_free(void* block) {
 }
 
 
+static blosc2_allocator g_allocator = {default_malloc, default_free, NULL};
+
+int blosc2_set_allocator(const blosc2_allocator* allocator) {
+  if (allocator == NULL) {
+    g_allocator.malloc = default_malloc;
+    g_allocator.free = default_free;
+    g_allocator.params = NULL;
+    return 0;
+  }
+  if (allocator->malloc == NULL || allocator->free == NULL) {
+    BLOSC_TRACE_ERROR("The allocator needs both a malloc and a free function.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  g_allocator = *allocator;
+  return 0;
+}
+
+
+/* Allocate memory with an allocator (the global one if its functions are not set) */
+static uint8_t* my_malloc(const blosc2_allocator* allocator, size_t size) {
+  if (allocator == NULL || allocator->malloc == NULL) {
+    allocator = &g_allocator;
+  }
+  /* Do an alignment to 32 bytes because AVX2 is supported */
+  void* block = allocator->malloc(size, 32, allocator->params);
+  if (block == NULL) {
+    BLOSC_TRACE_ERROR("Error allocating memory!");
+    return NULL;
+  }
+  return (uint8_t*)block;
+}
+
+
+/* Release memory booked by my_malloc with the same allocator */
+static void my_free(const blosc2_allocator* allocator, void* block) {
+  if (block == NULL) {
+    return;
+  }
+  if (allocator == NULL || allocator->free == NULL) {
+    allocator = &g_allocator;
+  }
+  allocator->free(block, allocator->params);
+}
+
+
+void* ctx_malloc(blosc2_context* context, size_t size) {
+  return my_malloc(context != NULL ? &context->allocator : NULL, size);
+}
+
+
+void ctx_free(blosc2_context* context, void* block) {
+  my_free(context != NULL ? &context->allocator : NULL, block);
+}
+
+
+/* Huge pages for the large scratch blocks and in-memory frames (Linux only), so that
+ * walking over blocks of several MB, or frames of many GB, does not thrash the TLB.
+ * The BLOSC_HUGEPAGES environment variable selects the mode at the first blosc2_init():
+ * "1" (or "transparent") asks for transparent huge pages with MADV_HUGEPAGE, and
+ * "explicit" maps the scratch blocks from the reserved huge pages (MAP_HUGETLB),
+ * falling back to transparent ones when there are none left.  Frames are always
+ * malloc()ed (they can be handed over to the user), so they only use transparent ones. */
+
+#define HUGEPAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+enum {
+  HUGEPAGES_OFF = 0,
+  HUGEPAGES_TRANSPARENT = 1,
+  HUGEPAGES_EXPLICIT = 2,
+};
+
+static void free_env(void) {
+  for (int i = 0; i < BLOSC_ENV_NVARS; i++) {
+    free(g_env_values[i]);
+    g_env_values[i] = NULL;
+  }
+}
+
+void blosc2_reload_env(void) {
+  free_env();
+  for (int i = 0; i < BLOSC_ENV_NVARS; i++) {
+    const char* value = getenv(g_env_names[i]);
+    if (value != NULL) {
+      size_t len = strlen(value) + 1;
+      g_env_values[i] = malloc(len);
+      if (g_env_values[i] != NULL) {
+        memcpy(g_env_values[i], value, len);
+      }
+    }
+  }
+}
+
+const char* blosc_getenv(blosc_env_var var) {
+  // The contexts can be created with no blosc2_init()
+  if (!g_initlib) {
+    return getenv(g_env_names[var]);
+  }
+  return g_env_values[var];
+}
+
+
+static int g_hugepages = -1;  /* not read from the environment yet */
+
+static void hugepages_init(void) {
+  if (g_hugepages >= 0) {
+    return;
+  }
+  g_hugepages = HUGEPAGES_OFF;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  const char* envvar = blosc_getenv(BLOSC_ENV_HUGEPAGES);
+  if (envvar == NULL || strcmp(envvar, "0") == 0) {
+    return;
+  }
+  if (strcmp(envvar, "explicit") == 0) {
+    g_hugepages = HUGEPAGES_EXPLICIT;
+  }
+  else if (strcmp(envvar, "1") == 0 || strcmp(envvar, "transparent") == 0) {
+    g_hugepages = HUGEPAGES_TRANSPARENT;
+  }
+  else {
+    BLOSC_TRACE_WARNING("Unknown BLOSC_HUGEPAGES mode '%s'; huge pages are not used.", envvar);
+  }
+#endif
+}
+
+
+void hugepages_advise(void* ptr, size_t size) {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (g_hugepages <= HUGEPAGES_OFF || ptr == NULL || size < HUGEPAGE_SIZE) {
+    return;
+  }
+  /* Only the huge pages that are fully inside of the buffer can be advised */
+  uintptr_t start = ((uintptr_t)ptr + HUGEPAGE_SIZE - 1) & ~(uintptr_t)(HUGEPAGE_SIZE - 1);
+  uintptr_t stop = ((uintptr_t)ptr + size) & ~(uintptr_t)(HUGEPAGE_SIZE - 1);
+  if (stop > start) {
+    madvise((void*)start, stop - start, MADV_HUGEPAGE);
+  }
+#else
+  BLOSC_UNUSED_PARAM(ptr);
+  BLOSC_UNUSED_PARAM(size);
+#endif
+}
+
+
+/* Whether the (scratch) buffers of `size` bytes are backed by huge pages */
+static bool hugepages_use(size_t size) {
+  return g_hugepages > HUGEPAGES_OFF && size >= HUGEPAGE_SIZE;
+}
+
+/* Allocate a buffer backed by huge pages.  Release it with hugepages_free(). */
+static uint8_t* hugepages_malloc(size_t size) {
+  void* block = NULL;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  size_t nbytes = (size + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+  if (g_hugepages == HUGEPAGES_EXPLICIT) {
+    block = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (block != MAP_FAILED) {
+      return block;
+    }
+    /* No reserved huge pages (left), so go with transparent ones */
+    block = mmap(NULL, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED) {
+      BLOSC_TRACE_ERROR("Error allocating memory!");
+      return NULL;
+    }
+  }
+  else {
+    block = default_malloc(nbytes, HUGEPAGE_SIZE, NULL);
+  }
+  hugepages_advise(block, nbytes);
+#else
+  BLOSC_UNUSED_PARAM(size);
+#endif
+  return block;
+}
+
+static void hugepages_free(void* block, size_t size) {
+  if (block == NULL) {
+    return;
+  }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (g_hugepages == HUGEPAGES_EXPLICIT) {
+    munmap(block, (size + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1));
+    return;
+  }
+#endif
+  BLOSC_UNUSED_PARAM(size);
+  default_free(block, NULL);
+}
+
+
+/* Process-wide pool of the scratch blocks of the thread contexts and of the ZSTD
+ * contexts.  Setting up a new (de-)compression context used to allocate these from
+ * scratch, which dominates the latency of short-lived contexts; now they are checked
+ * out of the pool and returned to it when the context is released.  Scratch blocks
+ * are pooled by blocksize class (powers of two), and only for the contexts using the
+ * default allocator, as the memory of other allocators must not outlive them. */
+
+#define SCRATCH_MIN_CLASS 12   /* 4 KB blocks */
+#define SCRATCH_MAX_CLASS 24   /* 16 MB blocks; larger ones are never pooled */
+#define SCRATCH_POOL_DEPTH 16  /* per blocksize class */
+#define SCRATCH_POOL_MAXBYTES (256 * 1024 * 1024)
+#define ZSTD_POOL_DEPTH 16
+
+static pthread_mutex_t g_scratch_mutex;
+static bool g_scratch_initialized = false;
+static uint8_t* g_scratch_blocks[SCRATCH_MAX_CLASS + 1][SCRATCH_POOL_DEPTH];
+static int g_scratch_nblocks[SCRATCH_MAX_CLASS + 1];
+static size_t g_scratch_nbytes = 0;
+#if defined(HAVE_ZSTD)
+static ZSTD_CCtx* g_zstd_cctxs[ZSTD_POOL_DEPTH];
+static int g_zstd_ncctxs = 0;
+static ZSTD_DCtx* g_zstd_dctxs[ZSTD_POOL_DEPTH];
+static int g_zstd_ndctxs = 0;
+#endif
+
+
+/* The scratch bytes for the blocks of a blocksize class (of any typesize) */
+static size_t scratch_class_nbytes(int sclass) {
+  return (size_t)4 * (((size_t)1 << sclass) + BLOSC_MAX_TYPESIZE * sizeof(int32_t));
+}
+
+static uint8_t* scratch_malloc(int sclass) {
+  size_t nbytes = scratch_class_nbytes(sclass);
+  if (hugepages_use(nbytes)) {
+    return hugepages_malloc(nbytes);
+  }
+  return default_malloc(nbytes, 32, NULL);
+}
+
+static void scratch_free(int sclass, uint8_t* block) {
+  size_t nbytes = scratch_class_nbytes(sclass);
+  if (hugepages_use(nbytes)) {
+    hugepages_free(block, nbytes);
+    return;
+  }
+  default_free(block, NULL);
+}
+
+
+/* Free the pooled blocks and ZSTD contexts (the largest blocks first) until `nbytes` more
+ * fit in the memory budget, or all of them when `nbytes` is negative.  Must be called
+ * with the mutex held. */
+static void scratch_pool_trim(int64_t nbytes) {
+  for (int sclass = SCRATCH_MAX_CLASS; sclass >= SCRATCH_MIN_CLASS; sclass--) {
+    while (g_scratch_nblocks[sclass] > 0 && (nbytes < 0 || !membudget_fits(nbytes))) {
+      scratch_free(sclass, g_scratch_blocks[sclass][--g_scratch_nblocks[sclass]]);
+      g_scratch_nbytes -= scratch_class_nbytes(sclass);
+      membudget_release((int64_t)scratch_class_nbytes(sclass));
+    }
+  }
+#if defined(HAVE_ZSTD)
+  while (g_zstd_ncctxs > 0 && (nbytes < 0 || !membudget_fits(nbytes))) {
+    ZSTD_CCtx* cctx = g_zstd_cctxs[--g_zstd_ncctxs];
+    membudget_release((int64_t)ZSTD_sizeof_CCtx(cctx));
+    ZSTD_freeCCtx(cctx);
+  }
+  while (g_zstd_ndctxs > 0 && (nbytes < 0 || !membudget_fits(nbytes))) {
+    ZSTD_DCtx* dctx = g_zstd_dctxs[--g_zstd_ndctxs];
+    membudget_release((int64_t)ZSTD_sizeof_DCtx(dctx));
+    ZSTD_freeDCtx(dctx);
+  }
+#endif
+}
+
+/* Free all the pooled blocks and ZSTD contexts.  Must be called with the mutex held. */
+static void scratch_pool_clear(void) {
+  scratch_pool_trim(-1);
+}
+
+static void scratch_pool_init(void) {
+  pthread_mutex_init(&g_scratch_mutex, NULL);
+  g_scratch_initialized = true;
+}
+
+static void scratch_pool_destroy(void) {
+  if (!g_scratch_initialized) {
+    return;
+  }
+  pthread_mutex_lock(&g_scratch_mutex);
+  scratch_pool_clear();
+  g_scratch_initialized = false;
+  pthread_mutex_unlock(&g_scratch_mutex);
+  pthread_mutex_destroy(&g_scratch_mutex);
+}
+
+
+/* Check a scratch block of a blocksize class out of the pool (a new one if empty) */
+static uint8_t* scratch_get(int sclass) {
+  uint8_t* block = NULL;
+  pthread_mutex_lock(&g_scratch_mutex);
+  if (g_scratch_nblocks[sclass] > 0) {
+    block = g_scratch_blocks[sclass][--g_scratch_nblocks[sclass]];
+    g_scratch_nbytes -= scratch_class_nbytes(sclass);
+  }
+  pthread_mutex_unlock(&g_scratch_mutex);
+  if (block == NULL) {
+    block = scratch_malloc(sclass);
+    if (block != NULL) {
+      // The blocks at work cannot be given up, so they are charged no matter the budget
+      membudget_force((int64_t)scratch_class_nbytes(sclass));
+    }
+  }
+  return block;
+}
+
+/* Return a scratch block to the pool (or free it if the pool is full or gone) */
+static void scratch_put(int sclass, uint8_t* block) {
+  if (block == NULL) {
+    return;
+  }
+  if (g_scratch_initialized) {
+    pthread_mutex_lock(&g_scratch_mutex);
+    size_t nbytes = scratch_class_nbytes(sclass);
+    if (g_scratch_nblocks[sclass] < SCRATCH_POOL_DEPTH && g_scratch_nbytes + nbytes <= SCRATCH_POOL_MAXBYTES &&
+        membudget_fits(0)) {
+      g_scratch_blocks[sclass][g_scratch_nblocks[sclass]++] = block;
+      g_scratch_nbytes += nbytes;
+      block = NULL;
+    }
+    pthread_mutex_unlock(&g_scratch_mutex);
+  }
+  if (block != NULL) {
+    scratch_free(sclass, block);
+    membudget_release((int64_t)scratch_class_nbytes(sclass));
+  }
+}
+
+#if defined(HAVE_ZSTD)
+static ZSTD_CCtx* zstd_cctx_get(void) {
+  ZSTD_CCtx* cctx = NULL;
+  if (g_scratch_initialized) {
+    pthread_mutex_lock(&g_scratch_mutex);
+    if (g_zstd_ncctxs > 0) {
+      cctx = g_zstd_cctxs[--g_zstd_ncctxs];
+    }
+    pthread_mutex_unlock(&g_scratch_mutex);
+  }
+  if (cctx != NULL) {
+    membudget_release((int64_t)ZSTD_sizeof_CCtx(cctx));
+    return cctx;
+  }
+  return ZSTD_createCCtx();
+}
+
+/* The (idle) pooled ZSTD contexts are charged to the memory budget, and freed if they do not fit */
+static void zstd_cctx_put(ZSTD_CCtx* cctx) {
+  if (g_scratch_initialized) {
+    ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+    int64_t nbytes = (int64_t)ZSTD_sizeof_CCtx(cctx);
+    if (membudget_charge(nbytes)) {
+      pthread_mutex_lock(&g_scratch_mutex);
+      if (g_zstd_ncctxs < ZSTD_POOL_DEPTH) {
+        g_zstd_cctxs[g_zstd_ncctxs++] = cctx;
+        cctx = NULL;
+      }
+      pthread_mutex_unlock(&g_scratch_mutex);
+      if (cctx != NULL) {
+        membudget_release(nbytes);
+      }
+    }
+  }
+  ZSTD_freeCCtx(cctx);
+}
+
+static ZSTD_DCtx* zstd_dctx_get(void) {
+  ZSTD_DCtx* dctx = NULL;
+  if (g_scratch_initialized) {
+    pthread_mutex_lock(&g_scratch_mutex);
+    if (g_zstd_ndctxs > 0) {
+      dctx = g_zstd_dctxs[--g_zstd_ndctxs];
+    }
+    pthread_mutex_unlock(&g_scratch_mutex);
+  }
+  if (dctx != NULL) {
+    membudget_release((int64_t)ZSTD_sizeof_DCtx(dctx));
+    return dctx;
+  }
+  return ZSTD_createDCtx();
+}
+
+static void zstd_dctx_put(ZSTD_DCtx* dctx) {
+  if (g_scratch_initialized) {
+    ZSTD_DCtx_reset(dctx, ZSTD_reset_session_and_parameters);
+    int64_t nbytes = (int64_t)ZSTD_sizeof_DCtx(dctx);
+    if (membudget_charge(nbytes)) {
+      pthread_mutex_lock(&g_scratch_mutex);
+      if (g_zstd_ndctxs < ZSTD_POOL_DEPTH) {
+        g_zstd_dctxs[g_zstd_ndctxs++] = dctx;
+        dctx = NULL;
+      }
+      pthread_mutex_unlock(&g_scratch_mutex);
+      if (dctx != NULL) {
+        membudget_release(nbytes);
+      }
+    }
+  }
+  ZSTD_freeDCtx(dctx);
+}
+#endif  /* HAVE_ZSTD */
+
+
+/* Global budget for the memory kept around by the caches and pools (see
+ * blosc2_set_memory_budget()).  The usage is tracked even without a budget, so
+ * that it can be reported.  When some memory does not fit, the idle pooled
+ * blocks and file handles go first, as they are the cheapest to do without; the
+ * chunk caches, which are not thread-safe, can only shrink themselves, so the
+ * bytes that did not fit are recorded as wanted, and every cache gives up its
+ * least recently used chunks the next time it is used, until they fit. */
+
+static volatile int64_t g_membudget = 0;   // 0 means no limit
+static volatile int64_t g_memusage = 0;
+static volatile int64_t g_memwanted = 0;
+
+
+bool membudget_fits(int64_t nbytes) {
+  int64_t budget = blosc_atomic_load64(&g_membudget);
+  return budget <= 0 || blosc_atomic_load64(&g_memusage) + nbytes <= budget;
+}
+
+bool membudget_over(void) {
+  return !membudget_fits(blosc_atomic_load64(&g_memwanted));
+}
+
+static bool membudget_try(int64_t nbytes) {
+  int64_t budget = blosc_atomic_load64(&g_membudget);
+  int64_t usage = blosc_atomic_load64(&g_memusage);
+  do {
+    if (budget > 0 && usage + nbytes > budget) {
+      return false;
+    }
+  } while (!blosc_atomic_cas64(&g_memusage, &usage, usage + nbytes));
+  return true;
+}
+
+/* Release the idle pooled memory until `nbytes` more fit in the budget */
+static void membudget_reclaim(int64_t nbytes) {
+  if (g_scratch_initialized) {
+    pthread_mutex_lock(&g_scratch_mutex);
+    scratch_pool_trim(nbytes);
+    pthread_mutex_unlock(&g_scratch_mutex);
+  }
+  stdio_cache_trim(nbytes);
+}
+
+bool membudget_charge(int64_t nbytes) {
+  if (!membudget_try(nbytes)) {
+    membudget_reclaim(nbytes);
+    if (!membudget_try(nbytes)) {
+      blosc_atomic_store64(&g_memwanted, nbytes);
+      return false;
+    }
+  }
+  // The room wanted by a cache is there now
+  if (nbytes >= blosc_atomic_load64(&g_memwanted)) {
+    blosc_atomic_store64(&g_memwanted, 0);
+  }
+  return true;
+}
+
+void membudget_force(int64_t nbytes) {
+  if (!membudget_charge(nbytes)) {
+    blosc_atomic_add64(&g_memusage, nbytes);
+  }
+}
+
+void membudget_release(int64_t nbytes) {
+  blosc_atomic_add64(&g_memusage, -nbytes);
+}
+
+
+int64_t blosc2_set_memory_budget(int64_t nbytes) {
+  if (nbytes < 0) {
+    BLOSC_TRACE_ERROR("The memory budget cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int64_t previous = blosc_atomic_load64(&g_membudget);
+  blosc_atomic_store64(&g_membudget, nbytes);
+  blosc_atomic_store64(&g_memwanted, 0);
+  membudget_reclaim(0);
+  return previous;
+}
+
+
+int64_t blosc2_get_memory_usage(void) {
+  return blosc_atomic_load64(&g_memusage);
+}
+
+
+/* Set the temporaries of a thread context up for blocks of `blocksize` bytes, with
+ * `ebsize` bytes each, releasing the previous ones. */
+static int set_thread_tmp(struct thread_context* thread_context, int32_t blocksize, int32_t ebsize) {
+  blosc2_context* context = thread_context->parent_context;
+  if (thread_context->tmp_class >= 0) {
+    scratch_put(thread_context->tmp_class, thread_context->tmp);
+  }
+  else {
+    ctx_free(context, thread_context->tmp);
+  }
+  thread_context->tmp = NULL;
+  thread_context->tmp_blocksize = 0;
+  thread_context->tmp_nbytes = (size_t)4 * ebsize;
+  ctx_free(context, thread_context->block_input);
+  thread_context->block_input = NULL;
+  thread_context->tmp_class = -1;
+
+  int sclass = SCRATCH_MIN_CLASS;
+  while (sclass <= SCRATCH_MAX_CLASS && ((int64_t)1 << sclass) < blocksize) {
+    sclass++;
+  }
+  /* Pinned threads do not share their (node-local) temporaries */
+  if (g_scratch_initialized && sclass <= SCRATCH_MAX_CLASS && context->numa_nodes == 0 &&
+      context->allocator.malloc == default_malloc && context->allocator.free == default_free) {
+    thread_context->tmp = scratch_get(sclass);
+    thread_context->tmp_class = sclass;
+  }
+  else {
+    thread_context->tmp = ctx_malloc(context, thread_context->tmp_nbytes);
+  }
+  BLOSC_ERROR_NULL(thread_context->tmp, BLOSC2_ERROR_MEMORY_ALLOC);
+  thread_context->tmp2 = thread_context->tmp + ebsize;
+  thread_context->tmp3 = thread_context->tmp2 + ebsize;
+  thread_context->tmp4 = thread_context->tmp3 + ebsize;
+  thread_context->tmp_blocksize = blocksize;
+  return 0;
+}
+
+
 /*
  * Conversion routines between compressor and compression libraries
  */
@@ -236,6 +805,7 @@ static const char* clibcode_to_clibname(int clibcode) {
   if (clibcode == BLOSC_LZ4_LIB) return BLOSC_LZ4_LIBNAME;
   if (clibcode == BLOSC_ZLIB_LIB) return BLOSC_ZLIB_LIBNAME;
   if (clibcode == BLOSC_ZSTD_LIB) return BLOSC_ZSTD_LIBNAME;
+  if (clibcode == BLOSC_HYBRID_LIB) return BLOSC_HYBRID_LIBNAME;
   for (int i = 0; i < g_ncodecs; ++i) {
     if (clibcode == g_codecs[i].complib)
       return g_codecs[i].compname;
@@ -352,6 +922,20 @@ static int compcode_to_compformat(int compcode) {
 }
 
 
+/* The format of a block of a hybrid chunk out of its codec.  The codecs that are not
+   supported (or the blocks stored as is) have no format, so they never get decoded. */
+static int block_codec_to_compformat(uint8_t compcode) {
+  switch (compcode) {
+    case BLOSC_BLOSCLZ: return BLOSC_BLOSCLZ_FORMAT;
+    case BLOSC_LZ4:     return BLOSC_LZ4_FORMAT;
+    case BLOSC_LZ4HC:   return BLOSC_LZ4HC_FORMAT;
+    case BLOSC_ZLIB:    return BLOSC_ZLIB_FORMAT;
+    case BLOSC_ZSTD:    return BLOSC_ZSTD_FORMAT;
+    default:            return BLOSC_HYBRID_FORMAT;
+  }
+}
+
+
 /* Convert compressor code to blosc compressor format version */
 static int compcode_to_compversion(int compcode) {
   /* Write compressor format */
@@ -385,11 +969,45 @@ static int compcode_to_compversion(int compcode) {
 }
 
 
-static int lz4_wrap_compress(const char* input, size_t input_length,
-                             char* output, size_t maxout, int accel, void* hash_table) {
+/* Get the LZ4 state of a thread context, which is reused from a block to the next */
+static LZ4_stream_t* get_lz4_state(struct thread_context* thread_context) {
+  if (thread_context->lz4_state == NULL) {
+    void* state = ctx_malloc(thread_context->parent_context, sizeof(LZ4_stream_t));
+    if (state == NULL) {
+      return NULL;
+    }
+    thread_context->lz4_state = LZ4_initStream(state, sizeof(LZ4_stream_t));
+  }
+  return thread_context->lz4_state;
+}
+
+
+static int lz4_wrap_compress(struct thread_context* thread_context,
+                             const char* input, size_t input_length,
+                             char* output, size_t maxout, int accel) {
   BLOSC_UNUSED_PARAM(accel);
+  blosc2_context* context = thread_context->parent_context;
   int cbytes;
+  accel = 1;  // deactivate acceleration to match IPP behaviour
+
+  if (context->use_dict) {
+    /* The dictionary is loaded once per chunk in dict_cdict, and referenced by every block */
+    assert(context->dict_cdict != NULL);
+    LZ4_stream_t* state = get_lz4_state(thread_context);
+    if (state == NULL) {
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+#if defined(LZ4_STATIC_LINKING_ONLY)
+    LZ4_resetStream_fast(state);
+    LZ4_attach_dictionary(state, (const LZ4_stream_t*)context->dict_cdict);
+#else
+    memcpy(state, context->dict_cdict, sizeof(LZ4_stream_t));
+#endif
+    return LZ4_compress_fast_continue(state, input, output, (int)input_length, (int)maxout, accel);
+  }
+
 #ifdef HAVE_IPP
+  Ipp8u* hash_table = thread_context->lz4_hash_table;
   if (hash_table == NULL) {
     return BLOSC2_ERROR_INVALID_PARAM;  // the hash table should always be initialized
   }
@@ -398,7 +1016,7 @@ static int lz4_wrap_compress(const char* input, size_t input_length,
   // I have not found any function that uses `accel` like in `LZ4_compress_fast`, but
   // the IPP LZ4Safe call does a pretty good job on compressing well, so let's use it
   IppStatus status = ippsEncodeLZ4Safe_8u((const Ipp8u*)input, &inlen,
-                                           (Ipp8u*)output, &outlen, (Ipp8u*)hash_table);
+                                           (Ipp8u*)output, &outlen, hash_table);
   if (status == ippStsDstSizeLessExpected) {
     return 0;  // we cannot compress in required outlen
   }
@@ -407,14 +1025,67 @@ static int lz4_wrap_compress(const char* input, size_t input_length,
   }
   cbytes = outlen;
 #else
-  BLOSC_UNUSED_PARAM(hash_table);
-  accel = 1;  // deactivate acceleration to match IPP behaviour
-  cbytes = LZ4_compress_fast(input, output, (int)input_length, (int)maxout, accel);
+  LZ4_stream_t* state = get_lz4_state(thread_context);
+  if (state == NULL) {
+    return LZ4_compress_fast(input, output, (int)input_length, (int)maxout, accel);
+  }
+  // The state has been initialized already, so a (cheap) reset is enough
+#if defined(LZ4_STATIC_LINKING_ONLY)
+  cbytes = LZ4_compress_fast_extState_fastReset(state, input, output,
+                                                (int)input_length, (int)maxout, accel);
+#else
+  cbytes = LZ4_compress_fast_extState(state, input, output,
+                                      (int)input_length, (int)maxout, accel);
+#endif
 #endif
   return cbytes;
 }
 
 
+/* Blocks of encrypted or already compressed data do not shrink with LZ4, and compressing
+   them whole just to store them as is afterwards is a waste.  A few samples of the stream
+   (at its start, its middle and its end, where the filters that compact the blocks leave
+   their zeros) tell them apart for a fraction of the cost. */
+#define LZ4_PROBE_MINLEN (16 * 1024)  /* smaller streams are compressed anyway */
+#define LZ4_PROBE_MAXLEN (4 * 1024)
+
+static bool lz4_probe_incompressible(struct thread_context* thread_context,
+                                     const char* input, int32_t input_length,
+                                     char* output, int32_t maxout) {
+  if (input_length < LZ4_PROBE_MINLEN) {
+    return false;
+  }
+  int32_t probe_length = input_length / 16;
+  if (probe_length > LZ4_PROBE_MAXLEN) {
+    probe_length = LZ4_PROBE_MAXLEN;
+  }
+  // A sample has to shrink by 1/32 at least, else LZ4 gives up as soon as it gets there
+  int32_t probe_maxout = probe_length - probe_length / 32;
+  if (probe_maxout > maxout) {
+    return false;
+  }
+  LZ4_stream_t* state = get_lz4_state(thread_context);
+  const char* samples[3] = {input, input + input_length / 2, input + input_length - probe_length};
+  for (int i = 0; i < 3; i++) {
+    int cbytes;
+    if (state == NULL) {
+      cbytes = LZ4_compress_fast(samples[i], output, probe_length, probe_maxout, 1);
+    }
+    else {
+#if defined(LZ4_STATIC_LINKING_ONLY)
+      cbytes = LZ4_compress_fast_extState_fastReset(state, samples[i], output, probe_length, probe_maxout, 1);
+#else
+      cbytes = LZ4_compress_fast_extState(state, samples[i], output, probe_length, probe_maxout, 1);
+#endif
+    }
+    if (cbytes > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
 static int lz4hc_wrap_compress(const char* input, size_t input_length,
                                char* output, size_t maxout, int clevel) {
   int cbytes;
@@ -429,8 +1100,14 @@ static int lz4hc_wrap_compress(const char* input, size_t input_length,
 
 
 static int lz4_wrap_decompress(const char* input, size_t compressed_length,
-                               char* output, size_t maxout) {
+                               char* output, size_t maxout,
+                               const char* dict, int32_t dict_size) {
   int nbytes;
+  if (dict != NULL) {
+    nbytes = LZ4_decompress_safe_usingDict(input, output, (int)compressed_length, (int)maxout,
+                                           dict, dict_size);
+    return (nbytes == (int)maxout) ? nbytes : 0;
+  }
 #ifdef HAVE_IPP
   int outlen = (int)maxout;
   int inlen = (int)compressed_length;
@@ -450,45 +1127,156 @@ static int lz4_wrap_decompress(const char* input, size_t compressed_length,
 #if defined(HAVE_ZLIB)
 /* zlib is not very respectful with sharing name space with others.
  Fortunately, its names do not collide with those already in blosc. */
-static int zlib_wrap_compress(const char* input, size_t input_length,
-                              char* output, size_t maxout, int clevel) {
-  int status;
 #if defined(HAVE_ZLIB_NG) && ! defined(ZLIB_COMPAT)
-  size_t cl = maxout;
-  status = zng_compress2(
-      (uint8_t*)output, &cl, (uint8_t*)input, input_length, clevel);
+  #define ZLIB_STREAM zng_stream
+  #define ZLIB_FUNC(name) zng_ ## name
 #else
-  uLongf cl = (uLongf)maxout;
-  status = compress2(
-      (Bytef*)output, &cl, (Bytef*)input, (uLong)input_length, clevel);
+  #define ZLIB_STREAM z_stream
+  #define ZLIB_FUNC(name) name
 #endif
-  if (status != Z_OK) {
+
+/* Get the deflate stream of a thread context, which is only reset from a block to the next.
+   zlib-ng picks its strategy out of the level: deflate_quick for 1 and deflate_medium for 4 to 6. */
+static ZLIB_STREAM* get_zlib_deflate(struct thread_context* thread_context, int clevel) {
+  ZLIB_STREAM* strm = thread_context->zlib_deflate;
+  if (strm == NULL) {
+    strm = ctx_malloc(thread_context->parent_context, sizeof(ZLIB_STREAM));
+    if (strm == NULL) {
+      return NULL;
+    }
+    memset(strm, 0, sizeof(ZLIB_STREAM));
+    if (ZLIB_FUNC(deflateInit)(strm, clevel) != Z_OK) {
+      ctx_free(thread_context->parent_context, strm);
+      return NULL;
+    }
+    thread_context->zlib_deflate = strm;
+    thread_context->zlib_clevel = clevel;
+    return strm;
+  }
+  if (ZLIB_FUNC(deflateReset)(strm) != Z_OK) {
+    return NULL;
+  }
+  if (clevel != thread_context->zlib_clevel) {
+    // Nothing is flushed right after a reset
+    if (ZLIB_FUNC(deflateParams)(strm, clevel, Z_DEFAULT_STRATEGY) != Z_OK) {
+      return NULL;
+    }
+    thread_context->zlib_clevel = clevel;
+  }
+  return strm;
+}
+
+/* Get the inflate stream of a thread context, which is only reset from a block to the next */
+static ZLIB_STREAM* get_zlib_inflate(struct thread_context* thread_context) {
+  ZLIB_STREAM* strm = thread_context->zlib_inflate;
+  if (strm == NULL) {
+    strm = ctx_malloc(thread_context->parent_context, sizeof(ZLIB_STREAM));
+    if (strm == NULL) {
+      return NULL;
+    }
+    memset(strm, 0, sizeof(ZLIB_STREAM));
+    if (ZLIB_FUNC(inflateInit)(strm) != Z_OK) {
+      ctx_free(thread_context->parent_context, strm);
+      return NULL;
+    }
+    thread_context->zlib_inflate = strm;
+    return strm;
+  }
+  if (ZLIB_FUNC(inflateReset)(strm) != Z_OK) {
+    return NULL;
+  }
+  return strm;
+}
+
+static void free_zlib_streams(struct thread_context* thread_context) {
+  if (thread_context->zlib_deflate != NULL) {
+    ZLIB_FUNC(deflateEnd)(thread_context->zlib_deflate);
+    ctx_free(thread_context->parent_context, thread_context->zlib_deflate);
+  }
+  if (thread_context->zlib_inflate != NULL) {
+    ZLIB_FUNC(inflateEnd)(thread_context->zlib_inflate);
+    ctx_free(thread_context->parent_context, thread_context->zlib_inflate);
+  }
+}
+
+static int zlib_wrap_compress(struct thread_context* thread_context,
+                              const char* input, size_t input_length,
+                              char* output, size_t maxout, int clevel) {
+  ZLIB_STREAM* strm = get_zlib_deflate(thread_context, clevel);
+  if (strm == NULL) {
+    return 0;
+  }
+  strm->next_in = (uint8_t*)input;
+  strm->avail_in = (uint32_t)input_length;
+  strm->next_out = (uint8_t*)output;
+  strm->avail_out = (uint32_t)maxout;
+  if (ZLIB_FUNC(deflate)(strm, Z_FINISH) != Z_STREAM_END) {
+    // Blosc will just memcpy this buffer
     return 0;
   }
-  return (int)cl;
+  return (int)strm->total_out;
 }
 
-static int zlib_wrap_decompress(const char* input, size_t compressed_length,
+static int zlib_wrap_decompress(struct thread_context* thread_context,
+                                const char* input, size_t compressed_length,
                                 char* output, size_t maxout) {
-  int status;
-#if defined(HAVE_ZLIB_NG) && ! defined(ZLIB_COMPAT)
-  size_t ul = maxout;
-  status = zng_uncompress(
-      (uint8_t*)output, &ul, (uint8_t*)input, compressed_length);
-#else
-  uLongf ul = (uLongf)maxout;
-  status = uncompress(
-      (Bytef*)output, &ul, (Bytef*)input, (uLong)compressed_length);
-#endif
-  if (status != Z_OK) {
+  ZLIB_STREAM* strm = get_zlib_inflate(thread_context);
+  if (strm == NULL) {
+    return 0;
+  }
+  strm->next_in = (uint8_t*)input;
+  strm->avail_in = (uint32_t)compressed_length;
+  strm->next_out = (uint8_t*)output;
+  strm->avail_out = (uint32_t)maxout;
+  if (ZLIB_FUNC(inflate)(strm, Z_FINISH) != Z_STREAM_END) {
     return 0;
   }
-  return (int)ul;
+  return (int)strm->total_out;
 }
 #endif /*  HAVE_ZLIB */
 
 
 #if defined(HAVE_ZSTD)
+/* The prefix of the zstd blocks being (de)compressed (NULL if there is none) */
+static const uint8_t* zstd_block_prefix(struct thread_context* thread_context) {
+  if (!(thread_context->parent_context->blosc2_flags & BLOSC2_ZSTD_PREFIX) ||
+      thread_context->zstd_prefix_nblock < 0) {
+    return NULL;
+  }
+  return thread_context->zstd_prefix;
+}
+
+/* Get the prefix of block `nblock` ready, which is the previous block.  Returns a negative
+   value when that one has not just been (de)compressed by this thread. */
+static int start_zstd_prefix(struct thread_context* thread_context, int32_t nblock) {
+  if (nblock == 0) {
+    thread_context->zstd_prefix_nblock = -1;
+    return 0;
+  }
+  if (thread_context->zstd_prefix_nblock != nblock - 1) {
+    BLOSC_TRACE_ERROR("Block %d needs the previous one as its zstd prefix", nblock);
+    return BLOSC2_ERROR_DATA;
+  }
+  return 0;
+}
+
+/* Keep `block` (once filtered) as the prefix of the next block */
+static int keep_zstd_prefix(struct thread_context* thread_context, const uint8_t* block, int32_t bsize,
+                            int32_t nblock) {
+  blosc2_context* context = thread_context->parent_context;
+  if (bsize > thread_context->zstd_prefix_size) {
+    ctx_free(context, thread_context->zstd_prefix);
+    thread_context->zstd_prefix = ctx_malloc(context, (size_t)bsize);
+    thread_context->zstd_prefix_size = thread_context->zstd_prefix != NULL ? bsize : 0;
+    thread_context->zstd_prefix_nblock = -1;
+    BLOSC_ERROR_NULL(thread_context->zstd_prefix, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  memcpy(thread_context->zstd_prefix, block, (size_t)bsize);
+  thread_context->zstd_prefix_len = bsize;
+  thread_context->zstd_prefix_nblock = nblock;
+  return 0;
+}
+
 static int zstd_wrap_compress(struct thread_context* thread_context,
                               const char* input, size_t input_length,
                               char* output, size_t maxout, int clevel) {
@@ -500,18 +1288,58 @@ static int zstd_wrap_compress(struct thread_context* thread_context,
   if (clevel == 8) clevel = ZSTD_maxCLevel() - 2;
 
   if (thread_context->zstd_cctx == NULL) {
-    thread_context->zstd_cctx = ZSTD_createCCtx();
+    thread_context->zstd_cctx = zstd_cctx_get();
+    thread_context->zstd_clevel = 0;
+    thread_context->zstd_cdict = NULL;
+    if (thread_context->zstd_cctx == NULL) {
+      return 0;
+    }
   }
+  ZSTD_CCtx* cctx = thread_context->zstd_cctx;
 
+  /* The level and dictionary are sticky in the context, so only set them when they change.
+   * A dictionary allocated at the address of the previous (freed) one is referenced already. */
+  const ZSTD_CDict* cdict = NULL;
   if (context->use_dict) {
     assert(context->dict_cdict != NULL);
-    code = ZSTD_compress_usingCDict(
-            thread_context->zstd_cctx, (void*)output, maxout, (void*)input,
-            input_length, context->dict_cdict);
-  } else {
-    code = ZSTD_compressCCtx(thread_context->zstd_cctx,
-        (void*)output, maxout, (void*)input, input_length, clevel);
+    cdict = context->dict_cdict;
+  }
+  if (cdict != thread_context->zstd_cdict) {
+    code = ZSTD_CCtx_refCDict(cctx, cdict);
+    if (ZSTD_isError(code)) {
+      return 0;
+    }
+    thread_context->zstd_cdict = cdict;
+  }
+  if (clevel != thread_context->zstd_clevel) {
+    code = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, clevel);
+    if (ZSTD_isError(code)) {
+      return 0;
+    }
+    thread_context->zstd_clevel = clevel;
   }
+  int ldm = context->zstd_window == BLOSC2_ZSTD_LDM_WINDOW && (context->blosc2_flags & BLOSC2_ZSTD_PREFIX);
+  if (ldm != thread_context->zstd_ldm) {
+    // 1 enables it, and 0 leaves it to zstd (which only turns it on for huge windows)
+    code = ZSTD_CCtx_setParameter(cctx, ZSTD_c_enableLongDistanceMatching, ldm);
+    if (ZSTD_isError(code)) {
+      return 0;
+    }
+    thread_context->zstd_ldm = ldm;
+  }
+  /* A prefix is only referenced for the next compression, which may not have been
+   * reset yet when the previous one failed (because of a small output, say) */
+  const uint8_t* prefix = zstd_block_prefix(thread_context);
+  if (prefix != NULL) {
+    code = ZSTD_CCtx_reset(cctx, ZSTD_reset_session_only);
+    if (!ZSTD_isError(code)) {
+      code = ZSTD_CCtx_refPrefix(cctx, prefix, (size_t)thread_context->zstd_prefix_len);
+    }
+    if (ZSTD_isError(code)) {
+      return 0;
+    }
+  }
+  code = ZSTD_compress2(cctx, (void*)output, maxout, (void*)input, input_length);
   if (ZSTD_isError(code) != ZSTD_error_no_error) {
     // Blosc will just memcpy this buffer
     return 0;
@@ -526,10 +1354,21 @@ static int zstd_wrap_decompress(struct thread_context* thread_context,
   blosc2_context* context = thread_context->parent_context;
 
   if (thread_context->zstd_dctx == NULL) {
-    thread_context->zstd_dctx = ZSTD_createDCtx();
+    thread_context->zstd_dctx = zstd_dctx_get();
   }
 
-  if (context->use_dict) {
+  const uint8_t* prefix = zstd_block_prefix(thread_context);
+  if (prefix != NULL) {
+    code = ZSTD_DCtx_reset(thread_context->zstd_dctx, ZSTD_reset_session_only);
+    if (!ZSTD_isError(code)) {
+      code = ZSTD_DCtx_refPrefix(thread_context->zstd_dctx, prefix, (size_t)thread_context->zstd_prefix_len);
+    }
+    if (ZSTD_isError(code)) {
+      BLOSC_TRACE_ERROR("Error in ZSTD prefix: '%s'.  Giving up.", ZDICT_getErrorName(code));
+      return 0;
+    }
+  }
+  if (context->blosc2_flags & BLOSC2_USEDICT) {
     assert(context->dict_ddict != NULL);
     code = ZSTD_decompress_usingDDict(
             thread_context->zstd_dctx, (void*)output, maxout, (void*)input,
@@ -548,10 +1387,10 @@ static int zstd_wrap_decompress(struct thread_context* thread_context,
 #endif /*  HAVE_ZSTD */
 
 /* Compute acceleration for blosclz */
-static int get_accel(const blosc2_context* context) {
+static int get_accel(const blosc2_context* context, int compcode) {
   int clevel = context->clevel;
 
-  if (context->compcode == BLOSC_LZ4) {
+  if (compcode == BLOSC_LZ4) {
     /* This acceleration setting based on discussions held in:
      * https://groups.google.com/forum/#!topic/lz4c/zosy90P8MQw
      */
@@ -662,7 +1501,7 @@ typedef struct blosc_header_s {
   uint8_t udcompcode;
   uint8_t compcode_meta;
   uint8_t filter_meta[BLOSC2_MAX_FILTERS];
-  uint8_t reserved2;
+  uint8_t checksum;
   uint8_t blosc2_flags;
 } blosc_header;
 
@@ -741,20 +1580,135 @@ int read_chunk_header(const uint8_t* src, int32_t srcsize, bool extended_header,
       header->filter_meta[5] = 0;
     }
   }
-  else {
-    flags_to_filters(header->flags, header->filter_codes);
+  else {
+    flags_to_filters(header->flags, header->filter_codes);
+  }
+  return 0;
+}
+
+static inline void blosc2_calculate_blocks(blosc2_context* context) {
+  /* Compute number of blocks in buffer */
+  context->nblocks = context->sourcesize / context->blocksize;
+  context->leftover = context->sourcesize % context->blocksize;
+  context->nblocks = (context->leftover > 0) ?
+                     (context->nblocks + 1) : context->nblocks;
+}
+
+/* The codecs and filters that are loaded by id from BLOSC_PLUGIN_PATH, when chunks
+ * (or contexts) refer to them but they are not registered */
+static pthread_mutex_t g_plugins_mutex;
+static char g_plugin_codec_names[256][16];
+static char g_plugin_filter_names[256][16];
+
+static bool codec_registered(int compcode) {
+  for (int i = 0; i < g_ncodecs; ++i) {
+    if (g_codecs[i].compcode == compcode) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* The partial decoder of the registered codec `compcode`, if any */
+static blosc2_codec_getitems_cb codec_getitems(int compcode) {
+  for (int i = 0; i < g_ncodecs; ++i) {
+    if (g_codecs[i].compcode == compcode) {
+      return g_codecs_getitems[i];
+    }
+  }
+  return NULL;
+}
+
+static bool filter_registered(int id) {
+  for (uint64_t i = 0; i < g_nfilters; ++i) {
+    if (g_filters[i].id == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Register the codec in libblosc2_codec_<compcode> (which has the `info` of a dynamic codec) */
+static int load_plugin_codec(int compcode) {
+  char *name = g_plugin_codec_names[compcode];
+  snprintf(name, sizeof(g_plugin_codec_names[0]), "codec_%d", compcode);
+  char libpath[PATH_MAX];
+  void *lib = load_lib_from_path(name, libpath);
+  if (lib == NULL) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  codec_info *info = dlsym(lib, "info");
+  if (info == NULL) {
+    BLOSC_TRACE_ERROR("`info` symbol cannot be loaded from plugin `%s`", name);
+    dlclose(lib);
+    return BLOSC2_ERROR_FAILURE;
+  }
+  blosc2_codec codec = {.compcode = (uint8_t)compcode, .compname = name, .complib = (uint8_t)compcode,
+                        .version = 1};
+  codec.encoder = dlsym(lib, info->encoder);
+  codec.decoder = dlsym(lib, info->decoder);
+  if (codec.encoder == NULL || codec.decoder == NULL) {
+    BLOSC_TRACE_ERROR("encoder or decoder cannot be loaded from plugin `%s`", name);
+    dlclose(lib);
+    return BLOSC2_ERROR_FAILURE;
   }
-  return 0;
+  return register_codec_private(&codec);
 }
 
-static inline void blosc2_calculate_blocks(blosc2_context* context) {
-  /* Compute number of blocks in buffer */
-  context->nblocks = context->sourcesize / context->blocksize;
-  context->leftover = context->sourcesize % context->blocksize;
-  context->nblocks = (context->leftover > 0) ?
-                     (context->nblocks + 1) : context->nblocks;
+/* Register the filter in libblosc2_filter_<id> (which has the `info` of a dynamic filter) */
+static int load_plugin_filter(int id) {
+  char *name = g_plugin_filter_names[id];
+  snprintf(name, sizeof(g_plugin_filter_names[0]), "filter_%d", id);
+  char libpath[PATH_MAX];
+  void *lib = load_lib_from_path(name, libpath);
+  if (lib == NULL) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  filter_info *info = dlsym(lib, "info");
+  if (info == NULL) {
+    BLOSC_TRACE_ERROR("`info` symbol cannot be loaded from plugin `%s`", name);
+    dlclose(lib);
+    return BLOSC2_ERROR_FAILURE;
+  }
+  blosc2_filter filter = {.id = (uint8_t)id, .name = name, .version = 1};
+  filter.forward = dlsym(lib, info->forward);
+  filter.backward = dlsym(lib, info->backward);
+  if (filter.forward == NULL || filter.backward == NULL) {
+    BLOSC_TRACE_ERROR("forward or backward cannot be loaded from plugin `%s`", name);
+    dlclose(lib);
+    return BLOSC2_ERROR_FAILURE;
+  }
+  return register_filter_private(&filter);
+}
+
+/* Load the plugins for the codec and the filters of context that are not registered yet
+ * (the ones that cannot be loaded are reported later on, when they are looked up) */
+static void resolve_plugins(blosc2_context* context) {
+  bool codec_missing = context->compcode >= BLOSC2_GLOBAL_REGISTERED_CODECS_START &&
+                       !codec_registered(context->compcode);
+  bool filters_missing = false;
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; ++i) {
+    filters_missing |= context->filters[i] >= BLOSC2_GLOBAL_REGISTERED_FILTERS_START &&
+                       !filter_registered(context->filters[i]);
+  }
+  if (!codec_missing && !filters_missing) {
+    return;
+  }
+
+  pthread_mutex_lock(&g_plugins_mutex);
+  if (codec_missing && !codec_registered(context->compcode)) {
+    load_plugin_codec(context->compcode);
+  }
+  for (int i = 0; filters_missing && i < BLOSC2_MAX_FILTERS; ++i) {
+    if (context->filters[i] >= BLOSC2_GLOBAL_REGISTERED_FILTERS_START &&
+        !filter_registered(context->filters[i])) {
+      load_plugin_filter(context->filters[i]);
+    }
+  }
+  pthread_mutex_unlock(&g_plugins_mutex);
 }
 
+
 static int blosc2_initialize_context_from_header(blosc2_context* context, blosc_header* header) {
   context->header_flags = header->flags;
   context->typesize = header->typesize;
@@ -762,7 +1716,7 @@ static int blosc2_initialize_context_from_header(blosc2_context* context, blosc_
   context->blocksize = header->blocksize;
   context->blosc2_flags = header->blosc2_flags;
   context->compcode = header->flags >> 5;
-  if (context->compcode == BLOSC_UDCODEC_FORMAT) {
+  if (context->compcode == BLOSC_UDCODEC_FORMAT || context->compcode == BLOSC_HYBRID_FORMAT) {
     context->compcode = header->udcompcode;
   }
   blosc2_calculate_blocks(context);
@@ -779,14 +1733,21 @@ static int blosc2_initialize_context_from_header(blosc2_context* context, blosc_
 
     context->filter_flags = filters_to_flags(header->filter_codes);
     context->special_type = (header->blosc2_flags >> 4) & BLOSC2_SPECIAL_MASK;
+    context->chunk_checksum = header->checksum & 0x0Fu;
+    context->chunk_cipher = header->checksum >> 4;
 
     is_lazy = (context->blosc2_flags & 0x08u);
   }
   else {
     context->header_overhead = BLOSC_MIN_HEADER_LENGTH;
+    context->chunk_checksum = BLOSC2_CHECKSUM_NONE;
+    context->chunk_cipher = BLOSC2_CIPHER_NONE;
     context->filter_flags = get_filter_flags(context->header_flags, context->typesize);
     flags_to_filters(context->header_flags, context->filters);
   }
+  if (g_initlib) {
+    resolve_plugins(context);
+  }
 
   // Some checks for malformed headers
   if (!is_lazy && header->cbytes > context->srcsize) {
@@ -894,6 +1855,10 @@ static int blosc2_intialize_header_from_context(blosc2_context* context, blosc_h
     for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
       header->filter_codes[i] = context->filters[i];
       header->filter_meta[i] = context->filters_meta[i];
+      if (context->filters[i] == BLOSC_SHUFFLE && context->shuffle_stride > 0) {
+        header->filter_codes[i] = BLOSC_FILTER_SHUFFLE_STRIDE;
+        header->filter_meta[i] = (uint8_t)context->shuffle_stride;
+      }
     }
     header->udcompcode = context->compcode;
     header->compcode_meta = context->compcode_meta;
@@ -907,6 +1872,9 @@ static int blosc2_intialize_header_from_context(blosc2_context* context, blosc_h
     if (context->blosc2_flags & BLOSC2_INSTR_CODEC) {
       header->blosc2_flags |= BLOSC2_INSTR_CODEC;
     }
+    if (context->blosc2_flags & BLOSC2_ZSTD_PREFIX) {
+      header->blosc2_flags |= BLOSC2_ZSTD_PREFIX;
+    }
   }
 
   return 0;
@@ -919,6 +1887,190 @@ void _cycle_buffers(uint8_t **src, uint8_t **dest, uint8_t **tmp) {
   *tmp = tmp2;
 }
 
+/* Cycle the buffers of the forward pipeline, where the `input` of the pipeline can be
+   read (the delta filter does so) but never written, so it stays in the `tmp` slot */
+static void cycle_forward_buffers(uint8_t **src, uint8_t **dest, uint8_t **tmp, const uint8_t *input) {
+  _cycle_buffers(src, dest, tmp);
+  if (*dest == input) {
+    *dest = *tmp;
+    *tmp = (uint8_t *)input;
+  }
+}
+
+/* A monotonic clock in nanoseconds, cheap enough for timing the stages of every block */
+static inline int64_t stats_clock(void) {
+#if defined(_WIN32)
+  static double nsecs_per_tick = 0.;
+  LARGE_INTEGER ticks;
+  if (nsecs_per_tick == 0.) {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    nsecs_per_tick = 1e9 / (double)freq.QuadPart;
+  }
+  QueryPerformanceCounter(&ticks);
+  return (int64_t)((double)ticks.QuadPart * nsecs_per_tick);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+/* The nanoseconds since *last, which is moved to now */
+static inline int64_t stats_lap(int64_t* last) {
+  int64_t now = stats_clock();
+  int64_t nsecs = now - *last;
+  *last = now;
+  return nsecs;
+}
+
+#if defined(HAVE_TRACE_HOOKS)
+blosc2_trace_cb g_trace_cb = NULL;
+void *g_trace_data = NULL;
+#if defined(HAVE_SYS_SDT_H)
+unsigned short blosc2_stage_semaphore __attribute__((unused)) __attribute__((section(".probes")));
+#endif
+
+int64_t trace_clock(void) {
+  return stats_clock();
+}
+
+void trace_stage(int stage, const blosc2_context *ctx, int32_t tid, int32_t nblock, int64_t nbytes,
+                 int64_t start_ns, int64_t end_ns) {
+#if defined(HAVE_SYS_SDT_H)
+  STAP_PROBE7(blosc2, stage, stage, ctx, tid, nblock, nbytes, start_ns, end_ns);
+#endif
+  blosc2_trace_cb cb = g_trace_cb;
+  if (cb != NULL) {
+    blosc2_trace_event event = {stage, ctx, tid, nblock, nbytes, start_ns, end_ns};
+    cb(&event, g_trace_data);
+  }
+}
+#endif  /* HAVE_TRACE_HOOKS */
+
+/* Like stats_lap(), also reporting the stage of the block to the tracing hooks */
+static inline int64_t stage_lap(struct thread_context* thread_context, int stage, int32_t nblock,
+                                int32_t nbytes, int64_t* last) {
+#if defined(HAVE_TRACE_HOOKS)
+  int64_t start = *last;
+  int64_t nsecs = stats_lap(last);
+  BLOSC_HOOK_STAGE(stage, thread_context->parent_context, thread_context->tid, nblock, nbytes, start, *last);
+  return nsecs;
+#else
+  BLOSC_UNUSED_PARAM(thread_context);
+  BLOSC_UNUSED_PARAM(stage);
+  BLOSC_UNUSED_PARAM(nblock);
+  BLOSC_UNUSED_PARAM(nbytes);
+  return stats_lap(last);
+#endif
+}
+
+/* Add the statistics of a thread to the ones of its context, and start them over */
+static void merge_stats(blosc2_ctx_stats* stats, blosc2_ctx_stats* thread_stats) {
+  stats->nblocks += thread_stats->nblocks;
+  stats->nblocks_raw += thread_stats->nblocks_raw;
+  stats->nruns += thread_stats->nruns;
+  stats->filters_ns += thread_stats->filters_ns;
+  stats->codec_ns += thread_stats->codec_ns;
+  stats->memcpy_ns += thread_stats->memcpy_ns;
+  stats->cipher_ns += thread_stats->cipher_ns;
+  stats->wakeup_ns += thread_stats->wakeup_ns;
+  stats->sched_ns += thread_stats->sched_ns;
+  stats->lazy_reads += thread_stats->lazy_reads;
+  stats->lazy_read_bytes += thread_stats->lazy_read_bytes;
+  memset(thread_stats, 0, sizeof(blosc2_ctx_stats));
+}
+
+/* The csize and the tag of a block in the cipher data of a chunk */
+#define CIPHER_BLOCK_SIZE ((int32_t)sizeof(int32_t) + BLOSC2_CIPHER_TAG_SIZE)
+
+/* The bytes of the header that the tags of the blocks authenticate as well: all of them but the
+ * cbytes, the checksum/cipher byte and the blosc2 flags (the lazy chunks change them) */
+#define CIPHER_AAD_SIZE (BLOSC2_CHUNK_CBYTES + BLOSC2_CHUNK_CHECKSUM - BLOSC2_CHUNK_FILTER_CODES)
+
+/* The size of the cipher data (the nonce of the chunk, and the csize and the tag of
+ * every block) that ends an encrypted chunk of nblocks */
+static int32_t cipher_data_len(int32_t nblocks) {
+  return BLOSC2_CIPHER_NONCE_SIZE + nblocks * CIPHER_BLOCK_SIZE;
+}
+
+/* Fill the aad of the blocks out of the header of chunk, with the given flags (the ones of
+ * the chunk but while it is being compressed) */
+static void build_cipher_aad(const uint8_t* chunk, uint8_t flags, uint8_t* aad) {
+  memcpy(aad, chunk, BLOSC2_CHUNK_CBYTES);
+  aad[BLOSC2_CHUNK_FLAGS] = flags;
+  memcpy(aad + BLOSC2_CHUNK_CBYTES, chunk + BLOSC2_CHUNK_FILTER_CODES,
+         BLOSC2_CHUNK_CHECKSUM - BLOSC2_CHUNK_FILTER_CODES);
+}
+
+/* The nonce of a block, which is the one of its chunk with the index of the block
+ * (little endian) xored into its last 4 bytes */
+static void build_block_nonce(const uint8_t* chunk_nonce, int32_t nblock, uint8_t* nonce) {
+  memcpy(nonce, chunk_nonce, BLOSC2_CIPHER_NONCE_SIZE);
+  for (int i = 0; i < 4; i++) {
+    nonce[BLOSC2_CIPHER_NONCE_SIZE - 4 + i] ^= (uint8_t)((uint32_t)nblock >> (8 * i));
+  }
+}
+
+/* Encrypt the cbytes of a compressed block in place, when the chunk has a cipher, and
+ * keep its csize and its tag for the cipher data of the chunk */
+static void seal_block(struct thread_context* thread_context, uint8_t* block, int32_t cbytes, int32_t nblock) {
+  blosc2_context* context = thread_context->parent_context;
+  if (context->cipher == BLOSC2_CIPHER_NONE) {
+    return;
+  }
+  int64_t start = stats_clock();
+  uint8_t nonce[BLOSC2_CIPHER_NONCE_SIZE];
+  build_block_nonce(context->chunk_nonce, nblock, nonce);
+  uint8_t* block_cipher = context->cipher_blocks + (int64_t)nblock * CIPHER_BLOCK_SIZE;
+  _sw32(block_cipher, cbytes);
+  cipher_seal(context->cipher_key, nonce, context->cipher_aad, CIPHER_AAD_SIZE, block, (size_t)cbytes,
+              block_cipher + sizeof(int32_t));
+  thread_context->stats.cipher_ns += stage_lap(thread_context, BLOSC2_TRACE_CIPHER, nblock, cbytes, &start);
+}
+
+/* Copy a block that is stored as it is */
+static void copy_raw_block(struct thread_context* thread_context, uint8_t* dest, const uint8_t* src,
+                           int32_t nblock, int32_t bsize) {
+  blosc2_context* context = thread_context->parent_context;
+  int64_t start = stats_clock();
+  if (context->block_zonemaps != NULL) {
+    zonemap_compute(context->zonemap, context->typesize, src, bsize, &context->block_zonemaps[nblock]);
+  }
+  if (context->block_checksums != NULL) {
+    context->block_checksums[nblock] = checksum_xxh3(src, bsize);
+  }
+  memcpy(dest, src, (unsigned int)bsize);
+  thread_context->stats.memcpy_ns += stage_lap(thread_context, BLOSC2_TRACE_MEMCPY, nblock, bsize, &start);
+  thread_context->stats.nblocks++;
+  thread_context->stats.nblocks_raw++;
+}
+
+/* The chunk of the super-chunk that a context is working on (-1 if none).  Contexts of
+ * the pools of concurrent reads and writes keep their own, as the super-chunk is shared. */
+static int64_t get_current_nchunk(blosc2_context* context) {
+  if (context->pooled) {
+    return context->nchunk;
+  }
+  return context->schunk != NULL ? context->schunk->current_nchunk : -1;
+}
+
+/* The index of the (single) SHUFFLE that comes right after the filter `current` in the
+   forward pipeline if both can be fused for this block, and -1 otherwise */
+static int fused_shuffle(blosc2_context* context, int current, int32_t bsize) {
+  int i = current + 1;
+  while (i < BLOSC2_MAX_FILTERS && context->filters[i] == BLOSC_NOFILTER) {
+    i++;
+  }
+  if (i == BLOSC2_MAX_FILTERS || context->filters[i] != BLOSC_SHUFFLE || context->filters_meta[i] != 0) {
+    return -1;
+  }
+  if ((bsize % context->typesize) != 0 || !shuffle_tile_accelerated(context->typesize)) {
+    return -1;
+  }
+  return i;
+}
+
 uint8_t* pipeline_forward(struct thread_context* thread_context, const int32_t bsize,
                           const uint8_t* src, const int32_t offset,
                           uint8_t* dest, uint8_t* tmp, uint8_t* tmp2) {
@@ -944,7 +2096,7 @@ uint8_t* pipeline_forward(struct thread_context* thread_context, const int32_t b
     preparams.output_typesize = typesize;
     preparams.output_offset = offset;
     preparams.nblock = offset / context->blocksize;
-    preparams.nchunk = context->schunk != NULL ? context->schunk->current_nchunk : -1;
+    preparams.nchunk = get_current_nchunk(context);
     preparams.tid = thread_context->tid;
     preparams.ttmp = thread_context->tmp;
     preparams.ttmp_nbytes = thread_context->tmp_nbytes;
@@ -954,25 +2106,35 @@ uint8_t* pipeline_forward(struct thread_context* thread_context, const int32_t b
       BLOSC_TRACE_ERROR("Execution of prefilter function failed");
       return NULL;
     }
+    if (context->block_checksums != NULL) {
+      // What the prefilter outputs is what gets compressed
+      context->block_checksums[preparams.nblock] = checksum_xxh3(_dest, bsize);
+    }
 
     if (memcpyed) {
       // No more filters are required
       return _dest;
     }
-    _cycle_buffers(&_src, &_dest, &_tmp);
+    cycle_forward_buffers(&_src, &_dest, &_tmp, src + offset);
   }
 
   /* Process the filter pipeline */
   for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
     int rc = BLOSC2_ERROR_SUCCESS;
+    // The shuffle that is run along with the element-wise filter (if any)
+    int fused = -1;
     if (filters[i] <= BLOSC2_DEFINED_FILTERS_STOP) {
       switch (filters[i]) {
         case BLOSC_SHUFFLE:
+          if (context->shuffle_stride > 0) {
+            shuffle(context->shuffle_stride, bsize, _src, _dest);
+            break;
+          }
           for (int j = 0; j <= filters_meta[i]; j++) {
             shuffle(typesize, bsize, _src, _dest);
             // Cycle filters when required
             if (j < filters_meta[i]) {
-              _cycle_buffers(&_src, &_dest, &_tmp);
+              cycle_forward_buffers(&_src, &_dest, &_tmp, src + offset);
             }
           }
           break;
@@ -982,10 +2144,23 @@ uint8_t* pipeline_forward(struct thread_context* thread_context, const int32_t b
           }
           break;
         case BLOSC_DELTA:
-          delta_encoder(src, offset, bsize, typesize, _src, _dest);
+          fused = fused_shuffle(context, i, bsize);
+          if (fused >= 0) {
+            delta_encoder_shuffle(src, offset, bsize, typesize, filters_meta[i], _src, _dest);
+          }
+          else {
+            delta_encoder(src, offset, bsize, typesize, filters_meta[i], _src, _dest);
+          }
           break;
         case BLOSC_TRUNC_PREC:
-          if (truncate_precision(filters_meta[i], typesize, bsize, _src, _dest) < 0) {
+          fused = (typesize == 4 || typesize == 8) ? fused_shuffle(context, i, bsize) : -1;
+          if (fused >= 0) {
+            rc = truncate_precision_shuffle(filters_meta[i], typesize, bsize, _src, _dest);
+          }
+          else {
+            rc = truncate_precision(filters_meta[i], typesize, bsize, _src, _dest);
+          }
+          if (rc < 0) {
             return NULL;
           }
           break;
@@ -1031,7 +2206,11 @@ uint8_t* pipeline_forward(struct thread_context* thread_context, const int32_t b
 
     // Cycle buffers when required
     if (filters[i] != BLOSC_NOFILTER) {
-      _cycle_buffers(&_src, &_dest, &_tmp);
+      cycle_forward_buffers(&_src, &_dest, &_tmp, src + offset);
+    }
+    if (fused >= 0) {
+      // The shuffle is already done
+      i = fused;
     }
   }
   return _src;
@@ -1039,28 +2218,208 @@ uint8_t* pipeline_forward(struct thread_context* thread_context, const int32_t b
 
 
 // Optimized version for detecting runs.  It compares 8 bytes values wherever possible.
-static bool get_run(const uint8_t* ip, const uint8_t* ip_bound) {
-  uint8_t x = *ip;
-  int64_t value, value2;
-  /* Broadcast the value for every byte in a 64-bit register */
-  memset(&value, x, 8);
-  while (ip < (ip_bound - 8)) {
-#if defined(BLOSC_STRICT_ALIGN)
-    memcpy(&value2, ip, 8);
-#else
-    value2 = *(int64_t*)ip;
+/* Whether the `nbytes` at `ip` are a run of the same value of `typesize` bytes,
+ * i.e. whether every byte matches the one `typesize` bytes before it.  The first
+ * mismatch ends the scan, so non-runs are usually detected in the first vector. */
+static bool get_run(const uint8_t* ip, int32_t nbytes, int32_t typesize) {
+  if (nbytes <= typesize) {
+    return nbytes == typesize;
+  }
+  const uint8_t* ref = ip;
+  const uint8_t* cur = ip + typesize;
+  int32_t n = nbytes - typesize;
+  int32_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= n; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(ref + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(cur + i));
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != -1) {
+      return false;
+    }
+  }
 #endif
-    if (value != value2) {
-      // Values differ.  We don't have a run.
+#if defined(__SSE2__)
+  for (; i + 16 <= n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(ref + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(cur + i));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) {
       return false;
     }
-    else {
-      ip += 8;
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t eq = vceqq_u8(vld1q_u8(ref + i), vld1q_u8(cur + i));
+    if (vminvq_u8(eq) != 0xFF) {
+      return false;
+    }
+  }
+#endif
+  for (; i + 8 <= n; i += 8) {
+    uint64_t a, b;
+    memcpy(&a, ref + i, 8);
+    memcpy(&b, cur + i, 8);
+    if (a != b) {
+      return false;
+    }
+  }
+  for (; i < n; i++) {
+    if (ref[i] != cur[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Compute the zone map and the checksum of a block (if any), while it is in cache */
+static void summarize_block(blosc2_context* context, const uint8_t* src, int32_t bsize, int32_t nblock) {
+  if (context->block_zonemaps != NULL) {
+    // Every block is summarized by a single thread
+    zonemap_compute(context->zonemap, context->typesize, src, bsize, &context->block_zonemaps[nblock]);
+  }
+  if (context->block_checksums != NULL && context->prefilter == NULL) {
+    context->block_checksums[nblock] = checksum_xxh3(src, bsize);
+  }
+}
+
+
+/* The codecs of the blocks of the hybrid chunk being compressed (NULL for the other chunks) */
+static uint8_t* hybrid_block_codecs(blosc2_context* context) {
+  if (!is_hybrid_chunk(context->header_flags)) {
+    return NULL;
+  }
+  return context->dest + context->header_overhead + (int32_t)sizeof(int32_t) * context->nblocks;
+}
+
+
+/* Pick the codec of a block (once filtered) of a hybrid chunk, and keep it after the bstarts.
+   Returns the codec, which is the one of the context for the other chunks, or a negative
+   value on errors. */
+static int pick_block_codec(struct thread_context* thread_context, const uint8_t* src,
+                            int32_t bsize, int32_t nblock) {
+  blosc2_context* context = thread_context->parent_context;
+  uint8_t* block_codecs = hybrid_block_codecs(context);
+  if (block_codecs == NULL) {
+    return context->compcode;
+  }
+
+  blosc2_block_codec_params params = {
+    .user_data = context->block_codec_params,
+    .input = src,
+    .size = bsize,
+    .typesize = context->typesize,
+    .nblock = nblock,
+    .tid = thread_context->tid,
+    .ctx = context,
+  };
+  int compcode = context->block_codec(&params);
+  switch (compcode) {
+    case BLOSC_BLOSCLZ:
+    case BLOSC_LZ4:
+    case BLOSC_LZ4HC:
+#if defined(HAVE_ZLIB)
+    case BLOSC_ZLIB:
+#endif /* HAVE_ZLIB */
+#if defined(HAVE_ZSTD)
+    case BLOSC_ZSTD:
+#endif /* HAVE_ZSTD */
+    case BLOSC2_BLOCK_MEMCPY:
+      break;
+    default:
+      if (compcode < 0) {
+        BLOSC_TRACE_ERROR("Error in block codec function for block %d", nblock);
+        return compcode;
+      }
+      BLOSC_TRACE_ERROR("Codec %d is not supported for the blocks of hybrid chunks", compcode);
+      return BLOSC2_ERROR_CODEC_SUPPORT;
+  }
+  block_codecs[nblock] = (uint8_t)compcode;
+  return compcode;
+}
+
+
+/* Compress a single stream of a block with `compcode`.  Returns 0 when the codec cannot
+   compress it (and it has to be stored as is), or a negative value on errors. */
+static int32_t compress_stream(struct thread_context* thread_context, int compcode, const uint8_t* src,
+                               int32_t neblock, uint8_t* dest, int32_t maxout, int accel) {
+  blosc2_context* context = thread_context->parent_context;
+  int32_t cbytes;
+  const char* compname;
+
+  if (compcode == BLOSC2_BLOCK_MEMCPY) {
+    cbytes = 0;  // stored as is by the caller
+  }
+  else if (compcode == BLOSC_BLOSCLZ) {
+    cbytes = blosclz_compress(context->clevel, src,
+                              (int)neblock, dest, maxout, context);
+  }
+  else if ((compcode == BLOSC_LZ4 || compcode == BLOSC_LZ4HC) && !context->use_dict &&
+           lz4_probe_incompressible(thread_context, (char*)src, neblock, (char*)dest, maxout)) {
+    cbytes = 0;  // stored as is below
+  }
+  else if (compcode == BLOSC_LZ4) {
+    cbytes = lz4_wrap_compress(thread_context, (char*)src, (size_t)neblock,
+                               (char*)dest, (size_t)maxout, accel);
+  }
+  else if (compcode == BLOSC_LZ4HC) {
+    cbytes = lz4hc_wrap_compress((char*)src, (size_t)neblock,
+                                 (char*)dest, (size_t)maxout, context->clevel);
+  }
+#if defined(HAVE_ZLIB)
+  else if (compcode == BLOSC_ZLIB) {
+    cbytes = zlib_wrap_compress(thread_context, (char*)src, (size_t)neblock,
+                                (char*)dest, (size_t)maxout, context->clevel);
+  }
+#endif /* HAVE_ZLIB */
+#if defined(HAVE_ZSTD)
+  else if (compcode == BLOSC_ZSTD) {
+    cbytes = zstd_wrap_compress(thread_context,
+                                (char*)src, (size_t)neblock,
+                                (char*)dest, (size_t)maxout, context->clevel);
+  }
+#endif /* HAVE_ZSTD */
+  else if (compcode > BLOSC2_DEFINED_CODECS_STOP) {
+    for (int i = 0; i < g_ncodecs; ++i) {
+      if (g_codecs[i].compcode == compcode) {
+        if (g_codecs[i].encoder == NULL) {
+          // Dynamically load codec plugin
+          if (fill_codec(&g_codecs[i]) < 0) {
+            BLOSC_TRACE_ERROR("Could not load codec %d.", g_codecs[i].compcode);
+            return BLOSC2_ERROR_CODEC_SUPPORT;
+          }
+        }
+        blosc2_cparams cparams;
+        blosc2_ctx_get_cparams(context, &cparams);
+        cbytes = g_codecs[i].encoder(src,
+                                      neblock,
+                                      dest,
+                                      maxout,
+                                      context->compcode_meta,
+                                      &cparams,
+                                      context->src);
+        goto urcodecsuccess;
+      }
     }
+    BLOSC_TRACE_ERROR("User-defined compressor codec %d not found during compression", compcode);
+    return BLOSC2_ERROR_CODEC_SUPPORT;
+  urcodecsuccess:
+    ;
+  } else {
+    blosc2_compcode_to_compname(compcode, &compname);
+    BLOSC_TRACE_ERROR("Blosc has not been compiled with '%s' compression support."
+                      "Please use one having it.", compname);
+    return BLOSC2_ERROR_CODEC_SUPPORT;
+  }
+
+  if (cbytes > maxout) {
+    /* Buffer overrun caused by compression (should never happen) */
+    return BLOSC2_ERROR_WRITE_BUFFER;
+  }
+  if (cbytes < 0) {
+    /* cbytes should never be negative */
+    return BLOSC2_ERROR_DATA;
   }
-  /* Look into the remainder */
-  while ((ip < ip_bound) && (*ip == x)) ip++;
-  return ip == ip_bound ? true : false;
+
+  return cbytes;
 }
 
 
@@ -1077,7 +2436,6 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
   int32_t ctbytes = 0;              /* number of compressed bytes in block */
   int32_t maxout;
   int32_t typesize = context->typesize;
-  const char* compname;
   int accel;
   const uint8_t* _src;
   uint8_t *_tmp = tmp, *_tmp2 = tmp2;
@@ -1087,11 +2445,26 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
   bool instr_codec = context->blosc2_flags & BLOSC2_INSTR_CODEC;
   blosc_timestamp_t last, current;
   float filter_time = 0.f;
+  blosc2_ctx_stats* stats = &thread_context->stats;
+  int64_t stage_start = stats_clock();
+  int32_t nraw_streams = 0;
+  int32_t nblock = offset / context->blocksize;
+  BLOSC_HOOK_START(block_start);
 
   if (instr_codec) {
     blosc_set_timestamp(&last);
   }
 
+  summarize_block(context, src + offset, bsize, nblock);
+#if defined(HAVE_ZSTD)
+  if (context->blosc2_flags & BLOSC2_ZSTD_PREFIX) {
+    int rc = start_zstd_prefix(thread_context, nblock);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+#endif /* HAVE_ZSTD */
+
   // See whether we have a run here
   if (last_filter_index >= 0 || context->prefilter != NULL) {
     /* Apply the filter pipeline just for the prefilter */
@@ -1101,6 +2474,10 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
       if (_src == NULL) {
         return BLOSC2_ERROR_FILTER_PIPELINE;
       }
+      stats->filters_ns += stage_lap(thread_context, BLOSC2_TRACE_FILTERS, nblock, bsize, &stage_start);
+      stats->nblocks++;
+      stats->nblocks_raw++;
+      BLOSC_HOOK_END(BLOSC2_TRACE_BLOCK, context, thread_context->tid, nblock, bsize, block_start);
       return bsize;
     }
     /* Apply regular filter pipeline */
@@ -1108,6 +2485,7 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
     if (_src == NULL) {
       return BLOSC2_ERROR_FILTER_PIPELINE;
     }
+    stats->filters_ns += stage_lap(thread_context, BLOSC2_TRACE_FILTERS, nblock, bsize, &stage_start);
   } else {
     _src = src + offset;
   }
@@ -1120,8 +2498,12 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
 
   assert(context->clevel > 0);
 
-  /* Calculate acceleration for different compressors */
-  accel = get_accel(context);
+  /* The codec of this block, and its acceleration */
+  int compcode = pick_block_codec(thread_context, _src, bsize, nblock);
+  if (compcode < 0) {
+    return compcode;
+  }
+  accel = get_accel(context, compcode);
 
   /* The number of compressed data streams for this block */
   if (!dont_split && !leftoverblock && !dict_training) {
@@ -1141,9 +2523,8 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
       ctbytes += sizeof(int32_t);
 
       const uint8_t *ip = (uint8_t *) _src + j * neblock;
-      const uint8_t *ipbound = (uint8_t *) _src + (j + 1) * neblock;
 
-      if (context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH && get_run(ip, ipbound)) {
+      if (context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH && get_run(ip, neblock, 1)) {
         // A run
         int32_t value = _src[j * neblock];
         if (ntbytes > destsize) {
@@ -1172,6 +2553,7 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
           continue;
         }
 
+        stats->nruns++;
         // Encode the repeated byte in the first (LSB) byte of the length of the split.
         _sw32(dest - 4, -value);    // write the value in two's complement
         if (value > 0) {
@@ -1204,75 +2586,11 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
       memcpy(dest, _src + j * neblock, (unsigned int)neblock);
       cbytes = (int32_t)neblock;
     }
-    else if (context->compcode == BLOSC_BLOSCLZ) {
-      cbytes = blosclz_compress(context->clevel, _src + j * neblock,
-                                (int)neblock, dest, maxout, context);
-    }
-    else if (context->compcode == BLOSC_LZ4) {
-      void *hash_table = NULL;
-    #ifdef HAVE_IPP
-      hash_table = (void*)thread_context->lz4_hash_table;
-    #endif
-      cbytes = lz4_wrap_compress((char*)_src + j * neblock, (size_t)neblock,
-                                 (char*)dest, (size_t)maxout, accel, hash_table);
-    }
-    else if (context->compcode == BLOSC_LZ4HC) {
-      cbytes = lz4hc_wrap_compress((char*)_src + j * neblock, (size_t)neblock,
-                                   (char*)dest, (size_t)maxout, context->clevel);
-    }
-  #if defined(HAVE_ZLIB)
-    else if (context->compcode == BLOSC_ZLIB) {
-      cbytes = zlib_wrap_compress((char*)_src + j * neblock, (size_t)neblock,
-                                  (char*)dest, (size_t)maxout, context->clevel);
-    }
-  #endif /* HAVE_ZLIB */
-  #if defined(HAVE_ZSTD)
-    else if (context->compcode == BLOSC_ZSTD) {
-      cbytes = zstd_wrap_compress(thread_context,
-                                  (char*)_src + j * neblock, (size_t)neblock,
-                                  (char*)dest, (size_t)maxout, context->clevel);
-    }
-  #endif /* HAVE_ZSTD */
-    else if (context->compcode > BLOSC2_DEFINED_CODECS_STOP) {
-      for (int i = 0; i < g_ncodecs; ++i) {
-        if (g_codecs[i].compcode == context->compcode) {
-          if (g_codecs[i].encoder == NULL) {
-            // Dynamically load codec plugin
-            if (fill_codec(&g_codecs[i]) < 0) {
-              BLOSC_TRACE_ERROR("Could not load codec %d.", g_codecs[i].compcode);
-              return BLOSC2_ERROR_CODEC_SUPPORT;
-            }
-          }
-          blosc2_cparams cparams;
-          blosc2_ctx_get_cparams(context, &cparams);
-          cbytes = g_codecs[i].encoder(_src + j * neblock,
-                                        neblock,
-                                        dest,
-                                        maxout,
-                                        context->compcode_meta,
-                                        &cparams,
-                                        context->src);
-          goto urcodecsuccess;
-        }
+    else {
+      cbytes = compress_stream(thread_context, compcode, _src + j * neblock, neblock, dest, maxout, accel);
+      if (cbytes < 0) {
+        return cbytes;
       }
-      BLOSC_TRACE_ERROR("User-defined compressor codec %d not found during compression", context->compcode);
-      return BLOSC2_ERROR_CODEC_SUPPORT;
-    urcodecsuccess:
-      ;
-    } else {
-      blosc2_compcode_to_compname(context->compcode, &compname);
-      BLOSC_TRACE_ERROR("Blosc has not been compiled with '%s' compression support."
-                        "Please use one having it.", compname);
-      return BLOSC2_ERROR_CODEC_SUPPORT;
-    }
-
-    if (cbytes > maxout) {
-      /* Buffer overrun caused by compression (should never happen) */
-      return BLOSC2_ERROR_WRITE_BUFFER;
-    }
-    if (cbytes < 0) {
-      /* cbytes should never be negative */
-      return BLOSC2_ERROR_DATA;
     }
     if (cbytes == 0) {
       // When cbytes is 0, the compressor has not been able to compress anything
@@ -1309,19 +2627,245 @@ static int blosc_c(struct thread_context* thread_context, int32_t bsize,
         }
         memcpy(dest, _src + j * neblock, (unsigned int)neblock);
         cbytes = neblock;
+        nraw_streams++;
       }
       _sw32(dest - 4, cbytes);
     }
-    dest += cbytes;
-    ntbytes += cbytes;
-    ctbytes += cbytes;
-  }  /* Closes j < nstreams */
+    dest += cbytes;
+    ntbytes += cbytes;
+    ctbytes += cbytes;
+  }  /* Closes j < nstreams */
+
+#if defined(HAVE_ZSTD)
+  if (context->blosc2_flags & BLOSC2_ZSTD_PREFIX) {
+    int rc = keep_zstd_prefix(thread_context, _src, bsize, nblock);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+#endif /* HAVE_ZSTD */
+  stats->codec_ns += stage_lap(thread_context, BLOSC2_TRACE_CODEC, nblock, bsize, &stage_start);
+  stats->nblocks++;
+  if (nraw_streams == nstreams) {
+    stats->nblocks_raw++;
+  }
+  if (context->block_csizes != NULL) {
+    // Every block is compressed by a single thread
+    context->block_csizes[nblock] = ctbytes;
+  }
+  BLOSC_HOOK_END(BLOSC2_TRACE_BLOCK, context, thread_context->tid, nblock, bsize, block_start);
+
+  return ctbytes;
+}
+
+
+/* Whether the blocks of the chunk being decompressed go to dest with non-temporal stores.
+ * The last filter writes them to a temporary (which stays in the cache) and then they are
+ * streamed to dest, but not for the postfilters or the delta filter, that read dest back. */
+static bool use_stream_dest(blosc2_context* context) {
+  if (context->nontemporal == BLOSC2_NONTEMPORAL_NEVER ||
+      (context->nontemporal == BLOSC2_NONTEMPORAL_AUTO && context->sourcesize < BLOSC2_NONTEMPORAL_THRESHOLD)) {
+    return false;
+  }
+  if (context->postfilter != NULL || context->block_postfilter != NULL ||
+      context->device != BLOSC2_DEVICE_HOST || (context->blosc2_flags & BLOSC2_INSTR_CODEC)) {
+    return false;
+  }
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    if (context->filters[i] == BLOSC_DELTA) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Whether the blocks of the chunk in context are delta coded wrt the first one as decoded
+ * (rather than as stored in the chunk) */
+static bool uses_decoded_dref(blosc2_context* context) {
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    if (context->filters[i] == BLOSC_DELTA && context->filters_meta[i] == BLOSC_DELTA_DREF) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Process the filter pipeline (decompression mode) */
+/* Undo the delta filter of a block into _dest (unshuffling `shuffled` along the way, if not NULL) */
+static void decode_delta_block(const uint8_t* dref, int32_t offset, int32_t bsize, int32_t typesize,
+                               uint8_t meta, const uint8_t* shuffled, uint8_t* _dest) {
+  if (shuffled != NULL) {
+    delta_decoder_unshuffle(dref, offset, bsize, typesize, meta, shuffled, _dest);
+  }
+  else {
+    delta_decoder(dref, offset, bsize, typesize, meta, _dest);
+  }
+}
+
+/* Undo the delta filter `i` of a block, making sure that the reference block is decoded first */
+static void delta_backward(blosc2_context* context, int i, uint8_t* dest, int32_t offset, int32_t bsize,
+                           const uint8_t* shuffled, uint8_t* _dest, int32_t nblock) {
+  int32_t typesize = context->typesize;
+  uint8_t meta = context->filters_meta[i];
+  if (context->dref != NULL) {
+    /* The reference block is at hand already (e.g. stored in the chunk), so there is nothing to wait for */
+    decode_delta_block(context->dref, nblock * context->blocksize, bsize, typesize, meta,
+                       shuffled, _dest);
+    return;
+  }
+  if (context->nthreads == 1 || meta == BLOSC_DELTA_ELEMENTS) {
+    /* Serial mode, or blocks that do not depend on the reference one */
+    decode_delta_block(dest, offset, bsize, typesize, meta, shuffled, _dest);
+    return;
+  }
+  /* Force the thread in charge of the block 0 to go first */
+  pthread_mutex_lock(&context->delta_mutex);
+  if (context->dref_not_init) {
+    if (offset != 0) {
+      pthread_cond_wait(&context->delta_cv, &context->delta_mutex);
+    } else {
+      decode_delta_block(dest, offset, bsize, typesize, meta, shuffled, _dest);
+      context->dref_not_init = 0;
+      pthread_cond_broadcast(&context->delta_cv);
+    }
+  }
+  pthread_mutex_unlock(&context->delta_mutex);
+  if (offset != 0) {
+    decode_delta_block(dest, offset, bsize, typesize, meta, shuffled, _dest);
+  }
+}
+
+/* Whether the decompressed blocks go through a postfilter before reaching dest */
+static inline bool has_postfilter(blosc2_context* context) {
+  return context->postfilter != NULL || context->block_states != NULL;
+}
+
+/* Run the block postfilter on a block, copying it to the output first (unless discarded) */
+static int run_block_postfilter(struct thread_context* thread_context, const uint8_t* input,
+                                uint8_t* output, int32_t bsize, int32_t nblock) {
+  blosc2_context* context = thread_context->parent_context;
+  blosc2_block_postfilter* block_postfilter = context->block_postfilter;
+  int32_t tid = thread_context->tid;
+  if (tid >= context->block_nstates) {
+    BLOSC_TRACE_ERROR("There is no state for the thread %d of the block postfilter", tid);
+    return BLOSC2_ERROR_POSTFILTER;
+  }
+
+  if (block_postfilter->discard) {
+    output = NULL;
+  }
+  else {
+    memcpy(output, input, bsize);
+  }
+  if (((uintptr_t)input % BLOSC2_BLOCK_POSTFILTER_ALIGN) != 0) {
+    // The temporaries of the filter pipeline are not aligned in general
+    if (thread_context->block_input == NULL) {
+      thread_context->block_input = ctx_malloc(context, thread_context->tmp_blocksize);
+      BLOSC_ERROR_NULL(thread_context->block_input, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+    memcpy(thread_context->block_input, input, bsize);
+    input = thread_context->block_input;
+  }
 
-  return ctbytes;
+  struct blosc_block_state* state = &context->block_states[tid];
+  if (!state->started) {
+    if (block_postfilter->init != NULL &&
+        block_postfilter->init(block_postfilter->user_data, tid, &state->state) != 0) {
+      BLOSC_TRACE_ERROR("Initialization of the block postfilter state failed");
+      return BLOSC2_ERROR_POSTFILTER;
+    }
+    state->started = true;
+  }
+
+  blosc2_block_postfilter_params params;
+  params.user_data = block_postfilter->user_data;
+  params.state = state->state;
+  params.input = input;
+  params.output = output;
+  params.nitems = bsize / context->typesize;
+  params.typesize = context->typesize;
+  params.start = nblock * (context->blocksize / context->typesize);
+  params.nchunk = get_current_nchunk(context);
+  params.nblock = nblock;
+  params.tid = tid;
+  params.ctx = context;
+  int rc = block_postfilter->block(&params);
+  // The kernel may replace its state
+  state->state = params.state;
+  if (rc != 0) {
+    BLOSC_TRACE_ERROR("Execution of block postfilter function failed");
+    return BLOSC2_ERROR_POSTFILTER;
+  }
+  return 0;
+}
+
+/* Check a block that has been decompressed whole against its checksum, if it has to */
+static int verify_block(struct thread_context* thread_context, const uint8_t* block, int32_t bsize,
+                        int32_t nblock) {
+  blosc2_context* context = thread_context->parent_context;
+  if (context->src_checksums == NULL || thread_context->cell_nitems > 0) {
+    return 0;
+  }
+  // The block is still in cache, so this is much cheaper than another pass over the chunk
+  uint64_t checksum = checksum_xxh3(block, bsize);
+  if (checksum != checksum_load(context->src_checksums + (int64_t)nblock * BLOSC2_CHECKSUM_SIZE)) {
+    BLOSC_TRACE_ERROR("The checksum of block %d does not match its contents.", nblock);
+    return BLOSC2_ERROR_CHECKSUM;
+  }
+  return 0;
 }
 
+/* Run the postfilter on a block that has been decompressed in input */
+static int run_postfilter(struct thread_context* thread_context, const uint8_t* input, uint8_t* output,
+                          int32_t bsize, int32_t nblock) {
+  blosc2_context* context = thread_context->parent_context;
+  if (context->postfilter == NULL) {
+    return run_block_postfilter(thread_context, input, output, bsize, nblock);
+  }
+
+  // Create new postfilter parameters for this block (must be private for each thread)
+  blosc2_postfilter_params postparams;
+  memcpy(&postparams, context->postparams, sizeof(postparams));
+  postparams.input = input;
+  postparams.output = output;
+  postparams.size = bsize;
+  postparams.typesize = context->typesize;
+  postparams.offset = nblock * context->blocksize;
+  postparams.nchunk = get_current_nchunk(context);
+  postparams.nblock = nblock;
+  postparams.tid = thread_context->tid;
+  postparams.ttmp = thread_context->tmp;
+  postparams.ttmp_nbytes = thread_context->tmp_nbytes;
+  postparams.ctx = context;
+
+  if (context->postfilter(&postparams) != 0) {
+    BLOSC_TRACE_ERROR("Execution of postfilter function failed");
+    return BLOSC2_ERROR_POSTFILTER;
+  }
+  return 0;
+}
+
+/* The index of the DELTA that comes right after the (single) SHUFFLE `current` in the
+   backward pipeline if both can be fused for this block, and -1 otherwise */
+static int fused_delta(blosc2_context* context, int current, int last_filter_index, int32_t bsize) {
+  if (context->filters_meta[current] != 0 || has_postfilter(context)) {
+    return -1;
+  }
+  int i = current - 1;
+  while (i >= 0 && do_nothing(context->filters[i], 'd')) {
+    i--;
+  }
+  // The delta has to be the last filter, so that it is decoded right into dest
+  if (i < 0 || i != last_filter_index || context->filters[i] != BLOSC_DELTA ||
+      context->filters_meta[i] > BLOSC_DELTA_DREF_STORED) {
+    return -1;
+  }
+  if ((bsize % context->typesize) != 0 || !shuffle_tile_accelerated(context->typesize)) {
+    return -1;
+  }
+  return i;
+}
 
-/* Process the filter pipeline (decompression mode) */
 int pipeline_backward(struct thread_context* thread_context, const int32_t bsize, uint8_t* dest,
                       const int32_t offset, uint8_t* src, uint8_t* tmp,
                       uint8_t* tmp2, int last_filter_index, int32_t nblock) {
@@ -1337,13 +2881,20 @@ int pipeline_backward(struct thread_context* thread_context, const int32_t bsize
   for (int i = BLOSC2_MAX_FILTERS - 1; i >= 0; i--) {
     // Delta filter requires the whole chunk ready
     int last_copy_filter = (last_filter_index == i) || (next_filter(filters, i, 'd') == BLOSC_DELTA);
-    if (last_copy_filter && context->postfilter == NULL) {
+    if (last_copy_filter && !has_postfilter(context) && !context->stream_dest) {
       _dest = dest + offset;
     }
     int rc = BLOSC2_ERROR_SUCCESS;
+    // The delta that is undone along with the unshuffle (if any)
+    int fused = -1;
     if (filters[i] <= BLOSC2_DEFINED_FILTERS_STOP) {
       switch (filters[i]) {
         case BLOSC_SHUFFLE:
+          fused = fused_delta(context, i, last_filter_index, bsize);
+          if (fused >= 0) {
+            delta_backward(context, fused, dest, offset, bsize, _src, _dest, nblock);
+            break;
+          }
           for (int j = 0; j <= filters_meta[i]; j++) {
             unshuffle(typesize, bsize, _src, _dest);
             // Cycle filters when required
@@ -1351,7 +2902,7 @@ int pipeline_backward(struct thread_context* thread_context, const int32_t bsize
               _cycle_buffers(&_src, &_dest, &_tmp);
             }
             // Check whether we have to copy the intermediate _dest buffer to final destination
-            if (last_copy_filter && (filters_meta[i] % 2) == 1 && j == filters_meta[i]) {
+            if (last_copy_filter && !context->stream_dest && (filters_meta[i] % 2) == 1 && j == filters_meta[i]) {
               memcpy(dest + offset, _dest, (unsigned int) bsize);
             }
           }
@@ -1362,26 +2913,11 @@ int pipeline_backward(struct thread_context* thread_context, const int32_t bsize
           }
           break;
         case BLOSC_DELTA:
-          if (context->nthreads == 1) {
-            /* Serial mode */
-            delta_decoder(dest, offset, bsize, typesize, _dest);
-          } else {
-            /* Force the thread in charge of the block 0 to go first */
-            pthread_mutex_lock(&context->delta_mutex);
-            if (context->dref_not_init) {
-              if (offset != 0) {
-                pthread_cond_wait(&context->delta_cv, &context->delta_mutex);
-              } else {
-                delta_decoder(dest, offset, bsize, typesize, _dest);
-                context->dref_not_init = 0;
-                pthread_cond_broadcast(&context->delta_cv);
-              }
-            }
-            pthread_mutex_unlock(&context->delta_mutex);
-            if (offset != 0) {
-              delta_decoder(dest, offset, bsize, typesize, _dest);
-            }
+          if (filters_meta[i] > BLOSC_DELTA_DREF_STORED) {
+            BLOSC_TRACE_ERROR("Unknown mode (%d) for the delta filter.", filters_meta[i]);
+            return BLOSC2_ERROR_FILTER_PIPELINE;
           }
+          delta_backward(context, i, dest, offset, bsize, NULL, _dest, nblock);
           break;
         case BLOSC_TRUNC_PREC:
           // TRUNC_PREC filter does not need to be undone
@@ -1428,31 +2964,28 @@ int pipeline_backward(struct thread_context* thread_context, const int32_t bsize
     if ((filters[i] != BLOSC_NOFILTER) && (filters[i] != BLOSC_TRUNC_PREC)) {
       _cycle_buffers(&_src, &_dest, &_tmp);
     }
+    if (fused >= 0) {
+      // The delta is already undone
+      i = fused;
+    }
     if (last_filter_index == i) {
       break;
     }
   }
 
+  if (context->stream_dest) {
+    fastcopy_stream(dest + offset, _src, (unsigned) bsize);
+  }
+
   /* Postfilter function */
-  if (context->postfilter != NULL) {
-    // Create new postfilter parameters for this block (must be private for each thread)
-    blosc2_postfilter_params postparams;
-    memcpy(&postparams, context->postparams, sizeof(postparams));
-    postparams.input = _src;
-    postparams.output = dest + offset;
-    postparams.size = bsize;
-    postparams.typesize = typesize;
-    postparams.offset = nblock * context->blocksize;
-    postparams.nchunk = context->schunk != NULL ? context->schunk->current_nchunk : -1;
-    postparams.nblock = nblock;
-    postparams.tid = thread_context->tid;
-    postparams.ttmp = thread_context->tmp;
-    postparams.ttmp_nbytes = thread_context->tmp_nbytes;
-    postparams.ctx = context;
-
-    if (context->postfilter(&postparams) != 0) {
-      BLOSC_TRACE_ERROR("Execution of postfilter function failed");
-      return BLOSC2_ERROR_POSTFILTER;
+  if (has_postfilter(context)) {
+    int rc = verify_block(thread_context, _src, bsize, nblock);
+    if (rc < 0) {
+      return rc;
+    }
+    rc = run_postfilter(thread_context, _src, dest + offset, bsize, nblock);
+    if (rc < 0) {
+      return rc;
     }
   }
 
@@ -1550,6 +3083,347 @@ static int32_t set_values(int32_t typesize, const uint8_t* src, uint8_t* dest, i
 }
 
 
+/* Open the file holding the blocks of the lazy chunk nchunk of the frame of context. */
+static void* open_lazy_chunk(blosc2_context* context, blosc2_io_cb* io_cb, int32_t nchunk) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)context->schunk->frame;
+  void* fp;
+  if (frame->sframe) {
+    // The chunk is not in the frame, but in a file of its own or in its shard
+    fp = sframe_open_file(frame, nchunk, "rb");
+  }
+  else {
+    fp = io_cb->open(frame->urlpath, "rb", context->schunk->storage->io->params);
+  }
+  return fp;
+}
+
+
+/* The offset of the trailer of a lazy chunk, which follows the bstarts (and the
+ * reference to the shared dictionary, the codecs of the blocks and the reference block
+ * of the delta filter, if any) */
+static size_t get_lazy_trailer_offset(blosc2_context* context) {
+  size_t trailer_offset = BLOSC_EXTENDED_HEADER_LENGTH + context->nblocks * sizeof(int32_t);
+  if ((context->blosc2_flags & BLOSC2_USEDICT) && !(context->header_flags & (uint8_t)BLOSC_MEMCPYED)) {
+    trailer_offset += sizeof(int32_t);
+  }
+  if (is_hybrid_chunk(context->header_flags)) {
+    trailer_offset += context->nblocks;
+  }
+  trailer_offset += stored_dref_len(context->src);
+  return trailer_offset;
+}
+
+
+/* The size of the checksums that end the chunk in context */
+static int32_t get_checksums_len(blosc2_context* context) {
+  if (context->chunk_checksum != BLOSC2_CHECKSUM_XXH3 || context->special_type) {
+    return 0;
+  }
+  return context->nblocks * BLOSC2_CHECKSUM_SIZE;
+}
+
+
+/* The size of the cipher data that ends the chunk in context */
+static int32_t get_cipher_len(blosc2_context* context) {
+  if (context->chunk_cipher == BLOSC2_CIPHER_NONE || context->special_type) {
+    return 0;
+  }
+  return cipher_data_len(context->nblocks);
+}
+
+/* Point to the cipher data of src, which lazy chunks keep after the checksums of their
+ * trailer, and check that its blocks can be decrypted */
+static int setup_src_cipher(blosc2_context* context, const uint8_t* src, int32_t srcsize) {
+  context->src_cipher = NULL;
+  int32_t cipher_len = get_cipher_len(context);
+  if (cipher_len == 0) {
+    return 0;
+  }
+  if (context->chunk_cipher != BLOSC2_CIPHER_CHACHA20_POLY1305) {
+    BLOSC_TRACE_ERROR("The cipher (%d) of the chunk is not supported.", context->chunk_cipher);
+    return BLOSC2_ERROR_DATA;
+  }
+  if (!context->has_cipher_key) {
+    BLOSC_TRACE_ERROR("The chunk is encrypted, but there is no cipher_key in dparams.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+#if defined(HAVE_CUDA)
+  if (context->device == BLOSC2_DEVICE_CUDA) {
+    BLOSC_TRACE_ERROR("Encrypted chunks cannot be decompressed on the GPU.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+#endif
+  int64_t offset;
+  if (context->blosc2_flags & 0x08u) {
+    offset = (int64_t)get_lazy_trailer_offset(context) + sizeof(int32_t) + sizeof(int64_t) +
+             context->nblocks * sizeof(int32_t) + get_checksums_len(context);
+  }
+  else {
+    offset = sw32_(src + BLOSC2_CHUNK_CBYTES) - cipher_len;
+  }
+  if (offset < context->header_overhead || offset + cipher_len > srcsize) {
+    BLOSC_TRACE_ERROR("The cipher data of the blocks is out of the chunk.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  context->src_cipher = src + offset;
+  build_cipher_aad(src, context->header_flags, context->cipher_aad);
+  return 0;
+}
+
+
+/* Point to the checksums of the blocks of src if they have to be verified.  Lazy chunks
+ * keep them after the csizes of their trailer. */
+static int setup_src_checksums(blosc2_context* context, const uint8_t* src, int32_t srcsize) {
+  context->src_checksums = NULL;
+  int32_t checksums_len = get_checksums_len(context);
+  if (!context->verify_checksums || checksums_len == 0) {
+    return 0;
+  }
+  int64_t offset;
+  if (context->blosc2_flags & 0x08u) {
+    offset = (int64_t)get_lazy_trailer_offset(context) + sizeof(int32_t) + sizeof(int64_t) +
+             context->nblocks * sizeof(int32_t);
+  }
+  else {
+    offset = sw32_(src + BLOSC2_CHUNK_CBYTES) - get_cipher_len(context) - checksums_len;
+  }
+  if (offset < context->header_overhead || offset + checksums_len > srcsize) {
+    BLOSC_TRACE_ERROR("The checksums of the blocks are out of the chunk.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  context->src_checksums = src + offset;
+  return 0;
+}
+
+
+/* Open the stream that the threads will share for reading the blocks of a lazy chunk.
+ * This needs positional reads; otherwise (or if the chunk is not lazy) NULL is returned,
+ * and every block read opens its own stream. */
+static void* open_shared_lazy_stream(blosc2_context* context, const uint8_t* src, int32_t srcsize) {
+  bool is_lazy = ((context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) &&
+                  (context->blosc2_flags & 0x08u) && !context->special_type);
+  if (!is_lazy || context->schunk == NULL || context->schunk->frame == NULL) {
+    return NULL;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(context->schunk->storage->io->id);
+  if (io_cb == NULL || io_cb_ext(io_cb)->pread == NULL) {
+    return NULL;
+  }
+  size_t trailer_offset = get_lazy_trailer_offset(context);
+  if ((int64_t)trailer_offset + (int64_t)sizeof(int32_t) > srcsize) {
+    return NULL;
+  }
+  int32_t nchunk = *(int32_t*)(src + trailer_offset);
+  return open_lazy_chunk(context, io_cb, nchunk);
+}
+
+
+/* The bytes of the blocks of a lazy chunk that are read at a time when reading them ahead:
+ * the first reads are small, so that the decompression starts soon, and the next ones
+ * larger, so that there are not many of them */
+#define LAZY_READAHEAD_MINBYTES (256 * 1024)
+#define LAZY_READAHEAD_MAXBYTES (4 * 1024 * 1024)
+
+/* The blocks of a lazy chunk that are read by a thread of their own while the ones read
+ * already are decompressed */
+typedef struct {
+  blosc2_context* context;
+  blosc2_io_cb* io_cb;
+  int32_t nchunk;
+  blosc2_io_vec* vecs;  // in the order of the blocks in lazy_buffer
+  int32_t nvecs;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int64_t nbytes_read;  // the bytes of lazy_buffer that are read
+  int rc;
+  int64_t nreads;
+} lazy_readahead;
+
+static void* lazy_readahead_thread(void* data) {
+  lazy_readahead* ra = (lazy_readahead*)data;
+  blosc2_context* context = ra->context;
+  void* fp = context->lazy_stream;
+  if (fp == NULL) {
+    fp = open_lazy_chunk(context, ra->io_cb, ra->nchunk);
+  }
+  int rc = fp != NULL ? 0 : BLOSC2_ERROR_FILE_OPEN;
+  int64_t batch_bytes = LAZY_READAHEAD_MINBYTES;
+  for (int32_t i = 0; i < ra->nvecs && rc >= 0;) {
+    int32_t nvecs = 0;
+    int64_t nbytes = 0;
+    while (i + nvecs < ra->nvecs && (nvecs == 0 || nbytes + ra->vecs[i + nvecs].size <= batch_bytes)) {
+      nbytes += ra->vecs[i + nvecs].size;
+      nvecs++;
+    }
+    int64_t rbytes = io_preadv(ra->io_cb, ra->vecs + i, nvecs, fp);
+    if (rbytes != nbytes) {
+      BLOSC_TRACE_ERROR("Cannot read the (lazy) blocks out of the fileframe.");
+      rc = BLOSC2_ERROR_READ_BUFFER;
+    }
+    i += nvecs;
+    batch_bytes = batch_bytes * 2 < LAZY_READAHEAD_MAXBYTES ? batch_bytes * 2 : LAZY_READAHEAD_MAXBYTES;
+    pthread_mutex_lock(&ra->mutex);
+    if (rc < 0) {
+      ra->rc = rc;
+    }
+    else {
+      ra->nbytes_read += nbytes;
+      ra->nreads++;
+    }
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->mutex);
+  }
+  if (fp != NULL && fp != context->lazy_stream) {
+    ra->io_cb->close(fp);
+  }
+  return NULL;
+}
+
+/* Wait for a block of a lazy chunk that is being read ahead */
+static int wait_lazy_block(blosc2_context* context, int32_t nblock, int32_t block_csize) {
+  lazy_readahead* ra = (lazy_readahead*)context->lazy_readahead;
+  if (ra == NULL) {
+    return 0;
+  }
+  int64_t block_end = context->lazy_blocks[nblock] - context->lazy_buffer + block_csize;
+  pthread_mutex_lock(&ra->mutex);
+  while (ra->rc == 0 && ra->nbytes_read < block_end) {
+    pthread_cond_wait(&ra->cond, &ra->mutex);
+  }
+  int rc = ra->rc;
+  pthread_mutex_unlock(&ra->mutex);
+  return rc;
+}
+
+/* Read the blocks [first, stop) of a lazy chunk, but the masked out ones, with a single
+ * vectored read, instead of a read per block from blosc_d().  Nothing is read (and 0 is
+ * returned) when there is nothing to gain.  With `ahead`, the blocks that do not fit in
+ * a single read are read by a thread of their own, while blosc_d() decompresses the ones
+ * read already. */
+static int prefetch_lazy_blocks(blosc2_context* context, const uint8_t* src, int32_t srcsize,
+                                bool memcpyed, int32_t first, int32_t stop, bool ahead) {
+  bool is_lazy = ((context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) &&
+                  (context->blosc2_flags & 0x08u) && !context->special_type);
+  if (!is_lazy || context->schunk == NULL || context->schunk->frame == NULL) {
+    return 0;
+  }
+  size_t trailer_offset = get_lazy_trailer_offset(context);
+  int64_t csizes_offset = (int64_t)trailer_offset + sizeof(int32_t) + sizeof(int64_t);
+  if (csizes_offset + context->nblocks * (int64_t)sizeof(int32_t) > srcsize) {
+    return 0;
+  }
+  int32_t nchunk = *(int32_t*)(src + trailer_offset);
+  int64_t chunk_offset = *(int64_t*)(src + trailer_offset + sizeof(int32_t));
+  int32_t* block_csizes = (int32_t*)(src + csizes_offset);
+  int32_t nvecs = 0;
+  int64_t nbytes = 0;
+  for (int32_t j = first; j < stop; j++) {
+    if (context->block_maskout == NULL || !context->block_maskout[j]) {
+      nvecs++;
+      nbytes += block_csizes[j];
+    }
+  }
+  if (nvecs < 2) {
+    return 0;
+  }
+  blosc2_io_cb* io_cb = blosc2_get_io_cb(context->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+
+  blosc2_frame_s* frame = (blosc2_frame_s*)context->schunk->frame;
+  context->lazy_blocks = ctx_malloc(context, context->nblocks * sizeof(uint8_t*));
+  context->lazy_buffer = ctx_malloc(context, nbytes);
+  blosc2_io_vec* vecs = ctx_malloc(context, nvecs * sizeof(blosc2_io_vec));
+  if (context->lazy_blocks == NULL || context->lazy_buffer == NULL || vecs == NULL) {
+    ctx_free(context, vecs);
+    BLOSC_TRACE_ERROR("Error allocating memory!");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  memset(context->lazy_blocks, 0, context->nblocks * sizeof(uint8_t*));
+  uint8_t* block = context->lazy_buffer;
+  int32_t i = 0;
+  for (int32_t j = first; j < stop; j++) {
+    if (context->block_maskout != NULL && context->block_maskout[j]) {
+      continue;
+    }
+    // The same offsets of the blocks than in blosc_d()
+    int64_t position = memcpyed ? context->header_overhead + (int64_t)j * context->blocksize :
+                       sw32_(context->bstarts + j);
+    // The chunks of sparse frames start at chunk_offset of their file
+    position += frame->sframe ? chunk_offset : frame->file_offset + chunk_offset;
+    vecs[i].ptr = block;
+    vecs[i].size = block_csizes[j];
+    vecs[i].position = position;
+    context->lazy_blocks[j] = block;
+    block += block_csizes[j];
+    i++;
+  }
+
+  lazy_readahead* ra = NULL;
+  if (ahead && nbytes > LAZY_READAHEAD_MINBYTES) {
+    ra = ctx_malloc(context, sizeof(lazy_readahead));
+  }
+  if (ra != NULL) {
+    memset(ra, 0, sizeof(lazy_readahead));
+    ra->context = context;
+    ra->io_cb = io_cb;
+    ra->nchunk = nchunk;
+    ra->vecs = vecs;
+    ra->nvecs = nvecs;
+    pthread_mutex_init(&ra->mutex, NULL);
+    pthread_cond_init(&ra->cond, NULL);
+    if (pthread_create(&ra->thread, NULL, lazy_readahead_thread, ra) == 0) {
+      context->lazy_readahead = ra;
+      return 0;
+    }
+    // Without a thread, the blocks are just read right away
+    pthread_mutex_destroy(&ra->mutex);
+    pthread_cond_destroy(&ra->cond);
+    ctx_free(context, ra);
+  }
+
+  void* fp = context->lazy_stream;
+  if (fp == NULL) {
+    fp = open_lazy_chunk(context, io_cb, nchunk);
+  }
+  int64_t rbytes = fp != NULL ? io_preadv(io_cb, vecs, nvecs, fp) : BLOSC2_ERROR_FILE_OPEN;
+  if (fp != NULL && fp != context->lazy_stream) {
+    io_cb->close(fp);
+  }
+  ctx_free(context, vecs);
+  if (rbytes != nbytes) {
+    BLOSC_TRACE_ERROR("Cannot read the (lazy) blocks out of the fileframe.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  context->stats.lazy_reads++;
+  context->stats.lazy_read_bytes += rbytes;
+  return 0;
+}
+
+
+static void free_lazy_blocks(blosc2_context* context) {
+  lazy_readahead* ra = (lazy_readahead*)context->lazy_readahead;
+  if (ra != NULL) {
+    // The reads that nobody waits for (after an error) are over before the buffer goes away
+    pthread_join(ra->thread, NULL);
+    context->stats.lazy_reads += ra->nreads;
+    context->stats.lazy_read_bytes += ra->nbytes_read;
+    pthread_mutex_destroy(&ra->mutex);
+    pthread_cond_destroy(&ra->cond);
+    ctx_free(context, ra->vecs);
+    ctx_free(context, ra);
+    context->lazy_readahead = NULL;
+  }
+  ctx_free(context, context->lazy_blocks);
+  ctx_free(context, context->lazy_buffer);
+  context->lazy_blocks = NULL;
+  context->lazy_buffer = NULL;
+}
+
+
 /* Decompress & unshuffle a single block */
 static int blosc_d(
     struct thread_context* thread_context, int32_t bsize,
@@ -1573,12 +3447,20 @@ static int blosc_d(
   bool instr_codec = context->blosc2_flags & BLOSC2_INSTR_CODEC;
   const char* compname;
   int rc;
+  bool partial = false;          /* whether the codec only decoded part of the block */
 
-  if (context->block_maskout != NULL && context->block_maskout[nblock]) {
+  if (context->block_maskout != NULL && context->block_maskout[nblock] &&
+      !(context->blosc2_flags & BLOSC2_ZSTD_PREFIX)) {
     // Do not decompress, but act as if we successfully decompressed everything
+    // (the blocks with a zstd prefix are needed by the next one, though)
     return bsize;
   }
 
+  BLOSC_HOOK_START(block_start);
+  blosc2_ctx_stats* stats = &thread_context->stats;
+  int64_t stage_start = stats_clock();
+  int32_t nraw_streams = 0;
+
   rc = blosc2_cbuffer_sizes(src, &chunk_nbytes, &chunk_cbytes, NULL);
   if (rc < 0) {
     return rc;
@@ -1590,6 +3472,11 @@ static int blosc_d(
     context->src = src;
   }
 
+  if (context->block_codecs != NULL) {
+    // The codec of the block in hybrid chunks
+    compformat = block_codec_to_compformat(context->block_codecs[nblock]);
+  }
+
   // Chunks with special values cannot be lazy
   bool is_lazy = ((context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) &&
           (context->blosc2_flags & 0x08u) && !context->special_type);
@@ -1604,8 +3491,7 @@ static int blosc_d(
       return BLOSC2_ERROR_INVALID_PARAM;
     }
     blosc2_frame_s* frame = (blosc2_frame_s*)context->schunk->frame;
-    char* urlpath = frame->urlpath;
-    size_t trailer_offset = BLOSC_EXTENDED_HEADER_LENGTH + context->nblocks * sizeof(int32_t);
+    size_t trailer_offset = get_lazy_trailer_offset(context);
     int32_t nchunk;
     int64_t chunk_offset;
     // The nchunk and the offset of the current chunk are in the trailer
@@ -1614,48 +3500,91 @@ static int blosc_d(
     // Get the csize of the nblock
     int32_t *block_csizes = (int32_t *)(src + trailer_offset + sizeof(int32_t) + sizeof(int64_t));
     int32_t block_csize = block_csizes[nblock];
-    // Read the lazy block on disk
-    void* fp = NULL;
-    blosc2_io_cb *io_cb = blosc2_get_io_cb(context->schunk->storage->io->id);
-    if (io_cb == NULL) {
-      BLOSC_TRACE_ERROR("Error getting the input/output API");
-      return BLOSC2_ERROR_PLUGIN_IO;
-    }
-
-    if (frame->sframe) {
-      // The chunk is not in the frame
-      char* chunkpath = malloc(strlen(frame->urlpath) + 1 + 8 + strlen(".chunk") + 1);
-      BLOSC_ERROR_NULL(chunkpath, BLOSC2_ERROR_MEMORY_ALLOC);
-      sprintf(chunkpath, "%s/%08X.chunk", frame->urlpath, nchunk);
-      fp = io_cb->open(chunkpath, "rb", context->schunk->storage->io->params);
-      BLOSC_ERROR_NULL(fp, BLOSC2_ERROR_FILE_OPEN);
-      free(chunkpath);
-      // The offset of the block is src_offset
-      io_cb->seek(fp, src_offset, SEEK_SET);
+    if (context->lazy_blocks != NULL && context->lazy_blocks[nblock] != NULL) {
+      // The block has been read in advance (see prefetch_lazy_blocks), or it is being read
+      int rc = wait_lazy_block(context, nblock, block_csize);
+      if (rc < 0) {
+        return rc;
+      }
+      src = context->lazy_blocks[nblock];
     }
     else {
-      fp = io_cb->open(urlpath, "rb", context->schunk->storage->io->params);
-      BLOSC_ERROR_NULL(fp, BLOSC2_ERROR_FILE_OPEN);
-      // The offset of the block is src_offset
-      io_cb->seek(fp, frame->file_offset + chunk_offset + src_offset, SEEK_SET);
+      // Read the lazy block on disk
+      blosc2_io_cb *io_cb = blosc2_get_io_cb(context->schunk->storage->io->id);
+      if (io_cb == NULL) {
+        BLOSC_TRACE_ERROR("Error getting the input/output API");
+        return BLOSC2_ERROR_PLUGIN_IO;
+      }
+
+      // Use the stream shared by all the threads, if any
+      void* fp = context->lazy_stream;
+      if (fp == NULL) {
+        fp = open_lazy_chunk(context, io_cb, nchunk);
+        BLOSC_ERROR_NULL(fp, BLOSC2_ERROR_FILE_OPEN);
+      }
+      // The offset of the block is src_offset (from where the chunk starts in its file for sframes)
+      int64_t block_position = src_offset;
+      block_position += frame->sframe ? chunk_offset : frame->file_offset + chunk_offset;
+      // We can make use of tmp3 because it will be used after src is not needed anymore
+      int64_t rbytes = io_pread(io_cb, tmp3, 1, block_csize, block_position, fp);
+      if (fp != context->lazy_stream) {
+        io_cb->close(fp);
+      }
+      if ((int32_t)rbytes != block_csize) {
+        BLOSC_TRACE_ERROR("Cannot read the (lazy) block out of the fileframe.");
+        return BLOSC2_ERROR_READ_BUFFER;
+      }
+      stats->lazy_reads++;
+      stats->lazy_read_bytes += rbytes;
+      // The time of the read is not the one of any stage
+      stage_lap(thread_context, BLOSC2_TRACE_LAZY_READ, nblock, block_csize, &stage_start);
+      src = tmp3;
     }
-    // We can make use of tmp3 because it will be used after src is not needed anymore
-    int64_t rbytes = io_cb->read(tmp3, 1, block_csize, fp);
-    io_cb->close(fp);
-    if ((int32_t)rbytes != block_csize) {
-      BLOSC_TRACE_ERROR("Cannot read the (lazy) block out of the fileframe.");
-      return BLOSC2_ERROR_READ_BUFFER;
+    src_offset = 0;
+    srcsize = block_csize;
+  }
+
+  // The blocks of encrypted chunks are authenticated and decrypted into tmp3 first
+  bool in_tmp = is_lazy;
+  if (context->src_cipher != NULL) {
+    const uint8_t* block_cipher = context->src_cipher + BLOSC2_CIPHER_NONCE_SIZE + (int64_t)nblock * CIPHER_BLOCK_SIZE;
+    int32_t block_csize = sw32_(block_cipher);
+    if (!is_lazy) {
+      if (memcpyed) {
+        src_offset = context->header_overhead + nblock * context->blocksize;
+      }
+      if (src_offset <= 0 || src_offset >= srcsize) {
+        return BLOSC2_ERROR_DATA;
+      }
+      src += src_offset;
+      srcsize -= src_offset;
+    }
+    if (block_csize <= 0 || block_csize > srcsize ||
+        (size_t)block_csize > thread_context->tmp_nbytes / 4) {
+      BLOSC_TRACE_ERROR("The encrypted block %d is out of the chunk.", nblock);
+      return BLOSC2_ERROR_DATA;
     }
+    uint8_t nonce[BLOSC2_CIPHER_NONCE_SIZE];
+    build_block_nonce(context->src_cipher, nblock, nonce);
+    rc = cipher_open(context->cipher_key, nonce, context->cipher_aad, CIPHER_AAD_SIZE,
+                     src, tmp3, block_csize, block_cipher + sizeof(int32_t));
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Block %d does not authenticate (wrong key or tampered data).", nblock);
+      return rc;
+    }
+    stats->cipher_ns += stage_lap(thread_context, BLOSC2_TRACE_CIPHER, nblock, block_csize, &stage_start);
     src = tmp3;
     src_offset = 0;
     srcsize = block_csize;
+    in_tmp = true;
   }
 
   // If the chunk is memcpyed, we just have to copy the block to dest and return
   if (memcpyed) {
     int bsize_ = leftoverblock ? chunk_nbytes % context->blocksize : bsize;
     if (!context->special_type) {
-      if (chunk_nbytes + context->header_overhead != chunk_cbytes) {
+      if (chunk_nbytes + context->header_overhead + get_checksums_len(context) + get_cipher_len(context) !=
+          chunk_cbytes) {
         return BLOSC2_ERROR_WRITE_BUFFER;
       }
       if (chunk_cbytes < context->header_overhead + (nblock * context->blocksize) + bsize_) {
@@ -1663,11 +3592,11 @@ static int blosc_d(
         return BLOSC2_ERROR_READ_BUFFER;
       }
     }
-    if (!is_lazy) {
+    if (!in_tmp) {
       src += context->header_overhead + nblock * context->blocksize;
     }
     _dest = dest + dest_offset;
-    if (context->postfilter != NULL) {
+    if (has_postfilter(context)) {
       // We are making use of a postfilter, so use a temp for destination
       _dest = tmp;
     }
@@ -1694,37 +3623,44 @@ static int blosc_d(
       case BLOSC2_SPECIAL_UNINIT:
         // We do nothing here
         break;
+      case BLOSC2_SPECIAL_VIRTUAL:
+        // The values are generated by the postfilter out of zeros
+        if (!has_postfilter(context)) {
+          BLOSC_TRACE_ERROR("Virtual chunks can only be decompressed with a postfilter");
+          return BLOSC2_ERROR_POSTFILTER;
+        }
+        memset(_dest, 0, bsize_);
+        break;
       default:
-        memcpy(_dest, src, bsize_);
-    }
-    if (context->postfilter != NULL) {
-      // Create new postfilter parameters for this block (must be private for each thread)
-      blosc2_postfilter_params postparams;
-      memcpy(&postparams, context->postparams, sizeof(postparams));
-      postparams.input = tmp;
-      postparams.output = dest + dest_offset;
-      postparams.size = bsize;
-      postparams.typesize = typesize;
-      postparams.offset = nblock * context->blocksize;
-      postparams.nchunk = context->schunk != NULL ? context->schunk->current_nchunk : -1;
-      postparams.nblock = nblock;
-      postparams.tid = thread_context->tid;
-      postparams.ttmp = thread_context->tmp;
-      postparams.ttmp_nbytes = thread_context->tmp_nbytes;
-      postparams.ctx = context;
-
+        if (context->stream_dest) {
+          fastcopy_stream(_dest, src, (unsigned) bsize_);
+        }
+        else {
+          memcpy(_dest, src, bsize_);
+        }
+        stats->memcpy_ns += stage_lap(thread_context, BLOSC2_TRACE_MEMCPY, nblock, bsize_, &stage_start);
+        stats->nblocks++;
+        stats->nblocks_raw++;
+        rc = verify_block(thread_context, _dest, bsize_, nblock);
+        if (rc < 0) {
+          return rc;
+        }
+    }
+    if (has_postfilter(context)) {
       // Execute the postfilter (the processed block will be copied to dest)
-      if (context->postfilter(&postparams) != 0) {
-        BLOSC_TRACE_ERROR("Execution of postfilter function failed");
-        return BLOSC2_ERROR_POSTFILTER;
+      rc = run_postfilter(thread_context, tmp, dest + dest_offset, bsize, nblock);
+      if (rc < 0) {
+        return rc;
       }
+      stats->filters_ns += stage_lap(thread_context, BLOSC2_TRACE_POSTFILTER, nblock, bsize_, &stage_start);
     }
-    thread_context->zfp_cell_nitems = 0;
+    thread_context->cell_nitems = 0;
+    BLOSC_HOOK_END(BLOSC2_TRACE_BLOCK, context, thread_context->tid, nblock, bsize_, block_start);
 
     return bsize_;
   }
 
-  if (!is_lazy && (src_offset <= 0 || src_offset >= srcsize)) {
+  if (!in_tmp && (src_offset <= 0 || src_offset >= srcsize)) {
     /* Invalid block src offset encountered */
     return BLOSC2_ERROR_DATA;
   }
@@ -1739,13 +3675,13 @@ static int blosc_d(
   }
   else if (((last_filter_index >= 0) &&
        (next_filter(filters, BLOSC2_MAX_FILTERS, 'd') != BLOSC_DELTA)) ||
-    context->postfilter != NULL) {
+    has_postfilter(context)) {
     // We are making use of some filter, so use a temp for destination
     _dest = tmp;
   }
   else {
-    // If no filters, or only DELTA in pipeline
-    _dest = dest + dest_offset;
+    // If no filters, or only DELTA in pipeline (the codec output is streamed from tmp, if asked)
+    _dest = context->stream_dest ? tmp : dest + dest_offset;
   }
 
   /* The number of compressed data streams for this block */
@@ -1762,6 +3698,15 @@ static int blosc_d(
     /* Not enough space to output bytes */
     BLOSC_ERROR(BLOSC2_ERROR_WRITE_BUFFER);
   }
+  uint8_t* codec_dest = _dest;  /* the block before the filters */
+#if defined(HAVE_ZSTD)
+  if (context->blosc2_flags & BLOSC2_ZSTD_PREFIX) {
+    rc = start_zstd_prefix(thread_context, nblock);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+#endif /* HAVE_ZSTD */
   for (int j = 0; j < nstreams; j++) {
     if (srcsize < (signed)sizeof(int32_t)) {
       /* Not enough input to read compressed size */
@@ -1784,6 +3729,7 @@ static int blosc_d(
       // A run of 0's
       memset(_dest, 0, (unsigned int)neblock);
       nbytes = neblock;
+      stats->nruns++;
     }
     else if (cbytes < 0) {
       // A negative number means some encoding depending on the token that comes next
@@ -1807,6 +3753,7 @@ static int blosc_d(
         }
         uint8_t value = -cbytes;
         memset(_dest, value, (unsigned int)neblock);
+        stats->nruns++;
       } else {
         BLOSC_TRACE_ERROR("Invalid or unsupported compressed stream token value - %d", token);
         return BLOSC2_ERROR_RUN_LENGTH;
@@ -1817,18 +3764,29 @@ static int blosc_d(
     else if (cbytes == neblock) {
       memcpy(_dest, src, (unsigned int)neblock);
       nbytes = (int32_t)neblock;
+      nraw_streams++;
     }
     else {
       if (compformat == BLOSC_BLOSCLZ_FORMAT) {
-        nbytes = blosclz_decompress(src, cbytes, _dest, (int)neblock);
+        if (context->blosc2_flags & BLOSC2_USEDICT) {
+          nbytes = blosclz_decompress_dict(src, cbytes, _dest, (int)neblock,
+                                           context->dict_buffer, context->dict_size);
+        }
+        else {
+          nbytes = blosclz_decompress(src, cbytes, _dest, (int)neblock);
+        }
       }
       else if (compformat == BLOSC_LZ4_FORMAT) {
+        const char* dict = NULL;
+        if (context->blosc2_flags & BLOSC2_USEDICT) {
+          dict = (const char*)context->dict_buffer;
+        }
         nbytes = lz4_wrap_decompress((char*)src, (size_t)cbytes,
-                                     (char*)_dest, (size_t)neblock);
+                                     (char*)_dest, (size_t)neblock, dict, context->dict_size);
       }
   #if defined(HAVE_ZLIB)
       else if (compformat == BLOSC_ZLIB_FORMAT) {
-        nbytes = zlib_wrap_decompress((char*)src, (size_t)cbytes,
+        nbytes = zlib_wrap_decompress(thread_context, (char*)src, (size_t)cbytes,
                                       (char*)_dest, (size_t)neblock);
       }
   #endif /*  HAVE_ZLIB */
@@ -1841,47 +3799,57 @@ static int blosc_d(
   #endif /*  HAVE_ZSTD */
       else if (compformat == BLOSC_UDCODEC_FORMAT) {
         bool getcell = false;
-
-#if defined(HAVE_PLUGINS)
-        if ((context->compcode == BLOSC_CODEC_ZFP_FIXED_RATE) &&
-            (thread_context->zfp_cell_nitems > 0)) {
-          nbytes = zfp_getcell(thread_context, src, cbytes, _dest, neblock);
+        blosc2_codec* codec = NULL;
+        blosc2_codec_getitems_cb getitems = NULL;
+        for (int i = 0; i < g_ncodecs; ++i) {
+          if (g_codecs[i].compcode == context->compcode) {
+            codec = &g_codecs[i];
+            getitems = g_codecs_getitems[i];
+            break;
+          }
+        }
+        if (codec == NULL) {
+          BLOSC_TRACE_ERROR("User-defined compressor codec %d not found during decompression", context->compcode);
+          return BLOSC2_ERROR_CODEC_SUPPORT;
+        }
+        if (codec->decoder == NULL) {
+          // Dynamically load codec plugin
+          if (fill_codec(codec) < 0) {
+            BLOSC_TRACE_ERROR("Could not load codec %d.", codec->compcode);
+            return BLOSC2_ERROR_CODEC_SUPPORT;
+          }
+        }
+        blosc2_dparams dparams;
+        blosc2_ctx_get_dparams(context, &dparams);
+
+        if ((getitems != NULL) && (thread_context->cell_nitems > 0) &&
+            (last_filter_index < 0) && !has_postfilter(context) && (nstreams == 1)) {
+          // Only the items that are asked for
+          nbytes = getitems(src, cbytes, thread_context->cell_start, thread_context->cell_nitems,
+                            _dest, neblock, context->compcode_meta, &dparams, context->src);
           if (nbytes < 0) {
             return BLOSC2_ERROR_DATA;
           }
-          if (nbytes == thread_context->zfp_cell_nitems * typesize) {
-            getcell = true;
+          getcell = nbytes == thread_context->cell_nitems * typesize;
+        }
+#if defined(HAVE_PLUGINS)
+        else if ((context->compcode == BLOSC_CODEC_ZFP_FIXED_RATE) && (context->zfp_boxes != NULL) &&
+                 (context->zfp_boxes[nblock * 2 * context->zfp_boxes_ndim] >= 0) &&
+                 (last_filter_index < 0) && !has_postfilter(context) && (nstreams == 1) &&
+                 !leftoverblock) {
+          // Only the cells of the block that are needed (the rest of it is left as is)
+          nbytes = zfp_getbox(thread_context, src, cbytes, nblock, _dest, neblock);
+          if (nbytes < 0) {
+            return BLOSC2_ERROR_DATA;
           }
+          getcell = nbytes == neblock;
         }
 #endif /* HAVE_PLUGINS */
         if (!getcell) {
-          thread_context->zfp_cell_nitems = 0;
-          for (int i = 0; i < g_ncodecs; ++i) {
-            if (g_codecs[i].compcode == context->compcode) {
-              if (g_codecs[i].decoder == NULL) {
-                // Dynamically load codec plugin
-                if (fill_codec(&g_codecs[i]) < 0) {
-                  BLOSC_TRACE_ERROR("Could not load codec %d.", g_codecs[i].compcode);
-                  return BLOSC2_ERROR_CODEC_SUPPORT;
-                }
-              }
-              blosc2_dparams dparams;
-              blosc2_ctx_get_dparams(context, &dparams);
-              nbytes = g_codecs[i].decoder(src,
-                                           cbytes,
-                                           _dest,
-                                           neblock,
-                                           context->compcode_meta,
-                                           &dparams,
-                                           context->src);
-              goto urcodecsuccess;
-            }
-          }
-          BLOSC_TRACE_ERROR("User-defined compressor codec %d not found during decompression", context->compcode);
-          return BLOSC2_ERROR_CODEC_SUPPORT;
+          thread_context->cell_nitems = 0;
+          nbytes = codec->decoder(src, cbytes, _dest, neblock, context->compcode_meta, &dparams, context->src);
         }
-      urcodecsuccess:
-        ;
+        partial = partial || getcell;
       }
       else {
         compname = clibcode_to_clibname(compformat);
@@ -1893,7 +3861,7 @@ static int blosc_d(
       }
 
       /* Check that decompressed bytes number is correct */
-      if ((nbytes != neblock) && (thread_context->zfp_cell_nitems == 0)) {
+      if ((nbytes != neblock) && (thread_context->cell_nitems == 0)) {
         return BLOSC2_ERROR_DATA;
       }
 
@@ -1904,21 +3872,72 @@ static int blosc_d(
     ntbytes += nbytes;
   } /* Closes j < nstreams */
 
+#if defined(HAVE_ZSTD)
+  if (context->blosc2_flags & BLOSC2_ZSTD_PREFIX) {
+    rc = keep_zstd_prefix(thread_context, codec_dest, ntbytes, nblock);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+#else
+  BLOSC_UNUSED_PARAM(codec_dest);
+#endif /* HAVE_ZSTD */
+
+  stats->codec_ns += stage_lap(thread_context, BLOSC2_TRACE_CODEC, nblock, bsize, &stage_start);
+  stats->nblocks++;
+  if (nraw_streams == nstreams) {
+    stats->nblocks_raw++;
+  }
+
+  if (context->stream_dest && last_filter_index < 0) {
+    fastcopy_stream(dest + dest_offset, tmp, (unsigned) ntbytes);
+  }
   if (!instr_codec) {
-    if (last_filter_index >= 0 || context->postfilter != NULL) {
+    if (last_filter_index >= 0 || has_postfilter(context)) {
       /* Apply regular filter pipeline */
       int errcode = pipeline_backward(thread_context, bsize, dest, dest_offset, tmp, tmp2, tmp3,
                                       last_filter_index, nblock);
       if (errcode < 0)
         return errcode;
+      stats->filters_ns += stage_lap(thread_context, BLOSC2_TRACE_FILTERS, nblock, bsize, &stage_start);
+    }
+    if (!has_postfilter(context) && !partial) {
+      // With a postfilter, the block has been checked before it was handed over
+      rc = verify_block(thread_context, dest + dest_offset, bsize, nblock);
+      if (rc < 0) {
+        return rc;
+      }
     }
   }
+  BLOSC_HOOK_END(BLOSC2_TRACE_BLOCK, context, thread_context->tid, nblock, bsize, block_start);
 
   /* Return the number of uncompressed bytes */
   return (int)ntbytes;
 }
 
 
+#define BLOCK_PREFETCH_BYTES 1024  /* enough for the hardware prefetchers to take the block over */
+
+/* Prefetch the first bytes of the compressed block nblock into the cache, so that they are on
+ * their way while the current block is decompressed (the hardware prefetchers only pick a
+ * block up after some misses on it) */
+static void prefetch_block(blosc2_context* context, int32_t nblock, bool memcpyed) {
+  if (nblock >= context->nblocks || memcpyed || (context->blosc2_flags & 0x08u) ||
+      context->srcsize < context->header_overhead + (int32_t)sizeof(int32_t) * context->nblocks) {
+    // Lazy chunks do not have the blocks in src
+    return;
+  }
+  int32_t offset = sw32_(context->bstarts + nblock);
+  if (offset <= 0 || offset >= context->srcsize) {
+    return;
+  }
+  int32_t len = context->srcsize - offset < BLOCK_PREFETCH_BYTES ? context->srcsize - offset : BLOCK_PREFETCH_BYTES;
+  for (int32_t i = 0; i < len; i += 64) {
+    BLOSC_PREFETCH(context->src + offset + i);
+  }
+}
+
+
 /* Serial version for compression/decompression */
 static int serial_blosc(struct thread_context* thread_context) {
   blosc2_context* context = thread_context->parent_context;
@@ -1934,6 +3953,7 @@ static int serial_blosc(struct thread_context* thread_context) {
     // Fake a runlen as if it was a memcpyed chunk
     memcpyed = true;
   }
+  BLOSC_HOOK_START(job_start);
 
   for (j = 0; j < context->nblocks; j++) {
     if (context->do_compress && !memcpyed && !dict_training) {
@@ -1948,9 +3968,10 @@ static int serial_blosc(struct thread_context* thread_context) {
     if (context->do_compress) {
       if (memcpyed && !context->prefilter) {
         /* We want to memcpy only */
-        memcpy(context->dest + context->header_overhead + j * context->blocksize,
-               context->src + j * context->blocksize, (unsigned int)bsize);
+        copy_raw_block(thread_context, context->dest + context->header_overhead + j * context->blocksize,
+                       context->src + j * context->blocksize, j, bsize);
         cbytes = (int32_t)bsize;
+        seal_block(thread_context, context->dest + context->header_overhead + j * context->blocksize, cbytes, j);
       }
       else {
         /* Regular compression */
@@ -1961,6 +3982,9 @@ static int serial_blosc(struct thread_context* thread_context) {
           ntbytes = 0;              /* incompressible data */
           break;
         }
+        if (cbytes > 0 && !dict_training) {
+          seal_block(thread_context, context->dest + ntbytes, cbytes, j);
+        }
       }
     }
     else {
@@ -1968,48 +3992,151 @@ static int serial_blosc(struct thread_context* thread_context) {
       // If memcpyed we don't have a bstarts section (because it is not needed)
       int32_t src_offset = memcpyed ?
           context->header_overhead + j * context->blocksize : sw32_(bstarts + j);
+      prefetch_block(context, j + 1, memcpyed);
       cbytes = blosc_d(thread_context, bsize, leftoverblock, memcpyed,
                        context->src, context->srcsize, src_offset, j,
-                       context->dest, j * context->blocksize, tmp, tmp2);
+                       context->dest, j * context->blocksize - context->dest_shift, tmp, tmp2);
+    }
+
+    if (cbytes < 0) {
+      ntbytes = cbytes;         /* error in blosc_c or blosc_d */
+      break;
+    }
+    ntbytes += cbytes;
+  }
+  BLOSC_HOOK_END(BLOSC2_TRACE_JOB, context, thread_context->tid, -1, 0, job_start);
+
+  return ntbytes;
+}
+
+static void t_blosc_do_job(void *ctxt);
+
+/* The phases of the job of the threads with BLOSC_STREAMS_SCHED */
+enum {
+  STREAMS_PHASE_NONE = 0,  /* the blocks are the unit of work (other schedulers) */
+  STREAMS_PHASE_FILTERS = 1,  /* run the filters of every block */
+  STREAMS_PHASE_CODEC = 2,  /* compress every stream of every block */
+};
+
+static inline int64_t pack_block_range(int32_t begin, int32_t end) {
+  return (int64_t)(((uint64_t)(uint32_t)begin << 32) | (uint32_t)end);
+}
+
+/* Take the first pending block of a range.  Returns -1 if the range is empty. */
+static int32_t pop_block_range(struct blosc_block_range* block_range) {
+  int64_t old = blosc_atomic_load64(&block_range->range);
+  while (1) {
+    int32_t begin = (int32_t)((uint64_t)old >> 32);
+    int32_t end = (int32_t)(uint32_t)old;
+    if (begin >= end) {
+      return -1;
     }
-
-    if (cbytes < 0) {
-      ntbytes = cbytes;         /* error in blosc_c or blosc_d */
-      break;
+    if (blosc_atomic_cas64(&block_range->range, &old, pack_block_range(begin + 1, end))) {
+      return begin;
     }
-    ntbytes += cbytes;
   }
+}
 
-  return ntbytes;
+/* Steal the upper half of the pending blocks of other threads.  The first stolen
+ * block is returned and the rest become the new range of the thief.
+ * Returns -1 when there is nothing left to steal. */
+static int32_t steal_block_range(blosc2_context* context, int tid) {
+  struct blosc_block_range* ranges = context->block_ranges;
+  for (int i = 1; i < context->nthreads; i++) {
+    struct blosc_block_range* victim = &ranges[(tid + i) % context->nthreads];
+    int64_t old = blosc_atomic_load64(&victim->range);
+    while (1) {
+      int32_t begin = (int32_t)((uint64_t)old >> 32);
+      int32_t end = (int32_t)(uint32_t)old;
+      if (begin >= end) {
+        break;
+      }
+      int32_t mid = end - (end - begin + 1) / 2;
+      if (blosc_atomic_cas64(&victim->range, &old, pack_block_range(begin, mid))) {
+        /* Our own range is empty here, so nobody else can modify it */
+        blosc_atomic_store64(&ranges[tid].range, pack_block_range(mid + 1, end));
+        return mid;
+      }
+    }
+  }
+  return -1;
 }
 
-static void t_blosc_do_job(void *ctxt);
+/* Get the next block to process when using the work-stealing scheduler */
+static int32_t next_stolen_block(struct thread_context* thcontext) {
+  blosc2_context* context = thcontext->parent_context;
+  int64_t start = stats_clock();
+  int32_t nblock = pop_block_range(&context->block_ranges[thcontext->tid]);
+  if (nblock < 0) {
+    nblock = steal_block_range(context, thcontext->tid);
+  }
+  thcontext->stats.sched_ns += stats_clock() - start;
+  return nblock;
+}
 
 /* Threaded version for compression/decompression */
 static int parallel_blosc(blosc2_context* context) {
-#ifdef BLOSC_POSIX_BARRIERS
-  int rc;
-#endif
   /* Set sentinels */
   context->thread_giveup_code = 1;
   context->thread_nblock = -1;
+  context->job_busy_ns = 0;
+  context->job_max_busy_ns = 0;
+
+  if (context->scheduler == BLOSC_WORKSTEALING_SCHED) {
+    /* Seed every thread with the same blocks that the static split would get
+     * (the threads that stay out of the job get none) */
+    int32_t tblocks = context->nblocks / context->active_nthreads;
+    if (context->nblocks % context->active_nthreads > 0) {
+      tblocks++;
+    }
+    for (int32_t tid = 0; tid < context->nthreads; tid++) {
+      int32_t begin = tid * tblocks;
+      int32_t end = begin + tblocks;
+      if (begin > context->nblocks) {
+        begin = context->nblocks;
+      }
+      if (end > context->nblocks) {
+        end = context->nblocks;
+      }
+      blosc_atomic_store64(&context->block_ranges[tid].range, pack_block_range(begin, end));
+    }
+  }
 
-  if (threads_callback) {
+  context->job_start_ns = stats_clock();
+  if (context->task_scheduler.submit != NULL) {
+    blosc_sched_run(&context->task_scheduler, t_blosc_do_job, context->active_nthreads,
+                    sizeof(struct thread_context), (void*) context->thread_contexts);
+  }
+  else if (threads_callback) {
     threads_callback(threads_callback_data, t_blosc_do_job,
-                     context->nthreads, sizeof(struct thread_context), (void*) context->thread_contexts);
+                     context->active_nthreads, sizeof(struct thread_context), (void*) context->thread_contexts);
+  }
+  else if (context->thread_contexts != NULL && blosc_native_scheduler() != NULL && blosc_pool_nthreads() == 0) {
+    /* The thread pool of the operating system */
+    blosc_sched_run(blosc_native_scheduler(), t_blosc_do_job, context->active_nthreads,
+                    sizeof(struct thread_context), (void*) context->thread_contexts);
+  }
+  else if (context->thread_contexts != NULL) {
+    /* Submit the jobs to the shared pool, or else to the one of the implicit contexts */
+    void *pool = context->implicit && blosc_pool_nthreads() == 0 ? get_implicit_pool() : NULL;
+    blosc_pool_run(pool, t_blosc_do_job, context->active_nthreads, sizeof(struct thread_context),
+                   (void*) context->thread_contexts);
   }
   else {
     /* Synchronization point for all threads (wait for initialization) */
-    WAIT_INIT(-1, context);
+    blosc_barrier_wait(&context->barr_init);
 
     /* Synchronization point for all threads (wait for finalization) */
-    WAIT_FINISH(-1, context);
+    blosc_barrier_wait(&context->barr_finish);
   }
 
   if (context->thread_giveup_code <= 0) {
     /* Compression/decompression gave up.  Return error code. */
     return context->thread_giveup_code;
   }
+  /* The threads that finished before the slowest one waited for it, and the caller for the last one */
+  context->stats.idle_ns += context->active_nthreads * context->job_max_busy_ns - context->job_busy_ns;
+  context->stats.sync_ns += stats_clock() - context->job_start_ns - context->job_max_busy_ns;
 
   /* Return the total bytes (de-)compressed in threads */
   return (int)context->output_bytes;
@@ -2024,19 +4151,33 @@ static int init_thread_context(struct thread_context* thread_context, blosc2_con
   thread_context->tid = tid;
 
   ebsize = context->blocksize + context->typesize * (signed)sizeof(int32_t);
-  thread_context->tmp_nbytes = (size_t)4 * ebsize;
-  thread_context->tmp = my_malloc(thread_context->tmp_nbytes);
-  BLOSC_ERROR_NULL(thread_context->tmp, BLOSC2_ERROR_MEMORY_ALLOC);
-  thread_context->tmp2 = thread_context->tmp + ebsize;
-  thread_context->tmp3 = thread_context->tmp2 + ebsize;
-  thread_context->tmp4 = thread_context->tmp3 + ebsize;
-  thread_context->tmp_blocksize = context->blocksize;
-  thread_context->zfp_cell_nitems = 0;
-  thread_context->zfp_cell_start = 0;
+  thread_context->tmp = NULL;
+  thread_context->tmp_class = -1;
+  thread_context->block_input = NULL;
+  int rc = set_thread_tmp(thread_context, context->blocksize, ebsize);
+  if (rc < 0) {
+    return rc;
+  }
+  thread_context->cell_nitems = 0;
+  thread_context->cell_start = 0;
+  memset(&thread_context->stats, 0, sizeof(blosc2_ctx_stats));
   #if defined(HAVE_ZSTD)
   thread_context->zstd_cctx = NULL;
   thread_context->zstd_dctx = NULL;
+  thread_context->zstd_clevel = 0;
+  thread_context->zstd_cdict = NULL;
+  thread_context->zstd_ldm = 0;
+  thread_context->zstd_prefix = NULL;
+  thread_context->zstd_prefix_len = 0;
+  thread_context->zstd_prefix_size = 0;
+  thread_context->zstd_prefix_nblock = -1;
   #endif
+  thread_context->lz4_state = NULL;
+#if defined(HAVE_ZLIB)
+  thread_context->zlib_deflate = NULL;
+  thread_context->zlib_inflate = NULL;
+  thread_context->zlib_clevel = 0;
+#endif
 
   /* Create the hash table for LZ4 in case we are using IPP */
 #ifdef HAVE_IPP
@@ -2060,7 +4201,7 @@ static int init_thread_context(struct thread_context* thread_context, blosc2_con
 static struct thread_context*
 create_thread_context(blosc2_context* context, int32_t tid) {
   struct thread_context* thread_context;
-  thread_context = (struct thread_context*)my_malloc(sizeof(struct thread_context));
+  thread_context = (struct thread_context*)ctx_malloc(context, sizeof(struct thread_context));
   BLOSC_ERROR_NULL(thread_context, NULL);
   int rc = init_thread_context(thread_context, context, tid);
   if (rc < 0) {
@@ -2071,25 +4212,36 @@ create_thread_context(blosc2_context* context, int32_t tid) {
 
 /* free members of thread_context, but not thread_context itself */
 static void destroy_thread_context(struct thread_context* thread_context) {
-  my_free(thread_context->tmp);
+  if (thread_context->tmp_class >= 0) {
+    scratch_put(thread_context->tmp_class, thread_context->tmp);
+  }
+  else {
+    ctx_free(thread_context->parent_context, thread_context->tmp);
+  }
 #if defined(HAVE_ZSTD)
   if (thread_context->zstd_cctx != NULL) {
-    ZSTD_freeCCtx(thread_context->zstd_cctx);
+    zstd_cctx_put(thread_context->zstd_cctx);
   }
   if (thread_context->zstd_dctx != NULL) {
-    ZSTD_freeDCtx(thread_context->zstd_dctx);
+    zstd_dctx_put(thread_context->zstd_dctx);
   }
+  ctx_free(thread_context->parent_context, thread_context->zstd_prefix);
 #endif
 #ifdef HAVE_IPP
   if (thread_context->lz4_hash_table != NULL) {
     ippsFree(thread_context->lz4_hash_table);
   }
 #endif
+  ctx_free(thread_context->parent_context, thread_context->lz4_state);
+#if defined(HAVE_ZLIB)
+  free_zlib_streams(thread_context);
+#endif
+  ctx_free(thread_context->parent_context, thread_context->block_input);
 }
 
 void free_thread_context(struct thread_context* thread_context) {
   destroy_thread_context(thread_context);
-  my_free(thread_context);
+  ctx_free(thread_context->parent_context, thread_context);
 }
 
 
@@ -2099,6 +4251,11 @@ int check_nthreads(blosc2_context* context) {
     return BLOSC2_ERROR_INVALID_PARAM;
   }
 
+  if (context->threads_started > 0 && use_thread_contexts(context) != (context->thread_contexts != NULL)) {
+    /* The threading backend has changed since the threads were started */
+    release_threadpool(context);
+  }
+
   if (context->new_nthreads != context->nthreads) {
     if (context->nthreads > 1) {
       release_threadpool(context);
@@ -2112,6 +4269,182 @@ int check_nthreads(blosc2_context* context) {
   return context->nthreads;
 }
 
+/* Whether a compression takes the streams of the blocks as the unit of work for the threads */
+static bool use_streams_sched(blosc2_context* context) {
+  bool dont_split = (context->header_flags & 0x10) >> 4;
+  bool memcpyed = context->header_flags & (uint8_t)BLOSC_MEMCPYED;
+  int32_t nsplit_blocks = context->leftover > 0 ? context->nblocks - 1 : context->nblocks;
+  return context->do_compress && context->scheduler == BLOSC_STREAMS_SCHED && context->nthreads > 1 &&
+         context->cipher == BLOSC2_CIPHER_NONE &&
+         !dont_split && !memcpyed && !context->use_dict && !(context->blosc2_flags & BLOSC2_INSTR_CODEC) &&
+         !(context->blosc2_flags & BLOSC2_ZSTD_PREFIX) && context->typesize > 1 && nsplit_blocks > 0;
+}
+
+/* Whether the blocks have to go through the filters (or the prefilter) before being compressed */
+static bool streams_need_filters(blosc2_context* context) {
+  return last_filter(context->filters, 'c') >= 0 || context->prefilter != NULL;
+}
+
+static int32_t streams_block_size(blosc2_context* context, int32_t nblock) {
+  return (nblock == context->nblocks - 1 && context->leftover > 0) ? context->leftover : context->blocksize;
+}
+
+/* The leftover block is not split, like in blosc_c() */
+static int32_t streams_block_nstreams(blosc2_context* context, int32_t nblock) {
+  return (nblock == context->nblocks - 1 && context->leftover > 0) ? 1 : context->typesize;
+}
+
+/* The block after the filters */
+static const uint8_t* streams_block(blosc2_context* context, int32_t nblock) {
+  const uint8_t* src = streams_need_filters(context) ? context->streams_src : context->src;
+  return src + (int64_t)nblock * context->blocksize;
+}
+
+/* The room for a compressed stream, which is large enough for the stream stored as is */
+static uint8_t* streams_slot(blosc2_context* context, int32_t nblock, int32_t nstream) {
+  int32_t ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
+  int32_t neblock = streams_block_size(context, nblock) / streams_block_nstreams(context, nblock);
+  return context->streams_dest + (int64_t)nblock * ebsize + (int64_t)nstream * (neblock + (int32_t)sizeof(int32_t));
+}
+
+/* Compress a buffer with the streams of the blocks as the unit of work for the threads
+   (BLOSC_STREAMS_SCHED).  The blocks go through the filters first, then every stream is
+   compressed into a slot of its own, and finally the streams are laid out in dest like
+   the other schedulers do. */
+static int parallel_streams(blosc2_context* context) {
+  int32_t typesize = context->typesize;
+  int32_t ebsize = context->blocksize + typesize * (int32_t)sizeof(int32_t);
+  int64_t nunits = (int64_t)context->nblocks * typesize;
+  int32_t ntbytes = context->output_bytes;
+
+  if (streams_need_filters(context) && context->streams_src_len < (int64_t)context->nblocks * context->blocksize) {
+    ctx_free(context, context->streams_src);
+    context->streams_src_len = (int64_t)context->nblocks * context->blocksize;
+    context->streams_src = ctx_malloc(context, (size_t)context->streams_src_len);
+    BLOSC_ERROR_NULL(context->streams_src, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  if (context->streams_dest_len < (int64_t)context->nblocks * ebsize) {
+    ctx_free(context, context->streams_dest);
+    context->streams_dest_len = (int64_t)context->nblocks * ebsize;
+    context->streams_dest = ctx_malloc(context, (size_t)context->streams_dest_len);
+    BLOSC_ERROR_NULL(context->streams_dest, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  if (context->streams_csizes_len < nunits) {
+    ctx_free(context, context->streams_csizes);
+    context->streams_csizes_len = nunits;
+    context->streams_csizes = ctx_malloc(context, (size_t)nunits * sizeof(int32_t));
+    BLOSC_ERROR_NULL(context->streams_csizes, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+
+  context->streams_phase = STREAMS_PHASE_FILTERS;
+  int rc = parallel_blosc(context);
+  if (rc > 0) {
+    context->streams_phase = STREAMS_PHASE_CODEC;
+    rc = parallel_blosc(context);
+  }
+  context->streams_phase = STREAMS_PHASE_NONE;
+  if (rc <= 0) {
+    return rc;
+  }
+
+  for (int32_t nblock = 0; nblock < context->nblocks; nblock++) {
+    int32_t nstreams = streams_block_nstreams(context, nblock);
+    int32_t neblock = streams_block_size(context, nblock) / nstreams;
+    int32_t ctbytes = 0;
+    int32_t nraw_streams = 0;
+    _sw32(context->bstarts + nblock, ntbytes);
+    for (int32_t j = 0; j < nstreams; j++) {
+      int32_t csize = context->streams_csizes[nblock * typesize + j];
+      uint8_t* slot = streams_slot(context, nblock, j);
+      if (ntbytes + csize > context->destsize) {
+        return 0;    /* Non-compressible data */
+      }
+      memcpy(context->dest + ntbytes, slot, csize);
+      nraw_streams += sw32_(slot) == neblock;
+      ntbytes += csize;
+      ctbytes += csize;
+    }
+    if (nraw_streams == nstreams) {
+      context->stats.nblocks_raw++;
+    }
+    if (context->block_csizes != NULL) {
+      context->block_csizes[nblock] = ctbytes;
+    }
+  }
+  context->output_bytes = ntbytes;
+
+  return ntbytes;
+}
+
+/* The bytes that every thread has to get at least for a call to go parallel, as waking
+   the threads up and waiting for them costs about as much as (de-)compressing less */
+#define PARALLEL_THRESHOLD (32 * 1024)
+
+/* The bytes per thread below which calls run serially (see BLOSC_PARALLEL_THRESHOLD) */
+static int32_t parallel_threshold(void) {
+  const char* envvar = blosc_getenv(BLOSC_ENV_PARALLEL_THRESHOLD);
+  if (envvar != NULL) {
+    long value = strtol(envvar, NULL, 10);
+    if (value >= 0 && value <= INT32_MAX) {
+      return (int32_t)value;
+    }
+  }
+  return PARALLEL_THRESHOLD;
+}
+
+bool parallel_pays_off(int32_t nbytes, int16_t nthreads) {
+  if (nthreads <= 1) {
+    return false;
+  }
+  int32_t threshold = parallel_threshold();
+  if (threshold == 0) {
+    return true;
+  }
+  // A single core cannot run the threads at once
+  return nbytes / nthreads >= threshold && blosc_stune_cpu_info()->ncores != 1;
+}
+
+/* The blocks that every thread has to get at least with BLOSC2_NTHREADS_AUTO */
+#define AUTO_MIN_THREAD_BLOCKS 4
+/* The time that every thread has to be busy at least with BLOSC2_NTHREADS_AUTO */
+#define AUTO_MIN_THREAD_NS (20 * 1000)
+
+/* The threads that a context with BLOSC2_NTHREADS_AUTO starts, one per core */
+static int16_t max_auto_nthreads(void) {
+  int ncores = blosc_stune_cpu_info()->ncores;
+  if (ncores <= 0) {
+    // Like the frames, 4 threads when the cores are unknown
+    return 4;
+  }
+  return (int16_t)(ncores < INT16_MAX ? ncores : INT16_MAX);
+}
+
+/* The threads to engage in the current job of a context with BLOSC2_NTHREADS_AUTO, from
+   the blocks to (de-)compress and from the time that blocks took in the previous jobs */
+static int16_t auto_active_nthreads(blosc2_context* context) {
+  int64_t nthreads = context->nblocks / AUTO_MIN_THREAD_BLOCKS;
+  if (context->block_ns > 0) {
+    int64_t by_time = context->nblocks * context->block_ns / AUTO_MIN_THREAD_NS;
+    if (by_time < nthreads) {
+      nthreads = by_time;
+    }
+  }
+  if (nthreads > context->nthreads) {
+    nthreads = context->nthreads;
+  }
+  return (int16_t)(nthreads < 1 ? 1 : nthreads);
+}
+
+/* Fold the time that the threads were busy in a job into the estimate of the time per block */
+static void update_block_ns(blosc2_context* context, int64_t busy_ns) {
+  int64_t block_ns = busy_ns / context->nblocks;
+  if (context->block_ns > 0) {
+    block_ns = (3 * context->block_ns + block_ns) / 4;
+  }
+  // 0 is for no estimate yet
+  context->block_ns = block_ns > 0 ? block_ns : 1;
+}
+
 /* Do the compression or decompression of the buffer depending on the
    global params. */
 static int do_job(blosc2_context* context) {
@@ -2122,10 +4455,25 @@ static int do_job(blosc2_context* context) {
 
   /* Check whether we need to restart threads */
   check_nthreads(context);
+  context->active_nthreads = context->nthreads;
+
+  /* The streams of a single block can also be compressed in parallel */
+  if (use_streams_sched(context)) {
+    return parallel_streams(context);
+  }
+
+  int64_t job_start = 0;
+  if (context->auto_nthreads) {
+    context->active_nthreads = auto_active_nthreads(context);
+    job_start = stats_clock();
+  }
 
   /* Run the serial version when nthreads is 1 or when the buffers are
-     not larger than blocksize */
-  if (context->nthreads == 1 || (context->sourcesize / context->blocksize) <= 1) {
+     not larger than blocksize (or when every block needs the previous one),
+     and also when the threads would get too little work to pay for waking them up */
+  if (context->active_nthreads == 1 || (context->sourcesize / context->blocksize) <= 1 ||
+      (context->blosc2_flags & BLOSC2_ZSTD_PREFIX) ||
+      !parallel_pays_off(context->sourcesize, context->active_nthreads)) {
     /* The context for this 'thread' has no been initialized yet */
     if (context->serial_context == NULL) {
       context->serial_context = create_thread_context(context, 0);
@@ -2136,9 +4484,16 @@ static int do_job(blosc2_context* context) {
     }
     BLOSC_ERROR_NULL(context->serial_context, BLOSC2_ERROR_THREAD_CREATE);
     ntbytes = serial_blosc(context->serial_context);
+    merge_stats(&context->stats, &context->serial_context->stats);
+    if (context->auto_nthreads && ntbytes > 0) {
+      update_block_ns(context, stats_clock() - job_start);
+    }
   }
   else {
     ntbytes = parallel_blosc(context);
+    if (context->auto_nthreads && ntbytes > 0) {
+      update_block_ns(context, context->job_busy_ns);
+    }
   }
 
   return ntbytes;
@@ -2237,6 +4592,11 @@ static int initialize_context_compression(
     BLOSC_TRACE_ERROR("Error in tuner next_blocksize func\n");
     return BLOSC2_ERROR_TUNER;
   }
+  // The tuner may have changed the filters
+  context->filter_flags = filters_to_flags(context->filters);
+  if (g_initlib) {
+    resolve_plugins(context);
+  }
 
 
   /* Check buffer size limits */
@@ -2299,6 +4659,11 @@ static int initialize_context_decompression(blosc2_context* context, blosc_heade
                       context->block_maskout_nitems, context->nblocks);
     return BLOSC2_ERROR_DATA;
   }
+  if (context->zfp_boxes != NULL && context->zfp_boxes_nitems != context->nblocks) {
+    BLOSC_TRACE_ERROR("The number of boxes (%d) must match the number of blocks in chunk (%d).",
+                      context->zfp_boxes_nitems, context->nblocks);
+    return BLOSC2_ERROR_DATA;
+  }
 
   context->special_type = (header->blosc2_flags >> 4) & BLOSC2_SPECIAL_MASK;
   if (context->special_type > BLOSC2_SPECIAL_LASTID) {
@@ -2308,10 +4673,23 @@ static int initialize_context_decompression(blosc2_context* context, blosc_heade
   }
 
   int memcpyed = (context->header_flags & (uint8_t) BLOSC_MEMCPYED);
-  if (memcpyed && (header->cbytes != header->nbytes + context->header_overhead)) {
+  context->block_codecs = NULL;
+  context->dref = NULL;
+  context->dest_shift = 0;
+  context->stream_dest = use_stream_dest(context);
+  if (memcpyed && (header->cbytes != header->nbytes + context->header_overhead + get_checksums_len(context) +
+                   get_cipher_len(context))) {
     BLOSC_TRACE_ERROR("Wrong header info for this memcpyed chunk");
     return BLOSC2_ERROR_DATA;
   }
+  rc = setup_src_checksums(context, context->src, srcsize);
+  if (rc < 0) {
+    return rc;
+  }
+  rc = setup_src_cipher(context, context->src, srcsize);
+  if (rc < 0) {
+    return rc;
+  }
 
   if ((header->nbytes == 0) && (header->cbytes == context->header_overhead) &&
       !context->special_type) {
@@ -2324,6 +4702,17 @@ static int initialize_context_decompression(blosc2_context* context, blosc_heade
   if (!context->special_type && !memcpyed) {
     /* If chunk is not special or a memcpyed, we do have a bstarts section */
     bstarts_end = (int32_t)(context->header_overhead + (context->nblocks * sizeof(int32_t)));
+    if (is_hybrid_chunk(context->header_flags)) {
+      /* The codecs of the blocks come right after the bstarts */
+      context->block_codecs = context->src + bstarts_end;
+      bstarts_end += context->nblocks;
+    }
+    int32_t dref_len = stored_dref_len(context->src);
+    if (dref_len > 0) {
+      /* And then the reference block of the delta filter, as is */
+      context->dref = context->src + bstarts_end;
+      bstarts_end += dref_len;
+    }
   }
 
   if (srcsize < bstarts_end) {
@@ -2332,22 +4721,51 @@ static int initialize_context_decompression(blosc2_context* context, blosc_heade
   }
   srcsize -= bstarts_end;
 
-  /* Read optional dictionary if flag set */
-  if (context->blosc2_flags & BLOSC2_USEDICT) {
-#if defined(HAVE_ZSTD)
+  /* Read optional dictionary if flag set (memcpyed chunks do not use it) */
+  if ((context->blosc2_flags & BLOSC2_USEDICT) && !memcpyed) {
     context->use_dict = 1;
-    if (context->dict_ddict != NULL) {
-      // Free the existing dictionary (probably from another chunk)
-      ZSTD_freeDDict(context->dict_ddict);
-    }
     // The trained dictionary is after the bstarts block
     if (srcsize < (signed)sizeof(int32_t)) {
       BLOSC_TRACE_ERROR("Not enough space to read size of dictionary.");
       return BLOSC2_ERROR_READ_BUFFER;
     }
     srcsize -= sizeof(int32_t);
+    int compformat = (context->header_flags & (uint8_t)0xe0) >> 5u;
     // Read dictionary size
     context->dict_size = sw32_(context->src + bstarts_end);
+    if (context->dict_size < 0) {
+      // A (negated) reference to the dictionary shared by the chunks of the super-chunk
+      shared_dict* dict = NULL;
+      if (context->schunk != NULL) {
+        dict = (shared_dict*)context->schunk->shared_dict;
+      }
+      if (dict == NULL || context->dict_size != -dict->id) {
+        BLOSC_TRACE_ERROR("The chunk references a shared dictionary that is not available.");
+        return BLOSC2_ERROR_CODEC_DICT;
+      }
+      context->dict_buffer = dict->buffer;
+      context->dict_size = dict->size;
+#if defined(HAVE_ZSTD)
+      // The digested dictionary is kept for the next chunks
+      if (compformat == BLOSC_ZSTD_FORMAT &&
+          (context->dict_ddict == NULL || context->dict_id != dict->id)) {
+        if (context->dict_ddict != NULL) {
+          ZSTD_freeDDict(context->dict_ddict);
+        }
+        context->dict_ddict = ZSTD_createDDict(context->dict_buffer, context->dict_size);
+        context->dict_id = dict->id;
+      }
+#endif   // HAVE_ZSTD
+      return 0;
+    }
+#if defined(HAVE_ZSTD)
+    if (context->dict_ddict != NULL) {
+      // Free the existing dictionary (probably from another chunk)
+      ZSTD_freeDDict(context->dict_ddict);
+      context->dict_ddict = NULL;
+      context->dict_id = 0;
+    }
+#endif   // HAVE_ZSTD
     if (context->dict_size <= 0 || context->dict_size > BLOSC2_MAXDICTSIZE) {
       BLOSC_TRACE_ERROR("Dictionary size is smaller than minimum or larger than maximum allowed.");
       return BLOSC2_ERROR_CODEC_DICT;
@@ -2359,19 +4777,59 @@ static int initialize_context_decompression(blosc2_context* context, blosc_heade
     srcsize -= context->dict_size;
     // Read dictionary
     context->dict_buffer = (void*)(context->src + bstarts_end + sizeof(int32_t));
-    context->dict_ddict = ZSTD_createDDict(context->dict_buffer, context->dict_size);
+#if defined(HAVE_ZSTD)
+    // Only ZSTD needs a digested form; LZ4 and BloscLZ use the dictionary as is
+    if (compformat == BLOSC_ZSTD_FORMAT) {
+      context->dict_ddict = ZSTD_createDDict(context->dict_buffer, context->dict_size);
+    }
 #endif   // HAVE_ZSTD
   }
 
   return 0;
 }
 
+/* The size of the reference block of the delta filter that the chunk being compressed
+ * keeps as is (see BLOSC_DELTA_DREF_STORED), which is 0 for the other modes */
+static int32_t dref_len_to_store(blosc2_context* context) {
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    if (context->filters[i] == BLOSC_DELTA && context->filters_meta[i] == BLOSC_DELTA_DREF_STORED) {
+      return context->sourcesize < context->blocksize ? context->sourcesize : context->blocksize;
+    }
+  }
+  return 0;
+}
+
+/* Whether the stride of the shuffle of the chunk being compressed has to be guessed, which is
+ * done for the items of a byte when the only filter is a plain shuffle (see detect_typesize).
+ * The chunk then goes with the shuffle_stride filter, so this needs the filter plugins. */
+static bool detect_shuffle_stride(blosc2_context* context) {
+#if !defined(HAVE_PLUGINS)
+  BLOSC_UNUSED_PARAM(context);
+  return false;
+#else
+  if (!context->detect_typesize || context->typesize != 1 || context->prefilter != NULL) {
+    return false;
+  }
+  int nshuffles = 0;
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    if (context->filters[i] == BLOSC_SHUFFLE && context->filters_meta[i] == 0) {
+      nshuffles++;
+    }
+    else if (context->filters[i] != BLOSC_NOFILTER) {
+      return false;
+    }
+  }
+  return nshuffles == 1;
+#endif /* HAVE_PLUGINS */
+}
+
 static int write_compression_header(blosc2_context* context, bool extended_header) {
   blosc_header header;
   int dont_split;
   int dict_training = context->use_dict && (context->dict_cdict == NULL);
 
   context->header_flags = 0;
+  context->blosc2_flags &= (uint8_t)~BLOSC2_ZSTD_PREFIX;
 
   if (context->clevel == 0) {
     /* Compression level 0 means buffer to be memcpy'ed */
@@ -2381,8 +4839,18 @@ static int write_compression_header(blosc2_context* context, bool extended_heade
     /* Buffer is too small.  Try memcpy'ing. */
     context->header_flags |= (uint8_t)BLOSC_MEMCPYED;
   }
+  int32_t dref_len = extended_header ? dref_len_to_store(context) : 0;
+  if (dref_len > 0 && BLOSC_EXTENDED_HEADER_LENGTH + context->nblocks * ((int32_t)sizeof(int32_t) + 1) +
+                      dref_len > context->destsize) {
+    /* No room for the reference block of the delta filter.  Try memcpy'ing. */
+    context->header_flags |= (uint8_t)BLOSC_MEMCPYED;
+  }
 
   bool memcpyed = context->header_flags & (uint8_t)BLOSC_MEMCPYED;
+  context->shuffle_stride = 0;
+  if (extended_header && !memcpyed && !dict_training && detect_shuffle_stride(context)) {
+    context->shuffle_stride = stune_detect_stride(context->src, context->sourcesize);
+  }
   if (extended_header) {
     /* Indicate that we are building an extended header */
     context->header_overhead = BLOSC_EXTENDED_HEADER_LENGTH;
@@ -2424,14 +4892,32 @@ static int write_compression_header(blosc2_context* context, bool extended_heade
       context->header_flags |= BLOSC_DODELTA;
     }
 
+    /* Blocks compressed with dicts are never split */
     dont_split = !split_block(context, context->typesize,
-                              context->blocksize);
+                              context->blocksize) || context->use_dict;
 
     /* dont_split is in bit 4 */
     context->header_flags |= dont_split << 4;
     /* codec starts at bit 5 */
     uint8_t compformat = compcode_to_compformat(context->compcode);
+    /* Hybrid chunks keep the codec of every block after the bstarts, when there is room */
+    if (extended_header && context->block_codec != NULL && !context->use_dict &&
+        !(context->blosc2_flags & BLOSC2_INSTR_CODEC) &&
+        context->output_bytes + context->nblocks <= context->destsize) {
+      compformat = BLOSC_HYBRID_FORMAT;
+      context->output_bytes += context->nblocks;
+    }
     context->header_flags |= compformat << 5;
+    if (dref_len > 0) {
+      /* The reference block of the delta filter goes as is before the streams */
+      memcpy(context->dest + context->output_bytes, context->src, dref_len);
+      context->output_bytes += dref_len;
+    }
+    /* The zstd blocks can reference the previous block of the chunk */
+    if (extended_header && context->zstd_window != BLOSC2_ZSTD_BLOCK_WINDOW && context->compcode == BLOSC_ZSTD &&
+        compformat != BLOSC_HYBRID_FORMAT && !context->use_dict && !(context->blosc2_flags & BLOSC2_INSTR_CODEC)) {
+      context->blosc2_flags |= BLOSC2_ZSTD_PREFIX;
+    }
   }
 
   // Create blosc header and store to dest
@@ -2444,15 +4930,148 @@ static int write_compression_header(blosc2_context* context, bool extended_heade
 }
 
 
+/* Encode a source made of the same (typesize-wide) value as a special chunk, so that
+ * neither the filters nor the codec have to go through it.  Returns the size of the
+ * chunk, or 0 if the source is not a run (or it cannot be encoded as a special chunk). */
+static int compress_run(blosc2_context* context) {
+  int32_t typesize = context->typesize;
+  int32_t header_overhead = context->header_overhead;
+  if (context->special_detection == BLOSC_SPECIAL_DETECT_NONE ||
+      header_overhead != BLOSC_EXTENDED_HEADER_LENGTH || context->prefilter != NULL ||
+      context->use_dict || (context->blosc2_flags & BLOSC2_INSTR_CODEC) ||
+      context->sourcesize == 0 || context->sourcesize % typesize != 0 ||
+      context->destsize < header_overhead + typesize) {
+    return 0;
+  }
+  if (!get_run(context->src, context->sourcesize, typesize)) {
+    return 0;
+  }
+
+  bool zeros = true;
+  for (int32_t i = 0; i < typesize; i++) {
+    zeros &= context->src[i] == 0;
+  }
+  if (zeros) {
+    context->dest[BLOSC2_CHUNK_BLOSC2_FLAGS] |= BLOSC2_SPECIAL_ZERO << 4;
+    return header_overhead;
+  }
+  /* Only the NaN that is written back by set_nans() can be stored as a NaN chunk */
+  float fnan = nanf("");
+  double dnan = nan("");
+  if ((typesize == 4 && memcmp(context->src, &fnan, 4) == 0) ||
+      (typesize == 8 && memcmp(context->src, &dnan, 8) == 0)) {
+    context->dest[BLOSC2_CHUNK_BLOSC2_FLAGS] |= BLOSC2_SPECIAL_NAN << 4;
+    return header_overhead;
+  }
+  context->dest[BLOSC2_CHUNK_BLOSC2_FLAGS] |= BLOSC2_SPECIAL_VALUE << 4;
+  memcpy(context->dest + header_overhead, context->src, typesize);
+  return header_overhead + typesize;
+}
+
+
+/* Store the checksums of the blocks at the end of a regular chunk of ntbytes, when there
+ * is room for them.  Returns the new size of the chunk. */
+static int append_checksums(blosc2_context* context, int ntbytes, bool run) {
+  int dict_training = context->use_dict && (context->dict_cdict == NULL);
+  int32_t checksums_len = context->nblocks * BLOSC2_CHECKSUM_SIZE;
+  if (context->block_checksums == NULL || run || dict_training || ntbytes <= context->header_overhead ||
+      context->header_overhead != BLOSC_EXTENDED_HEADER_LENGTH ||
+      (context->blosc2_flags & BLOSC2_INSTR_CODEC) ||
+      ((context->dest[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK) ||
+      ntbytes + checksums_len > context->destsize) {
+    return ntbytes;
+  }
+  for (int32_t i = 0; i < context->nblocks; i++) {
+    checksum_store(context->dest + ntbytes + i * BLOSC2_CHECKSUM_SIZE, context->block_checksums[i]);
+  }
+  context->dest[BLOSC2_CHUNK_CHECKSUM] = (uint8_t)context->checksum;
+  return ntbytes + checksums_len;
+}
+
+/* Draw a new nonce for the chunk being compressed, and take the aad of its blocks out of
+ * its header, before a pass over its blocks (if it has a cipher) */
+static int start_cipher(blosc2_context* context) {
+  if (context->cipher == BLOSC2_CIPHER_NONE) {
+    return 0;
+  }
+  build_cipher_aad(context->dest, context->header_flags, context->cipher_aad);
+  return cipher_random(context->chunk_nonce, BLOSC2_CIPHER_NONCE_SIZE);
+}
+
+/* Store the cipher data of the blocks at the end of a regular chunk of ntbytes (the room for
+ * it is kept since the start).  Returns the new size of the chunk. */
+static int append_cipher(blosc2_context* context, int ntbytes) {
+  if (context->cipher == BLOSC2_CIPHER_NONE || ntbytes <= context->header_overhead) {
+    return ntbytes;
+  }
+  uint8_t* cipher_data = context->dest + ntbytes;
+  memcpy(cipher_data, context->chunk_nonce, BLOSC2_CIPHER_NONCE_SIZE);
+  memcpy(cipher_data + BLOSC2_CIPHER_NONCE_SIZE, context->cipher_blocks,
+         (size_t)context->nblocks * CIPHER_BLOCK_SIZE);
+  context->dest[BLOSC2_CHUNK_CHECKSUM] |= (uint8_t)(context->cipher << 4);
+  return ntbytes + cipher_data_len(context->nblocks);
+}
+
 static int blosc_compress_context(blosc2_context* context) {
   int ntbytes = 0;
   blosc_timestamp_t last, current;
   bool memcpyed = context->header_flags & (uint8_t)BLOSC_MEMCPYED;
+  bool run = false;
 
   blosc_set_timestamp(&last);
 
-  if (!memcpyed) {
+  if (context->record_stats) {
+    if (context->block_csizes_len < context->nblocks) {
+      ctx_free(context, context->block_csizes);
+      context->block_csizes = ctx_malloc(context, context->nblocks * sizeof(int32_t));
+      BLOSC_ERROR_NULL(context->block_csizes, BLOSC2_ERROR_MEMORY_ALLOC);
+      context->block_csizes_len = context->nblocks;
+    }
+    memset(context->block_csizes, 0, context->nblocks * sizeof(int32_t));
+  }
+  if (context->zonemap != BLOSC2_ZONEMAP_NONE && context->prefilter == NULL) {
+    if (context->block_zonemaps_len < context->nblocks) {
+      ctx_free(context, context->block_zonemaps);
+      context->block_zonemaps = ctx_malloc(context, context->nblocks * sizeof(blosc2_zonemap));
+      BLOSC_ERROR_NULL(context->block_zonemaps, BLOSC2_ERROR_MEMORY_ALLOC);
+      context->block_zonemaps_len = context->nblocks;
+    }
+  }
+  if (context->checksum != BLOSC2_CHECKSUM_NONE) {
+    if (context->block_checksums_len < context->nblocks) {
+      ctx_free(context, context->block_checksums);
+      context->block_checksums = ctx_malloc(context, context->nblocks * sizeof(uint64_t));
+      BLOSC_ERROR_NULL(context->block_checksums, BLOSC2_ERROR_MEMORY_ALLOC);
+      context->block_checksums_len = context->nblocks;
+    }
+  }
+  int32_t cipher_len = 0;
+  if (context->cipher != BLOSC2_CIPHER_NONE && context->sourcesize > 0) {
+    if (context->cipher_blocks_len < context->nblocks) {
+      ctx_free(context, context->cipher_blocks);
+      context->cipher_blocks = ctx_malloc(context, (size_t)context->nblocks * CIPHER_BLOCK_SIZE);
+      BLOSC_ERROR_NULL(context->cipher_blocks, BLOSC2_ERROR_MEMORY_ALLOC);
+      context->cipher_blocks_len = context->nblocks;
+    }
+    /* The blocks cannot be decrypted without their cipher data, so its room is kept apart */
+    cipher_len = cipher_data_len(context->nblocks);
+    if (context->destsize < context->header_overhead + cipher_len) {
+      return 0;
+    }
+    context->destsize -= cipher_len;
+  }
+
+  if (!memcpyed && context->cipher == BLOSC2_CIPHER_NONE) {
+    /* Runs of a single value take the special value shortcut (the value would go in the clear) */
+    ntbytes = compress_run(context);
+    run = ntbytes > 0;
+  }
+  if (!memcpyed && !run) {
     /* Do the actual compression */
+    int rc = start_cipher(context);
+    if (rc < 0) {
+      return rc;
+    }
     ntbytes = do_job(context);
     if (ntbytes < 0) {
       return ntbytes;
@@ -2483,19 +5102,32 @@ static int blosc_compress_context(blosc2_context* context) {
     }
     else {
       context->output_bytes = context->header_overhead;
+      context->blosc2_flags &= (uint8_t)~BLOSC2_ZSTD_PREFIX;
+      /* The blocks are encrypted again under a new nonce */
+      int rc = start_cipher(context);
+      if (rc < 0) {
+        return rc;
+      }
       ntbytes = do_job(context);
       if (ntbytes < 0) {
         return ntbytes;
       }
       // Success!  update the memcpy bit in header
       context->dest[BLOSC2_CHUNK_FLAGS] = context->header_flags;
+      if (context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) {
+        // Memcpyed chunks have no room for dicts, nor any zstd blocks
+        context->dest[BLOSC2_CHUNK_BLOSC2_FLAGS] &= ~(BLOSC2_USEDICT | BLOSC2_ZSTD_PREFIX);
+      }
       // and clear the memcpy bit in context (for next reuse)
       context->header_flags &= ~(uint8_t)BLOSC_MEMCPYED;
     }
   }
-  else {
+  else if (!run && context->cipher == BLOSC2_CIPHER_NONE) {
     // Check whether we have a run for the whole chunk
     int start_csizes = context->header_overhead + 4 * context->nblocks;
+    if (is_hybrid_chunk(context->header_flags)) {
+      start_csizes += context->nblocks;
+    }
     if (ntbytes == (int)(start_csizes + nstreams * sizeof(int32_t))) {
       // The streams are all zero runs (by construction).  Encode it...
       context->dest[BLOSC2_CHUNK_BLOSC2_FLAGS] |= BLOSC2_SPECIAL_ZERO << 4;
@@ -2504,6 +5136,18 @@ static int blosc_compress_context(blosc2_context* context) {
     }
   }
 
+  ntbytes = append_checksums(context, ntbytes, run);
+  context->destsize += cipher_len;
+  ntbytes = append_cipher(context, ntbytes);
+
+  context->stats.ncalls++;
+  context->stats.nbytes_in += context->sourcesize;
+  context->stats.nbytes_out += ntbytes;
+  if (context->sourcesize > 0 && ntbytes == context->header_overhead &&
+      context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) {
+    context->stats.nspecial_chunks++;
+  }
+
   /* Set the number of compressed bytes in header */
   _sw32(context->dest + BLOSC2_CHUNK_CBYTES, ntbytes);
   if (context->blosc2_flags & BLOSC2_INSTR_CODEC) {
@@ -2539,13 +5183,166 @@ static int blosc_compress_context(blosc2_context* context) {
       return BLOSC2_ERROR_INVALID_PARAM;
       urtunersuccess:;
     }
-    if (rc < 0) {
-      BLOSC_TRACE_ERROR("Error in tuner update func\n");
-      return BLOSC2_ERROR_TUNER;
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Error in tuner update func\n");
+      return BLOSC2_ERROR_TUNER;
+    }
+  }
+
+  return ntbytes;
+}
+
+
+/* Train a dictionary out of the filters outcome, which the first pass of the compression
+ * left in the destination.  Returns the size of the dictionary, or a negative error code. */
+static int32_t train_dict(blosc2_context* context, void* dict_buffer, int32_t dict_maxsize) {
+  uint8_t* samples_buffer = context->dest + context->header_overhead;
+  unsigned nblocks = 8;  // the minimum that accepts zstd as of 1.4.0
+  unsigned sample_fraction = 1;  // 1 allows to use most of the chunk for training
+  size_t sample_size = context->sourcesize / nblocks / sample_fraction;
+
+#ifdef HAVE_ZSTD
+  // Populate the samples sizes for training the dictionary
+  size_t* samples_sizes = malloc(nblocks * sizeof(void*));
+  BLOSC_ERROR_NULL(samples_sizes, BLOSC2_ERROR_MEMORY_ALLOC);
+  for (size_t i = 0; i < nblocks; i++) {
+    samples_sizes[i] = sample_size;
+  }
+
+  // Train from samples
+  size_t dict_actual_size = ZDICT_trainFromBuffer(dict_buffer, dict_maxsize, samples_buffer, samples_sizes, nblocks);
+  free(samples_sizes);
+
+  // TODO: experiment with parameters of low-level fast cover algorithm
+  // Note that this API is still unstable.  See: https://github.com/facebook/zstd/issues/1599
+  // ZDICT_fastCover_params_t fast_cover_params;
+  // memset(&fast_cover_params, 0, sizeof(fast_cover_params));
+  // fast_cover_params.d = nblocks;
+  // fast_cover_params.steps = 4;
+  // fast_cover_params.zParams.compressionLevel = context->clevel;
+  //size_t dict_actual_size = ZDICT_optimizeTrainFromBuffer_fastCover(dict_buffer, dict_maxsize, samples_buffer, samples_sizes, nblocks, &fast_cover_params);
+
+  if (context->compcode == BLOSC_ZSTD) {
+    if (ZDICT_isError(dict_actual_size) != ZSTD_error_no_error) {
+      BLOSC_TRACE_ERROR("Error in ZDICT_trainFromBuffer(): '%s'."
+                        "  Giving up.", ZDICT_getErrorName(dict_actual_size));
+      return BLOSC2_ERROR_CODEC_DICT;
+    }
+    assert(dict_actual_size > 0);
+    return (int32_t)dict_actual_size;
+  }
+  if (ZDICT_isError(dict_actual_size) == ZSTD_error_no_error) {
+    // LZ4 and BloscLZ only use the content, not the entropy tables in the header
+    size_t header_size = ZDICT_getDictHeaderSize(dict_buffer, dict_actual_size);
+    if (ZDICT_isError(header_size) == ZSTD_error_no_error && header_size < dict_actual_size) {
+      dict_actual_size -= header_size;
+      memmove(dict_buffer, (uint8_t*)dict_buffer + header_size, dict_actual_size);
+      return (int32_t)dict_actual_size;
+    }
+  }
+  // Too few data for training (or ZSTD is not there), so fall back to a raw dictionary below
+#endif  // HAVE_ZSTD
+
+  // A raw dictionary made of the first bytes of (up to) nblocks samples
+  size_t slice_size = dict_maxsize / nblocks;
+  if (slice_size > sample_size) {
+    slice_size = sample_size;
+  }
+  if (slice_size == 0) {
+    BLOSC_TRACE_ERROR("The chunk is too small for building a dict.  Giving up.");
+    return BLOSC2_ERROR_CODEC_DICT;
+  }
+  for (size_t i = 0; i < nblocks; i++) {
+    memcpy((uint8_t*)dict_buffer + i * slice_size, samples_buffer + i * sample_size, slice_size);
+  }
+  return (int32_t)(nblocks * slice_size);
+}
+
+
+/* Digest the dictionary in context->dict_buffer for the codec in use */
+static int create_cdict(blosc2_context* context) {
+  switch (context->compcode) {
+#ifdef HAVE_ZSTD
+    case BLOSC_ZSTD:
+      context->dict_cdict = ZSTD_createCDict(context->dict_buffer, context->dict_size, 1);  // TODO: use get_accel()
+      break;
+#endif  // HAVE_ZSTD
+    case BLOSC_LZ4: {
+      LZ4_stream_t* stream = ctx_malloc(context, sizeof(LZ4_stream_t));
+      BLOSC_ERROR_NULL(stream, BLOSC2_ERROR_MEMORY_ALLOC);
+      LZ4_initStream(stream, sizeof(LZ4_stream_t));
+      // The dictionary is referenced by the stream, and it stays in the chunk while compressing
+      LZ4_loadDict(stream, context->dict_buffer, context->dict_size);
+      context->dict_cdict = stream;
+      break;
+    }
+    case BLOSC_BLOSCLZ:
+      context->dict_cdict = blosclz_create_cdict(context->clevel, context->dict_buffer,
+                                                 context->dict_size);
+      break;
+    default:
+      break;
+  }
+  if (context->dict_cdict == NULL) {
+    BLOSC_TRACE_ERROR("Cannot digest the dict for compression.");
+    return BLOSC2_ERROR_CODEC_DICT;
+  }
+  return 0;
+}
+
+
+static void free_cdict(blosc2_context* context) {
+  if (context->dict_cdict == NULL) {
+    return;
+  }
+  switch (context->compcode) {
+#ifdef HAVE_ZSTD
+    case BLOSC_ZSTD:
+      ZSTD_freeCDict(context->dict_cdict);
+      break;
+#endif  // HAVE_ZSTD
+    case BLOSC_LZ4:
+      ctx_free(context, context->dict_cdict);
+      break;
+    case BLOSC_BLOSCLZ:
+      blosclz_free_cdict(context->dict_cdict);
+      break;
+    default:
+      break;
+  }
+  context->dict_cdict = NULL;
+}
+
+/* Digest the dictionary shared by the chunks of the super-chunk of context (if any),
+ * unless it is digested already from a previous chunk.  Returns the id of the
+ * dictionary (0 if there is none), or a negative error code. */
+static int32_t setup_shared_cdict(blosc2_context* context) {
+  shared_dict* dict = NULL;
+  if (context->use_dict && context->schunk != NULL) {
+    dict = (shared_dict*)context->schunk->shared_dict;
+  }
+  if (dict == NULL) {
+    if (context->dict_id != 0) {
+      // The digest of a shared dictionary must not pass for a per-chunk one
+      context->dict_buffer = NULL;
+      free_cdict(context);
+      context->dict_id = 0;
+    }
+    return 0;
+  }
+  if (context->dict_cdict == NULL || context->dict_id != dict->id) {
+    free_cdict(context);
+    context->dict_buffer = dict->buffer;
+    context->dict_size = dict->size;
+    context->dict_id = 0;
+    int error = create_cdict(context);
+    if (error < 0) {
+      context->dict_buffer = NULL;
+      return error;
     }
+    context->dict_id = dict->id;
   }
-
-  return ntbytes;
+  return dict->id;
 }
 
 
@@ -2569,20 +5366,33 @@ int blosc2_compress_ctx(blosc2_context* context, const void* src, int32_t srcsiz
     return error;
   }
 
+  int32_t dict_id = setup_shared_cdict(context);
+  if (dict_id < 0) {
+    return dict_id;
+  }
+
   /* Write the extended header */
   error = write_compression_header(context, true);
   if (error < 0) {
     return error;
   }
 
+  if (dict_id > 0 && !(context->header_flags & (uint8_t)BLOSC_MEMCPYED)) {
+    /* Reference the shared dictionary (negated id) where the dictionary would go */
+    _sw32(context->dest + context->output_bytes, -dict_id);
+    context->output_bytes += sizeof(int32_t);
+  }
+
   cbytes = blosc_compress_context(context);
   if (cbytes < 0) {
     return cbytes;
   }
 
-  if (context->use_dict && context->dict_cdict == NULL) {
+  bool memcpyed = context->dest[BLOSC2_CHUNK_FLAGS] & (uint8_t)BLOSC_MEMCPYED;
+  if (context->use_dict && context->dict_cdict == NULL && cbytes > 0 && !memcpyed) {
 
-    if (context->compcode != BLOSC_ZSTD) {
+    if (context->compcode != BLOSC_ZSTD && context->compcode != BLOSC_LZ4 &&
+        context->compcode != BLOSC_BLOSCLZ) {
       const char* compname;
       compname = clibcode_to_clibname(context->compcode);
       BLOSC_TRACE_ERROR("Codec %s does not support dicts.  Giving up.",
@@ -2590,46 +5400,19 @@ int blosc2_compress_ctx(blosc2_context* context, const void* src, int32_t srcsiz
       return BLOSC2_ERROR_CODEC_DICT;
     }
 
-#ifdef HAVE_ZSTD
     // Build the dictionary out of the filters outcome and compress with it
     int32_t dict_maxsize = BLOSC2_MAXDICTSIZE;
     // Do not make the dict more than 5% larger than uncompressed buffer
     if (dict_maxsize > srcsize / 20) {
       dict_maxsize = srcsize / 20;
     }
-    void* samples_buffer = context->dest + context->header_overhead;
-    unsigned nblocks = 8;  // the minimum that accepts zstd as of 1.4.0
-    unsigned sample_fraction = 1;  // 1 allows to use most of the chunk for training
-    size_t sample_size = context->sourcesize / nblocks / sample_fraction;
-
-    // Populate the samples sizes for training the dictionary
-    size_t* samples_sizes = malloc(nblocks * sizeof(void*));
-    BLOSC_ERROR_NULL(samples_sizes, BLOSC2_ERROR_MEMORY_ALLOC);
-    for (size_t i = 0; i < nblocks; i++) {
-      samples_sizes[i] = sample_size;
-    }
-
-    // Train from samples
     void* dict_buffer = malloc(dict_maxsize);
     BLOSC_ERROR_NULL(dict_buffer, BLOSC2_ERROR_MEMORY_ALLOC);
-    int32_t dict_actual_size = (int32_t)ZDICT_trainFromBuffer(dict_buffer, dict_maxsize, samples_buffer, samples_sizes, nblocks);
-
-    // TODO: experiment with parameters of low-level fast cover algorithm
-    // Note that this API is still unstable.  See: https://github.com/facebook/zstd/issues/1599
-    // ZDICT_fastCover_params_t fast_cover_params;
-    // memset(&fast_cover_params, 0, sizeof(fast_cover_params));
-    // fast_cover_params.d = nblocks;
-    // fast_cover_params.steps = 4;
-    // fast_cover_params.zParams.compressionLevel = context->clevel;
-    //size_t dict_actual_size = ZDICT_optimizeTrainFromBuffer_fastCover(dict_buffer, dict_maxsize, samples_buffer, samples_sizes, nblocks, &fast_cover_params);
-
-    if (ZDICT_isError(dict_actual_size) != ZSTD_error_no_error) {
-      BLOSC_TRACE_ERROR("Error in ZDICT_trainFromBuffer(): '%s'."
-                        "  Giving up.", ZDICT_getErrorName(dict_actual_size));
-      return BLOSC2_ERROR_CODEC_DICT;
+    int32_t dict_actual_size = train_dict(context, dict_buffer, dict_maxsize);
+    if (dict_actual_size < 0) {
+      free(dict_buffer);
+      return dict_actual_size;
     }
-    assert(dict_actual_size > 0);
-    free(samples_sizes);
 
     // Update bytes counter and pointers to bstarts for the new compressed buffer
     context->bstarts = (int32_t*)(context->dest + context->header_overhead);
@@ -2640,25 +5423,98 @@ int blosc2_compress_ctx(blosc2_context* context, const void* src, int32_t srcsiz
     /* Write the trained dict afterwards */
     context->dict_buffer = context->dest + context->output_bytes;
     memcpy(context->dict_buffer, dict_buffer, (unsigned int)dict_actual_size);
-    context->dict_cdict = ZSTD_createCDict(dict_buffer, dict_actual_size, 1);  // TODO: use get_accel()
     free(dict_buffer);      // the dictionary is copied in the header now
     context->output_bytes += (int32_t)dict_actual_size;
     context->dict_size = dict_actual_size;
+    error = create_cdict(context);
+    if (error < 0) {
+      context->dict_buffer = NULL;
+      return error;
+    }
 
     /* Compress with dict */
     cbytes = blosc_compress_context(context);
 
     // Invalidate the dictionary for compressing other chunks using the same context
     context->dict_buffer = NULL;
-    ZSTD_freeCDict(context->dict_cdict);
-    context->dict_cdict = NULL;
-#endif  // HAVE_ZSTD
+    free_cdict(context);
   }
 
   return cbytes;
 }
 
 
+int32_t build_shared_dict(const blosc2_cparams* cparams, const void* src, int32_t srcsize,
+                          uint8_t** dict) {
+  if (cparams->compcode != BLOSC_ZSTD && cparams->compcode != BLOSC_LZ4 &&
+      cparams->compcode != BLOSC_BLOSCLZ) {
+    BLOSC_TRACE_ERROR("Codec %s does not support dicts.  Giving up.",
+                      clibcode_to_clibname(cparams->compcode));
+    return BLOSC2_ERROR_CODEC_DICT;
+  }
+  blosc2_cparams params = *cparams;
+  params.use_dict = 1;
+  params.schunk = NULL;
+  params.prefilter = NULL;
+  params.preparams = NULL;
+  blosc2_context* context = blosc2_create_cctx(params);
+  BLOSC_ERROR_NULL(context, BLOSC2_ERROR_NULL_POINTER);
+
+  /* The first pass of the compression (with no dict yet) leaves the filters outcome
+   * in the destination, which is what the dictionary is trained on */
+  int32_t destsize = srcsize + BLOSC2_MAX_OVERHEAD;
+  uint8_t* dest = malloc(destsize);
+  int32_t dict_size = BLOSC2_ERROR_MEMORY_ALLOC;
+  uint8_t* dict_buffer = NULL;
+  if (dest == NULL) {
+    goto out;
+  }
+  dict_size = initialize_context_compression(
+          context, src, srcsize, dest, destsize,
+          context->clevel, context->filters, context->filters_meta,
+          context->typesize, context->compcode, context->blocksize,
+          context->new_nthreads, context->nthreads, context->splitmode,
+          context->tuner_id, context->tuner_params, NULL);
+  if (dict_size <= 0) {
+    dict_size = dict_size == 0 ? BLOSC2_ERROR_CODEC_DICT : dict_size;
+    goto out;
+  }
+  dict_size = write_compression_header(context, true);
+  if (dict_size < 0) {
+    goto out;
+  }
+  dict_size = blosc_compress_context(context);
+  if (dict_size <= 0) {
+    BLOSC_TRACE_ERROR("Cannot gather the samples for training the shared dict.");
+    dict_size = dict_size == 0 ? BLOSC2_ERROR_CODEC_DICT : dict_size;
+    goto out;
+  }
+
+  int32_t dict_maxsize = BLOSC2_MAXDICTSIZE;
+  // Do not make the dict more than 5% larger than the samples
+  if (dict_maxsize > srcsize / 20) {
+    dict_maxsize = srcsize / 20;
+  }
+  dict_buffer = malloc(dict_maxsize);
+  if (dict_buffer == NULL) {
+    dict_size = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto out;
+  }
+  dict_size = train_dict(context, dict_buffer, dict_maxsize);
+
+  out:
+  if (dict_size > 0) {
+    *dict = dict_buffer;
+  }
+  else {
+    free(dict_buffer);
+  }
+  free(dest);
+  blosc2_free_ctx(context);
+  return dict_size;
+}
+
+
 void build_filters(const int doshuffle, const int delta,
                    const int32_t typesize, uint8_t* filters) {
 
@@ -2673,18 +5529,47 @@ void build_filters(const int doshuffle, const int delta,
     filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_DELTA;
 }
 
+/* Release the implicit context of a thread (when it exits, or when the library is destroyed) */
+static void free_implicit_context(void *data) {
+  blosc2_free_ctx((blosc2_context *)data);
+}
+
+/* The implicit context of the calling thread, which is created on its first use */
+static blosc2_context* get_implicit_context(void) {
+  blosc2_context *context = (blosc2_context *)pthread_getspecific(g_implicit_context_key);
+  if (context != NULL) {
+    return context;
+  }
+  context = (blosc2_context*)ctx_malloc(NULL, sizeof(blosc2_context));
+  if (context == NULL) {
+    BLOSC_TRACE_ERROR("Error while creating the implicit context");
+    return NULL;
+  }
+  memset(context, 0, sizeof(blosc2_context));
+  context->allocator = g_allocator;
+  context->nthreads = g_nthreads;
+  context->new_nthreads = g_nthreads;
+  context->implicit = true;
+  if (pthread_setspecific(g_implicit_context_key, context) != 0) {
+    free_implicit_context(context);
+    BLOSC_TRACE_ERROR("Error while setting the implicit context of the thread");
+    return NULL;
+  }
+  return context;
+}
+
 /* The public secure routine for compression. */
 int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
                     const void* src, int32_t srcsize, void* dest, int32_t destsize) {
   int error;
   int result;
-  char* envvar;
+  const char* envvar;
 
   /* Check whether the library should be initialized */
   if (!g_initlib) blosc2_init();
 
   /* Check for a BLOSC_CLEVEL environment variable */
-  envvar = getenv("BLOSC_CLEVEL");
+  envvar = blosc_getenv(BLOSC_ENV_CLEVEL);
   if (envvar != NULL) {
     long value;
     value = strtol(envvar, NULL, 10);
@@ -2697,7 +5582,7 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   }
 
   /* Check for a BLOSC_SHUFFLE environment variable */
-  envvar = getenv("BLOSC_SHUFFLE");
+  envvar = blosc_getenv(BLOSC_ENV_SHUFFLE);
   if (envvar != NULL) {
     if (strcmp(envvar, "NOSHUFFLE") == 0) {
       doshuffle = BLOSC_NOSHUFFLE;
@@ -2714,7 +5599,7 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   }
 
   /* Check for a BLOSC_DELTA environment variable */
-  envvar = getenv("BLOSC_DELTA");
+  envvar = blosc_getenv(BLOSC_ENV_DELTA);
   if (envvar != NULL) {
     if (strcmp(envvar, "1") == 0) {
       blosc2_set_delta(1);
@@ -2727,7 +5612,7 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   }
 
   /* Check for a BLOSC_TYPESIZE environment variable */
-  envvar = getenv("BLOSC_TYPESIZE");
+  envvar = blosc_getenv(BLOSC_ENV_TYPESIZE);
   if (envvar != NULL) {
     long value;
     value = strtol(envvar, NULL, 10);
@@ -2740,7 +5625,7 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   }
 
   /* Check for a BLOSC_COMPRESSOR environment variable */
-  envvar = getenv("BLOSC_COMPRESSOR");
+  envvar = blosc_getenv(BLOSC_ENV_COMPRESSOR);
   if (envvar != NULL) {
     result = blosc1_set_compressor(envvar);
     if (result < 0) {
@@ -2749,7 +5634,7 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   }
 
   /* Check for a BLOSC_BLOCKSIZE environment variable */
-  envvar = getenv("BLOSC_BLOCKSIZE");
+  envvar = blosc_getenv(BLOSC_ENV_BLOCKSIZE);
   if (envvar != NULL) {
     long blocksize;
     blocksize = strtol(envvar, NULL, 10);
@@ -2762,7 +5647,7 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   }
 
   /* Check for a BLOSC_NTHREADS environment variable */
-  envvar = getenv("BLOSC_NTHREADS");
+  envvar = blosc_getenv(BLOSC_ENV_NTHREADS);
   if (envvar != NULL) {
     long nthreads;
     nthreads = strtol(envvar, NULL, 10);
@@ -2775,7 +5660,7 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   }
 
   /* Check for a BLOSC_SPLITMODE environment variable */
-  envvar = getenv("BLOSC_SPLITMODE");
+  envvar = blosc_getenv(BLOSC_ENV_SPLITMODE);
   if (envvar != NULL) {
     int32_t splitmode = -1;
     if (strcmp(envvar, "ALWAYS") == 0) {
@@ -2802,7 +5687,7 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   /* Check for a BLOSC_NOLOCK environment variable.  It is important
      that this should be the last env var so that it can take the
      previous ones into account */
-  envvar = getenv("BLOSC_NOLOCK");
+  envvar = blosc_getenv(BLOSC_ENV_NOLOCK);
   if (envvar != NULL) {
     // TODO: here is the only place that returns an extended header from
     //  a blosc1_compress() call.  This should probably be fixed.
@@ -2831,7 +5716,13 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
     return result;
   }
 
-  pthread_mutex_lock(&global_comp_mutex);
+  blosc2_context *context = get_implicit_context();
+  BLOSC_ERROR_NULL(context, BLOSC2_ERROR_MEMORY_ALLOC);
+  if (context->nthreads != g_nthreads) {
+    /* Restart the threads of the context with the current number of them */
+    context->new_nthreads = g_nthreads;
+    check_nthreads(context);
+  }
 
   /* Initialize a context compression */
   uint8_t* filters = calloc(1, BLOSC2_MAX_FILTERS);
@@ -2840,34 +5731,28 @@ int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
   BLOSC_ERROR_NULL(filters_meta, BLOSC2_ERROR_MEMORY_ALLOC);
   build_filters(doshuffle, g_delta, typesize, filters);
   error = initialize_context_compression(
-          g_global_context, src, srcsize, dest, destsize, clevel, filters,
+          context, src, srcsize, dest, destsize, clevel, filters,
           filters_meta, (int32_t)typesize, g_compressor, g_force_blocksize, g_nthreads, g_nthreads,
           g_splitmode, g_tuner, NULL, g_schunk);
   free(filters);
   free(filters_meta);
   if (error <= 0) {
-    pthread_mutex_unlock(&global_comp_mutex);
     return error;
   }
 
-  envvar = getenv("BLOSC_BLOSC1_COMPAT");
+  envvar = blosc_getenv(BLOSC_ENV_BLOSC1_COMPAT);
   if (envvar != NULL) {
     /* Write chunk header without extended header (Blosc1 compatibility mode) */
-    error = write_compression_header(g_global_context, false);
+    error = write_compression_header(context, false);
   }
   else {
-    error = write_compression_header(g_global_context, true);
+    error = write_compression_header(context, true);
   }
   if (error < 0) {
-    pthread_mutex_unlock(&global_comp_mutex);
     return error;
   }
 
-  result = blosc_compress_context(g_global_context);
-
-  pthread_mutex_unlock(&global_comp_mutex);
-
-  return result;
+  return blosc_compress_context(context);
 }
 
 
@@ -2879,6 +5764,82 @@ int blosc1_compress(int clevel, int doshuffle, size_t typesize, size_t nbytes,
 
 
 
+#ifdef HAVE_CUDA
+/* Decompress an initialized context into device memory.  The chunks that cannot be
+   decompressed on the GPU are decompressed into a host buffer, which is copied afterwards. */
+static int run_cuda_decompression(blosc2_context* context, void* dest) {
+  int32_t ntbytes = 0;
+  int rc = cuda_decompress(context, &ntbytes);
+  if (rc != 0) {
+    return rc < 0 ? rc : ntbytes;
+  }
+
+  uint8_t* host_dest = ctx_malloc(context, context->sourcesize > 0 ? context->sourcesize : 1);
+  BLOSC_ERROR_NULL(host_dest, BLOSC2_ERROR_MEMORY_ALLOC);
+  context->dest = host_dest;
+  context->lazy_stream = open_shared_lazy_stream(context, context->src, context->srcsize);
+  ntbytes = do_job(context);
+  if (context->lazy_stream != NULL) {
+    blosc2_get_io_cb(context->schunk->storage->io->id)->close(context->lazy_stream);
+    context->lazy_stream = NULL;
+  }
+  if (ntbytes > 0) {
+    rc = cuda_copy_to_device(context, dest, host_dest, ntbytes);
+    if (rc < 0) {
+      ntbytes = rc;
+    }
+  }
+  context->dest = dest;
+  ctx_free(context, host_dest);
+  return ntbytes;
+}
+#endif
+
+
+/* Set up a fresh state for every thread that can run the block postfilter */
+static int start_block_postfilter(blosc2_context* context) {
+  // The threads are not (re)started until the job, so take the larger of both counts
+  int32_t nstates = context->new_nthreads > context->nthreads ? context->new_nthreads : context->nthreads;
+  context->block_states = ctx_malloc(context, nstates * sizeof(struct blosc_block_state));
+  BLOSC_ERROR_NULL(context->block_states, BLOSC2_ERROR_MEMORY_ALLOC);
+  memset(context->block_states, 0, nstates * sizeof(struct blosc_block_state));
+  context->block_nstates = nstates;
+  return 0;
+}
+
+
+/* Combine the states of the threads that got any block (if the decompression succeeded) and release them */
+static int finish_block_postfilter(blosc2_context* context, bool combine) {
+  blosc2_block_postfilter* block_postfilter = context->block_postfilter;
+  int rc = 0;
+  void** states = ctx_malloc(context, context->block_nstates * sizeof(void*));
+  BLOSC_ERROR_NULL(states, BLOSC2_ERROR_MEMORY_ALLOC);
+  int32_t nstates = 0;
+  for (int32_t tid = 0; tid < context->block_nstates; tid++) {
+    if (context->block_states[tid].started) {
+      states[nstates++] = context->block_states[tid].state;
+    }
+  }
+  if (combine && block_postfilter->combine != NULL &&
+      block_postfilter->combine(block_postfilter->user_data, states, nstates) != 0) {
+    BLOSC_TRACE_ERROR("Combining the states of the block postfilter failed");
+    rc = BLOSC2_ERROR_POSTFILTER;
+  }
+  if (block_postfilter->free != NULL) {
+    for (int32_t i = 0; i < nstates; i++) {
+      block_postfilter->free(block_postfilter->user_data, states[i]);
+    }
+  }
+  ctx_free(context, states);
+  ctx_free(context, context->block_states);
+  context->block_states = NULL;
+  context->block_nstates = 0;
+  return rc;
+}
+
+
+static int run_decompression(blosc2_context* context, blosc_header* header, const void* src, int32_t srcsize);
+
 static int blosc_run_decompression_with_context(blosc2_context* context, const void* src, int32_t srcsize,
                                                 void* dest, int32_t destsize) {
   blosc_header header;
@@ -2900,17 +5861,66 @@ static int blosc_run_decompression_with_context(blosc2_context* context, const v
     return rc;
   }
 
-  /* Do the actual decompression */
-  ntbytes = do_job(context);
+#ifdef HAVE_CUDA
+  if (context->device == BLOSC2_DEVICE_CUDA) {
+    return run_cuda_decompression(context, dest);
+  }
+#endif
+
+  ntbytes = run_decompression(context, &header, src, srcsize);
   if (ntbytes < 0) {
     return ntbytes;
   }
 
+  context->stats.ncalls++;
+  context->stats.nbytes_in += header.cbytes;
+  context->stats.nbytes_out += ntbytes;
+  if (context->special_type) {
+    context->stats.nspecial_chunks++;
+  }
+
   assert(ntbytes <= (int32_t)destsize);
   return ntbytes;
 }
 
 
+/* Decompress the blocks of the chunk in src (that are not masked out) into an initialized context */
+static int run_decompression(blosc2_context* context, blosc_header* header, const void* src, int32_t srcsize) {
+  int32_t ntbytes;
+  int rc;
+
+  if (context->block_postfilter != NULL) {
+    rc = start_block_postfilter(context);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  /* Do the actual decompression */
+  context->lazy_stream = open_shared_lazy_stream(context, src, srcsize);
+  // The blocks of a lazy chunk that are needed are read in a few large reads, and the
+  // first ones are decompressed while the next ones are read
+  ntbytes = prefetch_lazy_blocks(context, src, srcsize, header->flags & (uint8_t)BLOSC_MEMCPYED,
+                                 0, context->nblocks, true);
+  if (ntbytes == 0) {
+    ntbytes = do_job(context);
+  }
+  free_lazy_blocks(context);
+  if (context->lazy_stream != NULL) {
+    blosc2_get_io_cb(context->schunk->storage->io->id)->close(context->lazy_stream);
+    context->lazy_stream = NULL;
+  }
+  if (context->block_postfilter != NULL) {
+    rc = finish_block_postfilter(context, ntbytes >= 0);
+    if (rc < 0 && ntbytes >= 0) {
+      ntbytes = rc;
+    }
+  }
+
+  return ntbytes;
+}
+
+
 /* The public secure routine for decompression with context. */
 int blosc2_decompress_ctx(blosc2_context* context, const void* src, int32_t srcsize,
                           void* dest, int32_t destsize) {
@@ -2923,12 +5933,17 @@ int blosc2_decompress_ctx(blosc2_context* context, const void* src, int32_t srcs
 
   result = blosc_run_decompression_with_context(context, src, srcsize, dest, destsize);
 
-  // Reset a possible block_maskout
+  // Reset a possible block_maskout (and the boxes of the blocks)
   if (context->block_maskout != NULL) {
-    free(context->block_maskout);
+    ctx_free(context, context->block_maskout);
     context->block_maskout = NULL;
   }
   context->block_maskout_nitems = 0;
+  if (context->zfp_boxes != NULL) {
+    ctx_free(context, context->zfp_boxes);
+    context->zfp_boxes = NULL;
+  }
+  context->zfp_boxes_nitems = 0;
 
   return result;
 }
@@ -2937,7 +5952,7 @@ int blosc2_decompress_ctx(blosc2_context* context, const void* src, int32_t srcs
 /* The public secure routine for decompression. */
 int blosc2_decompress(const void* src, int32_t srcsize, void* dest, int32_t destsize) {
   int result;
-  char* envvar;
+  const char* envvar;
   long nthreads;
   blosc2_context *dctx;
   blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
@@ -2946,7 +5961,7 @@ int blosc2_decompress(const void* src, int32_t srcsize, void* dest, int32_t dest
   if (!g_initlib) blosc2_init();
 
   /* Check for a BLOSC_NTHREADS environment variable */
-  envvar = getenv("BLOSC_NTHREADS");
+  envvar = blosc_getenv(BLOSC_ENV_NTHREADS);
   if (envvar != NULL) {
     nthreads = strtol(envvar, NULL, 10);
     if ((nthreads != EINVAL) && (nthreads > 0)) {
@@ -2960,7 +5975,7 @@ int blosc2_decompress(const void* src, int32_t srcsize, void* dest, int32_t dest
   /* Check for a BLOSC_NOLOCK environment variable.  It is important
      that this should be the last env var so that it can take the
      previous ones into account */
-  envvar = getenv("BLOSC_NOLOCK");
+  envvar = blosc_getenv(BLOSC_ENV_NOLOCK);
   if (envvar != NULL) {
     dparams.nthreads = g_nthreads;
     dctx = blosc2_create_dctx(dparams);
@@ -2973,14 +5988,12 @@ int blosc2_decompress(const void* src, int32_t srcsize, void* dest, int32_t dest
     return result;
   }
 
-  pthread_mutex_lock(&global_comp_mutex);
-
-  result = blosc_run_decompression_with_context(
-          g_global_context, src, srcsize, dest, destsize);
+  dctx = get_implicit_context();
+  BLOSC_ERROR_NULL(dctx, BLOSC2_ERROR_MEMORY_ALLOC);
+  dctx->new_nthreads = g_nthreads;
+  dctx->schunk = g_schunk;
 
-  pthread_mutex_unlock(&global_comp_mutex);
-
-  return result;
+  return blosc_run_decompression_with_context(dctx, src, srcsize, dest, destsize);
 }
 
 
@@ -3012,7 +6025,17 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
     return BLOSC2_ERROR_WRITE_BUFFER;
   }
 
+  // The items are few and go to dest through the temporaries, so they are not streamed
+  context->stream_dest = false;
   context->bstarts = (int32_t*)(_src + context->header_overhead);
+  rc = setup_src_checksums(context, _src, srcsize);
+  if (rc < 0) {
+    return rc;
+  }
+  rc = setup_src_cipher(context, _src, srcsize);
+  if (rc < 0) {
+    return rc;
+  }
 
   /* Check region boundaries */
   if ((start < 0) || (start * header->typesize > header->nbytes)) {
@@ -3031,6 +6054,27 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
     BLOSC_TRACE_ERROR("`bstarts` out of bounds.");
     return BLOSC2_ERROR_READ_BUFFER;
   }
+  context->block_codecs = NULL;
+  if (!context->special_type && is_hybrid_chunk(header->flags)) {
+    context->block_codecs = (uint8_t*)(context->bstarts + context->nblocks);
+    if (_src + srcsize < context->block_codecs + context->nblocks) {
+      BLOSC_TRACE_ERROR("The codecs of the blocks are out of bounds.");
+      return BLOSC2_ERROR_READ_BUFFER;
+    }
+  }
+  context->dref = NULL;
+  int32_t dref_len = stored_dref_len(_src);
+  if (dref_len > 0) {
+    context->dref = (uint8_t*)(context->bstarts + context->nblocks);
+    if (context->block_codecs != NULL) {
+      context->dref += context->nblocks;
+    }
+    if (_src + srcsize < context->dref + dref_len) {
+      BLOSC_TRACE_ERROR("The reference block of the delta filter is out of bounds.");
+      context->dref = NULL;
+      return BLOSC2_ERROR_READ_BUFFER;
+    }
+  }
 
   bool memcpyed = header->flags & (uint8_t)BLOSC_MEMCPYED;
   if (context->special_type) {
@@ -3040,8 +6084,8 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
 
   bool is_lazy = ((context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH) &&
                   (context->blosc2_flags & 0x08u) && !context->special_type);
-  if (memcpyed && !is_lazy && !context->postfilter) {
-    // Short-circuit for (non-lazy) memcpyed or special values
+  if (memcpyed && !is_lazy && !context->postfilter && context->src_cipher == NULL) {
+    // Short-circuit for (non-lazy, non-encrypted) memcpyed or special values
     ntbytes = nitems * header->typesize;
     switch (context->special_type) {
       case BLOSC2_SPECIAL_VALUE:
@@ -3065,6 +6109,9 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
       case BLOSC2_SPECIAL_UNINIT:
         // We do nothing here
         break;
+      case BLOSC2_SPECIAL_VIRTUAL:
+        BLOSC_TRACE_ERROR("Virtual chunks can only be decompressed with a postfilter");
+        return BLOSC2_ERROR_POSTFILTER;
       case BLOSC2_NO_SPECIAL:
         _src += context->header_overhead + start * context->typesize;
         memcpy(_dest, _src, ntbytes);
@@ -3078,16 +6125,46 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
 
   ebsize = header->blocksize + header->typesize * (signed)sizeof(int32_t);
   struct thread_context* scontext = context->serial_context;
+  // The codecs that can decode a few items of a block are told which ones
+  bool getitems = !memcpyed && context->block_codecs == NULL && codec_getitems(context->compcode) != NULL;
   /* Resize the temporaries in serial context if needed */
   if (header->blocksize > scontext->tmp_blocksize) {
-    my_free(scontext->tmp);
-    scontext->tmp_nbytes = (size_t)4 * ebsize;
-    scontext->tmp = my_malloc(scontext->tmp_nbytes);
-    BLOSC_ERROR_NULL(scontext->tmp, BLOSC2_ERROR_MEMORY_ALLOC);
-    scontext->tmp2 = scontext->tmp + ebsize;
-    scontext->tmp3 = scontext->tmp2 + ebsize;
-    scontext->tmp4 = scontext->tmp3 + ebsize;
-    scontext->tmp_blocksize = (int32_t)header->blocksize;
+    int rc = set_thread_tmp(scontext, (int32_t)header->blocksize, ebsize);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  // The blocks with a zstd prefix need all the ones before
+  bool prefixed = context->blosc2_flags & BLOSC2_ZSTD_PREFIX;
+  // The blocks of a lazy chunk are read at once when there are several
+  rc = prefetch_lazy_blocks(context, _src, srcsize, memcpyed,
+                            prefixed ? 0 : start * header->typesize / header->blocksize,
+                            (stop * header->typesize - 1) / header->blocksize + 1, false);
+  if (rc < 0) {
+    free_lazy_blocks(context);
+    return rc;
+  }
+
+  // The blocks are delta coded wrt the first one as decoded, so it goes first
+  uint8_t* dref_block = NULL;
+  if (context->dref == NULL && !memcpyed && uses_decoded_dref(context)) {
+    dref_block = ctx_malloc(context, header->blocksize);
+    if (dref_block == NULL) {
+      free_lazy_blocks(context);
+      BLOSC_ERROR_NULL(dref_block, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+    bsize = (context->nblocks == 1 && context->leftover > 0) ? context->leftover : header->blocksize;
+    scontext->cell_nitems = 0;
+    context->dref_not_init = 1;
+    int32_t cbytes = blosc_d(scontext, bsize, bsize < header->blocksize, memcpyed, src, srcsize,
+                             sw32_(context->bstarts), 0, dref_block, 0, scontext->tmp, scontext->tmp3);
+    if (cbytes < 0) {
+      ctx_free(context, dref_block);
+      free_lazy_blocks(context);
+      return cbytes;
+    }
+    context->dref = dref_block;
   }
 
   for (j = 0; j < context->nblocks; j++) {
@@ -3106,6 +6183,14 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
       break;
     }
     if (startb >= header->blocksize) {
+      if (prefixed) {
+        int32_t cbytes = blosc_d(scontext, bsize, leftoverblock, memcpyed, src, srcsize,
+                                 sw32_(context->bstarts + j), j, scontext->tmp2, 0, scontext->tmp, scontext->tmp3);
+        if (cbytes < 0) {
+          ntbytes = cbytes;
+          break;
+        }
+      }
       continue;
     }
     if (startb < 0) {
@@ -3116,17 +6201,17 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
     }
     bsize2 = stopb - startb;
 
-#if defined(HAVE_PLUGINS)
-    if (context->compcode == BLOSC_CODEC_ZFP_FIXED_RATE) {
-      scontext->zfp_cell_start = startb / context->typesize;
-      scontext->zfp_cell_nitems = nitems;
+    if (getitems) {
+      // The blocks that are asked for as a whole are decoded as usual
+      scontext->cell_start = startb / context->typesize;
+      scontext->cell_nitems = (bsize2 < bsize) ? bsize2 / context->typesize : 0;
     }
-#endif /* HAVE_PLUGINS */
 
     /* Do the actual data copy */
     // Regular decompression.  Put results in tmp2.
     // If the block is aligned and the worst case fits in destination, let's avoid a copy
-    bool get_single_block = ((startb == 0) && (bsize == nitems * header->typesize));
+    // (only when it is all that is asked for, as it goes to the start of dest)
+    bool get_single_block = ((startb == 0) && (bsize == nitems * header->typesize) && (ntbytes == 0));
     uint8_t* tmp2 = get_single_block ? dest : scontext->tmp2;
 
     // If memcpyed we don't have a bstarts section (because it is not needed)
@@ -3140,11 +6225,12 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
       ntbytes = cbytes;
       break;
     }
-    if (scontext->zfp_cell_nitems > 0) {
+    if (scontext->cell_nitems > 0) {
       if (cbytes == bsize2) {
-        memcpy((uint8_t *) dest, tmp2, (unsigned int) bsize2);
-      } else if (cbytes == context->blocksize) {
-        memcpy((uint8_t *) dest, tmp2 + scontext->zfp_cell_start * context->typesize, (unsigned int) bsize2);
+        memcpy((uint8_t *) dest + ntbytes, tmp2, (unsigned int) bsize2);
+      } else if (cbytes == bsize) {
+        // The whole block has been decoded (e.g. when stored as is)
+        memcpy((uint8_t *) dest + ntbytes, tmp2 + scontext->cell_start * context->typesize, (unsigned int) bsize2);
         cbytes = bsize2;
       }
     } else if (!get_single_block) {
@@ -3154,12 +6240,36 @@ int _blosc_getitem(blosc2_context* context, blosc_header* header, const void* sr
     ntbytes += bsize2;
   }
 
-  scontext->zfp_cell_nitems = 0;
+  scontext->cell_nitems = 0;
+  free_lazy_blocks(context);
+  ctx_free(context, dref_block);
+  context->dref = NULL;
 
   return ntbytes;
 }
 
+#define GETITEM_THREADED_MIN_BLOCKS 2  /* the whole blocks of a span of items to use the threads */
+
+/* Whether the bytes [begin, end) of a chunk are worth decompressing with the threads, and the blocks
+ * [*first, *last) that are wholly inside them */
+static bool threaded_range(const blosc_header* header, int64_t begin, int64_t end, int32_t* first, int32_t* last) {
+  int32_t blocksize = header->blocksize;
+  int32_t nblocks = header->nbytes / blocksize + (header->nbytes % blocksize > 0);
+  *first = (int32_t)((begin + blocksize - 1) / blocksize);
+  *last = end == header->nbytes ? nblocks : (int32_t)(end / blocksize);
+  // Few blocks are not worth the threads, the special chunks are cheap already and the blocks with a
+  // zstd prefix need all the ones before
+  return *last - *first >= GETITEM_THREADED_MIN_BLOCKS &&
+         ((header->blosc2_flags >> 4) & BLOSC2_SPECIAL_MASK) == BLOSC2_NO_SPECIAL &&
+         !(header->blosc2_flags & BLOSC2_ZSTD_PREFIX);
+}
+
 int blosc2_getitem(const void* src, int32_t srcsize, int start, int nitems, void* dest, int32_t destsize) {
+  return ctx_getitem(NULL, src, srcsize, start, nitems, dest, destsize);
+}
+
+int ctx_getitem(blosc2_context* parent, const void* src, int32_t srcsize, int start, int nitems,
+                void* dest, int32_t destsize) {
   blosc2_context context;
   int result;
 
@@ -3167,6 +6277,7 @@ int blosc2_getitem(const void* src, int32_t srcsize, int start, int nitems, void
   memset(&context, 0, sizeof(blosc2_context));
 
   context.schunk = g_schunk;
+  context.allocator = parent != NULL ? parent->allocator : g_allocator;
   context.nthreads = 1;  // force a serial decompression; fixes #95
 
   /* Call the actual getitem function */
@@ -3190,12 +6301,27 @@ int blosc2_getitem_ctx(blosc2_context* context, const void* src, int32_t srcsize
   blosc_header header;
   int result;
 
+  if (context->device != BLOSC2_DEVICE_HOST) {
+    BLOSC_TRACE_ERROR("Getting items is only supported for host memory.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
   /* Minimally populate the context */
   result = read_chunk_header((uint8_t *) src, srcsize, true, &header);
   if (result < 0) {
     return result;
   }
 
+  // The spans of several blocks go to the threads of a decompression context
+  int64_t begin = (int64_t)start * header.typesize;
+  int64_t end = ((int64_t)start + nitems) * header.typesize;
+  int32_t first;
+  int32_t last;
+  if (context->nthreads > 1 && context->do_compress == 0 && start >= 0 && nitems >= 0 &&
+      end <= header.nbytes && end - begin <= destsize && threaded_range(&header, begin, end, &first, &last)) {
+    return blosc2_decompress_range_ctx(context, src, srcsize, start, nitems, dest, destsize);
+  }
+
   context->src = src;
   context->srcsize = srcsize;
   context->dest = dest;
@@ -3212,11 +6338,255 @@ int blosc2_getitem_ctx(blosc2_context* context, const void* src, int32_t srcsize
   BLOSC_ERROR_NULL(context->serial_context, BLOSC2_ERROR_THREAD_CREATE);
   /* Call the actual getitem function */
   result = _blosc_getitem(context, &header, src, srcsize, start, nitems, dest, destsize);
+  merge_stats(&context->stats, &context->serial_context->stats);
+  if (result >= 0) {
+    context->stats.ncalls++;
+    context->stats.nbytes_out += result;
+    if (context->special_type) {
+      context->stats.nspecial_chunks++;
+    }
+  }
 
   return result;
 }
 
+int blosc2_decompress_range_ctx(blosc2_context* context, const void* src, int32_t srcsize,
+                                int start, int nitems, void* dest, int32_t destsize) {
+  blosc_header header;
+  int rc;
+
+  if (context->do_compress != 0) {
+    BLOSC_TRACE_ERROR("Context is not meant for decompression.  Giving up.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (context->device != BLOSC2_DEVICE_HOST) {
+    BLOSC_TRACE_ERROR("Decompressing ranges is only supported for host memory.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  rc = read_chunk_header((uint8_t *) src, srcsize, true, &header);
+  if (rc < 0) {
+    return rc;
+  }
+  int64_t begin = (int64_t)start * header.typesize;
+  int64_t end = ((int64_t)start + nitems) * header.typesize;
+  if (start < 0 || nitems < 0 || end > header.nbytes) {
+    BLOSC_TRACE_ERROR("The range of items is out of the chunk.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (end - begin > destsize) {
+    BLOSC_TRACE_ERROR("The range of items does not fit in dest.");
+    return BLOSC2_ERROR_WRITE_BUFFER;
+  }
+
+  int32_t blocksize = header.blocksize;
+  int32_t nblocks = header.nbytes / blocksize + (header.nbytes % blocksize > 0);
+  int32_t first;
+  int32_t last;
+  if (!threaded_range(&header, begin, end, &first, &last)) {
+    return blosc2_getitem_ctx(context, src, srcsize, start, nitems, dest, destsize);
+  }
+  int64_t first_byte = (int64_t)first * blocksize;
+  int64_t last_byte = last == nblocks ? header.nbytes : (int64_t)last * blocksize;
+
+  // The items before and after the whole blocks
+  uint8_t* _dest = dest;
+  if (begin < first_byte) {
+    rc = blosc2_getitem_ctx(context, src, srcsize, start, (int)((first_byte - begin) / header.typesize),
+                            _dest, destsize);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  if (last_byte < end) {
+    rc = blosc2_getitem_ctx(context, src, srcsize, (int)(last_byte / header.typesize),
+                            (int)((end - last_byte) / header.typesize), _dest + (last_byte - begin),
+                            (int32_t)(end - last_byte));
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  // The whole blocks go through the regular machinery, with the rest of the blocks masked out and
+  // dest shifted to the start of the range.  A maskout of the user is kept for later.
+  bool* user_maskout = context->block_maskout;
+  int user_maskout_nitems = context->block_maskout_nitems;
+  bool* maskout = ctx_malloc(context, nblocks * sizeof(bool));
+  BLOSC_ERROR_NULL(maskout, BLOSC2_ERROR_MEMORY_ALLOC);
+  for (int32_t i = 0; i < nblocks; i++) {
+    maskout[i] = i < first || i >= last;
+  }
+  context->block_maskout = NULL;
+  context->block_maskout_nitems = 0;
+
+  // The chunk decompresses as a whole, as far as the checks go
+  rc = initialize_context_decompression(context, &header, src, srcsize, dest, header.nbytes);
+  uint8_t* dref_block = NULL;
+  if (rc >= 0) {
+    context->dest_shift = (int32_t)begin;
+    // The blocks are delta coded wrt the first one as decoded, which is not in dest
+    int memcpyed = context->header_flags & (uint8_t)BLOSC_MEMCPYED;
+    if (first > 0 && context->dref == NULL && !memcpyed && uses_decoded_dref(context)) {
+      if (context->serial_context == NULL) {
+        context->serial_context = create_thread_context(context, 0);
+      }
+      struct thread_context* scontext = context->serial_context;
+      dref_block = ctx_malloc(context, blocksize);
+      if (scontext == NULL || dref_block == NULL) {
+        BLOSC_TRACE_ERROR("Cannot decode the reference block.");
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      }
+      else if (blocksize > scontext->tmp_blocksize) {
+        rc = set_thread_tmp(scontext, blocksize, blocksize + context->typesize * (signed)sizeof(int32_t));
+      }
+      if (rc >= 0) {
+        scontext->cell_nitems = 0;
+        context->dref_not_init = 1;
+        rc = blosc_d(scontext, blocksize, false, memcpyed, src, srcsize, sw32_(context->bstarts), 0,
+                     dref_block, 0, scontext->tmp, scontext->tmp3);
+        merge_stats(&context->stats, &scontext->stats);
+        context->dref = dref_block;
+      }
+    }
+  }
+  if (rc >= 0) {
+    context->block_maskout = maskout;
+    context->block_maskout_nitems = nblocks;
+    rc = run_decompression(context, &header, src, srcsize);
+  }
+  if (rc >= 0) {
+    context->stats.ncalls++;
+    context->stats.nbytes_out += last_byte - first_byte;
+  }
+
+  context->dref = NULL;
+  context->dest_shift = 0;
+  ctx_free(context, dref_block);
+  ctx_free(context, maskout);
+  context->block_maskout = user_maskout;
+  context->block_maskout_nitems = user_maskout_nitems;
+
+  return rc < 0 ? rc : (int)(end - begin);
+}
+
 /* execute single compression/decompression job for a single thread_context */
+/* Hand the statistics of a thread over to the context, along with the time that it was busy */
+static void hand_over_stats(struct thread_context* thcontext) {
+  blosc2_context* context = thcontext->parent_context;
+  int64_t job_end = stats_clock();
+  int64_t busy_ns = job_end - context->job_start_ns;
+  BLOSC_HOOK_STAGE(BLOSC2_TRACE_JOB, context, thcontext->tid, -1, 0, context->job_start_ns, job_end);
+  pthread_mutex_lock(&context->count_mutex);
+  thcontext->stats.sched_ns += stats_clock() - job_end;
+  merge_stats(&context->stats, &thcontext->stats);
+  context->job_busy_ns += busy_ns;
+  if (busy_ns > context->job_max_busy_ns) {
+    context->job_max_busy_ns = busy_ns;
+  }
+  pthread_mutex_unlock(&context->count_mutex);
+}
+
+/* Run the filters of a block into its place in streams_src, and pick its codec (BLOSC_STREAMS_SCHED) */
+static int filter_streams_block(struct thread_context* thcontext, int32_t nblock) {
+  blosc2_context* context = thcontext->parent_context;
+  int32_t bsize = streams_block_size(context, nblock);
+  int32_t offset = nblock * context->blocksize;
+  int64_t stage_start = stats_clock();
+
+  summarize_block(context, context->src + offset, bsize, nblock);
+  if (streams_need_filters(context)) {
+    uint8_t* dest = context->streams_src + offset;
+    uint8_t* _src = pipeline_forward(thcontext, bsize, context->src, offset, dest, thcontext->tmp3, thcontext->tmp4);
+    if (_src == NULL) {
+      return BLOSC2_ERROR_FILTER_PIPELINE;
+    }
+    if (_src != dest) {
+      memcpy(dest, _src, bsize);
+    }
+    thcontext->stats.filters_ns += stage_lap(thcontext, BLOSC2_TRACE_FILTERS, nblock, bsize, &stage_start);
+  }
+  int compcode = pick_block_codec(thcontext, streams_block(context, nblock), bsize, nblock);
+  if (compcode < 0) {
+    return compcode;
+  }
+  thcontext->stats.nblocks++;
+  return 0;
+}
+
+/* Compress the stream `nstream` of a block into its slot of streams_dest, laid out as
+   blosc_c() does (the length of the stream, followed by its bytes).  Returns the bytes
+   in the slot, or a negative value on errors. */
+static int32_t compress_streams_unit(struct thread_context* thcontext, int32_t nblock, int32_t nstream) {
+  blosc2_context* context = thcontext->parent_context;
+  uint8_t* block_codecs = hybrid_block_codecs(context);
+  int compcode = block_codecs != NULL ? block_codecs[nblock] : context->compcode;
+  int32_t bsize = streams_block_size(context, nblock);
+  int32_t neblock = bsize / streams_block_nstreams(context, nblock);
+  const uint8_t* src = streams_block(context, nblock) + nstream * neblock;
+  uint8_t* dest = streams_slot(context, nblock, nstream);
+  int64_t stage_start = stats_clock();
+
+  if (context->header_overhead == BLOSC_EXTENDED_HEADER_LENGTH && get_run(src, neblock, 1)) {
+    thcontext->stats.nruns++;
+    // A run, with the repeated byte in the length of the stream (and a token if it is not 0)
+    _sw32(dest, -(int32_t)src[0]);
+    if (src[0] > 0) {
+      dest[sizeof(int32_t)] = 0x1;
+      return (int32_t)sizeof(int32_t) + 1;
+    }
+    return (int32_t)sizeof(int32_t);
+  }
+
+  int32_t cbytes = compress_stream(thcontext, compcode, src, neblock, dest + sizeof(int32_t), neblock,
+                                   get_accel(context, compcode));
+  if (cbytes < 0) {
+    return cbytes;
+  }
+  if (cbytes == 0 || cbytes == neblock) {
+    /* The codec has been unable to compress the stream at all */
+    memcpy(dest + sizeof(int32_t), src, neblock);
+    cbytes = neblock;
+  }
+  _sw32(dest, cbytes);
+  thcontext->stats.codec_ns += stage_lap(thcontext, BLOSC2_TRACE_CODEC, nblock, neblock, &stage_start);
+  return (int32_t)sizeof(int32_t) + cbytes;
+}
+
+/* Take the next block (or unit) from the counter that the threads share */
+static int32_t next_shared_block(struct thread_context* thcontext) {
+  int64_t start = stats_clock();
+  int32_t nblock = blosc_atomic_add32(&thcontext->parent_context->thread_nblock, 1) + 1;
+  thcontext->stats.sched_ns += stats_clock() - start;
+  return nblock;
+}
+
+/* Do the work of a thread for a phase of BLOSC_STREAMS_SCHED, taking the next block
+   (or stream of a block) from a shared counter */
+static void t_blosc_do_streams_job(struct thread_context* thcontext) {
+  blosc2_context* context = thcontext->parent_context;
+  bool filters = context->streams_phase == STREAMS_PHASE_FILTERS;
+  int32_t typesize = context->typesize;
+  int32_t nunits = filters ? context->nblocks : context->nblocks * typesize;
+
+  int32_t unit = next_shared_block(thcontext);
+  while (unit < nunits && context->thread_giveup_code > 0) {
+    int32_t rc = 0;
+    if (filters) {
+      rc = filter_streams_block(thcontext, unit);
+    }
+    else if (unit % typesize < streams_block_nstreams(context, unit / typesize)) {
+      rc = compress_streams_unit(thcontext, unit / typesize, unit % typesize);
+      context->streams_csizes[unit] = rc;
+    }
+    if (rc < 0) {
+      pthread_mutex_lock(&context->count_mutex);
+      context->thread_giveup_code = rc;
+      pthread_mutex_unlock(&context->count_mutex);
+      break;
+    }
+    unit = next_shared_block(thcontext);
+  }
+}
+
 static void t_blosc_do_job(void *ctxt)
 {
   struct thread_context* thcontext = (struct thread_context*)ctxt;
@@ -3244,6 +6614,12 @@ static void t_blosc_do_job(void *ctxt)
   uint8_t* tmp2;
   uint8_t* tmp3;
 
+  /* The threads of the context that are not engaged in this job have nothing to do */
+  if (thcontext->tid >= context->active_nthreads) {
+    return;
+  }
+  thcontext->stats.wakeup_ns += stats_clock() - context->job_start_ns;
+
   /* Get parameters for this thread before entering the main loop */
   blocksize = context->blocksize;
   ebsize = blocksize + context->typesize * (int32_t)sizeof(int32_t);
@@ -3257,13 +6633,18 @@ static void t_blosc_do_job(void *ctxt)
 
   /* Resize the temporaries if needed */
   if (blocksize > thcontext->tmp_blocksize) {
-    my_free(thcontext->tmp);
-    thcontext->tmp_nbytes = (size_t) 4 * ebsize;
-    thcontext->tmp = my_malloc(thcontext->tmp_nbytes);
-    thcontext->tmp2 = thcontext->tmp + ebsize;
-    thcontext->tmp3 = thcontext->tmp2 + ebsize;
-    thcontext->tmp4 = thcontext->tmp3 + ebsize;
-    thcontext->tmp_blocksize = blocksize;
+    if (set_thread_tmp(thcontext, blocksize, ebsize) < 0) {
+      pthread_mutex_lock(&context->count_mutex);
+      context->thread_giveup_code = BLOSC2_ERROR_MEMORY_ALLOC;
+      pthread_mutex_unlock(&context->count_mutex);
+      return;
+    }
+  }
+
+  if (context->streams_phase != STREAMS_PHASE_NONE) {
+    t_blosc_do_streams_job(thcontext);
+    hand_over_stats(thcontext);
+    return;
   }
 
   tmp = thcontext->tmp;
@@ -3277,11 +6658,18 @@ static void t_blosc_do_job(void *ctxt)
     memcpyed = true;
   }
 
-  bool static_schedule = (!compress || memcpyed) && context->block_maskout == NULL;
-  if (static_schedule) {
+  bool work_stealing = context->scheduler == BLOSC_WORKSTEALING_SCHED;
+  bool static_schedule = (!compress || memcpyed) && context->block_maskout == NULL &&
+                         context->scheduler == BLOSC_DEFAULT_SCHED;
+  if (work_stealing) {
+    nblock_ = next_stolen_block(thcontext);
+    /* A negative block means that there is nothing left to do */
+    tblock = nblock_ < 0 ? -1 : nblocks;
+  }
+  else if (static_schedule) {
       /* Blocks per thread */
-      tblocks = nblocks / context->nthreads;
-      leftover2 = nblocks % context->nthreads;
+      tblocks = nblocks / context->active_nthreads;
+      leftover2 = nblocks % context->active_nthreads;
       tblocks = (leftover2 > 0) ? tblocks + 1 : tblocks;
       nblock_ = thcontext->tid * tblocks;
       tblock = nblock_ + tblocks;
@@ -3290,18 +6678,15 @@ static void t_blosc_do_job(void *ctxt)
       }
   }
   else {
-    // Use dynamic schedule via a queue.  Get the next block.
-    pthread_mutex_lock(&context->count_mutex);
-    context->thread_nblock++;
-    nblock_ = context->thread_nblock;
-    pthread_mutex_unlock(&context->count_mutex);
+    // Use dynamic schedule via a queue.  Get the next block.
+    nblock_ = next_shared_block(thcontext);
     tblock = nblocks;
   }
 
   /* Loop over blocks */
-  leftoverblock = 0;
   while ((nblock_ < tblock) && (context->thread_giveup_code > 0)) {
     bsize = blocksize;
+    leftoverblock = 0;
     if (nblock_ == (nblocks - 1) && (leftover > 0)) {
       bsize = leftover;
       leftoverblock = 1;
@@ -3310,8 +6695,8 @@ static void t_blosc_do_job(void *ctxt)
       if (memcpyed) {
         if (!context->prefilter) {
           /* We want to memcpy only */
-          memcpy(dest + context->header_overhead + nblock_ * blocksize,
-                 src + nblock_ * blocksize, (unsigned int) bsize);
+          copy_raw_block(thcontext, dest + context->header_overhead + nblock_ * blocksize,
+                         src + nblock_ * blocksize, nblock_, bsize);
           cbytes = (int32_t) bsize;
         }
         else {
@@ -3323,6 +6708,9 @@ static void t_blosc_do_job(void *ctxt)
                            dest + context->header_overhead + nblock_ * blocksize,
                            tmp, tmp3);
         }
+        if (cbytes > 0) {
+          seal_block(thcontext, dest + context->header_overhead + nblock_ * blocksize, cbytes, nblock_);
+        }
       }
       else {
         /* Regular compression */
@@ -3341,9 +6729,13 @@ static void t_blosc_do_job(void *ctxt)
         // If memcpyed we don't have a bstarts section (because it is not needed)
         int32_t src_offset = memcpyed ?
             context->header_overhead + nblock_ * blocksize : sw32_(bstarts + nblock_);
+        if (static_schedule || work_stealing) {
+          // The next block of the thread is most likely the next one in the chunk
+          prefetch_block(context, nblock_ + 1, memcpyed);
+        }
         cbytes = blosc_d(thcontext, bsize, leftoverblock, memcpyed,
                           src, srcsize, src_offset, nblock_,
-                          dest, nblock_ * blocksize, tmp, tmp2);
+                          dest, nblock_ * blocksize - context->dest_shift, tmp, tmp2);
       }
     }
 
@@ -3362,9 +6754,12 @@ static void t_blosc_do_job(void *ctxt)
     }
 
     if (compress && !memcpyed) {
-      /* Start critical section */
-      pthread_mutex_lock(&context->count_mutex);
-      ntdest = context->output_bytes;
+      if (cbytes == 0) {
+        context->thread_giveup_code = 0;  /* incompressible buf */
+        break;
+      }
+      /* Reserve room for the compressed block in destination */
+      ntdest = blosc_atomic_add32(&context->output_bytes, cbytes);
       // Note: do not use a typical local dict_training variable here
       // because it is probably cached from previous calls if the number of
       // threads does not change (the usual thing).
@@ -3372,29 +6767,30 @@ static void t_blosc_do_job(void *ctxt)
         _sw32(bstarts + nblock_, (int32_t) ntdest);
       }
 
-      if ((cbytes == 0) || (ntdest + cbytes > maxbytes)) {
+      if (ntdest + cbytes > maxbytes) {
         context->thread_giveup_code = 0;  /* incompressible buf */
-        pthread_mutex_unlock(&context->count_mutex);
         break;
       }
-      context->thread_nblock++;
-      nblock_ = context->thread_nblock;
-      context->output_bytes += cbytes;
-      pthread_mutex_unlock(&context->count_mutex);
-      /* End of critical section */
 
-      /* Copy the compressed buffer to destination */
+      /* Copy the compressed buffer (once encrypted, if it has to) to destination */
+      seal_block(thcontext, tmp2, cbytes, nblock_);
       memcpy(dest + ntdest, tmp2, (unsigned int) cbytes);
     }
+    else if (!static_schedule) {
+      blosc_atomic_add32(&context->output_bytes, cbytes);
+    }
+
+    if (work_stealing) {
+      nblock_ = next_stolen_block(thcontext);
+      if (nblock_ < 0) {
+        break;
+      }
+    }
     else if (static_schedule) {
       nblock_++;
     }
     else {
-      pthread_mutex_lock(&context->count_mutex);
-      context->thread_nblock++;
-      nblock_ = context->thread_nblock;
-      context->output_bytes += cbytes;
-      pthread_mutex_unlock(&context->count_mutex);
+      nblock_ = next_shared_block(thcontext);
     }
 
   } /* closes while (nblock_) */
@@ -3408,19 +6804,30 @@ static void t_blosc_do_job(void *ctxt)
     pthread_mutex_unlock(&context->count_mutex);
   }
 
+  hand_over_stats(thcontext);
 }
 
 /* Decompress & unshuffle several blocks in a single thread */
 static void* t_blosc(void* ctxt) {
   struct thread_context* thcontext = (struct thread_context*)ctxt;
   blosc2_context* context = thcontext->parent_context;
-#ifdef BLOSC_POSIX_BARRIERS
-  int rc;
-#endif
+
+  if (context->numa_nodes > 1) {
+    /* Consecutive threads go to the same node, so that the block ranges of the
+     * static schedule (and hence the pages they first touch) are grouped by node */
+    int node = thcontext->tid * context->numa_nodes / context->nthreads;
+    if (blosc_numa_bind_self(node) == 0) {
+      /* Get temporaries that are first touched here, and hence local to the node */
+      int32_t ebsize = (int32_t)(thcontext->tmp_nbytes / 4);
+      if (set_thread_tmp(thcontext, thcontext->tmp_blocksize, ebsize) == 0) {
+        memset(thcontext->tmp, 0, thcontext->tmp_nbytes);
+      }
+    }
+  }
 
   while (1) {
     /* Synchronization point for all threads (wait for initialization) */
-    WAIT_INIT(NULL, context);
+    blosc_barrier_wait(&context->barr_init);
 
     if (context->end_threads) {
       break;
@@ -3429,7 +6836,7 @@ static void* t_blosc(void* ctxt) {
     t_blosc_do_job(ctxt);
 
     /* Meeting point for all threads (wait for finalization) */
-    WAIT_FINISH(NULL, context);
+    blosc_barrier_wait(&context->barr_finish);
   }
 
   /* Cleanup our working space and context */
@@ -3453,19 +6860,19 @@ int init_threadpool(blosc2_context *context) {
   context->thread_giveup_code = 1;
   context->thread_nblock = -1;
 
+  /* Per-thread block ranges for the work-stealing scheduler */
+  context->block_ranges = (struct blosc_block_range*)ctx_malloc(context,
+          context->nthreads * sizeof(struct blosc_block_range));
+  BLOSC_ERROR_NULL(context->block_ranges, BLOSC2_ERROR_MEMORY_ALLOC);
+  memset(context->block_ranges, 0, context->nthreads * sizeof(struct blosc_block_range));
+
   /* Barrier initialization */
-#ifdef BLOSC_POSIX_BARRIERS
-  pthread_barrier_init(&context->barr_init, NULL, context->nthreads + 1);
-  pthread_barrier_init(&context->barr_finish, NULL, context->nthreads + 1);
-#else
-  pthread_mutex_init(&context->count_threads_mutex, NULL);
-  pthread_cond_init(&context->count_threads_cv, NULL);
-  context->count_threads = 0;      /* Reset threads counter */
-#endif
+  blosc_barrier_init(&context->barr_init, context->nthreads + 1);
+  blosc_barrier_init(&context->barr_finish, context->nthreads + 1);
 
-  if (threads_callback) {
-      /* Create thread contexts to store data for callback threads */
-    context->thread_contexts = (struct thread_context *)my_malloc(
+  if (use_thread_contexts(context)) {
+      /* Create thread contexts to store data for callback (or shared pool or scheduler) threads */
+    context->thread_contexts = (struct thread_context *)ctx_malloc(context,
             context->nthreads * sizeof(struct thread_context));
     BLOSC_ERROR_NULL(context->thread_contexts, BLOSC2_ERROR_MEMORY_ALLOC);
     for (tid = 0; tid < context->nthreads; tid++)
@@ -3479,14 +6886,20 @@ int init_threadpool(blosc2_context *context) {
     #endif
 
     /* Make space for thread handlers */
-    context->threads = (pthread_t*)my_malloc(
+    context->threads = (pthread_t*)ctx_malloc(context,
             context->nthreads * sizeof(pthread_t));
     BLOSC_ERROR_NULL(context->threads, BLOSC2_ERROR_MEMORY_ALLOC);
+    /* The thread contexts are kept at hand too, for reporting their memory */
+    context->own_thread_contexts = (struct thread_context**)ctx_malloc(context,
+            context->nthreads * sizeof(struct thread_context*));
+    BLOSC_ERROR_NULL(context->own_thread_contexts, BLOSC2_ERROR_MEMORY_ALLOC);
+    memset(context->own_thread_contexts, 0, context->nthreads * sizeof(struct thread_context*));
     /* Finally, create the threads */
     for (tid = 0; tid < context->nthreads; tid++) {
       /* Create a thread context (will destroy when finished) */
       struct thread_context *thread_context = create_thread_context(context, tid);
       BLOSC_ERROR_NULL(thread_context, BLOSC2_ERROR_THREAD_CREATE);
+      context->own_thread_contexts[tid] = thread_context;
       #if !defined(_WIN32)
         rc2 = pthread_create(&context->threads[tid], &context->ct_attr, t_blosc,
                             (void*)thread_context);
@@ -3520,11 +6933,8 @@ int16_t blosc2_set_nthreads(int16_t nthreads) {
   /* Check whether the library should be initialized */
   if (!g_initlib) blosc2_init();
 
- if (nthreads != ret) {
-   g_nthreads = nthreads;
-   g_global_context->new_nthreads = nthreads;
-   check_nthreads(g_global_context);
- }
+ // The implicit contexts take the new number of threads in their next use
+ g_nthreads = nthreads;
 
   return ret;
 }
@@ -3664,6 +7074,43 @@ int blosc2_cbuffer_sizes(const void* cbuffer, int32_t* nbytes, int32_t* cbytes,
   return rc;
 }
 
+int blosc2_cbuffer_info(const void* cbuffer, int32_t cbytes, blosc2_chunk_info* info) {
+  blosc_header header;
+  int rc = read_chunk_header((uint8_t *) cbuffer, cbytes, true, &header);
+  if (rc < 0) {
+    return rc;
+  }
+
+  info->nbytes = header.nbytes;
+  info->cbytes = header.cbytes;
+  info->blocksize = header.blocksize;
+  info->typesize = header.typesize;
+  switch (header.flags >> 5) {
+    case BLOSC_BLOSCLZ_FORMAT:
+      info->compcode = BLOSC_BLOSCLZ;
+      break;
+    case BLOSC_LZ4_FORMAT:
+      info->compcode = BLOSC_LZ4;
+      break;
+    case BLOSC_ZLIB_FORMAT:
+      info->compcode = BLOSC_ZLIB;
+      break;
+    case BLOSC_ZSTD_FORMAT:
+      info->compcode = BLOSC_ZSTD;
+      break;
+    default:
+      info->compcode = header.udcompcode;
+  }
+  info->compcode_meta = header.compcode_meta;
+  memcpy(info->filters, header.filter_codes, BLOSC2_MAX_FILTERS);
+  memcpy(info->filters_meta, header.filter_meta, BLOSC2_MAX_FILTERS);
+  info->split = !(header.flags & 0x10);
+  info->memcpyed = header.flags & (uint8_t)BLOSC_MEMCPYED;
+  info->use_dict = header.blosc2_flags & BLOSC2_USEDICT;
+  info->special = (header.blosc2_flags >> 4) & BLOSC2_SPECIAL_MASK;
+  return 0;
+}
+
 int blosc1_cbuffer_validate(const void* cbuffer, size_t cbytes, size_t* nbytes) {
   int32_t header_cbytes;
   int32_t header_nbytes;
@@ -3764,16 +7211,26 @@ void blosc1_set_splitmode(int mode)
    reachable (the default). */
 void blosc_set_schunk(blosc2_schunk* schunk) {
   g_schunk = schunk;
-  g_global_context->schunk = schunk;
 }
 
 blosc2_io *blosc2_io_global = NULL;
 blosc2_io_cb BLOSC2_IO_CB_DEFAULTS;
+blosc2_io_cb BLOSC2_IO_CB_MMAP;
+blosc2_io_cb BLOSC2_IO_CB_URING;
+blosc2_io_cb BLOSC2_IO_CB_DIRECT;
+blosc2_io_cb BLOSC2_IO_CB_OBJSTORE;
+static blosc2_io_cb_ext BLOSC2_IO_CB_EXT_DEFAULTS;
+static blosc2_io_cb_ext BLOSC2_IO_CB_EXT_MMAP;
+static blosc2_io_cb_ext BLOSC2_IO_CB_EXT_URING;
+static blosc2_io_cb_ext BLOSC2_IO_CB_EXT_DIRECT;
+static blosc2_io_cb_ext BLOSC2_IO_CB_EXT_OBJSTORE;
 
 void blosc2_init(void) {
   /* Return if Blosc is already initialized */
   if (g_initlib) return;
 
+  blosc_stune_detect_cpu();
+
   BLOSC2_IO_CB_DEFAULTS.id = BLOSC2_IO_FILESYSTEM;
   BLOSC2_IO_CB_DEFAULTS.name = "filesystem";
   BLOSC2_IO_CB_DEFAULTS.open = (blosc2_open_cb) blosc2_stdio_open;
@@ -3783,7 +7240,65 @@ void blosc2_init(void) {
   BLOSC2_IO_CB_DEFAULTS.write = (blosc2_write_cb) blosc2_stdio_write;
   BLOSC2_IO_CB_DEFAULTS.read = (blosc2_read_cb) blosc2_stdio_read;
   BLOSC2_IO_CB_DEFAULTS.truncate = (blosc2_truncate_cb) blosc2_stdio_truncate;
+  BLOSC2_IO_CB_EXT_DEFAULTS.sync = (blosc2_sync_cb) blosc2_stdio_sync;
+#if !defined(_WIN32)
+  BLOSC2_IO_CB_EXT_DEFAULTS.pread = (blosc2_pread_cb) blosc2_stdio_pread;
+  BLOSC2_IO_CB_EXT_DEFAULTS.pwrite = (blosc2_pwrite_cb) blosc2_stdio_pwrite;
+  BLOSC2_IO_CB_EXT_DEFAULTS.preadv = (blosc2_preadv_cb) blosc2_stdio_preadv;
+#endif
 
+  BLOSC2_IO_CB_MMAP.id = BLOSC2_IO_FILESYSTEM_MMAP;
+  BLOSC2_IO_CB_MMAP.name = "filesystem_mmap";
+  BLOSC2_IO_CB_MMAP.open = (blosc2_open_cb) blosc2_stdio_mmap_open;
+  BLOSC2_IO_CB_MMAP.close = (blosc2_close_cb) blosc2_stdio_mmap_close;
+  BLOSC2_IO_CB_MMAP.tell = (blosc2_tell_cb) blosc2_stdio_mmap_tell;
+  BLOSC2_IO_CB_MMAP.seek = (blosc2_seek_cb) blosc2_stdio_mmap_seek;
+  BLOSC2_IO_CB_MMAP.write = (blosc2_write_cb) blosc2_stdio_mmap_write;
+  BLOSC2_IO_CB_MMAP.read = (blosc2_read_cb) blosc2_stdio_mmap_read;
+  BLOSC2_IO_CB_MMAP.truncate = (blosc2_truncate_cb) blosc2_stdio_mmap_truncate;
+  BLOSC2_IO_CB_EXT_MMAP.pread = (blosc2_pread_cb) blosc2_stdio_mmap_pread;
+  BLOSC2_IO_CB_EXT_MMAP.pwrite = (blosc2_pwrite_cb) blosc2_stdio_mmap_pwrite;
+
+  BLOSC2_IO_CB_URING.id = BLOSC2_IO_FILESYSTEM_URING;
+  BLOSC2_IO_CB_URING.name = "filesystem_uring";
+  BLOSC2_IO_CB_URING.open = (blosc2_open_cb) blosc2_stdio_uring_open;
+  BLOSC2_IO_CB_URING.close = (blosc2_close_cb) blosc2_stdio_uring_close;
+  BLOSC2_IO_CB_URING.tell = (blosc2_tell_cb) blosc2_stdio_uring_tell;
+  BLOSC2_IO_CB_URING.seek = (blosc2_seek_cb) blosc2_stdio_uring_seek;
+  BLOSC2_IO_CB_URING.write = (blosc2_write_cb) blosc2_stdio_uring_write;
+  BLOSC2_IO_CB_URING.read = (blosc2_read_cb) blosc2_stdio_uring_read;
+  BLOSC2_IO_CB_URING.truncate = (blosc2_truncate_cb) blosc2_stdio_uring_truncate;
+  BLOSC2_IO_CB_EXT_URING.pread = (blosc2_pread_cb) blosc2_stdio_uring_pread;
+  BLOSC2_IO_CB_EXT_URING.pwrite = (blosc2_pwrite_cb) blosc2_stdio_uring_pwrite;
+  BLOSC2_IO_CB_EXT_URING.pread_batch = (blosc2_pread_batch_cb) blosc2_stdio_uring_pread_batch;
+
+  BLOSC2_IO_CB_DIRECT.id = BLOSC2_IO_FILESYSTEM_DIRECT;
+  BLOSC2_IO_CB_DIRECT.name = "filesystem_direct";
+  BLOSC2_IO_CB_DIRECT.open = (blosc2_open_cb) blosc2_stdio_direct_open;
+  BLOSC2_IO_CB_DIRECT.close = (blosc2_close_cb) blosc2_stdio_direct_close;
+  BLOSC2_IO_CB_DIRECT.tell = (blosc2_tell_cb) blosc2_stdio_direct_tell;
+  BLOSC2_IO_CB_DIRECT.seek = (blosc2_seek_cb) blosc2_stdio_direct_seek;
+  BLOSC2_IO_CB_DIRECT.write = (blosc2_write_cb) blosc2_stdio_direct_write;
+  BLOSC2_IO_CB_DIRECT.read = (blosc2_read_cb) blosc2_stdio_direct_read;
+  BLOSC2_IO_CB_DIRECT.truncate = (blosc2_truncate_cb) blosc2_stdio_direct_truncate;
+  BLOSC2_IO_CB_EXT_DIRECT.pread = (blosc2_pread_cb) blosc2_stdio_direct_pread;
+  BLOSC2_IO_CB_EXT_DIRECT.pwrite = (blosc2_pwrite_cb) blosc2_stdio_direct_pwrite;
+
+  BLOSC2_IO_CB_OBJSTORE.id = BLOSC2_IO_OBJECT_STORE;
+  BLOSC2_IO_CB_OBJSTORE.name = "object_store";
+  BLOSC2_IO_CB_OBJSTORE.open = (blosc2_open_cb) blosc2_stdio_objstore_open;
+  BLOSC2_IO_CB_OBJSTORE.close = (blosc2_close_cb) blosc2_stdio_objstore_close;
+  BLOSC2_IO_CB_OBJSTORE.tell = (blosc2_tell_cb) blosc2_stdio_objstore_tell;
+  BLOSC2_IO_CB_OBJSTORE.seek = (blosc2_seek_cb) blosc2_stdio_objstore_seek;
+  BLOSC2_IO_CB_OBJSTORE.write = (blosc2_write_cb) blosc2_stdio_objstore_write;
+  BLOSC2_IO_CB_OBJSTORE.read = (blosc2_read_cb) blosc2_stdio_objstore_read;
+  BLOSC2_IO_CB_OBJSTORE.truncate = (blosc2_truncate_cb) blosc2_stdio_objstore_truncate;
+  BLOSC2_IO_CB_EXT_OBJSTORE.pread = (blosc2_pread_cb) blosc2_stdio_objstore_pread;
+  BLOSC2_IO_CB_EXT_OBJSTORE.pwrite = (blosc2_pwrite_cb) blosc2_stdio_objstore_pwrite;
+  BLOSC2_IO_CB_EXT_OBJSTORE.pread_batch = (blosc2_pread_batch_cb) blosc2_stdio_objstore_pread_batch;
+  BLOSC2_IO_CB_EXT_OBJSTORE.preadv = (blosc2_preadv_cb) blosc2_stdio_objstore_preadv;
+
+  blosc2_reload_env();
   g_ncodecs = 0;
   g_nfilters = 0;
   g_ntuners = 0;
@@ -3795,12 +7310,14 @@ void blosc2_init(void) {
   register_filters();
   register_tuners();
 #endif
-  pthread_mutex_init(&global_comp_mutex, NULL);
-  /* Create a global context */
-  g_global_context = (blosc2_context*)my_malloc(sizeof(blosc2_context));
-  memset(g_global_context, 0, sizeof(blosc2_context));
-  g_global_context->nthreads = g_nthreads;
-  g_global_context->new_nthreads = g_nthreads;
+  pthread_mutex_init(&g_implicit_pool_mutex, NULL);
+  pthread_mutex_init(&g_plugins_mutex, NULL);
+  if (!g_implicit_context_key_created) {
+    g_implicit_context_key_created = pthread_key_create(&g_implicit_context_key, free_implicit_context) == 0;
+  }
+  stdio_cache_init();
+  hugepages_init();
+  scratch_pool_init();
   g_initlib = 1;
 }
 
@@ -3809,7 +7326,12 @@ int blosc2_free_resources(void) {
   /* Return if Blosc is not initialized */
   if (!g_initlib) return BLOSC2_ERROR_FAILURE;
 
-  return release_threadpool(g_global_context);
+  pthread_mutex_lock(&g_scratch_mutex);
+  scratch_pool_clear();
+  pthread_mutex_unlock(&g_scratch_mutex);
+  // Only the context of the calling thread, as the ones of other threads may be in use
+  blosc2_context *context = (blosc2_context *)pthread_getspecific(g_implicit_context_key);
+  return context != NULL ? release_threadpool(context) : 0;
 }
 
 
@@ -3819,9 +7341,21 @@ void blosc2_destroy(void) {
 
   blosc2_free_resources();
   g_initlib = 0;
-  blosc2_free_ctx(g_global_context);
-
-  pthread_mutex_destroy(&global_comp_mutex);
+  // The contexts of other threads are released when they exit
+  blosc2_context *context = (blosc2_context *)pthread_getspecific(g_implicit_context_key);
+  if (context != NULL) {
+    pthread_setspecific(g_implicit_context_key, NULL);
+    free_implicit_context(context);
+  }
+  blosc_pool_free(g_implicit_pool);
+  g_implicit_pool = NULL;
+  blosc_pool_destroy();
+  stdio_cache_destroy();
+  scratch_pool_destroy();
+
+  pthread_mutex_destroy(&g_implicit_pool_mutex);
+  pthread_mutex_destroy(&g_plugins_mutex);
+  free_env();
 
 }
 
@@ -3832,16 +7366,17 @@ int release_threadpool(blosc2_context *context) {
   int rc;
 
   if (context->threads_started > 0) {
-    if (threads_callback) {
-      /* free context data for user-managed threads */
+    if (context->thread_contexts != NULL) {
+      /* free context data for user-managed (or shared pool) threads */
       for (t=0; t<context->threads_started; t++)
         destroy_thread_context(context->thread_contexts + t);
-      my_free(context->thread_contexts);
+      ctx_free(context, context->thread_contexts);
+      context->thread_contexts = NULL;
     }
     else {
       /* Tell all existing threads to finish */
       context->end_threads = 1;
-      WAIT_INIT(-1, context);
+      blosc_barrier_wait(&context->barr_init);
 
       /* Join exiting threads */
       for (t = 0; t < context->threads_started; t++) {
@@ -3858,7 +7393,10 @@ int release_threadpool(blosc2_context *context) {
       #endif
 
       /* Release thread handlers */
-      my_free(context->threads);
+      ctx_free(context, context->threads);
+      context->threads = NULL;
+      ctx_free(context, context->own_thread_contexts);
+      context->own_thread_contexts = NULL;
     }
 
     /* Release mutex and condition variable objects */
@@ -3867,15 +7405,12 @@ int release_threadpool(blosc2_context *context) {
     pthread_mutex_destroy(&context->nchunk_mutex);
     pthread_cond_destroy(&context->delta_cv);
 
+    ctx_free(context, context->block_ranges);
+    context->block_ranges = NULL;
+
     /* Barriers */
-  #ifdef BLOSC_POSIX_BARRIERS
-    pthread_barrier_destroy(&context->barr_init);
-    pthread_barrier_destroy(&context->barr_finish);
-  #else
-    pthread_mutex_destroy(&context->count_threads_mutex);
-    pthread_cond_destroy(&context->count_threads_cv);
-    context->count_threads = 0;      /* Reset threads counter */
-  #endif
+    blosc_barrier_destroy(&context->barr_init);
+    blosc_barrier_destroy(&context->barr_finish);
 
     /* Reset flags and counters */
     context->end_threads = 0;
@@ -3890,51 +7425,55 @@ int release_threadpool(blosc2_context *context) {
 /* Contexts */
 
 /* Create a context for compression */
-blosc2_context* blosc2_create_cctx(blosc2_cparams cparams) {
-  blosc2_context* context = (blosc2_context*)my_malloc(sizeof(blosc2_context));
-  BLOSC_ERROR_NULL(context, NULL);
-
-  /* Populate the context, using zeros as default values */
-  memset(context, 0, sizeof(blosc2_context));
-  context->do_compress = 1;   /* meant for compression */
-  context->use_dict = cparams.use_dict;
-  if (cparams.instr_codec) {
-    context->blosc2_flags = BLOSC2_INSTR_CODEC;
+/* The number of NUMA nodes to spread the threads of a context over, as set by the
+ * BLOSC_NTHREADS_AFFINITY environment variable (0 means that threads are not pinned) */
+static int get_affinity_nodes(void) {
+  const char* envvar = blosc_getenv(BLOSC_ENV_NTHREADS_AFFINITY);
+  if (envvar == NULL || strcmp(envvar, "NONE") == 0 || strcmp(envvar, "none") == 0) {
+    return 0;
+  }
+  if (strcmp(envvar, "NUMA") != 0 && strcmp(envvar, "numa") != 0) {
+    BLOSC_TRACE_WARNING("BLOSC_NTHREADS_AFFINITY environment variable '%s' not recognized\n", envvar);
+    return 0;
   }
+  int nnodes = blosc_numa_nnodes();
+  return nnodes > 1 ? nnodes : 0;
+}
+
 
+/* Validate the compression parameters (as overridden by the environment variables)
+ * and set them in context, which is left untouched if they are not valid.  The
+ * allocator and the tuner are left to the callers. */
+static int set_cparams(blosc2_context* context, const blosc2_cparams* cparams) {
+  uint8_t filters[BLOSC2_MAX_FILTERS];
+  uint8_t filters_meta[BLOSC2_MAX_FILTERS];
   for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
-    context->filters[i] = cparams.filters[i];
-    context->filters_meta[i] = cparams.filters_meta[i];
+    filters[i] = cparams->filters[i];
+    filters_meta[i] = cparams->filters_meta[i];
 
-    if (context->filters[i] >= BLOSC_LAST_FILTER && context->filters[i] <= BLOSC2_DEFINED_FILTERS_STOP) {
-      BLOSC_TRACE_ERROR("filter (%d) is not yet defined",
-                        context->filters[i]);
-      free(context);
-      return NULL;
+    if (filters[i] >= BLOSC_LAST_FILTER && filters[i] <= BLOSC2_DEFINED_FILTERS_STOP) {
+      BLOSC_TRACE_ERROR("filter (%d) is not yet defined", filters[i]);
+      return BLOSC2_ERROR_FILTER_PIPELINE;
     }
-    if (context->filters[i] > BLOSC_LAST_REGISTERED_FILTER && context->filters[i] <= BLOSC2_GLOBAL_REGISTERED_FILTERS_STOP) {
-      BLOSC_TRACE_ERROR("filter (%d) is not yet defined",
-                        context->filters[i]);
-      free(context);
-      return NULL;
+    if (filters[i] > BLOSC_LAST_REGISTERED_FILTER && filters[i] <= BLOSC2_GLOBAL_REGISTERED_FILTERS_STOP) {
+      BLOSC_TRACE_ERROR("filter (%d) is not yet defined", filters[i]);
+      return BLOSC2_ERROR_FILTER_PIPELINE;
     }
-  }
-
-#if defined(HAVE_PLUGINS)
-#include "blosc2/codecs-registry.h"
-  if ((context->compcode >= BLOSC_CODEC_ZFP_FIXED_ACCURACY) && (context->compcode <= BLOSC_CODEC_ZFP_FIXED_RATE)) {
-    for (int i = 0; i < BLOSC2_MAX_FILTERS; ++i) {
-      if ((context->filters[i] == BLOSC_SHUFFLE) || (context->filters[i] == BLOSC_BITSHUFFLE)) {
-        BLOSC_TRACE_ERROR("ZFP cannot be run in presence of SHUFFLE / BITSHUFFLE");
-        return NULL;
-      }
+    if (filters[i] == BLOSC_DELTA && filters_meta[i] > BLOSC_DELTA_DREF_STORED) {
+      BLOSC_TRACE_ERROR("mode (%d) of the delta filter is not defined", filters_meta[i]);
+      return BLOSC2_ERROR_FILTER_PIPELINE;
+    }
+    if (filters[i] == BLOSC_DELTA && filters_meta[i] == BLOSC_DELTA_DREF_STORED &&
+        (cparams->use_dict || cparams->instr_codec)) {
+      BLOSC_TRACE_ERROR("The reference block of the delta filter cannot be stored along with"
+                        " dictionaries or instrumentation");
+      return BLOSC2_ERROR_FILTER_PIPELINE;
     }
   }
-#endif /* HAVE_PLUGINS */
 
   /* Check for a BLOSC_SHUFFLE environment variable */
   int doshuffle = -1;
-  char* envvar = getenv("BLOSC_SHUFFLE");
+  const char* envvar = blosc_getenv(BLOSC_ENV_SHUFFLE);
   if (envvar != NULL) {
     if (strcmp(envvar, "NOSHUFFLE") == 0) {
       doshuffle = BLOSC_NOSHUFFLE;
@@ -3951,7 +7490,7 @@ blosc2_context* blosc2_create_cctx(blosc2_cparams cparams) {
   }
   /* Check for a BLOSC_DELTA environment variable */
   int dodelta = BLOSC_NOFILTER;
-  envvar = getenv("BLOSC_DELTA");
+  envvar = blosc_getenv(BLOSC_ENV_DELTA);
   if (envvar != NULL) {
     if (strcmp(envvar, "1") == 0) {
       dodelta = BLOSC_DELTA;
@@ -3963,80 +7502,92 @@ blosc2_context* blosc2_create_cctx(blosc2_cparams cparams) {
     }
   }
   /* Check for a BLOSC_TYPESIZE environment variable */
-  context->typesize = cparams.typesize;
-  envvar = getenv("BLOSC_TYPESIZE");
+  int32_t typesize = cparams->typesize;
+  envvar = blosc_getenv(BLOSC_ENV_TYPESIZE);
   if (envvar != NULL) {
     int32_t value;
     value = (int32_t) strtol(envvar, NULL, 10);
     if ((value != EINVAL) && (value > 0)) {
-      context->typesize = value;
+      typesize = value;
     }
     else {
       BLOSC_TRACE_WARNING("BLOSC_TYPESIZE environment variable '%s' not recognized\n", envvar);
     }
   }
-  build_filters(doshuffle, dodelta, context->typesize, context->filters);
+  build_filters(doshuffle, dodelta, typesize, filters);
 
-  context->clevel = cparams.clevel;
+  int clevel = cparams->clevel;
   /* Check for a BLOSC_CLEVEL environment variable */
-  envvar = getenv("BLOSC_CLEVEL");
+  envvar = blosc_getenv(BLOSC_ENV_CLEVEL);
   if (envvar != NULL) {
     int value;
     value = (int)strtol(envvar, NULL, 10);
     if ((value != EINVAL) && (value >= 0)) {
-      context->clevel = value;
+      clevel = value;
     }
     else {
       BLOSC_TRACE_WARNING("BLOSC_CLEVEL environment variable '%s' not recognized\n", envvar);
     }
   }
 
-  context->compcode = cparams.compcode;
+  int compcode = cparams->compcode;
   /* Check for a BLOSC_COMPRESSOR environment variable */
-  envvar = getenv("BLOSC_COMPRESSOR");
+  envvar = blosc_getenv(BLOSC_ENV_COMPRESSOR);
   if (envvar != NULL) {
     int codec = blosc2_compname_to_compcode(envvar);
     if (codec >= BLOSC_LAST_CODEC) {
       BLOSC_TRACE_ERROR("User defined codecs cannot be set here. Use Blosc2 mechanism instead.");
-      return NULL;
+      return BLOSC2_ERROR_CODEC_SUPPORT;
+    }
+    compcode = codec;
+  }
+
+#if defined(HAVE_PLUGINS)
+#include "blosc2/codecs-registry.h"
+  if ((compcode >= BLOSC_CODEC_ZFP_FIXED_ACCURACY) && (compcode <= BLOSC_CODEC_ZFP_FIXED_RATE)) {
+    for (int i = 0; i < BLOSC2_MAX_FILTERS; ++i) {
+      if ((filters[i] == BLOSC_SHUFFLE) || (filters[i] == BLOSC_BITSHUFFLE)) {
+        BLOSC_TRACE_ERROR("ZFP cannot be run in presence of SHUFFLE / BITSHUFFLE");
+        return BLOSC2_ERROR_FILTER_PIPELINE;
+      }
     }
-    context->compcode = codec;
   }
-  context->compcode_meta = cparams.compcode_meta;
+#endif /* HAVE_PLUGINS */
 
-  context->blocksize = cparams.blocksize;
+  int32_t blocksize = cparams->blocksize;
   /* Check for a BLOSC_BLOCKSIZE environment variable */
-  envvar = getenv("BLOSC_BLOCKSIZE");
+  envvar = blosc_getenv(BLOSC_ENV_BLOCKSIZE);
   if (envvar != NULL) {
-    int32_t blocksize;
-    blocksize = (int32_t) strtol(envvar, NULL, 10);
-    if ((blocksize != EINVAL) && (blocksize > 0)) {
-      context->blocksize = blocksize;
+    int32_t value;
+    value = (int32_t) strtol(envvar, NULL, 10);
+    if ((value != EINVAL) && (value > 0)) {
+      blocksize = value;
     }
     else {
       BLOSC_TRACE_WARNING("BLOSC_BLOCKSIZE environment variable '%s' not recognized\n", envvar);
     }
   }
 
-  context->nthreads = cparams.nthreads;
+  int16_t nthreads = cparams->nthreads;
   /* Check for a BLOSC_NTHREADS environment variable */
-  envvar = getenv("BLOSC_NTHREADS");
+  envvar = blosc_getenv(BLOSC_ENV_NTHREADS);
   if (envvar != NULL) {
-    int16_t nthreads = (int16_t) strtol(envvar, NULL, 10);
-    if ((nthreads != EINVAL) && (nthreads > 0)) {
-      context->nthreads = nthreads;
+    int16_t value = (int16_t) strtol(envvar, NULL, 10);
+    if (strcmp(envvar, "AUTO") == 0) {
+      nthreads = BLOSC2_NTHREADS_AUTO;
+    }
+    else if ((value != EINVAL) && (value > 0)) {
+      nthreads = value;
     }
     else {
       BLOSC_TRACE_WARNING("BLOSC_NTHREADS environment variable '%s' not recognized\n", envvar);
     }
   }
-  context->new_nthreads = context->nthreads;
 
-  context->splitmode = cparams.splitmode;
+  int32_t splitmode = cparams->splitmode;
   /* Check for a BLOSC_SPLITMODE environment variable */
-  envvar = getenv("BLOSC_SPLITMODE");
+  envvar = blosc_getenv(BLOSC_ENV_SPLITMODE);
   if (envvar != NULL) {
-    int32_t splitmode = -1;
     if (strcmp(envvar, "ALWAYS") == 0) {
       splitmode = BLOSC_ALWAYS_SPLIT;
     }
@@ -4052,139 +7603,426 @@ blosc2_context* blosc2_create_cctx(blosc2_cparams cparams) {
     else {
       BLOSC_TRACE_WARNING("BLOSC_SPLITMODE environment variable '%s' not recognized\n", envvar);
     }
-    if (splitmode >= 0) {
-      context->splitmode = splitmode;
-    }
   }
 
-  context->threads_started = 0;
-  context->schunk = cparams.schunk;
+  if (cparams->scheduler < BLOSC_DEFAULT_SCHED || cparams->scheduler > BLOSC_STREAMS_SCHED) {
+    BLOSC_TRACE_ERROR("scheduler (%d) is not supported", cparams->scheduler);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cparams->special_detection < BLOSC_SPECIAL_DETECT_RUNS ||
+      cparams->special_detection > BLOSC_SPECIAL_DETECT_NONE) {
+    BLOSC_TRACE_ERROR("special_detection (%d) is not supported", cparams->special_detection);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cparams->zonemap != BLOSC2_ZONEMAP_NONE && !zonemap_supported(cparams->zonemap, typesize)) {
+    BLOSC_TRACE_ERROR("zonemap (%d) is not supported for a typesize of %d", cparams->zonemap, typesize);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cparams->checksum < BLOSC2_CHECKSUM_NONE || cparams->checksum > BLOSC2_CHECKSUM_XXH3) {
+    BLOSC_TRACE_ERROR("checksum (%d) is not supported", cparams->checksum);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cparams->block_codec != NULL && cparams->use_dict) {
+    BLOSC_TRACE_ERROR("A block codec function does not take dicts");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cparams->zstd_window < BLOSC2_ZSTD_BLOCK_WINDOW || cparams->zstd_window > BLOSC2_ZSTD_LDM_WINDOW) {
+    BLOSC_TRACE_ERROR("zstd_window (%d) is not supported", cparams->zstd_window);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cparams->zstd_window != BLOSC2_ZSTD_BLOCK_WINDOW && (cparams->use_dict || cparams->block_codec != NULL)) {
+    BLOSC_TRACE_ERROR("A zstd prefix window does not take dicts nor block codec functions");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cparams->cipher < BLOSC2_CIPHER_NONE || cparams->cipher > BLOSC2_CIPHER_CHACHA20_POLY1305) {
+    BLOSC_TRACE_ERROR("cipher (%d) is not supported", cparams->cipher);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cparams->cipher != BLOSC2_CIPHER_NONE) {
+    if (cparams->cipher_key == NULL) {
+      BLOSC_TRACE_ERROR("A cipher needs a cipher_key");
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    /* What is kept out of the blocks would go in the clear */
+    bool dref_stored = false;
+    for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+      dref_stored |= filters[i] == BLOSC_DELTA && filters_meta[i] == BLOSC_DELTA_DREF_STORED;
+    }
+    if (cparams->checksum != BLOSC2_CHECKSUM_NONE || cparams->zonemap != BLOSC2_ZONEMAP_NONE ||
+        cparams->use_dict || cparams->instr_codec || dref_stored) {
+      BLOSC_TRACE_ERROR("A cipher does not take checksums, zone maps, dicts, instrumented codecs"
+                        " nor stored reference blocks of the delta filter");
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+  }
 
-  if (cparams.prefilter != NULL) {
-    context->prefilter = cparams.prefilter;
-    context->preparams = (blosc2_prefilter_params*)my_malloc(sizeof(blosc2_prefilter_params));
-    BLOSC_ERROR_NULL(context->preparams, NULL);
-    memcpy(context->preparams, cparams.preparams, sizeof(blosc2_prefilter_params));
+  if (cparams->prefilter != NULL) {
+    if (context->preparams == NULL) {
+      context->preparams = (blosc2_prefilter_params*)ctx_malloc(context, sizeof(blosc2_prefilter_params));
+      BLOSC_ERROR_NULL(context->preparams, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+    memcpy(context->preparams, cparams->preparams, sizeof(blosc2_prefilter_params));
   }
+  else if (context->preparams != NULL) {
+    ctx_free(context, context->preparams);
+    context->preparams = NULL;
+  }
+  context->prefilter = cparams->prefilter;
+
+  if (compcode != context->compcode || clevel != context->clevel || cparams->use_dict != context->use_dict) {
+    /* A digested dictionary is only good for the codec and level it was made for */
+    context->dict_buffer = NULL;
+    free_cdict(context);
+    context->dict_id = 0;
+  }
+  context->use_dict = cparams->use_dict;
+  context->blosc2_flags = cparams->instr_codec ? BLOSC2_INSTR_CODEC : 0;
+  memcpy(context->filters, filters, BLOSC2_MAX_FILTERS);
+  memcpy(context->filters_meta, filters_meta, BLOSC2_MAX_FILTERS);
+  context->typesize = typesize;
+  context->clevel = clevel;
+  context->compcode = compcode;
+  context->compcode_meta = cparams->compcode_meta;
+  context->blocksize = blocksize;
+  /* The threads are (re)started at the next compression, when needed */
+  context->auto_nthreads = nthreads == BLOSC2_NTHREADS_AUTO;
+  context->new_nthreads = context->auto_nthreads ? max_auto_nthreads() : nthreads;
+  context->splitmode = splitmode;
+  context->schunk = cparams->schunk;
+  context->scheduler = cparams->scheduler;
+  context->special_detection = cparams->special_detection;
+  context->record_stats = cparams->record_stats;
+  context->zonemap = cparams->zonemap;
+  context->checksum = cparams->checksum;
+  context->block_codec = cparams->block_codec;
+  context->block_codec_params = cparams->block_codec_params;
+  context->zstd_window = cparams->zstd_window;
+  context->detect_typesize = cparams->detect_typesize;
+  context->cipher = cparams->cipher;
+  context->has_cipher_key = cparams->cipher_key != NULL;
+  if (context->has_cipher_key) {
+    memcpy(context->cipher_key, cparams->cipher_key, BLOSC2_CIPHER_KEY_SIZE);
+  }
+  context->codec_params = cparams->codec_params;
+  memcpy(context->filter_params, cparams->filter_params, BLOSC2_MAX_FILTERS * sizeof(void*));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  if (cparams.tuner_id <= 0) {
-    cparams.tuner_id = g_tuner;
+
+/* Set up the state of the tuner in cparams (the global one when not set) for context */
+static int init_tuner(blosc2_context* context, const blosc2_cparams* cparams) {
+  int tuner_id = cparams->tuner_id;
+  if (tuner_id <= 0) {
+    tuner_id = g_tuner;
+    if (tuner_id == BLOSC_STUNE && blosc_stune_init(cparams->tuner_params, context, NULL) < 0) {
+      BLOSC_TRACE_ERROR("Error in stune init function\n");
+      return BLOSC2_ERROR_TUNER;
+    }
   } else {
     for (int i = 0; i < g_ntuners; ++i) {
-      if (g_tuners[i].id == cparams.tuner_id) {
+      if (g_tuners[i].id == tuner_id) {
         if (g_tuners[i].init == NULL) {
           if (fill_tuner(&g_tuners[i]) < 0) {
             BLOSC_TRACE_ERROR("Could not load tuner %d.", g_tuners[i].id);
-            return NULL;
+            return BLOSC2_ERROR_FAILURE;
           }
         }
-        if (g_tuners[i].init(cparams.tuner_params, context, NULL) < 0) {
-          BLOSC_TRACE_ERROR("Error in user-defined tuner %d init function\n", cparams.tuner_id);
-          return NULL;
+        if (g_tuners[i].init(cparams->tuner_params, context, NULL) < 0) {
+          BLOSC_TRACE_ERROR("Error in user-defined tuner %d init function\n", tuner_id);
+          return BLOSC2_ERROR_TUNER;
         }
         goto urtunersuccess;
       }
     }
-    BLOSC_TRACE_ERROR("User-defined tuner %d not found\n", cparams.tuner_id);
-    return NULL;
+    BLOSC_TRACE_ERROR("User-defined tuner %d not found\n", tuner_id);
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
   urtunersuccess:;
 
-  context->tuner_id = cparams.tuner_id;
+  context->tuner_id = tuner_id;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  context->codec_params = cparams.codec_params;
-  memcpy(context->filter_params, cparams.filter_params, BLOSC2_MAX_FILTERS * sizeof(void*));
 
-  return context;
+/* Release the state of the tuner of context (if any) */
+static int free_tuner(blosc2_context* context) {
+  if (context->tuner_params == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int rc;
+  if (context->tuner_id < BLOSC_LAST_TUNER && context->tuner_id == BLOSC_STUNE) {
+    rc = blosc_stune_free(context);
+  } else {
+    for (int i = 0; i < g_ntuners; ++i) {
+      if (g_tuners[i].id == context->tuner_id) {
+        if (g_tuners[i].free == NULL) {
+          if (fill_tuner(&g_tuners[i]) < 0) {
+            BLOSC_TRACE_ERROR("Could not load tuner %d.", g_tuners[i].id);
+            return BLOSC2_ERROR_FAILURE;
+          }
+        }
+        rc = g_tuners[i].free(context);
+        goto urtunersuccess;
+      }
+    }
+    BLOSC_TRACE_ERROR("User-defined tuner %d not found\n", context->tuner_id);
+    return BLOSC2_ERROR_INVALID_PARAM;
+    urtunersuccess:;
+  }
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Error in user-defined tuner free function\n");
+    return BLOSC2_ERROR_TUNER;
+  }
+  context->tuner_params = NULL;
+
+  return BLOSC2_ERROR_SUCCESS;
 }
 
-/* Create a context for decompression */
-blosc2_context* blosc2_create_dctx(blosc2_dparams dparams) {
-  blosc2_context* context = (blosc2_context*)my_malloc(sizeof(blosc2_context));
+
+blosc2_context* blosc2_create_cctx(blosc2_cparams cparams) {
+  if (cparams.allocator != NULL && (cparams.allocator->malloc == NULL || cparams.allocator->free == NULL)) {
+    BLOSC_TRACE_ERROR("The allocator needs both a malloc and a free function.");
+    return NULL;
+  }
+  blosc2_allocator allocator = cparams.allocator != NULL ? *cparams.allocator : g_allocator;
+  blosc2_context* context = (blosc2_context*)my_malloc(&allocator, sizeof(blosc2_context));
   BLOSC_ERROR_NULL(context, NULL);
 
   /* Populate the context, using zeros as default values */
   memset(context, 0, sizeof(blosc2_context));
-  context->do_compress = 0;   /* Meant for decompression */
+  context->allocator = allocator;
+  context->allocator_params = cparams.allocator;
+  context->do_compress = 1;   /* meant for compression */
+  context->numa_nodes = get_affinity_nodes();
 
-  context->nthreads = dparams.nthreads;
-  char* envvar = getenv("BLOSC_NTHREADS");
-  if (envvar != NULL) {
-    long nthreads = strtol(envvar, NULL, 10);
-    if ((nthreads != EINVAL) && (nthreads > 0)) {
-      context->nthreads = (int16_t) nthreads;
-    }
+  if (set_cparams(context, &cparams) < 0) {
+    ctx_free(context, context);
+    return NULL;
   }
-  context->new_nthreads = context->nthreads;
-
+  context->nthreads = context->new_nthreads;
   context->threads_started = 0;
-  context->block_maskout = NULL;
-  context->block_maskout_nitems = 0;
-  context->schunk = dparams.schunk;
 
-  if (dparams.postfilter != NULL) {
-    context->postfilter = dparams.postfilter;
-    context->postparams = (blosc2_postfilter_params*)my_malloc(sizeof(blosc2_postfilter_params));
-    BLOSC_ERROR_NULL(context->postparams, NULL);
-    memcpy(context->postparams, dparams.postparams, sizeof(blosc2_postfilter_params));
+  if (init_tuner(context, &cparams) < 0) {
+    blosc2_free_ctx(context);
+    return NULL;
   }
 
   return context;
 }
 
 
-void blosc2_free_ctx(blosc2_context* context) {
-  release_threadpool(context);
-  if (context->serial_context != NULL) {
-    free_thread_context(context->serial_context);
+int blosc2_ctx_update_cparams(blosc2_context* ctx, const blosc2_cparams* cparams) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(cparams, BLOSC2_ERROR_NULL_POINTER);
+  if (ctx->do_compress != 1) {
+    BLOSC_TRACE_ERROR("Context is not meant for compression.  Giving up.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
-  if (context->dict_cdict != NULL) {
-#ifdef HAVE_ZSTD
-    ZSTD_freeCDict(context->dict_cdict);
-#endif
+  int rc = set_cparams(ctx, cparams);
+  if (rc < 0) {
+    return rc;
   }
-  if (context->dict_ddict != NULL) {
-#ifdef HAVE_ZSTD
-    ZSTD_freeDDict(context->dict_ddict);
-#endif
+
+  /* The tuner keeps its state unless another tuner (or config) is asked for */
+  int tuner_id = cparams->tuner_id <= 0 ? g_tuner : cparams->tuner_id;
+  if (tuner_id != ctx->tuner_id || cparams->tuner_params != NULL) {
+    BLOSC_ERROR(free_tuner(ctx));
+    BLOSC_ERROR(init_tuner(ctx, cparams));
   }
-  if (context->tuner_params != NULL) {
-    int rc;
-    if (context->tuner_id < BLOSC_LAST_TUNER && context->tuner_id == BLOSC_STUNE) {
-      rc = blosc_stune_free(context);
-    } else {
-      for (int i = 0; i < g_ntuners; ++i) {
-        if (g_tuners[i].id == context->tuner_id) {
-          if (g_tuners[i].free == NULL) {
-            if (fill_tuner(&g_tuners[i]) < 0) {
-              BLOSC_TRACE_ERROR("Could not load tuner %d.", g_tuners[i].id);
-              return;
-            }
-          }
-          rc = g_tuners[i].free(context);
-          goto urtunersuccess;
-        }
-      }
-      BLOSC_TRACE_ERROR("User-defined tuner %d not found\n", context->tuner_id);
-      return;
-      urtunersuccess:;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Validate the decompression parameters and set them in context, which is left
+ * untouched if they are not valid.  The allocator is left to the callers. */
+static int set_dparams(blosc2_context* context, const blosc2_dparams* dparams) {
+  int16_t nthreads = dparams->nthreads;
+  const char* envvar = blosc_getenv(BLOSC_ENV_NTHREADS);
+  if (envvar != NULL) {
+    long value = strtol(envvar, NULL, 10);
+    if (strcmp(envvar, "AUTO") == 0) {
+      nthreads = BLOSC2_NTHREADS_AUTO;
     }
-    if (rc < 0) {
-      BLOSC_TRACE_ERROR("Error in user-defined tuner free function\n");
-      return;
+    else if ((value != EINVAL) && (value > 0)) {
+      nthreads = (int16_t) value;
     }
   }
+
+  if (dparams->scheduler < BLOSC_DEFAULT_SCHED || dparams->scheduler > BLOSC_STREAMS_SCHED) {
+    BLOSC_TRACE_ERROR("scheduler (%d) is not supported", dparams->scheduler);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (dparams->device < BLOSC2_DEVICE_HOST || dparams->device > BLOSC2_DEVICE_CUDA) {
+    BLOSC_TRACE_ERROR("device (%d) is not supported", dparams->device);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (dparams->nontemporal < BLOSC2_NONTEMPORAL_AUTO || dparams->nontemporal > BLOSC2_NONTEMPORAL_ALWAYS) {
+    BLOSC_TRACE_ERROR("nontemporal (%d) is not supported", dparams->nontemporal);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+#ifndef HAVE_CUDA
+  if (dparams->device == BLOSC2_DEVICE_CUDA) {
+    BLOSC_TRACE_ERROR("Decompressing into CUDA device memory needs a Blosc built with CUDA.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+#endif
+  if (dparams->block_postfilter != NULL &&
+      (dparams->block_postfilter->block == NULL || dparams->postfilter != NULL ||
+       dparams->device != BLOSC2_DEVICE_HOST)) {
+    BLOSC_TRACE_ERROR("The block postfilter needs a block function, and it only works alone and on the host.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  if (dparams->postfilter != NULL && context->postparams == NULL) {
+    context->postparams = (blosc2_postfilter_params*)ctx_malloc(context, sizeof(blosc2_postfilter_params));
+    BLOSC_ERROR_NULL(context->postparams, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  if (dparams->block_postfilter != NULL && context->block_postfilter == NULL) {
+    context->block_postfilter = (blosc2_block_postfilter*)ctx_malloc(context, sizeof(blosc2_block_postfilter));
+    BLOSC_ERROR_NULL(context->block_postfilter, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+
+  if (dparams->postfilter != NULL) {
+    memcpy(context->postparams, dparams->postparams, sizeof(blosc2_postfilter_params));
+  }
+  else if (context->postparams != NULL) {
+    ctx_free(context, context->postparams);
+    context->postparams = NULL;
+  }
+  context->postfilter = dparams->postfilter;
+  if (dparams->block_postfilter != NULL) {
+    memcpy(context->block_postfilter, dparams->block_postfilter, sizeof(blosc2_block_postfilter));
+  }
+  else if (context->block_postfilter != NULL) {
+    ctx_free(context, context->block_postfilter);
+    context->block_postfilter = NULL;
+  }
+
+  /* The threads are (re)started at the next decompression, when needed */
+  context->auto_nthreads = nthreads == BLOSC2_NTHREADS_AUTO;
+  context->new_nthreads = context->auto_nthreads ? max_auto_nthreads() : nthreads;
+  context->schunk = dparams->schunk;
+  context->scheduler = dparams->scheduler;
+  context->device = dparams->device;
+  context->verify_checksums = dparams->verify_checksums;
+  context->nontemporal = dparams->nontemporal;
+  context->has_cipher_key = dparams->cipher_key != NULL;
+  if (context->has_cipher_key) {
+    memcpy(context->cipher_key, dparams->cipher_key, BLOSC2_CIPHER_KEY_SIZE);
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Create a context for decompression */
+blosc2_context* blosc2_create_dctx(blosc2_dparams dparams) {
+  if (dparams.allocator != NULL && (dparams.allocator->malloc == NULL || dparams.allocator->free == NULL)) {
+    BLOSC_TRACE_ERROR("The allocator needs both a malloc and a free function.");
+    return NULL;
+  }
+  blosc2_allocator allocator = dparams.allocator != NULL ? *dparams.allocator : g_allocator;
+  blosc2_context* context = (blosc2_context*)my_malloc(&allocator, sizeof(blosc2_context));
+  BLOSC_ERROR_NULL(context, NULL);
+
+  /* Populate the context, using zeros as default values */
+  memset(context, 0, sizeof(blosc2_context));
+  context->allocator = allocator;
+  context->allocator_params = dparams.allocator;
+  context->do_compress = 0;   /* Meant for decompression */
+  context->numa_nodes = get_affinity_nodes();
+
+  if (set_dparams(context, &dparams) < 0) {
+    ctx_free(context, context);
+    return NULL;
+  }
+  context->nthreads = context->new_nthreads;
+  context->threads_started = 0;
+
+  return context;
+}
+
+
+int blosc2_ctx_update_dparams(blosc2_context* ctx, const blosc2_dparams* dparams) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(dparams, BLOSC2_ERROR_NULL_POINTER);
+  if (ctx->do_compress != 0) {
+    BLOSC_TRACE_ERROR("Context is not meant for decompression.  Giving up.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  return set_dparams(ctx, dparams);
+}
+
+
+void blosc2_free_ctx(blosc2_context* context) {
+  release_threadpool(context);
+  if (context->serial_context != NULL) {
+    free_thread_context(context->serial_context);
+  }
+  free_cdict(context);
+#ifdef HAVE_CUDA
+  cuda_free_state(context);
+#endif
+  if (context->dict_ddict != NULL) {
+#ifdef HAVE_ZSTD
+    ZSTD_freeDDict(context->dict_ddict);
+#endif
+  }
+  if (free_tuner(context) < 0) {
+    return;
+  }
   if (context->prefilter != NULL) {
-    my_free(context->preparams);
+    ctx_free(context, context->preparams);
   }
   if (context->postfilter != NULL) {
-    my_free(context->postparams);
+    ctx_free(context, context->postparams);
   }
+  ctx_free(context, context->block_postfilter);
 
   if (context->block_maskout != NULL) {
-    free(context->block_maskout);
+    ctx_free(context, context->block_maskout);
+  }
+  if (context->zfp_boxes != NULL) {
+    ctx_free(context, context->zfp_boxes);
+  }
+  if (context->block_csizes != NULL) {
+    ctx_free(context, context->block_csizes);
+  }
+  ctx_free(context, context->block_zonemaps);
+  ctx_free(context, context->block_checksums);
+  ctx_free(context, context->cipher_blocks);
+  cipher_wipe(context->cipher_key, BLOSC2_CIPHER_KEY_SIZE);
+  ctx_free(context, context->streams_src);
+  ctx_free(context, context->streams_dest);
+  ctx_free(context, context->streams_csizes);
+  /* The allocator is in the context itself */
+  blosc2_allocator allocator = context->allocator;
+  my_free(&allocator, context);
+}
+
+
+int blosc2_ctx_set_task_scheduler(blosc2_context *ctx, const blosc2_task_scheduler *scheduler) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  if (scheduler != NULL && scheduler->submit == NULL) {
+    BLOSC_TRACE_ERROR("The task scheduler needs a submit function.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
-  my_free(context);
+  /* The threads (or their data) are set up again for the new backend at the next call */
+  if (ctx->threads_started > 0) {
+    release_threadpool(ctx);
+  }
+  if (scheduler != NULL) {
+    ctx->task_scheduler = *scheduler;
+  }
+  else {
+    memset(&ctx->task_scheduler, 0, sizeof(blosc2_task_scheduler));
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
 }
 
 
@@ -4195,7 +8033,7 @@ int blosc2_ctx_get_cparams(blosc2_context *ctx, blosc2_cparams *cparams) {
   cparams->use_dict = ctx->use_dict;
   cparams->instr_codec = ctx->blosc2_flags & BLOSC2_INSTR_CODEC;
   cparams->typesize = ctx->typesize;
-  cparams->nthreads = ctx->nthreads;
+  cparams->nthreads = ctx->auto_nthreads ? BLOSC2_NTHREADS_AUTO : ctx->nthreads;
   cparams->blocksize = ctx->blocksize;
   cparams->splitmode = ctx->splitmode;
   cparams->schunk = ctx->schunk;
@@ -4206,31 +8044,224 @@ int blosc2_ctx_get_cparams(blosc2_context *ctx, blosc2_cparams *cparams) {
   cparams->prefilter = ctx->prefilter;
   cparams->preparams = ctx->preparams;
   cparams->tuner_id = ctx->tuner_id;
+  // The state of the tuner belongs to the context (and it is not a tuner config)
+  cparams->tuner_params = NULL;
   cparams->codec_params = ctx->codec_params;
+  cparams->scheduler = ctx->scheduler;
+  cparams->allocator = ctx->allocator_params;
+  cparams->special_detection = ctx->special_detection;
+  cparams->record_stats = ctx->record_stats;
+  cparams->zonemap = ctx->zonemap;
+  cparams->checksum = ctx->checksum;
+  cparams->block_codec = ctx->block_codec;
+  cparams->block_codec_params = ctx->block_codec_params;
+  cparams->zstd_window = ctx->zstd_window;
+  cparams->detect_typesize = ctx->detect_typesize;
+  cparams->cipher = ctx->cipher;
+  cparams->cipher_key = ctx->has_cipher_key ? ctx->cipher_key : NULL;
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
 int blosc2_ctx_get_dparams(blosc2_context *ctx, blosc2_dparams *dparams) {
-  dparams->nthreads = ctx->nthreads;
+  dparams->nthreads = ctx->auto_nthreads ? BLOSC2_NTHREADS_AUTO : ctx->nthreads;
   dparams->schunk = ctx->schunk;
   dparams->postfilter = ctx->postfilter;
   dparams->postparams = ctx->postparams;
+  dparams->scheduler = ctx->scheduler;
+  dparams->allocator = ctx->allocator_params;
+  dparams->device = ctx->device;
+  dparams->block_postfilter = ctx->block_postfilter;
+  dparams->verify_checksums = ctx->verify_checksums;
+  dparams->cipher_key = ctx->has_cipher_key ? ctx->cipher_key : NULL;
+  dparams->nontemporal = ctx->nontemporal;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_ctx_get_stats(const blosc2_context *ctx, blosc2_ctx_stats *stats) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stats, BLOSC2_ERROR_NULL_POINTER);
+  *stats = ctx->stats;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_ctx_reset_stats(blosc2_context *ctx) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  memset(&ctx->stats, 0, sizeof(blosc2_ctx_stats));
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+#if defined(HAVE_ZLIB)
+/* The memory of the zlib streams with the default windowBits and memLevel (see zconf.h) */
+#define ZLIB_DEFLATE_NBYTES ((1 << (15 + 2)) + (1 << (8 + 9)) + 6 * 1024)
+#define ZLIB_INFLATE_NBYTES ((1 << 15) + 7 * 1024)
+#endif
+
+/* Add the memory of a thread context (but the struct itself) to `usage` */
+static void thread_context_memory(const struct thread_context* thread_context, blosc2_ctx_memory* usage) {
+  if (thread_context->tmp != NULL) {
+    usage->scratch += thread_context->tmp_class >= 0 ?
+                      (int64_t)scratch_class_nbytes(thread_context->tmp_class) :
+                      (int64_t)thread_context->tmp_nbytes;
+  }
+  if (thread_context->block_input != NULL) {
+    usage->scratch += thread_context->tmp_blocksize;
+  }
+#if defined(HAVE_ZSTD)
+  usage->scratch += thread_context->zstd_prefix_size;
+  if (thread_context->zstd_cctx != NULL) {
+    usage->codecs += (int64_t)ZSTD_sizeof_CCtx(thread_context->zstd_cctx);
+  }
+  if (thread_context->zstd_dctx != NULL) {
+    usage->codecs += (int64_t)ZSTD_sizeof_DCtx(thread_context->zstd_dctx);
+  }
+#endif
+#ifdef HAVE_IPP
+  if (thread_context->lz4_hash_table != NULL) {
+    int hash_size = 0;
+    if (ippsEncodeLZ4HashTableGetSize_8u(&hash_size) == ippStsNoErr) {
+      usage->codecs += hash_size;
+    }
+  }
+#endif
+  if (thread_context->lz4_state != NULL) {
+    usage->codecs += (int64_t)sizeof(LZ4_stream_t);
+  }
+#if defined(HAVE_ZLIB)
+  if (thread_context->zlib_deflate != NULL) {
+    usage->codecs += (int64_t)sizeof(ZLIB_STREAM) + ZLIB_DEFLATE_NBYTES;
+  }
+  if (thread_context->zlib_inflate != NULL) {
+    usage->codecs += (int64_t)sizeof(ZLIB_STREAM) + ZLIB_INFLATE_NBYTES;
+  }
+#endif
+}
+
+
+int blosc2_ctx_memory_usage(const blosc2_context *ctx, blosc2_ctx_memory *usage) {
+  BLOSC_ERROR_NULL(ctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(usage, BLOSC2_ERROR_NULL_POINTER);
+  memset(usage, 0, sizeof(blosc2_ctx_memory));
+
+  usage->context = (int64_t)sizeof(blosc2_context);
+  if (ctx->serial_context != NULL) {
+    usage->context += (int64_t)sizeof(struct thread_context);
+    thread_context_memory(ctx->serial_context, usage);
+  }
+  if (ctx->threads_started > 0) {
+    usage->context += ctx->threads_started * (int64_t)sizeof(struct blosc_block_range);
+    if (ctx->thread_contexts != NULL) {
+      for (int t = 0; t < ctx->threads_started; t++) {
+        thread_context_memory(ctx->thread_contexts + t, usage);
+      }
+    }
+    else if (ctx->own_thread_contexts != NULL) {
+      usage->context += ctx->threads_started * (int64_t)(sizeof(pthread_t) + sizeof(struct thread_context*));
+      for (int t = 0; t < ctx->threads_started; t++) {
+        if (ctx->own_thread_contexts[t] != NULL) {
+          thread_context_memory(ctx->own_thread_contexts[t], usage);
+        }
+      }
+    }
+    usage->context += ctx->threads_started * (int64_t)sizeof(struct thread_context);
+  }
+  if (ctx->preparams != NULL) {
+    usage->context += (int64_t)sizeof(blosc2_prefilter_params);
+  }
+  if (ctx->postparams != NULL) {
+    usage->context += (int64_t)sizeof(blosc2_postfilter_params);
+  }
+  if (ctx->block_postfilter != NULL) {
+    usage->context += (int64_t)sizeof(blosc2_block_postfilter);
+  }
+  if (ctx->block_maskout != NULL) {
+    usage->context += ctx->block_maskout_nitems * (int64_t)sizeof(bool);
+  }
+  if (ctx->zfp_boxes != NULL) {
+    usage->context += ctx->zfp_boxes_nitems * (int64_t)(2 * ctx->zfp_boxes_ndim) * (int64_t)sizeof(int64_t);
+  }
+
+  /* The dictionaries themselves live in the chunks (or in the super-chunk), but their digests do not */
+  if (ctx->dict_cdict != NULL) {
+    switch (ctx->compcode) {
+#ifdef HAVE_ZSTD
+      case BLOSC_ZSTD:
+        usage->dicts += (int64_t)ZSTD_sizeof_CDict(ctx->dict_cdict);
+        break;
+#endif
+      case BLOSC_LZ4:
+        usage->dicts += (int64_t)sizeof(LZ4_stream_t);
+        break;
+      case BLOSC_BLOSCLZ:
+        usage->dicts += blosclz_sizeof_cdict();
+        break;
+      default:
+        break;
+    }
+  }
+#ifdef HAVE_ZSTD
+  if (ctx->dict_ddict != NULL) {
+    usage->dicts += (int64_t)ZSTD_sizeof_DDict(ctx->dict_ddict);
+  }
+#endif
 
+  if (ctx->block_csizes != NULL) {
+    usage->blocks += ctx->block_csizes_len * (int64_t)sizeof(int32_t);
+  }
+  if (ctx->block_zonemaps != NULL) {
+    usage->blocks += ctx->block_zonemaps_len * (int64_t)sizeof(blosc2_zonemap);
+  }
+  if (ctx->block_checksums != NULL) {
+    usage->blocks += ctx->block_checksums_len * (int64_t)sizeof(uint64_t);
+  }
+  if (ctx->cipher_blocks != NULL) {
+    usage->blocks += ctx->cipher_blocks_len * (int64_t)CIPHER_BLOCK_SIZE;
+  }
+  if (ctx->streams_src != NULL) {
+    usage->blocks += ctx->streams_src_len;
+  }
+  if (ctx->streams_dest != NULL) {
+    usage->blocks += ctx->streams_dest_len;
+  }
+  if (ctx->streams_csizes != NULL) {
+    usage->blocks += ctx->streams_csizes_len * (int64_t)sizeof(int32_t);
+  }
+
+  usage->total = usage->context + usage->scratch + usage->codecs + usage->dicts + usage->blocks;
   return BLOSC2_ERROR_SUCCESS;
 }
 
 
+int blosc2_set_trace_cb(blosc2_trace_cb cb, void *user_data) {
+#if defined(HAVE_TRACE_HOOKS)
+  g_trace_data = user_data;
+  g_trace_cb = cb;
+  return BLOSC2_ERROR_SUCCESS;
+#else
+  BLOSC_UNUSED_PARAM(cb);
+  BLOSC_UNUSED_PARAM(user_data);
+  BLOSC_TRACE_ERROR("Blosc has been built without the tracing hooks (see the ENABLE_TRACE_HOOKS option).");
+  return BLOSC2_ERROR_FAILURE;
+#endif
+}
+
+
 /* Set a maskout in decompression context */
 int blosc2_set_maskout(blosc2_context *ctx, bool *maskout, int nblocks) {
 
   if (ctx->block_maskout != NULL) {
     // Get rid of a possible mask here
-    free(ctx->block_maskout);
+    ctx_free(ctx, ctx->block_maskout);
   }
 
-  bool *maskout_ = malloc(nblocks);
+  bool *maskout_ = ctx_malloc(ctx, nblocks);
   BLOSC_ERROR_NULL(maskout_, BLOSC2_ERROR_MEMORY_ALLOC);
   memcpy(maskout_, maskout, nblocks);
   ctx->block_maskout = maskout_;
@@ -4333,6 +8364,52 @@ int blosc2_chunk_uninit(blosc2_cparams cparams, const int32_t nbytes, void* dest
 }
 
 
+/* Create a chunk whose values are generated by the postfilter */
+int blosc2_chunk_virtual(blosc2_cparams cparams, const int32_t nbytes, void* dest, int32_t destsize) {
+  if (destsize < BLOSC_EXTENDED_HEADER_LENGTH) {
+    BLOSC_TRACE_ERROR("dest buffer is not long enough");
+    return BLOSC2_ERROR_DATA;
+  }
+
+  if (nbytes % cparams.typesize) {
+    BLOSC_TRACE_ERROR("nbytes must be a multiple of typesize");
+    return BLOSC2_ERROR_DATA;
+  }
+
+  blosc_header header;
+  blosc2_context* context = blosc2_create_cctx(cparams);
+  if (context == NULL) {
+    BLOSC_TRACE_ERROR("Error while creating the compression context");
+    return BLOSC2_ERROR_NULL_POINTER;
+  }
+  int error = initialize_context_compression(
+          context, NULL, nbytes, dest, destsize,
+          context->clevel, context->filters, context->filters_meta,
+          context->typesize, context->compcode, context->blocksize,
+          context->new_nthreads, context->nthreads, context->splitmode,
+          context->tuner_id, context->tuner_params, context->schunk);
+  if (error <= 0) {
+    blosc2_free_ctx(context);
+    return error;
+  }
+
+  memset(&header, 0, sizeof(header));
+  header.version = BLOSC2_VERSION_FORMAT;
+  header.versionlz = BLOSC_BLOSCLZ_VERSION_FORMAT;
+  header.flags = BLOSC_DOSHUFFLE | BLOSC_DOBITSHUFFLE;  // extended header
+  header.typesize = context->typesize;
+  header.nbytes = (int32_t)nbytes;
+  header.blocksize = context->blocksize;
+  header.cbytes = BLOSC_EXTENDED_HEADER_LENGTH;
+  header.blosc2_flags = BLOSC2_SPECIAL_VIRTUAL << 4;  // mark chunk as virtual
+  memcpy((uint8_t *)dest, &header, sizeof(header));
+
+  blosc2_free_ctx(context);
+
+  return BLOSC_EXTENDED_HEADER_LENGTH;
+}
+
+
 /* Create a chunk made of nans */
 int blosc2_chunk_nans(blosc2_cparams cparams, const int32_t nbytes, void* dest, int32_t destsize) {
   if (destsize < BLOSC_EXTENDED_HEADER_LENGTH) {
@@ -4380,6 +8457,47 @@ int blosc2_chunk_nans(blosc2_cparams cparams, const int32_t nbytes, void* dest,
 }
 
 
+/* Write the header of a memcpyed chunk whose `nbytes` follow it in dest */
+int chunk_memcpyed_header(blosc2_cparams cparams, int32_t nbytes, void* dest) {
+  if (nbytes < 0 || nbytes > BLOSC2_MAX_BUFFERSIZE - BLOSC_EXTENDED_HEADER_LENGTH) {
+    BLOSC_TRACE_ERROR("The data of a memcpyed chunk cannot be larger than %d bytes",
+                      BLOSC2_MAX_BUFFERSIZE - BLOSC_EXTENDED_HEADER_LENGTH);
+    return BLOSC2_ERROR_MAX_BUFSIZE_EXCEEDED;
+  }
+
+  blosc_header header;
+  blosc2_context* context = blosc2_create_cctx(cparams);
+  if (context == NULL) {
+    BLOSC_TRACE_ERROR("Error while creating the compression context");
+    return BLOSC2_ERROR_NULL_POINTER;
+  }
+  int error = initialize_context_compression(
+          context, NULL, nbytes, dest, nbytes + BLOSC_EXTENDED_HEADER_LENGTH,
+          0, context->filters, context->filters_meta,
+          context->typesize, context->compcode, context->blocksize,
+          context->new_nthreads, context->nthreads, context->splitmode,
+          context->tuner_id, context->tuner_params, context->schunk);
+  if (error <= 0) {
+    blosc2_free_ctx(context);
+    return error;
+  }
+
+  memset(&header, 0, sizeof(header));
+  header.version = BLOSC2_VERSION_FORMAT;
+  header.versionlz = BLOSC_BLOSCLZ_VERSION_FORMAT;
+  header.flags = BLOSC_DOSHUFFLE | BLOSC_DOBITSHUFFLE | BLOSC_MEMCPYED;  // extended header
+  header.typesize = context->typesize;
+  header.nbytes = nbytes;
+  header.blocksize = context->blocksize;
+  header.cbytes = nbytes + BLOSC_EXTENDED_HEADER_LENGTH;
+  memcpy((uint8_t *)dest, &header, sizeof(header));
+
+  blosc2_free_ctx(context);
+
+  return BLOSC_EXTENDED_HEADER_LENGTH;
+}
+
+
 /* Create a chunk made of repeated values */
 int blosc2_chunk_repeatval(blosc2_cparams cparams, const int32_t nbytes,
                            void* dest, int32_t destsize, const void* repeatval) {
@@ -4513,6 +8631,7 @@ int register_codec_private(blosc2_codec *codec) {
       }
     }
 
+    g_codecs_getitems[g_ncodecs] = NULL;
     blosc2_codec *codec_new = &g_codecs[g_ncodecs++];
     memcpy(codec_new, codec, sizeof(blosc2_codec));
 
@@ -4520,6 +8639,18 @@ int register_codec_private(blosc2_codec *codec) {
 }
 
 
+int register_codec_getitems_private(uint8_t compcode, blosc2_codec_getitems_cb getitems) {
+  for (int i = 0; i < g_ncodecs; ++i) {
+    if (g_codecs[i].compcode == compcode) {
+      g_codecs_getitems[i] = getitems;
+      return BLOSC2_ERROR_SUCCESS;
+    }
+  }
+  BLOSC_TRACE_ERROR("The codec %d is not registered", compcode);
+  return BLOSC2_ERROR_NOT_FOUND;
+}
+
+
 int blosc2_register_codec(blosc2_codec *codec) {
   if (codec->compcode < BLOSC2_USER_REGISTERED_CODECS_START) {
     BLOSC_TRACE_ERROR("The compcode must be greater or equal than %d", BLOSC2_USER_REGISTERED_CODECS_START);
@@ -4530,6 +8661,45 @@ int blosc2_register_codec(blosc2_codec *codec) {
 }
 
 
+int blosc2_register_codec_getitems(uint8_t compcode, blosc2_codec_getitems_cb getitems) {
+  if (compcode < BLOSC2_USER_REGISTERED_CODECS_START) {
+    BLOSC_TRACE_ERROR("The compcode must be greater or equal than %d", BLOSC2_USER_REGISTERED_CODECS_START);
+    return BLOSC2_ERROR_CODEC_PARAM;
+  }
+
+  return register_codec_getitems_private(compcode, getitems);
+}
+
+
+int tuner_serialize(blosc2_context *cctx, uint8_t **content, int32_t *content_len) {
+  if (cctx->tuner_id == BLOSC_STUNE) {
+    return blosc_stune_serialize(cctx, content, content_len);
+  }
+  for (int i = 0; i < g_ntuners; ++i) {
+    if (g_tuners[i].id == cctx->tuner_id) {
+      return g_tuners_serialize[i] != NULL ? g_tuners_serialize[i](cctx, content, content_len) : 0;
+    }
+  }
+  return 0;
+}
+
+
+int tuner_deserialize(blosc2_context *cctx, const uint8_t *content, int32_t content_len) {
+  if (cctx->tuner_id == BLOSC_STUNE) {
+    return blosc_stune_deserialize(cctx, content, content_len);
+  }
+  for (int i = 0; i < g_ntuners; ++i) {
+    if (g_tuners[i].id == cctx->tuner_id) {
+      if (g_tuners_deserialize[i] == NULL) {
+        return BLOSC2_ERROR_SUCCESS;
+      }
+      return g_tuners_deserialize[i](cctx, content, content_len);
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
 /* Register tuners */
 
 int register_tuner_private(blosc2_tuner *tuner) {
@@ -4557,6 +8727,8 @@ int register_tuner_private(blosc2_tuner *tuner) {
     }
   }
 
+  g_tuners_serialize[g_ntuners] = NULL;
+  g_tuners_deserialize[g_ntuners] = NULL;
   blosc2_tuner *tuner_new = &g_tuners[g_ntuners++];
   memcpy(tuner_new, tuner, sizeof(blosc2_tuner));
 
@@ -4574,7 +8746,21 @@ int blosc2_register_tuner(blosc2_tuner *tuner) {
 }
 
 
-int _blosc2_register_io_cb(const blosc2_io_cb *io) {
+int blosc2_register_tuner_state(int id, blosc2_tuner_serialize_cb serialize,
+                                blosc2_tuner_deserialize_cb deserialize) {
+  for (int i = 0; i < g_ntuners; ++i) {
+    if (g_tuners[i].id == id) {
+      g_tuners_serialize[i] = serialize;
+      g_tuners_deserialize[i] = deserialize;
+      return BLOSC2_ERROR_SUCCESS;
+    }
+  }
+  BLOSC_TRACE_ERROR("The tuner (ID: %d) is not registered.", id);
+  return BLOSC2_ERROR_NOT_FOUND;
+}
+
+
+int _blosc2_register_io_cb(const blosc2_io_cb *io, const blosc2_io_cb_ext *ext) {
 
   for (uint64_t i = 0; i < g_nio; ++i) {
     if (g_ios[i].id == io->id) {
@@ -4592,6 +8778,12 @@ int _blosc2_register_io_cb(const blosc2_io_cb *io) {
 
   blosc2_io_cb *io_new = &g_ios[g_nio++];
   memcpy(io_new, io, sizeof(blosc2_io_cb));
+  if (ext != NULL) {
+    g_ios_ext[io->id] = *ext;
+  }
+  else {
+    memset(&g_ios_ext[io->id], 0, sizeof(blosc2_io_cb_ext));
+  }
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -4608,7 +8800,33 @@ int blosc2_register_io_cb(const blosc2_io_cb *io) {
     return BLOSC2_ERROR_PLUGIN_IO;
   }
 
-  return _blosc2_register_io_cb(io);
+  return _blosc2_register_io_cb(io, NULL);
+}
+
+int blosc2_register_io_cb_ext(uint8_t id, const blosc2_io_cb_ext *ext) {
+  BLOSC_ERROR_NULL(ext, BLOSC2_ERROR_INVALID_PARAM);
+  if (id < BLOSC2_IO_REGISTERED) {
+    BLOSC_TRACE_ERROR("The id must be greater or equal than %d", BLOSC2_IO_REGISTERED);
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  if (blosc2_get_io_cb(id) == NULL) {
+    BLOSC_TRACE_ERROR("The IO (ID: %d) is not registered.", id);
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  g_ios_ext[id] = *ext;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+const blosc2_io_cb_ext *blosc2_get_io_cb_ext(uint8_t id) {
+  if (blosc2_get_io_cb(id) == NULL) {
+    return NULL;
+  }
+  return &g_ios_ext[id];
+}
+
+const blosc2_io_cb_ext *io_cb_ext(const blosc2_io_cb *io_cb) {
+  return &g_ios_ext[io_cb->id];
 }
 
 blosc2_io_cb *blosc2_get_io_cb(uint8_t id) {
@@ -4618,12 +8836,40 @@ blosc2_io_cb *blosc2_get_io_cb(uint8_t id) {
     }
   }
   if (id == BLOSC2_IO_FILESYSTEM) {
-    if (_blosc2_register_io_cb(&BLOSC2_IO_CB_DEFAULTS) < 0) {
+    if (_blosc2_register_io_cb(&BLOSC2_IO_CB_DEFAULTS, &BLOSC2_IO_CB_EXT_DEFAULTS) < 0) {
       BLOSC_TRACE_ERROR("Error registering the default IO API");
       return NULL;
     }
     return blosc2_get_io_cb(id);
   }
+  if (id == BLOSC2_IO_FILESYSTEM_MMAP) {
+    if (_blosc2_register_io_cb(&BLOSC2_IO_CB_MMAP, &BLOSC2_IO_CB_EXT_MMAP) < 0) {
+      BLOSC_TRACE_ERROR("Error registering the memory-mapped IO API");
+      return NULL;
+    }
+    return blosc2_get_io_cb(id);
+  }
+  if (id == BLOSC2_IO_FILESYSTEM_URING) {
+    if (_blosc2_register_io_cb(&BLOSC2_IO_CB_URING, &BLOSC2_IO_CB_EXT_URING) < 0) {
+      BLOSC_TRACE_ERROR("Error registering the io_uring IO API");
+      return NULL;
+    }
+    return blosc2_get_io_cb(id);
+  }
+  if (id == BLOSC2_IO_FILESYSTEM_DIRECT) {
+    if (_blosc2_register_io_cb(&BLOSC2_IO_CB_DIRECT, &BLOSC2_IO_CB_EXT_DIRECT) < 0) {
+      BLOSC_TRACE_ERROR("Error registering the direct IO API");
+      return NULL;
+    }
+    return blosc2_get_io_cb(id);
+  }
+  if (id == BLOSC2_IO_OBJECT_STORE) {
+    if (_blosc2_register_io_cb(&BLOSC2_IO_CB_OBJSTORE, &BLOSC2_IO_CB_EXT_OBJSTORE) < 0) {
+      BLOSC_TRACE_ERROR("Error registering the object store IO API");
+      return NULL;
+    }
+    return blosc2_get_io_cb(id);
+  }
   return NULL;
 }
 
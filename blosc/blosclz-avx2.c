@@ -0,0 +1,16 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* blosclz.c built again with AVX2 enabled, for the wider match copies when decompressing
+   (which go to fastcopy-avx2.c).  The dictionaries are still digested by the baseline
+   build, as blosclz.h tells. */
+
+#define BLOSC_AVX2_BUILD
+#include "blosclz.c"
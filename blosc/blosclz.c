@@ -16,13 +16,22 @@
 
 #include "blosclz.h"
 #include "fastcopy.h"
+#include "shuffle.h"
 #include "blosc2/blosc2-common.h"
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+  #include <arm_neon.h>
+#endif
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
 /*
  * Give hints to the compiler for branch prediction optimization.
  * This is not necessary anymore with modern CPUs.
@@ -42,6 +51,17 @@
 #define inline __inline  /* Visual C is not C99, but supports some kind of inline */
 #endif
 
+/*
+ * Force the inlining of the functions that are specialized for the use of dictionaries.
+ */
+#if defined(_MSC_VER)
+#define BLOSCLZ_FORCE_INLINE static __forceinline
+#elif defined(__GNUC__)
+#define BLOSCLZ_FORCE_INLINE static inline __attribute__((always_inline))
+#else
+#define BLOSCLZ_FORCE_INLINE static inline
+#endif
+
 #define MAX_COPY 32U
 #define MAX_DISTANCE 8191
 #define MAX_FARDISTANCE (65535 + MAX_DISTANCE - 1)
@@ -56,39 +76,52 @@
 
 #define HASH_LOG (14U)
 
+/* The digested form of a dictionary: its last MAX_FARDISTANCE bytes (at most) and the hash
+ * table of their positions.  The dictionary is a virtual prefix of every input, so the
+ * positions in the hash table are counted from the start of this tail. */
+typedef struct {
+  const uint8_t* tail;
+  uint32_t tail_len;
+  uint8_t hashlog;
+  uint32_t htab[1U << HASH_LOG];
+} blosclz_cdict;
+
 // This is used in LZ4 and seems to work pretty well here too
 #define HASH_FUNCTION(v, s, h) {      \
   (v) = ((s) * 2654435761U) >> (32U - (h)); \
 }
 
+/*
+ * The first differing byte of two words is found from the trailing zeros of their xor,
+ * which needs the bytes in memory order (little endian).
+ */
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define BLOSCLZ_LITTLE_ENDIAN 1
+#else
+#define BLOSCLZ_LITTLE_ENDIAN 0
+#endif
 
-#if defined(__AVX2__)
-static uint8_t *get_run_32(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
-    uint8_t x = ip[-1];
-
-    while (ip < (ip_bound - (sizeof(__m256i)))) {
-        __m256i value, value2, cmp;
-        /* Broadcast the value for every byte in a 256-bit register */
-        memset(&value, x, sizeof(__m256i));
-        value2 = _mm256_loadu_si256((__m256i *)ref);
-        cmp = _mm256_cmpeq_epi64(value, value2);
-        if ((unsigned)_mm256_movemask_epi8(cmp) != 0xFFFFFFFF) {
-            /* Return the byte that starts to differ */
-            while (*ref++ == x) ip++;
-            return ip;
-        }
-        else {
-            ip += sizeof(__m256i);
-            ref += sizeof(__m256i);
-        }
-    }
-    /* Look into the remainder */
-    while ((ip < ip_bound) && (*ref++ == x)) ip++;
-    return ip;
-}
+/* Number of trailing zero bits of a non-zero value */
+static inline unsigned blosclz_ctz(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long r;
+  _BitScanForward64(&r, x);
+  return (unsigned)r;
+#elif defined(__GNUC__)
+  return (unsigned)__builtin_ctzll(x);
+#else
+  unsigned r = 0;
+  while (!(x & 1U)) {
+    x >>= 1U;
+    r++;
+  }
+  return r;
 #endif
+}
 
-#if defined(__SSE2__)
+
+/* Left out of the AVX2 build (as get_match() is), where it would clash with the baseline one */
+#if defined(__SSE2__) && !defined(BLOSC_AVX2_BUILD)
 uint8_t *get_run_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
   uint8_t x = ip[-1];
 
@@ -97,11 +130,11 @@ uint8_t *get_run_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
     /* Broadcast the value for every byte in a 128-bit register */
     memset(&value, x, sizeof(__m128i));
     value2 = _mm_loadu_si128((__m128i *)ref);
-    cmp = _mm_cmpeq_epi32(value, value2);
-    if (_mm_movemask_epi8(cmp) != 0xFFFF) {
+    cmp = _mm_cmpeq_epi8(value, value2);
+    unsigned mask = (unsigned)_mm_movemask_epi8(cmp) ^ 0xFFFFU;
+    if (mask != 0) {
       /* Return the byte that starts to differ */
-      while (*ref++ == x) ip++;
-      return ip;
+      return ip + blosclz_ctz(mask);
     }
     else {
       ip += sizeof(__m128i);
@@ -118,7 +151,7 @@ uint8_t *get_run_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
 
 static uint8_t *get_run(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
   uint8_t x = ip[-1];
-  int64_t value, value2;
+  uint64_t value, value2;
   /* Broadcast the value for every byte in a 64-bit register */
   memset(&value, x, 8);
   /* safe because the outer check against ip limit */
@@ -126,12 +159,16 @@ static uint8_t *get_run(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref
 #if defined(BLOSC_STRICT_ALIGN)
     memcpy(&value2, ref, 8);
 #else
-    value2 = ((int64_t*)ref)[0];
+    value2 = ((uint64_t*)ref)[0];
 #endif
     if (value != value2) {
       /* Return the byte that starts to differ */
+#if BLOSCLZ_LITTLE_ENDIAN
+      return ip + blosclz_ctz(value ^ value2) / 8;
+#else
       while (*ref++ == x) ip++;
       return ip;
+#endif
     }
     else {
       ip += 8;
@@ -144,14 +181,20 @@ static uint8_t *get_run(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref
 }
 
 
+#if !defined(BLOSC_AVX2_BUILD)
 /* Return the byte that starts to differ */
 uint8_t *get_match(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
 #if !defined(BLOSC_STRICT_ALIGN)
   while (ip < (ip_bound - sizeof(int64_t))) {
-    if (*(int64_t*)ref != *(int64_t*)ip) {
+    uint64_t diff = *(uint64_t*)ref ^ *(uint64_t*)ip;
+    if (diff != 0) {
       /* Return the byte that starts to differ */
+#if BLOSCLZ_LITTLE_ENDIAN
+      return ip + blosclz_ctz(diff) / 8 + 1;
+#else
       while (*ref++ == *ip++) {}
       return ip;
+#endif
     }
     else {
       ip += sizeof(int64_t);
@@ -163,6 +206,7 @@ uint8_t *get_match(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
   while ((ip < ip_bound) && (*ref++ == *ip++)) {}
   return ip;
 }
+#endif  // !BLOSC_AVX2_BUILD
 
 
 #if defined(__SSE2__)
@@ -172,11 +216,11 @@ static uint8_t *get_match_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t
   while (ip < (ip_bound - sizeof(__m128i))) {
     value = _mm_loadu_si128((__m128i *) ip);
     value2 = _mm_loadu_si128((__m128i *) ref);
-    cmp = _mm_cmpeq_epi32(value, value2);
-    if (_mm_movemask_epi8(cmp) != 0xFFFF) {
+    cmp = _mm_cmpeq_epi8(value, value2);
+    unsigned mask = (unsigned)_mm_movemask_epi8(cmp) ^ 0xFFFFU;
+    if (mask != 0) {
       /* Return the byte that starts to differ */
-      while (*ref++ == *ip++) {}
-      return ip;
+      return ip + blosclz_ctz(mask) + 1;
     }
     else {
       ip += sizeof(__m128i);
@@ -190,22 +234,43 @@ static uint8_t *get_match_16(uint8_t *ip, const uint8_t *ip_bound, const uint8_t
 #endif
 
 
-#if defined(__AVX2__)
-static uint8_t *get_match_32(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+#if defined(__ARM_NEON) && defined(__aarch64__)
+static uint8_t *get_match_neon(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
 
-  while (ip < (ip_bound - sizeof(__m256i))) {
-    __m256i value, value2, cmp;
-    value = _mm256_loadu_si256((__m256i *) ip);
-    value2 = _mm256_loadu_si256((__m256i *)ref);
-    cmp = _mm256_cmpeq_epi64(value, value2);
-    if ((unsigned)_mm256_movemask_epi8(cmp) != 0xFFFFFFFF) {
+  while (ip < (ip_bound - sizeof(uint8x16_t))) {
+    uint8x16_t cmp = vceqq_u8(vld1q_u8(ip), vld1q_u8(ref));
+    /* Narrow the comparison to 4 bits per byte, as NEON lacks a movemask */
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+    uint64_t mask = ~vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+    if (mask != 0) {
       /* Return the byte that starts to differ */
-      while (*ref++ == *ip++) {}
-      return ip;
+      return ip + blosclz_ctz(mask) / 4 + 1;
+    }
+    else {
+      ip += sizeof(uint8x16_t);
+      ref += sizeof(uint8x16_t);
+    }
+  }
+  /* Look into the remainder */
+  while ((ip < ip_bound) && (*ref++ == *ip++)) {}
+  return ip;
+}
+#endif
+
+
+#if defined(__wasm_simd128__)
+static uint8_t *get_match_wasm(uint8_t *ip, const uint8_t *ip_bound, const uint8_t *ref) {
+
+  while (ip < (ip_bound - sizeof(v128_t))) {
+    v128_t cmp = wasm_i8x16_eq(wasm_v128_load(ip), wasm_v128_load(ref));
+    unsigned mask = (unsigned)wasm_i8x16_bitmask(cmp) ^ 0xFFFFU;
+    if (mask != 0) {
+      /* Return the byte that starts to differ */
+      return ip + blosclz_ctz(mask) + 1;
     }
     else {
-      ip += sizeof(__m256i);
-      ref += sizeof(__m256i);
+      ip += sizeof(v128_t);
+      ref += sizeof(v128_t);
     }
   }
   /* Look into the remainder */
@@ -215,27 +280,39 @@ static uint8_t *get_match_32(uint8_t *ip, const uint8_t *ip_bound, const uint8_t
 #endif
 
 
+/* Return the byte that starts to differ for a match that starts in the dictionary,
+ * and that can go on at the beginning of the input */
+static uint8_t* get_dict_match(uint8_t* ip, const uint8_t* ip_bound, const uint8_t* ref,
+                               const uint8_t* dict_end, const uint8_t* ibase) {
+  while ((ip < ip_bound) && (ref < dict_end) && (*ref == *ip)) {
+    ip++;
+    ref++;
+  }
+  if (ref == dict_end) {
+    ref = ibase;
+    while ((ip < ip_bound) && (*ref == *ip)) {
+      ip++;
+      ref++;
+    }
+  }
+  /* Mimic get_match(), which returns one byte past the differing one */
+  return (ip < ip_bound) ? ip + 1 : ip;
+}
+
+
 static uint8_t* get_run_or_match(uint8_t* ip, uint8_t* ip_bound, const uint8_t* ref, bool run) {
   if (BLOSCLZ_UNLIKELY(run)) {
-#if defined(__AVX2__)
-    // Extensive experiments on AMD Ryzen3 say that regular get_run is faster
-    // ip = get_run_32(ip, ip_bound, ref);
-    ip = get_run(ip, ip_bound, ref);
-#elif defined(__SSE2__)
-    // Extensive experiments on AMD Ryzen3 say that regular get_run is faster
-    // ip = get_run_16(ip, ip_bound, ref);
-    ip = get_run(ip, ip_bound, ref);
-#else
+    // Extensive experiments on AMD Ryzen3 say that regular get_run is faster than the SIMD ones
     ip = get_run(ip, ip_bound, ref);
-#endif
   }
   else {
-#if defined(__AVX2__)
-    // Extensive experiments on AMD Ryzen3 say that regular get_match_16 is faster
-    // ip = get_match_32(ip, ip_bound, ref);
-    ip = get_match_16(ip, ip_bound, ref);
-#elif defined(__SSE2__)
+#if defined(__SSE2__)
+    // Extensive experiments on AMD Ryzen3 say that get_match_16 is faster than a 32-byte one for AVX2
     ip = get_match_16(ip, ip_bound, ref);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    ip = get_match_neon(ip, ip_bound, ref);
+#elif defined(__wasm_simd128__)
+    ip = get_match_wasm(ip, ip_bound, ref);
 #else
     ip = get_match(ip, ip_bound, ref);
 #endif
@@ -419,11 +496,21 @@ static double get_cratio(uint8_t* ibase, int maxlen, int minlen, int ipshift, ui
 }
 
 
-int blosclz_compress(const int clevel, const void* input, int length,
-                     void* output, int maxout, blosc2_context* ctx) {
-  BLOSC_UNUSED_PARAM(ctx);
+static uint8_t get_hashlog(int clevel) {
+  const uint8_t hashlog_[10] = {0, HASH_LOG - 1, HASH_LOG - 1, HASH_LOG, HASH_LOG,
+                                HASH_LOG, HASH_LOG, HASH_LOG, HASH_LOG, HASH_LOG};
+  return hashlog_[clevel];
+}
+
+
+/* The compressor, specialized for compressing with or without a dictionary (cdict) */
+BLOSCLZ_FORCE_INLINE int compress_(const int clevel, const void* input, int length,
+                                   void* output, int maxout, const blosclz_cdict* cdict) {
   uint8_t* ibase = (uint8_t*)input;
   uint32_t htab[1U << (uint8_t)HASH_LOG];
+  /* The positions in the hash table start at the tail of the dictionary, if any */
+  const uint32_t dict_len = (cdict != NULL) ? cdict->tail_len : 0;
+  const uint8_t* dict = (cdict != NULL) ? cdict->tail : NULL;
 
   /* When we go back in a match (shift), we obtain quite different compression properties.
    * It looks like 4 is more useful in combination with bitshuffle and small typesizes
@@ -438,9 +525,7 @@ int blosclz_compress(const int clevel, const void* input, int length,
   // Minimum lengths for encoding (normally it is good to match the shift value)
   unsigned minlen = 3;
 
-  uint8_t hashlog_[10] = {0, HASH_LOG - 1, HASH_LOG - 1, HASH_LOG, HASH_LOG,
-                          HASH_LOG, HASH_LOG, HASH_LOG, HASH_LOG, HASH_LOG};
-  uint8_t hashlog = hashlog_[clevel];
+  uint8_t hashlog = (cdict != NULL) ? cdict->hashlog : get_hashlog(clevel);
 
   // Experiments say that checking 1/4 of the buffer is enough to figure out approx cratio
   // UPDATE: new experiments with ERA5 datasets (float32) say that checking the whole buffer
@@ -458,12 +543,14 @@ int blosclz_compress(const int clevel, const void* input, int length,
   }
   // Start probing somewhere inside the buffer
   int shift = length - maxlen;
-  // Actual entropy probing!
-  double cratio = get_cratio(ibase + shift, maxlen, minlen, ipshift, htab, hashlog);
-  // discard probes with small compression ratios (too expensive)
-  double cratio_[10] = {0, 2, 1.5, 1.2, 1.2, 1.2, 1.2, 1.15, 1.1, 1.0};
-  if (cratio < cratio_[clevel]) {
+  // Actual entropy probing!  Not with dictionaries, as the input alone says little then.
+  if (cdict == NULL) {
+    double cratio = get_cratio(ibase + shift, maxlen, minlen, ipshift, htab, hashlog);
+    // discard probes with small compression ratios (too expensive)
+    double cratio_[10] = {0, 2, 1.5, 1.2, 1.2, 1.2, 1.2, 1.15, 1.1, 1.0};
+    if (cratio < cratio_[clevel]) {
       goto out;
+    }
   }
 
   uint8_t* ip = ibase;
@@ -481,7 +568,12 @@ int blosclz_compress(const int clevel, const void* input, int length,
   }
 
   // Initialize the hash table
-  memset(htab, 0, (1U << hashlog) * sizeof(uint32_t));
+  if (cdict != NULL) {
+    memcpy(htab, cdict->htab, (1U << hashlog) * sizeof(uint32_t));
+  }
+  else {
+    memset(htab, 0, (1U << hashlog) * sizeof(uint32_t));
+  }
 
   /* we start with literal copy */
   copy = 4;
@@ -500,13 +592,15 @@ int blosclz_compress(const int clevel, const void* input, int length,
     /* find potential match */
     seq = BLOSCLZ_READU32(ip);
     HASH_FUNCTION(hval, seq, hashlog)
-    ref = ibase + htab[hval];
+    uint32_t pos = htab[hval];
+    bool in_dict = pos < dict_len;
+    ref = in_dict ? dict + pos : ibase + (pos - dict_len);
 
     /* calculate distance to the match */
-    distance = (unsigned int)(anchor - ref);
+    distance = (unsigned int)(anchor - ibase) + dict_len - pos;
 
     /* update hash table */
-    htab[hval] = (uint32_t) (anchor - ibase);
+    htab[hval] = (uint32_t) (anchor - ibase) + dict_len;
 
     if (distance == 0 || (distance >= MAX_FARDISTANCE)) {
       LITERAL(ip, op, op_limit, anchor, copy)
@@ -529,7 +623,12 @@ int blosclz_compress(const int clevel, const void* input, int length,
     distance--;
 
     /* get runs or matches; zero distance means a run */
-    ip = get_run_or_match(ip, ip_bound, ref, !distance);
+    if (in_dict) {
+      ip = get_dict_match(ip, ip_bound, ref, dict + dict_len, ibase);
+    }
+    else {
+      ip = get_run_or_match(ip, ip_bound, ref, !distance);
+    }
 
     /* length is biased, '1' means a match of 3 bytes */
     ip -= ipshift;
@@ -572,13 +671,13 @@ int blosclz_compress(const int clevel, const void* input, int length,
     /* update the hash at match boundary */
     seq = BLOSCLZ_READU32(ip);
     HASH_FUNCTION(hval, seq, hashlog)
-    htab[hval] = (uint32_t) (ip++ - ibase);
+    htab[hval] = (uint32_t) (ip++ - ibase) + dict_len;
     if (clevel == 9) {
       // In some situations, including a second hash proves to be useful,
       // but not in others.  Activating here in max clevel only.
       seq >>= 8U;
       HASH_FUNCTION(hval, seq, hashlog)
-      htab[hval] = (uint32_t) (ip++ - ibase);
+      htab[hval] = (uint32_t) (ip++ - ibase) + dict_len;
     }
     else {
       ip++;
@@ -591,11 +690,17 @@ int blosclz_compress(const int clevel, const void* input, int length,
     *op++ = MAX_COPY - 1;
   }
 
-  /* left-over as literal copy */
+  /* left-over as literal copy, in runs that fill the current literal */
   while (BLOSCLZ_UNLIKELY(ip <= ip_bound)) {
-    if (BLOSCLZ_UNLIKELY(op + 2 > op_limit)) goto out;
-    *op++ = *ip++;
-    copy++;
+    unsigned nlit = MAX_COPY - copy;
+    if (nlit > (unsigned)(ip_bound - ip) + 1) {
+      nlit = (unsigned)(ip_bound - ip) + 1;
+    }
+    if (BLOSCLZ_UNLIKELY(op + nlit + 1 > op_limit)) goto out;
+    memcpy(op, ip, nlit);
+    op += nlit;
+    ip += nlit;
+    copy += nlit;
     if (BLOSCLZ_UNLIKELY(copy == MAX_COPY)) {
       copy = 0;
       *op++ = MAX_COPY - 1;
@@ -617,60 +722,54 @@ int blosclz_compress(const int clevel, const void* input, int length,
   return 0;
 }
 
-// See https://habr.com/en/company/yandex/blog/457612/
-#if defined(__AVX2__)
-
-#if defined(_MSC_VER)
-#define ALIGNED_(x) __declspec(align(x))
-#else
-#if defined(__GNUC__)
-#define ALIGNED_(x) __attribute__ ((aligned(x)))
-#endif
+int blosclz_compress(const int clevel, const void* input, int length,
+                     void* output, int maxout, blosc2_context* ctx) {
+#if defined(BLOSCLZ_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    return blosclz_compress_avx2(clevel, input, length, output, maxout, ctx);
+  }
 #endif
-#define ALIGNED_TYPE_(t, x) t ALIGNED_(x)
-
-static unsigned char* copy_match_16(unsigned char *op, const unsigned char *match, int32_t len)
-{
-  size_t offset = op - match;
-  while (len >= 16) {
-
-    static const ALIGNED_TYPE_(uint8_t, 16) masks[] =
-      {
-                0,  1,  2,  1,  4,  1,  4,  2,  8,  7,  6,  5,  4,  3,  2,  1, // offset = 0, not used as mask, but for shift
-                0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, // offset = 1
-                0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,  0,  1,
-                0,  1,  2,  0,  1,  2,  0,  1,  2,  0,  1,  2,  0,  1,  2,  0,
-                0,  1,  2,  3,  0,  1,  2,  3,  0,  1,  2,  3,  0,  1,  2,  3,
-                0,  1,  2,  3,  4,  0,  1,  2,  3,  4,  0,  1,  2,  3,  4,  0,
-                0,  1,  2,  3,  4,  5,  0,  1,  2,  3,  4,  5,  0,  1,  2,  3,
-                0,  1,  2,  3,  4,  5,  6,  0,  1,  2,  3,  4,  5,  6,  0,  1,
-                0,  1,  2,  3,  4,  5,  6,  7,  0,  1,  2,  3,  4,  5,  6,  7,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  0,  1,  2,  3,  4,  5,  6,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  0,  1,  2,  3,  4,  5,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10,  0,  1,  2,  3,  4,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11,  0,  1,  2,  3,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12,  0,  1,  2,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13,  0,  1,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  0,
-                0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,  15, // offset = 16
-      };
-
-    _mm_storeu_si128((__m128i *)(op),
-                     _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(match)),
-                                      _mm_load_si128((const __m128i *)(masks) + offset)));
-
-    match += masks[offset];
-
-    op += 16;
-    len -= 16;
+  if (ctx != NULL && ctx->use_dict && ctx->dict_cdict != NULL) {
+    return compress_(clevel, input, length, output, maxout, (const blosclz_cdict*)ctx->dict_cdict);
   }
-  // Deal with remainders
-  for (; len > 0; len--) {
-    *op++ = *match++;
+  return compress_(clevel, input, length, output, maxout, NULL);
+}
+
+
+#if !defined(BLOSC_AVX2_BUILD)
+void* blosclz_create_cdict(int clevel, const void* dict, int dict_size) {
+  if (clevel < 1 || clevel > 9 || dict_size < 16) {
+    return NULL;
   }
-  return op;
+  blosclz_cdict* cdict = malloc(sizeof(blosclz_cdict));
+  if (cdict == NULL) {
+    return NULL;
+  }
+  /* Farther bytes cannot be reached by matches */
+  cdict->tail_len = (dict_size < MAX_FARDISTANCE) ? (uint32_t)dict_size : MAX_FARDISTANCE;
+  cdict->tail = (const uint8_t*)dict + dict_size - cdict->tail_len;
+  cdict->hashlog = get_hashlog(clevel);
+  memset(cdict->htab, 0, (1U << cdict->hashlog) * sizeof(uint32_t));
+  /* Only positions with 4 bytes ahead in the dictionary, as these are checked for matches */
+  for (uint32_t i = 0; i + 4 <= cdict->tail_len; i++) {
+    uint32_t seq = BLOSCLZ_READU32(cdict->tail + i);
+    uint32_t hval;
+    HASH_FUNCTION(hval, seq, cdict->hashlog)
+    cdict->htab[hval] = i;
+  }
+  return cdict;
 }
-#endif
+
+
+void blosclz_free_cdict(void* cdict) {
+  free(cdict);
+}
+
+
+int blosclz_sizeof_cdict(void) {
+  return (int)sizeof(blosclz_cdict);
+}
+#endif  // !BLOSC_AVX2_BUILD
 
 // LZ4 wildCopy which can reach excellent copy bandwidth (even if insecure)
 static inline void wild_copy(uint8_t *out, const uint8_t* from, uint8_t* end) {
@@ -681,7 +780,22 @@ static inline void wild_copy(uint8_t *out, const uint8_t* from, uint8_t* end) {
   do { memcpy(d,s,8); d+=8; s+=8; } while (d<e);
 }
 
-int blosclz_decompress(const void* input, int length, void* output, int maxout) {
+/* Copy a match that starts in the dictionary, and that can go on at the beginning of the output */
+static uint8_t* copy_dict_match(uint8_t* op, const uint8_t* ref, int32_t len, const uint8_t* output,
+                                const uint8_t* dict, int32_t dict_size) {
+  int32_t nback = (int32_t)(output - ref);
+  int32_t ndict = (len < nback) ? len : nback;
+  memcpy(op, dict + dict_size - nback, (size_t)ndict);
+  op += ndict;
+  if (len > ndict) {
+    op = copy_match(op, output, (unsigned)(len - ndict));
+  }
+  return op;
+}
+
+/* The decompressor, specialized for decompressing with or without a dictionary */
+BLOSCLZ_FORCE_INLINE int decompress_(const void* input, int length, void* output, int maxout,
+                                     const uint8_t* dict, int32_t dict_size) {
   const uint8_t* ip = (const uint8_t*)input;
   const uint8_t* ip_limit = ip + length;
   uint8_t* op = (uint8_t*)output;
@@ -734,7 +848,7 @@ int blosclz_decompress(const void* input, int length, void* output, int maxout)
         return 0;
       }
 
-      if (BLOSCLZ_UNLIKELY(ref - 1 < (uint8_t*)output)) {
+      if (BLOSCLZ_UNLIKELY(ref - 1 < (uint8_t*)output - dict_size)) {
         return 0;
       }
 
@@ -742,7 +856,10 @@ int blosclz_decompress(const void* input, int length, void* output, int maxout)
       ctrl = *ip++;
 
       ref--;
-      if (ref == op - 1) {
+      if (dict_size > 0 && BLOSCLZ_UNLIKELY(ref < (uint8_t*)output)) {
+        op = copy_dict_match(op, ref, len, output, dict, dict_size);
+      }
+      else if (ref == op - 1) {
         /* optimized copy for a run */
         memset(op, *ref, len);
         op += len;
@@ -754,18 +871,7 @@ int blosclz_decompress(const void* input, int length, void* output, int maxout)
       }
       else {
         // general copy with any overlap
-#if 0 && defined(__AVX2__)
-        if (op - ref <= 16) {
-          // This is not faster on a combination of compilers (clang, gcc, icc) or machines, but
-          // it is not too slower either.
-          op = copy_match_16(op, ref, len);
-        }
-        else {
-#endif
-          op = copy_match(op, ref, (unsigned) len);
-#if 0 && defined(__AVX2__)
-        }
-#endif
+        op = copy_match(op, ref, (unsigned) len);
       }
     }
     else {
@@ -778,7 +884,15 @@ int blosclz_decompress(const void* input, int length, void* output, int maxout)
         return 0;
       }
 
-      memcpy(op, ip, ctrl); op += ctrl; ip += ctrl;
+      if (BLOSCLZ_LIKELY(op_limit - op >= MAX_COPY && ip_limit - ip >= MAX_COPY)) {
+        // Literals are MAX_COPY bytes at most, so a fixed-size copy avoids the length dispatch
+        // of memcpy; the bytes past ctrl are overwritten by what comes next
+        memcpy(op, ip, MAX_COPY);
+      }
+      else {
+        memcpy(op, ip, ctrl);
+      }
+      op += ctrl; ip += ctrl;
       // On GCC-6, fastcopy this is still faster than plain memcpy
       // However, using recent CLANG/LLVM 9.0, there is almost no difference
       // in performance.
@@ -792,3 +906,24 @@ int blosclz_decompress(const void* input, int length, void* output, int maxout)
 
   return (int)(op - (uint8_t*)output);
 }
+
+
+int blosclz_decompress(const void* input, int length, void* output, int maxout) {
+#if defined(BLOSCLZ_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    return blosclz_decompress_avx2(input, length, output, maxout);
+  }
+#endif
+  return decompress_(input, length, output, maxout, NULL, 0);
+}
+
+
+int blosclz_decompress_dict(const void* input, int length, void* output, int maxout,
+                            const void* dict, int dict_size) {
+#if defined(BLOSCLZ_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    return blosclz_decompress_dict_avx2(input, length, output, maxout, dict, dict_size);
+  }
+#endif
+  return decompress_(input, length, output, maxout, (const uint8_t*)dict, dict_size);
+}
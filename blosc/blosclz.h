@@ -21,6 +21,14 @@
 
 #define BLOSCLZ_VERSION_STRING "2.5.3"
 
+/* blosclz-avx2.c builds blosclz.c again for AVX2, with these names (the dictionaries
+   are digested by the baseline build only, as the digest is the same) */
+#if defined(BLOSC_AVX2_BUILD)
+#define blosclz_compress blosclz_compress_avx2
+#define blosclz_decompress blosclz_decompress_avx2
+#define blosclz_decompress_dict blosclz_decompress_dict_avx2
+#endif
+
 /**
   Compress a block of data in the input buffer and returns the size of
   compressed block. The size of input buffer is specified by
@@ -44,6 +52,30 @@
 int blosclz_compress(int opt_level, const void* input, int length,
                      void* output, int maxout, blosc2_context* ctx);
 
+/**
+  Digest a dictionary for compressing blocks with it.  The dictionary is used
+  when ctx->use_dict is set and ctx->dict_cdict is the digested form returned
+  by this function; it is referenced, not copied, so it has to outlive the
+  digested form.
+
+  Returns NULL if the dictionary is too small (less than 16 bytes), or if
+  memory cannot be allocated.
+*/
+
+void* blosclz_create_cdict(int opt_level, const void* dict, int dict_size);
+
+/**
+  Free the digested form of a dictionary.
+*/
+
+void blosclz_free_cdict(void* cdict);
+
+/**
+  The size in bytes of the digested form of a dictionary.
+*/
+
+int blosclz_sizeof_cdict(void);
+
 /**
   Decompress a block of compressed data and returns the size of the
   decompressed block. If error occurs, e.g. the compressed data is
@@ -58,4 +90,23 @@ int blosclz_compress(int opt_level, const void* input, int length,
 
 int blosclz_decompress(const void* input, int length, void* output, int maxout);
 
+/**
+  Decompress a block of data that has been compressed with a dictionary.
+  This is the same as blosclz_decompress(), but matches can reach the
+  dictionary, which logically precedes the output buffer.
+ */
+
+int blosclz_decompress_dict(const void* input, int length, void* output, int maxout,
+                            const void* dict, int dict_size);
+
+#if defined(BLOSCLZ_AVX2_ENABLED)
+int blosclz_compress_avx2(int opt_level, const void* input, int length,
+                          void* output, int maxout, blosc2_context* ctx);
+
+int blosclz_decompress_avx2(const void* input, int length, void* output, int maxout);
+
+int blosclz_decompress_dict_avx2(const void* input, int length, void* output, int maxout,
+                                 const void* dict, int dict_size);
+#endif
+
 #endif /* BLOSC_BLOSCLZ_H */
@@ -0,0 +1,34 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "checksum.h"
+#include "blosc-private.h"
+
+/* The xxHash that is vendored for the NDLZ codec, which picks the widest SIMD unit
+ * (SSE2, AVX2, AVX512 or NEON) that the compiler can target */
+#define XXH_INLINE_ALL
+#include "../plugins/codecs/ndlz/xxhash.h"
+
+
+uint64_t checksum_xxh3(const void* src, size_t nbytes) {
+  return XXH3_64bits(src, nbytes);
+}
+
+
+void checksum_store(uint8_t* dest, uint64_t checksum) {
+  to_little(dest, &checksum, sizeof(checksum));
+}
+
+
+uint64_t checksum_load(const uint8_t* src) {
+  uint64_t checksum;
+  from_little(&checksum, src, sizeof(checksum));
+  return checksum;
+}
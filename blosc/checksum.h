@@ -0,0 +1,26 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_CHECKSUM_H
+#define BLOSC_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The 64-bit XXH3 hash of the `nbytes` of `src` (BLOSC2_CHECKSUM_XXH3) */
+uint64_t checksum_xxh3(const void* src, size_t nbytes);
+
+/* Store `checksum` in the BLOSC2_CHECKSUM_SIZE bytes of `dest` (little endian, as the chunks) */
+void checksum_store(uint8_t* dest, uint64_t checksum);
+
+/* The checksum stored in the BLOSC2_CHECKSUM_SIZE bytes of `src` */
+uint64_t checksum_load(const uint8_t* src);
+
+#endif /* BLOSC_CHECKSUM_H */
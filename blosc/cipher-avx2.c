@@ -0,0 +1,80 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "cipher-avx2.h"
+
+/* Make sure AVX2 is available for the compilation target and compiler. */
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+#define ROTL_AVX2(x, n) _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - (n)))
+
+/* The rotations by whole bytes are byte shuffles */
+#define QUARTER_ROUND_AVX2(a, b, c, d) \
+  a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = _mm256_shuffle_epi8(d, rot16); \
+  c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = ROTL_AVX2(b, 12);              \
+  a = _mm256_add_epi32(a, b); d = _mm256_xor_si256(d, a); d = _mm256_shuffle_epi8(d, rot8);  \
+  c = _mm256_add_epi32(c, d); b = _mm256_xor_si256(b, c); b = ROTL_AVX2(b, 7);
+
+
+size_t chacha20_xor_avx2(uint32_t* state, const uint8_t* src, uint8_t* dest, size_t nbytes) {
+  const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                         2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+  const __m256i rot8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+  size_t done = 0;
+  for (; done + 512 <= nbytes; done += 512) {
+    // Every vector keeps a word of the 8 states, blocks 0 to 3 in the low lane and 4 to 7 in the high one
+    __m256i in[16], x[16];
+    for (int i = 0; i < 16; i++) {
+      in[i] = _mm256_set1_epi32((int) state[i]);
+    }
+    in[12] = _mm256_add_epi32(in[12], _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    for (int i = 0; i < 16; i++) {
+      x[i] = in[i];
+    }
+    for (int i = 0; i < 10; i++) {
+      QUARTER_ROUND_AVX2(x[0], x[4], x[8], x[12])
+      QUARTER_ROUND_AVX2(x[1], x[5], x[9], x[13])
+      QUARTER_ROUND_AVX2(x[2], x[6], x[10], x[14])
+      QUARTER_ROUND_AVX2(x[3], x[7], x[11], x[15])
+      QUARTER_ROUND_AVX2(x[0], x[5], x[10], x[15])
+      QUARTER_ROUND_AVX2(x[1], x[6], x[11], x[12])
+      QUARTER_ROUND_AVX2(x[2], x[7], x[8], x[13])
+      QUARTER_ROUND_AVX2(x[3], x[4], x[9], x[14])
+    }
+    // Transpose every 4 words of the 8 blocks into 16 bytes of every block, in both lanes
+    for (int i = 0; i < 16; i += 4) {
+      __m256i a = _mm256_add_epi32(x[i], in[i]);
+      __m256i b = _mm256_add_epi32(x[i + 1], in[i + 1]);
+      __m256i c = _mm256_add_epi32(x[i + 2], in[i + 2]);
+      __m256i d = _mm256_add_epi32(x[i + 3], in[i + 3]);
+      __m256i ab_lo = _mm256_unpacklo_epi32(a, b);
+      __m256i cd_lo = _mm256_unpacklo_epi32(c, d);
+      __m256i ab_hi = _mm256_unpackhi_epi32(a, b);
+      __m256i cd_hi = _mm256_unpackhi_epi32(c, d);
+      __m256i words[4] = {_mm256_unpacklo_epi64(ab_lo, cd_lo), _mm256_unpackhi_epi64(ab_lo, cd_lo),
+                          _mm256_unpacklo_epi64(ab_hi, cd_hi), _mm256_unpackhi_epi64(ab_hi, cd_hi)};
+      for (int j = 0; j < 4; j++) {
+        size_t lo = done + j * 64 + i * 4;
+        size_t hi = lo + 4 * 64;
+        __m128i text_lo = _mm_loadu_si128((const __m128i*) (src + lo));
+        __m128i text_hi = _mm_loadu_si128((const __m128i*) (src + hi));
+        _mm_storeu_si128((__m128i*) (dest + lo), _mm_xor_si128(text_lo, _mm256_castsi256_si128(words[j])));
+        _mm_storeu_si128((__m128i*) (dest + hi), _mm_xor_si128(text_hi, _mm256_extracti128_si256(words[j], 1)));
+      }
+    }
+    state[12] += 8;
+  }
+  return done;
+}
+
+#endif /* defined(__AVX2__) */
@@ -0,0 +1,28 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX2-accelerated ChaCha20 for the ciphers of the blocks. */
+
+#ifndef BLOSC_CIPHER_AVX2_H
+#define BLOSC_CIPHER_AVX2_H
+
+#include "blosc2/blosc2-common.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+  Xor the ChaCha20 keystream from the 16 words of `state` (whose block
+  counter is advanced) into `src`, 8 blocks of 64 bytes at a time, up to the
+  last multiple of 512 of `nbytes`.  Returns the number of bytes done.
+*/
+BLOSC_NO_EXPORT size_t chacha20_xor_avx2(uint32_t* state, const uint8_t* src, uint8_t* dest, size_t nbytes);
+
+#endif /* BLOSC_CIPHER_AVX2_H */
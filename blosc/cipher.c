@@ -0,0 +1,554 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* The ChaCha20-Poly1305 AEAD of RFC 8439 for the blocks of the chunks.  ChaCha20 is made
+ * of additions, xors and rotations only, so it runs several blocks at once in the vector
+ * units (4 with SSE2 or NEON, 8 with AVX2 when the host processor supports it) without the
+ * tables (nor the timing leaks) of the software fallbacks of AES.  Poly1305 is computed in
+ * 44-bit limbs when the compiler has 128-bit integers, and in 26-bit ones otherwise. */
+
+#if defined(_WIN32)
+/* For rand_s(), which has to be asked for before any include of stdlib.h */
+#define _CRT_RAND_S
+#endif
+
+#include "cipher.h"
+#include "shuffle.h"
+#if defined(CIPHER_AVX2_ENABLED)
+#include "cipher-avx2.h"
+#endif
+#include "blosc2.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CIPHER_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__) && !defined(__ARM_BIG_ENDIAN)
+#include <arm_neon.h>
+#define CIPHER_NEON
+#endif
+
+
+static inline uint32_t load_le32(const uint8_t* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline void store_le32(uint8_t* p, uint32_t u) {
+  p[0] = (uint8_t) u;
+  p[1] = (uint8_t) (u >> 8);
+  p[2] = (uint8_t) (u >> 16);
+  p[3] = (uint8_t) (u >> 24);
+}
+
+static inline uint64_t load_le64(const uint8_t* p) {
+  return (uint64_t) load_le32(p) | (uint64_t) load_le32(p + 4) << 32;
+}
+
+static inline void store_le64(uint8_t* p, uint64_t u) {
+  store_le32(p, (uint32_t) u);
+  store_le32(p + 4, (uint32_t) (u >> 32));
+}
+
+
+/* ChaCha20 */
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+#define QUARTER_ROUND(a, b, c, d) \
+  a += b; d ^= a; d = ROTL32(d, 16); \
+  c += d; b ^= c; b = ROTL32(b, 12); \
+  a += b; d ^= a; d = ROTL32(d, 8);  \
+  c += d; b ^= c; b = ROTL32(b, 7);
+
+static void chacha20_init(uint32_t* state, const uint8_t* key, const uint8_t* nonce, uint32_t counter) {
+  // "expand 32-byte k"
+  state[0] = 0x61707865;
+  state[1] = 0x3320646e;
+  state[2] = 0x79622d32;
+  state[3] = 0x6b206574;
+  for (int i = 0; i < 8; i++) {
+    state[4 + i] = load_le32(key + 4 * i);
+  }
+  state[12] = counter;
+  for (int i = 0; i < 3; i++) {
+    state[13 + i] = load_le32(nonce + 4 * i);
+  }
+}
+
+/* The 64 bytes of the keystream for the block of the counter in state */
+static void chacha20_block(const uint32_t* state, uint8_t* out) {
+  uint32_t x[16];
+  memcpy(x, state, sizeof(x));
+  for (int i = 0; i < 10; i++) {
+    QUARTER_ROUND(x[0], x[4], x[8], x[12])
+    QUARTER_ROUND(x[1], x[5], x[9], x[13])
+    QUARTER_ROUND(x[2], x[6], x[10], x[14])
+    QUARTER_ROUND(x[3], x[7], x[11], x[15])
+    QUARTER_ROUND(x[0], x[5], x[10], x[15])
+    QUARTER_ROUND(x[1], x[6], x[11], x[12])
+    QUARTER_ROUND(x[2], x[7], x[8], x[13])
+    QUARTER_ROUND(x[3], x[4], x[9], x[14])
+  }
+  for (int i = 0; i < 16; i++) {
+    store_le32(out + 4 * i, x[i] + state[i]);
+  }
+}
+
+
+#if defined(CIPHER_SSE2)
+
+#define ROTL_SSE2(x, n) _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - (n)))
+#define QUARTER_ROUND_SSE2(a, b, c, d) \
+  a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL_SSE2(d, 16); \
+  c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL_SSE2(b, 12); \
+  a = _mm_add_epi32(a, b); d = _mm_xor_si128(d, a); d = ROTL_SSE2(d, 8);  \
+  c = _mm_add_epi32(c, d); b = _mm_xor_si128(b, c); b = ROTL_SSE2(b, 7);
+
+/* Xor the keystream of 4 blocks at a time, every vector keeping a word of the 4 states.
+   Returns the bytes done (a multiple of 256). */
+static size_t chacha20_xor_sse2(uint32_t* state, const uint8_t* src, uint8_t* dest, size_t nbytes) {
+  size_t done = 0;
+  for (; done + 256 <= nbytes; done += 256) {
+    __m128i in[16], x[16];
+    for (int i = 0; i < 16; i++) {
+      in[i] = _mm_set1_epi32((int) state[i]);
+    }
+    in[12] = _mm_add_epi32(in[12], _mm_setr_epi32(0, 1, 2, 3));
+    for (int i = 0; i < 16; i++) {
+      x[i] = in[i];
+    }
+    for (int i = 0; i < 10; i++) {
+      QUARTER_ROUND_SSE2(x[0], x[4], x[8], x[12])
+      QUARTER_ROUND_SSE2(x[1], x[5], x[9], x[13])
+      QUARTER_ROUND_SSE2(x[2], x[6], x[10], x[14])
+      QUARTER_ROUND_SSE2(x[3], x[7], x[11], x[15])
+      QUARTER_ROUND_SSE2(x[0], x[5], x[10], x[15])
+      QUARTER_ROUND_SSE2(x[1], x[6], x[11], x[12])
+      QUARTER_ROUND_SSE2(x[2], x[7], x[8], x[13])
+      QUARTER_ROUND_SSE2(x[3], x[4], x[9], x[14])
+    }
+    // Transpose every 4 words of the 4 blocks into 16 bytes of every block
+    for (int i = 0; i < 16; i += 4) {
+      __m128i a = _mm_add_epi32(x[i], in[i]);
+      __m128i b = _mm_add_epi32(x[i + 1], in[i + 1]);
+      __m128i c = _mm_add_epi32(x[i + 2], in[i + 2]);
+      __m128i d = _mm_add_epi32(x[i + 3], in[i + 3]);
+      __m128i ab_lo = _mm_unpacklo_epi32(a, b);
+      __m128i cd_lo = _mm_unpacklo_epi32(c, d);
+      __m128i ab_hi = _mm_unpackhi_epi32(a, b);
+      __m128i cd_hi = _mm_unpackhi_epi32(c, d);
+      __m128i words[4] = {_mm_unpacklo_epi64(ab_lo, cd_lo), _mm_unpackhi_epi64(ab_lo, cd_lo),
+                          _mm_unpacklo_epi64(ab_hi, cd_hi), _mm_unpackhi_epi64(ab_hi, cd_hi)};
+      for (int j = 0; j < 4; j++) {
+        size_t offset = done + j * 64 + i * 4;
+        __m128i text = _mm_loadu_si128((const __m128i*) (src + offset));
+        _mm_storeu_si128((__m128i*) (dest + offset), _mm_xor_si128(text, words[j]));
+      }
+    }
+    state[12] += 4;
+  }
+  return done;
+}
+
+#elif defined(CIPHER_NEON)
+
+#define ROTL_NEON(x, n) vsriq_n_u32(vshlq_n_u32(x, n), x, 32 - (n))
+#define QUARTER_ROUND_NEON(a, b, c, d) \
+  a = vaddq_u32(a, b); d = veorq_u32(d, a); d = ROTL_NEON(d, 16); \
+  c = vaddq_u32(c, d); b = veorq_u32(b, c); b = ROTL_NEON(b, 12); \
+  a = vaddq_u32(a, b); d = veorq_u32(d, a); d = ROTL_NEON(d, 8);  \
+  c = vaddq_u32(c, d); b = veorq_u32(b, c); b = ROTL_NEON(b, 7);
+
+/* Like chacha20_xor_sse2() */
+static size_t chacha20_xor_neon(uint32_t* state, const uint8_t* src, uint8_t* dest, size_t nbytes) {
+  static const uint32_t counters[4] = {0, 1, 2, 3};
+  size_t done = 0;
+  for (; done + 256 <= nbytes; done += 256) {
+    uint32x4_t in[16], x[16];
+    for (int i = 0; i < 16; i++) {
+      in[i] = vdupq_n_u32(state[i]);
+    }
+    in[12] = vaddq_u32(in[12], vld1q_u32(counters));
+    for (int i = 0; i < 16; i++) {
+      x[i] = in[i];
+    }
+    for (int i = 0; i < 10; i++) {
+      QUARTER_ROUND_NEON(x[0], x[4], x[8], x[12])
+      QUARTER_ROUND_NEON(x[1], x[5], x[9], x[13])
+      QUARTER_ROUND_NEON(x[2], x[6], x[10], x[14])
+      QUARTER_ROUND_NEON(x[3], x[7], x[11], x[15])
+      QUARTER_ROUND_NEON(x[0], x[5], x[10], x[15])
+      QUARTER_ROUND_NEON(x[1], x[6], x[11], x[12])
+      QUARTER_ROUND_NEON(x[2], x[7], x[8], x[13])
+      QUARTER_ROUND_NEON(x[3], x[4], x[9], x[14])
+    }
+    for (int i = 0; i < 16; i += 4) {
+      uint32x4x2_t ab = vtrnq_u32(vaddq_u32(x[i], in[i]), vaddq_u32(x[i + 1], in[i + 1]));
+      uint32x4x2_t cd = vtrnq_u32(vaddq_u32(x[i + 2], in[i + 2]), vaddq_u32(x[i + 3], in[i + 3]));
+      uint32x4_t words[4] = {vcombine_u32(vget_low_u32(ab.val[0]), vget_low_u32(cd.val[0])),
+                             vcombine_u32(vget_low_u32(ab.val[1]), vget_low_u32(cd.val[1])),
+                             vcombine_u32(vget_high_u32(ab.val[0]), vget_high_u32(cd.val[0])),
+                             vcombine_u32(vget_high_u32(ab.val[1]), vget_high_u32(cd.val[1]))};
+      for (int j = 0; j < 4; j++) {
+        size_t offset = done + j * 64 + i * 4;
+        vst1q_u8(dest + offset, veorq_u8(vld1q_u8(src + offset), vreinterpretq_u8_u32(words[j])));
+      }
+    }
+    state[12] += 4;
+  }
+  return done;
+}
+
+#endif
+
+
+/* Flag indicating whether the kernels have been chosen for the host processor */
+static int32_t implementation_initialized;
+#if defined(CIPHER_AVX2_ENABLED)
+static bool cipher_avx2;
+#endif
+
+/* Choose the widest kernel that the host processor supports, if not done yet.  As for the
+   shuffle, a concurrent initialization would just choose the same one on every thread. */
+static void init_cipher_implementation(void) {
+  if (implementation_initialized) {
+    return;
+  }
+#if defined(CIPHER_AVX2_ENABLED)
+  cipher_avx2 = (blosc_get_cpu_features() & BLOSC_HAVE_AVX2) != 0;
+#endif
+  implementation_initialized = 1;
+}
+
+/* Xor the keystream from the counter in state into the `nbytes` of `src` */
+static void chacha20_xor(uint32_t* state, const uint8_t* src, uint8_t* dest, size_t nbytes) {
+  size_t done = 0;
+  init_cipher_implementation();
+#if defined(CIPHER_AVX2_ENABLED)
+  if (cipher_avx2) {
+    done = chacha20_xor_avx2(state, src, dest, nbytes);
+  }
+#endif
+#if defined(CIPHER_SSE2)
+  done += chacha20_xor_sse2(state, src + done, dest + done, nbytes - done);
+#elif defined(CIPHER_NEON)
+  done += chacha20_xor_neon(state, src + done, dest + done, nbytes - done);
+#endif
+  uint8_t keystream[64];
+  for (; done < nbytes; done += 64) {
+    chacha20_block(state, keystream);
+    state[12]++;
+    size_t n = nbytes - done < 64 ? nbytes - done : 64;
+    for (size_t i = 0; i < n; i++) {
+      dest[done + i] = src[done + i] ^ keystream[i];
+    }
+  }
+}
+
+
+/* Poly1305 */
+
+#if defined(__SIZEOF_INT128__)
+
+typedef unsigned __int128 uint128_t;
+#define MASK44 0xfffffffffffull
+#define MASK42 0x3ffffffffffull
+
+typedef struct {
+  uint64_t r[3];
+  uint64_t h[3];
+  uint64_t pad[2];
+} poly1305_state;
+
+static void poly1305_init(poly1305_state* st, const uint8_t* key) {
+  uint64_t t0 = load_le64(key);
+  uint64_t t1 = load_le64(key + 8);
+  // r is clamped
+  st->r[0] = t0 & 0xffc0fffffffull;
+  st->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffull;
+  st->r[2] = (t1 >> 24) & 0x00ffffffc0full;
+  st->h[0] = st->h[1] = st->h[2] = 0;
+  st->pad[0] = load_le64(key + 16);
+  st->pad[1] = load_le64(key + 24);
+}
+
+/* Add the `nblocks` full blocks of 16 bytes of `m` */
+static void poly1305_blocks(poly1305_state* st, const uint8_t* m, size_t nblocks) {
+  uint64_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2];
+  uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+  uint64_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2];
+  for (size_t i = 0; i < nblocks; i++, m += 16) {
+    uint64_t t0 = load_le64(m);
+    uint64_t t1 = load_le64(m + 8);
+    h0 += t0 & MASK44;
+    h1 += ((t0 >> 44) | (t1 << 20)) & MASK44;
+    h2 += ((t1 >> 24) & MASK42) | ((uint64_t) 1 << 40);
+
+    uint128_t d0 = (uint128_t) h0 * r0 + (uint128_t) h1 * s2 + (uint128_t) h2 * s1;
+    uint128_t d1 = (uint128_t) h0 * r1 + (uint128_t) h1 * r0 + (uint128_t) h2 * s2;
+    uint128_t d2 = (uint128_t) h0 * r2 + (uint128_t) h1 * r1 + (uint128_t) h2 * r0;
+    uint64_t c = (uint64_t) (d0 >> 44);
+    h0 = (uint64_t) d0 & MASK44;
+    d1 += c;
+    c = (uint64_t) (d1 >> 44);
+    h1 = (uint64_t) d1 & MASK44;
+    d2 += c;
+    c = (uint64_t) (d2 >> 42);
+    h2 = (uint64_t) d2 & MASK42;
+    h0 += c * 5;
+    c = h0 >> 44;
+    h0 &= MASK44;
+    h1 += c;
+  }
+  st->h[0] = h0;
+  st->h[1] = h1;
+  st->h[2] = h2;
+}
+
+static void poly1305_finish(poly1305_state* st, uint8_t* mac) {
+  uint64_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2];
+  uint64_t c = h1 >> 44;
+  h1 &= MASK44;
+  h2 += c; c = h2 >> 42; h2 &= MASK42;
+  h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+  h1 += c; c = h1 >> 44; h1 &= MASK44;
+  h2 += c; c = h2 >> 42; h2 &= MASK42;
+  h0 += c * 5; c = h0 >> 44; h0 &= MASK44;
+  h1 += c;
+
+  // h - p, which is taken instead of h when it is not negative
+  uint64_t g0 = h0 + 5;
+  c = g0 >> 44;
+  g0 &= MASK44;
+  uint64_t g1 = h1 + c;
+  c = g1 >> 44;
+  g1 &= MASK44;
+  uint64_t g2 = h2 + c - ((uint64_t) 1 << 42);
+  c = (g2 >> 63) - 1;
+  h0 = (h0 & ~c) | (g0 & c);
+  h1 = (h1 & ~c) | (g1 & c);
+  h2 = (h2 & ~c) | (g2 & c);
+
+  // h + pad, modulo 2^128
+  uint64_t t0 = st->pad[0], t1 = st->pad[1];
+  h0 += t0 & MASK44;
+  c = h0 >> 44;
+  h0 &= MASK44;
+  h1 += (((t0 >> 44) | (t1 << 20)) & MASK44) + c;
+  c = h1 >> 44;
+  h1 &= MASK44;
+  h2 += ((t1 >> 24) & MASK42) + c;
+  h2 &= MASK42;
+  store_le64(mac, h0 | (h1 << 44));
+  store_le64(mac + 8, (h1 >> 20) | (h2 << 24));
+}
+
+#else
+
+#define MASK26 0x3ffffffu
+
+typedef struct {
+  uint32_t r[5];
+  uint32_t h[5];
+  uint32_t pad[4];
+} poly1305_state;
+
+static void poly1305_init(poly1305_state* st, const uint8_t* key) {
+  // r is clamped
+  st->r[0] = load_le32(key) & 0x3ffffff;
+  st->r[1] = (load_le32(key + 3) >> 2) & 0x3ffff03;
+  st->r[2] = (load_le32(key + 6) >> 4) & 0x3ffc0ff;
+  st->r[3] = (load_le32(key + 9) >> 6) & 0x3f03fff;
+  st->r[4] = (load_le32(key + 12) >> 8) & 0x00fffff;
+  for (int i = 0; i < 5; i++) {
+    st->h[i] = 0;
+  }
+  for (int i = 0; i < 4; i++) {
+    st->pad[i] = load_le32(key + 16 + 4 * i);
+  }
+}
+
+/* Add the `nblocks` full blocks of 16 bytes of `m` */
+static void poly1305_blocks(poly1305_state* st, const uint8_t* m, size_t nblocks) {
+  uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+  uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+  uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+  for (size_t i = 0; i < nblocks; i++, m += 16) {
+    h0 += load_le32(m) & MASK26;
+    h1 += (load_le32(m + 3) >> 2) & MASK26;
+    h2 += (load_le32(m + 6) >> 4) & MASK26;
+    h3 += (load_le32(m + 9) >> 6) & MASK26;
+    h4 += (load_le32(m + 12) >> 8) | (1u << 24);
+
+    uint64_t d0 = (uint64_t) h0 * r0 + (uint64_t) h1 * s4 + (uint64_t) h2 * s3 +
+                  (uint64_t) h3 * s2 + (uint64_t) h4 * s1;
+    uint64_t d1 = (uint64_t) h0 * r1 + (uint64_t) h1 * r0 + (uint64_t) h2 * s4 +
+                  (uint64_t) h3 * s3 + (uint64_t) h4 * s2;
+    uint64_t d2 = (uint64_t) h0 * r2 + (uint64_t) h1 * r1 + (uint64_t) h2 * r0 +
+                  (uint64_t) h3 * s4 + (uint64_t) h4 * s3;
+    uint64_t d3 = (uint64_t) h0 * r3 + (uint64_t) h1 * r2 + (uint64_t) h2 * r1 +
+                  (uint64_t) h3 * r0 + (uint64_t) h4 * s4;
+    uint64_t d4 = (uint64_t) h0 * r4 + (uint64_t) h1 * r3 + (uint64_t) h2 * r2 +
+                  (uint64_t) h3 * r1 + (uint64_t) h4 * r0;
+    uint32_t c = (uint32_t) (d0 >> 26);
+    h0 = (uint32_t) d0 & MASK26;
+    d1 += c; c = (uint32_t) (d1 >> 26); h1 = (uint32_t) d1 & MASK26;
+    d2 += c; c = (uint32_t) (d2 >> 26); h2 = (uint32_t) d2 & MASK26;
+    d3 += c; c = (uint32_t) (d3 >> 26); h3 = (uint32_t) d3 & MASK26;
+    d4 += c; c = (uint32_t) (d4 >> 26); h4 = (uint32_t) d4 & MASK26;
+    h0 += c * 5;
+    c = h0 >> 26;
+    h0 &= MASK26;
+    h1 += c;
+  }
+  st->h[0] = h0;
+  st->h[1] = h1;
+  st->h[2] = h2;
+  st->h[3] = h3;
+  st->h[4] = h4;
+}
+
+static void poly1305_finish(poly1305_state* st, uint8_t* mac) {
+  uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+  uint32_t c = h1 >> 26;
+  h1 &= MASK26;
+  h2 += c; c = h2 >> 26; h2 &= MASK26;
+  h3 += c; c = h3 >> 26; h3 &= MASK26;
+  h4 += c; c = h4 >> 26; h4 &= MASK26;
+  h0 += c * 5; c = h0 >> 26; h0 &= MASK26;
+  h1 += c;
+
+  // h - p, which is taken instead of h when it is not negative
+  uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= MASK26;
+  uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= MASK26;
+  uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= MASK26;
+  uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= MASK26;
+  uint32_t g4 = h4 + c - (1u << 26);
+  c = (g4 >> 31) - 1;
+  h0 = (h0 & ~c) | (g0 & c);
+  h1 = (h1 & ~c) | (g1 & c);
+  h2 = (h2 & ~c) | (g2 & c);
+  h3 = (h3 & ~c) | (g3 & c);
+  h4 = (h4 & ~c) | (g4 & c);
+
+  // h + pad, modulo 2^128
+  h0 = h0 | (h1 << 26);
+  h1 = (h1 >> 6) | (h2 << 20);
+  h2 = (h2 >> 12) | (h3 << 14);
+  h3 = (h3 >> 18) | (h4 << 8);
+  uint64_t f = (uint64_t) h0 + st->pad[0];
+  store_le32(mac, (uint32_t) f);
+  f = (uint64_t) h1 + st->pad[1] + (f >> 32);
+  store_le32(mac + 4, (uint32_t) f);
+  f = (uint64_t) h2 + st->pad[2] + (f >> 32);
+  store_le32(mac + 8, (uint32_t) f);
+  f = (uint64_t) h3 + st->pad[3] + (f >> 32);
+  store_le32(mac + 12, (uint32_t) f);
+}
+
+#endif
+
+/* Add the `nbytes` of `m`, padded with zeros up to a multiple of 16 bytes */
+static void poly1305_padded(poly1305_state* st, const uint8_t* m, size_t nbytes) {
+  poly1305_blocks(st, m, nbytes / 16);
+  size_t rest = nbytes % 16;
+  if (rest > 0) {
+    uint8_t block[16] = {0};
+    memcpy(block, m + nbytes - rest, rest);
+    poly1305_blocks(st, block, 1);
+  }
+}
+
+
+/* The tag of the ciphertext and the aad, with the one-time key of the first keystream block */
+static void aead_tag(const uint32_t* state, const uint8_t* aad, size_t aad_len,
+                     const uint8_t* ciphertext, size_t nbytes, uint8_t* tag) {
+  uint8_t block0[64];
+  chacha20_block(state, block0);
+  poly1305_state st;
+  poly1305_init(&st, block0);
+  poly1305_padded(&st, aad, aad_len);
+  poly1305_padded(&st, ciphertext, nbytes);
+  uint8_t lengths[16];
+  store_le64(lengths, (uint64_t) aad_len);
+  store_le64(lengths + 8, (uint64_t) nbytes);
+  poly1305_blocks(&st, lengths, 1);
+  poly1305_finish(&st, tag);
+  cipher_wipe(block0, sizeof(block0));
+  cipher_wipe(&st, sizeof(st));
+}
+
+
+void cipher_seal(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aad_len,
+                 uint8_t* buf, size_t nbytes, uint8_t* tag) {
+  uint32_t state[16];
+  chacha20_init(state, key, nonce, 1);
+  chacha20_xor(state, buf, buf, nbytes);
+  state[12] = 0;
+  aead_tag(state, aad, aad_len, buf, nbytes, tag);
+  cipher_wipe(state, sizeof(state));
+}
+
+
+int cipher_open(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aad_len,
+                const uint8_t* src, uint8_t* dest, size_t nbytes, const uint8_t* tag) {
+  uint32_t state[16];
+  uint8_t expected[BLOSC2_CIPHER_TAG_SIZE];
+  chacha20_init(state, key, nonce, 0);
+  aead_tag(state, aad, aad_len, src, nbytes, expected);
+  // Compare in constant time
+  uint8_t diff = 0;
+  for (int i = 0; i < BLOSC2_CIPHER_TAG_SIZE; i++) {
+    diff |= (uint8_t) (expected[i] ^ tag[i]);
+  }
+  if (diff != 0) {
+    cipher_wipe(state, sizeof(state));
+    return BLOSC2_ERROR_AUTHENTICATION;
+  }
+  state[12] = 1;
+  chacha20_xor(state, src, dest, nbytes);
+  cipher_wipe(state, sizeof(state));
+  return 0;
+}
+
+
+void cipher_wipe(void* buf, size_t nbytes) {
+  // Through a volatile pointer, so that it is not dropped as a dead store
+  volatile uint8_t* p = (volatile uint8_t*) buf;
+  for (size_t i = 0; i < nbytes; i++) {
+    p[i] = 0;
+  }
+}
+
+
+int cipher_random(uint8_t* dest, size_t nbytes) {
+#if defined(_WIN32)
+  for (size_t i = 0; i < nbytes; i += sizeof(unsigned int)) {
+    unsigned int value;
+    if (rand_s(&value) != 0) {
+      return BLOSC2_ERROR_FAILURE;
+    }
+    size_t n = nbytes - i < sizeof(value) ? nbytes - i : sizeof(value);
+    memcpy(dest + i, &value, n);
+  }
+  return 0;
+#else
+  FILE* fp = fopen("/dev/urandom", "rb");
+  if (fp == NULL) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  size_t rbytes = fread(dest, 1, nbytes, fp);
+  fclose(fp);
+  return rbytes == nbytes ? 0 : BLOSC2_ERROR_FAILURE;
+#endif
+}
@@ -0,0 +1,37 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_CIPHER_H
+#define BLOSC_CIPHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Encrypt the `nbytes` of `buf` in place with ChaCha20-Poly1305 (RFC 8439) under the
+ * BLOSC2_CIPHER_KEY_SIZE bytes of `key` and the BLOSC2_CIPHER_NONCE_SIZE bytes of `nonce`,
+ * authenticating the `aad_len` bytes of `aad` as well, and leave the BLOSC2_CIPHER_TAG_SIZE
+ * bytes of the tag in `tag` */
+void cipher_seal(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aad_len,
+                 uint8_t* buf, size_t nbytes, uint8_t* tag);
+
+/* Check the `nbytes` of `src` against their `tag` (as sealed by cipher_seal()), and decrypt
+ * them into `dest` (which may be `src`).  Returns 0 if succeeds, or BLOSC2_ERROR_AUTHENTICATION
+ * (and nothing is decrypted) if the tag does not match. */
+int cipher_open(const uint8_t* key, const uint8_t* nonce, const uint8_t* aad, size_t aad_len,
+                const uint8_t* src, uint8_t* dest, size_t nbytes, const uint8_t* tag);
+
+/* Zero the `nbytes` of `buf`, which keep a secret (unlike memset(), this is never optimized out) */
+void cipher_wipe(void* buf, size_t nbytes);
+
+/* Fill the `nbytes` of `dest` with random bytes from the operating system, for the nonces.
+ * Returns 0 if succeeds, or BLOSC2_ERROR_FAILURE. */
+int cipher_random(uint8_t* dest, size_t nbytes);
+
+#endif /* BLOSC_CIPHER_H */
@@ -0,0 +1,17 @@
+#ifndef _CONFIGURATION_HEADER_GUARD_H_
+#define _CONFIGURATION_HEADER_GUARD_H_
+
+#define HAVE_ZLIB TRUE
+#define HAVE_ZLIB_NG TRUE
+#define HAVE_ZSTD TRUE
+#define HAVE_INTERNAL_LZ4 TRUE
+/* #undef HAVE_IPP */
+/* #undef HAVE_QPL */
+/* #undef HAVE_CUDA */
+/* #undef BLOSC_DLL_EXPORT */
+#define HAVE_PLUGINS TRUE
+#define HAVE_IO_URING 1
+/* #undef HAVE_TRACE_HOOKS */
+/* #undef HAVE_SYS_SDT_H */
+
+#endif
@@ -13,6 +13,7 @@
 
 #include "b2nd.h"
 #include "blosc2.h"
+#include "threadpool.h"
 
 #if defined(HAVE_ZSTD)
 #include "zstd.h"
@@ -31,12 +32,6 @@
 #include <stddef.h>
 #include <stdint.h>
 
-/* Have problems using posix barriers when symbol value is 200112L */
-/* Requires more investigation, but this will work for the moment */
-#if defined(_POSIX_BARRIERS) && ( (_POSIX_BARRIERS - 20012L) >= 0 && _POSIX_BARRIERS != 200112L)
-#define BLOSC_POSIX_BARRIERS
-#endif
-
 struct blosc2_context_s {
   const uint8_t* src;  /* The source buffer */
   uint8_t* dest;  /* The destination buffer */
@@ -60,8 +55,9 @@ struct blosc2_context_s {
   int use_dict;  /* Whether to use dicts or not */
   void* dict_buffer;  /* The buffer to keep the trained dictionary */
   int32_t dict_size;  /* The size of the trained dictionary */
-  void* dict_cdict;  /* The dictionary in digested form for compression */
+  void* dict_cdict;  /* The dictionary in digested form for compression (codec specific) */
   void* dict_ddict;  /* The dictionary in digested form for decompression */
+  int32_t dict_id;  /* The id of the shared dictionary that is digested (0 if none) */
   uint8_t filter_flags;  /* The filter flags in the filter pipeline */
   uint8_t filters[BLOSC2_MAX_FILTERS];  /* The (sequence of) filters */
   uint8_t filters_meta[BLOSC2_MAX_FILTERS];  /* The metainfo for filters */
@@ -74,7 +70,16 @@ struct blosc2_context_s {
                          * If NULL (default), all blocks in a chunk should be read. */
   int block_maskout_nitems;  /* The number of items in block_maskout array (must match
                               * the number of blocks in chunk) */
+  int64_t* zfp_boxes;  /* For every block, the [start, stop) items of every dimension that are needed
+                       * (ZFP fixed-rate only, the whole block when start[0] < 0).  If NULL, whole blocks. */
+  int8_t zfp_boxes_ndim;  /* The number of dimensions of every box in zfp_boxes */
+  int zfp_boxes_nitems;  /* The number of boxes in zfp_boxes (must match the number of blocks in chunk) */
   blosc2_schunk* schunk;  /* Associated super-chunk (if available) */
+  void* lazy_stream;  /* Stream shared by the threads for reading the blocks of a lazy chunk (if any) */
+  uint8_t** lazy_blocks;  /* The blocks of a lazy chunk read in advance (NULL for the others) */
+  uint8_t* lazy_buffer;  /* Where the blocks read in advance are */
+  void* lazy_readahead;  /* The reads of the blocks in lazy_buffer that go on while the first ones are
+                         * decompressed (NULL if they are all read already) */
   struct thread_context* serial_context;  /* Cache for temporaries for serial operation */
   int do_compress;  /* 1 if we are compressing, 0 if decompressing */
   void *tuner_params;  /* Entry point for tuner persistence between runs */
@@ -84,31 +89,102 @@ struct blosc2_context_s {
   /* Threading */
   int16_t nthreads;
   int16_t new_nthreads;
+  bool auto_nthreads;  /* whether the threads engaged are decided in every call (BLOSC2_NTHREADS_AUTO) */
+  int16_t active_nthreads;  /* the threads that take part in the current job (at most nthreads) */
+  int64_t block_ns;  /* a running estimate of the time that a block takes (for auto_nthreads), 0 if unknown */
   int16_t threads_started;
   int16_t end_threads;
+  int numa_nodes;  /* the NUMA nodes the threads are pinned to (0 if they are not pinned) */
   pthread_t *threads;
   struct thread_context *thread_contexts;  /* Only for user-managed threads */
+  blosc2_task_scheduler task_scheduler;  /* the scheduler of the application running the jobs (no submit if none) */
   pthread_mutex_t count_mutex;
   pthread_mutex_t nchunk_mutex;
-#ifdef BLOSC_POSIX_BARRIERS
-  pthread_barrier_t barr_init;
-  pthread_barrier_t barr_finish;
-#else
-  int count_threads;
-  pthread_mutex_t count_threads_mutex;
-  pthread_cond_t count_threads_cv;
-#endif
+  blosc_barrier barr_init;  /* the threads of the context wait for a job here */
+  blosc_barrier barr_finish;  /* and here for the rest to finish it */
 #if !defined(_WIN32)
   pthread_attr_t ct_attr;  /* creation time attrs for threads */
 #endif
   int thread_giveup_code;  /* error code when give up */
-  int thread_nblock;  /* block counter */
+  int32_t thread_nblock;  /* block counter */
   int dref_not_init;  /* data ref in delta not initialized */
+  const uint8_t* dref;  /* the decoded reference block of the delta filter, when at hand (or NULL) */
   pthread_mutex_t delta_mutex;
   pthread_cond_t delta_cv;
+  int scheduler;  /* the scheduler for distributing blocks among threads */
+  int special_detection;  /* which sources are encoded as special chunks */
+  struct blosc_block_range *block_ranges;  /* per-thread pending blocks (work-stealing) */
+  blosc2_allocator allocator;  /* the allocator for the internal buffers (all NULL means the global one) */
+  blosc2_allocator *allocator_params;  /* the allocator in the params of the context, if any */
+  int device;  /* where the destination of decompression lives (BLOSC2_DEVICE_*) */
+  void *cuda_state;  /* the CUDA stream and device buffers for decompressing on the GPU (if any) */
+  blosc2_ctx_stats stats;  /* the cumulative statistics (the ones of the threads are merged after every job) */
+  int64_t job_start_ns;  /* when the current job of the threads started */
+  int64_t job_busy_ns;  /* the time that the threads have been busy in the current job */
+  int64_t job_max_busy_ns;  /* the time of the slowest thread in the current job */
+  bool record_stats;  /* whether the super-chunk records the stats of the chunks */
+  int32_t* block_csizes;  /* the compressed size of every block of the last chunk (if record_stats) */
+  int32_t block_csizes_len;  /* the number of items in block_csizes */
+  bool pooled;  /* whether the context belongs to the pool of concurrent reads or writes of a super-chunk */
+  bool implicit;  /* whether the context is the implicit one of a thread, whose jobs go to the pool of workers of the implicit contexts */
+  int64_t nchunk;  /* the chunk being decompressed by a pooled context (-1 for compression) */
+  blosc2_block_postfilter *block_postfilter;  /* the postfilter for whole blocks (a copy of the one in dparams) */
+  struct blosc_block_state *block_states;  /* the states of the threads for the block postfilter (only during a decompression) */
+  int32_t block_nstates;  /* the number of items in block_states */
+  int zonemap;  /* how the items are summarized in the zone maps of the blocks (BLOSC2_ZONEMAP_*) */
+  blosc2_zonemap* block_zonemaps;  /* the zone map of every block of the last chunk (if zonemap and no prefilter) */
+  int32_t block_zonemaps_len;  /* the number of items in block_zonemaps */
+  int checksum;  /* the checksums of the blocks that end the chunks (BLOSC2_CHECKSUM_*) */
+  uint64_t* block_checksums;  /* the checksum of every block of the last chunk (if checksum) */
+  int32_t block_checksums_len;  /* the number of items in block_checksums */
+  bool verify_checksums;  /* whether to check the decompressed blocks against their checksums */
+  int chunk_checksum;  /* the checksums of the chunk being decompressed (BLOSC2_CHECKSUM_*) */
+  const uint8_t* src_checksums;  /* where they are in the source (NULL if they are not verified) */
+  int streams_phase;  /* the phase of the job of the threads with BLOSC_STREAMS_SCHED (0 otherwise) */
+  uint8_t* streams_src;  /* the blocks after the filters (BLOSC_STREAMS_SCHED) */
+  int64_t streams_src_len;  /* the bytes in streams_src */
+  uint8_t* streams_dest;  /* the compressed streams, each one in a slot of its own (BLOSC_STREAMS_SCHED) */
+  int64_t streams_dest_len;  /* the bytes in streams_dest */
+  int32_t* streams_csizes;  /* the bytes in every slot of streams_dest */
+  int64_t streams_csizes_len;  /* the number of items in streams_csizes */
+  blosc2_block_codec_fn block_codec;  /* picks the codec of every block of hybrid chunks (NULL otherwise) */
+  void* block_codec_params;  /* the user data for block_codec */
+  const uint8_t* block_codecs;  /* the codec of every block of the hybrid chunk being decompressed (NULL otherwise) */
+  int zstd_window;  /* what the zstd blocks can match against (BLOSC2_ZSTD_*_WINDOW) */
+  bool detect_typesize;  /* whether to guess the stride of the shuffle of the chunks with a typesize of 1 */
+  int32_t shuffle_stride;  /* the stride guessed for the shuffle of the chunk being compressed (0 if none) */
+  int cipher;  /* the cipher of the blocks of the chunks (BLOSC2_CIPHER_*) */
+  uint8_t cipher_key[BLOSC2_CIPHER_KEY_SIZE];  /* the key for compressing or decompressing encrypted chunks */
+  bool has_cipher_key;  /* whether cipher_key was given */
+  uint8_t chunk_nonce[BLOSC2_CIPHER_NONCE_SIZE];  /* the nonce of the chunk being compressed */
+  uint8_t cipher_aad[BLOSC2_CHUNK_CBYTES + BLOSC2_CHUNK_CHECKSUM - BLOSC2_CHUNK_FILTER_CODES];  /* the bytes of
+                                   * the header of the chunk that the tags authenticate too */
+  uint8_t* cipher_blocks;  /* the csize and the tag of every block of the chunk being compressed */
+  int32_t cipher_blocks_len;  /* the number of blocks that fit in cipher_blocks */
+  int chunk_cipher;  /* the cipher of the chunk being decompressed (BLOSC2_CIPHER_*) */
+  const uint8_t* src_cipher;  /* where its nonce, csizes and tags are in the source (NULL if not encrypted) */
+  int nontemporal;  /* whether the blocks go to dest with non-temporal stores (BLOSC2_NONTEMPORAL_*) */
+  bool stream_dest;  /* whether they do in the decompression at hand */
+  int32_t dest_shift;  /* the position in the chunk of the first byte of dest (ranges of items) */
+  struct thread_context** own_thread_contexts;  /* the ones of the threads of the context itself (NULL
+                                                * with thread_contexts), which are only freed by them */
   // Add new fields here to avoid breaking the ABI.
 };
 
+/* The pending blocks [begin, end) of a thread for the work-stealing scheduler,
+ * packed as begin << 32 | end so that it can be updated with a single CAS.
+ * The padding avoids false sharing between neighbouring threads. */
+struct blosc_block_range {
+  int64_t range;
+  uint8_t pad[56];
+};
+
+/* The state of a thread for the block postfilter during a decompression */
+struct blosc_block_state {
+  void* state;
+  bool started;  /* whether the thread got any block (and its state was initialized) */
+};
+
 struct b2nd_context_s {
   int8_t ndim;
   //!< The array dimensions.
@@ -128,6 +204,12 @@ struct b2nd_context_s {
   //!< List with the metalayers desired.
   int32_t nmetalayers;
   //!< The number of metalayers.
+  int8_t chunk_order;
+  //!< The order in which the chunks are laid out in the frame.
+  bool auto_chunkshape;
+  //!< Whether the chunk shape is chosen (see b2nd_ctx_set_access_pattern()).
+  bool auto_blockshape;
+  //!< Whether the block shape is chosen.
 };
 
 struct thread_context {
@@ -139,16 +221,35 @@ struct thread_context {
   uint8_t* tmp4;
   int32_t tmp_blocksize;  /* the blocksize for different temporaries */
   size_t tmp_nbytes;   /* keep track of how big the temporary buffers are */
-  int32_t zfp_cell_start;  /* cell starter index for ZFP fixed-rate mode */
-  int32_t zfp_cell_nitems;  /* number of items to get for ZFP fixed-rate mode */
+  int tmp_class;  /* the blocksize class of the temporaries in the scratch pool (-1 if not pooled) */
+  int32_t cell_start;  /* first item to get from the block by the codecs with a getitems decoder */
+  int32_t cell_nitems;  /* number of items to get from it (0 for decoding the whole block) */
 #if defined(HAVE_ZSTD)
   /* The contexts for ZSTD */
   ZSTD_CCtx* zstd_cctx;
   ZSTD_DCtx* zstd_dctx;
+  /* The parameters that are sticky in zstd_cctx, so that they are only set when changed */
+  int zstd_clevel;  /* 0 if not set yet */
+  const ZSTD_CDict* zstd_cdict;
+  int zstd_ldm;  /* whether the long distance matcher is on */
+  /* The previous block once filtered, which is the prefix of the zstd blocks in chunks with BLOSC2_ZSTD_PREFIX */
+  uint8_t* zstd_prefix;
+  int32_t zstd_prefix_len;
+  int32_t zstd_prefix_size;  /* the bytes allocated for zstd_prefix */
+  int32_t zstd_prefix_nblock;  /* the block that zstd_prefix comes from (-1 if none) */
 #endif /* HAVE_ZSTD */
 #ifdef HAVE_IPP
   Ipp8u* lz4_hash_table;
 #endif
+  void* lz4_state;  /* the LZ4 state, reused from a block to the next */
+#if defined(HAVE_ZLIB)
+  /* The zlib streams, which are only reset from a block to the next */
+  void* zlib_deflate;
+  void* zlib_inflate;
+  int zlib_clevel;  /* the level of zlib_deflate */
+#endif /* HAVE_ZLIB */
+  blosc2_ctx_stats stats;  /* the statistics of the current job (merged into the context at its end) */
+  uint8_t* block_input;  /* an aligned copy of the block for the block postfilter (if needed) */
 };
 
 #endif  /* BLOSC_CONTEXT_H */
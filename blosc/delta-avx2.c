@@ -0,0 +1,16 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* delta.c built again with AVX2 enabled, for the 256-bit XORs and subtractions of the
+   delta filter.  The entry points get the _avx2 suffix (see delta.h), and the baseline
+   ones hand the blocks over to them when the processor has AVX2. */
+
+#define BLOSC_AVX2_BUILD
+#include "delta.c"
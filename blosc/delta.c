@@ -9,153 +9,483 @@
 **********************************************************************/
 
 #include "delta.h"
+#include "shuffle.h"
+#include "blosc2.h"
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+
+
+/* The kernels below work on bytes, and the units (of 1, 2, 4 or 8 bytes) only matter
+ * for the arithmetic and for the vector scans.  The vectors are the ones that the
+ * compilation target supports (as in ndlz): delta.c is built for the baseline, and
+ * again for AVX2 by delta-avx2.c, which the entry points hand the blocks over to. */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#define DELTA_HAS_SIMD
+typedef __m128i delta_vec;
+
+static inline delta_vec vec_load(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void vec_store(uint8_t* p, delta_vec x) { _mm_storeu_si128((__m128i*)p, x); }
+static inline delta_vec vec_xor(delta_vec a, delta_vec b) { return _mm_xor_si128(a, b); }
+
+static inline delta_vec vec_add(delta_vec a, delta_vec b, int32_t unit) {
+  switch (unit) {
+    case 1: return _mm_add_epi8(a, b);
+    case 2: return _mm_add_epi16(a, b);
+    case 4: return _mm_add_epi32(a, b);
+    default: return _mm_add_epi64(a, b);
+  }
+}
+
+static inline delta_vec vec_sub(delta_vec a, delta_vec b, int32_t unit) {
+  switch (unit) {
+    case 1: return _mm_sub_epi8(a, b);
+    case 2: return _mm_sub_epi16(a, b);
+    case 4: return _mm_sub_epi32(a, b);
+    default: return _mm_sub_epi64(a, b);
+  }
+}
+
+/* The vector moved up by n bytes (a constant), with zeros coming in */
+#define VEC_SHIFT_UP(x, n) _mm_slli_si128(x, n)
+
+/* The last unit of x in every unit */
+static inline delta_vec vec_last(delta_vec x, int32_t unit) {
+  switch (unit) {
+    case 4:
+      return _mm_shuffle_epi32(x, 0xFF);
+    case 1:
+      x = _mm_unpackhi_epi8(x, x);
+      // fallthrough
+    case 2:
+      x = _mm_shufflehi_epi16(x, 0xFF);
+      // fallthrough
+    default:
+      return _mm_unpackhi_epi64(x, x);
+  }
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define DELTA_HAS_SIMD
+typedef uint8x16_t delta_vec;
+
+static inline delta_vec vec_load(const uint8_t* p) { return vld1q_u8(p); }
+static inline void vec_store(uint8_t* p, delta_vec x) { vst1q_u8(p, x); }
+static inline delta_vec vec_xor(delta_vec a, delta_vec b) { return veorq_u8(a, b); }
+
+static inline delta_vec vec_add(delta_vec a, delta_vec b, int32_t unit) {
+  switch (unit) {
+    case 1: return vaddq_u8(a, b);
+    case 2: return vreinterpretq_u8_u16(vaddq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)));
+    case 4: return vreinterpretq_u8_u32(vaddq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
+    default: return vreinterpretq_u8_u64(vaddq_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b)));
+  }
+}
+
+static inline delta_vec vec_sub(delta_vec a, delta_vec b, int32_t unit) {
+  switch (unit) {
+    case 1: return vsubq_u8(a, b);
+    case 2: return vreinterpretq_u8_u16(vsubq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)));
+    case 4: return vreinterpretq_u8_u32(vsubq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
+    default: return vreinterpretq_u8_u64(vsubq_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b)));
+  }
+}
+
+#define VEC_SHIFT_UP(x, n) vextq_u8(vdupq_n_u8(0), x, 16 - (n))
+
+static inline delta_vec vec_last(delta_vec x, int32_t unit) {
+  switch (unit) {
+    case 1: return vdupq_laneq_u8(x, 15);
+    case 2: return vreinterpretq_u8_u16(vdupq_laneq_u16(vreinterpretq_u16_u8(x), 7));
+    case 4: return vreinterpretq_u8_u32(vdupq_laneq_u32(vreinterpretq_u32_u8(x), 3));
+    default: return vreinterpretq_u8_u64(vdupq_laneq_u64(vreinterpretq_u64_u8(x), 1));
+  }
+}
+#endif
+
+#if defined(DELTA_HAS_SIMD)
+/* The unit at p in every unit */
+static inline delta_vec vec_load_unit(const uint8_t* p, int32_t unit) {
+  uint8_t units[16];
+  for (int32_t i = 0; i < 16; i += unit) {
+    memcpy(units + i, p, unit);
+  }
+  return vec_load(units);
+}
+
+/* The XOR of every unit of x with all the previous ones (Kogge-Stone) */
+static inline delta_vec vec_prefix_xor(delta_vec x, int32_t unit) {
+  switch (unit) {
+    case 1:
+      x = vec_xor(x, VEC_SHIFT_UP(x, 1));
+      // fallthrough
+    case 2:
+      x = vec_xor(x, VEC_SHIFT_UP(x, 2));
+      // fallthrough
+    case 4:
+      x = vec_xor(x, VEC_SHIFT_UP(x, 4));
+      // fallthrough
+    default:
+      x = vec_xor(x, VEC_SHIFT_UP(x, 8));
+  }
+  return x;
+}
+
+/* The sum of every unit of x with all the previous ones */
+static inline delta_vec vec_prefix_add(delta_vec x, int32_t unit) {
+  switch (unit) {
+    case 1:
+      x = vec_add(x, VEC_SHIFT_UP(x, 1), 1);
+      // fallthrough
+    case 2:
+      x = vec_add(x, VEC_SHIFT_UP(x, 2), unit);
+      // fallthrough
+    case 4:
+      x = vec_add(x, VEC_SHIFT_UP(x, 4), unit);
+      // fallthrough
+    default:
+      x = vec_add(x, VEC_SHIFT_UP(x, 8), unit);
+  }
+  return x;
+}
+#endif  /* DELTA_HAS_SIMD */
+
+
+/* out[i] = a[i] ^ b[i] for the n bytes (out can be a) */
+static void xor_bytes(const uint8_t* a, const uint8_t* b, uint8_t* out, int32_t n) {
+  int32_t i = 0;
+#if defined(__AVX2__)
+  for (; i <= n - 32; i += 32) {
+    __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)),
+                                 _mm256_loadu_si256((const __m256i*)(b + i)));
+    _mm256_storeu_si256((__m256i*)(out + i), x);
+  }
+#endif
+#if defined(DELTA_HAS_SIMD)
+  for (; i <= n - 16; i += 16) {
+    vec_store(out + i, vec_xor(vec_load(a + i), vec_load(b + i)));
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = a[i] ^ b[i];
+  }
+}
+
+
+/* out[i] = in[i] ^ out[i - unit] for the n bytes, the unit before out being decoded
+ * already (in can be out) */
+static void xor_scan(const uint8_t* in, uint8_t* out, int32_t n, int32_t unit) {
+  int32_t i = 0;
+#if defined(DELTA_HAS_SIMD)
+  if (n >= 16) {
+    delta_vec carry = vec_load_unit(out - unit, unit);
+    for (; i <= n - 16; i += 16) {
+      delta_vec x = vec_xor(vec_prefix_xor(vec_load(in + i), unit), carry);
+      vec_store(out + i, x);
+      carry = vec_last(x, unit);
+    }
+  }
+#endif
+  for (; i < n; i++) {
+    out[i] = in[i] ^ out[i - unit];
+  }
+}
+
+
+/* out[i] = src[i] - src[i - stride] in units for the n bytes (a multiple of the unit),
+ * the stride before src being there */
+static void sub_lagged(const uint8_t* src, uint8_t* out, int32_t n, int32_t unit, int32_t stride) {
+  int32_t i = 0;
+#if defined(__AVX2__)
+  for (; i <= n - 32; i += 32) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(src + i - stride));
+    __m256i x;
+    switch (unit) {
+      case 1: x = _mm256_sub_epi8(a, b); break;
+      case 2: x = _mm256_sub_epi16(a, b); break;
+      case 4: x = _mm256_sub_epi32(a, b); break;
+      default: x = _mm256_sub_epi64(a, b);
+    }
+    _mm256_storeu_si256((__m256i*)(out + i), x);
+  }
+#endif
+#if defined(DELTA_HAS_SIMD)
+  for (; i <= n - 16; i += 16) {
+    vec_store(out + i, vec_sub(vec_load(src + i), vec_load(src + i - stride), unit));
+  }
+#endif
+  switch (unit) {
+    case 2:
+      for (; i < n; i += 2) {
+        *(uint16_t *)(out + i) = *(uint16_t *)(src + i) - *(uint16_t *)(src + i - stride);
+      }
+      break;
+    case 4:
+      for (; i < n; i += 4) {
+        *(uint32_t *)(out + i) = *(uint32_t *)(src + i) - *(uint32_t *)(src + i - stride);
+      }
+      break;
+    case 8:
+      for (; i < n; i += 8) {
+        *(uint64_t *)(out + i) = *(uint64_t *)(src + i) - *(uint64_t *)(src + i - stride);
+      }
+      break;
+    default:
+      for (; i < n; i++) {
+        out[i] = src[i] - src[i - stride];
+      }
+  }
+}
+
+
+/* out[i] = in[i] + out[i - stride] in units for the n bytes (a multiple of the unit),
+ * the stride before out being decoded already (in can be out) */
+static void add_scan(const uint8_t* in, uint8_t* out, int32_t n, int32_t unit, int32_t stride) {
+  int32_t i = 0;
+#if defined(DELTA_HAS_SIMD)
+  if (stride == unit && n >= 16) {
+    delta_vec carry = vec_load_unit(out - unit, unit);
+    for (; i <= n - 16; i += 16) {
+      delta_vec x = vec_add(vec_prefix_add(vec_load(in + i), unit), carry, unit);
+      vec_store(out + i, x);
+      carry = vec_last(x, unit);
+    }
+  }
+  else if (stride >= 16) {
+    // The previous elements of a vector are all in the previous vectors
+    for (; i <= n - 16; i += 16) {
+      vec_store(out + i, vec_add(vec_load(in + i), vec_load(out + i - stride), unit));
+    }
+  }
+#endif
+  switch (unit) {
+    case 2:
+      for (; i < n; i += 2) {
+        *(uint16_t *)(out + i) = *(uint16_t *)(in + i) + *(uint16_t *)(out + i - stride);
+      }
+      break;
+    case 4:
+      for (; i < n; i += 4) {
+        *(uint32_t *)(out + i) = *(uint32_t *)(in + i) + *(uint32_t *)(out + i - stride);
+      }
+      break;
+    case 8:
+      for (; i < n; i += 8) {
+        *(uint64_t *)(out + i) = *(uint64_t *)(in + i) + *(uint64_t *)(out + i - stride);
+      }
+      break;
+    default:
+      for (; i < n; i++) {
+        out[i] = in[i] + out[i - stride];
+      }
+  }
+}
+
+
+/* The delta coding works in units of the typesize, or of 8 (or 1) bytes for larger types */
+static int32_t delta_unit(int32_t typesize) {
+  switch (typesize) {
+    case 1:
+    case 2:
+    case 4:
+    case 8:
+      return typesize;
+    default:
+      return (typesize % 8) == 0 ? 8 : 1;
+  }
+}
+
+
+/* Whether the block at offset is coded wrt its own previous elements (the first block in
+ * BLOSC_DELTA_DREF mode), rather than wrt the reference block */
+static inline bool is_reference_block(int32_t offset, uint8_t meta) {
+  return offset == 0 && meta == BLOSC_DELTA_DREF;
+}
 
 
 /* Apply the delta filters to src.  This can never fail. */
 void delta_encoder(const uint8_t* dref, int32_t offset, int32_t nbytes, int32_t typesize,
-                   const uint8_t* src, uint8_t* dest) {
-  int32_t i;
-  if (offset == 0) {
+                   uint8_t meta, const uint8_t* src, uint8_t* dest) {
+#if defined(DELTA_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    delta_encoder_avx2(dref, offset, nbytes, typesize, meta, src, dest);
+    return;
+  }
+#endif
+  int32_t unit = delta_unit(typesize);
+  /* Only the whole units are coded */
+  int32_t n = nbytes - nbytes % unit;
+
+  if (meta == BLOSC_DELTA_ELEMENTS) {
+    /* Every element minus the previous one; the first one and the trailing bytes as they are */
+    int32_t head = (typesize < n) ? typesize : n;
+    memcpy(dest, src, head);
+    sub_lagged(src + head, dest + head, n - head, unit, typesize);
+    memcpy(dest + n, src + n, nbytes - n);
+  }
+  else if (is_reference_block(offset, meta)) {
     /* This is the reference block, use delta coding in elements */
-    switch (typesize) {
-      case 1:
-        dest[0] = dref[0];
-        for (i = 1; i < nbytes; i++) {
-          dest[i] = src[i] ^ dref[i-1];
-        }
-        break;
-      case 2:
-        ((uint16_t *)dest)[0] = ((uint16_t *)dref)[0];
-        for (i = 1; i < nbytes / 2; i++) {
-          ((uint16_t *)dest)[i] =
-                  ((uint16_t *)src)[i] ^ ((uint16_t *)dref)[i-1];
-        }
-        break;
-      case 4:
-        ((uint32_t *)dest)[0] = ((uint32_t *)dref)[0];
-        for (i = 1; i < nbytes / 4; i++) {
-          ((uint32_t *)dest)[i] =
-                  ((uint32_t *)src)[i] ^ ((uint32_t *)dref)[i-1];
-        }
-        break;
-      case 8:
-        ((uint64_t *)dest)[0] = ((uint64_t *)dref)[0];
-        for (i = 1; i < nbytes / 8; i++) {
-          ((uint64_t *)dest)[i] =
-                  ((uint64_t *)src)[i] ^ ((uint64_t *)dref)[i-1];
-        }
-        break;
-      default:
-        if ((typesize % 8) == 0) {
-          delta_encoder(dref, offset, nbytes, 8, src, dest);
-        } else {
-          delta_encoder(dref, offset, nbytes, 1, src, dest);
-        }
+    memcpy(dest, dref, (unit < nbytes) ? unit : nbytes);
+    if (n > unit) {
+      xor_bytes(src + unit, dref, dest + unit, n - unit);
     }
-  } else {
+  }
+  else {
     /* Use delta coding wrt reference block */
-    switch (typesize) {
-      case 1:
-        for (i = 0; i < nbytes; i++) {
-          dest[i] = src[i] ^ dref[i];
-        }
-        break;
-      case 2:
-        for (i = 0; i < nbytes / 2; i++) {
-          ((uint16_t *) dest)[i] =
-                  ((uint16_t *) src)[i] ^ ((uint16_t *) dref)[i];
-        }
-        break;
-      case 4:
-        for (i = 0; i < nbytes / 4; i++) {
-          ((uint32_t *) dest)[i] =
-                  ((uint32_t *) src)[i] ^ ((uint32_t *) dref)[i];
-        }
-        break;
-      case 8:
-        for (i = 0; i < nbytes / 8; i++) {
-          ((uint64_t *) dest)[i] =
-                  ((uint64_t *) src)[i] ^ ((uint64_t *) dref)[i];
-        }
-        break;
-      default:
-        if ((typesize % 8) == 0) {
-          delta_encoder(dref, offset, nbytes, 8, src, dest);
-        } else {
-          delta_encoder(dref, offset, nbytes, 1, src, dest);
-        }
-    }
+    xor_bytes(src, dref, dest, n);
   }
 }
 
 
 /* Undo the delta filter in dest.  This can never fail. */
 void delta_decoder(const uint8_t* dref, int32_t offset, int32_t nbytes,
-                   int32_t typesize, uint8_t* dest) {
-  int32_t i;
-
-  if (offset == 0) {
-    /* Decode delta for the reference block */
-    switch (typesize) {
-      case 1:
-        for (i = 1; i < nbytes; i++) {
-          dest[i] ^= dref[i-1];
-        }
-        break;
-      case 2:
-        for (i = 1; i < nbytes / 2; i++) {
-          ((uint16_t *)dest)[i] ^= ((uint16_t *)dref)[i-1];
-        }
-        break;
-      case 4:
-        for (i = 1; i < nbytes / 4; i++) {
-          ((uint32_t *)dest)[i] ^= ((uint32_t *)dref)[i-1];
-        }
-        break;
-      case 8:
-        for (i = 1; i < nbytes / 8; i++) {
-          ((uint64_t *)dest)[i] ^= ((uint64_t *)dref)[i-1];
-        }
-        break;
-      default:
-        if ((typesize % 8) == 0) {
-          delta_decoder(dref, offset, nbytes, 8, dest);
-        } else {
-          delta_decoder(dref, offset, nbytes, 1, dest);
-        }
+                   int32_t typesize, uint8_t meta, uint8_t* dest) {
+#if defined(DELTA_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    delta_decoder_avx2(dref, offset, nbytes, typesize, meta, dest);
+    return;
+  }
+#endif
+  int32_t unit = delta_unit(typesize);
+  int32_t n = nbytes - nbytes % unit;
+
+  if (meta == BLOSC_DELTA_ELEMENTS) {
+    if (n > typesize) {
+      add_scan(dest + typesize, dest + typesize, n - typesize, unit, typesize);
+    }
+  }
+  else if (is_reference_block(offset, meta)) {
+    /* Decode delta for the reference block (which is normally decoded in place) */
+    if (n > unit) {
+      if (dref == dest) {
+        xor_scan(dest + unit, dest + unit, n - unit, unit);
+      }
+      else {
+        xor_bytes(dest + unit, dref, dest + unit, n - unit);
+      }
     }
-  } else {
+  }
+  else {
     /* Decode delta for the non-reference blocks */
-    switch (typesize) {
-      case 1:
-        for (i = 0; i < nbytes; i++) {
-          dest[i] ^= dref[i];
-        }
-        break;
-      case 2:
-        for (i = 0; i < nbytes / 2; i++) {
-          ((uint16_t *)dest)[i] ^= ((uint16_t *)dref)[i];
-        }
-        break;
-      case 4:
-        for (i = 0; i < nbytes / 4; i++) {
-          ((uint32_t *)dest)[i] ^= ((uint32_t *)dref)[i];
-        }
-        break;
-      case 8:
-        for (i = 0; i < nbytes / 8; i++) {
-          ((uint64_t *)dest)[i] ^= ((uint64_t *)dref)[i];
-        }
-        break;
-      default:
-        if ((typesize % 8) == 0) {
-          delta_decoder(dref, offset, nbytes, 8, dest);
-        } else {
-          delta_decoder(dref, offset, nbytes, 1, dest);
-        }
+    xor_bytes(dest, dref, dest, n);
+  }
+}
+
+
+/* Delta encode the units [start, stop) of a block into `out` (which begins at `start`),
+ * just like delta_encoder() */
+static void delta_encode_range(const uint8_t* dref, int32_t offset, int32_t typesize, uint8_t meta,
+                               int32_t unit, int32_t start, int32_t stop, const uint8_t* src,
+                               uint8_t* out) {
+  int32_t first = start * unit;
+  int32_t i = first;
+  int32_t end = stop * unit;
+  if (meta == BLOSC_DELTA_ELEMENTS) {
+    if (i < typesize) {
+      int32_t head = (typesize < end) ? typesize : end;
+      memcpy(out, src + i, head - i);
+      i = head;
     }
+    sub_lagged(src + i, out + i - first, end - i, unit, typesize);
+    return;
+  }
+  /* The reference block is coded with the previous unit */
+  int32_t shift = is_reference_block(offset, meta) ? unit : 0;
+  if (shift && i == 0) {
+    memcpy(out, dref, unit);
+    i = unit;
+  }
+  if (end > i) {
+    xor_bytes(src + i, dref + i - shift, out + i - first, end - i);
+  }
+}
+
+
+/* Undo the delta coding of the units [start, stop) of a block out of `in` (which begins
+ * at `start`), just like delta_decoder().  For the reference block, `dref` is `dest`. */
+static void delta_decode_range(const uint8_t* dref, int32_t offset, int32_t typesize, uint8_t meta,
+                               int32_t unit, int32_t start, int32_t stop, const uint8_t* in,
+                               uint8_t* dest) {
+  int32_t first = start * unit;
+  int32_t i = first;
+  int32_t end = stop * unit;
+  if (meta == BLOSC_DELTA_ELEMENTS) {
+    if (i < typesize) {
+      int32_t head = (typesize < end) ? typesize : end;
+      memcpy(dest + i, in, head - i);
+      i = head;
+    }
+    add_scan(in + i - first, dest + i, end - i, unit, typesize);
+    return;
+  }
+  int32_t shift = is_reference_block(offset, meta) ? unit : 0;
+  if (shift && i == 0) {
+    memcpy(dest, in, unit);
+    i = unit;
+  }
+  if (end <= i) {
+    return;
+  }
+  if (shift && dref == dest) {
+    xor_scan(in + i - first, dest + i, end - i, unit);
+  }
+  else {
+    xor_bytes(in + i - first, dref + i - shift, dest + i, end - i);
+  }
+}
+
+
+/* Apply the delta filter and then the shuffle to src in a single pass over the block.
+ * `nbytes` has to be a multiple of `typesize`.  This can never fail. */
+void delta_encoder_shuffle(const uint8_t* dref, int32_t offset, int32_t nbytes, int32_t typesize,
+                           uint8_t meta, const uint8_t* src, uint8_t* dest) {
+#if defined(DELTA_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    delta_encoder_shuffle_avx2(dref, offset, nbytes, typesize, meta, src, dest);
+    return;
+  }
+#endif
+  uint8_t tile[SHUFFLE_TILE_SIZE];
+  int32_t unit = delta_unit(typesize);
+  int32_t nelems = nbytes / typesize;
+  int32_t tile_elems = SHUFFLE_TILE_ELEMENTS(typesize);
+
+  for (int32_t i = 0; i < nelems; i += tile_elems) {
+    int32_t n = (nelems - i < tile_elems) ? nelems - i : tile_elems;
+    delta_encode_range(dref, offset, typesize, meta, unit, i * typesize / unit, (i + n) * typesize / unit,
+                       src, tile);
+    shuffle_tile(typesize, n, nelems, tile, dest + i);
+  }
+}
+
+
+/* Undo the shuffle of src and then the delta filter into dest in a single pass over the block.
+ * `nbytes` has to be a multiple of `typesize`.  This can never fail. */
+void delta_decoder_unshuffle(const uint8_t* dref, int32_t offset, int32_t nbytes, int32_t typesize,
+                             uint8_t meta, const uint8_t* src, uint8_t* dest) {
+#if defined(DELTA_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    delta_decoder_unshuffle_avx2(dref, offset, nbytes, typesize, meta, src, dest);
+    return;
+  }
+#endif
+  uint8_t tile[SHUFFLE_TILE_SIZE];
+  int32_t unit = delta_unit(typesize);
+  int32_t nelems = nbytes / typesize;
+  int32_t tile_elems = SHUFFLE_TILE_ELEMENTS(typesize);
+
+  for (int32_t i = 0; i < nelems; i += tile_elems) {
+    int32_t n = (nelems - i < tile_elems) ? nelems - i : tile_elems;
+    unshuffle_tile(typesize, n, nelems, src + i, tile);
+    delta_decode_range(dref, offset, typesize, meta, unit, i * typesize / unit, (i + n) * typesize / unit,
+                       tile, dest);
   }
 }
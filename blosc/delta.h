@@ -13,10 +13,40 @@
 
 #include <stdint.h>
 
+/* delta-avx2.c builds delta.c again for AVX2, with these names */
+#if defined(BLOSC_AVX2_BUILD)
+#define delta_encoder delta_encoder_avx2
+#define delta_decoder delta_decoder_avx2
+#define delta_encoder_shuffle delta_encoder_shuffle_avx2
+#define delta_decoder_unshuffle delta_decoder_unshuffle_avx2
+#endif
+
+/* `meta` is the mode of the filter (BLOSC_DELTA_DREF, BLOSC_DELTA_ELEMENTS or BLOSC_DELTA_DREF_STORED) */
 void delta_encoder(const uint8_t* dref, int32_t offset, int32_t nbytes,
-                   int32_t typesize, const uint8_t* src, uint8_t* dest);
+                   int32_t typesize, uint8_t meta, const uint8_t* src, uint8_t* dest);
 
 void delta_decoder(const uint8_t* dref, int32_t offset, int32_t nbytes,
-                   int32_t typesize, uint8_t* dest);
+                   int32_t typesize, uint8_t meta, uint8_t* dest);
+
+/* The delta filter fused with the shuffle (for blocks made of whole elements) */
+void delta_encoder_shuffle(const uint8_t* dref, int32_t offset, int32_t nbytes,
+                           int32_t typesize, uint8_t meta, const uint8_t* src, uint8_t* dest);
+
+void delta_decoder_unshuffle(const uint8_t* dref, int32_t offset, int32_t nbytes,
+                             int32_t typesize, uint8_t meta, const uint8_t* src, uint8_t* dest);
+
+#if defined(DELTA_AVX2_ENABLED)
+void delta_encoder_avx2(const uint8_t* dref, int32_t offset, int32_t nbytes,
+                        int32_t typesize, uint8_t meta, const uint8_t* src, uint8_t* dest);
+
+void delta_decoder_avx2(const uint8_t* dref, int32_t offset, int32_t nbytes,
+                        int32_t typesize, uint8_t meta, uint8_t* dest);
+
+void delta_encoder_shuffle_avx2(const uint8_t* dref, int32_t offset, int32_t nbytes,
+                                int32_t typesize, uint8_t meta, const uint8_t* src, uint8_t* dest);
+
+void delta_decoder_unshuffle_avx2(const uint8_t* dref, int32_t offset, int32_t nbytes,
+                                  int32_t typesize, uint8_t meta, const uint8_t* src, uint8_t* dest);
+#endif
 
 #endif /* BLOSC_DELTA_H */
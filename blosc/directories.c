@@ -9,6 +9,7 @@
 **********************************************************************/
 
 #include "blosc2.h"
+#include "blosc-private.h"
 
 #include <sys/stat.h>
 #include <errno.h>
@@ -23,6 +24,7 @@
   #include <io.h>
 
   int blosc2_remove_dir(const char* dir_path) {
+    stdio_cache_release(dir_path);
     char* path;
     char last_char = dir_path[strlen(dir_path) - 1];
     if (last_char != '\\' || last_char != '/') {
@@ -53,7 +55,8 @@
       fname = malloc(strlen(dir_path) + 1 + strlen(cfile.name) + 1);
       sprintf(fname, "%s\\%s", dir_path, cfile.name);
 
-      ret = remove(fname);
+      // The subdirectories of sparse frames go too
+      ret = (cfile.attrib & _A_SUBDIR) ? blosc2_remove_dir(fname) : remove(fname);
       free(fname);
       if (ret < 0) {
         BLOSC_TRACE_ERROR("Could not remove file %s", fname);
@@ -88,6 +91,7 @@ char* blosc2_normalize_dirpath(const char* dir_path) {
 
 /* Function needed for removing each time the directory */
 int blosc2_remove_dir(const char* dir_path) {
+  stdio_cache_release(dir_path);
   char* path = blosc2_normalize_dirpath(dir_path);
 
   DIR* dr = opendir(path);
@@ -108,7 +112,8 @@ int blosc2_remove_dir(const char* dir_path) {
       continue;
     }
     if (!stat(fname, &statbuf)) {
-      ret = unlink(fname);
+      // The subdirectories of sparse frames go too
+      ret = S_ISDIR(statbuf.st_mode) ? blosc2_remove_dir(fname) : unlink(fname);
       if (ret < 0) {
         BLOSC_TRACE_ERROR("Could not remove file %s", fname);
         free(fname);
@@ -129,6 +134,7 @@ int blosc2_remove_dir(const char* dir_path) {
 
 int blosc2_remove_urlpath(const char* urlpath){
   if (urlpath != NULL) {
+    stdio_cache_release(urlpath);
     struct stat statbuf;
     if (stat(urlpath, &statbuf) != 0){
       if (errno == ENOENT) {
@@ -0,0 +1,16 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* fastcopy.c built again with AVX2 enabled, for the 32-byte copies and streamed stores.
+   blosclz-avx2.c calls these directly, while the rest of the library goes through the
+   baseline entry points, which hand the copies over when the processor has AVX2. */
+
+#define BLOSC_AVX2_BUILD
+#include "fastcopy.c"
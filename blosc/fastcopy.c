@@ -15,9 +15,11 @@
 
   New implementations by Francesc Alted:
     * fast_copy() and copy_run() functions
-    * Support for SSE2/AVX2 copy instructions for these routines
+    * Support for SSE2/AVX2 (and WebAssembly SIMD128) copy instructions for these routines
 **********************************************************************/
 
+#include "fastcopy.h"
+#include "shuffle.h"
 #include "blosc2/blosc2-common.h"
 
 #include <assert.h>
@@ -99,6 +101,9 @@ static inline unsigned char *copy_16_bytes(unsigned char *out, const unsigned ch
   chunk = _mm_loadu_si128((__m128i*)from);
   _mm_storeu_si128((__m128i*)out, chunk);
   out += 16;
+#elif defined(__wasm_simd128__)
+  wasm_v128_store(out, wasm_v128_load(from));
+  out += 16;
 #elif !defined(BLOSC_STRICT_ALIGN)
   *(uint64_t*)out = *(uint64_t*)from;
    from += 8; out += 8;
@@ -127,6 +132,12 @@ static inline unsigned char *copy_32_bytes(unsigned char *out, const unsigned ch
   chunk = _mm_loadu_si128((__m128i*)from);
   _mm_storeu_si128((__m128i*)out, chunk);
   out += 16;
+#elif defined(__wasm_simd128__)
+  v128_t chunk0 = wasm_v128_load(from);
+  v128_t chunk1 = wasm_v128_load(from + 16);
+  wasm_v128_store(out, chunk0);
+  wasm_v128_store(out + 16, chunk1);
+  out += 32;
 #elif !defined(BLOSC_STRICT_ALIGN)
   *(uint64_t*)out = *(uint64_t*)from;
   from += 8; out += 8;
@@ -403,13 +414,15 @@ static inline unsigned char *chunk_memcpy_16(unsigned char *out, const unsigned
 //}
 
 
-/* SSE2/AVX2 *unaligned* version of chunk_memcpy() */
-#if defined(__SSE2__) || defined(__AVX2__)
+/* SSE2/AVX2/SIMD128 *unaligned* version of chunk_memcpy() */
+#if defined(__SSE2__) || defined(__AVX2__) || defined(__wasm_simd128__)
 static inline unsigned char *chunk_memcpy_unaligned(unsigned char *out, const unsigned char *from, unsigned len) {
 #if defined(__AVX2__)
   unsigned sz = sizeof(__m256i);
 #elif defined(__SSE2__)
   unsigned sz = sizeof(__m128i);
+#elif defined(__wasm_simd128__)
+  unsigned sz = sizeof(v128_t);
 #endif
   unsigned rem = len % sz;
   unsigned ilen;
@@ -419,7 +432,7 @@ static inline unsigned char *chunk_memcpy_unaligned(unsigned char *out, const un
   /* Copy a few bytes to make sure the loop below has a multiple of SZ bytes to be copied. */
 #if defined(__AVX2__)
   copy_32_bytes(out, from);
-#elif defined(__SSE2__)
+#elif defined(__SSE2__) || defined(__wasm_simd128__)
   copy_16_bytes(out, from);
 #endif
 
@@ -430,7 +443,7 @@ static inline unsigned char *chunk_memcpy_unaligned(unsigned char *out, const un
   for (ilen = 0; ilen < len; ilen++) {
 #if defined(__AVX2__)
     copy_32_bytes(out, from);
-#elif defined(__SSE2__)
+#elif defined(__SSE2__) || defined(__wasm_simd128__)
     copy_16_bytes(out, from);
 #endif
     out += sz;
@@ -439,7 +452,7 @@ static inline unsigned char *chunk_memcpy_unaligned(unsigned char *out, const un
 
   return out;
 }
-#endif // __SSE2__ || __AVX2__
+#endif // __SSE2__ || __AVX2__ || __wasm_simd128__
 
 
 // NOTE: chunk_memcpy_aligned() is not used, so commenting it
@@ -500,6 +513,11 @@ static inline unsigned char *chunk_memcpy_unaligned(unsigned char *out, const un
 
 /* Byte by byte semantics: copy LEN bytes from FROM and write them to OUT. Return OUT + LEN. */
 unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned len) {
+#if defined(FASTCOPY_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    return fastcopy_avx2(out, from, len);
+  }
+#endif
   switch (len) {
     case 32:
       return copy_32_bytes(out, from);
@@ -513,7 +531,7 @@ unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned
   if (len < 8) {
     return copy_bytes(out, from, len);
   }
-#if defined(__SSE2__)
+#if defined(__SSE2__) || defined(__wasm_simd128__)
   if (len < 16) {
     return chunk_memcpy(out, from, len);
   }
@@ -527,16 +545,62 @@ unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned
 #endif  // !__AVX2__
 #else
   return chunk_memcpy(out, from, len);
-#endif  // __SSE2__
+#endif  // __SSE2__ || __wasm_simd128__
 }
 
 
+/* Same as fastcopy(), but the aligned body of OUT is written with non-temporal stores */
+unsigned char *fastcopy_stream(unsigned char *out, const unsigned char *from, unsigned len) {
+#if defined(FASTCOPY_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    return fastcopy_stream_avx2(out, from, len);
+  }
+#endif
+#if defined(__SSE2__)
+  unsigned head = (unsigned) ((16 - (uintptr_t) out % 16) % 16);
+  if (len < head + 64) {
+    return fastcopy(out, from, len);
+  }
+  out = fastcopy(out, from, head);
+  from += head;
+  len -= head;
+#if defined(__AVX2__)
+  if ((uintptr_t) out % 32 != 0) {
+    _mm_stream_si128((__m128i *) out, _mm_loadu_si128((const __m128i *) from));
+    out += 16;
+    from += 16;
+    len -= 16;
+  }
+  for (; len >= 32; len -= 32) {
+    _mm256_stream_si256((__m256i *) out, _mm256_loadu_si256((const __m256i *) from));
+    out += 32;
+    from += 32;
+  }
+#endif  // __AVX2__
+  for (; len >= 16; len -= 16) {
+    _mm_stream_si128((__m128i *) out, _mm_loadu_si128((const __m128i *) from));
+    out += 16;
+    from += 16;
+  }
+  // The streamed stores are not ordered with the rest, so make them visible before going on
+  _mm_sfence();
+#endif  // __SSE2__
+  return fastcopy(out, from, len);
+}
+
 /* Copy a run */
 unsigned char* copy_match(unsigned char *out, const unsigned char *from, unsigned len) {
+#if defined(FASTCOPY_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    return copy_match_avx2(out, from, len);
+  }
+#endif
 #if defined(__AVX2__)
   unsigned sz = sizeof(__m256i);
 #elif defined(__SSE2__)
   unsigned sz = sizeof(__m128i);
+#elif defined(__wasm_simd128__)
+  unsigned sz = sizeof(v128_t);
 #else
   unsigned sz = sizeof(uint64_t);
 #endif
@@ -11,10 +11,29 @@
 #ifndef BLOSC_FASTCOPY_H
 #define BLOSC_FASTCOPY_H
 
+/* fastcopy-avx2.c builds fastcopy.c again for AVX2, with these names (which the
+   other AVX2 builds, like blosclz-avx2.c, call directly) */
+#if defined(BLOSC_AVX2_BUILD)
+#define fastcopy fastcopy_avx2
+#define fastcopy_stream fastcopy_stream_avx2
+#define copy_match copy_match_avx2
+#endif
+
 /* Same semantics than memcpy() */
 unsigned char *fastcopy(unsigned char *out, const unsigned char *from, unsigned len);
 
+/* Same as fastcopy() but with non-temporal stores, which do not bring OUT into the cache */
+unsigned char *fastcopy_stream(unsigned char *out, const unsigned char *from, unsigned len);
+
 /* Same as fastcopy() but without overwriting origin or destination when they overlap */
 unsigned char* copy_match(unsigned char *out, const unsigned char *from, unsigned len);
 
+#if defined(FASTCOPY_AVX2_ENABLED)
+unsigned char *fastcopy_avx2(unsigned char *out, const unsigned char *from, unsigned len);
+
+unsigned char *fastcopy_stream_avx2(unsigned char *out, const unsigned char *from, unsigned len);
+
+unsigned char* copy_match_avx2(unsigned char *out, const unsigned char *from, unsigned len);
+#endif
+
 #endif /* BLOSC_FASTCOPY_H */
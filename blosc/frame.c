@@ -10,9 +10,13 @@
 
 #include "frame.h"
 #include "sframe.h"
+#include "checksum.h"
 #include "context.h"
 #include "blosc-private.h"
+#include "blosc-atomic.h"
+#include "threadpool.h"
 #include "blosc2.h"
+#include "blosc2/blosc2-stdio.h"
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -46,18 +50,76 @@ blosc2_frame_s* frame_new(const char* urlpath) {
 }
 
 
+/* Forget the ends of an on-disk frame read when opening it (they are outdated by any write) */
+static void frame_forget_open_reads(blosc2_frame_s* frame) {
+  free(frame->open_head);
+  frame->open_head = NULL;
+  frame->open_head_len = 0;
+  free(frame->open_tail);
+  frame->open_tail = NULL;
+  frame->open_tail_offset = 0;
+  frame->open_tail_len = 0;
+}
+
+
+/* Get the `len` bytes at `offset` of the frame out of the ends read when opening it.
+ * Returns NULL if they have not been read (or are outdated). */
+static uint8_t* frame_open_read(blosc2_frame_s* frame, int64_t offset, int64_t len) {
+  if (offset < 0 || len < 0) {
+    return NULL;
+  }
+  if (frame->open_head != NULL && offset + len <= frame->open_head_len) {
+    return frame->open_head + offset;
+  }
+  // The tail is only good while the frame does not grow or shrink
+  if (frame->open_tail != NULL && frame->len == frame->open_tail_offset + frame->open_tail_len &&
+      offset >= frame->open_tail_offset && offset + len <= frame->len) {
+    return frame->open_tail + (offset - frame->open_tail_offset);
+  }
+  return NULL;
+}
+
+
+/* Invalidate the caches of the header and chunk offsets of a frame.  Must be called
+ * every time that the on-disk header or offsets are modified. */
+static void frame_invalidate_caches(blosc2_frame_s* frame) {
+  frame_forget_open_reads(frame);
+  if (frame->coffsets != NULL) {
+    free(frame->coffsets);
+    frame->coffsets = NULL;
+    frame->coffsets_len = 0;
+  }
+  if (frame->offsets != NULL) {
+    free(frame->offsets);
+    frame->offsets = NULL;
+    frame->noffsets = 0;
+    frame->offsets_cap = 0;
+  }
+  if (frame->header != NULL) {
+    free(frame->header);
+    frame->header = NULL;
+  }
+  frame->special_value = 0;
+  frame_prefetch_clear(frame);
+  frame_item_cache_clear(frame);
+}
+
+
 /* Free memory from a frame. */
 int frame_free(blosc2_frame_s* frame) {
+  frame_set_prefetch(frame, 0);
 
   if (frame->cframe != NULL && !frame->avoid_cframe_free) {
     free(frame->cframe);
   }
 
-  if (frame->coffsets != NULL) {
-    free(frame->coffsets);
-  }
+  frame_invalidate_caches(frame);
+  free(frame->vlmeta_positions);
+  free(frame->append_scratch);
 
   if (frame->urlpath != NULL) {
+    // Do not keep the files of the frame open after it is gone
+    stdio_cache_release(frame->urlpath);
     free(frame->urlpath);
   }
 
@@ -67,6 +129,56 @@ int frame_free(blosc2_frame_s* frame) {
 }
 
 
+/* Make room for `len` bytes in the buffer of an in-memory frame.  The buffer grows
+ * geometrically, so that appending many chunks does not realloc (and copy) it every
+ * time; frame_shrink_to_fit() gives the spare capacity back.  Returns the (possibly
+ * moved) buffer, or NULL if it cannot be grown (the frame is left untouched then). */
+static uint8_t* frame_reserve(blosc2_frame_s* frame, int64_t len) {
+  if (len <= frame->cframe_cap) {
+    return frame->cframe;
+  }
+  int64_t cap = frame->cframe_cap + frame->cframe_cap / 2;
+  if (cap < len) {
+    cap = len;
+  }
+  uint8_t* cframe = realloc(frame->cframe, (size_t)cap);
+  if (cframe == NULL && cap > len) {
+    // Try again without the spare capacity
+    cap = len;
+    cframe = realloc(frame->cframe, (size_t)cap);
+  }
+  if (cframe == NULL) {
+    return NULL;
+  }
+  hugepages_advise(cframe, (size_t)cap);
+  frame->cframe = cframe;
+  frame->cframe_cap = cap;
+  return cframe;
+}
+
+
+int frame_shrink_to_fit(blosc2_frame_s* frame) {
+  if (frame->cframe == NULL || frame->avoid_cframe_free || frame->cframe_cap <= frame->len) {
+    return 0;
+  }
+  uint8_t* cframe = realloc(frame->cframe, (size_t)frame->len);
+  if (cframe == NULL) {
+    BLOSC_TRACE_ERROR("Cannot shrink the frame buffer.");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  frame->cframe = cframe;
+  frame->cframe_cap = frame->len;
+  return 0;
+}
+
+
+/* Whether the chunk offsets of a frame with `nchunks` chunks are stored in a two-level index, which
+ * is opted in with BLOSC2_INDEX_TWO_LEVELS and only pays off for frames with many chunks */
+static inline bool index_two_levels(int index_format, int64_t nchunks) {
+  return index_format == BLOSC2_INDEX_TWO_LEVELS && nchunks > FRAME_INDEX_LEAF_NOFFSETS;
+}
+
+
 void *new_header_frame(blosc2_schunk *schunk, blosc2_frame_s *frame) {
   if (frame == NULL) {
     return NULL;
@@ -112,8 +224,21 @@ void *new_header_frame(blosc2_schunk *schunk, blosc2_frame_s *frame) {
     return NULL;
   }
   // General flags
-  *h2p = BLOSC2_VERSION_FRAME_FORMAT;  // version
+  // version
+  switch (frame->index_format) {
+    case BLOSC2_INDEX_TWO_LEVELS:
+      *h2p = BLOSC2_VERSION_FRAME_FORMAT_TWO_LEVELS_INDEX;
+      break;
+    case BLOSC2_INDEX_PACKED:
+      *h2p = BLOSC2_VERSION_FRAME_FORMAT_PACKED_INDEX;
+      break;
+    default:
+      *h2p = BLOSC2_VERSION_FRAME_FORMAT;
+  }
   *h2p += 0x10;  // 64-bit offsets.  We only support this for now.
+  if (index_two_levels(frame->index_format, schunk->nchunks)) {
+    *h2p += FRAME_INDEX_TWO_LEVELS;
+  }
   h2p += 1;
   if (h2p - h2 >= FRAME_HEADER_MINLEN) {
     return NULL;
@@ -121,7 +246,15 @@ void *new_header_frame(blosc2_schunk *schunk, blosc2_frame_s *frame) {
 
   // Frame type
   // We only support contiguous and sparse directories frames currently
-  *h2p = frame->sframe ? 1 : 0;
+  *h2p = frame->sframe ? FRAME_DIRECTORY_TYPE : FRAME_CONTIGUOUS_TYPE;
+  for (int log2 = 1; frame->sframe && frame->shard_nchunks > 1 && log2 < 16; log2++) {
+    if (frame->shard_nchunks == (1 << log2)) {
+      *h2p |= (uint8_t)(log2 << FRAME_SHARD_SHIFT);
+    }
+  }
+  if (frame->sframe) {
+    *h2p |= (uint8_t)(frame->dir_levels << FRAME_DIR_LEVELS_SHIFT);
+  }
   h2p += 1;
   if (h2p - h2 >= FRAME_HEADER_MINLEN) {
     return NULL;
@@ -140,6 +273,14 @@ void *new_header_frame(blosc2_schunk *schunk, blosc2_frame_s *frame) {
 
   // Other flags
   *h2p = schunk->splitmode - 1;
+  for (int log2 = 1; frame->chunk_align > 1 && log2 < 31; log2++) {
+    if (frame->chunk_align == (1 << log2)) {
+      *h2p |= (uint8_t)(log2 << FRAME_CHUNK_ALIGN_SHIFT);
+    }
+  }
+  if (frame->sframe && frame->index_log) {
+    *h2p |= FRAME_INDEX_LOG;
+  }
   h2p += 1;
   if (h2p - h2 >= FRAME_HEADER_MINLEN) {
     return NULL;
@@ -371,8 +512,17 @@ int get_header_info(blosc2_frame_s *frame, int32_t *header_len, int64_t *frame_l
     return BLOSC2_ERROR_READ_BUFFER;
   }
 
-  if (frame->cframe == NULL) {
+  if (frame->cframe == NULL && frame->header != NULL) {
+    // The header has not changed since it was last read
+    framep = frame->header;
+  }
+  else if (frame->cframe == NULL && frame_open_read(frame, 0, FRAME_HEADER_MINLEN) != NULL) {
+    memcpy(header, frame_open_read(frame, 0, FRAME_HEADER_MINLEN), FRAME_HEADER_MINLEN);
+    framep = header;
+  }
+  else if (frame->cframe == NULL) {
     int64_t rbytes = 0;
+    int64_t position = 0;
     void* fp = NULL;
     if (frame->sframe) {
       fp = sframe_open_index(frame->urlpath, "rb", io);
@@ -387,9 +537,9 @@ int get_header_info(blosc2_frame_s *frame, int32_t *header_len, int64_t *frame_l
         BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
         return BLOSC2_ERROR_FILE_OPEN;
       }
-      io_cb->seek(fp, frame->file_offset, SEEK_SET);
+      position = frame->file_offset;
     }
-    rbytes = io_cb->read(header, 1, FRAME_HEADER_MINLEN, fp);
+    rbytes = io_pread(io_cb, header, 1, FRAME_HEADER_MINLEN, position, fp);
     io_cb->close(fp);
     if (rbytes != FRAME_HEADER_MINLEN) {
       return BLOSC2_ERROR_FILE_READ;
@@ -398,8 +548,15 @@ int get_header_info(blosc2_frame_s *frame, int32_t *header_len, int64_t *frame_l
   }
 
   // Consistency check for frame type
-  uint8_t frame_type = framep[FRAME_TYPE];
+  uint8_t frame_type = framep[FRAME_TYPE] & FRAME_TYPE_MASK;
   if (frame->sframe) {
+    int shard_log2 = framep[FRAME_TYPE] >> FRAME_SHARD_SHIFT;
+    frame->shard_nchunks = shard_log2 > 0 ? 1 << shard_log2 : 0;
+    // Frames from before the subdirectories have every file at the top
+    frame->dir_levels = (int8_t)((framep[FRAME_TYPE] >> FRAME_DIR_LEVELS_SHIFT) & FRAME_DIR_LEVELS_MASK);
+    if (frame->dir_levels > FRAME_DIR_LEVELS_MAX) {
+      return BLOSC2_ERROR_FRAME_TYPE;
+    }
     if (frame_type != FRAME_DIRECTORY_TYPE) {
       return BLOSC2_ERROR_FRAME_TYPE;
     }
@@ -408,6 +565,20 @@ int get_header_info(blosc2_frame_s *frame, int32_t *header_len, int64_t *frame_l
       return BLOSC2_ERROR_FRAME_TYPE;
     }
   }
+  // The format of the index goes with the version of the frame
+  int version = framep[FRAME_FLAGS] & 0x0f;
+  if (version > BLOSC2_VERSION_FRAME_FORMAT_PACKED_INDEX) {
+    BLOSC_TRACE_ERROR("The version of the frame (%d) is not supported.", version);
+    return BLOSC2_ERROR_VERSION_SUPPORT;
+  }
+  frame->index_format = version == BLOSC2_VERSION_FRAME_FORMAT_TWO_LEVELS_INDEX ? BLOSC2_INDEX_TWO_LEVELS :
+                        version == BLOSC2_VERSION_FRAME_FORMAT_PACKED_INDEX ? BLOSC2_INDEX_PACKED :
+                        BLOSC2_INDEX_CHUNK;
+  if ((framep[FRAME_FLAGS] & FRAME_INDEX_TWO_LEVELS) && frame->index_format != BLOSC2_INDEX_TWO_LEVELS) {
+    BLOSC_TRACE_ERROR("Two-level indexes need a frame format of version %d.",
+                      BLOSC2_VERSION_FRAME_FORMAT_TWO_LEVELS_INDEX);
+    return BLOSC2_ERROR_INVALID_HEADER;
+  }
 
   // Fetch some internal lengths
   from_big(header_len, framep + FRAME_HEADER_LEN, sizeof(*header_len));
@@ -449,10 +620,11 @@ int get_header_info(blosc2_frame_s *frame, int32_t *header_len, int64_t *frame_l
   // Other flags
   uint8_t other_flags = framep[FRAME_OTHER_FLAGS];
   if (splitmode != NULL) {
-    *splitmode = other_flags & 0x4u;
-    from_big(splitmode, framep + FRAME_OTHER_FLAGS, sizeof(*splitmode));
-    *splitmode += 1;
+    *splitmode = (uint8_t)((other_flags & FRAME_SPLITMODE_MASK) + 1);
   }
+  int align_log2 = (other_flags >> FRAME_CHUNK_ALIGN_SHIFT) & FRAME_CHUNK_ALIGN_MASK;
+  frame->chunk_align = align_log2 > 0 && align_log2 < 31 ? 1 << align_log2 : 0;
+  frame->index_log = frame->sframe && (other_flags & FRAME_INDEX_LOG);
 
   if (compcode_meta != NULL) {
     from_big(compcode_meta, framep + FRAME_CODEC_META, sizeof(*compcode_meta));
@@ -493,6 +665,12 @@ int get_header_info(blosc2_frame_s *frame, int32_t *header_len, int64_t *frame_l
     *nchunks = 0;
   }
 
+  if (frame->cframe == NULL && frame->header == NULL) {
+    // Keep the (validated) header around for the next lookups
+    frame->header = malloc(FRAME_HEADER_MINLEN);
+    memcpy(frame->header, header, FRAME_HEADER_MINLEN);
+  }
+
   return 0;
 }
 
@@ -519,6 +697,10 @@ int update_frame_len(blosc2_frame_s* frame, int64_t len) {
     to_big(frame->cframe + FRAME_LEN, &len, sizeof(int64_t));
   }
   else {
+    // The cached header is outdated now
+    free(frame->header);
+    frame->header = NULL;
+    frame_forget_open_reads(frame);
     void* fp = NULL;
     if (frame->sframe) {
       fp = sframe_open_index(frame->urlpath, "rb+",
@@ -531,10 +713,9 @@ int update_frame_len(blosc2_frame_s* frame, int64_t len) {
       BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
       return BLOSC2_ERROR_FILE_OPEN;
     }
-    io_cb->seek(fp, frame->file_offset + FRAME_LEN, SEEK_SET);
     int64_t swap_len;
     to_big(&swap_len, &len, sizeof(int64_t));
-    int64_t wbytes = io_cb->write(&swap_len, 1, sizeof(int64_t), fp);
+    int64_t wbytes = io_pwrite(io_cb, &swap_len, 1, sizeof(int64_t), frame->file_offset + FRAME_LEN, fp);
     io_cb->close(fp);
     if (wbytes != sizeof(int64_t)) {
       BLOSC_TRACE_ERROR("Cannot write the frame length in header.");
@@ -545,14 +726,13 @@ int update_frame_len(blosc2_frame_s* frame, int64_t len) {
 }
 
 
-int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
-  if (frame != NULL && frame->len == 0) {
-    BLOSC_TRACE_ERROR("The trailer cannot be updated on empty frames.");
-  }
-
+/* Build the trailer of a frame out of the vlmetalayers of `schunk` (see the frame format
+ * document).  If the vlmetalayers fit in a trailer of `fit_len` bytes, the trailer gets that
+ * length; else the padding of the storage is reserved after them.  Returns a new buffer of
+ * `trailer_len` bytes, or NULL in case of errors. */
+static uint8_t* new_trailer_frame(blosc2_schunk* schunk, int64_t fit_len, int64_t* trailer_len) {
   // Create the trailer in msgpack (see the frame format document)
-  int64_t trailer_len = FRAME_TRAILER_MINLEN;
-  uint8_t* trailer = (uint8_t*)calloc((size_t)trailer_len, 1);
+  uint8_t* trailer = (uint8_t*)calloc(FRAME_TRAILER_MINLEN, 1);
   uint8_t* ptrailer = trailer;
   *ptrailer = 0x90 + 4;  // fixarray with 4 elements
   ptrailer += 1;
@@ -565,7 +745,7 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   // Now, deal with variable-length metalayers
   int16_t nvlmetalayers = schunk->nvlmetalayers;
   if (nvlmetalayers < 0 || nvlmetalayers > BLOSC2_MAX_METALAYERS) {
-    return -1;
+    return NULL;
   }
 
   // Make space for the header of metalayers (array marker, size, map of offsets)
@@ -590,9 +770,6 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   current_trailer_len = (int32_t)(ptrailer - trailer);
   int32_t *offtodata = malloc(nvlmetalayers * sizeof(int32_t));
   for (int nvlmetalayer = 0; nvlmetalayer < nvlmetalayers; nvlmetalayer++) {
-    if (frame == NULL) {
-      return -1;
-    }
     blosc2_metalayer *vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
     uint8_t name_len = (uint8_t) strlen(vlmetalayer->name);
     trailer = realloc(trailer, (size_t)current_trailer_len + 1 + name_len + 1 + 4);
@@ -600,7 +777,7 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
     // Store the vlmetalayer
     if (name_len >= (1U << 5U)) {  // metalayer strings cannot be longer than 32 bytes
       free(offtodata);
-      return -1;
+      return NULL;
     }
     *ptrailer = (uint8_t)0xa0 + name_len;  // str
     ptrailer += 1;
@@ -615,12 +792,12 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   }
   int32_t tsize2 = (int32_t)(ptrailer - trailer);
   if (tsize2 != current_trailer_len) {  // sanity check
-    return -1;
+    return NULL;
   }
 
   // Map size + int16 size
   if ((uint32_t) (tsize2 - tsize) >= (1U << 16U)) {
-    return -1;
+    return NULL;
   }
   uint16_t map_size = (uint16_t) (tsize2 - tsize);
   to_big(trailer + 4, &map_size, sizeof(map_size));
@@ -637,9 +814,6 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   ptrailer += sizeof(nvlmetalayers);
   current_trailer_len = (int32_t)(ptrailer - trailer);
   for (int nvlmetalayer = 0; nvlmetalayer < nvlmetalayers; nvlmetalayer++) {
-    if (frame == NULL) {
-      return -1;
-    }
     blosc2_metalayer *vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
     trailer = realloc(trailer, (size_t)current_trailer_len + 1 + 4 + vlmetalayer->content_len);
     ptrailer = trailer + current_trailer_len;
@@ -657,34 +831,83 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   free(offtodata);
   tsize = (int32_t)(ptrailer - trailer);
   if (tsize != current_trailer_len) {  // sanity check
-    return -1;
+    return NULL;
+  }
+
+  // Zeros after the values, so that later changes can overwrite the trailer in place
+  int64_t padded_len = current_trailer_len;
+  if (fit_len - 23 >= padded_len) {
+    padded_len = fit_len - 23;
+  }
+  else if (schunk->storage->trailer_padding > 0) {
+    padded_len += schunk->storage->trailer_padding;
   }
+  if (padded_len + 23 > UINT32_MAX) {
+    free(trailer);
+    return NULL;
+  }
+  trailer = realloc(trailer, (size_t)padded_len);
+  memset(trailer + current_trailer_len, 0, (size_t)(padded_len - current_trailer_len));
+  current_trailer_len = (int32_t)padded_len;
+  ptrailer = trailer + current_trailer_len;
 
   trailer = realloc(trailer, (size_t)current_trailer_len + 23);
   ptrailer = trailer + current_trailer_len;
-  trailer_len = (ptrailer - trailer) + 23;
+  *trailer_len = (ptrailer - trailer) + 23;
 
   // Trailer length
   *ptrailer = 0xce;  // uint32
   ptrailer += 1;
-  to_big(ptrailer, &trailer_len, sizeof(uint32_t));
+  to_big(ptrailer, trailer_len, sizeof(uint32_t));
   ptrailer += sizeof(uint32_t);
   // Up to 16 bytes for frame fingerprint (using XXH3 included in https://github.com/Cyan4973/xxHash)
   // Maybe someone would need 256-bit in the future, but for the time being 128-bit seems like a good tradeoff
   *ptrailer = 0xd8;  // fixext 16
   ptrailer += 1;
-  *ptrailer = 0;  // fingerprint type: 0 -> no fp; 1 -> 32-bit; 2 -> 64-bit; 3 -> 128-bit
+  // fingerprint type: 0 -> no fp; 1 -> 32-bit; 2 -> 64-bit; 3 -> 128-bit
+  *ptrailer = schunk->cctx->checksum == BLOSC2_CHECKSUM_XXH3 ? FRAME_FINGERPRINT_64 : FRAME_FINGERPRINT_NONE;
   ptrailer += 1;
 
-  // Remove call to memset when we compute an actual fingerprint
+  // The 64-bit XXH3 of the vlmetalayers, padded to the left
   memset(ptrailer, 0, 16);
-  // Uncomment call to memcpy when we compute an actual fingerprint
-  // memcpy(ptrailer, xxh3_fingerprint, sizeof(xxh3_fingerprint));
+  if (ptrailer[-1] == FRAME_FINGERPRINT_64) {
+    uint64_t fingerprint = checksum_xxh3(trailer, current_trailer_len);
+    to_big(ptrailer + 8, &fingerprint, sizeof(fingerprint));
+  }
   ptrailer += 16;
 
   // Sanity check
-  if (ptrailer - trailer != trailer_len) {
-    return BLOSC2_ERROR_DATA;
+  if (ptrailer - trailer != *trailer_len) {
+    free(trailer);
+    return NULL;
+  }
+
+  return trailer;
+}
+
+
+int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
+  if (frame != NULL && frame->len == 0) {
+    BLOSC_TRACE_ERROR("The trailer cannot be updated on empty frames.");
+  }
+  frame_forget_open_reads(frame);
+
+  if (frame->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(frame);
+    if (rc_ < 0) {
+      return rc_;
+    }
+  }
+  int rc_meta = frame_load_vlmetalayers(frame, schunk, -1);
+  if (rc_meta < 0) {
+    return rc_meta;
+  }
+
+  int64_t trailer_len;
+  uint8_t* trailer = new_trailer_frame(schunk, frame->trailer_len, &trailer_len);
+  if (trailer == NULL) {
+    return BLOSC2_ERROR_FAILURE;
   }
 
   int32_t header_len;
@@ -719,8 +942,7 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   // and it is always at the end of the frame, we can just write (or overwrite) it
   // at the end of the frame.
   if (frame->cframe != NULL) {
-    frame->cframe = realloc(frame->cframe, (size_t)(trailer_offset + trailer_len));
-    if (frame->cframe == NULL) {
+    if (frame_reserve(frame, trailer_offset + trailer_len) == NULL) {
       BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
       return BLOSC2_ERROR_MEMORY_ALLOC;
     }
@@ -739,8 +961,7 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
       BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
       return BLOSC2_ERROR_FILE_OPEN;
     }
-    io_cb->seek(fp, frame->file_offset + trailer_offset, SEEK_SET);
-    int64_t wbytes = io_cb->write(trailer, 1, trailer_len, fp);
+    int64_t wbytes = io_pwrite(io_cb, trailer, 1, trailer_len, frame->file_offset + trailer_offset, fp);
     if (wbytes != trailer_len) {
       BLOSC_TRACE_ERROR("Cannot write the trailer length in trailer.");
       return BLOSC2_ERROR_FILE_WRITE;
@@ -760,7 +981,80 @@ int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk) {
   }
   frame->len = trailer_offset + trailer_len;
   frame->trailer_len = trailer_len;
+  // The trailer is the last thing written by any change
+  if (schunk->storage->durability == BLOSC2_DURABILITY_WRITE) {
+    rc = frame_sync(frame);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  return 1;
+}
+
+
+/* Overwrite the trailer with the vlmetalayers of `schunk` if they fit in it (see
+ * blosc2_storage.trailer_padding), so that the frame keeps its length and its header.
+ * Returns 1 if written, 0 if they do not fit, or a negative value in case of errors. */
+int frame_update_vlmetalayers(blosc2_frame_s* frame, blosc2_schunk* schunk) {
+  if (frame->len <= 0 || frame->trailer_len < FRAME_TRAILER_MINLEN || frame->bulk_pending) {
+    return 0;
+  }
+  int64_t trailer_offset = frame->len - frame->trailer_len;
+  if (trailer_offset < BLOSC_EXTENDED_HEADER_LENGTH) {
+    return 0;
+  }
+  int rc = frame_load_vlmetalayers(frame, schunk, -1);
+  if (rc < 0) {
+    return rc;
+  }
+  int64_t trailer_len;
+  uint8_t* trailer = new_trailer_frame(schunk, frame->trailer_len, &trailer_len);
+  if (trailer == NULL) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  if (trailer_len != frame->trailer_len) {
+    free(trailer);
+    return 0;
+  }
 
+  if (frame->cframe != NULL) {
+    memcpy(frame->cframe + trailer_offset, trailer, trailer_len);
+    free(trailer);
+    return 1;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    free(trailer);
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  frame_forget_open_reads(frame);
+  void* fp;
+  if (frame->sframe) {
+    fp = sframe_open_index(frame->urlpath, "rb+", schunk->storage->io);
+  }
+  else {
+    fp = io_cb->open(frame->urlpath, "rb+", schunk->storage->io->params);
+  }
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+    free(trailer);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  int64_t wbytes = io_pwrite(io_cb, trailer, 1, trailer_len, frame->file_offset + trailer_offset, fp);
+  io_cb->close(fp);
+  free(trailer);
+  if (wbytes != trailer_len) {
+    BLOSC_TRACE_ERROR("Cannot write the trailer.");
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  if (schunk->storage->durability == BLOSC2_DURABILITY_WRITE) {
+    rc = frame_sync(frame);
+    if (rc < 0) {
+      return rc;
+    }
+  }
   return 1;
 }
 
@@ -780,11 +1074,13 @@ static char* normalize_urlpath(const char* urlpath) {
 }
 
 
-/* Initialize a frame out of a file */
+/* Initialize a frame out of a file.  Both ends of the frame are read in one go, so that
+ * the header, metalayers, chunk offsets and trailer of small frames (or with small
+ * indexes) do not need more I/O when building the super-chunk. */
 blosc2_frame_s* frame_from_file_offset(const char* urlpath, const blosc2_io *io, int64_t offset) {
     // Get the length of the frame
-    uint8_t header[FRAME_HEADER_MINLEN];
-    uint8_t trailer[FRAME_TRAILER_MINLEN];
+    uint8_t* header;
+    uint8_t* trailer;
 
     void* fp = NULL;
     bool sframe = false;
@@ -792,17 +1088,23 @@ blosc2_frame_s* frame_from_file_offset(const char* urlpath, const blosc2_io *io,
 
     urlpath = normalize_urlpath(urlpath);
 
-    if(stat(urlpath, &path_stat) < 0) {
-        BLOSC_TRACE_ERROR("Cannot get information about the path %s.", urlpath);
-        return NULL;
-    }
-
     blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
     if (io_cb == NULL) {
         BLOSC_TRACE_ERROR("Error getting the input/output API");
         return NULL;
     }
 
+    // There are no directories in object stores: a sparse frame is just the prefix of its objects
+    bool remote = io->id == BLOSC2_IO_OBJECT_STORE;
+    if (remote) {
+        fp = io_cb->open(urlpath, "rb", io->params);
+        path_stat.st_mode = fp == NULL ? S_IFDIR : 0;
+    }
+    else if(stat(urlpath, &path_stat) < 0) {
+        BLOSC_TRACE_ERROR("Cannot get information about the path %s.", urlpath);
+        return NULL;
+    }
+
     char* urlpath_cpy;
     if (path_stat.st_mode & S_IFDIR) {
         urlpath_cpy = malloc(strlen(urlpath) + 1);
@@ -819,43 +1121,64 @@ blosc2_frame_s* frame_from_file_offset(const char* urlpath, const blosc2_io *io,
     else {
         urlpath_cpy = malloc(strlen(urlpath) + 1);
         strcpy(urlpath_cpy, urlpath);
-        fp = io_cb->open(urlpath, "rb", io->params);
+        if (!remote) {
+            fp = io_cb->open(urlpath, "rb", io->params);
+        }
     }
     if (fp == NULL) {
       BLOSC_TRACE_ERROR("Error opening file in: %s", urlpath);
+      free(urlpath_cpy);
       return NULL;
     }
-    io_cb->seek(fp, offset, SEEK_SET);
-    int64_t rbytes = io_cb->read(header, 1, FRAME_HEADER_MINLEN, fp);
-    if (rbytes != FRAME_HEADER_MINLEN) {
+    header = malloc(FRAME_OPEN_READAHEAD);
+    int64_t rbytes = io_pread(io_cb, header, 1, FRAME_OPEN_READAHEAD, offset, fp);
+    if (rbytes < FRAME_HEADER_MINLEN) {
         BLOSC_TRACE_ERROR("Cannot read from file '%s'.", urlpath);
         io_cb->close(fp);
+        free(header);
         free(urlpath_cpy);
         return NULL;
     }
     int64_t frame_len;
     to_big(&frame_len, header + FRAME_LEN, sizeof(frame_len));
+    if (frame_len < FRAME_HEADER_MINLEN + FRAME_TRAILER_MINLEN) {
+        BLOSC_TRACE_ERROR("The frame in file '%s' is too short.", urlpath);
+        io_cb->close(fp);
+        free(header);
+        free(urlpath_cpy);
+        return NULL;
+    }
 
     blosc2_frame_s* frame = calloc(1, sizeof(blosc2_frame_s));
     frame->urlpath = urlpath_cpy;
     frame->len = frame_len;
     frame->sframe = sframe;
     frame->file_offset = offset;
+    frame->open_head = header;
+    frame->open_head_len = rbytes < frame_len ? rbytes : frame_len;
 
-    // Now, the trailer length
-    io_cb->seek(fp, offset + frame_len - FRAME_TRAILER_MINLEN, SEEK_SET);
-    rbytes = io_cb->read(trailer, 1, FRAME_TRAILER_MINLEN, fp);
-    io_cb->close(fp);
-    if (rbytes != FRAME_TRAILER_MINLEN) {
-        BLOSC_TRACE_ERROR("Cannot read from file '%s'.", urlpath);
-        free(urlpath_cpy);
-        free(frame);
-        return NULL;
+    // Now, the trailer length (at the end of what has been read already for small frames)
+    int64_t tail_len = frame_len < FRAME_OPEN_READAHEAD ? frame_len : FRAME_OPEN_READAHEAD;
+    if (frame->open_head_len == frame_len) {
+        trailer = header + frame_len - tail_len;
+    }
+    else {
+        trailer = malloc(tail_len);
+        frame->open_tail = trailer;
+        frame->open_tail_offset = frame_len - tail_len;
+        frame->open_tail_len = tail_len;
+        rbytes = io_pread(io_cb, trailer, 1, tail_len, offset + frame_len - tail_len, fp);
+        if (rbytes != tail_len) {
+            BLOSC_TRACE_ERROR("Cannot read from file '%s'.", urlpath);
+            io_cb->close(fp);
+            frame_free(frame);
+            return NULL;
+        }
     }
-    int trailer_offset = FRAME_TRAILER_MINLEN - FRAME_TRAILER_LEN_OFFSET;
+    io_cb->close(fp);
+    int trailer_offset = (int) tail_len - FRAME_TRAILER_LEN_OFFSET;
     if (trailer[trailer_offset - 1] != 0xce) {
-        free(urlpath_cpy);
-        free(frame);
+        frame_free(frame);
         return NULL;
     }
     uint32_t trailer_len;
@@ -897,127 +1220,695 @@ blosc2_frame_s* frame_from_cframe(uint8_t *cframe, int64_t len, bool copy) {
 
   if (copy) {
     frame->cframe = malloc((size_t)len);
+    hugepages_advise(frame->cframe, (size_t)len);
     memcpy(frame->cframe, cframe, (size_t)len);
   }
   else {
     frame->cframe = cframe;
     frame->avoid_cframe_free = true;
   }
+  frame->cframe_cap = len;
 
   return frame;
 }
 
 
-/* Create a frame out of a super-chunk. */
-int64_t frame_from_schunk(blosc2_schunk *schunk, blosc2_frame_s *frame) {
-  frame->file_offset = 0;
-  int64_t nchunks = schunk->nchunks;
-  int64_t cbytes = schunk->cbytes;
-  int32_t chunk_cbytes;
-  int32_t chunk_nbytes;
-  void* fp = NULL;
-  int rc;
+/* Store the `nbytes` low bytes of `value` in little endian */
+static void store_le(uint8_t* dest, uint64_t value, int nbytes) {
+  for (int i = 0; i < nbytes; i++) {
+    dest[i] = (uint8_t)(value >> (8 * i));
+  }
+}
 
-  uint8_t* h2 = new_header_frame(schunk, frame);
-  if (h2 == NULL) {
-    return BLOSC2_ERROR_DATA;
+static uint64_t load_le(const uint8_t* src, int nbytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < nbytes; i++) {
+    value |= (uint64_t)src[i] << (8 * i);
   }
-  uint32_t h2len;
-  from_big(&h2len, h2 + FRAME_HEADER_LEN, sizeof(h2len));
-  // Build the offsets chunk
-  int32_t chunksize = -1;
-  int32_t off_cbytes = 0;
-  uint64_t coffset = 0;
-  int32_t off_nbytes = (int32_t) (nchunks * sizeof(int64_t));
-  uint64_t* data_tmp = malloc(off_nbytes);
-  bool needs_free = false;
-  for (int i = 0; i < nchunks; i++) {
-    uint8_t* data_chunk;
-    data_chunk = schunk->data[i];
-    rc = blosc2_cbuffer_sizes(data_chunk, &chunk_nbytes, &chunk_cbytes, NULL);
-    if (rc < 0) {
-      return rc;
-    }
-    data_tmp[i] = coffset;
-    coffset += chunk_cbytes;
-    int32_t chunksize_ = chunk_nbytes;
-    if (i == 0) {
-      chunksize = chunksize_;
-    }
-    else if (chunksize != chunksize_) {
-      // Variable size  // TODO: update flags for this (or do not use them at all)
-      chunksize = 0;
-    }
-    if (needs_free) {
-      free(data_chunk);
-    }
+  return value;
+}
+
+/* Write the `nbits` low bits of `value` at bit `bitpos` of `dest` (which starts zeroed) */
+static void write_bits(uint8_t* dest, int64_t bitpos, int nbits, uint64_t value) {
+  int done = 0;
+  while (done < nbits) {
+    int shift = (int)(bitpos % 8);
+    int n = nbits - done < 8 - shift ? nbits - done : 8 - shift;
+    dest[bitpos / 8] |= (uint8_t)(((value >> done) & ((1u << n) - 1)) << shift);
+    done += n;
+    bitpos += n;
   }
-  if ((int64_t)coffset != cbytes) {
-    free(data_tmp);
-    return BLOSC2_ERROR_DATA;
+}
+
+static uint64_t read_bits(const uint8_t* src, int64_t bitpos, int nbits) {
+  if (nbits == 0) {
+    return 0;
   }
-  uint8_t *off_chunk = NULL;
-  if (nchunks > 0) {
-    // Compress the chunk of offsets
-    off_chunk = malloc(off_nbytes + BLOSC2_MAX_OVERHEAD);
-    blosc2_context *cctx = blosc2_create_cctx(BLOSC2_CPARAMS_DEFAULTS);
-    if (cctx == NULL) {
-      BLOSC_TRACE_ERROR("Error while creating the compression context");
-      return BLOSC2_ERROR_NULL_POINTER;
-    }
-    cctx->typesize = sizeof(int64_t);
-    off_cbytes = blosc2_compress_ctx(cctx, data_tmp, off_nbytes, off_chunk,
-                                     off_nbytes + BLOSC2_MAX_OVERHEAD);
-    blosc2_free_ctx(cctx);
-    if (off_cbytes < 0) {
-      free(off_chunk);
-      free(h2);
-      return off_cbytes;
-    }
+  const uint8_t* p = src + bitpos / 8;
+  int shift = (int)(bitpos % 8);
+  int nbytes = (shift + nbits + 7) / 8;  // up to 9
+  uint64_t value = load_le(p, nbytes < 8 ? nbytes : 8) >> shift;
+  if (nbytes > 8) {
+    value |= (uint64_t)p[8] << (64 - shift);
   }
-  else {
-    off_cbytes = 0;
+  return nbits < 64 ? value & (((uint64_t)1 << nbits) - 1) : value;
+}
+
+/* The parameters of a group of `n` offsets of a packed index: the offsets follow the line
+ * that goes from the first to the last one (the step is the mean delta between them), and
+ * the distances to that line are packed with respect to the smallest one (the reference).
+ * Offsets of special chunks (negative) only get the reference. */
+static int pack_group_params(const int64_t* offsets, int64_t n, int64_t* reference, int64_t* step) {
+  bool regular = true;
+  for (int64_t i = 0; i < n; i++) {
+    regular &= offsets[i] >= 0;
+  }
+  *step = regular && n > 1 && offsets[n - 1] >= offsets[0] ? (offsets[n - 1] - offsets[0]) / (n - 1) : 0;
+  *reference = offsets[0];
+  for (int64_t i = 1; i < n; i++) {
+    int64_t line = offsets[i] - i * *step;
+    *reference = line < *reference ? line : *reference;
+  }
+  uint64_t maxdist = 0;
+  for (int64_t i = 0; i < n; i++) {
+    uint64_t dist = (uint64_t)offsets[i] - (uint64_t)i * (uint64_t)*step - (uint64_t)*reference;
+    maxdist = dist > maxdist ? dist : maxdist;
+  }
+  int nbits = 0;
+  while (nbits < 64 && (maxdist >> nbits) != 0) {
+    nbits++;
+  }
+  return nbits;
+}
+
+/* Build a packed index (BLOSC2_INDEX_PACKED) out of `noffsets` offsets, or out of `noffsets`
+ * copies of `value` if `offsets` is NULL (see README_CFRAME_FORMAT.rst).  Returns a new
+ * buffer from the allocator of `ctx`, or NULL in case of errors. */
+static uint8_t* pack_offsets(blosc2_context* ctx, const int64_t* offsets, int64_t noffsets, int64_t value,
+                             int32_t* off_cbytes) {
+  int64_t ngroups = (noffsets + FRAME_PACKED_INDEX_NOFFSETS - 1) / FRAME_PACKED_INDEX_NOFFSETS;
+  uint8_t* nbits = ctx_malloc(ctx, ngroups > 0 ? ngroups : 1);
+  int64_t len = FRAME_PACKED_INDEX_HEADER_LEN + ngroups * FRAME_PACKED_INDEX_GROUP_LEN;
+  int64_t reference = value;
+  int64_t step = 0;
+  for (int64_t ngroup = 0; ngroup < ngroups; ngroup++) {
+    int64_t start = ngroup * FRAME_PACKED_INDEX_NOFFSETS;
+    int64_t n = noffsets - start < FRAME_PACKED_INDEX_NOFFSETS ? noffsets - start : FRAME_PACKED_INDEX_NOFFSETS;
+    nbits[ngroup] = offsets != NULL ? (uint8_t)pack_group_params(offsets + start, n, &reference, &step) : 0;
+    len += (n * nbits[ngroup] + 7) / 8;
+  }
+  if (len > INT32_MAX) {
+    BLOSC_TRACE_ERROR("The index of the frame is too large.");
+    ctx_free(ctx, nbits);
+    return NULL;
   }
-  free(data_tmp);
 
-  // Now that we know them, fill the chunksize and frame length in header
-  to_big(h2 + FRAME_CHUNKSIZE, &chunksize, sizeof(chunksize));
-  frame->len = h2len + cbytes + off_cbytes + FRAME_TRAILER_MINLEN;
-  if (frame->sframe) {
-    frame->len = h2len + off_cbytes + FRAME_TRAILER_MINLEN;
+  uint8_t* index = ctx_malloc(ctx, (size_t)len);
+  if (index == NULL) {
+    ctx_free(ctx, nbits);
+    return NULL;
   }
-  int64_t tbytes = frame->len;
-  to_big(h2 + FRAME_LEN, &tbytes, sizeof(tbytes));
+  memset(index, 0, (size_t)len);
+  store_le(index, (uint64_t)len, sizeof(int32_t));
+  store_le(index + 4, FRAME_PACKED_INDEX_NOFFSETS, sizeof(int32_t));
+  store_le(index + 8, (uint64_t)noffsets, sizeof(int64_t));
+  int64_t pos = FRAME_PACKED_INDEX_HEADER_LEN + ngroups * FRAME_PACKED_INDEX_GROUP_LEN;
+  for (int64_t ngroup = 0; ngroup < ngroups; ngroup++) {
+    int64_t start = ngroup * FRAME_PACKED_INDEX_NOFFSETS;
+    int64_t n = noffsets - start < FRAME_PACKED_INDEX_NOFFSETS ? noffsets - start : FRAME_PACKED_INDEX_NOFFSETS;
+    if (offsets != NULL) {
+      pack_group_params(offsets + start, n, &reference, &step);
+    }
+    uint8_t* group = index + FRAME_PACKED_INDEX_HEADER_LEN + ngroup * FRAME_PACKED_INDEX_GROUP_LEN;
+    store_le(group, (uint64_t)reference, sizeof(int64_t));
+    store_le(group + 8, (uint64_t)step, sizeof(int64_t));
+    store_le(group + 16, (uint64_t)pos, sizeof(int32_t));
+    group[20] = nbits[ngroup];
+    for (int64_t i = 0; offsets != NULL && i < n; i++) {
+      uint64_t dist = (uint64_t)offsets[start + i] - (uint64_t)i * (uint64_t)step - (uint64_t)reference;
+      write_bits(index + pos, i * nbits[ngroup], nbits[ngroup], dist);
+    }
+    pos += (n * nbits[ngroup] + 7) / 8;
+  }
+  ctx_free(ctx, nbits);
+  *off_cbytes = (int32_t)len;
+  return index;
+}
 
-  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
-  if (io_cb == NULL) {
-    BLOSC_TRACE_ERROR("Error getting the input/output API");
-    return BLOSC2_ERROR_PLUGIN_IO;
+/* The length of a packed index, which has to hold `noffsets` offsets.  Returns a negative
+ * code if it does not fit in `off_cbytes` (when not negative) or it is not consistent. */
+static int32_t packed_index_len(const uint8_t* coffsets, int32_t off_cbytes, int64_t noffsets) {
+  if (off_cbytes >= 0 && off_cbytes < FRAME_PACKED_INDEX_HEADER_LEN) {
+    return BLOSC2_ERROR_READ_BUFFER;
   }
+  int64_t len = (int64_t)load_le(coffsets, sizeof(int32_t));
+  int64_t group_noffsets = (int64_t)load_le(coffsets + 4, sizeof(int32_t));
+  int64_t ngroups = (noffsets + FRAME_PACKED_INDEX_NOFFSETS - 1) / FRAME_PACKED_INDEX_NOFFSETS;
+  if (group_noffsets != FRAME_PACKED_INDEX_NOFFSETS || (int64_t)load_le(coffsets + 8, sizeof(int64_t)) != noffsets ||
+      len < FRAME_PACKED_INDEX_HEADER_LEN + ngroups * FRAME_PACKED_INDEX_GROUP_LEN ||
+      (off_cbytes >= 0 && len > off_cbytes)) {
+    BLOSC_TRACE_ERROR("The packed index of the frame is not consistent with its %" PRId64 " chunks.", noffsets);
+    return BLOSC2_ERROR_DATA;
+  }
+  return (int32_t)len;
+}
 
-  // Create the frame and put the header at the beginning
-  if (frame->urlpath == NULL) {
-    frame->cframe = malloc((size_t)frame->len);
-    memcpy(frame->cframe, h2, h2len);
+/* Get the offset of chunk `nchunk` out of a packed index, without going through the rest */
+static int get_packed_offset(const uint8_t* coffsets, int32_t off_cbytes, int64_t nchunk, int64_t noffsets,
+                             int64_t* offset) {
+  int32_t len = packed_index_len(coffsets, off_cbytes, noffsets);
+  if (len < 0) {
+    return len;
   }
-  else {
-    if (frame->sframe) {
-      fp = sframe_open_index(frame->urlpath, "wb",
-                             frame->schunk->storage->io);
-    }
-    else {
-      fp = io_cb->open(frame->urlpath, "wb", frame->schunk->storage->io->params);
-    }
-    if (fp == NULL) {
+  if (nchunk < 0 || nchunk >= noffsets) {
+    BLOSC_TRACE_ERROR("Chunk %" PRId64 " is out of the index of the frame.", nchunk);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int64_t ngroup = nchunk / FRAME_PACKED_INDEX_NOFFSETS;
+  int64_t i = nchunk % FRAME_PACKED_INDEX_NOFFSETS;
+  const uint8_t* group = coffsets + FRAME_PACKED_INDEX_HEADER_LEN + ngroup * FRAME_PACKED_INDEX_GROUP_LEN;
+  uint64_t reference = load_le(group, sizeof(int64_t));
+  uint64_t step = load_le(group + 8, sizeof(int64_t));
+  int64_t pos = (int64_t)load_le(group + 16, sizeof(int32_t));
+  int nbits = group[20];
+  if (nbits > 64 || pos > len || (i + 1) * nbits > (len - pos) * 8) {
+    BLOSC_TRACE_ERROR("The packed index of the frame is corrupted.");
+    return BLOSC2_ERROR_DATA;
+  }
+  *offset = (int64_t)(reference + (uint64_t)i * step + read_bits(coffsets + pos, i * nbits, nbits));
+  return (int)sizeof(int64_t);
+}
+
+/* Unpack the `noffsets` offsets of a packed index into `offsets`.  Returns the number of
+ * bytes unpacked, or a negative code in case of errors. */
+static int64_t unpack_offsets(const uint8_t* coffsets, int32_t off_cbytes, int64_t* offsets, int64_t noffsets) {
+  for (int64_t i = 0; i < noffsets; i++) {
+    int rc = get_packed_offset(coffsets, off_cbytes, i, noffsets, &offsets[i]);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  return noffsets * (int64_t)sizeof(int64_t);
+}
+
+
+static uint8_t* compress_offsets_chunk(blosc2_context* ctx, const int64_t* offsets, int64_t noffsets,
+                                       int32_t* off_cbytes) {
+  int32_t off_nbytes = (int32_t) (noffsets * sizeof(int64_t));
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.splitmode = BLOSC_NEVER_SPLIT;
+  cparams.typesize = sizeof(int64_t);
+  cparams.blocksize = 16 * 1024;  // based on experiments with create_frame.c bench
+  cparams.nthreads = 4;  // 4 threads seems a decent default for nowadays CPUs
+  cparams.compcode = BLOSC_BLOSCLZ;
+  cparams.allocator = ctx != NULL ? ctx->allocator_params : NULL;
+  // The index is checksummed as the chunks are
+  cparams.checksum = ctx != NULL ? ctx->checksum : BLOSC2_CHECKSUM_NONE;
+  blosc2_context* cctx = blosc2_create_cctx(cparams);
+  if (cctx == NULL) {
+    BLOSC_TRACE_ERROR("Error while creating the compression context");
+    return NULL;
+  }
+  cctx->typesize = sizeof(int64_t);  // override a possible BLOSC_TYPESIZE env variable (or chaos may appear)
+  int32_t off_destsize = off_nbytes + BLOSC2_MAX_OVERHEAD +
+                         trailer_maxlen(cparams.checksum, cparams.cipher, off_nbytes, cparams.blocksize);
+  uint8_t* off_chunk = ctx_malloc(ctx, (size_t)off_destsize);
+  *off_cbytes = blosc2_compress_ctx(cctx, offsets, off_nbytes, off_chunk, off_destsize);
+  blosc2_free_ctx(cctx);
+  if (*off_cbytes < 0) {
+    BLOSC_TRACE_ERROR("Cannot compress the offsets chunk.");
+    ctx_free(ctx, off_chunk);
+    return NULL;
+  }
+  return off_chunk;
+}
+
+
+/* Compress the chunk offsets of a frame into its index: a single chunk, or a
+ * root chunk followed by the leaf chunks for large frames, or the packed index, per `index_format`
+ * (see README_CFRAME_FORMAT.rst).  Returns a new buffer from the allocator of `ctx`,
+ * or NULL in case of errors. */
+static uint8_t* compress_offsets(blosc2_context* ctx, int index_format, const int64_t* offsets, int64_t noffsets,
+                                 int32_t* off_cbytes) {
+  if (index_format == BLOSC2_INDEX_PACKED) {
+    return pack_offsets(ctx, offsets, noffsets, 0, off_cbytes);
+  }
+  if (!index_two_levels(index_format, noffsets)) {
+    return compress_offsets_chunk(ctx, offsets, noffsets, off_cbytes);
+  }
+
+  int64_t nleaves = (noffsets + FRAME_INDEX_LEAF_NOFFSETS - 1) / FRAME_INDEX_LEAF_NOFFSETS;
+  uint8_t** leaves = ctx_malloc(ctx, nleaves * sizeof(uint8_t*));
+  int32_t* leaves_cbytes = ctx_malloc(ctx, nleaves * sizeof(int32_t));
+  // The root holds the number of offsets per leaf, and the positions of the leaves after it
+  int64_t* root = ctx_malloc(ctx, (1 + nleaves) * sizeof(int64_t));
+  root[0] = FRAME_INDEX_LEAF_NOFFSETS;
+  int64_t leaves_len = 0;
+  int64_t nleaf;
+  for (nleaf = 0; nleaf < nleaves; nleaf++) {
+    int64_t start = nleaf * FRAME_INDEX_LEAF_NOFFSETS;
+    int64_t n = noffsets - start < FRAME_INDEX_LEAF_NOFFSETS ? noffsets - start : FRAME_INDEX_LEAF_NOFFSETS;
+    leaves[nleaf] = compress_offsets_chunk(ctx, offsets + start, n, &leaves_cbytes[nleaf]);
+    if (leaves[nleaf] == NULL) {
+      break;
+    }
+    root[1 + nleaf] = leaves_len;
+    leaves_len += leaves_cbytes[nleaf];
+  }
+
+  uint8_t* index = NULL;
+  int32_t root_cbytes;
+  uint8_t* root_chunk = nleaf == nleaves ? compress_offsets_chunk(ctx, root, 1 + nleaves, &root_cbytes) : NULL;
+  if (root_chunk != NULL) {
+    if (root_cbytes + leaves_len > INT32_MAX) {
+      BLOSC_TRACE_ERROR("The index of the frame is too large.");
+    }
+    else {
+      *off_cbytes = (int32_t)(root_cbytes + leaves_len);
+      index = ctx_malloc(ctx, *off_cbytes);
+      memcpy(index, root_chunk, root_cbytes);
+      for (int64_t i = 0; i < nleaves; i++) {
+        memcpy(index + root_cbytes + root[1 + i], leaves[i], leaves_cbytes[i]);
+      }
+    }
+    ctx_free(ctx, root_chunk);
+  }
+  for (int64_t i = 0; i < nleaf; i++) {
+    ctx_free(ctx, leaves[i]);
+  }
+  ctx_free(ctx, leaves);
+  ctx_free(ctx, leaves_cbytes);
+  ctx_free(ctx, root);
+  return index;
+}
+
+
+/* Build the index of a frame whose `noffsets` chunks have all the same special `offset_value`,
+ * made of chunks of repeated values (or of groups without residuals for packed ones).  Returns a
+ * new buffer from the allocator of `ctx`, or NULL in case of errors. */
+static uint8_t* special_offsets_index(blosc2_context* ctx, int index_format, blosc2_cparams cparams, int64_t noffsets,
+                                      uint64_t* offset_value, int32_t* off_cbytes) {
+  if (index_format == BLOSC2_INDEX_PACKED) {
+    return pack_offsets(ctx, NULL, noffsets, (int64_t)*offset_value, off_cbytes);
+  }
+  int32_t leaf_cbytes = BLOSC_EXTENDED_HEADER_LENGTH + sizeof(int64_t);
+  if (!index_two_levels(index_format, noffsets)) {
+    uint8_t* off_chunk = ctx_malloc(ctx, leaf_cbytes);
+    if (blosc2_chunk_repeatval(cparams, (int32_t)(noffsets * sizeof(int64_t)), off_chunk, leaf_cbytes,
+                               offset_value) < 0) {
+      ctx_free(ctx, off_chunk);
+      return NULL;
+    }
+    *off_cbytes = leaf_cbytes;
+    return off_chunk;
+  }
+
+  int64_t nleaves = (noffsets + FRAME_INDEX_LEAF_NOFFSETS - 1) / FRAME_INDEX_LEAF_NOFFSETS;
+  int64_t* root = ctx_malloc(ctx, (1 + nleaves) * sizeof(int64_t));
+  root[0] = FRAME_INDEX_LEAF_NOFFSETS;
+  for (int64_t i = 0; i < nleaves; i++) {
+    root[1 + i] = i * leaf_cbytes;
+  }
+  int32_t root_cbytes;
+  uint8_t* root_chunk = compress_offsets_chunk(ctx, root, 1 + nleaves, &root_cbytes);
+  ctx_free(ctx, root);
+  if (root_chunk == NULL) {
+    return NULL;
+  }
+  *off_cbytes = (int32_t)(root_cbytes + nleaves * leaf_cbytes);
+  uint8_t* index = ctx_malloc(ctx, *off_cbytes);
+  memcpy(index, root_chunk, root_cbytes);
+  ctx_free(ctx, root_chunk);
+  for (int64_t i = 0; i < nleaves; i++) {
+    int64_t n = noffsets - i * FRAME_INDEX_LEAF_NOFFSETS;
+    n = n < FRAME_INDEX_LEAF_NOFFSETS ? n : FRAME_INDEX_LEAF_NOFFSETS;
+    if (blosc2_chunk_repeatval(cparams, (int32_t)(n * sizeof(int64_t)), index + root_cbytes + i * leaf_cbytes,
+                               leaf_cbytes, offset_value) < 0) {
+      ctx_free(ctx, index);
+      return NULL;
+    }
+  }
+  return index;
+}
+
+
+/* Get the leaf of a two-level index that holds the offset of chunk `nchunk`, along with
+ * the position of its first offset and its number of offsets */
+static const uint8_t* get_index_leaf(blosc2_context* ctx, const uint8_t* coffsets, int32_t off_cbytes,
+                                     int64_t noffsets, int64_t nchunk, int32_t* leaf_cbytes,
+                                     int64_t* leaf_start, int64_t* leaf_noffsets) {
+  int32_t root_cbytes;
+  int64_t leaf_len;
+  int64_t leaf_pos;
+  if (blosc2_cbuffer_sizes(coffsets, NULL, &root_cbytes, NULL) < 0 || root_cbytes > off_cbytes ||
+      ctx_getitem(ctx, coffsets, root_cbytes, 0, 1, &leaf_len, sizeof(int64_t)) < 0 || leaf_len <= 0 ||
+      nchunk < 0 || nchunk >= noffsets ||
+      ctx_getitem(ctx, coffsets, root_cbytes, (int)(1 + nchunk / leaf_len), 1, &leaf_pos, sizeof(int64_t)) < 0 ||
+      leaf_pos < 0 || leaf_pos > off_cbytes - root_cbytes - BLOSC_EXTENDED_HEADER_LENGTH) {
+    BLOSC_TRACE_ERROR("Cannot read the root of the index.");
+    return NULL;
+  }
+  const uint8_t* leaf = coffsets + root_cbytes + leaf_pos;
+  if (blosc2_cbuffer_sizes(leaf, NULL, leaf_cbytes, NULL) < 0 ||
+      *leaf_cbytes > off_cbytes - root_cbytes - leaf_pos) {
+    BLOSC_TRACE_ERROR("Cannot read a leaf of the index.");
+    return NULL;
+  }
+  *leaf_start = nchunk - nchunk % leaf_len;
+  *leaf_noffsets = noffsets - *leaf_start < leaf_len ? noffsets - *leaf_start : leaf_len;
+  return leaf;
+}
+
+
+/* Decompress the `noffsets` chunk offsets of the index of a frame into `offsets`, using
+ * the allocator of `ctx`.  Returns the number of bytes decompressed, or a negative code
+ * in case of errors. */
+static int64_t decompress_offsets(blosc2_context* ctx, int index_format, const uint8_t* coffsets, int32_t off_cbytes,
+                                  int64_t* offsets, int64_t noffsets) {
+  if (index_format == BLOSC2_INDEX_PACKED) {
+    return unpack_offsets(coffsets, off_cbytes, offsets, noffsets);
+  }
+  blosc2_dparams off_dparams = BLOSC2_DPARAMS_DEFAULTS;
+  off_dparams.allocator = ctx != NULL ? ctx->allocator_params : NULL;
+  blosc2_context *dctx = blosc2_create_dctx(off_dparams);
+  if (dctx == NULL) {
+    BLOSC_TRACE_ERROR("Error while creating the decompression context");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  int64_t dbytes;
+  if (!index_two_levels(index_format, noffsets)) {
+    dbytes = blosc2_decompress_ctx(dctx, coffsets, off_cbytes, offsets, (int32_t)(noffsets * sizeof(int64_t)));
+  }
+  else {
+    dbytes = 0;
+    while (dbytes < noffsets * (int64_t)sizeof(int64_t)) {
+      int32_t leaf_cbytes;
+      int64_t leaf_start;
+      int64_t leaf_noffsets;
+      const uint8_t* leaf = get_index_leaf(ctx, coffsets, off_cbytes, noffsets, dbytes / (int64_t)sizeof(int64_t),
+                                           &leaf_cbytes, &leaf_start, &leaf_noffsets);
+      if (leaf == NULL) {
+        dbytes = BLOSC2_ERROR_DATA;
+        break;
+      }
+      int32_t leaf_nbytes = (int32_t)(leaf_noffsets * sizeof(int64_t));
+      int rc = blosc2_decompress_ctx(dctx, leaf, leaf_cbytes, (uint8_t*)offsets + dbytes, leaf_nbytes);
+      if (rc != leaf_nbytes) {
+        dbytes = rc < 0 ? rc : BLOSC2_ERROR_DATA;
+        break;
+      }
+      dbytes += leaf_nbytes;
+    }
+  }
+  blosc2_free_ctx(dctx);
+  if (dbytes < 0) {
+    BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
+  }
+  return dbytes;
+}
+
+
+/* Get the offset of chunk `nchunk` out of the index of a frame with `noffsets` chunks,
+ * decompressing only the block (of the leaf) that holds it, or nothing for packed ones. */
+static int get_index_offset(blosc2_context* ctx, int index_format, const uint8_t* coffsets, int32_t off_cbytes,
+                            int64_t nchunk, int64_t noffsets, int64_t* offset) {
+  if (index_format == BLOSC2_INDEX_PACKED) {
+    return get_packed_offset(coffsets, off_cbytes, nchunk, noffsets, offset);
+  }
+  if (!index_two_levels(index_format, noffsets)) {
+    return ctx_getitem(ctx, coffsets, off_cbytes, (int32_t)nchunk, 1, offset, (int32_t)sizeof(int64_t));
+  }
+  int32_t leaf_cbytes;
+  int64_t leaf_start;
+  int64_t leaf_noffsets;
+  const uint8_t* leaf = get_index_leaf(ctx, coffsets, off_cbytes, noffsets, nchunk, &leaf_cbytes, &leaf_start,
+                                       &leaf_noffsets);
+  if (leaf == NULL) {
+    return BLOSC2_ERROR_DATA;
+  }
+  return ctx_getitem(ctx, leaf, leaf_cbytes, (int)(nchunk - leaf_start), 1, offset, (int32_t)sizeof(int64_t));
+}
+
+
+/* The bounds of the jobs putting the chunks of a super-chunk in a frame */
+#define FRAME_CHUNKS_MAXJOBS 64
+#define FRAME_CHUNKS_MINBYTES (1024 * 1024)
+/* The chunks of sparse frames read at a time per thread when filling a frame with them */
+#define FRAME_FILL_WINDOW 4
+
+/* The chunks of a super-chunk that are put in their places of a frame by several threads */
+typedef struct {
+  void (*dojob)(void*);   // what the jobs do with the chunks
+  blosc2_frame_s* src;    // the sparse frame where the chunks are read from (or NULL)
+  uint8_t* dest;          // where the chunks start in the frame
+  uint8_t** chunks;
+  bool* needs_free;
+  const int64_t* ids;     // the files of the chunks in src
+  int32_t* cbytes;
+  const int64_t* offsets; // where the chunks go from dest on
+  int64_t nchunks;
+  int njobs;
+} frame_chunks;
+
+typedef struct {
+  frame_chunks* fc;
+  int job;
+  int rc;
+} frame_chunks_job;
+
+/* Read the chunks of the job out of their files (the ones not read yet) */
+static void read_frame_chunks(void* data) {
+  frame_chunks_job* job = (frame_chunks_job*)data;
+  frame_chunks* fc = job->fc;
+  for (int64_t i = job->job; i < fc->nchunks && job->rc >= 0; i += fc->njobs) {
+    if (fc->chunks[i] == NULL) {
+      job->rc = fc->cbytes[i] = sframe_get_chunk(fc->src, fc->ids[i], &fc->chunks[i], &fc->needs_free[i]);
+    }
+  }
+}
+
+/* Copy the chunks of the job (a run of them of about the same bytes as the others) */
+static void copy_frame_chunks(void* data) {
+  frame_chunks_job* job = (frame_chunks_job*)data;
+  frame_chunks* fc = job->fc;
+  int64_t total = fc->offsets[fc->nchunks - 1] + fc->cbytes[fc->nchunks - 1];
+  int64_t first = total * job->job / fc->njobs;
+  int64_t last = total * (job->job + 1) / fc->njobs;
+  for (int64_t i = 0; i < fc->nchunks; i++) {
+    if (fc->offsets[i] < first || fc->offsets[i] >= last) {
+      continue;
+    }
+    memcpy(fc->dest + fc->offsets[i], fc->chunks[i], fc->cbytes[i]);
+    if (fc->needs_free != NULL && fc->needs_free[i]) {
+      free(fc->chunks[i]);
+      fc->chunks[i] = NULL;
+    }
+  }
+}
+
+static void* frame_chunks_thread(void* data) {
+  frame_chunks_job* job = (frame_chunks_job*)data;
+  job->fc->dojob(data);
+  return NULL;
+}
+
+/* Run the jobs over the chunks in the shared pool, or in threads of their own if there is
+ * no pool.  Returns the first error of the jobs, if any. */
+static int run_frame_chunks(frame_chunks* fc, void (*dojob)(void*)) {
+  fc->dojob = dojob;
+  frame_chunks_job jobs[FRAME_CHUNKS_MAXJOBS];
+  for (int i = 0; i < fc->njobs; i++) {
+    jobs[i].fc = fc;
+    jobs[i].job = i;
+    jobs[i].rc = 0;
+  }
+  if (fc->njobs == 1) {
+    dojob(&jobs[0]);
+  }
+  else if (blosc_pool_nthreads() > 0) {
+    blosc_pool_run(NULL, dojob, fc->njobs, sizeof(frame_chunks_job), jobs);
+  }
+  else {
+    pthread_t threads[FRAME_CHUNKS_MAXJOBS];
+    bool started[FRAME_CHUNKS_MAXJOBS] = {false};
+    for (int i = 1; i < fc->njobs; i++) {
+      started[i] = pthread_create(&threads[i], NULL, frame_chunks_thread, &jobs[i]) == 0;
+    }
+    dojob(&jobs[0]);
+    for (int i = 1; i < fc->njobs; i++) {
+      if (started[i]) {
+        pthread_join(threads[i], NULL);
+      }
+      else {
+        // The jobs that could not be started are run here
+        dojob(&jobs[i]);
+      }
+    }
+  }
+  for (int i = 0; i < fc->njobs; i++) {
+    if (jobs[i].rc < 0) {
+      return jobs[i].rc;
+    }
+  }
+  return 0;
+}
+
+/* The number of jobs for putting `nbytes` of chunks in a frame with `nthreads` threads */
+static int frame_chunks_njobs(int64_t nchunks, int64_t nbytes, int nthreads) {
+  int16_t pool_nthreads = blosc_pool_nthreads();
+  if (pool_nthreads > 0) {
+    nthreads = pool_nthreads;
+  }
+  int64_t njobs = nbytes / FRAME_CHUNKS_MINBYTES;
+  njobs = njobs < nthreads ? njobs : nthreads;
+  njobs = njobs < nchunks ? njobs : nchunks;
+  njobs = njobs < FRAME_CHUNKS_MAXJOBS ? njobs : FRAME_CHUNKS_MAXJOBS;
+  return njobs > 1 ? (int)njobs : 1;
+}
+
+/* Copy the chunks of `fc` (their offsets already computed) to their places */
+static void put_frame_chunks(frame_chunks* fc, int nthreads) {
+  if (fc->nchunks == 0) {
+    return;
+  }
+  int64_t nbytes = fc->offsets[fc->nchunks - 1] + fc->cbytes[fc->nchunks - 1];
+  fc->njobs = frame_chunks_njobs(fc->nchunks, nbytes, nthreads);
+  run_frame_chunks(fc, copy_frame_chunks);
+}
+
+
+/* Create a frame out of a super-chunk. */
+int64_t frame_from_schunk(blosc2_schunk *schunk, blosc2_frame_s *frame) {
+  frame->file_offset = 0;
+  int64_t nchunks = schunk->nchunks;
+  int64_t cbytes = schunk->cbytes;
+  int32_t chunk_cbytes;
+  int32_t chunk_nbytes;
+  void* fp = NULL;
+  int rc;
+
+  uint8_t* h2 = new_header_frame(schunk, frame);
+  if (h2 == NULL) {
+    return BLOSC2_ERROR_DATA;
+  }
+  uint32_t h2len;
+  from_big(&h2len, h2 + FRAME_HEADER_LEN, sizeof(h2len));
+  // Build the offsets chunk
+  int32_t chunksize = -1;
+  int32_t off_cbytes = 0;
+  uint64_t coffset = 0;
+  uint64_t* data_tmp = ctx_malloc(schunk->cctx, (size_t)nchunks * sizeof(int64_t));
+  int32_t* sizes = malloc((size_t)nchunks * sizeof(int32_t));
+  bool needs_free = false;
+  for (int i = 0; i < nchunks; i++) {
+    uint8_t* data_chunk;
+    data_chunk = schunk->data[i];
+    rc = blosc2_cbuffer_sizes(data_chunk, &chunk_nbytes, &chunk_cbytes, NULL);
+    if (rc < 0) {
+      ctx_free(schunk->cctx, data_tmp);
+      free(sizes);
+      return rc;
+    }
+    data_tmp[i] = coffset;
+    sizes[i] = chunk_cbytes;
+    coffset += chunk_cbytes;
+    int32_t chunksize_ = chunk_nbytes;
+    if (i == 0) {
+      chunksize = chunksize_;
+    }
+    else if (chunksize != chunksize_) {
+      // Variable size  // TODO: update flags for this (or do not use them at all)
+      chunksize = 0;
+    }
+    if (needs_free) {
+      free(data_chunk);
+    }
+  }
+  if ((int64_t)coffset != cbytes) {
+    ctx_free(schunk->cctx, data_tmp);
+    free(sizes);
+    return BLOSC2_ERROR_DATA;
+  }
+  uint8_t *off_chunk = NULL;
+  if (nchunks > 0) {
+    // Compress the index of offsets
+    off_chunk = compress_offsets(schunk->cctx, frame->index_format, (int64_t*)data_tmp, nchunks, &off_cbytes);
+    if (off_chunk == NULL) {
+      ctx_free(schunk->cctx, data_tmp);
+      free(sizes);
+      free(h2);
+      return BLOSC2_ERROR_DATA;
+    }
+  }
+  else {
+    off_cbytes = 0;
+  }
+
+  // Now that we know them, fill the chunksize and frame length in header
+  to_big(h2 + FRAME_CHUNKSIZE, &chunksize, sizeof(chunksize));
+  frame->len = h2len + cbytes + off_cbytes + FRAME_TRAILER_MINLEN;
+  if (frame->sframe) {
+    frame->len = h2len + off_cbytes + FRAME_TRAILER_MINLEN;
+  }
+  int64_t tbytes = frame->len;
+  to_big(h2 + FRAME_LEN, &tbytes, sizeof(tbytes));
+
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    ctx_free(schunk->cctx, data_tmp);
+    free(sizes);
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+
+  // Create the frame and put the header at the beginning
+  if (frame->urlpath == NULL) {
+    frame->cframe = malloc((size_t)frame->len);
+    frame->cframe_cap = frame->len;
+    hugepages_advise(frame->cframe, (size_t)frame->len);
+    memcpy(frame->cframe, h2, h2len);
+    // The offsets of the chunks are known, so they are copied to their places by several threads
+    frame_chunks fc = {.dest=frame->cframe + h2len, .chunks=schunk->data, .cbytes=sizes,
+                       .offsets=(int64_t*)data_tmp, .nchunks=nchunks};
+    put_frame_chunks(&fc, schunk->cctx->nthreads);
+  }
+  else {
+    frame_invalidate_caches(frame);
+    if (frame->sframe) {
+      fp = sframe_open_index(frame->urlpath, "wb",
+                             frame->schunk->storage->io);
+      if (fp != NULL && frame->index_log) {
+        // The log starts empty, along with the index
+        void* fp_log = sframe_open_index_log(frame->urlpath, "wb", frame->schunk->storage->io);
+        if (fp_log == NULL) {
+          BLOSC_TRACE_ERROR("Error creating the index log in: %s", frame->urlpath);
+          io_cb->close(fp);
+          free(h2);
+          ctx_free(schunk->cctx, data_tmp);
+          free(sizes);
+          return BLOSC2_ERROR_FILE_OPEN;
+        }
+        io_cb->close(fp_log);
+        frame->index_log_nentries = 0;
+      }
+    }
+    else {
+      fp = io_cb->open(frame->urlpath, "wb", frame->schunk->storage->io->params);
+    }
+    if (fp == NULL) {
       BLOSC_TRACE_ERROR("Error creating file in: %s", frame->urlpath);
+      ctx_free(schunk->cctx, data_tmp);
+      free(sizes);
       return BLOSC2_ERROR_FILE_OPEN;
     }
     io_cb->write(h2, h2len, 1, fp);
   }
   free(h2);
+  ctx_free(schunk->cctx, data_tmp);
+  free(sizes);
 
-  // Fill the frame with the actual data chunks
-  if (!frame->sframe) {
+  // Fill the frame on disk with the actual data chunks (the ones in memory are there already)
+  if (!frame->sframe && frame->urlpath != NULL) {
     coffset = 0;
     for (int i = 0; i < nchunks; i++) {
       uint8_t* data_chunk = schunk->data[i];
@@ -1025,11 +1916,7 @@ int64_t frame_from_schunk(blosc2_schunk *schunk, blosc2_frame_s *frame) {
       if (rc < 0) {
         return rc;
       }
-      if (frame->urlpath == NULL) {
-        memcpy(frame->cframe + h2len + coffset, data_chunk, (size_t)chunk_cbytes);
-      } else {
-        io_cb->write(data_chunk, chunk_cbytes, 1, fp);
-      }
+      io_cb->write(data_chunk, chunk_cbytes, 1, fp);
       coffset += chunk_cbytes;
     }
     if ((int64_t)coffset != cbytes) {
@@ -1045,7 +1932,7 @@ int64_t frame_from_schunk(blosc2_schunk *schunk, blosc2_frame_s *frame) {
     io_cb->write(off_chunk, off_cbytes, 1, fp);
     io_cb->close(fp);
   }
-  free(off_chunk);
+  ctx_free(schunk->cctx, off_chunk);
   rc = frame_update_trailer(frame, schunk);
   if (rc < 0) {
     return rc;
@@ -1062,12 +1949,25 @@ uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
   int rc;
 
   if (frame->coffsets != NULL) {
-    if (off_cbytes != NULL) {
+    if (off_cbytes != NULL && frame->index_format == BLOSC2_INDEX_PACKED) {
+      *off_cbytes = packed_index_len(frame->coffsets, -1, nchunks);
+      if (*off_cbytes < 0) {
+        return NULL;
+      }
+    }
+    else if (off_cbytes != NULL) {
       rc = blosc2_cbuffer_sizes(frame->coffsets, NULL, &chunk_cbytes, NULL);
       if (rc < 0) {
         return NULL;
       }
       *off_cbytes = (int32_t)chunk_cbytes;
+      if (index_two_levels(frame->index_format, nchunks)) {
+        // The leaves follow the root, up to the trailer
+        *off_cbytes = (int32_t)(get_trailer_offset(frame, header_len, true) - header_len);
+        if (!frame->sframe) {
+          *off_cbytes -= (int32_t)cbytes;
+        }
+      }
     }
     return frame->coffsets;
   }
@@ -1076,6 +1976,21 @@ uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
     if (cbytes < INT64_MAX - header_len) {
       off_pos += cbytes;
     }
+    if (frame->index_format == BLOSC2_INDEX_PACKED) {
+      if (off_pos < 0 || off_pos > frame->len - FRAME_PACKED_INDEX_HEADER_LEN) {
+        BLOSC_TRACE_ERROR("Cannot read the offsets outside of frame boundary.");
+        return NULL;
+      }
+      int32_t len = packed_index_len(frame->cframe + off_pos, (int32_t)(frame->len - off_pos < INT32_MAX ?
+                                     frame->len - off_pos : INT32_MAX), nchunks);
+      if (len < 0) {
+        return NULL;
+      }
+      if (off_cbytes != NULL) {
+        *off_cbytes = len;
+      }
+      return frame->cframe + off_pos;
+    }
     // Check that there is enough room to read Blosc header
     if (off_pos < 0 || off_pos > INT64_MAX - BLOSC_EXTENDED_HEADER_LENGTH ||
         off_pos + BLOSC_EXTENDED_HEADER_LENGTH > frame->len) {
@@ -1092,11 +2007,17 @@ uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
         return NULL;
       }
       *off_cbytes = (int32_t)chunk_cbytes;
+      int64_t idx_nbytes = (int64_t)nchunks * (int64_t)sizeof(int64_t);
+      if (index_two_levels(frame->index_format, nchunks)) {
+        // The leaves follow the root, up to the trailer
+        *off_cbytes = (int32_t)(get_trailer_offset(frame, header_len, true) - off_pos);
+        idx_nbytes = chunk_nbytes;  // the root is checked on lookups
+      }
       if (*off_cbytes < 0 || off_pos + *off_cbytes > frame->len) {
         BLOSC_TRACE_ERROR("Cannot read the cbytes outside of frame boundary.");
         return NULL;
       }
-      if ((uint64_t)chunk_nbytes != nchunks * sizeof(int64_t)) {
+      if ((int64_t)chunk_nbytes != idx_nbytes) {
         BLOSC_TRACE_ERROR("The number of chunks in offset idx "
                           "does not match the ones in the header frame.");
         return NULL;
@@ -1125,6 +2046,16 @@ uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
     *off_cbytes = coffsets_cbytes;
   }
 
+  // The offsets are right before the trailer, so they usually come with the end read when opening
+  const uint8_t* open_coffsets = frame_open_read(frame, frame->sframe ? header_len : header_len + cbytes,
+                                                 coffsets_cbytes);
+  if (open_coffsets != NULL) {
+    frame->coffsets = malloc((size_t)coffsets_cbytes);
+    memcpy(frame->coffsets, open_coffsets, coffsets_cbytes);
+    frame->coffsets_len = coffsets_cbytes;
+    return frame->coffsets;
+  }
+
   blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
   if (io_cb == NULL) {
     BLOSC_TRACE_ERROR("Error getting the input/output API");
@@ -1132,6 +2063,7 @@ uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
   }
 
   void* fp = NULL;
+  int64_t position;
   uint8_t* coffsets = malloc((size_t)coffsets_cbytes);
   if (frame->sframe) {
     fp = sframe_open_index(frame->urlpath, "rb",
@@ -1140,7 +2072,7 @@ uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
       BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
       return NULL;
     }
-    io_cb->seek(fp, header_len + 0, SEEK_SET);
+    position = header_len + 0;
   }
   else {
     fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
@@ -1148,9 +2080,9 @@ uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
       BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
       return NULL;
     }
-    io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
+    position = frame->file_offset + header_len + cbytes;
   }
-  int64_t rbytes = io_cb->read(coffsets, 1, coffsets_cbytes, fp);
+  int64_t rbytes = io_pread(io_cb, coffsets, 1, coffsets_cbytes, position, fp);
   io_cb->close(fp);
   if (rbytes != coffsets_cbytes) {
     BLOSC_TRACE_ERROR("Cannot read the offsets out of the frame.");
@@ -1158,6 +2090,7 @@ uint8_t* get_coffsets(blosc2_frame_s *frame, int32_t header_len, int64_t cbytes,
     return NULL;
   }
   frame->coffsets = coffsets;
+  frame->coffsets_len = coffsets_cbytes;
   return coffsets;
 }
 
@@ -1187,22 +2120,18 @@ int64_t* blosc2_frame_get_offsets(blosc2_schunk *schunk) {
     return NULL;
   }
 
-  int32_t off_nbytes = (int32_t) (nchunks * sizeof(int64_t));
-  int64_t* offsets = (int64_t *) malloc((size_t)off_nbytes);
+  size_t off_nbytes = (size_t)nchunks * sizeof(int64_t);
+  int64_t* offsets = (int64_t *) malloc(off_nbytes);
+  if (frame->bulk_pending) {
+    // The offsets are not in the frame yet
+    memcpy(offsets, frame->offsets, off_nbytes);
+    return offsets;
+  }
 
   int32_t coffsets_cbytes = 0;
   uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
-  // Decompress offsets
-  blosc2_dparams off_dparams = BLOSC2_DPARAMS_DEFAULTS;
-  blosc2_context *dctx = blosc2_create_dctx(off_dparams);
-  if (dctx == NULL) {
-    BLOSC_TRACE_ERROR("Error while creating the decompression context");
-    return NULL;
-  }
-  int32_t prev_nbytes = blosc2_decompress_ctx(dctx, coffsets, coffsets_cbytes,
-                                              offsets, off_nbytes);
-  blosc2_free_ctx(dctx);
-  if (prev_nbytes < 0) {
+  if (coffsets == NULL || decompress_offsets(schunk->dctx, frame->index_format,
+                                             coffsets, coffsets_cbytes, offsets, nchunks) < 0) {
     free(offsets);
     BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
     return NULL;
@@ -1212,6 +2141,13 @@ int64_t* blosc2_frame_get_offsets(blosc2_schunk *schunk) {
 
 
 int frame_update_header(blosc2_frame_s* frame, blosc2_schunk* schunk, bool new) {
+  if (frame->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(frame);
+    if (rc_ < 0) {
+      return rc_;
+    }
+  }
   uint8_t* framep = frame->cframe;
   uint8_t header[FRAME_HEADER_MINLEN];
 
@@ -1282,7 +2218,10 @@ int frame_update_header(blosc2_frame_s* frame, blosc2_schunk* schunk, bool new)
 
   void* fp = NULL;
   if (frame->cframe == NULL) {
-    // Write updated header down to file
+    // Write updated header down to file (and forget the cached one)
+    free(frame->header);
+    frame->header = NULL;
+    frame_forget_open_reads(frame);
     if (frame->sframe) {
       fp = sframe_open_index(frame->urlpath, "rb+",
                              frame->schunk->storage->io);
@@ -1294,13 +2233,14 @@ int frame_update_header(blosc2_frame_s* frame, blosc2_schunk* schunk, bool new)
       BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
       return BLOSC2_ERROR_FILE_OPEN;
     }
-    io_cb->seek(fp, frame->file_offset, SEEK_SET);
-    io_cb->write(h2, h2len, 1, fp);
+    io_pwrite(io_cb, h2, h2len, 1, frame->file_offset, fp);
     io_cb->close(fp);
   }
   else {
-    if (new) {
-      frame->cframe = realloc(frame->cframe, h2len);
+    if (new && frame_reserve(frame, h2len) == NULL) {
+      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      free(h2);
+      return BLOSC2_ERROR_MEMORY_ALLOC;
     }
     memcpy(frame->cframe, h2, h2len);
   }
@@ -1439,11 +2379,13 @@ int frame_get_metalayers(blosc2_frame_s* frame, blosc2_schunk* schunk) {
 
   // Get the header
   uint8_t* header = NULL;
+  bool needs_free = false;
   if (frame->cframe != NULL) {
     header = frame->cframe;
-  } else {
+  } else if ((header = frame_open_read(frame, 0, header_len)) == NULL) {
     int64_t rbytes = 0;
     header = malloc(header_len);
+    needs_free = true;
     blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
     if (io_cb == NULL) {
       BLOSC_TRACE_ERROR("Error getting the input/output API");
@@ -1480,23 +2422,73 @@ int frame_get_metalayers(blosc2_frame_s* frame, blosc2_schunk* schunk) {
 
   ret = get_meta_from_header(frame, schunk, header, header_len);
 
-  if (frame->cframe == NULL) {
+  if (needs_free) {
     free(header);
   }
 
   return ret;
 }
 
-static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk, uint8_t* trailer,
-                                   int32_t trailer_len) {
-
-  BLOSC_UNUSED_PARAM(frame);
-  int64_t trailer_pos = FRAME_TRAILER_VLMETALAYERS + 2;
+/* Open the file that holds the trailer of an on-disk frame for reading.  `position` is set
+ * to where the trailer (which is at `trailer_offset` in the frame) starts in the file. */
+static void* open_trailer(blosc2_frame_s* frame, blosc2_io_cb *io_cb, int64_t trailer_offset, int64_t* position) {
+  void* fp;
+  if (frame->sframe) {
+    fp = sframe_open_index(frame->urlpath, "rb", frame->schunk->storage->io);
+    *position = trailer_offset;
+  }
+  else {
+    fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
+    *position = frame->file_offset + trailer_offset;
+  }
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+  }
+  return fp;
+}
+
+/* Read the `len` bytes at `offset` of the trailer of an on-disk frame, out of the ends read
+ * when opening it if they are there */
+static int read_trailer_bytes(blosc2_frame_s* frame, blosc2_io_cb *io_cb, void* fp, int64_t position,
+                              int64_t trailer_offset, int64_t offset, int32_t len, uint8_t* dest) {
+  const uint8_t* open_bytes = frame_open_read(frame, trailer_offset + offset, len);
+  if (open_bytes != NULL) {
+    memcpy(dest, open_bytes, len);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (io_pread(io_cb, dest, 1, len, position + offset, fp) != len) {
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Populate the vlmetalayers of `schunk` out of the trailer of its frame.  If `index_len` is
+ * positive, `trailer` only holds the first `index_len` bytes (the index of the vlmetalayers),
+ * and where their contents start in the trailer is kept in `frame` for reading them on demand. */
+static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk, uint8_t* trailer,
+                                   int32_t trailer_len, int32_t index_len) {
+  bool lazy = index_len > 0;
+  int32_t buffer_len = lazy ? index_len : trailer_len;
+  // The fingerprint (if any) is the last item of the trailer
+  if (!lazy && trailer_len >= FRAME_TRAILER_MINLEN &&
+      trailer[trailer_len - FRAME_TRAILER_FINGERPRINT_TYPE] == FRAME_FINGERPRINT_64) {
+    uint64_t fingerprint;
+    from_big(&fingerprint, trailer + trailer_len - 8, sizeof(fingerprint));
+    if (fingerprint != checksum_xxh3(trailer, trailer_len - FRAME_TRAILER_LEN_OFFSET - 1)) {
+      BLOSC_TRACE_ERROR("The fingerprint of the trailer of the frame does not match its contents.");
+      return BLOSC2_ERROR_CHECKSUM;
+    }
+    // Keep on checksumming the chunks that are added to the frame
+    if (schunk->cctx != NULL) {
+      schunk->cctx->checksum = BLOSC2_CHECKSUM_XXH3;
+    }
+  }
+  int64_t trailer_pos = FRAME_TRAILER_VLMETALAYERS + 2;
   uint8_t* idxp = trailer + trailer_pos;
 
   // Get the size for the index of metalayers
   trailer_pos += 2;
-  if (trailer_len < trailer_pos) {
+  if (buffer_len < trailer_pos) {
     return BLOSC2_ERROR_READ_BUFFER;
   }
   uint16_t idx_size;
@@ -1505,7 +2497,7 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
 
   trailer_pos += 1;
   // Get the actual index of metalayers
-  if (trailer_len < trailer_pos) {
+  if (buffer_len < trailer_pos) {
     return BLOSC2_ERROR_READ_BUFFER;
   }
   if (idxp[0] != 0xde) {   // sanity check
@@ -1515,7 +2507,7 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
 
   int16_t nmetalayers;
   trailer_pos += sizeof(nmetalayers);
-  if (trailer_len < trailer_pos) {
+  if (buffer_len < trailer_pos) {
     return BLOSC2_ERROR_READ_BUFFER;
   }
   from_big(&nmetalayers, idxp, sizeof(uint16_t));
@@ -1524,11 +2516,15 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
     return BLOSC2_ERROR_DATA;
   }
   schunk->nvlmetalayers = nmetalayers;
+  if (lazy) {
+    frame->vlmeta_positions = malloc(nmetalayers * sizeof(int64_t));
+    frame->vlmeta_npositions = nmetalayers;
+  }
 
   // Populate the metalayers and its serialized values
   for (int nmetalayer = 0; nmetalayer < nmetalayers; nmetalayer++) {
     trailer_pos += 1;
-    if (trailer_len < trailer_pos) {
+    if (buffer_len < trailer_pos) {
       return BLOSC2_ERROR_READ_BUFFER;
     }
     if ((*idxp & 0xe0u) != 0xa0u) {   // sanity check
@@ -1541,7 +2537,7 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
     int8_t nslen = *idxp & (uint8_t)0x1F;
     idxp += 1;
     trailer_pos += nslen;
-    if (trailer_len < trailer_pos) {
+    if (buffer_len < trailer_pos) {
       return BLOSC2_ERROR_READ_BUFFER;
     }
     char* ns = malloc((size_t)nslen + 1);
@@ -1553,7 +2549,7 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
     // Populate the serialized value for this metalayer
     // Get the offset
     trailer_pos += 1;
-    if (trailer_len < trailer_pos) {
+    if (buffer_len < trailer_pos) {
       return BLOSC2_ERROR_READ_BUFFER;
     }
     if ((*idxp & 0xffu) != 0xd2u) {   // sanity check
@@ -1562,7 +2558,7 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
     idxp += 1;
     int32_t offset;
     trailer_pos += sizeof(offset);
-    if (trailer_len < trailer_pos) {
+    if (buffer_len < trailer_pos) {
       return BLOSC2_ERROR_READ_BUFFER;
     }
     from_big(&offset, idxp, sizeof(offset));
@@ -1571,6 +2567,14 @@ static int get_vlmeta_from_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk,
       // Offset is less than zero or exceeds trailer length
       return BLOSC2_ERROR_DATA;
     }
+    if (lazy) {
+      // The content comes after the index, and it is read when needed
+      if (offset < index_len || trailer_len < offset + 1 + 4) {
+        return BLOSC2_ERROR_DATA;
+      }
+      frame->vlmeta_positions[nmetalayer] = offset;
+      continue;
+    }
     // Go to offset and see if we have the correct marker
     uint8_t* content_marker = trailer + offset;
     if (trailer_len < offset + 1 + 4) {
@@ -1626,53 +2630,56 @@ int frame_get_vlmetalayers(blosc2_frame_s* frame, blosc2_schunk* schunk) {
 
   // Get the trailer
   uint8_t* trailer = NULL;
+  bool needs_free = false;
+  int32_t index_len = 0;
   if (frame->cframe != NULL) {
     trailer = frame->cframe + trailer_offset;
-  } else {
-    int64_t rbytes = 0;
-    trailer = malloc(trailer_len);
-
+  } else if ((trailer = frame_open_read(frame, trailer_offset, trailer_len)) == NULL) {
     blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
     if (io_cb == NULL) {
       BLOSC_TRACE_ERROR("Error getting the input/output API");
       return BLOSC2_ERROR_PLUGIN_IO;
     }
-
-    void* fp = NULL;
-    if (frame->sframe) {
-      char* eframe_name = malloc(strlen(frame->urlpath) + strlen("/chunks.b2frame") + 1);
-      sprintf(eframe_name, "%s/chunks.b2frame", frame->urlpath);
-      fp = io_cb->open(eframe_name, "rb", frame->schunk->storage->io->params);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", eframe_name);
-        free(eframe_name);
-        return BLOSC2_ERROR_FILE_OPEN;
-      }
-      free(eframe_name);
-      io_cb->seek(fp, trailer_offset, SEEK_SET);
-    }
-    else {
-      fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return BLOSC2_ERROR_FILE_OPEN;
-      }
-      io_cb->seek(fp, frame->file_offset + trailer_offset, SEEK_SET);
+    int64_t position;
+    void* fp = open_trailer(frame, io_cb, trailer_offset, &position);
+    if (fp == NULL) {
+      return BLOSC2_ERROR_FILE_OPEN;
     }
-    if (fp != NULL) {
-      rbytes = io_cb->read(trailer, 1, trailer_len, fp);
+    // Large vlmetalayers make the frame open slowly, so only the index of them is read
+    // (with the names and where their contents are), unless the fingerprint of the whole
+    // trailer has to be checked
+    uint8_t head[FRAME_TRAILER_VLMETALAYERS + 4];
+    uint8_t fingerprint_type;
+    if (read_trailer_bytes(frame, io_cb, fp, position, trailer_offset, 0, sizeof(head), head) < 0 ||
+        read_trailer_bytes(frame, io_cb, fp, position, trailer_offset, trailer_len - FRAME_TRAILER_FINGERPRINT_TYPE,
+                           1, &fingerprint_type) < 0) {
       io_cb->close(fp);
+      BLOSC_TRACE_ERROR("Cannot access the trailer out of the fileframe.");
+      return BLOSC2_ERROR_FILE_READ;
+    }
+    if (fingerprint_type != FRAME_FINGERPRINT_64) {
+      uint16_t map_size;
+      from_big(&map_size, head + FRAME_TRAILER_VLMETALAYERS + 2, sizeof(map_size));
+      index_len = FRAME_TRAILER_VLMETALAYERS + 1 + map_size;
+      if (index_len > trailer_len) {
+        index_len = trailer_len;
+      }
     }
-    if (rbytes != trailer_len) {
+    int32_t read_len = index_len > 0 ? index_len : trailer_len;
+    trailer = malloc(read_len);
+    needs_free = true;
+    int rc = read_trailer_bytes(frame, io_cb, fp, position, trailer_offset, 0, read_len, trailer);
+    io_cb->close(fp);
+    if (rc < 0) {
       BLOSC_TRACE_ERROR("Cannot access the trailer out of the fileframe.");
       free(trailer);
       return BLOSC2_ERROR_FILE_READ;
     }
   }
 
-  ret = get_vlmeta_from_trailer(frame, schunk, trailer, trailer_len);
+  ret = get_vlmeta_from_trailer(frame, schunk, trailer, trailer_len, index_len);
 
-  if (frame->cframe == NULL) {
+  if (needs_free) {
     free(trailer);
   }
 
@@ -1680,6 +2687,84 @@ int frame_get_vlmetalayers(blosc2_frame_s* frame, blosc2_schunk* schunk) {
 }
 
 
+int frame_load_vlmetalayers(blosc2_frame_s* frame, blosc2_schunk* schunk, int nvlmetalayer) {
+  if (frame == NULL || frame->vlmeta_positions == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int start = nvlmetalayer < 0 ? 0 : nvlmetalayer;
+  int stop = nvlmetalayer < 0 ? frame->vlmeta_npositions : nvlmetalayer + 1;
+  if (stop > frame->vlmeta_npositions) {
+    stop = frame->vlmeta_npositions;
+  }
+
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                           schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get the trailer info from frame.");
+    return rc;
+  }
+  int64_t trailer_offset = get_trailer_offset(frame, header_len, nbytes > 0);
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  int64_t position;
+  void* fp = open_trailer(frame, io_cb, trailer_offset, &position);
+  if (fp == NULL) {
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+
+  for (int n = start; rc >= 0 && n < stop; n++) {
+    int64_t offset = frame->vlmeta_positions[n];
+    if (offset < 0) {
+      continue;
+    }
+    // The content goes as a bin32 item
+    uint8_t marker[1 + 4];
+    int32_t content_len;
+    rc = read_trailer_bytes(frame, io_cb, fp, position, trailer_offset, offset, sizeof(marker), marker);
+    if (rc >= 0) {
+      from_big(&content_len, marker + 1, sizeof(content_len));
+      if (marker[0] != 0xc6 || content_len < 0 || offset + 1 + 4 + content_len > frame->trailer_len) {
+        rc = BLOSC2_ERROR_DATA;
+      }
+    }
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot read the vlmetalayer \"%s\".", schunk->vlmetalayers[n]->name);
+      break;
+    }
+    uint8_t* content = malloc((size_t)content_len);
+    rc = read_trailer_bytes(frame, io_cb, fp, position, trailer_offset, offset + 1 + 4, content_len, content);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot read the vlmetalayer \"%s\".", schunk->vlmetalayers[n]->name);
+      free(content);
+      break;
+    }
+    schunk->vlmetalayers[n]->content = content;
+    schunk->vlmetalayers[n]->content_len = content_len;
+    frame->vlmeta_positions[n] = -1;
+  }
+  io_cb->close(fp);
+  if (rc >= 0 && nvlmetalayer < 0) {
+    free(frame->vlmeta_positions);
+    frame->vlmeta_positions = NULL;
+    frame->vlmeta_npositions = 0;
+  }
+
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
 blosc2_storage* get_new_storage(const blosc2_storage* storage,
                                 const blosc2_cparams* cdefaults,
                                 const blosc2_dparams* ddefaults,
@@ -1766,6 +2851,10 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
     return NULL;
   }
   blosc2_storage storage = {.contiguous = copy ? false : true};
+  storage.index_format = frame->index_format;
+  storage.chunk_align = frame->chunk_align;
+  storage.shard_nchunks = frame->shard_nchunks;
+  storage.dir_levels = frame->dir_levels;
   schunk->storage = get_new_storage(&storage, cparams, dparams, udio);
   free(cparams);
   free(dparams);
@@ -1791,16 +2880,9 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
   }
 
   // Decompress offsets
-  blosc2_dparams off_dparams = BLOSC2_DPARAMS_DEFAULTS;
-  blosc2_context *dctx = blosc2_create_dctx(off_dparams);
-  if (dctx == NULL) {
-    BLOSC_TRACE_ERROR("Error while creating the decompression context");
-    return NULL;
-  }
   int64_t* offsets = (int64_t *) malloc((size_t)nchunks * sizeof(int64_t));
-  int32_t off_nbytes = blosc2_decompress_ctx(dctx, coffsets, coffsets_cbytes,
-                                             offsets, (int32_t)(nchunks * sizeof(int64_t)));
-  blosc2_free_ctx(dctx);
+  int64_t off_nbytes = decompress_offsets(schunk->dctx, frame->index_format,
+                                          coffsets, coffsets_cbytes, offsets, nchunks);
   if (off_nbytes < 0) {
     free(offsets);
     blosc2_schunk_free(schunk);
@@ -1841,6 +2923,7 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
     }
   }
   schunk->data = malloc(nchunks * sizeof(void*));
+  schunk->data_len = nchunks * sizeof(void*);
   for (int i = 0; i < nchunks; i++) {
     if (frame->cframe != NULL) {
       if (needs_free) {
@@ -1853,7 +2936,8 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
         }
       }
       else {
-       data_chunk = frame->cframe + header_len + offsets[i];
+        data_chunk = frame->cframe + header_len + offsets[i];
+        needs_free = false;
       }
       rc = blosc2_cbuffer_sizes(data_chunk, NULL, &chunk_cbytes, NULL);
       if (rc < 0) {
@@ -1872,8 +2956,8 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
         }
       }
       else {
-        io_cb->seek(fp, frame->file_offset + header_len + offsets[i], SEEK_SET);
-        rbytes = io_cb->read(data_chunk, 1, BLOSC_EXTENDED_HEADER_LENGTH, fp);
+        rbytes = io_pread(io_cb, data_chunk, 1, BLOSC_EXTENDED_HEADER_LENGTH,
+                          frame->file_offset + header_len + offsets[i], fp);
       }
       if (rbytes != BLOSC_EXTENDED_HEADER_LENGTH) {
         rc = BLOSC2_ERROR_READ_BUFFER;
@@ -1888,8 +2972,8 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
         prev_alloc = chunk_cbytes;
       }
       if (!frame->sframe) {
-        io_cb->seek(fp, frame->file_offset + header_len + offsets[i], SEEK_SET);
-        rbytes = io_cb->read(data_chunk, 1, chunk_cbytes, fp);
+        rbytes = io_pread(io_cb, data_chunk, 1, chunk_cbytes,
+                          frame->file_offset + header_len + offsets[i], fp);
         if (rbytes != chunk_cbytes) {
           rc = BLOSC2_ERROR_READ_BUFFER;
           break;
@@ -1958,6 +3042,54 @@ blosc2_schunk* frame_to_schunk(blosc2_frame_s* frame, bool copy, const blosc2_io
     return NULL;
   }
 
+  rc = schunk_load_shared_dict(schunk);
+  if (rc < 0) {
+    blosc2_schunk_free(schunk);
+    BLOSC_TRACE_ERROR("Cannot load the shared dictionary.");
+    return NULL;
+  }
+
+  rc = schunk_load_tuner(schunk);
+  if (rc < 0) {
+    blosc2_schunk_free(schunk);
+    BLOSC_TRACE_ERROR("Cannot load the state of the tuner.");
+    return NULL;
+  }
+
+  rc = schunk_load_zonemap(schunk);
+  if (rc < 0) {
+    blosc2_schunk_free(schunk);
+    BLOSC_TRACE_ERROR("Cannot load the kind of the zone maps.");
+    return NULL;
+  }
+
+  rc = schunk_load_xdelta(schunk);
+  if (rc < 0) {
+    blosc2_schunk_free(schunk);
+    BLOSC_TRACE_ERROR("Cannot load the deltas between chunks.");
+    return NULL;
+  }
+
+  if (frame->open_head != NULL || frame->open_tail != NULL) {
+    // Keep the chunk offsets if they came with the ends of the frame, but not the rest
+    int64_t coffsets_pos = frame->sframe ? header_len : header_len + cbytes;
+    int64_t trailer_offset = get_trailer_offset(frame, header_len, nchunks > 0);
+    if (!copy && frame->coffsets == NULL && nchunks > 0 &&
+        frame_open_read(frame, coffsets_pos, trailer_offset - coffsets_pos) != NULL) {
+      get_coffsets(frame, header_len, cbytes, nchunks, NULL);
+    }
+    frame_forget_open_reads(frame);
+  }
+
+  if (frame->sframe) {
+    rc = frame_replay_index_log(frame);
+    if (rc < 0) {
+      blosc2_schunk_free(schunk);
+      BLOSC_TRACE_ERROR("Cannot replay the index log.");
+      return NULL;
+    }
+  }
+
   return schunk;
 }
 
@@ -1980,9 +3112,38 @@ int sort_offset(const void* a, const void* b) {
 }
 
 
+/* Decompress the whole chunk offsets of a frame into its `offsets` cache.  In case
+ * of errors the cache is left empty, and lookups are done in `coffsets` instead. */
+static void decode_coffsets(blosc2_frame_s* frame, uint8_t* coffsets, int32_t off_cbytes, int64_t nchunks) {
+  if (nchunks <= 0) {
+    return;
+  }
+  int64_t* offsets = malloc((size_t)nchunks * sizeof(int64_t));
+  blosc2_context* dctx = frame->schunk != NULL ? frame->schunk->dctx : NULL;
+  if (decompress_offsets(dctx, frame->index_format,
+                         coffsets, off_cbytes, offsets, nchunks) != nchunks * (int64_t)sizeof(int64_t)) {
+    free(offsets);
+    return;
+  }
+  free(frame->offsets);
+  frame->offsets = offsets;
+  frame->noffsets = nchunks;
+  frame->offsets_cap = frame->noffsets;
+}
+
+
 int get_coffset(blosc2_frame_s* frame, int32_t header_len, int64_t cbytes,
                 int64_t nchunk, int64_t nchunks, int64_t *offset) {
   int32_t off_cbytes;
+  if (frame->cframe == NULL && nchunk >= 0 && nchunk < nchunks && frame->noffsets >= nchunks) {
+    // Already decoded (and, in bulk mode, not written to the frame yet)
+    *offset = frame->offsets[nchunk];
+    if (!frame->sframe && *offset > frame->len) {
+      BLOSC_TRACE_ERROR("Cannot read chunk %" PRId64 " outside of frame boundary.", nchunk);
+      return BLOSC2_ERROR_READ_BUFFER;
+    }
+    return (int)sizeof(int64_t);
+  }
   // Get the offset to nchunk
   uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &off_cbytes);
   if (coffsets == NULL) {
@@ -1990,8 +3151,22 @@ int get_coffset(blosc2_frame_s* frame, int32_t header_len, int64_t cbytes,
     return BLOSC2_ERROR_DATA;
   }
 
+  // On-disk frames keep the offsets decompressed, so lookups do not need a decompression
+  // (concurrent reads do not retry a failed decoding, as that would modify the frame)
+  if (frame->cframe == NULL && frame->noffsets < nchunks && !frame->concurrent_reads) {
+    decode_coffsets(frame, coffsets, off_cbytes, nchunks);
+  }
+
   // Get the 64-bit offset
-  int rc = blosc2_getitem(coffsets, off_cbytes, (int32_t)nchunk, 1, offset, (int32_t)sizeof(int64_t));
+  int rc;
+  if (nchunk >= 0 && nchunk < frame->noffsets) {
+    *offset = frame->offsets[nchunk];
+    rc = (int)sizeof(int64_t);
+  }
+  else {
+    blosc2_context* dctx = frame->schunk != NULL ? frame->schunk->dctx : NULL;
+    rc = get_index_offset(dctx, frame->index_format, coffsets, off_cbytes, nchunk, nchunks, offset);
+  }
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Problems retrieving a chunk offset.");
   } else if (!frame->sframe && *offset > frame->len) {
@@ -2003,44 +3178,57 @@ int get_coffset(blosc2_frame_s* frame, int32_t header_len, int64_t cbytes,
 }
 
 
-// Detect and return a chunk with special values in offsets (only zeros, NaNs and non initialized)
-int frame_special_chunk(int64_t special_value, int32_t nbytes, int32_t typesize, int32_t blocksize,
-                        uint8_t** chunk, int32_t cbytes, bool *needs_free) {
-  int rc = 0;
-  *chunk = malloc(cbytes);
-  *needs_free = true;
+// Detect and build a chunk with special values in offsets (only zeros, NaNs, non initialized and virtual)
+static int build_special_chunk(int64_t special_value, int32_t nbytes, int32_t typesize, int32_t blocksize,
+                               uint8_t* chunk, int32_t cbytes) {
+  int rc;
 
-  // Detect the kind of special value
-  uint64_t zeros_mask = (uint64_t) BLOSC2_SPECIAL_ZERO << (8 * 7);  // chunk of zeros
-  uint64_t nans_mask = (uint64_t) BLOSC2_SPECIAL_NAN << (8 * 7);  // chunk of NaNs
-  uint64_t uninit_mask = (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);  // chunk of uninit values
+  // Detect the kind of special value (the IDs are not single bits, so compare them as a whole)
+  int special_id = (int) (((uint64_t) special_value >> (8 * 7)) & BLOSC2_SPECIAL_MASK);
 
   blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
   cparams.typesize = typesize;
   cparams.blocksize = blocksize;
-  if (special_value & zeros_mask) {
-    rc = blosc2_chunk_zeros(cparams, nbytes, *chunk, cbytes);
+  if (special_id == BLOSC2_SPECIAL_ZERO) {
+    rc = blosc2_chunk_zeros(cparams, nbytes, chunk, cbytes);
     if (rc < 0) {
       BLOSC_TRACE_ERROR("Error creating a zero chunk");
     }
   }
-  else if (special_value & uninit_mask) {
-    rc = blosc2_chunk_uninit(cparams, nbytes, *chunk, cbytes);
+  else if (special_id == BLOSC2_SPECIAL_UNINIT) {
+    rc = blosc2_chunk_uninit(cparams, nbytes, chunk, cbytes);
     if (rc < 0) {
       BLOSC_TRACE_ERROR("Error creating a non initialized chunk");
     }
   }
-  else if (special_value & nans_mask) {
-    rc = blosc2_chunk_nans(cparams, nbytes, *chunk, cbytes);
+  else if (special_id == BLOSC2_SPECIAL_NAN) {
+    rc = blosc2_chunk_nans(cparams, nbytes, chunk, cbytes);
     if (rc < 0) {
       BLOSC_TRACE_ERROR("Error creating a nan chunk");
     }
   }
+  else if (special_id == BLOSC2_SPECIAL_VIRTUAL) {
+    rc = blosc2_chunk_virtual(cparams, nbytes, chunk, cbytes);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Error creating a virtual chunk");
+    }
+  }
   else {
     BLOSC_TRACE_ERROR("Special value not recognized: %" PRId64 "", special_value);
     rc = BLOSC2_ERROR_DATA;
   }
 
+  return rc;
+}
+
+
+// Detect and return a chunk with special values in offsets (only zeros, NaNs and non initialized)
+int frame_special_chunk(int64_t special_value, int32_t nbytes, int32_t typesize, int32_t blocksize,
+                        uint8_t** chunk, int32_t cbytes, bool *needs_free) {
+  *chunk = malloc(cbytes);
+  *needs_free = true;
+
+  int rc = build_special_chunk(special_value, nbytes, typesize, blocksize, *chunk, cbytes);
   if (rc < 0) {
     free(*chunk);
     *needs_free = false;
@@ -2051,6 +3239,53 @@ int frame_special_chunk(int64_t special_value, int32_t nbytes, int32_t typesize,
 }
 
 
+/* Get a chunk of a contiguous frame straight from the mapping of its file, when it
+ * is using the memory-mapped io.  The chunk is not lazy and does not need a free.
+ * Return the cbytes of the chunk, 0 if the frame is not memory-mapped or a negative
+ * value in case of errors. */
+static int32_t frame_get_mapped_chunk(blosc2_frame_s* frame, int32_t header_len, int64_t offset,
+                                      uint8_t** chunk) {
+  if (frame->cframe != NULL || frame->sframe ||
+      frame->schunk->storage->io->id != BLOSC2_IO_FILESYSTEM_MMAP) {
+    return 0;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(BLOSC2_IO_FILESYSTEM_MMAP);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+
+  int32_t chunk_cbytes = 0;
+  int64_t chunk_offset = frame->file_offset + header_len + offset;
+  uint8_t* header = blosc2_stdio_mmap_map(fp, chunk_offset, BLOSC_EXTENDED_HEADER_LENGTH);
+  if (header == NULL) {
+    BLOSC_TRACE_ERROR("Cannot read the header for chunk in the frame.");
+    chunk_cbytes = BLOSC2_ERROR_FILE_READ;
+    goto end;
+  }
+  int rc = blosc2_cbuffer_sizes(header, NULL, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    chunk_cbytes = rc;
+    goto end;
+  }
+  // Make sure that the whole chunk is in the file (and mapped)
+  *chunk = blosc2_stdio_mmap_map(fp, chunk_offset, chunk_cbytes);
+  if (*chunk == NULL) {
+    BLOSC_TRACE_ERROR("Compressed bytes exceed beyond frame length.");
+    chunk_cbytes = BLOSC2_ERROR_READ_BUFFER;
+  }
+
+  end:
+  io_cb->close(fp);
+  return chunk_cbytes;
+}
+
+
 /* Return a compressed chunk that is part of a frame in the `chunk` parameter.
  * If the frame is disk-based, a buffer is allocated for the (compressed) chunk,
  * and hence a free is needed.  You can check if the chunk requires a free with the `needs_free`
@@ -2061,6 +3296,51 @@ int frame_special_chunk(int64_t special_value, int32_t nbytes, int32_t typesize,
  * The size of the (compressed) chunk is returned.  If some problem is detected, a negative code
  * is returned instead.
 */
+/* Read the (complete) chunk at `offset` out of the file of an on-disk, contiguous
+ * frame into a new buffer.  This does not touch the frame, so that it can be used by
+ * the read-ahead thread.  Returns the size of the chunk or a negative code. */
+static int32_t frame_read_chunk(blosc2_frame_s *frame, int32_t header_len, int64_t offset,
+                                uint8_t **chunk) {
+  int32_t chunk_cbytes;
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+
+  uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+  void* fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  int64_t rbytes = io_pread(io_cb, header, 1, sizeof(header),
+                            frame->file_offset + header_len + offset, fp);
+  if (rbytes != sizeof(header)) {
+    BLOSC_TRACE_ERROR("Cannot read the cbytes for chunk in the frame.");
+    io_cb->close(fp);
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  int rc = blosc2_cbuffer_sizes(header, NULL, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot read the cbytes for chunk in the frame.");
+    io_cb->close(fp);
+    return rc;
+  }
+  *chunk = malloc(chunk_cbytes);
+  rbytes = io_pread(io_cb, *chunk, 1, chunk_cbytes, frame->file_offset + header_len + offset, fp);
+  io_cb->close(fp);
+  if (rbytes != chunk_cbytes) {
+    BLOSC_TRACE_ERROR("Cannot read the chunk out of the frame.");
+    free(*chunk);
+    *chunk = NULL;
+    return BLOSC2_ERROR_FILE_READ;
+  }
+
+  return chunk_cbytes;
+}
+
+
 int frame_get_chunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk, bool *needs_free) {
   int32_t header_len;
   int64_t frame_len;
@@ -2119,40 +3399,18 @@ int frame_get_chunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk, bool
     return sframe_get_chunk(frame, nchunk, chunk, needs_free);
   }
 
-  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
-  if (io_cb == NULL) {
-    BLOSC_TRACE_ERROR("Error getting the input/output API");
-    return BLOSC2_ERROR_PLUGIN_IO;
+  rc = frame_get_mapped_chunk(frame, header_len, offset, chunk);
+  if (rc != 0) {
+    // The chunk is memory-mapped (or there was an error)
+    return rc;
   }
 
   if (frame->cframe == NULL) {
-    uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
-    void* fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
-    if (fp == NULL) {
-      BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-      return BLOSC2_ERROR_FILE_OPEN;
-    }
-    io_cb->seek(fp, frame->file_offset + header_len + offset, SEEK_SET);
-    int64_t rbytes = io_cb->read(header, 1, sizeof(header), fp);
-    if (rbytes != sizeof(header)) {
-      BLOSC_TRACE_ERROR("Cannot read the cbytes for chunk in the frame.");
-      io_cb->close(fp);
-      return BLOSC2_ERROR_FILE_READ;
-    }
-    rc = blosc2_cbuffer_sizes(header, NULL, &chunk_cbytes, NULL);
+    rc = frame_read_chunk(frame, header_len, offset, chunk);
     if (rc < 0) {
-      BLOSC_TRACE_ERROR("Cannot read the cbytes for chunk in the frame.");
-      io_cb->close(fp);
       return rc;
     }
-    *chunk = malloc(chunk_cbytes);
-    io_cb->seek(fp, frame->file_offset + header_len + offset, SEEK_SET);
-    rbytes = io_cb->read(*chunk, 1, chunk_cbytes, fp);
-    io_cb->close(fp);
-    if (rbytes != chunk_cbytes) {
-      BLOSC_TRACE_ERROR("Cannot read the chunk out of the frame.");
-      return BLOSC2_ERROR_FILE_READ;
-    }
+    chunk_cbytes = rc;
     *needs_free = true;
   } else {
     // The chunk is in memory and just one pointer away
@@ -2168,374 +3426,3152 @@ int frame_get_chunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk, bool
 }
 
 
-/* Return a compressed chunk that is part of a frame in the `chunk` parameter.
- * If the frame is disk-based, a buffer is allocated for the (lazy) chunk,
- * and hence a free is needed.  You can check if the chunk requires a free with the `needs_free`
- * parameter.
- * If the chunk does not need a free, it means that the frame is in memory and that just a
- * pointer to the location of the chunk in memory is returned.
- *
- * The size of the (compressed, potentially lazy) chunk is returned.  If some problem is detected,
- * a negative code is returned instead.
-*/
-int frame_get_lazychunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk, bool *needs_free) {
+/* The states of the slots of the read-ahead of on-disk frames */
+#define FRAME_PREFETCH_FREE 0
+#define FRAME_PREFETCH_PENDING 1
+#define FRAME_PREFETCH_READING 2
+#define FRAME_PREFETCH_READY 3
+
+typedef struct {
+  int state;
+  int64_t nchunk;
+  int64_t offset;       // the offset of the chunk in the frame (its id for sparse frames)
   int32_t header_len;
-  int64_t frame_len;
-  int64_t nbytes;
-  int64_t cbytes;
-  int32_t blocksize;
-  int32_t chunksize;
-  int64_t nchunks;
-  int32_t typesize;
-  int32_t lazychunk_cbytes;
-  int64_t offset;
-  void* fp = NULL;
+  uint8_t *chunk;
+  int32_t cbytes;       // the size of the chunk, or a negative code if it could not be read
+} frame_prefetch_slot;
+
+struct frame_prefetcher {
+  blosc2_frame_s *frame;
+  int depth;
+  frame_prefetch_slot *slots;
+  int64_t hits;
+  int64_t misses;
+  bool stop;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cv;    // signalled on new requests, on finished reads and on stop
+};
 
-  *chunk = NULL;
-  *needs_free = false;
-  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
-                           &blocksize, &chunksize, &nchunks,
-                           &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
-                           frame->schunk->storage->io);
-  if (rc < 0) {
-    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
-    return rc;
-  }
 
-  if (nchunk >= nchunks) {
-    BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the number of chunks "
-                      "('%" PRId64 "') in frame.", nchunk, nchunks);
-    return BLOSC2_ERROR_INVALID_PARAM;
-  }
-
-  // Get the offset to nchunk
-  rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
-  if (rc < 0) {
-    BLOSC_TRACE_ERROR("Unable to get offset to chunk %" PRId64 ".", nchunk);
-    return rc;
-  }
-
-  if (offset < 0) {
-    // Special value
-    lazychunk_cbytes = BLOSC_EXTENDED_HEADER_LENGTH;
-    int32_t chunksize_ = chunksize;
-    if ((nchunk == nchunks - 1) && (nbytes % chunksize)) {
-      // Last chunk is incomplete.  Compute its actual size.
-      chunksize_ = (int32_t) (nbytes % chunksize);
-    }
-    rc = frame_special_chunk(offset, chunksize_, typesize, blocksize, chunk,
-                             (int32_t)lazychunk_cbytes, needs_free);
-    goto end;
-  }
-
-  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
-  if (io_cb == NULL) {
-    BLOSC_TRACE_ERROR("Error getting the input/output API");
-    rc = BLOSC2_ERROR_PLUGIN_IO;
-    goto end;
-  }
+static void* frame_prefetch_thread(void *arg) {
+  frame_prefetcher *pf = (frame_prefetcher *) arg;
 
-  if (frame->cframe == NULL) {
-    // TODO: make this portable across different endianness
-    // Get info for building a lazy chunk
-    int32_t chunk_nbytes;
-    int32_t chunk_cbytes;
-    int32_t chunk_blocksize;
-    uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
-    if (frame->sframe) {
-      // The chunk is not in the frame
-      fp = sframe_open_chunk(frame->urlpath, offset, "rb",
-                             frame->schunk->storage->io);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return BLOSC2_ERROR_FILE_OPEN;
-      }
-    }
-    else {
-      fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return BLOSC2_ERROR_FILE_OPEN;
+  pthread_mutex_lock(&pf->mutex);
+  while (!pf->stop) {
+    /* The pending chunks are read in order */
+    frame_prefetch_slot *slot = NULL;
+    for (int i = 0; i < pf->depth; i++) {
+      if (pf->slots[i].state == FRAME_PREFETCH_PENDING &&
+          (slot == NULL || pf->slots[i].nchunk < slot->nchunk)) {
+        slot = &pf->slots[i];
       }
-      io_cb->seek(fp, frame->file_offset + header_len + offset, SEEK_SET);
-    }
-    int64_t rbytes = io_cb->read(header, 1, BLOSC_EXTENDED_HEADER_LENGTH, fp);
-    if (rbytes != BLOSC_EXTENDED_HEADER_LENGTH) {
-      BLOSC_TRACE_ERROR("Cannot read the header for chunk in the frame.");
-      rc = BLOSC2_ERROR_FILE_READ;
-      goto end;
     }
-    rc = blosc2_cbuffer_sizes(header, &chunk_nbytes, &chunk_cbytes, &chunk_blocksize);
-    if (rc < 0) {
-      goto end;
+    if (slot == NULL) {
+      pthread_cond_wait(&pf->cv, &pf->mutex);
+      continue;
     }
-    size_t nblocks = chunk_nbytes / chunk_blocksize;
-    size_t leftover_block = chunk_nbytes % chunk_blocksize;
-    nblocks = leftover_block ? nblocks + 1 : nblocks;
-    // Allocate space for the lazy chunk
-    int32_t trailer_len;
-    int32_t special_type = (header[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
-    int memcpyed = header[BLOSC2_CHUNK_FLAGS] & (uint8_t) BLOSC_MEMCPYED;
+    slot->state = FRAME_PREFETCH_READING;
+    int64_t offset = slot->offset;
+    int32_t header_len = slot->header_len;
+    pthread_mutex_unlock(&pf->mutex);
 
-    int32_t trailer_offset = BLOSC_EXTENDED_HEADER_LENGTH;
-    size_t streams_offset = BLOSC_EXTENDED_HEADER_LENGTH;
-    if (special_type == 0) {
-      // Regular values have offsets for blocks
-      trailer_offset += (int32_t) (nblocks * sizeof(int32_t));
-      if (memcpyed) {
-        streams_offset += 0;
-      } else {
-        streams_offset += nblocks * sizeof(int32_t);
-      }
-      trailer_len = (int32_t) (sizeof(int32_t) + sizeof(int64_t) + nblocks * sizeof(int32_t));
-      lazychunk_cbytes = trailer_offset + trailer_len;
-    }
-    else if (special_type == BLOSC2_SPECIAL_VALUE) {
-      trailer_offset += typesize;
-      streams_offset += typesize;
-      trailer_len = 0;
-      lazychunk_cbytes = trailer_offset + trailer_len;
+    uint8_t *chunk = NULL;
+    int32_t cbytes;
+    if (pf->frame->sframe) {
+      bool needs_free;
+      cbytes = sframe_get_chunk(pf->frame, offset, &chunk, &needs_free);
     }
     else {
-      rc = BLOSC2_ERROR_INVALID_HEADER;
-      goto end;
+      cbytes = frame_read_chunk(pf->frame, header_len, offset, &chunk);
     }
-    *chunk = malloc(lazychunk_cbytes);
-    *needs_free = true;
 
-    // Read just the full header and bstarts section too (lazy partial length)
-    if (frame->sframe) {
-      io_cb->seek(fp, 0, SEEK_SET);
+    /* The chunks that do not fit in the memory budget are left for the regular read */
+    if (cbytes > 0 && !membudget_charge(cbytes)) {
+      cbytes = 0;
     }
-    else {
-      io_cb->seek(fp, frame->file_offset + header_len + offset, SEEK_SET);
+    pthread_mutex_lock(&pf->mutex);
+    if (cbytes <= 0) {
+      free(chunk);
+      chunk = NULL;
     }
+    slot->chunk = chunk;
+    slot->cbytes = cbytes;
+    slot->state = FRAME_PREFETCH_READY;
+    pthread_cond_broadcast(&pf->cv);
+  }
+  pthread_mutex_unlock(&pf->mutex);
 
-    rbytes = io_cb->read(*chunk, 1, (int64_t)streams_offset, fp);
-    if (rbytes != (int64_t)streams_offset) {
-      BLOSC_TRACE_ERROR("Cannot read the (lazy) chunk out of the frame.");
-      rc = BLOSC2_ERROR_FILE_READ;
-      goto end;
-    }
-    if (special_type == BLOSC2_SPECIAL_VALUE) {
-      // Value runlen is not returning a lazy chunk.  We are done.
-      goto end;
-    }
+  return NULL;
+}
 
-    // Mark chunk as lazy
-    uint8_t* blosc2_flags = *chunk + BLOSC2_CHUNK_BLOSC2_FLAGS;
-    *blosc2_flags |= 0x08U;
 
-    // Add the trailer (currently, nchunk + offset + block_csizes)
-    if (frame->sframe) {
-      *(int32_t*)(*chunk + trailer_offset) = (int32_t)offset;   // offset is nchunk for sframes
-      *(int64_t*)(*chunk + trailer_offset + sizeof(int32_t)) = offset;
-    }
-    else {
-      *(int32_t*)(*chunk + trailer_offset) = (int32_t)nchunk;
-      *(int64_t*)(*chunk + trailer_offset + sizeof(int32_t)) = header_len + offset;
-    }
+static void prefetch_slot_free(frame_prefetch_slot *slot) {
+  if (slot->chunk != NULL) {
+    membudget_release(slot->cbytes);
+  }
+  free(slot->chunk);
+  slot->chunk = NULL;
+  slot->state = FRAME_PREFETCH_FREE;
+}
 
-    int32_t* block_csizes = malloc(nblocks * sizeof(int32_t));
 
-    if (memcpyed) {
-      // When memcpyed the blocksizes are trivial to compute
-      for (int i = 0; i < (int)nblocks - 1; i++) {
-        block_csizes[i] = (int)chunk_blocksize;
-      }
-      // The last block could be incomplete, mainly due to the fact that the block size is not divisible
-      // by the typesize
-      block_csizes[nblocks - 1] = (int32_t)leftover_block ? (int32_t)leftover_block : chunk_blocksize;
-    }
-    else {
-      // In regular, compressed chunks, we need to sort the bstarts (they can be out
-      // of order because of multi-threading), and get a reverse index too.
-      memcpy(block_csizes, *chunk + BLOSC_EXTENDED_HEADER_LENGTH, nblocks * sizeof(int32_t));
-      // Helper structure to keep track of original indexes
-      struct csize_idx *csize_idx = malloc(nblocks * sizeof(struct csize_idx));
-      for (int n = 0; n < (int)nblocks; n++) {
-        csize_idx[n].val = block_csizes[n];
-        csize_idx[n].idx = n;
-      }
-      qsort(csize_idx, nblocks, sizeof(struct csize_idx), &sort_offset);
-      // Compute the actual csizes
-      int idx;
-      for (int n = 0; n < (int)nblocks - 1; n++) {
-        idx = csize_idx[n].idx;
-        block_csizes[idx] = csize_idx[n + 1].val - csize_idx[n].val;
-      }
-      idx = csize_idx[nblocks - 1].idx;
-      block_csizes[idx] = (int)chunk_cbytes - csize_idx[nblocks - 1].val;
-      free(csize_idx);
+void frame_prefetch_clear(blosc2_frame_s *frame) {
+  frame_prefetcher *pf = frame->prefetcher;
+  if (pf == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&pf->mutex);
+  for (int i = 0; i < pf->depth; i++) {
+    frame_prefetch_slot *slot = &pf->slots[i];
+    while (slot->state == FRAME_PREFETCH_READING) {
+      pthread_cond_wait(&pf->cv, &pf->mutex);
     }
-    // Copy the csizes at the end of the trailer
-    void *trailer_csizes = *chunk + lazychunk_cbytes - nblocks * sizeof(int32_t);
-    memcpy(trailer_csizes, block_csizes, nblocks * sizeof(int32_t));
-    free(block_csizes);
-  } else {
-    // The chunk is in memory and just one pointer away
-    int64_t chunk_header_offset = header_len + offset;
-    int64_t chunk_cbytes_offset = chunk_header_offset + BLOSC_MIN_HEADER_LENGTH;
+    prefetch_slot_free(slot);
+  }
+  pthread_mutex_unlock(&pf->mutex);
+}
 
-    *chunk = frame->cframe + chunk_header_offset;
 
-    if (chunk_cbytes_offset > frame->len) {
-      BLOSC_TRACE_ERROR("Cannot read the header for chunk in the (contiguous) frame.");
-      rc = BLOSC2_ERROR_READ_BUFFER;
-    } else {
-      rc = blosc2_cbuffer_sizes(*chunk, NULL, &lazychunk_cbytes, NULL);
-      if (rc && chunk_cbytes_offset + lazychunk_cbytes > frame_len) {
-        BLOSC_TRACE_ERROR("Compressed bytes exceed beyond frame length.");
-        rc = BLOSC2_ERROR_READ_BUFFER;
-      }
-    }
+int frame_set_prefetch(blosc2_frame_s *frame, int depth) {
+  if (depth < 0) {
+    BLOSC_TRACE_ERROR("The read-ahead depth cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
 
-  end:
-  if (fp != NULL) {
-    io_cb->close(fp);
+  if (depth > 0 && frame->concurrent_reads) {
+    BLOSC_TRACE_ERROR("The read-ahead cannot be used with concurrent reads.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  frame_prefetcher *pf = frame->prefetcher;
+  if (pf != NULL) {
+    pthread_mutex_lock(&pf->mutex);
+    pf->stop = true;
+    pthread_cond_broadcast(&pf->cv);
+    pthread_mutex_unlock(&pf->mutex);
+    pthread_join(pf->thread, NULL);
+    for (int i = 0; i < pf->depth; i++) {
+      prefetch_slot_free(&pf->slots[i]);
+    }
+    pthread_cond_destroy(&pf->cv);
+    pthread_mutex_destroy(&pf->mutex);
+    free(pf->slots);
+    free(pf);
+    frame->prefetcher = NULL;
+  }
+  // Chunks of in-memory frames are just one pointer away
+  if (depth == 0 || frame->cframe != NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  pf = calloc(1, sizeof(frame_prefetcher));
+  BLOSC_ERROR_NULL(pf, BLOSC2_ERROR_MEMORY_ALLOC);
+  pf->slots = calloc(depth, sizeof(frame_prefetch_slot));
+  if (pf->slots == NULL) {
+    free(pf);
+    BLOSC_TRACE_ERROR("Error allocating memory!");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  pf->frame = frame;
+  pf->depth = depth;
+  pthread_mutex_init(&pf->mutex, NULL);
+  pthread_cond_init(&pf->cv, NULL);
+  if (pthread_create(&pf->thread, NULL, frame_prefetch_thread, pf) != 0) {
+    BLOSC_TRACE_ERROR("Cannot create the read-ahead thread.");
+    pthread_cond_destroy(&pf->cv);
+    pthread_mutex_destroy(&pf->mutex);
+    free(pf->slots);
+    free(pf);
+    return BLOSC2_ERROR_THREAD_CREATE;
+  }
+  frame->prefetcher = pf;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int frame_get_prefetch_stats(blosc2_frame_s *frame, int64_t *hits, int64_t *misses) {
+  frame_prefetcher *pf = frame->prefetcher;
+  if (pf == NULL) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  pthread_mutex_lock(&pf->mutex);
+  *hits = pf->hits;
+  *misses = pf->misses;
+  pthread_mutex_unlock(&pf->mutex);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int frame_set_concurrent_reads(blosc2_frame_s *frame, bool enable) {
+  if (!enable) {
+    frame->concurrent_reads = false;
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (frame->prefetcher != NULL) {
+    BLOSC_TRACE_ERROR("Concurrent reads cannot be used with the read-ahead.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
+  // The vlmetalayers that are read on demand too
+  int rc = frame_load_vlmetalayers(frame, frame->schunk, -1);
   if (rc < 0) {
-    if (*needs_free) {
-      free(*chunk);
-      *chunk = NULL;
-      *needs_free = false;
-    }
     return rc;
   }
 
-  return (int)lazychunk_cbytes;
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int32_t typesize;
+  // Reading the header keeps it in the frame
+  rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, &chunksize,
+                       &nchunks, &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                       frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+  if (nchunks > 0) {
+    // And looking up an offset reads (and decodes) all of them
+    int64_t offset;
+    rc = get_coffset(frame, header_len, cbytes, 0, nchunks, &offset);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Unable to get the chunk offsets.");
+      return rc;
+    }
+  }
+  frame->concurrent_reads = true;
+
+  return BLOSC2_ERROR_SUCCESS;
 }
 
 
-/* Fill an empty frame with special values (fast path). */
-int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_value,
-                       int32_t chunksize, blosc2_schunk* schunk) {
+/* Take the chunk `nchunk` out of the read-ahead, waiting for it if it is being read,
+ * and schedule the read of the next ones.  The offsets are looked up here, so that
+ * the read-ahead thread never touches the (cached) index of the frame.  Returns the
+ * size of the chunk, to be freed by the caller, or 0 if it has not been read ahead. */
+static int frame_prefetch_get(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk) {
+  frame_prefetcher *pf = frame->prefetcher;
   int32_t header_len;
   int64_t frame_len;
   int64_t nbytes;
   int64_t cbytes;
   int32_t blocksize;
-  int32_t typesize;
+  int32_t chunksize;
   int64_t nchunks;
-
-  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, NULL,
-                           &nchunks, &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
-                           schunk->storage->io);
+  int32_t typesize;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
   if (rc < 0) {
-    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
-    return BLOSC2_ERROR_DATA;
+    return 0;
   }
 
-  if (nitems == 0) {
-    return frame_len;
+  int32_t chunk_cbytes = 0;
+  pthread_mutex_lock(&pf->mutex);
+  for (int i = 0; i < pf->depth; i++) {
+    frame_prefetch_slot *slot = &pf->slots[i];
+    if (slot->state == FRAME_PREFETCH_FREE || slot->nchunk != nchunk) {
+      continue;
+    }
+    while (slot->state != FRAME_PREFETCH_READY) {
+      pthread_cond_wait(&pf->cv, &pf->mutex);
+    }
+    if (slot->cbytes > 0) {
+      *chunk = slot->chunk;
+      chunk_cbytes = slot->cbytes;
+      slot->chunk = NULL;
+      // The chunk belongs to the caller now
+      membudget_release(chunk_cbytes);
+    }
+    prefetch_slot_free(slot);
+    break;
   }
-
-  if ((nitems / chunksize) > INT_MAX) {
-    BLOSC_TRACE_ERROR("nitems is too large.  Try increasing the chunksize.");
-    return BLOSC2_ERROR_FRAME_SPECIAL;
+  if (chunk_cbytes > 0) {
+    pf->hits++;
+  }
+  else {
+    pf->misses++;
   }
 
-  if ((nbytes > 0) || (cbytes > 0)) {
-    BLOSC_TRACE_ERROR("Filling with special values only works on empty frames");
-    return BLOSC2_ERROR_FRAME_SPECIAL;
+  /* Drop the chunks out of the window (but the ones being read) */
+  for (int i = 0; i < pf->depth; i++) {
+    frame_prefetch_slot *slot = &pf->slots[i];
+    if (slot->state != FRAME_PREFETCH_FREE && slot->state != FRAME_PREFETCH_READING &&
+        (slot->nchunk <= nchunk || slot->nchunk > nchunk + pf->depth)) {
+      prefetch_slot_free(slot);
+    }
   }
 
-  // Compute the number of chunks and the length of the offsets chunk
-  int32_t chunkitems = chunksize / typesize;
-  nchunks = nitems / chunkitems;
-  int32_t leftover_items = (int32_t)(nitems % chunkitems);
-  if (leftover_items) {
-    nchunks += 1;
+  /* And schedule the read of the next chunks */
+  int nslot = 0;
+  for (int64_t next = nchunk + 1; next <= nchunk + pf->depth && next < nchunks; next++) {
+    bool scheduled = false;
+    for (int i = 0; i < pf->depth; i++) {
+      if (pf->slots[i].state != FRAME_PREFETCH_FREE && pf->slots[i].nchunk == next) {
+        scheduled = true;
+        break;
+      }
+    }
+    if (scheduled) {
+      continue;
+    }
+    while (nslot < pf->depth && pf->slots[nslot].state != FRAME_PREFETCH_FREE) {
+      nslot++;
+    }
+    if (nslot == pf->depth) {
+      break;
+    }
+    int64_t offset;
+    if (get_coffset(frame, header_len, cbytes, next, nchunks, &offset) < 0 || offset < 0) {
+      // Errors are reported by the regular read, and special chunks are not read at all
+      continue;
+    }
+    frame_prefetch_slot *slot = &pf->slots[nslot];
+    slot->state = FRAME_PREFETCH_PENDING;
+    slot->nchunk = next;
+    slot->offset = offset;
+    slot->header_len = header_len;
   }
+  pthread_cond_broadcast(&pf->cv);
+  pthread_mutex_unlock(&pf->mutex);
 
-  blosc2_cparams* cparams;
-  blosc2_schunk_get_cparams(schunk, &cparams);
+  return chunk_cbytes;
+}
+
+
+/* Fill `view` with a chunk that is part of a frame, with no allocations.  Special
+ * chunks are built in the view itself, and regular ones point into the in-memory
+ * frame (or into the mapping of its file, for the memory-mapped io).
+ *
+ * The size of the (compressed) chunk is returned, 0 if the chunk has to be read
+ * from a file (see frame_get_chunk()), or a negative code in case of errors.
+*/
+int frame_get_chunk_view(blosc2_frame_s *frame, int64_t nchunk, blosc2_chunk_view *view) {
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int32_t typesize;
+  int64_t offset;
+  int32_t chunk_cbytes;
+  int32_t chunk_nbytes;
+  uint8_t *chunk;
+
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+
+  if (nchunk >= nchunks) {
+    BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the number of chunks "
+                      "('%" PRId64 "') in frame.", nchunk, nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get offset to chunk %" PRId64 ".", nchunk);
+    return rc;
+  }
+
+  if (offset < 0) {
+    // Special value
+    int32_t chunksize_ = chunksize;
+    if ((nchunk == nchunks - 1) && (nbytes % chunksize)) {
+      // Last chunk is incomplete.  Compute its actual size.
+      chunksize_ = (int32_t) (nbytes % chunksize);
+    }
+    if (frame->concurrent_reads) {
+      // Other threads may be viewing the special chunk kept in the frame
+      rc = build_special_chunk(offset, chunksize_, typesize, blocksize, view->header,
+                               BLOSC_EXTENDED_HEADER_LENGTH);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+    // Building a special chunk needs a (compression) context, so keep the last one
+    else if (frame->special_value != offset ||
+        blosc2_cbuffer_sizes(frame->special_chunk, &chunk_nbytes, NULL, NULL) < 0 ||
+        chunk_nbytes != chunksize_) {
+      frame->special_value = 0;
+      rc = build_special_chunk(offset, chunksize_, typesize, blocksize, frame->special_chunk,
+                               BLOSC_EXTENDED_HEADER_LENGTH);
+      if (rc < 0) {
+        return rc;
+      }
+      frame->special_value = offset;
+    }
+    if (!frame->concurrent_reads) {
+      memcpy(view->header, frame->special_chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+    }
+    view->chunk = view->header;
+    view->cbytes = BLOSC_EXTENDED_HEADER_LENGTH;
+    view->nbytes = chunksize_;
+    view->special = (int) (((uint64_t) offset >> (8 * 7)) & BLOSC2_SPECIAL_MASK);
+    return BLOSC_EXTENDED_HEADER_LENGTH;
+  }
+
+  if (frame->cframe != NULL) {
+    // The chunk is in memory and just one pointer away
+    chunk = frame->cframe + header_len + offset;
+    rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
+    if (rc < 0) {
+      return rc;
+    }
+    if (header_len + offset + chunk_cbytes > frame->len) {
+      BLOSC_TRACE_ERROR("Compressed bytes exceed beyond frame length.");
+      return BLOSC2_ERROR_READ_BUFFER;
+    }
+  }
+  else {
+    chunk_cbytes = frame_get_mapped_chunk(frame, header_len, offset, &chunk);
+    if (chunk_cbytes <= 0) {
+      return chunk_cbytes;
+    }
+    rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, NULL, NULL);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  view->chunk = chunk;
+  view->cbytes = chunk_cbytes;
+  view->nbytes = chunk_nbytes;
+  view->special = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  return chunk_cbytes;
+}
+
+
+/* Read the headers of the chunks from `start` to `stop` of a frame into `headers`
+ * (BLOSC_EXTENDED_HEADER_LENGTH bytes each), without reading the chunks themselves.
+ * Special chunks get the header that they would have if they were stored.
+*/
+int frame_get_chunk_headers(blosc2_frame_s *frame, int64_t start, int64_t stop, uint8_t *headers) {
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int32_t typesize;
+  int64_t offset;
+  blosc2_io_cb *io_cb = NULL;
+  void *fp = NULL;
+
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+
+  if (start < 0 || stop > nchunks || start > stop) {
+    BLOSC_TRACE_ERROR("The chunks from %" PRId64 " to %" PRId64 " are not in the frame "
+                      "('%" PRId64 "' chunks).", start, stop, nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (frame->cframe == NULL) {
+    io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      return BLOSC2_ERROR_PLUGIN_IO;
+    }
+  }
+
+  for (int64_t nchunk = start; nchunk < stop; nchunk++) {
+    uint8_t *header = headers + (nchunk - start) * BLOSC_EXTENDED_HEADER_LENGTH;
+    rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Unable to get offset to chunk %" PRId64 ".", nchunk);
+      break;
+    }
+    rc = BLOSC2_ERROR_SUCCESS;
+
+    if (offset < 0) {
+      // Special value
+      int32_t chunksize_ = chunksize;
+      if ((nchunk == nchunks - 1) && (nbytes % chunksize)) {
+        // Last chunk is incomplete.  Compute its actual size.
+        chunksize_ = (int32_t) (nbytes % chunksize);
+      }
+      rc = build_special_chunk(offset, chunksize_, typesize, blocksize, header, BLOSC_EXTENDED_HEADER_LENGTH);
+      if (rc < 0) {
+        break;
+      }
+      continue;
+    }
+
+    if (frame->cframe != NULL) {
+      if (header_len + offset + BLOSC_EXTENDED_HEADER_LENGTH > frame->len) {
+        BLOSC_TRACE_ERROR("The header of chunk %" PRId64 " exceeds beyond frame length.", nchunk);
+        rc = BLOSC2_ERROR_READ_BUFFER;
+        break;
+      }
+      memcpy(header, frame->cframe + header_len + offset, BLOSC_EXTENDED_HEADER_LENGTH);
+      continue;
+    }
+
+    // Where the chunk starts in its file
+    int64_t chunk_position = 0;
+    if (frame->sframe) {
+      // Every chunk has its own file, or a place in its shard
+      fp = sframe_open_chunk(frame, offset, &chunk_position);
+    }
+    else {
+      if (fp == NULL) {
+        fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
+      }
+      chunk_position = frame->file_offset + header_len + offset;
+    }
+    if (fp == NULL) {
+      BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+      rc = BLOSC2_ERROR_FILE_OPEN;
+      break;
+    }
+    int64_t rbytes = io_pread(io_cb, header, 1, BLOSC_EXTENDED_HEADER_LENGTH, chunk_position, fp);
+    if (frame->sframe) {
+      io_cb->close(fp);
+      fp = NULL;
+    }
+    if (rbytes != BLOSC_EXTENDED_HEADER_LENGTH) {
+      BLOSC_TRACE_ERROR("Cannot read the header for chunk %" PRId64 " in the frame.", nchunk);
+      rc = BLOSC2_ERROR_FILE_READ;
+      break;
+    }
+  }
+
+  if (fp != NULL) {
+    io_cb->close(fp);
+  }
+  return rc;
+}
+
+
+/* Send `nbytes` of a frame on disk to `fd`, by the kernel when the frame is a plain file */
+static int send_stored_range(blosc2_io_cb *io_cb, void *fp, int64_t position, int64_t nbytes, int fd) {
+#if !defined(_WIN32)
+  if (io_cb->id == BLOSC2_IO_FILESYSTEM) {
+    if (blosc2_stdio_send_range(fp, position, fd, nbytes) != nbytes) {
+      BLOSC_TRACE_ERROR("Cannot send %" PRId64 " bytes of the frame.", nbytes);
+      return BLOSC2_ERROR_FILE_WRITE;
+    }
+    return BLOSC2_ERROR_SUCCESS;
+  }
+#endif
+  int64_t buffer_size = nbytes < FRAME_COPY_BLOCKSIZE ? nbytes : FRAME_COPY_BLOCKSIZE;
+  uint8_t *buffer = malloc((size_t)buffer_size);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int64_t sent = 0; sent < nbytes && rc == BLOSC2_ERROR_SUCCESS; sent += buffer_size) {
+    int64_t size = nbytes - sent < buffer_size ? nbytes - sent : buffer_size;
+    if (io_pread(io_cb, buffer, 1, size, position + sent, fp) != size) {
+      rc = BLOSC2_ERROR_FILE_READ;
+      break;
+    }
+    rc = stdio_write_fd(fd, buffer, size);
+  }
+  free(buffer);
+  return rc;
+}
+
+
+/* Write the chunks from `start` to `stop` of a frame, one after the other, to `fd`.
+ * The chunks of frames on disk do not go through user space when they can be sent by
+ * the kernel, and the ones that are next to each other in the file are sent at once.
+ * Returns the bytes written, or a negative value on errors.
+*/
+int64_t frame_send_chunks(blosc2_frame_s *frame, int64_t start, int64_t stop, int fd) {
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int32_t typesize;
+  int64_t offset;
+  blosc2_io_cb *io_cb = NULL;
+  void *fp = NULL;
+
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+
+  if (start < 0 || stop > nchunks || start > stop) {
+    BLOSC_TRACE_ERROR("The chunks from %" PRId64 " to %" PRId64 " are not in the frame "
+                      "('%" PRId64 "' chunks).", start, stop, nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (frame->cframe == NULL) {
+    io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      return BLOSC2_ERROR_PLUGIN_IO;
+    }
+  }
+
+  // The run of chunks next to each other in the file that are still to be sent
+  int64_t run_position = 0;
+  int64_t run_nbytes = 0;
+  int64_t sent = 0;
+  for (int64_t nchunk = start; nchunk < stop; nchunk++) {
+    rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Unable to get offset to chunk %" PRId64 ".", nchunk);
+      break;
+    }
+    rc = BLOSC2_ERROR_SUCCESS;
+
+    uint8_t *chunk = NULL;
+    int32_t chunk_cbytes = 0;
+    uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+    if (offset < 0) {
+      // Special value
+      int32_t chunksize_ = chunksize;
+      if ((nchunk == nchunks - 1) && (nbytes % chunksize)) {
+        // Last chunk is incomplete.  Compute its actual size.
+        chunksize_ = (int32_t) (nbytes % chunksize);
+      }
+      rc = build_special_chunk(offset, chunksize_, typesize, blocksize, header, BLOSC_EXTENDED_HEADER_LENGTH);
+      if (rc < 0) {
+        break;
+      }
+      chunk = header;
+      chunk_cbytes = BLOSC_EXTENDED_HEADER_LENGTH;
+    }
+    else if (frame->cframe != NULL) {
+      chunk = frame->cframe + header_len + offset;
+      if (header_len + offset + BLOSC_EXTENDED_HEADER_LENGTH > frame->len ||
+          blosc2_cbuffer_sizes(chunk, NULL, &chunk_cbytes, NULL) < 0 ||
+          header_len + offset + chunk_cbytes > frame->len) {
+        BLOSC_TRACE_ERROR("Compressed bytes exceed beyond frame length.");
+        rc = BLOSC2_ERROR_READ_BUFFER;
+        break;
+      }
+    }
+    else {
+      // The memory-mapped chunks are written from the mapping
+      chunk_cbytes = frame_get_mapped_chunk(frame, header_len, offset, &chunk);
+      if (chunk_cbytes < 0) {
+        rc = chunk_cbytes;
+        break;
+      }
+    }
+
+    if (chunk_cbytes > 0) {
+      if (run_nbytes > 0) {
+        rc = send_stored_range(io_cb, fp, run_position, run_nbytes, fd);
+        if (rc < 0) {
+          break;
+        }
+        run_nbytes = 0;
+      }
+      rc = stdio_write_fd(fd, chunk, chunk_cbytes);
+      if (rc < 0) {
+        break;
+      }
+      sent += chunk_cbytes;
+      continue;
+    }
+
+    // Where the chunk starts in its file
+    int64_t chunk_position = 0;
+    if (frame->sframe) {
+      // Every chunk has its own file, or a place in its shard
+      fp = sframe_open_chunk(frame, offset, &chunk_position);
+    }
+    else {
+      if (fp == NULL) {
+        fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
+      }
+      chunk_position = frame->file_offset + header_len + offset;
+    }
+    if (fp == NULL) {
+      BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+      rc = BLOSC2_ERROR_FILE_OPEN;
+      break;
+    }
+    // Only the header of the chunk is read, for its size
+    if (io_pread(io_cb, header, 1, BLOSC_EXTENDED_HEADER_LENGTH, chunk_position, fp) !=
+        BLOSC_EXTENDED_HEADER_LENGTH ||
+        blosc2_cbuffer_sizes(header, NULL, &chunk_cbytes, NULL) < 0) {
+      BLOSC_TRACE_ERROR("Cannot read the header for chunk %" PRId64 " in the frame.", nchunk);
+      rc = BLOSC2_ERROR_FILE_READ;
+      break;
+    }
+    if (run_nbytes > 0 && run_position + run_nbytes == chunk_position) {
+      run_nbytes += chunk_cbytes;
+    }
+    else {
+      if (run_nbytes > 0) {
+        rc = send_stored_range(io_cb, fp, run_position, run_nbytes, fd);
+        if (rc < 0) {
+          break;
+        }
+      }
+      run_position = chunk_position;
+      run_nbytes = chunk_cbytes;
+    }
+    sent += chunk_cbytes;
+    if (frame->sframe) {
+      rc = send_stored_range(io_cb, fp, run_position, run_nbytes, fd);
+      run_nbytes = 0;
+      io_cb->close(fp);
+      fp = NULL;
+      if (rc < 0) {
+        break;
+      }
+    }
+  }
+  if (rc >= 0 && run_nbytes > 0) {
+    rc = send_stored_range(io_cb, fp, run_position, run_nbytes, fd);
+  }
+
+  if (fp != NULL) {
+    io_cb->close(fp);
+  }
+  return rc < 0 ? rc : sent;
+}
+
+/* The state of a frame_prefetch_chunks() call */
+typedef struct {
+  blosc2_frame_s *frame;
+  frame_chunk_ready_cb ready;
+  void *user_data;
+} prefetch_batch;
+
+/* A chunk being fetched by frame_prefetch_chunks() */
+typedef struct {
+  prefetch_batch *batch;
+  int64_t nchunk;
+  void *fp;
+  int64_t position;
+  uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+  uint8_t *chunk;
+  int32_t cbytes;
+} prefetch_item;
+
+static void prefetch_header_done(blosc2_io_request *request) {
+  prefetch_item *item = (prefetch_item *) request->user_data;
+  int rc = BLOSC2_ERROR_FILE_READ;
+  if (request->result == request->size) {
+    rc = blosc2_cbuffer_sizes(item->header, NULL, &item->cbytes, NULL);
+  }
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot read the cbytes for chunk %" PRId64 " in the frame.", item->nchunk);
+    item->batch->ready(item->nchunk, NULL, rc, false, item->batch->user_data);
+    return;
+  }
+  item->chunk = malloc(item->cbytes);
+  if (item->chunk == NULL) {
+    item->batch->ready(item->nchunk, NULL, BLOSC2_ERROR_MEMORY_ALLOC, false, item->batch->user_data);
+    return;
+  }
+  memcpy(item->chunk, item->header, BLOSC_EXTENDED_HEADER_LENGTH);
+  if (item->cbytes == BLOSC_EXTENDED_HEADER_LENGTH) {
+    // Nothing else to read
+    item->batch->ready(item->nchunk, item->chunk, item->cbytes, true, item->batch->user_data);
+    item->chunk = NULL;
+  }
+}
+
+static void prefetch_chunk_done(blosc2_io_request *request) {
+  prefetch_item *item = (prefetch_item *) request->user_data;
+  if (request->result != request->size) {
+    BLOSC_TRACE_ERROR("Cannot read the chunk %" PRId64 " out of the frame.", item->nchunk);
+    free(item->chunk);
+    item->batch->ready(item->nchunk, NULL, BLOSC2_ERROR_FILE_READ, false, item->batch->user_data);
+  }
+  else {
+    item->batch->ready(item->nchunk, item->chunk, item->cbytes, true, item->batch->user_data);
+  }
+  item->chunk = NULL;
+}
+
+/* Fetch the chunks [start, stop) of a frame.  On-disk frames whose io can read a batch
+ * at once (see blosc2_io_cb_ext.pread_batch) read all the chunk headers together, and then
+ * all the chunks together; else, the chunks are fetched one after the other.  `ready` is
+ * called exactly once per chunk, as soon as it is available (with the same meaning for
+ * the arguments than frame_get_chunk), or with a negative cbytes if it could not be
+ * fetched.  Return 0, or the code of the first error. */
+int frame_prefetch_chunks(blosc2_frame_s *frame, int64_t start, int64_t stop,
+                          frame_chunk_ready_cb ready, void *user_data) {
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int32_t typesize;
+  int64_t nchunk;
+  uint8_t *chunk;
+  bool needs_free;
+  int rc = 0;
+
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    rc = BLOSC2_ERROR_PLUGIN_IO;
+    goto error;
+  }
+  if (frame->cframe != NULL || io_cb_ext(io_cb)->pread_batch == NULL) {
+    for (nchunk = start; nchunk < stop; nchunk++) {
+      int chunk_cbytes = frame_get_chunk(frame, nchunk, &chunk, &needs_free);
+      if (chunk_cbytes < 0 && rc == 0) {
+        rc = chunk_cbytes;
+      }
+      ready(nchunk, chunk, chunk_cbytes, needs_free, user_data);
+    }
+    return rc;
+  }
+
+  rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                       &blocksize, &chunksize, &nchunks,
+                       &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                       frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    goto error;
+  }
+  if (start < 0 || stop > nchunks) {
+    BLOSC_TRACE_ERROR("The range of chunks [%" PRId64 ", %" PRId64 ") is not within the "
+                      "frame ('%" PRId64 "' chunks).", start, stop, nchunks);
+    rc = BLOSC2_ERROR_INVALID_PARAM;
+    goto error;
+  }
+
+  void *fp = NULL;
+  if (!frame->sframe) {
+    // All the chunks share the stream of the frame
+    fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
+    if (fp == NULL) {
+      BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+      rc = BLOSC2_ERROR_FILE_OPEN;
+      goto error;
+    }
+  }
+  prefetch_batch batch = {frame, ready, user_data};
+  prefetch_item *items = calloc(stop - start, sizeof(prefetch_item));
+  blosc2_io_request *requests = calloc(stop - start, sizeof(blosc2_io_request));
+  if (items == NULL || requests == NULL) {
+    free(items);
+    free(requests);
+    if (fp != NULL) {
+      io_cb->close(fp);
+    }
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto error;
+  }
+
+  int64_t nitems = 0;
+  for (nchunk = start; nchunk < stop; nchunk++) {
+    int64_t offset;
+    int rc_ = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
+    if (rc_ < 0) {
+      BLOSC_TRACE_ERROR("Unable to get offset to chunk %" PRId64 ".", nchunk);
+    }
+    else if (offset < 0) {
+      // Special values are built in memory
+      rc_ = frame_get_chunk(frame, nchunk, &chunk, &needs_free);
+    }
+    if (rc_ < 0 || offset < 0) {
+      if (rc_ < 0 && rc == 0) {
+        rc = rc_;
+      }
+      ready(nchunk, rc_ < 0 ? NULL : chunk, rc_, rc_ < 0 ? false : needs_free, user_data);
+      continue;
+    }
+
+    prefetch_item *item = &items[nitems];
+    item->batch = &batch;
+    item->nchunk = nchunk;
+    if (frame->sframe) {
+      item->fp = sframe_open_chunk(frame, offset, &item->position);
+      if (item->fp == NULL) {
+        if (rc == 0) {
+          rc = BLOSC2_ERROR_FILE_OPEN;
+        }
+        ready(nchunk, NULL, BLOSC2_ERROR_FILE_OPEN, false, user_data);
+        continue;
+      }
+    }
+    else {
+      item->fp = fp;
+      item->position = frame->file_offset + header_len + offset;
+    }
+    nitems++;
+  }
+
+  for (int64_t i = 0; i < nitems; i++) {
+    blosc2_io_request request = {items[i].fp, items[i].header, BLOSC_EXTENDED_HEADER_LENGTH,
+                                 items[i].position, 0, &items[i]};
+    requests[i] = request;
+  }
+  int rc_ = io_pread_batch(io_cb, requests, nitems, prefetch_header_done);
+  if (rc_ < 0 && rc == 0) {
+    rc = rc_;
+  }
+  // The rest of the chunks whose header could be read
+  int64_t nrequests = 0;
+  for (int64_t i = 0; i < nitems; i++) {
+    if (items[i].chunk != NULL) {
+      blosc2_io_request request = {items[i].fp, items[i].chunk + BLOSC_EXTENDED_HEADER_LENGTH,
+                                   items[i].cbytes - BLOSC_EXTENDED_HEADER_LENGTH,
+                                   items[i].position + BLOSC_EXTENDED_HEADER_LENGTH, 0, &items[i]};
+      requests[nrequests++] = request;
+    }
+  }
+  rc_ = io_pread_batch(io_cb, requests, nrequests, prefetch_chunk_done);
+  if (rc_ < 0 && rc == 0) {
+    rc = rc_;
+  }
+
+  for (int64_t i = 0; i < nitems; i++) {
+    if (frame->sframe) {
+      io_cb->close(items[i].fp);
+    }
+  }
+  if (fp != NULL) {
+    io_cb->close(fp);
+  }
+  free(items);
+  free(requests);
+  return rc;
+
+  error:
+  for (nchunk = start; nchunk < stop; nchunk++) {
+    ready(nchunk, NULL, rc, false, user_data);
+  }
+  return rc;
+}
+
+
+/* Return a compressed chunk that is part of a frame in the `chunk` parameter.
+ * If the frame is disk-based, a buffer is allocated for the (lazy) chunk,
+ * and hence a free is needed.  You can check if the chunk requires a free with the `needs_free`
+ * parameter.
+ * If the chunk does not need a free, it means that the frame is in memory and that just a
+ * pointer to the location of the chunk in memory is returned.
+ *
+ * The size of the (compressed, potentially lazy) chunk is returned.  If some problem is detected,
+ * a negative code is returned instead.
+*/
+int frame_get_lazychunk(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk, bool *needs_free) {
+  return frame_get_lazychunk_ctx(frame, nchunk, chunk, needs_free, NULL);
+}
+
+
+/* The buffers of the lazy chunks come from the allocator of the context, if any */
+static void* lazychunk_malloc(blosc2_context *ctx, size_t size) {
+  return ctx != NULL ? ctx_malloc(ctx, size) : malloc(size);
+}
+
+static void lazychunk_free(blosc2_context *ctx, void *block) {
+  if (ctx != NULL) {
+    ctx_free(ctx, block);
+  }
+  else {
+    free(block);
+  }
+}
+
+
+int frame_get_lazychunk_ctx(blosc2_frame_s *frame, int64_t nchunk, uint8_t **chunk, bool *needs_free,
+                            blosc2_context *ctx) {
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int32_t typesize;
+  int32_t lazychunk_cbytes;
+  int64_t offset;
+  void* fp = NULL;
+
+  *chunk = NULL;
+  *needs_free = false;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+
+  if (nchunk >= nchunks) {
+    BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the number of chunks "
+                      "('%" PRId64 "') in frame.", nchunk, nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  // Get the offset to nchunk
+  rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get offset to chunk %" PRId64 ".", nchunk);
+    return rc;
+  }
+
+  if (offset < 0) {
+    // Special value
+    lazychunk_cbytes = BLOSC_EXTENDED_HEADER_LENGTH;
+    int32_t chunksize_ = chunksize;
+    if ((nchunk == nchunks - 1) && (nbytes % chunksize)) {
+      // Last chunk is incomplete.  Compute its actual size.
+      chunksize_ = (int32_t) (nbytes % chunksize);
+    }
+    *chunk = lazychunk_malloc(ctx, lazychunk_cbytes);
+    if (*chunk == NULL) {
+      BLOSC_TRACE_ERROR("Error allocating memory!");
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    *needs_free = true;
+    rc = build_special_chunk(offset, chunksize_, typesize, blocksize, *chunk, lazychunk_cbytes);
+    goto end;
+  }
+
+  // A memory-mapped chunk is just one pointer away, so there is no need for a lazy one
+  rc = frame_get_mapped_chunk(frame, header_len, offset, chunk);
+  if (rc != 0) {
+    return rc;
+  }
+
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    rc = BLOSC2_ERROR_PLUGIN_IO;
+    goto end;
+  }
+
+  if (frame->cframe == NULL) {
+    // TODO: make this portable across different endianness
+    // Get info for building a lazy chunk
+    int32_t chunk_nbytes;
+    int32_t chunk_cbytes;
+    int32_t chunk_blocksize;
+    uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+    // Where the chunk starts in its file
+    int64_t chunk_position = 0;
+    if (frame->sframe) {
+      // The chunk is not in the frame
+      fp = sframe_open_chunk(frame, offset, &chunk_position);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        return BLOSC2_ERROR_FILE_OPEN;
+      }
+    }
+    else {
+      fp = io_cb->open(frame->urlpath, "rb", frame->schunk->storage->io->params);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        return BLOSC2_ERROR_FILE_OPEN;
+      }
+      chunk_position = frame->file_offset + header_len + offset;
+    }
+    int64_t rbytes = io_pread(io_cb, header, 1, BLOSC_EXTENDED_HEADER_LENGTH, chunk_position, fp);
+    if (rbytes != BLOSC_EXTENDED_HEADER_LENGTH) {
+      BLOSC_TRACE_ERROR("Cannot read the header for chunk in the frame.");
+      rc = BLOSC2_ERROR_FILE_READ;
+      goto end;
+    }
+    rc = blosc2_cbuffer_sizes(header, &chunk_nbytes, &chunk_cbytes, &chunk_blocksize);
+    if (rc < 0) {
+      goto end;
+    }
+    size_t nblocks = chunk_nbytes / chunk_blocksize;
+    size_t leftover_block = chunk_nbytes % chunk_blocksize;
+    nblocks = leftover_block ? nblocks + 1 : nblocks;
+    // Allocate space for the lazy chunk
+    int32_t trailer_len;
+    int32_t special_type = (header[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+    int memcpyed = header[BLOSC2_CHUNK_FLAGS] & (uint8_t) BLOSC_MEMCPYED;
+
+    int32_t trailer_offset = BLOSC_EXTENDED_HEADER_LENGTH;
+    size_t streams_offset = BLOSC_EXTENDED_HEADER_LENGTH;
+    // The checksums of the blocks and the cipher data end the chunk, and they go after the
+    // csizes of the trailer
+    int32_t checksums_len = 0;
+    if (special_type == 0 && (header[BLOSC2_CHUNK_CHECKSUM] & 0x0Fu) == BLOSC2_CHECKSUM_XXH3) {
+      checksums_len = (int32_t) (nblocks * BLOSC2_CHECKSUM_SIZE);
+    }
+    int32_t cipher_len = 0;
+    if (special_type == 0 && (header[BLOSC2_CHUNK_CHECKSUM] >> 4) != BLOSC2_CIPHER_NONE) {
+      cipher_len = BLOSC2_CIPHER_NONCE_SIZE + (int32_t) (nblocks * (sizeof(int32_t) + BLOSC2_CIPHER_TAG_SIZE));
+    }
+    if (special_type == 0) {
+      // Regular values have offsets for blocks
+      trailer_offset += (int32_t) (nblocks * sizeof(int32_t));
+      if (memcpyed) {
+        streams_offset += 0;
+      } else {
+        streams_offset += nblocks * sizeof(int32_t);
+      }
+      if (!memcpyed && (header[BLOSC2_CHUNK_BLOSC2_FLAGS] & BLOSC2_USEDICT)) {
+        // Keep the reference to the (shared) dictionary that follows the bstarts
+        trailer_offset += (int32_t) sizeof(int32_t);
+        streams_offset += sizeof(int32_t);
+      }
+      if (is_hybrid_chunk(header[BLOSC2_CHUNK_FLAGS])) {
+        // Keep the codecs of the blocks that follow the bstarts too
+        trailer_offset += (int32_t) nblocks;
+        streams_offset += nblocks;
+      }
+      // And the reference block of the delta filter, when it is stored
+      int32_t dref_len = stored_dref_len(header);
+      trailer_offset += dref_len;
+      streams_offset += dref_len;
+      trailer_len = (int32_t) (sizeof(int32_t) + sizeof(int64_t) + nblocks * sizeof(int32_t)) + checksums_len + cipher_len;
+      lazychunk_cbytes = trailer_offset + trailer_len;
+    }
+    else if (special_type == BLOSC2_SPECIAL_VALUE) {
+      trailer_offset += typesize;
+      streams_offset += typesize;
+      trailer_len = 0;
+      lazychunk_cbytes = trailer_offset + trailer_len;
+    }
+    else {
+      rc = BLOSC2_ERROR_INVALID_HEADER;
+      goto end;
+    }
+    *chunk = lazychunk_malloc(ctx, lazychunk_cbytes);
+    if (*chunk == NULL) {
+      BLOSC_TRACE_ERROR("Error allocating memory!");
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      goto end;
+    }
+    *needs_free = true;
+
+    // Read just the full header and bstarts section too (lazy partial length)
+    rbytes = io_pread(io_cb, *chunk, 1, (int64_t)streams_offset, chunk_position, fp);
+    if (rbytes != (int64_t)streams_offset) {
+      BLOSC_TRACE_ERROR("Cannot read the (lazy) chunk out of the frame.");
+      rc = BLOSC2_ERROR_FILE_READ;
+      goto end;
+    }
+    if (special_type == BLOSC2_SPECIAL_VALUE) {
+      // Value runlen is not returning a lazy chunk.  We are done.
+      goto end;
+    }
+
+    // Mark chunk as lazy
+    uint8_t* blosc2_flags = *chunk + BLOSC2_CHUNK_BLOSC2_FLAGS;
+    *blosc2_flags |= 0x08U;
+
+    // Add the trailer (currently, nchunk + offset + block_csizes + checksums + cipher data)
+    if (frame->sframe) {
+      *(int32_t*)(*chunk + trailer_offset) = (int32_t)offset;   // offset is nchunk for sframes
+      *(int64_t*)(*chunk + trailer_offset + sizeof(int32_t)) = chunk_position;  // in its file
+    }
+    else {
+      *(int32_t*)(*chunk + trailer_offset) = (int32_t)nchunk;
+      *(int64_t*)(*chunk + trailer_offset + sizeof(int32_t)) = header_len + offset;
+    }
+
+    int32_t* block_csizes = lazychunk_malloc(ctx, nblocks * sizeof(int32_t));
+    if (block_csizes == NULL) {
+      BLOSC_TRACE_ERROR("Error allocating memory!");
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      goto end;
+    }
+
+    if (memcpyed) {
+      // When memcpyed the blocksizes are trivial to compute
+      for (int i = 0; i < (int)nblocks - 1; i++) {
+        block_csizes[i] = (int)chunk_blocksize;
+      }
+      // The last block could be incomplete, mainly due to the fact that the block size is not divisible
+      // by the typesize
+      block_csizes[nblocks - 1] = (int32_t)leftover_block ? (int32_t)leftover_block : chunk_blocksize;
+    }
+    else {
+      // In regular, compressed chunks, we need to sort the bstarts (they can be out
+      // of order because of multi-threading), and get a reverse index too.
+      memcpy(block_csizes, *chunk + BLOSC_EXTENDED_HEADER_LENGTH, nblocks * sizeof(int32_t));
+      // Helper structure to keep track of original indexes
+      struct csize_idx *csize_idx = lazychunk_malloc(ctx, nblocks * sizeof(struct csize_idx));
+      if (csize_idx == NULL) {
+        lazychunk_free(ctx, block_csizes);
+        BLOSC_TRACE_ERROR("Error allocating memory!");
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        goto end;
+      }
+      for (int n = 0; n < (int)nblocks; n++) {
+        csize_idx[n].val = block_csizes[n];
+        csize_idx[n].idx = n;
+      }
+      qsort(csize_idx, nblocks, sizeof(struct csize_idx), &sort_offset);
+      // Compute the actual csizes
+      int idx;
+      for (int n = 0; n < (int)nblocks - 1; n++) {
+        idx = csize_idx[n].idx;
+        block_csizes[idx] = csize_idx[n + 1].val - csize_idx[n].val;
+      }
+      idx = csize_idx[nblocks - 1].idx;
+      block_csizes[idx] = (int)chunk_cbytes - checksums_len - cipher_len - csize_idx[nblocks - 1].val;
+      lazychunk_free(ctx, csize_idx);
+    }
+    // Copy the csizes after the nchunk and the offset
+    void *trailer_csizes = *chunk + trailer_offset + sizeof(int32_t) + sizeof(int64_t);
+    memcpy(trailer_csizes, block_csizes, nblocks * sizeof(int32_t));
+    lazychunk_free(ctx, block_csizes);
+    int32_t ending_len = checksums_len + cipher_len;
+    if (ending_len > 0) {
+      rbytes = io_pread(io_cb, *chunk + lazychunk_cbytes - ending_len, 1, ending_len,
+                        chunk_position + chunk_cbytes - ending_len, fp);
+      if (rbytes != ending_len) {
+        BLOSC_TRACE_ERROR("Cannot read the checksums or the cipher data of the (lazy) chunk out of the frame.");
+        rc = BLOSC2_ERROR_FILE_READ;
+        goto end;
+      }
+    }
+  } else {
+    // The chunk is in memory and just one pointer away
+    int64_t chunk_header_offset = header_len + offset;
+    int64_t chunk_cbytes_offset = chunk_header_offset + BLOSC_MIN_HEADER_LENGTH;
+
+    *chunk = frame->cframe + chunk_header_offset;
+
+    if (chunk_cbytes_offset > frame->len) {
+      BLOSC_TRACE_ERROR("Cannot read the header for chunk in the (contiguous) frame.");
+      rc = BLOSC2_ERROR_READ_BUFFER;
+    } else {
+      rc = blosc2_cbuffer_sizes(*chunk, NULL, &lazychunk_cbytes, NULL);
+      if (rc && chunk_cbytes_offset + lazychunk_cbytes > frame_len) {
+        BLOSC_TRACE_ERROR("Compressed bytes exceed beyond frame length.");
+        rc = BLOSC2_ERROR_READ_BUFFER;
+      }
+    }
+  }
+
+  end:
+  if (fp != NULL) {
+    io_cb->close(fp);
+  }
+  if (rc < 0) {
+    if (*needs_free) {
+      lazychunk_free(ctx, *chunk);
+      *chunk = NULL;
+      *needs_free = false;
+    }
+    return rc;
+  }
+
+  return (int)lazychunk_cbytes;
+}
+
+
+/* The bytes skipped from `position` (in a contiguous frame) up to the boundary where the
+ * next chunk starts, if anything is `stored` there (see blosc2_storage.chunk_align) */
+static int32_t get_chunk_gap(blosc2_frame_s* frame, int64_t position, bool stored) {
+  if (frame->sframe || !stored || frame->chunk_align <= 1) {
+    return 0;
+  }
+  return (int32_t)(-position & (frame->chunk_align - 1));
+}
+
+
+/* The bytes reserved after a chunk stored at the end of a contiguous frame, so that
+ * updates with larger chunks can still go to its slot (see blosc2_storage.chunk_padding),
+ * and so that the next chunk or the index start at the boundary of aligned frames.  The
+ * chunk ends at `chunk_end`. */
+static int32_t get_chunk_padding(blosc2_frame_s* frame, int64_t chunk_end, int32_t chunk_cbytes) {
+  if (frame->sframe || chunk_cbytes == 0) {
+    return 0;
+  }
+  int32_t padding = frame->schunk->storage->chunk_padding > 0 ? frame->schunk->storage->chunk_padding : 0;
+  return padding + get_chunk_gap(frame, chunk_end + padding, true);
+}
+
+
+/* Fill an empty frame with special values (fast path). */
+int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_value, const void* repeatval,
+                           int32_t chunksize, blosc2_schunk* schunk) {
+  if (frame->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(frame);
+    if (rc_ < 0) {
+      return rc_;
+    }
+  }
+  int rc_meta = frame_load_vlmetalayers(frame, schunk, -1);
+  if (rc_meta < 0) {
+    return rc_meta;
+  }
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t typesize;
+  int64_t nchunks;
+
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, NULL,
+                           &nchunks, &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                           schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return BLOSC2_ERROR_DATA;
+  }
+
+  if (nitems == 0) {
+    return frame_len;
+  }
+
+  if ((nitems / chunksize) > INT_MAX) {
+    BLOSC_TRACE_ERROR("nitems is too large.  Try increasing the chunksize.");
+    return BLOSC2_ERROR_FRAME_SPECIAL;
+  }
+
+  if ((nbytes > 0) || (cbytes > 0)) {
+    BLOSC_TRACE_ERROR("Filling with special values only works on empty frames");
+    return BLOSC2_ERROR_FRAME_SPECIAL;
+  }
+
+  // Compute the number of chunks and the length of the offsets chunk
+  int32_t chunkitems = chunksize / typesize;
+  nchunks = nitems / chunkitems;
+  int32_t leftover_items = (int32_t)(nitems % chunkitems);
+  if (leftover_items) {
+    nchunks += 1;
+  }
+  if (special_value == BLOSC2_SPECIAL_VALUE && (leftover_items || frame->sframe)) {
+    BLOSC_TRACE_ERROR("Chunks of a repeated value can only fill whole chunks of contiguous frames.");
+    return BLOSC2_ERROR_FRAME_SPECIAL;
+  }
+
+  blosc2_cparams* cparams;
+  blosc2_schunk_get_cparams(schunk, &cparams);
+
+  // Build the offsets with a special chunk
+  int32_t new_off_cbytes;
+  uint64_t offset_value = ((uint64_t)1 << 63);
+  uint8_t* sample_chunk = malloc(BLOSC_EXTENDED_HEADER_LENGTH + typesize);
+  int csize;
+  // The chunks that are not coded in the offsets are stored once, and shared by all of them
+  int32_t gap = 0;
+  int64_t stored_cbytes = 0;
+  switch (special_value) {
+    case BLOSC2_SPECIAL_ZERO:
+      offset_value += (uint64_t) BLOSC2_SPECIAL_ZERO << (8 * 7);
+      csize = blosc2_chunk_zeros(*cparams, chunksize, sample_chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+      break;
+    case BLOSC2_SPECIAL_UNINIT:
+      offset_value += (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);
+      csize = blosc2_chunk_uninit(*cparams, chunksize, sample_chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+      break;
+    case BLOSC2_SPECIAL_NAN:
+      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);
+      csize = blosc2_chunk_nans(*cparams, chunksize, sample_chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+      break;
+    case BLOSC2_SPECIAL_VIRTUAL:
+      offset_value += (uint64_t)BLOSC2_SPECIAL_VIRTUAL << (8 * 7);
+      csize = blosc2_chunk_virtual(*cparams, chunksize, sample_chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+      break;
+    case BLOSC2_SPECIAL_VALUE:
+      csize = blosc2_chunk_repeatval(*cparams, chunksize, sample_chunk, BLOSC_EXTENDED_HEADER_LENGTH + typesize,
+                                     repeatval);
+      gap = get_chunk_gap(frame, header_len, true);
+      offset_value = (uint64_t)gap;
+      stored_cbytes = gap + csize + get_chunk_padding(frame, header_len + gap + csize, csize);
+      break;
+    default:
+      BLOSC_TRACE_ERROR("Only zeros, NaNs, non-initialized, virtual or repeated values are supported.");
+      return BLOSC2_ERROR_FRAME_SPECIAL;
+  }
+  if (csize < 0) {
+    BLOSC_TRACE_ERROR("Error creating sample chunk");
+    return BLOSC2_ERROR_FRAME_SPECIAL;
+  }
+  cparams->typesize = sizeof(int64_t);  // change it to offsets typesize
+  // cparams->blocksize = 0;   // automatic blocksize
+  cparams->blocksize = 8 * 2 * 1024;  // based on experiments with create_frame.c bench
+  cparams->clevel = 5;
+  cparams->compcode = BLOSC_BLOSCLZ;
+  uint8_t* off_chunk = special_offsets_index(schunk->cctx, frame->index_format,
+                                             *cparams, nchunks, &offset_value, &new_off_cbytes);
+  free(cparams);
+  if (off_chunk == NULL) {
+    BLOSC_TRACE_ERROR("Error creating a special offsets chunk");
+    return BLOSC2_ERROR_DATA;
+  }
+
+  // Get the blocksize associated to the sample chunk
+  blosc2_cbuffer_sizes(sample_chunk, NULL, NULL, &blocksize);
+  // and use it for the super-chunk
+  schunk->blocksize = blocksize;
+  // schunk->blocksize = 0;  // for experimenting with automatic blocksize
+  // The stored chunk goes right before the offsets, along with its gap and padding
+  uint8_t* stored = NULL;
+  if (stored_cbytes > 0) {
+    stored = calloc(1, (size_t)stored_cbytes);
+    if (stored == NULL) {
+      free(sample_chunk);
+      ctx_free(schunk->cctx, off_chunk);
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    memcpy(stored + gap, sample_chunk, (size_t)csize);
+    schunk->cbytes = stored_cbytes;
+  }
+  free(sample_chunk);
+
+  // We have the new offsets; update the frame.
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    free(stored);
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+
+  int64_t new_frame_len = header_len + stored_cbytes + new_off_cbytes + frame->trailer_len;
+  void* fp = NULL;
+  if (frame->cframe != NULL) {
+    /* Make space for the new chunk and copy it */
+    uint8_t* framep = frame_reserve(frame, new_frame_len);
+    if (framep == NULL) {
+      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      free(stored);
+      return BLOSC2_ERROR_FRAME_SPECIAL;
+    }
+    /* Copy the stored chunk and the offsets */
+    if (stored_cbytes > 0) {
+      memcpy(framep + header_len, stored, (size_t)stored_cbytes);
+    }
+    memcpy(framep + header_len + stored_cbytes, off_chunk, (size_t)new_off_cbytes);
+  }
+  else {
+    size_t wbytes;
+    if (frame->sframe) {
+      // Update the offsets chunk in the chunks frame
+      fp = sframe_open_index(frame->urlpath, "rb+", frame->schunk->storage->io);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        return BLOSC2_ERROR_FILE_OPEN;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len, SEEK_SET);
+    }
+    else {
+      // Regular frame
+      fp = io_cb->open(frame->urlpath, "rb+", schunk->storage->io->params);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        return BLOSC2_ERROR_FILE_OPEN;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
+    }
+    wbytes = stored_cbytes > 0 ? io_cb->write(stored, 1, stored_cbytes, fp) : 0;  // the stored chunk
+    wbytes += io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
+    io_cb->close(fp);
+    if (wbytes != (size_t)(stored_cbytes + new_off_cbytes)) {
+      BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
+      free(stored);
+      return BLOSC2_ERROR_FRAME_SPECIAL;
+    }
+  }
+  free(stored);
+
+  // Invalidate the caches for the header and chunk offsets
+  frame_invalidate_caches(frame);
+  ctx_free(schunk->cctx, off_chunk);
+
+  frame->len = new_frame_len;
+  rc = frame_update_header(frame, schunk, false);
+  if (rc < 0) {
+    return BLOSC2_ERROR_FRAME_SPECIAL;
+  }
+
+  rc = frame_update_trailer(frame, schunk);
+  if (rc < 0) {
+    return BLOSC2_ERROR_FRAME_SPECIAL;
+  }
+
+  return frame->len;
+}
+
+
+/* Whether the appends to a frame are published as new versions (see frame_set_versioned_commits()),
+ * which the durability levels that sync the appends need too, so that no crash leaves the
+ * index overwritten by a chunk */
+static bool publishes_versions(blosc2_frame_s* frame) {
+  return frame->versioned || (frame->cframe == NULL && !frame->sframe &&
+                              frame->schunk->storage->durability >= BLOSC2_DURABILITY_GROUP);
+}
+
+
+/* Whether the appends that are not synced yet make a group (see blosc2_storage.sync_nappends) */
+static bool group_commit_due(blosc2_frame_s* frame) {
+  blosc2_storage* storage = frame->schunk->storage;
+  if (storage->sync_nappends > 0 && frame->group_nappends >= storage->sync_nappends) {
+    return true;
+  }
+  if (storage->sync_ms > 0) {
+    blosc_timestamp_t now;
+    blosc_set_timestamp(&now);
+    return blosc_elapsed_secs(frame->group_start, now) * 1000 >= storage->sync_ms;
+  }
+  return storage->sync_nappends == 0;
+}
+
+
+int frame_sync(blosc2_frame_s* frame) {
+  if (frame->cframe != NULL || frame->sframe || frame->urlpath == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  int rc = io_sync(io_cb, fp);
+  io_cb->close(fp);
+  return rc;
+}
+
+
+/* Start deferring the updates of the offsets and the header of an on-disk frame
+ * (bulk mode), from the offsets in the frame, which are not read again until the flush */
+static int start_bulk(blosc2_frame_s* frame, int32_t header_len, int64_t cbytes, int64_t nchunks) {
+  if (nchunks > 0 && frame->noffsets < nchunks) {
+    int32_t coffsets_cbytes;
+    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
+    if (coffsets == NULL) {
+      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
+      return BLOSC2_ERROR_READ_BUFFER;
+    }
+    decode_coffsets(frame, coffsets, coffsets_cbytes, nchunks);
+    if (frame->noffsets < nchunks) {
+      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
+      return BLOSC2_ERROR_DATA;
+    }
+  }
+  frame->noffsets = nchunks;
+  // The chunk ids handed out to concurrent writers are never given again
+  int64_t chunk_id = frame->writers != NULL ? frame->bulk_chunk_id : -1;
+  for (int64_t i = 0; i < nchunks; ++i) {
+    if (frame->offsets[i] > chunk_id) {
+      chunk_id = frame->offsets[i];
+    }
+  }
+  frame->bulk_chunk_id = chunk_id;
+  // The compressed offsets are outdated from now on
+  free(frame->coffsets);
+  frame->coffsets = NULL;
+  frame->coffsets_len = 0;
+  frame->bulk_pending = true;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Make room for one more entry in the offsets of a frame in bulk mode */
+static int grow_offsets(blosc2_frame_s* frame) {
+  if (frame->noffsets < frame->offsets_cap) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int64_t offsets_cap = frame->offsets_cap < 1024 ? 1024 : 2 * frame->offsets_cap;
+  int64_t* offsets = realloc(frame->offsets, (size_t)offsets_cap * sizeof(int64_t));
+  if (offsets == NULL) {
+    BLOSC_TRACE_ERROR("Cannot realloc space for the offsets.");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  frame->offsets = offsets;
+  frame->offsets_cap = offsets_cap;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Record the append of the chunk `nchunk` to a sparse frame in its index log */
+static int append_index_log(blosc2_frame_s* frame, int64_t nchunk, int64_t offset) {
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  uint8_t entry[SFRAME_INDEX_LOG_ENTRY_LEN];
+  to_little(entry, &nchunk, sizeof(int64_t));
+  to_little(entry + sizeof(int64_t), &offset, sizeof(int64_t));
+  memcpy(entry + 2 * sizeof(int64_t), frame->header, FRAME_HEADER_MINLEN);
+  void* fp = sframe_open_index_log(frame->urlpath, "rb+", frame->schunk->storage->io);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening the index log in: %s", frame->urlpath);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  // Over a torn entry, if any
+  int64_t wbytes = io_pwrite(io_cb, entry, 1, SFRAME_INDEX_LOG_ENTRY_LEN,
+                             frame->index_log_nentries * SFRAME_INDEX_LOG_ENTRY_LEN, fp);
+  io_cb->close(fp);
+  if (wbytes != SFRAME_INDEX_LOG_ENTRY_LEN) {
+    BLOSC_TRACE_ERROR("Cannot write the entry of chunk %" PRId64 " to the index log.", nchunk);
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  frame->index_log_nentries++;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Append a chunk to an on-disk frame in bulk mode.  Only the chunk is written; the
+ * offsets and the header are updated in memory until frame_flush_bulk(). */
+static void* append_chunk_bulk(blosc2_frame_s* frame, uint8_t* chunk, int32_t chunk_cbytes, int32_t header_len,
+                               int64_t cbytes, int64_t nchunks, blosc2_schunk* schunk) {
+  if (!frame->bulk_pending) {
+    if (start_bulk(frame, header_len, cbytes, nchunks) < 0) {
+      return NULL;
+    }
+    if (publishes_versions(frame)) {
+      // The published offsets and trailer are left for the readers, as part of the chunks
+      int64_t published = frame->len - header_len - cbytes;
+      cbytes += published;
+      schunk->cbytes += published;
+    }
+  }
+
+  if (grow_offsets(frame) < 0) {
+    return NULL;
+  }
+  // The new offset
+  int64_t offset;
+  int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  uint64_t offset_value = ((uint64_t)1 << 63);
+  switch (special_value) {
+    case BLOSC2_SPECIAL_ZERO:
+    case BLOSC2_SPECIAL_UNINIT:
+    case BLOSC2_SPECIAL_NAN:
+    case BLOSC2_SPECIAL_VIRTUAL:
+      offset_value += (uint64_t) special_value << (8 * 7);
+      to_little(&offset, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    default:
+      offset = frame->sframe ? frame->bulk_chunk_id + 1 : cbytes;
+  }
+  // Chunks of aligned frames start at the boundary
+  int32_t gap = get_chunk_gap(frame, header_len + cbytes, chunk_cbytes > 0);
+  if (gap > 0) {
+    cbytes += gap;
+    offset = cbytes;
+  }
+
+  if (chunk_cbytes > 0) {
+    if (frame->sframe) {
+      if (sframe_create_chunk(frame, chunk, offset, chunk_cbytes) == NULL) {
+        BLOSC_TRACE_ERROR("Cannot write the full chunk.");
+        return NULL;
+      }
+      frame->bulk_chunk_id = offset;
+    }
+    else {
+      blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+      if (io_cb == NULL) {
+        BLOSC_TRACE_ERROR("Error getting the input/output API");
+        return NULL;
+      }
+      void* fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        return NULL;
+      }
+      // Overwrites the outdated offsets and trailer, which are written again in the flush
+      int64_t wbytes = io_pwrite(io_cb, chunk, 1, chunk_cbytes, frame->file_offset + header_len + cbytes, fp);
+      io_cb->close(fp);
+      if (wbytes != chunk_cbytes) {
+        BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
+        return NULL;
+      }
+    }
+  }
+  frame->offsets[frame->noffsets++] = offset;
+  // The padding is only reserved (the offsets are written past it in the flush)
+  int32_t padding = get_chunk_padding(frame, header_len + cbytes + chunk_cbytes, chunk_cbytes);
+  schunk->cbytes += gap + padding;
+
+  // The offsets chunk does not count until it is written
+  frame->len = header_len + frame->trailer_len;
+  if (!frame->sframe) {
+    frame->len += cbytes + chunk_cbytes + padding;
+  }
+  uint8_t* h2 = new_header_frame(schunk, frame);
+  memcpy(frame->header, h2, FRAME_HEADER_MINLEN);
+  free(h2);
+
+  if (frame->index_log && frame->sframe) {
+    if (append_index_log(frame, frame->noffsets - 1, offset) < 0) {
+      return NULL;
+    }
+    if (frame->index_log_nentries >= FRAME_INDEX_LOG_NENTRIES && frame_flush_bulk(frame) < 0) {
+      return NULL;
+    }
+  }
+
+  return frame;
+}
+
+
+/* Write the offsets and the trailer of a contiguous frame past its chunks, and only then
+ * the header, so that the readers see either the previous version or the new one */
+static int publish_version(blosc2_frame_s* frame, uint8_t* off_chunk, int32_t off_cbytes, int64_t off_position) {
+  int rc = frame_load_vlmetalayers(frame, frame->schunk, -1);
+  if (rc < 0) {
+    return rc;
+  }
+  int64_t trailer_len;
+  uint8_t* trailer = new_trailer_frame(frame->schunk, frame->trailer_len, &trailer_len);
+  if (trailer == NULL) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    free(trailer);
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+    free(trailer);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  frame->len = off_position + off_cbytes + trailer_len;
+  frame->trailer_len = (uint32_t)trailer_len;
+  to_big(frame->header + FRAME_LEN, &frame->len, sizeof(frame->len));
+  int64_t position = frame->file_offset + off_position;
+  bool written = io_pwrite(io_cb, off_chunk, 1, off_cbytes, position, fp) == off_cbytes &&
+                 io_pwrite(io_cb, trailer, 1, trailer_len, position + off_cbytes, fp) == trailer_len;
+  free(trailer);
+  // The chunks and the offsets are durable before the header points to them
+  bool synced = frame->schunk->storage->durability >= BLOSC2_DURABILITY_GROUP;
+  rc = written && synced ? io_sync(io_cb, fp) : BLOSC2_ERROR_SUCCESS;
+  written = written && rc == BLOSC2_ERROR_SUCCESS &&
+            io_pwrite(io_cb, frame->header, 1, FRAME_HEADER_MINLEN, frame->file_offset, fp) == FRAME_HEADER_MINLEN;
+  rc = written && synced ? io_sync(io_cb, fp) : rc;
+  io_cb->close(fp);
+  if (rc < 0) {
+    return rc;
+  }
+  if (!written) {
+    BLOSC_TRACE_ERROR("Cannot write the new version of the frame.");
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  return 0;
+}
+
+
+int frame_flush_bulk(blosc2_frame_s* frame) {
+  if (!frame->bulk_pending) {
+    return 0;
+  }
+  // From here on, the frame is a regular one for the updates below
+  frame->bulk_pending = false;
+  frame_forget_open_reads(frame);
+
+  int32_t header_len;
+  int64_t cbytes;
+  from_big(&header_len, frame->header + FRAME_HEADER_LEN, sizeof(header_len));
+  from_big(&cbytes, frame->header + FRAME_CBYTES, sizeof(cbytes));
+
+  int32_t off_cbytes;
+  uint8_t* off_chunk = compress_offsets(frame->schunk->cctx, frame->index_format,
+                                        frame->offsets, frame->noffsets, &off_cbytes);
+  if (off_chunk == NULL) {
+    return BLOSC2_ERROR_DATA;
+  }
+  int64_t off_position = frame->sframe ? header_len : header_len + cbytes;
+  frame->group_nappends = 0;
+  if (publishes_versions(frame)) {
+    int rc = publish_version(frame, off_chunk, off_cbytes, off_position);
+    ctx_free(frame->schunk->cctx, off_chunk);
+    return rc;
+  }
+  frame->len = off_position + off_cbytes + frame->trailer_len;
+  to_big(frame->header + FRAME_LEN, &frame->len, sizeof(frame->len));
+
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    ctx_free(frame->schunk->cctx, off_chunk);
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp;
+  if (frame->sframe) {
+    fp = sframe_open_index(frame->urlpath, "rb+", frame->schunk->storage->io);
+  }
+  else {
+    fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
+  }
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+    ctx_free(frame->schunk->cctx, off_chunk);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  // Only the fixed-size part of the header changes with appends
+  int64_t wbytes = io_pwrite(io_cb, frame->header, 1, FRAME_HEADER_MINLEN, frame->file_offset, fp);
+  if (wbytes == FRAME_HEADER_MINLEN) {
+    wbytes = io_pwrite(io_cb, off_chunk, 1, off_cbytes, frame->file_offset + off_position, fp);
+    wbytes = wbytes == off_cbytes ? FRAME_HEADER_MINLEN : 0;
+  }
+  io_cb->close(fp);
+  ctx_free(frame->schunk->cctx, off_chunk);
+  if (wbytes != FRAME_HEADER_MINLEN) {
+    BLOSC_TRACE_ERROR("Cannot write the offsets and header to frame.");
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+
+  int rc = frame_update_trailer(frame, frame->schunk);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot write the trailer to frame.");
+    return rc;
+  }
+
+  if (frame->index_log && frame->index_log_nentries > 0) {
+    // Everything in the log is in the index now
+    fp = sframe_open_index_log(frame->urlpath, "wb", frame->schunk->storage->io);
+    if (fp == NULL) {
+      BLOSC_TRACE_ERROR("Cannot empty the index log in: %s", frame->urlpath);
+      return BLOSC2_ERROR_FILE_OPEN;
+    }
+    io_cb->close(fp);
+    frame->index_log_nentries = 0;
+  }
+  return 0;
+}
+
+
+
+int frame_replay_index_log(blosc2_frame_s* frame) {
+  blosc2_schunk* schunk = frame->schunk;
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  if (!frame->index_log) {
+    return 0;
+  }
+  void* fp = sframe_open_index_log(frame->urlpath, "rb", schunk->storage->io);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Cannot open the index log in: %s", frame->urlpath);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  io_cb->seek(fp, 0, SEEK_END);
+  // A torn entry at the end (of an append that did not finish) is left out
+  int64_t nentries = io_cb->tell(fp) / SFRAME_INDEX_LOG_ENTRY_LEN;
+  uint8_t* entries = nentries > 0 ? malloc((size_t)(nentries * SFRAME_INDEX_LOG_ENTRY_LEN)) : NULL;
+  int64_t rbytes = entries == NULL ? 0 : io_pread(io_cb, entries, 1, nentries * SFRAME_INDEX_LOG_ENTRY_LEN, 0, fp);
+  io_cb->close(fp);
+  frame->index_log_nentries = nentries;
+  if (nentries == 0) {
+    return 0;
+  }
+  if (rbytes != nentries * SFRAME_INDEX_LOG_ENTRY_LEN) {
+    BLOSC_TRACE_ERROR("Cannot read the index log in: %s", frame->urlpath);
+    free(entries);
+    return BLOSC2_ERROR_FILE_READ;
+  }
+
+  // The trailer is read before its place in the index is forgotten
+  int rc = frame_load_vlmetalayers(frame, schunk, -1);
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  if (rc >= 0) {
+    // This keeps the header in the frame too
+    rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, &chunksize, &nchunks,
+                         NULL, NULL, NULL, NULL, NULL, NULL, NULL, schunk->storage->io);
+  }
+  const uint8_t* header = NULL;
+  for (int64_t i = 0; rc >= 0 && i < nentries; i++) {
+    uint8_t* entry = entries + i * SFRAME_INDEX_LOG_ENTRY_LEN;
+    int64_t nchunk;
+    int64_t offset;
+    from_little(&nchunk, entry, sizeof(int64_t));
+    from_little(&offset, entry + sizeof(int64_t), sizeof(int64_t));
+    if (nchunk < schunk->nchunks && header == NULL) {
+      // Merged already, before the log could be emptied
+      continue;
+    }
+    if (!frame->bulk_pending) {
+      rc = start_bulk(frame, header_len, schunk->cbytes, schunk->nchunks);
+      if (rc < 0) {
+        break;
+      }
+    }
+    if (nchunk != frame->noffsets) {
+      BLOSC_TRACE_ERROR("The index log does not follow the index in: %s", frame->urlpath);
+      rc = BLOSC2_ERROR_DATA;
+      break;
+    }
+    rc = grow_offsets(frame);
+    if (rc < 0) {
+      break;
+    }
+    frame->offsets[frame->noffsets++] = offset;
+    if (offset > frame->bulk_chunk_id) {
+      frame->bulk_chunk_id = offset;
+    }
+    header = entry + 2 * sizeof(int64_t);
+  }
+  if (rc < 0 || header == NULL) {
+    free(entries);
+    return rc < 0 ? rc : 0;
+  }
+
+  // The counters after the last append
+  memcpy(frame->header, header, FRAME_HEADER_MINLEN);
+  free(entries);
+  rc = get_header_info(frame, &header_len, &frame_len, &schunk->nbytes, &schunk->cbytes, &schunk->blocksize,
+                       &schunk->chunksize, &schunk->nchunks, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                       schunk->storage->io);
+  if (rc < 0) {
+    return rc;
+  }
+  if (schunk->nchunks != frame->noffsets) {
+    BLOSC_TRACE_ERROR("The index log does not match its chunks in: %s", frame->urlpath);
+    return BLOSC2_ERROR_DATA;
+  }
+  frame->len = header_len + frame->trailer_len;
+  return 0;
+}
+
+
+struct frame_writers {
+  pthread_mutex_t mutex;   // serializes the updates of the offsets, header and counters
+  pthread_mutex_t shards;  // serializes the writes to the shard files of the chunks
+};
+
+
+int frame_set_concurrent_writes(blosc2_frame_s* frame, bool enable) {
+  frame_writers *writers = frame->writers;
+  if (!enable) {
+    if (writers == NULL) {
+      return BLOSC2_ERROR_SUCCESS;
+    }
+    frame->writers = NULL;
+    frame->bulk = false;
+    pthread_mutex_destroy(&writers->mutex);
+    pthread_mutex_destroy(&writers->shards);
+    free(writers);
+    return frame_flush_bulk(frame);
+  }
+  if (writers != NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (!frame->sframe) {
+    BLOSC_TRACE_ERROR("Concurrent writes are only supported in sparse frames.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (frame->prefetcher != NULL || frame->concurrent_reads) {
+    BLOSC_TRACE_ERROR("Concurrent writes cannot be used with the read-ahead or concurrent reads.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  // The trailer is rewritten by the writers in turns
+  int rc = frame_load_vlmetalayers(frame, frame->schunk, -1);
+  if (rc < 0) {
+    return rc;
+  }
+
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int32_t typesize;
+  // Reading the header keeps it in the frame
+  rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, &chunksize,
+                       &nchunks, &typesize, NULL, NULL, NULL, NULL, NULL, NULL,
+                       frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+  if (!frame->bulk_pending) {
+    rc = start_bulk(frame, header_len, cbytes, nchunks);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  writers = calloc(1, sizeof(frame_writers));
+  BLOSC_ERROR_NULL(writers, BLOSC2_ERROR_MEMORY_ALLOC);
+  pthread_mutex_init(&writers->mutex, NULL);
+  pthread_mutex_init(&writers->shards, NULL);
+  frame->bulk = true;
+  frame->writers = writers;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Point the chunk `nchunk` of a sparse frame with concurrent writes (or a new one
+ * if negative) to `offset`, and update the counters of the super-chunk.  Must be
+ * called with the mutex of the writers held. */
+int frame_set_versioned_commits(blosc2_frame_s* frame, bool enable) {
+  if (enable && (frame->cframe != NULL || frame->sframe)) {
+    BLOSC_TRACE_ERROR("Versioned commits are only supported in contiguous frames on disk.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  // The appends so far are committed the way they were done
+  int rc = frame_flush_bulk(frame);
+  if (rc < 0) {
+    return rc;
+  }
+  frame->versioned = enable;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t frame_refresh(blosc2_frame_s* frame) {
+  blosc2_schunk* schunk = frame->schunk;
+  if (frame->cframe != NULL || frame->sframe) {
+    BLOSC_TRACE_ERROR("Only contiguous frames on disk can be refreshed.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (frame->bulk_pending) {
+    // The writer knows better than the file
+    return schunk->nchunks;
+  }
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, &chunksize,
+                           &nchunks, NULL, NULL, NULL, NULL, NULL, NULL, NULL, schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp = io_cb->open(frame->urlpath, "rb", schunk->storage->io->params);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  // A header read while it is being written does not match the next read
+  uint8_t header[FRAME_HEADER_MINLEN];
+  uint8_t check[FRAME_HEADER_MINLEN];
+  bool consistent = false;
+  int64_t rbytes = io_pread(io_cb, header, 1, FRAME_HEADER_MINLEN, frame->file_offset, fp);
+  for (int i = 0; i < FRAME_REFRESH_NREADS && rbytes == FRAME_HEADER_MINLEN && !consistent; ++i) {
+    rbytes = io_pread(io_cb, check, 1, FRAME_HEADER_MINLEN, frame->file_offset, fp);
+    consistent = rbytes == FRAME_HEADER_MINLEN && memcmp(header, check, FRAME_HEADER_MINLEN) == 0;
+    memcpy(header, check, FRAME_HEADER_MINLEN);
+  }
+  if (!consistent) {
+    io_cb->close(fp);
+    BLOSC_TRACE_ERROR("Cannot read a consistent header of the frame.");
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  int32_t new_header_len;
+  from_big(&frame_len, header + FRAME_LEN, sizeof(frame_len));
+  from_big(&new_header_len, header + FRAME_HEADER_LEN, sizeof(new_header_len));
+  if (frame_len == frame->len) {
+    io_cb->close(fp);
+    return schunk->nchunks;
+  }
+  if (new_header_len != header_len || frame_len < header_len + FRAME_TRAILER_MINLEN) {
+    io_cb->close(fp);
+    BLOSC_TRACE_ERROR("The frame has changed beyond appends; it has to be opened again.");
+    return BLOSC2_ERROR_FRAME_TYPE;
+  }
+  // The marker and the length at the end of the new trailer
+  uint8_t tail[FRAME_TRAILER_LEN_OFFSET + 1];
+  rbytes = io_pread(io_cb, tail, 1, sizeof(tail), frame->file_offset + frame_len - (int64_t)sizeof(tail), fp);
+  io_cb->close(fp);
+  if (rbytes != (int64_t)sizeof(tail) || tail[0] != 0xce) {
+    BLOSC_TRACE_ERROR("Cannot read the trailer of the new version of the frame.");
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  uint32_t trailer_len;
+  from_big(&trailer_len, tail + 1, sizeof(trailer_len));
+
+  // The chunks read so far are still good, but not the offsets
+  frame_invalidate_caches(frame);
+  frame->header = malloc(FRAME_HEADER_MINLEN);
+  memcpy(frame->header, header, FRAME_HEADER_MINLEN);
+  frame->len = frame_len;
+  frame->trailer_len = trailer_len;
+  rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, &chunksize,
+                           &nchunks, NULL, NULL, NULL, NULL, NULL, NULL, NULL, schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return rc;
+  }
+  schunk->nbytes = nbytes;
+  schunk->cbytes = cbytes;
+  schunk->blocksize = blocksize;
+  schunk->chunksize = chunksize;
+  schunk->nchunks = nchunks;
+  if (frame->concurrent_reads) {
+    // The lazy caches of the concurrent readers are filled up front again
+    rc = frame_set_concurrent_reads(frame, true);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  return nchunks;
+}
+
+
+static int64_t set_chunk_offset(blosc2_frame_s* frame, int64_t nchunk, int64_t offset,
+                                int32_t chunk_nbytes, int32_t chunk_cbytes, int64_t* old_offset) {
+  blosc2_schunk* schunk = frame->schunk;
+  *old_offset = -1;
+  if (!frame->bulk_pending) {
+    // Some other update of the frame flushed the offsets meanwhile
+    int32_t header_len;
+    int64_t cbytes;
+    from_big(&header_len, frame->header + FRAME_HEADER_LEN, sizeof(header_len));
+    from_big(&cbytes, frame->header + FRAME_CBYTES, sizeof(cbytes));
+    int rc = start_bulk(frame, header_len, cbytes, schunk->nchunks);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  if (nchunk < 0) {
+    if (schunk->chunksize == -1) {
+      schunk->chunksize = chunk_nbytes;  // The super-chunk is initialized now
+    }
+    if (chunk_nbytes > schunk->chunksize) {
+      BLOSC_TRACE_ERROR("Appending chunks that have different lengths in the same schunk "
+                        "is not supported yet: %d > %d.", chunk_nbytes, schunk->chunksize);
+      return BLOSC2_ERROR_CHUNK_APPEND;
+    }
+    if (schunk->chunksize > 0 && schunk->nbytes % schunk->chunksize != 0) {
+      BLOSC_TRACE_ERROR("Appending a chunk after a chunk smaller than the schunk chunksize "
+                        "is not allowed yet.");
+      return BLOSC2_ERROR_CHUNK_APPEND;
+    }
+    int rc = grow_offsets(frame);
+    if (rc < 0) {
+      return rc;
+    }
+    frame->offsets[frame->noffsets++] = offset;
+    schunk->nchunks = frame->noffsets;
+    schunk->nbytes += chunk_nbytes;
+    schunk->cbytes += chunk_cbytes;
+  }
+  else {
+    if (nchunk >= frame->noffsets) {
+      BLOSC_TRACE_ERROR("The chunk %" PRId64 " is not in the frame.", nchunk);
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    if (chunk_nbytes > schunk->chunksize ||
+        (chunk_nbytes < schunk->chunksize && nchunk != schunk->nchunks - 1)) {
+      BLOSC_TRACE_ERROR("Updating chunks that have different lengths in the same schunk "
+                        "is not supported yet (unless it's the last one and smaller):"
+                        " %d > %d.", chunk_nbytes, schunk->chunksize);
+      return BLOSC2_ERROR_CHUNK_UPDATE;
+    }
+    uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+    int rc = frame_get_chunk_headers(frame, nchunk, nchunk + 1, header);
+    if (rc < 0) {
+      return rc;
+    }
+    int32_t old_nbytes;
+    int32_t old_cbytes;
+    rc = blosc2_cbuffer_sizes(header, &old_nbytes, &old_cbytes, NULL);
+    if (rc < 0) {
+      return rc;
+    }
+    *old_offset = frame->offsets[nchunk];
+    if (*old_offset < 0) {
+      old_cbytes = 0;  // special chunks are not stored
+    }
+    frame->offsets[nchunk] = offset;
+    schunk->nbytes += chunk_nbytes - old_nbytes;
+    schunk->cbytes += chunk_cbytes - old_cbytes;
+  }
+
+  // The offsets chunk does not count until it is written
+  int32_t header_len;
+  from_big(&header_len, frame->header + FRAME_HEADER_LEN, sizeof(header_len));
+  frame->len = header_len + frame->trailer_len;
+  uint8_t* h2 = new_header_frame(schunk, frame);
+  memcpy(frame->header, h2, FRAME_HEADER_MINLEN);
+  free(h2);
+
+  return schunk->nchunks;
+}
+
+
+/* Delete a chunk of a sparse frame with concurrent writes */
+static void put_delete_chunk(blosc2_frame_s* frame, int64_t offset) {
+  // Shards are shared with the other writers
+  bool sharded = frame->shard_nchunks > 0;
+  if (sharded) {
+    pthread_mutex_lock(&frame->writers->shards);
+  }
+  sframe_delete_chunk(frame, offset);
+  if (sharded) {
+    pthread_mutex_unlock(&frame->writers->shards);
+  }
+}
+
+
+int64_t frame_put_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t* chunk) {
+  int32_t chunk_nbytes;
+  int32_t chunk_cbytes;
+  int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    return rc;
+  }
+
+  // The chunk goes to a file of its own, which no other writer touches (or to a shard, in turns)
+  int64_t offset;
+  int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  uint64_t offset_value = ((uint64_t)1 << 63);
+  switch (special_value) {
+    case BLOSC2_SPECIAL_ZERO:
+    case BLOSC2_SPECIAL_UNINIT:
+    case BLOSC2_SPECIAL_NAN:
+    case BLOSC2_SPECIAL_VIRTUAL:
+      offset_value += (uint64_t) special_value << (8 * 7);
+      to_little(&offset, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    default:
+      offset = blosc_atomic_add64((volatile int64_t*)&frame->bulk_chunk_id, 1) + 1;
+      if (frame->shard_nchunks > 0) {
+        pthread_mutex_lock(&frame->writers->shards);
+      }
+      void* created = sframe_create_chunk(frame, chunk, offset, chunk_cbytes);
+      if (frame->shard_nchunks > 0) {
+        pthread_mutex_unlock(&frame->writers->shards);
+      }
+      if (created == NULL) {
+        BLOSC_TRACE_ERROR("Cannot write the full chunk.");
+        return BLOSC2_ERROR_FILE_WRITE;
+      }
+  }
+
+  // Only the index is updated in turns
+  int64_t old_offset;
+  pthread_mutex_lock(&frame->writers->mutex);
+  int64_t nchunks = set_chunk_offset(frame, nchunk, offset, chunk_nbytes, chunk_cbytes, &old_offset);
+  pthread_mutex_unlock(&frame->writers->mutex);
+
+  if (nchunks < 0 && chunk_cbytes > 0) {
+    put_delete_chunk(frame, offset);
+  }
+  if (old_offset >= 0) {
+    // The readers of the old chunk, if any, are to be synchronized by the caller
+    put_delete_chunk(frame, old_offset);
+  }
+  return nchunks;
+}
+
+/* Append an existing chunk into a frame. */
+void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schunk) {
+  if (frame_load_vlmetalayers(frame, schunk, -1) < 0) {
+    return NULL;
+  }
+  int8_t* chunk_ = chunk;
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, &chunksize,
+                           &nchunks, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return NULL;
+  }
+
+  /* The uncompressed and compressed sizes start at byte 4 and 12 */
+  int32_t chunk_nbytes;
+  int32_t chunk_cbytes;
+  rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  if ((nchunks > 0) && (chunk_nbytes > chunksize)) {
+    BLOSC_TRACE_ERROR("Appending chunks with a larger chunksize than frame is "
+                      "not allowed yet %d != %d.", chunk_nbytes, chunksize);
+    return NULL;
+  }
+
+  // Check that we are not appending a small chunk after another small chunk
+  int32_t chunk_nbytes_last;
+  if (chunksize == 0 && (nchunks > 0) && (chunk_nbytes < chunksize)) {
+    uint8_t* last_chunk;
+    bool needs_free;
+    rc = frame_get_lazychunk(frame, nchunks - 1, &last_chunk, &needs_free);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the last chunk (in position %" PRId64 ").", nchunks - 1);
+    } else {
+      rc = blosc2_cbuffer_sizes(last_chunk, &chunk_nbytes_last, NULL, NULL);
+    }
+    if (needs_free) {
+      free(last_chunk);
+    }
+    if (rc < 0) {
+      return NULL;
+    }
+    if ((chunk_nbytes_last < chunksize) && (nbytes < chunksize)) {
+      BLOSC_TRACE_ERROR("Appending two consecutive chunks with a chunksize smaller "
+                        "than the frame chunksize is not allowed yet: %d != %d.",
+                        chunk_nbytes, chunksize);
+      return NULL;
+    }
+  }
+
+  if (frame->bulk || (frame->index_log && frame->sframe)) {
+    return append_chunk_bulk(frame, chunk, chunk_cbytes, header_len, cbytes, nchunks, schunk);
+  }
+  if (publishes_versions(frame)) {
+    // Every append is a version of its own, but for the ones synced in groups
+    if (append_chunk_bulk(frame, chunk, chunk_cbytes, header_len, cbytes, nchunks, schunk) == NULL) {
+      return NULL;
+    }
+    if (frame->group_nappends++ == 0) {
+      blosc_set_timestamp(&frame->group_start);
+    }
+    if (schunk->storage->durability == BLOSC2_DURABILITY_GROUP && !group_commit_due(frame)) {
+      return frame;
+    }
+    return frame_flush_bulk(frame) < 0 ? NULL : frame;
+  }
+
+  // Get the current offsets and add one more
+  int64_t off_nbytes = (int64_t)(nchunks + 1) * (int64_t)sizeof(int64_t);
+  int64_t* offsets = (int64_t *) ctx_malloc(schunk->cctx, (size_t)off_nbytes);
+  if (nchunks > 0) {
+    int32_t coffsets_cbytes;
+    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
+    if (coffsets == NULL) {
+      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
+      ctx_free(schunk->cctx, offsets);
+      return NULL;
+    }
+    if (coffsets_cbytes == 0) {
+      coffsets_cbytes = (int32_t)cbytes;
+    }
+
+    // Decompress offsets
+    int64_t prev_nbytes = decompress_offsets(schunk->cctx, frame->index_format,
+                                             coffsets, coffsets_cbytes, offsets, nchunks);
+    if (prev_nbytes < 0) {
+      ctx_free(schunk->cctx, offsets);
+      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
+      return NULL;
+    }
+  }
+
+  // Add the new offset
+  int64_t sframe_chunk_id = -1;
+  int special_value = (chunk_[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  uint64_t offset_value = ((uint64_t)1 << 63);
+  switch (special_value) {
+    case BLOSC2_SPECIAL_ZERO:
+      // Zero chunk.  Code it in a special way.
+      offset_value += (uint64_t) BLOSC2_SPECIAL_ZERO << (8 * 7);  // chunk of zeros
+      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_UNINIT:
+      // Non initizalized values chunk.  Code it in a special way.
+      offset_value += (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);  // chunk of uninit values
+      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_VIRTUAL:
+      // Virtual chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_VIRTUAL << (8 * 7);  // indicate a chunk of generated values
+      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_NAN:
+      // NaN chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);  // chunk of NANs
+      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    default:
+      if (frame->sframe) {
+        // Compute the sframe_chunk_id value
+        for (int i = 0; i < nchunks; ++i) {
+          if (offsets[i] > sframe_chunk_id) {
+            sframe_chunk_id = offsets[i];
+          }
+        }
+        offsets[nchunks] = ++sframe_chunk_id;
+      }
+      else {
+        offsets[nchunks] = cbytes;
+      }
+  }
+  // Chunks of aligned frames start at the boundary
+  int32_t gap = get_chunk_gap(frame, header_len + cbytes, chunk_cbytes > 0);
+  cbytes += gap;
+  if (gap > 0) {
+    offsets[nchunks] = cbytes;
+  }
+
+  // Re-compress the offsets again
+  int32_t new_off_cbytes;
+  uint8_t* off_chunk = compress_offsets(schunk->cctx, frame->index_format, offsets, nchunks + 1, &new_off_cbytes);
+  ctx_free(schunk->cctx, offsets);
+  if (off_chunk == NULL) {
+    return NULL;
+  }
+  // printf("%f\n", (double) off_nbytes / new_off_cbytes);
+
+  int32_t padding = get_chunk_padding(frame, header_len + cbytes + chunk_cbytes, chunk_cbytes);
+  int64_t new_cbytes = cbytes + chunk_cbytes + padding;
+  int64_t new_frame_len;
+  if (frame->sframe) {
+    new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
+  }
+  else {
+    new_frame_len = header_len + new_cbytes + new_off_cbytes + frame->trailer_len;
+  }
+
+  void* fp = NULL;
+  if (frame->cframe != NULL) {
+    /* Make space for the new chunk and copy it */
+    uint8_t* framep = frame_reserve(frame, new_frame_len);
+    if (framep == NULL) {
+      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      ctx_free(schunk->cctx, off_chunk);
+      return NULL;
+    }
+    /* Copy the chunk */
+    memset(framep + header_len + cbytes - gap, 0, (size_t)gap);
+    memcpy(framep + header_len + cbytes, chunk, (size_t)chunk_cbytes);
+    memset(framep + header_len + cbytes + chunk_cbytes, 0, (size_t)padding);
+    /* Copy the offsets */
+    memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
+  }
+  else {
+    int64_t wbytes;
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      ctx_free(schunk->cctx, off_chunk);
+      return NULL;
+    }
+
+    if (frame->sframe) {
+      // Update the offsets chunk in the chunks frame
+      if (chunk_cbytes != 0) {
+        if (sframe_chunk_id < 0) {
+          BLOSC_TRACE_ERROR("The chunk id (%" PRId64 ") is not correct", sframe_chunk_id);
+          ctx_free(schunk->cctx, off_chunk);
+          return NULL;
+        }
+        if (sframe_create_chunk(frame, chunk, sframe_chunk_id, chunk_cbytes) == NULL) {
+          BLOSC_TRACE_ERROR("Cannot write the full chunk.");
+          ctx_free(schunk->cctx, off_chunk);
+          return NULL;
+        }
+      }
+      fp = sframe_open_index(frame->urlpath, "rb+",
+                             frame->schunk->storage->io);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        ctx_free(schunk->cctx, off_chunk);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len, SEEK_SET);
+    }
+    else {
+      // Regular frame
+      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        ctx_free(schunk->cctx, off_chunk);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
+      wbytes = io_cb->write(chunk, 1, chunk_cbytes, fp);  // the new chunk
+      if (wbytes != chunk_cbytes) {
+        BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
+        io_cb->close(fp);
+        ctx_free(schunk->cctx, off_chunk);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + new_cbytes, SEEK_SET);
+    }
+    wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
+    io_cb->close(fp);
+    if (wbytes != new_off_cbytes) {
+      BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
+      ctx_free(schunk->cctx, off_chunk);
+      return NULL;
+    }
+  }
+  // Invalidate the caches for the header and chunk offsets
+  frame_invalidate_caches(frame);
+  ctx_free(schunk->cctx, off_chunk);
+
+  schunk->cbytes += gap + padding;
+  frame->len = new_frame_len;
+  rc = frame_update_header(frame, schunk, false);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  rc = frame_update_trailer(frame, schunk);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  return frame;
+}
+
+
+void* frame_insert_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk) {
+  if (frame->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(frame);
+    if (rc_ < 0) {
+      return NULL;
+    }
+  }
+  if (frame_load_vlmetalayers(frame, schunk, -1) < 0) {
+    return NULL;
+  }
+  uint8_t* chunk_ = chunk;
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return NULL;
+  }
+  int32_t chunk_cbytes;
+  rc = blosc2_cbuffer_sizes(chunk_, NULL, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  // Get the current offsets
+  int64_t off_nbytes = (int64_t)(nchunks + 1) * (int64_t)sizeof(int64_t);
+  int64_t* offsets = (int64_t *) ctx_malloc(schunk->cctx, (size_t)off_nbytes);
+  if (nchunks > 0) {
+    int32_t coffsets_cbytes = 0;
+    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
+    if (coffsets == NULL) {
+      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
+      return NULL;
+    }
+    if (coffsets_cbytes == 0) {
+      coffsets_cbytes = (int32_t)cbytes;
+    }
+
+    // Decompress offsets
+    int64_t prev_nbytes = decompress_offsets(schunk->cctx, frame->index_format,
+                                             coffsets, coffsets_cbytes, offsets, nchunks);
+    if (prev_nbytes < 0) {
+      ctx_free(schunk->cctx, offsets);
+      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
+      return NULL;
+    }
+  }
+
+  // TODO: Improvement: Check if new chunk is smaller than previous one
+
+  // Move offsets
+  for (int64_t i = nchunks; i > nchunk; i--) {
+    offsets[i] = offsets[i - 1];
+  }
+  // Add the new offset
+  int64_t sframe_chunk_id = -1;
+  int special_value = (chunk_[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  uint64_t offset_value = ((uint64_t)1 << 63);
+  switch (special_value) {
+    case BLOSC2_SPECIAL_ZERO:
+      // Zero chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_ZERO << (8 * 7);  // indicate a chunk of zeros
+      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_UNINIT:
+      // Non initizalized values chunk.  Code it in a special way.
+      offset_value += (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);  // chunk of uninit values
+      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_VIRTUAL:
+      // Virtual chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_VIRTUAL << (8 * 7);  // indicate a chunk of generated values
+      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_NAN:
+      // NaN chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);  // indicate a chunk of NANs
+      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    default:
+      if (frame->sframe) {
+        for (int i = 0; i <= nchunks; ++i) {
+          // offsets[nchunk] is still uninitialized here
+          if (i != nchunk && offsets[i] > sframe_chunk_id) {
+            sframe_chunk_id = offsets[i];
+          }
+        }
+        offsets[nchunk] = ++sframe_chunk_id;
+      }
+      else {
+        offsets[nchunk] = cbytes;
+      }
+  }
+  // Chunks of aligned frames start at the boundary, and so does the index after them
+  int32_t gap = get_chunk_gap(frame, header_len + cbytes, chunk_cbytes > 0);
+  cbytes += gap;
+  if (gap > 0) {
+    offsets[nchunk] = cbytes;
+  }
+  int32_t padding = get_chunk_gap(frame, header_len + cbytes + chunk_cbytes, chunk_cbytes > 0);
+
+  // Re-compress the offsets again
+  int32_t new_off_cbytes;
+  uint8_t* off_chunk = compress_offsets(schunk->cctx, frame->index_format, offsets, nchunks + 1, &new_off_cbytes);
+  ctx_free(schunk->cctx, offsets);
+  if (off_chunk == NULL) {
+    return NULL;
+  }
+
+  int64_t new_cbytes = cbytes + chunk_cbytes + padding;
+
+  int64_t new_frame_len;
+  if (frame->sframe) {
+    new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
+  }
+  else {
+    new_frame_len = header_len + new_cbytes + new_off_cbytes + frame->trailer_len;
+  }
+
+  // Add the chunk and update meta
+  void* fp = NULL;
+  if (frame->cframe != NULL) {
+    /* Make space for the new chunk and copy it */
+    uint8_t* framep = frame_reserve(frame, new_frame_len);
+    if (framep == NULL) {
+      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      ctx_free(schunk->cctx, off_chunk);
+      return NULL;
+    }
+    /* Copy the chunk */
+    memset(framep + header_len + cbytes - gap, 0, (size_t)gap);
+    memcpy(framep + header_len + cbytes, chunk, (size_t)chunk_cbytes);
+    memset(framep + header_len + cbytes + chunk_cbytes, 0, (size_t)padding);
+    /* Copy the offsets */
+    memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
+  } else {
+    int64_t wbytes;
+
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      ctx_free(schunk->cctx, off_chunk);
+      return NULL;
+    }
+
+    if (frame->sframe) {
+      if (chunk_cbytes != 0) {
+        if (sframe_chunk_id < 0) {
+          BLOSC_TRACE_ERROR("The chunk id (%" PRId64 ") is not correct", sframe_chunk_id);
+          ctx_free(schunk->cctx, off_chunk);
+          return NULL;
+        }
+        if (sframe_create_chunk(frame, chunk, sframe_chunk_id, chunk_cbytes) == NULL) {
+          BLOSC_TRACE_ERROR("Cannot write the full chunk.");
+          ctx_free(schunk->cctx, off_chunk);
+          return NULL;
+        }
+      }
+      // Update the offsets chunk in the chunks frame
+      fp = sframe_open_index(frame->urlpath, "rb+",
+                             frame->schunk->storage->io);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        ctx_free(schunk->cctx, off_chunk);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + 0, SEEK_SET);
+    }
+    else {
+      // Regular frame
+      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        ctx_free(schunk->cctx, off_chunk);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
+      wbytes = io_cb->write(chunk, 1, chunk_cbytes, fp);  // the new chunk
+      if (wbytes != chunk_cbytes) {
+        BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
+        io_cb->close(fp);
+        ctx_free(schunk->cctx, off_chunk);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + new_cbytes, SEEK_SET);
+    }
+    wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
+    io_cb->close(fp);
+    if (wbytes != new_off_cbytes) {
+      BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
+      ctx_free(schunk->cctx, off_chunk);
+      return NULL;
+    }
+    // Invalidate the caches for the header and chunk offsets
+    frame_invalidate_caches(frame);
+  }
+  free(chunk);  // chunk has always to be a copy when reaching here...
+  ctx_free(schunk->cctx, off_chunk);
+
+  schunk->cbytes += gap + padding;
+  frame->len = new_frame_len;
+  rc = frame_update_header(frame, schunk, false);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  rc = frame_update_trailer(frame, schunk);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  return frame;
+}
+
+
+void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk) {
+  if (frame->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(frame);
+    if (rc_ < 0) {
+      return NULL;
+    }
+  }
+  if (frame_load_vlmetalayers(frame, schunk, -1) < 0) {
+    return NULL;
+  }
+  uint8_t *chunk_ = (uint8_t *) chunk;
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return NULL;
+  }
+  if (nchunk >= nchunks) {
+    BLOSC_TRACE_ERROR("The chunk must already exist.");
+    return NULL;
+  }
+
+  int32_t chunk_cbytes;
+  rc = blosc2_cbuffer_sizes(chunk, NULL, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  // Get the current offsets
+  int64_t off_nbytes = (int64_t)nchunks * (int64_t)sizeof(int64_t);
+  int64_t* offsets = (int64_t *) ctx_malloc(schunk->cctx, (size_t)off_nbytes);
+  if (nchunks > 0) {
+    int32_t coffsets_cbytes = 0;
+    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
+    if (coffsets == NULL) {
+      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
+      return NULL;
+    }
+    if (coffsets_cbytes == 0) {
+      coffsets_cbytes = (int32_t)cbytes;
+    }
+
+    // Decompress offsets
+    int64_t prev_nbytes = decompress_offsets(schunk->cctx, frame->index_format,
+                                             coffsets, coffsets_cbytes, offsets, nchunks);
+    if (prev_nbytes < 0) {
+      ctx_free(schunk->cctx, offsets);
+      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
+      return NULL;
+    }
+  }
+  int64_t old_offset = -1;
+  int64_t slot_end = -1;
+  if (!frame->sframe) {
+    // The slot of the old chunk goes up to the next chunk stored (or to the end of the chunks),
+    // unless other chunks share it (see frame_fill_special)
+    old_offset = offsets[nchunk];
+    if (old_offset >= 0) {
+      slot_end = cbytes;
+      for (int64_t i = 0; i < nchunks; ++i) {
+        if (offsets[i] > old_offset && offsets[i] < slot_end) {
+          slot_end = offsets[i];
+        }
+        if (offsets[i] == old_offset && i != nchunk) {
+          old_offset = -1;
+          break;
+        }
+      }
+    }
+  }
+
+  // Add the new offset
+  int64_t sframe_chunk_id = -1;
+  if (frame->sframe) {
+    if (offsets[nchunk] < 0) {
+      sframe_chunk_id = -1;
+    }
+    else {
+      // In case there was a reorder in a sframe
+      sframe_chunk_id = offsets[nchunk];
+    }
+  }
+  int special_value = (chunk_[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  uint64_t offset_value = ((uint64_t)1 << 63);
+  switch (special_value) {
+    case BLOSC2_SPECIAL_ZERO:
+      // Zero chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_ZERO << (8 * 7);  // indicate a chunk of zeros
+      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_UNINIT:
+      // Non initizalized values chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_UNINIT << (8 * 7);  // indicate a chunk of uninit values
+      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_VIRTUAL:
+      // Virtual chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_VIRTUAL << (8 * 7);  // indicate a chunk of generated values
+      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    case BLOSC2_SPECIAL_NAN:
+      // NaN chunk.  Code it in a special way.
+      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);  // indicate a chunk of NANs
+      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
+      chunk_cbytes = 0;   // we don't need to store the chunk
+      break;
+    default:
+      if (frame->sframe) {
+        if (sframe_chunk_id < 0) {
+          for (int i = 0; i < nchunks; ++i) {
+            if (offsets[i] > sframe_chunk_id) {
+              sframe_chunk_id = offsets[i];
+            }
+          }
+          offsets[nchunk] = ++sframe_chunk_id;
+        }
+      }
+      else {
+        // Add the new offset
+        offsets[nchunk] = cbytes;
+      }
+  }
+
+  int64_t new_cbytes = cbytes;
+  int32_t gap = 0;
+  int32_t padding = 0;
+  if (!frame->sframe && chunk_cbytes != 0) {
+    if (old_offset >= 0 && old_offset + chunk_cbytes <= slot_end) {
+      // The new chunk fits in the slot of the old one
+      offsets[nchunk] = old_offset;
+      cbytes = old_offset;
+    }
+    else {
+      // Chunks of aligned frames start at the boundary
+      gap = get_chunk_gap(frame, header_len + cbytes, chunk_cbytes > 0);
+      cbytes += gap;
+      offsets[nchunk] = cbytes;
+      padding = get_chunk_padding(frame, header_len + cbytes + chunk_cbytes, chunk_cbytes);
+      new_cbytes += gap + chunk_cbytes + padding;
+    }
+  }
+  // Re-compress the offsets again
+  int32_t new_off_cbytes;
+  uint8_t* off_chunk = compress_offsets(schunk->cctx, frame->index_format, offsets, nchunks, &new_off_cbytes);
+  ctx_free(schunk->cctx, offsets);
+  if (off_chunk == NULL) {
+    return NULL;
+  }
+
+  if (!frame->sframe) {
+    // The chunks of contiguous frames take all the space up to the offsets
+    schunk->cbytes = new_cbytes;
+  }
+  int64_t new_frame_len;
+  if (frame->sframe) {
+    // The chunk is not stored in the frame
+    new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
+  }
+  else {
+    new_frame_len = header_len + new_cbytes + new_off_cbytes + frame->trailer_len;
+  }
+
+  void* fp = NULL;
+  if (frame->cframe != NULL) {
+    /* Make space for the new chunk and copy it */
+    uint8_t* framep = frame_reserve(frame, new_frame_len);
+    if (framep == NULL) {
+      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      return NULL;
+    }
+    /* Copy the chunk */
+    memset(framep + header_len + cbytes - gap, 0, (size_t)gap);
+    memcpy(framep + header_len + cbytes, chunk, (size_t)chunk_cbytes);
+    memset(framep + header_len + cbytes + chunk_cbytes, 0, (size_t)padding);
+    /* Copy the offsets */
+    memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
+  } else {
+    int64_t wbytes;
+
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      return NULL;
+    }
+
+    if (frame->sframe) {
+      // Create the chunks file, if it's a special value this will delete its old content
+      if (sframe_chunk_id >= 0) {
+        if (sframe_create_chunk(frame, chunk, sframe_chunk_id, chunk_cbytes) == NULL) {
+          BLOSC_TRACE_ERROR("Cannot write the full chunk.");
+          return NULL;
+        }
+      }
+      // Update the offsets chunk in the chunks frame
+      fp = sframe_open_index(frame->urlpath, "rb+",
+                             frame->schunk->storage->io);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + 0, SEEK_SET);
+    }
+    else {
+      // Regular frame
+      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
+      if (fp == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
+      wbytes = io_cb->write(chunk, 1, chunk_cbytes, fp);  // the new chunk
+      if (wbytes != chunk_cbytes) {
+        BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
+        io_cb->close(fp);
+        return NULL;
+      }
+      io_cb->seek(fp, frame->file_offset + header_len + new_cbytes, SEEK_SET);
+    }
+    wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
+    io_cb->close(fp);
+    if (wbytes != new_off_cbytes) {
+      BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
+      return NULL;
+    }
+    // Invalidate the caches for the header and chunk offsets
+    frame_invalidate_caches(frame);
+  }
+  free(chunk);  // chunk has always to be a copy when reaching here...
+  ctx_free(schunk->cctx, off_chunk);
+
+  frame->len = new_frame_len;
+  rc = frame_update_header(frame, schunk, false);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  rc = frame_update_trailer(frame, schunk);
+  if (rc < 0) {
+    return NULL;
+  }
+
+  return frame;
+}
+
+
+void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* schunk) {
+  if (frame->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(frame);
+    if (rc_ < 0) {
+      return NULL;
+    }
+  }
+  if (frame_load_vlmetalayers(frame, schunk, -1) < 0) {
+    return NULL;
+  }
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize,  &nchunks,
+                           NULL, NULL, NULL, NULL, NULL, NULL, NULL, frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
+    return NULL;
+  }
+
+  // Get the current offsets
+  int64_t off_nbytes = (int64_t)nchunks * (int64_t)sizeof(int64_t);
+  int64_t* offsets = (int64_t *) ctx_malloc(schunk->cctx, (size_t)off_nbytes);
+  if (nchunks > 0) {
+    int32_t coffsets_cbytes = 0;
+    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
+    if (coffsets == NULL) {
+      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
+      return NULL;
+    }
+    if (coffsets_cbytes == 0) {
+      coffsets_cbytes = (int32_t)cbytes;
+    }
 
-  // Build the offsets with a special chunk
-  int new_off_cbytes = BLOSC_EXTENDED_HEADER_LENGTH + sizeof(int64_t);
-  uint8_t* off_chunk = malloc(new_off_cbytes);
-  uint64_t offset_value = ((uint64_t)1 << 63);
-  uint8_t* sample_chunk = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
-  int csize;
-  switch (special_value) {
-    case BLOSC2_SPECIAL_ZERO:
-      offset_value += (uint64_t) BLOSC2_SPECIAL_ZERO << (8 * 7);
-      csize = blosc2_chunk_zeros(*cparams, chunksize, sample_chunk, BLOSC_EXTENDED_HEADER_LENGTH);
-      break;
-    case BLOSC2_SPECIAL_UNINIT:
-      offset_value += (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);
-      csize = blosc2_chunk_uninit(*cparams, chunksize, sample_chunk, BLOSC_EXTENDED_HEADER_LENGTH);
-      break;
-    case BLOSC2_SPECIAL_NAN:
-      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);
-      csize = blosc2_chunk_nans(*cparams, chunksize, sample_chunk, BLOSC_EXTENDED_HEADER_LENGTH);
-      break;
-    default:
-      BLOSC_TRACE_ERROR("Only zeros, NaNs or non-initialized values are supported.");
-      return BLOSC2_ERROR_FRAME_SPECIAL;
+    // Decompress offsets
+    int64_t prev_nbytes = decompress_offsets(schunk->cctx, frame->index_format,
+                                             coffsets, coffsets_cbytes, offsets, nchunks);
+    if (prev_nbytes < 0) {
+      ctx_free(schunk->cctx, offsets);
+      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
+      return NULL;
+    }
   }
-  if (csize < 0) {
-    BLOSC_TRACE_ERROR("Error creating sample chunk");
-    return BLOSC2_ERROR_FRAME_SPECIAL;
+
+  // Delete the new offset
+  for (int64_t i = nchunk; i < nchunks - 1; i++) {
+    offsets[i] = offsets[i + 1];
   }
-  cparams->typesize = sizeof(int64_t);  // change it to offsets typesize
-  // cparams->blocksize = 0;   // automatic blocksize
-  cparams->blocksize = 8 * 2 * 1024;  // based on experiments with create_frame.c bench
-  cparams->clevel = 5;
-  cparams->compcode = BLOSC_BLOSCLZ;
-  int32_t special_nbytes = (int32_t) (nchunks * sizeof(int64_t));
-  rc = blosc2_chunk_repeatval(*cparams, special_nbytes, off_chunk, new_off_cbytes, &offset_value);
-  free(cparams);
-  if (rc < 0) {
-    BLOSC_TRACE_ERROR("Error creating a special offsets chunk");
-    return BLOSC2_ERROR_DATA;
+  offsets[nchunks - 1] = 0;
+
+  // Re-compress the offsets again
+  int32_t new_off_cbytes;
+  uint8_t* off_chunk = compress_offsets(schunk->cctx, frame->index_format, offsets, nchunks - 1, &new_off_cbytes);
+  ctx_free(schunk->cctx, offsets);
+  if (off_chunk == NULL) {
+    return NULL;
   }
 
-  // Get the blocksize associated to the sample chunk
-  blosc2_cbuffer_sizes(sample_chunk, NULL, NULL, &blocksize);
-  free(sample_chunk);
-  // and use it for the super-chunk
-  schunk->blocksize = blocksize;
-  // schunk->blocksize = 0;  // for experimenting with automatic blocksize
+  int64_t new_cbytes = cbytes;
 
-  // We have the new offsets; update the frame.
-  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
-  if (io_cb == NULL) {
-    BLOSC_TRACE_ERROR("Error getting the input/output API");
-    return BLOSC2_ERROR_PLUGIN_IO;
+  int64_t new_frame_len;
+  if (frame->sframe) {
+    new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
+  }
+  else {
+    new_frame_len = header_len + new_cbytes + new_off_cbytes + frame->trailer_len;
   }
 
-  int64_t new_frame_len = header_len + new_off_cbytes + frame->trailer_len;
-  void* fp = NULL;
+  // Add the chunk and update meta
+  FILE* fp = NULL;
   if (frame->cframe != NULL) {
-    uint8_t* framep = frame->cframe;
     /* Make space for the new chunk and copy it */
-    frame->cframe = framep = realloc(framep, (size_t)new_frame_len);
+    uint8_t* framep = frame_reserve(frame, new_frame_len);
     if (framep == NULL) {
       BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
-      return BLOSC2_ERROR_FRAME_SPECIAL;
+      return NULL;
     }
     /* Copy the offsets */
-    memcpy(framep + header_len, off_chunk, (size_t)new_off_cbytes);
-  }
-  else {
+    memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
+  } else {
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+    if (io_cb == NULL) {
+      BLOSC_TRACE_ERROR("Error getting the input/output API");
+      return NULL;
+    }
+
     size_t wbytes;
     if (frame->sframe) {
+      int64_t offset;
+      rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
+      if (rc < 0) {
+        BLOSC_TRACE_ERROR("Unable to get offset to chunk %" PRId64 ".", nchunk);
+        return NULL;
+      }
+      if (offset >= 0){
+        // Remove the chunk file only if it is not a special value chunk
+        int err = sframe_delete_chunk(frame, offset);
+        if (err != 0) {
+          BLOSC_TRACE_ERROR("Unable to delete chunk!");
+          return NULL;
+        }
+      }
       // Update the offsets chunk in the chunks frame
       fp = sframe_open_index(frame->urlpath, "rb+", frame->schunk->storage->io);
       if (fp == NULL) {
         BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return BLOSC2_ERROR_FILE_OPEN;
+        return NULL;
       }
-      io_cb->seek(fp, frame->file_offset + header_len, SEEK_SET);
+      io_cb->seek(fp, frame->file_offset + header_len + 0, SEEK_SET);
     }
     else {
       // Regular frame
-      fp = io_cb->open(frame->urlpath, "rb+", schunk->storage->io->params);
+      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
       if (fp == NULL) {
         BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return BLOSC2_ERROR_FILE_OPEN;
+        return NULL;
       }
       io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
     }
@@ -2543,35 +6579,41 @@ int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_va
     io_cb->close(fp);
     if (wbytes != (size_t)new_off_cbytes) {
       BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
-      return BLOSC2_ERROR_FRAME_SPECIAL;
+      return NULL;
     }
+    // Invalidate the caches for the header and chunk offsets
+    frame_invalidate_caches(frame);
   }
-
-  // Invalidate the cache for chunk offsets
-  if (frame->coffsets != NULL) {
-    free(frame->coffsets);
-    frame->coffsets = NULL;
-  }
-  free(off_chunk);
+  ctx_free(schunk->cctx, off_chunk);
 
   frame->len = new_frame_len;
   rc = frame_update_header(frame, schunk, false);
   if (rc < 0) {
-    return BLOSC2_ERROR_FRAME_SPECIAL;
+    return NULL;
   }
 
   rc = frame_update_trailer(frame, schunk);
   if (rc < 0) {
-    return BLOSC2_ERROR_FRAME_SPECIAL;
+    return NULL;
   }
 
-  return frame->len;
+  return frame;
 }
 
 
-/* Append an existing chunk into a frame. */
-void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schunk) {
-  int8_t* chunk_ = chunk;
+int frame_reorder_offsets(blosc2_frame_s* frame, const int64_t* offsets_order, blosc2_schunk* schunk) {
+  if (frame->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(frame);
+    if (rc_ < 0) {
+      return rc_;
+    }
+  }
+  int rc_meta = frame_load_vlmetalayers(frame, schunk, -1);
+  if (rc_meta < 0) {
+    return rc_meta;
+  }
+  // Get header info
   int32_t header_len;
   int64_t frame_len;
   int64_t nbytes;
@@ -2579,245 +6621,184 @@ void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schu
   int32_t blocksize;
   int32_t chunksize;
   int64_t nchunks;
-  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes, &blocksize, &chunksize,
-                           &nchunks, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-                           frame->schunk->storage->io);
-  if (rc < 0) {
-    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
-    return NULL;
-  }
-
-  /* The uncompressed and compressed sizes start at byte 4 and 12 */
-  int32_t chunk_nbytes;
-  int32_t chunk_cbytes;
-  rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
-  if (rc < 0) {
-    return NULL;
-  }
-
-  if ((nchunks > 0) && (chunk_nbytes > chunksize)) {
-    BLOSC_TRACE_ERROR("Appending chunks with a larger chunksize than frame is "
-                      "not allowed yet %d != %d.", chunk_nbytes, chunksize);
-    return NULL;
-  }
-
-  // Check that we are not appending a small chunk after another small chunk
-  int32_t chunk_nbytes_last;
-  if (chunksize == 0 && (nchunks > 0) && (chunk_nbytes < chunksize)) {
-    uint8_t* last_chunk;
-    bool needs_free;
-    rc = frame_get_lazychunk(frame, nchunks - 1, &last_chunk, &needs_free);
-    if (rc < 0) {
-      BLOSC_TRACE_ERROR("Cannot get the last chunk (in position %" PRId64 ").", nchunks - 1);
-    } else {
-      rc = blosc2_cbuffer_sizes(last_chunk, &chunk_nbytes_last, NULL, NULL);
-    }
-    if (needs_free) {
-      free(last_chunk);
-    }
-    if (rc < 0) {
-      return NULL;
-    }
-    if ((chunk_nbytes_last < chunksize) && (nbytes < chunksize)) {
-      BLOSC_TRACE_ERROR("Appending two consecutive chunks with a chunksize smaller "
-                        "than the frame chunksize is not allowed yet: %d != %d.",
-                        chunk_nbytes, chunksize);
-      return NULL;
-    }
+  int ret = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                            &blocksize, &chunksize, &nchunks,
+                            NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                            frame->schunk->storage->io);
+  if (ret < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+      return ret;
   }
 
   // Get the current offsets and add one more
-  int32_t off_nbytes = (int32_t) ((nchunks + 1) * sizeof(int64_t));
-  int64_t* offsets = (int64_t *) malloc((size_t)off_nbytes);
-  if (nchunks > 0) {
-    int32_t coffsets_cbytes;
-    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
-    if (coffsets == NULL) {
-      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
-      free(offsets);
-      return NULL;
-    }
-    if (coffsets_cbytes == 0) {
-      coffsets_cbytes = (int32_t)cbytes;
-    }
+  int64_t off_nbytes = (int64_t)nchunks * (int64_t)sizeof(int64_t);
+  int64_t* offsets = (int64_t *) ctx_malloc(schunk->cctx, (size_t)off_nbytes);
 
-    // Decompress offsets
-    blosc2_dparams off_dparams = BLOSC2_DPARAMS_DEFAULTS;
-    blosc2_context *dctx = blosc2_create_dctx(off_dparams);
-    if (dctx == NULL) {
-      BLOSC_TRACE_ERROR("Error while creating the decompression context");
-      return NULL;
-    }
-    int32_t prev_nbytes = blosc2_decompress_ctx(dctx, coffsets, coffsets_cbytes, offsets,
-                                                off_nbytes);
-    blosc2_free_ctx(dctx);
-    if (prev_nbytes < 0) {
-      free(offsets);
-      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
-      return NULL;
-    }
+  int32_t coffsets_cbytes = 0;
+  uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
+  if (coffsets == NULL) {
+    BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
+    ctx_free(schunk->cctx, offsets);
+    return BLOSC2_ERROR_DATA;
   }
 
-  // Add the new offset
-  int64_t sframe_chunk_id = -1;
-  int special_value = (chunk_[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
-  uint64_t offset_value = ((uint64_t)1 << 63);
-  switch (special_value) {
-    case BLOSC2_SPECIAL_ZERO:
-      // Zero chunk.  Code it in a special way.
-      offset_value += (uint64_t) BLOSC2_SPECIAL_ZERO << (8 * 7);  // chunk of zeros
-      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    case BLOSC2_SPECIAL_UNINIT:
-      // Non initizalized values chunk.  Code it in a special way.
-      offset_value += (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);  // chunk of uninit values
-      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    case BLOSC2_SPECIAL_NAN:
-      // NaN chunk.  Code it in a special way.
-      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);  // chunk of NANs
-      to_little(offsets + nchunks, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    default:
-      if (frame->sframe) {
-        // Compute the sframe_chunk_id value
-        for (int i = 0; i < nchunks; ++i) {
-          if (offsets[i] > sframe_chunk_id) {
-            sframe_chunk_id = offsets[i];
-          }
-        }
-        offsets[nchunks] = ++sframe_chunk_id;
-      }
-      else {
-        offsets[nchunks] = cbytes;
-      }
+  // Decompress offsets
+  int64_t prev_nbytes = decompress_offsets(schunk->cctx, frame->index_format,
+                                           coffsets, coffsets_cbytes, offsets, nchunks);
+  if (prev_nbytes < 0) {
+    ctx_free(schunk->cctx, offsets);
+    BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
+    return prev_nbytes;
   }
 
-  // Re-compress the offsets again
-  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
-  cparams.splitmode = BLOSC_NEVER_SPLIT;
-  cparams.typesize = sizeof(int64_t);
-  cparams.blocksize = 16 * 1024;  // based on experiments with create_frame.c bench
-  cparams.nthreads = 4;  // 4 threads seems a decent default for nowadays CPUs
-  cparams.compcode = BLOSC_BLOSCLZ;
-  blosc2_context* cctx = blosc2_create_cctx(cparams);
-  if (cctx == NULL) {
-    BLOSC_TRACE_ERROR("Error while creating the compression context");
-    return NULL;
-  }
-  cctx->typesize = sizeof(int64_t);  // override a possible BLOSC_TYPESIZE env variable (or chaos may appear)
-  void* off_chunk = malloc((size_t)off_nbytes + BLOSC2_MAX_OVERHEAD);
-  int32_t new_off_cbytes = blosc2_compress_ctx(cctx, offsets, off_nbytes,
-                                               off_chunk, off_nbytes + BLOSC2_MAX_OVERHEAD);
-  blosc2_free_ctx(cctx);
-  free(offsets);
-  if (new_off_cbytes < 0) {
-    free(off_chunk);
-    return NULL;
+  // Make a copy of the chunk offsets and reorder it
+  int64_t *offsets_copy = ctx_malloc(schunk->cctx, prev_nbytes);
+  memcpy(offsets_copy, offsets, prev_nbytes);
+
+  for (int i = 0; i < nchunks; ++i) {
+    offsets[i] = offsets_copy[offsets_order[i]];
   }
-  // printf("%f\n", (double) off_nbytes / new_off_cbytes);
+  ctx_free(schunk->cctx, offsets_copy);
 
-  int64_t new_cbytes = cbytes + chunk_cbytes;
+  // Re-compress the offsets again
+  int32_t new_off_cbytes;
+  uint8_t* off_chunk = compress_offsets(schunk->cctx, frame->index_format, offsets, nchunks, &new_off_cbytes);
+  if (off_chunk == NULL) {
+    ctx_free(schunk->cctx, offsets);
+    return BLOSC2_ERROR_DATA;
+  }
+  ctx_free(schunk->cctx, offsets);
   int64_t new_frame_len;
   if (frame->sframe) {
+    // The chunks are not in the frame
     new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
   }
   else {
-    new_frame_len = header_len + new_cbytes + new_off_cbytes + frame->trailer_len;
+    new_frame_len = header_len + cbytes + new_off_cbytes + frame->trailer_len;
   }
 
-  void* fp = NULL;
   if (frame->cframe != NULL) {
-    uint8_t* framep = frame->cframe;
     /* Make space for the new chunk and copy it */
-    frame->cframe = framep = realloc(framep, (size_t)new_frame_len);
+    uint8_t* framep = frame_reserve(frame, new_frame_len);
     if (framep == NULL) {
       BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
-      return NULL;
+      return BLOSC2_ERROR_MEMORY_ALLOC;
     }
-    /* Copy the chunk */
-    memcpy(framep + header_len + cbytes, chunk, (size_t)chunk_cbytes);
     /* Copy the offsets */
-    memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
+    memcpy(framep + header_len + cbytes, off_chunk, (size_t)new_off_cbytes);
   }
   else {
-    int64_t wbytes;
+    void* fp = NULL;
+
     blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
     if (io_cb == NULL) {
       BLOSC_TRACE_ERROR("Error getting the input/output API");
-      return NULL;
+      return BLOSC2_ERROR_PLUGIN_IO;
     }
 
     if (frame->sframe) {
       // Update the offsets chunk in the chunks frame
-      if (chunk_cbytes != 0) {
-        if (sframe_chunk_id < 0) {
-          BLOSC_TRACE_ERROR("The chunk id (%" PRId64 ") is not correct", sframe_chunk_id);
-          return NULL;
-        }
-        if (sframe_create_chunk(frame, chunk, sframe_chunk_id, chunk_cbytes) == NULL) {
-          BLOSC_TRACE_ERROR("Cannot write the full chunk.");
-          return NULL;
-        }
-      }
       fp = sframe_open_index(frame->urlpath, "rb+",
                              frame->schunk->storage->io);
       if (fp == NULL) {
         BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return NULL;
+        return BLOSC2_ERROR_FILE_OPEN;
       }
-      io_cb->seek(fp, frame->file_offset + header_len, SEEK_SET);
+      io_cb->seek(fp, frame->file_offset + header_len + 0, SEEK_SET);
     }
     else {
       // Regular frame
       fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
       if (fp == NULL) {
         BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return NULL;
+        return BLOSC2_ERROR_FILE_OPEN;
       }
       io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
-      wbytes = io_cb->write(chunk, 1, chunk_cbytes, fp);  // the new chunk
-      if (wbytes != chunk_cbytes) {
-        BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
-        io_cb->close(fp);
-        return NULL;
-      }
     }
-    wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
+    int64_t wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
     io_cb->close(fp);
     if (wbytes != new_off_cbytes) {
       BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
-      return NULL;
+      return BLOSC2_ERROR_FILE_WRITE;
     }
   }
-  // Invalidate the cache for chunk offsets
-  if (frame->coffsets != NULL) {
-    free(frame->coffsets);
-    frame->coffsets = NULL;
-  }
-  free(chunk);  // chunk has always to be a copy when reaching here...
-  free(off_chunk);
+
+  // Invalidate the caches for the header and chunk offsets
+  frame_invalidate_caches(frame);
+  ctx_free(schunk->cctx, off_chunk);
 
   frame->len = new_frame_len;
-  rc = frame_update_header(frame, schunk, false);
+  int rc = frame_update_header(frame, schunk, false);
   if (rc < 0) {
-    return NULL;
+    return rc;
   }
 
   rc = frame_update_trailer(frame, schunk);
   if (rc < 0) {
-    return NULL;
+    return rc;
   }
 
-  return frame;
+  return 0;
 }
 
 
-void* frame_insert_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk) {
-  uint8_t* chunk_ = chunk;
+
+/* A chunk stored in a contiguous frame, for sorting them by offset */
+typedef struct {
+  int64_t offset;
+  int64_t nchunk;
+  int32_t cbytes;
+} stored_chunk;
+
+static int compare_stored_chunks(const void *a, const void *b) {
+  int64_t offset_a = ((const stored_chunk *) a)->offset;
+  int64_t offset_b = ((const stored_chunk *) b)->offset;
+  return (offset_a > offset_b) - (offset_a < offset_b);
+}
+
+
+/* Move (or copy, if `fp_dest` is not `fp`) the chunks of a contiguous frame on disk to
+ * their new offsets, which are never past the old ones */
+static int move_stored_chunks(blosc2_frame_s* frame, blosc2_io_cb *io_cb, void *fp, void *fp_dest,
+                              int64_t chunks_start, const stored_chunk *chunks, int64_t nstored,
+                              const int64_t *new_offsets) {
+  int32_t buffer_size = 0;
+  uint8_t *buffer = NULL;
+  for (int64_t i = 0; i < nstored; i++) {
+    int64_t new_offset = new_offsets[chunks[i].nchunk];
+    if (i > 0 && chunks[i].offset == chunks[i - 1].offset) {
+      continue;  // shared with the previous chunk
+    }
+    if (fp_dest == fp && new_offset == chunks[i].offset) {
+      continue;  // already in place
+    }
+    if (chunks[i].cbytes > buffer_size) {
+      free(buffer);
+      buffer_size = chunks[i].cbytes;
+      buffer = malloc(buffer_size);
+      BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+    int64_t rbytes = io_pread(io_cb, buffer, 1, chunks[i].cbytes, frame->file_offset + chunks_start + chunks[i].offset, fp);
+    if (rbytes != chunks[i].cbytes) {
+      BLOSC_TRACE_ERROR("Cannot read the chunk %" PRId64 " of the frame.", chunks[i].nchunk);
+      free(buffer);
+      return BLOSC2_ERROR_FILE_READ;
+    }
+    int64_t dest_offset = fp_dest == fp ? frame->file_offset + chunks_start : chunks_start;
+    int64_t wbytes = io_pwrite(io_cb, buffer, 1, chunks[i].cbytes, dest_offset + new_offset, fp_dest);
+    if (wbytes != chunks[i].cbytes) {
+      BLOSC_TRACE_ERROR("Cannot write the chunk %" PRId64 " of the frame.", chunks[i].nchunk);
+      free(buffer);
+      return BLOSC2_ERROR_FILE_WRITE;
+    }
+  }
+  free(buffer);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Reclaim the space of the chunks updated or deleted in the shards of a sparse frame */
+static int64_t compact_shards(blosc2_frame_s* frame, bool in_place) {
   int32_t header_len;
   int64_t frame_len;
   int64_t nbytes;
@@ -2830,212 +6811,351 @@ void* frame_insert_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blo
                            NULL, NULL, NULL, NULL, NULL, NULL, NULL,
                            frame->schunk->storage->io);
   if (rc < 0) {
-    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
-    return NULL;
+    BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+    return rc;
   }
-  int32_t chunk_cbytes;
-  rc = blosc2_cbuffer_sizes(chunk_, NULL, &chunk_cbytes, NULL);
-  if (rc < 0) {
-    return NULL;
+  // The shards go up to the one of the last chunk stored (special chunks are negative)
+  int64_t max_chunk_id = -1;
+  for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+    int64_t offset;
+    rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
+    if (rc < 0) {
+      return rc;
+    }
+    max_chunk_id = offset > max_chunk_id ? offset : max_chunk_id;
   }
+  if (max_chunk_id < 0) {
+    return 0;
+  }
+  // The chunks read ahead (or looked up) before point to where they were in their shards
+  frame_prefetch_clear(frame);
+  frame_item_cache_clear(frame);
+  return sframe_compact(frame, max_chunk_id, in_place);
+}
 
-  // Get the current offsets
-  int32_t off_nbytes = (int32_t) ((nchunks + 1) * sizeof(int64_t));
-  int64_t* offsets = (int64_t *) malloc((size_t)off_nbytes);
-  if (nchunks > 0) {
-    int32_t coffsets_cbytes = 0;
-    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
-    if (coffsets == NULL) {
-      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
-      return NULL;
-    }
-    if (coffsets_cbytes == 0) {
-      coffsets_cbytes = (int32_t)cbytes;
-    }
 
-    // Decompress offsets
-    blosc2_dparams off_dparams = BLOSC2_DPARAMS_DEFAULTS;
-    blosc2_context *dctx = blosc2_create_dctx(off_dparams);
-    if (dctx == NULL) {
-      BLOSC_TRACE_ERROR("Error while creating the decompression context");
-      return NULL;
-    }
-    int32_t prev_nbytes = blosc2_decompress_ctx(dctx, coffsets, coffsets_cbytes, offsets, off_nbytes);
-    blosc2_free_ctx(dctx);
-    if (prev_nbytes < 0) {
-      free(offsets);
-      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
-      return NULL;
+int64_t frame_compact(blosc2_frame_s* frame, bool in_place) {
+  blosc2_schunk* schunk = frame->schunk;
+  if (frame->sframe && frame->shard_nchunks == 0) {
+    // The files of the chunks of sparse frames go away along with them
+    return 0;
+  }
+  if (frame->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(frame);
+    if (rc_ < 0) {
+      return rc_;
     }
   }
-
-  // TODO: Improvement: Check if new chunk is smaller than previous one
-
-  // Move offsets
-  for (int64_t i = nchunks; i > nchunk; i--) {
-    offsets[i] = offsets[i - 1];
+  if (frame->sframe) {
+    return compact_shards(frame, in_place);
   }
-  // Add the new offset
-  int64_t sframe_chunk_id = -1;
-  int special_value = (chunk_[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
-  uint64_t offset_value = ((uint64_t)1 << 63);
-  switch (special_value) {
-    case BLOSC2_SPECIAL_ZERO:
-      // Zero chunk.  Code it in a special way.
-      offset_value += (uint64_t)BLOSC2_SPECIAL_ZERO << (8 * 7);  // indicate a chunk of zeros
-      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    case BLOSC2_SPECIAL_UNINIT:
-      // Non initizalized values chunk.  Code it in a special way.
-      offset_value += (uint64_t) BLOSC2_SPECIAL_UNINIT << (8 * 7);  // chunk of uninit values
-      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    case BLOSC2_SPECIAL_NAN:
-      // NaN chunk.  Code it in a special way.
-      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);  // indicate a chunk of NANs
-      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
-    default:
-      if (frame->sframe) {
-        for (int i = 0; i <= nchunks; ++i) {
-          // offsets[nchunk] is still uninitialized here
-          if (i != nchunk && offsets[i] > sframe_chunk_id) {
-            sframe_chunk_id = offsets[i];
-          }
-        }
-        offsets[nchunk] = ++sframe_chunk_id;
-      }
-      else {
-        offsets[nchunk] = cbytes;
-      }
+  int rc_meta = frame_load_vlmetalayers(frame, schunk, -1);
+  if (rc_meta < 0) {
+    return rc_meta;
   }
-
-  // Re-compress the offsets again
-  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
-  cparams.splitmode = BLOSC_NEVER_SPLIT;
-  cparams.typesize = sizeof(int64_t);
-  cparams.blocksize = 16 * 1024;  // based on experiments with create_frame.c bench
-  cparams.nthreads = 4;  // 4 threads seems a decent default for nowadays CPUs
-  cparams.compcode = BLOSC_BLOSCLZ;
-  blosc2_context* cctx = blosc2_create_cctx(cparams);
-  if (cctx == NULL) {
-    BLOSC_TRACE_ERROR("Error while creating the compression context");
-    return NULL;
+  if (!in_place && (frame->cframe != NULL || frame->file_offset != 0)) {
+    BLOSC_TRACE_ERROR("Only frames in a file of their own can be compacted into a new file.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
-  void* off_chunk = malloc((size_t)off_nbytes + BLOSC2_MAX_OVERHEAD);
-  int32_t new_off_cbytes = blosc2_compress_ctx(cctx, offsets, off_nbytes,
-                                               off_chunk, off_nbytes + BLOSC2_MAX_OVERHEAD);
-  blosc2_free_ctx(cctx);
 
-  free(offsets);
-  if (new_off_cbytes < 0) {
-    free(off_chunk);
-    return NULL;
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t nchunks;
+  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &nchunks,
+                           NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                           frame->schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+    return rc;
+  }
+  if (nchunks == 0) {
+    return 0;
   }
 
-  int64_t new_cbytes = cbytes + chunk_cbytes;
-
-  int64_t new_frame_len;
-  if (frame->sframe) {
-    new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
+  // The chunks that are stored (special ones are not), sorted by their offset
+  int64_t* offsets = malloc((size_t)nchunks * sizeof(int64_t));
+  uint8_t* headers = malloc((size_t)nchunks * BLOSC_EXTENDED_HEADER_LENGTH);
+  stored_chunk* chunks = malloc((size_t)nchunks * sizeof(stored_chunk));
+  if (offsets == NULL || headers == NULL || chunks == NULL) {
+    free(offsets);
+    free(headers);
+    free(chunks);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  rc = frame_get_chunk_headers(frame, 0, nchunks, headers);
+  int64_t nstored = 0;
+  for (int64_t nchunk = 0; rc >= 0 && nchunk < nchunks; nchunk++) {
+    rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offsets[nchunk]);
+    if (rc >= 0 && offsets[nchunk] >= 0) {
+      chunks[nstored].offset = offsets[nchunk];
+      chunks[nstored].nchunk = nchunk;
+      rc = blosc2_cbuffer_sizes(headers + nchunk * BLOSC_EXTENDED_HEADER_LENGTH, NULL,
+                                &chunks[nstored].cbytes, NULL);
+      nstored++;
+    }
+  }
+  free(headers);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the chunks of the frame.");
+    free(offsets);
+    free(chunks);
+    return rc;
   }
-  else {
-    new_frame_len = header_len + new_cbytes + new_off_cbytes + frame->trailer_len;
+  rc = 0;  // the lookups above return positive sizes
+  qsort(chunks, (size_t)nstored, sizeof(stored_chunk), compare_stored_chunks);
+
+  // Pack them one after the other, in the same order (and at the boundaries of aligned
+  // frames, as long as the chunks do not go past where they are)
+  int64_t new_cbytes = 0;
+  for (int64_t i = 0; i < nstored; i++) {
+    if (i > 0 && chunks[i].offset == chunks[i - 1].offset) {
+      offsets[chunks[i].nchunk] = offsets[chunks[i - 1].nchunk];
+      continue;
+    }
+    int32_t gap = get_chunk_gap(frame, header_len + new_cbytes, chunks[i].cbytes > 0);
+    new_cbytes += new_cbytes + gap <= chunks[i].offset ? gap : 0;
+    offsets[chunks[i].nchunk] = new_cbytes;
+    new_cbytes += chunks[i].cbytes;
+  }
+  // The index starts at the boundary too
+  new_cbytes += get_chunk_gap(frame, header_len + new_cbytes, nstored > 0);
+  if (new_cbytes == cbytes) {
+    // No holes
+    free(offsets);
+    free(chunks);
+    return 0;
   }
 
-  // Add the chunk and update meta
-  void* fp = NULL;
+  int32_t off_cbytes;
+  uint8_t* off_chunk = compress_offsets(schunk->cctx, frame->index_format, offsets, nchunks, &off_cbytes);
+  if (off_chunk == NULL) {
+    free(offsets);
+    free(chunks);
+    return BLOSC2_ERROR_DATA;
+  }
+  int64_t new_frame_len = header_len + new_cbytes + off_cbytes + frame->trailer_len;
+
+  char* urlpath = frame->urlpath;
+  char* compact_urlpath = NULL;
   if (frame->cframe != NULL) {
-    uint8_t* framep = frame->cframe;
-    /* Make space for the new chunk and copy it */
-    frame->cframe = framep = realloc(framep, (size_t)new_frame_len);
-    if (framep == NULL) {
-      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
-      return NULL;
+    for (int64_t i = 0; i < nstored; i++) {
+      if (i == 0 || chunks[i].offset != chunks[i - 1].offset) {
+        memmove(frame->cframe + header_len + offsets[chunks[i].nchunk],
+                frame->cframe + header_len + chunks[i].offset, (size_t)chunks[i].cbytes);
+      }
     }
-    /* Copy the chunk */
-    memcpy(framep + header_len + cbytes, chunk, (size_t)chunk_cbytes);
-    /* Copy the offsets */
-    memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
-  } else {
-    int64_t wbytes;
-
-    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+    memcpy(frame->cframe + header_len + new_cbytes, off_chunk, (size_t)off_cbytes);
+  }
+  else {
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(schunk->storage->io->id);
     if (io_cb == NULL) {
       BLOSC_TRACE_ERROR("Error getting the input/output API");
-      return NULL;
+      rc = BLOSC2_ERROR_PLUGIN_IO;
+      goto out;
     }
-
-    if (frame->sframe) {
-      if (chunk_cbytes != 0) {
-        if (sframe_chunk_id < 0) {
-          BLOSC_TRACE_ERROR("The chunk id (%" PRId64 ") is not correct", sframe_chunk_id);
-          return NULL;
-        }
-        if (sframe_create_chunk(frame, chunk, sframe_chunk_id, chunk_cbytes) == NULL) {
-          BLOSC_TRACE_ERROR("Cannot write the full chunk.");
-          return NULL;
-        }
+    void* fp = io_cb->open(urlpath, "rb+", schunk->storage->io->params);
+    if (fp == NULL) {
+      BLOSC_TRACE_ERROR("Error opening file in: %s", urlpath);
+      rc = BLOSC2_ERROR_FILE_OPEN;
+      goto out;
+    }
+    void* fp_dest = fp;
+    if (!in_place) {
+      // The frame is written down to a new file, which replaces the old one when complete
+      compact_urlpath = malloc(strlen(urlpath) + strlen(".compact") + 1);
+      sprintf(compact_urlpath, "%s.compact", urlpath);
+      fp_dest = io_cb->open(compact_urlpath, "wb+", schunk->storage->io->params);
+      if (fp_dest == NULL) {
+        BLOSC_TRACE_ERROR("Error opening file in: %s", compact_urlpath);
+        io_cb->close(fp);
+        rc = BLOSC2_ERROR_FILE_OPEN;
+        goto out;
       }
-      // Update the offsets chunk in the chunks frame
-      fp = sframe_open_index(frame->urlpath, "rb+",
-                             frame->schunk->storage->io);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return NULL;
+      // The header is the same but for the fixed-size part, which is updated below
+      uint8_t* header = malloc(header_len);
+      rc = io_pread(io_cb, header, 1, header_len, 0, fp) == header_len ? 0 : BLOSC2_ERROR_FILE_READ;
+      if (rc == 0 && io_pwrite(io_cb, header, 1, header_len, 0, fp_dest) != header_len) {
+        rc = BLOSC2_ERROR_FILE_WRITE;
       }
-      io_cb->seek(fp, frame->file_offset + header_len + 0, SEEK_SET);
+      free(header);
     }
-    else {
-      // Regular frame
-      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return NULL;
-      }
-      io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
-      wbytes = io_cb->write(chunk, 1, chunk_cbytes, fp);  // the new chunk
-      if (wbytes != chunk_cbytes) {
-        BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
-        io_cb->close(fp);
-        return NULL;
+    if (rc == 0) {
+      rc = move_stored_chunks(frame, io_cb, fp, fp_dest, header_len, chunks, nstored, offsets);
+    }
+    if (rc == 0) {
+      int64_t position = (in_place ? frame->file_offset : 0) + header_len + new_cbytes;
+      if (io_pwrite(io_cb, off_chunk, 1, off_cbytes, position, fp_dest) != off_cbytes) {
+        BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
+        rc = BLOSC2_ERROR_FILE_WRITE;
       }
     }
-    wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
-    io_cb->close(fp);
-    if (wbytes != new_off_cbytes) {
-      BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
-      return NULL;
+    if (fp_dest != fp) {
+      io_cb->close(fp_dest);
     }
-    // Invalidate the cache for chunk offsets
-    if (frame->coffsets != NULL) {
-      free(frame->coffsets);
-      frame->coffsets = NULL;
+    io_cb->close(fp);
+    if (rc < 0) {
+      if (compact_urlpath != NULL) {
+        remove(compact_urlpath);
+      }
+      goto out;
     }
+    // The header and the trailer go to the new file too
+    frame->urlpath = in_place ? urlpath : compact_urlpath;
   }
-  free(chunk);  // chunk has always to be a copy when reaching here...
-  free(off_chunk);
 
+  // Invalidate the caches for the header and chunk offsets
+  frame_invalidate_caches(frame);
+  schunk->cbytes = new_cbytes;
   frame->len = new_frame_len;
   rc = frame_update_header(frame, schunk, false);
-  if (rc < 0) {
-    return NULL;
+  if (rc >= 0) {
+    // This also truncates the frame
+    rc = frame_update_trailer(frame, schunk);
+  }
+  frame->urlpath = urlpath;
+  if (compact_urlpath != NULL) {
+    if (rc >= 0) {
+      rc = blosc2_rename_urlpath(compact_urlpath, urlpath);
+    }
+    else {
+      remove(compact_urlpath);
+    }
   }
+  frame_invalidate_caches(frame);
 
-  rc = frame_update_trailer(frame, schunk);
+  out:
+  free(compact_urlpath);
+  ctx_free(schunk->cctx, off_chunk);
+  free(offsets);
+  free(chunks);
   if (rc < 0) {
-    return NULL;
+    return rc;
   }
+  return frame_len - frame->len;
+}
 
-  return frame;
+
+/* Copy `nbytes` of a frame on disk into another one, in blocks (or by the kernel when both
+ * are plain files) */
+static int copy_stored_range(blosc2_io_cb *src_cb, void *src_fp, int64_t src_position,
+                             blosc2_io_cb *dest_cb, void *dest_fp, int64_t dest_position, int64_t nbytes) {
+#if !defined(_WIN32)
+  if (src_cb->id == BLOSC2_IO_FILESYSTEM && dest_cb->id == BLOSC2_IO_FILESYSTEM) {
+    if (blosc2_stdio_copy_range(src_fp, src_position, dest_fp, dest_position, nbytes) != nbytes) {
+      return BLOSC2_ERROR_FILE_WRITE;
+    }
+    return BLOSC2_ERROR_SUCCESS;
+  }
+#endif
+  int64_t buffer_size = nbytes < FRAME_COPY_BLOCKSIZE ? nbytes : FRAME_COPY_BLOCKSIZE;
+  uint8_t *buffer = malloc((size_t)buffer_size);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int64_t copied = 0; copied < nbytes; copied += buffer_size) {
+    int64_t size = nbytes - copied < buffer_size ? nbytes - copied : buffer_size;
+    if (io_pread(src_cb, buffer, 1, size, src_position + copied, src_fp) != size) {
+      rc = BLOSC2_ERROR_FILE_READ;
+      break;
+    }
+    if (io_pwrite(dest_cb, buffer, 1, size, dest_position + copied, dest_fp) != size) {
+      rc = BLOSC2_ERROR_FILE_WRITE;
+      break;
+    }
+  }
+  free(buffer);
+  return rc;
 }
 
 
-void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk) {
-  uint8_t *chunk_ = (uint8_t *) chunk;
+/* Copy `len` bytes from `src_position` in the frame `src` to `dest_position` in the frame
+ * `dest` (which has room for them already when in memory) */
+static int copy_frame_region(blosc2_frame_s* dest, int64_t dest_position,
+                             blosc2_frame_s* src, int64_t src_position, int64_t len) {
+  blosc2_schunk* schunk = dest->schunk;
+  blosc2_schunk* src_schunk = src->schunk;
+  if (src->cframe != NULL && dest->cframe != NULL) {
+    memcpy(dest->cframe + dest_position, src->cframe + src_position, (size_t)len);
+    return 0;
+  }
+
+  blosc2_io_cb *src_cb = blosc2_get_io_cb(src_schunk->storage->io->id);
+  blosc2_io_cb *dest_cb = blosc2_get_io_cb(schunk->storage->io->id);
+  if (src_cb == NULL || dest_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* src_fp = NULL;
+  void* dest_fp = NULL;
+  if (src->cframe == NULL) {
+    src_fp = src_cb->open(src->urlpath, "rb", src_schunk->storage->io->params);
+    if (src_fp == NULL) {
+      BLOSC_TRACE_ERROR("Error opening file in: %s", src->urlpath);
+      return BLOSC2_ERROR_FILE_OPEN;
+    }
+  }
+  if (dest->cframe == NULL) {
+    frame_forget_open_reads(dest);
+    dest_fp = dest_cb->open(dest->urlpath, "rb+", schunk->storage->io->params);
+    if (dest_fp == NULL) {
+      BLOSC_TRACE_ERROR("Error opening file in: %s", dest->urlpath);
+      if (src_fp != NULL) {
+        src_cb->close(src_fp);
+      }
+      return BLOSC2_ERROR_FILE_OPEN;
+    }
+  }
+  int rc = 0;
+  if (src_fp == NULL) {
+    if (io_pwrite(dest_cb, src->cframe + src_position, 1, len, dest->file_offset + dest_position,
+                  dest_fp) != len) {
+      rc = BLOSC2_ERROR_FILE_WRITE;
+    }
+  }
+  else if (dest_fp == NULL) {
+    if (io_pread(src_cb, dest->cframe + dest_position, 1, len, src->file_offset + src_position,
+                 src_fp) != len) {
+      rc = BLOSC2_ERROR_FILE_READ;
+    }
+  }
+  else {
+    rc = copy_stored_range(src_cb, src_fp, src->file_offset + src_position,
+                           dest_cb, dest_fp, dest->file_offset + dest_position, len);
+  }
+  if (src_fp != NULL) {
+    src_cb->close(src_fp);
+  }
+  if (dest_fp != NULL) {
+    dest_cb->close(dest_fp);
+  }
+  return rc;
+}
+
+
+int frame_copy_chunks(blosc2_frame_s* dest, blosc2_frame_s* src) {
+  blosc2_schunk* schunk = dest->schunk;
+  blosc2_schunk* src_schunk = src->schunk;
+  if (dest->sframe || src->sframe) {
+    BLOSC_TRACE_ERROR("The chunks can only be copied between contiguous frames.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (schunk->nchunks > 0) {
+    BLOSC_TRACE_ERROR("The chunks can only be copied into an empty frame.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (src->bulk_pending) {
+    // Write down the updates deferred by the appends first
+    int rc_ = frame_flush_bulk(src);
+    if (rc_ < 0) {
+      return rc_;
+    }
+  }
+
   int32_t header_len;
   int64_t frame_len;
   int64_t nbytes;
@@ -3043,253 +7163,305 @@ void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blo
   int32_t blocksize;
   int32_t chunksize;
   int64_t nchunks;
-  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
+  int rc = get_header_info(src, &header_len, &frame_len, &nbytes, &cbytes,
                            &blocksize, &chunksize, &nchunks,
                            NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-                           frame->schunk->storage->io);
+                           src_schunk->storage->io);
   if (rc < 0) {
-    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
-    return NULL;
-  }
-  if (nchunk >= nchunks) {
-    BLOSC_TRACE_ERROR("The chunk must already exist.");
-    return NULL;
+    BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+    return rc;
   }
-
-  int32_t chunk_cbytes;
-  rc = blosc2_cbuffer_sizes(chunk, NULL, &chunk_cbytes, NULL);
+  if (nchunks == 0) {
+    return 0;
+  }
+  int32_t dest_header_len;
+  int64_t dest_nbytes;
+  int64_t dest_cbytes;
+  int64_t dest_nchunks;
+  rc = get_header_info(dest, &dest_header_len, &frame_len, &dest_nbytes, &dest_cbytes,
+                       &blocksize, &chunksize, &dest_nchunks,
+                       NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                       schunk->storage->io);
   if (rc < 0) {
-    return NULL;
+    BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+    return rc;
   }
 
-  // Get the current offsets
-  int32_t off_nbytes = (int32_t) (nchunks * sizeof(int64_t));
-  int64_t* offsets = (int64_t *) malloc((size_t)off_nbytes);
-  if (nchunks > 0) {
-    int32_t coffsets_cbytes = 0;
-    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
-    if (coffsets == NULL) {
-      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
-      return NULL;
-    }
-    if (coffsets_cbytes == 0) {
-      coffsets_cbytes = (int32_t)cbytes;
-    }
-
-    // Decompress offsets
-    blosc2_dparams off_dparams = BLOSC2_DPARAMS_DEFAULTS;
-    blosc2_context *dctx = blosc2_create_dctx(off_dparams);
-    if (dctx == NULL) {
-      BLOSC_TRACE_ERROR("Error while creating the decompression context");
-      return NULL;
-    }
-    int32_t prev_nbytes = blosc2_decompress_ctx(dctx, coffsets, coffsets_cbytes, offsets, off_nbytes);
-    blosc2_free_ctx(dctx);
-    if (prev_nbytes < 0) {
-      free(offsets);
-      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
-      return NULL;
-    }
+  // The offsets are relative to the start of the chunks, so both go verbatim right after the header
+  int64_t region_len = get_trailer_offset(src, header_len, true) - header_len;
+  if (region_len < cbytes) {
+    BLOSC_TRACE_ERROR("Cannot get the chunk offsets of the frame.");
+    return BLOSC2_ERROR_DATA;
   }
-  int32_t cbytes_old;
-  int64_t old_offset;
-  if (!frame->sframe) {
-    // See how big would be the space
-    old_offset = offsets[nchunk];
-    bool needs_free;
-    uint8_t *chunk_old;
-    int err = blosc2_schunk_get_chunk(schunk, nchunk, &chunk_old, &needs_free);
-    if (err < 0) {
-      BLOSC_TRACE_ERROR("%" PRId64 " chunk can not be obtained from schunk.", nchunk);
-      return NULL;
-    }
-
-    if (chunk_old == NULL) {
-      cbytes_old = 0;
-    }
-    else {
-      cbytes_old = sw32_(chunk_old + BLOSC2_CHUNK_CBYTES);
-      if (cbytes_old == BLOSC2_MAX_OVERHEAD) {
-        cbytes_old = 0;
-      }
-    }
-    if (needs_free) {
-      free(chunk_old);
+  if (dest->cframe != NULL) {
+    if (frame_reserve(dest, dest_header_len + region_len) == NULL) {
+      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      return BLOSC2_ERROR_MEMORY_ALLOC;
     }
   }
+  rc = copy_frame_region(dest, dest_header_len, src, header_len, region_len);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot copy the chunks of the frame.");
+    return rc;
+  }
 
-  // Add the new offset
-  int64_t sframe_chunk_id;
-  if (frame->sframe) {
-    if (offsets[nchunk] < 0) {
-      sframe_chunk_id = -1;
-    }
-    else {
-      // In case there was a reorder in a sframe
-      sframe_chunk_id = offsets[nchunk];
-    }
+  // Invalidate the caches for the header and chunk offsets
+  frame_invalidate_caches(dest);
+  schunk->nchunks = nchunks;
+  schunk->nbytes = nbytes;
+  schunk->cbytes = cbytes;
+  schunk->chunksize = src_schunk->chunksize;
+  dest->len = dest_header_len + region_len + dest->trailer_len;
+  rc = frame_update_header(dest, schunk, false);
+  if (rc < 0) {
+    return rc;
   }
-  int special_value = (chunk_[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  rc = frame_update_trailer(dest, schunk);
+  if (rc < 0) {
+    return rc;
+  }
+  return 0;
+}
+
+/* The offset of a special chunk in the index of a frame, or 0 if it is not special */
+static int64_t special_chunk_offset(const uint8_t* chunk) {
+  int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
   uint64_t offset_value = ((uint64_t)1 << 63);
+  int64_t offset = 0;
   switch (special_value) {
     case BLOSC2_SPECIAL_ZERO:
-      // Zero chunk.  Code it in a special way.
-      offset_value += (uint64_t)BLOSC2_SPECIAL_ZERO << (8 * 7);  // indicate a chunk of zeros
-      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
     case BLOSC2_SPECIAL_UNINIT:
-      // Non initizalized values chunk.  Code it in a special way.
-      offset_value += (uint64_t)BLOSC2_SPECIAL_UNINIT << (8 * 7);  // indicate a chunk of uninit values
-      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
-      break;
     case BLOSC2_SPECIAL_NAN:
-      // NaN chunk.  Code it in a special way.
-      offset_value += (uint64_t)BLOSC2_SPECIAL_NAN << (8 * 7);  // indicate a chunk of NANs
-      to_little(offsets + nchunk, &offset_value, sizeof(uint64_t));
-      chunk_cbytes = 0;   // we don't need to store the chunk
+    case BLOSC2_SPECIAL_VIRTUAL:
+      offset_value += (uint64_t) special_value << (8 * 7);
+      to_little(&offset, &offset_value, sizeof(uint64_t));
       break;
     default:
-      if (frame->sframe) {
-        if (sframe_chunk_id < 0) {
-          for (int i = 0; i < nchunks; ++i) {
-            if (offsets[i] > sframe_chunk_id) {
-              sframe_chunk_id = offsets[i];
-            }
-          }
-          offsets[nchunk] = ++sframe_chunk_id;
-        }
-      }
-      else {
-        // Add the new offset
-        offsets[nchunk] = cbytes;
-      }
+      break;
   }
+  return offset;
+}
 
-  if (!frame->sframe && chunk_cbytes != 0 && cbytes_old >= chunk_cbytes) {
-    offsets[nchunk] = old_offset;
-    cbytes = old_offset;
+int frame_fill_chunks(blosc2_frame_s* dest, blosc2_schunk* src_schunk, int nthreads) {
+  blosc2_schunk* schunk = dest->schunk;
+  blosc2_frame_s* src = (blosc2_frame_s*)src_schunk->frame;
+  if (dest->sframe || dest->cframe == NULL || dest->chunk_align > 1 || (src != NULL && !src->sframe)) {
+    BLOSC_TRACE_ERROR("The chunks can only be filled into an unaligned in-memory contiguous frame, "
+                      "from memory or a sparse frame.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
-  // Re-compress the offsets again
-  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
-  cparams.splitmode = BLOSC_NEVER_SPLIT;
-  cparams.typesize = sizeof(int64_t);
-  cparams.blocksize = 16 * 1024;  // based on experiments with create_frame.c bench
-  cparams.nthreads = 4;  // 4 threads seems a decent default for nowadays CPUs
-  cparams.compcode = BLOSC_BLOSCLZ;
-  blosc2_context* cctx = blosc2_create_cctx(cparams);
-  if (cctx == NULL) {
-    BLOSC_TRACE_ERROR("Error while creating the compression context");
-    return NULL;
+  if (schunk->nchunks > 0) {
+    BLOSC_TRACE_ERROR("The chunks can only be filled into an empty frame.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
-  void* off_chunk = malloc((size_t)off_nbytes + BLOSC2_MAX_OVERHEAD);
-  int32_t new_off_cbytes = blosc2_compress_ctx(cctx, offsets, off_nbytes,
-                                               off_chunk, off_nbytes + BLOSC2_MAX_OVERHEAD);
-  blosc2_free_ctx(cctx);
-
-  free(offsets);
-  if (new_off_cbytes < 0) {
-    free(off_chunk);
-    return NULL;
+  int64_t nchunks = src_schunk->nchunks;
+  if (nchunks == 0) {
+    return 0;
   }
 
-  int64_t new_cbytes = schunk->cbytes;
-  int64_t new_frame_len;
-  if (frame->sframe) {
-    // The chunk is not stored in the frame
-    new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
-  }
-  else {
-    new_frame_len = header_len + new_cbytes + new_off_cbytes + frame->trailer_len;
+  int32_t header_len;
+  int64_t frame_len;
+  int64_t nbytes;
+  int64_t cbytes;
+  int32_t blocksize;
+  int32_t chunksize;
+  int64_t dest_nchunks;
+  int rc = get_header_info(dest, &header_len, &frame_len, &nbytes, &cbytes,
+                           &blocksize, &chunksize, &dest_nchunks,
+                           NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                           schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+    return rc;
   }
-
-  void* fp = NULL;
-  if (frame->cframe != NULL) {
-    uint8_t* framep = frame->cframe;
-    /* Make space for the new chunk and copy it */
-    frame->cframe = framep = realloc(framep, (size_t)new_frame_len);
-    if (framep == NULL) {
-      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
-      return NULL;
+  int32_t src_header_len = 0;
+  int64_t src_cbytes = 0;
+  if (src != NULL) {
+    int64_t src_nchunks;
+    rc = get_header_info(src, &src_header_len, &frame_len, &nbytes, &src_cbytes,
+                         &blocksize, &chunksize, &src_nchunks,
+                         NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                         src_schunk->storage->io);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+      return rc;
     }
-    /* Copy the chunk */
-    memcpy(framep + header_len + cbytes, chunk, (size_t)chunk_cbytes);
-    /* Copy the offsets */
-    memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
-  } else {
-    int64_t wbytes;
+  }
 
-    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
-    if (io_cb == NULL) {
-      BLOSC_TRACE_ERROR("Error getting the input/output API");
-      return NULL;
+  // The files of the chunks are read by several threads, unless they are shared by chunks
+  // (shards) or read through other I/O backends, which may not expect that
+  bool parallel_reads = src != NULL && src->shard_nchunks == 0 &&
+                        src_schunk->storage->io->id == BLOSC2_IO_FILESYSTEM;
+  int64_t window = src != NULL ? FRAME_FILL_WINDOW * (nthreads > 1 ? nthreads : 1) : nchunks;
+  window = window < nchunks ? window : nchunks;
+  int64_t* offsets = malloc((size_t)nchunks * sizeof(int64_t));
+  int64_t* window_offsets = malloc((size_t)window * sizeof(int64_t));
+  int64_t* ids = malloc((size_t)window * sizeof(int64_t));
+  int32_t* sizes = malloc((size_t)window * sizeof(int32_t));
+  uint8_t** chunks = malloc((size_t)window * sizeof(uint8_t*));
+  bool* needs_free = malloc((size_t)window * sizeof(bool));
+  int64_t coffset = 0;
+  if (offsets == NULL || window_offsets == NULL || ids == NULL || sizes == NULL || chunks == NULL ||
+      needs_free == NULL) {
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  for (int64_t first = 0; first < nchunks && rc >= 0; first += window) {
+    int64_t n = nchunks - first < window ? nchunks - first : window;
+    // The chunks in memory and the special ones are at hand, the rest are read below
+    for (int64_t i = 0; i < n; i++) {
+      chunks[i] = NULL;
+      needs_free[i] = false;
+      offsets[first + i] = 0;
+    }
+    for (int64_t i = 0; i < n && rc >= 0; i++) {
+      if (src == NULL) {
+        chunks[i] = src_schunk->data[first + i];
+        rc = chunks[i] != NULL ? blosc2_cbuffer_sizes(chunks[i], NULL, &sizes[i], NULL) : BLOSC2_ERROR_DATA;
+        offsets[first + i] = rc >= 0 ? special_chunk_offset(chunks[i]) : 0;
+        continue;
+      }
+      rc = get_coffset(src, src_header_len, src_cbytes, first + i, nchunks, &offsets[first + i]);
+      if (rc >= 0 && offsets[first + i] >= 0) {
+        ids[i] = offsets[first + i];
+        offsets[first + i] = 0;
+        if (!parallel_reads) {
+          rc = sizes[i] = sframe_get_chunk(src, ids[i], &chunks[i], &needs_free[i]);
+        }
+      }
     }
-
-    if (frame->sframe) {
-      // Create the chunks file, if it's a special value this will delete its old content
-      if (sframe_chunk_id >= 0) {
-        if (sframe_create_chunk(frame, chunk, sframe_chunk_id, chunk_cbytes) == NULL) {
-          BLOSC_TRACE_ERROR("Cannot write the full chunk.");
-          return NULL;
+    if (rc >= 0 && parallel_reads) {
+      frame_chunks fc = {.src=src, .chunks=chunks, .needs_free=needs_free, .ids=ids, .cbytes=sizes, .nchunks=n};
+      fc.njobs = (int)(n < nthreads ? n : nthreads);
+      fc.njobs = fc.njobs < FRAME_CHUNKS_MAXJOBS ? (fc.njobs > 1 ? fc.njobs : 1) : FRAME_CHUNKS_MAXJOBS;
+      // The special chunks are not read
+      for (int64_t i = 0; i < n; i++) {
+        if (offsets[first + i] < 0) {
+          chunks[i] = (uint8_t*)"";
+          sizes[i] = 0;
         }
       }
-      // Update the offsets chunk in the chunks frame
-      fp = sframe_open_index(frame->urlpath, "rb+",
-                             frame->schunk->storage->io);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return NULL;
+      rc = run_frame_chunks(&fc, read_frame_chunks);
+    }
+    if (rc < 0) {
+      for (int64_t i = 0; i < n; i++) {
+        if (needs_free[i]) {
+          free(chunks[i]);
+        }
       }
-      io_cb->seek(fp, frame->file_offset + header_len + 0, SEEK_SET);
+      break;
     }
-    else {
-      // Regular frame
-      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return NULL;
+
+    // The chunks go right after the ones of the previous windows (the special ones go just in the index)
+    int64_t window_cbytes = 0;
+    for (int64_t i = 0; i < n; i++) {
+      if (offsets[first + i] < 0) {
+        sizes[i] = 0;
       }
-      io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
-      wbytes = io_cb->write(chunk, 1, chunk_cbytes, fp);  // the new chunk
-      if (wbytes != chunk_cbytes) {
-        BLOSC_TRACE_ERROR("Cannot write the full chunk to frame.");
-        io_cb->close(fp);
-        return NULL;
+      window_offsets[i] = window_cbytes;
+      if (offsets[first + i] >= 0) {
+        offsets[first + i] = coffset + window_cbytes;
       }
-      io_cb->seek(fp, frame->file_offset + header_len + new_cbytes, SEEK_SET);
+      window_cbytes += sizes[i];
     }
-    wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
-    io_cb->close(fp);
-    if (wbytes != new_off_cbytes) {
-      BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
-      return NULL;
+    if (frame_reserve(dest, header_len + coffset + window_cbytes) == NULL) {
+      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    frame_chunks fc = {.dest=dest->cframe + header_len + coffset, .chunks=chunks, .needs_free=needs_free,
+                       .cbytes=sizes, .offsets=window_offsets, .nchunks=n};
+    if (rc >= 0) {
+      put_frame_chunks(&fc, nthreads);
     }
-    // Invalidate the cache for chunk offsets
-    if (frame->coffsets != NULL) {
-      free(frame->coffsets);
-      frame->coffsets = NULL;
+    else {
+      for (int64_t i = 0; i < n; i++) {
+        if (needs_free[i]) {
+          free(chunks[i]);
+        }
+      }
     }
+    coffset += window_cbytes;
   }
-  free(chunk);  // chunk has always to be a copy when reaching here...
-  free(off_chunk);
+  free(window_offsets);
+  free(ids);
+  free(sizes);
+  free(chunks);
+  free(needs_free);
 
-  frame->len = new_frame_len;
-  rc = frame_update_header(frame, schunk, false);
+  // And the index after all of them
+  int32_t off_cbytes = 0;
+  uint8_t* off_chunk = NULL;
+  if (rc >= 0) {
+    off_chunk = compress_offsets(schunk->cctx, dest->index_format, offsets, nchunks, &off_cbytes);
+    rc = off_chunk != NULL ? 0 : BLOSC2_ERROR_DATA;
+  }
+  free(offsets);
+  if (rc >= 0 && frame_reserve(dest, header_len + coffset + off_cbytes + dest->trailer_len) == NULL) {
+    BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+  }
   if (rc < 0) {
-    return NULL;
+    ctx_free(schunk->cctx, off_chunk);
+    return rc;
   }
+  memcpy(dest->cframe + header_len + coffset, off_chunk, off_cbytes);
+  ctx_free(schunk->cctx, off_chunk);
 
-  rc = frame_update_trailer(frame, schunk);
+  frame_invalidate_caches(dest);
+  schunk->nchunks = nchunks;
+  schunk->nbytes = src_schunk->nbytes;
+  schunk->cbytes = coffset;
+  schunk->chunksize = src_schunk->chunksize;
+  dest->len = header_len + coffset + off_cbytes + dest->trailer_len;
+  rc = frame_update_header(dest, schunk, false);
   if (rc < 0) {
-    return NULL;
+    return rc;
+  }
+  rc = frame_update_trailer(dest, schunk);
+  if (rc < 0) {
+    return rc;
   }
+  return 0;
+}
 
-  return frame;
+/* Get the offsets of the `nchunks` chunks of a frame into `offsets` */
+static int get_frame_offsets(blosc2_frame_s* frame, int32_t header_len, int64_t cbytes, int64_t nchunks,
+                             int64_t* offsets) {
+  if (nchunks == 0) {
+    return 0;
+  }
+  int32_t coffsets_cbytes;
+  uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
+  if (coffsets == NULL) {
+    BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  if (coffsets_cbytes == 0) {
+    coffsets_cbytes = (int32_t)cbytes;
+  }
+  if (decompress_offsets(frame->schunk->cctx, frame->index_format, coffsets, coffsets_cbytes, offsets, nchunks) < 0) {
+    BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
+    return BLOSC2_ERROR_DATA;
+  }
+  return 0;
 }
 
+int frame_concat_chunks(blosc2_frame_s* dest, blosc2_frame_s* src) {
+  blosc2_schunk* schunk = dest->schunk;
+  if (dest->sframe || src->sframe) {
+    BLOSC_TRACE_ERROR("The chunks can only be concatenated between contiguous frames.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int rc;
+  if (src->bulk_pending && (rc = frame_flush_bulk(src)) < 0) {
+    return rc;
+  }
+  if (dest->bulk_pending && (rc = frame_flush_bulk(dest)) < 0) {
+    return rc;
+  }
+  if ((rc = frame_load_vlmetalayers(dest, schunk, -1)) < 0) {
+    return rc;
+  }
 
-void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* schunk) {
   int32_t header_len;
   int64_t frame_len;
   int64_t nbytes;
@@ -3297,362 +7469,783 @@ void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* s
   int32_t blocksize;
   int32_t chunksize;
   int64_t nchunks;
-  int rc = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
-                           &blocksize, &chunksize,  &nchunks,
-                           NULL, NULL, NULL, NULL, NULL, NULL, NULL, frame->schunk->storage->io);
+  rc = get_header_info(src, &header_len, &frame_len, &nbytes, &cbytes,
+                       &blocksize, &chunksize, &nchunks,
+                       NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                       src->schunk->storage->io);
   if (rc < 0) {
-    BLOSC_TRACE_ERROR("Unable to get meta info from frame.");
-    return NULL;
+    BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+    return rc;
+  }
+  if (nchunks == 0) {
+    return 0;
+  }
+  int32_t dest_header_len;
+  int64_t dest_nbytes;
+  int64_t dest_cbytes;
+  int64_t dest_nchunks;
+  rc = get_header_info(dest, &dest_header_len, &frame_len, &dest_nbytes, &dest_cbytes,
+                       &blocksize, &chunksize, &dest_nchunks,
+                       NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+                       schunk->storage->io);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
+    return rc;
   }
 
-  // Get the current offsets
-  int32_t off_nbytes = (int32_t) (nchunks * sizeof(int64_t));
-  int64_t* offsets = (int64_t *) malloc((size_t)off_nbytes);
-  if (nchunks > 0) {
-    int32_t coffsets_cbytes = 0;
-    uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
-    if (coffsets == NULL) {
-      BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
-      return NULL;
+  // The offsets of the chunks of `src` follow the ones of `dest`, past its chunks
+  int64_t* offsets = malloc((dest_nchunks + nchunks) * sizeof(int64_t));
+  BLOSC_ERROR_NULL(offsets, BLOSC2_ERROR_MEMORY_ALLOC);
+  rc = get_frame_offsets(dest, dest_header_len, dest_cbytes, dest_nchunks, offsets);
+  if (rc >= 0) {
+    rc = get_frame_offsets(src, header_len, cbytes, nchunks, offsets + dest_nchunks);
+  }
+  if (rc < 0) {
+    free(offsets);
+    return rc;
+  }
+  // The chunks keep their place with respect to the boundaries of aligned frames
+  int64_t chunks_pos = dest_cbytes + get_chunk_gap(dest, dest_header_len + dest_cbytes - header_len, cbytes > 0);
+  for (int64_t i = dest_nchunks; i < dest_nchunks + nchunks; i++) {
+    // Special chunks are not stored
+    if (offsets[i] >= 0) {
+      offsets[i] += chunks_pos;
     }
-    if (coffsets_cbytes == 0) {
-      coffsets_cbytes = (int32_t)cbytes;
+  }
+  int32_t off_cbytes;
+  uint8_t* off_chunk = compress_offsets(schunk->cctx, dest->index_format, offsets, dest_nchunks + nchunks, &off_cbytes);
+  free(offsets);
+  if (off_chunk == NULL) {
+    return BLOSC2_ERROR_DATA;
+  }
+
+  // The chunks of `src` go as a whole, and then the new offsets
+  int64_t new_cbytes = chunks_pos + cbytes;
+  new_cbytes += get_chunk_gap(dest, dest_header_len + new_cbytes, cbytes > 0);
+  int64_t new_frame_len = dest_header_len + new_cbytes + off_cbytes + dest->trailer_len;
+  if (dest->cframe != NULL && frame_reserve(dest, new_frame_len) == NULL) {
+    BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
+    ctx_free(schunk->cctx, off_chunk);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  if (dest->cframe != NULL) {
+    memset(dest->cframe + dest_header_len + dest_cbytes, 0, (size_t)(chunks_pos - dest_cbytes));
+    memset(dest->cframe + dest_header_len + chunks_pos + cbytes, 0, (size_t)(new_cbytes - chunks_pos - cbytes));
+  }
+  rc = copy_frame_region(dest, dest_header_len + chunks_pos, src, header_len, cbytes);
+  if (rc >= 0 && dest->cframe != NULL) {
+    memcpy(dest->cframe + dest_header_len + new_cbytes, off_chunk, (size_t)off_cbytes);
+  }
+  else if (rc >= 0) {
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(schunk->storage->io->id);
+    void* fp = io_cb == NULL ? NULL : io_cb->open(dest->urlpath, "rb+", schunk->storage->io->params);
+    if (fp == NULL) {
+      BLOSC_TRACE_ERROR("Error opening file in: %s", dest->urlpath);
+      rc = BLOSC2_ERROR_FILE_OPEN;
+    }
+    else {
+      if (io_pwrite(io_cb, off_chunk, 1, off_cbytes, dest->file_offset + dest_header_len + new_cbytes, fp)
+          != off_cbytes) {
+        rc = BLOSC2_ERROR_FILE_WRITE;
+      }
+      io_cb->close(fp);
     }
+  }
+  ctx_free(schunk->cctx, off_chunk);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot concatenate the chunks of the frame.");
+    return rc;
+  }
 
-    // Decompress offsets
-    blosc2_dparams off_dparams = BLOSC2_DPARAMS_DEFAULTS;
-    blosc2_context *dctx = blosc2_create_dctx(off_dparams);
-    if (dctx == NULL) {
-      BLOSC_TRACE_ERROR("Error while creating the decompression context");
-      return NULL;
+  // Invalidate the caches for the header and chunk offsets
+  frame_invalidate_caches(dest);
+  schunk->nchunks = dest_nchunks + nchunks;
+  schunk->nbytes = dest_nbytes + nbytes;
+  schunk->cbytes = new_cbytes;
+  dest->len = new_frame_len;
+  rc = frame_update_header(dest, schunk, false);
+  if (rc < 0) {
+    return rc;
+  }
+  return frame_update_trailer(dest, schunk);
+}
+
+
+/* Decompress and return a chunk that is part of a frame. */
+int frame_decompress_chunk(blosc2_context *dctx, blosc2_frame_s* frame, int64_t nchunk, void *dest, int32_t nbytes) {
+  uint8_t* src;
+  bool needs_free;
+  int32_t chunk_nbytes;
+  int32_t chunk_cbytes;
+  int rc;
+
+  // Chunks in memory (and special ones) need neither copies nor allocations
+  blosc2_chunk_view view;
+  rc = frame_get_chunk_view(frame, nchunk, &view);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the chunk in position %" PRId64 ".", nchunk);
+    return rc;
+  }
+  if (rc > 0) {
+    if (view.nbytes > nbytes) {
+      BLOSC_TRACE_ERROR("Not enough space for decompressing in dest.");
+      return BLOSC2_ERROR_WRITE_BUFFER;
     }
-    int32_t prev_nbytes = blosc2_decompress_ctx(dctx, coffsets, coffsets_cbytes, offsets, off_nbytes);
-    blosc2_free_ctx(dctx);
-    if (prev_nbytes < 0) {
-      free(offsets);
-      BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
-      return NULL;
+    dctx->header_overhead = BLOSC_EXTENDED_HEADER_LENGTH;
+    rc = blosc2_decompress_ctx(dctx, view.chunk, view.cbytes, dest, nbytes);
+    if (rc >= 0 && rc != view.nbytes) {
+      BLOSC_TRACE_ERROR("Error in decompressing chunk.");
+      rc = BLOSC2_ERROR_FAILURE;
     }
+    return rc;
   }
 
-  // Delete the new offset
-  for (int64_t i = nchunk; i < nchunks - 1; i++) {
-    offsets[i] = offsets[i + 1];
+  // Chunks that have been read ahead are complete already
+  rc = 0;
+  needs_free = false;
+  bool lazy = false;  /* whether src comes from the allocator of dctx */
+  if (frame->prefetcher != NULL) {
+    rc = frame_prefetch_get(frame, nchunk, &src);
+    needs_free = rc > 0;
+  }
+  if (rc == 0) {
+    // Use a lazychunk here in order to do a potential parallel read.
+    rc = frame_get_lazychunk_ctx(frame, nchunk, &src, &needs_free, dctx);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the chunk in position %" PRId64 ".", nchunk);
+      goto end;
+    }
+    lazy = needs_free;
+  }
+  chunk_cbytes = rc;
+  if (chunk_cbytes < (signed)sizeof(int32_t)) {
+    /* Not enough input to read `nbytes` */
+    rc = BLOSC2_ERROR_READ_BUFFER;
   }
-  offsets[nchunks - 1] = 0;
 
-  // Re-compress the offsets again
-  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
-  cparams.splitmode = BLOSC_NEVER_SPLIT;
-  cparams.typesize = sizeof(int64_t);
-  cparams.blocksize = 16 * 1024;  // based on experiments with create_frame.c bench
-  cparams.nthreads = 4;  // 4 threads seems a decent default for nowadays CPUs
-  cparams.compcode = BLOSC_BLOSCLZ;
-  blosc2_context* cctx = blosc2_create_cctx(cparams);
-  if (cctx == NULL) {
-    BLOSC_TRACE_ERROR("Error while creating the compression context");
-    return NULL;
+  rc = blosc2_cbuffer_sizes(src, &chunk_nbytes, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    goto end;
   }
-  void* off_chunk = malloc((size_t)off_nbytes + BLOSC2_MAX_OVERHEAD);
-  int32_t new_off_cbytes = blosc2_compress_ctx(cctx, offsets, off_nbytes - (int32_t)sizeof(int64_t),
-                                               off_chunk, off_nbytes + BLOSC2_MAX_OVERHEAD);
-  blosc2_free_ctx(cctx);
 
-  free(offsets);
-  if (new_off_cbytes < 0) {
-    free(off_chunk);
-    return NULL;
+  /* Create a buffer for destination */
+  if (chunk_nbytes > nbytes) {
+    BLOSC_TRACE_ERROR("Not enough space for decompressing in dest.");
+    rc = BLOSC2_ERROR_WRITE_BUFFER;
+    goto end;
+  }
+  /* And decompress it */
+  dctx->header_overhead = BLOSC_EXTENDED_HEADER_LENGTH;
+  int chunksize = rc = blosc2_decompress_ctx(dctx, src, chunk_cbytes, dest, nbytes);
+  if (chunksize < 0 || chunksize != chunk_nbytes) {
+    BLOSC_TRACE_ERROR("Error in decompressing chunk.");
+    if (chunksize >= 0)
+      rc = BLOSC2_ERROR_FAILURE;
+  }
+  end:
+  if (lazy) {
+    ctx_free(dctx, src);
+  }
+  else if (needs_free) {
+    free(src);
   }
+  return rc;
+}
 
-  int64_t new_cbytes = cbytes;
 
-  int64_t new_frame_len;
+/* The lazy chunks of the last point lookups, indexed by their number modulo
+   FRAME_ITEM_CACHE_LEN, and the stream that their blocks are read through */
+#define FRAME_ITEM_CACHE_LEN 64
+
+typedef struct {
+  int64_t nchunk;       // -1 if the slot is empty
+  uint8_t *chunk;
+  int32_t cbytes;
+} frame_item_slot;
+
+struct frame_item_cache {
+  frame_item_slot slots[FRAME_ITEM_CACHE_LEN];
+  const blosc2_io_cb *io_cb;
+  void *stream;
+  int64_t stream_id;    // the chunk file of the stream for sparse frames
+};
+
+
+void frame_item_cache_clear(blosc2_frame_s *frame) {
+  frame_item_cache *cache = frame->item_cache;
+  if (cache == NULL) {
+    return;
+  }
+  for (int i = 0; i < FRAME_ITEM_CACHE_LEN; i++) {
+    free(cache->slots[i].chunk);
+  }
+  if (cache->stream != NULL) {
+    cache->io_cb->close(cache->stream);
+  }
+  free(cache);
+  frame->item_cache = NULL;
+}
+
+
+void frame_memory_usage(blosc2_frame_s *frame, int64_t *buffer, int64_t *bookkeeping, int64_t *caches) {
+  *buffer = 0;
+  if (frame->cframe != NULL && !frame->avoid_cframe_free) {
+    *buffer = frame->cframe_cap > frame->len ? frame->cframe_cap : frame->len;
+  }
+
+  *bookkeeping = (int64_t) sizeof(blosc2_frame_s) + frame->coffsets_len +
+                 frame->offsets_cap * (int64_t) sizeof(int64_t) + frame->open_head_len + frame->open_tail_len +
+                 frame->vlmeta_npositions * (int64_t) sizeof(int64_t) + frame->append_scratch_len;
+  if (frame->urlpath != NULL) {
+    *bookkeeping += (int64_t) strlen(frame->urlpath) + 1;
+  }
+  if (frame->header != NULL) {
+    *bookkeeping += FRAME_HEADER_MINLEN;
+  }
+
+  *caches = 0;
+  frame_prefetcher *pf = frame->prefetcher;
+  if (pf != NULL) {
+    *caches += (int64_t) sizeof(frame_prefetcher) + pf->depth * (int64_t) sizeof(frame_prefetch_slot);
+    pthread_mutex_lock(&pf->mutex);
+    for (int i = 0; i < pf->depth; i++) {
+      if (pf->slots[i].chunk != NULL) {
+        *caches += pf->slots[i].cbytes;
+      }
+    }
+    pthread_mutex_unlock(&pf->mutex);
+  }
+  frame_item_cache *item_cache = frame->item_cache;
+  if (item_cache != NULL) {
+    *caches += (int64_t) sizeof(frame_item_cache);
+    for (int i = 0; i < FRAME_ITEM_CACHE_LEN; i++) {
+      if (item_cache->slots[i].chunk != NULL) {
+        *caches += item_cache->slots[i].cbytes;
+      }
+    }
+  }
+}
+
+
+/* The id of the file of a lazy chunk of a sparse frame, which starts its trailer */
+static int64_t lazychunk_file_id(const uint8_t *chunk) {
+  int32_t nbytes = sw32_(chunk + BLOSC2_CHUNK_NBYTES);
+  int32_t blocksize = sw32_(chunk + BLOSC2_CHUNK_BLOCKSIZE);
+  int32_t nblocks = nbytes / blocksize + (nbytes % blocksize != 0);
+  int64_t trailer_offset = BLOSC_EXTENDED_HEADER_LENGTH + (int64_t)nblocks * sizeof(int32_t);
+  if ((chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] & BLOSC2_USEDICT) &&
+      !(chunk[BLOSC2_CHUNK_FLAGS] & (uint8_t)BLOSC_MEMCPYED)) {
+    trailer_offset += sizeof(int32_t);
+  }
+  if (is_hybrid_chunk(chunk[BLOSC2_CHUNK_FLAGS])) {
+    trailer_offset += nblocks;
+  }
+  trailer_offset += stored_dref_len(chunk);
+  int32_t id;
+  memcpy(&id, chunk + trailer_offset, sizeof(id));
+  return id;
+}
+
+
+/* The stream for the blocks of the lazy chunk of `slot`, which is kept open for the next lookups */
+static void* item_cache_stream(blosc2_frame_s *frame, frame_item_cache *cache, frame_item_slot *slot) {
+  if (!(slot->chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] & 0x08u)) {
+    // Special chunks have no blocks to read
+    return NULL;
+  }
+  int64_t id = frame->sframe ? sframe_file_id(frame, lazychunk_file_id(slot->chunk)) : -1;
+  if (cache->stream != NULL && cache->stream_id == id) {
+    return cache->stream;
+  }
+  if (cache->stream != NULL) {
+    cache->io_cb->close(cache->stream);
+    cache->stream = NULL;
+  }
+  blosc2_io *io = frame->schunk->storage->io;
+  cache->io_cb = blosc2_get_io_cb(io->id);
+  if (cache->io_cb == NULL) {
+    // The blocks will report the error
+    return NULL;
+  }
   if (frame->sframe) {
-    new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
+    cache->stream = sframe_open_file(frame, lazychunk_file_id(slot->chunk), "rb");
   }
   else {
-    new_frame_len = header_len + new_cbytes + new_off_cbytes + frame->trailer_len;
+    cache->stream = cache->io_cb->open(frame->urlpath, "rb", io->params);
   }
+  cache->stream_id = id;
+  return cache->stream;
+}
 
-  // Add the chunk and update meta
-  FILE* fp = NULL;
-  if (frame->cframe != NULL) {
-    uint8_t* framep = frame->cframe;
-    /* Make space for the new chunk and copy it */
-    frame->cframe = framep = realloc(framep, (size_t)new_frame_len);
-    if (framep == NULL) {
-      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
-      return NULL;
+
+int frame_get_item(blosc2_context *dctx, blosc2_frame_s *frame, int64_t nchunk, int32_t start,
+                   void *dest, int32_t destsize) {
+  frame_item_cache *cache = frame->item_cache;
+  frame_item_slot *slot = NULL;
+  if (cache != NULL && cache->slots[nchunk % FRAME_ITEM_CACHE_LEN].nchunk == nchunk) {
+    slot = &cache->slots[nchunk % FRAME_ITEM_CACHE_LEN];
+  }
+
+  if (slot == NULL) {
+    // Chunks in memory (and special ones) are at hand already
+    blosc2_chunk_view view;
+    int rc = frame_get_chunk_view(frame, nchunk, &view);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the chunk in position %" PRId64 ".", nchunk);
+      return rc;
     }
-    /* Copy the offsets */
-    memcpy(framep + header_len + new_cbytes, off_chunk, (size_t)new_off_cbytes);
-  } else {
-    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
-    if (io_cb == NULL) {
-      BLOSC_TRACE_ERROR("Error getting the input/output API");
-      return NULL;
+    if (rc > 0) {
+      return blosc2_getitem_ctx(dctx, view.chunk, view.cbytes, start, 1, dest, destsize);
     }
 
-    size_t wbytes;
-    if (frame->sframe) {
-      int64_t offset;
-      rc = get_coffset(frame, header_len, cbytes, nchunk, nchunks, &offset);
-      if (rc < 0) {
-        BLOSC_TRACE_ERROR("Unable to get offset to chunk %" PRId64 ".", nchunk);
-        return NULL;
-      }
-      if (offset >= 0){
-        // Remove the chunk file only if it is not a special value chunk
-        int err = sframe_delete_chunk(frame->urlpath, offset);
-        if (err != 0) {
-          BLOSC_TRACE_ERROR("Unable to delete chunk!");
-          return NULL;
-        }
-      }
-      // Update the offsets chunk in the chunks frame
-      fp = sframe_open_index(frame->urlpath, "rb+", frame->schunk->storage->io);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return NULL;
+    uint8_t *chunk;
+    bool needs_free;
+    rc = frame_get_lazychunk(frame, nchunk, &chunk, &needs_free);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the chunk in position %" PRId64 ".", nchunk);
+      return rc;
+    }
+    if (frame->concurrent_reads) {
+      // Other threads may be looking up items too, so nothing is kept
+      int nbytes = blosc2_getitem_ctx(dctx, chunk, rc, start, 1, dest, destsize);
+      if (needs_free) {
+        free(chunk);
       }
-      io_cb->seek(fp, frame->file_offset + header_len + 0, SEEK_SET);
+      return nbytes;
     }
-    else {
-      // Regular frame
-      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return NULL;
+    if (!needs_free) {
+      // The chunk is memory-mapped
+      return blosc2_getitem_ctx(dctx, chunk, rc, start, 1, dest, destsize);
+    }
+
+    if (cache == NULL) {
+      cache = calloc(1, sizeof(frame_item_cache));
+      if (cache == NULL) {
+        free(chunk);
+        BLOSC_TRACE_ERROR("Error allocating memory!");
+        return BLOSC2_ERROR_MEMORY_ALLOC;
       }
-      io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
+      for (int i = 0; i < FRAME_ITEM_CACHE_LEN; i++) {
+        cache->slots[i].nchunk = -1;
+      }
+      frame->item_cache = cache;
     }
-    wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
-    io_cb->close(fp);
-    if (wbytes != (size_t)new_off_cbytes) {
-      BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
-      return NULL;
+    slot = &cache->slots[nchunk % FRAME_ITEM_CACHE_LEN];
+    free(slot->chunk);
+    slot->nchunk = nchunk;
+    slot->chunk = chunk;
+    slot->cbytes = rc;
+  }
+
+  dctx->lazy_stream = item_cache_stream(frame, cache, slot);
+  int nbytes = blosc2_getitem_ctx(dctx, slot->chunk, slot->cbytes, start, 1, dest, destsize);
+  dctx->lazy_stream = NULL;
+  return nbytes;
+}
+
+
+/* The state of a frame stream while it is written (see blosc2_stream_writer_new()) */
+struct blosc2_stream_writer_s {
+  blosc2_schunk* schunk;
+  blosc2_stream_write_cb write;
+  void* user_data;
+  int64_t* offsets;      // the offsets of the chunks written so far, for the index
+  int64_t nchunks;
+  int64_t offsets_cap;
+  int64_t cbytes;        // the bytes of the chunks written so far
+  int64_t len;           // the bytes of the stream written so far
+  int rc;                // the first error, after which the stream is of no use
+};
+
+static int stream_write(blosc2_stream_writer* writer, const void* buf, int64_t size) {
+  const uint8_t* p = buf;
+  while (size > 0 && writer->rc == 0) {
+    int64_t wbytes = writer->write(writer->user_data, p, size);
+    if (wbytes <= 0) {
+      BLOSC_TRACE_ERROR("Cannot write to the stream.");
+      writer->rc = BLOSC2_ERROR_FILE_WRITE;
+      break;
     }
-    // Invalidate the cache for chunk offsets
-    if (frame->coffsets != NULL) {
-      free(frame->coffsets);
-      frame->coffsets = NULL;
+    p += wbytes;
+    size -= wbytes;
+    writer->len += wbytes;
+  }
+  return writer->rc;
+}
+
+/* Read exactly `size` bytes out of a stream */
+static int stream_read(blosc2_stream_read_cb read, void* user_data, void* buf, int64_t size) {
+  uint8_t* p = buf;
+  while (size > 0) {
+    int64_t rbytes = read(user_data, p, size);
+    if (rbytes <= 0) {
+      BLOSC_TRACE_ERROR("Cannot read the stream (it may have ended before its trailer).");
+      return BLOSC2_ERROR_FILE_READ;
     }
+    p += rbytes;
+    size -= rbytes;
   }
-  free(off_chunk);
+  return 0;
+}
 
-  frame->len = new_frame_len;
-  rc = frame_update_header(frame, schunk, false);
-  if (rc < 0) {
+
+blosc2_stream_writer* blosc2_stream_writer_new(blosc2_schunk* schunk, blosc2_stream_write_cb write,
+                                               void* user_data) {
+  if (schunk == NULL || write == NULL) {
+    BLOSC_TRACE_ERROR("The stream needs a super-chunk and a write callback.");
     return NULL;
   }
+  // The sizes are not known upfront, so they are left out of the header, and the reader
+  // goes by the chunks instead
+  blosc2_frame_s frame = {0};
+  frame.len = FRAME_STREAM_LEN;
+  uint8_t* h2 = new_header_frame(schunk, &frame);
+  if (h2 == NULL) {
+    BLOSC_TRACE_ERROR("Cannot build the header of the stream.");
+    return NULL;
+  }
+  int64_t zero = 0;
+  to_big(h2 + FRAME_NBYTES, &zero, sizeof(zero));
+  to_big(h2 + FRAME_CBYTES, &zero, sizeof(zero));
+  h2[FRAME_FLAGS] &= (uint8_t) ~FRAME_INDEX_TWO_LEVELS;
+  int32_t h2len;
+  from_big(&h2len, h2 + FRAME_HEADER_LEN, sizeof(h2len));
 
-  rc = frame_update_trailer(frame, schunk);
+  blosc2_stream_writer* writer = calloc(1, sizeof(blosc2_stream_writer));
+  writer->schunk = schunk;
+  writer->write = write;
+  writer->user_data = user_data;
+  int rc = stream_write(writer, h2, h2len);
+  free(h2);
   if (rc < 0) {
+    free(writer);
     return NULL;
   }
-
-  return frame;
+  return writer;
 }
 
 
-int frame_reorder_offsets(blosc2_frame_s* frame, const int64_t* offsets_order, blosc2_schunk* schunk) {
-  // Get header info
-  int32_t header_len;
-  int64_t frame_len;
-  int64_t nbytes;
-  int64_t cbytes;
-  int32_t blocksize;
-  int32_t chunksize;
-  int64_t nchunks;
-  int ret = get_header_info(frame, &header_len, &frame_len, &nbytes, &cbytes,
-                            &blocksize, &chunksize, &nchunks,
-                            NULL, NULL, NULL, NULL, NULL, NULL, NULL,
-                            frame->schunk->storage->io);
-  if (ret < 0) {
-      BLOSC_TRACE_ERROR("Cannot get the header info for the frame.");
-      return ret;
+int64_t blosc2_stream_writer_append_chunk(blosc2_stream_writer* writer, const uint8_t* chunk) {
+  if (writer->rc < 0) {
+    return writer->rc;
   }
-
-  // Get the current offsets and add one more
-  int32_t off_nbytes = (int32_t) (nchunks * sizeof(int64_t));
-  int64_t* offsets = (int64_t *) malloc((size_t)off_nbytes);
-
-  int32_t coffsets_cbytes = 0;
-  uint8_t *coffsets = get_coffsets(frame, header_len, cbytes, nchunks, &coffsets_cbytes);
-  if (coffsets == NULL) {
-    BLOSC_TRACE_ERROR("Cannot get the offsets for the frame.");
-    free(offsets);
-    return BLOSC2_ERROR_DATA;
+  int32_t cbytes;
+  int rc = blosc2_cbuffer_sizes(chunk, NULL, &cbytes, NULL);
+  if (rc < 0) {
+    return rc;
   }
-
-  // Decompress offsets
-  blosc2_dparams off_dparams = BLOSC2_DPARAMS_DEFAULTS;
-  blosc2_context *dctx = blosc2_create_dctx(off_dparams);
-  if (dctx == NULL) {
-    BLOSC_TRACE_ERROR("Error while creating the decompression context");
-    return BLOSC2_ERROR_NULL_POINTER;
+  if (writer->nchunks == writer->offsets_cap) {
+    int64_t cap = writer->offsets_cap > 0 ? 2 * writer->offsets_cap : 1024;
+    int64_t* offsets = realloc(writer->offsets, cap * sizeof(int64_t));
+    if (offsets == NULL) {
+      BLOSC_TRACE_ERROR("Cannot grow the index of the stream.");
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    writer->offsets = offsets;
+    writer->offsets_cap = cap;
   }
-  int32_t prev_nbytes = blosc2_decompress_ctx(dctx, coffsets, coffsets_cbytes,
-                                              offsets, off_nbytes);
-  blosc2_free_ctx(dctx);
-  if (prev_nbytes < 0) {
-    free(offsets);
-    BLOSC_TRACE_ERROR("Cannot decompress the offsets chunk.");
-    return prev_nbytes;
+  rc = stream_write(writer, chunk, cbytes);
+  if (rc < 0) {
+    return rc;
   }
+  writer->offsets[writer->nchunks] = writer->cbytes;
+  writer->nchunks++;
+  writer->cbytes += cbytes;
+  return writer->nchunks;
+}
 
-  // Make a copy of the chunk offsets and reorder it
-  int64_t *offsets_copy = malloc(prev_nbytes);
-  memcpy(offsets_copy, offsets, prev_nbytes);
 
-  for (int i = 0; i < nchunks; ++i) {
-    offsets[i] = offsets_copy[offsets_order[i]];
+int64_t blosc2_stream_writer_append_buffer(blosc2_stream_writer* writer, const void* src, int32_t nbytes) {
+  if (writer->rc < 0) {
+    return writer->rc;
   }
-  free(offsets_copy);
-
-  // Re-compress the offsets again
-  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
-  cparams.splitmode = BLOSC_NEVER_SPLIT;
-  cparams.typesize = sizeof(int64_t);
-  cparams.blocksize = 16 * 1024;  // based on experiments with create_frame.c bench
-  cparams.nthreads = 4;  // 4 threads seems a decent default for nowadays CPUs
-  cparams.compcode = BLOSC_BLOSCLZ;
-  blosc2_context* cctx = blosc2_create_cctx(cparams);
-  if (cctx == NULL) {
-    BLOSC_TRACE_ERROR("Error while creating the compression context");
-    return BLOSC2_ERROR_NULL_POINTER;
+  blosc2_context* cctx = writer->schunk->cctx;
+  int32_t destsize = nbytes + BLOSC2_MAX_OVERHEAD + trailer_maxlen(cctx->checksum, cctx->cipher, nbytes, cctx->blocksize);
+  uint8_t* chunk = malloc(destsize);
+  if (chunk == NULL) {
+    BLOSC_TRACE_ERROR("Error allocating memory!");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
   }
-  void* off_chunk = malloc((size_t)off_nbytes + BLOSC2_MAX_OVERHEAD);
-  int32_t new_off_cbytes = blosc2_compress_ctx(cctx, offsets, off_nbytes,
-                                               off_chunk, off_nbytes + BLOSC2_MAX_OVERHEAD);
-  blosc2_free_ctx(cctx);
+  int64_t rc = blosc2_compress_ctx(cctx, src, nbytes, chunk, destsize);
+  if (rc >= 0) {
+    rc = blosc2_stream_writer_append_chunk(writer, chunk);
+  }
+  free(chunk);
+  return rc;
+}
 
-  if (new_off_cbytes < 0) {
-    free(offsets);
-    free(off_chunk);
-    return new_off_cbytes;
+
+int64_t blosc2_stream_writer_close(blosc2_stream_writer* writer) {
+  blosc2_context* cctx = writer->schunk->cctx;
+  int64_t rc = writer->rc;
+  uint8_t* off_chunk = NULL;
+  int32_t off_cbytes = 0;
+  if (rc == 0 && writer->nchunks > 0) {
+    off_chunk = compress_offsets(cctx, BLOSC2_INDEX_CHUNK, writer->offsets, writer->nchunks, &off_cbytes);
+    if (off_chunk == NULL) {
+      rc = BLOSC2_ERROR_DATA;
+    }
   }
-  free(offsets);
-  int64_t new_frame_len;
-  if (frame->sframe) {
-    // The chunks are not in the frame
-    new_frame_len = header_len + 0 + new_off_cbytes + frame->trailer_len;
+  int64_t trailer_len = 0;
+  uint8_t* trailer = NULL;
+  if (rc == 0) {
+    rc = frame_load_vlmetalayers((blosc2_frame_s*)writer->schunk->frame, writer->schunk, -1);
   }
-  else {
-    new_frame_len = header_len + cbytes + new_off_cbytes + frame->trailer_len;
+  if (rc == 0) {
+    trailer = new_trailer_frame(writer->schunk, 0, &trailer_len);
+    if (trailer == NULL) {
+      rc = BLOSC2_ERROR_FAILURE;
+    }
   }
+  if (rc == 0) {
+    // The chunks end with the header of a chunk of version 0, which has the number of
+    // chunks and the lengths of the index and the trailer that follow
+    uint8_t end[FRAME_STREAM_END_LEN] = {0};
+    int32_t trailer_len_ = (int32_t) trailer_len;
+    to_big(end + 4, &off_cbytes, sizeof(off_cbytes));
+    to_big(end + 8, &trailer_len_, sizeof(trailer_len_));
+    to_big(end + 12, &writer->nchunks, sizeof(writer->nchunks));
+    stream_write(writer, end, FRAME_STREAM_END_LEN);
+    stream_write(writer, off_chunk, off_cbytes);
+    rc = stream_write(writer, trailer, trailer_len);
+  }
+  ctx_free(cctx, off_chunk);
+  free(trailer);
+  int64_t len = writer->len;
+  free(writer->offsets);
+  free(writer);
+  return rc < 0 ? rc : len;
+}
 
-  if (frame->cframe != NULL) {
-    uint8_t* framep = frame->cframe;
-    /* Make space for the new chunk and copy it */
-    frame->cframe = framep = realloc(framep, (size_t)new_frame_len);
-    if (framep == NULL) {
-      BLOSC_TRACE_ERROR("Cannot realloc space for the frame.");
-      return BLOSC2_ERROR_MEMORY_ALLOC;
+
+int64_t blosc2_schunk_to_stream(blosc2_schunk* schunk, blosc2_stream_write_cb write, void* user_data) {
+  blosc2_stream_writer* writer = blosc2_stream_writer_new(schunk, write, user_data);
+  if (writer == NULL) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  int64_t rc = 0;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks && rc >= 0; nchunk++) {
+    uint8_t* chunk;
+    bool needs_free;
+    rc = blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free);
+    if (rc >= 0) {
+      rc = blosc2_stream_writer_append_chunk(writer, chunk);
+    }
+    if (rc >= 0 && needs_free) {
+      free(chunk);
     }
-    /* Copy the offsets */
-    memcpy(framep + header_len + cbytes, off_chunk, (size_t)new_off_cbytes);
   }
-  else {
-    void* fp = NULL;
+  int64_t len = blosc2_stream_writer_close(writer);
+  return rc < 0 ? rc : len;
+}
 
-    blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
-    if (io_cb == NULL) {
-      BLOSC_TRACE_ERROR("Error getting the input/output API");
-      return BLOSC2_ERROR_PLUGIN_IO;
+
+static void free_metalayers(blosc2_metalayer** metalayers, int nmetalayers) {
+  for (int i = 0; i < nmetalayers; i++) {
+    if (metalayers[i] != NULL) {
+      free(metalayers[i]->name);
+      free(metalayers[i]->content);
+      free(metalayers[i]);
+      metalayers[i] = NULL;
     }
+  }
+}
 
-    if (frame->sframe) {
-      // Update the offsets chunk in the chunks frame
-      fp = sframe_open_index(frame->urlpath, "rb+",
-                             frame->schunk->storage->io);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return BLOSC2_ERROR_FILE_OPEN;
-      }
-      io_cb->seek(fp, frame->file_offset + header_len + 0, SEEK_SET);
+
+/* Read the chunks of a frame stream into `schunk`, and check them against the index at the end */
+static int stream_read_chunks(blosc2_stream_read_cb read, void* user_data, blosc2_schunk* schunk,
+                              int32_t* off_cbytes, int32_t* trailer_len) {
+  uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+  uint8_t* chunk = NULL;
+  int32_t chunk_cap = 0;
+  int64_t* offsets = NULL;
+  int64_t offsets_cap = 0;
+  int64_t nchunks = 0;
+  int64_t coffset = 0;
+  int rc;
+  while ((rc = stream_read(read, user_data, header, sizeof(header))) == 0) {
+    if (header[BLOSC2_CHUNK_VERSION] == 0) {
+      // The end of the chunks
+      break;
     }
-    else {
-      // Regular frame
-      fp = io_cb->open(frame->urlpath, "rb+", frame->schunk->storage->io->params);
-      if (fp == NULL) {
-        BLOSC_TRACE_ERROR("Error opening file in: %s", frame->urlpath);
-        return BLOSC2_ERROR_FILE_OPEN;
-      }
-      io_cb->seek(fp, frame->file_offset + header_len + cbytes, SEEK_SET);
+    int32_t cbytes;
+    rc = blosc2_cbuffer_sizes(header, NULL, &cbytes, NULL);
+    if (rc < 0 || cbytes < BLOSC_EXTENDED_HEADER_LENGTH) {
+      BLOSC_TRACE_ERROR("Wrong chunk in the stream.");
+      rc = BLOSC2_ERROR_DATA;
+      break;
     }
-    int64_t wbytes = io_cb->write(off_chunk, 1, new_off_cbytes, fp);  // the new offsets
-    io_cb->close(fp);
-    if (wbytes != new_off_cbytes) {
-      BLOSC_TRACE_ERROR("Cannot write the offsets to frame.");
-      return BLOSC2_ERROR_FILE_WRITE;
+    if (cbytes > chunk_cap) {
+      free(chunk);
+      chunk = malloc(cbytes);
+      chunk_cap = cbytes;
+    }
+    if (nchunks == offsets_cap) {
+      offsets_cap = offsets_cap > 0 ? 2 * offsets_cap : 1024;
+      offsets = realloc(offsets, offsets_cap * sizeof(int64_t));
+    }
+    if (chunk == NULL || offsets == NULL) {
+      BLOSC_TRACE_ERROR("Error allocating memory!");
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      break;
+    }
+    memcpy(chunk, header, sizeof(header));
+    rc = stream_read(read, user_data, chunk + sizeof(header), cbytes - (int64_t) sizeof(header));
+    if (rc < 0) {
+      break;
     }
+    int64_t nchunks_ = blosc2_schunk_append_chunk(schunk, chunk, true);
+    if (nchunks_ < 0) {
+      rc = (int) nchunks_;
+      break;
+    }
+    offsets[nchunks] = coffset;
+    nchunks++;
+    coffset += cbytes;
+  }
+  free(chunk);
+
+  int64_t nchunks_end;
+  if (rc == 0) {
+    from_big(off_cbytes, header + 4, sizeof(*off_cbytes));
+    from_big(trailer_len, header + 8, sizeof(*trailer_len));
+    from_big(&nchunks_end, header + 12, sizeof(nchunks_end));
+    if (nchunks_end != nchunks || *off_cbytes < 0 || (*off_cbytes == 0) != (nchunks == 0) ||
+        *trailer_len < FRAME_TRAILER_MINLEN) {
+      BLOSC_TRACE_ERROR("Wrong end of the chunks in the stream.");
+      rc = BLOSC2_ERROR_DATA;
+    }
+  }
+  if (rc == 0 && nchunks > 0) {
+    uint8_t* coffsets = malloc(*off_cbytes);
+    int64_t* offsets_end = malloc(nchunks * sizeof(int64_t));
+    rc = stream_read(read, user_data, coffsets, *off_cbytes);
+    if (rc == 0 && (decompress_offsets(schunk->dctx, BLOSC2_INDEX_CHUNK, coffsets, *off_cbytes, offsets_end, nchunks) !=
+                    nchunks * (int64_t) sizeof(int64_t) ||
+                    memcmp(offsets, offsets_end, nchunks * sizeof(int64_t)) != 0)) {
+      BLOSC_TRACE_ERROR("The index of the stream does not match its chunks.");
+      rc = BLOSC2_ERROR_DATA;
+    }
+    free(offsets_end);
+    free(coffsets);
   }
+  free(offsets);
+  return rc;
+}
 
-  // Invalidate the cache for chunk offsets
-  if (frame->coffsets != NULL) {
-    free(frame->coffsets);
-    frame->coffsets = NULL;
-  }
-  free(off_chunk);
 
-  frame->len = new_frame_len;
-  int rc = frame_update_header(frame, schunk, false);
+blosc2_schunk* blosc2_schunk_from_stream(blosc2_stream_read_cb read, void* user_data, blosc2_storage* storage) {
+  blosc2_storage storage_ = storage != NULL ? *storage : BLOSC2_STORAGE_DEFAULTS;
+  // The parameters and the metalayers of the stream
+  blosc2_schunk params = {0};
+  blosc2_schunk* schunk = NULL;
+  uint8_t* trailer = NULL;
+  uint8_t* header = malloc(FRAME_HEADER_MINLEN);
+  int rc = stream_read(read, user_data, header, FRAME_HEADER_MINLEN);
   if (rc < 0) {
-    return rc;
+    goto end;
   }
-
-  rc = frame_update_trailer(frame, schunk);
+  int32_t header_len;
+  int64_t frame_len;
+  from_big(&header_len, header + FRAME_HEADER_LEN, sizeof(header_len));
+  from_big(&frame_len, header + FRAME_LEN, sizeof(frame_len));
+  if (strcmp((char*)header + FRAME_HEADER_MAGIC, "b2frame") != 0 || frame_len != FRAME_STREAM_LEN ||
+      header_len < FRAME_HEADER_MINLEN) {
+    BLOSC_TRACE_ERROR("This is not a frame stream.");
+    rc = BLOSC2_ERROR_INVALID_HEADER;
+    goto end;
+  }
+  header = realloc(header, header_len);
+  rc = stream_read(read, user_data, header + FRAME_HEADER_MINLEN, header_len - FRAME_HEADER_MINLEN);
   if (rc < 0) {
-    return rc;
+    goto end;
   }
 
-  return 0;
-}
-
-
-/* Decompress and return a chunk that is part of a frame. */
-int frame_decompress_chunk(blosc2_context *dctx, blosc2_frame_s* frame, int64_t nchunk, void *dest, int32_t nbytes) {
-  uint8_t* src;
-  bool needs_free;
-  int32_t chunk_nbytes;
-  int32_t chunk_cbytes;
-  int rc;
-
-  // Use a lazychunk here in order to do a potential parallel read.
-  rc = frame_get_lazychunk(frame, nchunk, &src, &needs_free);
+  // The header is parsed as the one of an empty frame
+  frame_len = header_len;
+  to_big(header + FRAME_LEN, &frame_len, sizeof(frame_len));
+  blosc2_frame_s frame = {0};
+  frame.cframe = header;
+  frame.len = header_len;
+  rc = get_header_info(&frame, &header_len, &frame_len, &params.nbytes, &params.cbytes, &params.blocksize,
+                       &params.chunksize, &params.nchunks, &params.typesize, &params.compcode,
+                       &params.compcode_meta, &params.clevel, params.filters, params.filters_meta,
+                       &params.splitmode, &BLOSC2_IO_DEFAULTS);
   if (rc < 0) {
-    BLOSC_TRACE_ERROR("Cannot get the chunk in position %" PRId64 ".", nchunk);
     goto end;
   }
-  chunk_cbytes = rc;
-  if (chunk_cbytes < (signed)sizeof(int32_t)) {
-    /* Not enough input to read `nbytes` */
-    rc = BLOSC2_ERROR_READ_BUFFER;
+  rc = get_meta_from_header(&frame, &params, header, header_len);
+  if (rc < 0) {
+    goto end;
   }
 
-  rc = blosc2_cbuffer_sizes(src, &chunk_nbytes, &chunk_cbytes, NULL);
+  blosc2_cparams cparams = storage_.cparams != NULL ? *storage_.cparams : BLOSC2_CPARAMS_DEFAULTS;
+  cparams.compcode = params.compcode;
+  cparams.compcode_meta = params.compcode_meta;
+  cparams.clevel = params.clevel;
+  cparams.typesize = params.typesize;
+  cparams.blocksize = params.blocksize;
+  cparams.splitmode = params.splitmode;
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    cparams.filters[i] = params.filters[i];
+    cparams.filters_meta[i] = params.filters_meta[i];
+  }
+  storage_.cparams = &cparams;
+  schunk = blosc2_schunk_new(&storage_);
+  if (schunk == NULL) {
+    rc = BLOSC2_ERROR_FAILURE;
+    goto end;
+  }
+  for (int i = 0; i < params.nmetalayers && rc >= 0; i++) {
+    blosc2_metalayer* metalayer = params.metalayers[i];
+    rc = blosc2_meta_add(schunk, metalayer->name, metalayer->content, metalayer->content_len);
+  }
   if (rc < 0) {
     goto end;
   }
 
-  /* Create a buffer for destination */
-  if (chunk_nbytes > nbytes) {
-    BLOSC_TRACE_ERROR("Not enough space for decompressing in dest.");
-    rc = BLOSC2_ERROR_WRITE_BUFFER;
+  int32_t off_cbytes = 0;
+  int32_t trailer_len = 0;
+  rc = stream_read_chunks(read, user_data, schunk, &off_cbytes, &trailer_len);
+  if (rc < 0) {
     goto end;
   }
-  /* And decompress it */
-  dctx->header_overhead = BLOSC_EXTENDED_HEADER_LENGTH;
-  int chunksize = rc = blosc2_decompress_ctx(dctx, src, chunk_cbytes, dest, nbytes);
-  if (chunksize < 0 || chunksize != chunk_nbytes) {
-    BLOSC_TRACE_ERROR("Error in decompressing chunk.");
-    if (chunksize >= 0)
-      rc = BLOSC2_ERROR_FAILURE;
+
+  // The variable-length metalayers come in the trailer
+  trailer = malloc(trailer_len);
+  rc = stream_read(read, user_data, trailer, trailer_len);
+  if (rc < 0) {
+    goto end;
+  }
+  params.cctx = schunk->cctx;
+  rc = get_vlmeta_from_trailer(NULL, &params, trailer, trailer_len, 0);
+  if (rc < 0) {
+    goto end;
   }
+  for (int i = 0; i < params.nvlmetalayers; i++) {
+    schunk->vlmetalayers[schunk->nvlmetalayers] = params.vlmetalayers[i];
+    schunk->nvlmetalayers++;
+    params.vlmetalayers[i] = NULL;
+  }
+  if (schunk->frame != NULL && schunk->nvlmetalayers > 0) {
+    rc = frame_update_header((blosc2_frame_s*)schunk->frame, schunk, false);
+    if (rc >= 0) {
+      rc = frame_update_trailer((blosc2_frame_s*)schunk->frame, schunk);
+    }
+  }
+
   end:
-  if (needs_free) {
-    free(src);
+  free(header);
+  free(trailer);
+  free_metalayers(params.metalayers, BLOSC2_MAX_METALAYERS);
+  free_metalayers(params.vlmetalayers, BLOSC2_MAX_VLMETALAYERS);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot read the super-chunk out of the stream.");
+    if (schunk != NULL) {
+      blosc2_schunk_free(schunk);
+      blosc2_remove_urlpath(storage_.urlpath);
+    }
+    return NULL;
   }
-  return rc;
+  return schunk;
 }
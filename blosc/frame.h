@@ -46,25 +46,96 @@
 
 #define FRAME_FILTER_PIPELINE_MAX (8)  // the maximum number of filters that can be stored in header
 
+#define FRAME_INDEX_TWO_LEVELS (0x80)  // general flag for the chunk offsets in a two-level index
+#define FRAME_INDEX_LEAF_NOFFSETS (64 * 1024)  // the number of offsets in every leaf of a two-level index
+#define FRAME_PACKED_INDEX_HEADER_LEN (16)  // the length, the offsets per group and the number of offsets
+#define FRAME_PACKED_INDEX_GROUP_LEN (24)  // the reference, the step, the position and the bits of a group
+#define FRAME_PACKED_INDEX_NOFFSETS (128)  // the number of offsets in every group of a packed index
+
+#define FRAME_SPLITMODE_MASK (0x03)  // the bits of the other flags for the split mode
+#define FRAME_CHUNK_ALIGN_SHIFT (2)  // the other flags keep the log2 of the chunk alignment from this bit on
+#define FRAME_CHUNK_ALIGN_MASK (0x1f)
+#define FRAME_CHUNK_ALIGN_MAX (1 << 30)  // the largest alignment of chunks
+#define FRAME_INDEX_LOG (0x80)  // other flag for the sparse frames that record their appends in an index log
+#define FRAME_TYPE_MASK (0x01)  // the bits of the frame type byte for the type
+#define FRAME_DIR_LEVELS_SHIFT (1)  // the frame type byte keeps the subdirectory levels of sparse frames from this bit on
+#define FRAME_DIR_LEVELS_MASK (0x07)
+#define FRAME_DIR_LEVELS_MAX (3)  // the most subdirectory levels of sparse frames (one per byte of the file ids)
+#define FRAME_SHARD_SHIFT (4)  // the frame type byte keeps the log2 of the chunks per shard from this bit on
+#define FRAME_SHARD_NCHUNKS_MAX (1 << 15)  // the most chunks in a shard of a sparse frame
+
+#define FRAME_INDEX_LOG_NENTRIES (4096)  // the appends kept in the index log of a sparse frame before merging it
+#define FRAME_COPY_BLOCKSIZE (4 * 1024 * 1024)  // the size of the blocks for copying the chunks between frames
+
 #define FRAME_TRAILER_VERSION_BETA2 (0U)  // for beta.2 and former
 #define FRAME_TRAILER_VERSION (1U)        // can be up to 127
 
 #define FRAME_TRAILER_MINLEN (25)  // minimum length for the trailer (msgpack overhead)
 #define FRAME_TRAILER_LEN_OFFSET (22)  // offset to trailer length (counting from the end)
+#define FRAME_TRAILER_FINGERPRINT_TYPE (17)  // offset to fingerprint type (counting from the end)
+#define FRAME_FINGERPRINT_NONE (0U)
+#define FRAME_FINGERPRINT_64 (2U)  // the XXH3 of the trailer before its length (for checksummed chunks)
 #define FRAME_TRAILER_VLMETALAYERS (2)
+#define FRAME_OPEN_READAHEAD (16 * 1024)  // bytes read at each end of on-disk frames when opening them
+#define FRAME_REFRESH_NREADS (16)  // reads of the header of a frame that is being written before giving up
+#define FRAME_STREAM_LEN (-1)  // the frame length in the header of frame streams, which is not known upfront
+#define FRAME_STREAM_END_LEN (BLOSC_EXTENDED_HEADER_LENGTH)  // the marker between the chunks and the index of streams
+
+// The read-ahead of the chunks of on-disk frames (see frame_set_prefetch())
+typedef struct frame_prefetcher frame_prefetcher;
 
+// The serialization of the index updates of concurrent writers (see frame_set_concurrent_writes())
+typedef struct frame_writers frame_writers;
+
+// The lazy chunks of the point lookups of on-disk frames (see frame_get_item())
+typedef struct frame_item_cache frame_item_cache;
 
 typedef struct {
   char* urlpath;            //!< The name of the file or directory if it's an sframe; if NULL, this is in-memory
   uint8_t* cframe;          //!< The in-memory, contiguous frame buffer
   bool avoid_cframe_free;   //!< Whether the cframe can be freed (false) or not (true).
+  int64_t cframe_cap;       //!< The number of bytes allocated for `cframe` (at least `len`)
+  int64_t shm_len;          //!< The length of the shared memory mapped read-only as `cframe` (0 if none)
+  bool read_only;           //!< Whether `cframe` is borrowed read-only from an archive (see blosc2_archive_open_schunk())
   uint8_t* coffsets;        //!< Pointers to the (compressed, on-disk) chunk offsets
+  int32_t coffsets_len;     //!< The number of bytes in `coffsets`
+  int64_t* offsets;         //!< The decompressed chunk offsets of on-disk frames (NULL if not decoded yet)
+  int64_t noffsets;         //!< The number of entries in `offsets`
+  int64_t offsets_cap;      //!< The number of entries allocated for `offsets`
+  uint8_t* header;          //!< Copy of the fixed-size part of the header of on-disk frames (NULL if not read yet)
   int64_t len;              //!< The current length of the frame in (compressed) bytes
   int64_t maxlen;           //!< The maximum length of the frame; if 0, there is no maximum
   uint32_t trailer_len;     //!< The current length of the trailer in (compressed) bytes
   bool sframe;              //!< Whether the frame is sparse (true) or not
   blosc2_schunk *schunk;    //!< The schunk associated
   int64_t file_offset;      //!< The offset where the frame starts inside the file
+  bool bulk;                //!< Whether appends defer the update of the offsets, header and trailer
+  bool bulk_pending;        //!< Whether there are deferred updates (`offsets` and `header` are the only up-to-date copies)
+  bool versioned;           //!< Whether the appends are published as new versions (see frame_set_versioned_commits())
+  int64_t group_nappends;   //!< The appends not synced yet with #BLOSC2_DURABILITY_GROUP
+  blosc_timestamp_t group_start;  //!< When the first of `group_nappends` happened
+  int64_t bulk_chunk_id;    //!< The last chunk id of a sparse frame in bulk mode
+  int64_t special_value;    //!< The offset of the special chunk in `special_chunk` (0 if none yet)
+  uint8_t special_chunk[BLOSC_EXTENDED_HEADER_LENGTH];  //!< The last special chunk built for a view
+  frame_prefetcher* prefetcher;  //!< The read-ahead of chunks for sequential scans (NULL if disabled)
+  uint8_t* open_head;       //!< The first bytes of an on-disk frame, read when opening it (NULL once it changes)
+  int64_t open_head_len;    //!< The number of bytes in `open_head`
+  uint8_t* open_tail;       //!< The last bytes of an on-disk frame, read when opening it (NULL once it changes)
+  int64_t open_tail_offset; //!< Where `open_tail` starts in the frame
+  int64_t open_tail_len;    //!< The number of bytes in `open_tail`
+  bool concurrent_reads;    //!< Whether the frame is read from several threads (the lazy caches are filled up front)
+  frame_writers* writers;   //!< The state of the concurrent writes of a sparse frame (NULL if disabled)
+  frame_item_cache* item_cache;  //!< The lazy chunks of the last point lookups (NULL if none yet)
+  int index_format;         //!< The format of the index of the chunk offsets (BLOSC2_INDEX_*)
+  int32_t chunk_align;      //!< The boundary where the chunks and the index of a contiguous frame start (0 if none)
+  int32_t shard_nchunks;    //!< The chunks in every shard file of a sparse frame (0 if every chunk has a file)
+  int8_t dir_levels;        //!< The levels of subdirectories that the files of a sparse frame are spread over
+  bool index_log;           //!< Whether the appends to a sparse frame are recorded in its index log (in bulk mode)
+  int64_t index_log_nentries;  //!< The entries in the index log that are not merged into the index yet
+  int64_t* vlmeta_positions;  //!< Where the contents of the vlmetalayers left on disk at opening are (-1 once read)
+  int16_t vlmeta_npositions;  //!< The number of entries in `vlmeta_positions`
+  uint8_t* append_scratch;  //!< Where the appended buffers are compressed before going to the frame (NULL if none yet)
+  int32_t append_scratch_len;  //!< The size of `append_scratch`
 } blosc2_frame_s;
 
 
@@ -105,6 +176,59 @@ int64_t frame_from_schunk(blosc2_schunk* schunk, blosc2_frame_s* frame);
  */
 void frame_avoid_cframe_free(blosc2_frame_s* frame, bool avoid_cframe_free);
 
+/**
+ * @brief Release the spare capacity of the buffer of an in-memory frame, which grows
+ * geometrically with appends.
+ *
+ * @param frame The frame.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int frame_shrink_to_fit(blosc2_frame_s* frame);
+
+/**
+ * @brief Start, resize or stop the read-ahead of the chunks of an on-disk frame.
+ *
+ * A background thread reads the next @p depth chunks while the current one is
+ * decompressed by frame_decompress_chunk().  In-memory frames are not read ahead.
+ *
+ * @param frame The frame.
+ * @param depth The number of chunks to read ahead; 0 stops the read-ahead.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int frame_set_prefetch(blosc2_frame_s *frame, int depth);
+
+/**
+ * @brief Make (or stop making) the reads of a frame safe to run concurrently.
+ *
+ * The header and the chunk offsets, which reads cache lazily, are read up front, and
+ * the special chunks are built in the views instead of in the frame.  The read-ahead
+ * cannot be used meanwhile.
+ *
+ * @param frame The frame.
+ * @param enable Whether the frame is going to be read from several threads.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int frame_set_concurrent_reads(blosc2_frame_s *frame, bool enable);
+
+/**
+ * @brief Drop the chunks read ahead, waiting for the reads in flight.  Must be called
+ * before the chunks or their offsets are modified.
+ *
+ * @param frame The frame.
+ */
+void frame_prefetch_clear(blosc2_frame_s *frame);
+
+/**
+ * @brief Get the number of chunks that were (@p hits) and were not (@p misses) read
+ * ahead when frame_decompress_chunk() needed them.
+ *
+ * @return 0 if succeeds, or BLOSC2_ERROR_NOT_FOUND if there is no read-ahead.
+ */
+int frame_get_prefetch_stats(blosc2_frame_s *frame, int64_t *hits, int64_t *misses);
+
 /**
  * @brief Free all memory from a frame.
  *
@@ -150,21 +274,224 @@ blosc2_storage *
 get_new_storage(const blosc2_storage *storage, const blosc2_cparams *cdefaults, const blosc2_dparams *ddefaults,
                 const blosc2_io *iodefaults);
 
+/* The chunk is copied (or written) to the frame, so it is still owned by the caller */
 void* frame_append_chunk(blosc2_frame_s* frame, void* chunk, blosc2_schunk* schunk);
 void* frame_insert_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk);
 void* frame_update_chunk(blosc2_frame_s* frame, int64_t nchunk, void* chunk, blosc2_schunk* schunk);
 void* frame_delete_chunk(blosc2_frame_s* frame, int64_t nchunk, blosc2_schunk* schunk);
 int frame_reorder_offsets(blosc2_frame_s *frame, const int64_t *offsets_order, blosc2_schunk* schunk);
 
+/**
+ * @brief Reclaim the space of the chunks that are no longer referenced in a contiguous
+ * frame, by packing the stored ones in the order of their offsets.
+ *
+ * @param frame The frame.  Sparse frames have nothing to reclaim.
+ * @param in_place Whether the chunks are moved inside the frame (and the file is truncated
+ * afterwards) or copied into a new file that replaces the old one once complete.
+ *
+ * @return The number of bytes reclaimed. Else a negative code is returned.
+ */
+int64_t frame_compact(blosc2_frame_s* frame, bool in_place);
+
+/**
+ * @brief Copy all the chunks of a contiguous frame, verbatim, into an empty one.
+ *
+ * The chunks and their offsets go as a whole right after the header of @p dest (so
+ * the holes of @p src are kept too), and only the header and trailer are rebuilt.
+ * Copies between plain files are done by the kernel where possible.
+ *
+ * @param dest The empty, contiguous frame to copy to (its metalayers already added).
+ * @param src The contiguous frame to copy from.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int frame_copy_chunks(blosc2_frame_s* dest, blosc2_frame_s* src);
+
+/**
+ * @brief Append the chunks of a contiguous frame to another one, with no recompression.
+ *
+ * The chunks of @p src go as a whole right after the ones of @p dest, and the offsets of
+ * both are merged and written once, along with the header and trailer.
+ *
+ * @param dest The contiguous frame to append to.
+ * @param src The contiguous frame to append from.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int frame_concat_chunks(blosc2_frame_s* dest, blosc2_frame_s* src);
+
+/**
+ * @brief Fill an empty in-memory contiguous frame with the chunks of a super-chunk
+ * in memory or in a sparse frame.
+ *
+ * The chunks are put in their places of the frame by several threads, and the ones
+ * of sparse frames are read out of their files by them too.
+ *
+ * @param dest The empty in-memory contiguous frame to fill.
+ * @param src_schunk The super-chunk with the chunks.
+ * @param nthreads The number of threads (unless there is a shared pool).
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int frame_fill_chunks(blosc2_frame_s* dest, blosc2_schunk* src_schunk, int nthreads);
+
 int frame_get_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t **chunk, bool *needs_free);
 int frame_get_lazychunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t **chunk, bool *needs_free);
+/* Like frame_get_lazychunk(), but the chunk (and the temporaries) come from the allocator of @p ctx,
+   so the chunk has to be released with ctx_free() when it needs a free */
+int frame_get_lazychunk_ctx(blosc2_frame_s* frame, int64_t nchunk, uint8_t **chunk, bool *needs_free,
+                            blosc2_context *ctx);
+int frame_get_chunk_view(blosc2_frame_s* frame, int64_t nchunk, blosc2_chunk_view *view);
+int frame_get_chunk_headers(blosc2_frame_s* frame, int64_t start, int64_t stop, uint8_t *headers);
+int64_t frame_send_chunks(blosc2_frame_s* frame, int64_t start, int64_t stop, int fd);
+
+/* Called by frame_prefetch_chunks() when a chunk has been fetched (cbytes is negative on errors) */
+typedef void (*frame_chunk_ready_cb)(int64_t nchunk, uint8_t *chunk, int32_t cbytes, bool needs_free,
+                                     void *user_data);
+int frame_prefetch_chunks(blosc2_frame_s *frame, int64_t start, int64_t stop,
+                          frame_chunk_ready_cb ready, void *user_data);
 int frame_decompress_chunk(blosc2_context* dctx, blosc2_frame_s* frame, int64_t nchunk,
                            void *dest, int32_t nbytes);
 
+/**
+ * @brief Get the item @p start of the chunk @p nchunk of a frame.
+ *
+ * The lazy chunks (header, bstarts and trailer) of on-disk frames are kept between
+ * calls, along with the stream that their blocks are read through, so that a lookup
+ * only reads the block of the item.  Frames that are read concurrently go without.
+ *
+ * @return The size of the item, or a negative code if there is some problem.
+ */
+int frame_get_item(blosc2_context* dctx, blosc2_frame_s* frame, int64_t nchunk, int32_t start,
+                   void *dest, int32_t destsize);
+
+/**
+ * @brief Drop the lazy chunks kept by frame_get_item() and close their stream.  Must be
+ * called before the chunks or their offsets are modified.
+ *
+ * @param frame The frame.
+ */
+void frame_item_cache_clear(blosc2_frame_s *frame);
+
+/**
+ * @brief Get the memory held by a frame: the buffer of in-memory frames that own it
+ * (@p buffer), the rest of the frame itself (@p bookkeeping), and the chunks read ahead
+ * or kept for the point lookups (@p caches).
+ */
+void frame_memory_usage(blosc2_frame_s *frame, int64_t *buffer, int64_t *bookkeeping, int64_t *caches);
+
 int frame_update_header(blosc2_frame_s* frame, blosc2_schunk* schunk, bool new);
 int frame_update_trailer(blosc2_frame_s* frame, blosc2_schunk* schunk);
+int frame_update_vlmetalayers(blosc2_frame_s* frame, blosc2_schunk* schunk);
+
+/**
+ * @brief Read the contents of the vlmetalayers of an on-disk frame that were left in its
+ * trailer when opening it.  Must be called before the frame is modified, as the trailer
+ * can be overwritten then.
+ *
+ * @param frame The frame.
+ * @param schunk The super-chunk of the frame.
+ * @param nvlmetalayer The vlmetalayer to read, or all of them if negative.
+ *
+ * @return 0 if succeeds (or there was nothing to read). Else a negative code is returned.
+ */
+int frame_load_vlmetalayers(blosc2_frame_s* frame, blosc2_schunk* schunk, int nvlmetalayer);
+
+/**
+ * @brief Write down the offsets, header and trailer whose updates were
+ * deferred by the appends in bulk mode (see blosc2_schunk_begin_bulk()).
+ *
+ * @param frame The frame.
+ *
+ * @return 0 if succeeds (or there was nothing to write). Else a negative code is returned.
+ */
+int frame_flush_bulk(blosc2_frame_s* frame);
+
+/**
+ * @brief Apply the appends recorded in the index log of a sparse frame that were not
+ * merged into its index, as if they had just been done in bulk mode.
+ *
+ * @param frame The frame.
+ *
+ * @return 0 if succeeds (or the frame has no log). Else a negative code is returned.
+ */
+int frame_replay_index_log(blosc2_frame_s* frame);
+
+/**
+ * @brief Make (or stop making) a sparse frame safe for several threads appending or
+ * updating chunks (see frame_put_chunk()).
+ *
+ * The frame is kept in bulk mode meanwhile, so the offsets are only merged into the
+ * index on disk when the concurrent writes are disabled, which also commits the bulk,
+ * or at the checkpoints of frame_flush_bulk().
+ *
+ * @param frame The frame.
+ * @param enable Whether the frame is going to be written from several threads.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int frame_set_concurrent_writes(blosc2_frame_s* frame, bool enable);
+
+/**
+ * @brief Make (or stop making) the appends to a contiguous frame on disk readable
+ * by other processes while they happen.
+ *
+ * The chunks of every commit (every append, or every bulk append) go past the end of
+ * the frame, followed by the new offsets and trailer; the header, written last, is
+ * what publishes them.  The previous offsets and trailer are left behind as unused
+ * bytes among the chunks, for the readers that have not refreshed yet (see frame_refresh()).
+ *
+ * @param frame The frame.
+ * @param enable Whether the appends are published as new versions.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+int frame_set_versioned_commits(blosc2_frame_s* frame, bool enable);
+
+/**
+ * @brief Catch up with the versions of a contiguous frame on disk published by a
+ * writer after it was opened (see frame_set_versioned_commits()).
+ *
+ * @param frame The frame.
+ *
+ * @return The number of chunks in the frame. Else a negative code is returned.
+ */
+int64_t frame_refresh(blosc2_frame_s* frame);
+
+/**
+ * @brief Make the writes to a contiguous frame on disk durable on the storage device.
+ *
+ * @param frame The frame.
+ *
+ * @return 0 if succeeds (or the frame is not a contiguous one on disk). Else a negative code is returned.
+ */
+int frame_sync(blosc2_frame_s* frame);
+
+/**
+ * @brief Append (if @p nchunk is negative) or update a chunk of a sparse frame with
+ * concurrent writes.
+ *
+ * The chunk is written to a new file without any locking, and only the update of the
+ * offsets, the header and the counters of the super-chunk is serialized.  The file of
+ * an updated chunk is removed afterwards.
+ *
+ * @param frame The frame.
+ * @param nchunk The chunk to update, or a negative value for appending.
+ * @param chunk The chunk, which is not taken over.
+ *
+ * @return The number of chunks in the frame. Else a negative code is returned.
+ */
+int64_t frame_put_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t* chunk);
 
-int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_value,
-                       int32_t chunksize, blosc2_schunk* schunk);
+/**
+ * @brief Fill an empty frame with chunks of a special value in one go, writing only the index.
+ *
+ * Chunks of BLOSC2_SPECIAL_VALUE (which repeat @p repeatval) are stored once, and all the
+ * entries of the index point to that copy; @p nitems has to fill whole chunks then.
+ *
+ * @return The length of the frame.  Else a negative code is returned.
+ */
+int64_t frame_fill_special(blosc2_frame_s* frame, int64_t nitems, int special_value, const void* repeatval,
+                           int32_t chunksize, blosc2_schunk* schunk);
 
 #endif /* BLOSC_FRAME_H */
@@ -10,6 +10,11 @@
 
 #include "frame.h"
 #include "stune.h"
+#include "zonemap.h"
+#include "bloom.h"
+#include "threadpool.h"
+#include "b2nd_utils.h"
+#include "blosc-atomic.h"
 #include "blosc-private.h"
 #include "blosc2/tuners-registry.h"
 #include "blosc2.h"
@@ -19,11 +24,16 @@
 #include <direct.h>
 #include <malloc.h>
 #define mkdir(D, M) _mkdir(D)
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #endif  /* _WIN32 */
 
 #include <sys/stat.h>
 
 #include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -54,6 +64,17 @@ int blosc2_schunk_get_cparams(blosc2_schunk *schunk, blosc2_cparams **cparams) {
   }
   else {
     (*cparams)->nthreads = (int16_t)schunk->cctx->nthreads;
+    (*cparams)->allocator = schunk->cctx->allocator_params;
+    (*cparams)->special_detection = schunk->cctx->special_detection;
+    (*cparams)->record_stats = schunk->cctx->record_stats;
+    (*cparams)->zonemap = schunk->cctx->zonemap;
+    (*cparams)->checksum = schunk->cctx->checksum;
+    (*cparams)->block_codec = schunk->cctx->block_codec;
+    (*cparams)->block_codec_params = schunk->cctx->block_codec_params;
+    (*cparams)->zstd_window = schunk->cctx->zstd_window;
+    (*cparams)->detect_typesize = schunk->cctx->detect_typesize;
+    (*cparams)->cipher = schunk->cctx->cipher;
+    (*cparams)->cipher_key = schunk->cctx->has_cipher_key ? schunk->cctx->cipher_key : NULL;
   }
   return 0;
 }
@@ -68,6 +89,10 @@ int blosc2_schunk_get_dparams(blosc2_schunk *schunk, blosc2_dparams **dparams) {
   }
   else {
     (*dparams)->nthreads = schunk->dctx->nthreads;
+    (*dparams)->allocator = schunk->dctx->allocator_params;
+    (*dparams)->verify_checksums = schunk->dctx->verify_checksums;
+    (*dparams)->cipher_key = schunk->dctx->has_cipher_key ? schunk->dctx->cipher_key : NULL;
+    (*dparams)->nontemporal = schunk->dctx->nontemporal;
   }
   return 0;
 }
@@ -105,6 +130,11 @@ int update_schunk_properties(struct blosc2_schunk* schunk) {
   }
 
   /* The decompression context */
+  if (dparams->device != BLOSC2_DEVICE_HOST) {
+    // The context also decompresses the offsets, the metalayers and the cached chunks
+    BLOSC_TRACE_ERROR("Super-chunks can only be decompressed into host memory.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
   if (schunk->dctx != NULL) {
     blosc2_free_ctx(schunk->dctx);
   }
@@ -130,12 +160,52 @@ blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage) {
   blosc2_schunk* schunk = calloc(1, sizeof(blosc2_schunk));
   schunk->version = 0;     /* pre-first version */
 
+  if (storage->index_format < BLOSC2_INDEX_CHUNK || storage->index_format > BLOSC2_INDEX_PACKED) {
+    BLOSC_TRACE_ERROR("The format of the index (%d) is not supported.", storage->index_format);
+    free(schunk);
+    return NULL;
+  }
+  if (storage->chunk_align < 0 || storage->chunk_align > FRAME_CHUNK_ALIGN_MAX ||
+      (storage->chunk_align & (storage->chunk_align - 1)) != 0) {
+    BLOSC_TRACE_ERROR("The alignment of the chunks (%d) is not a power of 2 up to %d.",
+                      storage->chunk_align, FRAME_CHUNK_ALIGN_MAX);
+    free(schunk);
+    return NULL;
+  }
+  if (storage->shard_nchunks < 0 || storage->shard_nchunks > FRAME_SHARD_NCHUNKS_MAX ||
+      (storage->shard_nchunks & (storage->shard_nchunks - 1)) != 0) {
+    BLOSC_TRACE_ERROR("The chunks per shard (%d) are not a power of 2 up to %d.",
+                      storage->shard_nchunks, FRAME_SHARD_NCHUNKS_MAX);
+    free(schunk);
+    return NULL;
+  }
+  if (storage->dir_levels < 0 || storage->dir_levels > FRAME_DIR_LEVELS_MAX) {
+    BLOSC_TRACE_ERROR("The levels of subdirectories (%d) are not up to %d.",
+                      storage->dir_levels, FRAME_DIR_LEVELS_MAX);
+    free(schunk);
+    return NULL;
+  }
+  if (storage->durability < BLOSC2_DURABILITY_NONE || storage->durability > BLOSC2_DURABILITY_WRITE ||
+      storage->sync_nappends < 0 || storage->sync_ms < 0) {
+    BLOSC_TRACE_ERROR("The durability level (%d) or its limits are not valid.", storage->durability);
+    free(schunk);
+    return NULL;
+  }
+  if (storage->durability != BLOSC2_DURABILITY_NONE && storage->contiguous && storage->urlpath != NULL) {
+    blosc2_io_cb *io_cb = blosc2_get_io_cb(storage->io != NULL ? storage->io->id : BLOSC2_IO_FILESYSTEM);
+    if (io_cb == NULL || io_cb_ext(io_cb)->sync == NULL) {
+      BLOSC_TRACE_ERROR("The io of the frame cannot sync its writes.");
+      free(schunk);
+      return NULL;
+    }
+  }
+
   // Get the storage with proper defaults
   schunk->storage = get_new_storage(storage, &BLOSC2_CPARAMS_DEFAULTS, &BLOSC2_DPARAMS_DEFAULTS, &BLOSC2_IO_DEFAULTS);
   // Update the (local variable) storage
   storage = schunk->storage;
 
-  char* tradeoff = getenv("BTUNE_TRADEOFF");
+  const char* tradeoff = blosc_getenv(BLOSC_ENV_BTUNE_TRADEOFF);
   if (tradeoff != NULL) {
     // If BTUNE_TRADEOFF passed, automatically use btune
     storage->cparams->tuner_id = BLOSC_BTUNE;
@@ -158,12 +228,19 @@ blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage) {
     // Create directory
     if (mkdir(urlpath, 0777) == -1) {
       BLOSC_TRACE_ERROR("Error during the creation of the directory, maybe it already exists.");
+      free(urlpath);
+      blosc2_schunk_free(schunk);
       return NULL;
     }
     // We want a sparse (directory) frame as storage
     blosc2_frame_s* frame = frame_new(urlpath);
     free(urlpath);
     frame->sframe = true;
+    frame->index_format = storage->index_format;
+    frame->chunk_align = storage->chunk_align;
+    frame->shard_nchunks = storage->shard_nchunks > 1 ? storage->shard_nchunks : 0;
+    frame->dir_levels = (int8_t)storage->dir_levels;
+    frame->index_log = storage->index_log;
     // Initialize frame (basically, encode the header)
     frame->schunk = schunk;
     int64_t frame_len = frame_from_schunk(schunk, frame);
@@ -178,11 +255,14 @@ blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage) {
     if (storage->urlpath != NULL) {
       if (file_exists(storage->urlpath)) {
         BLOSC_TRACE_ERROR("You are trying to overwrite an existing frame.  Remove it first!");
+        blosc2_schunk_free(schunk);
         return NULL;
       }
     }
     blosc2_frame_s* frame = frame_new(storage->urlpath);
     frame->sframe = false;
+    frame->index_format = storage->index_format;
+    frame->chunk_align = storage->chunk_align;
     // Initialize frame (basically, encode the header)
     frame->schunk = schunk;
     int64_t frame_len = frame_from_schunk(schunk, frame);
@@ -197,6 +277,67 @@ blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage) {
 }
 
 
+/* Add the metalayers of `schunk` to `new_schunk` */
+static int copy_metalayers(blosc2_schunk *schunk, blosc2_schunk *new_schunk) {
+  for (int nmeta = 0; nmeta < schunk->nmetalayers; ++nmeta) {
+    blosc2_metalayer *meta = schunk->metalayers[nmeta];
+    int rc = blosc2_meta_add(new_schunk, meta->name, meta->content, meta->content_len);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Can not add %s `metalayer`.", meta->name);
+      return rc;
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Add the vlmetalayers of `schunk` to `new_schunk`, but for the ones describing the chunks
+ * when they are `recompressed` */
+static int copy_vlmetalayers(blosc2_schunk *schunk, blosc2_schunk *new_schunk, bool recompressed) {
+  for (int nmeta = 0; nmeta < schunk->nvlmetalayers; ++nmeta) {
+    uint8_t *content;
+    int32_t content_len;
+    char* name = schunk->vlmetalayers[nmeta]->name;
+    if (recompressed && strcmp(name, SHARED_DICT_VLMETA) == 0) {
+      // The recompressed chunks do not reference the shared dictionary
+      continue;
+    }
+    if (strcmp(name, TUNER_VLMETA) == 0) {
+      // The tuner of the copy keeps its own state
+      continue;
+    }
+    if (recompressed && strcmp(name, STATS_VLMETA) == 0) {
+      // The stats are not the ones of the recompressed chunks
+      continue;
+    }
+    if (recompressed && strcmp(name, ZONEMAP_VLMETA) == 0) {
+      // The blocks of the recompressed chunks may be others
+      continue;
+    }
+    if (recompressed && strcmp(name, XDELTA_VLMETA) == 0) {
+      // The recompressed chunks are appended decoded
+      continue;
+    }
+    if (strcmp(name, TRANSCODE_VLMETA) == 0) {
+      // The copy is complete
+      continue;
+    }
+    int rc = blosc2_vlmeta_get(schunk, name, &content, &content_len);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Can not get %s `vlmetalayer`.", name);
+      return rc;
+    }
+    rc = blosc2_vlmeta_add(new_schunk, name, content, content_len, NULL);
+    free(content);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Can not add %s `vlmetalayer`.", name);
+      return rc;
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
 /* Create a copy of a super-chunk */
 blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage) {
   if (schunk == NULL) {
@@ -255,16 +396,30 @@ blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage
   }
 
   // Copy metalayers
-  for (int nmeta = 0; nmeta < schunk->nmetalayers; ++nmeta) {
-    blosc2_metalayer *meta = schunk->metalayers[nmeta];
-    if (blosc2_meta_add(new_schunk, meta->name, meta->content, meta->content_len) < 0) {
-      BLOSC_TRACE_ERROR("Can not add %s `metalayer`.", meta->name);
-      return NULL;
-    }
+  if (copy_metalayers(schunk, new_schunk) < 0) {
+    return NULL;
   }
 
   // Copy chunks
-  if (cparams_equal) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  blosc2_frame_s* new_frame = (blosc2_frame_s*)new_schunk->frame;
+  if (cparams_equal && frame != NULL && !frame->sframe && new_frame != NULL && !new_frame->sframe) {
+    // The chunks and their offsets go verbatim, in one go
+    if (frame_copy_chunks(new_frame, frame) < 0) {
+      BLOSC_TRACE_ERROR("Can not copy the chunks into super-chunk.");
+      return NULL;
+    }
+  } else if (cparams_equal && (frame == NULL || frame->sframe) && schunk->tiering == NULL &&
+             new_frame != NULL && !new_frame->sframe && new_frame->urlpath == NULL && new_frame->chunk_align <= 1) {
+    // The offsets of the chunks in the new frame are computed first, so that they are put
+    // (and read out of their files) by several threads
+    if (frame_fill_chunks(new_frame, schunk, schunk->cctx->nthreads) < 0) {
+      BLOSC_TRACE_ERROR("Can not fill the chunks into super-chunk.");
+      return NULL;
+    }
+  } else if (cparams_equal) {
+    // Defer the update of the offsets, header and trailer of on-disk frames to the end
+    blosc2_schunk_begin_bulk(new_schunk);
     for (int nchunk = 0; nchunk < schunk->nchunks; ++nchunk) {
       uint8_t *chunk;
       bool needs_free;
@@ -277,6 +432,10 @@ blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage
         return NULL;
       }
     }
+    if (blosc2_schunk_commit_bulk(new_schunk) < 0) {
+      BLOSC_TRACE_ERROR("Can not commit the appends into super-chunk.");
+      return NULL;
+    }
   } else {
     int32_t chunksize = schunk->chunksize == -1 ? 0 : schunk->chunksize;
     uint8_t *buffer = malloc(chunksize);
@@ -294,18 +453,20 @@ blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage
   }
 
   // Copy vlmetalayers
-  for (int nmeta = 0; nmeta < schunk->nvlmetalayers; ++nmeta) {
-    uint8_t *content;
-    int32_t content_len;
-    char* name = schunk->vlmetalayers[nmeta]->name;
-    if (blosc2_vlmeta_get(schunk, name, &content, &content_len) < 0) {
-      BLOSC_TRACE_ERROR("Can not get %s `vlmetalayer`.", name);
-    }
-    if (blosc2_vlmeta_add(new_schunk, name, content, content_len, NULL) < 0) {
-      BLOSC_TRACE_ERROR("Can not add %s `vlmetalayer`.", name);
-      return NULL;
-    }
-    free(content);
+  if (copy_vlmetalayers(schunk, new_schunk, !cparams_equal) < 0) {
+    return NULL;
+  }
+  if (schunk_load_shared_dict(new_schunk) < 0) {
+    BLOSC_TRACE_ERROR("Can not load the shared dictionary.");
+    return NULL;
+  }
+  if (schunk_load_zonemap(new_schunk) < 0) {
+    BLOSC_TRACE_ERROR("Can not load the kind of the zone maps.");
+    return NULL;
+  }
+  if (schunk_load_xdelta(new_schunk) < 0) {
+    BLOSC_TRACE_ERROR("Can not load the deltas between chunks.");
+    return NULL;
   }
   return new_schunk;
 }
@@ -323,6 +484,10 @@ blosc2_schunk* blosc2_schunk_open_udio(const char* urlpath, const blosc2_io *udi
     return NULL;
   }
   blosc2_schunk* schunk = frame_to_schunk(frame, false, udio);
+  if (schunk == NULL) {
+    // The frame goes away with the super-chunk
+    return NULL;
+  }
 
   // Set the storage with proper defaults
   size_t pathlen = strlen(urlpath);
@@ -348,6 +513,10 @@ blosc2_schunk* blosc2_schunk_open_offset(const char* urlpath, int64_t offset) {
     return NULL;
   }
   blosc2_schunk* schunk = frame_to_schunk(frame, false, &BLOSC2_IO_DEFAULTS);
+  if (schunk == NULL) {
+    // The frame goes away with the super-chunk
+    return NULL;
+  }
 
   // Set the storage with proper defaults
   size_t pathlen = strlen(urlpath);
@@ -368,19 +537,29 @@ int64_t blosc2_schunk_to_buffer(blosc2_schunk* schunk, uint8_t** dest, bool* nee
 
   if ((schunk->storage->contiguous == true) && (schunk->storage->urlpath == NULL)) {
     frame =  (blosc2_frame_s*)(schunk->frame);
+    int rc = frame_shrink_to_fit(frame);
+    if (rc < 0) {
+      return rc;
+    }
     *dest = frame->cframe;
     cframe_len = frame->len;
     *needs_free = false;
   }
   else {
     // Copy to a contiguous storage
-    blosc2_storage frame_storage = {.contiguous=true};
+    blosc2_storage frame_storage = {.contiguous=true, .index_format=schunk->storage->index_format,
+                                    .chunk_align=schunk->storage->chunk_align};
     blosc2_schunk* schunk_copy = blosc2_schunk_copy(schunk, &frame_storage);
     if (schunk_copy == NULL) {
       BLOSC_TRACE_ERROR("Error during the conversion of schunk to buffer.");
       return BLOSC2_ERROR_SCHUNK_COPY;
     }
     frame = (blosc2_frame_s*)(schunk_copy->frame);
+    int rc = frame_shrink_to_fit(frame);
+    if (rc < 0) {
+      blosc2_schunk_free(schunk_copy);
+      return rc;
+    }
     *dest = frame->cframe;
     cframe_len = frame->len;
     *needs_free = true;
@@ -448,7 +627,9 @@ int64_t blosc2_schunk_to_file(blosc2_schunk* schunk, const char* urlpath) {
   }
 
   // Copy to a contiguous file
-  blosc2_storage frame_storage = {.contiguous=true, .urlpath=(char*)urlpath};
+  blosc2_storage frame_storage = {.contiguous=true, .urlpath=(char*)urlpath,
+                                  .index_format=schunk->storage->index_format,
+                                  .chunk_align=schunk->storage->chunk_align};
   blosc2_schunk* schunk_copy = blosc2_schunk_copy(schunk, &frame_storage);
   if (schunk_copy == NULL) {
     BLOSC_TRACE_ERROR("Error during the conversion of schunk to buffer.");
@@ -479,7 +660,9 @@ int64_t blosc2_schunk_append_file(blosc2_schunk* schunk, const char* urlpath) {
     }
 
     // Copy to a contiguous file
-    blosc2_storage frame_storage = {.contiguous=true, .urlpath=NULL};
+    blosc2_storage frame_storage = {.contiguous=true, .urlpath=NULL,
+                                    .index_format=schunk->storage->index_format,
+                                    .chunk_align=schunk->storage->chunk_align};
     blosc2_schunk* schunk_copy = blosc2_schunk_copy(schunk, &frame_storage);
     if (schunk_copy == NULL) {
         BLOSC_TRACE_ERROR("Error during the conversion of schunk to buffer.");
@@ -492,618 +675,5555 @@ int64_t blosc2_schunk_append_file(blosc2_schunk* schunk, const char* urlpath) {
 }
 
 
-/* Free all memory from a super-chunk. */
-int blosc2_schunk_free(blosc2_schunk *schunk) {
-  if (schunk->data != NULL) {
-    for (int i = 0; i < schunk->nchunks; i++) {
-      free(schunk->data[i]);
-    }
-    free(schunk->data);
+/* Start deferring the updates of the offsets, header and trailer of an on-disk frame. */
+int blosc2_schunk_begin_bulk(blosc2_schunk *schunk) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame != NULL && frame->cframe == NULL) {
+    frame->bulk = true;
   }
-  if (schunk->cctx != NULL)
-    blosc2_free_ctx(schunk->cctx);
-  if (schunk->dctx != NULL)
-    blosc2_free_ctx(schunk->dctx);
-  if (schunk->blockshape != NULL)
-    free(schunk->blockshape);
+  return 0;
+}
 
-  if (schunk->nmetalayers > 0) {
-    for (int i = 0; i < schunk->nmetalayers; i++) {
-      if (schunk->metalayers[i] != NULL) {
-        if (schunk->metalayers[i]->name != NULL)
-          free(schunk->metalayers[i]->name);
-        if (schunk->metalayers[i]->content != NULL)
-          free(schunk->metalayers[i]->content);
-        free(schunk->metalayers[i]);
-      }
-    }
-    schunk->nmetalayers = 0;
-  }
 
-  if (schunk->storage != NULL) {
-    if (schunk->storage->urlpath != NULL) {
-      free(schunk->storage->urlpath);
-    }
-    free(schunk->storage->cparams);
-    free(schunk->storage->dparams);
-    free(schunk->storage->io);
-    free(schunk->storage);
+/* Write down the deferred updates of a bulk append. */
+int blosc2_schunk_commit_bulk(blosc2_schunk *schunk) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame == NULL) {
+    return 0;
   }
+  // Concurrent writes keep deferring the updates after this checkpoint
+  frame->bulk = frame->writers != NULL;
+  return frame_flush_bulk(frame);
+}
 
-  if (schunk->frame != NULL) {
-    frame_free((blosc2_frame_s *) schunk->frame);
+
+/* An entry of the cache of decompressed chunks */
+typedef struct chunk_cache_entry {
+  int64_t nchunk;
+  uint8_t *data;
+  int32_t nbytes;
+  struct chunk_cache_entry *prev;
+  struct chunk_cache_entry *next;
+} chunk_cache_entry;
+
+/* The cache of decompressed chunks of a super-chunk; entries are kept in LRU order */
+typedef struct {
+  int64_t max_nbytes;
+  int64_t nbytes;
+  int64_t hits;
+  int64_t misses;
+  chunk_cache_entry *head;  // most recently used
+  chunk_cache_entry *tail;  // least recently used
+} chunk_cache;
+
+
+static void cache_unlink(chunk_cache *cache, chunk_cache_entry *entry) {
+  if (entry->prev != NULL) {
+    entry->prev->next = entry->next;
+  }
+  else {
+    cache->head = entry->next;
   }
+  if (entry->next != NULL) {
+    entry->next->prev = entry->prev;
+  }
+  else {
+    cache->tail = entry->prev;
+  }
+  entry->prev = entry->next = NULL;
+}
 
-  if (schunk->nvlmetalayers > 0) {
-    for (int i = 0; i < schunk->nvlmetalayers; ++i) {
-      if (schunk->vlmetalayers[i] != NULL) {
-        if (schunk->vlmetalayers[i]->name != NULL)
-          free(schunk->vlmetalayers[i]->name);
-        if (schunk->vlmetalayers[i]->content != NULL)
-          free(schunk->vlmetalayers[i]->content);
-        free(schunk->vlmetalayers[i]);
-      }
-    }
+
+static void cache_push_front(chunk_cache *cache, chunk_cache_entry *entry) {
+  entry->prev = NULL;
+  entry->next = cache->head;
+  if (cache->head != NULL) {
+    cache->head->prev = entry;
+  }
+  cache->head = entry;
+  if (cache->tail == NULL) {
+    cache->tail = entry;
   }
+}
 
-  free(schunk);
 
-  return 0;
+static void cache_evict(chunk_cache *cache, chunk_cache_entry *entry) {
+  cache_unlink(cache, entry);
+  cache->nbytes -= entry->nbytes;
+  membudget_release(entry->nbytes);
+  free(entry->data);
+  free(entry);
 }
 
 
-/* Create a super-chunk out of a contiguous frame buffer */
-blosc2_schunk* blosc2_schunk_from_buffer(uint8_t *cframe, int64_t len, bool copy) {
-  blosc2_frame_s* frame = frame_from_cframe(cframe, len, false);
-  if (frame == NULL) {
-    return NULL;
-  }
-  // Check that the buffer actually comes from a cframe
-  char *magic_number = (char *)cframe;
-  magic_number += FRAME_HEADER_MAGIC;
-  if (strcmp(magic_number, "b2frame\0") != 0) {
-    return NULL;
+/* Drop the chunk `nchunk` from the cache of `schunk` (all of them if negative) */
+static void schunk_cache_invalidate(blosc2_schunk *schunk, int64_t nchunk) {
+  chunk_cache *cache = (chunk_cache *) schunk->chunk_cache;
+  if (cache == NULL) {
+    return;
   }
-  blosc2_schunk* schunk = frame_to_schunk(frame, copy, &BLOSC2_IO_DEFAULTS);
-  if (schunk && copy) {
-    // Super-chunk has its own copy of frame
-    frame_free(frame);
+  chunk_cache_entry *entry = cache->head;
+  while (entry != NULL) {
+    chunk_cache_entry *next = entry->next;
+    if (nchunk < 0 || entry->nchunk == nchunk) {
+      cache_evict(cache, entry);
+    }
+    entry = next;
   }
-  return schunk;
 }
 
 
-/* Create a super-chunk out of a contiguous frame buffer */
-void blosc2_schunk_avoid_cframe_free(blosc2_schunk *schunk, bool avoid_cframe_free) {
-  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
-  frame_avoid_cframe_free(frame, avoid_cframe_free);
+/* The deltas between the chunks of a super-chunk (see blosc2_schunk_set_xdelta()), along with
+ * the last chunk that has been decoded (or appended), which the next one is decoded against */
+typedef struct {
+  int32_t interval;  // the keyframes are the chunks that are a multiple of it
+  int64_t nchunk;  // the chunk in buffer (-1 if none)
+  uint8_t *buffer;
+  int32_t nbytes;
+  int32_t buffer_len;
+  uint8_t *tmp;  // for the chunks on the way to the one asked for
+  int32_t tmp_len;
+  pthread_mutex_t mutex;  // concurrent readers share the decoded chunk
+} xdelta_state;
+
+
+static void free_xdelta(blosc2_schunk *schunk) {
+  xdelta_state *xd = (xdelta_state *) schunk->xdelta;
+  if (xd != NULL) {
+    pthread_mutex_destroy(&xd->mutex);
+    free(xd->buffer);
+    free(xd->tmp);
+    free(xd);
+    schunk->xdelta = NULL;
+  }
 }
 
 
-/* Fill an empty frame with special values (fast path). */
-int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems, int special_value,
-                               int32_t chunksize) {
-  if (nitems == 0) {
-    return 0;
+/* Forget the decoded chunk if it is `nchunk` or a later one (whatever it is if negative) */
+static void xdelta_invalidate(blosc2_schunk *schunk, int64_t nchunk) {
+  xdelta_state *xd = (xdelta_state *) schunk->xdelta;
+  if (xd != NULL && (nchunk < 0 || xd->nchunk >= nchunk)) {
+    xd->nchunk = -1;
   }
+}
 
-  int32_t typesize = schunk->typesize;
 
-  if ((nitems * typesize / chunksize) > INT_MAX) {
-    BLOSC_TRACE_ERROR("nitems is too large.  Try increasing the chunksize.");
-    return BLOSC2_ERROR_SCHUNK_SPECIAL;
+/* The chunks of super-chunks with deltas between them can only be appended */
+static int check_no_xdelta(blosc2_schunk *schunk) {
+  if (schunk->xdelta != NULL) {
+    BLOSC_TRACE_ERROR("Chunks can only be appended in super-chunks with deltas between them.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  if ((schunk->nbytes > 0) || (schunk->cbytes > 0)) {
-    BLOSC_TRACE_ERROR("Filling with special values only works on empty super-chunks");
-    return BLOSC2_ERROR_FRAME_SPECIAL;
-  }
 
-  // Compute the number of chunks and the length of the offsets chunk
-  int32_t chunkitems = chunksize / typesize;
-  int64_t nchunks = nitems / chunkitems;
-  int32_t leftover_items = (int32_t)(nitems % chunkitems);
+/* The slabs holding the chunks of an in-memory super-chunk, which are freed in one go along
+ * with it (the chunks that are updated or deleted just leave their room unused) */
+typedef struct {
+  uint8_t **slabs;  // sorted by address, so that the owner of a chunk is found by bisection
+  int64_t *slab_lens;
+  int64_t nslabs;
+  int64_t max_nslabs;
+  uint8_t *current;  // the slab the chunks go to
+  int64_t current_len;
+  int64_t used;  // in the current slab
+  int32_t slab_size;  // 0 when new chunks are not taken anymore
+  uint8_t *scratch;  // where blosc2_schunk_append_buffer() compresses
+  int32_t scratch_len;
+} chunk_arena;
+
+#define ARENA_ALIGNMENT 16
+
+
+static void free_chunk_arena(blosc2_schunk *schunk) {
+  chunk_arena *arena = (chunk_arena *) schunk->chunk_arena;
+  if (arena == NULL) {
+    return;
+  }
+  for (int64_t i = 0; i < arena->nslabs; i++) {
+    free(arena->slabs[i]);
+  }
+  free(arena->slabs);
+  free(arena->slab_lens);
+  free(arena->scratch);
+  free(arena);
+  schunk->chunk_arena = NULL;
+}
 
-  if (schunk->frame == NULL) {
-    // Build the special chunks
-    int32_t leftover_size = leftover_items * typesize;
-    void* chunk = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
-    void* chunk2 = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
-    blosc2_cparams* cparams;
-    blosc2_schunk_get_cparams(schunk, &cparams);
-    int csize, csize2;
-    switch (special_value) {
-      case BLOSC2_SPECIAL_ZERO:
-        csize = blosc2_chunk_zeros(*cparams, chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
-        csize2 = blosc2_chunk_zeros(*cparams, leftover_size, chunk2, BLOSC_EXTENDED_HEADER_LENGTH);
-        break;
-      case BLOSC2_SPECIAL_UNINIT:
-        csize = blosc2_chunk_uninit(*cparams, chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
-        csize2 = blosc2_chunk_uninit(*cparams, leftover_size, chunk2, BLOSC_EXTENDED_HEADER_LENGTH);
-        break;
-      case BLOSC2_SPECIAL_NAN:
-        csize = blosc2_chunk_nans(*cparams, chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
-        csize2 = blosc2_chunk_nans(*cparams, leftover_size, chunk2, BLOSC_EXTENDED_HEADER_LENGTH);
-        break;
-      default:
-        BLOSC_TRACE_ERROR("Only zeros, NaNs or non-initialized values are supported.");
-        return BLOSC2_ERROR_SCHUNK_SPECIAL;
+
+/* Whether `chunk` lives in a slab of the arena */
+static bool arena_owns(chunk_arena *arena, const uint8_t *chunk) {
+  int64_t lo = 0;
+  int64_t hi = arena->nslabs;
+  while (lo < hi) {
+    int64_t mid = (lo + hi) / 2;
+    if ((uintptr_t) chunk < (uintptr_t) arena->slabs[mid]) {
+      hi = mid;
     }
-    free(cparams);
-    if (csize < 0 || csize2 < 0) {
-      BLOSC_TRACE_ERROR("Error creating special chunks.");
-      return BLOSC2_ERROR_SCHUNK_SPECIAL;
+    else if ((uintptr_t) chunk >= (uintptr_t) arena->slabs[mid] + arena->slab_lens[mid]) {
+      lo = mid + 1;
     }
-
-    for (int nchunk = 0; nchunk < nchunks; nchunk++) {
-      int64_t nchunk_ = blosc2_schunk_append_chunk(schunk, chunk, true);
-      if (nchunk_ != nchunk + 1) {
-        BLOSC_TRACE_ERROR("Error appending special chunks.");
-        return BLOSC2_ERROR_SCHUNK_SPECIAL;
-      }
+    else {
+      return true;
     }
+  }
+  return false;
+}
 
-    if (leftover_items) {
-      int64_t nchunk_ = blosc2_schunk_append_chunk(schunk, chunk2, true);
-      if (nchunk_ != nchunks + 1) {
-        BLOSC_TRACE_ERROR("Error appending last special chunk.");
-        return BLOSC2_ERROR_SCHUNK_SPECIAL;
+
+static int arena_add_slab(chunk_arena *arena, int64_t len) {
+  if (arena->nslabs == arena->max_nslabs) {
+    int64_t max_nslabs = arena->max_nslabs > 0 ? 2 * arena->max_nslabs : 16;
+    uint8_t **slabs = realloc(arena->slabs, max_nslabs * sizeof(uint8_t *));
+    BLOSC_ERROR_NULL(slabs, BLOSC2_ERROR_MEMORY_ALLOC);
+    arena->slabs = slabs;
+    int64_t *slab_lens = realloc(arena->slab_lens, max_nslabs * sizeof(int64_t));
+    BLOSC_ERROR_NULL(slab_lens, BLOSC2_ERROR_MEMORY_ALLOC);
+    arena->slab_lens = slab_lens;
+    arena->max_nslabs = max_nslabs;
+  }
+  uint8_t *slab = malloc(len);
+  BLOSC_ERROR_NULL(slab, BLOSC2_ERROR_MEMORY_ALLOC);
+  int64_t i = arena->nslabs;
+  while (i > 0 && (uintptr_t) arena->slabs[i - 1] > (uintptr_t) slab) {
+    arena->slabs[i] = arena->slabs[i - 1];
+    arena->slab_lens[i] = arena->slab_lens[i - 1];
+    i--;
+  }
+  arena->slabs[i] = slab;
+  arena->slab_lens[i] = len;
+  arena->nslabs++;
+  arena->current = slab;
+  arena->current_len = len;
+  arena->used = 0;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* A copy of the `cbytes` of `chunk` that the super-chunk owns, out of the arena if there is one */
+static uint8_t *copy_chunk(blosc2_schunk *schunk, const uint8_t *chunk, int32_t cbytes) {
+  chunk_arena *arena = (chunk_arena *) schunk->chunk_arena;
+  uint8_t *copy;
+  if (arena == NULL || arena->slab_size == 0 || schunk->frame != NULL) {
+    copy = malloc(cbytes);
+  }
+  else {
+    int64_t len = (cbytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    if (arena->current == NULL || arena->used + len > arena->current_len) {
+      // Chunks larger than the slabs get one of their own
+      if (arena_add_slab(arena, len > arena->slab_size ? len : arena->slab_size) < 0) {
+        return NULL;
       }
     }
-    free(chunk);
-    free(chunk2);
+    copy = arena->current + arena->used;
+    arena->used += len;
   }
-  else {
-    /* Fill an empty frame with special values (fast path). */
-    blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
-    /* Update counters (necessary for the frame_fill_special() logic) */
-    if (leftover_items) {
-      nchunks += 1;
+  if (copy != NULL) {
+    memcpy(copy, chunk, cbytes);
+  }
+  return copy;
+}
+
+
+/* Shrink a chunk that the super-chunk takes over to its `cbytes` (moving it to the arena
+ * if there is one) */
+static uint8_t *shrink_chunk(blosc2_schunk *schunk, uint8_t *chunk, int32_t cbytes) {
+  chunk_arena *arena = (chunk_arena *) schunk->chunk_arena;
+  if (arena == NULL || arena->slab_size == 0) {
+    return realloc(chunk, cbytes);
+  }
+  uint8_t *copy = copy_chunk(schunk, chunk, cbytes);
+  if (copy != NULL) {
+    free(chunk);
+  }
+  return copy;
+}
+
+
+/* The chunks of an in-memory super-chunk that live in buffers of the caller, sorted by
+ * address, along with the callbacks that hand them back */
+typedef struct {
+  uint8_t *chunk;
+  blosc2_release_cb release;
+  void *params;
+} borrowed_chunk;
+
+typedef struct {
+  borrowed_chunk *chunks;
+  int64_t nchunks;
+  int64_t max_nchunks;
+} borrowed_chunks;
+
+
+/* The position of `chunk` among the borrowed ones, or where it would go (negated, minus one) */
+static int64_t find_borrowed(borrowed_chunks *borrowed, const uint8_t *chunk) {
+  int64_t lo = 0;
+  int64_t hi = borrowed->nchunks;
+  while (lo < hi) {
+    int64_t mid = (lo + hi) / 2;
+    if ((uintptr_t) chunk < (uintptr_t) borrowed->chunks[mid].chunk) {
+      hi = mid;
     }
-    schunk->chunksize = chunksize;
-    schunk->nchunks = nchunks;
-    schunk->nbytes = nitems * typesize;
-    int64_t frame_len = frame_fill_special(frame, nitems, special_value, chunksize, schunk);
-    if (frame_len < 0) {
-      BLOSC_TRACE_ERROR("Error creating special frame.");
-      return frame_len;
+    else if ((uintptr_t) chunk > (uintptr_t) borrowed->chunks[mid].chunk) {
+      lo = mid + 1;
+    }
+    else {
+      return mid;
     }
   }
+  return -lo - 1;
+}
 
-  return schunk->nchunks;
+
+/* Hand a borrowed chunk back to its owner; false if `chunk` is not borrowed */
+static bool release_borrowed(blosc2_schunk *schunk, uint8_t *chunk) {
+  borrowed_chunks *borrowed = (borrowed_chunks *) schunk->borrowed_chunks;
+  if (borrowed == NULL) {
+    return false;
+  }
+  int64_t i = find_borrowed(borrowed, chunk);
+  if (i < 0) {
+    return false;
+  }
+  borrowed_chunk entry = borrowed->chunks[i];
+  memmove(borrowed->chunks + i, borrowed->chunks + i + 1, (borrowed->nchunks - i - 1) * sizeof(borrowed_chunk));
+  borrowed->nchunks--;
+  if (entry.release != NULL) {
+    entry.release(entry.chunk, entry.params);
+  }
+  return true;
 }
 
-/* Append an existing chunk into a super-chunk. */
-int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy) {
-  int32_t chunk_nbytes;
-  int32_t chunk_cbytes;
-  int64_t nchunks = schunk->nchunks;
 
-  int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
-  if (rc < 0) {
-    return rc;
+static void free_borrowed_chunks(blosc2_schunk *schunk) {
+  borrowed_chunks *borrowed = (borrowed_chunks *) schunk->borrowed_chunks;
+  if (borrowed == NULL) {
+    return;
   }
+  free(borrowed->chunks);
+  free(borrowed);
+  schunk->borrowed_chunks = NULL;
+}
 
-  if (schunk->chunksize == -1) {
-    schunk->chunksize = chunk_nbytes;  // The super-chunk is initialized now
+
+/* Free a chunk of an in-memory super-chunk (unless it is in the arena, or borrowed) */
+static void free_chunk(blosc2_schunk *schunk, uint8_t *chunk) {
+  if (release_borrowed(schunk, chunk)) {
+    return;
   }
-  if (chunk_nbytes > schunk->chunksize) {
-    BLOSC_TRACE_ERROR("Appending chunks that have different lengths in the same schunk "
-                      "is not supported yet: %d > %d.", chunk_nbytes, schunk->chunksize);
-    return BLOSC2_ERROR_CHUNK_APPEND;
+  chunk_arena *arena = (chunk_arena *) schunk->chunk_arena;
+  if (arena == NULL || !arena_owns(arena, chunk)) {
+    free(chunk);
   }
+}
 
-  /* Update counters */
-  schunk->current_nchunk = nchunks;
-  schunk->nchunks = nchunks + 1;
-  schunk->nbytes += chunk_nbytes;
-  if (schunk->frame == NULL) {
-    schunk->cbytes += chunk_cbytes;
-  } else {
-    // A frame
-    int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
-    switch (special_value) {
-      case BLOSC2_SPECIAL_ZERO:
-      case BLOSC2_SPECIAL_NAN:
-      case BLOSC2_SPECIAL_UNINIT:
-        schunk->cbytes += 0;
-        break;
-      default:
-        schunk->cbytes += chunk_cbytes;
+
+/* Make room for `nchunks` chunk pointers in an in-memory super-chunk */
+static int grow_data(blosc2_schunk *schunk, int64_t nchunks) {
+  if (nchunks * sizeof(void *) <= schunk->data_len) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // Grow geometrically, from one memory page (4k) on
+  size_t data_len = schunk->data_len >= 4096 ? schunk->data_len : 4096;
+  while (nchunks * sizeof(void *) > data_len) {
+    data_len *= 2;  // must be a multiple of sizeof(void*)
+  }
+  uint8_t **data = realloc(schunk->data, data_len);
+  BLOSC_ERROR_NULL(data, BLOSC2_ERROR_MEMORY_ALLOC);
+  schunk->data = data;
+  schunk->data_len = data_len;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_schunk_set_chunk_arena(blosc2_schunk *schunk, int32_t slab_size) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  if (slab_size < 0) {
+    BLOSC_TRACE_ERROR("The size of the slabs of the chunk arena cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  chunk_arena *arena = (chunk_arena *) schunk->chunk_arena;
+  if (slab_size == 0) {
+    if (arena != NULL) {
+      // The chunks in the slabs are still there
+      arena->slab_size = 0;
+      free(arena->scratch);
+      arena->scratch = NULL;
+      arena->scratch_len = 0;
     }
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (schunk->frame != NULL) {
+    BLOSC_TRACE_ERROR("The chunk arena is for super-chunks in memory without a frame.");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
+  if (arena == NULL) {
+    arena = calloc(1, sizeof(chunk_arena));
+    BLOSC_ERROR_NULL(arena, BLOSC2_ERROR_MEMORY_ALLOC);
+    schunk->chunk_arena = arena;
+  }
+  arena->slab_size = slab_size;
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  if (copy) {
-    // Make a copy of the chunk
-    uint8_t *chunk_copy = malloc(chunk_cbytes);
-    memcpy(chunk_copy, chunk, chunk_cbytes);
-    chunk = chunk_copy;
+
+/* Drop the cached copy of the chunk `nchunk` (of all of them if negative), the
+ * chunks read ahead and the ones of the point lookups, before the super-chunk is modified */
+static void schunk_invalidate_reads(blosc2_schunk *schunk, int64_t nchunk) {
+  schunk_cache_invalidate(schunk, nchunk);
+  xdelta_invalidate(schunk, nchunk);
+  if (schunk->frame != NULL) {
+    frame_prefetch_clear((blosc2_frame_s *) schunk->frame);
+    frame_item_cache_clear((blosc2_frame_s *) schunk->frame);
   }
+}
 
-  // Update super-chunk or frame
-  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
-  if (frame == NULL) {
-    // Check that we are not appending a small chunk after another small chunk
-    if ((schunk->nchunks > 1) && (chunk_nbytes < schunk->chunksize)) {
-      uint8_t* last_chunk = schunk->data[nchunks - 1];
-      int32_t last_nbytes;
-      rc = blosc2_cbuffer_sizes(last_chunk, &last_nbytes, NULL, NULL);
-      if (rc < 0) {
-        return rc;
+
+int schunk_cache_get_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **data) {
+  chunk_cache *cache = (chunk_cache *) schunk->chunk_cache;
+  if (cache == NULL || schunk->chunksize <= 0 || schunk->chunksize > cache->max_nbytes) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+
+  for (chunk_cache_entry *entry = cache->head; entry != NULL; entry = entry->next) {
+    if (entry->nchunk == nchunk) {
+      if (entry != cache->head) {
+        cache_unlink(cache, entry);
+        cache_push_front(cache, entry);
       }
-      if ((last_nbytes < schunk->chunksize) && (chunk_nbytes < schunk->chunksize)) {
-        BLOSC_TRACE_ERROR(
-                "Appending two consecutive chunks with a chunksize smaller than the schunk chunksize "
-                "is not allowed yet: %d != %d.", chunk_nbytes, schunk->chunksize);
-        return BLOSC2_ERROR_CHUNK_APPEND;
+      /* Give room to the ones that did not fit in the memory budget */
+      while (cache->tail != entry && membudget_over()) {
+        cache_evict(cache, cache->tail);
       }
+      cache->hits++;
+      *data = entry->data;
+      return entry->nbytes;
     }
+  }
 
-    if (!copy && (chunk_cbytes < chunk_nbytes)) {
-      // We still want to do a shrink of the chunk
-      chunk = realloc(chunk, chunk_cbytes);
+  cache->misses++;
+  /* Make room for the new entry, in the cache and in the memory budget; if it still
+   * does not fit, the chunk is just not cached */
+  while (cache->tail != NULL && cache->nbytes + schunk->chunksize > cache->max_nbytes) {
+    cache_evict(cache, cache->tail);
+  }
+  while (!membudget_charge(schunk->chunksize)) {
+    if (cache->tail == NULL) {
+      return BLOSC2_ERROR_NOT_FOUND;
     }
+    cache_evict(cache, cache->tail);
+  }
+  chunk_cache_entry *entry = calloc(1, sizeof(chunk_cache_entry));
+  if (entry != NULL) {
+    entry->data = malloc(schunk->chunksize);
+  }
+  if (entry == NULL || entry->data == NULL) {
+    free(entry);
+    membudget_release(schunk->chunksize);
+    BLOSC_TRACE_ERROR("Error allocating memory!");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  int nbytes = blosc2_schunk_decompress_chunk(schunk, nchunk, entry->data, schunk->chunksize);
+  if (nbytes < 0) {
+    free(entry->data);
+    free(entry);
+    membudget_release(schunk->chunksize);
+    return nbytes;
+  }
+  membudget_release(schunk->chunksize - nbytes);
+  entry->nchunk = nchunk;
+  entry->nbytes = nbytes;
+  cache_push_front(cache, entry);
+  cache->nbytes += nbytes;
+
+  *data = entry->data;
+  return nbytes;
+}
 
-    /* Make space for appending the copy of the chunk and do it */
-    if ((nchunks + 1) * sizeof(void *) > schunk->data_len) {
-      // Extend the data pointer by one memory page (4k)
-      schunk->data_len += 4096;  // must be a multiple of sizeof(void*)
-      schunk->data = realloc(schunk->data, schunk->data_len);
+
+int blosc2_schunk_set_chunk_cache(blosc2_schunk *schunk, int64_t max_nbytes) {
+  if (max_nbytes < 0) {
+    BLOSC_TRACE_ERROR("The size of the chunk cache cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  chunk_cache *cache = (chunk_cache *) schunk->chunk_cache;
+  if (max_nbytes == 0) {
+    if (cache != NULL) {
+      schunk_cache_invalidate(schunk, -1);
+      free(cache);
+      schunk->chunk_cache = NULL;
     }
-    schunk->data[nchunks] = chunk;
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  if (schunk->dctx_pool != NULL || schunk->cctx_pool != NULL) {
+    BLOSC_TRACE_ERROR("The chunk cache cannot be used with concurrent reads or writes.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (cache == NULL) {
+    cache = calloc(1, sizeof(chunk_cache));
+    BLOSC_ERROR_NULL(cache, BLOSC2_ERROR_MEMORY_ALLOC);
+    schunk->chunk_cache = cache;
+  }
+  cache->max_nbytes = max_nbytes;
+  while (cache->tail != NULL && cache->nbytes > cache->max_nbytes) {
+    cache_evict(cache, cache->tail);
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_schunk_get_chunk_cache_stats(blosc2_schunk *schunk, int64_t *hits, int64_t *misses,
+                                        int64_t *nbytes) {
+  chunk_cache *cache = (chunk_cache *) schunk->chunk_cache;
+  if (cache == NULL) {
+    BLOSC_TRACE_ERROR("The super-chunk has no chunk cache.");
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  if (hits != NULL) {
+    *hits = cache->hits;
+  }
+  if (misses != NULL) {
+    *misses = cache->misses;
+  }
+  if (nbytes != NULL) {
+    *nbytes = cache->nbytes;
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_schunk_set_prefetch(blosc2_schunk *schunk, int depth) {
+  if (depth < 0) {
+    BLOSC_TRACE_ERROR("The read-ahead depth cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (schunk->frame == NULL) {
+    // Chunks of schunks without a frame live in memory
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (depth > 0 && (schunk->dctx_pool != NULL || schunk->cctx_pool != NULL)) {
+    BLOSC_TRACE_ERROR("The read-ahead cannot be used with concurrent reads or writes.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  return frame_set_prefetch((blosc2_frame_s *) schunk->frame, depth);
+}
+
+
+/* A context of the pools of concurrent reads and writes, which is claimed with a CAS
+ * on `busy`.  The padding avoids false sharing between the threads of neighbouring contexts. */
+typedef struct {
+  volatile int64_t busy;
+  blosc2_context *ctx;
+  uint8_t pad[48];
+} ctx_slot;
+
+typedef struct {
+  int nslots;
+  ctx_slot *slots;
+  bool compress;
+} ctx_pool;
+
+
+/* A context like the ones of `schunk`, which keeps the chunk it is working on */
+static blosc2_context *create_pooled_ctx(blosc2_schunk *schunk, bool compress) {
+  blosc2_context *ctx;
+  if (compress) {
+    blosc2_cparams cparams;
+    blosc2_ctx_get_cparams(schunk->cctx, &cparams);
+    cparams.schunk = schunk;
+    // The stats and zone maps are recorded in vlmetalayers, which cannot be written concurrently
+    cparams.record_stats = false;
+    cparams.zonemap = BLOSC2_ZONEMAP_NONE;
+    ctx = blosc2_create_cctx(cparams);
   }
   else {
-    if (frame_append_chunk(frame, chunk, schunk) == NULL) {
-      BLOSC_TRACE_ERROR("Problems appending a chunk.");
-      return BLOSC2_ERROR_CHUNK_APPEND;
+    blosc2_dparams dparams;
+    blosc2_ctx_get_dparams(schunk->dctx, &dparams);
+    dparams.schunk = schunk;
+    ctx = blosc2_create_dctx(dparams);
+  }
+  if (ctx == NULL) {
+    BLOSC_TRACE_ERROR("Error while creating the %s context", compress ? "compression" : "decompression");
+    return NULL;
+  }
+  ctx->pooled = true;
+  ctx->nchunk = -1;
+  return ctx;
+}
+
+
+static void free_ctx_pool(void **pool_) {
+  ctx_pool *pool = (ctx_pool *) *pool_;
+  if (pool == NULL) {
+    return;
+  }
+  for (int i = 0; i < pool->nslots; i++) {
+    if (pool->slots[i].ctx != NULL) {
+      blosc2_free_ctx(pool->slots[i].ctx);
     }
   }
-  return schunk->nchunks;
+  free(pool->slots);
+  free(pool);
+  *pool_ = NULL;
 }
 
 
-/* Insert an existing @p chunk in a specified position on a super-chunk */
-int64_t blosc2_schunk_insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
-  int32_t chunk_nbytes;
-  int32_t chunk_cbytes;
-  int64_t nchunks = schunk->nchunks;
+static int new_ctx_pool(blosc2_schunk *schunk, int nctxs, bool compress, void **pool_) {
+  ctx_pool *pool = calloc(1, sizeof(ctx_pool));
+  BLOSC_ERROR_NULL(pool, BLOSC2_ERROR_MEMORY_ALLOC);
+  *pool_ = pool;
+  pool->compress = compress;
+  pool->slots = calloc(nctxs, sizeof(ctx_slot));
+  if (pool->slots == NULL) {
+    free_ctx_pool(pool_);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  pool->nslots = nctxs;
+  for (int i = 0; i < nctxs; i++) {
+    pool->slots[i].ctx = create_pooled_ctx(schunk, compress);
+    if (pool->slots[i].ctx == NULL) {
+      free_ctx_pool(pool_);
+      return BLOSC2_ERROR_FAILURE;
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
 
-  int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
+
+static blosc2_context *acquire_ctx(blosc2_schunk *schunk, ctx_pool *pool) {
+  for (int i = 0; i < pool->nslots; i++) {
+    int64_t expected = 0;
+    if (blosc_atomic_load64(&pool->slots[i].busy) == 0 &&
+        blosc_atomic_cas64(&pool->slots[i].busy, &expected, 1)) {
+      return pool->slots[i].ctx;
+    }
+  }
+  // All the contexts are in use, so the thread gets one of its own
+  return create_pooled_ctx(schunk, pool->compress);
+}
+
+
+static void release_ctx(ctx_pool *pool, blosc2_context *ctx) {
+  if (pool == NULL || ctx == NULL) {
+    return;
+  }
+  for (int i = 0; i < pool->nslots; i++) {
+    if (pool->slots[i].ctx == ctx) {
+      blosc_atomic_store64(&pool->slots[i].busy, 0);
+      return;
+    }
+  }
+  blosc2_free_ctx(ctx);
+}
+
+
+int blosc2_schunk_set_concurrent_reads(blosc2_schunk *schunk, int nctxs) {
+  if (nctxs < 0) {
+    BLOSC_TRACE_ERROR("The number of contexts for concurrent reads cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  free_ctx_pool(&schunk->dctx_pool);
+  if (frame != NULL) {
+    frame_set_concurrent_reads(frame, false);
+  }
+  if (nctxs == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  if (schunk->chunk_cache != NULL) {
+    BLOSC_TRACE_ERROR("Concurrent reads cannot be used with the chunk cache.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (schunk->cctx_pool != NULL) {
+    BLOSC_TRACE_ERROR("Concurrent reads cannot be used with concurrent writes.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (frame != NULL) {
+    int rc = frame_set_concurrent_reads(frame, true);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  int rc = new_ctx_pool(schunk, nctxs, false, &schunk->dctx_pool);
   if (rc < 0) {
+    blosc2_schunk_set_concurrent_reads(schunk, 0);
     return rc;
   }
 
-  if (schunk->chunksize == -1) {
-    schunk->chunksize = chunk_nbytes;  // The super-chunk is initialized now
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+blosc2_context *schunk_acquire_dctx(blosc2_schunk *schunk) {
+  if (schunk->dctx_pool == NULL) {
+    return schunk->dctx;
   }
+  return acquire_ctx(schunk, (ctx_pool *) schunk->dctx_pool);
+}
 
-  if (chunk_nbytes > schunk->chunksize) {
-    BLOSC_TRACE_ERROR("Inserting chunks that have different lengths in the same schunk "
-                      "is not supported yet: %d > %d.", chunk_nbytes, schunk->chunksize);
-    return BLOSC2_ERROR_CHUNK_INSERT;
+
+void schunk_release_dctx(blosc2_schunk *schunk, blosc2_context *dctx) {
+  release_ctx((ctx_pool *) schunk->dctx_pool, dctx);
+}
+
+
+/* The header of the zone maps vlmetalayer: the version, the kind and the typesize */
+#define ZONEMAP_HEADER_SIZE (1 + 1 + 1)
+
+/* The record of a chunk in the zone maps vlmetalayer is its number of blocks (-1 when the
+   chunk has no zone maps), followed by the zone map of the chunk and the ones of the blocks */
+static int32_t zonemap_record_len(int32_t nblocks) {
+  return nblocks < 0 ? 4 : 4 + (1 + nblocks) * ZONEMAP_SIZE;
+}
+
+static const uint8_t zonemap_unknown[4] = {0xff, 0xff, 0xff, 0xff};
+
+typedef struct {
+  uint8_t *content;  // NULL when there are no zone maps
+  int32_t content_len;
+  int kind;
+  int32_t typesize;
+  int64_t nrecords;
+  int32_t *starts;  // where every record starts, plus where the last one ends
+} zonemap_records;
+
+static void zonemap_records_free(zonemap_records *records) {
+  free(records->content);
+  free(records->starts);
+  memset(records, 0, sizeof(zonemap_records));
+}
+
+/* Get the zone maps vlmetalayer and index its records */
+static int zonemap_records_load(blosc2_schunk *schunk, zonemap_records *records) {
+  memset(records, 0, sizeof(zonemap_records));
+  if (blosc2_vlmeta_exists(schunk, ZONEMAP_VLMETA) < 0) {
+    return BLOSC2_ERROR_SUCCESS;
   }
+  int rc = blosc2_vlmeta_get(schunk, ZONEMAP_VLMETA, &records->content, &records->content_len);
+  if (rc < 0) {
+    return rc;
+  }
+  uint8_t *content = records->content;
+  int32_t content_len = records->content_len;
+  if (content_len < ZONEMAP_HEADER_SIZE || content[0] != ZONEMAP_VERSION ||
+      !zonemap_supported(content[1], content[2])) {
+    BLOSC_TRACE_ERROR("Unknown format of the zone maps.");
+    zonemap_records_free(records);
+    return BLOSC2_ERROR_DATA;
+  }
+  records->kind = content[1];
+  records->typesize = content[2];
 
-  /* Update counters */
-  schunk->current_nchunk = nchunk;
-  schunk->nchunks = nchunks + 1;
-  schunk->nbytes += chunk_nbytes;
-  if (schunk->frame == NULL) {
-    schunk->cbytes += chunk_cbytes;
-  } else {
-    // A frame
-    int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
-    switch (special_value) {
-      case BLOSC2_SPECIAL_ZERO:
-      case BLOSC2_SPECIAL_NAN:
-      case BLOSC2_SPECIAL_UNINIT:
-        schunk->cbytes += 0;
-        break;
-      default:
-        schunk->cbytes += chunk_cbytes;
+  // Every record takes 4 bytes at least
+  records->starts = malloc(((content_len - ZONEMAP_HEADER_SIZE) / 4 + 1) * sizeof(int32_t));
+  if (records->starts == NULL) {
+    zonemap_records_free(records);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  int32_t pos = ZONEMAP_HEADER_SIZE;
+  while (content_len - pos >= 4) {
+    int32_t nblocks = sw32_(content + pos);
+    if (nblocks >= 0 && (content_len - pos - 4) / ZONEMAP_SIZE < nblocks + 1) {
+      break;
+    }
+    records->starts[records->nrecords++] = pos;
+    pos += zonemap_record_len(nblocks);
+  }
+  if (pos != content_len) {
+    BLOSC_TRACE_ERROR("The zone maps are corrupted.");
+    zonemap_records_free(records);
+    return BLOSC2_ERROR_DATA;
+  }
+  records->starts[records->nrecords] = pos;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Replace the `nremoved` records from the one of `nchunk` on with `record` (which may be
+   empty), padding with unknown records up to `nchunk` */
+static int zonemap_splice(blosc2_schunk *schunk, int64_t nchunk, int64_t nremoved,
+                          const uint8_t *record, int32_t record_len) {
+  bool unknown = record_len == 0 || sw32_(record) < 0;
+  zonemap_records records;
+  int rc = zonemap_records_load(schunk, &records);
+  if (rc < 0) {
+    return rc;
+  }
+  if (records.content == NULL && unknown) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (records.content == NULL) {
+    records.kind = schunk->cctx->zonemap;
+    records.typesize = schunk->cctx->typesize;
+  }
+  else if (!unknown && (records.kind != schunk->cctx->zonemap || records.typesize != schunk->cctx->typesize)) {
+    BLOSC_TRACE_ERROR("The zone maps of the super-chunk are of another kind.");
+    zonemap_records_free(&records);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (nchunk >= records.nrecords && unknown) {
+    // The chunks beyond the records have no zone maps already
+    zonemap_records_free(&records);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  int32_t start, end;
+  int64_t npadding = 0;
+  if (nchunk < records.nrecords) {
+    start = records.starts[nchunk];
+    end = records.starts[nchunk + nremoved < records.nrecords ? nchunk + nremoved : records.nrecords];
+  }
+  else {
+    start = end = records.content == NULL ? ZONEMAP_HEADER_SIZE : records.content_len;
+    npadding = nchunk - records.nrecords;
+  }
+  int32_t tail_len = records.content == NULL ? 0 : records.content_len - end;
+  int64_t new_len = start + npadding * 4 + record_len + tail_len;
+  if (new_len > INT32_MAX) {
+    BLOSC_TRACE_ERROR("The zone maps do not fit in a vlmetalayer.");
+    zonemap_records_free(&records);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  uint8_t *content = malloc(new_len);
+  if (content == NULL) {
+    zonemap_records_free(&records);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  if (records.content == NULL) {
+    content[0] = ZONEMAP_VERSION;
+    content[1] = (uint8_t)records.kind;
+    content[2] = (uint8_t)records.typesize;
+  }
+  else {
+    memcpy(content, records.content, start);
+  }
+  uint8_t *p = content + start;
+  for (int64_t i = 0; i < npadding; i++) {
+    memcpy(p, zonemap_unknown, 4);
+    p += 4;
+  }
+  if (record_len > 0) {
+    memcpy(p, record, record_len);
+    p += record_len;
+  }
+  if (tail_len > 0) {
+    memcpy(p, records.content + end, tail_len);
+  }
+
+  if (records.content != NULL) {
+    rc = blosc2_vlmeta_update(schunk, ZONEMAP_VLMETA, content, (int32_t)new_len, NULL);
+  }
+  else {
+    rc = blosc2_vlmeta_add(schunk, ZONEMAP_VLMETA, content, (int32_t)new_len, NULL);
+  }
+  free(content);
+  zonemap_records_free(&records);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+/* Forget the zone maps of the chunk `nchunk` (when `nremoved` is 1), or make room for a
+   chunk without zone maps (when it is 0) */
+static int zonemap_invalidate(blosc2_schunk *schunk, int64_t nchunk, int64_t nremoved) {
+  return zonemap_splice(schunk, nchunk, nremoved, zonemap_unknown, sizeof(zonemap_unknown));
+}
+
+/* Reorder the zone maps along with the chunks (see blosc2_schunk_reorder_offsets()) */
+static int zonemap_reorder(blosc2_schunk *schunk, const int64_t *offsets_order) {
+  zonemap_records records;
+  int rc = zonemap_records_load(schunk, &records);
+  if (rc < 0 || records.content == NULL) {
+    return rc;
+  }
+  int64_t new_len = ZONEMAP_HEADER_SIZE;
+  for (int64_t i = 0; i < schunk->nchunks; i++) {
+    int64_t j = offsets_order[i];
+    new_len += j < records.nrecords ? records.starts[j + 1] - records.starts[j] : 4;
+  }
+  uint8_t *content = new_len > INT32_MAX ? NULL : malloc(new_len);
+  if (content == NULL) {
+    zonemap_records_free(&records);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  memcpy(content, records.content, ZONEMAP_HEADER_SIZE);
+  uint8_t *p = content + ZONEMAP_HEADER_SIZE;
+  for (int64_t i = 0; i < schunk->nchunks; i++) {
+    int64_t j = offsets_order[i];
+    if (j < records.nrecords) {
+      int32_t len = records.starts[j + 1] - records.starts[j];
+      memcpy(p, records.content + records.starts[j], len);
+      p += len;
+    }
+    else {
+      memcpy(p, zonemap_unknown, 4);
+      p += 4;
+    }
+  }
+  rc = blosc2_vlmeta_update(schunk, ZONEMAP_VLMETA, content, (int32_t)new_len, NULL);
+  free(content);
+  zonemap_records_free(&records);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+#define CHANGES_HEADER_SIZE (1 + 8)
+#define DELTA_HEADER_SIZE (1 + 8 + 8 + 8)
+
+/* Get the last sequence number and the ones of the chunks out of the changes vlmetalayer
+   (`seqs` is NULL when the changes of the super-chunk are not tracked) */
+static int changes_load(blosc2_schunk *schunk, int64_t *sequence, int64_t **seqs, int64_t *nseqs) {
+  *seqs = NULL;
+  *nseqs = 0;
+  *sequence = 0;
+  if (blosc2_vlmeta_exists(schunk, CHANGES_VLMETA) < 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t *content;
+  int32_t content_len;
+  int rc = blosc2_vlmeta_get(schunk, CHANGES_VLMETA, &content, &content_len);
+  if (rc < 0) {
+    return rc;
+  }
+  if (content_len < CHANGES_HEADER_SIZE || content[0] != CHANGES_VERSION ||
+      (content_len - CHANGES_HEADER_SIZE) % 8 != 0) {
+    BLOSC_TRACE_ERROR("Unknown format of the changes of the chunks.");
+    free(content);
+    return BLOSC2_ERROR_DATA;
+  }
+  from_big(sequence, content + 1, sizeof(int64_t));
+  *nseqs = (content_len - CHANGES_HEADER_SIZE) / 8;
+  // One more, so that it is never empty
+  *seqs = malloc((*nseqs + 1) * sizeof(int64_t));
+  if (*seqs == NULL) {
+    free(content);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  for (int64_t i = 0; i < *nseqs; i++) {
+    from_big(*seqs + i, content + CHANGES_HEADER_SIZE + i * 8, sizeof(int64_t));
+  }
+  free(content);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Write the sequence numbers of the chunks down, padding (or cutting) them to the chunks of
+   the super-chunk, which have changed with `sequence` when they were not known */
+static int changes_save(blosc2_schunk *schunk, int64_t sequence, const int64_t *seqs, int64_t nseqs) {
+  int64_t content_len = CHANGES_HEADER_SIZE + schunk->nchunks * 8;
+  if (content_len > INT32_MAX) {
+    BLOSC_TRACE_ERROR("The changes of the chunks do not fit in a vlmetalayer.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  uint8_t *content = malloc(content_len);
+  if (content == NULL) {
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  content[0] = CHANGES_VERSION;
+  to_big(content + 1, &sequence, sizeof(sequence));
+  for (int64_t i = 0; i < schunk->nchunks; i++) {
+    to_big(content + CHANGES_HEADER_SIZE + i * 8, i < nseqs ? seqs + i : &sequence, sizeof(int64_t));
+  }
+  int rc;
+  if (blosc2_vlmeta_exists(schunk, CHANGES_VLMETA) >= 0) {
+    rc = blosc2_vlmeta_update(schunk, CHANGES_VLMETA, content, (int32_t)content_len, NULL);
+  }
+  else {
+    rc = blosc2_vlmeta_add(schunk, CHANGES_VLMETA, content, (int32_t)content_len, NULL);
+  }
+  free(content);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+/* Give the next sequence number to the `ninserted` chunks that replace the `nremoved` ones
+   from `nchunk` on, and to the ones after them when they have moved */
+static int changes_record(blosc2_schunk *schunk, int64_t nchunk, int64_t nremoved, int64_t ninserted) {
+  int64_t sequence;
+  int64_t *seqs;
+  int64_t nseqs;
+  int rc = changes_load(schunk, &sequence, &seqs, &nseqs);
+  if (rc < 0 || seqs == NULL) {
+    return rc;
+  }
+  sequence++;
+  if (nremoved == ninserted) {
+    for (int64_t i = nchunk; i < nchunk + ninserted && i < nseqs; i++) {
+      seqs[i] = sequence;
+    }
+  }
+  else if (nchunk < nseqs) {
+    // The chunks that come after are at new positions, and they are sent again
+    nseqs = nchunk;
+  }
+  rc = changes_save(schunk, sequence, seqs, nseqs);
+  free(seqs);
+  return rc;
+}
+
+/* The chunks that move with a reordering (see blosc2_schunk_reorder_offsets()) have changed */
+static int changes_reorder(blosc2_schunk *schunk, const int64_t *offsets_order) {
+  int64_t sequence;
+  int64_t *seqs;
+  int64_t nseqs;
+  int rc = changes_load(schunk, &sequence, &seqs, &nseqs);
+  if (rc < 0 || seqs == NULL) {
+    return rc;
+  }
+  sequence++;
+  for (int64_t i = 0; i < nseqs; i++) {
+    if (offsets_order[i] != i) {
+      seqs[i] = sequence;
+    }
+  }
+  rc = changes_save(schunk, sequence, seqs, nseqs);
+  free(seqs);
+  return rc;
+}
+
+
+
+/* The header of the Bloom filters vlmetalayer: the version, the number of hashes, the
+   typesize and the length of the filters */
+#define BLOOM_HEADER_SIZE (1 + 1 + 4 + 4)
+
+typedef struct {
+  uint8_t *content;  // NULL when the keys of the chunks are not indexed
+  int32_t content_len;
+  int nhashes;
+  int32_t typesize;
+  int32_t filter_len;
+  int64_t nrecords;
+} bloom_index;
+
+static void bloom_index_free(bloom_index *index) {
+  free(index->content);
+  memset(index, 0, sizeof(bloom_index));
+}
+
+/* Every chunk has a record of the same length: whether it has a filter, and the filter */
+static int32_t bloom_record_len(const bloom_index *index) {
+  return 1 + index->filter_len;
+}
+
+/* Get the Bloom filters vlmetalayer and check its header */
+static int bloom_index_load(blosc2_schunk *schunk, bloom_index *index) {
+  memset(index, 0, sizeof(bloom_index));
+  if (blosc2_vlmeta_exists(schunk, BLOOM_VLMETA) < 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int rc = blosc2_vlmeta_get(schunk, BLOOM_VLMETA, &index->content, &index->content_len);
+  if (rc < 0) {
+    return rc;
+  }
+  uint8_t *content = index->content;
+  if (index->content_len >= BLOOM_HEADER_SIZE) {
+    index->nhashes = content[1];
+    index->typesize = sw32_(content + 2);
+    index->filter_len = sw32_(content + 6);
+  }
+  if (index->content_len < BLOOM_HEADER_SIZE || content[0] != BLOOM_VERSION || index->nhashes < 1 ||
+      index->typesize <= 0 || index->filter_len <= 0 ||
+      (index->content_len - BLOOM_HEADER_SIZE) % bloom_record_len(index) != 0) {
+    BLOSC_TRACE_ERROR("Unknown format of the Bloom filters.");
+    bloom_index_free(index);
+    return BLOSC2_ERROR_DATA;
+  }
+  index->nrecords = (index->content_len - BLOOM_HEADER_SIZE) / bloom_record_len(index);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* Fill the `record` (zeroed) of a chunk with the filter of the keys in the `nbytes` of `src`,
+   unless they are not the keys of the index */
+static void bloom_fill_record(const bloom_index *index, const uint8_t *src, int32_t nbytes,
+                              int32_t typesize, int special, uint8_t *record) {
+  if (typesize != index->typesize || nbytes % typesize != 0 ||
+      special == BLOSC2_SPECIAL_UNINIT || special == BLOSC2_SPECIAL_VIRTUAL) {
+    return;
+  }
+  record[0] = 1;
+  // The items of the other special chunks are all the same
+  int64_t nkeys = special == BLOSC2_NO_SPECIAL ? nbytes / typesize : (nbytes > 0);
+  bloom_add(record + 1, index->filter_len, index->nhashes, src, nkeys, typesize);
+}
+
+/* Replace the `nremoved` records from the one of `nchunk` on with the `ninserted` ones in
+   `records` (or as many chunks without a filter when it is NULL), padding with chunks
+   without a filter up to `nchunk` */
+static int bloom_index_splice(blosc2_schunk *schunk, const bloom_index *index, int64_t nchunk,
+                              int64_t nremoved, const uint8_t *records, int64_t ninserted) {
+  if (index->content == NULL || (nchunk >= index->nrecords && records == NULL)) {
+    // The chunks beyond the records have no filter already
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int64_t record_len = bloom_record_len(index);
+  int64_t start = nchunk < index->nrecords ? nchunk : index->nrecords;
+  int64_t end = nchunk + nremoved < index->nrecords ? nchunk + nremoved : index->nrecords;
+  int64_t npadding = nchunk - start;
+  int64_t new_nrecords = start + npadding + ninserted + index->nrecords - end;
+  int64_t new_len = BLOOM_HEADER_SIZE + new_nrecords * record_len;
+  if (new_len > INT32_MAX) {
+    BLOSC_TRACE_ERROR("The Bloom filters do not fit in a vlmetalayer.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  uint8_t *content = malloc(new_len);
+  if (content == NULL) {
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  uint8_t *p = content;
+  memcpy(p, index->content, BLOOM_HEADER_SIZE + start * record_len);
+  p += BLOOM_HEADER_SIZE + start * record_len;
+  memset(p, 0, npadding * record_len);
+  p += npadding * record_len;
+  if (records != NULL) {
+    memcpy(p, records, ninserted * record_len);
+  }
+  else {
+    memset(p, 0, ninserted * record_len);
+  }
+  p += ninserted * record_len;
+  memcpy(p, index->content + BLOOM_HEADER_SIZE + end * record_len, (index->nrecords - end) * record_len);
+
+  int rc = blosc2_vlmeta_update(schunk, BLOOM_VLMETA, content, (int32_t)new_len, NULL);
+  free(content);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+/* Replace the `nremoved` records from the one of `nchunk` on with `ninserted` chunks without
+   a filter */
+static int bloom_invalidate(blosc2_schunk *schunk, int64_t nchunk, int64_t nremoved, int64_t ninserted) {
+  bloom_index index;
+  int rc = bloom_index_load(schunk, &index);
+  if (rc < 0) {
+    return rc;
+  }
+  rc = bloom_index_splice(schunk, &index, nchunk, nremoved, NULL, ninserted);
+  bloom_index_free(&index);
+  return rc;
+}
+
+/* Reorder the Bloom filters along with the chunks (see blosc2_schunk_reorder_offsets()) */
+static int bloom_reorder(blosc2_schunk *schunk, const int64_t *offsets_order) {
+  bloom_index index;
+  int rc = bloom_index_load(schunk, &index);
+  if (rc < 0 || index.content == NULL) {
+    return rc;
+  }
+  int64_t record_len = bloom_record_len(&index);
+  int64_t new_len = BLOOM_HEADER_SIZE + schunk->nchunks * record_len;
+  uint8_t *content = new_len > INT32_MAX ? NULL : malloc(new_len);
+  if (content == NULL) {
+    bloom_index_free(&index);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  memcpy(content, index.content, BLOOM_HEADER_SIZE);
+  for (int64_t i = 0; i < schunk->nchunks; i++) {
+    int64_t j = offsets_order[i];
+    uint8_t *p = content + BLOOM_HEADER_SIZE + i * record_len;
+    if (j < index.nrecords) {
+      memcpy(p, index.content + BLOOM_HEADER_SIZE + j * record_len, record_len);
+    }
+    else {
+      memset(p, 0, record_len);
+    }
+  }
+  rc = blosc2_vlmeta_update(schunk, BLOOM_VLMETA, content, (int32_t)new_len, NULL);
+  free(content);
+  bloom_index_free(&index);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_schunk_set_concurrent_writes(blosc2_schunk *schunk, int nctxs) {
+  if (nctxs < 0) {
+    BLOSC_TRACE_ERROR("The number of contexts for concurrent writes cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (nctxs > 0) {
+    BLOSC_ERROR(check_no_xdelta(schunk));
+  }
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  if (nctxs == 0) {
+    if (schunk->cctx_pool == NULL) {
+      return BLOSC2_ERROR_SUCCESS;
+    }
+    free_ctx_pool(&schunk->cctx_pool);
+    // The offsets of the chunks are merged into the index of the frame now
+    return frame_set_concurrent_writes(frame, false);
+  }
+
+  if (frame == NULL || !frame->sframe) {
+    BLOSC_TRACE_ERROR("Concurrent writes are only supported in super-chunks on sparse frames.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (schunk->chunk_cache != NULL || schunk->dctx_pool != NULL) {
+    BLOSC_TRACE_ERROR("Concurrent writes cannot be used with the chunk cache or concurrent reads.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (blosc2_vlmeta_exists(schunk, CHANGES_VLMETA) >= 0) {
+    BLOSC_TRACE_ERROR("Concurrent writes cannot be used in super-chunks that track their changes.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (blosc2_vlmeta_exists(schunk, BLOOM_VLMETA) >= 0) {
+    BLOSC_TRACE_ERROR("Concurrent writes cannot be used in super-chunks with Bloom filters.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  // The zone maps cannot follow the updates of concurrent writers
+  int rc = zonemap_splice(schunk, 0, INT32_MAX, NULL, 0);
+  if (rc < 0) {
+    return rc;
+  }
+  free_ctx_pool(&schunk->cctx_pool);
+  rc = frame_set_concurrent_writes(frame, true);
+  if (rc < 0) {
+    return rc;
+  }
+  rc = new_ctx_pool(schunk, nctxs, true, &schunk->cctx_pool);
+  if (rc < 0) {
+    frame_set_concurrent_writes(frame, false);
+    return rc;
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Add the memory usage of a context to `usage` */
+static void add_ctx_memory(blosc2_context *ctx, blosc2_ctx_memory *usage) {
+  blosc2_ctx_memory ctx_usage;
+  if (ctx == NULL || blosc2_ctx_memory_usage(ctx, &ctx_usage) < 0) {
+    return;
+  }
+  usage->context += ctx_usage.context;
+  usage->scratch += ctx_usage.scratch;
+  usage->codecs += ctx_usage.codecs;
+  usage->dicts += ctx_usage.dicts;
+  usage->blocks += ctx_usage.blocks;
+  usage->total += ctx_usage.total;
+}
+
+static void add_ctx_pool_memory(void *pool_, blosc2_ctx_memory *usage) {
+  ctx_pool *pool = (ctx_pool *) pool_;
+  if (pool == NULL) {
+    return;
+  }
+  usage->context += (int64_t) sizeof(ctx_pool) + pool->nslots * (int64_t) sizeof(ctx_slot);
+  usage->total += (int64_t) sizeof(ctx_pool) + pool->nslots * (int64_t) sizeof(ctx_slot);
+  for (int i = 0; i < pool->nslots; i++) {
+    add_ctx_memory(pool->slots[i].ctx, usage);
+  }
+}
+
+static int64_t metalayer_memory(blosc2_metalayer *meta) {
+  if (meta == NULL) {
+    return 0;
+  }
+  int64_t nbytes = (int64_t) sizeof(blosc2_metalayer) + (int64_t) strlen(meta->name) + 1;
+  if (meta->content != NULL) {
+    nbytes += meta->content_len;
+  }
+  return nbytes;
+}
+
+
+int blosc2_schunk_memory_usage(blosc2_schunk *schunk, blosc2_schunk_memory *usage) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(usage, BLOSC2_ERROR_NULL_POINTER);
+  memset(usage, 0, sizeof(blosc2_schunk_memory));
+
+  usage->schunk = (int64_t) sizeof(blosc2_schunk);
+  blosc2_storage *storage = schunk->storage;
+  if (storage != NULL) {
+    usage->schunk += (int64_t) (sizeof(blosc2_storage) + sizeof(blosc2_cparams) + sizeof(blosc2_dparams) +
+                                sizeof(blosc2_io));
+    if (storage->urlpath != NULL) {
+      usage->schunk += (int64_t) strlen(storage->urlpath) + 1;
+    }
+  }
+  if (schunk->blockshape != NULL) {
+    usage->schunk += schunk->ndim * (int64_t) sizeof(int64_t);
+  }
+
+  add_ctx_memory(schunk->cctx, &usage->contexts);
+  add_ctx_memory(schunk->dctx, &usage->contexts);
+  add_ctx_pool_memory(schunk->dctx_pool, &usage->contexts);
+  add_ctx_pool_memory(schunk->cctx_pool, &usage->contexts);
+
+  /* The chunks of in-memory super-chunks are in the arena, or on their own but for the borrowed ones */
+  chunk_arena *arena = (chunk_arena *) schunk->chunk_arena;
+  borrowed_chunks *borrowed = (borrowed_chunks *) schunk->borrowed_chunks;
+  if (schunk->data != NULL) {
+    usage->chunks += (int64_t) schunk->data_len * (int64_t) sizeof(uint8_t *);
+    for (int64_t i = 0; i < schunk->nchunks; i++) {
+      uint8_t *chunk = schunk->data[i];
+      if (chunk == NULL || (arena != NULL && arena_owns(arena, chunk)) ||
+          (borrowed != NULL && find_borrowed(borrowed, chunk) >= 0)) {
+        continue;
+      }
+      int32_t cbytes;
+      if (blosc2_cbuffer_sizes(chunk, NULL, &cbytes, NULL) >= 0) {
+        usage->chunks += cbytes;
+      }
+    }
+  }
+  if (arena != NULL) {
+    usage->chunks += (int64_t) sizeof(chunk_arena) + arena->max_nslabs * (int64_t) (sizeof(uint8_t *) + sizeof(int64_t)) +
+                     arena->scratch_len;
+    for (int64_t i = 0; i < arena->nslabs; i++) {
+      usage->chunks += arena->slab_lens[i];
+    }
+  }
+  if (borrowed != NULL) {
+    usage->chunks += (int64_t) sizeof(borrowed_chunks) + borrowed->max_nchunks * (int64_t) sizeof(borrowed_chunk);
+  }
+  if (schunk->frame != NULL) {
+    int64_t buffer;
+    int64_t frame_caches;
+    frame_memory_usage((blosc2_frame_s *) schunk->frame, &buffer, &usage->frame, &frame_caches);
+    usage->chunks += buffer;
+    usage->caches += frame_caches;
+  }
+
+  for (int i = 0; i < schunk->nmetalayers; i++) {
+    usage->metalayers += metalayer_memory(schunk->metalayers[i]);
+  }
+  for (int i = 0; i < schunk->nvlmetalayers; i++) {
+    usage->metalayers += metalayer_memory(schunk->vlmetalayers[i]);
+  }
+  shared_dict *dict = (shared_dict *) schunk->shared_dict;
+  if (dict != NULL) {
+    usage->metalayers += (int64_t) sizeof(shared_dict) + dict->size;
+  }
+
+  chunk_cache *cache = (chunk_cache *) schunk->chunk_cache;
+  if (cache != NULL) {
+    usage->caches += (int64_t) sizeof(chunk_cache);
+    for (chunk_cache_entry *entry = cache->head; entry != NULL; entry = entry->next) {
+      // The entries have room for whole chunks, no matter their actual size
+      usage->caches += (int64_t) sizeof(chunk_cache_entry) + schunk->chunksize;
+    }
+  }
+  xdelta_state *xd = (xdelta_state *) schunk->xdelta;
+  if (xd != NULL) {
+    usage->caches += (int64_t) sizeof(xdelta_state) + xd->buffer_len + xd->tmp_len;
+  }
+
+  usage->total = usage->schunk + usage->contexts.total + usage->chunks + usage->frame + usage->metalayers +
+                 usage->caches;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Publish the appends as new versions of the frame on disk */
+int blosc2_schunk_set_versioned_commits(blosc2_schunk *schunk, bool enable) {
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  if (frame == NULL) {
+    if (enable) {
+      BLOSC_TRACE_ERROR("Versioned commits are only supported in super-chunks on contiguous frames on disk.");
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  return frame_set_versioned_commits(frame, enable);
+}
+
+
+/* Catch up with the versions published by another process */
+int64_t blosc2_schunk_refresh(blosc2_schunk *schunk) {
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  if (frame == NULL) {
+    BLOSC_TRACE_ERROR("Only super-chunks on contiguous frames on disk can be refreshed.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  return frame_refresh(frame);
+}
+
+
+/* The chunks cannot change under the readers of super-chunks read concurrently */
+static int check_no_concurrent_reads(blosc2_schunk *schunk) {
+  if (schunk->dctx_pool != NULL) {
+    BLOSC_TRACE_ERROR("The chunks of super-chunks with concurrent reads cannot be modified.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Super-chunks attached to shared memory or archives cannot change under the other readers */
+static int check_not_read_only(blosc2_schunk *schunk) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame != NULL && (frame->shm_len > 0 || frame->read_only)) {
+    BLOSC_TRACE_ERROR("Super-chunks in shared memory or archives are read-only.");
+    return BLOSC2_ERROR_READ_ONLY;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Only appends and updates keep the positions of the chunks of concurrent writers */
+static int check_no_concurrent_writes(blosc2_schunk *schunk) {
+  if (schunk->cctx_pool != NULL) {
+    BLOSC_TRACE_ERROR("Chunks can only be appended or updated in super-chunks with concurrent writes.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t blosc2_schunk_track_changes(blosc2_schunk *schunk) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(check_no_concurrent_writes(schunk));
+  int64_t sequence;
+  int64_t *seqs;
+  int64_t nseqs;
+  int rc = changes_load(schunk, &sequence, &seqs, &nseqs);
+  if (rc < 0) {
+    return rc;
+  }
+  if (seqs != NULL) {
+    free(seqs);
+    return sequence;
+  }
+  // The chunks that are there already are the ones of sequence 0
+  rc = changes_save(schunk, 0, NULL, 0);
+  return rc < 0 ? rc : 0;
+}
+
+
+int64_t blosc2_schunk_get_sequence(blosc2_schunk *schunk) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  int64_t sequence;
+  int64_t *seqs;
+  int64_t nseqs;
+  int rc = changes_load(schunk, &sequence, &seqs, &nseqs);
+  if (rc < 0) {
+    return rc;
+  }
+  if (seqs == NULL) {
+    BLOSC_TRACE_ERROR("The changes of the super-chunk are not tracked.");
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  free(seqs);
+  return sequence;
+}
+
+
+blosc2_schunk* blosc2_schunk_get_changes(blosc2_schunk *schunk, int64_t since) {
+  BLOSC_ERROR_NULL(schunk, NULL);
+  int64_t sequence;
+  int64_t *seqs;
+  int64_t nseqs;
+  if (changes_load(schunk, &sequence, &seqs, &nseqs) < 0) {
+    return NULL;
+  }
+  if (seqs == NULL) {
+    BLOSC_TRACE_ERROR("The changes of the super-chunk are not tracked.");
+    return NULL;
+  }
+  int64_t nchanged = 0;
+  for (int64_t i = 0; i < schunk->nchunks; i++) {
+    nchanged += i >= nseqs || seqs[i] > since;
+  }
+  int64_t content_len = DELTA_HEADER_SIZE + nchanged * 16;
+  uint8_t *content = content_len <= INT32_MAX ? malloc(content_len) : NULL;
+  if (content == NULL) {
+    BLOSC_TRACE_ERROR("The changes do not fit in a vlmetalayer.");
+    free(seqs);
+    return NULL;
+  }
+  content[0] = DELTA_VERSION;
+  to_big(content + 1, &since, sizeof(since));
+  to_big(content + 9, &sequence, sizeof(sequence));
+  to_big(content + 17, &schunk->nchunks, sizeof(schunk->nchunks));
+
+  // The changed chunks go as they are, in an in-memory frame
+  blosc2_cparams *cparams;
+  blosc2_schunk_get_cparams(schunk, &cparams);
+  cparams->schunk = NULL;
+  blosc2_storage storage = {.contiguous = true, .cparams = cparams};
+  blosc2_schunk *delta = blosc2_schunk_new(&storage);
+  free(cparams);
+  int64_t rc = delta != NULL ? 0 : BLOSC2_ERROR_FAILURE;
+  uint8_t *p = content + DELTA_HEADER_SIZE;
+  for (int64_t i = 0; i < schunk->nchunks && rc >= 0; i++) {
+    int64_t seq = i < nseqs ? seqs[i] : sequence;
+    if (seq <= since) {
+      continue;
+    }
+    uint8_t *chunk;
+    bool needs_free;
+    rc = blosc2_schunk_get_chunk(schunk, i, &chunk, &needs_free);
+    if (rc < 0) {
+      break;
+    }
+    rc = blosc2_schunk_append_chunk(delta, chunk, true);
+    if (needs_free) {
+      free(chunk);
+    }
+    to_big(p, &i, sizeof(i));
+    to_big(p + 8, &seq, sizeof(seq));
+    p += 16;
+  }
+  free(seqs);
+  if (rc >= 0) {
+    rc = blosc2_vlmeta_add(delta, DELTA_VLMETA, content, (int32_t)content_len, NULL);
+  }
+  free(content);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the changes of the super-chunk.");
+    if (delta != NULL) {
+      blosc2_schunk_free(delta);
+    }
+    return NULL;
+  }
+  return delta;
+}
+
+
+int64_t blosc2_schunk_apply_changes(blosc2_schunk *schunk, blosc2_schunk *delta) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(delta, BLOSC2_ERROR_NULL_POINTER);
+  uint8_t *content;
+  int32_t content_len;
+  int rc = blosc2_vlmeta_get(delta, DELTA_VLMETA, &content, &content_len);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("This is not a super-chunk of changes.");
+    return rc;
+  }
+  int64_t since;
+  int64_t sequence;
+  int64_t nchunks;
+  if (content_len >= DELTA_HEADER_SIZE) {
+    from_big(&since, content + 1, sizeof(since));
+    from_big(&sequence, content + 9, sizeof(sequence));
+    from_big(&nchunks, content + 17, sizeof(nchunks));
+  }
+  if (content_len < DELTA_HEADER_SIZE || content[0] != DELTA_VERSION ||
+      (content_len - DELTA_HEADER_SIZE) / 16 != delta->nchunks ||
+      (content_len - DELTA_HEADER_SIZE) % 16 != 0 || nchunks < 0) {
+    BLOSC_TRACE_ERROR("Unknown format of the changes.");
+    free(content);
+    return BLOSC2_ERROR_DATA;
+  }
+
+  int64_t replica_sequence;
+  int64_t *seqs;
+  int64_t nseqs;
+  rc = changes_load(schunk, &replica_sequence, &seqs, &nseqs);
+  if (rc < 0 || seqs == NULL) {
+    BLOSC_TRACE_ERROR("The changes of the super-chunk are not tracked.");
+    free(content);
+    return rc < 0 ? rc : BLOSC2_ERROR_NOT_FOUND;
+  }
+  free(seqs);
+  if (replica_sequence >= sequence) {
+    // The changes are there already
+    free(content);
+    return 0;
+  }
+  if (replica_sequence < since) {
+    BLOSC_TRACE_ERROR("The super-chunk misses the changes before the ones to apply.");
+    free(content);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  // The chunks that are gone, and then the changed ones (the new ones are the last)
+  int64_t rc_ = 0;
+  while (schunk->nchunks > nchunks && rc_ >= 0) {
+    rc_ = blosc2_schunk_delete_chunk(schunk, schunk->nchunks - 1);
+  }
+  const uint8_t *p = content + DELTA_HEADER_SIZE;
+  for (int64_t i = 0; i < delta->nchunks && rc_ >= 0; i++, p += 16) {
+    int64_t nchunk;
+    from_big(&nchunk, p, sizeof(nchunk));
+    uint8_t *chunk;
+    bool needs_free;
+    rc_ = blosc2_schunk_get_chunk(delta, i, &chunk, &needs_free);
+    if (rc_ < 0) {
+      break;
+    }
+    if (nchunk < schunk->nchunks) {
+      rc_ = blosc2_schunk_update_chunk(schunk, nchunk, chunk, true);
+    }
+    else if (nchunk == schunk->nchunks && nchunk < nchunks) {
+      rc_ = blosc2_schunk_append_chunk(schunk, chunk, true);
+    }
+    else {
+      BLOSC_TRACE_ERROR("Wrong position of a changed chunk.");
+      rc_ = BLOSC2_ERROR_DATA;
+    }
+    if (needs_free) {
+      free(chunk);
+    }
+  }
+  if (rc_ >= 0 && schunk->nchunks != nchunks) {
+    BLOSC_TRACE_ERROR("The changes miss some chunks.");
+    rc_ = BLOSC2_ERROR_DATA;
+  }
+
+  // The chunks keep the sequence numbers of the ones of the source
+  if (rc_ >= 0) {
+    rc_ = changes_load(schunk, &replica_sequence, &seqs, &nseqs);
+  }
+  if (rc_ >= 0) {
+    p = content + DELTA_HEADER_SIZE;
+    for (int64_t i = 0; i < delta->nchunks; i++, p += 16) {
+      int64_t nchunk;
+      from_big(&nchunk, p, sizeof(nchunk));
+      from_big(seqs + nchunk, p + 8, sizeof(int64_t));
+    }
+    rc_ = changes_save(schunk, sequence, seqs, nseqs);
+    free(seqs);
+  }
+  free(content);
+  return rc_ < 0 ? rc_ : delta->nchunks;
+}
+
+
+
+static void tiering_note_read(blosc2_schunk *schunk, int64_t nchunk);
+static void tiering_on_append(blosc2_schunk *schunk);
+static int64_t stop_tiering(blosc2_schunk *schunk, bool swap);
+
+/* Keep track of the chunk being accessed, for the postfilters of the dctx of the
+ * super-chunk (the contexts of concurrent reads keep it on their own) */
+static void set_current_nchunk(blosc2_schunk *schunk, int64_t nchunk) {
+  tiering_note_read(schunk, nchunk);
+  if (schunk->dctx_pool != NULL) {
+    return;
+  }
+  if (schunk->dctx->threads_started > 1) {
+    pthread_mutex_lock(&schunk->dctx->nchunk_mutex);
+    schunk->current_nchunk = nchunk;
+    pthread_mutex_unlock(&schunk->dctx->nchunk_mutex);
+  }
+  else {
+    schunk->current_nchunk = nchunk;
+  }
+}
+
+
+/* The id of a shared dictionary (the FNV-1a hash of its bytes), which is always positive */
+static int32_t get_shared_dict_id(const uint8_t *dict, int32_t size) {
+  uint32_t hash = 2166136261u;
+  for (int32_t i = 0; i < size; i++) {
+    hash = (hash ^ dict[i]) * 16777619u;
+  }
+  int32_t id = (int32_t) (hash & 0x7FFFFFFFu);
+  return id == 0 ? 1 : id;
+}
+
+
+static void free_shared_dict(blosc2_schunk *schunk) {
+  shared_dict *dict = (shared_dict *) schunk->shared_dict;
+  if (dict != NULL) {
+    free(dict->buffer);
+    free(dict);
+    schunk->shared_dict = NULL;
+  }
+}
+
+
+/* Set the shared dictionary of a super-chunk out of the content of its vlmetalayer */
+static int set_shared_dict(blosc2_schunk *schunk, const uint8_t *content, int32_t content_len) {
+  int32_t id = content_len > (int32_t) sizeof(int32_t) ? sw32_(content) : 0;
+  int32_t size = content_len - (int32_t) sizeof(int32_t);
+  if (id <= 0 || size > BLOSC2_MAXDICTSIZE) {
+    BLOSC_TRACE_ERROR("The shared dictionary is corrupted.");
+    return BLOSC2_ERROR_DATA;
+  }
+  shared_dict *dict = malloc(sizeof(shared_dict));
+  BLOSC_ERROR_NULL(dict, BLOSC2_ERROR_MEMORY_ALLOC);
+  dict->buffer = malloc(size);
+  if (dict->buffer == NULL) {
+    free(dict);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  memcpy(dict->buffer, content + sizeof(int32_t), size);
+  dict->id = id;
+  dict->size = size;
+  free_shared_dict(schunk);
+  schunk->shared_dict = dict;
+
+  // New chunks reference the dictionary too
+  schunk->storage->cparams->use_dict = 1;
+  schunk->cctx->use_dict = 1;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int schunk_load_shared_dict(blosc2_schunk *schunk) {
+  if (blosc2_vlmeta_exists(schunk, SHARED_DICT_VLMETA) < 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t *content;
+  int32_t content_len;
+  int rc = blosc2_vlmeta_get(schunk, SHARED_DICT_VLMETA, &content, &content_len);
+  if (rc < 0) {
+    return rc;
+  }
+  rc = set_shared_dict(schunk, content, content_len);
+  free(content);
+  return rc;
+}
+
+
+/* The size of the record of a chunk in the stats vlmetalayer, before the ones of its blocks */
+#define STATS_CHUNK_SIZE (8 + 4 + 4 + 4 + 1 + 1 + BLOSC2_MAX_FILTERS + 1 + 4)
+#define STATS_BLOCK_SIZE (2 + 1)
+
+/* The compression ratios of the blocks are kept as 1/256 steps of their log2,
+   and the entropies as 1/255 steps of the 8 bits of a byte */
+static uint16_t quantize_cratio(double cratio) {
+  double q = round(log2(cratio) * 256) + 32768;
+  return (uint16_t)(q < 0 ? 0 : q > UINT16_MAX ? UINT16_MAX : q);
+}
+
+static float unquantize_cratio(uint16_t q) {
+  return (float)exp2(((int)q - 32768) / 256.);
+}
+
+static uint8_t quantize_entropy(double entropy) {
+  double q = round(entropy * 255 / 8);
+  return (uint8_t)(q < 0 ? 0 : q > UINT8_MAX ? UINT8_MAX : q);
+}
+
+static float unquantize_entropy(uint8_t q) {
+  return (float)(q * 8 / 255.);
+}
+
+
+/* Append the stats of the chunk that `schunk->cctx` just compressed out of `src` to the
+   stats vlmetalayer */
+static int schunk_record_stats(blosc2_schunk *schunk, int64_t nchunk, const uint8_t *src,
+                               const uint8_t *chunk, double ctime) {
+  blosc2_context *cctx = schunk->cctx;
+  int32_t nbytes, cbytes, blocksize;
+  int rc = blosc2_cbuffer_sizes(chunk, &nbytes, &cbytes, &blocksize);
+  if (rc < 0) {
+    return rc;
+  }
+  bool special = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  bool memcpyed = chunk[BLOSC2_CHUNK_FLAGS] & (uint8_t)BLOSC_MEMCPYED;
+  int32_t nblocks = 0;
+  if (!special && nbytes > 0) {
+    nblocks = nbytes / blocksize + (nbytes % blocksize > 0);
+  }
+
+  uint8_t *content = NULL;
+  int32_t content_len = 0;
+  bool exists = blosc2_vlmeta_exists(schunk, STATS_VLMETA) >= 0;
+  if (exists) {
+    rc = blosc2_vlmeta_get(schunk, STATS_VLMETA, &content, &content_len);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  int32_t record_len = STATS_CHUNK_SIZE + nblocks * STATS_BLOCK_SIZE;
+  int32_t new_len = (exists ? content_len : 1) + record_len;
+  uint8_t *new_content = realloc(content, new_len);
+  if (new_content == NULL) {
+    free(content);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  content = new_content;
+  if (!exists) {
+    content[0] = STATS_VERSION;
+    content_len = 1;
+  }
+
+  uint8_t *p = content + content_len;
+  float ctime_ = (float)ctime;
+  to_big(p, &nchunk, sizeof(nchunk));
+  _sw32(p + 8, nbytes);
+  _sw32(p + 12, cbytes);
+  to_big(p + 16, &ctime_, sizeof(ctime_));
+  p[20] = (uint8_t)cctx->compcode;
+  p[21] = memcpyed ? 0 : (uint8_t)cctx->clevel;
+  memcpy(p + 22, cctx->filters, BLOSC2_MAX_FILTERS);
+  p[22 + BLOSC2_MAX_FILTERS] = (chunk[BLOSC2_CHUNK_FLAGS] & 0x10) ? 0 : 1;
+  _sw32(p + 23 + BLOSC2_MAX_FILTERS, nblocks);
+  p += STATS_CHUNK_SIZE;
+  for (int32_t i = 0; i < nblocks; i++) {
+    int32_t bsize = (i == nblocks - 1 && nbytes % blocksize > 0) ? nbytes % blocksize : blocksize;
+    int32_t csize = (memcpyed || cctx->block_csizes == NULL) ? bsize : cctx->block_csizes[i];
+    uint16_t cratio = quantize_cratio(csize > 0 ? (double)bsize / csize : 1.);
+    to_big(p, &cratio, sizeof(cratio));
+    p[2] = quantize_entropy(stune_sampled_entropy(src + (int64_t)i * blocksize, bsize));
+    p += STATS_BLOCK_SIZE;
+  }
+
+  if (exists) {
+    rc = blosc2_vlmeta_update(schunk, STATS_VLMETA, content, new_len, NULL);
+  }
+  else {
+    rc = blosc2_vlmeta_add(schunk, STATS_VLMETA, content, new_len, NULL);
+  }
+  free(content);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t blosc2_schunk_get_recorded_stats(blosc2_schunk *schunk, blosc2_chunk_stats **chunks,
+                                         blosc2_block_stats **blocks) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(chunks, BLOSC2_ERROR_NULL_POINTER);
+  *chunks = NULL;
+  if (blocks != NULL) {
+    *blocks = NULL;
+  }
+  if (blosc2_vlmeta_exists(schunk, STATS_VLMETA) < 0) {
+    return 0;
+  }
+  uint8_t *content;
+  int32_t content_len;
+  int rc = blosc2_vlmeta_get(schunk, STATS_VLMETA, &content, &content_len);
+  if (rc < 0) {
+    return rc;
+  }
+  if (content_len < 1 || content[0] != STATS_VERSION) {
+    BLOSC_TRACE_ERROR("Unknown format of the recorded stats.");
+    free(content);
+    return BLOSC2_ERROR_DATA;
+  }
+
+  // Count the records first
+  int64_t nchunks = 0;
+  int64_t nblocks = 0;
+  int32_t pos = 1;
+  while (pos < content_len) {
+    if (content_len - pos < STATS_CHUNK_SIZE) {
+      break;
+    }
+    int32_t chunk_nblocks = sw32_(content + pos + 23 + BLOSC2_MAX_FILTERS);
+    if (chunk_nblocks < 0 || (content_len - pos - STATS_CHUNK_SIZE) / STATS_BLOCK_SIZE < chunk_nblocks) {
+      break;
+    }
+    pos += STATS_CHUNK_SIZE + chunk_nblocks * STATS_BLOCK_SIZE;
+    nchunks++;
+    nblocks += chunk_nblocks;
+  }
+  if (pos != content_len) {
+    BLOSC_TRACE_ERROR("The recorded stats are corrupted.");
+    free(content);
+    return BLOSC2_ERROR_DATA;
+  }
+
+  blosc2_chunk_stats *chunks_ = malloc(nchunks * sizeof(blosc2_chunk_stats) + 1);
+  blosc2_block_stats *blocks_ = malloc(nblocks * sizeof(blosc2_block_stats) + 1);
+  if (chunks_ == NULL || blocks_ == NULL) {
+    free(chunks_);
+    free(blocks_);
+    free(content);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  const uint8_t *p = content + 1;
+  blosc2_block_stats *block = blocks_;
+  for (int64_t i = 0; i < nchunks; i++) {
+    blosc2_chunk_stats *chunk = &chunks_[i];
+    from_big(&chunk->nchunk, p, sizeof(chunk->nchunk));
+    chunk->nbytes = sw32_(p + 8);
+    chunk->cbytes = sw32_(p + 12);
+    from_big(&chunk->ctime, p + 16, sizeof(chunk->ctime));
+    chunk->compcode = p[20];
+    chunk->clevel = p[21];
+    memcpy(chunk->filters, p + 22, BLOSC2_MAX_FILTERS);
+    chunk->splitmode = p[22 + BLOSC2_MAX_FILTERS] ? BLOSC_ALWAYS_SPLIT : BLOSC_NEVER_SPLIT;
+    chunk->nblocks = sw32_(p + 23 + BLOSC2_MAX_FILTERS);
+    p += STATS_CHUNK_SIZE;
+    double entropy = 0;
+    for (int32_t j = 0; j < chunk->nblocks; j++) {
+      uint16_t cratio;
+      from_big(&cratio, p, sizeof(cratio));
+      block->cratio = unquantize_cratio(cratio);
+      block->entropy = unquantize_entropy(p[2]);
+      entropy += block->entropy;
+      block++;
+      p += STATS_BLOCK_SIZE;
+    }
+    chunk->entropy = chunk->nblocks > 0 ? (float)(entropy / chunk->nblocks) : 0.f;
+  }
+  free(content);
+
+  *chunks = chunks_;
+  if (blocks != NULL) {
+    *blocks = blocks_;
+  }
+  else {
+    free(blocks_);
+  }
+  return nchunks;
+}
+
+
+int schunk_load_zonemap(blosc2_schunk *schunk) {
+  zonemap_records records;
+  int rc = zonemap_records_load(schunk, &records);
+  if (rc < 0) {
+    return rc;
+  }
+  if (records.content != NULL && records.typesize == schunk->cctx->typesize) {
+    schunk->cctx->zonemap = records.kind;
+  }
+  zonemap_records_free(&records);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Record the zone maps of the chunk that `schunk->cctx` just compressed out of `src` */
+static int schunk_record_zonemap(blosc2_schunk *schunk, int64_t nchunk, const uint8_t *src,
+                                 const uint8_t *chunk) {
+  blosc2_context *cctx = schunk->cctx;
+  int32_t nbytes, blocksize;
+  int rc = blosc2_cbuffer_sizes(chunk, &nbytes, NULL, &blocksize);
+  if (rc < 0) {
+    return rc;
+  }
+  int32_t typesize = cctx->typesize;
+  int special = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  bool known = nbytes % typesize == 0;
+  if (special == BLOSC2_SPECIAL_UNINIT || special == BLOSC2_SPECIAL_VIRTUAL) {
+    known = false;
+  }
+  else if (special == BLOSC2_NO_SPECIAL && cctx->block_zonemaps == NULL) {
+    // The blocks of prefilters are not summarized
+    known = false;
+  }
+  if (!known) {
+    return zonemap_splice(schunk, nchunk, 1, zonemap_unknown, sizeof(zonemap_unknown));
+  }
+
+  int32_t nblocks = 0;
+  if (special == BLOSC2_NO_SPECIAL && nbytes > 0) {
+    nblocks = nbytes / blocksize + (nbytes % blocksize > 0);
+  }
+  int32_t record_len = zonemap_record_len(nblocks);
+  uint8_t *record = malloc(record_len);
+  if (record == NULL) {
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  _sw32(record, nblocks);
+  blosc2_zonemap zonemap;
+  if (special != BLOSC2_NO_SPECIAL) {
+    // A run of the first item
+    zonemap_compute(cctx->zonemap, typesize, src, nbytes > 0 ? typesize : 0, &zonemap);
+    zonemap.nitems = nbytes / typesize;
+    zonemap.nnans = zonemap.nnans > 0 ? zonemap.nitems : 0;
+  }
+  else {
+    zonemap_compute(cctx->zonemap, typesize, src, 0, &zonemap);
+    for (int32_t i = 0; i < nblocks; i++) {
+      zonemap_merge(cctx->zonemap, &zonemap, &cctx->block_zonemaps[i]);
+      zonemap_serialize(&cctx->block_zonemaps[i], record + 4 + (1 + i) * ZONEMAP_SIZE);
+    }
+  }
+  zonemap_serialize(&zonemap, record + 4);
+
+  rc = zonemap_splice(schunk, nchunk, 1, record, record_len);
+  free(record);
+  return rc;
+}
+
+
+/* Record the Bloom filter of the keys of the chunk `nchunk`, which has been compressed out of
+   the `nbytes` of `src`, if the keys of the super-chunk are indexed */
+static int schunk_record_bloom(blosc2_schunk *schunk, int64_t nchunk, const void *src, int32_t nbytes,
+                               int special) {
+  bloom_index index;
+  int rc = bloom_index_load(schunk, &index);
+  if (rc < 0 || index.content == NULL) {
+    return rc;
+  }
+  uint8_t *record = calloc(1, bloom_record_len(&index));
+  if (record == NULL) {
+    bloom_index_free(&index);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  bloom_fill_record(&index, src, nbytes, schunk->cctx->typesize, special, record);
+  rc = bloom_index_splice(schunk, &index, nchunk, 1, record, 1);
+  free(record);
+  bloom_index_free(&index);
+  return rc;
+}
+
+
+int blosc2_schunk_set_bloom(blosc2_schunk *schunk, int32_t nkeys, int bits_per_key) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(check_no_concurrent_writes(schunk));
+  if (bits_per_key <= 0) {
+    if (blosc2_vlmeta_exists(schunk, BLOOM_VLMETA) < 0) {
+      return BLOSC2_ERROR_SUCCESS;
+    }
+    int rc = blosc2_vlmeta_delete(schunk, BLOOM_VLMETA);
+    return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+  }
+  if (schunk->cctx != NULL && schunk->cctx->cipher != BLOSC2_CIPHER_NONE) {
+    BLOSC_TRACE_ERROR("The filters would leak the items of the encrypted chunks.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int32_t typesize = schunk->typesize;
+  if (nkeys <= 0) {
+    if (schunk->chunksize <= 0) {
+      BLOSC_TRACE_ERROR("The number of keys of the chunks is needed until the super-chunk has chunks.");
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    nkeys = schunk->chunksize / typesize;
+  }
+  int64_t filter_len = ((int64_t)nkeys * bits_per_key + 7) / 8;
+  if (filter_len >= INT32_MAX) {
+    BLOSC_TRACE_ERROR("The Bloom filters of %d keys with %d bits each are too large.", nkeys, bits_per_key);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  bloom_index index;
+  BLOSC_ERROR(bloom_index_load(schunk, &index));
+  bool exists = index.content != NULL;
+  bool same = exists && index.nhashes == bloom_nhashes(bits_per_key) && index.typesize == typesize &&
+              index.filter_len == filter_len;
+  bloom_index_free(&index);
+  if (same) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  // The chunks that are there already are indexed now
+  index.nhashes = bloom_nhashes(bits_per_key);
+  index.typesize = typesize;
+  index.filter_len = (int32_t)filter_len;
+  int64_t record_len = bloom_record_len(&index);
+  int64_t content_len = BLOOM_HEADER_SIZE + schunk->nchunks * record_len;
+  if (content_len > INT32_MAX) {
+    BLOSC_TRACE_ERROR("The Bloom filters do not fit in a vlmetalayer.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  uint8_t *content = calloc(1, content_len);
+  uint8_t *buffer = schunk->nchunks > 0 ? malloc(schunk->chunksize) : NULL;
+  if (content == NULL || (schunk->nchunks > 0 && buffer == NULL)) {
+    free(content);
+    free(buffer);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  content[0] = BLOOM_VERSION;
+  content[1] = (uint8_t)index.nhashes;
+  _sw32(content + 2, typesize);
+  _sw32(content + 6, index.filter_len);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    uint8_t *chunk;
+    bool needs_free;
+    rc = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
+    if (rc < 0) {
+      break;
+    }
+    int special = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+    if (schunk->xdelta != NULL && special != BLOSC2_SPECIAL_UNINIT && special != BLOSC2_SPECIAL_VIRTUAL) {
+      // The special chunks hold deltas
+      special = BLOSC2_NO_SPECIAL;
+    }
+    int32_t chunk_typesize = chunk[BLOSC2_CHUNK_TYPESIZE];
+    if (needs_free) {
+      free(chunk);
+    }
+    int32_t nbytes = 0;
+    if (special != BLOSC2_SPECIAL_UNINIT && special != BLOSC2_SPECIAL_VIRTUAL) {
+      nbytes = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, schunk->chunksize);
+      if (nbytes < 0) {
+        rc = nbytes;
+        break;
+      }
+    }
+    bloom_fill_record(&index, buffer, nbytes, chunk_typesize, special,
+                      content + BLOOM_HEADER_SIZE + nchunk * record_len);
+  }
+  free(buffer);
+  if (rc >= 0) {
+    if (exists) {
+      rc = blosc2_vlmeta_update(schunk, BLOOM_VLMETA, content, (int32_t)content_len, NULL);
+    }
+    else {
+      rc = blosc2_vlmeta_add(schunk, BLOOM_VLMETA, content, (int32_t)content_len, NULL);
+    }
+  }
+  free(content);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t blosc2_schunk_bloom_lookup(blosc2_schunk *schunk, const void *key, int64_t **nchunks) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(key, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(nchunks, BLOSC2_ERROR_NULL_POINTER);
+  bloom_index index;
+  BLOSC_ERROR(bloom_index_load(schunk, &index));
+  if (index.content == NULL) {
+    BLOSC_TRACE_ERROR("The keys of the super-chunk are not indexed.");
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  // One more, so that it is never empty
+  *nchunks = malloc((schunk->nchunks + 1) * sizeof(int64_t));
+  if (*nchunks == NULL) {
+    bloom_index_free(&index);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  int32_t record_len = bloom_record_len(&index);
+  int64_t ncandidates = 0;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    // The chunks without a filter may have any key
+    const uint8_t *record = index.content + BLOOM_HEADER_SIZE + nchunk * record_len;
+    if (nchunk >= index.nrecords || record[0] == 0 ||
+        bloom_may_contain(record + 1, index.filter_len, index.nhashes, key, index.typesize)) {
+      (*nchunks)[ncandidates++] = nchunk;
+    }
+  }
+  bloom_index_free(&index);
+  return ncandidates;
+}
+
+
+int blosc2_schunk_get_zonemap(blosc2_schunk *schunk, int64_t nchunk, blosc2_zonemap *chunk,
+                              blosc2_zonemap **blocks) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  if (blocks != NULL) {
+    *blocks = NULL;
+  }
+  if (nchunk < 0 || nchunk >= schunk->nchunks) {
+    BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the number of chunks "
+                      "('%" PRId64 "') in the super-chunk.", nchunk, schunk->nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  zonemap_records records;
+  int rc = zonemap_records_load(schunk, &records);
+  if (rc < 0) {
+    return rc;
+  }
+  const uint8_t *p = records.content + (nchunk < records.nrecords ? records.starts[nchunk] : 0);
+  if (records.content == NULL || nchunk >= records.nrecords || sw32_(p) < 0) {
+    zonemap_records_free(&records);
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  int32_t nblocks = sw32_(p);
+  if (chunk != NULL) {
+    zonemap_deserialize(chunk, p + 4);
+  }
+  if (blocks != NULL) {
+    *blocks = malloc(nblocks * sizeof(blosc2_zonemap) + 1);
+    if (*blocks == NULL) {
+      zonemap_records_free(&records);
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    for (int32_t i = 0; i < nblocks; i++) {
+      zonemap_deserialize(&(*blocks)[i], p + 4 + (1 + i) * ZONEMAP_SIZE);
+    }
+  }
+  zonemap_records_free(&records);
+  return nblocks;
+}
+
+
+/* Mask out the blocks of the chunk `nchunk` that have no values within [low, high], as told
+   by its record in `records` */
+static int zonemap_records_maskout(const zonemap_records *records, int64_t nchunk,
+                                   const blosc2_zonemap_value *low, const blosc2_zonemap_value *high,
+                                   bool *maskout, int nblocks) {
+  if (records->content == NULL || nchunk >= records->nrecords) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  const uint8_t *p = records->content + records->starts[nchunk];
+  int32_t nblocks_ = sw32_(p);
+  if (nblocks_ < 0) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  if (nblocks_ > 0 && nblocks_ != nblocks) {
+    BLOSC_TRACE_ERROR("The chunk has %d blocks, not %d.", nblocks_, nblocks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  blosc2_zonemap zonemap;
+  zonemap_deserialize(&zonemap, p + 4);
+  // The blocks of special chunks are all like the chunk
+  bool chunk_out = !zonemap_overlaps(records->kind, &zonemap, low, high);
+  int nmasked = 0;
+  for (int i = 0; i < nblocks; i++) {
+    bool out = chunk_out;
+    if (!out && nblocks_ > 0) {
+      zonemap_deserialize(&zonemap, p + 4 + (1 + i) * ZONEMAP_SIZE);
+      out = !zonemap_overlaps(records->kind, &zonemap, low, high);
+    }
+    maskout[i] = out;
+    nmasked += out;
+  }
+  return nmasked;
+}
+
+
+int blosc2_schunk_zonemap_maskout(blosc2_schunk *schunk, int64_t nchunk,
+                                  const blosc2_zonemap_value *low,
+                                  const blosc2_zonemap_value *high,
+                                  bool *maskout, int nblocks) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(maskout, BLOSC2_ERROR_NULL_POINTER);
+  zonemap_records records;
+  int rc = zonemap_records_load(schunk, &records);
+  if (rc < 0) {
+    return rc;
+  }
+  rc = zonemap_records_maskout(&records, nchunk, low, high, maskout, nblocks);
+  zonemap_records_free(&records);
+  return rc;
+}
+
+
+/* The matches in the blocks of a chunk, which the threads find while they decompress them */
+typedef struct {
+  int kind;
+  const blosc2_zonemap_value *low;
+  const blosc2_zonemap_value *high;
+  int32_t *indices;  // the matches of every block, from the index of its first item on
+  int32_t *nmatches;  // the number of matches of every block
+} range_filter;
+
+static int range_filter_block(blosc2_block_postfilter_params *params) {
+  range_filter *filter = (range_filter *)params->user_data;
+  filter->nmatches[params->nblock] = zonemap_select(filter->kind, params->typesize, params->input,
+                                                    params->nitems, filter->low, filter->high,
+                                                    params->start, filter->indices + params->start);
+  return 0;
+}
+
+
+int64_t blosc2_schunk_filter_range(blosc2_schunk *schunk, const blosc2_zonemap_value *low,
+                                   const blosc2_zonemap_value *high, blosc2_filter_range_cb callback,
+                                   void *user_data) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(callback, BLOSC2_ERROR_NULL_POINTER);
+  zonemap_records records;
+  int rc = zonemap_records_load(schunk, &records);
+  if (rc < 0) {
+    return rc;
+  }
+  // The zone maps tell how to read the items, if there are any
+  int kind = records.content != NULL ? records.kind : schunk->cctx->zonemap;
+  int32_t typesize = schunk->typesize;
+  if (!zonemap_supported(kind, typesize) || (records.content != NULL && records.typesize != typesize)) {
+    BLOSC_TRACE_ERROR("The super-chunk has no zone maps for typesize %d.", typesize);
+    zonemap_records_free(&records);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  range_filter filter = {kind, low, high, NULL, NULL};
+  blosc2_block_postfilter block_postfilter = {.user_data=&filter, .block=range_filter_block};
+  blosc2_dparams dparams;
+  blosc2_ctx_get_dparams(schunk->dctx, &dparams);
+  dparams.schunk = schunk;
+  // The items are compared while the blocks are hot, but after any postfilter of the super-chunk
+  bool fused = dparams.postfilter == NULL && dparams.block_postfilter == NULL;
+  if (fused) {
+    dparams.block_postfilter = &block_postfilter;
+  }
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int32_t chunksize = schunk->chunksize > 0 ? schunk->chunksize : 0;
+  uint8_t *buffer = malloc(chunksize + 1);
+  filter.indices = malloc((chunksize / typesize + 1) * sizeof(int32_t));
+  int32_t *nmatches = NULL;
+  bool *maskout = NULL;
+  int nblocks_max = 0;
+  int64_t total = 0;
+  if (dctx == NULL || buffer == NULL || filter.indices == NULL) {
+    BLOSC_TRACE_ERROR("Cannot set up the filter of the super-chunk.");
+    total = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto end;
+  }
+
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    uint8_t *chunk;
+    bool needs_free;
+    int32_t nbytes, blocksize;
+    rc = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
+    if (rc >= 0) {
+      rc = blosc2_cbuffer_sizes(chunk, &nbytes, NULL, &blocksize);
+    }
+    if (needs_free) {
+      free(chunk);
+    }
+    if (rc < 0) {
+      total = rc;
+      goto end;
+    }
+    if (nbytes == 0) {
+      continue;
+    }
+    int nblocks = nbytes / blocksize + (nbytes % blocksize > 0);
+    if (nblocks > nblocks_max) {
+      free(nmatches);
+      free(maskout);
+      nmatches = malloc(nblocks * sizeof(int32_t));
+      maskout = malloc(nblocks * sizeof(bool));
+      nblocks_max = nblocks;
+      if (nmatches == NULL || maskout == NULL) {
+        total = BLOSC2_ERROR_MEMORY_ALLOC;
+        goto end;
+      }
+    }
+    filter.nmatches = nmatches;
+
+    // Only the blocks that may have matches are decompressed
+    int nmasked = zonemap_records_maskout(&records, nchunk, low, high, maskout, nblocks);
+    if (nmasked == BLOSC2_ERROR_NOT_FOUND) {
+      memset(maskout, 0, nblocks * sizeof(bool));
+      nmasked = 0;
+    }
+    if (nmasked < 0) {
+      total = nmasked;
+      goto end;
+    }
+    if (nmasked == nblocks) {
+      continue;
+    }
+    if (nmasked > 0 && blosc2_set_maskout(dctx, maskout, nblocks) < 0) {
+      total = BLOSC2_ERROR_FAILURE;
+      goto end;
+    }
+    memset(nmatches, 0, nblocks * sizeof(int32_t));
+    rc = schunk_decompress_chunk_ctx(schunk, dctx, nchunk, buffer, chunksize);
+    if (rc < 0) {
+      total = rc;
+      goto end;
+    }
+    if (!fused) {
+      for (int i = 0; i < nblocks; i++) {
+        int32_t bsize = (i == nblocks - 1 && nbytes % blocksize > 0) ? nbytes % blocksize : blocksize;
+        if (!maskout[i]) {
+          nmatches[i] = zonemap_select(kind, typesize, buffer + (int64_t)i * blocksize, bsize / typesize,
+                                       low, high, i * (blocksize / typesize),
+                                       filter.indices + i * (blocksize / typesize));
+        }
+      }
+    }
+
+    // Gather the matches of the blocks
+    int32_t n = 0;
+    for (int i = 0; i < nblocks; i++) {
+      memmove(filter.indices + n, filter.indices + i * (blocksize / typesize), nmatches[i] * sizeof(int32_t));
+      n += nmatches[i];
+    }
+    if (n > 0) {
+      rc = callback(user_data, nchunk, nchunk * (schunk->chunksize / typesize), filter.indices, n);
+      if (rc < 0) {
+        total = rc;
+        goto end;
+      }
+      total += n;
+    }
+  }
+
+  end:
+  if (dctx != NULL) {
+    blosc2_free_ctx(dctx);
+  }
+  free(buffer);
+  free(filter.indices);
+  free(nmatches);
+  free(maskout);
+  zonemap_records_free(&records);
+  return total;
+}
+
+
+/* The reductions of the items of a super-chunk, and how they are read */
+typedef struct {
+  int kind;
+  int ops;
+  int32_t typesize;
+  const reduce_layout *layout;
+  blosc2_reduction *total;
+  int64_t chunk_stop[BLOSC2_MAX_DIM];  // the items of the current chunk that are not padding
+  bool padded;  // whether the current chunk has any padding
+} reducer;
+
+/* Add the reductions of `src` to `dest` */
+static void reduction_merge(int kind, blosc2_reduction *dest, const blosc2_reduction *src) {
+  if (src->count > 0 && dest->count == 0) {
+    dest->min = src->min;
+    dest->max = src->max;
+  }
+  else if (src->count > 0) {
+    switch (kind) {
+      case BLOSC2_ZONEMAP_INT:
+        dest->min.i = src->min.i < dest->min.i ? src->min.i : dest->min.i;
+        dest->max.i = src->max.i > dest->max.i ? src->max.i : dest->max.i;
+        break;
+      case BLOSC2_ZONEMAP_UINT:
+        dest->min.u = src->min.u < dest->min.u ? src->min.u : dest->min.u;
+        dest->max.u = src->max.u > dest->max.u ? src->max.u : dest->max.u;
+        break;
+      default:
+        dest->min.f = src->min.f < dest->min.f ? src->min.f : dest->min.f;
+        dest->max.f = src->max.f > dest->max.f ? src->max.f : dest->max.f;
+        break;
+    }
+  }
+  if (kind == BLOSC2_ZONEMAP_FLOAT) {
+    dest->sum.f += src->sum.f;
+  }
+  else {
+    dest->sum.u += src->sum.u;
+  }
+  dest->count += src->count;
+  dest->nnans += src->nnans;
+}
+
+/* Add `count` items of `value` plus `nnans` NaNs to `dest`, without going through them */
+static void reduction_repeat(int kind, blosc2_zonemap_value value, int64_t count, int64_t nnans,
+                             blosc2_reduction *dest) {
+  blosc2_reduction repeated = {.min=value, .max=value, .count=count, .nnans=nnans};
+  if (kind == BLOSC2_ZONEMAP_FLOAT) {
+    repeated.sum.f = count > 0 ? value.f * (double)count : 0.;
+  }
+  else {
+    // Wrapping around just like the sums of the items one by one
+    repeated.sum.u = value.u * (uint64_t)count;
+  }
+  reduction_merge(kind, dest, &repeated);
+}
+
+/* Add the reductions of the `nitems` items of `src` to `dest` */
+static void reduce_items(const reducer *reducer, const uint8_t *src, int32_t nitems, blosc2_reduction *dest) {
+  blosc2_reduction items = {0};
+  if (reducer->ops & (BLOSC2_REDUCE_MIN | BLOSC2_REDUCE_MAX | BLOSC2_REDUCE_COUNT)) {
+    blosc2_zonemap zonemap;
+    zonemap_compute(reducer->kind, reducer->typesize, src, nitems * reducer->typesize, &zonemap);
+    items.min = zonemap.min;
+    items.max = zonemap.max;
+    items.nnans = zonemap.nnans;
+  }
+  items.count = nitems - items.nnans;
+  if (reducer->ops & BLOSC2_REDUCE_SUM) {
+    zonemap_sum(reducer->kind, reducer->typesize, src, nitems, &items.sum);
+  }
+  reduction_merge(reducer->kind, dest, &items);
+}
+
+/* Add the reductions of the items of the block `nblock` of the current chunk to `dest`,
+   leaving its padding out */
+static void reduce_block(const reducer *reducer, int32_t nblock, const uint8_t *src, int32_t nitems,
+                         blosc2_reduction *dest) {
+  if (!reducer->padded) {
+    reduce_items(reducer, src, nitems, dest);
+    return;
+  }
+  const reduce_layout *layout = reducer->layout;
+  int8_t ndim = layout->ndim;
+  int64_t blocks_in_chunk[BLOSC2_MAX_DIM];
+  int64_t coords[BLOSC2_MAX_DIM];
+  int64_t stop[BLOSC2_MAX_DIM];
+  for (int i = 0; i < ndim; i++) {
+    blocks_in_chunk[i] = layout->extchunkshape[i] / layout->blockshape[i];
+  }
+  blosc2_unidim_to_multidim(ndim, blocks_in_chunk, nblock, coords);
+  for (int i = 0; i < ndim; i++) {
+    stop[i] = reducer->chunk_stop[i] - coords[i] * layout->blockshape[i];
+    stop[i] = stop[i] < layout->blockshape[i] ? stop[i] : layout->blockshape[i];
+    if (stop[i] <= 0) {
+      return;
+    }
+  }
+  // The items come in runs along the last dim
+  int64_t index[BLOSC2_MAX_DIM] = {0};
+  while (true) {
+    int64_t offset = 0;
+    for (int i = 0; i < ndim; i++) {
+      offset = offset * layout->blockshape[i] + index[i];
+    }
+    reduce_items(reducer, src + offset * reducer->typesize, (int32_t)stop[ndim - 1], dest);
+    int i = ndim - 2;
+    while (i >= 0 && ++index[i] == stop[i]) {
+      index[i] = 0;
+      i--;
+    }
+    if (i < 0) {
+      break;
+    }
+  }
+}
+
+static int reduce_init(void *user_data, int32_t tid, void **state) {
+  BLOSC_UNUSED_PARAM(user_data);
+  BLOSC_UNUSED_PARAM(tid);
+  *state = calloc(1, sizeof(blosc2_reduction));
+  return *state == NULL ? BLOSC2_ERROR_MEMORY_ALLOC : 0;
+}
+
+static int reduce_block_postfilter(blosc2_block_postfilter_params *params) {
+  reduce_block((reducer *)params->user_data, params->nblock, params->input, params->nitems, params->state);
+  return 0;
+}
+
+static int reduce_combine(void *user_data, void **states, int32_t nstates) {
+  reducer *reducer = user_data;
+  for (int32_t i = 0; i < nstates; i++) {
+    reduction_merge(reducer->kind, reducer->total, states[i]);
+  }
+  return 0;
+}
+
+static void reduce_free(void *user_data, void *state) {
+  BLOSC_UNUSED_PARAM(user_data);
+  free(state);
+}
+
+/* Tell the items of the chunk `nchunk` that are not padding to `reducer`.  Returns how many there are. */
+static int64_t reduce_chunk_region(reducer *reducer, int64_t nchunk, int64_t nitems) {
+  const reduce_layout *layout = reducer->layout;
+  reducer->padded = false;
+  if (layout == NULL || layout->ndim == 0) {
+    return nitems;
+  }
+  int64_t chunks_in_array[BLOSC2_MAX_DIM];
+  int64_t coords[BLOSC2_MAX_DIM];
+  for (int i = 0; i < layout->ndim; i++) {
+    chunks_in_array[i] = (layout->shape[i] + layout->chunkshape[i] - 1) / layout->chunkshape[i];
+  }
+  blosc2_unidim_to_multidim(layout->ndim, chunks_in_array, nchunk, coords);
+  nitems = 1;
+  for (int i = 0; i < layout->ndim; i++) {
+    int64_t stop = layout->shape[i] - coords[i] * layout->chunkshape[i];
+    reducer->chunk_stop[i] = stop < layout->chunkshape[i] ? stop : layout->chunkshape[i];
+    reducer->padded |= reducer->chunk_stop[i] != layout->extchunkshape[i];
+    nitems *= reducer->chunk_stop[i];
+  }
+  return nitems;
+}
+
+/* The item that a special chunk repeats, in `item` (which has room for it) */
+static int special_item(blosc2_schunk *schunk, int64_t nchunk, int special, uint8_t *item) {
+  int32_t typesize = schunk->typesize;
+  memset(item, 0, typesize);
+  if (special == BLOSC2_SPECIAL_NAN) {
+    float nan_f = NAN;
+    double nan_d = NAN;
+    memcpy(item, typesize == sizeof(float) ? (void *)&nan_f : (void *)&nan_d, typesize);
+  }
+  else if (special == BLOSC2_SPECIAL_VALUE) {
+    uint8_t *chunk;
+    bool needs_free;
+    int rc = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
+    if (rc < BLOSC_EXTENDED_HEADER_LENGTH + typesize) {
+      if (needs_free) {
+        free(chunk);
+      }
+      return rc < 0 ? rc : BLOSC2_ERROR_READ_BUFFER;
+    }
+    memcpy(item, chunk + BLOSC_EXTENDED_HEADER_LENGTH, typesize);
+    if (needs_free) {
+      free(chunk);
+    }
+  }
+  return 0;
+}
+
+
+int schunk_reduce(blosc2_schunk *schunk, const reduce_layout *layout, int kind, int ops,
+                  blosc2_reduction *result) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(result, BLOSC2_ERROR_NULL_POINTER);
+  memset(result, 0, sizeof(blosc2_reduction));
+  int32_t typesize = schunk->typesize;
+  if (!zonemap_supported(kind, typesize)) {
+    BLOSC_TRACE_ERROR("Items of typesize %d cannot be reduced as kind %d.", typesize, kind);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  zonemap_records records;
+  int rc = zonemap_records_load(schunk, &records);
+  if (rc < 0) {
+    return rc;
+  }
+  bool zonemaps = records.content != NULL && records.kind == kind && records.typesize == typesize;
+
+  reducer reducer = {.kind=kind, .ops=ops, .typesize=typesize, .layout=layout, .total=result};
+  blosc2_block_postfilter block_postfilter = {.user_data=&reducer, .init=reduce_init, .block=reduce_block_postfilter,
+                                              .combine=reduce_combine, .free=reduce_free, .discard=true};
+  blosc2_dparams dparams;
+  blosc2_ctx_get_dparams(schunk->dctx, &dparams);
+  dparams.schunk = schunk;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  // The blocks are reduced while they are hot, but after any postfilter of the super-chunk
+  // (and the ones of chunks with deltas between them, after these are undone)
+  bool xdelta = schunk->xdelta != NULL;
+  blosc2_context *fused_dctx = NULL;
+  if (dparams.postfilter == NULL && dparams.block_postfilter == NULL && !xdelta) {
+    dparams.block_postfilter = &block_postfilter;
+    fused_dctx = blosc2_create_dctx(dparams);
+  }
+  // Only the chunks that are not reduced on the fly are decompressed here
+  int32_t chunksize = schunk->chunksize > 0 ? schunk->chunksize : 0;
+  uint8_t *buffer = malloc(chunksize + 1);
+  uint8_t *item = malloc(typesize);
+  bool *maskout = NULL;
+  int nblocks_max = 0;
+  if (dctx == NULL || buffer == NULL || item == NULL) {
+    BLOSC_TRACE_ERROR("Cannot set up the reduction of the super-chunk.");
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto end;
+  }
+
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    blosc2_chunk_info info;
+    rc = blosc2_schunk_get_chunk_info(schunk, nchunk, &info);
+    if (rc < 0) {
+      goto end;
+    }
+    if (info.nbytes % typesize != 0) {
+      BLOSC_TRACE_ERROR("The chunk %" PRId64 " does not hold whole items.", nchunk);
+      rc = BLOSC2_ERROR_INVALID_PARAM;
+      goto end;
+    }
+    int64_t nitems = reduce_chunk_region(&reducer, nchunk, info.nbytes / typesize);
+    if (nitems == 0 || info.special == BLOSC2_SPECIAL_UNINIT) {
+      continue;
+    }
+
+    // Special chunks are a single item repeated (but as deltas)
+    if (!xdelta && (info.special == BLOSC2_SPECIAL_ZERO || info.special == BLOSC2_SPECIAL_NAN ||
+                    info.special == BLOSC2_SPECIAL_VALUE)) {
+      rc = special_item(schunk, nchunk, info.special, item);
+      if (rc < 0) {
+        goto end;
+      }
+      blosc2_zonemap zonemap;
+      zonemap_compute(kind, typesize, item, typesize, &zonemap);
+      reduction_repeat(kind, zonemap.min, zonemap.nnans > 0 ? 0 : nitems, zonemap.nnans > 0 ? nitems : 0,
+                       result);
+      continue;
+    }
+    // And integers are counted without looking at them
+    if (ops == BLOSC2_REDUCE_COUNT && kind != BLOSC2_ZONEMAP_FLOAT) {
+      result->count += nitems;
+      continue;
+    }
+
+    int nblocks = info.nbytes / info.blocksize + (info.nbytes % info.blocksize > 0);
+    if (nblocks > nblocks_max) {
+      free(maskout);
+      maskout = malloc(nblocks * sizeof(bool));
+      nblocks_max = nblocks;
+      if (maskout == NULL) {
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        goto end;
+      }
+    }
+    memset(maskout, 0, nblocks * sizeof(bool));
+    int nmasked = 0;
+
+    // The blocks of the delta filter are decoded against the first one in the destination,
+    // which cannot be masked out then
+    bool delta = false;
+    for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+      delta |= info.filters[i] == BLOSC_DELTA && info.filters_meta[i] != BLOSC_DELTA_ELEMENTS;
+    }
+
+    // The zone maps tell about the whole chunk, and about the blocks of a single value
+    const uint8_t *p = NULL;
+    if (zonemaps && !reducer.padded && nchunk < records.nrecords) {
+      p = records.content + records.starts[nchunk];
+      if (sw32_(p) != nblocks) {
+        p = NULL;
+      }
+    }
+    if (p != NULL && !(ops & BLOSC2_REDUCE_SUM)) {
+      blosc2_zonemap zonemap;
+      zonemap_deserialize(&zonemap, p + 4);
+      blosc2_reduction chunk = {.min=zonemap.min, .max=zonemap.max, .count=zonemap.nitems - zonemap.nnans,
+                                .nnans=zonemap.nnans};
+      reduction_merge(kind, result, &chunk);
+      continue;
+    }
+    for (int i = delta ? 1 : 0; p != NULL && i < nblocks; i++) {
+      blosc2_zonemap zonemap;
+      zonemap_deserialize(&zonemap, p + 4 + (1 + i) * ZONEMAP_SIZE);
+      bool single = zonemap.nitems == zonemap.nnans ||
+                    (kind == BLOSC2_ZONEMAP_FLOAT ? zonemap.min.f == zonemap.max.f : zonemap.min.u == zonemap.max.u);
+      if (single) {
+        reduction_repeat(kind, zonemap.min, zonemap.nitems - zonemap.nnans, zonemap.nnans, result);
+        maskout[i] = true;
+        nmasked++;
+      }
+    }
+    if (nmasked == nblocks) {
+      continue;
+    }
+
+    blosc2_context *ctx = fused_dctx != NULL && !delta ? fused_dctx : dctx;
+    if (nmasked > 0 && blosc2_set_maskout(ctx, maskout, nblocks) < 0) {
+      rc = BLOSC2_ERROR_FAILURE;
+      goto end;
+    }
+    rc = schunk_decompress_chunk_ctx(schunk, ctx, nchunk, buffer, chunksize);
+    if (rc < 0) {
+      goto end;
+    }
+    for (int i = 0; ctx == dctx && i < nblocks; i++) {
+      int32_t bsize = (i == nblocks - 1 && info.nbytes % info.blocksize > 0) ? info.nbytes % info.blocksize
+                                                                              : info.blocksize;
+      if (!maskout[i]) {
+        reduce_block(&reducer, i, buffer + (int64_t)i * info.blocksize, bsize / typesize, result);
+      }
+    }
+  }
+  rc = 0;
+
+  // Only what was asked for
+  if (!(ops & BLOSC2_REDUCE_SUM)) {
+    memset(&result->sum, 0, sizeof(result->sum));
+  }
+  if (!(ops & BLOSC2_REDUCE_MIN)) {
+    memset(&result->min, 0, sizeof(result->min));
+  }
+  if (!(ops & BLOSC2_REDUCE_MAX)) {
+    memset(&result->max, 0, sizeof(result->max));
+  }
+  if (!(ops & BLOSC2_REDUCE_COUNT)) {
+    result->count = 0;
+    result->nnans = 0;
+  }
+
+  end:
+  if (dctx != NULL) {
+    blosc2_free_ctx(dctx);
+  }
+  if (fused_dctx != NULL) {
+    blosc2_free_ctx(fused_dctx);
+  }
+  free(buffer);
+  free(item);
+  free(maskout);
+  zonemap_records_free(&records);
+  return rc;
+}
+
+
+int blosc2_schunk_reduce(blosc2_schunk *schunk, int kind, int ops, blosc2_reduction *result) {
+  return schunk_reduce(schunk, NULL, kind, ops, result);
+}
+
+
+int schunk_save_tuner(blosc2_schunk *schunk) {
+  uint8_t *state;
+  int32_t state_len;
+  int rc = tuner_serialize(schunk->cctx, &state, &state_len);
+  if (rc <= 0) {
+    return rc;
+  }
+  int32_t content_len = (int32_t)sizeof(int32_t) + state_len;
+  uint8_t *content = malloc(content_len);
+  if (content == NULL) {
+    free(state);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  _sw32(content, schunk->cctx->tuner_id);
+  memcpy(content + sizeof(int32_t), state, state_len);
+  free(state);
+  if (blosc2_vlmeta_exists(schunk, TUNER_VLMETA) >= 0) {
+    rc = blosc2_vlmeta_update(schunk, TUNER_VLMETA, content, content_len, NULL);
+  }
+  else {
+    rc = blosc2_vlmeta_add(schunk, TUNER_VLMETA, content, content_len, NULL);
+  }
+  free(content);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+int schunk_load_tuner(blosc2_schunk *schunk) {
+  if (blosc2_vlmeta_exists(schunk, TUNER_VLMETA) < 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t *content;
+  int32_t content_len;
+  int rc = blosc2_vlmeta_get(schunk, TUNER_VLMETA, &content, &content_len);
+  if (rc < 0) {
+    return rc;
+  }
+  if (content_len < (int32_t)sizeof(int32_t)) {
+    BLOSC_TRACE_ERROR("The tuner state of the super-chunk is corrupted.");
+    free(content);
+    return BLOSC2_ERROR_DATA;
+  }
+  // A state from another tuner is of no use
+  if (sw32_(content) == schunk->cctx->tuner_id) {
+    rc = tuner_deserialize(schunk->cctx, content + sizeof(int32_t), content_len - (int32_t)sizeof(int32_t));
+  }
+  free(content);
+  return rc;
+}
+
+
+
+/* Get the uncompressed size of a chunk and whether it is a special one */
+static int get_chunk_info(blosc2_schunk *schunk, int64_t nchunk, int32_t *nbytes, bool *special) {
+  uint8_t *chunk;
+  bool needs_free;
+  int rc = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
+  if (rc < 0) {
+    return rc;
+  }
+  rc = blosc2_cbuffer_sizes(chunk, nbytes, NULL, NULL);
+  if (rc >= 0) {
+    *special = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  }
+  if (needs_free) {
+    free(chunk);
+  }
+  return rc;
+}
+
+
+int blosc2_schunk_train_dict(blosc2_schunk *schunk, int64_t nchunks) {
+  if (schunk->shared_dict != NULL || blosc2_vlmeta_exists(schunk, SHARED_DICT_VLMETA) >= 0) {
+    BLOSC_TRACE_ERROR("The super-chunk has a shared dictionary already.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (nchunks <= 0 || nchunks > schunk->nchunks) {
+    BLOSC_TRACE_ERROR("Cannot train on %" PRId64 " chunks of a super-chunk with %" PRId64 " chunks.",
+                      nchunks, schunk->nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (schunk->cctx->tuner_id != BLOSC_STUNE || schunk->cctx->tuner_params != NULL) {
+    // Other tuners (and the adaptive stune) can change the codec from a chunk to the next
+    BLOSC_TRACE_ERROR("Shared dictionaries are not supported with tuner %d.", schunk->cctx->tuner_id);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  // The samples are taken evenly from the first chunks
+  int32_t samples_maxsize = 32 * BLOSC2_MAXDICTSIZE;
+  int32_t sample_maxsize = (int32_t) (samples_maxsize / nchunks);
+  sample_maxsize -= sample_maxsize % schunk->typesize;
+  if (sample_maxsize == 0) {
+    sample_maxsize = schunk->typesize;
+  }
+  uint8_t *samples = malloc((size_t) sample_maxsize * nchunks);
+  BLOSC_ERROR_NULL(samples, BLOSC2_ERROR_MEMORY_ALLOC);
+  uint8_t *buffer = NULL;
+  uint8_t *chunk = NULL;
+  uint8_t *dict = NULL;
+  uint8_t *content = NULL;
+  int32_t buffer_size = 0;
+  int32_t samples_size = 0;
+  int32_t nbytes;
+  bool special;
+  int rc;
+  for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+    rc = get_chunk_info(schunk, nchunk, &nbytes, &special);
+    if (rc < 0) {
+      goto out;
+    }
+    if (nbytes > buffer_size) {
+      free(buffer);
+      buffer = malloc(nbytes);
+      buffer_size = nbytes;
+      if (buffer == NULL) {
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        goto out;
+      }
+    }
+    rc = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, nbytes);
+    if (rc < 0) {
+      goto out;
+    }
+    int32_t sample_size = nbytes < sample_maxsize ? nbytes : sample_maxsize;
+    memcpy(samples + samples_size, buffer, sample_size);
+    samples_size += sample_size;
+  }
+
+  blosc2_cparams *cparams;
+  blosc2_schunk_get_cparams(schunk, &cparams);
+  int32_t dict_size = build_shared_dict(cparams, samples, samples_size, &dict);
+  free(cparams);
+  if (dict_size < 0) {
+    rc = dict_size;
+    goto out;
+  }
+
+  // Store the dictionary once, in a vlmetalayer
+  int32_t content_len = (int32_t) sizeof(int32_t) + dict_size;
+  content = malloc(content_len);
+  if (content == NULL) {
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto out;
+  }
+  _sw32(content, get_shared_dict_id(dict, dict_size));
+  memcpy(content + sizeof(int32_t), dict, dict_size);
+  rc = blosc2_vlmeta_add(schunk, SHARED_DICT_VLMETA, content, content_len, NULL);
+  if (rc < 0) {
+    goto out;
+  }
+  rc = set_shared_dict(schunk, content, content_len);
+  if (rc < 0) {
+    goto out;
+  }
+
+  // Recompress the (non-special) chunks with the dictionary
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    rc = get_chunk_info(schunk, nchunk, &nbytes, &special);
+    if (rc < 0) {
+      goto out;
+    }
+    if (special) {
+      continue;
+    }
+    if (nbytes > buffer_size) {
+      free(buffer);
+      buffer = malloc(nbytes);
+      buffer_size = nbytes;
+      free(chunk);
+      chunk = NULL;
+      if (buffer == NULL) {
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        goto out;
+      }
+    }
+    if (chunk == NULL) {
+      chunk = malloc((size_t) buffer_size + BLOSC2_MAX_OVERHEAD);
+      if (chunk == NULL) {
+        rc = BLOSC2_ERROR_MEMORY_ALLOC;
+        goto out;
+      }
+    }
+    rc = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, nbytes);
+    if (rc < 0) {
+      goto out;
+    }
+    rc = blosc2_compress_ctx(schunk->cctx, buffer, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+    if (rc < 0) {
+      goto out;
+    }
+    int64_t rc_ = blosc2_schunk_update_chunk(schunk, nchunk, chunk, true);
+    if (rc_ < 0) {
+      rc = (int) rc_;
+      goto out;
+    }
+  }
+  rc = BLOSC2_ERROR_SUCCESS;
+
+  out:
+  free(samples);
+  free(buffer);
+  free(chunk);
+  free(dict);
+  free(content);
+  return rc;
+}
+
+
+/* Free all memory from a super-chunk. */
+int blosc2_schunk_free(blosc2_schunk *schunk) {
+  int rc = blosc2_schunk_set_async_appends(schunk, 0, 0);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot finish the asynchronous appends.");
+  }
+  stop_tiering(schunk, false);
+  rc = blosc2_schunk_set_concurrent_writes(schunk, 0);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot merge the chunks of the concurrent writes.");
+  }
+  rc = blosc2_schunk_commit_bulk(schunk);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot commit the bulk append.");
+  }
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame != NULL && schunk->storage->durability != BLOSC2_DURABILITY_NONE) {
+    rc = frame_sync(frame);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot sync the frame.");
+    }
+  }
+
+  if (schunk->data != NULL) {
+    for (int i = 0; i < schunk->nchunks; i++) {
+      free_chunk(schunk, schunk->data[i]);
+    }
+    free(schunk->data);
+  }
+  free_chunk_arena(schunk);
+  free_borrowed_chunks(schunk);
+  if (schunk->cctx != NULL)
+    blosc2_free_ctx(schunk->cctx);
+  if (schunk->dctx != NULL)
+    blosc2_free_ctx(schunk->dctx);
+  if (schunk->blockshape != NULL)
+    free(schunk->blockshape);
+  blosc2_schunk_set_chunk_cache(schunk, 0);
+  free_ctx_pool(&schunk->dctx_pool);
+  free_shared_dict(schunk);
+  free_xdelta(schunk);
+
+  if (schunk->nmetalayers > 0) {
+    for (int i = 0; i < schunk->nmetalayers; i++) {
+      if (schunk->metalayers[i] != NULL) {
+        if (schunk->metalayers[i]->name != NULL)
+          free(schunk->metalayers[i]->name);
+        if (schunk->metalayers[i]->content != NULL)
+          free(schunk->metalayers[i]->content);
+        free(schunk->metalayers[i]);
+      }
+    }
+    schunk->nmetalayers = 0;
+  }
+
+  if (schunk->storage != NULL) {
+    if (schunk->storage->urlpath != NULL) {
+      free(schunk->storage->urlpath);
+    }
+    free(schunk->storage->cparams);
+    free(schunk->storage->dparams);
+    free(schunk->storage->io);
+    free(schunk->storage);
+  }
+
+  if (frame != NULL) {
+#if !defined(_WIN32)
+    if (frame->shm_len > 0) {
+      // Attached to shared memory (see blosc2_schunk_open_shm())
+      munmap(frame->cframe, (size_t)frame->shm_len);
+    }
+#endif
+    frame_free(frame);
+  }
+
+  if (schunk->nvlmetalayers > 0) {
+    for (int i = 0; i < schunk->nvlmetalayers; ++i) {
+      if (schunk->vlmetalayers[i] != NULL) {
+        if (schunk->vlmetalayers[i]->name != NULL)
+          free(schunk->vlmetalayers[i]->name);
+        if (schunk->vlmetalayers[i]->content != NULL)
+          free(schunk->vlmetalayers[i]->content);
+        free(schunk->vlmetalayers[i]);
+      }
+    }
+  }
+
+  free(schunk);
+
+  return rc < 0 ? rc : 0;
+}
+
+
+/* Create a super-chunk out of a contiguous frame buffer */
+blosc2_schunk* blosc2_schunk_from_buffer(uint8_t *cframe, int64_t len, bool copy) {
+  blosc2_frame_s* frame = frame_from_cframe(cframe, len, false);
+  if (frame == NULL) {
+    return NULL;
+  }
+  // Check that the buffer actually comes from a cframe
+  char *magic_number = (char *)cframe;
+  magic_number += FRAME_HEADER_MAGIC;
+  if (strcmp(magic_number, "b2frame\0") != 0) {
+    return NULL;
+  }
+  blosc2_schunk* schunk = frame_to_schunk(frame, copy, &BLOSC2_IO_DEFAULTS);
+  if (schunk && copy) {
+    // Super-chunk has its own copy of frame
+    frame_free(frame);
+  }
+  return schunk;
+}
+
+
+/* Put the frame of a super-chunk in named shared memory */
+int64_t blosc2_schunk_to_shm(blosc2_schunk *schunk, const char *name) {
+#if defined(_WIN32)
+  BLOSC_UNUSED_PARAM(schunk);
+  BLOSC_UNUSED_PARAM(name);
+  BLOSC_TRACE_ERROR("Frames in shared memory are not supported on Windows.");
+  return BLOSC2_ERROR_INVALID_PARAM;
+#else
+  uint8_t* cframe;
+  bool needs_free;
+  int64_t len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  if (len < 0) {
+    return len;
+  }
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    BLOSC_TRACE_ERROR("Cannot create the shared memory %s (maybe it exists already).", name);
+    if (needs_free) {
+      free(cframe);
+    }
+    return BLOSC2_ERROR_FILE_OPEN;
+  }
+  int64_t rc = len;
+  if (ftruncate(fd, (off_t)len) != 0) {
+    BLOSC_TRACE_ERROR("Cannot make room for the frame in the shared memory %s.", name);
+    rc = BLOSC2_ERROR_FILE_TRUNCATE;
+  }
+  else {
+    // Shared memory objects may not support write(), but they can always be mapped
+    void* map = mmap(NULL, (size_t)len, PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+      BLOSC_TRACE_ERROR("Cannot map the shared memory %s.", name);
+      rc = BLOSC2_ERROR_FILE_WRITE;
+    }
+    else {
+      memcpy(map, cframe, (size_t)len);
+      munmap(map, (size_t)len);
+    }
+  }
+  close(fd);
+  if (needs_free) {
+    free(cframe);
+  }
+  if (rc < 0) {
+    shm_unlink(name);
+  }
+  return rc;
+#endif
+}
+
+
+/* Attach to a frame in named shared memory, read-only */
+blosc2_schunk* blosc2_schunk_open_shm(const char *name) {
+#if defined(_WIN32)
+  BLOSC_UNUSED_PARAM(name);
+  BLOSC_TRACE_ERROR("Frames in shared memory are not supported on Windows.");
+  return NULL;
+#else
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    BLOSC_TRACE_ERROR("Cannot open the shared memory %s.", name);
+    return NULL;
+  }
+  struct stat shm_stat;
+  if (fstat(fd, &shm_stat) != 0 || shm_stat.st_size < FRAME_HEADER_MINLEN + FRAME_TRAILER_MINLEN) {
+    BLOSC_TRACE_ERROR("The shared memory %s does not have a frame.", name);
+    close(fd);
+    return NULL;
+  }
+  int64_t len = shm_stat.st_size;
+  uint8_t* cframe = mmap(NULL, (size_t)len, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (cframe == MAP_FAILED) {
+    BLOSC_TRACE_ERROR("Cannot map the shared memory %s.", name);
+    return NULL;
+  }
+  if (memcmp(cframe + FRAME_HEADER_MAGIC, "b2frame\0", 8) != 0) {
+    BLOSC_TRACE_ERROR("The shared memory %s does not have a frame.", name);
+    munmap(cframe, (size_t)len);
+    return NULL;
+  }
+  blosc2_frame_s* frame = frame_from_cframe(cframe, len, false);
+  if (frame == NULL) {
+    munmap(cframe, (size_t)len);
+    return NULL;
+  }
+  // The mapping goes away along with the super-chunk
+  frame->shm_len = len;
+  return frame_to_schunk(frame, false, &BLOSC2_IO_DEFAULTS);
+#endif
+}
+
+
+int blosc2_remove_shm(const char *name) {
+#if defined(_WIN32)
+  BLOSC_UNUSED_PARAM(name);
+  return BLOSC2_ERROR_INVALID_PARAM;
+#else
+  if (shm_unlink(name) != 0) {
+    BLOSC_TRACE_ERROR("Cannot remove the shared memory %s.", name);
+    return BLOSC2_ERROR_FILE_REMOVE;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+#endif
+}
+
+
+/* Create a super-chunk out of a contiguous frame buffer */
+void blosc2_schunk_avoid_cframe_free(blosc2_schunk *schunk, bool avoid_cframe_free) {
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  frame_avoid_cframe_free(frame, avoid_cframe_free);
+}
+
+
+/* Fill an empty frame with special values (fast path), which repeat `repeatval` for
+   BLOSC2_SPECIAL_VALUE. */
+static int64_t schunk_fill(blosc2_schunk* schunk, int64_t nitems, int special_value, const void* repeatval,
+                           int32_t chunksize) {
+  BLOSC_ERROR(check_no_xdelta(schunk));
+  if (nitems == 0) {
+    return 0;
+  }
+
+  int32_t typesize = schunk->typesize;
+
+  if ((nitems * typesize / chunksize) > INT_MAX) {
+    BLOSC_TRACE_ERROR("nitems is too large.  Try increasing the chunksize.");
+    return BLOSC2_ERROR_SCHUNK_SPECIAL;
+  }
+
+  if ((schunk->nbytes > 0) || (schunk->cbytes > 0)) {
+    BLOSC_TRACE_ERROR("Filling with special values only works on empty super-chunks");
+    return BLOSC2_ERROR_FRAME_SPECIAL;
+  }
+
+  // Compute the number of chunks and the length of the offsets chunk
+  int32_t chunkitems = chunksize / typesize;
+  int64_t nchunks = nitems / chunkitems;
+  int32_t leftover_items = (int32_t)(nitems % chunkitems);
+
+  // Sparse frames keep every chunk in a file of its own, so repeated values go one by one
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  if (frame == NULL || (frame->sframe && special_value == BLOSC2_SPECIAL_VALUE)) {
+    // Build the special chunks
+    int32_t leftover_size = leftover_items * typesize;
+    int32_t chunk_cbytes = BLOSC_EXTENDED_HEADER_LENGTH + typesize;
+    void* chunk = malloc(chunk_cbytes);
+    void* chunk2 = malloc(chunk_cbytes);
+    blosc2_cparams* cparams;
+    blosc2_schunk_get_cparams(schunk, &cparams);
+    int csize, csize2;
+    switch (special_value) {
+      case BLOSC2_SPECIAL_ZERO:
+        csize = blosc2_chunk_zeros(*cparams, chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+        csize2 = blosc2_chunk_zeros(*cparams, leftover_size, chunk2, BLOSC_EXTENDED_HEADER_LENGTH);
+        break;
+      case BLOSC2_SPECIAL_UNINIT:
+        csize = blosc2_chunk_uninit(*cparams, chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+        csize2 = blosc2_chunk_uninit(*cparams, leftover_size, chunk2, BLOSC_EXTENDED_HEADER_LENGTH);
+        break;
+      case BLOSC2_SPECIAL_NAN:
+        csize = blosc2_chunk_nans(*cparams, chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+        csize2 = blosc2_chunk_nans(*cparams, leftover_size, chunk2, BLOSC_EXTENDED_HEADER_LENGTH);
+        break;
+      case BLOSC2_SPECIAL_VIRTUAL:
+        csize = blosc2_chunk_virtual(*cparams, chunksize, chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+        csize2 = blosc2_chunk_virtual(*cparams, leftover_size, chunk2, BLOSC_EXTENDED_HEADER_LENGTH);
+        break;
+      case BLOSC2_SPECIAL_VALUE:
+        csize = blosc2_chunk_repeatval(*cparams, chunksize, chunk, chunk_cbytes, repeatval);
+        csize2 = blosc2_chunk_repeatval(*cparams, leftover_size, chunk2, chunk_cbytes, repeatval);
+        break;
+      default:
+        BLOSC_TRACE_ERROR("Only zeros, NaNs, non-initialized, virtual or repeated values are supported.");
+        return BLOSC2_ERROR_SCHUNK_SPECIAL;
+    }
+    free(cparams);
+    if (csize < 0 || csize2 < 0) {
+      BLOSC_TRACE_ERROR("Error creating special chunks.");
+      return BLOSC2_ERROR_SCHUNK_SPECIAL;
+    }
+
+    for (int nchunk = 0; nchunk < nchunks; nchunk++) {
+      int64_t nchunk_ = blosc2_schunk_append_chunk(schunk, chunk, true);
+      if (nchunk_ != nchunk + 1) {
+        BLOSC_TRACE_ERROR("Error appending special chunks.");
+        return BLOSC2_ERROR_SCHUNK_SPECIAL;
+      }
+    }
+
+    if (leftover_items) {
+      int64_t nchunk_ = blosc2_schunk_append_chunk(schunk, chunk2, true);
+      if (nchunk_ != nchunks + 1) {
+        BLOSC_TRACE_ERROR("Error appending last special chunk.");
+        return BLOSC2_ERROR_SCHUNK_SPECIAL;
+      }
+    }
+    free(chunk);
+    free(chunk2);
+  }
+  else {
+    /* Fill an empty frame with special values (fast path). */
+    // A repeated value is stored once for all the whole chunks, and the leftover goes after
+    bool repeated = special_value == BLOSC2_SPECIAL_VALUE;
+    int64_t fill_items = repeated ? nitems - leftover_items : nitems;
+    /* Update counters (necessary for the frame_fill_special() logic) */
+    if (leftover_items && !repeated) {
+      nchunks += 1;
+    }
+    schunk->chunksize = chunksize;
+    schunk->nchunks = nchunks;
+    schunk->nbytes = fill_items * typesize;
+    if (fill_items > 0) {
+      int64_t frame_len = frame_fill_special(frame, fill_items, special_value, repeatval, chunksize, schunk);
+      if (frame_len < 0) {
+        BLOSC_TRACE_ERROR("Error creating special frame.");
+        return frame_len;
+      }
+      BLOSC_ERROR(changes_record(schunk, 0, 0, schunk->nchunks));
+    }
+    if (repeated && leftover_items) {
+      blosc2_cparams* cparams;
+      blosc2_schunk_get_cparams(schunk, &cparams);
+      int32_t chunk_cbytes = BLOSC_EXTENDED_HEADER_LENGTH + typesize;
+      uint8_t* chunk = malloc(chunk_cbytes);
+      int csize = blosc2_chunk_repeatval(*cparams, leftover_items * typesize, chunk, chunk_cbytes, repeatval);
+      free(cparams);
+      int64_t nchunks_ = csize < 0 ? csize : blosc2_schunk_append_chunk(schunk, chunk, true);
+      free(chunk);
+      if (nchunks_ != nchunks + 1) {
+        BLOSC_TRACE_ERROR("Error appending last special chunk.");
+        return BLOSC2_ERROR_SCHUNK_SPECIAL;
+      }
+    }
+  }
+
+  return schunk->nchunks;
+}
+
+
+int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems, int special_value,
+                               int32_t chunksize) {
+  if (special_value == BLOSC2_SPECIAL_VALUE) {
+    BLOSC_TRACE_ERROR("Repeated values go through blosc2_schunk_fill_repeatval.");
+    return BLOSC2_ERROR_SCHUNK_SPECIAL;
+  }
+  return schunk_fill(schunk, nitems, special_value, NULL, chunksize);
+}
+
+
+int64_t blosc2_schunk_fill_repeatval(blosc2_schunk* schunk, int64_t nitems, const void* repeatval,
+                                     int32_t chunksize) {
+  BLOSC_ERROR_NULL(repeatval, BLOSC2_ERROR_NULL_POINTER);
+  return schunk_fill(schunk, nitems, BLOSC2_SPECIAL_VALUE, repeatval, chunksize);
+}
+
+
+/* Append an existing chunk into a super-chunk. */
+int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy) {
+  BLOSC_ERROR(check_not_read_only(schunk));
+  BLOSC_ERROR(check_no_concurrent_reads(schunk));
+  if (schunk->cctx_pool != NULL) {
+    // The chunk goes to a file of its own, and only the index of the frame is updated in turns
+    int64_t nchunks = frame_put_chunk((blosc2_frame_s*)schunk->frame, -1, chunk);
+    if (!copy) {
+      free(chunk);
+    }
+    return nchunks;
+  }
+  int32_t chunk_nbytes;
+  int32_t chunk_cbytes;
+  int64_t nchunks = schunk->nchunks;
+
+  int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    return rc;
+  }
+
+  if (schunk->chunksize == -1) {
+    schunk->chunksize = chunk_nbytes;  // The super-chunk is initialized now
+  }
+  if (chunk_nbytes > schunk->chunksize) {
+    BLOSC_TRACE_ERROR("Appending chunks that have different lengths in the same schunk "
+                      "is not supported yet: %d > %d.", chunk_nbytes, schunk->chunksize);
+    return BLOSC2_ERROR_CHUNK_APPEND;
+  }
+
+  /* Update counters */
+  schunk->current_nchunk = nchunks;
+  schunk->nchunks = nchunks + 1;
+  schunk->nbytes += chunk_nbytes;
+  if (schunk->frame == NULL) {
+    schunk->cbytes += chunk_cbytes;
+  } else {
+    // A frame
+    int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+    switch (special_value) {
+      case BLOSC2_SPECIAL_ZERO:
+      case BLOSC2_SPECIAL_NAN:
+      case BLOSC2_SPECIAL_UNINIT:
+      case BLOSC2_SPECIAL_VIRTUAL:
+        schunk->cbytes += 0;
+        break;
+      default:
+        schunk->cbytes += chunk_cbytes;
+    }
+  }
+
+  // Update super-chunk or frame
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (copy && frame == NULL) {
+    // Make a copy of the chunk (a frame copies it on its own)
+    chunk = copy_chunk(schunk, chunk, chunk_cbytes);
+    BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  if (frame == NULL) {
+    // Check that we are not appending a small chunk after another small chunk
+    if ((schunk->nchunks > 1) && (chunk_nbytes < schunk->chunksize)) {
+      uint8_t* last_chunk = schunk->data[nchunks - 1];
+      int32_t last_nbytes;
+      rc = blosc2_cbuffer_sizes(last_chunk, &last_nbytes, NULL, NULL);
+      if (rc < 0) {
+        return rc;
+      }
+      if ((last_nbytes < schunk->chunksize) && (chunk_nbytes < schunk->chunksize)) {
+        BLOSC_TRACE_ERROR(
+                "Appending two consecutive chunks with a chunksize smaller than the schunk chunksize "
+                "is not allowed yet: %d != %d.", chunk_nbytes, schunk->chunksize);
+        return BLOSC2_ERROR_CHUNK_APPEND;
+      }
+    }
+
+    if (!copy && (chunk_cbytes < chunk_nbytes)) {
+      // We still want to do a shrink of the chunk
+      chunk = shrink_chunk(schunk, chunk, chunk_cbytes);
+      BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+
+    /* Make space for appending the copy of the chunk and do it */
+    BLOSC_ERROR(grow_data(schunk, nchunks + 1));
+    schunk->data[nchunks] = chunk;
+  }
+  else {
+    void* rc_frame = frame_append_chunk(frame, chunk, schunk);
+    // The chunk is ours either way
+    if (!copy) {
+      free(chunk);
+    }
+    if (rc_frame == NULL) {
+      BLOSC_TRACE_ERROR("Problems appending a chunk.");
+      return BLOSC2_ERROR_CHUNK_APPEND;
+    }
+  }
+  BLOSC_ERROR(changes_record(schunk, nchunks, 0, 1));
+  tiering_on_append(schunk);
+  return schunk->nchunks;
+}
+
+
+/* The chunks of `src` can only go as they are into `schunk` when they reference the same
+   shared dictionary, if any */
+static bool same_shared_dict(blosc2_schunk *schunk, blosc2_schunk *src) {
+  if (blosc2_vlmeta_exists(src, SHARED_DICT_VLMETA) < 0) {
+    return true;
+  }
+  if (blosc2_vlmeta_exists(schunk, SHARED_DICT_VLMETA) < 0) {
+    return false;
+  }
+  uint8_t *content, *src_content;
+  int32_t content_len, src_content_len;
+  if (blosc2_vlmeta_get(schunk, SHARED_DICT_VLMETA, &content, &content_len) < 0) {
+    return false;
+  }
+  if (blosc2_vlmeta_get(src, SHARED_DICT_VLMETA, &src_content, &src_content_len) < 0) {
+    free(content);
+    return false;
+  }
+  bool same = content_len == src_content_len && memcmp(content, src_content, content_len) == 0;
+  free(src_content);
+  free(content);
+  return same;
+}
+
+/* Append the chunks of `src` to `schunk`, with no recompression. */
+int64_t blosc2_schunk_concat(blosc2_schunk *schunk, blosc2_schunk *src) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(src, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(check_no_concurrent_reads(schunk));
+  BLOSC_ERROR(check_no_concurrent_writes(schunk));
+  BLOSC_ERROR(check_no_xdelta(schunk));
+  BLOSC_ERROR(check_no_xdelta(src));
+  if (schunk == src) {
+    BLOSC_TRACE_ERROR("A super-chunk cannot be concatenated to itself.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (src->nchunks == 0) {
+    return schunk->nchunks;
+  }
+  if (schunk->typesize != src->typesize) {
+    BLOSC_TRACE_ERROR("Cannot concatenate super-chunks with different typesizes: %d != %d.",
+                      schunk->typesize, src->typesize);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (schunk->nchunks > 0 && (src->chunksize != schunk->chunksize ||
+                              schunk->nbytes != schunk->nchunks * schunk->chunksize)) {
+    // Only the last chunk of a super-chunk can be smaller
+    BLOSC_TRACE_ERROR("Cannot concatenate super-chunks with different chunksizes, or after a smaller chunk.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (!same_shared_dict(schunk, src)) {
+    BLOSC_TRACE_ERROR("The chunks to concatenate reference another shared dictionary.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int64_t nchunks = schunk->nchunks;
+
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  blosc2_frame_s* src_frame = (blosc2_frame_s*)src->frame;
+  if (frame != NULL && !frame->sframe && src_frame != NULL && !src_frame->sframe &&
+      src_frame->chunk_align >= frame->chunk_align) {
+    // The chunks and the offsets of contiguous frames are merged in one go (as long as
+    // the chunks of `src` are aligned to the boundaries of `schunk`)
+    if (schunk->chunksize == -1) {
+      schunk->chunksize = src->chunksize;
+    }
+    BLOSC_ERROR(frame_concat_chunks(frame, src_frame));
+    BLOSC_ERROR(changes_record(schunk, nchunks, 0, src->nchunks));
+  }
+  else {
+    // Defer the update of the offsets, header and trailer of on-disk frames to the end
+    // (unless the caller is in a bulk append already)
+    bool bulk = frame != NULL && frame->bulk;
+    if (!bulk) {
+      blosc2_schunk_begin_bulk(schunk);
+    }
+    for (int64_t nchunk = 0; nchunk < src->nchunks; nchunk++) {
+      uint8_t *chunk;
+      bool needs_free;
+      int rc = blosc2_schunk_get_chunk(src, nchunk, &chunk, &needs_free);
+      if (rc < 0) {
+        BLOSC_TRACE_ERROR("Cannot get the chunk %" PRId64 ".", nchunk);
+        return rc;
+      }
+      int64_t nchunks_ = blosc2_schunk_append_chunk(schunk, chunk, !needs_free);
+      if (nchunks_ < 0) {
+        if (!bulk) {
+          blosc2_schunk_commit_bulk(schunk);
+        }
+        return nchunks_;
+      }
+    }
+    if (!bulk) {
+      BLOSC_ERROR(blosc2_schunk_commit_bulk(schunk));
+    }
+  }
+
+  // The zone maps of the chunks go along, when they are of the same kind
+  zonemap_records records;
+  BLOSC_ERROR(zonemap_records_load(src, &records));
+  int rc = BLOSC2_ERROR_SUCCESS;
+  if (records.content != NULL && records.nrecords > 0 &&
+      records.kind == schunk->cctx->zonemap && records.typesize == schunk->cctx->typesize) {
+    rc = zonemap_splice(schunk, nchunks, 0, records.content + ZONEMAP_HEADER_SIZE,
+                        records.content_len - ZONEMAP_HEADER_SIZE);
+  }
+  zonemap_records_free(&records);
+  if (rc < 0) {
+    return rc;
+  }
+
+  // And so do the Bloom filters, when they index the same keys in the same way
+  bloom_index src_bloom, bloom;
+  BLOSC_ERROR(bloom_index_load(src, &src_bloom));
+  rc = bloom_index_load(schunk, &bloom);
+  if (rc >= 0 && src_bloom.nrecords > 0 && bloom.content != NULL && src_bloom.nhashes == bloom.nhashes &&
+      src_bloom.typesize == bloom.typesize && src_bloom.filter_len == bloom.filter_len) {
+    rc = bloom_index_splice(schunk, &bloom, nchunks, 0, src_bloom.content + BLOOM_HEADER_SIZE,
+                            src_bloom.nrecords);
+  }
+  bloom_index_free(&src_bloom);
+  bloom_index_free(&bloom);
+  if (rc < 0) {
+    return rc;
+  }
+
+  return schunk->nchunks;
+}
+
+
+/* Insert an existing @p chunk in a specified position on a super-chunk */
+int64_t blosc2_schunk_insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
+  BLOSC_ERROR(check_not_read_only(schunk));
+  BLOSC_ERROR(check_no_concurrent_reads(schunk));
+  BLOSC_ERROR(check_no_concurrent_writes(schunk));
+  BLOSC_ERROR(check_no_xdelta(schunk));
+  int32_t chunk_nbytes;
+  int32_t chunk_cbytes;
+  int64_t nchunks = schunk->nchunks;
+
+  int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    return rc;
+  }
+
+  if (schunk->chunksize == -1) {
+    schunk->chunksize = chunk_nbytes;  // The super-chunk is initialized now
+  }
+
+  if (chunk_nbytes > schunk->chunksize) {
+    BLOSC_TRACE_ERROR("Inserting chunks that have different lengths in the same schunk "
+                      "is not supported yet: %d > %d.", chunk_nbytes, schunk->chunksize);
+    return BLOSC2_ERROR_CHUNK_INSERT;
+  }
+  /* The chunks after nchunk are shifted */
+  schunk_invalidate_reads(schunk, -1);
+
+  /* Update counters */
+  schunk->current_nchunk = nchunk;
+  schunk->nchunks = nchunks + 1;
+  schunk->nbytes += chunk_nbytes;
+  if (schunk->frame == NULL) {
+    schunk->cbytes += chunk_cbytes;
+  } else {
+    // A frame
+    int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+    switch (special_value) {
+      case BLOSC2_SPECIAL_ZERO:
+      case BLOSC2_SPECIAL_NAN:
+      case BLOSC2_SPECIAL_UNINIT:
+      case BLOSC2_SPECIAL_VIRTUAL:
+        schunk->cbytes += 0;
+        break;
+      default:
+        schunk->cbytes += chunk_cbytes;
+    }
+  }
+
+  if (copy) {
+    // Make a copy of the chunk
+    chunk = copy_chunk(schunk, chunk, chunk_cbytes);
+    BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+
+  // Update super-chunk or frame
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame == NULL) {
+    // Check that we are not appending a small chunk after another small chunk
+    if ((schunk->nchunks > 0) && (chunk_nbytes < schunk->chunksize)) {
+      uint8_t* last_chunk = schunk->data[nchunks - 1];
+      int32_t last_nbytes;
+      rc = blosc2_cbuffer_sizes(last_chunk, &last_nbytes, NULL, NULL);
+      if (rc < 0) {
+        return rc;
+      }
+      if ((last_nbytes < schunk->chunksize) && (chunk_nbytes < schunk->chunksize)) {
+        BLOSC_TRACE_ERROR("Appending two consecutive chunks with a chunksize smaller "
+                          "than the schunk chunksize is not allowed yet:  %d != %d",
+                          chunk_nbytes, schunk->chunksize);
+        return BLOSC2_ERROR_CHUNK_APPEND;
+      }
+    }
+
+    if (!copy && (chunk_cbytes < chunk_nbytes)) {
+      // We still want to do a shrink of the chunk
+      chunk = shrink_chunk(schunk, chunk, chunk_cbytes);
+      BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+
+    // Make space for appending the copy of the chunk and do it
+    BLOSC_ERROR(grow_data(schunk, nchunks + 1));
+
+    // Reorder the offsets and insert the new chunk
+    for (int64_t i = nchunks; i > nchunk; --i) {
+      schunk->data[i] = schunk->data[i-1];
+    }
+    schunk->data[nchunk] = chunk;
+  }
+
+  else {
+    if (frame_insert_chunk(frame, nchunk, chunk, schunk) == NULL) {
+      BLOSC_TRACE_ERROR("Problems inserting a chunk in a frame.");
+      return BLOSC2_ERROR_CHUNK_INSERT;
+    }
+  }
+  // The chunk comes with no zone maps nor Bloom filter
+  BLOSC_ERROR(zonemap_invalidate(schunk, nchunk, 0));
+  BLOSC_ERROR(bloom_invalidate(schunk, nchunk, 0, 1));
+  BLOSC_ERROR(changes_record(schunk, nchunk, 0, 1));
+  return schunk->nchunks;
+}
+
+
+int64_t blosc2_schunk_update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
+  BLOSC_ERROR(check_not_read_only(schunk));
+  BLOSC_ERROR(check_no_concurrent_reads(schunk));
+  BLOSC_ERROR(check_no_xdelta(schunk));
+  if (schunk->cctx_pool != NULL) {
+    // The chunk goes to a file of its own, and only the index of the frame is updated in turns
+    int64_t nchunks = frame_put_chunk((blosc2_frame_s*)schunk->frame, nchunk, chunk);
+    if (!copy) {
+      free(chunk);
+    }
+    return nchunks;
+  }
+  int32_t chunk_nbytes;
+  int32_t chunk_cbytes;
+
+  int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
+  if (rc < 0) {
+    return rc;
+  }
+
+  if (schunk->chunksize == -1) {
+    schunk->chunksize = chunk_nbytes;  // The super-chunk is initialized now
+  }
+
+  if (schunk->chunksize != 0 && (chunk_nbytes > schunk->chunksize ||
+      (chunk_nbytes < schunk->chunksize && nchunk != schunk->nchunks - 1))) {
+    BLOSC_TRACE_ERROR("Updating chunks that have different lengths in the same schunk "
+                      "is not supported yet (unless it's the last one and smaller):"
+                      " %d > %d.", chunk_nbytes, schunk->chunksize);
+    return BLOSC2_ERROR_CHUNK_UPDATE;
+  }
+  schunk_invalidate_reads(schunk, nchunk);
+
+  bool needs_free;
+  uint8_t *chunk_old;
+  int err = blosc2_schunk_get_chunk(schunk, nchunk, &chunk_old, &needs_free);
+  if (err < 0) {
+    BLOSC_TRACE_ERROR("%" PRId64 " chunk can not be obtained from schunk.", nchunk);
+    return -1;
+  }
+  int32_t chunk_nbytes_old = 0;
+  int32_t chunk_cbytes_old = 0;
+  schunk->current_nchunk = nchunk;
+
+  if (chunk_old != 0) {
+    rc = blosc2_cbuffer_sizes(chunk_old, &chunk_nbytes_old, &chunk_cbytes_old, NULL);
+    if (rc < 0) {
+      return rc;
+    }
+    if (chunk_cbytes_old == BLOSC2_MAX_OVERHEAD) {
+        chunk_cbytes_old = 0;
+    }
+  }
+  if (needs_free) {
+    free(chunk_old);
+  }
+
+  if (copy) {
+    // Make a copy of the chunk
+    chunk = copy_chunk(schunk, chunk, chunk_cbytes);
+    BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+
+  blosc2_frame_s* frame = (blosc2_frame_s*)(schunk->frame);
+  if (schunk->frame == NULL) {
+    /* Update counters */
+    schunk->nbytes += chunk_nbytes;
+    schunk->nbytes -= chunk_nbytes_old;
+    schunk->cbytes += chunk_cbytes;
+    schunk->cbytes -= chunk_cbytes_old;
+  } else {
+    // A frame
+    int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+    switch (special_value) {
+      case BLOSC2_SPECIAL_ZERO:
+      case BLOSC2_SPECIAL_NAN:
+      case BLOSC2_SPECIAL_UNINIT:
+      case BLOSC2_SPECIAL_VIRTUAL:
+        schunk->nbytes += chunk_nbytes;
+        schunk->nbytes -= chunk_nbytes_old;
+        if (frame->sframe) {
+          schunk->cbytes -= chunk_cbytes_old;
+        }
+        break;
+      default:
+        /* Update counters */
+        schunk->nbytes += chunk_nbytes;
+        schunk->nbytes -= chunk_nbytes_old;
+        if (frame->sframe) {
+          schunk->cbytes += chunk_cbytes;
+          schunk->cbytes -= chunk_cbytes_old;
+        }
+        // else, the frame works out whether the chunk goes to the slot of the old one
+    }
+  }
+
+  // Update super-chunk or frame
+  if (schunk->frame == NULL) {
+    if (!copy && (chunk_cbytes < chunk_nbytes)) {
+      // We still want to do a shrink of the chunk
+      chunk = shrink_chunk(schunk, chunk, chunk_cbytes);
+      BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+    }
+
+    // Free old chunk and add reference to new chunk
+    if (schunk->data[nchunk] != 0) {
+      free_chunk(schunk, schunk->data[nchunk]);
+    }
+    schunk->data[nchunk] = chunk;
+  }
+  else {
+    if (frame_update_chunk(frame, nchunk, chunk, schunk) == NULL) {
+        BLOSC_TRACE_ERROR("Problems updating a chunk in a frame.");
+        return BLOSC2_ERROR_CHUNK_UPDATE;
+    }
+  }
+  BLOSC_ERROR(zonemap_invalidate(schunk, nchunk, 1));
+  BLOSC_ERROR(bloom_invalidate(schunk, nchunk, 1, 1));
+  BLOSC_ERROR(changes_record(schunk, nchunk, 1, 1));
+
+  return schunk->nchunks;
+}
+
+int64_t blosc2_schunk_delete_chunk(blosc2_schunk *schunk, int64_t nchunk) {
+  BLOSC_ERROR(check_not_read_only(schunk));
+  BLOSC_ERROR(check_no_concurrent_reads(schunk));
+  BLOSC_ERROR(check_no_concurrent_writes(schunk));
+  if (nchunk != schunk->nchunks - 1) {
+    // The chunk after would lose its reference
+    BLOSC_ERROR(check_no_xdelta(schunk));
+  }
+  int rc;
+  if (schunk->nchunks < nchunk) {
+    BLOSC_TRACE_ERROR("The schunk has not enough chunks (%" PRId64 ")!", schunk->nchunks);
+  }
+  /* The chunks after nchunk are shifted */
+  schunk_invalidate_reads(schunk, -1);
+
+  bool needs_free;
+  uint8_t *chunk_old;
+  int err = blosc2_schunk_get_chunk(schunk, nchunk, &chunk_old, &needs_free);
+  if (err < 0) {
+    BLOSC_TRACE_ERROR("%" PRId64 "chunk can not be obtained from schunk.", nchunk);
+    return -1;
+  }
+  int32_t chunk_nbytes_old = 0;
+  int32_t chunk_cbytes_old = 0;
+  schunk->current_nchunk = nchunk;
+
+  if (chunk_old != 0) {
+    rc = blosc2_cbuffer_sizes(chunk_old, &chunk_nbytes_old, &chunk_cbytes_old, NULL);
+    if (rc < 0) {
+      return rc;
+    }
+    if (chunk_cbytes_old == BLOSC2_MAX_OVERHEAD) {
+      chunk_cbytes_old = 0;
+    }
+  }
+  if (needs_free) {
+    free(chunk_old);
+  }
+
+  blosc2_frame_s* frame = (blosc2_frame_s*)(schunk->frame);
+  schunk->nchunks -= 1;
+  if (schunk->frame == NULL) {
+    /* Update counters */
+    schunk->nbytes -= chunk_nbytes_old;
+    schunk->cbytes -= chunk_cbytes_old;
+  } else {
+    // A frame
+    schunk->nbytes -= chunk_nbytes_old;
+    if (frame->sframe) {
+      schunk->cbytes -= chunk_cbytes_old;
+    }
+  }
+
+  // Update super-chunk or frame
+  if (schunk->frame == NULL) {
+    // Free old chunk
+    if (schunk->data[nchunk] != 0) {
+      free_chunk(schunk, schunk->data[nchunk]);
+    }
+    // Reorder the offsets and insert the new chunk
+    for (int64_t i = nchunk; i < schunk->nchunks; i++) {
+      schunk->data[i] = schunk->data[i + 1];
+    }
+    schunk->data[schunk->nchunks] = NULL;
+
+  }
+  else {
+    if (frame_delete_chunk(frame, nchunk, schunk) == NULL) {
+      BLOSC_TRACE_ERROR("Problems deleting a chunk in a frame.");
+      return BLOSC2_ERROR_CHUNK_UPDATE;
+    }
+  }
+  BLOSC_ERROR(zonemap_splice(schunk, nchunk, 1, NULL, 0));
+  BLOSC_ERROR(bloom_invalidate(schunk, nchunk, 1, 0));
+  BLOSC_ERROR(changes_record(schunk, nchunk, 1, 0));
+  return schunk->nchunks;
+}
+
+
+/* Append a data buffer to a super-chunk. */
+/* Decompress a chunk as it is stored (before undoing the deltas between chunks, if any) */
+static int decompress_stored_chunk(blosc2_schunk *schunk, blosc2_context *dctx, int64_t nchunk,
+                                   void *dest, int32_t nbytes) {
+  int32_t chunk_nbytes;
+  int32_t chunk_cbytes;
+  int chunksize;
+  int rc;
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+
+  set_current_nchunk(schunk, nchunk);
+  dctx->nchunk = nchunk;
+  if (frame == NULL) {
+    if (nchunk >= schunk->nchunks) {
+      BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the number of chunks "
+                        "('%" PRId64 "') in super-chunk.", nchunk, schunk->nchunks);
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    uint8_t* src = schunk->data[nchunk];
+    if (src == 0) {
+      return 0;
+    }
+
+    rc = blosc2_cbuffer_sizes(src, &chunk_nbytes, &chunk_cbytes, NULL);
+    if (rc < 0) {
+      return rc;
+    }
+
+    if (nbytes < chunk_nbytes) {
+      BLOSC_TRACE_ERROR("Buffer size is too small for the decompressed buffer "
+                        "('%d' bytes, but '%d' are needed).", nbytes, chunk_nbytes);
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+
+    chunksize = blosc2_decompress_ctx(dctx, src, chunk_cbytes, dest, nbytes);
+    if (chunksize < 0 || chunksize != chunk_nbytes) {
+      BLOSC_TRACE_ERROR("Error in decompressing chunk.");
+      if (chunksize < 0)
+        return chunksize;
+      return BLOSC2_ERROR_FAILURE;
+    }
+  } else {
+    chunksize = frame_decompress_chunk(dctx, frame, nchunk, dest, nbytes);
+    if (chunksize < 0) {
+      return chunksize;
+    }
+  }
+  return chunksize;
+}
+
+
+/* dest[i] ^= src[i] for the n bytes */
+static void xor_into(uint8_t *dest, const uint8_t *src, int32_t n) {
+  for (int32_t i = 0; i < n; i++) {
+    dest[i] ^= src[i];
+  }
+}
+
+
+static int grow_buffer(uint8_t **buffer, int32_t *len, int32_t nbytes) {
+  if (nbytes > *len) {
+    free(*buffer);
+    *len = 0;
+    *buffer = malloc(nbytes > 0 ? nbytes : 1);
+    BLOSC_ERROR_NULL(*buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+    *len = nbytes;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Keep the `nbytes` of src as the decoded chunk `nchunk` */
+static int xdelta_keep(xdelta_state *xd, int64_t nchunk, const void *src, int32_t nbytes) {
+  xd->nchunk = -1;
+  BLOSC_ERROR(grow_buffer(&xd->buffer, &xd->buffer_len, nbytes));
+  memcpy(xd->buffer, src, nbytes);
+  xd->nchunk = nchunk;
+  xd->nbytes = nbytes;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Decode the chunk `nchunk` into the buffer of the deltas, out of the previous ones down to
+ * its keyframe (or to the one in the buffer already).  The mutex has to be held. */
+static int xdelta_seek(blosc2_schunk *schunk, blosc2_context *dctx, int64_t nchunk) {
+  xdelta_state *xd = (xdelta_state *) schunk->xdelta;
+  if (xd->nchunk == nchunk) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int64_t first = nchunk - nchunk % xd->interval;
+  if (xd->nchunk >= first && xd->nchunk < nchunk) {
+    first = xd->nchunk + 1;
+  }
+  for (int64_t i = first; i <= nchunk; i++) {
+    blosc2_chunk_info info;
+    BLOSC_ERROR(blosc2_schunk_get_chunk_info(schunk, i, &info));
+    BLOSC_ERROR(grow_buffer(&xd->tmp, &xd->tmp_len, info.nbytes));
+    int nbytes = decompress_stored_chunk(schunk, dctx, i, xd->tmp, info.nbytes);
+    if (nbytes < 0) {
+      xd->nchunk = -1;
+      return nbytes;
+    }
+    if (i % xd->interval != 0) {
+      xor_into(xd->tmp, xd->buffer, nbytes < xd->nbytes ? nbytes : xd->nbytes);
+    }
+    uint8_t *buffer = xd->buffer;
+    int32_t buffer_len = xd->buffer_len;
+    xd->buffer = xd->tmp;
+    xd->buffer_len = xd->tmp_len;
+    xd->tmp = buffer;
+    xd->tmp_len = buffer_len;
+    xd->nchunk = i;
+    xd->nbytes = nbytes;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Decompress a chunk and undo its delta wrt the previous one */
+static int xdelta_decompress(blosc2_schunk *schunk, blosc2_context *dctx, int64_t nchunk,
+                             void *dest, int32_t nbytes) {
+  xdelta_state *xd = (xdelta_state *) schunk->xdelta;
+  if (nchunk < 0 || nchunk >= schunk->nchunks) {
+    BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the number of chunks "
+                      "('%" PRId64 "') in super-chunk.", nchunk, schunk->nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  pthread_mutex_lock(&xd->mutex);
+  int rc = BLOSC2_ERROR_SUCCESS;
+  if (xd->nchunk == nchunk) {
+    // Read again
+    if (nbytes < xd->nbytes) {
+      BLOSC_TRACE_ERROR("Buffer size is too small for the decompressed buffer "
+                        "('%d' bytes, but '%d' are needed).", nbytes, xd->nbytes);
+      rc = BLOSC2_ERROR_INVALID_PARAM;
+    }
+    else {
+      memcpy(dest, xd->buffer, xd->nbytes);
+      rc = xd->nbytes;
+    }
+    pthread_mutex_unlock(&xd->mutex);
+    return rc;
+  }
+  bool keyframe = nchunk % xd->interval == 0;
+  if (!keyframe) {
+    rc = xdelta_seek(schunk, dctx, nchunk - 1);
+  }
+  if (rc >= 0) {
+    rc = decompress_stored_chunk(schunk, dctx, nchunk, dest, nbytes);
+  }
+  if (rc >= 0) {
+    if (!keyframe) {
+      xor_into(dest, xd->buffer, rc < xd->nbytes ? rc : xd->nbytes);
+    }
+    // So that the next chunk is decoded right away
+    int rc2 = xdelta_keep(xd, nchunk, dest, rc);
+    rc = rc2 < 0 ? rc2 : rc;
+  }
+  pthread_mutex_unlock(&xd->mutex);
+  return rc;
+}
+
+
+/* The delta of the `nbytes` of `src` wrt the chunk before `nchunk` (src itself for keyframes) */
+static int xdelta_encode(blosc2_schunk *schunk, int64_t nchunk, const void *src, int32_t nbytes,
+                         uint8_t **coded) {
+  xdelta_state *xd = (xdelta_state *) schunk->xdelta;
+  *coded = (uint8_t *) src;
+  if (nchunk % xd->interval == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  pthread_mutex_lock(&xd->mutex);
+  int rc = xdelta_seek(schunk, schunk->dctx, nchunk - 1);
+  if (rc >= 0) {
+    *coded = malloc(nbytes > 0 ? nbytes : 1);
+    if (*coded == NULL) {
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    else {
+      memcpy(*coded, src, nbytes);
+      xor_into(*coded, xd->buffer, nbytes < xd->nbytes ? nbytes : xd->nbytes);
+    }
+  }
+  pthread_mutex_unlock(&xd->mutex);
+  return rc;
+}
+
+
+/* Set up the deltas between chunks out of the vlmetalayer of `schunk`, if it has one */
+int schunk_load_xdelta(blosc2_schunk *schunk) {
+  free_xdelta(schunk);
+  if (blosc2_vlmeta_exists(schunk, XDELTA_VLMETA) < 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  uint8_t *content;
+  int32_t content_len;
+  BLOSC_ERROR(blosc2_vlmeta_get(schunk, XDELTA_VLMETA, &content, &content_len));
+  int32_t interval = content_len == XDELTA_HEADER_SIZE ? sw32_(content + 1) : 0;
+  bool known = content_len == XDELTA_HEADER_SIZE && content[0] == XDELTA_VERSION && interval >= 2;
+  free(content);
+  if (!known) {
+    BLOSC_TRACE_ERROR("Unknown format of the deltas between chunks.");
+    return BLOSC2_ERROR_DATA;
+  }
+  xdelta_state *xd = calloc(1, sizeof(xdelta_state));
+  BLOSC_ERROR_NULL(xd, BLOSC2_ERROR_MEMORY_ALLOC);
+  xd->interval = interval;
+  xd->nchunk = -1;
+  pthread_mutex_init(&xd->mutex, NULL);
+  schunk->xdelta = xd;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_schunk_set_xdelta(blosc2_schunk *schunk, int32_t keyframe_interval) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  if (keyframe_interval < 0 || keyframe_interval == 1) {
+    BLOSC_TRACE_ERROR("The keyframes have to be 2 chunks apart at least (or 0 for no deltas).");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (schunk->nchunks > 0) {
+    BLOSC_TRACE_ERROR("The deltas between chunks can only be set up before appending any chunk.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  bool exists = blosc2_vlmeta_exists(schunk, XDELTA_VLMETA) >= 0;
+  if (keyframe_interval == 0) {
+    free_xdelta(schunk);
+    if (!exists) {
+      return BLOSC2_ERROR_SUCCESS;
+    }
+    int rc = blosc2_vlmeta_delete(schunk, XDELTA_VLMETA);
+    return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+  }
+  if (schunk->cctx_pool != NULL || schunk->cctx->zonemap != BLOSC2_ZONEMAP_NONE ||
+      schunk->cctx->prefilter != NULL || schunk->dctx->postfilter != NULL ||
+      schunk->dctx->block_postfilter != NULL) {
+    BLOSC_TRACE_ERROR("The deltas between chunks cannot be used with concurrent writes, zone maps, "
+                      "prefilters or postfilters.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  uint8_t content[XDELTA_HEADER_SIZE];
+  content[0] = XDELTA_VERSION;
+  _sw32(content + 1, keyframe_interval);
+  int rc;
+  if (exists) {
+    rc = blosc2_vlmeta_update(schunk, XDELTA_VLMETA, content, XDELTA_HEADER_SIZE, NULL);
+  }
+  else {
+    rc = blosc2_vlmeta_add(schunk, XDELTA_VLMETA, content, XDELTA_HEADER_SIZE, NULL);
+  }
+  if (rc < 0) {
+    return rc;
+  }
+  return schunk_load_xdelta(schunk);
+}
+
+
+int64_t blosc2_schunk_append_buffer(blosc2_schunk *schunk, void *src, int32_t nbytes) {
+  // Do not compress anything for read-only super-chunks
+  BLOSC_ERROR(check_not_read_only(schunk));
+  // Concurrent writers compress with contexts of their own, and nothing is recorded
+  blosc2_context *cctx = schunk->cctx;
+  bool concurrent = schunk->cctx_pool != NULL;
+  if (concurrent) {
+    cctx = acquire_ctx(schunk, (ctx_pool *) schunk->cctx_pool);
+    BLOSC_ERROR_NULL(cctx, BLOSC2_ERROR_NULL_POINTER);
+  }
+  else {
+    schunk->current_nchunk = schunk->nchunks;
+  }
+  int32_t destsize = nbytes + BLOSC2_MAX_OVERHEAD + trailer_maxlen(cctx->checksum, cctx->cipher, nbytes, cctx->blocksize);
+  // The chunks that go to the arena or to a frame are compressed in a scratch buffer, and copied there
+  // (the concurrent writers have no single one to share)
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  chunk_arena *arena = frame == NULL ? (chunk_arena *) schunk->chunk_arena : NULL;
+  bool scratch = (arena != NULL && arena->slab_size > 0) || (frame != NULL && !concurrent);
+  uint8_t* chunk;
+  if (scratch && frame != NULL) {
+    BLOSC_ERROR(grow_buffer(&frame->append_scratch, &frame->append_scratch_len, destsize));
+    chunk = frame->append_scratch;
+  }
+  else if (scratch) {
+    BLOSC_ERROR(grow_buffer(&arena->scratch, &arena->scratch_len, destsize));
+    chunk = arena->scratch;
+  }
+  else {
+    chunk = malloc(destsize);
+    BLOSC_ERROR_NULL(chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+  }
+  // Super-chunks with deltas between chunks have no concurrent writers
+  uint8_t *coded = src;
+  if (schunk->xdelta != NULL) {
+    int rc = xdelta_encode(schunk, schunk->nchunks, src, nbytes, &coded);
+    if (rc < 0) {
+      if (!scratch) {
+        free(chunk);
+      }
+      return rc;
+    }
+  }
+  blosc_timestamp_t last, current;
+  blosc_set_timestamp(&last);
+  /* Compress the src buffer using super-chunk context */
+  int cbytes = blosc2_compress_ctx(cctx, coded, nbytes, chunk, destsize);
+  if (concurrent) {
+    release_ctx((ctx_pool *) schunk->cctx_pool, cctx);
+  }
+  if (coded != src) {
+    free(coded);
+  }
+  if (cbytes < 0) {
+    if (!scratch) {
+      free(chunk);
+    }
+    return cbytes;
+  }
+  blosc_set_timestamp(&current);
+  if (!concurrent && schunk->cctx->record_stats) {
+    int rc = schunk_record_stats(schunk, schunk->nchunks, src, chunk, blosc_elapsed_secs(last, current));
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Error recording the stats of the chunk");
+      if (!scratch) {
+        free(chunk);
+      }
+      return rc;
+    }
+  }
+  if (!concurrent && schunk->cctx->zonemap != BLOSC2_ZONEMAP_NONE) {
+    int rc = schunk_record_zonemap(schunk, schunk->nchunks, src, chunk);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Error recording the zone maps of the chunk");
+      if (!scratch) {
+        free(chunk);
+      }
+      return rc;
+    }
+  }
+  // The special chunks of super-chunks with deltas between chunks are not made of a single value
+  int special = schunk->xdelta != NULL ? BLOSC2_NO_SPECIAL
+                                       : (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  // We don't need a copy of the chunk, as it will be shrunk if necessary (but for the scratch one)
+  int64_t nchunks = blosc2_schunk_append_chunk(schunk, chunk, scratch);
+  if (nchunks < 0) {
+    BLOSC_TRACE_ERROR("Error appending a buffer in super-chunk");
+    return nchunks;
+  }
+  if (concurrent) {
+    return nchunks;
+  }
+  int rc = schunk_record_bloom(schunk, nchunks - 1, src, nbytes, special);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Error recording the Bloom filter of the chunk");
+    return rc;
+  }
+  rc = schunk_save_tuner(schunk);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Error keeping the state of the tuner");
+    return rc;
+  }
+  if (schunk->xdelta != NULL) {
+    // The reference of the next chunk
+    xdelta_state *xd = (xdelta_state *) schunk->xdelta;
+    pthread_mutex_lock(&xd->mutex);
+    rc = xdelta_keep(xd, nchunks - 1, src, nbytes);
+    pthread_mutex_unlock(&xd->mutex);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  return nchunks;
+}
+
+
+int64_t blosc2_schunk_append_borrowed(blosc2_schunk *schunk, void *buffer, int32_t nbytes,
+                                      blosc2_release_cb release, void *params) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR(check_not_read_only(schunk));
+  BLOSC_ERROR(check_no_xdelta(schunk));
+  if (schunk->frame != NULL || schunk->cctx_pool != NULL) {
+    BLOSC_TRACE_ERROR("The borrowed chunks are for super-chunks in memory without a frame (nor concurrent writers).");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  borrowed_chunks *borrowed = (borrowed_chunks *) schunk->borrowed_chunks;
+  if (borrowed == NULL) {
+    borrowed = calloc(1, sizeof(borrowed_chunks));
+    BLOSC_ERROR_NULL(borrowed, BLOSC2_ERROR_MEMORY_ALLOC);
+    schunk->borrowed_chunks = borrowed;
+  }
+  if (find_borrowed(borrowed, buffer) >= 0) {
+    BLOSC_TRACE_ERROR("The buffer is in the super-chunk already.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  // Make room for the entry first, so that nothing can fail once the chunk is in
+  if (borrowed->nchunks == borrowed->max_nchunks) {
+    int64_t max_nchunks = borrowed->max_nchunks > 0 ? 2 * borrowed->max_nchunks : 16;
+    borrowed_chunk *chunks = realloc(borrowed->chunks, max_nchunks * sizeof(borrowed_chunk));
+    BLOSC_ERROR_NULL(chunks, BLOSC2_ERROR_MEMORY_ALLOC);
+    borrowed->chunks = chunks;
+    borrowed->max_nchunks = max_nchunks;
+  }
+
+  // The buffer becomes a memcpyed chunk with its header in the room before the data
+  blosc2_cparams cparams;
+  BLOSC_ERROR(blosc2_ctx_get_cparams(schunk->cctx, &cparams));
+  BLOSC_ERROR(chunk_memcpyed_header(cparams, nbytes, buffer));
+  int64_t nchunks = blosc2_schunk_append_chunk(schunk, buffer, false);
+  if (nchunks < 0) {
+    return nchunks;
+  }
+  int64_t i = -find_borrowed(borrowed, buffer) - 1;
+  memmove(borrowed->chunks + i + 1, borrowed->chunks + i, (borrowed->nchunks - i) * sizeof(borrowed_chunk));
+  borrowed->chunks[i].chunk = buffer;
+  borrowed->chunks[i].release = release;
+  borrowed->chunks[i].params = params;
+  borrowed->nchunks++;
+
+  return nchunks;
+}
+
+
+int schunk_decompress_chunk_ctx(blosc2_schunk *schunk, blosc2_context *dctx, int64_t nchunk,
+                                void *dest, int32_t nbytes) {
+  if (schunk->xdelta != NULL) {
+    return xdelta_decompress(schunk, dctx, nchunk, dest, nbytes);
+  }
+  return decompress_stored_chunk(schunk, dctx, nchunk, dest, nbytes);
+}
+
+
+/* Decompress and return a chunk that is part of a super-chunk. */
+int blosc2_schunk_decompress_chunk(blosc2_schunk *schunk, int64_t nchunk,
+                                   void *dest, int32_t nbytes) {
+  blosc2_context *dctx = schunk_acquire_dctx(schunk);
+  BLOSC_ERROR_NULL(dctx, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = schunk_decompress_chunk_ctx(schunk, dctx, nchunk, dest, nbytes);
+  schunk_release_dctx(schunk, dctx);
+  return rc;
+}
+
+
+/* Chunks of a batch that are read (by its first job) while the other jobs decompress them */
+typedef struct {
+  blosc2_frame_s *frame;
+  int64_t nchunk;  /* the chunk of the first item */
+  int32_t *cbytes;
+  bool *needs_free;
+  int32_t *ready;  /* the items, in the order they have been fetched */
+  int32_t nready;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} chunk_fetch;
+
+/* State shared by the jobs of a batched (de-)compression */
+typedef struct {
+  int nitems;
+  volatile int32_t next_item;  /* the next item to be processed */
+  uint8_t **srcs;
+  const int32_t *srcsizes;
+  uint8_t **dests;
+  const int32_t *destsizes;
+  int *rcs;  /* the result for every item */
+  chunk_fetch *fetch;  /* NULL if the srcs are already there */
+} chunk_batch;
+
+/* A job processing items of a chunk_batch with its own (single-threaded) context */
+typedef struct {
+  blosc2_context *ctx;
+  chunk_batch *batch;
+  bool first;
+} chunk_job;
+
+static void compress_chunks_job(void *data) {
+  chunk_job *job = (chunk_job *)data;
+  chunk_batch *batch = job->batch;
+  int32_t i;
+  while ((i = blosc_atomic_add32(&batch->next_item, 1)) < batch->nitems) {
+    batch->rcs[i] = blosc2_compress_ctx(job->ctx, batch->srcs[i], batch->srcsizes[i],
+                                        batch->dests[i], batch->destsizes[i]);
+  }
+}
+
+static void chunk_fetched(int64_t nchunk, uint8_t *chunk, int32_t cbytes, bool needs_free,
+                          void *user_data) {
+  chunk_batch *batch = (chunk_batch *)user_data;
+  chunk_fetch *fetch = batch->fetch;
+  int32_t i = (int32_t)(nchunk - fetch->nchunk);
+  batch->srcs[i] = cbytes > 0 ? chunk : NULL;
+  fetch->cbytes[i] = cbytes;
+  fetch->needs_free[i] = needs_free;
+  pthread_mutex_lock(&fetch->mutex);
+  fetch->ready[fetch->nready++] = i;
+  pthread_cond_broadcast(&fetch->cond);
+  pthread_mutex_unlock(&fetch->mutex);
+}
+
+/* The next item to be decompressed, in the order the chunks are fetched */
+static int32_t next_decompress_item(chunk_batch *batch) {
+  chunk_fetch *fetch = batch->fetch;
+  if (fetch == NULL) {
+    return blosc_atomic_add32(&batch->next_item, 1);
+  }
+  pthread_mutex_lock(&fetch->mutex);
+  while (batch->next_item < batch->nitems && batch->next_item >= fetch->nready) {
+    pthread_cond_wait(&fetch->cond, &fetch->mutex);
+  }
+  int32_t i = batch->nitems;
+  if (batch->next_item < batch->nitems) {
+    i = fetch->ready[batch->next_item++];
+  }
+  pthread_mutex_unlock(&fetch->mutex);
+  return i;
+}
+
+static void decompress_chunks_job(void *data) {
+  chunk_job *job = (chunk_job *)data;
+  chunk_batch *batch = job->batch;
+  int32_t i;
+  if (batch->fetch != NULL && job->first) {
+    /* The first job is started before the rest, so they can wait for the chunks it fetches */
+    frame_prefetch_chunks(batch->fetch->frame, batch->fetch->nchunk, batch->fetch->nchunk + batch->nitems,
+                          chunk_fetched, batch);
+  }
+  while ((i = next_decompress_item(batch)) < batch->nitems) {
+    if (batch->srcsizes[i] < 0) {
+      /* The chunk could not be fetched */
+      batch->rcs[i] = batch->srcsizes[i];
+      continue;
+    }
+    if (batch->srcs[i] == NULL) {
+      /* Non-initialized chunk */
+      batch->rcs[i] = 0;
+      continue;
+    }
+    batch->rcs[i] = blosc2_decompress_ctx(job->ctx, batch->srcs[i], batch->srcsizes[i],
+                                          batch->dests[i], batch->destsizes[i]);
+  }
+}
+
+/* Run a batch on the shared pool, using one context per participating thread */
+static int run_chunk_batch(chunk_batch *batch, void (*dojob)(void *),
+                           blosc2_cparams *cparams, blosc2_dparams *dparams) {
+  int njobs = blosc_pool_nthreads() + 1;
+  if (njobs > batch->nitems) {
+    njobs = batch->nitems;
+  }
+  chunk_job *jobs = calloc(njobs, sizeof(chunk_job));
+  BLOSC_ERROR_NULL(jobs, BLOSC2_ERROR_MEMORY_ALLOC);
+
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int i = 0; i < njobs; i++) {
+    jobs[i].batch = batch;
+    jobs[i].first = (i == 0);
+    jobs[i].ctx = (cparams != NULL) ? blosc2_create_cctx(*cparams) : blosc2_create_dctx(*dparams);
+    if (jobs[i].ctx == NULL) {
+      BLOSC_TRACE_ERROR("Cannot create a context for the batch.");
+      rc = BLOSC2_ERROR_NULL_POINTER;
+      njobs = i;
+      break;
+    }
+  }
+  if (rc == BLOSC2_ERROR_SUCCESS) {
+    batch->next_item = 0;
+    blosc_pool_run(NULL, dojob, njobs, sizeof(chunk_job), jobs);
+  }
+
+  for (int i = 0; i < njobs; i++) {
+    blosc2_free_ctx(jobs[i].ctx);
+  }
+  free(jobs);
+  return rc;
+}
+
+
+/* Whether the chunks have to be compressed by the super-chunk itself, one after the other:
+   prefilters, dicts, stateful tuners, zone maps and deltas between chunks depend on the state
+   of the super-chunk, and the Bloom filters are built along with the chunks */
+static bool stateful_compression(blosc2_schunk *schunk) {
+  blosc2_context *cctx = schunk->cctx;
+  return cctx->prefilter != NULL || schunk->xdelta != NULL || cctx->use_dict || cctx->tuner_id != BLOSC_STUNE ||
+         cctx->tuner_params != NULL || cctx->zonemap != BLOSC2_ZONEMAP_NONE ||
+         blosc2_vlmeta_exists(schunk, BLOOM_VLMETA) >= 0;
+}
+
+
+/* Append several data buffers to a super-chunk, compressing them in parallel. */
+int64_t blosc2_schunk_append_buffers(blosc2_schunk *schunk, void **srcs, const int32_t *nbytes,
+                                     int nbuffers) {
+  if (nbuffers < 0) {
+    BLOSC_TRACE_ERROR("nbuffers cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  blosc2_context *cctx = schunk->cctx;
+  if (nbuffers < 2 || blosc_pool_nthreads() == 0 || stateful_compression(schunk)) {
+    int64_t nchunks = schunk->nchunks;
+    for (int i = 0; i < nbuffers; i++) {
+      nchunks = blosc2_schunk_append_buffer(schunk, srcs[i], nbytes[i]);
+      if (nchunks < 0) {
+        return nchunks;
+      }
+    }
+    return nchunks;
+  }
+
+  chunk_batch batch = {0};
+  batch.nitems = nbuffers;
+  batch.srcs = (uint8_t **)srcs;
+  batch.srcsizes = nbytes;
+  batch.dests = calloc(nbuffers, sizeof(uint8_t *));
+  int32_t *destsizes = malloc(nbuffers * sizeof(int32_t));
+  batch.destsizes = destsizes;
+  batch.rcs = malloc(nbuffers * sizeof(int));
+  int64_t rc = BLOSC2_ERROR_SUCCESS;
+  if (batch.dests == NULL || destsizes == NULL || batch.rcs == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate the batch of chunks.");
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto end;
+  }
+  for (int i = 0; i < nbuffers; i++) {
+    destsizes[i] = nbytes[i] + BLOSC2_MAX_OVERHEAD +
+                   trailer_maxlen(schunk->cctx->checksum, schunk->cctx->cipher, nbytes[i], schunk->cctx->blocksize);
+    batch.dests[i] = malloc(destsizes[i]);
+    if (batch.dests[i] == NULL) {
+      BLOSC_TRACE_ERROR("Cannot allocate the batch of chunks.");
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      goto end;
+    }
+  }
+
+  blosc2_cparams cparams;
+  blosc2_ctx_get_cparams(cctx, &cparams);
+  cparams.nthreads = 1;
+  rc = run_chunk_batch(&batch, compress_chunks_job, &cparams, NULL);
+  if (rc < 0) {
+    goto end;
+  }
+
+  /* The offsets of the frame must be updated in order */
+  for (int i = 0; i < nbuffers; i++) {
+    if (batch.rcs[i] < 0) {
+      BLOSC_TRACE_ERROR("Error compressing buffer %d of the batch.", i);
+      rc = batch.rcs[i];
+      goto end;
+    }
+    schunk->current_nchunk = schunk->nchunks;
+    // We don't need a copy of the chunk, as it will be shrunk if necessary
+    rc = blosc2_schunk_append_chunk(schunk, batch.dests[i], false);
+    batch.dests[i] = NULL;
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Error appending a buffer in super-chunk");
+      goto end;
+    }
+  }
+
+  end:
+  if (batch.dests != NULL) {
+    for (int i = 0; i < nbuffers; i++) {
+      free(batch.dests[i]);
+    }
+  }
+  free(batch.dests);
+  free(destsizes);
+  free(batch.rcs);
+  return rc;
+}
+
+
+/* A buffer handed over for an asynchronous append */
+typedef struct {
+  uint8_t *src;  // owned by the queue
+  int32_t nbytes;
+  uint8_t *chunk;  // the compressed chunk (NULL when the super-chunk compresses it)
+  int rc;
+  bool ready;  // whether it can be appended
+} append_item;
+
+/* The queue and the workers of the asynchronous appends */
+typedef struct {
+  blosc2_schunk *schunk;
+  int nworkers;
+  pthread_t *workers;
+  blosc2_context **cctxs;  // one per worker (NULL when the super-chunk compresses the chunks)
+  int32_t queue_len;
+  append_item *items;  // a ring of queue_len items, from the oldest one not appended yet
+  int64_t next_append;  // the sequence number of the next item to be appended
+  int64_t next_compress;  // the sequence number of the next item to be taken by a worker
+  int64_t nqueued;  // the sequence number of the next item to be queued
+  int64_t nchunks;  // the chunks that the super-chunk will have once the queue is drained
+  int nstarted;  // the workers that have taken their context
+  bool appending;  // whether a worker is appending (only one at a time, in order)
+  bool end_workers;
+  int error;  // the first error of the appends since the last flush
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cv;  // the workers wait here for items
+  pthread_cond_t space_cv;  // and the producers for room, or for the queue to drain
+} async_appends;
+
+/* Drop an item (queue mutex held) */
+static void drop_item(append_item *item) {
+  free(item->src);
+  free(item->chunk);
+  memset(item, 0, sizeof(append_item));
+}
+
+/* Append the items that are ready, in order (queue mutex held, and released while appending) */
+static void append_ready_items(async_appends *aa) {
+  aa->appending = true;
+  while (aa->next_append < aa->next_compress) {
+    append_item *item = &aa->items[aa->next_append % aa->queue_len];
+    if (!item->ready) {
+      break;
+    }
+    if (aa->error == 0 && item->rc < 0) {
+      aa->error = item->rc;
+    }
+    if (aa->error == 0) {
+      append_item taken = *item;
+      pthread_mutex_unlock(&aa->mutex);
+      blosc2_schunk *schunk = aa->schunk;
+      int64_t rc;
+      if (schunk->chunksize > 0 && taken.nbytes > schunk->chunksize) {
+        // Caught here, so that the chunk is not lost when it cannot be handed over
+        BLOSC_TRACE_ERROR("Appending chunks that have different lengths in the same schunk "
+                          "is not supported yet: %d > %d.", taken.nbytes, schunk->chunksize);
+        rc = BLOSC2_ERROR_CHUNK_APPEND;
+      }
+      else if (taken.chunk == NULL) {
+        rc = blosc2_schunk_append_buffer(schunk, taken.src, taken.nbytes);
+      }
+      else {
+        schunk->current_nchunk = schunk->nchunks;
+        // The chunk is handed over to the super-chunk, which shrinks it if necessary
+        rc = blosc2_schunk_append_chunk(schunk, taken.chunk, false);
+        item->chunk = NULL;
+      }
+      pthread_mutex_lock(&aa->mutex);
+      if (rc < 0) {
+        BLOSC_TRACE_ERROR("Error appending a buffer in the background.");
+        aa->error = (int) rc;
+      }
+    }
+    // After an error, the rest of the items are dropped until the next flush
+    drop_item(item);
+    aa->next_append++;
+    pthread_cond_broadcast(&aa->space_cv);
+  }
+  aa->appending = false;
+}
+
+static void* append_worker(void *arg) {
+  async_appends *aa = (async_appends *) arg;
+  pthread_mutex_lock(&aa->mutex);
+  int nworker = aa->nstarted++;
+  while (1) {
+    while (aa->next_compress == aa->nqueued && !aa->end_workers) {
+      pthread_cond_wait(&aa->work_cv, &aa->mutex);
+    }
+    if (aa->next_compress == aa->nqueued) {
+      break;
+    }
+    append_item *item = &aa->items[aa->next_compress % aa->queue_len];
+    aa->next_compress++;
+    blosc2_context *cctx = aa->cctxs != NULL ? aa->cctxs[nworker] : NULL;
+    if (cctx != NULL && aa->error == 0) {
+      pthread_mutex_unlock(&aa->mutex);
+      int32_t destsize = item->nbytes + BLOSC2_MAX_OVERHEAD +
+                         trailer_maxlen(cctx->checksum, cctx->cipher, item->nbytes, cctx->blocksize);
+      uint8_t *chunk = malloc(destsize);
+      int rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      if (chunk != NULL) {
+        rc = blosc2_compress_ctx(cctx, item->src, item->nbytes, chunk, destsize);
+      }
+      pthread_mutex_lock(&aa->mutex);
+      if (rc < 0) {
+        free(chunk);
+        item->rc = rc;
+      }
+      else {
+        // The source is not needed anymore
+        free(item->src);
+        item->src = NULL;
+        item->chunk = chunk;
+      }
+    }
+    item->ready = true;
+    if (!aa->appending) {
+      append_ready_items(aa);
+    }
+  }
+  pthread_mutex_unlock(&aa->mutex);
+  return NULL;
+}
+
+/* Wait for the queue to drain (queue mutex held), and get the first error since the last flush */
+static int drain_appends(async_appends *aa) {
+  while (aa->next_append < aa->nqueued) {
+    pthread_cond_wait(&aa->space_cv, &aa->mutex);
+  }
+  int rc = aa->error;
+  aa->error = 0;
+  return rc;
+}
+
+static int stop_async_appends(blosc2_schunk *schunk) {
+  async_appends *aa = (async_appends *) schunk->async_appends;
+  if (aa == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  pthread_mutex_lock(&aa->mutex);
+  int rc = drain_appends(aa);
+  aa->end_workers = true;
+  pthread_cond_broadcast(&aa->work_cv);
+  pthread_mutex_unlock(&aa->mutex);
+  for (int i = 0; i < aa->nworkers; i++) {
+    pthread_join(aa->workers[i], NULL);
+  }
+  if (aa->cctxs != NULL) {
+    for (int i = 0; i < aa->nworkers; i++) {
+      blosc2_free_ctx(aa->cctxs[i]);
+    }
+    free(aa->cctxs);
+  }
+  pthread_mutex_destroy(&aa->mutex);
+  pthread_cond_destroy(&aa->work_cv);
+  pthread_cond_destroy(&aa->space_cv);
+  free(aa->workers);
+  free(aa->items);
+  free(aa);
+  schunk->async_appends = NULL;
+  return rc;
+}
+
+
+int blosc2_schunk_set_async_appends(blosc2_schunk *schunk, int nworkers, int32_t queue_len) {
+  if (nworkers < 0 || (nworkers > 0 && queue_len < 1)) {
+    BLOSC_TRACE_ERROR("The asynchronous appends need workers and a queue of one item at least.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int rc = stop_async_appends(schunk);
+  if (rc < 0 || nworkers == 0) {
+    return rc;
+  }
+
+  async_appends *aa = calloc(1, sizeof(async_appends));
+  BLOSC_ERROR_NULL(aa, BLOSC2_ERROR_MEMORY_ALLOC);
+  aa->schunk = schunk;
+  aa->queue_len = queue_len;
+  aa->items = calloc(queue_len, sizeof(append_item));
+  aa->workers = calloc(nworkers, sizeof(pthread_t));
+  if (aa->items == NULL || aa->workers == NULL) {
+    free(aa->items);
+    free(aa->workers);
+    free(aa);
+    BLOSC_TRACE_ERROR("Cannot allocate the queue of the asynchronous appends.");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  pthread_mutex_init(&aa->mutex, NULL);
+  pthread_cond_init(&aa->work_cv, NULL);
+  pthread_cond_init(&aa->space_cv, NULL);
+  schunk->async_appends = aa;
+
+  // The workers compress the chunks on their own when they do not depend on the previous ones
+  if (!stateful_compression(schunk) && !schunk->cctx->record_stats) {
+    aa->cctxs = calloc(nworkers, sizeof(blosc2_context *));
+    if (aa->cctxs == NULL) {
+      stop_async_appends(schunk);
+      BLOSC_TRACE_ERROR("Cannot allocate the contexts of the asynchronous appends.");
+      return BLOSC2_ERROR_MEMORY_ALLOC;
+    }
+    blosc2_cparams cparams;
+    blosc2_ctx_get_cparams(schunk->cctx, &cparams);
+    if (cparams.nthreads > 1) {
+      cparams.nthreads = (int16_t) (cparams.nthreads > nworkers ? cparams.nthreads / nworkers : 1);
+    }
+    for (int i = 0; i < nworkers; i++) {
+      aa->cctxs[i] = blosc2_create_cctx(cparams);
+      if (aa->cctxs[i] == NULL) {
+        aa->nworkers = i;
+        stop_async_appends(schunk);
+        BLOSC_TRACE_ERROR("Cannot create the contexts of the asynchronous appends.");
+        return BLOSC2_ERROR_NULL_POINTER;
+      }
+    }
+  }
+
+  pthread_mutex_lock(&aa->mutex);
+  for (int i = 0; i < nworkers; i++) {
+    int rc2 = pthread_create(&aa->workers[i], NULL, append_worker, aa);
+    if (rc2 != 0) {
+      BLOSC_TRACE_ERROR("Cannot create the workers of the asynchronous appends (%d).", rc2);
+      pthread_mutex_unlock(&aa->mutex);
+      stop_async_appends(schunk);
+      return BLOSC2_ERROR_THREAD_CREATE;
+    }
+    aa->nworkers = i + 1;
+  }
+  pthread_mutex_unlock(&aa->mutex);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t blosc2_schunk_append_buffer_async(blosc2_schunk *schunk, void *src, int32_t nbytes, bool copy, bool wait) {
+  async_appends *aa = (async_appends *) schunk->async_appends;
+  if (aa == NULL) {
+    BLOSC_TRACE_ERROR("The asynchronous appends are not set up (see blosc2_schunk_set_async_appends()).");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (nbytes < 0) {
+    BLOSC_TRACE_ERROR("nbytes cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  uint8_t *item_src = src;
+  if (copy) {
+    item_src = malloc(nbytes > 0 ? nbytes : 1);
+    BLOSC_ERROR_NULL(item_src, BLOSC2_ERROR_MEMORY_ALLOC);
+    memcpy(item_src, src, nbytes);
+  }
+
+  pthread_mutex_lock(&aa->mutex);
+  while (aa->error == 0 && aa->nqueued - aa->next_append == aa->queue_len) {
+    if (!wait) {
+      pthread_mutex_unlock(&aa->mutex);
+      if (copy) {
+        free(item_src);
+      }
+      return BLOSC2_ERROR_QUEUE_FULL;
+    }
+    pthread_cond_wait(&aa->space_cv, &aa->mutex);
+  }
+  if (aa->error < 0) {
+    int rc = aa->error;
+    pthread_mutex_unlock(&aa->mutex);
+    if (copy) {
+      free(item_src);
+    }
+    BLOSC_TRACE_ERROR("A previous asynchronous append failed (see blosc2_schunk_flush_appends()).");
+    return rc;
+  }
+  append_item *item = &aa->items[aa->nqueued % aa->queue_len];
+  item->src = item_src;
+  item->nbytes = nbytes;
+  // Nothing is in flight, so the super-chunk is not being modified
+  if (aa->next_append == aa->nqueued) {
+    aa->nchunks = schunk->nchunks;
+  }
+  aa->nqueued++;
+  int64_t nchunks = ++aa->nchunks;
+  pthread_cond_signal(&aa->work_cv);
+  pthread_mutex_unlock(&aa->mutex);
+
+  return nchunks;
+}
+
+
+int blosc2_schunk_flush_appends(blosc2_schunk *schunk) {
+  async_appends *aa = (async_appends *) schunk->async_appends;
+  if (aa == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  pthread_mutex_lock(&aa->mutex);
+  int rc = drain_appends(aa);
+  pthread_mutex_unlock(&aa->mutex);
+  return rc;
+}
+
+
+/* The recompression of the chunks that turn cold (see blosc2_schunk_set_tiering()) */
+#define TIERING_READ 0x1  // the chunk has been read since it was appended
+#define TIERING_TAKEN 0x2  // the chunk has been taken for recompression
+
+struct tiering_state;
+
+typedef struct tiering_job {
+  struct tiering_state *ts;
+  int64_t nchunk;
+  uint8_t *hot;  // a copy of the chunk as it was taken
+  int32_t hot_cbytes;
+  uint8_t *cold;  // the chunk recompressed (NULL if it failed or it is not smaller)
+  struct tiering_job *next;
+} tiering_job;
+
+typedef struct tiering_state {
+  blosc2_schunk *schunk;
+  blosc2_cparams cparams;
+  int64_t min_age;
+  int64_t idle_appends;
+  uint8_t *flags;  // TIERING_* for every chunk
+  int64_t flags_len;
+  int64_t ninflight;  // the jobs queued or running
+  tiering_job *done;  // the jobs finished, to be swapped in by the thread of the super-chunk
+  pthread_mutex_t mutex;
+  pthread_cond_t done_cv;
+} tiering_state;
+
+
+/* Recompress the chunk of a job (in the shared pool, or in place without it) */
+static void tiering_job_run(void *arg) {
+  tiering_job *job = (tiering_job *) arg;
+  tiering_state *ts = job->ts;
+  int32_t nbytes;
+  uint8_t *buffer = NULL;
+  blosc2_context *dctx = NULL;
+  blosc2_context *cctx = NULL;
+  if (blosc2_cbuffer_sizes(job->hot, &nbytes, NULL, NULL) < 0) {
+    goto out;
+  }
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.schunk = ts->schunk;
+  dctx = blosc2_create_dctx(dparams);
+  cctx = blosc2_create_cctx(ts->cparams);
+  buffer = malloc(nbytes > 0 ? nbytes : 1);
+  if (dctx == NULL || cctx == NULL || buffer == NULL ||
+      blosc2_decompress_ctx(dctx, job->hot, job->hot_cbytes, buffer, nbytes) != nbytes) {
+    goto out;
+  }
+  int32_t destsize = nbytes + BLOSC2_MAX_OVERHEAD + trailer_maxlen(cctx->checksum, cctx->cipher, nbytes, cctx->blocksize);
+  uint8_t *cold = malloc(destsize);
+  if (cold == NULL) {
+    goto out;
+  }
+  int cbytes = blosc2_compress_ctx(cctx, buffer, nbytes, cold, destsize);
+  if (cbytes <= 0 || cbytes >= job->hot_cbytes) {
+    free(cold);
+    goto out;
+  }
+  job->cold = cold;
+
+  out:
+  free(buffer);
+  if (dctx != NULL) {
+    blosc2_free_ctx(dctx);
+  }
+  if (cctx != NULL) {
+    blosc2_free_ctx(cctx);
+  }
+  pthread_mutex_lock(&ts->mutex);
+  job->next = ts->done;
+  ts->done = job;
+  ts->ninflight--;
+  pthread_cond_broadcast(&ts->done_cv);
+  pthread_mutex_unlock(&ts->mutex);
+}
+
+
+/* Take the chunk `nchunk` for recompression, unless it is taken already or there is nothing to gain */
+static void tiering_take(blosc2_schunk *schunk, tiering_state *ts, int64_t nchunk) {
+  if (ts->flags[nchunk] & TIERING_TAKEN) {
+    return;
+  }
+  ts->flags[nchunk] |= TIERING_TAKEN;
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free);
+  if (cbytes < 0) {
+    return;
+  }
+  if (cbytes <= BLOSC_EXTENDED_HEADER_LENGTH || ((chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK)) {
+    // The special chunks are as small as they get
+    if (needs_free) {
+      free(chunk);
     }
+    return;
+  }
+  tiering_job *job = calloc(1, sizeof(tiering_job));
+  uint8_t *hot = needs_free ? chunk : malloc(cbytes);
+  if (job == NULL || hot == NULL) {
+    free(job);
+    if (needs_free || hot != NULL) {
+      free(hot);
+    }
+    return;
+  }
+  if (!needs_free) {
+    memcpy(hot, chunk, cbytes);
+  }
+  job->ts = ts;
+  job->nchunk = nchunk;
+  job->hot = hot;
+  job->hot_cbytes = cbytes;
+  pthread_mutex_lock(&ts->mutex);
+  ts->ninflight++;
+  pthread_mutex_unlock(&ts->mutex);
+  // The recompressions go after the work that is in the pool already
+  if (blosc_pool_submit(tiering_job_run, job) != BLOSC2_ERROR_SUCCESS) {
+    tiering_job_run(job);
   }
+}
 
-  if (copy) {
-    // Make a copy of the chunk
-    uint8_t *chunk_copy = malloc(chunk_cbytes);
-    memcpy(chunk_copy, chunk, chunk_cbytes);
-    chunk = chunk_copy;
-  }
 
-  // Update super-chunk or frame
-  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
-  if (frame == NULL) {
-    // Check that we are not appending a small chunk after another small chunk
-    if ((schunk->nchunks > 0) && (chunk_nbytes < schunk->chunksize)) {
-      uint8_t* last_chunk = schunk->data[nchunks - 1];
-      int32_t last_nbytes;
-      rc = blosc2_cbuffer_sizes(last_chunk, &last_nbytes, NULL, NULL);
-      if (rc < 0) {
-        return rc;
+/* Swap the chunks recompressed so far in (waiting for the ones in flight if `wait`), and
+ * return how many of them */
+static int64_t tiering_swap(blosc2_schunk *schunk, tiering_state *ts, bool wait) {
+  pthread_mutex_lock(&ts->mutex);
+  while (wait && ts->ninflight > 0) {
+    pthread_cond_wait(&ts->done_cv, &ts->mutex);
+  }
+  tiering_job *job = ts->done;
+  ts->done = NULL;
+  pthread_mutex_unlock(&ts->mutex);
+
+  int64_t nswapped = 0;
+  while (job != NULL) {
+    tiering_job *next = job->next;
+    // The chunk is only replaced if it has not changed (nor moved) in the meanwhile
+    uint8_t *chunk;
+    bool needs_free = false;
+    if (job->cold != NULL && schunk != NULL && job->nchunk < schunk->nchunks) {
+      int cbytes = blosc2_schunk_get_chunk(schunk, job->nchunk, &chunk, &needs_free);
+      bool same = cbytes == job->hot_cbytes && memcmp(chunk, job->hot, job->hot_cbytes) == 0;
+      if (needs_free) {
+        free(chunk);
       }
-      if ((last_nbytes < schunk->chunksize) && (chunk_nbytes < schunk->chunksize)) {
-        BLOSC_TRACE_ERROR("Appending two consecutive chunks with a chunksize smaller "
-                          "than the schunk chunksize is not allowed yet:  %d != %d",
-                          chunk_nbytes, schunk->chunksize);
-        return BLOSC2_ERROR_CHUNK_APPEND;
+      if (same && blosc2_schunk_update_chunk(schunk, job->nchunk, job->cold, true) >= 0) {
+        nswapped++;
       }
     }
+    free(job->cold);
+    free(job->hot);
+    free(job);
+    job = next;
+  }
+  return nswapped;
+}
 
-    if (!copy && (chunk_cbytes < chunk_nbytes)) {
-      // We still want to do a shrink of the chunk
-      chunk = realloc(chunk, chunk_cbytes);
-    }
-
-    // Make space for appending the copy of the chunk and do it
-    if ((nchunks + 1) * sizeof(void *) > schunk->data_len) {
-      // Extend the data pointer by one memory page (4k)
-      schunk->data_len += 4096;  // must be a multiple of sizeof(void*)
-      schunk->data = realloc(schunk->data, schunk->data_len);
-    }
 
-    // Reorder the offsets and insert the new chunk
-    for (int64_t i = nchunks; i > nchunk; --i) {
-      schunk->data[i] = schunk->data[i-1];
-    }
-    schunk->data[nchunk] = chunk;
+/* Mark a chunk as read */
+static void tiering_note_read(blosc2_schunk *schunk, int64_t nchunk) {
+  tiering_state *ts = (tiering_state *) schunk->tiering;
+  if (ts != NULL && nchunk >= 0 && nchunk < ts->flags_len) {
+    ts->flags[nchunk] |= TIERING_READ;
   }
+}
 
-  else {
-    if (frame_insert_chunk(frame, nchunk, chunk, schunk) == NULL) {
-      BLOSC_TRACE_ERROR("Problems inserting a chunk in a frame.");
-      return BLOSC2_ERROR_CHUNK_INSERT;
+
+/* Swap the recompressed chunks in, and take the ones that turn cold with the last append */
+static void tiering_on_append(blosc2_schunk *schunk) {
+  tiering_state *ts = (tiering_state *) schunk->tiering;
+  if (ts == NULL) {
+    return;
+  }
+  tiering_swap(schunk, ts, false);
+  int64_t last = schunk->nchunks - 1;
+  if (last >= ts->flags_len) {
+    int64_t flags_len = ts->flags_len > 0 ? 2 * ts->flags_len : 1024;
+    while (flags_len <= last) {
+      flags_len *= 2;
     }
+    uint8_t *flags = realloc(ts->flags, flags_len);
+    if (flags == NULL) {
+      return;
+    }
+    memset(flags + ts->flags_len, 0, flags_len - ts->flags_len);
+    ts->flags = flags;
+    ts->flags_len = flags_len;
+  }
+  ts->flags[last] = 0;
+  if (ts->min_age > 0 && last >= ts->min_age) {
+    tiering_take(schunk, ts, last - ts->min_age);
+  }
+  if (ts->idle_appends > 0 && last >= ts->idle_appends && !(ts->flags[last - ts->idle_appends] & TIERING_READ)) {
+    tiering_take(schunk, ts, last - ts->idle_appends);
   }
-  return schunk->nchunks;
 }
 
 
-int64_t blosc2_schunk_update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy) {
-  int32_t chunk_nbytes;
-  int32_t chunk_cbytes;
-
-  int rc = blosc2_cbuffer_sizes(chunk, &chunk_nbytes, &chunk_cbytes, NULL);
-  if (rc < 0) {
-    return rc;
+/* Wait for the recompressions in flight and stop the tiering (swapping them in if `swap`) */
+static int64_t stop_tiering(blosc2_schunk *schunk, bool swap) {
+  tiering_state *ts = (tiering_state *) schunk->tiering;
+  if (ts == NULL) {
+    return 0;
   }
+  int64_t nswapped = tiering_swap(swap ? schunk : NULL, ts, true);
+  schunk->tiering = NULL;
+  pthread_mutex_destroy(&ts->mutex);
+  pthread_cond_destroy(&ts->done_cv);
+  free(ts->flags);
+  free(ts);
+  return nswapped;
+}
 
-  if (schunk->chunksize == -1) {
-    schunk->chunksize = chunk_nbytes;  // The super-chunk is initialized now
-  }
 
-  if (schunk->chunksize != 0 && (chunk_nbytes > schunk->chunksize ||
-      (chunk_nbytes < schunk->chunksize && nchunk != schunk->nchunks - 1))) {
-    BLOSC_TRACE_ERROR("Updating chunks that have different lengths in the same schunk "
-                      "is not supported yet (unless it's the last one and smaller):"
-                      " %d > %d.", chunk_nbytes, schunk->chunksize);
-    return BLOSC2_ERROR_CHUNK_UPDATE;
+int blosc2_schunk_set_tiering(blosc2_schunk *schunk, const blosc2_tiering *tiering) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  stop_tiering(schunk, true);
+  if (tiering == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  if (tiering->cparams == NULL || tiering->min_age < 0 || tiering->idle_appends < 0) {
+    BLOSC_TRACE_ERROR("The tiering needs the compression parameters of the cold chunks, and ages that are not negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  BLOSC_ERROR(check_not_read_only(schunk));
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  if ((frame != NULL && !frame->sframe) || schunk->cctx_pool != NULL || stateful_compression(schunk)) {
+    // The chunks updated in contiguous frames go to their end, leaving the old ones behind
+    BLOSC_TRACE_ERROR("The tiering is for super-chunks in memory or in sparse frames (without concurrent writers "
+                      "and whose chunks do not depend on the super-chunk).");
+    return BLOSC2_ERROR_INVALID_PARAM;
   }
 
-  bool needs_free;
-  uint8_t *chunk_old;
-  int err = blosc2_schunk_get_chunk(schunk, nchunk, &chunk_old, &needs_free);
-  if (err < 0) {
-    BLOSC_TRACE_ERROR("%" PRId64 " chunk can not be obtained from schunk.", nchunk);
-    return -1;
+  tiering_state *ts = calloc(1, sizeof(tiering_state));
+  BLOSC_ERROR_NULL(ts, BLOSC2_ERROR_MEMORY_ALLOC);
+  ts->schunk = schunk;
+  ts->cparams = *tiering->cparams;
+  // The recompressions run in parallel one chunk per thread, and the chunks keep the typesize of the super-chunk
+  ts->cparams.nthreads = 1;
+  ts->cparams.typesize = schunk->typesize;
+  ts->cparams.schunk = schunk;
+  ts->min_age = tiering->min_age;
+  ts->idle_appends = tiering->idle_appends;
+  pthread_mutex_init(&ts->mutex, NULL);
+  pthread_cond_init(&ts->done_cv, NULL);
+  schunk->tiering = ts;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int64_t blosc2_schunk_flush_tiering(blosc2_schunk *schunk) {
+  tiering_state *ts = (tiering_state *) schunk->tiering;
+  if (ts == NULL) {
+    return 0;
   }
-  int32_t chunk_nbytes_old = 0;
-  int32_t chunk_cbytes_old = 0;
-  schunk->current_nchunk = nchunk;
+  return tiering_swap(schunk, ts, true);
+}
 
-  if (chunk_old != 0) {
-    rc = blosc2_cbuffer_sizes(chunk_old, &chunk_nbytes_old, &chunk_cbytes_old, NULL);
-    if (rc < 0) {
-      return rc;
+
+/* Decompress several consecutive chunks of a super-chunk in parallel. */
+int64_t blosc2_schunk_decompress_chunks(blosc2_schunk *schunk, int64_t nchunk, int nchunks,
+                                        void **dests, const int32_t *nbytes) {
+  if (nchunks < 0 || nchunk < 0 || nchunk + nchunks > schunk->nchunks) {
+    BLOSC_TRACE_ERROR("The range of chunks [%" PRId64 ", %" PRId64 ") is not within the "
+                      "super-chunk ('%" PRId64 "' chunks).", nchunk, nchunk + nchunks, schunk->nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int64_t total = 0;
+  /* Postfilters may depend on the current chunk of the super-chunk, and deltas on the previous one */
+  if (nchunks < 2 || blosc_pool_nthreads() == 0 || schunk->dctx->postfilter != NULL || schunk->xdelta != NULL) {
+    for (int i = 0; i < nchunks; i++) {
+      int rc = blosc2_schunk_decompress_chunk(schunk, nchunk + i, dests[i], nbytes[i]);
+      if (rc < 0) {
+        return rc;
+      }
+      total += rc;
     }
-    if (chunk_cbytes_old == BLOSC2_MAX_OVERHEAD) {
-        chunk_cbytes_old = 0;
+    return total;
+  }
+
+  chunk_batch batch = {0};
+  batch.nitems = nchunks;
+  batch.srcs = calloc(nchunks, sizeof(uint8_t *));
+  int32_t *srcsizes = malloc(nchunks * sizeof(int32_t));
+  batch.srcsizes = srcsizes;
+  bool *needs_free = calloc(nchunks, sizeof(bool));
+  batch.dests = (uint8_t **)dests;
+  batch.destsizes = nbytes;
+  batch.rcs = malloc(nchunks * sizeof(int));
+  int64_t rc = BLOSC2_ERROR_SUCCESS;
+  if (batch.srcs == NULL || srcsizes == NULL || needs_free == NULL || batch.rcs == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate the batch of chunks.");
+    rc = BLOSC2_ERROR_MEMORY_ALLOC;
+    goto end;
+  }
+
+  blosc2_frame_s *frame = (blosc2_frame_s *)schunk->frame;
+  chunk_fetch fetch = {0};
+  if (frame != NULL && frame->cframe == NULL) {
+    /* On-disk chunks are read in a batch by the first job, and decompressed as they arrive */
+    fetch.frame = frame;
+    fetch.nchunk = nchunk;
+    fetch.cbytes = srcsizes;
+    fetch.needs_free = needs_free;
+    fetch.ready = malloc(nchunks * sizeof(int32_t));
+    if (fetch.ready == NULL) {
+      BLOSC_TRACE_ERROR("Cannot allocate the batch of chunks.");
+      rc = BLOSC2_ERROR_MEMORY_ALLOC;
+      goto end;
     }
+    pthread_mutex_init(&fetch.mutex, NULL);
+    pthread_cond_init(&fetch.cond, NULL);
+    batch.fetch = &fetch;
   }
-  if (needs_free) {
-    free(chunk_old);
+  else {
+    /* The backing storage is not meant to be read concurrently, so fetch the chunks first */
+    for (int i = 0; i < nchunks; i++) {
+      int cbytes = blosc2_schunk_get_chunk(schunk, nchunk + i, &batch.srcs[i], &needs_free[i]);
+      if (cbytes < 0) {
+        rc = cbytes;
+        goto end;
+      }
+      if (cbytes == 0) {
+        batch.srcs[i] = NULL;
+      }
+      srcsizes[i] = cbytes;
+    }
   }
 
-  if (copy) {
-    // Make a copy of the chunk
-    uint8_t *chunk_copy = malloc(chunk_cbytes);
-    memcpy(chunk_copy, chunk, chunk_cbytes);
-    chunk = chunk_copy;
+  blosc2_dparams dparams;
+  blosc2_ctx_get_dparams(schunk->dctx, &dparams);
+  dparams.nthreads = 1;
+  rc = run_chunk_batch(&batch, decompress_chunks_job, NULL, &dparams);
+  if (batch.fetch != NULL) {
+    pthread_mutex_destroy(&fetch.mutex);
+    pthread_cond_destroy(&fetch.cond);
+    free(fetch.ready);
   }
-
-  blosc2_frame_s* frame = (blosc2_frame_s*)(schunk->frame);
-  if (schunk->frame == NULL) {
-    /* Update counters */
-    schunk->nbytes += chunk_nbytes;
-    schunk->nbytes -= chunk_nbytes_old;
-    schunk->cbytes += chunk_cbytes;
-    schunk->cbytes -= chunk_cbytes_old;
-  } else {
-    // A frame
-    int special_value = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
-    switch (special_value) {
-      case BLOSC2_SPECIAL_ZERO:
-      case BLOSC2_SPECIAL_NAN:
-      case BLOSC2_SPECIAL_UNINIT:
-        schunk->nbytes += chunk_nbytes;
-        schunk->nbytes -= chunk_nbytes_old;
-        if (frame->sframe) {
-          schunk->cbytes -= chunk_cbytes_old;
-        }
-        break;
-      default:
-        /* Update counters */
-        schunk->nbytes += chunk_nbytes;
-        schunk->nbytes -= chunk_nbytes_old;
-        schunk->cbytes += chunk_cbytes;
-        if (frame->sframe) {
-          schunk->cbytes -= chunk_cbytes_old;
-        }
-        else {
-          if (chunk_cbytes_old >= chunk_cbytes) {
-            schunk->cbytes -= chunk_cbytes;
-          }
-        }
-    }
+  if (rc < 0) {
+    goto end;
   }
 
-  // Update super-chunk or frame
-  if (schunk->frame == NULL) {
-    if (!copy && (chunk_cbytes < chunk_nbytes)) {
-      // We still want to do a shrink of the chunk
-      chunk = realloc(chunk, chunk_cbytes);
-    }
-
-    // Free old chunk and add reference to new chunk
-    if (schunk->data[nchunk] != 0) {
-      free(schunk->data[nchunk]);
+  for (int i = 0; i < nchunks; i++) {
+    if (batch.rcs[i] < 0) {
+      BLOSC_TRACE_ERROR("Error in decompressing chunk %" PRId64 ".", nchunk + i);
+      rc = batch.rcs[i];
+      goto end;
     }
-    schunk->data[nchunk] = chunk;
+    total += batch.rcs[i];
   }
-  else {
-    if (frame_update_chunk(frame, nchunk, chunk, schunk) == NULL) {
-        BLOSC_TRACE_ERROR("Problems updating a chunk in a frame.");
-        return BLOSC2_ERROR_CHUNK_UPDATE;
+  rc = total;
+
+  end:
+  if (batch.srcs != NULL && needs_free != NULL) {
+    for (int i = 0; i < nchunks; i++) {
+      if (needs_free[i]) {
+        free(batch.srcs[i]);
+      }
     }
   }
-
-  return schunk->nchunks;
+  free(batch.srcs);
+  free(srcsizes);
+  free(needs_free);
+  free(batch.rcs);
+  return rc;
 }
 
-int64_t blosc2_schunk_delete_chunk(blosc2_schunk *schunk, int64_t nchunk) {
-  int rc;
-  if (schunk->nchunks < nchunk) {
-    BLOSC_TRACE_ERROR("The schunk has not enough chunks (%" PRId64 ")!", schunk->nchunks);
+
+/* The number of chunks appended between the checkpoints of a transcode */
+#define TRANSCODE_CHECKPOINT_NCHUNKS 1024
+
+/* State shared by the jobs of a transcode.  The chunks are claimed in order, but no further
+ * than `window` chunks past the last one written, which bounds the chunks in flight. */
+typedef struct {
+  blosc2_schunk *src;
+  blosc2_schunk *dest;
+  int64_t next;  /* the next chunk to be claimed */
+  int64_t written;  /* the number of chunks in dest */
+  int64_t checkpoint;  /* the number of chunks in dest at the last checkpoint */
+  int window;
+  uint8_t **chunks;  /* the transcoded chunks waiting to be written, by nchunk % window */
+  bool writing;  /* whether some job is appending the chunks to dest */
+  int rc;  /* the first error */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  pthread_mutex_t read_mutex;  /* the source is not meant to be read concurrently */
+} transcoder;
+
+/* A job of a transcode, with its own (single-threaded) contexts */
+typedef struct {
+  transcoder *tc;
+  blosc2_context *dctx;
+  blosc2_context *cctx;
+  uint8_t *buffer;  /* the decompressed chunk */
+} transcode_job;
+
+/* Write down the deferred updates of the appends, so that an interrupted transcode can be
+ * resumed from here */
+static int transcode_checkpoint(transcoder *tc) {
+  int rc = blosc2_schunk_commit_bulk(tc->dest);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot commit the transcoded chunks.");
+    return rc;
   }
+  tc->checkpoint = tc->dest->nchunks;
+  return blosc2_schunk_begin_bulk(tc->dest);
+}
 
+/* Read, decompress and compress again a chunk of the source */
+static int transcode_chunk(transcode_job *job, int64_t nchunk, uint8_t **chunk) {
+  transcoder *tc = job->tc;
+  uint8_t *src_chunk;
   bool needs_free;
-  uint8_t *chunk_old;
-  int err = blosc2_schunk_get_chunk(schunk, nchunk, &chunk_old, &needs_free);
-  if (err < 0) {
-    BLOSC_TRACE_ERROR("%" PRId64 "chunk can not be obtained from schunk.", nchunk);
-    return -1;
+  pthread_mutex_lock(&tc->read_mutex);
+  int cbytes = blosc2_schunk_get_chunk(tc->src, nchunk, &src_chunk, &needs_free);
+  pthread_mutex_unlock(&tc->read_mutex);
+  if (cbytes < 0) {
+    BLOSC_TRACE_ERROR("Cannot get the chunk %" PRId64 ".", nchunk);
+    return cbytes;
   }
-  int32_t chunk_nbytes_old = 0;
-  int32_t chunk_cbytes_old = 0;
-  schunk->current_nchunk = nchunk;
+  if (cbytes == 0) {
+    // Non-initialized chunks stay so
+    blosc2_cparams cparams;
+    blosc2_ctx_get_cparams(job->cctx, &cparams);
+    *chunk = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
+    BLOSC_ERROR_NULL(*chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+    return blosc2_chunk_uninit(cparams, tc->src->chunksize, *chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+  }
+  job->dctx->nchunk = nchunk;
+  int nbytes = blosc2_decompress_ctx(job->dctx, src_chunk, cbytes, job->buffer, tc->src->chunksize);
+  if (needs_free) {
+    free(src_chunk);
+  }
+  if (nbytes < 0) {
+    BLOSC_TRACE_ERROR("Error in decompressing chunk %" PRId64 ".", nchunk);
+    return nbytes;
+  }
+  int32_t destsize = nbytes + BLOSC2_MAX_OVERHEAD +
+                     trailer_maxlen(job->cctx->checksum, job->cctx->cipher, nbytes, job->cctx->blocksize);
+  *chunk = malloc(destsize);
+  BLOSC_ERROR_NULL(*chunk, BLOSC2_ERROR_MEMORY_ALLOC);
+  cbytes = blosc2_compress_ctx(job->cctx, job->buffer, nbytes, *chunk, destsize);
+  if (cbytes < 0) {
+    BLOSC_TRACE_ERROR("Error in compressing chunk %" PRId64 ".", nchunk);
+  }
+  return cbytes;
+}
 
-  if (chunk_old != 0) {
-    rc = blosc2_cbuffer_sizes(chunk_old, &chunk_nbytes_old, &chunk_cbytes_old, NULL);
+/* Append the transcoded chunks that come next in order, unless some other job is at it.
+ * Called with the mutex held, which is released while appending. */
+static void write_transcoded_chunks(transcoder *tc) {
+  if (tc->writing) {
+    return;
+  }
+  tc->writing = true;
+  while (tc->rc == 0 && tc->chunks[tc->written % tc->window] != NULL) {
+    uint8_t *chunk = tc->chunks[tc->written % tc->window];
+    tc->chunks[tc->written % tc->window] = NULL;
+    pthread_mutex_unlock(&tc->mutex);
+    // We don't need a copy of the chunk, as it will be shrunk if necessary
+    int64_t rc = blosc2_schunk_append_chunk(tc->dest, chunk, false);
+    if (rc >= 0 && tc->dest->nchunks - tc->checkpoint >= TRANSCODE_CHECKPOINT_NCHUNKS) {
+      rc = transcode_checkpoint(tc);
+    }
+    pthread_mutex_lock(&tc->mutex);
     if (rc < 0) {
-      return rc;
+      BLOSC_TRACE_ERROR("Error appending a transcoded chunk in super-chunk.");
+      tc->rc = (int)rc;
     }
-    if (chunk_cbytes_old == BLOSC2_MAX_OVERHEAD) {
-      chunk_cbytes_old = 0;
+    else {
+      tc->written++;
     }
+    pthread_cond_broadcast(&tc->cond);
   }
-  if (needs_free) {
-    free(chunk_old);
+  tc->writing = false;
+}
+
+static void transcode_chunks_job(void *data) {
+  transcode_job *job = (transcode_job *)data;
+  transcoder *tc = job->tc;
+  int64_t nchunks = tc->src->nchunks;
+  pthread_mutex_lock(&tc->mutex);
+  while (true) {
+    while (tc->rc == 0 && tc->next < nchunks && tc->next >= tc->written + tc->window) {
+      pthread_cond_wait(&tc->cond, &tc->mutex);
+    }
+    if (tc->rc < 0 || tc->next >= nchunks) {
+      break;
+    }
+    int64_t nchunk = tc->next++;
+    pthread_mutex_unlock(&tc->mutex);
+    uint8_t *chunk = NULL;
+    int rc = transcode_chunk(job, nchunk, &chunk);
+    pthread_mutex_lock(&tc->mutex);
+    if (rc < 0) {
+      free(chunk);
+      if (tc->rc == 0) {
+        tc->rc = rc;
+      }
+      pthread_cond_broadcast(&tc->cond);
+      break;
+    }
+    tc->chunks[nchunk % tc->window] = chunk;
+    write_transcoded_chunks(tc);
   }
+  pthread_mutex_unlock(&tc->mutex);
+}
 
-  blosc2_frame_s* frame = (blosc2_frame_s*)(schunk->frame);
-  schunk->nchunks -= 1;
-  if (schunk->frame == NULL) {
-    /* Update counters */
-    schunk->nbytes -= chunk_nbytes_old;
-    schunk->cbytes -= chunk_cbytes_old;
-  } else {
-    // A frame
-    schunk->nbytes -= chunk_nbytes_old;
-    if (frame->sframe) {
-      schunk->cbytes -= chunk_cbytes_old;
+static void *transcode_chunks_thread(void *data) {
+  transcode_chunks_job(data);
+  return NULL;
+}
+
+/* Run the jobs of a transcode in the shared pool, or in threads of their own if there
+ * is no pool */
+static void run_transcode_jobs(transcode_job *jobs, int njobs) {
+  if (blosc_pool_nthreads() > 0) {
+    blosc_pool_run(NULL, transcode_chunks_job, njobs, sizeof(transcode_job), jobs);
+    return;
+  }
+  pthread_t *threads = malloc(njobs * sizeof(pthread_t));
+  bool *started = calloc(njobs, sizeof(bool));
+  for (int i = 1; i < njobs && threads != NULL && started != NULL; i++) {
+    started[i] = pthread_create(&threads[i], NULL, transcode_chunks_thread, &jobs[i]) == 0;
+  }
+  // The jobs that could not be started just leave all the chunks to this one
+  transcode_chunks_job(&jobs[0]);
+  for (int i = 1; i < njobs && threads != NULL && started != NULL; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
     }
   }
+  free(threads);
+  free(started);
+}
 
-  // Update super-chunk or frame
-  if (schunk->frame == NULL) {
-    // Free old chunk
-    if (schunk->data[nchunk] != 0) {
-      free(schunk->data[nchunk]);
+/* Transcode the chunks of `schunk` that are not in `new_schunk` yet, in parallel */
+static int transcode_chunks(blosc2_schunk *schunk, blosc2_schunk *new_schunk, int nthreads) {
+  transcoder tc = {0};
+  tc.src = schunk;
+  tc.dest = new_schunk;
+  tc.next = new_schunk->nchunks;
+  tc.written = new_schunk->nchunks;
+  tc.checkpoint = new_schunk->nchunks;
+  tc.window = 2 * nthreads;
+  tc.chunks = calloc(tc.window, sizeof(uint8_t *));
+  transcode_job *jobs = calloc(nthreads, sizeof(transcode_job));
+  if (tc.chunks == NULL || jobs == NULL) {
+    BLOSC_TRACE_ERROR("Cannot allocate the transcode.");
+    free(tc.chunks);
+    free(jobs);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+
+  blosc2_dparams dparams;
+  blosc2_ctx_get_dparams(schunk->dctx, &dparams);
+  dparams.nthreads = 1;
+  dparams.schunk = schunk;
+  blosc2_cparams cparams;
+  blosc2_ctx_get_cparams(new_schunk->cctx, &cparams);
+  cparams.nthreads = 1;
+  cparams.schunk = new_schunk;
+  // The stats and zone maps are recorded in vlmetalayers, which cannot be written concurrently
+  cparams.record_stats = false;
+  cparams.zonemap = BLOSC2_ZONEMAP_NONE;
+  for (int i = 0; i < nthreads; i++) {
+    jobs[i].tc = &tc;
+    jobs[i].dctx = blosc2_create_dctx(dparams);
+    jobs[i].cctx = blosc2_create_cctx(cparams);
+    jobs[i].buffer = malloc(schunk->chunksize);
+    if (jobs[i].dctx == NULL || jobs[i].cctx == NULL || jobs[i].buffer == NULL) {
+      BLOSC_TRACE_ERROR("Cannot create the contexts for the transcode.");
+      tc.rc = BLOSC2_ERROR_NULL_POINTER;
+      break;
     }
-    // Reorder the offsets and insert the new chunk
-    for (int64_t i = nchunk; i < schunk->nchunks; i++) {
-      schunk->data[i] = schunk->data[i + 1];
+    // Every job keeps its own chunk, as the super-chunks are shared
+    jobs[i].dctx->pooled = true;
+    jobs[i].cctx->pooled = true;
+    jobs[i].cctx->nchunk = -1;
+  }
+
+  if (tc.rc == 0) {
+    pthread_mutex_init(&tc.mutex, NULL);
+    pthread_cond_init(&tc.cond, NULL);
+    pthread_mutex_init(&tc.read_mutex, NULL);
+    blosc2_schunk_begin_bulk(new_schunk);
+    run_transcode_jobs(jobs, nthreads);
+    int rc = transcode_checkpoint(&tc);
+    if (tc.rc == 0) {
+      tc.rc = rc;
     }
-    schunk->data[schunk->nchunks] = NULL;
+    pthread_mutex_destroy(&tc.mutex);
+    pthread_cond_destroy(&tc.cond);
+    pthread_mutex_destroy(&tc.read_mutex);
+  }
 
+  for (int i = 0; i < tc.window; i++) {
+    free(tc.chunks[i]);
   }
-  else {
-    if (frame_delete_chunk(frame, nchunk, schunk) == NULL) {
-      BLOSC_TRACE_ERROR("Problems deleting a chunk in a frame.");
-      return BLOSC2_ERROR_CHUNK_UPDATE;
+  free(tc.chunks);
+  for (int i = 0; i < nthreads; i++) {
+    if (jobs[i].dctx != NULL) {
+      blosc2_free_ctx(jobs[i].dctx);
+    }
+    if (jobs[i].cctx != NULL) {
+      blosc2_free_ctx(jobs[i].cctx);
     }
+    free(jobs[i].buffer);
   }
-  return schunk->nchunks;
+  free(jobs);
+  return tc.rc;
 }
 
+/* Transcode the chunks of `schunk` that are not in `new_schunk` yet, one after the other.
+ * This is needed when the compression depends on the state of the super-chunk context. */
+static int transcode_chunks_serial(blosc2_schunk *schunk, blosc2_schunk *new_schunk) {
+  uint8_t *buffer = malloc(schunk->chunksize);
+  BLOSC_ERROR_NULL(buffer, BLOSC2_ERROR_MEMORY_ALLOC);
+  transcoder tc = {0};
+  tc.dest = new_schunk;
+  tc.checkpoint = new_schunk->nchunks;
+  int rc = blosc2_schunk_begin_bulk(new_schunk);
+  for (int64_t nchunk = new_schunk->nchunks; nchunk < schunk->nchunks && rc >= 0; nchunk++) {
+    int nbytes = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, schunk->chunksize);
+    if (nbytes < 0) {
+      BLOSC_TRACE_ERROR("Can not decompress the `chunk` %" PRId64 ".", nchunk);
+      rc = nbytes;
+      break;
+    }
+    int64_t nchunks = blosc2_schunk_append_buffer(new_schunk, buffer, nbytes);
+    if (nchunks < 0) {
+      BLOSC_TRACE_ERROR("Can not append the `buffer` into super-chunk.");
+      rc = (int)nchunks;
+      break;
+    }
+    if (nchunks - tc.checkpoint >= TRANSCODE_CHECKPOINT_NCHUNKS) {
+      rc = transcode_checkpoint(&tc);
+    }
+  }
+  free(buffer);
+  int rc_ = transcode_checkpoint(&tc);
+  return rc < 0 ? rc : rc_;
+}
 
-/* Append a data buffer to a super-chunk. */
-int64_t blosc2_schunk_append_buffer(blosc2_schunk *schunk, void *src, int32_t nbytes) {
-  uint8_t* chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
-  schunk->current_nchunk = schunk->nchunks;
-  /* Compress the src buffer using super-chunk context */
-  int cbytes = blosc2_compress_ctx(schunk->cctx, src, nbytes, chunk,
-                                   nbytes + BLOSC2_MAX_OVERHEAD);
-  if (cbytes < 0) {
-    free(chunk);
-    return cbytes;
+/* The super-chunk of an interrupted transcode of `schunk` into `storage`, if there is one */
+static blosc2_schunk *open_transcode(blosc2_schunk *schunk, blosc2_storage *storage) {
+  struct stat path_stat;
+  if (storage->urlpath == NULL || stat(storage->urlpath, &path_stat) < 0) {
+    return NULL;
   }
-  // We don't need a copy of the chunk, as it will be shrunk if necessary
-  int64_t nchunks = blosc2_schunk_append_chunk(schunk, chunk, false);
-  if (nchunks < 0) {
-    BLOSC_TRACE_ERROR("Error appending a buffer in super-chunk");
-    return nchunks;
+  blosc2_schunk *new_schunk = blosc2_schunk_open_udio(storage->urlpath,
+                                                      storage->io != NULL ? storage->io : &BLOSC2_IO_DEFAULTS);
+  if (new_schunk == NULL) {
+    return NULL;
   }
-
-  return nchunks;
+  int64_t *marker;
+  int32_t marker_len;
+  if (blosc2_vlmeta_exists(new_schunk, TRANSCODE_VLMETA) < 0 ||
+      blosc2_vlmeta_get(new_schunk, TRANSCODE_VLMETA, (uint8_t **)&marker, &marker_len) < 0) {
+    blosc2_schunk_free(new_schunk);
+    return NULL;
+  }
+  bool same_src = marker_len == 2 * sizeof(int64_t) && marker[0] == schunk->nchunks &&
+                  marker[1] == schunk->nbytes && new_schunk->nchunks <= schunk->nchunks;
+  free(marker);
+  if (!same_src) {
+    blosc2_schunk_free(new_schunk);
+    return NULL;
+  }
+  // Any vlmetalayer copied before the interruption comes again at the end
+  for (int nmeta = new_schunk->nvlmetalayers - 1; nmeta >= 0; nmeta--) {
+    char *name = new_schunk->vlmetalayers[nmeta]->name;
+    if (strcmp(name, TRANSCODE_VLMETA) != 0 && blosc2_vlmeta_delete(new_schunk, name) < 0) {
+      blosc2_schunk_free(new_schunk);
+      return NULL;
+    }
+  }
+  return new_schunk;
 }
 
 
-/* Decompress and return a chunk that is part of a super-chunk. */
-int blosc2_schunk_decompress_chunk(blosc2_schunk *schunk, int64_t nchunk,
-                                   void *dest, int32_t nbytes) {
-  int32_t chunk_nbytes;
-  int32_t chunk_cbytes;
-  int chunksize;
-  int rc;
-  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+/* Create a copy of a super-chunk with other compression parameters, transcoding its chunks in parallel */
+blosc2_schunk* blosc2_schunk_transcode(blosc2_schunk *schunk, blosc2_storage *storage, int nthreads) {
+  if (schunk == NULL || storage == NULL) {
+    BLOSC_TRACE_ERROR("Can not transcode a NULL `schunk` or into a NULL `storage`.");
+    return NULL;
+  }
+  if (nthreads < 1) {
+    BLOSC_TRACE_ERROR("The number of threads must be at least 1.");
+    return NULL;
+  }
 
-  schunk->current_nchunk = nchunk;
-  if (frame == NULL) {
-    if (nchunk >= schunk->nchunks) {
-      BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the number of chunks "
-                        "('%" PRId64 "') in super-chunk.", nchunk, schunk->nchunks);
-      return BLOSC2_ERROR_INVALID_PARAM;
+  blosc2_schunk *new_schunk = open_transcode(schunk, storage);
+  if (new_schunk == NULL) {
+    new_schunk = blosc2_schunk_new(storage);
+    if (new_schunk == NULL) {
+      BLOSC_TRACE_ERROR("Can not create a new schunk");
+      return NULL;
     }
-    uint8_t* src = schunk->data[nchunk];
-    if (src == 0) {
-      return 0;
+    int64_t marker[2] = {schunk->nchunks, schunk->nbytes};
+    if (copy_metalayers(schunk, new_schunk) < 0 ||
+        blosc2_vlmeta_add(new_schunk, TRANSCODE_VLMETA, (uint8_t *)marker, sizeof(marker), NULL) < 0) {
+      blosc2_schunk_free(new_schunk);
+      return NULL;
     }
+  }
 
-    rc = blosc2_cbuffer_sizes(src, &chunk_nbytes, &chunk_cbytes, NULL);
-    if (rc < 0) {
-      return rc;
+  int rc = 0;
+  if (new_schunk->nchunks < schunk->nchunks) {
+    /* Prefilters, dicts and stateful tuners depend on the state of the super-chunk context,
+       and the chunks with deltas on the previous ones */
+    blosc2_context *cctx = new_schunk->cctx;
+    if (cctx->prefilter != NULL || cctx->use_dict || cctx->tuner_id != BLOSC_STUNE || cctx->tuner_params != NULL ||
+        schunk->xdelta != NULL) {
+      rc = transcode_chunks_serial(schunk, new_schunk);
     }
-
-    if (nbytes < chunk_nbytes) {
-      BLOSC_TRACE_ERROR("Buffer size is too small for the decompressed buffer "
-                        "('%d' bytes, but '%d' are needed).", nbytes, chunk_nbytes);
-      return BLOSC2_ERROR_INVALID_PARAM;
+    else {
+      rc = transcode_chunks(schunk, new_schunk, nthreads);
     }
+  }
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Can not transcode the chunks (the transcode can be resumed from its last checkpoint).");
+    blosc2_schunk_free(new_schunk);
+    return NULL;
+  }
 
-    chunksize = blosc2_decompress_ctx(schunk->dctx, src, chunk_cbytes, dest, nbytes);
-    if (chunksize < 0 || chunksize != chunk_nbytes) {
-      BLOSC_TRACE_ERROR("Error in decompressing chunk.");
-      if (chunksize < 0)
-        return chunksize;
-      return BLOSC2_ERROR_FAILURE;
-    }
-  } else {
-    chunksize = frame_decompress_chunk(schunk->dctx, frame, nchunk, dest, nbytes);
-    if (chunksize < 0) {
-      return chunksize;
-    }
+  if (copy_vlmetalayers(schunk, new_schunk, true) < 0 ||
+      blosc2_vlmeta_delete(new_schunk, TRANSCODE_VLMETA) < 0) {
+    blosc2_schunk_free(new_schunk);
+    return NULL;
   }
-  return chunksize;
+  return new_schunk;
 }
 
 
@@ -1118,14 +6238,7 @@ int blosc2_schunk_decompress_chunk(blosc2_schunk *schunk, int64_t nchunk,
  * is returned instead.
 */
 int blosc2_schunk_get_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chunk, bool *needs_free) {
-  if (schunk->dctx->threads_started > 1) {
-    pthread_mutex_lock(&schunk->dctx->nchunk_mutex);
-    schunk->current_nchunk = nchunk;
-    pthread_mutex_unlock(&schunk->dctx->nchunk_mutex);
-  }
-  else {
-    schunk->current_nchunk = nchunk;
-  }
+  set_current_nchunk(schunk, nchunk);
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
   if (frame != NULL) {
     return frame_get_chunk(frame, nchunk, chunk, needs_free);
@@ -1164,14 +6277,7 @@ int blosc2_schunk_get_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chu
  * is returned instead.
 */
 int blosc2_schunk_get_lazychunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chunk, bool *needs_free) {
-  if (schunk->dctx->threads_started > 1) {
-    pthread_mutex_lock(&schunk->dctx->nchunk_mutex);
-    schunk->current_nchunk = nchunk;
-    pthread_mutex_unlock(&schunk->dctx->nchunk_mutex);
-  }
-  else {
-    schunk->current_nchunk = nchunk;
-  }
+  set_current_nchunk(schunk, nchunk);
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
   if (schunk->frame != NULL) {
     return frame_get_lazychunk(frame, nchunk, chunk, needs_free);
@@ -1199,7 +6305,148 @@ int blosc2_schunk_get_lazychunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *
 }
 
 
-int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t stop, void *buffer) {
+/* Get a view of a chunk, with no copies nor allocations. */
+int blosc2_schunk_get_chunk_view(blosc2_schunk *schunk, int64_t nchunk, blosc2_chunk_view *view) {
+  set_current_nchunk(schunk, nchunk);
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame != NULL) {
+    int rc = frame_get_chunk_view(frame, nchunk, view);
+    if (rc == 0) {
+      BLOSC_TRACE_ERROR("Chunk %" PRId64 " lives in a file and cannot be viewed.", nchunk);
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+    return rc;
+  }
+
+  if (nchunk >= schunk->nchunks) {
+    BLOSC_TRACE_ERROR("nchunk ('%" PRId64 "') exceeds the number of chunks "
+                      "('%" PRId64 "') in schunk.", nchunk, schunk->nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  uint8_t *chunk = schunk->data[nchunk];
+  if (chunk == NULL) {
+    BLOSC_TRACE_ERROR("Chunk %" PRId64 " is not initialized.", nchunk);
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  int rc = blosc2_cbuffer_sizes(chunk, &view->nbytes, &view->cbytes, NULL);
+  if (rc < 0) {
+    return rc;
+  }
+  view->chunk = chunk;
+  view->special = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  return view->cbytes;
+}
+
+
+/* Write a range of chunks to a file descriptor, by the kernel for the frames on disk. */
+int64_t blosc2_schunk_send_chunks(blosc2_schunk *schunk, int64_t start, int64_t stop, int fd) {
+  if (start < 0 || stop > schunk->nchunks || start > stop) {
+    BLOSC_TRACE_ERROR("The chunks from %" PRId64 " to %" PRId64 " are not in the super-chunk "
+                      "('%" PRId64 "' chunks).", start, stop, schunk->nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame != NULL) {
+    return frame_send_chunks(frame, start, stop, fd);
+  }
+
+  int64_t sent = 0;
+  for (int64_t nchunk = start; nchunk < stop; nchunk++) {
+    uint8_t *chunk = schunk->data[nchunk];
+    if (chunk == NULL) {
+      BLOSC_TRACE_ERROR("Chunk %" PRId64 " is not initialized.", nchunk);
+      return BLOSC2_ERROR_NOT_FOUND;
+    }
+    int32_t cbytes;
+    int rc = blosc2_cbuffer_sizes(chunk, NULL, &cbytes, NULL);
+    if (rc < 0) {
+      return rc;
+    }
+    rc = stdio_write_fd(fd, chunk, cbytes);
+    if (rc < 0) {
+      return rc;
+    }
+    sent += cbytes;
+  }
+  return sent;
+}
+
+
+/* Get what a range of chunks are made of, out of their headers only. */
+int blosc2_schunk_get_chunks_info(blosc2_schunk *schunk, int64_t start, int64_t stop,
+                                  blosc2_chunk_info *info) {
+  if (start < 0 || stop > schunk->nchunks || start > stop) {
+    BLOSC_TRACE_ERROR("The chunks from %" PRId64 " to %" PRId64 " are not in the super-chunk "
+                      "('%" PRId64 "' chunks).", start, stop, schunk->nchunks);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int rc;
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame != NULL) {
+    uint8_t *headers = malloc((size_t)(stop - start) * BLOSC_EXTENDED_HEADER_LENGTH);
+    BLOSC_ERROR_NULL(headers, BLOSC2_ERROR_MEMORY_ALLOC);
+    rc = frame_get_chunk_headers(frame, start, stop, headers);
+    for (int64_t nchunk = start; rc >= 0 && nchunk < stop; nchunk++) {
+      rc = blosc2_cbuffer_info(headers + (nchunk - start) * BLOSC_EXTENDED_HEADER_LENGTH,
+                               BLOSC_EXTENDED_HEADER_LENGTH, &info[nchunk - start]);
+    }
+    free(headers);
+    return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+  }
+
+  for (int64_t nchunk = start; nchunk < stop; nchunk++) {
+    uint8_t *chunk = schunk->data[nchunk];
+    if (chunk == NULL) {
+      BLOSC_TRACE_ERROR("Chunk %" PRId64 " is not initialized.", nchunk);
+      return BLOSC2_ERROR_NOT_FOUND;
+    }
+    rc = blosc2_cbuffer_info(chunk, BLOSC_EXTENDED_HEADER_LENGTH, &info[nchunk - start]);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_schunk_get_chunk_info(blosc2_schunk *schunk, int64_t nchunk, blosc2_chunk_info *info) {
+  return blosc2_schunk_get_chunks_info(schunk, nchunk, nchunk + 1, info);
+}
+
+
+/* Decompress whole the `nchunks` chunks starting at `nchunk` into consecutive areas of
+ * `dest`, in parallel on the shared pool.  Returns the number of bytes decompressed. */
+/* Get a lazy chunk whose buffers come from the allocator of dctx (see frame_get_lazychunk_ctx()) */
+static int get_lazychunk_ctx(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chunk, bool *needs_free,
+                             blosc2_context *dctx) {
+  if (schunk->frame == NULL) {
+    // A pointer to the chunk is returned
+    return blosc2_schunk_get_lazychunk(schunk, nchunk, chunk, needs_free);
+  }
+  set_current_nchunk(schunk, nchunk);
+  return frame_get_lazychunk_ctx((blosc2_frame_s *) schunk->frame, nchunk, chunk, needs_free, dctx);
+}
+
+
+static int64_t get_slice_chunks(blosc2_schunk *schunk, int64_t nchunk, int nchunks, uint8_t *dest) {
+  void **dests = malloc(nchunks * sizeof(void *));
+  int32_t *destsizes = malloc(nchunks * sizeof(int32_t));
+  int64_t rc = BLOSC2_ERROR_MEMORY_ALLOC;
+  if (dests != NULL && destsizes != NULL) {
+    for (int i = 0; i < nchunks; i++) {
+      dests[i] = dest + (int64_t) i * schunk->chunksize;
+      destsizes[i] = schunk->chunksize;
+    }
+    rc = blosc2_schunk_decompress_chunks(schunk, nchunk, nchunks, dests, destsizes);
+  }
+  free(dests);
+  free(destsizes);
+  return rc;
+}
+
+
+static int get_slice_buffer(blosc2_schunk *schunk, blosc2_context *dctx, int64_t start, int64_t stop,
+                            void *buffer) {
   int64_t byte_start = start * schunk->typesize;
   int64_t byte_stop = stop * schunk->typesize;
   int64_t nchunk_start = byte_start / schunk->chunksize;
@@ -1221,78 +6468,141 @@ int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
   int32_t nbytes;
   int32_t chunksize = schunk->chunksize;
 
+  // The chunks in between the edges of the slice are decompressed whole, and in parallel
+  int64_t batch_start = (byte_start + chunksize - 1) / chunksize;
+  int64_t batch_stop = byte_stop >= schunk->nbytes ? schunk->nchunks : byte_stop / chunksize;
+  bool batch = batch_stop - batch_start >= 2 && batch_stop - batch_start <= INT32_MAX &&
+               blosc_pool_nthreads() > 0 && dctx->postfilter == NULL && schunk->chunk_cache == NULL;
+
   while (nbytes_read < ((stop - start) * schunk->typesize)) {
-    cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
-    if (cbytes < 0) {
-      BLOSC_TRACE_ERROR("Cannot get lazychunk ('%" PRId64 "').", nchunk);
-      return BLOSC2_ERROR_FAILURE;
+    if (batch && nchunk == batch_start) {
+      int64_t rc = get_slice_chunks(schunk, nchunk, (int) (batch_stop - batch_start), dst_ptr);
+      if (rc < 0) {
+        BLOSC_TRACE_ERROR("Cannot decompress chunks [%" PRId64 ", %" PRId64 ").", batch_start, batch_stop);
+        return (int) rc;
+      }
+      dst_ptr += rc;
+      nbytes_read += rc;
+      nchunk = batch_stop;
+      chunk_start = 0;
+      if (byte_stop >= (nchunk + 1) * chunksize) {
+        chunk_stop = chunksize;
+      }
+      else {
+        chunk_stop = (int32_t)(byte_stop % chunksize);
+      }
+      continue;
     }
-    int32_t blocksize = sw32_(chunk + BLOSC2_CHUNK_BLOCKSIZE);
 
-    int32_t nblock_start = (int32_t) (chunk_start / blocksize);
-    int32_t nblock_stop = (int32_t) ((chunk_stop - 1) / blocksize);
-    if (nchunk == (schunk->nchunks - 1) && schunk->nbytes % schunk->chunksize != 0) {
-      chunksize = schunk->nbytes % schunk->chunksize;
+    /* Repeated reads of a chunk are served from the chunk cache, if any */
+    uint8_t *cached;
+    int cached_nbytes = schunk_cache_get_chunk(schunk, nchunk, &cached);
+    if (cached_nbytes < 0 && cached_nbytes != BLOSC2_ERROR_NOT_FOUND) {
+      BLOSC_TRACE_ERROR("Cannot decompress chunk ('%" PRId64 "').", nchunk);
+      return cached_nbytes;
     }
-    int32_t nblocks = chunksize / blocksize;
-    if (chunksize % blocksize != 0) {
-      nblocks++;
+    if (cached_nbytes >= 0) {
+      if (chunk_stop > cached_nbytes) {
+        chunk_stop = cached_nbytes;
+      }
+      nbytes = chunk_stop - chunk_start;
+      memcpy(dst_ptr, cached + chunk_start, nbytes);
     }
-
-    if (chunk_start == 0 && chunk_stop == chunksize) {
-      // Avoid memcpy
-      nbytes = blosc2_decompress_ctx(schunk->dctx, chunk, cbytes, dst_ptr, chunksize);
+    else if (schunk->xdelta != NULL) {
+      /* Any part of a chunk with deltas needs the whole previous one */
+      bool whole = chunk_start == 0 && chunk_stop == chunksize;
+      uint8_t *data = whole ? dst_ptr : malloc(chunksize);
+      BLOSC_ERROR_NULL(data, BLOSC2_ERROR_MEMORY_ALLOC);
+      nbytes = schunk_decompress_chunk_ctx(schunk, dctx, nchunk, data, chunksize);
+      if (nbytes >= 0 && !whole) {
+        if (chunk_stop > nbytes) {
+          chunk_stop = nbytes;
+        }
+        nbytes = chunk_stop - chunk_start;
+        memcpy(dst_ptr, data + chunk_start, nbytes);
+      }
+      if (!whole) {
+        free(data);
+      }
       if (nbytes < 0) {
         BLOSC_TRACE_ERROR("Cannot decompress chunk ('%" PRId64 "').", nchunk);
-        return BLOSC2_ERROR_FAILURE;
+        return nbytes;
       }
     }
     else {
-      // After extensive timing I have not been able to see lots of situations where
-      // a maskout read is better than a getitem one.  Disabling for now.
-      // if (nblock_start != nblock_stop) {
-      if (false) {
-        uint8_t *data = malloc(chunksize);
-        /* We have more than 1 block to read, so use a masked read */
-        bool *block_maskout = calloc(nblocks, 1);
-        for (int32_t nblock = 0; nblock < nblocks; nblock++) {
-          if ((nblock < nblock_start) || (nblock > nblock_stop)) {
-            block_maskout[nblock] = true;
-          }
-        }
-        if (blosc2_set_maskout(schunk->dctx, block_maskout, nblocks) < 0) {
-          BLOSC_TRACE_ERROR("Cannot set maskout");
-          return BLOSC2_ERROR_FAILURE;
-        }
+      cbytes = get_lazychunk_ctx(schunk, nchunk, &chunk, &needs_free, dctx);
+      if (cbytes < 0) {
+        BLOSC_TRACE_ERROR("Cannot get lazychunk ('%" PRId64 "').", nchunk);
+        return BLOSC2_ERROR_FAILURE;
+      }
+      dctx->nchunk = nchunk;
+      int32_t blocksize = sw32_(chunk + BLOSC2_CHUNK_BLOCKSIZE);
+
+      int32_t nblock_start = (int32_t) (chunk_start / blocksize);
+      int32_t nblock_stop = (int32_t) ((chunk_stop - 1) / blocksize);
+      if (nchunk == (schunk->nchunks - 1) && schunk->nbytes % schunk->chunksize != 0) {
+        chunksize = schunk->nbytes % schunk->chunksize;
+      }
+      int32_t nblocks = chunksize / blocksize;
+      if (chunksize % blocksize != 0) {
+        nblocks++;
+      }
 
-        nbytes = blosc2_decompress_ctx(schunk->dctx, chunk, cbytes, data, chunksize);
+      if (chunk_start == 0 && chunk_stop == chunksize) {
+        // Avoid memcpy
+        nbytes = blosc2_decompress_ctx(dctx, chunk, cbytes, dst_ptr, chunksize);
         if (nbytes < 0) {
           BLOSC_TRACE_ERROR("Cannot decompress chunk ('%" PRId64 "').", nchunk);
           return BLOSC2_ERROR_FAILURE;
         }
-        nbytes = chunk_stop - chunk_start;
-        memcpy(dst_ptr, &data[chunk_start], nbytes);
-        free(block_maskout);
-        free(data);
       }
       else {
-        /* Less than 1 block to read; use a getitem call */
-        nbytes = blosc2_getitem_ctx(schunk->dctx, chunk, cbytes, (int32_t) (chunk_start / schunk->typesize),
-                                    (chunk_stop - chunk_start) / schunk->typesize, dst_ptr, chunksize);
-        if (nbytes < 0) {
-          BLOSC_TRACE_ERROR("Cannot get item from ('%" PRId64 "') chunk.", nchunk);
-          return BLOSC2_ERROR_FAILURE;
+        // After extensive timing I have not been able to see lots of situations where
+        // a maskout read is better than a getitem one.  Disabling for now.
+        // if (nblock_start != nblock_stop) {
+        if (false) {
+          uint8_t *data = malloc(chunksize);
+          /* We have more than 1 block to read, so use a masked read */
+          bool *block_maskout = calloc(nblocks, 1);
+          for (int32_t nblock = 0; nblock < nblocks; nblock++) {
+            if ((nblock < nblock_start) || (nblock > nblock_stop)) {
+              block_maskout[nblock] = true;
+            }
+          }
+          if (blosc2_set_maskout(dctx, block_maskout, nblocks) < 0) {
+            BLOSC_TRACE_ERROR("Cannot set maskout");
+            return BLOSC2_ERROR_FAILURE;
+          }
+
+          nbytes = blosc2_decompress_ctx(dctx, chunk, cbytes, data, chunksize);
+          if (nbytes < 0) {
+            BLOSC_TRACE_ERROR("Cannot decompress chunk ('%" PRId64 "').", nchunk);
+            return BLOSC2_ERROR_FAILURE;
+          }
+          nbytes = chunk_stop - chunk_start;
+          memcpy(dst_ptr, &data[chunk_start], nbytes);
+          free(block_maskout);
+          free(data);
         }
+        else {
+          /* Less than 1 block to read; use a getitem call */
+          nbytes = blosc2_getitem_ctx(dctx, chunk, cbytes, (int32_t) (chunk_start / schunk->typesize),
+                                      (chunk_stop - chunk_start) / schunk->typesize, dst_ptr, chunksize);
+          if (nbytes < 0) {
+            BLOSC_TRACE_ERROR("Cannot get item from ('%" PRId64 "') chunk.", nchunk);
+            return BLOSC2_ERROR_FAILURE;
+          }
+        }
+      }
+
+      if (needs_free) {
+        ctx_free(dctx, chunk);
       }
     }
 
     dst_ptr += nbytes;
     nbytes_read += nbytes;
     nchunk++;
-
-    if (needs_free) {
-      free(chunk);
-    }
     chunk_start = 0;
     if (byte_stop >= (nchunk + 1) * chunksize) {
       chunk_stop = chunksize;
@@ -1306,6 +6616,157 @@ int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
 }
 
 
+int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t stop, void *buffer) {
+  blosc2_context *dctx = schunk_acquire_dctx(schunk);
+  BLOSC_ERROR_NULL(dctx, BLOSC2_ERROR_MEMORY_ALLOC);
+  int rc = get_slice_buffer(schunk, dctx, start, stop, buffer);
+  schunk_release_dctx(schunk, dctx);
+  return rc;
+}
+
+
+/* Get `nitems` items of chunk `nchunk` that are `step` apart, starting at item `first`, into
+ * `dest`.  Only the blocks holding some of them are read and decompressed (into `scratch`). */
+static int get_chunk_step(blosc2_schunk *schunk, blosc2_context *dctx, int64_t nchunk, int32_t first,
+                          int64_t nitems, int64_t step, uint8_t *dest, uint8_t *scratch) {
+  int32_t typesize = schunk->typesize;
+  int64_t src_stride = step * typesize;
+  int64_t dest_stride = typesize;
+  uint8_t *data;
+  int rc = schunk_cache_get_chunk(schunk, nchunk, &data);
+  if (rc < 0 && rc != BLOSC2_ERROR_NOT_FOUND) {
+    return rc;
+  }
+  if (rc < 0 && schunk->xdelta != NULL) {
+    // A chunk with deltas needs the whole previous one anyway
+    rc = schunk_decompress_chunk_ctx(schunk, dctx, nchunk, scratch, schunk->chunksize);
+    data = scratch;
+  }
+  else if (rc < 0) {
+    uint8_t *chunk;
+    bool needs_free;
+    int cbytes = get_lazychunk_ctx(schunk, nchunk, &chunk, &needs_free, dctx);
+    if (cbytes < 0) {
+      return cbytes;
+    }
+    dctx->nchunk = nchunk;
+    int32_t nbytes;
+    int32_t blocksize;
+    rc = blosc2_cbuffer_sizes(chunk, &nbytes, NULL, &blocksize);
+    bool special = (chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+    if (rc >= 0 && nitems == 1) {
+      rc = blosc2_getitem_ctx(dctx, chunk, cbytes, first, 1, dest, typesize);
+    }
+    else if (rc >= 0) {
+      // Leave the blocks without items out (when the step spans several blocks, most of them)
+      int32_t nblocks = blocksize > 0 ? (nbytes + blocksize - 1) / blocksize : 0;
+      bool *maskout = special || nblocks <= 1 ? NULL : malloc(nblocks);
+      if (maskout != NULL) {
+        memset(maskout, true, nblocks);
+        for (int64_t i = 0; i < nitems; i++) {
+          maskout[(first + i * step) * typesize / blocksize] = false;
+        }
+        if (memchr(maskout, true, nblocks) != NULL) {
+          rc = blosc2_set_maskout(dctx, maskout, nblocks);
+        }
+        free(maskout);
+      }
+      if (rc >= 0) {
+        rc = blosc2_decompress_ctx(dctx, chunk, cbytes, scratch, nbytes);
+      }
+    }
+    if (needs_free) {
+      free(chunk);
+    }
+    if (rc < 0 || nitems == 1) {
+      return rc;
+    }
+    data = scratch;
+  }
+  if (rc < 0) {
+    return rc;
+  }
+  b2nd_copy_buffer_strided(1, (uint8_t) typesize, &nitems, data + (int64_t) first * typesize, &src_stride,
+                           dest, &dest_stride);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_schunk_get_slice_buffer_step(blosc2_schunk *schunk, int64_t start, int64_t stop, int64_t step,
+                                        void *buffer) {
+  BLOSC_ERROR_NULL(schunk, BLOSC2_ERROR_NULL_POINTER);
+  if (step < 1 || start < 0 || stop < start || stop > schunk->nbytes / schunk->typesize) {
+    BLOSC_TRACE_ERROR("The slice [%" PRId64 ", %" PRId64 ") with step %" PRId64 " is not valid.", start, stop, step);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (step == 1) {
+    return blosc2_schunk_get_slice_buffer(schunk, start, stop, buffer);
+  }
+  int64_t nitems = (stop - start + step - 1) / step;
+  if (nitems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  int64_t chunkitems = schunk->chunksize / schunk->typesize;
+  uint8_t *scratch = malloc(schunk->chunksize);
+  BLOSC_ERROR_NULL(scratch, BLOSC2_ERROR_MEMORY_ALLOC);
+  blosc2_context *dctx = schunk_acquire_dctx(schunk);
+  if (dctx == NULL) {
+    free(scratch);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  uint8_t *dest = (uint8_t *) buffer;
+  int rc = BLOSC2_ERROR_SUCCESS;
+  // The chunks without items in between are not even read
+  for (int64_t i = 0; i < nitems && rc >= 0;) {
+    int64_t item = start + i * step;
+    int64_t nchunk = item / chunkitems;
+    int32_t first = (int32_t) (item % chunkitems);
+    int64_t chunk_nitems = (chunkitems - first + step - 1) / step;
+    if (chunk_nitems > nitems - i) {
+      chunk_nitems = nitems - i;
+    }
+    rc = get_chunk_step(schunk, dctx, nchunk, first, chunk_nitems, step, dest, scratch);
+    if (rc < 0) {
+      BLOSC_TRACE_ERROR("Cannot get the items of chunk ('%" PRId64 "').", nchunk);
+    }
+    dest += chunk_nitems * schunk->typesize;
+    i += chunk_nitems;
+  }
+  schunk_release_dctx(schunk, dctx);
+  free(scratch);
+  return rc < 0 ? rc : BLOSC2_ERROR_SUCCESS;
+}
+
+
+int blosc2_schunk_get_item(blosc2_schunk *schunk, int64_t index, void *dest) {
+  if (index < 0 || index >= schunk->nbytes / schunk->typesize) {
+    BLOSC_TRACE_ERROR("Index ('%" PRId64 "') is out of the super-chunk.", index);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  // The chunk cache, if any, has the decompressed chunks at hand, and deltas need whole chunks
+  if (frame == NULL || schunk->chunk_cache != NULL || schunk->xdelta != NULL || schunk->chunksize <= 0) {
+    return blosc2_schunk_get_slice_buffer(schunk, index, index + 1, dest);
+  }
+
+  int64_t byte_index = index * schunk->typesize;
+  int64_t nchunk = byte_index / schunk->chunksize;
+  int32_t start = (int32_t) (byte_index % schunk->chunksize) / schunk->typesize;
+  set_current_nchunk(schunk, nchunk);
+  blosc2_context *dctx = schunk_acquire_dctx(schunk);
+  BLOSC_ERROR_NULL(dctx, BLOSC2_ERROR_MEMORY_ALLOC);
+  dctx->nchunk = nchunk;
+  int rc = frame_get_item(dctx, frame, nchunk, start, dest, schunk->typesize);
+  schunk_release_dctx(schunk, dctx);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot get item from ('%" PRId64 "') chunk.", nchunk);
+    return rc;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
 int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t stop, void *buffer) {
   int64_t byte_start = start * schunk->typesize;
   int64_t byte_stop = stop * schunk->typesize;
@@ -1333,8 +6794,10 @@ int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
       if (chunk_stop == schunk->nbytes % schunk->chunksize) {
         chunksize = chunk_stop;
       }
-      uint8_t *chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
-      if (blosc2_compress_ctx(schunk->cctx, src_ptr, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD) < 0) {
+      int32_t destsize = chunksize + BLOSC2_MAX_OVERHEAD +
+                         trailer_maxlen(schunk->cctx->checksum, schunk->cctx->cipher, chunksize, schunk->cctx->blocksize);
+      uint8_t *chunk = malloc(destsize);
+      if (blosc2_compress_ctx(schunk->cctx, src_ptr, chunksize, chunk, destsize) < 0) {
         BLOSC_TRACE_ERROR("Cannot compress data of chunk ('%" PRId64 "').", nchunk);
         return BLOSC2_ERROR_FAILURE;
       }
@@ -1351,8 +6814,10 @@ int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
         return BLOSC2_ERROR_FAILURE;
       }
       memcpy(&data[chunk_start], src_ptr, chunk_stop - chunk_start);
-      uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
-      if (blosc2_compress_ctx(schunk->cctx, data, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD) < 0) {
+      int32_t destsize = nbytes + BLOSC2_MAX_OVERHEAD +
+                         trailer_maxlen(schunk->cctx->checksum, schunk->cctx->cipher, nbytes, schunk->cctx->blocksize);
+      uint8_t *chunk = malloc(destsize);
+      if (blosc2_compress_ctx(schunk->cctx, data, nbytes, chunk, destsize) < 0) {
         BLOSC_TRACE_ERROR("Cannot compress data of chunk ('%" PRId64 "').", nchunk);
         return BLOSC2_ERROR_FAILURE;
       }
@@ -1381,6 +6846,10 @@ int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t
 
 /* Reorder the chunk offsets of an existing super-chunk. */
 int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order) {
+  BLOSC_ERROR(check_not_read_only(schunk));
+  BLOSC_ERROR(check_no_concurrent_reads(schunk));
+  BLOSC_ERROR(check_no_concurrent_writes(schunk));
+  BLOSC_ERROR(check_no_xdelta(schunk));
   // Check that the offsets order are correct
   bool *index_check = (bool *) calloc(schunk->nchunks, sizeof(bool));
   for (int i = 0; i < schunk->nchunks; ++i) {
@@ -1399,6 +6868,11 @@ int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order)
     }
   }
   free(index_check);
+  schunk_invalidate_reads(schunk, -1);
+
+  BLOSC_ERROR(zonemap_reorder(schunk, offsets_order));
+  BLOSC_ERROR(bloom_reorder(schunk, offsets_order));
+  BLOSC_ERROR(changes_reorder(schunk, offsets_order));
 
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
   if (frame != NULL) {
@@ -1419,6 +6893,20 @@ int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order)
 }
 
 
+/* Reclaim the space left behind by the updates and deletions of chunks in a contiguous frame. */
+int64_t blosc2_schunk_compact(blosc2_schunk *schunk, bool in_place) {
+  BLOSC_ERROR(check_not_read_only(schunk));
+  BLOSC_ERROR(check_no_concurrent_reads(schunk));
+  BLOSC_ERROR(check_no_concurrent_writes(schunk));
+  blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
+  if (frame == NULL) {
+    // Chunks in memory are freed along with them
+    return 0;
+  }
+  return frame_compact(frame, in_place);
+}
+
+
 // Get the length (in bytes) of the internal frame of the super-chunk
 int64_t blosc2_schunk_frame_len(blosc2_schunk* schunk) {
   int64_t len;
@@ -1472,6 +6960,7 @@ int metalayer_flush(blosc2_schunk* schunk) {
  * If successful, return the index of the new metalayer.  Else, return a negative value.
  */
 int blosc2_meta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len) {
+  BLOSC_ERROR(check_not_read_only(schunk));
   int nmetalayer = blosc2_meta_exists(schunk, name);
   if (nmetalayer >= 0) {
     BLOSC_TRACE_ERROR("Metalayer \"%s\" already exists.", name);
@@ -1504,6 +6993,7 @@ int blosc2_meta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, i
  * If successful, return the index of the new metalayer.  Else, return a negative value.
  */
 int blosc2_meta_update(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len) {
+  BLOSC_ERROR(check_not_read_only(schunk));
   int nmetalayer = blosc2_meta_exists(schunk, name);
   if (nmetalayer < 0) {
     BLOSC_TRACE_ERROR("Metalayer \"%s\" not found.", name);
@@ -1551,12 +7041,19 @@ int blosc2_vlmeta_exists(blosc2_schunk *schunk, const char *name) {
   return BLOSC2_ERROR_NOT_FOUND;
 }
 
-int vlmetalayer_flush(blosc2_schunk* schunk) {
+int vlmetalayer_flush(blosc2_schunk* schunk, bool same_header) {
   int rc = BLOSC2_ERROR_SUCCESS;
   blosc2_frame_s* frame = (blosc2_frame_s*)schunk->frame;
   if (frame == NULL) {
     return rc;
   }
+  if (same_header) {
+    // Changes that fit in the trailer (see blosc2_storage.trailer_padding) cost a single write
+    rc = frame_update_vlmetalayers(frame, schunk);
+    if (rc != 0) {
+      return rc;
+    }
+  }
   rc = frame_update_header(frame, schunk, false);
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Unable to update metalayers into frame.");
@@ -1576,6 +7073,7 @@ int vlmetalayer_flush(blosc2_schunk* schunk) {
  */
 int blosc2_vlmeta_add(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
                       blosc2_cparams *cparams) {
+  BLOSC_ERROR(check_not_read_only(schunk));
   int nvlmetalayer = blosc2_vlmeta_exists(schunk, name);
   if (nvlmetalayer >= 0) {
     BLOSC_TRACE_ERROR("Variable-length metalayer \"%s\" already exists.", name);
@@ -1610,8 +7108,8 @@ int blosc2_vlmeta_add(blosc2_schunk *schunk, const char *name, uint8_t *content,
   schunk->vlmetalayers[schunk->nvlmetalayers] = vlmetalayer;
   schunk->nvlmetalayers += 1;
 
-  // Propagate to frames
-  int rc = vlmetalayer_flush(schunk);
+  // Propagate to frames (the header only tells whether there are vlmetalayers)
+  int rc = vlmetalayer_flush(schunk, schunk->nvlmetalayers > 1);
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Can not propagate de `%s` variable-length metalayer to a frame.", name);
     return rc;
@@ -1628,6 +7126,11 @@ int blosc2_vlmeta_get(blosc2_schunk *schunk, const char *name, uint8_t **content
     BLOSC_TRACE_ERROR("User metalayer \"%s\" not found.", name);
     return nvlmetalayer;
   }
+  // The contents of on-disk frames are read the first time that they are needed
+  int rc = frame_load_vlmetalayers((blosc2_frame_s*)schunk->frame, schunk, nvlmetalayer);
+  if (rc < 0) {
+    return rc;
+  }
   blosc2_metalayer *meta = schunk->vlmetalayers[nvlmetalayer];
   int32_t nbytes, cbytes;
   blosc2_cbuffer_sizes(meta->content, &nbytes, &cbytes, NULL);
@@ -1653,11 +7156,17 @@ int blosc2_vlmeta_get(blosc2_schunk *schunk, const char *name, uint8_t **content
 
 int blosc2_vlmeta_update(blosc2_schunk *schunk, const char *name, uint8_t *content, int32_t content_len,
                          blosc2_cparams *cparams) {
+  BLOSC_ERROR(check_not_read_only(schunk));
   int nvlmetalayer = blosc2_vlmeta_exists(schunk, name);
   if (nvlmetalayer < 0) {
     BLOSC_TRACE_ERROR("User vlmetalayer \"%s\" not found.", name);
     return nvlmetalayer;
   }
+  // The trailer is rewritten with the rest of the contents
+  int rc = frame_load_vlmetalayers((blosc2_frame_s*)schunk->frame, schunk, -1);
+  if (rc < 0) {
+    return rc;
+  }
 
   blosc2_metalayer *vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
   free(vlmetalayer->content);
@@ -1685,7 +7194,7 @@ int blosc2_vlmeta_update(blosc2_schunk *schunk, const char *name, uint8_t *conte
   vlmetalayer->content_len = csize;
 
   // Propagate to frames
-  int rc = vlmetalayer_flush(schunk);
+  rc = vlmetalayer_flush(schunk, true);
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Can not propagate de `%s` variable-length metalayer to a frame.", name);
     return rc;
@@ -1695,11 +7204,17 @@ int blosc2_vlmeta_update(blosc2_schunk *schunk, const char *name, uint8_t *conte
 }
 
 int blosc2_vlmeta_delete(blosc2_schunk *schunk, const char *name) {
+  BLOSC_ERROR(check_not_read_only(schunk));
   int nvlmetalayer = blosc2_vlmeta_exists(schunk, name);
   if (nvlmetalayer < 0) {
     BLOSC_TRACE_ERROR("User vlmetalayer \"%s\" not found.", name);
     return nvlmetalayer;
   }
+  // The trailer is rewritten with the rest of the contents
+  int rc = frame_load_vlmetalayers((blosc2_frame_s*)schunk->frame, schunk, -1);
+  if (rc < 0) {
+    return rc;
+  }
 
   blosc2_metalayer *vlmetalayer = schunk->vlmetalayers[nvlmetalayer];
   for (int i = nvlmetalayer; i < (schunk->nvlmetalayers - 1); i++) {
@@ -1709,9 +7224,14 @@ int blosc2_vlmeta_delete(blosc2_schunk *schunk, const char *name) {
   schunk->nvlmetalayers--;
 
   // Propagate to frames
-  int rc = vlmetalayer_flush(schunk);
+  rc = vlmetalayer_flush(schunk, schunk->nvlmetalayers > 0);
   if (rc < 0) {
     BLOSC_TRACE_ERROR("Can not propagate de `%s` variable-length metalayer to a frame.", name);
+  }
+  // The name may be the one passed
+  free(vlmetalayer->name);
+  free(vlmetalayer);
+  if (rc < 0) {
     return rc;
   }
 
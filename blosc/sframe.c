@@ -8,9 +8,19 @@
   See LICENSE.txt for details about copyright and rights to use.
 **********************************************************************/
 
+#include "sframe.h"
 #include "frame.h"
 #include "blosc2.h"
+#include "blosc-private.h"
 
+#if defined(_WIN32)
+#include <direct.h>
+#define mkdir(D, M) _mkdir(D)
+#endif  /* _WIN32 */
+
+#include <sys/stat.h>
+
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -42,28 +52,181 @@ void* sframe_open_index(const char* urlpath, const char* mode, const blosc2_io *
   return fp;
 }
 
-/* Open directory/nchunk.chunk with 8 zeros of padding */
-void* sframe_open_chunk(const char* urlpath, int64_t nchunk, const char* mode, const blosc2_io *io) {
-  void* fp = NULL;
-  char* chunk_path = malloc(strlen(urlpath) + 1 + 8 + strlen(".chunk") + 1);
-  if (chunk_path) {
-    sprintf(chunk_path, "%s/%08X.chunk", urlpath, (unsigned int)nchunk);
-    blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
-    if (io_cb == NULL) {
-      BLOSC_TRACE_ERROR("Error getting the input/output API");
-      return NULL;
+void* sframe_open_index_log(const char* urlpath, const char* mode, const blosc2_io *io) {
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return NULL;
+  }
+  char* log_path = malloc(strlen(urlpath) + strlen("/chunks.b2log") + 1);
+  if (log_path == NULL) {
+    return NULL;
+  }
+  sprintf(log_path, "%s/chunks.b2log", urlpath);
+  void* fp = io_cb->open(log_path, mode, io->params);
+  free(log_path);
+  return fp;
+}
+
+/* The path of the file of a sparse frame that holds the chunk `nchunk`: its own, or its shard */
+static char* chunk_file_path(blosc2_frame_s* frame, int64_t nchunk) {
+  char* path = malloc(strlen(frame->urlpath) + 3 * FRAME_DIR_LEVELS_MAX + 1 + 8 + strlen(".chunk") + 1);
+  if (path != NULL) {
+    unsigned int id = (unsigned int)sframe_file_id(frame, nchunk);
+    char* p = path + sprintf(path, "%s", frame->urlpath);
+    for (int level = 0; level < frame->dir_levels; level++) {
+      p += sprintf(p, "/%02X", (id >> (8 * level)) & 0xffu);
     }
-    fp = io_cb->open(chunk_path, mode, io->params);
-    if (fp == NULL)
-      BLOSC_TRACE_ERROR("Error opening chunk path in: %s", chunk_path);
-    free(chunk_path);
+    sprintf(p, frame->shard_nchunks > 0 ? "/%08X.shard" : "/%08X.chunk", id);
+  }
+  return path;
+}
+
+/* Create the subdirectories of the file at `path` that are still missing */
+static void make_chunk_dirs(blosc2_frame_s* frame, char* path) {
+  char* sep = path + strlen(frame->urlpath);
+  for (int level = 0; level < frame->dir_levels; level++) {
+    sep = strchr(sep + 1, '/');
+    *sep = '\0';
+    mkdir(path, 0777);  // it may exist already
+    *sep = '/';
+  }
+}
+
+/* Open the file that holds the chunk `nchunk` (quietly, as shards may not exist yet) */
+static void* open_chunk_file(blosc2_frame_s* frame, int64_t nchunk, const char* mode) {
+  blosc2_io *io = frame->schunk->storage->io;
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return NULL;
+  }
+  char* path = chunk_file_path(frame, nchunk);
+  if (path == NULL) {
+    return NULL;
+  }
+  void* fp = io_cb->open(path, mode, io->params);
+  if (fp == NULL && mode[0] == 'w' && frame->dir_levels > 0) {
+    // The first file in its subdirectories
+    make_chunk_dirs(frame, path);
+    fp = io_cb->open(path, mode, io->params);
   }
+  free(path);
   return fp;
 }
 
+/* Read the entry of the chunk `nchunk` in the index of its shard */
+static int read_shard_entry(blosc2_frame_s* frame, blosc2_io_cb* io_cb, void* fp, int64_t nchunk,
+                            int64_t* position, int64_t* cbytes) {
+  uint8_t entry[SFRAME_SHARD_ENTRY_LEN];
+  int64_t slot = nchunk % frame->shard_nchunks;
+  if (io_pread(io_cb, entry, 1, SFRAME_SHARD_ENTRY_LEN, slot * SFRAME_SHARD_ENTRY_LEN, fp) !=
+      SFRAME_SHARD_ENTRY_LEN) {
+    BLOSC_TRACE_ERROR("Cannot read the index of the shard of chunk %" PRId64 ".", nchunk);
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  from_little(position, entry, sizeof(int64_t));
+  from_little(cbytes, entry + sizeof(int64_t), sizeof(int64_t));
+  if (*cbytes <= 0) {
+    BLOSC_TRACE_ERROR("The chunk %" PRId64 " is not in its shard.", nchunk);
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  return 0;
+}
+
+/* Write the entry of the chunk `nchunk` in the index of its shard (a zero `cbytes` removes it) */
+static int write_shard_entry(blosc2_frame_s* frame, blosc2_io_cb* io_cb, void* fp, int64_t nchunk,
+                             int64_t position, int64_t cbytes) {
+  uint8_t entry[SFRAME_SHARD_ENTRY_LEN];
+  to_little(entry, &position, sizeof(int64_t));
+  to_little(entry + sizeof(int64_t), &cbytes, sizeof(int64_t));
+  int64_t slot = nchunk % frame->shard_nchunks;
+  if (io_pwrite(io_cb, entry, 1, SFRAME_SHARD_ENTRY_LEN, slot * SFRAME_SHARD_ENTRY_LEN, fp) !=
+      SFRAME_SHARD_ENTRY_LEN) {
+    BLOSC_TRACE_ERROR("Cannot write the index of the shard of chunk %" PRId64 ".", nchunk);
+    return BLOSC2_ERROR_FILE_WRITE;
+  }
+  return 0;
+}
+
+int64_t sframe_file_id(blosc2_frame_s* frame, int64_t nchunk) {
+  return frame->shard_nchunks > 0 ? nchunk / frame->shard_nchunks : nchunk;
+}
+
+void* sframe_open_file(blosc2_frame_s* frame, int64_t nchunk, const char* mode) {
+  void* fp = open_chunk_file(frame, nchunk, mode);
+  if (fp == NULL) {
+    BLOSC_TRACE_ERROR("Error opening the file of chunk %" PRId64 " in: %s", nchunk, frame->urlpath);
+  }
+  return fp;
+}
+
+/* Open the file of a chunk, and find where the chunk starts in it */
+void* sframe_open_chunk(blosc2_frame_s* frame, int64_t nchunk, int64_t* position) {
+  void* fp = sframe_open_file(frame, nchunk, "rb");
+  *position = 0;
+  if (fp == NULL || frame->shard_nchunks == 0) {
+    return fp;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  int64_t cbytes;
+  if (read_shard_entry(frame, io_cb, fp, nchunk, position, &cbytes) < 0) {
+    io_cb->close(fp);
+    return NULL;
+  }
+  return fp;
+}
+
+/* Append a chunk to its shard, and point the index of the shard to it */
+static void* create_shard_chunk(blosc2_frame_s* frame, uint8_t* chunk, int64_t nchunk, int64_t cbytes) {
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return NULL;
+  }
+  void* fp = open_chunk_file(frame, nchunk, "rb+");
+  int64_t index_len = (int64_t)frame->shard_nchunks * SFRAME_SHARD_ENTRY_LEN;
+  if (fp == NULL) {
+    // A new shard starts with an empty index
+    fp = sframe_open_file(frame, nchunk, "wb+");
+    if (fp == NULL) {
+      return NULL;
+    }
+    uint8_t* index = calloc(1, index_len);
+    int64_t wbytes = index == NULL ? 0 : io_pwrite(io_cb, index, 1, index_len, 0, fp);
+    free(index);
+    if (wbytes != index_len) {
+      BLOSC_TRACE_ERROR("Cannot write the index of a new shard.");
+      io_cb->close(fp);
+      return NULL;
+    }
+  }
+  // The chunks go to the end, so that the ones that are read meanwhile stay as they are
+  io_cb->seek(fp, 0, SEEK_END);
+  int64_t position = io_cb->tell(fp);
+  if (position < index_len) {
+    position = index_len;
+  }
+  int64_t wbytes = io_pwrite(io_cb, chunk, 1, cbytes, position, fp);
+  int rc = wbytes == cbytes ? write_shard_entry(frame, io_cb, fp, nchunk, position, cbytes) : BLOSC2_ERROR_FILE_WRITE;
+  io_cb->close(fp);
+  if (rc < 0) {
+    BLOSC_TRACE_ERROR("Cannot write the full chunk.");
+    return NULL;
+  }
+  return frame;
+}
+
 /* Append an existing chunk into a sparse frame. */
 void* sframe_create_chunk(blosc2_frame_s* frame, uint8_t* chunk, int64_t nchunk, int64_t cbytes) {
-  void* fpc = sframe_open_chunk(frame->urlpath, nchunk, "wb", frame->schunk->storage->io);
+  if (frame->shard_nchunks > 0) {
+    if (cbytes == 0) {
+      // Special chunks are not stored
+      return sframe_delete_chunk(frame, nchunk) < 0 ? NULL : frame;
+    }
+    return create_shard_chunk(frame, chunk, nchunk, cbytes);
+  }
+  void* fpc = sframe_open_file(frame, nchunk, "wb");
   if (fpc == NULL) {
     BLOSC_TRACE_ERROR("Cannot open the chunkfile.");
     return NULL;
@@ -83,11 +246,49 @@ void* sframe_create_chunk(blosc2_frame_s* frame, uint8_t* chunk, int64_t nchunk,
   return frame;
 }
 
-/* Append an existing chunk into a sparse frame. */
-int sframe_delete_chunk(const char *urlpath, int64_t nchunk) {
-  char* chunk_path = malloc(strlen(urlpath) + 1 + 8 + strlen(".chunk") + 1);
+/* Remove the entry of a chunk from the index of its shard, and the shard once it is empty */
+static int delete_shard_chunk(blosc2_frame_s* frame, int64_t nchunk) {
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  void* fp = open_chunk_file(frame, nchunk, "rb+");
+  if (fp == NULL) {
+    // Nothing was ever stored in the shard
+    return 0;
+  }
+  int64_t index_len = (int64_t)frame->shard_nchunks * SFRAME_SHARD_ENTRY_LEN;
+  uint8_t* index = malloc(index_len);
+  int rc = BLOSC2_ERROR_FILE_READ;
+  if (index != NULL && io_pread(io_cb, index, 1, index_len, 0, fp) == index_len) {
+    rc = write_shard_entry(frame, io_cb, fp, nchunk, 0, 0);
+  }
+  bool empty = rc == 0;
+  int64_t slot = nchunk % frame->shard_nchunks;
+  for (int64_t i = 0; empty && i < frame->shard_nchunks; i++) {
+    int64_t cbytes;
+    from_little(&cbytes, index + i * SFRAME_SHARD_ENTRY_LEN + sizeof(int64_t), sizeof(int64_t));
+    empty = i == slot || cbytes == 0;
+  }
+  free(index);
+  io_cb->close(fp);
+  if (empty) {
+    char* path = chunk_file_path(frame, nchunk);
+    BLOSC_ERROR_NULL(path, BLOSC2_ERROR_MEMORY_ALLOC);
+    rc = remove(path);
+    free(path);
+  }
+  return rc;
+}
+
+/* Delete a chunk from a sparse frame. */
+int sframe_delete_chunk(blosc2_frame_s* frame, int64_t nchunk) {
+  if (frame->shard_nchunks > 0) {
+    return delete_shard_chunk(frame, nchunk);
+  }
+  char* chunk_path = chunk_file_path(frame, nchunk);
   if (chunk_path) {
-    sprintf(chunk_path, "%s/%08X.chunk", urlpath, (unsigned int)nchunk);
     int rc = remove(chunk_path);
     free(chunk_path);
     return rc;
@@ -97,7 +298,7 @@ int sframe_delete_chunk(const char *urlpath, int64_t nchunk) {
 
 /* Get chunk from sparse frame. */
 int32_t sframe_get_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t** chunk, bool* needs_free){
-  void *fpc = sframe_open_chunk(frame->urlpath, nchunk, "rb", frame->schunk->storage->io);
+  void *fpc = sframe_open_file(frame, nchunk, "rb");
   if(fpc == NULL){
     BLOSC_TRACE_ERROR("Cannot open the chunkfile.");
     return BLOSC2_ERROR_FILE_OPEN;
@@ -109,18 +310,136 @@ int32_t sframe_get_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t** chunk,
     return BLOSC2_ERROR_PLUGIN_IO;
   }
 
-  io_cb->seek(fpc, 0L, SEEK_END);
-  int64_t chunk_cbytes = io_cb->tell(fpc);
+  int64_t position = 0;
+  int64_t chunk_cbytes;
+  if (frame->shard_nchunks > 0) {
+    int rc = read_shard_entry(frame, io_cb, fpc, nchunk, &position, &chunk_cbytes);
+    if (rc < 0) {
+      io_cb->close(fpc);
+      return rc;
+    }
+  }
+  else {
+    io_cb->seek(fpc, 0L, SEEK_END);
+    chunk_cbytes = io_cb->tell(fpc);
+  }
   *chunk = malloc((size_t)chunk_cbytes);
 
-  io_cb->seek(fpc, 0L, SEEK_SET);
-  int64_t rbytes = io_cb->read(*chunk, 1, chunk_cbytes, fpc);
+  int64_t rbytes = io_pread(io_cb, *chunk, 1, chunk_cbytes, position, fpc);
   io_cb->close(fpc);
   if (rbytes != chunk_cbytes) {
     BLOSC_TRACE_ERROR("Cannot read the chunk out of the chunkfile.");
+    free(*chunk);
     return BLOSC2_ERROR_FILE_READ;
   }
   *needs_free = true;
 
   return (int32_t)chunk_cbytes;
 }
+
+/* Rewrite the chunks of the shard `nshard` that are still in its index one after the other */
+static int64_t compact_shard(blosc2_frame_s* frame, blosc2_io_cb* io_cb, int64_t nshard, bool in_place) {
+  int64_t nchunk = nshard * frame->shard_nchunks;
+  void* fp = open_chunk_file(frame, nchunk, "rb");
+  if (fp == NULL) {
+    return 0;
+  }
+  int64_t index_len = (int64_t)frame->shard_nchunks * SFRAME_SHARD_ENTRY_LEN;
+  io_cb->seek(fp, 0, SEEK_END);
+  int64_t shard_len = io_cb->tell(fp);
+  uint8_t* index = malloc(index_len);
+  if (index == NULL || io_pread(io_cb, index, 1, index_len, 0, fp) != index_len) {
+    free(index);
+    io_cb->close(fp);
+    return BLOSC2_ERROR_FILE_READ;
+  }
+  int64_t live_len = index_len;
+  for (int64_t i = 0; i < frame->shard_nchunks; i++) {
+    int64_t cbytes;
+    from_little(&cbytes, index + i * SFRAME_SHARD_ENTRY_LEN + sizeof(int64_t), sizeof(int64_t));
+    live_len += cbytes;
+  }
+  if (live_len >= shard_len) {
+    free(index);
+    io_cb->close(fp);
+    return 0;
+  }
+
+  // The chunks that are left, in the order of their slots
+  uint8_t* shard = malloc(live_len);
+  int64_t rc = shard == NULL ? BLOSC2_ERROR_MEMORY_ALLOC : 0;
+  int64_t position = index_len;
+  for (int64_t i = 0; rc == 0 && i < frame->shard_nchunks; i++) {
+    uint8_t* entry = index + i * SFRAME_SHARD_ENTRY_LEN;
+    int64_t old_position;
+    int64_t cbytes;
+    from_little(&old_position, entry, sizeof(int64_t));
+    from_little(&cbytes, entry + sizeof(int64_t), sizeof(int64_t));
+    if (cbytes == 0) {
+      continue;
+    }
+    if (io_pread(io_cb, shard + position, 1, cbytes, old_position, fp) != cbytes) {
+      rc = BLOSC2_ERROR_FILE_READ;
+    }
+    to_little(entry, &position, sizeof(int64_t));
+    position += cbytes;
+  }
+  io_cb->close(fp);
+  if (rc < 0) {
+    free(index);
+    free(shard);
+    return rc;
+  }
+  memcpy(shard, index, index_len);
+  free(index);
+
+  // Either over the shard, or into a new file that replaces it once it is complete
+  char* path = chunk_file_path(frame, nchunk);
+  char* new_path = path == NULL ? NULL : malloc(strlen(path) + strlen(".compact") + 1);
+  if (new_path == NULL) {
+    free(path);
+    free(shard);
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  sprintf(new_path, in_place ? "%s" : "%s.compact", path);
+  fp = io_cb->open(new_path, "wb", frame->schunk->storage->io->params);
+  if (fp == NULL || io_cb->write(shard, 1, live_len, fp) != live_len) {
+    BLOSC_TRACE_ERROR("Cannot write the compacted shard %s.", new_path);
+    rc = BLOSC2_ERROR_FILE_WRITE;
+  }
+  if (fp != NULL) {
+    io_cb->close(fp);
+  }
+  if (rc == 0 && !in_place && rename(new_path, path) != 0) {
+    BLOSC_TRACE_ERROR("Cannot replace the shard %s.", path);
+    rc = BLOSC2_ERROR_FILE_WRITE;
+  }
+  if (rc < 0 && !in_place) {
+    remove(new_path);
+  }
+  free(new_path);
+  free(path);
+  free(shard);
+  return rc < 0 ? rc : shard_len - live_len;
+}
+
+int64_t sframe_compact(blosc2_frame_s* frame, int64_t max_chunk_id, bool in_place) {
+  if (frame->shard_nchunks == 0) {
+    // The files of the chunks go away along with them
+    return 0;
+  }
+  blosc2_io_cb *io_cb = blosc2_get_io_cb(frame->schunk->storage->io->id);
+  if (io_cb == NULL) {
+    BLOSC_TRACE_ERROR("Error getting the input/output API");
+    return BLOSC2_ERROR_PLUGIN_IO;
+  }
+  int64_t reclaimed = 0;
+  for (int64_t nshard = 0; nshard <= max_chunk_id / frame->shard_nchunks; nshard++) {
+    int64_t rc = compact_shard(frame, io_cb, nshard, in_place);
+    if (rc < 0) {
+      return rc;
+    }
+    reclaimed += rc;
+  }
+  return reclaimed;
+}
@@ -16,10 +16,28 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+/* The chunks of sharded sparse frames are appended to the file of their shard (%08X.shard), which
+ * starts with an index of an entry per chunk: its position in the file and its length (0 if none).
+ * The files go into subdirectories named after the lowest bytes of their ids (34/AB/0012AB34.chunk)
+ * when the frame has levels of them. */
+#define SFRAME_SHARD_ENTRY_LEN (16)
+
+/* The appends to sparse frames with an index log (chunks.b2log) add an entry to it instead of
+ * rewriting the index: the position of the chunk and its offset (little-endian), and the fixed
+ * part of the header of the frame after the append */
+#define SFRAME_INDEX_LOG_ENTRY_LEN (2 * 8 + FRAME_HEADER_MINLEN)
+
 void* sframe_open_index(const char* urlpath, const char* mode, const blosc2_io *io);
-void* sframe_open_chunk(const char* urlpath, int64_t nchunk, const char* mode, const blosc2_io *io);
-int sframe_delete_chunk(const char* urlpath, int64_t nchunk);
+/* Open the index log of a sparse frame (quietly, as most frames do not have one) */
+void* sframe_open_index_log(const char* urlpath, const char* mode, const blosc2_io *io);
+/* The id of the file holding a chunk (the shard or the chunk itself), for keeping it open */
+int64_t sframe_file_id(blosc2_frame_s* frame, int64_t nchunk);
+void* sframe_open_file(blosc2_frame_s* frame, int64_t nchunk, const char* mode);
+void* sframe_open_chunk(blosc2_frame_s* frame, int64_t nchunk, int64_t* position);
+int sframe_delete_chunk(blosc2_frame_s* frame, int64_t nchunk);
 void* sframe_create_chunk(blosc2_frame_s* frame, uint8_t* chunk, int64_t nchunk, int64_t cbytes);
 int32_t sframe_get_chunk(blosc2_frame_s* frame, int64_t nchunk, uint8_t** chunk, bool* needs_free);
+/* Reclaim the space of the chunks updated or deleted in the shards, up to the chunk id given */
+int64_t sframe_compact(blosc2_frame_s* frame, int64_t max_chunk_id, bool in_place);
 
 #endif /* BLOSC_SFRAME_H */
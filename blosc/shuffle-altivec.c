@@ -267,9 +267,9 @@ unshuffle16_altivec(uint8_t* const dest, const uint8_t* const src,
     // Do the Job!
     transpose16x16(xmm0);
 
-    /* Store the result vectors*/
+    /* Store the result vectors (unaligned, as the tiles of the fused filters may not be) */
     for (i = 0; i < 16; i++)
-      vec_st(xmm0[i], bytesoftype * (i+j), dest);
+      vec_xst(xmm0[i], bytesoftype * (i+j), dest);
   }
 }
 
@@ -307,6 +307,101 @@ unshuffle16_tiled_altivec(uint8_t* const dest, const uint8_t* const orig,
   }
 }
 
+/* Routine optimized for shuffling a buffer for a type size smaller than 16 bytes
+   (other than 2, 4 and 8).  As in shuffle-sse2.c, every element is loaded along with
+   the bytes that follow it up to a vector, and only the planes of the type are kept
+   out of the transposition, so the callers must have 16 - bytesoftype readable bytes
+   past the last element. */
+static inline void
+shuffle_narrow_altivec(uint8_t* const dest, const uint8_t* const src,
+                       const int32_t vectorizable_elements, const int32_t total_elements,
+                       const int32_t bytesoftype) {
+  int32_t j, k;
+  __vector uint8_t xmm[16];
+
+  for (j = 0; j < vectorizable_elements; j += 16) {
+    /* Fetch 16 elements (and the bytes past them) */
+    for (k = 0; k < 16; k++)
+      xmm[k] = vec_xl((j + k) * bytesoftype, src);
+
+    transpose16x16(xmm);
+
+    /* Store the planes of the type only */
+    for (k = 0; k < bytesoftype; k++)
+      vec_xst(xmm[k], j + total_elements * k, dest);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size smaller than 16 bytes
+   (other than 2, 4 and 8).  The transposition of the planes of the type (padded with
+   zeros) leaves every element at the start of a vector, which is stored along with
+   garbage that the next element overwrites, so the callers must have room for
+   16 - bytesoftype bytes past the last element (and fill them afterwards). */
+static inline void
+unshuffle_narrow_altivec(uint8_t* const dest, const uint8_t* const src,
+                         const int32_t vectorizable_elements, const int32_t total_elements,
+                         const int32_t bytesoftype) {
+  int32_t i, j;
+  __vector uint8_t xmm[16];
+
+  for (i = 0; i < vectorizable_elements; i += 16) {
+    /* Load 16 bytes of the planes of the type (and zeros for the rest) */
+    for (j = 0; j < 16; j++)
+      xmm[j] = j < bytesoftype ? vec_xl(i + total_elements * j, src) : vec_splat_u8(0);
+
+    transpose16x16(xmm);
+
+    /* Store the elements in increasing order */
+    for (j = 0; j < 16; j++)
+      vec_xst(xmm[j], (i + j) * bytesoftype, dest);
+  }
+}
+
+/* The type sizes smaller than 16 bytes that have no routine of their own */
+#define NARROW_TYPESIZES(_) _(3) _(5) _(6) _(7) _(9) _(10) _(11) _(12) _(13) _(14) _(15)
+
+/* Run the narrow routines with a constant type size, so that they are specialized for it.
+   Returns the elements done, which are none for the type sizes without a narrow routine. */
+static int32_t
+shuffle_narrow_typesize_altivec(uint8_t* const dest, const uint8_t* const src,
+                                const int32_t vectorizable_elements, const int32_t total_elements,
+                                const int32_t bytesoftype) {
+#define NARROW_CASE(typesize) \
+  case typesize: shuffle_narrow_altivec(dest, src, vectorizable_elements, total_elements, typesize); break;
+  switch (bytesoftype) {
+    NARROW_TYPESIZES(NARROW_CASE)
+    default: return 0;
+  }
+#undef NARROW_CASE
+  return vectorizable_elements;
+}
+
+static int32_t
+unshuffle_narrow_typesize_altivec(uint8_t* const dest, const uint8_t* const src,
+                                  const int32_t vectorizable_elements, const int32_t total_elements,
+                                  const int32_t bytesoftype) {
+#define NARROW_CASE(typesize) \
+  case typesize: unshuffle_narrow_altivec(dest, src, vectorizable_elements, total_elements, typesize); break;
+  switch (bytesoftype) {
+    NARROW_TYPESIZES(NARROW_CASE)
+    default: return 0;
+  }
+#undef NARROW_CASE
+  return vectorizable_elements;
+}
+
+/* The elements that the narrow routines can do out of `nelems`, leaving room for the
+   vector that they read (or write) from the last element */
+static int32_t
+narrow_vectorizable_elements(const int32_t bytesoftype, const int32_t nelems) {
+  int32_t vectorizable_elements = nelems - nelems % 16;
+  if (vectorizable_elements > 0 &&
+      vectorizable_elements * bytesoftype + 16 - bytesoftype > nelems * bytesoftype) {
+    vectorizable_elements -= 16;
+  }
+  return vectorizable_elements;
+}
+
 /* Shuffle a block.  This can never fail. */
 void
 shuffle_altivec(const int32_t bytesoftype, const int32_t blocksize,
@@ -351,10 +446,10 @@ shuffle_altivec(const int32_t bytesoftype, const int32_t blocksize,
         shuffle16_tiled_altivec(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
       }
       else {
-        /* Non-optimized shuffle */
-        shuffle_generic(bytesoftype, blocksize, _src, _dest);
-        /* The non-optimized function covers the whole buffer,
-           so we're done processing here. */
+        /* Optimized shuffle for the rest of the type sizes smaller than 16 bytes */
+        const int32_t narrow_elements = shuffle_narrow_typesize_altivec(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, total_elements), total_elements, bytesoftype);
+        shuffle_generic_inline(bytesoftype, narrow_elements * bytesoftype, blocksize, _src, _dest);
         return;
       }
   }
@@ -407,10 +502,10 @@ unshuffle_altivec(const int32_t bytesoftype, const int32_t blocksize,
         unshuffle16_tiled_altivec(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
       }
       else {
-        /* Non-optimized unshuffle */
-        unshuffle_generic(bytesoftype, blocksize, _src, _dest);
-        /* The non-optimized function covers the whole buffer,
-           so we're done processing here. */
+        /* Optimized unshuffle for the rest of the type sizes smaller than 16 bytes */
+        const int32_t narrow_elements = unshuffle_narrow_typesize_altivec(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, total_elements), total_elements, bytesoftype);
+        unshuffle_generic_inline(bytesoftype, narrow_elements * bytesoftype, blocksize, _src, _dest);
         return;
       }
   }
@@ -423,4 +518,70 @@ unshuffle_altivec(const int32_t bytesoftype, const int32_t blocksize,
   }
 }
 
+/* Shuffle the `nelems` elements of a tile into the byte planes of a block with
+   `total_elements` (`_dest` points to the first element of the tile in the
+   first plane).  This can never fail. */
+void
+shuffle_tile_altivec(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                     const uint8_t *_src, uint8_t *_dest) {
+  int32_t vectorizable_elements = nelems - nelems % 16;
+
+  switch (bytesoftype) {
+    case 2:
+      shuffle2_altivec(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      shuffle4_altivec(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      shuffle8_altivec(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      shuffle16_altivec(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype < 16) {
+        vectorizable_elements = shuffle_narrow_typesize_altivec(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, nelems), total_elements, bytesoftype);
+      }
+      else {
+        vectorizable_elements = 0;
+      }
+  }
+  shuffle_tile_generic_inline(bytesoftype, vectorizable_elements, nelems, total_elements, _src, _dest);
+}
+
+/* Unshuffle the `nelems` elements of a tile out of the byte planes of a block
+   with `total_elements` (`_src` points to the first element of the tile in the
+   first plane).  This can never fail. */
+void
+unshuffle_tile_altivec(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                       const uint8_t *_src, uint8_t *_dest) {
+  int32_t vectorizable_elements = nelems - nelems % 16;
+
+  switch (bytesoftype) {
+    case 2:
+      unshuffle2_altivec(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      unshuffle4_altivec(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      unshuffle8_altivec(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      unshuffle16_altivec(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype < 16) {
+        vectorizable_elements = unshuffle_narrow_typesize_altivec(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, nelems), total_elements, bytesoftype);
+      }
+      else {
+        vectorizable_elements = 0;
+      }
+  }
+  unshuffle_tile_generic_inline(bytesoftype, vectorizable_elements, nelems, total_elements, _src, _dest);
+}
+
 #endif /* defined(__ALTIVEC__) */
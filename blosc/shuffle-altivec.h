@@ -29,4 +29,16 @@ BLOSC_NO_EXPORT void shuffle_altivec(const int32_t bytesoftype, const int32_t bl
 BLOSC_NO_EXPORT void unshuffle_altivec(const int32_t bytesoftype, const int32_t blocksize,
                                        const uint8_t *_src, uint8_t *_dest);
 
+/**
+  ALTIVEC-accelerated shuffle of a tile into the byte planes of a block.
+*/
+BLOSC_NO_EXPORT void shuffle_tile_altivec(const int32_t bytesoftype, const int32_t nelems,
+                                          const int32_t total_elements, const uint8_t *_src, uint8_t *_dest);
+
+/**
+  ALTIVEC-accelerated unshuffle of a tile out of the byte planes of a block.
+*/
+BLOSC_NO_EXPORT void unshuffle_tile_altivec(const int32_t bytesoftype, const int32_t nelems,
+                                            const int32_t total_elements, const uint8_t *_src, uint8_t *_dest);
+
 #endif /* BLOSC_SHUFFLE_ALTIVEC_H */
@@ -628,6 +628,162 @@ unshuffle16_tiled_avx2(const uint8_t *dest, const uint8_t* const src,
   }
 }
 
+/* Routine optimized for shuffling a buffer for a type size smaller than 16 bytes
+   (other than 2, 4 and 8).  Every element is loaded along with the bytes that follow
+   it up to a 16-byte vector, which are transposed like in shuffle16_tiled_avx2 and
+   then left out, so the callers must have 16 - bytesoftype readable bytes past the
+   last element. */
+static inline void
+shuffle_narrow_avx2(uint8_t* const dest, const uint8_t* const src,
+                    const int32_t vectorizable_elements, const int32_t total_elements, const int32_t bytesoftype) {
+  int32_t j;
+  int k, l;
+  __m256i ymm0[16], ymm1[16];
+
+  /* Create the shuffle mask.
+     NOTE: The XMM/YMM 'set' intrinsics require the arguments to be ordered from
+     most to least significant (i.e., their order is reversed when compared to
+     loading the mask from an array). */
+  const __m256i shmask = _mm256_set_epi8(
+      0x0f, 0x07, 0x0e, 0x06, 0x0d, 0x05, 0x0c, 0x04,
+      0x0b, 0x03, 0x0a, 0x02, 0x09, 0x01, 0x08, 0x00,
+      0x0f, 0x07, 0x0e, 0x06, 0x0d, 0x05, 0x0c, 0x04,
+      0x0b, 0x03, 0x0a, 0x02, 0x09, 0x01, 0x08, 0x00);
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m256i)) {
+    /* Fetch 32 elements (and the bytes past them) */
+    for (k = 0; k < 16; k++) {
+      ymm0[k] = _mm256_loadu2_m128i(
+          (__m128i*)(src + (j + (2 * k) + 1) * bytesoftype),
+          (__m128i*)(src + (j + (2 * k)) * bytesoftype));
+    }
+    /* Transpose bytes */
+    for (k = 0, l = 0; k < 8; k++, l += 2) {
+      ymm1[k * 2] = _mm256_unpacklo_epi8(ymm0[l], ymm0[l + 1]);
+      ymm1[k * 2 + 1] = _mm256_unpackhi_epi8(ymm0[l], ymm0[l + 1]);
+    }
+    /* Transpose words */
+    for (k = 0, l = -2; k < 8; k++, l++) {
+      if ((k % 2) == 0) l += 2;
+      ymm0[k * 2] = _mm256_unpacklo_epi16(ymm1[l], ymm1[l + 2]);
+      ymm0[k * 2 + 1] = _mm256_unpackhi_epi16(ymm1[l], ymm1[l + 2]);
+    }
+    /* Transpose double words */
+    for (k = 0, l = -4; k < 8; k++, l++) {
+      if ((k % 4) == 0) l += 4;
+      ymm1[k * 2] = _mm256_unpacklo_epi32(ymm0[l], ymm0[l + 4]);
+      ymm1[k * 2 + 1] = _mm256_unpackhi_epi32(ymm0[l], ymm0[l + 4]);
+    }
+    /* Transpose quad words */
+    for (k = 0; k < 8; k++) {
+      ymm0[k * 2] = _mm256_unpacklo_epi64(ymm1[k], ymm1[k + 8]);
+      ymm0[k * 2 + 1] = _mm256_unpackhi_epi64(ymm1[k], ymm1[k + 8]);
+    }
+    /* Store the planes of the type only */
+    for (k = 0; k < bytesoftype; k++) {
+      ymm0[k] = _mm256_permute4x64_epi64(ymm0[k], 0xd8);
+      ymm0[k] = _mm256_shuffle_epi8(ymm0[k], shmask);
+      _mm256_storeu_si256((__m256i*)(dest + j + total_elements * k), ymm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size smaller than 16 bytes
+   (other than 2, 4 and 8).  Every element is stored along with garbage up to a
+   16-byte vector, which the next element overwrites, so the callers must have room
+   for 16 - bytesoftype bytes past the last element (and fill them afterwards). */
+static inline void
+unshuffle_narrow_avx2(uint8_t* const dest, const uint8_t* const src,
+                      const int32_t vectorizable_elements, const int32_t total_elements, const int32_t bytesoftype) {
+  int32_t i;
+  int j;
+  __m256i ymm0[16], ymm1[16];
+  /* The order of the pairs of elements in the vectors after the transposition */
+  static const int order[16] = {0, 4, 2, 6, 1, 5, 3, 7, 8, 12, 10, 14, 9, 13, 11, 15};
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m256i)) {
+    /* Load 32 bytes of the planes of the type (and zeros for the rest) */
+    for (j = 0; j < 16; j++) {
+      ymm0[j] = j < bytesoftype ? _mm256_loadu_si256((__m256i*)(src + i + total_elements * j))
+                                : _mm256_setzero_si256();
+    }
+    /* Shuffle bytes */
+    for (j = 0; j < 8; j++) {
+      ymm1[j] = _mm256_unpacklo_epi8(ymm0[j * 2], ymm0[j * 2 + 1]);
+      ymm1[8 + j] = _mm256_unpackhi_epi8(ymm0[j * 2], ymm0[j * 2 + 1]);
+    }
+    /* Shuffle 2-byte words */
+    for (j = 0; j < 8; j++) {
+      ymm0[j] = _mm256_unpacklo_epi16(ymm1[j * 2], ymm1[j * 2 + 1]);
+      ymm0[8 + j] = _mm256_unpackhi_epi16(ymm1[j * 2], ymm1[j * 2 + 1]);
+    }
+    /* Shuffle 4-byte dwords */
+    for (j = 0; j < 8; j++) {
+      ymm1[j] = _mm256_unpacklo_epi32(ymm0[j * 2], ymm0[j * 2 + 1]);
+      ymm1[8 + j] = _mm256_unpackhi_epi32(ymm0[j * 2], ymm0[j * 2 + 1]);
+    }
+    /* Shuffle 8-byte qwords */
+    for (j = 0; j < 8; j++) {
+      ymm0[j] = _mm256_unpacklo_epi64(ymm1[j * 2], ymm1[j * 2 + 1]);
+      ymm0[8 + j] = _mm256_unpackhi_epi64(ymm1[j * 2], ymm1[j * 2 + 1]);
+    }
+    for (j = 0; j < 8; j++) {
+      ymm1[j] = _mm256_permute2x128_si256(ymm0[j], ymm0[j + 8], 0x20);
+      ymm1[j + 8] = _mm256_permute2x128_si256(ymm0[j], ymm0[j + 8], 0x31);
+    }
+    /* Store the elements in increasing order, so every one overwrites the garbage of the previous one */
+    for (j = 0; j < 16; j++) {
+      _mm_storeu_si128((__m128i*)(dest + (i + 2 * j) * bytesoftype), _mm256_castsi256_si128(ymm1[order[j]]));
+      _mm_storeu_si128((__m128i*)(dest + (i + 2 * j + 1) * bytesoftype), _mm256_extracti128_si256(ymm1[order[j]], 1));
+    }
+  }
+}
+
+/* The type sizes smaller than 16 bytes that have no routine of their own */
+#define NARROW_TYPESIZES(_) _(3) _(5) _(6) _(7) _(9) _(10) _(11) _(12) _(13) _(14) _(15)
+
+/* Run the narrow routines with a constant type size, so that they are specialized for it.
+   Returns the elements done, which are none for the type sizes without a narrow routine. */
+static int32_t
+shuffle_narrow_typesize_avx2(uint8_t* const dest, const uint8_t* const src,
+                             const int32_t vectorizable_elements, const int32_t total_elements,
+                             const int32_t bytesoftype) {
+#define NARROW_CASE(typesize) \
+  case typesize: shuffle_narrow_avx2(dest, src, vectorizable_elements, total_elements, typesize); break;
+  switch (bytesoftype) {
+    NARROW_TYPESIZES(NARROW_CASE)
+    default: return 0;
+  }
+#undef NARROW_CASE
+  return vectorizable_elements;
+}
+
+static int32_t
+unshuffle_narrow_typesize_avx2(uint8_t* const dest, const uint8_t* const src,
+                               const int32_t vectorizable_elements, const int32_t total_elements,
+                               const int32_t bytesoftype) {
+#define NARROW_CASE(typesize) \
+  case typesize: unshuffle_narrow_avx2(dest, src, vectorizable_elements, total_elements, typesize); break;
+  switch (bytesoftype) {
+    NARROW_TYPESIZES(NARROW_CASE)
+    default: return 0;
+  }
+#undef NARROW_CASE
+  return vectorizable_elements;
+}
+
+/* The elements that the narrow routines can do out of `nelems`, leaving room for the
+   16-byte vector that they read (or write) from the last element */
+static int32_t
+narrow_vectorizable_elements(const int32_t bytesoftype, const int32_t nelems) {
+  int32_t vectorizable_elements = nelems - nelems % (int32_t)sizeof(__m256i);
+  if (vectorizable_elements > 0 &&
+      vectorizable_elements * bytesoftype + (int32_t)sizeof(__m128i) - bytesoftype > nelems * bytesoftype) {
+    vectorizable_elements -= sizeof(__m256i);
+  }
+  return vectorizable_elements;
+}
+
 /* Shuffle a block.  This can never fail. */
 void
 shuffle_avx2(const int32_t bytesoftype, const int32_t blocksize,
@@ -671,10 +827,10 @@ shuffle_avx2(const int32_t bytesoftype, const int32_t blocksize,
         shuffle16_tiled_avx2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
       }
       else {
-        /* Non-optimized shuffle */
-        shuffle_generic(bytesoftype, blocksize, _src, _dest);
-        /* The non-optimized function covers the whole buffer,
-           so we're done processing here. */
+        /* Optimized shuffle for the rest of the type sizes smaller than 16 bytes */
+        const int32_t narrow_elements = shuffle_narrow_typesize_avx2(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, total_elements), total_elements, bytesoftype);
+        shuffle_generic_inline(bytesoftype, narrow_elements * bytesoftype, blocksize, _src, _dest);
         return;
       }
   }
@@ -730,10 +886,10 @@ unshuffle_avx2(const int32_t bytesoftype, const int32_t blocksize,
         unshuffle16_tiled_avx2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
       }
       else {
-        /* Non-optimized unshuffle */
-        unshuffle_generic(bytesoftype, blocksize, _src, _dest);
-        /* The non-optimized function covers the whole buffer,
-           so we're done processing here. */
+        /* Optimized unshuffle for the rest of the type sizes smaller than 16 bytes */
+        const int32_t narrow_elements = unshuffle_narrow_typesize_avx2(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, total_elements), total_elements, bytesoftype);
+        unshuffle_generic_inline(bytesoftype, narrow_elements * bytesoftype, blocksize, _src, _dest);
         return;
       }
   }
@@ -746,4 +902,70 @@ unshuffle_avx2(const int32_t bytesoftype, const int32_t blocksize,
   }
 }
 
+/* Shuffle the `nelems` elements of a tile into the byte planes of a block with
+   `total_elements` (`_dest` points to the first element of the tile in the
+   first plane).  This can never fail. */
+void
+shuffle_tile_avx2(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                  const uint8_t *_src, uint8_t *_dest) {
+  int32_t vectorizable_elements = nelems - nelems % (int32_t)sizeof(__m256i);
+
+  switch (bytesoftype) {
+    case 2:
+      shuffle2_avx2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      shuffle4_avx2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      shuffle8_avx2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      shuffle16_avx2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype < (int32_t)sizeof(__m128i)) {
+        vectorizable_elements = shuffle_narrow_typesize_avx2(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, nelems), total_elements, bytesoftype);
+      }
+      else {
+        vectorizable_elements = 0;
+      }
+  }
+  shuffle_tile_generic_inline(bytesoftype, vectorizable_elements, nelems, total_elements, _src, _dest);
+}
+
+/* Unshuffle the `nelems` elements of a tile out of the byte planes of a block
+   with `total_elements` (`_src` points to the first element of the tile in the
+   first plane).  This can never fail. */
+void
+unshuffle_tile_avx2(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                    const uint8_t *_src, uint8_t *_dest) {
+  int32_t vectorizable_elements = nelems - nelems % (int32_t)sizeof(__m256i);
+
+  switch (bytesoftype) {
+    case 2:
+      unshuffle2_avx2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      unshuffle4_avx2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      unshuffle8_avx2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      unshuffle16_avx2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype < (int32_t)sizeof(__m128i)) {
+        vectorizable_elements = unshuffle_narrow_typesize_avx2(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, nelems), total_elements, bytesoftype);
+      }
+      else {
+        vectorizable_elements = 0;
+      }
+  }
+  unshuffle_tile_generic_inline(bytesoftype, vectorizable_elements, nelems, total_elements, _src, _dest);
+}
+
 #endif /* defined(__AVX2__) */
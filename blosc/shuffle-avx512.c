@@ -0,0 +1,463 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "shuffle-avx512.h"
+#include "shuffle-avx2.h"
+#include "shuffle-generic.h"
+
+/* Make sure AVX512BW is available for the compilation target and compiler. */
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include <immintrin.h>
+
+#include <stdint.h>
+
+/* All the kernels below process 64 elements (a row of 64 bytes for every byte
+   of the type) per iteration.  They first gather the bytes of the same rank
+   inside each 128-bit lane with a pshufb, and then move the resulting units
+   across lanes and registers with two-source permutes. */
+
+/* Transpose the 128-bit lanes of four registers, i.e. lane m of r[k] becomes
+   lane k of r[m].  The transposition is its own inverse. */
+static inline void
+transpose_lanes4_avx512(__m512i* r) {
+  const __m512i t0 = _mm512_shuffle_i64x2(r[0], r[1], 0x44);
+  const __m512i t1 = _mm512_shuffle_i64x2(r[0], r[1], 0xee);
+  const __m512i t2 = _mm512_shuffle_i64x2(r[2], r[3], 0x44);
+  const __m512i t3 = _mm512_shuffle_i64x2(r[2], r[3], 0xee);
+  r[0] = _mm512_shuffle_i64x2(t0, t2, 0x88);
+  r[1] = _mm512_shuffle_i64x2(t0, t2, 0xdd);
+  r[2] = _mm512_shuffle_i64x2(t1, t3, 0x88);
+  r[3] = _mm512_shuffle_i64x2(t1, t3, 0xdd);
+}
+
+/* Transpose the 16x16 byte matrix made by the same lane of 16 registers, for
+   the four lanes at the same time.  This is the same network than the AVX2
+   16-byte shuffle uses. */
+static inline void
+transpose_bytes16_avx512(__m512i* zmm0) {
+  __m512i zmm1[16];
+  int k, l;
+
+  /* Transpose bytes */
+  for (k = 0, l = 0; k < 8; k++, l += 2) {
+    zmm1[k * 2] = _mm512_unpacklo_epi8(zmm0[l], zmm0[l + 1]);
+    zmm1[k * 2 + 1] = _mm512_unpackhi_epi8(zmm0[l], zmm0[l + 1]);
+  }
+  /* Transpose words */
+  for (k = 0, l = -2; k < 8; k++, l++) {
+    if ((k % 2) == 0) l += 2;
+    zmm0[k * 2] = _mm512_unpacklo_epi16(zmm1[l], zmm1[l + 2]);
+    zmm0[k * 2 + 1] = _mm512_unpackhi_epi16(zmm1[l], zmm1[l + 2]);
+  }
+  /* Transpose double words */
+  for (k = 0, l = -4; k < 8; k++, l++) {
+    if ((k % 4) == 0) l += 4;
+    zmm1[k * 2] = _mm512_unpacklo_epi32(zmm0[l], zmm0[l + 4]);
+    zmm1[k * 2 + 1] = _mm512_unpackhi_epi32(zmm0[l], zmm0[l + 4]);
+  }
+  /* Transpose quad words */
+  for (k = 0; k < 8; k++) {
+    zmm0[k * 2] = _mm512_unpacklo_epi64(zmm1[k], zmm1[k + 8]);
+    zmm0[k * 2 + 1] = _mm512_unpackhi_epi64(zmm1[k], zmm1[k + 8]);
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 2 bytes. */
+static void
+shuffle2_avx512(uint8_t* const dest, const uint8_t* const src,
+                const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 2;
+  int32_t j;
+  int k;
+  __m512i zmm0[2];
+
+  /* Gather the bytes 0 and 1 of the lane in its low and high quad word */
+  const __m512i shmask = _mm512_broadcast_i32x4(_mm_set_epi8(
+      0x0f, 0x0d, 0x0b, 0x09, 0x07, 0x05, 0x03, 0x01,
+      0x0e, 0x0c, 0x0a, 0x08, 0x06, 0x04, 0x02, 0x00));
+  const __m512i idx0 = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+  const __m512i idx1 = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m512i)) {
+    /* Fetch 64 elements (128 bytes) */
+    for (k = 0; k < 2; k++) {
+      zmm0[k] = _mm512_loadu_si512((__m512i*)(src + (j * bytesoftype) + (k * sizeof(__m512i))));
+      zmm0[k] = _mm512_shuffle_epi8(zmm0[k], shmask);
+    }
+    const __m512i row0 = _mm512_permutex2var_epi64(zmm0[0], idx0, zmm0[1]);
+    const __m512i row1 = _mm512_permutex2var_epi64(zmm0[0], idx1, zmm0[1]);
+
+    /* Store the result vectors */
+    uint8_t* const dest_for_jth_element = dest + j;
+    _mm512_storeu_si512((__m512i*)(dest_for_jth_element), row0);
+    _mm512_storeu_si512((__m512i*)(dest_for_jth_element + total_elements), row1);
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 4 bytes. */
+static void
+shuffle4_avx512(uint8_t* const dest, const uint8_t* const src,
+                const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 4;
+  int32_t j;
+  int k;
+  __m512i zmm0[4], zmm1[4];
+
+  /* Gather the byte k of the 4 elements of the lane in its double word k */
+  const __m512i shmask = _mm512_broadcast_i32x4(_mm_set_epi8(
+      0x0f, 0x0b, 0x07, 0x03, 0x0e, 0x0a, 0x06, 0x02,
+      0x0d, 0x09, 0x05, 0x01, 0x0c, 0x08, 0x04, 0x00));
+  /* Rows 0 and 1 (resp. 2 and 3) of the 8 lanes in a pair of registers */
+  const __m512i idx01 = _mm512_set_epi32(29, 25, 21, 17, 13, 9, 5, 1,
+                                         28, 24, 20, 16, 12, 8, 4, 0);
+  const __m512i idx23 = _mm512_set_epi32(31, 27, 23, 19, 15, 11, 7, 3,
+                                         30, 26, 22, 18, 14, 10, 6, 2);
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m512i)) {
+    /* Fetch 64 elements (256 bytes) */
+    for (k = 0; k < 4; k++) {
+      zmm0[k] = _mm512_loadu_si512((__m512i*)(src + (j * bytesoftype) + (k * sizeof(__m512i))));
+      zmm0[k] = _mm512_shuffle_epi8(zmm0[k], shmask);
+    }
+    for (k = 0; k < 2; k++) {
+      zmm1[k * 2] = _mm512_permutex2var_epi32(zmm0[k * 2], idx01, zmm0[k * 2 + 1]);
+      zmm1[k * 2 + 1] = _mm512_permutex2var_epi32(zmm0[k * 2], idx23, zmm0[k * 2 + 1]);
+    }
+    zmm0[0] = _mm512_shuffle_i64x2(zmm1[0], zmm1[2], 0x44);
+    zmm0[1] = _mm512_shuffle_i64x2(zmm1[0], zmm1[2], 0xee);
+    zmm0[2] = _mm512_shuffle_i64x2(zmm1[1], zmm1[3], 0x44);
+    zmm0[3] = _mm512_shuffle_i64x2(zmm1[1], zmm1[3], 0xee);
+
+    /* Store the result vectors */
+    uint8_t* const dest_for_jth_element = dest + j;
+    for (k = 0; k < 4; k++) {
+      _mm512_storeu_si512((__m512i*)(dest_for_jth_element + (k * total_elements)), zmm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 8 bytes. */
+static void
+shuffle8_avx512(uint8_t* const dest, const uint8_t* const src,
+                const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 8;
+  int32_t j;
+  int k;
+  __m512i zmm0[8], zmm1[8];
+
+  /* Gather the byte k of the 2 elements of the lane in its word k */
+  const __m512i shmask = _mm512_broadcast_i32x4(_mm_set_epi8(
+      0x0f, 0x07, 0x0e, 0x06, 0x0d, 0x05, 0x0c, 0x04,
+      0x0b, 0x03, 0x0a, 0x02, 0x09, 0x01, 0x08, 0x00));
+  /* Rows 0 to 3 (resp. 4 to 7) of the 8 lanes in a pair of registers */
+  const __m512i idx03 = _mm512_set_epi16(
+      59, 51, 43, 35, 27, 19, 11, 3, 58, 50, 42, 34, 26, 18, 10, 2,
+      57, 49, 41, 33, 25, 17, 9, 1, 56, 48, 40, 32, 24, 16, 8, 0);
+  const __m512i idx47 = _mm512_set_epi16(
+      63, 55, 47, 39, 31, 23, 15, 7, 62, 54, 46, 38, 30, 22, 14, 6,
+      61, 53, 45, 37, 29, 21, 13, 5, 60, 52, 44, 36, 28, 20, 12, 4);
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m512i)) {
+    /* Fetch 64 elements (512 bytes) */
+    for (k = 0; k < 8; k++) {
+      zmm0[k] = _mm512_loadu_si512((__m512i*)(src + (j * bytesoftype) + (k * sizeof(__m512i))));
+      zmm0[k] = _mm512_shuffle_epi8(zmm0[k], shmask);
+    }
+    for (k = 0; k < 4; k++) {
+      zmm1[k] = _mm512_permutex2var_epi16(zmm0[k * 2], idx03, zmm0[k * 2 + 1]);
+      zmm1[k + 4] = _mm512_permutex2var_epi16(zmm0[k * 2], idx47, zmm0[k * 2 + 1]);
+    }
+    transpose_lanes4_avx512(zmm1);
+    transpose_lanes4_avx512(zmm1 + 4);
+
+    /* Store the result vectors */
+    uint8_t* const dest_for_jth_element = dest + j;
+    for (k = 0; k < 8; k++) {
+      _mm512_storeu_si512((__m512i*)(dest_for_jth_element + (k * total_elements)), zmm1[k]);
+    }
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 16 bytes. */
+static void
+shuffle16_avx512(uint8_t* const dest, const uint8_t* const src,
+                 const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 16;
+  int32_t j;
+  int k;
+  __m512i zmm0[16];
+
+  /* After transposing, the lane l of row k holds the byte k of the elements
+     4 * v + l (v = 0..15); interleave the four lanes to put them in order. */
+  const __m512i lanemask = _mm512_set_epi32(15, 11, 7, 3, 14, 10, 6, 2,
+                                            13, 9, 5, 1, 12, 8, 4, 0);
+  const __m512i shmask = _mm512_broadcast_i32x4(_mm_set_epi8(
+      0x0f, 0x0b, 0x07, 0x03, 0x0e, 0x0a, 0x06, 0x02,
+      0x0d, 0x09, 0x05, 0x01, 0x0c, 0x08, 0x04, 0x00));
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m512i)) {
+    /* Fetch 64 elements (1024 bytes) into 16 ZMM registers. */
+    for (k = 0; k < 16; k++) {
+      zmm0[k] = _mm512_loadu_si512((__m512i*)(src + (j * bytesoftype) + (k * sizeof(__m512i))));
+    }
+    transpose_bytes16_avx512(zmm0);
+
+    /* Store the result vectors */
+    uint8_t* const dest_for_jth_element = dest + j;
+    for (k = 0; k < 16; k++) {
+      zmm0[k] = _mm512_permutexvar_epi32(lanemask, zmm0[k]);
+      zmm0[k] = _mm512_shuffle_epi8(zmm0[k], shmask);
+      _mm512_storeu_si512((__m512i*)(dest_for_jth_element + (k * total_elements)), zmm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 2 bytes. */
+static void
+unshuffle2_avx512(uint8_t* const dest, const uint8_t* const src,
+                  const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 2;
+  int32_t i;
+  int k;
+  __m512i zmm0[2];
+
+  /* Interleave the low and high quad words of the lane */
+  const __m512i shmask = _mm512_broadcast_i32x4(_mm_set_epi8(
+      0x0f, 0x07, 0x0e, 0x06, 0x0d, 0x05, 0x0c, 0x04,
+      0x0b, 0x03, 0x0a, 0x02, 0x09, 0x01, 0x08, 0x00));
+  const __m512i idx0 = _mm512_set_epi64(11, 3, 10, 2, 9, 1, 8, 0);
+  const __m512i idx1 = _mm512_set_epi64(15, 7, 14, 6, 13, 5, 12, 4);
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Load 64 elements (128 bytes) */
+    const __m512i row0 = _mm512_loadu_si512((__m512i*)(src + i));
+    const __m512i row1 = _mm512_loadu_si512((__m512i*)(src + i + total_elements));
+    zmm0[0] = _mm512_permutex2var_epi64(row0, idx0, row1);
+    zmm0[1] = _mm512_permutex2var_epi64(row0, idx1, row1);
+
+    /* Store the result vectors in proper order */
+    for (k = 0; k < 2; k++) {
+      zmm0[k] = _mm512_shuffle_epi8(zmm0[k], shmask);
+      _mm512_storeu_si512((__m512i*)(dest + (i * bytesoftype) + (k * sizeof(__m512i))), zmm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 4 bytes. */
+static void
+unshuffle4_avx512(uint8_t* const dest, const uint8_t* const src,
+                  const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 4;
+  int32_t i;
+  int k;
+  __m512i zmm0[4], zmm1[4];
+
+  /* Interleave the 4 double words of the lane */
+  const __m512i shmask = _mm512_broadcast_i32x4(_mm_set_epi8(
+      0x0f, 0x0b, 0x07, 0x03, 0x0e, 0x0a, 0x06, 0x02,
+      0x0d, 0x09, 0x05, 0x01, 0x0c, 0x08, 0x04, 0x00));
+  const __m512i idx0 = _mm512_set_epi32(27, 19, 11, 3, 26, 18, 10, 2,
+                                        25, 17, 9, 1, 24, 16, 8, 0);
+  const __m512i idx1 = _mm512_set_epi32(31, 23, 15, 7, 30, 22, 14, 6,
+                                        29, 21, 13, 5, 28, 20, 12, 4);
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Load 64 elements (256 bytes) */
+    for (k = 0; k < 4; k++) {
+      zmm0[k] = _mm512_loadu_si512((__m512i*)(src + i + (k * total_elements)));
+    }
+    zmm1[0] = _mm512_shuffle_i64x2(zmm0[0], zmm0[1], 0x44);
+    zmm1[1] = _mm512_shuffle_i64x2(zmm0[2], zmm0[3], 0x44);
+    zmm1[2] = _mm512_shuffle_i64x2(zmm0[0], zmm0[1], 0xee);
+    zmm1[3] = _mm512_shuffle_i64x2(zmm0[2], zmm0[3], 0xee);
+    for (k = 0; k < 2; k++) {
+      zmm0[k * 2] = _mm512_permutex2var_epi32(zmm1[k * 2], idx0, zmm1[k * 2 + 1]);
+      zmm0[k * 2 + 1] = _mm512_permutex2var_epi32(zmm1[k * 2], idx1, zmm1[k * 2 + 1]);
+    }
+
+    /* Store the result vectors in proper order */
+    for (k = 0; k < 4; k++) {
+      zmm0[k] = _mm512_shuffle_epi8(zmm0[k], shmask);
+      _mm512_storeu_si512((__m512i*)(dest + (i * bytesoftype) + (k * sizeof(__m512i))), zmm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 8 bytes. */
+static void
+unshuffle8_avx512(uint8_t* const dest, const uint8_t* const src,
+                  const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 8;
+  int32_t i;
+  int k;
+  __m512i zmm0[8];
+
+  /* Interleave the 8 words of the lane */
+  const __m512i shmask = _mm512_broadcast_i32x4(_mm_set_epi8(
+      0x0f, 0x0d, 0x0b, 0x09, 0x07, 0x05, 0x03, 0x01,
+      0x0e, 0x0c, 0x0a, 0x08, 0x06, 0x04, 0x02, 0x00));
+  const __m512i idx0 = _mm512_set_epi16(
+      59, 51, 43, 35, 27, 19, 11, 3, 58, 50, 42, 34, 26, 18, 10, 2,
+      57, 49, 41, 33, 25, 17, 9, 1, 56, 48, 40, 32, 24, 16, 8, 0);
+  const __m512i idx1 = _mm512_set_epi16(
+      63, 55, 47, 39, 31, 23, 15, 7, 62, 54, 46, 38, 30, 22, 14, 6,
+      61, 53, 45, 37, 29, 21, 13, 5, 60, 52, 44, 36, 28, 20, 12, 4);
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Load 64 elements (512 bytes) */
+    __m512i zmm1[8];
+    for (k = 0; k < 8; k++) {
+      zmm1[k] = _mm512_loadu_si512((__m512i*)(src + i + (k * total_elements)));
+    }
+    transpose_lanes4_avx512(zmm1);
+    transpose_lanes4_avx512(zmm1 + 4);
+    for (k = 0; k < 4; k++) {
+      zmm0[k * 2] = _mm512_permutex2var_epi16(zmm1[k], idx0, zmm1[k + 4]);
+      zmm0[k * 2 + 1] = _mm512_permutex2var_epi16(zmm1[k], idx1, zmm1[k + 4]);
+    }
+
+    /* Store the result vectors in proper order */
+    for (k = 0; k < 8; k++) {
+      zmm0[k] = _mm512_shuffle_epi8(zmm0[k], shmask);
+      _mm512_storeu_si512((__m512i*)(dest + (i * bytesoftype) + (k * sizeof(__m512i))), zmm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 16 bytes. */
+static void
+unshuffle16_avx512(uint8_t* const dest, const uint8_t* const src,
+                   const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 16;
+  int32_t i;
+  int k;
+  __m512i zmm0[16];
+
+  /* The inverse of the interleaving in shuffle16_avx512 (it is the same one) */
+  const __m512i lanemask = _mm512_set_epi32(15, 11, 7, 3, 14, 10, 6, 2,
+                                            13, 9, 5, 1, 12, 8, 4, 0);
+  const __m512i shmask = _mm512_broadcast_i32x4(_mm_set_epi8(
+      0x0f, 0x0b, 0x07, 0x03, 0x0e, 0x0a, 0x06, 0x02,
+      0x0d, 0x09, 0x05, 0x01, 0x0c, 0x08, 0x04, 0x00));
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m512i)) {
+    /* Load 64 elements (1024 bytes) into 16 ZMM registers. */
+    for (k = 0; k < 16; k++) {
+      zmm0[k] = _mm512_loadu_si512((__m512i*)(src + i + (k * total_elements)));
+      zmm0[k] = _mm512_shuffle_epi8(zmm0[k], shmask);
+      zmm0[k] = _mm512_permutexvar_epi32(lanemask, zmm0[k]);
+    }
+    transpose_bytes16_avx512(zmm0);
+
+    /* Store the result vectors in proper order */
+    for (k = 0; k < 16; k++) {
+      _mm512_storeu_si512((__m512i*)(dest + (i * bytesoftype) + (k * sizeof(__m512i))), zmm0[k]);
+    }
+  }
+}
+
+/* Shuffle a block.  This can never fail. */
+void
+shuffle_avx512(const int32_t bytesoftype, const int32_t blocksize,
+               const uint8_t *_src, uint8_t *_dest) {
+  const int32_t vectorized_chunk_size = bytesoftype * (int32_t)sizeof(__m512i);
+
+  /* Only the type sizes below get a specialized AVX512 routine, and the
+     buffer must be large enough for them; otherwise use the AVX2 one. */
+  if ((bytesoftype != 2 && bytesoftype != 4 && bytesoftype != 8 && bytesoftype != 16) ||
+      blocksize < vectorized_chunk_size) {
+    shuffle_avx2(bytesoftype, blocksize, _src, _dest);
+    return;
+  }
+
+  /* If the blocksize is not a multiple of both the typesize and
+     the vector size, round the blocksize down to the next value
+     which is a multiple of both. The vectorized shuffle can be
+     used for that portion of the data, and the naive implementation
+     can be used for the remaining portion. */
+  const int32_t vectorizable_bytes = blocksize - (blocksize % vectorized_chunk_size);
+
+  const int32_t vectorizable_elements = vectorizable_bytes / bytesoftype;
+  const int32_t total_elements = blocksize / bytesoftype;
+
+  /* Optimized shuffle implementations */
+  switch (bytesoftype) {
+    case 2:
+      shuffle2_avx512(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      shuffle4_avx512(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      shuffle8_avx512(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      shuffle16_avx512(_dest, _src, vectorizable_elements, total_elements);
+      break;
+  }
+
+  /* If the buffer had any bytes at the end which couldn't be handled
+     by the vectorized implementations, use the non-optimized version
+     to finish them up. */
+  if (vectorizable_bytes < blocksize) {
+    shuffle_generic_inline(bytesoftype, vectorizable_bytes, blocksize, _src, _dest);
+  }
+}
+
+/* Unshuffle a block.  This can never fail. */
+void
+unshuffle_avx512(const int32_t bytesoftype, const int32_t blocksize,
+                 const uint8_t *_src, uint8_t *_dest) {
+  const int32_t vectorized_chunk_size = bytesoftype * (int32_t)sizeof(__m512i);
+
+  /* Only the type sizes below get a specialized AVX512 routine, and the
+     buffer must be large enough for them; otherwise use the AVX2 one. */
+  if ((bytesoftype != 2 && bytesoftype != 4 && bytesoftype != 8 && bytesoftype != 16) ||
+      blocksize < vectorized_chunk_size) {
+    unshuffle_avx2(bytesoftype, blocksize, _src, _dest);
+    return;
+  }
+
+  /* If the blocksize is not a multiple of both the typesize and
+     the vector size, round the blocksize down to the next value
+     which is a multiple of both. The vectorized unshuffle can be
+     used for that portion of the data, and the naive implementation
+     can be used for the remaining portion. */
+  const int32_t vectorizable_bytes = blocksize - (blocksize % vectorized_chunk_size);
+
+  const int32_t vectorizable_elements = vectorizable_bytes / bytesoftype;
+  const int32_t total_elements = blocksize / bytesoftype;
+
+  /* Optimized unshuffle implementations */
+  switch (bytesoftype) {
+    case 2:
+      unshuffle2_avx512(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      unshuffle4_avx512(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      unshuffle8_avx512(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      unshuffle16_avx512(_dest, _src, vectorizable_elements, total_elements);
+      break;
+  }
+
+  /* If the buffer had any bytes at the end which couldn't be handled
+     by the vectorized implementations, use the non-optimized version
+     to finish them up. */
+  if (vectorizable_bytes < blocksize) {
+    unshuffle_generic_inline(bytesoftype, vectorizable_bytes, blocksize, _src, _dest);
+  }
+}
+
+#endif /* defined(__AVX512F__) && defined(__AVX512BW__) */
@@ -0,0 +1,32 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX512-accelerated shuffle/unshuffle routines. */
+
+#ifndef SHUFFLE_AVX512_H
+#define SHUFFLE_AVX512_H
+
+#include "blosc2/blosc2-common.h"
+
+#include <stdint.h>
+
+/**
+  AVX512-accelerated shuffle routine.
+*/
+BLOSC_NO_EXPORT void shuffle_avx512(const int32_t bytesoftype, const int32_t blocksize,
+                                    const uint8_t *_src, uint8_t *_dest);
+
+/**
+  AVX512-accelerated unshuffle routine.
+*/
+BLOSC_NO_EXPORT void unshuffle_avx512(const int32_t bytesoftype, const int32_t blocksize,
+                                      const uint8_t *_src, uint8_t *_dest);
+
+#endif /* SHUFFLE_AVX512_H */
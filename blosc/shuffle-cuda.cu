@@ -0,0 +1,52 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+
+  Unshuffle kernel for the chunks that are decompressed into device memory.
+**********************************************************************/
+
+#include "blosc2.h"
+
+#include <cuda_runtime.h>
+
+#include <stdint.h>
+
+
+/* Every thread writes one byte of the destination.  Each block is shuffled on
+ * its own (with its own size for the leftover block), and the bytes that do not
+ * make up a whole element at the end of a block are just copied. */
+__global__ static void unshuffle_kernel(int32_t typesize, int32_t blocksize, int32_t nbytes,
+                                        const uint8_t *src, uint8_t *dest) {
+  for (int64_t i = blockIdx.x * (int64_t)blockDim.x + threadIdx.x; i < nbytes;
+       i += (int64_t)blockDim.x * gridDim.x) {
+    int64_t block_start = i - i % blocksize;
+    int32_t offset = (int32_t)(i - block_start);
+    int32_t bsize = (nbytes - block_start < blocksize) ? (int32_t)(nbytes - block_start) : blocksize;
+    int32_t neblock = bsize / typesize;
+    if (offset < neblock * typesize) {
+      int32_t elem = offset / typesize;
+      int32_t byte = offset % typesize;
+      dest[i] = src[block_start + (int64_t)byte * neblock + elem];
+    }
+    else {
+      dest[i] = src[i];
+    }
+  }
+}
+
+
+extern "C" int cuda_unshuffle(int32_t typesize, int32_t blocksize, int32_t nbytes,
+                              const uint8_t *src, uint8_t *dest, void *stream) {
+  const int nthreads = 256;
+  int nblocks = (nbytes + nthreads - 1) / nthreads;
+  if (nblocks > 65535) {
+    nblocks = 65535;
+  }
+  unshuffle_kernel<<<nblocks, nthreads, 0, (cudaStream_t)stream>>>(typesize, blocksize, nbytes, src, dest);
+  return cudaGetLastError() == cudaSuccess ? 0 : BLOSC2_ERROR_FAILURE;
+}
@@ -80,6 +80,37 @@ static inline void unshuffle_generic_inline(const int32_t type_size,
   memcpy(_dest + (blocksize - neblock_rem), _src + (blocksize - neblock_rem), neblock_rem);
 }
 
+/**
+  Generic shuffle of the elements [start, nelems) of a tile into the byte planes
+  of a block with `total_elements` (`_dest` points to the first element of the
+  tile in the first plane).  It is used by the vectorized tile shuffles for the
+  elements that do not fill a whole vector.
+*/
+static inline void shuffle_tile_generic_inline(const int32_t type_size, const int32_t start,
+                                               const int32_t nelems, const int32_t total_elements,
+                                               const uint8_t *_src, uint8_t *_dest) {
+  for (int32_t j = 0; j < type_size; j++) {
+    for (int32_t i = start; i < nelems; i++) {
+      _dest[j * total_elements + i] = _src[i * type_size + j];
+    }
+  }
+}
+
+/**
+  Generic unshuffle of the elements [start, nelems) of a tile out of the byte
+  planes of a block with `total_elements` (`_src` points to the first element of
+  the tile in the first plane).
+*/
+static inline void unshuffle_tile_generic_inline(const int32_t type_size, const int32_t start,
+                                                 const int32_t nelems, const int32_t total_elements,
+                                                 const uint8_t *_src, uint8_t *_dest) {
+  for (int32_t i = start; i < nelems; i++) {
+    for (int32_t j = 0; j < type_size; j++) {
+      _dest[i * type_size + j] = _src[j * total_elements + i];
+    }
+  }
+}
+
 /**
   Generic (non-hardware-accelerated) shuffle routine.
 */
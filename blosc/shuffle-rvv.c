@@ -0,0 +1,272 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "shuffle-rvv.h"
+#include "shuffle-generic.h"
+
+/* Make sure RVV (with the v0.12+ intrinsics) is available for the compilation
+   target and compiler. */
+#if defined(__riscv_vector) && defined(__riscv_v_intrinsic) && __riscv_v_intrinsic >= 12000
+
+#include <riscv_vector.h>
+
+#include <stdint.h>
+
+/* The routines below are vector-length agnostic, and rely on the segment
+   loads/stores for doing the transposition.  These also handle the tail of
+   the elements (by setting a shorter vl), so only the leftover bytes of a
+   block that is not a multiple of the type size need the generic routine. */
+
+/* Store the low and high bytes of a vector of 2-byte units in 2 rows. */
+static inline void
+store_bytes2_rvv(const vuint16m1_t w, uint8_t* const row0, uint8_t* const row1, const size_t vl) {
+  __riscv_vse8_v_u8mf2(row0, __riscv_vnsrl_wx_u8mf2(w, 0, vl), vl);
+  __riscv_vse8_v_u8mf2(row1, __riscv_vnsrl_wx_u8mf2(w, 8, vl), vl);
+}
+
+/* Load a vector of 2-byte units from the 2 rows of its low and high bytes. */
+static inline vuint16m1_t
+load_bytes2_rvv(const uint8_t* const row0, const uint8_t* const row1, const size_t vl) {
+  const vuint16m1_t lo = __riscv_vzext_vf2_u16m1(__riscv_vle8_v_u8mf2(row0, vl), vl);
+  const vuint16m1_t hi = __riscv_vzext_vf2_u16m1(__riscv_vle8_v_u8mf2(row1, vl), vl);
+  return __riscv_vor_vv_u16m1(lo, __riscv_vsll_vx_u16m1(hi, 8, vl), vl);
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 2 bytes. */
+static void
+shuffle2_rvv(uint8_t* const dest, const uint8_t* const src, const int32_t total_elements) {
+  static const int32_t bytesoftype = 2;
+  int32_t j;
+  size_t vl;
+
+  for (j = 0; j < total_elements; j += (int32_t)vl) {
+    vl = __riscv_vsetvl_e8m1((size_t)(total_elements - j));
+    const vuint8m1x2_t r = __riscv_vlseg2e8_v_u8m1x2(src + j * bytesoftype, vl);
+    __riscv_vse8_v_u8m1(dest + j, __riscv_vget_v_u8m1x2_u8m1(r, 0), vl);
+    __riscv_vse8_v_u8m1(dest + total_elements + j, __riscv_vget_v_u8m1x2_u8m1(r, 1), vl);
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 4 bytes. */
+static void
+shuffle4_rvv(uint8_t* const dest, const uint8_t* const src, const int32_t total_elements) {
+  static const int32_t bytesoftype = 4;
+  int32_t j;
+  size_t vl;
+
+  for (j = 0; j < total_elements; j += (int32_t)vl) {
+    vl = __riscv_vsetvl_e8m1((size_t)(total_elements - j));
+    const vuint8m1x4_t r = __riscv_vlseg4e8_v_u8m1x4(src + j * bytesoftype, vl);
+    __riscv_vse8_v_u8m1(dest + j, __riscv_vget_v_u8m1x4_u8m1(r, 0), vl);
+    __riscv_vse8_v_u8m1(dest + total_elements + j, __riscv_vget_v_u8m1x4_u8m1(r, 1), vl);
+    __riscv_vse8_v_u8m1(dest + 2 * total_elements + j, __riscv_vget_v_u8m1x4_u8m1(r, 2), vl);
+    __riscv_vse8_v_u8m1(dest + 3 * total_elements + j, __riscv_vget_v_u8m1x4_u8m1(r, 3), vl);
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 8 bytes. */
+static void
+shuffle8_rvv(uint8_t* const dest, const uint8_t* const src, const int32_t total_elements) {
+  static const int32_t bytesoftype = 8;
+  int32_t j;
+  size_t vl;
+
+  for (j = 0; j < total_elements; j += (int32_t)vl) {
+    vl = __riscv_vsetvl_e8m1((size_t)(total_elements - j));
+    const vuint8m1x8_t r = __riscv_vlseg8e8_v_u8m1x8(src + j * bytesoftype, vl);
+    __riscv_vse8_v_u8m1(dest + j, __riscv_vget_v_u8m1x8_u8m1(r, 0), vl);
+    __riscv_vse8_v_u8m1(dest + total_elements + j, __riscv_vget_v_u8m1x8_u8m1(r, 1), vl);
+    __riscv_vse8_v_u8m1(dest + 2 * total_elements + j, __riscv_vget_v_u8m1x8_u8m1(r, 2), vl);
+    __riscv_vse8_v_u8m1(dest + 3 * total_elements + j, __riscv_vget_v_u8m1x8_u8m1(r, 3), vl);
+    __riscv_vse8_v_u8m1(dest + 4 * total_elements + j, __riscv_vget_v_u8m1x8_u8m1(r, 4), vl);
+    __riscv_vse8_v_u8m1(dest + 5 * total_elements + j, __riscv_vget_v_u8m1x8_u8m1(r, 5), vl);
+    __riscv_vse8_v_u8m1(dest + 6 * total_elements + j, __riscv_vget_v_u8m1x8_u8m1(r, 6), vl);
+    __riscv_vse8_v_u8m1(dest + 7 * total_elements + j, __riscv_vget_v_u8m1x8_u8m1(r, 7), vl);
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 16 bytes. */
+static void
+shuffle16_rvv(uint8_t* const dest, const uint8_t* const src, const int32_t total_elements) {
+  static const int32_t bytesoftype = 16;
+  int32_t j;
+  size_t vl;
+
+  for (j = 0; j < total_elements; j += (int32_t)vl) {
+    /* Segments are limited to 8 fields, so split the elements in 2-byte units */
+    vl = __riscv_vsetvl_e16m1((size_t)(total_elements - j));
+    const vuint16m1x8_t r = __riscv_vlseg8e16_v_u16m1x8((const uint16_t*)(src + j * bytesoftype), vl);
+    uint8_t* const dest_for_jth_element = dest + j;
+#define STORE_UNIT(p)                                                                         \
+    store_bytes2_rvv(__riscv_vget_v_u16m1x8_u16m1(r, p),                                      \
+                     dest_for_jth_element + (2 * (p)) * total_elements,                       \
+                     dest_for_jth_element + (2 * (p) + 1) * total_elements, vl)
+    STORE_UNIT(0);
+    STORE_UNIT(1);
+    STORE_UNIT(2);
+    STORE_UNIT(3);
+    STORE_UNIT(4);
+    STORE_UNIT(5);
+    STORE_UNIT(6);
+    STORE_UNIT(7);
+#undef STORE_UNIT
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 2 bytes. */
+static void
+unshuffle2_rvv(uint8_t* const dest, const uint8_t* const src, const int32_t total_elements) {
+  static const int32_t bytesoftype = 2;
+  int32_t i;
+  size_t vl;
+
+  for (i = 0; i < total_elements; i += (int32_t)vl) {
+    vl = __riscv_vsetvl_e8m1((size_t)(total_elements - i));
+    const vuint8m1_t b0 = __riscv_vle8_v_u8m1(src + i, vl);
+    const vuint8m1_t b1 = __riscv_vle8_v_u8m1(src + total_elements + i, vl);
+    __riscv_vsseg2e8_v_u8m1x2(dest + i * bytesoftype, __riscv_vcreate_v_u8m1x2(b0, b1), vl);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 4 bytes. */
+static void
+unshuffle4_rvv(uint8_t* const dest, const uint8_t* const src, const int32_t total_elements) {
+  static const int32_t bytesoftype = 4;
+  int32_t i;
+  size_t vl;
+
+  for (i = 0; i < total_elements; i += (int32_t)vl) {
+    vl = __riscv_vsetvl_e8m1((size_t)(total_elements - i));
+    const vuint8m1_t b0 = __riscv_vle8_v_u8m1(src + i, vl);
+    const vuint8m1_t b1 = __riscv_vle8_v_u8m1(src + total_elements + i, vl);
+    const vuint8m1_t b2 = __riscv_vle8_v_u8m1(src + 2 * total_elements + i, vl);
+    const vuint8m1_t b3 = __riscv_vle8_v_u8m1(src + 3 * total_elements + i, vl);
+    __riscv_vsseg4e8_v_u8m1x4(dest + i * bytesoftype, __riscv_vcreate_v_u8m1x4(b0, b1, b2, b3), vl);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 8 bytes. */
+static void
+unshuffle8_rvv(uint8_t* const dest, const uint8_t* const src, const int32_t total_elements) {
+  static const int32_t bytesoftype = 8;
+  int32_t i;
+  size_t vl;
+
+  for (i = 0; i < total_elements; i += (int32_t)vl) {
+    vl = __riscv_vsetvl_e8m1((size_t)(total_elements - i));
+    const vuint8m1_t b0 = __riscv_vle8_v_u8m1(src + i, vl);
+    const vuint8m1_t b1 = __riscv_vle8_v_u8m1(src + total_elements + i, vl);
+    const vuint8m1_t b2 = __riscv_vle8_v_u8m1(src + 2 * total_elements + i, vl);
+    const vuint8m1_t b3 = __riscv_vle8_v_u8m1(src + 3 * total_elements + i, vl);
+    const vuint8m1_t b4 = __riscv_vle8_v_u8m1(src + 4 * total_elements + i, vl);
+    const vuint8m1_t b5 = __riscv_vle8_v_u8m1(src + 5 * total_elements + i, vl);
+    const vuint8m1_t b6 = __riscv_vle8_v_u8m1(src + 6 * total_elements + i, vl);
+    const vuint8m1_t b7 = __riscv_vle8_v_u8m1(src + 7 * total_elements + i, vl);
+    __riscv_vsseg8e8_v_u8m1x8(dest + i * bytesoftype,
+                              __riscv_vcreate_v_u8m1x8(b0, b1, b2, b3, b4, b5, b6, b7), vl);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 16 bytes. */
+static void
+unshuffle16_rvv(uint8_t* const dest, const uint8_t* const src, const int32_t total_elements) {
+  static const int32_t bytesoftype = 16;
+  int32_t i;
+  size_t vl;
+
+  for (i = 0; i < total_elements; i += (int32_t)vl) {
+    vl = __riscv_vsetvl_e16m1((size_t)(total_elements - i));
+    const uint8_t* const src_for_ith_element = src + i;
+#define LOAD_UNIT(p)                                                                          \
+    load_bytes2_rvv(src_for_ith_element + (2 * (p)) * total_elements,                         \
+                    src_for_ith_element + (2 * (p) + 1) * total_elements, vl)
+    const vuint16m1_t w0 = LOAD_UNIT(0);
+    const vuint16m1_t w1 = LOAD_UNIT(1);
+    const vuint16m1_t w2 = LOAD_UNIT(2);
+    const vuint16m1_t w3 = LOAD_UNIT(3);
+    const vuint16m1_t w4 = LOAD_UNIT(4);
+    const vuint16m1_t w5 = LOAD_UNIT(5);
+    const vuint16m1_t w6 = LOAD_UNIT(6);
+    const vuint16m1_t w7 = LOAD_UNIT(7);
+#undef LOAD_UNIT
+    __riscv_vsseg8e16_v_u16m1x8((uint16_t*)(dest + i * bytesoftype),
+                                __riscv_vcreate_v_u16m1x8(w0, w1, w2, w3, w4, w5, w6, w7), vl);
+  }
+}
+
+/* Shuffle a block.  This can never fail. */
+void
+shuffle_rvv(const int32_t bytesoftype, const int32_t blocksize,
+            const uint8_t *_src, uint8_t *_dest) {
+  const int32_t total_elements = blocksize / bytesoftype;
+
+  /* Optimized shuffle implementations */
+  switch (bytesoftype) {
+    case 2:
+      shuffle2_rvv(_dest, _src, total_elements);
+      break;
+    case 4:
+      shuffle4_rvv(_dest, _src, total_elements);
+      break;
+    case 8:
+      shuffle8_rvv(_dest, _src, total_elements);
+      break;
+    case 16:
+      shuffle16_rvv(_dest, _src, total_elements);
+      break;
+    default:
+      /* Non-optimized shuffle */
+      shuffle_generic(bytesoftype, blocksize, _src, _dest);
+      /* The non-optimized function covers the whole buffer,
+         so we're done processing here. */
+      return;
+  }
+
+  /* Copy the leftover bytes of the block, if any. */
+  if (blocksize % bytesoftype) {
+    shuffle_generic_inline(bytesoftype, total_elements * bytesoftype, blocksize, _src, _dest);
+  }
+}
+
+/* Unshuffle a block.  This can never fail. */
+void
+unshuffle_rvv(const int32_t bytesoftype, const int32_t blocksize,
+              const uint8_t *_src, uint8_t *_dest) {
+  const int32_t total_elements = blocksize / bytesoftype;
+
+  /* Optimized unshuffle implementations */
+  switch (bytesoftype) {
+    case 2:
+      unshuffle2_rvv(_dest, _src, total_elements);
+      break;
+    case 4:
+      unshuffle4_rvv(_dest, _src, total_elements);
+      break;
+    case 8:
+      unshuffle8_rvv(_dest, _src, total_elements);
+      break;
+    case 16:
+      unshuffle16_rvv(_dest, _src, total_elements);
+      break;
+    default:
+      /* Non-optimized unshuffle */
+      unshuffle_generic(bytesoftype, blocksize, _src, _dest);
+      /* The non-optimized function covers the whole buffer,
+         so we're done processing here. */
+      return;
+  }
+
+  /* Copy the leftover bytes of the block, if any. */
+  if (blocksize % bytesoftype) {
+    unshuffle_generic_inline(bytesoftype, total_elements * bytesoftype, blocksize, _src, _dest);
+  }
+}
+
+#endif /* defined(__riscv_vector) && ... */
@@ -503,6 +503,141 @@ unshuffle16_tiled_sse2(uint8_t* const dest, const uint8_t* const orig,
   }
 }
 
+/* Routine optimized for shuffling a buffer for a type size smaller than 16 bytes
+   (other than 2, 4 and 8).  Every element is loaded along with the bytes that follow
+   it up to a vector, which are transposed like in shuffle16_sse2 and then left out,
+   so the callers must have 16 - bytesoftype readable bytes past the last element. */
+static inline void
+shuffle_narrow_sse2(uint8_t* const dest, const uint8_t* const src,
+                    const int32_t vectorizable_elements, const int32_t total_elements, const int32_t bytesoftype) {
+  int32_t j;
+  int k, l;
+  __m128i xmm0[16], xmm1[16];
+
+  for (j = 0; j < vectorizable_elements; j += sizeof(__m128i)) {
+    /* Fetch 16 elements (and the bytes past them) */
+    for (k = 0; k < 16; k++) {
+      xmm0[k] = _mm_loadu_si128((__m128i*)(src + (j + k) * bytesoftype));
+    }
+    /* Transpose bytes */
+    for (k = 0, l = 0; k < 8; k++, l += 2) {
+      xmm1[k * 2] = _mm_unpacklo_epi8(xmm0[l], xmm0[l + 1]);
+      xmm1[k * 2 + 1] = _mm_unpackhi_epi8(xmm0[l], xmm0[l + 1]);
+    }
+    /* Transpose words */
+    for (k = 0, l = -2; k < 8; k++, l++) {
+      if ((k % 2) == 0) l += 2;
+      xmm0[k * 2] = _mm_unpacklo_epi16(xmm1[l], xmm1[l + 2]);
+      xmm0[k * 2 + 1] = _mm_unpackhi_epi16(xmm1[l], xmm1[l + 2]);
+    }
+    /* Transpose double words */
+    for (k = 0, l = -4; k < 8; k++, l++) {
+      if ((k % 4) == 0) l += 4;
+      xmm1[k * 2] = _mm_unpacklo_epi32(xmm0[l], xmm0[l + 4]);
+      xmm1[k * 2 + 1] = _mm_unpackhi_epi32(xmm0[l], xmm0[l + 4]);
+    }
+    /* Transpose quad words */
+    for (k = 0; k < 8; k++) {
+      xmm0[k * 2] = _mm_unpacklo_epi64(xmm1[k], xmm1[k + 8]);
+      xmm0[k * 2 + 1] = _mm_unpackhi_epi64(xmm1[k], xmm1[k + 8]);
+    }
+    /* Store the planes of the type only */
+    for (k = 0; k < bytesoftype; k++) {
+      _mm_storeu_si128((__m128i*)(dest + j + total_elements * k), xmm0[k]);
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size smaller than 16 bytes
+   (other than 2, 4 and 8).  Every element is stored along with garbage up to a
+   vector, which the next element overwrites, so the callers must have room for
+   16 - bytesoftype bytes past the last element (and fill them afterwards). */
+static inline void
+unshuffle_narrow_sse2(uint8_t* const dest, const uint8_t* const src,
+                      const int32_t vectorizable_elements, const int32_t total_elements, const int32_t bytesoftype) {
+  int32_t i;
+  int j;
+  __m128i xmm1[16], xmm2[16];
+  /* The order of the elements in the vectors after the transposition */
+  static const int order[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+
+  for (i = 0; i < vectorizable_elements; i += sizeof(__m128i)) {
+    /* Load 16 bytes of the planes of the type (and zeros for the rest) */
+    for (j = 0; j < 16; j++) {
+      xmm1[j] = j < bytesoftype ? _mm_loadu_si128((__m128i*)(src + i + total_elements * j)) : _mm_setzero_si128();
+    }
+    /* Shuffle bytes */
+    for (j = 0; j < 8; j++) {
+      xmm2[j] = _mm_unpacklo_epi8(xmm1[j * 2], xmm1[j * 2 + 1]);
+      xmm2[8 + j] = _mm_unpackhi_epi8(xmm1[j * 2], xmm1[j * 2 + 1]);
+    }
+    /* Shuffle 2-byte words */
+    for (j = 0; j < 8; j++) {
+      xmm1[j] = _mm_unpacklo_epi16(xmm2[j * 2], xmm2[j * 2 + 1]);
+      xmm1[8 + j] = _mm_unpackhi_epi16(xmm2[j * 2], xmm2[j * 2 + 1]);
+    }
+    /* Shuffle 4-byte dwords */
+    for (j = 0; j < 8; j++) {
+      xmm2[j] = _mm_unpacklo_epi32(xmm1[j * 2], xmm1[j * 2 + 1]);
+      xmm2[8 + j] = _mm_unpackhi_epi32(xmm1[j * 2], xmm1[j * 2 + 1]);
+    }
+    /* Shuffle 8-byte qwords */
+    for (j = 0; j < 8; j++) {
+      xmm1[j] = _mm_unpacklo_epi64(xmm2[j * 2], xmm2[j * 2 + 1]);
+      xmm1[8 + j] = _mm_unpackhi_epi64(xmm2[j * 2], xmm2[j * 2 + 1]);
+    }
+    /* Store the elements in increasing order, so every one overwrites the garbage of the previous one */
+    for (j = 0; j < 16; j++) {
+      _mm_storeu_si128((__m128i*)(dest + (i + j) * bytesoftype), xmm1[order[j]]);
+    }
+  }
+}
+
+/* The type sizes smaller than 16 bytes that have no routine of their own */
+#define NARROW_TYPESIZES(_) _(3) _(5) _(6) _(7) _(9) _(10) _(11) _(12) _(13) _(14) _(15)
+
+/* Run the narrow routines with a constant type size, so that they are specialized for it.
+   Returns the elements done, which are none for the type sizes without a narrow routine. */
+static int32_t
+shuffle_narrow_typesize_sse2(uint8_t* const dest, const uint8_t* const src,
+                             const int32_t vectorizable_elements, const int32_t total_elements,
+                             const int32_t bytesoftype) {
+#define NARROW_CASE(typesize) \
+  case typesize: shuffle_narrow_sse2(dest, src, vectorizable_elements, total_elements, typesize); break;
+  switch (bytesoftype) {
+    NARROW_TYPESIZES(NARROW_CASE)
+    default: return 0;
+  }
+#undef NARROW_CASE
+  return vectorizable_elements;
+}
+
+static int32_t
+unshuffle_narrow_typesize_sse2(uint8_t* const dest, const uint8_t* const src,
+                               const int32_t vectorizable_elements, const int32_t total_elements,
+                               const int32_t bytesoftype) {
+#define NARROW_CASE(typesize) \
+  case typesize: unshuffle_narrow_sse2(dest, src, vectorizable_elements, total_elements, typesize); break;
+  switch (bytesoftype) {
+    NARROW_TYPESIZES(NARROW_CASE)
+    default: return 0;
+  }
+#undef NARROW_CASE
+  return vectorizable_elements;
+}
+
+/* The elements that the narrow routines can do out of `nelems`, leaving room for the
+   vector that they read (or write) from the last element */
+static int32_t
+narrow_vectorizable_elements(const int32_t bytesoftype, const int32_t nelems) {
+  int32_t vectorizable_elements = nelems - nelems % (int32_t)sizeof(__m128i);
+  if (vectorizable_elements > 0 &&
+      vectorizable_elements * bytesoftype + (int32_t)sizeof(__m128i) - bytesoftype > nelems * bytesoftype) {
+    vectorizable_elements -= sizeof(__m128i);
+  }
+  return vectorizable_elements;
+}
+
 /* Shuffle a block.  This can never fail. */
 void
 shuffle_sse2(const int32_t bytesoftype, const int32_t blocksize,
@@ -543,10 +678,10 @@ shuffle_sse2(const int32_t bytesoftype, const int32_t blocksize,
         shuffle16_tiled_sse2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
       }
       else {
-        /* Non-optimized shuffle */
-        shuffle_generic(bytesoftype, blocksize, _src, _dest);
-        /* The non-optimized function covers the whole buffer,
-           so we're done processing here. */
+        /* Optimized shuffle for the rest of the type sizes smaller than 16 bytes */
+        const int32_t narrow_elements = shuffle_narrow_typesize_sse2(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, total_elements), total_elements, bytesoftype);
+        shuffle_generic_inline(bytesoftype, narrow_elements * bytesoftype, blocksize, _src, _dest);
         return;
       }
   }
@@ -599,10 +734,10 @@ unshuffle_sse2(const int32_t bytesoftype, const int32_t blocksize,
         unshuffle16_tiled_sse2(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
       }
       else {
-        /* Non-optimized unshuffle */
-        unshuffle_generic(bytesoftype, blocksize, _src, _dest);
-        /* The non-optimized function covers the whole buffer,
-           so we're done processing here. */
+        /* Optimized unshuffle for the rest of the type sizes smaller than 16 bytes */
+        const int32_t narrow_elements = unshuffle_narrow_typesize_sse2(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, total_elements), total_elements, bytesoftype);
+        unshuffle_generic_inline(bytesoftype, narrow_elements * bytesoftype, blocksize, _src, _dest);
         return;
       }
   }
@@ -615,4 +750,70 @@ unshuffle_sse2(const int32_t bytesoftype, const int32_t blocksize,
   }
 }
 
+/* Shuffle the `nelems` elements of a tile into the byte planes of a block with
+   `total_elements` (`_dest` points to the first element of the tile in the
+   first plane).  This can never fail. */
+void
+shuffle_tile_sse2(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                  const uint8_t *_src, uint8_t *_dest) {
+  int32_t vectorizable_elements = nelems - nelems % (int32_t)sizeof(__m128i);
+
+  switch (bytesoftype) {
+    case 2:
+      shuffle2_sse2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      shuffle4_sse2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      shuffle8_sse2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      shuffle16_sse2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype < (int32_t)sizeof(__m128i)) {
+        vectorizable_elements = shuffle_narrow_typesize_sse2(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, nelems), total_elements, bytesoftype);
+      }
+      else {
+        vectorizable_elements = 0;
+      }
+  }
+  shuffle_tile_generic_inline(bytesoftype, vectorizable_elements, nelems, total_elements, _src, _dest);
+}
+
+/* Unshuffle the `nelems` elements of a tile out of the byte planes of a block
+   with `total_elements` (`_src` points to the first element of the tile in the
+   first plane).  This can never fail. */
+void
+unshuffle_tile_sse2(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                    const uint8_t *_src, uint8_t *_dest) {
+  int32_t vectorizable_elements = nelems - nelems % (int32_t)sizeof(__m128i);
+
+  switch (bytesoftype) {
+    case 2:
+      unshuffle2_sse2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      unshuffle4_sse2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      unshuffle8_sse2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      unshuffle16_sse2(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype < (int32_t)sizeof(__m128i)) {
+        vectorizable_elements = unshuffle_narrow_typesize_sse2(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, nelems), total_elements, bytesoftype);
+      }
+      else {
+        vectorizable_elements = 0;
+      }
+  }
+  unshuffle_tile_generic_inline(bytesoftype, vectorizable_elements, nelems, total_elements, _src, _dest);
+}
+
 #endif /* defined(__SSE2__) */
@@ -0,0 +1,360 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "shuffle-sve.h"
+#include "shuffle-generic.h"
+
+/* Make sure SVE is available for the compilation target and compiler. */
+#if defined(__ARM_FEATURE_SVE)
+
+#include <arm_sve.h>
+
+#include <stdint.h>
+
+/* The routines below are vector-length agnostic: each iteration processes
+   as many elements as bytes fit in a vector (svcntb()), whatever the width
+   of the implementation is.  Type sizes up to 4 map directly to the
+   structure loads/stores; larger ones are split in units of 2 or 4 bytes
+   first, and then (de-)interleaved with uzp/zip. */
+
+/* Deinterleave the bytes of two vectors of 2-byte units into 2 rows. */
+static inline void
+deinterleave2_sve(const svuint8_t a0, const svuint8_t a1,
+                  uint8_t* const row, const int32_t total_elements) {
+  const svbool_t pg = svptrue_b8();
+  svst1_u8(pg, row, svuzp1_u8(a0, a1));
+  svst1_u8(pg, row + total_elements, svuzp2_u8(a0, a1));
+}
+
+/* Deinterleave the bytes of four vectors of 4-byte units into 4 rows. */
+static inline void
+deinterleave4_sve(const svuint8_t a0, const svuint8_t a1, const svuint8_t a2, const svuint8_t a3,
+                  uint8_t* const row, const int32_t total_elements) {
+  const svbool_t pg = svptrue_b8();
+  const svuint8_t e01 = svuzp1_u8(a0, a1);
+  const svuint8_t o01 = svuzp2_u8(a0, a1);
+  const svuint8_t e23 = svuzp1_u8(a2, a3);
+  const svuint8_t o23 = svuzp2_u8(a2, a3);
+  svst1_u8(pg, row, svuzp1_u8(e01, e23));
+  svst1_u8(pg, row + total_elements, svuzp1_u8(o01, o23));
+  svst1_u8(pg, row + 2 * total_elements, svuzp2_u8(e01, e23));
+  svst1_u8(pg, row + 3 * total_elements, svuzp2_u8(o01, o23));
+}
+
+/* Interleave 2 rows into two vectors of 2-byte units (the inverse of deinterleave2_sve). */
+static inline svuint8x2_t
+interleave2_sve(const uint8_t* const row, const int32_t total_elements) {
+  const svbool_t pg = svptrue_b8();
+  const svuint8_t b0 = svld1_u8(pg, row);
+  const svuint8_t b1 = svld1_u8(pg, row + total_elements);
+  return svcreate2_u8(svzip1_u8(b0, b1), svzip2_u8(b0, b1));
+}
+
+/* Interleave 4 rows into four vectors of 4-byte units (the inverse of deinterleave4_sve). */
+static inline svuint8x4_t
+interleave4_sve(const uint8_t* const row, const int32_t total_elements) {
+  const svbool_t pg = svptrue_b8();
+  const svuint8_t b0 = svld1_u8(pg, row);
+  const svuint8_t b1 = svld1_u8(pg, row + total_elements);
+  const svuint8_t b2 = svld1_u8(pg, row + 2 * total_elements);
+  const svuint8_t b3 = svld1_u8(pg, row + 3 * total_elements);
+  const svuint8_t e01 = svzip1_u8(b0, b2);
+  const svuint8_t e23 = svzip2_u8(b0, b2);
+  const svuint8_t o01 = svzip1_u8(b1, b3);
+  const svuint8_t o23 = svzip2_u8(b1, b3);
+  return svcreate4_u8(svzip1_u8(e01, o01), svzip2_u8(e01, o01),
+                      svzip1_u8(e23, o23), svzip2_u8(e23, o23));
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 2 bytes. */
+static void
+shuffle2_sve(uint8_t* const dest, const uint8_t* const src,
+             const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 2;
+  const int32_t vl = (int32_t)svcntb();
+  const svbool_t pg = svptrue_b8();
+  int32_t j;
+
+  for (j = 0; j < vectorizable_elements; j += vl) {
+    const svuint8x2_t r = svld2_u8(pg, src + j * bytesoftype);
+    svst1_u8(pg, dest + j, svget2_u8(r, 0));
+    svst1_u8(pg, dest + total_elements + j, svget2_u8(r, 1));
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 4 bytes. */
+static void
+shuffle4_sve(uint8_t* const dest, const uint8_t* const src,
+             const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 4;
+  const int32_t vl = (int32_t)svcntb();
+  const svbool_t pg = svptrue_b8();
+  int32_t j;
+
+  for (j = 0; j < vectorizable_elements; j += vl) {
+    const svuint8x4_t r = svld4_u8(pg, src + j * bytesoftype);
+    svst1_u8(pg, dest + j, svget4_u8(r, 0));
+    svst1_u8(pg, dest + total_elements + j, svget4_u8(r, 1));
+    svst1_u8(pg, dest + 2 * total_elements + j, svget4_u8(r, 2));
+    svst1_u8(pg, dest + 3 * total_elements + j, svget4_u8(r, 3));
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 8 bytes. */
+static void
+shuffle8_sve(uint8_t* const dest, const uint8_t* const src,
+             const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 8;
+  const int32_t vl = (int32_t)svcntb();
+  const svbool_t pg = svptrue_b16();
+  int32_t j;
+
+  for (j = 0; j < vectorizable_elements; j += vl) {
+    /* Split the elements in 2-byte units, half of the elements at a time */
+    const uint16_t* const src_for_jth_element = (const uint16_t*)(src + j * bytesoftype);
+    const svuint16x4_t lo = svld4_u16(pg, src_for_jth_element);
+    const svuint16x4_t hi = svld4_u16(pg, src_for_jth_element + 2 * vl);
+    uint8_t* const dest_for_jth_element = dest + j;
+    deinterleave2_sve(svreinterpret_u8_u16(svget4_u16(lo, 0)), svreinterpret_u8_u16(svget4_u16(hi, 0)),
+                      dest_for_jth_element, total_elements);
+    deinterleave2_sve(svreinterpret_u8_u16(svget4_u16(lo, 1)), svreinterpret_u8_u16(svget4_u16(hi, 1)),
+                      dest_for_jth_element + 2 * total_elements, total_elements);
+    deinterleave2_sve(svreinterpret_u8_u16(svget4_u16(lo, 2)), svreinterpret_u8_u16(svget4_u16(hi, 2)),
+                      dest_for_jth_element + 4 * total_elements, total_elements);
+    deinterleave2_sve(svreinterpret_u8_u16(svget4_u16(lo, 3)), svreinterpret_u8_u16(svget4_u16(hi, 3)),
+                      dest_for_jth_element + 6 * total_elements, total_elements);
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size of 16 bytes. */
+static void
+shuffle16_sve(uint8_t* const dest, const uint8_t* const src,
+              const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 16;
+  const int32_t vl = (int32_t)svcntb();
+  const svbool_t pg = svptrue_b32();
+  int32_t j;
+
+  for (j = 0; j < vectorizable_elements; j += vl) {
+    /* Split the elements in 4-byte units, a quarter of the elements at a time */
+    const uint32_t* const src_for_jth_element = (const uint32_t*)(src + j * bytesoftype);
+    const svuint32x4_t g0 = svld4_u32(pg, src_for_jth_element);
+    const svuint32x4_t g1 = svld4_u32(pg, src_for_jth_element + vl);
+    const svuint32x4_t g2 = svld4_u32(pg, src_for_jth_element + 2 * vl);
+    const svuint32x4_t g3 = svld4_u32(pg, src_for_jth_element + 3 * vl);
+    uint8_t* const dest_for_jth_element = dest + j;
+#define DEINTERLEAVE_UNIT(p)                                                            \
+    deinterleave4_sve(svreinterpret_u8_u32(svget4_u32(g0, p)),                          \
+                      svreinterpret_u8_u32(svget4_u32(g1, p)),                          \
+                      svreinterpret_u8_u32(svget4_u32(g2, p)),                          \
+                      svreinterpret_u8_u32(svget4_u32(g3, p)),                          \
+                      dest_for_jth_element + 4 * (p) * total_elements, total_elements)
+    DEINTERLEAVE_UNIT(0);
+    DEINTERLEAVE_UNIT(1);
+    DEINTERLEAVE_UNIT(2);
+    DEINTERLEAVE_UNIT(3);
+#undef DEINTERLEAVE_UNIT
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 2 bytes. */
+static void
+unshuffle2_sve(uint8_t* const dest, const uint8_t* const src,
+               const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 2;
+  const int32_t vl = (int32_t)svcntb();
+  const svbool_t pg = svptrue_b8();
+  int32_t i;
+
+  for (i = 0; i < vectorizable_elements; i += vl) {
+    const svuint8_t b0 = svld1_u8(pg, src + i);
+    const svuint8_t b1 = svld1_u8(pg, src + total_elements + i);
+    svst2_u8(pg, dest + i * bytesoftype, svcreate2_u8(b0, b1));
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 4 bytes. */
+static void
+unshuffle4_sve(uint8_t* const dest, const uint8_t* const src,
+               const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 4;
+  const int32_t vl = (int32_t)svcntb();
+  const svbool_t pg = svptrue_b8();
+  int32_t i;
+
+  for (i = 0; i < vectorizable_elements; i += vl) {
+    const svuint8_t b0 = svld1_u8(pg, src + i);
+    const svuint8_t b1 = svld1_u8(pg, src + total_elements + i);
+    const svuint8_t b2 = svld1_u8(pg, src + 2 * total_elements + i);
+    const svuint8_t b3 = svld1_u8(pg, src + 3 * total_elements + i);
+    svst4_u8(pg, dest + i * bytesoftype, svcreate4_u8(b0, b1, b2, b3));
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 8 bytes. */
+static void
+unshuffle8_sve(uint8_t* const dest, const uint8_t* const src,
+               const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 8;
+  const int32_t vl = (int32_t)svcntb();
+  const svbool_t pg = svptrue_b16();
+  int32_t i;
+
+  for (i = 0; i < vectorizable_elements; i += vl) {
+    /* Build the 2-byte units of the elements, and store them for each half */
+    const uint8_t* const src_for_ith_element = src + i;
+    const svuint8x2_t u0 = interleave2_sve(src_for_ith_element, total_elements);
+    const svuint8x2_t u1 = interleave2_sve(src_for_ith_element + 2 * total_elements, total_elements);
+    const svuint8x2_t u2 = interleave2_sve(src_for_ith_element + 4 * total_elements, total_elements);
+    const svuint8x2_t u3 = interleave2_sve(src_for_ith_element + 6 * total_elements, total_elements);
+    uint16_t* const dest_for_ith_element = (uint16_t*)(dest + i * bytesoftype);
+    svst4_u16(pg, dest_for_ith_element,
+              svcreate4_u16(svreinterpret_u16_u8(svget2_u8(u0, 0)), svreinterpret_u16_u8(svget2_u8(u1, 0)),
+                            svreinterpret_u16_u8(svget2_u8(u2, 0)), svreinterpret_u16_u8(svget2_u8(u3, 0))));
+    svst4_u16(pg, dest_for_ith_element + 2 * vl,
+              svcreate4_u16(svreinterpret_u16_u8(svget2_u8(u0, 1)), svreinterpret_u16_u8(svget2_u8(u1, 1)),
+                            svreinterpret_u16_u8(svget2_u8(u2, 1)), svreinterpret_u16_u8(svget2_u8(u3, 1))));
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 16 bytes. */
+static void
+unshuffle16_sve(uint8_t* const dest, const uint8_t* const src,
+                const int32_t vectorizable_elements, const int32_t total_elements) {
+  static const int32_t bytesoftype = 16;
+  const int32_t vl = (int32_t)svcntb();
+  const svbool_t pg = svptrue_b32();
+  int32_t i;
+
+  for (i = 0; i < vectorizable_elements; i += vl) {
+    /* Build the 4-byte units of the elements, and store them for each quarter */
+    const uint8_t* const src_for_ith_element = src + i;
+    const svuint8x4_t u0 = interleave4_sve(src_for_ith_element, total_elements);
+    const svuint8x4_t u1 = interleave4_sve(src_for_ith_element + 4 * total_elements, total_elements);
+    const svuint8x4_t u2 = interleave4_sve(src_for_ith_element + 8 * total_elements, total_elements);
+    const svuint8x4_t u3 = interleave4_sve(src_for_ith_element + 12 * total_elements, total_elements);
+    uint32_t* const dest_for_ith_element = (uint32_t*)(dest + i * bytesoftype);
+#define STORE_QUARTER(g)                                                                     \
+    svst4_u32(pg, dest_for_ith_element + (g) * vl,                                           \
+              svcreate4_u32(svreinterpret_u32_u8(svget4_u8(u0, g)),                          \
+                            svreinterpret_u32_u8(svget4_u8(u1, g)),                          \
+                            svreinterpret_u32_u8(svget4_u8(u2, g)),                          \
+                            svreinterpret_u32_u8(svget4_u8(u3, g))))
+    STORE_QUARTER(0);
+    STORE_QUARTER(1);
+    STORE_QUARTER(2);
+    STORE_QUARTER(3);
+#undef STORE_QUARTER
+  }
+}
+
+/* Shuffle a block.  This can never fail. */
+void
+shuffle_sve(const int32_t bytesoftype, const int32_t blocksize,
+            const uint8_t *_src, uint8_t *_dest) {
+  const int32_t vectorized_chunk_size = bytesoftype * (int32_t)svcntb();
+  /* If the blocksize is not a multiple of both the typesize and
+     the vector size, round the blocksize down to the next value
+     which is a multiple of both. The vectorized shuffle can be
+     used for that portion of the data, and the naive implementation
+     can be used for the remaining portion. */
+  const int32_t vectorizable_bytes = blocksize - (blocksize % vectorized_chunk_size);
+  const int32_t vectorizable_elements = vectorizable_bytes / bytesoftype;
+  const int32_t total_elements = blocksize / bytesoftype;
+
+  /* If the block size is too small to be vectorized,
+     use the generic implementation. */
+  if (blocksize < vectorized_chunk_size) {
+    shuffle_generic(bytesoftype, blocksize, _src, _dest);
+    return;
+  }
+
+  /* Optimized shuffle implementations */
+  switch (bytesoftype) {
+    case 2:
+      shuffle2_sve(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      shuffle4_sve(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      shuffle8_sve(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      shuffle16_sve(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      /* Non-optimized shuffle */
+      shuffle_generic(bytesoftype, blocksize, _src, _dest);
+      /* The non-optimized function covers the whole buffer,
+         so we're done processing here. */
+      return;
+  }
+
+  /* If the buffer had any bytes at the end which couldn't be handled
+     by the vectorized implementations, use the non-optimized version
+     to finish them up. */
+  if (vectorizable_bytes < blocksize) {
+    shuffle_generic_inline(bytesoftype, vectorizable_bytes, blocksize, _src, _dest);
+  }
+}
+
+/* Unshuffle a block.  This can never fail. */
+void
+unshuffle_sve(const int32_t bytesoftype, const int32_t blocksize,
+              const uint8_t *_src, uint8_t *_dest) {
+  const int32_t vectorized_chunk_size = bytesoftype * (int32_t)svcntb();
+  /* If the blocksize is not a multiple of both the typesize and
+     the vector size, round the blocksize down to the next value
+     which is a multiple of both. The vectorized unshuffle can be
+     used for that portion of the data, and the naive implementation
+     can be used for the remaining portion. */
+  const int32_t vectorizable_bytes = blocksize - (blocksize % vectorized_chunk_size);
+  const int32_t vectorizable_elements = vectorizable_bytes / bytesoftype;
+  const int32_t total_elements = blocksize / bytesoftype;
+
+  /* If the block size is too small to be vectorized,
+     use the generic implementation. */
+  if (blocksize < vectorized_chunk_size) {
+    unshuffle_generic(bytesoftype, blocksize, _src, _dest);
+    return;
+  }
+
+  /* Optimized unshuffle implementations */
+  switch (bytesoftype) {
+    case 2:
+      unshuffle2_sve(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      unshuffle4_sve(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      unshuffle8_sve(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      unshuffle16_sve(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      /* Non-optimized unshuffle */
+      unshuffle_generic(bytesoftype, blocksize, _src, _dest);
+      /* The non-optimized function covers the whole buffer,
+         so we're done processing here. */
+      return;
+  }
+
+  /* If the buffer had any bytes at the end which couldn't be handled
+     by the vectorized implementations, use the non-optimized version
+     to finish them up. */
+  if (vectorizable_bytes < blocksize) {
+    unshuffle_generic_inline(bytesoftype, vectorizable_bytes, blocksize, _src, _dest);
+  }
+}
+
+#endif /* defined(__ARM_FEATURE_SVE) */
@@ -0,0 +1,32 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* SVE-accelerated shuffle/unshuffle routines. */
+
+#ifndef BLOSC_SHUFFLE_SVE_H
+#define BLOSC_SHUFFLE_SVE_H
+
+#include "blosc2/blosc2-common.h"
+
+#include <stdint.h>
+
+/**
+  SVE-accelerated shuffle routine.
+*/
+BLOSC_NO_EXPORT void shuffle_sve(const int32_t bytesoftype, const int32_t blocksize,
+                                 const uint8_t *_src, uint8_t *_dest);
+
+/**
+  SVE-accelerated unshuffle routine.
+*/
+BLOSC_NO_EXPORT void unshuffle_sve(const int32_t bytesoftype, const int32_t blocksize,
+                                   const uint8_t *_src, uint8_t *_dest);
+
+#endif /* BLOSC_SHUFFLE_SVE_H */
@@ -0,0 +1,456 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "shuffle-wasm.h"
+#include "shuffle-generic.h"
+
+/* Make sure SIMD128 is available for the compilation target and compiler. */
+#if defined(__wasm_simd128__)
+
+#include "transpose-wasm.h"
+
+#include <wasm_simd128.h>
+
+#include <stdint.h>
+
+/* Routine optimized for shuffling a buffer for a type size of 2, 4, 8 or 16 bytes
+   (it is inlined with a constant type size, so that the transposition is unrolled). */
+static inline void
+shuffle_pow2_wasm(uint8_t* const dest, const uint8_t* const src,
+                  const int32_t vectorizable_elements, const int32_t total_elements,
+                  const int32_t bytesoftype) {
+  int32_t i, j;
+  v128_t xmm0[16];
+
+  for (j = 0; j < vectorizable_elements; j += 16) {
+    /* Fetch 16 elements (bytesoftype vectors) */
+    for (i = 0; i < bytesoftype; i++)
+      xmm0[i] = wasm_v128_load(src + bytesoftype * j + 16 * i);
+
+    /* Transpose vectors */
+    transpose_nx16(xmm0, bytesoftype);
+
+    /* Store the result vectors */
+    for (i = 0; i < bytesoftype; i++)
+      wasm_v128_store(dest + j + i * total_elements, xmm0[i]);
+  }
+}
+
+static void
+shuffle2_wasm(uint8_t* const dest, const uint8_t* const src,
+              const int32_t vectorizable_elements, const int32_t total_elements) {
+  shuffle_pow2_wasm(dest, src, vectorizable_elements, total_elements, 2);
+}
+
+static void
+shuffle4_wasm(uint8_t* const dest, const uint8_t* const src,
+              const int32_t vectorizable_elements, const int32_t total_elements) {
+  shuffle_pow2_wasm(dest, src, vectorizable_elements, total_elements, 4);
+}
+
+static void
+shuffle8_wasm(uint8_t* const dest, const uint8_t* const src,
+              const int32_t vectorizable_elements, const int32_t total_elements) {
+  shuffle_pow2_wasm(dest, src, vectorizable_elements, total_elements, 8);
+}
+
+static void
+shuffle16_wasm(uint8_t* const dest, const uint8_t* const src,
+               const int32_t vectorizable_elements, const int32_t total_elements) {
+  shuffle_pow2_wasm(dest, src, vectorizable_elements, total_elements, 16);
+}
+
+
+/* Routine optimized for shuffling a buffer for a type size larger than 16 bytes. */
+static void
+shuffle16_tiled_wasm(uint8_t* const dest, const uint8_t* const src,
+                     const int32_t vectorizable_elements, const int32_t total_elements,
+                     const int32_t bytesoftype) {
+  int32_t j, k;
+  const int32_t vecs_per_el_rem = bytesoftype & 0xF;
+  v128_t xmm[16];
+
+  for (j = 0; j < vectorizable_elements; j += 16) {
+    /* Advance the offset into the type by the vector size (in bytes), unless this is
+    the initial iteration and the type size is not a multiple of the vector size.
+    In that case, only advance by the number of bytes necessary so that the number
+    of remaining bytes in the type will be a multiple of the vector size. */
+    int32_t offset_into_type;
+    for (offset_into_type = 0; offset_into_type < bytesoftype;
+         offset_into_type += (offset_into_type == 0 &&
+                              vecs_per_el_rem > 0 ? vecs_per_el_rem : 16)) {
+
+      /* Fetch elements in groups of 256 bytes */
+      const uint8_t* const src_with_offset = src + offset_into_type;
+      for (k = 0; k < 16; k++)
+        xmm[k] = wasm_v128_load(src_with_offset + (j + k) * bytesoftype);
+      // Do the Job!
+      transpose_nx16(xmm, 16);
+      /* Store the result vectors */
+      for (k = 0; k < 16; k++) {
+        wasm_v128_store(dest + j + total_elements * (offset_into_type + k), xmm[k]);
+      }
+    }
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size of 2, 4, 8 or 16 bytes. */
+static inline void
+unshuffle_pow2_wasm(uint8_t* const dest, const uint8_t* const src,
+                    const int32_t vectorizable_elements, const int32_t total_elements,
+                    const int32_t bytesoftype) {
+  int32_t i, j;
+  v128_t xmm0[16];
+
+  for (j = 0; j < vectorizable_elements; j += 16) {
+    /* Load 16 bytes of every plane */
+    for (i = 0; i < bytesoftype; i++)
+      xmm0[i] = wasm_v128_load(src + j + i * total_elements);
+
+    /* Interleave the planes back into the elements */
+    untranspose_nx16(xmm0, bytesoftype);
+
+    /* Store the result vectors (unaligned, as the tiles of the fused filters may not be) */
+    for (i = 0; i < bytesoftype; i++)
+      wasm_v128_store(dest + bytesoftype * j + 16 * i, xmm0[i]);
+  }
+}
+
+static void
+unshuffle2_wasm(uint8_t* const dest, const uint8_t* const src,
+                const int32_t vectorizable_elements, const int32_t total_elements) {
+  unshuffle_pow2_wasm(dest, src, vectorizable_elements, total_elements, 2);
+}
+
+static void
+unshuffle4_wasm(uint8_t* const dest, const uint8_t* const src,
+                const int32_t vectorizable_elements, const int32_t total_elements) {
+  unshuffle_pow2_wasm(dest, src, vectorizable_elements, total_elements, 4);
+}
+
+static void
+unshuffle8_wasm(uint8_t* const dest, const uint8_t* const src,
+                const int32_t vectorizable_elements, const int32_t total_elements) {
+  unshuffle_pow2_wasm(dest, src, vectorizable_elements, total_elements, 8);
+}
+
+static void
+unshuffle16_wasm(uint8_t* const dest, const uint8_t* const src,
+                 const int32_t vectorizable_elements, const int32_t total_elements) {
+  unshuffle_pow2_wasm(dest, src, vectorizable_elements, total_elements, 16);
+}
+
+
+/* Routine optimized for unshuffling a buffer for a type size larger than 16 bytes. */
+static void
+unshuffle16_tiled_wasm(uint8_t* const dest, const uint8_t* const orig,
+                       const int32_t vectorizable_elements, const int32_t total_elements,
+                       const int32_t bytesoftype) {
+  int32_t i, j, offset_into_type;
+  const int32_t vecs_per_el_rem = bytesoftype & 0xF;
+  v128_t xmm[16];
+
+  /* Advance the offset into the type by the vector size (in bytes), unless this is
+    the initial iteration and the type size is not a multiple of the vector size.
+    In that case, only advance by the number of bytes necessary so that the number
+    of remaining bytes in the type will be a multiple of the vector size. */
+
+  for (offset_into_type = 0; offset_into_type < bytesoftype;
+       offset_into_type += (offset_into_type == 0 &&
+           vecs_per_el_rem > 0 ? vecs_per_el_rem : 16)) {
+    for (i = 0; i < vectorizable_elements; i += 16) {
+      /* Load 16 bytes of 16 planes */
+      for (j = 0; j < 16; j++)
+        xmm[j] = wasm_v128_load(orig + total_elements * (offset_into_type + j) + i);
+
+      // Do the Job !
+      untranspose_nx16(xmm, 16);
+
+      /* Store the result vectors in proper order */
+      for (j = 0; j < 16; j++)
+        wasm_v128_store(dest + (i + j) * bytesoftype + offset_into_type, xmm[j]);
+    }
+  }
+}
+
+/* Routine optimized for shuffling a buffer for a type size smaller than 16 bytes
+   (other than 2, 4 and 8).  As in shuffle-altivec.c, every element is loaded along
+   with the bytes that follow it up to a vector, and only the planes of the type are
+   kept out of the transposition, so the callers must have 16 - bytesoftype readable
+   bytes past the last element. */
+static inline void
+shuffle_narrow_wasm(uint8_t* const dest, const uint8_t* const src,
+                    const int32_t vectorizable_elements, const int32_t total_elements,
+                    const int32_t bytesoftype) {
+  int32_t j, k;
+  v128_t xmm[16];
+
+  for (j = 0; j < vectorizable_elements; j += 16) {
+    /* Fetch 16 elements (and the bytes past them) */
+    for (k = 0; k < 16; k++)
+      xmm[k] = wasm_v128_load(src + (j + k) * bytesoftype);
+
+    transpose_nx16(xmm, 16);
+
+    /* Store the planes of the type only */
+    for (k = 0; k < bytesoftype; k++)
+      wasm_v128_store(dest + j + total_elements * k, xmm[k]);
+  }
+}
+
+/* Routine optimized for unshuffling a buffer for a type size smaller than 16 bytes
+   (other than 2, 4 and 8).  The transposition of the planes of the type (padded with
+   zeros) leaves every element at the start of a vector, which is stored along with
+   garbage that the next element overwrites, so the callers must have room for
+   16 - bytesoftype bytes past the last element (and fill them afterwards). */
+static inline void
+unshuffle_narrow_wasm(uint8_t* const dest, const uint8_t* const src,
+                      const int32_t vectorizable_elements, const int32_t total_elements,
+                      const int32_t bytesoftype) {
+  int32_t i, j;
+  v128_t xmm[16];
+
+  for (i = 0; i < vectorizable_elements; i += 16) {
+    /* Load 16 bytes of the planes of the type (and zeros for the rest) */
+    for (j = 0; j < 16; j++)
+      xmm[j] = j < bytesoftype ? wasm_v128_load(src + i + total_elements * j) : wasm_i8x16_splat(0);
+
+    untranspose_nx16(xmm, 16);
+
+    /* Store the elements in increasing order */
+    for (j = 0; j < 16; j++)
+      wasm_v128_store(dest + (i + j) * bytesoftype, xmm[j]);
+  }
+}
+
+/* The type sizes smaller than 16 bytes that have no routine of their own */
+#define NARROW_TYPESIZES(_) _(3) _(5) _(6) _(7) _(9) _(10) _(11) _(12) _(13) _(14) _(15)
+
+/* Run the narrow routines with a constant type size, so that they are specialized for it.
+   Returns the elements done, which are none for the type sizes without a narrow routine. */
+static int32_t
+shuffle_narrow_typesize_wasm(uint8_t* const dest, const uint8_t* const src,
+                             const int32_t vectorizable_elements, const int32_t total_elements,
+                             const int32_t bytesoftype) {
+#define NARROW_CASE(typesize) \
+  case typesize: shuffle_narrow_wasm(dest, src, vectorizable_elements, total_elements, typesize); break;
+  switch (bytesoftype) {
+    NARROW_TYPESIZES(NARROW_CASE)
+    default: return 0;
+  }
+#undef NARROW_CASE
+  return vectorizable_elements;
+}
+
+static int32_t
+unshuffle_narrow_typesize_wasm(uint8_t* const dest, const uint8_t* const src,
+                               const int32_t vectorizable_elements, const int32_t total_elements,
+                               const int32_t bytesoftype) {
+#define NARROW_CASE(typesize) \
+  case typesize: unshuffle_narrow_wasm(dest, src, vectorizable_elements, total_elements, typesize); break;
+  switch (bytesoftype) {
+    NARROW_TYPESIZES(NARROW_CASE)
+    default: return 0;
+  }
+#undef NARROW_CASE
+  return vectorizable_elements;
+}
+
+/* The elements that the narrow routines can do out of `nelems`, leaving room for the
+   vector that they read (or write) from the last element */
+static int32_t
+narrow_vectorizable_elements(const int32_t bytesoftype, const int32_t nelems) {
+  int32_t vectorizable_elements = nelems - nelems % 16;
+  if (vectorizable_elements > 0 &&
+      vectorizable_elements * bytesoftype + 16 - bytesoftype > nelems * bytesoftype) {
+    vectorizable_elements -= 16;
+  }
+  return vectorizable_elements;
+}
+
+/* Shuffle a block.  This can never fail. */
+void
+shuffle_wasm(const int32_t bytesoftype, const int32_t blocksize,
+             const uint8_t *_src, uint8_t *_dest) {
+  const int32_t vectorized_chunk_size = bytesoftype * 16;
+  /* If the blocksize is not a multiple of both the typesize and
+     the vector size, round the blocksize down to the next value
+     which is a multiple of both. The vectorized shuffle can be
+     used for that portion of the data, and the naive implementation
+     can be used for the remaining portion. */
+  const int32_t vectorizable_bytes = blocksize - (blocksize % vectorized_chunk_size);
+  const int32_t vectorizable_elements = vectorizable_bytes / bytesoftype;
+  const int32_t total_elements = blocksize / bytesoftype;
+
+  /* If the block size is too small to be vectorized,
+     use the generic implementation. */
+  if (blocksize < vectorized_chunk_size) {
+    shuffle_generic(bytesoftype, blocksize, _src, _dest);
+    return;
+  }
+
+  /* Optimized shuffle implementations */
+  switch (bytesoftype) {
+    case 2:
+      shuffle2_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      shuffle4_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      shuffle8_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      shuffle16_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype > 16) {
+        shuffle16_tiled_wasm(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
+      }
+      else {
+        /* Optimized shuffle for the rest of the type sizes smaller than 16 bytes */
+        const int32_t narrow_elements = shuffle_narrow_typesize_wasm(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, total_elements), total_elements, bytesoftype);
+        shuffle_generic_inline(bytesoftype, narrow_elements * bytesoftype, blocksize, _src, _dest);
+        return;
+      }
+  }
+
+  /* If the buffer had any bytes at the end which couldn't be handled
+     by the vectorized implementations, use the non-optimized version
+     to finish them up. */
+  if (vectorizable_bytes < blocksize) {
+    shuffle_generic_inline(bytesoftype, vectorizable_bytes, blocksize, _src, _dest);
+  }
+}
+
+/* Unshuffle a block.  This can never fail. */
+void
+unshuffle_wasm(const int32_t bytesoftype, const int32_t blocksize,
+               const uint8_t *_src, uint8_t *_dest) {
+  const int32_t vectorized_chunk_size = bytesoftype * 16;
+  /* If the blocksize is not a multiple of both the typesize and
+     the vector size, round the blocksize down to the next value
+     which is a multiple of both. The vectorized unshuffle can be
+     used for that portion of the data, and the naive implementation
+     can be used for the remaining portion. */
+  const int32_t vectorizable_bytes = blocksize - (blocksize % vectorized_chunk_size);
+  const int32_t vectorizable_elements = vectorizable_bytes / bytesoftype;
+  const int32_t total_elements = blocksize / bytesoftype;
+
+  /* If the block size is too small to be vectorized,
+     use the generic implementation. */
+  if (blocksize < vectorized_chunk_size) {
+    unshuffle_generic(bytesoftype, blocksize, _src, _dest);
+    return;
+  }
+
+  /* Optimized unshuffle implementations */
+  switch (bytesoftype) {
+    case 2:
+      unshuffle2_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      unshuffle4_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      unshuffle8_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      unshuffle16_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype > 16) {
+        unshuffle16_tiled_wasm(_dest, _src, vectorizable_elements, total_elements, bytesoftype);
+      }
+      else {
+        /* Optimized unshuffle for the rest of the type sizes smaller than 16 bytes */
+        const int32_t narrow_elements = unshuffle_narrow_typesize_wasm(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, total_elements), total_elements, bytesoftype);
+        unshuffle_generic_inline(bytesoftype, narrow_elements * bytesoftype, blocksize, _src, _dest);
+        return;
+      }
+  }
+
+  /* If the buffer had any bytes at the end which couldn't be handled
+     by the vectorized implementations, use the non-optimized version
+     to finish them up. */
+  if (vectorizable_bytes < blocksize) {
+    unshuffle_generic_inline(bytesoftype, vectorizable_bytes, blocksize, _src, _dest);
+  }
+}
+
+/* Shuffle the `nelems` elements of a tile into the byte planes of a block with
+   `total_elements` (`_dest` points to the first element of the tile in the
+   first plane).  This can never fail. */
+void
+shuffle_tile_wasm(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                  const uint8_t *_src, uint8_t *_dest) {
+  int32_t vectorizable_elements = nelems - nelems % 16;
+
+  switch (bytesoftype) {
+    case 2:
+      shuffle2_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      shuffle4_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      shuffle8_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      shuffle16_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype < 16) {
+        vectorizable_elements = shuffle_narrow_typesize_wasm(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, nelems), total_elements, bytesoftype);
+      }
+      else {
+        vectorizable_elements = 0;
+      }
+  }
+  shuffle_tile_generic_inline(bytesoftype, vectorizable_elements, nelems, total_elements, _src, _dest);
+}
+
+/* Unshuffle the `nelems` elements of a tile out of the byte planes of a block
+   with `total_elements` (`_src` points to the first element of the tile in the
+   first plane).  This can never fail. */
+void
+unshuffle_tile_wasm(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                    const uint8_t *_src, uint8_t *_dest) {
+  int32_t vectorizable_elements = nelems - nelems % 16;
+
+  switch (bytesoftype) {
+    case 2:
+      unshuffle2_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 4:
+      unshuffle4_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 8:
+      unshuffle8_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    case 16:
+      unshuffle16_wasm(_dest, _src, vectorizable_elements, total_elements);
+      break;
+    default:
+      if (bytesoftype < 16) {
+        vectorizable_elements = unshuffle_narrow_typesize_wasm(
+            _dest, _src, narrow_vectorizable_elements(bytesoftype, nelems), total_elements, bytesoftype);
+      }
+      else {
+        vectorizable_elements = 0;
+      }
+  }
+  unshuffle_tile_generic_inline(bytesoftype, vectorizable_elements, nelems, total_elements, _src, _dest);
+}
+
+#endif /* defined(__wasm_simd128__) */
@@ -0,0 +1,44 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* WebAssembly SIMD128-accelerated shuffle/unshuffle routines. */
+
+#ifndef BLOSC_SHUFFLE_WASM_H
+#define BLOSC_SHUFFLE_WASM_H
+
+#include "blosc2/blosc2-common.h"
+
+#include <stdint.h>
+
+/**
+  WebAssembly SIMD128-accelerated shuffle routine.
+*/
+BLOSC_NO_EXPORT void shuffle_wasm(const int32_t bytesoftype, const int32_t blocksize,
+                                  const uint8_t *_src, uint8_t *_dest);
+
+/**
+  WebAssembly SIMD128-accelerated unshuffle routine.
+*/
+BLOSC_NO_EXPORT void unshuffle_wasm(const int32_t bytesoftype, const int32_t blocksize,
+                                    const uint8_t *_src, uint8_t *_dest);
+
+/**
+  WebAssembly SIMD128-accelerated shuffle of a tile into the byte planes of a block.
+*/
+BLOSC_NO_EXPORT void shuffle_tile_wasm(const int32_t bytesoftype, const int32_t nelems,
+                                       const int32_t total_elements, const uint8_t *_src, uint8_t *_dest);
+
+/**
+  WebAssembly SIMD128-accelerated unshuffle of a tile out of the byte planes of a block.
+*/
+BLOSC_NO_EXPORT void unshuffle_tile_wasm(const int32_t bytesoftype, const int32_t nelems,
+                                         const int32_t total_elements, const uint8_t *_src, uint8_t *_dest);
+
+#endif /* BLOSC_SHUFFLE_WASM_H */
@@ -13,6 +13,11 @@
 /*  Include hardware-accelerated shuffle/unshuffle routines based on
     the target architecture. Note that a target architecture may support
     more than one type of acceleration!*/
+#if defined(SHUFFLE_USE_AVX512)
+  #include "shuffle-avx512.h"
+  #include "bitshuffle-avx512.h"
+#endif  /* defined(SHUFFLE_USE_AVX512) */
+
 #if defined(SHUFFLE_USE_AVX2)
   #include "shuffle-avx2.h"
   #include "bitshuffle-avx2.h"
@@ -34,11 +39,35 @@
   #include "bitshuffle-neon.h"
 #endif  /* defined(SHUFFLE_USE_NEON) */
 
+#if defined(SHUFFLE_USE_SVE)
+  #include "shuffle-sve.h"
+  #include "bitshuffle-sve.h"
+  /* Not in the headers of older C libraries */
+  #ifndef HWCAP_SVE
+    #define HWCAP_SVE (1 << 22)
+  #endif
+#endif  /* defined(SHUFFLE_USE_SVE) */
+
+#if defined(SHUFFLE_USE_RVV)
+  #if defined(__linux__)
+    #include <sys/auxv.h>
+  #endif
+  #include "shuffle-rvv.h"
+  #include "bitshuffle-rvv.h"
+  /* The single-letter extensions are reported as bits of AT_HWCAP */
+  #define BLOSC_HWCAP_RVV (1UL << ('V' - 'A'))
+#endif  /* defined(SHUFFLE_USE_RVV) */
+
 #if defined(SHUFFLE_USE_ALTIVEC)
   #include "shuffle-altivec.h"
   #include "bitshuffle-altivec.h"
 #endif  /* defined(SHUFFLE_USE_ALTIVEC) */
 
+#if defined(SHUFFLE_USE_WASM)
+  #include "shuffle-wasm.h"
+  #include "bitshuffle-wasm.h"
+#endif  /* defined(SHUFFLE_USE_WASM) */
+
 #include "shuffle-generic.h"
 #include "bitshuffle-generic.h"
 #include "blosc2/blosc2-common.h"
@@ -56,36 +85,6 @@
 #endif
 
 
-/*  Define function pointer types for shuffle/unshuffle routines. */
-typedef void(* shuffle_func)(const int32_t, const int32_t, const uint8_t*, const uint8_t*);
-typedef void(* unshuffle_func)(const int32_t, const int32_t, const uint8_t*, const uint8_t*);
-// For bitshuffle, everything is done in terms of size_t and int64_t (return value)
-// and although this is not strictly necessary for Blosc, it does not hurt either
-typedef int64_t(* bitshuffle_func)(void*, void*, const size_t, const size_t, void*);
-typedef int64_t(* bitunshuffle_func)(void*, void*, const size_t, const size_t, void*);
-
-/* An implementation of shuffle/unshuffle routines. */
-typedef struct shuffle_implementation {
-  /* Name of this implementation. */
-  const char* name;
-  /* Function pointer to the shuffle routine for this implementation. */
-  shuffle_func shuffle;
-  /* Function pointer to the unshuffle routine for this implementation. */
-  unshuffle_func unshuffle;
-  /* Function pointer to the bitshuffle routine for this implementation. */
-  bitshuffle_func bitshuffle;
-  /* Function pointer to the bitunshuffle routine for this implementation. */
-  bitunshuffle_func bitunshuffle;
-} shuffle_implementation_t;
-
-typedef enum {
-  BLOSC_HAVE_NOTHING = 0,
-  BLOSC_HAVE_SSE2 = 1,
-  BLOSC_HAVE_AVX2 = 2,
-  BLOSC_HAVE_NEON = 4,
-  BLOSC_HAVE_ALTIVEC = 8
-} blosc_cpu_features;
-
 /* Detect hardware and set function pointers to the best shuffle/unshuffle
    implementations supported by the host processor. */
 #if defined(SHUFFLE_USE_AVX2) || defined(SHUFFLE_USE_SSE2)    /* Intel/i686 */
@@ -97,7 +96,7 @@ typedef enum {
     https://lists.fedoraproject.org/archives/list/devel@lists.fedoraproject.org/thread/ZM2L65WIZEEQHHLFERZYD5FAG7QY2OGB/
 */
 #if defined(HAVE_CPU_FEAT_INTRIN) && 0
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
   blosc_cpu_features cpu_features = BLOSC_HAVE_NOTHING;
   if (__builtin_cpu_supports("sse2")) {
     cpu_features |= BLOSC_HAVE_SSE2;
@@ -171,7 +170,7 @@ _xgetbv(uint32_t xcr) {
 #define _XCR_XFEATURE_ENABLED_MASK 0x0
 #endif
 
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
   blosc_cpu_features result = BLOSC_HAVE_NOTHING;
   /* Holds the values of eax, ebx, ecx, edx set by the `cpuid` instruction */
   int32_t cpu_info[4];
@@ -187,16 +186,19 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
   const bool ssse3_available = (cpu_info[2] & (1 << 9)) != 0;
   const bool sse41_available = (cpu_info[2] & (1 << 19)) != 0;
   const bool sse42_available = (cpu_info[2] & (1 << 20)) != 0;
+  const bool f16c_available = (cpu_info[2] & (1 << 29)) != 0;
 
   const bool xsave_available = (cpu_info[2] & (1 << 26)) != 0;
   const bool xsave_enabled_by_os = (cpu_info[2] & (1 << 27)) != 0;
 
   /* Check for AVX-based features, if the processor supports extended features. */
   bool avx2_available = false;
+  bool avx512f_available = false;
   bool avx512bw_available = false;
   if (max_basic_function_id >= 7) {
     __cpuid(cpu_info, 7);
     avx2_available = (cpu_info[1] & (1 << 5)) != 0;
+    avx512f_available = (cpu_info[1] & (1 << 16)) != 0;
     avx512bw_available = (cpu_info[1] & (1 << 30)) != 0;
   }
 
@@ -206,13 +208,13 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
       extended control register XCR0 to see if the CPU features are enabled. */
   bool xmm_state_enabled = false;
   bool ymm_state_enabled = false;
-  //bool zmm_state_enabled = false;  // commented this out for avoiding an 'unused variable' warning
+  bool zmm_state_enabled = false;
 
 #if defined(_XCR_XFEATURE_ENABLED_MASK)
   if (xsave_available && xsave_enabled_by_os && (
       sse2_available || sse3_available || ssse3_available
       || sse41_available || sse42_available
-      || avx2_available || avx512bw_available)) {
+      || avx2_available || avx512f_available || avx512bw_available)) {
     /* Determine which register states can be restored by the OS. */
     uint64_t xcr0_contents = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
 
@@ -221,7 +223,7 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
 
     /*  Require support for both the upper 256-bits of zmm0-zmm15 to be
         restored as well as all of zmm16-zmm31 and the opmask registers. */
-    //zmm_state_enabled = (xcr0_contents & 0x70) == 0x70;
+    zmm_state_enabled = (xcr0_contents & 0xe0) == 0xe0;
   }
 #endif /* defined(_XCR_XFEATURE_ENABLED_MASK) */
 
@@ -233,12 +235,14 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
   printf("SSE4.1 available: %s\n", sse41_available ? "True" : "False");
   printf("SSE4.2 available: %s\n", sse42_available ? "True" : "False");
   printf("AVX2 available: %s\n", avx2_available ? "True" : "False");
+  printf("F16C available: %s\n", f16c_available ? "True" : "False");
+  printf("AVX512F available: %s\n", avx512f_available ? "True" : "False");
   printf("AVX512BW available: %s\n", avx512bw_available ? "True" : "False");
   printf("XSAVE available: %s\n", xsave_available ? "True" : "False");
   printf("XSAVE enabled: %s\n", xsave_enabled_by_os ? "True" : "False");
   printf("XMM state enabled: %s\n", xmm_state_enabled ? "True" : "False");
   printf("YMM state enabled: %s\n", ymm_state_enabled ? "True" : "False");
-  //printf("ZMM state enabled: %s\n", zmm_state_enabled ? "True" : "False");
+  printf("ZMM state enabled: %s\n", zmm_state_enabled ? "True" : "False");
 #endif /* defined(BLOSC_DUMP_CPU_INFO) */
 
   /* Using the gathered CPU information, determine which implementation to use. */
@@ -250,12 +254,19 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
   if (xmm_state_enabled && ymm_state_enabled && avx2_available) {
     result |= BLOSC_HAVE_AVX2;
   }
+  if (xmm_state_enabled && ymm_state_enabled && f16c_available) {
+    result |= BLOSC_HAVE_F16C;
+  }
+  if (xmm_state_enabled && ymm_state_enabled && zmm_state_enabled &&
+      avx2_available && avx512f_available && avx512bw_available) {
+    result |= BLOSC_HAVE_AVX512;
+  }
   return result;
 }
 #endif /* HAVE_CPU_FEAT_INTRIN */
 
 #elif defined(SHUFFLE_USE_NEON) /* ARM-NEON */
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
   blosc_cpu_features cpu_features = BLOSC_HAVE_NOTHING;
 #if defined(__aarch64__)
   /* aarch64 always has NEON */
@@ -264,15 +275,34 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
   if (getauxval(AT_HWCAP) & HWCAP_ARM_NEON) {
     cpu_features |= BLOSC_HAVE_NEON;
   }
+#endif
+#if defined(SHUFFLE_USE_SVE) && defined(__linux__)
+  if (getauxval(AT_HWCAP) & HWCAP_SVE) {
+    cpu_features |= BLOSC_HAVE_SVE;
+  }
 #endif
   return cpu_features;
 }
 #elif defined(SHUFFLE_USE_ALTIVEC) /* POWER9-ALTIVEC preliminary test*/
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
   blosc_cpu_features cpu_features = BLOSC_HAVE_NOTHING;
   cpu_features |= BLOSC_HAVE_ALTIVEC;
   return cpu_features;
 }
+#elif defined(SHUFFLE_USE_RVV) /* RISC-V Vector */
+blosc_cpu_features blosc_get_cpu_features(void) {
+  blosc_cpu_features cpu_features = BLOSC_HAVE_NOTHING;
+#if defined(__linux__)
+  if (getauxval(AT_HWCAP) & BLOSC_HWCAP_RVV) {
+    cpu_features |= BLOSC_HAVE_RVV;
+  }
+#endif
+  return cpu_features;
+}
+#elif defined(SHUFFLE_USE_WASM) /* WebAssembly SIMD128, chosen at build time */
+blosc_cpu_features blosc_get_cpu_features(void) {
+  return BLOSC_HAVE_WASM_SIMD;
+}
 #else   /* No hardware acceleration supported for the target architecture. */
   #if defined(_MSC_VER)
     #pragma message("Hardware-acceleration detection not implemented for the target architecture. Only the generic shuffle/unshuffle routines will be available.")
@@ -280,14 +310,31 @@ static blosc_cpu_features blosc_get_cpu_features(void) {
     #warning Hardware-acceleration detection not implemented for the target architecture. Only the generic shuffle/unshuffle routines will be available.
   #endif
 
-static blosc_cpu_features blosc_get_cpu_features(void) {
+blosc_cpu_features blosc_get_cpu_features(void) {
 return BLOSC_HAVE_NOTHING;
 }
 
 #endif /* defined(SHUFFLE_USE_AVX2) || defined(SHUFFLE_USE_SSE2) */
 
-static shuffle_implementation_t get_shuffle_implementation(void) {
+int shuffle_implementations(shuffle_implementation_t* impls, int maximpls) {
   blosc_cpu_features cpu_features = blosc_get_cpu_features();
+  int n = 0;
+#if defined(SHUFFLE_USE_AVX512)
+  if (cpu_features & BLOSC_HAVE_AVX512) {
+    shuffle_implementation_t impl_avx512;
+    impl_avx512.name = "avx512";
+    impl_avx512.shuffle = (shuffle_func)shuffle_avx512;
+    impl_avx512.unshuffle = (unshuffle_func)unshuffle_avx512;
+    impl_avx512.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_avx512;
+    impl_avx512.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_avx512;
+    impl_avx512.shuffle_tile = (shuffle_tile_func)shuffle_tile_avx2;
+    impl_avx512.unshuffle_tile = (unshuffle_tile_func)unshuffle_tile_avx2;
+    if (n < maximpls) {
+      impls[n++] = impl_avx512;
+    }
+  }
+#endif  /* defined(SHUFFLE_USE_AVX512) */
+
 #if defined(SHUFFLE_USE_AVX2)
   if (cpu_features & BLOSC_HAVE_AVX2) {
     shuffle_implementation_t impl_avx2;
@@ -296,7 +343,11 @@ static shuffle_implementation_t get_shuffle_implementation(void) {
     impl_avx2.unshuffle = (unshuffle_func)unshuffle_avx2;
     impl_avx2.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_avx2;
     impl_avx2.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_avx2;
-    return impl_avx2;
+    impl_avx2.shuffle_tile = (shuffle_tile_func)shuffle_tile_avx2;
+    impl_avx2.unshuffle_tile = (unshuffle_tile_func)unshuffle_tile_avx2;
+    if (n < maximpls) {
+      impls[n++] = impl_avx2;
+    }
   }
 #endif  /* defined(SHUFFLE_USE_AVX2) */
 
@@ -308,10 +359,30 @@ static shuffle_implementation_t get_shuffle_implementation(void) {
     impl_sse2.unshuffle = (unshuffle_func)unshuffle_sse2;
     impl_sse2.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_sse2;
     impl_sse2.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_sse2;
-    return impl_sse2;
+    impl_sse2.shuffle_tile = (shuffle_tile_func)shuffle_tile_sse2;
+    impl_sse2.unshuffle_tile = (unshuffle_tile_func)unshuffle_tile_sse2;
+    if (n < maximpls) {
+      impls[n++] = impl_sse2;
+    }
   }
 #endif  /* defined(SHUFFLE_USE_SSE2) */
 
+#if defined(SHUFFLE_USE_SVE)
+  if (cpu_features & BLOSC_HAVE_SVE) {
+    shuffle_implementation_t impl_sve;
+    impl_sve.name = "sve";
+    impl_sve.shuffle = (shuffle_func)shuffle_sve;
+    impl_sve.unshuffle = (unshuffle_func)unshuffle_sve;
+    impl_sve.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_sve;
+    impl_sve.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_sve;
+    impl_sve.shuffle_tile = NULL;
+    impl_sve.unshuffle_tile = NULL;
+    if (n < maximpls) {
+      impls[n++] = impl_sve;
+    }
+  }
+#endif  /* defined(SHUFFLE_USE_SVE) */
+
 #if defined(SHUFFLE_USE_NEON)
   if (cpu_features & BLOSC_HAVE_NEON) {
     shuffle_implementation_t impl_neon;
@@ -328,7 +399,11 @@ static shuffle_implementation_t get_shuffle_implementation(void) {
     // So, let's use the the scalar one, which is pretty fast, at least on a M1 CPU.
     impl_neon.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_scal;
     impl_neon.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_scal;
-    return impl_neon;
+    impl_neon.shuffle_tile = NULL;
+    impl_neon.unshuffle_tile = NULL;
+    if (n < maximpls) {
+      impls[n++] = impl_neon;
+    }
   }
 #endif  /* defined(SHUFFLE_USE_NEON) */
 
@@ -340,19 +415,68 @@ static shuffle_implementation_t get_shuffle_implementation(void) {
     impl_altivec.unshuffle = (unshuffle_func)unshuffle_altivec;
     impl_altivec.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_altivec;
     impl_altivec.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_altivec;
-    return impl_altivec;
+    impl_altivec.shuffle_tile = (shuffle_tile_func)shuffle_tile_altivec;
+    impl_altivec.unshuffle_tile = (unshuffle_tile_func)unshuffle_tile_altivec;
+    if (n < maximpls) {
+      impls[n++] = impl_altivec;
+    }
   }
 #endif  /* defined(SHUFFLE_USE_ALTIVEC) */
 
-  /* Processor doesn't support any of the hardware-accelerated implementations,
-     so use the generic implementation. */
+#if defined(SHUFFLE_USE_RVV)
+  if (cpu_features & BLOSC_HAVE_RVV) {
+    shuffle_implementation_t impl_rvv;
+    impl_rvv.name = "rvv";
+    impl_rvv.shuffle = (shuffle_func)shuffle_rvv;
+    impl_rvv.unshuffle = (unshuffle_func)unshuffle_rvv;
+    impl_rvv.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_rvv;
+    impl_rvv.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_rvv;
+    impl_rvv.shuffle_tile = NULL;
+    impl_rvv.unshuffle_tile = NULL;
+    if (n < maximpls) {
+      impls[n++] = impl_rvv;
+    }
+  }
+#endif  /* defined(SHUFFLE_USE_RVV) */
+
+#if defined(SHUFFLE_USE_WASM)
+  if (cpu_features & BLOSC_HAVE_WASM_SIMD) {
+    shuffle_implementation_t impl_wasm;
+    impl_wasm.name = "wasm";
+    impl_wasm.shuffle = (shuffle_func)shuffle_wasm;
+    impl_wasm.unshuffle = (unshuffle_func)unshuffle_wasm;
+    impl_wasm.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_wasm;
+    impl_wasm.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_wasm;
+    impl_wasm.shuffle_tile = (shuffle_tile_func)shuffle_tile_wasm;
+    impl_wasm.unshuffle_tile = (unshuffle_tile_func)unshuffle_tile_wasm;
+    if (n < maximpls) {
+      impls[n++] = impl_wasm;
+    }
+  }
+#endif  /* defined(SHUFFLE_USE_WASM) */
+
+  /* The generic implementation is always there, for the processors that do not
+     support any of the hardware-accelerated ones. */
   shuffle_implementation_t impl_generic;
   impl_generic.name = "generic";
   impl_generic.shuffle = (shuffle_func)shuffle_generic;
   impl_generic.unshuffle = (unshuffle_func)unshuffle_generic;
   impl_generic.bitshuffle = (bitshuffle_func)bshuf_trans_bit_elem_scal;
   impl_generic.bitunshuffle = (bitunshuffle_func)bshuf_untrans_bit_elem_scal;
-  return impl_generic;
+  impl_generic.shuffle_tile = NULL;
+  impl_generic.unshuffle_tile = NULL;
+  if (n < maximpls) {
+    impls[n++] = impl_generic;
+  }
+  return n;
+}
+
+/* Detect hardware and choose the best shuffle/unshuffle implementation
+   supported by the host processor. */
+static shuffle_implementation_t get_shuffle_implementation(void) {
+  shuffle_implementation_t impls[SHUFFLE_MAX_IMPLEMENTATIONS];
+  shuffle_implementations(impls, SHUFFLE_MAX_IMPLEMENTATIONS);
+  return impls[0];
 }
 
 
@@ -396,6 +520,17 @@ void init_shuffle_implementation(void) {
   }
 }
 
+/* 1 when the host has AVX2, 0 when not, and -1 when not looked for yet.  As for the
+   implementation above, a concurrent initialization gives the same answer on every thread. */
+static int32_t host_avx2 = -1;
+
+bool blosc_cpu_has_avx2(void) {
+  if (host_avx2 < 0) {
+    host_avx2 = (blosc_get_cpu_features() & BLOSC_HAVE_AVX2) != 0;
+  }
+  return host_avx2 != 0;
+}
+
 /* Shuffle a block by dynamically dispatching to the appropriate
    hardware-accelerated routine at run-time. */
 void
@@ -422,6 +557,34 @@ unshuffle(const int32_t bytesoftype, const int32_t blocksize,
   (host_implementation.unshuffle)(bytesoftype, blocksize, _src, _dest);
 }
 
+/* Whether there are accelerated routines for (un)shuffling tiles of this type size. */
+bool
+shuffle_tile_accelerated(const int32_t bytesoftype) {
+  init_shuffle_implementation();
+  if (host_implementation.shuffle_tile == NULL) {
+    return false;
+  }
+  return bytesoftype >= 2 && bytesoftype <= 16;
+}
+
+/* Shuffle a tile into the byte planes of a block by dynamically dispatching
+   to the appropriate hardware-accelerated routine at run-time. */
+void
+shuffle_tile(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+             const uint8_t* _src, uint8_t* _dest) {
+  init_shuffle_implementation();
+  (host_implementation.shuffle_tile)(bytesoftype, nelems, total_elements, _src, _dest);
+}
+
+/* Unshuffle a tile out of the byte planes of a block by dynamically dispatching
+   to the appropriate hardware-accelerated routine at run-time. */
+void
+unshuffle_tile(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+               const uint8_t* _src, uint8_t* _dest) {
+  init_shuffle_implementation();
+  (host_implementation.unshuffle_tile)(bytesoftype, nelems, total_elements, _src, _dest);
+}
+
 /*  Bit-shuffle a block by dynamically dispatching to the appropriate
     hardware-accelerated routine at run-time. */
 int32_t
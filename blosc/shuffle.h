@@ -21,6 +21,8 @@
 
 #include "blosc2/blosc2-common.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Toggle hardware-accelerated routines based on SHUFFLE_*_ENABLED macros
@@ -30,6 +32,12 @@
 #define SHUFFLE_USE_AVX2
 #endif
 
+/* The AVX512 routines are compiled on their own, and they fall back to the AVX2
+   ones for the cases they do not cover, so there is no need for __AVX512F__ here. */
+#if defined(SHUFFLE_AVX512_ENABLED) && defined(SHUFFLE_USE_AVX2)
+#define SHUFFLE_USE_AVX512
+#endif
+
 #if defined(SHUFFLE_SSE2_ENABLED) && defined(__SSE2__)
 #define SHUFFLE_USE_SSE2
 #endif
@@ -42,6 +50,92 @@
 #define SHUFFLE_USE_NEON
 #endif
 
+/* WebAssembly has no way to look for SIMD128 at run time (the modules using it just
+   do not load without it), so it is chosen at build time with -msimd128. */
+#if defined(SHUFFLE_WASM_ENABLED) && defined(__wasm_simd128__)
+#define SHUFFLE_USE_WASM
+#endif
+
+/* As for AVX512, the SVE and RVV routines are compiled on their own, and
+   their support is only checked at run time. */
+#if defined(SHUFFLE_SVE_ENABLED) && defined(SHUFFLE_USE_NEON) && defined(__aarch64__)
+#define SHUFFLE_USE_SVE
+#endif
+
+#if defined(SHUFFLE_RVV_ENABLED) && defined(__riscv)
+#define SHUFFLE_USE_RVV
+#endif
+
+/* The SIMD extensions of the host processor that the routines can use */
+typedef enum {
+  BLOSC_HAVE_NOTHING = 0,
+  BLOSC_HAVE_SSE2 = 1,
+  BLOSC_HAVE_AVX2 = 2,
+  BLOSC_HAVE_NEON = 4,
+  BLOSC_HAVE_ALTIVEC = 8,
+  BLOSC_HAVE_AVX512 = 16,
+  BLOSC_HAVE_SVE = 32,
+  BLOSC_HAVE_RVV = 64,
+  BLOSC_HAVE_F16C = 128,
+  BLOSC_HAVE_WASM_SIMD = 256
+} blosc_cpu_features;
+
+/**
+  Detect the SIMD extensions of the host processor (and the OS).  Only the
+  ones that the shuffle dispatch has been built for are looked for, and
+  BLOSC_HAVE_AVX512 stands for both AVX512F and AVX512BW (BLOSC_HAVE_F16C, for
+  the conversions of half floats, is looked for along with AVX2).  This is meant for
+  the other filters that dispatch at run time (e.g. bytedelta).
+*/
+BLOSC_NO_EXPORT blosc_cpu_features blosc_get_cpu_features(void);
+
+/**
+  Whether the host processor has AVX2, looked for once.  This is meant for the
+  translation units that are built a second time for AVX2 (see delta-avx2.c),
+  which hand the work over to that build.
+*/
+BLOSC_NO_EXPORT bool blosc_cpu_has_avx2(void);
+
+/*  Define function pointer types for shuffle/unshuffle routines. */
+typedef void(* shuffle_func)(const int32_t, const int32_t, const uint8_t*, const uint8_t*);
+typedef void(* unshuffle_func)(const int32_t, const int32_t, const uint8_t*, const uint8_t*);
+// For bitshuffle, everything is done in terms of size_t and int64_t (return value)
+// and although this is not strictly necessary for Blosc, it does not hurt either
+typedef int64_t(* bitshuffle_func)(void*, void*, const size_t, const size_t, void*);
+typedef int64_t(* bitunshuffle_func)(void*, void*, const size_t, const size_t, void*);
+typedef void(* shuffle_tile_func)(const int32_t, const int32_t, const int32_t, const uint8_t*, uint8_t*);
+typedef void(* unshuffle_tile_func)(const int32_t, const int32_t, const int32_t, const uint8_t*, uint8_t*);
+
+/* An implementation of shuffle/unshuffle routines. */
+typedef struct shuffle_implementation {
+  /* Name of this implementation. */
+  const char* name;
+  /* Function pointer to the shuffle routine for this implementation. */
+  shuffle_func shuffle;
+  /* Function pointer to the unshuffle routine for this implementation. */
+  unshuffle_func unshuffle;
+  /* Function pointer to the bitshuffle routine for this implementation. */
+  bitshuffle_func bitshuffle;
+  /* Function pointer to the bitunshuffle routine for this implementation. */
+  bitunshuffle_func bitunshuffle;
+  /* Function pointers to the routines for (un)shuffling tiles (NULL when not accelerated). */
+  shuffle_tile_func shuffle_tile;
+  unshuffle_tile_func unshuffle_tile;
+} shuffle_implementation_t;
+
+/* Enough room for every implementation (the generic one included) */
+#define SHUFFLE_MAX_IMPLEMENTATIONS 8
+
+/**
+  Get the implementations that have been built in and that the host processor
+  supports, from the preferred one (the one that the routines below dispatch
+  to) to the generic one, which is always the last.  Returns the number of
+  implementations, which are at most maximpls.  This is meant for the tests
+  and the benchmarks of the accelerated routines.
+*/
+BLOSC_NO_EXPORT int
+    shuffle_implementations(shuffle_implementation_t* impls, int maximpls);
+
 /**
   Primary shuffle and bitshuffle routines.
   This function dynamically dispatches to the appropriate hardware-accelerated
@@ -81,4 +175,29 @@ BLOSC_NO_EXPORT int32_t
                  const uint8_t *_src, const uint8_t *_dest,
                  const uint8_t *_tmp, const uint8_t format_version);
 
+/**
+  Routines for fusing an element-wise filter with the shuffle.
+
+  The filter is applied to a tile of SHUFFLE_TILE_SIZE bytes (which stays in
+  L1), and the tile is then shuffled straight into the byte planes of the
+  block, so that the block is traversed once instead of twice.  The tiles are
+  only accelerated for some type sizes (and processors); otherwise, the filter
+  and the shuffle should be run as separate passes.
+*/
+#define SHUFFLE_TILE_SIZE 4096
+
+/* The number of elements in a tile (a multiple of the vector sizes) */
+#define SHUFFLE_TILE_ELEMENTS(typesize) ((SHUFFLE_TILE_SIZE / (typesize)) & ~31)
+
+BLOSC_NO_EXPORT bool
+    shuffle_tile_accelerated(const int32_t bytesoftype);
+
+BLOSC_NO_EXPORT void
+    shuffle_tile(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                 const uint8_t* _src, uint8_t* _dest);
+
+BLOSC_NO_EXPORT void
+    unshuffle_tile(const int32_t bytesoftype, const int32_t nelems, const int32_t total_elements,
+                   const uint8_t* _src, uint8_t* _dest);
+
 #endif /* BLOSC_SHUFFLE_H */
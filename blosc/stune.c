@@ -9,9 +9,70 @@
 **********************************************************************/
 
 #include "stune.h"
+#include "blosc-private.h"
 
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+  #include <windows.h>
+#elif defined(__APPLE__)
+  #include <sys/sysctl.h>
+  #include <sys/types.h>
+#else
+  #include <unistd.h>
+#endif
+
+/* The samples for estimating the compressibility of a chunk */
+#define STUNE_SAMPLE_SIZE 1024
+#define STUNE_MAX_SAMPLES 16
+#define STUNE_MAX_LANES 16
+#define STUNE_HASH_LOG 10
+#define STUNE_MIN_MATCH 4
+/* The samples for estimating the entropy of a block */
+#define STUNE_BLOCK_SAMPLE_SIZE 256
+#define STUNE_BLOCK_SAMPLES 4
+
+
+/* The parameters that the adaptive tuning chooses among (one dimension each) */
+enum {
+  STUNE_CODEC,
+  STUNE_FILTER,
+  STUNE_SPLIT,
+  STUNE_CLEVEL,
+  STUNE_NDIMS,
+};
+
+#define STUNE_MAX_CANDIDATES 8
+
+typedef struct {
+  int values[STUNE_NDIMS];
+} stune_params;
+
+/* The state of the adaptive tuning, which lives in the tuner_params of the context */
+typedef struct {
+  blosc2_stune_config config;
+  int32_t blocksize;  // the blocksize asked by the user
+  int candidates[STUNE_NDIMS][STUNE_MAX_CANDIDATES];
+  int ncandidates[STUNE_NDIMS];
+  stune_params best;
+  double best_score;
+  stune_params trial;
+  int dim;  // the dimension of the trial
+  int cand;  // the candidate of the trial within its dimension (-1 for the initial params)
+  int nchunks;  // the chunks used for trying so far
+  bool skipped;  // whether the current chunk is stored as is
+  bool done;
+  bool dirty;  // whether there is something new to serialize
+  bool warm;  // whether the trials start from the params recorded in the super-chunk
+} stune_state;
+
+/* The version and size of the serialized state */
+#define STUNE_STATE_VERSION 1
+#define STUNE_STATE_SIZE (1 + 3 * 4 + 8 + 2 * STUNE_NDIMS * 4 + 8 + 3 * 4 + 1)
 
 
 /* Whether a codec is meant for High Compression Ratios
@@ -34,11 +95,215 @@ static bool is_HCR(blosc2_context * context) {
   }
 }
 
+static blosc_cpu_info g_cpu_info = {0};
+
+#if defined(_WIN32)
+
+static void detect_caches(blosc_cpu_info *info) {
+  DWORD size = 0;
+  GetLogicalProcessorInformation(NULL, &size);
+  SYSTEM_LOGICAL_PROCESSOR_INFORMATION *buffer = malloc(size);
+  if (buffer == NULL || !GetLogicalProcessorInformation(buffer, &size)) {
+    free(buffer);
+    return;
+  }
+  for (DWORD i = 0; i < size / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION); i++) {
+    if (buffer[i].Relationship == RelationProcessorCore) {
+      info->ncores++;
+    }
+    if (buffer[i].Relationship != RelationCache) {
+      continue;
+    }
+    CACHE_DESCRIPTOR *cache = &buffer[i].Cache;
+    int32_t cache_size = (int32_t)cache->Size;
+    // The caches shared by several cores are split among them
+    int nshared = 0;
+    for (ULONG_PTR mask = buffer[i].ProcessorMask; mask != 0; mask >>= 1) {
+      nshared += (int)(mask & 1);
+    }
+    if (cache->Level == 1 && cache->Type == CacheData) {
+      info->l1d = cache_size;
+    }
+    else if (cache->Level == 2) {
+      info->l2 = cache_size;
+    }
+    else if (cache->Level == 3) {
+      info->l3 = nshared > 0 ? cache_size / nshared : cache_size;
+    }
+  }
+  free(buffer);
+}
+
+#elif defined(__APPLE__)
+
+static int32_t sysctl_size(const char *name) {
+  int64_t value = 0;
+  size_t len = sizeof(value);
+  if (sysctlbyname(name, &value, &len, NULL, 0) != 0) {
+    return 0;
+  }
+  return value > INT32_MAX ? INT32_MAX : (int32_t)value;
+}
+
+static void detect_caches(blosc_cpu_info *info) {
+  info->l1d = sysctl_size("hw.l1dcachesize");
+  info->l2 = sysctl_size("hw.l2cachesize");
+  info->l3 = sysctl_size("hw.l3cachesize");
+  info->ncores = (int)sysctl_size("hw.physicalcpu");
+  if (info->l3 > 0 && info->ncores > 0) {
+    info->l3 /= info->ncores;
+  }
+}
+
+#else
+
+static bool read_sysfs(const char *dir, const char *name, char *value, int len) {
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return false;
+  }
+  bool ok = fgets(value, len, file) != NULL;
+  fclose(file);
+  return ok;
+}
+
+/* The number of cpus in a list like "0-3,8-11" */
+static int count_cpus(const char *list) {
+  int count = 0;
+  while (*list != '\0' && *list != '\n') {
+    char *end;
+    long first = strtol(list, &end, 10);
+    long last = first;
+    if (end == list) {
+      break;
+    }
+    if (*end == '-') {
+      list = end + 1;
+      last = strtol(list, &end, 10);
+    }
+    count += (int)(last - first + 1);
+    list = (*end == ',') ? end + 1 : end;
+  }
+  return count;
+}
+
+static void detect_caches(blosc_cpu_info *info) {
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+  info->ncores = ncpus > 0 ? (int)ncpus : 0;
+  for (int index = 0; index < 8; index++) {
+    char dir[128], level[16], type[32], size[32], shared[256];
+    snprintf(dir, sizeof(dir), "/sys/devices/system/cpu/cpu0/cache/index%d", index);
+    if (!read_sysfs(dir, "level", level, sizeof(level)) || !read_sysfs(dir, "type", type, sizeof(type)) ||
+        !read_sysfs(dir, "size", size, sizeof(size))) {
+      break;
+    }
+    char unit = 'K';
+    long cache_size = 0;
+    if (sscanf(size, "%ld%c", &cache_size, &unit) < 1) {
+      continue;
+    }
+    cache_size *= (unit == 'M') ? 1024 * 1024 : (unit == 'K') ? 1024 : 1;
+    if (cache_size > INT32_MAX) {
+      cache_size = INT32_MAX;
+    }
+    int nshared = read_sysfs(dir, "shared_cpu_list", shared, sizeof(shared)) ? count_cpus(shared) : 1;
+    if (strncmp(level, "1", 1) == 0 && strncmp(type, "Data", 4) == 0) {
+      info->l1d = (int32_t)cache_size;
+    }
+    else if (strncmp(level, "2", 1) == 0) {
+      info->l2 = (int32_t)cache_size;
+    }
+    else if (strncmp(level, "3", 1) == 0) {
+      info->l3 = (int32_t)(nshared > 1 ? cache_size / nshared : cache_size);
+    }
+  }
+}
+
+#endif
+
+void blosc_stune_detect_cpu(void) {
+  blosc_cpu_info info = {0};
+  detect_caches(&info);
+  g_cpu_info = info;
+  BLOSC_INFO("L1d: %d, L2: %d, L3 (per core): %d, cores: %d",
+             info.l1d, info.l2, info.l3, info.ncores);
+}
+
+const blosc_cpu_info* blosc_stune_cpu_info(void) {
+  return &g_cpu_info;
+}
+
+/* Whether the shuffle in the last filter slot can be chosen by the adaptive tuning */
+static bool tunable_filter(uint8_t filter) {
+  return filter == BLOSC_NOSHUFFLE || filter == BLOSC_SHUFFLE || filter == BLOSC_BITSHUFFLE;
+}
+
+static void add_candidate(stune_state *state, int dim, int value) {
+  state->candidates[dim][state->ncandidates[dim]++] = value;
+}
+
+/* A new adaptive tuning, which starts with the params of the context */
+static stune_state* new_state(blosc2_context* cctx, const blosc2_stune_config *config) {
+  stune_state *state = ctx_malloc(cctx, sizeof(stune_state));
+  if (state == NULL) {
+    return NULL;
+  }
+  memset(state, 0, sizeof(stune_state));
+  state->config = *config;
+  state->blocksize = cctx->blocksize;
+
+  const char *compname;
+  const int codecs[] = {BLOSC_BLOSCLZ, BLOSC_LZ4, BLOSC_LZ4HC, BLOSC_ZLIB, BLOSC_ZSTD};
+  for (int i = 0; i < (int)(sizeof(codecs) / sizeof(codecs[0])); i++) {
+    if (blosc2_compcode_to_compname(codecs[i], &compname) >= 0) {
+      add_candidate(state, STUNE_CODEC, codecs[i]);
+    }
+  }
+  uint8_t filter = cctx->filters[BLOSC2_MAX_FILTERS - 1];
+  if (tunable_filter(filter)) {
+    add_candidate(state, STUNE_FILTER, BLOSC_NOSHUFFLE);
+    add_candidate(state, STUNE_FILTER, BLOSC_SHUFFLE);
+    add_candidate(state, STUNE_FILTER, BLOSC_BITSHUFFLE);
+  }
+  add_candidate(state, STUNE_SPLIT, BLOSC_ALWAYS_SPLIT);
+  add_candidate(state, STUNE_SPLIT, BLOSC_NEVER_SPLIT);
+  for (int clevel = 1; clevel <= 9; clevel += 2) {
+    add_candidate(state, STUNE_CLEVEL, clevel);
+  }
+
+  state->best.values[STUNE_CODEC] = cctx->compcode;
+  state->best.values[STUNE_FILTER] = filter;
+  state->best.values[STUNE_SPLIT] = cctx->splitmode;
+  state->best.values[STUNE_CLEVEL] = cctx->clevel;
+  state->trial = state->best;
+  state->cand = -1;
+
+  return state;
+}
+
+/* Set up the adaptive tuning when a blosc2_stune_config is passed (the tuning
+   just chooses the blocksize otherwise) */
 int blosc_stune_init(void * config, blosc2_context* cctx, blosc2_context* dctx) {
-  BLOSC_UNUSED_PARAM(config);
-  BLOSC_UNUSED_PARAM(cctx);
   BLOSC_UNUSED_PARAM(dctx);
 
+  if (config == NULL || cctx == NULL) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  blosc2_stune_config *stune_config = (blosc2_stune_config *)config;
+  if (stune_config->objective < BLOSC_STUNE_CRATIO || stune_config->objective > BLOSC_STUNE_BALANCED) {
+    BLOSC_TRACE_ERROR("Unknown objective %d for the tuning.", stune_config->objective);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  if (stune_config->min_speed < 0 || stune_config->nchunks < 0) {
+    BLOSC_TRACE_ERROR("The minimum speed and the number of chunks for the tuning cannot be negative.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  stune_state *state = new_state(cctx, stune_config);
+  BLOSC_ERROR_NULL(state, BLOSC2_ERROR_MEMORY_ALLOC);
+  cctx->tuner_params = state;
   return BLOSC2_ERROR_SUCCESS;
 }
 
@@ -49,6 +314,7 @@ int blosc_stune_next_blocksize(blosc2_context *context) {
   int32_t nbytes = context->sourcesize;
   int32_t user_blocksize = context->blocksize;
   int32_t blocksize = nbytes;
+  const blosc_cpu_info *cpu = blosc_stune_cpu_info();
 
   // Protection against very small buffers
   if (nbytes < typesize) {
@@ -135,9 +401,10 @@ int blosc_stune_next_blocksize(blosc2_context *context) {
     }
     // Multiply by typesize to get proper split sizes
     blocksize *= typesize;
-    // But do not exceed 4 MB per thread (having this capacity in L3 is normal in modern CPUs)
-    if (blocksize > 4 * 1024 * 1024) {
-      blocksize = 4 * 1024 * 1024;
+    // But do not exceed the share of L3 per thread (4 MB is normal in modern CPUs)
+    int32_t l3 = cpu->l3 > 0 ? cpu->l3 : 4 * 1024 * 1024;
+    if (blocksize > l3) {
+      blocksize = l3;
     }
     if (blocksize < 32 * 1024) {
       /* Do not use a too small blocksize (< 32 KB) when typesize is small */
@@ -145,6 +412,33 @@ int blosc_stune_next_blocksize(blosc2_context *context) {
     }
   }
 
+  /* The working set of a thread for a block should fit in its L2 (HCR codecs are
+     rather bound by their own speed, and they need large blocks) */
+  if (cpu->l2 > 0 && !is_HCR(context)) {
+    int32_t max_blocksize = cpu->l2 / STUNE_THREAD_BUFFERS;
+    if (max_blocksize < L1) {
+      max_blocksize = L1;
+    }
+    if (blocksize > max_blocksize) {
+      blocksize = max_blocksize;
+    }
+  }
+
+  /* Small chunks still get a block for every thread (unless the threads take the
+     streams of split blocks, which are enough for them, or the chunk is too small for
+     the threads and is (de-)compressed serially anyway) */
+  int16_t nthreads = context->new_nthreads;
+  bool split_streams = context->scheduler == BLOSC_STREAMS_SCHED && splitmode && typesize > 1;
+  if (nbytes / blocksize < nthreads && !split_streams && parallel_pays_off(nbytes, nthreads)) {
+    int32_t thread_blocksize = (nbytes + nthreads - 1) / nthreads;
+    if (thread_blocksize < STUNE_MIN_THREAD_BLOCKSIZE) {
+      thread_blocksize = STUNE_MIN_THREAD_BLOCKSIZE;
+    }
+    if (thread_blocksize < blocksize) {
+      blocksize = thread_blocksize;
+    }
+  }
+
   last:
   /* Check that blocksize is not too large */
   if (blocksize > nbytes) {
@@ -163,22 +457,444 @@ int blosc_stune_next_blocksize(blosc2_context *context) {
   return BLOSC2_ERROR_SUCCESS;
 }
 
-int blosc_stune_next_cparams(blosc2_context * context) {
-  BLOSC_UNUSED_PARAM(context);
+/* The entropy in bits per byte of a histogram, with the Miller-Madow correction for
+   the bias of the small samples */
+static double histogram_entropy(const uint32_t *histogram, uint32_t total) {
+  if (total == 0) {
+    return 0;
+  }
+  double entropy = 0;
+  int nbins = 0;
+  for (int i = 0; i < 256; i++) {
+    if (histogram[i] > 0) {
+      double p = (double)histogram[i] / total;
+      entropy -= p * log2(p);
+      nbins++;
+    }
+  }
+  entropy += (nbins - 1) / (2. * total * log(2.));
+  return entropy > 8 ? 8 : entropy;
+}
+
+double stune_sampled_entropy(const uint8_t *src, int32_t size) {
+  uint32_t histogram[256] = {0};
+  int32_t sample_size = STUNE_BLOCK_SAMPLE_SIZE;
+  int32_t nsamples = STUNE_BLOCK_SAMPLES;
+  if (size < nsamples * sample_size) {
+    nsamples = 1;
+    sample_size = size;
+  }
+  int32_t stride = nsamples > 1 ? (size - sample_size) / (nsamples - 1) : 0;
+  for (int i = 0; i < nsamples; i++) {
+    const uint8_t *sample = src + (int64_t)i * stride;
+    for (int32_t j = 0; j < sample_size; j++) {
+      histogram[sample[j]]++;
+    }
+  }
+  return histogram_entropy(histogram, (uint32_t)(nsamples * sample_size));
+}
+
+int32_t stune_detect_stride(const uint8_t *src, int32_t size) {
+  int32_t sample_size = STUNE_SAMPLE_SIZE;
+  int32_t nsamples = size / sample_size;
+  if (nsamples > STUNE_MAX_SAMPLES) {
+    nsamples = STUNE_MAX_SAMPLES;
+  }
+  if (nsamples == 0) {
+    nsamples = 1;
+    sample_size = size;
+  }
+  int64_t stride = nsamples > 1 ? (size - sample_size) / (nsamples - 1) : 0;
+  uint32_t total = (uint32_t)(nsamples * sample_size);
+  if (total < 2 * STUNE_MAX_LANES) {
+    return 0;
+  }
+
+  // The entropy of the bytes in the lanes of every candidate stride (the stride 1 is the plain one)
+  double entropies[STUNE_MAX_LANES + 1];
+  uint32_t lane_histograms[STUNE_MAX_LANES][256];
+  uint32_t lane_totals[STUNE_MAX_LANES];
+  for (int32_t nlanes = 1; nlanes <= STUNE_MAX_LANES; nlanes++) {
+    memset(lane_histograms, 0, nlanes * sizeof(lane_histograms[0]));
+    memset(lane_totals, 0, sizeof(lane_totals));
+    for (int i = 0; i < nsamples; i++) {
+      int64_t start = i * stride;
+      const uint8_t *sample = src + start;
+      int32_t lane = (int32_t)(start % nlanes);
+      for (int32_t j = 0; j < sample_size; j++) {
+        lane_histograms[lane][sample[j]]++;
+        lane_totals[lane]++;
+        if (++lane == nlanes) {
+          lane = 0;
+        }
+      }
+    }
+    entropies[nlanes] = 0;
+    for (int32_t lane = 0; lane < nlanes; lane++) {
+      entropies[nlanes] += histogram_entropy(lane_histograms[lane], lane_totals[lane]) * lane_totals[lane] / total;
+    }
+  }
+
+  int32_t best = 1;
+  for (int32_t nlanes = 2; nlanes <= STUNE_MAX_LANES; nlanes++) {
+    if (entropies[nlanes] < entropies[best]) {
+      best = nlanes;
+    }
+  }
+  // As with blosc2_sample_chunk(), the shuffle has to pay off
+  if (entropies[best] > entropies[1] - 0.5) {
+    return 0;
+  }
+  // The multiples of the size of the items look as good as it, so keep the smallest stride that is close
+  for (int32_t nlanes = 2; nlanes < best; nlanes++) {
+    if (best % nlanes == 0 && entropies[nlanes] < entropies[best] + 0.1) {
+      return nlanes;
+    }
+  }
+  return best;
+}
+
+static uint32_t hash4(const uint8_t *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return (value * 2654435761U) >> (32 - STUNE_HASH_LOG);
+}
+
+/* The number of bytes of a sample that a greedy LZ parse covers with matches */
+static int32_t matched_bytes(const uint8_t *sample, int32_t size) {
+  uint16_t table[1 << STUNE_HASH_LOG];
+  memset(table, 0xff, sizeof(table));
+  int32_t matched = 0;
+  int32_t i = 0;
+  while (i + STUNE_MIN_MATCH <= size) {
+    uint32_t h = hash4(sample + i);
+    int32_t ref = table[h];
+    table[h] = (uint16_t)i;
+    if (ref != 0xffff && memcmp(sample + ref, sample + i, STUNE_MIN_MATCH) == 0) {
+      int32_t len = STUNE_MIN_MATCH;
+      while (i + len < size && sample[ref + len] == sample[i + len]) {
+        len++;
+      }
+      matched += len;
+      i += len;
+    }
+    else {
+      i++;
+    }
+  }
+  return matched;
+}
+
+int blosc2_sample_chunk(blosc2_context *cctx, blosc2_sample_stats *stats) {
+  BLOSC_ERROR_NULL(cctx, BLOSC2_ERROR_NULL_POINTER);
+  BLOSC_ERROR_NULL(stats, BLOSC2_ERROR_NULL_POINTER);
+  if (cctx->do_compress != 1 || cctx->src == NULL) {
+    BLOSC_TRACE_ERROR("The context has no source to sample.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  int32_t typesize = cctx->typesize;
+  int32_t nlanes = (typesize > 1 && typesize <= STUNE_MAX_LANES) ? typesize : 1;
+  int32_t sample_size = STUNE_SAMPLE_SIZE / nlanes * nlanes;
+  int32_t nsamples = cctx->sourcesize / sample_size;
+  if (nsamples > STUNE_MAX_SAMPLES) {
+    nsamples = STUNE_MAX_SAMPLES;
+  }
+  if (nsamples == 0) {
+    // Too small for sampling
+    nsamples = 1;
+    sample_size = cctx->sourcesize;
+  }
+
+  uint32_t histogram[256] = {0};
+  uint32_t lane_histograms[STUNE_MAX_LANES][256] = {{0}};
+  int64_t total = 0;
+  int64_t matched = 0;
+  // The samples are evenly spread, and start at an item boundary
+  int64_t stride = nsamples > 1 ? (cctx->sourcesize - sample_size) / (nsamples - 1) : 0;
+  stride = stride / nlanes * nlanes;
+  for (int i = 0; i < nsamples; i++) {
+    const uint8_t *sample = cctx->src + i * stride;
+    for (int32_t j = 0; j < sample_size; j++) {
+      histogram[sample[j]]++;
+      lane_histograms[j % nlanes][sample[j]]++;
+    }
+    matched += matched_bytes(sample, sample_size);
+    total += sample_size;
+  }
+
+  stats->entropy = histogram_entropy(histogram, (uint32_t)total);
+  stats->shuffled_entropy = 0;
+  for (int lane = 0; lane < nlanes; lane++) {
+    stats->shuffled_entropy += histogram_entropy(lane_histograms[lane], (uint32_t)(total / nlanes)) / nlanes;
+  }
+  stats->match_ratio = total > 0 ? (double)matched / (double)total : 0;
+
+  // Random looking bytes, no matter how they are shuffled
+  stats->incompressible = stats->entropy > 7.9 && stats->shuffled_entropy > 7.9 && stats->match_ratio < 0.01;
+  // The shuffle pays off when the bytes of the items are more predictable on their own
+  stats->filter = (nlanes > 1 && stats->shuffled_entropy < stats->entropy - 0.5) ? BLOSC_SHUFFLE : BLOSC_NOSHUFFLE;
+  // Long matches are well handled by fast codecs, and skewed bytes by entropy coders
+  const char *compname;
+  if (stats->match_ratio > 0.5 || blosc2_compcode_to_compname(BLOSC_ZSTD, &compname) < 0) {
+    stats->compcode = BLOSC_LZ4;
+  }
+  else {
+    stats->compcode = BLOSC_ZSTD;
+  }
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
+
+/* The higher, the better */
+static double score(blosc2_stune_config *config, double cratio, double speed) {
+  switch (config->objective) {
+    case BLOSC_STUNE_SPEED:
+      return speed;
+    case BLOSC_STUNE_BALANCED:
+      return cratio * speed;
+    default:
+      if (speed < config->min_speed) {
+        // Below any candidate that is fast enough
+        return speed / config->min_speed - 1;
+      }
+      return cratio;
+  }
+}
+
+/* Start the trials from the best params recorded for the chunks of the super-chunk
+   (see blosc2_schunk_get_recorded_stats()).  Returns whether there were any. */
+static bool warm_start(blosc2_context *context, stune_state *state) {
+  blosc2_schunk *schunk = context->schunk;
+  if (schunk == NULL || blosc2_vlmeta_exists(schunk, STATS_VLMETA) < 0) {
+    return false;
+  }
+  blosc2_chunk_stats *chunks;
+  int64_t nchunks = blosc2_schunk_get_recorded_stats(schunk, &chunks, NULL);
+  if (nchunks <= 0) {
+    return false;
+  }
+  const char *compname;
+  const blosc2_chunk_stats *best = NULL;
+  double best_score = 0;
+  for (int64_t i = 0; i < nchunks; i++) {
+    const blosc2_chunk_stats *chunk = &chunks[i];
+    // Special and skipped chunks say nothing about the params
+    if (chunk->nblocks == 0 || chunk->clevel == 0 || chunk->cbytes <= 0 ||
+        blosc2_compcode_to_compname(chunk->compcode, &compname) < 0) {
+      continue;
+    }
+    double cratio = (double)chunk->nbytes / chunk->cbytes;
+    double speed = (double)chunk->nbytes / (chunk->ctime > 0 ? chunk->ctime : 1e-9) / 1e9;
+    double chunk_score = score(&state->config, cratio, speed);
+    if (best == NULL || chunk_score > best_score) {
+      best = chunk;
+      best_score = chunk_score;
+    }
+  }
+  if (best != NULL) {
+    state->best.values[STUNE_CODEC] = best->compcode;
+    state->best.values[STUNE_CLEVEL] = best->clevel;
+    state->best.values[STUNE_SPLIT] = best->splitmode;
+    uint8_t filter = best->filters[BLOSC2_MAX_FILTERS - 1];
+    if (state->ncandidates[STUNE_FILTER] > 0 && tunable_filter(filter)) {
+      state->best.values[STUNE_FILTER] = filter;
+    }
+    state->trial = state->best;
+    state->warm = true;
+    BLOSC_INFO("Tuning starts from the recorded stats: compcode: %d, clevel: %d, filter: %d, splitmode: %d",
+               state->best.values[STUNE_CODEC], state->best.values[STUNE_CLEVEL],
+               state->best.values[STUNE_FILTER], state->best.values[STUNE_SPLIT]);
+  }
+  free(chunks);
+  return best != NULL;
+}
+
+int blosc_stune_next_cparams(blosc2_context * context) {
+  stune_state *state = (stune_state *)context->tuner_params;
+  blosc2_sample_stats stats;
+  int rc = blosc2_sample_chunk(context, &stats);
+  if (rc < 0) {
+    return rc;
+  }
+  if (!state->done && state->cand < 0 && state->nchunks == 0 && !state->warm &&
+      !warm_start(context, state)) {
+    // Start the trials from the predicted params
+    state->best.values[STUNE_CODEC] = stats.compcode;
+    if (state->ncandidates[STUNE_FILTER] > 0) {
+      state->best.values[STUNE_FILTER] = stats.filter;
+    }
+    state->trial = state->best;
+  }
+  stune_params *params = state->done ? &state->best : &state->trial;
+
+  context->compcode = params->values[STUNE_CODEC];
+  // Do not spend any codec time on the chunks that would be stored as is anyway
+  state->skipped = stats.incompressible;
+  context->clevel = state->skipped ? 0 : params->values[STUNE_CLEVEL];
+  context->splitmode = params->values[STUNE_SPLIT];
+  if (state->ncandidates[STUNE_FILTER] > 0) {
+    context->filters[BLOSC2_MAX_FILTERS - 1] = (uint8_t)params->values[STUNE_FILTER];
+  }
+  // The best blocksize depends on the rest of params
+  context->blocksize = state->blocksize;
+  return blosc_stune_next_blocksize(context);
+}
+
+/* Move to the next candidate that differs from the best params, if any */
+static bool next_trial(stune_state *state) {
+  for (; state->dim < STUNE_NDIMS; state->dim++, state->cand = -1) {
+    while (++state->cand < state->ncandidates[state->dim]) {
+      int value = state->candidates[state->dim][state->cand];
+      if (value != state->best.values[state->dim]) {
+        state->trial = state->best;
+        state->trial.values[state->dim] = value;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
 int blosc_stune_update(blosc2_context * context, double ctime) {
-  BLOSC_UNUSED_PARAM(context);
-  BLOSC_UNUSED_PARAM(ctime);
+  stune_state *state = (stune_state *)context->tuner_params;
+  if (state->done) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // Special and skipped chunks say nothing about the params
+  if (state->skipped || ((context->dest[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK)) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  double cratio = (double)context->sourcesize / context->destsize;
+  double speed = (double)context->sourcesize / (ctime > 0 ? ctime : 1e-9) / 1e9;
+  double chunk_score = score(&state->config, cratio, speed);
+  if (state->cand < 0 || chunk_score > state->best_score) {
+    state->best = state->trial;
+    state->best_score = chunk_score;
+  }
+  state->nchunks++;
+  state->dirty = true;
+
+  if (!next_trial(state) || (state->config.nchunks > 0 && state->nchunks >= state->config.nchunks)) {
+    state->done = true;
+    BLOSC_INFO("Tuning done after %d chunks: compcode: %d, clevel: %d, filter: %d, splitmode: %d",
+               state->nchunks, state->best.values[STUNE_CODEC], state->best.values[STUNE_CLEVEL],
+               state->best.values[STUNE_FILTER], state->best.values[STUNE_SPLIT]);
+  }
 
   return BLOSC2_ERROR_SUCCESS;
 }
 
 int blosc_stune_free(blosc2_context * context) {
-  BLOSC_UNUSED_PARAM(context);
+  ctx_free(context, context->tuner_params);
+  context->tuner_params = NULL;
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+static uint8_t* put_int32(uint8_t *p, int32_t value) {
+  to_big(p, &value, sizeof(value));
+  return p + sizeof(value);
+}
 
+static uint8_t* put_double(uint8_t *p, double value) {
+  to_big(p, &value, sizeof(value));
+  return p + sizeof(value);
+}
+
+static const uint8_t* get_int32(const uint8_t *p, int32_t *value) {
+  from_big(value, p, sizeof(*value));
+  return p + sizeof(*value);
+}
+
+static const uint8_t* get_double(const uint8_t *p, double *value) {
+  from_big(value, p, sizeof(*value));
+  return p + sizeof(*value);
+}
+
+int blosc_stune_serialize(blosc2_context * context, uint8_t **content, int32_t *content_len) {
+  stune_state *state = (stune_state *)context->tuner_params;
+  if (state == NULL || !state->dirty) {
+    return 0;
+  }
+  uint8_t *p = malloc(STUNE_STATE_SIZE);
+  BLOSC_ERROR_NULL(p, BLOSC2_ERROR_MEMORY_ALLOC);
+  *content = p;
+  *content_len = STUNE_STATE_SIZE;
+
+  *p++ = STUNE_STATE_VERSION;
+  p = put_int32(p, state->config.objective);
+  p = put_double(p, state->config.min_speed);
+  p = put_int32(p, state->config.nchunks);
+  p = put_int32(p, state->blocksize);
+  for (int dim = 0; dim < STUNE_NDIMS; dim++) {
+    p = put_int32(p, state->best.values[dim]);
+  }
+  p = put_double(p, state->best_score);
+  for (int dim = 0; dim < STUNE_NDIMS; dim++) {
+    p = put_int32(p, state->trial.values[dim]);
+  }
+  p = put_int32(p, state->dim);
+  p = put_int32(p, state->cand);
+  p = put_int32(p, state->nchunks);
+  *p = state->done;
+
+  state->dirty = false;
+  return 1;
+}
+
+int blosc_stune_deserialize(blosc2_context * context, const uint8_t *content, int32_t content_len) {
+  if (content_len != STUNE_STATE_SIZE || content[0] != STUNE_STATE_VERSION) {
+    BLOSC_TRACE_WARNING("Unknown format of the tuning state.  Starting afresh.");
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  const uint8_t *p = content + 1;
+  blosc2_stune_config config;
+  int32_t value;
+  p = get_int32(p, &value);
+  config.objective = value;
+  p = get_double(p, &config.min_speed);
+  p = get_int32(p, &value);
+  config.nchunks = value;
+
+  stune_state *state = new_state(context, &config);
+  BLOSC_ERROR_NULL(state, BLOSC2_ERROR_MEMORY_ALLOC);
+  p = get_int32(p, &state->blocksize);
+  for (int dim = 0; dim < STUNE_NDIMS; dim++) {
+    p = get_int32(p, &value);
+    state->best.values[dim] = value;
+  }
+  p = get_double(p, &state->best_score);
+  for (int dim = 0; dim < STUNE_NDIMS; dim++) {
+    p = get_int32(p, &value);
+    state->trial.values[dim] = value;
+  }
+  p = get_int32(p, &value);
+  state->dim = value;
+  p = get_int32(p, &value);
+  state->cand = value;
+  p = get_int32(p, &value);
+  state->nchunks = value;
+  state->done = *p != 0;
+
+  // The codecs here may not be the same as where the state was saved
+  const char *compname;
+  if (blosc2_compcode_to_compname(state->best.values[STUNE_CODEC], &compname) < 0 ||
+      blosc2_compcode_to_compname(state->trial.values[STUNE_CODEC], &compname) < 0 ||
+      state->dim < 0 || state->dim > STUNE_NDIMS || state->cand < -1 ||
+      (state->dim < STUNE_NDIMS && state->cand > state->ncandidates[state->dim]) ||
+      config.objective < BLOSC_STUNE_CRATIO || config.objective > BLOSC_STUNE_BALANCED) {
+    BLOSC_TRACE_WARNING("The tuning state cannot be used here.  Starting afresh.");
+    ctx_free(context, state);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  if (context->tuner_params != NULL) {
+    ctx_free(context, context->tuner_params);
+  }
+  context->tuner_params = state;
   return BLOSC2_ERROR_SUCCESS;
 }
 
@@ -20,11 +20,30 @@
 /* The size of L2 cache.  256 KB is quite common nowadays. */
 #define L2 (256 * 1024)
 
+/* The buffers that a thread works on for compressing a block: its source and tmp..tmp4 */
+#define STUNE_THREAD_BUFFERS 5
+
+/* The smallest automatic blocksize when splitting a chunk among threads */
+#define STUNE_MIN_THREAD_BLOCKSIZE (8 * 1024)
+
 /* The maximum number of compressed data streams in a block for compression */
 #define MAX_STREAMS 16 /* Cannot be larger than 128 */
 
 #define BLOSC_STUNE 0
 
+/* The caches that a core sees (the sizes are 0 when they cannot be detected) */
+typedef struct {
+  int32_t l1d;
+  int32_t l2;
+  int32_t l3;  /* the share of a core in the L3 */
+  int ncores;
+} blosc_cpu_info;
+
+/* Detect the caches, which is done once by blosc2_init() */
+void blosc_stune_detect_cpu(void);
+
+const blosc_cpu_info* blosc_stune_cpu_info(void);
+
 int blosc_stune_init(void * config, blosc2_context* cctx, blosc2_context* dctx);
 
 int blosc_stune_next_blocksize(blosc2_context * context);
@@ -35,6 +54,21 @@ int blosc_stune_update(blosc2_context * context, double ctime);
 
 int blosc_stune_free(blosc2_context * context);
 
+/* Serialize the state of the adaptive tuning in a malloc()ed `content`.  Returns 1 when
+   the state has changed since the last time, 0 when not, and a negative value on errors. */
+int blosc_stune_serialize(blosc2_context * context, uint8_t **content, int32_t *content_len);
+
+/* Restore the state of the adaptive tuning out of a serialized `content` (which is
+   ignored when it cannot be used) */
+int blosc_stune_deserialize(blosc2_context * context, const uint8_t *content, int32_t content_len);
+
+/* The entropy in bits per byte of a few samples of the `size` bytes at `src` */
+double stune_sampled_entropy(const uint8_t *src, int32_t size);
+
+/* The stride (up to 16) that makes the bytes of a few samples of the `size` bytes at `src`
+   the most predictable when they are shuffled, or 0 when no shuffle pays off */
+int32_t stune_detect_stride(const uint8_t *src, int32_t size);
+
 /* Conditions for splitting a block before compressing with a codec. */
 int split_block(blosc2_context *context, int32_t typesize, int32_t blocksize);
 
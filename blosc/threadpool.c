@@ -0,0 +1,627 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+/* Needed for pthread_setaffinity_np() */
+#define _GNU_SOURCE
+#endif
+
+#include "threadpool.h"
+#include "blosc-atomic.h"
+#include "stune.h"
+#include "blosc2.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#if defined(BLOSC_WIN32_NATIVE_THREADS)
+#include <windows.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* A set of jobs submitted by a single (de-)compression call */
+typedef struct pool_batch {
+  void (*dojob)(void *);
+  uint8_t *jobdata;
+  size_t jobdata_elsize;
+  int numjobs;
+  int next_job;  /* the next job to be started */
+  volatile int32_t pending;  /* the jobs that are not finished yet (read without the mutex when spinning) */
+  bool detached;  /* nobody waits for the batch; it is freed when finished */
+  struct pool_batch *next;  /* the next batch in the queue */
+} pool_batch;
+
+typedef struct {
+  int16_t nthreads;
+  pthread_t *threads;
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cv;  /* signaled when new jobs are queued */
+  pthread_cond_t done_cv;  /* signaled when a batch has finished */
+  pool_batch *head;  /* batches with jobs not started yet */
+  pool_batch *tail;
+  volatile int32_t nqueued;  /* the jobs not started yet (read without the mutex when spinning) */
+  volatile int32_t end_threads;
+} blosc_pool;
+
+static blosc_pool *g_pool = NULL;
+
+
+/* Unlink a batch from the queue (pool mutex must be held) */
+static void unlink_batch(blosc_pool *pool, pool_batch *batch) {
+  pool_batch *prev = NULL;
+  for (pool_batch *b = pool->head; b != NULL; b = b->next) {
+    if (b == batch) {
+      if (prev == NULL) {
+        pool->head = b->next;
+      }
+      else {
+        prev->next = b->next;
+      }
+      if (pool->tail == b) {
+        pool->tail = prev;
+      }
+      b->next = NULL;
+      return;
+    }
+    prev = b;
+  }
+}
+
+/* Take the next job of a batch (pool mutex must be held).  Fully started
+ * batches are removed from the queue. */
+static int take_job(blosc_pool *pool, pool_batch *batch) {
+  blosc_atomic_add32(&pool->nqueued, -1);
+  int njob = batch->next_job++;
+  if (batch->next_job == batch->numjobs) {
+    unlink_batch(pool, batch);
+  }
+  return njob;
+}
+
+/* Run a job and account for it (pool mutex must be held, it is released
+ * during the execution of the job).  Returns whether the batch is a detached
+ * one that has finished, and hence should be freed. */
+static bool run_job(blosc_pool *pool, pool_batch *batch, int njob) {
+  pthread_mutex_unlock(&pool->mutex);
+  batch->dojob(batch->jobdata + (size_t)njob * batch->jobdata_elsize);
+  pthread_mutex_lock(&pool->mutex);
+  if (blosc_atomic_add32(&batch->pending, -1) > 1) {
+    return false;
+  }
+  if (batch->detached) {
+    return true;
+  }
+  pthread_cond_broadcast(&pool->done_cv);
+  return false;
+}
+
+/* Spin for a while until `*value` is not `expected`.  Returns whether it changed. */
+static bool spin_while(volatile int32_t *value, int32_t expected) {
+  // With a single core, the thread that is waited for cannot run while spinning
+  int niters = blosc_stune_cpu_info()->ncores == 1 ? 0 : BLOSC_SPIN_ITERATIONS;
+  for (int i = 0; i < niters; i++) {
+    if (blosc_atomic_load32(value) != expected) {
+      return true;
+    }
+    blosc_cpu_relax();
+  }
+  return false;
+}
+
+static void* pool_worker(void *arg) {
+  blosc_pool *pool = (blosc_pool *)arg;
+
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    /* The next jobs usually come right after the previous ones, so spin before sleeping */
+    bool spun = false;
+    while (pool->head == NULL && !pool->end_threads) {
+      if (!spun) {
+        pthread_mutex_unlock(&pool->mutex);
+        spin_while(&pool->nqueued, 0);
+        pthread_mutex_lock(&pool->mutex);
+        spun = true;
+        continue;
+      }
+      pthread_cond_wait(&pool->work_cv, &pool->mutex);
+    }
+    if (pool->head == NULL) {
+      /* Only quit when the queue has been drained, as nobody else would run the jobs left */
+      break;
+    }
+    pool_batch *batch = pool->head;
+    int njob = take_job(pool, batch);
+    if (batch->next_job < batch->numjobs) {
+      /* Rotate the queue so that the other contexts get their turn */
+      unlink_batch(pool, batch);
+      if (pool->tail == NULL) {
+        pool->head = batch;
+      }
+      else {
+        pool->tail->next = batch;
+      }
+      pool->tail = batch;
+    }
+    if (run_job(pool, batch, njob)) {
+      free(batch);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+
+#if defined(__linux__)
+/* Parse a Linux cpulist (e.g. "0-3,8-11") into a cpu set.  Returns the number of cpus. */
+static int parse_cpulist(const char *cpulist, cpu_set_t *cpuset) {
+  int ncpus = 0;
+  const char *p = cpulist;
+  CPU_ZERO(cpuset);
+  while (*p != '\0' && *p != '\n') {
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p) {
+      break;
+    }
+    long last = first;
+    if (*end == '-') {
+      p = end + 1;
+      last = strtol(p, &end, 10);
+    }
+    for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+      CPU_SET((int)cpu, cpuset);
+      ncpus++;
+    }
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return ncpus;
+}
+
+/* Get the cpus of a NUMA node.  Returns the number of cpus (0 if node does not exist). */
+static int get_node_cpus(int node, cpu_set_t *cpuset) {
+  char path[64];
+  char cpulist[1024];
+  sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return 0;
+  }
+  if (fgets(cpulist, sizeof(cpulist), fp) == NULL) {
+    fclose(fp);
+    return 0;
+  }
+  fclose(fp);
+  return parse_cpulist(cpulist, cpuset);
+}
+
+/* Spread the workers evenly among the NUMA nodes, binding each one to the cpus
+ * of its node.  Nothing is done on single-node machines. */
+static void bind_workers_to_nodes(blosc_pool *pool) {
+  cpu_set_t cpuset;
+  int nnodes = blosc_numa_nnodes();
+  if (nnodes <= 1) {
+    return;
+  }
+  for (int tid = 0; tid < pool->nthreads; tid++) {
+    if (get_node_cpus(tid % nnodes, &cpuset) > 0) {
+      int rc = pthread_setaffinity_np(pool->threads[tid], sizeof(cpu_set_t), &cpuset);
+      if (rc != 0) {
+        BLOSC_TRACE_WARNING("Could not bind pool worker %d to NUMA node %d", tid, tid % nnodes);
+      }
+    }
+  }
+}
+#endif  /* __linux__ */
+
+
+int blosc_numa_nnodes(void) {
+  static int nnodes = 0;  /* not counted yet */
+  if (nnodes == 0) {
+    int n = 0;
+#if defined(__linux__)
+    cpu_set_t cpuset;
+    while (n < 64 && get_node_cpus(n, &cpuset) > 0) {
+      n++;
+    }
+#endif
+    nnodes = n > 0 ? n : 1;
+  }
+  return nnodes;
+}
+
+
+int blosc_numa_bind_self(int node) {
+#if defined(__linux__)
+  cpu_set_t cpuset;
+  if (get_node_cpus(node, &cpuset) <= 0) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+  if (rc != 0) {
+    BLOSC_TRACE_WARNING("Could not bind thread to NUMA node %d", node);
+    return BLOSC2_ERROR_FAILURE;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+#else
+  BLOSC_UNUSED_PARAM(node);
+  return BLOSC2_ERROR_NOT_FOUND;
+#endif
+}
+
+
+int blosc_pool_new(int16_t nthreads, void **pool_data) {
+  *pool_data = NULL;
+  if (nthreads <= 0) {
+    BLOSC_TRACE_ERROR("nthreads must be a positive integer.");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+
+  blosc_pool *pool = (blosc_pool *)calloc(1, sizeof(blosc_pool));
+  BLOSC_ERROR_NULL(pool, BLOSC2_ERROR_MEMORY_ALLOC);
+  pool->threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+  if (pool->threads == NULL) {
+    free(pool);
+    BLOSC_TRACE_ERROR("Cannot allocate the pool threads.");
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cv, NULL);
+  pthread_cond_init(&pool->done_cv, NULL);
+
+  for (int16_t tid = 0; tid < nthreads; tid++) {
+    int rc = pthread_create(&pool->threads[tid], NULL, pool_worker, (void *)pool);
+    if (rc) {
+      BLOSC_TRACE_ERROR("Return code from pthread_create() is %d.\n"
+                        "\tError detail: %s\n", rc, strerror(rc));
+      /* Stop the workers that could be started */
+      pool->nthreads = tid;
+      blosc_pool_free(pool);
+      return BLOSC2_ERROR_THREAD_CREATE;
+    }
+  }
+  pool->nthreads = nthreads;
+#if defined(__linux__)
+  bind_workers_to_nodes(pool);
+#endif
+
+  *pool_data = pool;
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+void blosc_pool_free(void *pool_data) {
+  blosc_pool *pool = (blosc_pool *)pool_data;
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->end_threads = 1;
+  blosc_atomic_add32(&pool->nqueued, 1);  /* stop the spinning workers too */
+  pthread_cond_broadcast(&pool->work_cv);
+  pthread_mutex_unlock(&pool->mutex);
+  for (int16_t tid = 0; tid < pool->nthreads; tid++) {
+    void *status;
+    int rc = pthread_join(pool->threads[tid], &status);
+    if (rc) {
+      BLOSC_TRACE_ERROR("Return code from pthread_join() is %d\n"
+                        "\tError detail: %s.", rc, strerror(rc));
+    }
+  }
+
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->work_cv);
+  pthread_cond_destroy(&pool->done_cv);
+  free(pool->threads);
+  free(pool);
+}
+
+
+int blosc_pool_create(int16_t nthreads) {
+  blosc_pool_destroy();
+  void *pool;
+  int rc = blosc_pool_new(nthreads, &pool);
+  g_pool = (blosc_pool *)pool;
+  return rc;
+}
+
+
+void blosc_pool_destroy(void) {
+  blosc_pool_free(g_pool);
+  g_pool = NULL;
+}
+
+
+int16_t blosc_pool_nthreads(void) {
+  return g_pool == NULL ? 0 : g_pool->nthreads;
+}
+
+
+void blosc_pool_run(void *pool_data, void (*dojob)(void *), int numjobs,
+                    size_t jobdata_elsize, void *jobdata) {
+  blosc_pool *pool = (pool_data != NULL) ? (blosc_pool *)pool_data : g_pool;
+  if (pool == NULL) {
+    /* No pool; just run the jobs in order */
+    for (int i = 0; i < numjobs; i++) {
+      dojob((uint8_t *)jobdata + (size_t)i * jobdata_elsize);
+    }
+    return;
+  }
+
+  pool_batch batch;
+  batch.dojob = dojob;
+  batch.jobdata = (uint8_t *)jobdata;
+  batch.jobdata_elsize = jobdata_elsize;
+  batch.numjobs = numjobs;
+  batch.next_job = 0;
+  batch.pending = numjobs;
+  batch.detached = false;
+  batch.next = NULL;
+
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->tail == NULL) {
+    pool->head = &batch;
+  }
+  else {
+    pool->tail->next = &batch;
+  }
+  pool->tail = &batch;
+  blosc_atomic_add32(&pool->nqueued, numjobs);
+  pthread_cond_broadcast(&pool->work_cv);
+
+  /* Help with our own jobs instead of just waiting */
+  while (batch.next_job < batch.numjobs) {
+    int njob = take_job(pool, &batch);
+    run_job(pool, &batch, njob);
+  }
+  /* The jobs of the other threads are about to finish when ours are, so spin before sleeping */
+  int32_t pending = blosc_atomic_load32(&batch.pending);
+  while (pending > 0) {
+    pthread_mutex_unlock(&pool->mutex);
+    bool changed = spin_while(&batch.pending, pending);
+    pthread_mutex_lock(&pool->mutex);
+    pending = blosc_atomic_load32(&batch.pending);
+    if (!changed && pending > 0) {
+      pthread_cond_wait(&pool->done_cv, &pool->mutex);
+      pending = blosc_atomic_load32(&batch.pending);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+
+/* The jobs of a call run in a task scheduler.  The jobs submitted to the scheduler may
+ * start after the call has returned, so the batch is freed by the last one to drop it. */
+typedef struct {
+  void (*dojob)(void *);
+  uint8_t *jobdata;
+  size_t jobdata_elsize;
+  int32_t numjobs;
+  volatile int32_t next_job;  /* the next job to be started */
+  volatile int32_t ndone;  /* the jobs finished (read without the mutex when spinning) */
+  volatile int32_t refs;  /* the caller plus the submitted jobs that have not run yet */
+  pthread_mutex_t mutex;
+  pthread_cond_t done_cv;
+} sched_batch;
+
+/* Start the jobs of the batch that nobody has started yet */
+static void sched_batch_work(sched_batch *batch) {
+  while (1) {
+    int32_t njob = blosc_atomic_add32(&batch->next_job, 1);
+    if (njob >= batch->numjobs) {
+      return;
+    }
+    batch->dojob(batch->jobdata + (size_t)njob * batch->jobdata_elsize);
+#if defined(BLOSC_WIN32_NATIVE_THREADS)
+    if (blosc_atomic_add32(&batch->ndone, 1) + 1 == batch->numjobs) {
+      WakeByAddressAll((PVOID)&batch->ndone);
+    }
+#else
+    pthread_mutex_lock(&batch->mutex);
+    if (blosc_atomic_add32(&batch->ndone, 1) + 1 == batch->numjobs) {
+      pthread_cond_signal(&batch->done_cv);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+#endif
+  }
+}
+
+static void sched_batch_release(sched_batch *batch) {
+  if (blosc_atomic_add32(&batch->refs, -1) == 1) {
+    pthread_mutex_destroy(&batch->mutex);
+    pthread_cond_destroy(&batch->done_cv);
+    free(batch);
+  }
+}
+
+/* The job submitted to the scheduler */
+static void sched_job(void *arg) {
+  sched_batch *batch = (sched_batch *)arg;
+  sched_batch_work(batch);
+  sched_batch_release(batch);
+}
+
+void blosc_sched_run(const blosc2_task_scheduler *scheduler, void (*dojob)(void *), int numjobs,
+                     size_t jobdata_elsize, void *jobdata) {
+  sched_batch *batch = (sched_batch *)malloc(sizeof(sched_batch));
+  if (batch == NULL) {
+    /* Just run the jobs in order */
+    for (int i = 0; i < numjobs; i++) {
+      dojob((uint8_t *)jobdata + (size_t)i * jobdata_elsize);
+    }
+    return;
+  }
+  batch->dojob = dojob;
+  batch->jobdata = (uint8_t *)jobdata;
+  batch->jobdata_elsize = jobdata_elsize;
+  batch->numjobs = numjobs;
+  batch->next_job = 0;
+  batch->ndone = 0;
+  batch->refs = 1;
+  pthread_mutex_init(&batch->mutex, NULL);
+  pthread_cond_init(&batch->done_cv, NULL);
+
+  /* The calling thread is one of the jobs */
+  for (int i = 1; i < numjobs; i++) {
+    blosc_atomic_add32(&batch->refs, 1);
+    if (scheduler->submit(scheduler->sched_data, sched_job, batch) < 0) {
+      /* We will run the rest ourselves */
+      blosc_atomic_add32(&batch->refs, -1);
+      break;
+    }
+  }
+  sched_batch_work(batch);
+
+  /* Only the jobs that are running are waited for, and they are about to finish when ours are */
+  int32_t ndone = blosc_atomic_load32(&batch->ndone);
+  if (ndone < numjobs) {
+    spin_while(&batch->ndone, ndone);
+#if defined(BLOSC_WIN32_NATIVE_THREADS)
+    /* This returns at once if ndone is not the one seen anymore */
+    while ((ndone = blosc_atomic_load32(&batch->ndone)) < numjobs) {
+      WaitOnAddress(&batch->ndone, &ndone, sizeof(int32_t), INFINITE);
+    }
+#else
+    pthread_mutex_lock(&batch->mutex);
+    while (blosc_atomic_load32(&batch->ndone) < numjobs) {
+      pthread_cond_wait(&batch->done_cv, &batch->mutex);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+#endif
+  }
+  sched_batch_release(batch);
+}
+
+
+#if defined(BLOSC_WIN32_NATIVE_THREADS)
+typedef struct {
+  void (*job)(void *);
+  void *job_data;
+} win32_job;
+
+static VOID CALLBACK win32_run_job(PTP_CALLBACK_INSTANCE instance, PVOID arg) {
+  (void)instance;
+  win32_job job = *(win32_job *)arg;
+  free(arg);
+  job.job(job.job_data);
+}
+
+/* Run the job in the default thread pool of the process */
+static int win32_submit(void *sched_data, void (*job)(void *), void *job_data) {
+  (void)sched_data;
+  win32_job *wjob = (win32_job *)malloc(sizeof(win32_job));
+  BLOSC_ERROR_NULL(wjob, BLOSC2_ERROR_MEMORY_ALLOC);
+  wjob->job = job;
+  wjob->job_data = job_data;
+  if (!TrySubmitThreadpoolCallback(win32_run_job, wjob, NULL)) {
+    free(wjob);
+    return BLOSC2_ERROR_THREAD_CREATE;
+  }
+  return 0;
+}
+
+static const blosc2_task_scheduler g_native_scheduler = {win32_submit, NULL};
+#endif  /* BLOSC_WIN32_NATIVE_THREADS */
+
+
+const blosc2_task_scheduler *blosc_native_scheduler(void) {
+#if defined(BLOSC_WIN32_NATIVE_THREADS)
+  return &g_native_scheduler;
+#else
+  return NULL;
+#endif
+}
+
+
+int blosc_pool_submit(void (*dojob)(void *), void *jobdata) {
+  blosc_pool *pool = g_pool;
+  if (pool == NULL) {
+    return BLOSC2_ERROR_NOT_FOUND;
+  }
+  pool_batch *batch = (pool_batch *)malloc(sizeof(pool_batch));
+  BLOSC_ERROR_NULL(batch, BLOSC2_ERROR_MEMORY_ALLOC);
+  batch->dojob = dojob;
+  batch->jobdata = (uint8_t *)jobdata;
+  batch->jobdata_elsize = 0;
+  batch->numjobs = 1;
+  batch->next_job = 0;
+  batch->pending = 1;
+  batch->detached = true;
+  batch->next = NULL;
+
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->tail == NULL) {
+    pool->head = batch;
+  }
+  else {
+    pool->tail->next = batch;
+  }
+  pool->tail = batch;
+  blosc_atomic_add32(&pool->nqueued, 1);
+  pthread_cond_signal(&pool->work_cv);
+  pthread_mutex_unlock(&pool->mutex);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+void blosc_barrier_init(blosc_barrier *barrier, int32_t nthreads) {
+  pthread_mutex_init(&barrier->mutex, NULL);
+  pthread_cond_init(&barrier->cv, NULL);
+  barrier->nthreads = nthreads;
+  barrier->count = 0;
+  barrier->generation = 0;
+}
+
+
+void blosc_barrier_destroy(blosc_barrier *barrier) {
+  pthread_mutex_destroy(&barrier->mutex);
+  pthread_cond_destroy(&barrier->cv);
+}
+
+
+bool blosc_barrier_wait(blosc_barrier *barrier) {
+  int32_t generation = blosc_atomic_load32(&barrier->generation);
+  if (blosc_atomic_add32(&barrier->count, 1) == barrier->nthreads - 1) {
+    /* The count is reset before anybody can go on to the next generation */
+    blosc_atomic_store32(&barrier->count, 0);
+#if defined(BLOSC_WIN32_NATIVE_THREADS)
+    blosc_atomic_add32(&barrier->generation, 1);
+    WakeByAddressAll((PVOID)&barrier->generation);
+#else
+    pthread_mutex_lock(&barrier->mutex);
+    blosc_atomic_add32(&barrier->generation, 1);
+    pthread_cond_broadcast(&barrier->cv);
+    pthread_mutex_unlock(&barrier->mutex);
+#endif
+    return true;
+  }
+  if (spin_while(&barrier->generation, generation)) {
+    return false;
+  }
+#if defined(BLOSC_WIN32_NATIVE_THREADS)
+  /* This returns at once if the generation is not the one seen anymore */
+  while (blosc_atomic_load32(&barrier->generation) == generation) {
+    WaitOnAddress(&barrier->generation, &generation, sizeof(int32_t), INFINITE);
+  }
+#else
+  pthread_mutex_lock(&barrier->mutex);
+  while (blosc_atomic_load32(&barrier->generation) == generation) {
+    pthread_cond_wait(&barrier->cv, &barrier->mutex);
+  }
+  pthread_mutex_unlock(&barrier->mutex);
+#endif
+  return false;
+}
@@ -0,0 +1,99 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+
+  A process-wide pool of worker threads that can be shared by many
+  contexts.  Every parallel (de-)compression submits a batch of jobs,
+  and workers take jobs from the pending batches in a round-robin
+  fashion, so that a context with many threads cannot starve the rest.
+
+*********************************************************************/
+
+#ifndef BLOSC_THREADPOOL_H
+#define BLOSC_THREADPOOL_H
+
+#if defined(_WIN32) && !defined(__GNUC__)
+#include "win32/pthread.h"
+#else
+#include <pthread.h>
+#endif
+
+#include "blosc2.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* The iterations that the threads spin before they block waiting for a barrier or for
+ * jobs (a few tens of microseconds), which is about what it takes to wake a thread up */
+#define BLOSC_SPIN_ITERATIONS 1000
+
+/* A barrier that spins for a while before blocking, so that the threads of calls
+ * with short jobs do not pay for being put to sleep and woken up every time */
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t cv;
+  int32_t nthreads;
+  volatile int32_t count;  /* the threads that have arrived in this generation */
+  volatile int32_t generation;  /* bumped every time all the threads arrive */
+} blosc_barrier;
+
+void blosc_barrier_init(blosc_barrier *barrier, int32_t nthreads);
+
+void blosc_barrier_destroy(blosc_barrier *barrier);
+
+/* Wait for the nthreads of the barrier.  Returns true for the last one to arrive. */
+bool blosc_barrier_wait(blosc_barrier *barrier);
+
+/* Create the shared pool with nthreads workers (replacing a previous one) */
+int blosc_pool_create(int16_t nthreads);
+
+/* Stop the workers and release the shared pool (if any) */
+void blosc_pool_destroy(void);
+
+/* Create a pool with nthreads workers apart from the shared one, for blosc_pool_run() */
+int blosc_pool_new(int16_t nthreads, void **pool_data);
+
+/* Stop the workers and release a pool of blosc_pool_new() (if any) */
+void blosc_pool_free(void *pool_data);
+
+/* The number of workers in the shared pool (0 if there is no pool) */
+int16_t blosc_pool_nthreads(void);
+
+/* Run numjobs jobs and wait for all of them to finish.  The calling thread
+ * takes part in the execution of its own jobs.  Jobs of a batch are started
+ * in order, so a job may wait for a previous one, but never for a later one.
+ * The signature is the same than a #blosc_threads_callback. */
+void blosc_pool_run(void *pool_data, void (*dojob)(void *), int numjobs,
+                    size_t jobdata_elsize, void *jobdata);
+
+/* Queue a single job in the shared pool and return without waiting for it.
+ * Returns BLOSC2_ERROR_NOT_FOUND if there is no shared pool. */
+int blosc_pool_submit(void (*dojob)(void *), void *jobdata);
+
+/* Run numjobs jobs in a task scheduler of the application and wait for all of them
+ * to finish.  The calling thread runs the jobs that the scheduler has not started yet,
+ * so that this neither depends on the scheduler running them nor deadlocks.  Jobs are
+ * started in order, like in blosc_pool_run(). */
+void blosc_sched_run(const blosc2_task_scheduler *scheduler, void (*dojob)(void *), int numjobs,
+                     size_t jobdata_elsize, void *jobdata);
+
+/* The scheduler of the operating system that runs the jobs of the contexts instead of
+ * threads of their own (the Windows thread pool with BLOSC_WIN32_NATIVE_THREADS), or NULL */
+const blosc2_task_scheduler *blosc_native_scheduler(void);
+
+/* The number of NUMA nodes of the machine (1 if they cannot be told apart) */
+int blosc_numa_nnodes(void);
+
+/* Bind the calling thread to the cpus of a NUMA node */
+int blosc_numa_bind_self(int node);
+
+#endif  /* BLOSC_THREADPOOL_H */
@@ -0,0 +1,66 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_TRANSPOSE_WASM_H
+#define BLOSC_TRANSPOSE_WASM_H
+
+#include <wasm_simd128.h>
+
+#include <stdint.h>
+
+/* Split the bytes of every pair of vectors in `xmm0` (of `n`): the even ones of
+   xmm0[2i] and xmm0[2i+1] go to xmm0[i] and the odd ones to xmm0[i + n/2]. */
+static inline void unzip16(v128_t *xmm0, const int n) {
+  v128_t xmm1[16];
+  for (int i = 0; i < n / 2; i++) {
+    xmm1[i] = wasm_i8x16_shuffle(xmm0[2 * i], xmm0[2 * i + 1],
+                                 0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+    xmm1[i + n / 2] = wasm_i8x16_shuffle(xmm0[2 * i], xmm0[2 * i + 1],
+                                         1, 3, 5, 7, 9, 11, 13, 15, 17, 19, 21, 23, 25, 27, 29, 31);
+  }
+  for (int i = 0; i < n; i++) {
+    xmm0[i] = xmm1[i];
+  }
+}
+
+/* The inverse of unzip16(): interleave the bytes of xmm0[i] and xmm0[i + n/2]
+   into xmm0[2i] and xmm0[2i+1]. */
+static inline void zip16(v128_t *xmm0, const int n) {
+  v128_t xmm1[16];
+  for (int i = 0; i < n / 2; i++) {
+    xmm1[2 * i] = wasm_i8x16_shuffle(xmm0[i], xmm0[i + n / 2],
+                                     0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23);
+    xmm1[2 * i + 1] = wasm_i8x16_shuffle(xmm0[i], xmm0[i + n / 2],
+                                         8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31);
+  }
+  for (int i = 0; i < n; i++) {
+    xmm0[i] = xmm1[i];
+  }
+}
+
+/* Transpose inplace the 16 elements of `n` bytes (n being 2, 4, 8 or 16) in the
+   `n` vectors of `xmm0`, so that xmm0[k] ends up with the k-th byte of all of them.
+   Every round of unzip16() takes one more bit of the byte index to the vector index.
+   Total cost: n * log2(n) calls to wasm_i8x16_shuffle. */
+static inline void transpose_nx16(v128_t *xmm0, const int n) {
+  for (int m = n; m > 1; m /= 2) {
+    unzip16(xmm0, n);
+  }
+}
+
+/* The inverse of transpose_nx16(): take the `n` vectors with the bytes of 16
+   elements of `n` bytes back to the elements. */
+static inline void untranspose_nx16(v128_t *xmm0, const int n) {
+  for (int m = n; m > 1; m /= 2) {
+    zip16(xmm0, n);
+  }
+}
+
+#endif /* BLOSC_TRANSPOSE_WASM_H */
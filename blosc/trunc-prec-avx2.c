@@ -0,0 +1,15 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* trunc-prec.c built again with AVX2 enabled, for rounding 8 floats (or 4 doubles) at a
+   time.  Its entry points are suffixed as in delta-avx2.c (see trunc-prec.h). */
+
+#define BLOSC_AVX2_BUILD
+#include "trunc-prec.c"
@@ -9,78 +9,268 @@
 **********************************************************************/
 
 #include "trunc-prec.h"
+#include "shuffle.h"
 #include "blosc2.h"
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 #define BITS_MANTISSA_FLOAT 23
 #define BITS_MANTISSA_DOUBLE 52
+#define EXPONENT_FLOAT 0x7F800000U
+#define EXPONENT_DOUBLE 0x7FF0000000000000ULL
 
 
-int truncate_precision32(int8_t prec_bits, int32_t nelems,
-                         const int32_t* src, int32_t* dest) {
-  // Make sure that we don't remove all the bits in mantissa so that we
-  // don't mess with NaNs or Infinite representation in IEEE 754:
-  // https://en.wikipedia.org/wiki/NaN
-  if ((abs(prec_bits) > BITS_MANTISSA_FLOAT)) {
-    BLOSC_TRACE_ERROR("The precision cannot be larger than %d bits for floats (asking for %d bits)",
-                      BITS_MANTISSA_FLOAT, prec_bits);
-    return -1;
+/* What is done to every element: x + bias, where bias = 0 for NaNs and infinities
+ * and bias = half + ((x >> zeroed_bits) & tie) otherwise, and then & mask */
+typedef struct {
+  uint64_t mask;
+  uint64_t half;  // half the last kept bit minus one (0 when truncating)
+  uint64_t tie;   // 1 for rounding the ties to even (0 when truncating)
+  int zeroed_bits;
+} trunc_prec_params;
+
+
+/* The vectors are the ones that the compilation target supports (as in delta.c, this
+ * is built again for AVX2 by trunc-prec-avx2.c), for elements of 4 or 8 bytes (the unit) */
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#define TRUNC_PREC_HAS_SIMD
+typedef __m128i prec_vec;
+
+static inline prec_vec vec_load(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void vec_store(uint8_t* p, prec_vec x) { _mm_storeu_si128((__m128i*)p, x); }
+static inline prec_vec vec_and(prec_vec a, prec_vec b) { return _mm_and_si128(a, b); }
+
+static inline prec_vec vec_set(uint64_t x, int32_t unit) {
+  return (unit == 4) ? _mm_set1_epi32((int32_t)x) : _mm_set1_epi64x((int64_t)x);
+}
+
+static inline prec_vec vec_add(prec_vec a, prec_vec b, int32_t unit) {
+  return (unit == 4) ? _mm_add_epi32(a, b) : _mm_add_epi64(a, b);
+}
+
+static inline prec_vec vec_shift_down(prec_vec x, int n, int32_t unit) {
+  return (unit == 4) ? _mm_srl_epi32(x, _mm_cvtsi32_si128(n)) : _mm_srl_epi64(x, _mm_cvtsi32_si128(n));
+}
+
+/* The bias of every element (see trunc_prec_params) */
+static inline prec_vec vec_bias(prec_vec x, prec_vec exponent, prec_vec half, prec_vec tie,
+                                int zeroed_bits, int32_t unit) {
+  // The whole exponent of doubles is in the upper halves
+  prec_vec special = _mm_cmpeq_epi32(_mm_and_si128(x, exponent), exponent);
+  if (unit == 8) {
+    special = _mm_shuffle_epi32(special, _MM_SHUFFLE(3, 3, 1, 1));
   }
-  int zeroed_bits = (prec_bits >= 0) ? BITS_MANTISSA_FLOAT - prec_bits : -prec_bits;
-  if (zeroed_bits >= BITS_MANTISSA_FLOAT) {
-    BLOSC_TRACE_ERROR("The reduction in precision cannot be larger or equal than %d bits for floats (asking for %d bits)",
-                      BITS_MANTISSA_FLOAT, zeroed_bits);
-    return -1;
+  prec_vec bias = vec_add(half, vec_and(vec_shift_down(x, zeroed_bits, unit), tie), unit);
+  return _mm_andnot_si128(special, bias);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TRUNC_PREC_HAS_SIMD
+typedef uint8x16_t prec_vec;
+
+static inline prec_vec vec_load(const uint8_t* p) { return vld1q_u8(p); }
+static inline void vec_store(uint8_t* p, prec_vec x) { vst1q_u8(p, x); }
+static inline prec_vec vec_and(prec_vec a, prec_vec b) { return vandq_u8(a, b); }
+
+static inline prec_vec vec_set(uint64_t x, int32_t unit) {
+  return (unit == 4) ? vreinterpretq_u8_u32(vdupq_n_u32((uint32_t)x)) : vreinterpretq_u8_u64(vdupq_n_u64(x));
+}
+
+static inline prec_vec vec_add(prec_vec a, prec_vec b, int32_t unit) {
+  if (unit == 4) {
+    return vreinterpretq_u8_u32(vaddq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
   }
-  int32_t mask = ~((1 << zeroed_bits) - 1);
-  for (int i = 0; i < nelems; i++) {
-    dest[i] = src[i] & mask;
+  return vreinterpretq_u8_u64(vaddq_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b)));
+}
+
+static inline prec_vec vec_shift_down(prec_vec x, int n, int32_t unit) {
+  if (unit == 4) {
+    return vreinterpretq_u8_u32(vshlq_u32(vreinterpretq_u32_u8(x), vdupq_n_s32(-n)));
   }
-  return 0;
+  return vreinterpretq_u8_u64(vshlq_u64(vreinterpretq_u64_u8(x), vdupq_n_s64(-n)));
 }
 
-int truncate_precision64(int8_t prec_bits, int32_t nelems,
-                          const int64_t* src, int64_t* dest) {
+static inline prec_vec vec_bias(prec_vec x, prec_vec exponent, prec_vec half, prec_vec tie,
+                                int zeroed_bits, int32_t unit) {
+  prec_vec special;
+  if (unit == 4) {
+    special = vreinterpretq_u8_u32(vceqq_u32(vreinterpretq_u32_u8(vandq_u8(x, exponent)),
+                                             vreinterpretq_u32_u8(exponent)));
+  }
+  else {
+    special = vreinterpretq_u8_u64(vceqq_u64(vreinterpretq_u64_u8(vandq_u8(x, exponent)),
+                                             vreinterpretq_u64_u8(exponent)));
+  }
+  prec_vec bias = vec_add(half, vec_and(vec_shift_down(x, zeroed_bits, unit), tie), unit);
+  return vbicq_u8(bias, special);
+}
+#endif
+
+
+/* Check the precision and get what has to be done to the elements.  The code in
+ * cparams.filters_meta is the precision, with BLOSC_TRUNC_PREC_ROUND added to (or
+ * subtracted from, if negative) it for rounding. */
+static int trunc_prec_params_init(int8_t code, int32_t typesize, trunc_prec_params* params) {
+  bool round = (code >= BLOSC_TRUNC_PREC_ROUND) || (code <= -BLOSC_TRUNC_PREC_ROUND);
+  int prec_bits = code;
+  if (round) {
+    prec_bits = (code > 0) ? code - BLOSC_TRUNC_PREC_ROUND : code + BLOSC_TRUNC_PREC_ROUND;
+  }
+  int bits_mantissa = (typesize == 4) ? BITS_MANTISSA_FLOAT : BITS_MANTISSA_DOUBLE;
+
   // Make sure that we don't remove all the bits in mantissa so that we
   // don't mess with NaNs or Infinite representation in IEEE 754:
   // https://en.wikipedia.org/wiki/NaN
-  if ((abs(prec_bits) > BITS_MANTISSA_DOUBLE)) {
+  if ((abs(prec_bits) > bits_mantissa)) {
     BLOSC_TRACE_ERROR("The precision cannot be larger than %d bits for floats (asking for %d bits)",
-                      BITS_MANTISSA_DOUBLE, prec_bits);
+                      bits_mantissa, prec_bits);
     return -1;
   }
-  int zeroed_bits = (prec_bits >= 0) ? BITS_MANTISSA_DOUBLE - prec_bits : -prec_bits;
-  if (zeroed_bits >= BITS_MANTISSA_DOUBLE) {
+  int zeroed_bits = (prec_bits >= 0) ? bits_mantissa - prec_bits : -prec_bits;
+  if (zeroed_bits >= bits_mantissa) {
     BLOSC_TRACE_ERROR("The reduction in precision cannot be larger or equal than %d bits for floats (asking for %d bits)",
-                      BITS_MANTISSA_DOUBLE, zeroed_bits);
+                      bits_mantissa, zeroed_bits);
     return -1;
   }
-  uint64_t mask = ~((1ULL << zeroed_bits) - 1ULL);
-  for (int i = 0; i < nelems; i++) {
-    dest[i] = (int64_t)(src[i] & mask);
+  params->mask = ~((1ULL << zeroed_bits) - 1ULL);
+  if (typesize == 4) {
+    params->mask = (uint32_t)params->mask;
+  }
+  params->zeroed_bits = zeroed_bits;
+  params->half = 0;
+  params->tie = 0;
+  if (round && zeroed_bits > 0) {
+    params->half = (1ULL << (zeroed_bits - 1)) - 1ULL;
+    params->tie = 1;
   }
   return 0;
 }
 
+
+/* Truncate (or round) the nelems elements of 4 or 8 bytes (unit) of src into dest */
+static void truncate_elements(const trunc_prec_params* params, int32_t unit, int32_t nelems,
+                              const uint8_t* src, uint8_t* dest) {
+  int32_t nbytes = nelems * unit;
+  int zeroed_bits = params->zeroed_bits;
+  int32_t i = 0;
+#if defined(__AVX2__)
+  {
+    __m256i mask = (unit == 4) ? _mm256_set1_epi32((int32_t)params->mask) : _mm256_set1_epi64x((int64_t)params->mask);
+    __m256i half = (unit == 4) ? _mm256_set1_epi32((int32_t)params->half) : _mm256_set1_epi64x((int64_t)params->half);
+    __m256i tie = (unit == 4) ? _mm256_set1_epi32((int32_t)params->tie) : _mm256_set1_epi64x((int64_t)params->tie);
+    __m256i exponent = (unit == 4) ? _mm256_set1_epi32((int32_t)EXPONENT_FLOAT) :
+                       _mm256_set1_epi64x((int64_t)EXPONENT_DOUBLE);
+    __m128i shift = _mm_cvtsi32_si128(zeroed_bits);
+    for (; i <= nbytes - 32; i += 32) {
+      __m256i x = _mm256_loadu_si256((const __m256i*)(src + i));
+      __m256i special, bias;
+      if (unit == 4) {
+        special = _mm256_cmpeq_epi32(_mm256_and_si256(x, exponent), exponent);
+        bias = _mm256_add_epi32(half, _mm256_and_si256(_mm256_srl_epi32(x, shift), tie));
+        x = _mm256_add_epi32(x, _mm256_andnot_si256(special, bias));
+      }
+      else {
+        special = _mm256_cmpeq_epi64(_mm256_and_si256(x, exponent), exponent);
+        bias = _mm256_add_epi64(half, _mm256_and_si256(_mm256_srl_epi64(x, shift), tie));
+        x = _mm256_add_epi64(x, _mm256_andnot_si256(special, bias));
+      }
+      _mm256_storeu_si256((__m256i*)(dest + i), _mm256_and_si256(x, mask));
+    }
+  }
+#endif
+#if defined(TRUNC_PREC_HAS_SIMD)
+  {
+    prec_vec mask = vec_set(params->mask, unit);
+    prec_vec half = vec_set(params->half, unit);
+    prec_vec tie = vec_set(params->tie, unit);
+    prec_vec exponent = vec_set((unit == 4) ? EXPONENT_FLOAT : EXPONENT_DOUBLE, unit);
+    for (; i <= nbytes - 16; i += 16) {
+      prec_vec x = vec_load(src + i);
+      x = vec_add(x, vec_bias(x, exponent, half, tie, zeroed_bits, unit), unit);
+      vec_store(dest + i, vec_and(x, mask));
+    }
+  }
+#endif
+  if (unit == 4) {
+    uint32_t mask = (uint32_t)params->mask;
+    for (; i < nbytes; i += 4) {
+      uint32_t x = *(const uint32_t*)(src + i);
+      if ((x & EXPONENT_FLOAT) != EXPONENT_FLOAT) {
+        x += (uint32_t)params->half + ((x >> zeroed_bits) & (uint32_t)params->tie);
+      }
+      *(uint32_t*)(dest + i) = x & mask;
+    }
+  }
+  else {
+    for (; i < nbytes; i += 8) {
+      uint64_t x = *(const uint64_t*)(src + i);
+      if ((x & EXPONENT_DOUBLE) != EXPONENT_DOUBLE) {
+        x += params->half + ((x >> zeroed_bits) & params->tie);
+      }
+      *(uint64_t*)(dest + i) = x & params->mask;
+    }
+  }
+}
+
+
 /* Apply the truncate precision to src.  This can never fail. */
 int truncate_precision(int8_t prec_bits, int32_t typesize, int32_t nbytes,
                        const uint8_t* src, uint8_t* dest) {
+#if defined(TRUNC_PREC_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    return truncate_precision_avx2(prec_bits, typesize, nbytes, src, dest);
+  }
+#endif
   // Positive values of prec_bits will set absolute precision bits, whereas negative
   // values will reduce the precision bits (similar to Python slicing convention).
-  switch (typesize) {
-    case 4:
-      return truncate_precision32(prec_bits, nbytes / typesize,
-                              (int32_t *)src, (int32_t *)dest);
-    case 8:
-      return truncate_precision64(prec_bits, nbytes / typesize,
-                              (int64_t *)src, (int64_t *)dest);
-    default:
-      BLOSC_TRACE_ERROR("Error in trunc-prec filter: Precision for typesize %d not handled",
-                        (int)typesize);
-      return -1;
+  if (typesize != 4 && typesize != 8) {
+    BLOSC_TRACE_ERROR("Error in trunc-prec filter: Precision for typesize %d not handled",
+                      (int)typesize);
+    return -1;
+  }
+  trunc_prec_params params;
+  if (trunc_prec_params_init(prec_bits, typesize, &params) < 0) {
+    return -1;
+  }
+  truncate_elements(&params, typesize, nbytes / typesize, src, dest);
+  return 0;
+}
+
+
+/* Apply the truncate precision and then the shuffle to src in a single pass over the block.
+ * `nbytes` has to be a multiple of `typesize`. */
+int truncate_precision_shuffle(int8_t prec_bits, int32_t typesize, int32_t nbytes,
+                               const uint8_t* src, uint8_t* dest) {
+#if defined(TRUNC_PREC_AVX2_ENABLED)
+  if (blosc_cpu_has_avx2()) {
+    return truncate_precision_shuffle_avx2(prec_bits, typesize, nbytes, src, dest);
+  }
+#endif
+  if (typesize != 4 && typesize != 8) {
+    // Let the unfused filter report the error
+    return truncate_precision(prec_bits, typesize, nbytes, src, dest);
+  }
+  trunc_prec_params params;
+  if (trunc_prec_params_init(prec_bits, typesize, &params) < 0) {
+    return -1;
   }
+
+  uint8_t tile[SHUFFLE_TILE_SIZE];
+  int32_t nelems = nbytes / typesize;
+  int32_t tile_elems = SHUFFLE_TILE_ELEMENTS(typesize);
+  for (int32_t i = 0; i < nelems; i += tile_elems) {
+    int32_t n = (nelems - i < tile_elems) ? nelems - i : tile_elems;
+    truncate_elements(&params, typesize, n, src + i * typesize, tile);
+    shuffle_tile(typesize, n, nelems, tile, dest + i);
+  }
+  return 0;
 }
@@ -13,7 +13,25 @@
 
 #include <stdint.h>
 
+/* trunc-prec-avx2.c builds trunc-prec.c again for AVX2, with these names */
+#if defined(BLOSC_AVX2_BUILD)
+#define truncate_precision truncate_precision_avx2
+#define truncate_precision_shuffle truncate_precision_shuffle_avx2
+#endif
+
 int truncate_precision(int8_t prec_bits, int32_t typesize, int32_t nbytes,
                        const uint8_t* src, uint8_t* dest);
 
+/* The truncate precision fused with the shuffle (for blocks made of whole elements) */
+int truncate_precision_shuffle(int8_t prec_bits, int32_t typesize, int32_t nbytes,
+                               const uint8_t* src, uint8_t* dest);
+
+#if defined(TRUNC_PREC_AVX2_ENABLED)
+int truncate_precision_avx2(int8_t prec_bits, int32_t typesize, int32_t nbytes,
+                            const uint8_t* src, uint8_t* dest);
+
+int truncate_precision_shuffle_avx2(int8_t prec_bits, int32_t typesize, int32_t nbytes,
+                                    const uint8_t* src, uint8_t* dest);
+#endif
+
 #endif /* BLOSC_TRUNC_PREC_H */
@@ -0,0 +1,272 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Chunks of variable-length items (see README_VLCHUNK_FORMAT.rst) */
+
+#include "blosc-private.h"
+#include "blosc2.h"
+#include "blosc2/filters-registry.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define VLCHUNK_MAGIC "b2vl"
+#define VLCHUNK_INDEX_ENTRY 8
+
+
+/* The number of blocks for the items, and the largest payload and count of items of a block */
+static int32_t vlchunk_nblocks(const int32_t* sizes, int32_t nitems, int32_t batchsize,
+                               int64_t* max_payload, int32_t* max_items) {
+  int32_t nblocks = 0;
+  int64_t payload = 0;
+  int32_t count = 0;
+  *max_payload = 0;
+  *max_items = 0;
+  for (int32_t i = 0; i < nitems; i++) {
+    if (count > 0 && payload + sizes[i] > batchsize) {
+      nblocks++;
+      payload = 0;
+      count = 0;
+    }
+    payload += sizes[i];
+    count++;
+    if (payload > *max_payload) {
+      *max_payload = payload;
+    }
+    if (count > *max_items) {
+      *max_items = count;
+    }
+  }
+  return count > 0 ? nblocks + 1 : nblocks;
+}
+
+
+int blosc2_vlchunk_compress(blosc2_cparams cparams, const void* const* items, const int32_t* sizes,
+                            int32_t nitems, void* dest, int32_t destsize) {
+  if (nitems < 0 || (nitems > 0 && (items == NULL || sizes == NULL)) || dest == NULL) {
+    BLOSC_TRACE_ERROR("The items or the dest buffer are not valid");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  for (int32_t i = 0; i < nitems; i++) {
+    if (sizes[i] < 0 || (sizes[i] > 0 && items[i] == NULL)) {
+      BLOSC_TRACE_ERROR("The item %d is not valid", i);
+      return BLOSC2_ERROR_INVALID_PARAM;
+    }
+  }
+
+  int32_t batchsize = cparams.blocksize > 0 ? cparams.blocksize : BLOSC2_VLCHUNK_BLOCKSIZE;
+  int64_t max_payload;
+  int32_t max_items;
+  int32_t nblocks = vlchunk_nblocks(sizes, nitems, batchsize, &max_payload, &max_items);
+  if (max_payload > BLOSC2_MAX_BUFFERSIZE || max_items > BLOSC2_MAX_BUFFERSIZE / (int32_t)sizeof(int32_t)) {
+    BLOSC_TRACE_ERROR("The block of an item is too large");
+    return BLOSC2_ERROR_MAX_BUFSIZE_EXCEEDED;
+  }
+  int64_t header_len = BLOSC2_VLCHUNK_HEADER_LENGTH + (int64_t)nblocks * VLCHUNK_INDEX_ENTRY;
+  if (header_len > destsize) {
+    return 0;
+  }
+
+  // The end offsets of the items go with the bytes of each of them shuffled and delta encoded,
+  // and the payload with the filters of cparams
+  blosc2_cparams ocparams = cparams;
+  ocparams.typesize = sizeof(int32_t);
+  ocparams.blocksize = 0;
+  ocparams.nthreads = 1;
+  ocparams.schunk = NULL;
+  ocparams.use_dict = 0;
+  ocparams.instr_codec = false;
+  ocparams.prefilter = NULL;
+  ocparams.preparams = NULL;
+  ocparams.block_codec = NULL;
+  ocparams.block_codec_params = NULL;
+  for (int i = 0; i < BLOSC2_MAX_FILTERS; i++) {
+    ocparams.filters[i] = BLOSC_NOFILTER;
+    ocparams.filters_meta[i] = 0;
+    ocparams.filter_params[i] = NULL;
+  }
+  ocparams.filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_SHUFFLE;
+#if defined(HAVE_PLUGINS)
+  ocparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_FILTER_BYTEDELTA;
+  ocparams.filters_meta[BLOSC2_MAX_FILTERS - 1] = sizeof(int32_t);
+#endif /* HAVE_PLUGINS */
+  blosc2_cparams pcparams = cparams;
+  pcparams.typesize = 1;
+  pcparams.schunk = NULL;
+
+  blosc2_context* octx = blosc2_create_cctx(ocparams);
+  blosc2_context* pctx = blosc2_create_cctx(pcparams);
+  int32_t* offsets = malloc((size_t)max_items * sizeof(int32_t) + 1);
+  uint8_t* payload = malloc((size_t)max_payload + 1);
+  int rc = 0;
+  if (octx == NULL || pctx == NULL || offsets == NULL || payload == NULL) {
+    BLOSC_TRACE_ERROR("Cannot create the contexts for the blocks");
+    rc = BLOSC2_ERROR_FAILURE;
+    goto out;
+  }
+
+  uint8_t* dest_ = dest;
+  int32_t pos = (int32_t)header_len;
+  int32_t item = 0;
+  for (int32_t nblock = 0; nblock < nblocks; nblock++) {
+    _sw32(dest_ + BLOSC2_VLCHUNK_HEADER_LENGTH + nblock * VLCHUNK_INDEX_ENTRY, item);
+    _sw32(dest_ + BLOSC2_VLCHUNK_HEADER_LENGTH + nblock * VLCHUNK_INDEX_ENTRY + 4, pos);
+    int32_t count = 0;
+    int32_t len = 0;
+    while (item < nitems && (count == 0 || (int64_t)len + sizes[item] <= batchsize)) {
+      if (sizes[item] > 0) {
+        memcpy(payload + len, items[item], sizes[item]);
+      }
+      len += sizes[item];
+      _sw32(&offsets[count], len);
+      count++;
+      item++;
+    }
+    int cbytes = blosc2_compress_ctx(octx, offsets, count * (int32_t)sizeof(int32_t),
+                                     dest_ + pos, destsize - pos);
+    if (cbytes <= 0) {
+      rc = cbytes;
+      goto out;
+    }
+    pos += cbytes;
+    cbytes = blosc2_compress_ctx(pctx, payload, len, dest_ + pos, destsize - pos);
+    if (cbytes <= 0) {
+      rc = cbytes;
+      goto out;
+    }
+    pos += cbytes;
+  }
+
+  memcpy(dest_, VLCHUNK_MAGIC, 4);
+  dest_[4] = BLOSC2_VLCHUNK_VERSION_FORMAT;
+  memset(dest_ + 5, 0, 3);
+  _sw32(dest_ + 8, nitems);
+  _sw32(dest_ + 12, nblocks);
+  _sw32(dest_ + 16, pos);
+  rc = pos;
+
+  out:
+  free(payload);
+  free(offsets);
+  if (octx != NULL) {
+    blosc2_free_ctx(octx);
+  }
+  if (pctx != NULL) {
+    blosc2_free_ctx(pctx);
+  }
+  return rc;
+}
+
+
+/* Check the header and the index of a chunk, and return its number of blocks */
+static int vlchunk_check(const uint8_t* chunk, int32_t cbytes, int32_t* nitems) {
+  if (chunk == NULL || cbytes < BLOSC2_VLCHUNK_HEADER_LENGTH || memcmp(chunk, VLCHUNK_MAGIC, 4) != 0) {
+    BLOSC_TRACE_ERROR("Not a chunk of variable-length items");
+    return BLOSC2_ERROR_INVALID_HEADER;
+  }
+  if (chunk[4] > BLOSC2_VLCHUNK_VERSION_FORMAT) {
+    BLOSC_TRACE_ERROR("The version of the chunk of variable-length items is not supported");
+    return BLOSC2_ERROR_VERSION_SUPPORT;
+  }
+  *nitems = sw32_(chunk + 8);
+  int32_t nblocks = sw32_(chunk + 12);
+  int32_t chunk_cbytes = sw32_(chunk + 16);
+  if (*nitems < 0 || nblocks < 0 || nblocks > *nitems || chunk_cbytes > cbytes ||
+      BLOSC2_VLCHUNK_HEADER_LENGTH + (int64_t)nblocks * VLCHUNK_INDEX_ENTRY > chunk_cbytes) {
+    BLOSC_TRACE_ERROR("The header of the chunk of variable-length items is corrupted");
+    return BLOSC2_ERROR_INVALID_HEADER;
+  }
+  return nblocks;
+}
+
+
+int blosc2_vlchunk_nitems(const void* chunk, int32_t cbytes) {
+  int32_t nitems;
+  int rc = vlchunk_check(chunk, cbytes, &nitems);
+  return rc < 0 ? rc : nitems;
+}
+
+
+int blosc2_vlchunk_getitem_ctx(blosc2_context* context, const void* chunk, int32_t cbytes,
+                               int32_t index, void* dest, int32_t destsize) {
+  const uint8_t* chunk_ = chunk;
+  int32_t nitems;
+  int32_t nblocks = vlchunk_check(chunk_, cbytes, &nitems);
+  if (nblocks < 0) {
+    return nblocks;
+  }
+  if (index < 0 || index >= nitems) {
+    BLOSC_TRACE_ERROR("The item %d is out of the chunk of %d items", index, nitems);
+    return BLOSC2_ERROR_INVALID_INDEX;
+  }
+  cbytes = sw32_(chunk_ + 16);
+
+  // The block with the item is the last one starting at or before it
+  const uint8_t* index_ = chunk_ + BLOSC2_VLCHUNK_HEADER_LENGTH;
+  int32_t lo = 0;
+  int32_t hi = nblocks - 1;
+  while (lo < hi) {
+    int32_t mid = lo + (hi - lo + 1) / 2;
+    if (sw32_(index_ + mid * VLCHUNK_INDEX_ENTRY) <= index) {
+      lo = mid;
+    }
+    else {
+      hi = mid - 1;
+    }
+  }
+  int32_t first_item = sw32_(index_ + lo * VLCHUNK_INDEX_ENTRY);
+  int32_t block_items = (lo + 1 < nblocks ? sw32_(index_ + (lo + 1) * VLCHUNK_INDEX_ENTRY) : nitems) - first_item;
+  int32_t offset = sw32_(index_ + lo * VLCHUNK_INDEX_ENTRY + 4);
+  int32_t nbytes;
+  int32_t ocbytes;
+  if (first_item > index || block_items <= 0 || offset < BLOSC2_VLCHUNK_HEADER_LENGTH || offset >= cbytes ||
+      blosc2_cbuffer_sizes(chunk_ + offset, &nbytes, &ocbytes, NULL) < 0 ||
+      ocbytes > cbytes - offset || nbytes != block_items * (int32_t)sizeof(int32_t)) {
+    BLOSC_TRACE_ERROR("The index of the chunk of variable-length items is corrupted");
+    return BLOSC2_ERROR_DATA;
+  }
+
+  // The end offsets of the previous and this item
+  int32_t local = index - first_item;
+  int32_t ends[2] = {0, 0};
+  int rc;
+  if (local > 0) {
+    rc = blosc2_getitem_ctx(context, chunk_ + offset, ocbytes, local - 1, 2, ends, sizeof(ends));
+  }
+  else {
+    rc = blosc2_getitem_ctx(context, chunk_ + offset, ocbytes, 0, 1, &ends[1], sizeof(int32_t));
+  }
+  if (rc < 0) {
+    return rc;
+  }
+  int32_t start = sw32_(&ends[0]);
+  int32_t end = sw32_(&ends[1]);
+  int32_t pcbytes;
+  offset += ocbytes;
+  if (offset >= cbytes || blosc2_cbuffer_sizes(chunk_ + offset, &nbytes, &pcbytes, NULL) < 0 ||
+      pcbytes > cbytes - offset || start < 0 || start > end || end > nbytes) {
+    BLOSC_TRACE_ERROR("The offsets of the chunk of variable-length items are corrupted");
+    return BLOSC2_ERROR_DATA;
+  }
+  if (dest == NULL || end == start) {
+    return end - start;
+  }
+  if (destsize < end - start) {
+    BLOSC_TRACE_ERROR("The item needs %d bytes, but dest only has %d", end - start, destsize);
+    return BLOSC2_ERROR_WRITE_BUFFER;
+  }
+
+  // Only the blocks of the payload with the bytes of the item are decompressed
+  rc = blosc2_getitem_ctx(context, chunk_ + offset, pcbytes, start, end - start, dest, destsize);
+  if (rc < 0) {
+    return rc;
+  }
+  return end - start;
+}
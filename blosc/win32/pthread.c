@@ -85,6 +85,9 @@ int win32_pthread_join(pthread_t *thread, void **value_ptr)
 	}
 }
 
+#if !defined(BLOSC_WIN32_NATIVE_THREADS)
+/* The native condition variables need none of this */
+
 int pthread_cond_init(pthread_cond_t *cond, const void *unused)
 {
 	PTHREAD_UNUSED_PARAM(unused);
@@ -224,4 +227,6 @@ int pthread_cond_broadcast(pthread_cond_t *cond)
 	return 0;
 }
 
+#endif /* BLOSC_WIN32_NATIVE_THREADS */
+
 #endif /* PTHREAD_C */
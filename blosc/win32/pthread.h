@@ -37,6 +37,27 @@
 
 #include "windows.h"
 
+#if defined(BLOSC_WIN32_NATIVE_THREADS)
+/*
+ * Slim reader/writer locks and native condition variables, which do not enter
+ * the kernel when there is no contention (Windows Vista and later)
+ */
+#define pthread_mutex_t SRWLOCK
+
+#define pthread_mutex_init(a,b) InitializeSRWLock((a))
+#define pthread_mutex_destroy(a) ((void)(a))
+#define pthread_mutex_lock AcquireSRWLockExclusive
+#define pthread_mutex_unlock ReleaseSRWLockExclusive
+
+#define pthread_cond_t CONDITION_VARIABLE
+
+#define pthread_cond_init(a,b) (InitializeConditionVariable((a)), 0)
+#define pthread_cond_destroy(a) ((void)(a), 0)
+#define pthread_cond_wait(a,b) (SleepConditionVariableSRW((a), (b), INFINITE, 0) ? 0 : -1)
+#define pthread_cond_signal(a) (WakeConditionVariable((a)), 0)
+#define pthread_cond_broadcast(a) (WakeAllConditionVariable((a)), 0)
+
+#else
 /*
  * Defines that adapt Windows API threads to pthreads API
  */
@@ -65,6 +86,8 @@ extern int pthread_cond_wait(pthread_cond_t *cond, CRITICAL_SECTION *mutex);
 extern int pthread_cond_signal(pthread_cond_t *cond);
 extern int pthread_cond_broadcast(pthread_cond_t *cond);
 
+#endif /* BLOSC_WIN32_NATIVE_THREADS */
+
 /*
  * Simple thread creation implementation using pthread API
  */
@@ -85,4 +108,15 @@ extern int pthread_create(pthread_t *thread, const void *unused,
 
 extern int win32_pthread_join(pthread_t *thread, void **value_ptr);
 
+/*
+ * Thread-local storage.  The destructors are not run when the threads exit,
+ * so the values must be released by other means.
+ */
+typedef DWORD pthread_key_t;
+
+#define pthread_key_create(k, d) ((void)(d), (*(k) = TlsAlloc()) == TLS_OUT_OF_INDEXES ? -1 : 0)
+#define pthread_key_delete(k) (TlsFree((k)) ? 0 : -1)
+#define pthread_getspecific(k) TlsGetValue((k))
+#define pthread_setspecific(k, v) (TlsSetValue((k), (LPVOID)(v)) ? 0 : -1)
+
 #endif /* PTHREAD_H */
@@ -0,0 +1,295 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "zonemap.h"
+#include "blosc-private.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+
+bool zonemap_supported(int kind, int32_t typesize) {
+  switch (kind) {
+    case BLOSC2_ZONEMAP_INT:
+    case BLOSC2_ZONEMAP_UINT:
+      return typesize == 1 || typesize == 2 || typesize == 4 || typesize == 8;
+    case BLOSC2_ZONEMAP_FLOAT:
+      return typesize == 4 || typesize == 8;
+    default:
+      return false;
+  }
+}
+
+
+/* The items may be unaligned, and memcpy() is what compilers turn into plain loads.  The
+ * branchless min/max let them vectorize the loops. */
+#define ZONEMAP_MINMAX(type, field)                       \
+  {                                                       \
+    type min_, max_;                                      \
+    memcpy(&min_, src, sizeof(type));                     \
+    max_ = min_;                                          \
+    for (int32_t i = 1; i < nitems; i++) {                \
+      type v;                                             \
+      memcpy(&v, src + (int64_t)i * sizeof(type), sizeof(type)); \
+      min_ = v < min_ ? v : min_;                         \
+      max_ = v > max_ ? v : max_;                         \
+    }                                                     \
+    zonemap->min.field = min_;                            \
+    zonemap->max.field = max_;                            \
+  }
+
+/* NaNs compare false, so they never become the min or the max */
+#define ZONEMAP_MINMAX_FLOAT(type)                        \
+  {                                                       \
+    type min_ = INFINITY, max_ = -INFINITY;               \
+    int32_t nnans = 0;                                    \
+    for (int32_t i = 0; i < nitems; i++) {                \
+      type v;                                             \
+      memcpy(&v, src + (int64_t)i * sizeof(type), sizeof(type)); \
+      nnans += v != v;                                    \
+      min_ = v < min_ ? v : min_;                         \
+      max_ = v > max_ ? v : max_;                         \
+    }                                                     \
+    zonemap->min.f = min_;                                \
+    zonemap->max.f = max_;                                \
+    zonemap->nnans = nnans;                               \
+  }
+
+void zonemap_compute(int kind, int32_t typesize, const uint8_t* src, int32_t nbytes,
+                     blosc2_zonemap* zonemap) {
+  int32_t nitems = nbytes / typesize;
+  memset(zonemap, 0, sizeof(blosc2_zonemap));
+  zonemap->nitems = nitems;
+  if (nitems == 0) {
+    return;
+  }
+  switch (kind) {
+    case BLOSC2_ZONEMAP_INT:
+      switch (typesize) {
+        case 1: ZONEMAP_MINMAX(int8_t, i) break;
+        case 2: ZONEMAP_MINMAX(int16_t, i) break;
+        case 4: ZONEMAP_MINMAX(int32_t, i) break;
+        case 8: ZONEMAP_MINMAX(int64_t, i) break;
+        default: break;
+      }
+      break;
+    case BLOSC2_ZONEMAP_UINT:
+      switch (typesize) {
+        case 1: ZONEMAP_MINMAX(uint8_t, u) break;
+        case 2: ZONEMAP_MINMAX(uint16_t, u) break;
+        case 4: ZONEMAP_MINMAX(uint32_t, u) break;
+        case 8: ZONEMAP_MINMAX(uint64_t, u) break;
+        default: break;
+      }
+      break;
+    case BLOSC2_ZONEMAP_FLOAT:
+      switch (typesize) {
+        case 4: ZONEMAP_MINMAX_FLOAT(float) break;
+        case 8: ZONEMAP_MINMAX_FLOAT(double) break;
+        default: break;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+
+void zonemap_merge(int kind, blosc2_zonemap* dest, const blosc2_zonemap* src) {
+  bool dest_values = dest->nitems > dest->nnans;
+  bool src_values = src->nitems > src->nnans;
+  if (src_values && !dest_values) {
+    dest->min = src->min;
+    dest->max = src->max;
+  }
+  else if (src_values) {
+    switch (kind) {
+      case BLOSC2_ZONEMAP_INT:
+        dest->min.i = src->min.i < dest->min.i ? src->min.i : dest->min.i;
+        dest->max.i = src->max.i > dest->max.i ? src->max.i : dest->max.i;
+        break;
+      case BLOSC2_ZONEMAP_UINT:
+        dest->min.u = src->min.u < dest->min.u ? src->min.u : dest->min.u;
+        dest->max.u = src->max.u > dest->max.u ? src->max.u : dest->max.u;
+        break;
+      case BLOSC2_ZONEMAP_FLOAT:
+        dest->min.f = src->min.f < dest->min.f ? src->min.f : dest->min.f;
+        dest->max.f = src->max.f > dest->max.f ? src->max.f : dest->max.f;
+        break;
+      default:
+        break;
+    }
+  }
+  dest->nitems += src->nitems;
+  dest->nnans += src->nnans;
+}
+
+
+bool zonemap_overlaps(int kind, const blosc2_zonemap* zonemap, const blosc2_zonemap_value* low,
+                      const blosc2_zonemap_value* high) {
+  if (zonemap->nitems <= zonemap->nnans) {
+    // NaNs are never within a range
+    return false;
+  }
+  switch (kind) {
+    case BLOSC2_ZONEMAP_INT:
+      return (low == NULL || zonemap->max.i >= low->i) && (high == NULL || zonemap->min.i <= high->i);
+    case BLOSC2_ZONEMAP_UINT:
+      return (low == NULL || zonemap->max.u >= low->u) && (high == NULL || zonemap->min.u <= high->u);
+    case BLOSC2_ZONEMAP_FLOAT:
+      // A NaN bound prunes nothing
+      return !((low != NULL && zonemap->max.f < low->f) || (high != NULL && zonemap->min.f > high->f));
+    default:
+      return true;
+  }
+}
+
+
+/* The index of every item is written, and the count only goes up for the matching ones, so
+ * that there are no branches in the way of the vectorizer */
+#define ZONEMAP_SELECT(type, wide_type)                   \
+  for (int32_t i = 0; i < nitems; i++) {                  \
+    type v;                                               \
+    memcpy(&v, src + (int64_t)i * sizeof(type), sizeof(type)); \
+    wide_type w = (wide_type)v;                           \
+    indices[n] = offset + i;                              \
+    n += (w >= lo) & (w <= hi);                           \
+  }
+
+int32_t zonemap_select(int kind, int32_t typesize, const uint8_t* src, int32_t nitems,
+                       const blosc2_zonemap_value* low, const blosc2_zonemap_value* high,
+                       int32_t offset, int32_t* indices) {
+  int32_t n = 0;
+  switch (kind) {
+    case BLOSC2_ZONEMAP_INT: {
+      int64_t lo = low != NULL ? low->i : INT64_MIN;
+      int64_t hi = high != NULL ? high->i : INT64_MAX;
+      switch (typesize) {
+        case 1: ZONEMAP_SELECT(int8_t, int64_t) break;
+        case 2: ZONEMAP_SELECT(int16_t, int64_t) break;
+        case 4: ZONEMAP_SELECT(int32_t, int64_t) break;
+        case 8: ZONEMAP_SELECT(int64_t, int64_t) break;
+        default: break;
+      }
+      break;
+    }
+    case BLOSC2_ZONEMAP_UINT: {
+      uint64_t lo = low != NULL ? low->u : 0;
+      uint64_t hi = high != NULL ? high->u : UINT64_MAX;
+      switch (typesize) {
+        case 1: ZONEMAP_SELECT(uint8_t, uint64_t) break;
+        case 2: ZONEMAP_SELECT(uint16_t, uint64_t) break;
+        case 4: ZONEMAP_SELECT(uint32_t, uint64_t) break;
+        case 8: ZONEMAP_SELECT(uint64_t, uint64_t) break;
+        default: break;
+      }
+      break;
+    }
+    case BLOSC2_ZONEMAP_FLOAT: {
+      // NaNs never match
+      double lo = low != NULL ? low->f : -INFINITY;
+      double hi = high != NULL ? high->f : INFINITY;
+      switch (typesize) {
+        case 4: ZONEMAP_SELECT(float, double) break;
+        case 8: ZONEMAP_SELECT(double, double) break;
+        default: break;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return n;
+}
+
+
+/* Integers are added as unsigned 64-bit ones, which wrap around instead of overflowing */
+#define ZONEMAP_SUM(type, wide_type)                      \
+  {                                                       \
+    uint64_t s = 0;                                       \
+    for (int32_t i = 0; i < nitems; i++) {                \
+      type v;                                             \
+      memcpy(&v, src + (int64_t)i * sizeof(type), sizeof(type)); \
+      s += (uint64_t)(wide_type)v;                        \
+    }                                                     \
+    sum->u = s;                                           \
+  }
+
+/* Floats are not reassociated by compilers, so there is a lane of doubles for every item of a
+ * run of eight, which they can vectorize as it is.  NaNs are left out. */
+#define ZONEMAP_SUM_FLOAT(type)                           \
+  {                                                       \
+    double lanes[8] = {0};                                \
+    int32_t i = 0;                                        \
+    for (; i + 8 <= nitems; i += 8) {                     \
+      for (int j = 0; j < 8; j++) {                       \
+        type v;                                           \
+        memcpy(&v, src + (int64_t)(i + j) * sizeof(type), sizeof(type)); \
+        lanes[j] += v == v ? (double)v : 0.;              \
+      }                                                   \
+    }                                                     \
+    for (; i < nitems; i++) {                             \
+      type v;                                             \
+      memcpy(&v, src + (int64_t)i * sizeof(type), sizeof(type)); \
+      lanes[0] += v == v ? (double)v : 0.;                \
+    }                                                     \
+    sum->f = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + \
+             ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])); \
+  }
+
+void zonemap_sum(int kind, int32_t typesize, const uint8_t* src, int32_t nitems, blosc2_zonemap_value* sum) {
+  memset(sum, 0, sizeof(blosc2_zonemap_value));
+  switch (kind) {
+    case BLOSC2_ZONEMAP_INT:
+      switch (typesize) {
+        case 1: ZONEMAP_SUM(int8_t, int64_t) break;
+        case 2: ZONEMAP_SUM(int16_t, int64_t) break;
+        case 4: ZONEMAP_SUM(int32_t, int64_t) break;
+        case 8: ZONEMAP_SUM(int64_t, int64_t) break;
+        default: break;
+      }
+      break;
+    case BLOSC2_ZONEMAP_UINT:
+      switch (typesize) {
+        case 1: ZONEMAP_SUM(uint8_t, uint64_t) break;
+        case 2: ZONEMAP_SUM(uint16_t, uint64_t) break;
+        case 4: ZONEMAP_SUM(uint32_t, uint64_t) break;
+        case 8: ZONEMAP_SUM(uint64_t, uint64_t) break;
+        default: break;
+      }
+      break;
+    case BLOSC2_ZONEMAP_FLOAT:
+      switch (typesize) {
+        case 4: ZONEMAP_SUM_FLOAT(float) break;
+        case 8: ZONEMAP_SUM_FLOAT(double) break;
+        default: break;
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+
+void zonemap_serialize(const blosc2_zonemap* zonemap, uint8_t* dest) {
+  to_big(dest, &zonemap->min, 8);
+  to_big(dest + 8, &zonemap->max, 8);
+  _sw32(dest + 16, zonemap->nnans);
+  _sw32(dest + 20, zonemap->nitems);
+}
+
+
+void zonemap_deserialize(blosc2_zonemap* zonemap, const uint8_t* src) {
+  from_big(&zonemap->min, src, 8);
+  from_big(&zonemap->max, src + 8, 8);
+  zonemap->nnans = sw32_(src + 16);
+  zonemap->nitems = sw32_(src + 20);
+}
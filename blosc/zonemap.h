@@ -0,0 +1,50 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_ZONEMAP_H
+#define BLOSC_ZONEMAP_H
+
+#include "blosc2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The size of a serialized zone map: the min, the max, nnans and nitems */
+#define ZONEMAP_SIZE (8 + 8 + 4 + 4)
+
+/* Whether items of `typesize` bytes can be summarized as `kind` (BLOSC2_ZONEMAP_*) */
+bool zonemap_supported(int kind, int32_t typesize);
+
+/* Summarize the whole items in the `nbytes` of `src` */
+void zonemap_compute(int kind, int32_t typesize, const uint8_t* src, int32_t nbytes,
+                     blosc2_zonemap* zonemap);
+
+/* Add the items summarized by `src` to `dest` */
+void zonemap_merge(int kind, blosc2_zonemap* dest, const blosc2_zonemap* src);
+
+/* Whether any of the items may be within [low, high] (a NULL bound is no bound) */
+bool zonemap_overlaps(int kind, const blosc2_zonemap* zonemap, const blosc2_zonemap_value* low,
+                      const blosc2_zonemap_value* high);
+
+/* Write the indices (plus `offset`) of the `nitems` items of `src` that are within
+ * [low, high] to `indices`, which has room for `nitems`.  Returns how many there are. */
+int32_t zonemap_select(int kind, int32_t typesize, const uint8_t* src, int32_t nitems,
+                       const blosc2_zonemap_value* low, const blosc2_zonemap_value* high,
+                       int32_t offset, int32_t* indices);
+
+/* Add up the `nitems` items of `src` (NaNs aside), as an int64, a uint64 or a double
+ * depending on `kind`.  Integers wrap around. */
+void zonemap_sum(int kind, int32_t typesize, const uint8_t* src, int32_t nitems, blosc2_zonemap_value* sum);
+
+void zonemap_serialize(const blosc2_zonemap* zonemap, uint8_t* dest);
+
+void zonemap_deserialize(blosc2_zonemap* zonemap, const uint8_t* src);
+
+#endif /* BLOSC_ZONEMAP_H */
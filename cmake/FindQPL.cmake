@@ -0,0 +1,51 @@
+# Find the Intel QPL (Query Processing Library), which offloads deflate to the
+# IAA (In-Memory Analytics Accelerator) when there is one, and falls back to
+# its software path otherwise.
+#
+# QPL_FOUND - System has QPL
+# QPL_INCLUDE_DIRS - QPL include files directories
+# QPL_LIBRARIES - The QPL libraries
+#
+# The environment variable QPLROOT is used to find the installation location.
+# If the environment variable is not set we'll look for it in the default installation locations.
+#
+# Usage:
+#
+# find_package(QPL)
+# if(QPL_FOUND)
+#     target_link_libraries(TARGET ${QPL_LIBRARIES})
+# endif()
+
+find_path(QPL_INCLUDE_DIR
+    qpl/qpl.h
+    PATHS
+        $ENV{QPLROOT}/include
+        /usr/local/include
+        /opt/intel/qpl/include
+)
+
+find_library(QPL_LIBRARY
+    NAMES qpl
+    PATHS
+        $ENV{QPLROOT}/lib
+        $ENV{QPLROOT}/lib64
+        /usr/local/lib
+        /usr/local/lib64
+        /opt/intel/qpl/lib
+        /opt/intel/qpl/lib64
+)
+
+if(QPL_INCLUDE_DIR AND QPL_LIBRARY)
+    set(QPL_FOUND TRUE)
+    set(QPL_INCLUDE_DIRS ${QPL_INCLUDE_DIR})
+    set(QPL_LIBRARIES ${QPL_LIBRARY})
+    if(QPL_LIBRARY MATCHES "\\.a$")
+        # The static library is written in C++, and loads the accelerator driver at runtime
+        set(QPL_LIBRARIES ${QPL_LIBRARIES} ${CMAKE_DL_LIBS} stdc++)
+    endif()
+    include_directories(${QPL_INCLUDE_DIRS})
+    message(STATUS "Found QPL libraries in: ${QPL_LIBRARIES}")
+else()
+    message(STATUS "No QPL libraries found.")
+    set(QPL_FOUND FALSE)
+endif()
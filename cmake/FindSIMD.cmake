@@ -20,6 +20,29 @@ if(CMAKE_SYSTEM_NAME MATCHES "Linux")
       set(AVX2_FOUND false CACHE BOOL "AVX2 available on host")
    endif()
 
+   string(REGEX REPLACE "^.*(avx512bw).*$" "\\1" SSE_THERE "${CPUINFO}")
+   string(COMPARE EQUAL "avx512bw" "${SSE_THERE}" AVX512_TRUE)
+   if(AVX512_TRUE)
+      set(AVX512_FOUND true CACHE BOOL "AVX512 available on host")
+   else()
+      set(AVX512_FOUND false CACHE BOOL "AVX512 available on host")
+   endif()
+
+   # aarch64 lists its features by name; RISC-V only has the ISA string
+   string(REGEX MATCH "Features[^\n]* sve( |\n|$)" SVE_THERE "${CPUINFO}")
+   if(SVE_THERE)
+      set(SVE_FOUND true CACHE BOOL "SVE available on host")
+   else()
+      set(SVE_FOUND false CACHE BOOL "SVE available on host")
+   endif()
+
+   string(REGEX MATCH "isa[\t ]*: rv64[a-uw-z]*v" RVV_THERE "${CPUINFO}")
+   if(RVV_THERE)
+      set(RVV_FOUND true CACHE BOOL "RVV available on host")
+   else()
+      set(RVV_FOUND false CACHE BOOL "RVV available on host")
+   endif()
+
 elseif(CMAKE_SYSTEM_NAME MATCHES "Darwin")
    exec_program("/usr/sbin/sysctl -a | grep machdep.cpu.features" OUTPUT_VARIABLE CPUINFO)
    string(REGEX REPLACE "^.*[^S](SSE2).*$" "\\1" SSE_THERE "${CPUINFO}")
@@ -39,13 +62,23 @@ elseif(CMAKE_SYSTEM_NAME MATCHES "Darwin")
       set(AVX2_FOUND false CACHE BOOL "AVX2 available on host")
    endif()
 
+   string(REGEX REPLACE "^.*(AVX512BW).*$" "\\1" SSE_THERE "${CPUINFO}")
+   string(COMPARE EQUAL "AVX512BW" "${SSE_THERE}" AVX512_TRUE)
+   if(AVX512_TRUE)
+      set(AVX512_FOUND true CACHE BOOL "AVX512 available on host")
+   else()
+      set(AVX512_FOUND false CACHE BOOL "AVX512 available on host")
+   endif()
+
 elseif(CMAKE_SYSTEM_NAME MATCHES "Windows")
    # TODO.  For now supposing SSE2 is safe enough
    set(SSE2_FOUND true  CACHE BOOL "SSE2 available on host")
    set(AVX2_FOUND false CACHE BOOL "AVX2 available on host")
+   set(AVX512_FOUND false CACHE BOOL "AVX512 available on host")
 else()
    set(SSE2_FOUND true  CACHE BOOL "SSE2 available on host")
    set(AVX2_FOUND false CACHE BOOL "AVX2 available on host")
+   set(AVX512_FOUND false CACHE BOOL "AVX512 available on host")
 endif()
 
 if(NOT SSE2_FOUND)
@@ -55,4 +88,8 @@ if(NOT AVX2_FOUND)
    message(STATUS "Could not find hardware support for AVX2 on this machine.")
 endif()
 
-mark_as_advanced(SSE2_FOUND AVX2_FOUND)
+if(NOT AVX512_FOUND)
+   message(STATUS "Could not find hardware support for AVX512 on this machine.")
+endif()
+
+mark_as_advanced(SSE2_FOUND AVX2_FOUND AVX512_FOUND SVE_FOUND RVV_FOUND)
@@ -50,6 +50,73 @@ extern "C" {
  */
 #define DTYPE_NUMPY_FORMAT 0
 
+/* The default bound for the items in flight when copying arrays into other chunks (see b2nd_rechunk) */
+#define B2ND_DEFAULT_RECHUNK_MEM ((int64_t) 256 * 1024 * 1024)
+
+/* The size of the chunks chosen when the L3 cache cannot be detected (see b2nd_create_ctx) */
+#define B2ND_DEFAULT_CHUNK_NBYTES (2 * 1024 * 1024)
+
+/**
+ * @brief The orders in which the chunks of an array are laid out in its frame.
+ *
+ * The chunks are numbered in the C order of their coordinates in the grid of chunks
+ * anyway, but the ones of contiguous frames can be written along a space-filling curve,
+ * so that the chunks of a region of the array lie close together in the frame.
+ */
+enum {
+  B2ND_CHUNK_ORDER_C = 0,
+  //!< The C order of the chunks (the default).
+  B2ND_CHUNK_ORDER_MORTON = 1,
+  //!< The Z-order curve (the bits of the coordinates of the chunks interleaved).
+  B2ND_CHUNK_ORDER_HILBERT = 2,
+  //!< The Hilbert curve, which keeps the consecutive chunks next to each other.
+};
+
+/**
+ * @brief The ways in which arrays are accessed, which the chunks and blocks chosen for them
+ * follow (see b2nd_ctx_set_access_pattern()).
+ */
+enum {
+  B2ND_ACCESS_SCANS = 0,
+  //!< Scans in C order, so the chunks take whole rows of the last dimensions (the default).
+  B2ND_ACCESS_AXIS_SLICES = 1,
+  //!< Slices with a single index along an axis, so the chunks take one along it.
+  B2ND_ACCESS_CUBES = 2,
+  //!< Regions anywhere, so the chunks are as close to cubes as the shape allows.
+};
+
+/* The maximum number of levels of the pyramids of arrays */
+#define B2ND_PYRAMID_MAX_LEVELS 16
+
+/**
+ * @brief The ways in which the items of an array are reduced to the ones of the levels of
+ * its pyramid (see b2nd_pyramid_new()).
+ */
+enum {
+  B2ND_PYRAMID_NEAREST = 0,
+  //!< The first item of every window, for any data type.
+  B2ND_PYRAMID_MEAN = 1,
+  //!< The mean of the items of every window (rounded for integers), for numbers only.
+  B2ND_PYRAMID_MAX = 2,
+  //!< The maximum of the items of every window, for numbers only.
+};
+
+/* The maximum number of different arrays in an expression */
+#define B2ND_EXPR_MAX_ARRAYS 32
+
+/**
+ * @brief The operations of element-wise expressions (see b2nd_expr_push_op()).
+ */
+enum {
+  B2ND_EXPR_ADD = 0,
+  B2ND_EXPR_SUB = 1,
+  B2ND_EXPR_MUL = 2,
+  B2ND_EXPR_DIV = 3,
+  //!< Integers divided by 0 give 0.
+  B2ND_EXPR_MIN = 4,
+  B2ND_EXPR_MAX = 5,
+};
+
 /* The default data type */
 #define B2ND_DEFAULT_DTYPE "|u1"
 /* The default data format */
@@ -73,6 +140,26 @@ struct chunk_cache_s {
  */
 typedef struct b2nd_context_s b2nd_context_t;   /* opaque type */
 
+/**
+ * @brief An iterator over the chunks of an array that hold items other than a fill value.
+ */
+typedef struct b2nd_sparse_iter_s b2nd_sparse_iter_t;   /* opaque type */
+
+/**
+ * @brief An iterator over the blocks of an array, reading the chunks ahead.
+ */
+typedef struct b2nd_block_iter_s b2nd_block_iter_t;   /* opaque type */
+
+/**
+ * @brief A lazy view of the items of an array, sliced with steps and squeezed.
+ */
+typedef struct b2nd_view_s b2nd_view_t;   /* opaque type */
+
+/**
+ * @brief An element-wise expression over arrays, evaluated lazily (see b2nd_expr_eval()).
+ */
+typedef struct b2nd_expr_s b2nd_expr_t;   /* opaque type */
+
 /**
  * @brief A multidimensional array of data that can be compressed.
  */
@@ -119,6 +206,12 @@ typedef struct {
   //!< Data type. Different formats can be supported (see dtype_format).
   int8_t dtype_format;
   //!< The format of the data type.  Default is DTYPE_NUMPY_FORMAT.
+  void *write_cache;
+  //!< The chunks that have been set and are written back later (see b2nd_set_write_cache()). NULL if disabled.
+  int8_t chunk_order;
+  //!< The order in which the chunks are laid out in the frame (see b2nd_ctx_set_chunk_order()).
+  void *pyramid;
+  //!< The levels of lower resolution of the array (see b2nd_pyramid_new()). NULL if none.
 } b2nd_array_t;
 
 
@@ -128,8 +221,10 @@ typedef struct {
  * @param b2_storage The Blosc2 storage params.
  * @param ndim The dimensions.
  * @param shape The shape.
- * @param chunkshape The chunk shape.
- * @param blockshape The block shape.
+ * @param chunkshape The chunk shape.  NULL (or all zeros) chooses a chunk of about the share
+ * of a core in the L3 cache.
+ * @param blockshape The block shape.  NULL (or all zeros) chooses a block that a thread can
+ * compress within the L2 cache.
  * @param dtype The data type expressed as a string version.
  * @param dtype_format The data type format; default is DTYPE_NUMPY_FORMAT.
  * @param metalayers The memory pointer to the list of the metalayers desired.
@@ -139,6 +234,9 @@ typedef struct {
  *
  * @note The pointer returned must be freed when not used anymore with #b2nd_free_ctx.
  *
+ * @note The shapes chosen follow scans in C order, unless otherwise told with
+ * #b2nd_ctx_set_access_pattern.
+ *
  */
 BLOSC_EXPORT b2nd_context_t *
 b2nd_create_ctx(const blosc2_storage *b2_storage, int8_t ndim, const int64_t *shape, const int32_t *chunkshape,
@@ -158,6 +256,42 @@ b2nd_create_ctx(const blosc2_storage *b2_storage, int8_t ndim, const int64_t *sh
  */
 BLOSC_EXPORT int b2nd_free_ctx(b2nd_context_t *ctx);
 
+/**
+ * @brief Set the order in which the chunks of the arrays created with a context are laid out.
+ *
+ * The chunks that the slices set into the array are written in that order (see
+ * #b2nd_reorder_chunks for the ones written otherwise), and the order is recorded in the
+ * b2nd metalayer, which the versions that do not know about it read as usual.
+ *
+ * @param ctx The b2nd context.
+ * @param chunk_order One of the B2ND_CHUNK_ORDER_* values.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_ctx_set_chunk_order(b2nd_context_t *ctx, int8_t chunk_order);
+
+/**
+ * @brief Choose the chunks and blocks left to choose in a context for an access pattern.
+ *
+ * @param ctx The b2nd context.
+ * @param access_pattern One of the B2ND_ACCESS_* values.
+ * @param axis The axis of the slices for B2ND_ACCESS_AXIS_SLICES (ignored otherwise).
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_ctx_set_access_pattern(b2nd_context_t *ctx, int8_t access_pattern, int8_t axis);
+
+/**
+ * @brief Get the chunk and block shapes of a context (chosen or not).
+ *
+ * @param ctx The b2nd context.
+ * @param chunkshape The chunk shape (output).
+ * @param blockshape The block shape (output).
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_ctx_get_shapes(const b2nd_context_t *ctx, int32_t *chunkshape, int32_t *blockshape);
+
 
 /**
  * @brief Create an uninitialized array.
@@ -170,6 +304,22 @@ BLOSC_EXPORT int b2nd_free_ctx(b2nd_context_t *ctx);
 BLOSC_EXPORT int b2nd_uninit(b2nd_context_t *ctx, b2nd_array_t **array);
 
 
+/**
+ * @brief Create an array whose values are generated on read by a postfilter.
+ *
+ * Nothing is stored for the chunks (see #blosc2_chunk_virtual), so this is meant for arrays
+ * defined by a formula (like coordinate grids) that are only read, e.g. as operands.
+ * The postfilter (or block postfilter) goes in the dparams of the storage of @p ctx; it gets
+ * the nchunk and the offset of every block, so that it can compute their coordinates.
+ *
+ * @param ctx The b2nd context for the new array.
+ * @param array The memory pointer where the array will be created.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_virtual(b2nd_context_t *ctx, b2nd_array_t **array);
+
+
 /**
  * @brief Create an empty array.
  *
@@ -271,6 +421,40 @@ BLOSC_EXPORT int b2nd_open(const char *urlpath, b2nd_array_t **array);
  */
 BLOSC_EXPORT int b2nd_open_offset(const char *urlpath, b2nd_array_t **array, int64_t offset);
 
+/**
+ * @brief Open a b2nd array from a file using a user-defined I/O interface.
+ *
+ * @param urlpath The path of the b2nd array (on disk, or in an object store).
+ * @param array The memory pointer where the array info will be stored.
+ * @param udio The user-defined I/O interface (e.g. BLOSC2_IO_OBJECT_STORE).
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_open_udio(const char *urlpath, b2nd_array_t **array, const blosc2_io *udio);
+
+/**
+ * @brief Write a b2nd array to an archive under @p name (see blosc2_archive_writer_new()).
+ *
+ * @param writer The writer of the archive.
+ * @param name The name of the array in the archive.
+ * @param array The array to write.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_archive_add(blosc2_archive_writer *writer, const char *name, const b2nd_array_t *array);
+
+/**
+ * @brief Open the b2nd array called @p name of an archive without copying it (see
+ * blosc2_archive_open_schunk()).  The archive must outlive the array, which is read-only.
+ *
+ * @param archive The archive.
+ * @param name The name of the array in the archive.
+ * @param array The memory pointer where the array info will be stored.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_archive_open(blosc2_archive *archive, const char *name, b2nd_array_t **array);
+
 /**
  * @brief Save b2nd array into a specific urlpath.
  *
@@ -304,6 +488,20 @@ BLOSC_EXPORT int b2nd_from_cbuffer(b2nd_context_t *ctx, b2nd_array_t **array, co
  */
 BLOSC_EXPORT int b2nd_to_cbuffer(const b2nd_array_t *array, void *buffer, int64_t buffersize);
 
+/**
+ * @brief Extract the data from a b2nd array into a C buffer with its dimensions permuted.
+ *
+ * @param array The b2nd array.
+ * @param axes The dimension of the array that goes in every dimension of the buffer
+ * (e.g. the reversed dimensions give the Fortran order).
+ * @param buffer The buffer where the data will be stored.
+ * @param buffersize Size (in bytes) of the buffer.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_to_cbuffer_permuted(const b2nd_array_t *array, const int8_t *axes, void *buffer,
+                                          int64_t buffersize);
+
 /**
  * @brief Get a slice from an array and store it into a new array.
  *
@@ -375,6 +573,192 @@ BLOSC_EXPORT int b2nd_get_slice_cbuffer(const b2nd_array_t *array, const int64_t
 BLOSC_EXPORT int b2nd_set_slice_cbuffer(const void *buffer, const int64_t *buffershape, int64_t buffersize,
                                         const int64_t *start, const int64_t *stop, b2nd_array_t *array);
 
+/**
+ * @brief Set up a write-back cache for the chunks of an array.
+ *
+ * The chunks that slices are set into are kept decompressed in the cache, and
+ * they are only compressed and written to the super-chunk when they are evicted
+ * (the least recently used first) or flushed, so that lots of small slices set
+ * into the same chunks take a compression and a write per chunk.  Slices got
+ * from the array see the chunks in the cache, and the rest of the functions
+ * flush them first.
+ *
+ * @param array The array.
+ * @param max_nbytes The size of the cache, which has to hold a (padded) chunk at
+ * least.  0 flushes the chunks and disables it.
+ *
+ * @return An error code.
+ *
+ * @warning The super-chunk of the array does not see the chunks in the cache until
+ * they are flushed with #b2nd_flush.
+ */
+BLOSC_EXPORT int b2nd_set_write_cache(b2nd_array_t *array, int64_t max_nbytes);
+
+/**
+ * @brief Write the chunks in the write cache of an array to its super-chunk.
+ *
+ * @param array The array.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_flush(b2nd_array_t *array);
+
+/**
+ * @brief Rewrite the chunks of an array in a contiguous frame in the order of the array.
+ *
+ * The chunks that are appended, inserted or updated one by one go to the end of the frame,
+ * so this lays them all out again one after the other in the order of the array (see
+ * #b2nd_ctx_set_chunk_order), and reclaims the space of the old ones (see
+ * #blosc2_schunk_compact).  Arrays that are not in contiguous frames are left as they are.
+ *
+ * @param array The array.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_reorder_chunks(b2nd_array_t *array);
+
+/**
+ * @brief Get a slice from an array and store it into a strided C buffer.
+ *
+ * Like #b2nd_get_slice_cbuffer, but the items are copied straight from the
+ * decompressed blocks into a buffer with any layout (e.g. a view of a NumPy
+ * array), with no temporary C-ordered copy in between.
+ *
+ * @param array The array from which the slice will be extracted.
+ * @param start The coordinates where the slice will begin.
+ * @param stop The coordinates where the slice will end.
+ * @param buffer Where the first item of the slice will be stored.
+ * @param bufferstrides The strides (in bytes, possibly negative) of every dimension of the buffer.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_get_slice_cbuffer_strided(const b2nd_array_t *array, const int64_t *start,
+                                                const int64_t *stop, void *buffer,
+                                                const int64_t *bufferstrides);
+
+/**
+ * @brief Get every @p step -th item along each dimension of a slice of an array into a C buffer.
+ *
+ * Only the chunks and, in them, the blocks holding some of the items are read and
+ * decompressed, so when the steps span several blocks the cost falls with them.  This is
+ * meant for previews and decimations.
+ *
+ * @param array The array from which the items will be extracted.
+ * @param start The coordinates where the slice will begin.
+ * @param stop The coordinates where the slice will end.
+ * @param step The distance between the items got along every dimension (at least 1).
+ * @param buffer The buffer where the items will be stored.
+ * @param buffershape The shape of the buffer (at least `(stop - start + step - 1) / step`).
+ * @param buffersize The size (in bytes) of the buffer.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_get_slice_cbuffer_step(const b2nd_array_t *array, const int64_t *start, const int64_t *stop,
+                                            const int64_t *step, void *buffer, const int64_t *buffershape,
+                                            int64_t buffersize);
+
+/**
+ * @brief Build a pyramid of levels of lower resolution for an array.
+ *
+ * Every level is an array whose items are the reductions of windows of @p factors items
+ * of the level below it (the array itself being the level 0), so coarse views of large
+ * arrays are read from small ones.  The levels are compressed like the array and, for
+ * arrays on disk, stored next to it (as `<urlpath>.level<n>`) and opened along with it.
+ *
+ * The levels are kept up to date by b2nd_set_slice_cbuffer(), b2nd_set_slice_cbuffer_strided()
+ * and b2nd_append(), which recompute just the windows of the items written.  After any other
+ * change of the array (inserting, deleting, resizing...), the pyramid has to be built again.
+ *
+ * @param array The array.
+ * @param nlevels The number of levels (up to #B2ND_PYRAMID_MAX_LEVELS).  0 removes the pyramid.
+ * @param factors The reduction factor of every dimension (at least 1, and more than 1 for some).
+ * @param reduction How the windows are reduced (see #B2ND_PYRAMID_MEAN and friends).
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_pyramid_new(b2nd_array_t *array, int nlevels, const int32_t *factors, int8_t reduction);
+
+/**
+ * @brief Get the number of levels of the pyramid of an array (0 if it has none).
+ *
+ * @param array The array.
+ *
+ * @return The number of levels or an error code.
+ */
+BLOSC_EXPORT int b2nd_pyramid_nlevels(const b2nd_array_t *array);
+
+/**
+ * @brief Get a level of the pyramid of an array.
+ *
+ * @param array The array.
+ * @param level The level (0 for the array itself).
+ * @param level_array The pointer where the level is returned.  It is owned by the array,
+ * and is not to be changed or freed.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_pyramid_get_level(const b2nd_array_t *array, int level, b2nd_array_t **level_array);
+
+/**
+ * @brief Get every @p step -th item of a slice of an array, read from the coarsest level of
+ * its pyramid whose items are not further apart than the steps.
+ *
+ * Every item comes from the item of the level whose window holds it, so the buffer is
+ * like the one of b2nd_get_slice_cbuffer_step(), with the reduced items in place of the
+ * sampled ones.  Without a pyramid, it is just b2nd_get_slice_cbuffer_step().
+ *
+ * @param array The array.
+ * @param start The coordinates where the slice will begin (in the array).
+ * @param stop The coordinates where the slice will end (in the array).
+ * @param step The distance between the items got along every dimension (at least 1).
+ * @param buffer The buffer where the items will be stored.
+ * @param buffershape The shape of the buffer (at least `(stop - start + step - 1) / step`).
+ * @param buffersize The size (in bytes) of the buffer.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_pyramid_get_slice_cbuffer(const b2nd_array_t *array, const int64_t *start,
+                                                const int64_t *stop, const int64_t *step, void *buffer,
+                                                const int64_t *buffershape, int64_t buffersize);
+
+/**
+ * @brief Set a slice in a b2nd array using a strided C buffer.
+ *
+ * Like #b2nd_set_slice_cbuffer, but the items are copied straight from a
+ * buffer with any layout into the blocks to be compressed.
+ *
+ * @param buffer Where the first item of the slice is.
+ * @param bufferstrides The strides (in bytes, possibly negative) of every dimension of the buffer.
+ * @param start The coordinates where the slice will begin.
+ * @param stop The coordinates where the slice will end.
+ * @param array The b2nd array where the slice will be set.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_set_slice_cbuffer_strided(const void *buffer, const int64_t *bufferstrides,
+                                                const int64_t *start, const int64_t *stop,
+                                                b2nd_array_t *array);
+
+/**
+ * @brief Get a slice from an array and store it into a C buffer with its dimensions permuted.
+ *
+ * The buffer is C-ordered with shape `stop[axes[i]] - start[axes[i]]` for every
+ * dimension `i`, so the reversed dimensions give the Fortran order.  The items
+ * are transposed tile by tile right after every block is decompressed.
+ *
+ * @param array The array from which the slice will be extracted.
+ * @param start The coordinates where the slice will begin.
+ * @param stop The coordinates where the slice will end.
+ * @param axes The dimension of the array that goes in every dimension of the buffer.
+ * @param buffer The buffer for getting the data.
+ * @param buffersize The size (in bytes) of the buffer.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_get_slice_cbuffer_permuted(const b2nd_array_t *array, const int64_t *start,
+                                                 const int64_t *stop, const int8_t *axes, void *buffer,
+                                                 int64_t buffersize);
+
 /**
  * @brief Make a copy of the array data. The copy is done into a new b2nd array.
  *
@@ -389,6 +773,144 @@ BLOSC_EXPORT int b2nd_set_slice_cbuffer(const void *buffer, const int64_t *buffe
  */
 BLOSC_EXPORT int b2nd_copy(b2nd_context_t *ctx, const b2nd_array_t *src, b2nd_array_t **array);
 
+/**
+ * @brief Make a copy of the array data into other chunks, with bounded memory.
+ *
+ * The items are copied a region at a time, with regions made of whole chunks of both
+ * arrays, so that every chunk of @p src is decompressed once and the chunks of the copy
+ * are compressed once.  The chunks of a region are (de)compressed in parallel when the
+ * shared pool of threads is active (see #blosc2_set_shared_threadpool).  When the smallest
+ * of such regions does not fit in @p max_mem (e.g. from chunks along the first dimension to
+ * chunks along the last one), the items go through an intermediate array with smaller
+ * chunks, so that they are read and written in regions that fit.  #b2nd_copy does the same
+ * with #B2ND_DEFAULT_RECHUNK_MEM.
+ *
+ * @param ctx The b2nd context for the new array.
+ * @param src The array from which data is copied.
+ * @param max_mem The maximum size (in bytes) of the uncompressed items in flight.  A chunk
+ * of each array is always read or written in one go, though.
+ * @param tmp_urlpath The path of the intermediate array when one is needed (it is removed
+ * afterwards).  If NULL, the intermediate array is kept (compressed) in memory.
+ * @param array The memory pointer where the array will be created.
+ *
+ * @return An error code
+ *
+ * @note The ndim and shape in ctx will be overwritten by the src ctx.
+ */
+BLOSC_EXPORT int b2nd_rechunk(b2nd_context_t *ctx, const b2nd_array_t *src, int64_t max_mem,
+                              const char *tmp_urlpath, b2nd_array_t **array);
+
+/**
+ * @brief Count the fill chunks of an array, and the items in them.
+ *
+ * Fill chunks are the ones made of a value repeated (zeros, NaNs, a generic value or
+ * uninitialized items), like the ones of #b2nd_zeros, #b2nd_full or #b2nd_empty, which
+ * take no room for their items.  Only the headers of the chunks are read.
+ *
+ * @param array The array.
+ * @param nfill_chunks The pointer where the number of fill chunks will be put.
+ * @param nfill_items The pointer where the number of items in fill chunks (within the
+ * shape) will be put.  The fill fraction is this over the number of items of the array.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_count_fill(const b2nd_array_t *array, int64_t *nfill_chunks, int64_t *nfill_items);
+
+/**
+ * @brief Create an iterator over the chunks of an array that are not fill chunks.
+ *
+ * Sparse reductions and copies can go through the items of these chunks only, as the
+ * rest of the items are the fill value (see #b2nd_count_fill).
+ *
+ * @param array The array.  It must outlive the iterator and not change while iterating.
+ * @param iter The pointer where the iterator will be created.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_sparse_iter_new(const b2nd_array_t *array, b2nd_sparse_iter_t **iter);
+
+/**
+ * @brief Get the items of the next chunk that is not a fill chunk.
+ *
+ * @param iter The iterator.
+ * @param start The array where the coordinates of the first item of the chunk will be put.
+ * @param stop The array where the coordinates past the last item of the chunk (clipped by
+ * the shape) will be put.
+ * @param data The pointer where the items of the chunk (in C order, with the shape
+ * @p stop - @p start) will be put.  They are owned by the iterator, and are valid until
+ * the next call.
+ *
+ * @return 1 when a chunk is got, 0 when there are no more chunks, or a negative error code.
+ */
+BLOSC_EXPORT int b2nd_sparse_iter_next(b2nd_sparse_iter_t *iter, int64_t *start, int64_t *stop, void **data);
+
+/**
+ * @brief Free an iterator over the chunks of an array.
+ *
+ * @param iter The iterator.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_sparse_iter_free(b2nd_sparse_iter_t *iter);
+
+/**
+ * @brief Create an iterator over the blocks of an array.
+ *
+ * The blocks come chunk by chunk, in the order of the super-chunk, and in C order
+ * within each chunk.  Each chunk is decompressed once into a buffer of the iterator,
+ * and the next one is decompressed in the background (on the shared pool of threads
+ * when there is one, see #blosc2_set_shared_threadpool) while the blocks of the current
+ * one are used.  Chunks are not read ahead when the array has a postfilter.
+ *
+ * An iterator must be used by a single thread; threads can have iterators of their own
+ * over the same array as long as it does not change.
+ *
+ * @param array The array.  It must outlive the iterator and not change while iterating.
+ * @param iter The pointer where the iterator will be created.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_iter_blocks(const b2nd_array_t *array, b2nd_block_iter_t **iter);
+
+/**
+ * @brief Get the items of the next block.
+ *
+ * @param iter The iterator.
+ * @param start The array where the coordinates of the first item of the block will be put.
+ * @param stop The array where the coordinates past the last item of the block (clipped by
+ * the chunk and the shape) will be put.
+ * @param data The pointer where the items of the block will be put.  They are in C order
+ * with the shape of the blocks of the array (the items past @p stop are padding).  They
+ * are owned by the iterator, and are valid until the next call.
+ *
+ * @return 1 when a block is got, 0 when there are no more blocks, or a negative error code.
+ */
+BLOSC_EXPORT int b2nd_block_iter_next(b2nd_block_iter_t *iter, int64_t *start, int64_t *stop, void **data);
+
+/**
+ * @brief Free an iterator over the blocks of an array, waiting for the chunk read ahead.
+ *
+ * @param iter The iterator.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_block_iter_free(b2nd_block_iter_t *iter);
+
+/**
+ * @brief Reduce the items of an array, decompressing only what cannot be worked out otherwise.
+ *
+ * This is #blosc2_schunk_reduce on the super-chunk of the array, with the items read as
+ * told by its NumPy dtype (signed and unsigned integers, booleans and floats, in little
+ * endian), and with the padding of the chunks and the blocks left out.
+ *
+ * @param array The array.
+ * @param ops The reductions to compute (#BLOSC2_REDUCE_SUM and friends).
+ * @param result The pointer where the result will be put.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_reduce(const b2nd_array_t *array, int ops, blosc2_reduction *result);
+
 /**
  * @brief Print metalayer parameters.
  *
@@ -401,9 +923,14 @@ BLOSC_EXPORT int b2nd_print_meta(const b2nd_array_t *array);
 /**
  * @brief Resize the shape of an array
  *
+ * The chunks with no items deleted or moved go as they are, and so do the ones whose items
+ * move by a multiple of the chunkshape.  Only the chunks whose items go to other positions
+ * of them are rewritten (the ones past @p start, if the change is not such a multiple).
+ *
  * @param array The array to be resized.
  * @param new_shape The new shape from the array.
- * @param start The position in which the array will be extended or shrunk.
+ * @param start The position in which the array will be extended (with zeros) or shrunk.
+ * NULL means the end of the array.
  *
  * @return An error code
  */
@@ -437,12 +964,54 @@ BLOSC_EXPORT int b2nd_insert(b2nd_array_t *array, const void *buffer, int64_t bu
 BLOSC_EXPORT int b2nd_append(b2nd_array_t *array, const void *buffer, int64_t buffersize,
                              int8_t axis);
 
+/**
+ * @brief Concatenate two arrays along an axis.
+ *
+ * When the chunks (and blocks) of both arrays have the same shape, and the items of @p src1
+ * along @p axis fill whole chunks, the chunks of @p src2 are moved as they are, with no
+ * decompression (and in one go when they all go after the ones of @p src1, as with the
+ * first axis).  Else the chunks of the result past the items of @p src1 are filled with
+ * the ones of @p src2, one at a time.
+ *
+ * @param ctx The b2nd context for the new array (only used when @p copy is true).
+ * @param src1 The first array.
+ * @param src2 The array whose items go after the ones of @p src1.  It must have the
+ * typesize of @p src1, and its shape too but for @p axis.
+ * @param axis The axis along which the arrays are concatenated.
+ * @param copy Whether the result is a copy of @p src1 (made with #b2nd_copy), or @p src1
+ * itself, extended in place.
+ * @param array The memory pointer where the resulting array will be returned.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_concatenate(b2nd_context_t *ctx, const b2nd_array_t *src1, const b2nd_array_t *src2,
+                                  int8_t axis, bool copy, b2nd_array_t **array);
+
+/**
+ * @brief Stack arrays of the same shape along a new axis.
+ *
+ * The chunks of the arrays are moved as they are into the result when its chunks (and
+ * blocks) have the shape of the ones of the arrays with a 1 inserted at @p axis.  Else
+ * the items of every array are copied to their place in the chunks of the result.
+ *
+ * @param ctx The b2nd context for the new array, with one dimension more than the arrays
+ * (its shape is overwritten).
+ * @param srcs The arrays to stack.
+ * @param nsrcs The number of arrays to stack.
+ * @param axis The position of the new axis in the result.
+ * @param array The memory pointer where the resulting array will be created.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_stack(b2nd_context_t *ctx, const b2nd_array_t **srcs, int nsrcs, int8_t axis,
+                            b2nd_array_t **array);
+
 /**
  * @brief Delete shrinking the given axis delete_len items.
  *
  * @param array The array to shrink.
  * @param axis The axis to shrink.
- * @param delete_start The start position from the axis to start deleting chunks.
+ * @param delete_start The start position from the axis to start deleting items.
  * @param delete_len The number of items to delete to the array->shape[axis].
  *   The newshape[axis] will be the old array->shape[axis] - delete_len
  *
@@ -492,6 +1061,230 @@ BLOSC_EXPORT int b2nd_set_orthogonal_selection(b2nd_array_t *array, int64_t **se
                                                int64_t *selection_size, const void *buffer,
                                                int64_t *buffershape, int64_t buffersize);
 
+/**
+ * @brief Get the elements of an array at a list of points.
+ *
+ * The points are grouped by chunk and block, so that every block with points is
+ * decompressed once, and the chunks are processed in parallel on the shared
+ * thread pool (see blosc2_set_shared_threadpool()) when possible.
+ *
+ * @param array The array to get the data from.
+ * @param coords The coordinates of the points, one after another (@p npoints x ndim).
+ * @param npoints The number of points.
+ * @param buffer The buffer for getting the elements, in the order of the points.
+ * @param buffersize The buffer size (in bytes).
+ *
+ * @return An error code.
+ *
+ * @note See also b2nd_set_coordinate_selection and b2nd_get_mask_selection.
+ */
+BLOSC_EXPORT int b2nd_get_coordinate_selection(const b2nd_array_t *array, const int64_t *coords,
+                                               int64_t npoints, void *buffer, int64_t buffersize);
+
+/**
+ * @brief Set the elements of an array at a list of points.
+ *
+ * Every chunk with points is recompressed once.  When a point is repeated, the
+ * last element for it is set.
+ *
+ * @param array The array to set the data to.
+ * @param coords The coordinates of the points, one after another (@p npoints x ndim).
+ * @param npoints The number of points.
+ * @param buffer The buffer with the elements, in the order of the points.
+ * @param buffersize The buffer size (in bytes).
+ *
+ * @return An error code.
+ *
+ * @note See also b2nd_get_coordinate_selection.
+ */
+BLOSC_EXPORT int b2nd_set_coordinate_selection(b2nd_array_t *array, const int64_t *coords,
+                                               int64_t npoints, const void *buffer, int64_t buffersize);
+
+/**
+ * @brief Get the elements of an array where a boolean mask is true.
+ *
+ * @param array The array to get the data from.
+ * @param mask The mask, with the shape of the array (in C order).
+ * @param buffer The buffer for getting the elements, in C order.
+ * @param buffersize The buffer size (in bytes).
+ * @param nselected The number of elements selected by the mask.
+ *
+ * @return An error code.
+ *
+ * @note See also b2nd_get_coordinate_selection.
+ */
+BLOSC_EXPORT int b2nd_get_mask_selection(const b2nd_array_t *array, const bool *mask, void *buffer,
+                                         int64_t buffersize, int64_t *nselected);
+
+/**
+ * @brief Set the elements of an array where a boolean mask is true.
+ *
+ * @param array The array to set the data to.
+ * @param mask The mask, with the shape of the array (in C order).
+ * @param buffer The buffer with the elements, in C order.
+ * @param buffersize The buffer size (in bytes).
+ *
+ * @return An error code.
+ *
+ * @note See also b2nd_get_mask_selection.
+ */
+BLOSC_EXPORT int b2nd_set_mask_selection(b2nd_array_t *array, const bool *mask, const void *buffer,
+                                         int64_t buffersize);
+
+/**
+ * @brief Create a view of a whole array.
+ *
+ * Views are sliced (see #b2nd_view_slice) and squeezed (see #b2nd_view_squeeze)
+ * with no data movement, and their items are only read when they are got with
+ * #b2nd_view_to_cbuffer or #b2nd_view_get_slice_cbuffer.
+ *
+ * @param array The array, which has to outlive the view (and the views sliced from it).
+ * @param view The new view.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_view_new(const b2nd_array_t *array, b2nd_view_t **view);
+
+/**
+ * @brief Create a view of a slice of a view, which costs O(ndim).
+ *
+ * @param src The view to slice.
+ * @param start The coordinates (in @p src) where the slice begins.
+ * @param stop The coordinates (in @p src) where the slice ends.
+ * @param step The steps (positive) along each dimension.  NULL means steps of 1.
+ * @param view The new view.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_view_slice(const b2nd_view_t *src, const int64_t *start, const int64_t *stop,
+                                 const int64_t *step, b2nd_view_t **view);
+
+/**
+ * @brief Remove the dimensions of a single item from the shape of a view.
+ *
+ * @param view The view.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_view_squeeze(b2nd_view_t *view);
+
+/**
+ * @brief Get the shape of a view.
+ *
+ * @param view The view.
+ * @param ndim The number of dimensions (output).
+ * @param shape The shape (output).
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_view_get_shape(const b2nd_view_t *view, int8_t *ndim, int64_t *shape);
+
+/**
+ * @brief Get the items of a view into a C buffer.
+ *
+ * @param view The view.
+ * @param buffer The buffer, which gets the items in C order.
+ * @param buffersize The size (in bytes) of the buffer.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_view_to_cbuffer(const b2nd_view_t *view, void *buffer, int64_t buffersize);
+
+/**
+ * @brief Get a slice of a view into a C buffer.
+ *
+ * @param view The view.
+ * @param start The coordinates (in @p view) where the slice begins.
+ * @param stop The coordinates (in @p view) where the slice ends.
+ * @param buffer The buffer, which gets the items in C order.
+ * @param buffersize The size (in bytes) of the buffer.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_view_get_slice_cbuffer(const b2nd_view_t *view, const int64_t *start,
+                                             const int64_t *stop, void *buffer, int64_t buffersize);
+
+/**
+ * @brief Free a view.
+ *
+ * @param view The view.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_view_free(b2nd_view_t *view);
+
+
+/**
+ * @brief Create an empty element-wise expression.
+ *
+ * Expressions are built in postfix order: the operands are pushed (#b2nd_expr_push_array,
+ * #b2nd_expr_push_scalar) before the operations on them (#b2nd_expr_push_op), so that
+ * `a * b + c` is a, b, MUL, c, ADD.
+ *
+ * @param expr The new expression.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_expr_new(b2nd_expr_t **expr);
+
+/**
+ * @brief Push an array to an expression.
+ *
+ * @param expr The expression.
+ * @param array The array, which has to outlive the expression.  All the arrays of an
+ * expression must have the same shape, chunk shape, block shape and dtype, which is one of
+ * the NumPy little endian floats or integers of 4 or 8 bytes.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_expr_push_array(b2nd_expr_t *expr, const b2nd_array_t *array);
+
+/**
+ * @brief Push a scalar to an expression.
+ *
+ * @param expr The expression.
+ * @param value The scalar, which is converted to the dtype of the arrays.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_expr_push_scalar(b2nd_expr_t *expr, double value);
+
+/**
+ * @brief Push an operation on the last two operands of an expression, which the result replaces.
+ *
+ * @param expr The expression.
+ * @param op One of the B2ND_EXPR_* operations.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_expr_push_op(b2nd_expr_t *expr, int op);
+
+/**
+ * @brief Evaluate an expression into a new array.
+ *
+ * The blocks of the result are computed by the threads that compress them (as a prefilter),
+ * out of the blocks of the operands that go with them, which are decompressed right there.
+ * So the operands are never decompressed whole, and the blocks stay in the caches of the
+ * threads from decompression to compression.
+ *
+ * @param expr The expression, which has to have a single operand left.
+ * @param ctx The b2nd context for the new array.  Its shapes and dtype are overwritten with
+ * the ones of the operands.
+ * @param array The new array.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_expr_eval(const b2nd_expr_t *expr, b2nd_context_t *ctx, b2nd_array_t **array);
+
+/**
+ * @brief Free an expression.
+ *
+ * @param expr The expression.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int b2nd_expr_free(b2nd_expr_t *expr);
+
 
 /**
  * @brief Create the metainfo for the b2nd metalayer.
@@ -152,10 +152,14 @@ enum {
   /* Blosc format version
    *  1 -> First version (introduced in beta.2)
    *  2 -> Second version (introduced in rc.1)
+   *  3 -> Like 2, but with a two-level index of chunk offsets for large frames (#BLOSC2_INDEX_TWO_LEVELS)
+   *  4 -> Like 2, but with a bit-packed index of chunk offsets (#BLOSC2_INDEX_PACKED)
    *
    */
   BLOSC2_VERSION_FRAME_FORMAT_BETA2 = 1,  // for 2.0.0-beta2 and after
   BLOSC2_VERSION_FRAME_FORMAT_RC1 = 2,    // for 2.0.0-rc1 and after
+  BLOSC2_VERSION_FRAME_FORMAT_TWO_LEVELS_INDEX = 3,  // for frames with a two-level index
+  BLOSC2_VERSION_FRAME_FORMAT_PACKED_INDEX = 4,  // for frames with a bit-packed index
   BLOSC2_VERSION_FRAME_FORMAT = BLOSC2_VERSION_FRAME_FORMAT_RC1,
 };
 
@@ -226,7 +230,7 @@ enum {
   BLOSC2_GLOBAL_REGISTERED_FILTERS_START = 32,
   BLOSC2_GLOBAL_REGISTERED_FILTERS_STOP = 159,
   //!< Blosc-registered filters must be between 32 - 159.
-  BLOSC2_GLOBAL_REGISTERED_FILTERS = 4,
+  BLOSC2_GLOBAL_REGISTERED_FILTERS = 10,
   //!< Number of Blosc-registered filters at the moment.
   BLOSC2_USER_REGISTERED_FILTERS_START = 160,
   BLOSC2_USER_REGISTERED_FILTERS_STOP = 255,
@@ -250,13 +254,36 @@ enum {
   BLOSC_SHUFFLE = 1,     //!< Byte-wise shuffle.
   BLOSC_BITSHUFFLE = 2,  //!< Bit-wise shuffle.
 #endif // BLOSC_H
-  BLOSC_DELTA = 3,       //!< Delta filter.
-  BLOSC_TRUNC_PREC = 4,  //!< Truncate mantissa precision; positive values in cparams.filters_meta will keep bits; negative values will reduce bits.
+  BLOSC_DELTA = 3,       //!< Delta filter; cparams.filters_meta selects the mode (see #BLOSC_DELTA_DREF).
+  BLOSC_TRUNC_PREC = 4,  //!< Truncate mantissa precision; positive values in cparams.filters_meta will keep bits; negative values will reduce bits (see also #BLOSC_TRUNC_PREC_ROUND).
   BLOSC_LAST_FILTER = 5, //!< sentinel
   BLOSC_LAST_REGISTERED_FILTER = BLOSC2_GLOBAL_REGISTERED_FILTERS_START + BLOSC2_GLOBAL_REGISTERED_FILTERS - 1,
   //!< Determine the last registered filter. It is used to check if a filter is registered or not.
 };
 
+/**
+ * @brief Modes of the #BLOSC_DELTA filter (its value in cparams.filters_meta).
+ */
+enum {
+  BLOSC_DELTA_DREF = 0,      //!< XOR the blocks with the first one, and the first one with its previous elements.
+  BLOSC_DELTA_ELEMENTS = 1,  //!< Subtract from every element the previous one in the block (for e.g. timestamps).
+  BLOSC_DELTA_DREF_STORED = 2,  //!< XOR all the blocks with the first one, which the chunk keeps as is, so that
+                                //!< every block can be decoded on its own (chunks with dictionaries cannot use it).
+};
+
+/**
+ * @brief Rounding for the #BLOSC_TRUNC_PREC filter.
+ *
+ * Adding it to a (positive) number of bits to keep in cparams.filters_meta, or subtracting it from a
+ * (negative) number of bits to remove, rounds the mantissas to the nearest value (ties to even)
+ * instead of truncating them, which halves the maximum error and makes it unbiased.  NaNs and
+ * infinities are truncated, and the largest values may round to infinity (as in IEEE 754).
+ * Decompressing the chunks does not depend on it.
+ */
+enum {
+  BLOSC_TRUNC_PREC_ROUND = 64,
+};
+
 /**
  * @brief Codes for internal flags (see blosc1_cbuffer_metainfo)
  */
@@ -275,6 +302,7 @@ enum {
 enum {
   BLOSC2_USEDICT = 0x1,          //!< use dictionaries with codec
   BLOSC2_BIGENDIAN = 0x2,        //!< data is in big-endian ordering
+  BLOSC2_ZSTD_PREFIX = 0x4,      //!< zstd blocks reference the previous block as a prefix (see #blosc2_cparams.zstd_window)
   BLOSC2_INSTR_CODEC = 0x80,     //!< codec is instrumented (mainly for development)
 };
 
@@ -286,6 +314,15 @@ enum {
   BLOSC2_MAXBLOCKSIZE = 536866816  //!< maximum size for blocks
 };
 
+/**
+ * @brief The number of threads that lets a context decide in every call how many threads to engage
+ *
+ * The context starts as many threads as cores, and engages from a single one to all of them
+ * depending on the blocks of the call and on the time that the blocks took in the previous calls,
+ * so that small chunks do not pay for waking threads up that would get too little work.
+ */
+#define BLOSC2_NTHREADS_AUTO (-1)
+
 
 enum {
   BLOSC2_DEFINED_CODECS_START = 0,
@@ -294,7 +331,7 @@ enum {
   BLOSC2_GLOBAL_REGISTERED_CODECS_START = 32,
   BLOSC2_GLOBAL_REGISTERED_CODECS_STOP = 159,
   //!< Blosc-registered codecs must be between 31 - 159.
-  BLOSC2_GLOBAL_REGISTERED_CODECS = 5,
+  BLOSC2_GLOBAL_REGISTERED_CODECS = 7,
     //!< Number of Blosc-registered codecs at the moment.
   BLOSC2_USER_REGISTERED_CODECS_START = 160,
   BLOSC2_USER_REGISTERED_CODECS_STOP = 255,
@@ -339,6 +376,7 @@ enum {
   BLOSC_ZLIB_LIB = 3,
   BLOSC_ZSTD_LIB = 4,
 #endif // BLOSC_H
+  BLOSC_HYBRID_LIB = 5,   //!< per-block codecs in chunk header (see #blosc2_block_codec_fn)
   BLOSC_UDCODEC_LIB = 6,
   BLOSC_SCHUNK_LIB = 7,   //!< compressor library in super-chunk header
 };
@@ -352,6 +390,7 @@ enum {
 #define BLOSC_ZLIB_LIBNAME      "Zlib"
 #define BLOSC_ZSTD_LIBNAME      "Zstd"
 #endif // BLOSC_H
+#define BLOSC_HYBRID_LIBNAME    "Hybrid"
 
 /**
  * @brief The codes for compressor formats shipped with Blosc
@@ -365,6 +404,7 @@ enum {
   BLOSC_ZLIB_FORMAT = BLOSC_ZLIB_LIB,
   BLOSC_ZSTD_FORMAT = BLOSC_ZSTD_LIB,
 #endif // BLOSC_H
+  BLOSC_HYBRID_FORMAT = BLOSC_HYBRID_LIB,
   BLOSC_UDCODEC_FORMAT = BLOSC_UDCODEC_LIB,
 };
 
@@ -398,6 +438,123 @@ enum {
 };
 #endif // BLOSC_H
 
+/**
+ * @brief Schedulers for distributing the blocks of a chunk among threads.
+ */
+enum {
+  BLOSC_DEFAULT_SCHED = 0,
+  //!< Static split for decompression, shared block counter for compression.
+  BLOSC_DYNAMIC_SCHED = 1,
+  //!< Always pull the next block from a shared (atomic) block counter.
+  BLOSC_WORKSTEALING_SCHED = 2,
+  //!< Every thread starts with its own range of blocks and steals from the
+  //!< others when done.  Good when block compressibility varies a lot.
+  BLOSC_STREAMS_SCHED = 3,
+  //!< When compressing split blocks, the unit of work is a (block, stream) pair
+  //!< instead of a block, so chunks with few (but large) blocks still use all the
+  //!< threads.  The filtered blocks and the compressed streams are kept in buffers
+  //!< of the context (about twice the size of the chunk).  Decompression goes as
+  //!< with #BLOSC_DYNAMIC_SCHED.
+};
+
+/**
+ * @brief Devices where the destination of decompression can live.
+ */
+enum {
+  BLOSC2_DEVICE_HOST = 0,
+  //!< Host memory.
+  BLOSC2_DEVICE_CUDA = 1,
+  //!< Device memory of the current CUDA device.  LZ4 and ZSTD chunks (with at most the
+  //!< shuffle filter) are decompressed on the GPU with nvCOMP, and the rest are decompressed
+  //!< on the host and then copied.  Needs a Blosc that is built with CUDA.
+};
+
+/**
+ * @brief Whether the decompressed blocks are written to the destination with non-temporal
+ * stores, which leave the cache to the rest of the pipeline (see blosc2_dparams.nontemporal).
+ */
+enum {
+  BLOSC2_NONTEMPORAL_AUTO = 0,
+  //!< Only for chunks of #BLOSC2_NONTEMPORAL_THRESHOLD bytes or more.
+  BLOSC2_NONTEMPORAL_NEVER = 1,
+  //!< Never; the destination ends up in the cache.
+  BLOSC2_NONTEMPORAL_ALWAYS = 2,
+  //!< Always; for destinations that will not be touched soon, like large buffers
+  //!< that a whole super-chunk is decompressed into.
+};
+
+#define BLOSC2_NONTEMPORAL_THRESHOLD (32 * 1024 * 1024)
+
+/**
+ * @brief Detection of the sources that can be encoded as special chunks.
+ */
+enum {
+  BLOSC_SPECIAL_DETECT_RUNS = 0,
+  //!< Sources made of a single (typesize-wide) value are encoded as zeros, NaNs or
+  //!< repeated value chunks, without going through the filters or the codec.
+  BLOSC_SPECIAL_DETECT_NONE = 1,
+  //!< Sources always go through the filters and the codec (all-zero sources still become
+  //!< zeros chunks out of their runs of zeros).
+};
+
+/**
+ * @brief How the items are interpreted for the zone maps of the chunks (see #blosc2_schunk_get_zonemap).
+ */
+enum {
+  BLOSC2_ZONEMAP_NONE = 0,
+  //!< No zone maps are computed.
+  BLOSC2_ZONEMAP_INT = 1,
+  //!< Signed integers (of a typesize of 1, 2, 4 or 8).
+  BLOSC2_ZONEMAP_UINT = 2,
+  //!< Unsigned integers (of a typesize of 1, 2, 4 or 8).
+  BLOSC2_ZONEMAP_FLOAT = 3,
+  //!< IEEE 754 floats (of a typesize of 4 or 8), whose NaNs are counted apart.
+};
+
+/**
+ * @brief The checksums of the blocks of the chunks (see #blosc2_cparams.checksum).
+ */
+enum {
+  BLOSC2_CHECKSUM_NONE = 0,
+  //!< No checksums are stored.
+  BLOSC2_CHECKSUM_XXH3 = 1,
+  //!< The 64-bit XXH3 hash of every uncompressed block.
+};
+
+/**
+ * @brief The ciphers of the blocks of the chunks (see #blosc2_cparams.cipher).
+ */
+enum {
+  BLOSC2_CIPHER_NONE = 0,
+  //!< The blocks are stored in the clear.
+  BLOSC2_CIPHER_CHACHA20_POLY1305 = 1,
+  //!< Every compressed block is encrypted and authenticated with ChaCha20-Poly1305 (RFC 8439).
+};
+
+/**
+ * @brief What the zstd blocks of a chunk can match against (see #blosc2_cparams.zstd_window).
+ */
+enum {
+  BLOSC2_ZSTD_BLOCK_WINDOW = 0,
+  //!< Only the block itself, so that the blocks can be decompressed on their own.
+  BLOSC2_ZSTD_PREFIX_WINDOW = 1,
+  //!< The previous block of the chunk too (once filtered), which is referenced as a prefix.
+  BLOSC2_ZSTD_LDM_WINDOW = 2,
+  //!< Like #BLOSC2_ZSTD_PREFIX_WINDOW, with the long distance matcher of zstd on top.
+};
+
+/**
+ * @brief The size of the checksum of a block.
+ */
+#define BLOSC2_CHECKSUM_SIZE 8
+
+/**
+ * @brief The sizes of the key of a cipher, of the nonce of a chunk and of the tag of a block.
+ */
+#define BLOSC2_CIPHER_KEY_SIZE 32
+#define BLOSC2_CIPHER_NONCE_SIZE 12
+#define BLOSC2_CIPHER_TAG_SIZE 16
+
 /**
  * @brief Offsets for fields in Blosc2 chunk header.
  */
@@ -411,6 +568,7 @@ enum {
   BLOSC2_CHUNK_CBYTES = 0xc,        //!< (int32) compressed size of the buffer (including this header)
   BLOSC2_CHUNK_FILTER_CODES = 0x10, //!< the codecs for the filter pipeline (1 byte per code)
   BLOSC2_CHUNK_FILTER_META = 0x18,  //!< meta info for the filter pipeline (1 byte per code)
+  BLOSC2_CHUNK_CHECKSUM = 0x1E,     //!< what ends the chunk: the checksums of the blocks (#BLOSC2_CHECKSUM_NONE) in the low 4 bits, and their cipher (#BLOSC2_CIPHER_NONE) in the high ones
   BLOSC2_CHUNK_BLOSC2_FLAGS = 0x1F, //!< flags specific for Blosc2 functionality
 };
 
@@ -423,7 +581,8 @@ enum {
   BLOSC2_SPECIAL_NAN = 0x2,      //!< NaN special value
   BLOSC2_SPECIAL_VALUE = 0x3,    //!< generic special value
   BLOSC2_SPECIAL_UNINIT = 0x4,   //!< non initialized values
-  BLOSC2_SPECIAL_LASTID = 0x4,   //!< last valid ID for special value (update this adequately)
+  BLOSC2_SPECIAL_VIRTUAL = 0x5,  //!< values that the postfilter generates on read
+  BLOSC2_SPECIAL_LASTID = 0x5,   //!< last valid ID for special value (update this adequately)
   BLOSC2_SPECIAL_MASK = 0x7      //!< special value mask (prev IDs cannot be larger than this)
 };
 
@@ -470,6 +629,10 @@ enum {
   BLOSC2_ERROR_METALAYER_NOT_FOUND = -34,   //!< Metalayer has not been found
   BLOSC2_ERROR_MAX_BUFSIZE_EXCEEDED = -35,  //!< Max buffer size exceeded
   BLOSC2_ERROR_TUNER = -36,           //!< Tuner failure
+  BLOSC2_ERROR_CHECKSUM = -37,        //!< Checksum mismatch
+  BLOSC2_ERROR_QUEUE_FULL = -38,      //!< Queue full (try again later)
+  BLOSC2_ERROR_READ_ONLY = -39,       //!< Read-only super-chunk
+  BLOSC2_ERROR_AUTHENTICATION = -40,  //!< Authentication failure (wrong key or tampered data)
 };
 
 
@@ -552,6 +715,14 @@ static char *print_error(int rc) {
       return (char *) "Metalayer has not been found";
     case BLOSC2_ERROR_MAX_BUFSIZE_EXCEEDED:
       return (char *) "Maximum buffersize exceeded";
+    case BLOSC2_ERROR_CHECKSUM:
+      return (char *) "Checksum mismatch";
+    case BLOSC2_ERROR_QUEUE_FULL:
+      return (char *) "Queue full";
+    case BLOSC2_ERROR_READ_ONLY:
+      return (char *) "Read-only super-chunk";
+    case BLOSC2_ERROR_AUTHENTICATION:
+      return (char *) "Authentication failure";
     default:
       return (char *) "Unknown error";
   }
@@ -565,6 +736,25 @@ static char *print_error(int rc) {
  * Blosc to be used simultaneously in a multi-threaded environment, in
  * which case you can use the #blosc2_compress_ctx #blosc2_decompress_ctx pair.
  *
+ * @remark The environment variables that Blosc honors (e.g. BLOSC_CLEVEL or
+ * BLOSC_NTHREADS) are read here once, and the calls use their values from then on.
+ * Use #blosc2_reload_env to read them again.
+ *
+ * @remark The calls with more than one thread run serially when every thread would
+ * get less than 32 KB to (de-)compress, as waking the threads up would cost about as
+ * much as the work, and on machines with a single core.  The
+ * **BLOSC_PARALLEL_THRESHOLD** environment variable sets these bytes per thread
+ * (0 always uses the threads).
+ *
+ * @remark On Linux, the first call reads the BLOSC_HUGEPAGES environment variable,
+ * which backs the temporaries of the large blocks (and the in-memory frames) with
+ * huge pages:
+ *
+ * * **BLOSC_HUGEPAGES=1** (or **transparent**): Use transparent huge pages (MADV_HUGEPAGE).
+ * * **BLOSC_HUGEPAGES=explicit**: Map the temporaries from the reserved huge pages
+ * (MAP_HUGETLB), or from transparent ones when none are available.  In-memory frames
+ * still use transparent huge pages.
+ *
  * @sa #blosc2_destroy
  */
 BLOSC_EXPORT void blosc2_init(void);
@@ -581,6 +771,18 @@ BLOSC_EXPORT void blosc2_init(void);
 BLOSC_EXPORT void blosc2_destroy(void);
 
 
+/**
+ * @brief Read again the environment variables that Blosc honors.
+ *
+ * The values read by #blosc2_init are used by the calls until this is called (but
+ * for BLOSC_HUGEPAGES, which is only read by the first #blosc2_init).
+ *
+ * @note This function is not thread-safe and should not be called while
+ * other Blosc functions are running.
+ */
+BLOSC_EXPORT void blosc2_reload_env(void);
+
+
 /**
  * @brief Compress a block of data in the @p src buffer and returns the size of
  * compressed block.
@@ -764,6 +966,92 @@ typedef void (*blosc_threads_callback)(void *callback_data, void (*dojob)(void *
  */
 BLOSC_EXPORT void blosc2_set_threads_callback(blosc_threads_callback callback, void *callback_data);
 
+/**
+ * @brief A task scheduler of the application for running the jobs of a context.
+ *
+ * @p submit starts `job(job_data)` in the scheduler and returns without waiting for it
+ * (0 on success, a negative value if the job could not be started).  Blosc does not
+ * depend on the jobs being started soon, or at all: the thread doing the call also
+ * runs the jobs that the scheduler has not started yet, and the call returns as soon as
+ * every job has finished, even if some of the submitted ones are still queued (they just
+ * find nothing to do when they run later).  This way Blosc work nests inside the scheduler
+ * without deadlocks nor more threads than the scheduler has.
+ *
+ * Ready-made schedulers for OpenMP tasks, oneTBB task arenas and Apple GCD queues are in
+ * blosc2/blosc2-schedulers.h.
+ */
+typedef struct {
+  int (*submit)(void *sched_data, void (*job)(void *), void *job_data);
+  //!< Start a job asynchronously.
+  void *sched_data;
+  //!< The data passed through to @p submit (e.g. the task arena or the queue).
+} blosc2_task_scheduler;
+
+/**
+ * @brief Create a process-wide pool of threads shared by all the contexts.
+ *
+ * When the pool exists, contexts with more than one thread do not start threads
+ * of their own anymore, but submit their blocks to the pool instead.  @a nthreads
+ * in contexts still sets the number of jobs in which a chunk is split, but the
+ * total number of threads is bounded by the size of the pool, no matter how many
+ * contexts are open.  Jobs of different contexts are served in a round-robin fashion.
+ * On Linux machines with several NUMA nodes, the workers are spread evenly among them.
+ *
+ * @param nthreads The number of threads in the pool.  A value of 0 destroys the
+ * pool, so that every context manages its own threads again.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ *
+ * @note This function is not thread-safe and should not be called while
+ * there are (de-)compressions in flight.
+ */
+BLOSC_EXPORT int blosc2_set_shared_threadpool(int16_t nthreads);
+
+/**
+ * @brief Returns the number of threads in the shared pool (0 if there is no pool).
+ */
+BLOSC_EXPORT int16_t blosc2_get_shared_threadpool(void);
+
+
+/**
+ * @brief An allocator for the internal buffers of Blosc (see #blosc2_set_allocator).
+ *
+ * These are the buffers whose lifetime is managed by Blosc itself: the contexts
+ * and their (per-thread) temporaries, the block masks for decompression, the
+ * scratch buffers for updating the chunk offsets of frames, and the chunks that are
+ * read from frames on disk to be decompressed (which come from the allocator of the
+ * decompression context).  Hence, a pool of pinned or registered memory can serve
+ * the chunk-sized buffers of the reads of a super-chunk.  Buffers that are
+ * handed over to the user (and documented to be released with `free()`) still
+ * come from `malloc()`.
+ */
+typedef struct {
+  void* (*malloc)(size_t size, size_t alignment, void* params);
+  //!< Allocate @p size bytes aligned to @p alignment (a power of 2).  NULL must be returned on errors.
+  void (*free)(void* ptr, void* params);
+  //!< Release a buffer from @p malloc.
+  void* params;
+  //!< The user data passed to the functions above.
+} blosc2_allocator;
+
+/**
+ * @brief Set the global allocator for the internal buffers of Blosc.
+ *
+ * Contexts take a copy of the allocator in their parameters (see
+ * blosc2_cparams.allocator and blosc2_dparams.allocator), or of the global one
+ * when there is none, at creation time.  Hence, contexts created before this
+ * call keep using the previous allocator.
+ *
+ * @param allocator The new allocator.  NULL restores the default one (an
+ * aligned `malloc()`).
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ *
+ * @note This function is not thread-safe and should be called before the
+ * contexts (and super-chunks) using it are created.
+ */
+BLOSC_EXPORT int blosc2_set_allocator(const blosc2_allocator* allocator);
+
 
 /**
  * @brief Returns the current number of threads that are used for
@@ -887,12 +1175,45 @@ BLOSC_EXPORT int blosc2_get_complib_info(const char* compname, char** complib,
  * @brief Free possible memory temporaries and thread resources. Use this
  * when you are not going to use Blosc for a long while.
  *
+ * @note The thread resources are the ones of the calling thread (see #blosc2_compress).
+ *
  * @return A 0 if succeeds, in case of problems releasing the resources,
  * it returns a negative number.
  */
 BLOSC_EXPORT int blosc2_free_resources(void);
 
 
+/**
+ * @brief Set a global budget for the memory that Blosc keeps around between calls.
+ *
+ * The caches of decompressed chunks (see blosc2_schunk_set_chunk_cache()), the idle
+ * file handles of the filesystem io (see blosc2_stdio_set_max_open()), the pooled
+ * scratch blocks and ZSTD contexts of the (de-)compression contexts and the chunks
+ * read ahead (see blosc2_schunk_set_prefetch()) are all charged to this budget.
+ * When some memory does not fit, the idle pooled blocks and file handles are released
+ * first; then the chunk cache asking for room evicts its least recently used chunks,
+ * and the rest of caches do the same the next time they are used.  Chunks that still
+ * do not fit are just not cached (or not read ahead), and read as usual.
+ *
+ * The scratch blocks of the contexts at work cannot be given up, so they are charged
+ * anyway, and the usage goes over the budget if they do not fit in it.
+ *
+ * @param nbytes The budget in bytes. 0 (the default) means no limit.
+ *
+ * @return The previous budget if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int64_t blosc2_set_memory_budget(int64_t nbytes);
+
+/**
+ * @brief Get the bytes charged to the memory budget (see blosc2_set_memory_budget()).
+ *
+ * The usage is tracked even when there is no budget.
+ *
+ * @return The bytes in use by the caches, pools and read-ahead of Blosc.
+ */
+BLOSC_EXPORT int64_t blosc2_get_memory_usage(void);
+
+
 /**
  * @brief Get information about a compressed buffer, namely the number of
  * uncompressed bytes (@p nbytes) and compressed (@p cbytes). It also
@@ -932,6 +1253,50 @@ BLOSC_EXPORT void blosc1_cbuffer_sizes(const void* cbuffer, size_t* nbytes,
 BLOSC_EXPORT int blosc2_cbuffer_sizes(const void* cbuffer, int32_t* nbytes,
                                       int32_t* cbytes, int32_t* blocksize);
 
+/**
+ * @brief What a chunk is made of, as told by its header (see #blosc2_cbuffer_info).
+ */
+typedef struct {
+  int32_t nbytes;
+  //!< The size of the decompressed chunk.
+  int32_t cbytes;
+  //!< The size of the (compressed) chunk.
+  int32_t blocksize;
+  //!< The size of the blocks.
+  int32_t typesize;
+  //!< The size of the items.
+  int compcode;
+  //!< The codec.  As LZ4HC shares its format with LZ4, it is reported as #BLOSC_LZ4.
+  uint8_t compcode_meta;
+  //!< The metadata for the codec.
+  uint8_t filters[BLOSC2_MAX_FILTERS];
+  //!< The filters of the pipeline.
+  uint8_t filters_meta[BLOSC2_MAX_FILTERS];
+  //!< The metadata for the filters.
+  bool split;
+  //!< Whether the blocks are split in streams (one per byte of the items).
+  bool memcpyed;
+  //!< Whether the data is just copied (no codec, nor any filter, do apply).
+  bool use_dict;
+  //!< Whether the codec uses a dictionary.
+  int special;
+  //!< The kind of special value of the chunk (#BLOSC2_NO_SPECIAL for regular chunks).
+} blosc2_chunk_info;
+
+/**
+ * @brief Get what a compressed buffer is made of out of its header.
+ *
+ * The compression level is not kept in the chunks, so it cannot be told.
+ *
+ * @param cbuffer The buffer of compressed data.
+ * @param cbytes The size of @p cbuffer.  Only #BLOSC_EXTENDED_HEADER_LENGTH bytes
+ * are needed.
+ * @param info The pointer where the info will be put.
+ *
+ * @return On failure, returns negative value.
+ */
+BLOSC_EXPORT int blosc2_cbuffer_info(const void* cbuffer, int32_t cbytes, blosc2_chunk_info* info);
+
 /**
  * @brief Checks that the compressed buffer starting at @p cbuffer of length @p cbytes
  * may contain valid blosc compressed data, and that it is safe to call
@@ -1005,7 +1370,17 @@ BLOSC_EXPORT const char* blosc2_cbuffer_complib(const void* cbuffer);
 
 enum {
   BLOSC2_IO_FILESYSTEM = 0,
-  BLOSC_IO_LAST_BLOSC_DEFINED = 1,  // sentinel
+  BLOSC2_IO_FILESYSTEM_MMAP = 1,
+  //!< Memory-mapped files, with a blosc2_stdio_mmap struct as params.
+  BLOSC2_IO_FILESYSTEM_URING = 2,
+  //!< Files with batched reads through io_uring (Linux), with an optional blosc2_stdio_uring
+  //!< struct as params.
+  BLOSC2_IO_FILESYSTEM_DIRECT = 3,
+  //!< Files written with O_DIRECT through aligned buffers, with a blosc2_stdio_direct struct as params.
+  BLOSC2_IO_OBJECT_STORE = 4,
+  //!< Read-only objects of an object store (S3, HTTP servers...) fetched with range requests,
+  //!< with a blosc2_stdio_objstore struct as params.
+  BLOSC_IO_LAST_BLOSC_DEFINED = 5,  // sentinel
   BLOSC_IO_LAST_REGISTERED = 32,  // sentinel
 };
 
@@ -1022,6 +1397,47 @@ typedef int     (*blosc2_seek_cb)(void *stream, int64_t offset, int whence);
 typedef int64_t (*blosc2_write_cb)(const void *ptr, int64_t size, int64_t nitems, void *stream);
 typedef int64_t (*blosc2_read_cb)(void *ptr, int64_t size, int64_t nitems, void *stream);
 typedef int     (*blosc2_truncate_cb)(void *stream, int64_t size);
+typedef int64_t (*blosc2_pread_cb)(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream);
+typedef int64_t (*blosc2_pwrite_cb)(const void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                    void *stream);
+
+/*
+ * A read of a batch (see #blosc2_pread_batch_cb).
+ */
+typedef struct blosc2_io_request {
+  void *stream;
+  //!< The stream to read from, as returned by the open callback.
+  void *ptr;
+  //!< The buffer where the data will be put.
+  int64_t size;
+  //!< The number of bytes to read.
+  int64_t position;
+  //!< The position in the stream to read from.
+  int64_t result;
+  //!< The number of bytes read, or a negative value in case of errors (set by the io).
+  void *user_data;
+  //!< Opaque data for the completion callback.
+} blosc2_io_request;
+
+typedef void    (*blosc2_io_done_cb)(blosc2_io_request *request);
+typedef int     (*blosc2_pread_batch_cb)(blosc2_io_request *requests, int64_t nrequests,
+                                         blosc2_io_done_cb done);
+
+/*
+ * A range of a vectored read (see #blosc2_preadv_cb).
+ */
+typedef struct blosc2_io_vec {
+  void *ptr;
+  //!< The buffer where the data will be put.
+  int64_t size;
+  //!< The number of bytes to read.
+  int64_t position;
+  //!< The position in the stream to read from.
+} blosc2_io_vec;
+
+typedef int64_t (*blosc2_preadv_cb)(const blosc2_io_vec *vecs, int64_t nvecs, void *stream);
+
+typedef int     (*blosc2_sync_cb)(void *stream);
 
 
 /*
@@ -1078,6 +1494,56 @@ BLOSC_EXPORT int blosc2_register_io_cb(const blosc2_io_cb *io);
 
 BLOSC_EXPORT blosc2_io_cb *blosc2_get_io_cb(uint8_t id);
 
+/*
+ * Optional Input/Output callbacks (see #blosc2_register_io_cb_ext).
+ */
+typedef struct {
+  blosc2_pread_cb pread;
+  //!< The IO positional read callback (NULL if not supported).  It must not move
+  //!< the position of the stream, and it must be safe to call it concurrently on the same
+  //!< stream, so that threads can share it.  When NULL, seek + read is used instead.
+  blosc2_pwrite_cb pwrite;
+  //!< The IO positional write callback (NULL if not supported).  Same requirements
+  //!< than @p pread.  When NULL, seek + write is used instead.
+  blosc2_pread_batch_cb pread_batch;
+  //!< The IO batched read callback (NULL if not supported).  It starts all the reads
+  //!< of the batch (possibly on different streams) at once, and must call the @p done callback
+  //!< exactly once for every request, in the order they complete, before returning.  It returns
+  //!< 0, or a negative value if some request failed.  When NULL, the reads are done one by one.
+  blosc2_preadv_cb preadv;
+  //!< The IO vectored read callback (NULL if not supported).  It reads all the ranges
+  //!< of the same stream (in any order, e.g. merging the adjacent ones) and returns the total
+  //!< number of bytes read, or a negative value in case of errors.  Same requirements than
+  //!< @p pread.  When NULL, @p pread_batch is used instead, or else the ranges are read one by one.
+  blosc2_sync_cb sync;
+  //!< The IO sync callback (NULL if not supported).  It makes the data written to the
+  //!< stream so far durable on the storage device (like fdatasync()), and returns 0 if succeeds.
+  //!< It is needed for the durability levels of #blosc2_storage.
+} blosc2_io_cb_ext;
+
+/**
+ * @brief Register the optional callbacks of a user-defined input/output.
+ *
+ * @note The callbacks that are not implemented must be NULL, so better
+ * zero-initialize the struct before filling it.
+ *
+ * @param id The identifier of an io that is already registered.
+ * @param ext The optional callbacks of the io.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_register_io_cb_ext(uint8_t id, const blosc2_io_cb_ext *ext);
+
+/**
+ * @brief Get the optional callbacks of an input/output.
+ *
+ * @param id The identifier of the io.
+ *
+ * @return The optional callbacks (the ones not registered are NULL), or NULL if the io
+ * is not registered.
+ */
+BLOSC_EXPORT const blosc2_io_cb_ext *blosc2_get_io_cb_ext(uint8_t id);
+
 /*********************************************************************
   Structures and functions related with contexts.
 *********************************************************************/
@@ -1101,6 +1567,9 @@ typedef struct {
   //!< The tuner name
 } blosc2_tuner;
 
+typedef int (*blosc2_tuner_serialize_cb)(blosc2_context * cctx, uint8_t **content, int32_t *content_len);
+typedef int (*blosc2_tuner_deserialize_cb)(blosc2_context * cctx, const uint8_t *content, int32_t content_len);
+
 
 /**
  * @brief Register locally a user-defined tuner in Blosc.
@@ -1111,6 +1580,96 @@ typedef struct {
  */
 BLOSC_EXPORT int register_tuner_private(blosc2_tuner *tuner);
 
+/**
+ * @brief Register a user-defined tuner in Blosc.
+ *
+ * @param tuner The tuner to register.  Its id must be between
+ * #BLOSC2_USER_REGISTERED_TUNER_START and #BLOSC2_USER_REGISTERED_TUNER_STOP.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_register_tuner(blosc2_tuner *tuner);
+
+/**
+ * @brief Register the callbacks that keep the state of a tuner in super-chunks.
+ *
+ * Super-chunks keep what the tuner learned whenever it changes during the appends, and
+ * restore it when their frame is opened.
+ *
+ * @param id The id of a tuner that is already registered.
+ * @param serialize Serialize what the tuner learned into a malloc()ed content, and return 1
+ * for a new content, or 0 when nothing changed.
+ * @param deserialize Restore what the tuner learned out of a serialized content.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_register_tuner_state(int id, blosc2_tuner_serialize_cb serialize,
+                                             blosc2_tuner_deserialize_cb deserialize);
+
+/**
+ * @brief The objectives for the adaptive tuning of #BLOSC_STUNE.
+ */
+enum {
+  BLOSC_STUNE_CRATIO = 0,
+  //!< Get the best compression ratio (with a minimum compression speed, if any).
+  BLOSC_STUNE_SPEED = 1,
+  //!< Get the fastest compression (i.e. the lowest latency).
+  BLOSC_STUNE_BALANCED = 2,
+  //!< Get the best product of compression ratio and speed.
+};
+
+/**
+ * @brief The configuration for the adaptive tuning of #BLOSC_STUNE.
+ *
+ * When a pointer to it is passed as the `tuner_params` in the compression
+ * params of #BLOSC_STUNE, the tuner uses the compression time and ratio of the
+ * chunks to choose the codec, the compression level, the shuffle (in the last
+ * filter slot) and the split mode.  The candidates are tried on the first chunks,
+ * one parameter at a time, and the best ones are then used for the rest.
+ * The struct is copied when the context is created.
+ */
+typedef struct {
+  int objective;
+  //!< What to optimize for (#BLOSC_STUNE_CRATIO).
+  double min_speed;
+  //!< The minimum compression speed in GB/s for #BLOSC_STUNE_CRATIO (0 means no minimum).
+  int nchunks;
+  //!< The maximum number of chunks for trying candidates (0 means as many as needed).
+} blosc2_stune_config;
+
+/**
+ * @brief The statistics of a few samples of the data to be compressed.
+ */
+typedef struct {
+  double entropy;
+  //!< The entropy of the bytes, in bits per byte (from 0 to 8).
+  double shuffled_entropy;
+  //!< The entropy of the bytes given their position in the items (which the shuffle exploits).
+  double match_ratio;
+  //!< The fraction of the bytes that repeat an earlier sequence (which LZ codecs exploit).
+  bool incompressible;
+  //!< Whether compressing the data is not expected to pay off.
+  uint8_t filter;
+  //!< The shuffle that is expected to do best.
+  int compcode;
+  //!< The codec that is expected to give the best compression ratio.
+} blosc2_sample_stats;
+
+/**
+ * @brief Estimate how the source of a compression context may be compressed.
+ *
+ * A few KB of the source are sampled, so this is much cheaper than compressing.
+ * This is meant for the `next_cparams` function of tuners, where the source of the
+ * chunk to compress is already in the context.  #BLOSC_STUNE uses it in its
+ * adaptive mode (see #blosc2_stune_config) to store incompressible chunks as they are.
+ *
+ * @param cctx The compression context.
+ * @param stats The statistics of the samples.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_sample_chunk(blosc2_context *cctx, blosc2_sample_stats *stats);
+
 
 /**
  * @brief The parameters for a prefilter function.
@@ -1164,6 +1723,87 @@ typedef int (*blosc2_prefilter_fn)(blosc2_prefilter_params* params);
  */
 typedef int (*blosc2_postfilter_fn)(blosc2_postfilter_params* params);
 
+/**
+ * @brief The parameters for a block codec function.
+ *
+ */
+typedef struct {
+  void *user_data;  // user-provided info (optional)
+  const uint8_t *input;  // the block, once filtered, that is going to be compressed
+  int32_t size;  // the size of the block (in bytes)
+  int32_t typesize;  // the typesize
+  int32_t nblock;  // the current nblock in associated chunk
+  int32_t tid;  // thread id
+  blosc2_context *ctx;  // the compression context
+} blosc2_block_codec_params;
+
+/**
+ * @brief Value for a block codec function that stores the block uncompressed.
+ */
+#define BLOSC2_BLOCK_MEMCPY 0xFF
+
+/**
+ * @brief The type of the block codec function.
+ *
+ * It picks the codec for every block of a hybrid chunk. It should return one of the
+ * codecs shipped with Blosc (#BLOSC_BLOSCLZ, #BLOSC_LZ4, #BLOSC_LZ4HC, #BLOSC_ZLIB or
+ * #BLOSC_ZSTD), which compresses the block with the clevel of the context, or
+ * #BLOSC2_BLOCK_MEMCPY; else, a negative value.
+ */
+typedef int (*blosc2_block_codec_fn)(blosc2_block_codec_params* params);
+
+/**
+ * @brief The alignment (in bytes) of the input of a block postfilter.
+ */
+#define BLOSC2_BLOCK_POSTFILTER_ALIGN 32
+
+/**
+ * @brief The parameters for the kernel of a block postfilter.
+ *
+ * The input is always aligned to #BLOSC2_BLOCK_POSTFILTER_ALIGN bytes, so that it can be
+ * read with aligned vector loads as an array of @p nitems items of @p typesize bytes.
+ */
+typedef struct {
+  void *user_data;  // user-provided info (optional)
+  void *state;  // the state of the thread, which only this thread sees during the decompression
+  const uint8_t *input;  // the decompressed block (aligned to BLOSC2_BLOCK_POSTFILTER_ALIGN bytes)
+  uint8_t *output;  // where the block goes in the destination (it already holds a copy of the input, if not discarded)
+  int32_t nitems;  // the number of items in the block (the last one can be shorter)
+  int32_t typesize;  // the size of the items
+  int32_t start;  // the index of the first item of the block in the chunk
+  int64_t nchunk;  // the current nchunk in associated schunk (if exists; if not -1)
+  int32_t nblock;  // the current nblock in associated chunk
+  int32_t tid;  // thread id
+  blosc2_context *ctx;  // the decompression context
+} blosc2_block_postfilter_params;
+
+/**
+ * @brief A postfilter that runs on whole decompressed blocks, with a state for every thread.
+ *
+ * It is meant for fused decompress-and-reduce kernels: every thread accumulates into its own
+ * state without atomics, and the states are combined when the decompression of the chunk ends.
+ * The states live for a single decompression; @p init creates them when a thread gets its
+ * first block, and @p free releases them after @p combine.  If a callback is successful,
+ * the return value should be 0; else, a negative value.
+ *
+ * @note It only runs on the decompression of whole chunks (not when getting items).
+ */
+typedef struct {
+  void *user_data;
+  //!< User-provided info that is passed to every callback (optional).
+  int (*init)(void *user_data, int32_t tid, void **state);
+  //!< Create the state of a thread (optional; the state is NULL otherwise).
+  int (*block)(blosc2_block_postfilter_params *params);
+  //!< The kernel that runs on every block.
+  int (*combine)(void *user_data, void **states, int32_t nstates);
+  //!< Combine the states of the threads that got any block (optional).
+  void (*free)(void *user_data, void *state);
+  //!< Release the state of a thread (optional).
+  bool discard;
+  //!< Whether the blocks are not copied to the destination, for kernels that only reduce them
+  //!< (the output of the kernel is NULL then, and the destination is left untouched).
+} blosc2_block_postfilter;
+
 /**
  * @brief The parameters for creating a context for compression purposes.
  *
@@ -1178,11 +1818,11 @@ typedef struct {
   uint8_t clevel;
   //!< The compression level (5).
   int use_dict;
-  //!< Use dicts or not when compressing (only for ZSTD).
+  //!< Use dicts or not when compressing (only for ZSTD, LZ4 and BLOSCLZ).
   int32_t typesize;
   //!< The type size (8).
   int16_t nthreads;
-  //!< The number of threads to use internally (1).
+  //!< The number of threads to use internally, or #BLOSC2_NTHREADS_AUTO (1).
   int32_t blocksize;
   //!< The requested size of the compressed blocks (0 means automatic).
   int32_t splitmode;
@@ -1207,6 +1847,47 @@ typedef struct {
   //!< User defined parameters for the codec
   void *filter_params[BLOSC2_MAX_FILTERS];
   //!< User defined parameters for the filters
+  int scheduler;
+  //!< The scheduler for distributing blocks among threads (#BLOSC_DEFAULT_SCHED).
+  blosc2_allocator* allocator;
+  //!< The allocator for the internal buffers; it must outlive the context (NULL means the global one).
+  int special_detection;
+  //!< Which sources are encoded as special chunks (#BLOSC_SPECIAL_DETECT_RUNS).
+  bool record_stats;
+  //!< Whether to record the statistics of the chunks appended to the super-chunk (see #blosc2_schunk_get_recorded_stats).
+  int zonemap;
+  //!< How to interpret the items for the zone maps of the chunks appended to the super-chunk (#BLOSC2_ZONEMAP_NONE).
+  int checksum;
+  //!< The checksums of the blocks that are stored at the end of the chunks (#BLOSC2_CHECKSUM_NONE).
+  //!< They take #BLOSC2_CHECKSUM_SIZE bytes per block more than #BLOSC2_MAX_OVERHEAD; a chunk
+  //!< that has no room for them in the destination goes without.
+  blosc2_block_codec_fn block_codec;
+  //!< The function that picks the codec of every block (NULL). With it, the chunks are hybrid, and
+  //!< they keep one codec id per block after the bstarts; @p compcode is still the codec of the
+  //!< header. It takes no dicts, and the chunks need Blosc 2.x to be decompressed.
+  void *block_codec_params;
+  //!< The user data for the block codec function (NULL).
+  int zstd_window;
+  //!< What the zstd blocks of a chunk can match against (#BLOSC2_ZSTD_BLOCK_WINDOW). With a prefix
+  //!< window, the blocks of a chunk are compressed and decompressed one after the other, in a single
+  //!< thread. It takes no dicts nor block codec functions, and it is ignored for the other codecs.
+  int cipher;
+  //!< The cipher of the compressed blocks (#BLOSC2_CIPHER_NONE). The nonce of every chunk and the size
+  //!< and the tag of every block end the chunks, which take #BLOSC2_CIPHER_NONCE_SIZE bytes, plus
+  //!< #BLOSC2_CIPHER_TAG_SIZE + 4 bytes per block, more than #BLOSC2_MAX_OVERHEAD (a chunk that does
+  //!< not fit is not compressed). The tags authenticate the blocks, their place in the chunk and its
+  //!< header, but not the place of the chunk in a super-chunk. It takes no checksums, zone maps, dicts,
+  //!< instrumented codecs nor stored reference blocks of the delta filter (they would leak the data),
+  //!< and the runs of values are not stored as special chunks.
+  const uint8_t* cipher_key;
+  //!< The #BLOSC2_CIPHER_KEY_SIZE bytes of the key of the cipher (NULL); the context keeps a copy. The
+  //!< key is not stored anywhere, so the super-chunks that are opened again need contexts with it.
+  bool detect_typesize;
+  //!< Whether to guess the size of the items of every chunk when @p typesize is 1 (false). When the
+  //!< only filter is #BLOSC_SHUFFLE, a few samples of the chunk pick the stride that makes the shuffled
+  //!< bytes the most predictable (up to 16), and the chunk goes with the shuffle_stride filter instead
+  //!< (#BLOSC_FILTER_SHUFFLE_STRIDE, which keeps the stride in its meta). Its typesize is still 1. The
+  //!< guess needs the filter plugins in the build (the option is ignored without them).
 } blosc2_cparams;
 
 /**
@@ -1218,7 +1899,10 @@ static const blosc2_cparams BLOSC2_CPARAMS_DEFAULTS = {
         {0, 0, 0, 0, 0, BLOSC_SHUFFLE},
         {0, 0, 0, 0, 0, 0},
         NULL, NULL, NULL, 0, 0,
-        NULL, {NULL, NULL, NULL, NULL, NULL, NULL}
+        NULL, {NULL, NULL, NULL, NULL, NULL, NULL},
+        BLOSC_DEFAULT_SCHED, NULL, BLOSC_SPECIAL_DETECT_RUNS, false,
+        BLOSC2_ZONEMAP_NONE, BLOSC2_CHECKSUM_NONE, NULL, NULL,
+        BLOSC2_ZSTD_BLOCK_WINDOW, BLOSC2_CIPHER_NONE, NULL, false
         };
 
 
@@ -1230,19 +1914,39 @@ static const blosc2_cparams BLOSC2_CPARAMS_DEFAULTS = {
  */
 typedef struct {
   int16_t nthreads;
-  //!< The number of threads to use internally (1).
+  //!< The number of threads to use internally, or #BLOSC2_NTHREADS_AUTO (1).
   void* schunk;
   //!< The associated schunk, if any (NULL).
   blosc2_postfilter_fn postfilter;
   //!< The postfilter function.
   blosc2_postfilter_params *postparams;
   //!< The postfilter parameters.
+  int scheduler;
+  //!< The scheduler for distributing blocks among threads (#BLOSC_DEFAULT_SCHED).
+  blosc2_allocator* allocator;
+  //!< The allocator for the internal buffers; it must outlive the context (NULL means the global one).
+  int device;
+  //!< Where the destination of decompression lives (#BLOSC2_DEVICE_HOST).
+  blosc2_block_postfilter *block_postfilter;
+  //!< The postfilter for whole blocks (NULL); it cannot be used together with @p postfilter.
+  bool verify_checksums;
+  //!< Whether to check the blocks against the checksums of the chunks that have them (false).
+  //!< A mismatch fails the decompression with #BLOSC2_ERROR_CHECKSUM.
+  const uint8_t* cipher_key;
+  //!< The #BLOSC2_CIPHER_KEY_SIZE bytes of the key for the chunks with a cipher (NULL); the context
+  //!< keeps a copy. A block that does not authenticate fails the decompression with
+  //!< #BLOSC2_ERROR_AUTHENTICATION.
+  int nontemporal;
+  //!< Whether the blocks are written to the destination with non-temporal stores
+  //!< (#BLOSC2_NONTEMPORAL_AUTO).  They are not with postfilters or the delta filter.
 } blosc2_dparams;
 
 /**
  * @brief Default struct for decompression params meant for user initialization.
  */
-static const blosc2_dparams BLOSC2_DPARAMS_DEFAULTS = {1, NULL, NULL, NULL};
+static const blosc2_dparams BLOSC2_DPARAMS_DEFAULTS = {1, NULL, NULL, NULL, BLOSC_DEFAULT_SCHED, NULL,
+                                                       BLOSC2_DEVICE_HOST, NULL, false, NULL,
+                                                       BLOSC2_NONTEMPORAL_AUTO};
 
 /**
  * @brief Create a context for @a *_ctx() compression functions.
@@ -1252,7 +1956,8 @@ static const blosc2_dparams BLOSC2_DPARAMS_DEFAULTS = {1, NULL, NULL, NULL};
  * @return A pointer to the new context. NULL is returned if this fails.
  *
  * @note This supports the same environment variables than #blosc2_compress
- * for overriding the programmatic compression values.
+ * for overriding the programmatic compression values.  *BLOSC_NTHREADS* also
+ * takes *AUTO* here, for #BLOSC2_NTHREADS_AUTO.
  *
  * @sa #blosc2_compress
  */
@@ -1266,7 +1971,11 @@ BLOSC_EXPORT blosc2_context* blosc2_create_cctx(blosc2_cparams cparams);
  * @return A pointer to the new context. NULL is returned if this fails.
  *
  * @note This supports the same environment variables than #blosc2_decompress
- * for overriding the programmatic decompression values.
+ * for overriding the programmatic decompression values.  *BLOSC_NTHREADS* also
+ * takes *AUTO* here, for #BLOSC2_NTHREADS_AUTO.
+ *
+ * @note Contexts with a #BLOSC2_DEVICE_CUDA device decompress into device memory
+ * with #blosc2_decompress_ctx only (neither getitem nor super-chunks support them).
  *
  * @sa #blosc2_decompress
  *
@@ -1304,43 +2013,260 @@ BLOSC_EXPORT int blosc2_ctx_get_cparams(blosc2_context *ctx, blosc2_cparams *cpa
 BLOSC_EXPORT int blosc2_ctx_get_dparams(blosc2_context *ctx, blosc2_dparams *dparams);
 
 /**
- * @brief Set a maskout so as to avoid decompressing specified blocks.
+ * @brief Reconfigure a compression context with other @p cparams.
  *
- * @param ctx The decompression context to update.
+ * This is much cheaper than freeing the context and creating a new one: the
+ * threads, their temporaries and the codec states (like the ZSTD contexts) are
+ * kept, and only the ones that do not fit anymore (e.g. for another number of
+ * threads, or for larger blocks) are replaced at the next compression.
  *
- * @param maskout The boolean mask for the blocks where decompression
- * is to be avoided.
+ * @param ctx The context to reconfigure (created with #blosc2_create_cctx).
+ * @param cparams The new compression parameters.  Their allocator is ignored,
+ * as the one of the context is kept.  The state of the tuner is kept too, unless
+ * another tuner or a tuner config is asked for.
  *
- * @remark The maskout is valid for contexts *only* meant for decompressing
- * a chunk via #blosc2_decompress_ctx.  Once a call to #blosc2_decompress_ctx
- * is done, this mask is reset so that next call to #blosc2_decompress_ctx
- * will decompress the whole chunk.
+ * @return 0 if succeeds.  Else a negative code is returned, and the context is
+ * left as it was (except for errors of the tuner).
  *
- * @param nblocks The number of blocks in maskout above.
+ * @note This supports the same environment variables than #blosc2_create_cctx
+ * for overriding the programmatic compression values.
+ */
+BLOSC_EXPORT int blosc2_ctx_update_cparams(blosc2_context *ctx, const blosc2_cparams *cparams);
+
+/**
+ * @brief Reconfigure a decompression context with other @p dparams.
  *
- * @return If success, a 0 is returned.  An error is signaled with a negative int.
+ * Like #blosc2_ctx_update_cparams, the threads and their temporaries are kept.
  *
+ * @param ctx The context to reconfigure (created with #blosc2_create_dctx).
+ * @param dparams The new decompression parameters.  Their allocator is ignored.
+ *
+ * @return 0 if succeeds.  Else a negative code is returned, and the context is
+ * left as it was.
  */
-BLOSC_EXPORT int blosc2_set_maskout(blosc2_context *ctx, bool *maskout, int nblocks);
+BLOSC_EXPORT int blosc2_ctx_update_dparams(blosc2_context *ctx, const blosc2_dparams *dparams);
 
 /**
- * @brief Compress a block of data in the @p src buffer and returns the size of
- * compressed block.
+ * @brief Run the jobs of the parallel calls of a context in a task scheduler.
  *
- * @remark Compression is memory safe and guaranteed not to write @p dest
- * more than what is specified in @p destsize.
- * There is not a minimum for @p src buffer size @p nbytes.
+ * This takes precedence over #blosc2_set_threads_callback and the shared pool, and the
+ * threads of the context are stopped.  The nthreads of the context is still the number
+ * of jobs in which a chunk is split.
  *
- * @warning The @p src buffer and the @p dest buffer can not overlap.
+ * @param ctx The context.
+ * @param scheduler The scheduler, which is copied.  NULL goes back to the threads of the
+ * context (or the shared pool or callback, if any).
  *
- * @param clevel The desired compression level and must be a number
- * between 0 (no compression) and 9 (maximum compression).
- * @param doshuffle Specifies whether the shuffle compression preconditioner
- * should be applied or not. #BLOSC_NOFILTER means not applying filters,
- * #BLOSC_SHUFFLE means applying shuffle at a byte level and
- * #BLOSC_BITSHUFFLE at a bit level (slower but *may* achieve better
- * compression).
- * @param typesize Is the number of bytes for the atomic type in binary
+ * @return 0 if succeeds, or a negative value if the scheduler has no @p submit function.
+ */
+BLOSC_EXPORT int blosc2_ctx_set_task_scheduler(blosc2_context *ctx, const blosc2_task_scheduler *scheduler);
+
+/**
+ * @brief Cumulative statistics of a context, for attributing the time spent
+ * by every stage of the (de)compressions (see #blosc2_ctx_get_stats).
+ *
+ * The times add up the ones of all the threads, so with several of them they
+ * can be larger than the wall time.
+ */
+typedef struct {
+  int64_t ncalls;
+  //!< The compressions, decompressions and getitems done.
+  int64_t nbytes_in;
+  //!< The bytes of the sources (compressed chunks when decompressing; not counted for getitems).
+  int64_t nbytes_out;
+  //!< The bytes of the results.
+  int64_t nblocks;
+  //!< The blocks compressed or decompressed (the ones of special value chunks are not counted).
+  int64_t nblocks_raw;
+  //!< The blocks that are stored as they are (memcpyed chunks, or no stream compressed).
+  int64_t nspecial_chunks;
+  //!< The chunks of special values (zeros, NaNs, uninitialized or a repeated value).
+  int64_t nruns;
+  //!< The streams of blocks encoded as a run of a byte.
+  int64_t filters_ns;
+  //!< The time in the filter pipeline (prefilters and postfilters included).
+  int64_t codec_ns;
+  //!< The time in the codecs.
+  int64_t memcpy_ns;
+  //!< The time copying the blocks that are stored as they are.
+  int64_t lazy_reads;
+  //!< The reads of blocks of lazy chunks.
+  int64_t lazy_read_bytes;
+  //!< The bytes read for the blocks of lazy chunks.
+  int64_t idle_ns;
+  //!< The time that the threads wait for the slowest one at the end of every job.
+  int64_t cipher_ns;
+  //!< The time encrypting or decrypting the blocks (see #blosc2_cparams.cipher).
+  int64_t wakeup_ns;
+  //!< The time from the start of every job until the threads begin to work on it.
+  int64_t sync_ns;
+  //!< The time from the end of the slowest thread of every job until the caller goes on
+  //!< (the barriers, or the pool or the scheduler the jobs are run in).
+  int64_t sched_ns;
+  //!< The time that the threads spend taking their blocks from the shared counter or from
+  //!< the other threads (dynamic and work-stealing schedules), and waiting for the lock of the
+  //!< context when they are done.
+} blosc2_ctx_stats;
+
+/**
+ * @brief Get the cumulative statistics of a context.
+ *
+ * They are gathered by every context since its creation (or the last
+ * #blosc2_ctx_reset_stats) at the cost of reading a clock a few times per
+ * block, which is negligible for the usual block sizes.
+ *
+ * @param ctx The context.
+ * @param stats The pointer where the statistics will be stored.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_ctx_get_stats(const blosc2_context *ctx, blosc2_ctx_stats *stats);
+
+/**
+ * @brief Reset the statistics of a context to zero.
+ *
+ * @param ctx The context.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_ctx_reset_stats(blosc2_context *ctx);
+
+/**
+ * @brief The memory used by a context, by category (see #blosc2_ctx_memory_usage).
+ */
+typedef struct {
+  int64_t context;
+  //!< The context itself, along with the bookkeeping of its threads and filters.
+  int64_t scratch;
+  //!< The temporaries of the threads for the blocks.
+  int64_t codecs;
+  //!< The states of the codecs kept by the threads (ZSTD contexts, LZ4 states and zlib streams).
+  int64_t dicts;
+  //!< The digested dictionaries (the dictionaries themselves live in the chunks or in the super-chunk).
+  int64_t blocks;
+  //!< The info of the blocks of the last chunk (compressed sizes, zone maps, checksums, tags and streams).
+  int64_t total;
+  //!< The sum of all of the above.
+} blosc2_ctx_memory;
+
+/**
+ * @brief Get the memory that a context is holding between calls.
+ *
+ * The pooled scratch blocks checked out by the threads of the context are counted
+ * as @p scratch, and the memory of the zlib streams is the one documented by zlib
+ * for the default parameters.  The buffers of the caller are not counted.
+ *
+ * @param ctx The context.
+ * @param usage The pointer where the breakdown will be stored.
+ *
+ * @warning This must not be called while the context is (de-)compressing.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_ctx_memory_usage(const blosc2_context *ctx, blosc2_ctx_memory *usage);
+
+/**
+ * @brief The stages that are reported to the tracing hooks.
+ */
+enum {
+  BLOSC2_TRACE_JOB = 0,         //!< The blocks that a thread does in a call
+  BLOSC2_TRACE_BLOCK = 1,       //!< A whole block
+  BLOSC2_TRACE_FILTERS = 2,     //!< The filters (and prefilter) of a block
+  BLOSC2_TRACE_CODEC = 3,       //!< The codec of a block
+  BLOSC2_TRACE_MEMCPY = 4,      //!< The copy of a block that is stored as it is
+  BLOSC2_TRACE_POSTFILTER = 5,  //!< The postfilter of a block that is stored as it is
+  BLOSC2_TRACE_LAZY_READ = 6,   //!< The read of a block of a lazy chunk
+  BLOSC2_TRACE_IO_READ = 7,     //!< A read of a frame
+  BLOSC2_TRACE_IO_WRITE = 8,    //!< A write of a frame
+  BLOSC2_TRACE_CIPHER = 9,      //!< The encryption or the decryption of a block
+};
+
+/**
+ * @brief A stage that has finished, as reported to the tracing hooks.
+ */
+typedef struct {
+  int stage;
+  //!< The stage (one of the BLOSC2_TRACE_* values).
+  const blosc2_context *ctx;
+  //!< The context (NULL for the I/O stages).
+  int32_t tid;
+  //!< The thread of the context (0 in serial mode, -1 for the I/O stages).
+  int32_t nblock;
+  //!< The block in the chunk (-1 for the stages which are not of a block).
+  int64_t nbytes;
+  //!< The bytes of the block, or the ones read or written (0 for the jobs).
+  int64_t start_ns;
+  //!< When the stage started, in nanoseconds of a monotonic clock.
+  int64_t end_ns;
+  //!< When the stage ended, in nanoseconds of the same clock.
+} blosc2_trace_event;
+
+/**
+ * @brief The signature of the tracing hooks.
+ */
+typedef void (*blosc2_trace_cb)(const blosc2_trace_event *event, void *user_data);
+
+/**
+ * @brief Set the hook that receives every stage as it finishes, from any
+ * thread (NULL for removing it).
+ *
+ * The hooks are meant for bridging to tracing tools (Perfetto, ETW...),
+ * and have to be set while no other call of the library is running.
+ * The stages are also USDT probes (blosc2:stage) where sys/sdt.h is
+ * available.  The hooks are only built with the ENABLE_TRACE_HOOKS
+ * option of CMake, so as to keep the default builds free of any cost.
+ *
+ * @param cb The hook.
+ * @param user_data The pointer that is passed to the hook.
+ *
+ * @return 0 if succeeds. Else a negative code is returned (the library
+ * has been built without the hooks).
+ */
+BLOSC_EXPORT int blosc2_set_trace_cb(blosc2_trace_cb cb, void *user_data);
+
+/**
+ * @brief Set a maskout so as to avoid decompressing specified blocks.
+ *
+ * @param ctx The decompression context to update.
+ *
+ * @param maskout The boolean mask for the blocks where decompression
+ * is to be avoided.
+ *
+ * @remark The maskout is valid for contexts *only* meant for decompressing
+ * a chunk via #blosc2_decompress_ctx.  Once a call to #blosc2_decompress_ctx
+ * is done, this mask is reset so that next call to #blosc2_decompress_ctx
+ * will decompress the whole chunk.
+ *
+ * @param nblocks The number of blocks in maskout above.
+ *
+ * @return If success, a 0 is returned.  An error is signaled with a negative int.
+ *
+ */
+BLOSC_EXPORT int blosc2_set_maskout(blosc2_context *ctx, bool *maskout, int nblocks);
+
+/**
+ * @brief Compress a block of data in the @p src buffer and returns the size of
+ * compressed block.
+ *
+ * @remark Compression is memory safe and guaranteed not to write @p dest
+ * more than what is specified in @p destsize.
+ * There is not a minimum for @p src buffer size @p nbytes.
+ *
+ * @warning The @p src buffer and the @p dest buffer can not overlap.
+ *
+ * @remark Every calling thread uses a context of its own, which is kept for its
+ * next calls (and released when the thread exits), so threads can compress
+ * simultaneously with no locks nor allocations per call.  Their jobs (see
+ * #blosc2_set_nthreads) run in a pool of workers that they all share.
+ *
+ * @param clevel The desired compression level and must be a number
+ * between 0 (no compression) and 9 (maximum compression).
+ * @param doshuffle Specifies whether the shuffle compression preconditioner
+ * should be applied or not. #BLOSC_NOFILTER means not applying filters,
+ * #BLOSC_SHUFFLE means applying shuffle at a byte level and
+ * #BLOSC_BITSHUFFLE at a bit level (slower but *may* achieve better
+ * compression).
+ * @param typesize Is the number of bytes for the atomic type in binary
  * @p src buffer.  This is mainly useful for the shuffle preconditioner.
  * For implementation reasons, only a 1 < typesize < 256 will allow the
  * shuffle filter to work.  When typesize is not in this range, shuffle
@@ -1390,6 +2316,13 @@ BLOSC_EXPORT int blosc2_set_maskout(blosc2_context *ctx, bool *maskout, int nblo
  * #blosc_set_nthreads before the compression process
  * starts.
  *
+ * **BLOSC_NTHREADS_AFFINITY=[NUMA | NONE]**: With *numa*, the threads of the
+ * contexts are pinned to the NUMA nodes (in groups of consecutive threads), so
+ * that the blocks of the static schedule are (de-)compressed, and their output
+ * first touched, by threads on the same node.  Nothing is done on single-node
+ * machines, for the shared threadpool (which always spreads its workers among
+ * the nodes) or for user-managed threads.
+ *
  * **BLOSC_SPLITMODE=(ALWAYS | NEVER | AUTO | FORWARD_COMPAT)**:
  * This will call #blosc1_set_splitmode() before the compression process starts.
  *
@@ -1425,6 +2358,8 @@ BLOSC_EXPORT int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
  * @p nbytes (i.e. the number of bytes to be read from @p src buffer by this
  * function) in the compressed buffer is ok with you.
  *
+ * @remark As for #blosc2_compress, every calling thread uses a context of its own.
+ *
  * @param src The buffer to be decompressed.
  * @param srcsize The size of the buffer to be decompressed.
  * @param dest The buffer where the decompressed data will be put.
@@ -1447,6 +2382,9 @@ BLOSC_EXPORT int blosc2_compress(int clevel, int doshuffle, int32_t typesize,
  * *blosc_set_nthreads(BLOSC_NTHREADS)* before the proper decompression
  * process starts.
  *
+ * **BLOSC_NTHREADS_AFFINITY=[NUMA | NONE]**: Pin the threads to the NUMA nodes,
+ * as for #blosc2_compress.
+ *
  * **BLOSC_NOLOCK=(ANY VALUE)**: This will call *blosc2_decompress_ctx*
  * under the hood, with the *numinternalthreads* parameter set to the
  * same value as the last call to *blosc2_set_nthreads*.
@@ -1515,6 +2453,88 @@ BLOSC_EXPORT int blosc2_compress_ctx(
 BLOSC_EXPORT int blosc2_decompress_ctx(blosc2_context* context, const void* src,
                                        int32_t srcsize, void* dest, int32_t destsize);
 
+/**
+ * @brief The handle of an asynchronous (de-)compression.
+ */
+typedef struct blosc2_future blosc2_future;
+
+/**
+ * @brief Signature of the functions called when an asynchronous
+ * (de-)compression finishes.
+ *
+ * @param future The handle of the operation.
+ * @param result The value that the synchronous call would return.
+ * @param user_data The pointer passed when the operation was started.
+ *
+ * @remark The callback is run by the thread that did the work, so it should
+ * return quickly.  It must not free the @p future.
+ */
+typedef void (*blosc2_completion_cb)(blosc2_future *future, int result, void *user_data);
+
+/**
+ * @brief Asynchronous version of #blosc2_compress_ctx.
+ *
+ * The compression runs in the shared pool of threads (see
+ * #blosc2_set_shared_threadpool) when there is one, or in a new thread
+ * otherwise.  The call returns right away.
+ *
+ * @param callback The function to call on completion (can be NULL).
+ * @param user_data The pointer passed to @p callback.
+ *
+ * @warning The @p context, @p src and @p dest must not be used or released
+ * until the operation has finished.
+ *
+ * @return The handle of the operation, which must be released with
+ * #blosc2_future_free. NULL if the operation cannot be started.
+ */
+BLOSC_EXPORT blosc2_future* blosc2_compress_ctx_async(
+        blosc2_context* context, const void* src, int32_t srcsize, void* dest,
+        int32_t destsize, blosc2_completion_cb callback, void *user_data);
+
+/**
+ * @brief Asynchronous version of #blosc2_decompress_ctx.
+ *
+ * See #blosc2_compress_ctx_async for the details.
+ */
+BLOSC_EXPORT blosc2_future* blosc2_decompress_ctx_async(
+        blosc2_context* context, const void* src, int32_t srcsize, void* dest,
+        int32_t destsize, blosc2_completion_cb callback, void *user_data);
+
+/**
+ * @brief Check whether an asynchronous operation has finished, without blocking.
+ *
+ * @param future The handle of the operation.
+ * @param result If not NULL and the operation is finished, its result is put here.
+ *
+ * @return Whether the operation has finished.
+ */
+BLOSC_EXPORT bool blosc2_future_test(blosc2_future *future, int *result);
+
+/**
+ * @brief Wait for an asynchronous operation to finish.
+ *
+ * @return The value that the synchronous call would return.
+ */
+BLOSC_EXPORT int blosc2_future_wait(blosc2_future *future);
+
+/**
+ * @brief Get a file descriptor that becomes readable when the operation
+ * finishes, so that it can be watched from an event loop (poll, epoll...).
+ *
+ * The descriptor belongs to the @p future and it is closed by #blosc2_future_free.
+ *
+ * @return The file descriptor. A negative value if it cannot be created or
+ * the platform does not support it (Windows).
+ */
+BLOSC_EXPORT int blosc2_future_get_fd(blosc2_future *future);
+
+/**
+ * @brief Wait for an asynchronous operation to finish and release its handle.
+ *
+ * @return The value that the synchronous call would return.
+ */
+BLOSC_EXPORT int blosc2_future_free(blosc2_future *future);
+
 /**
  * @brief Create a chunk made of zeros.
  *
@@ -1583,9 +2603,33 @@ BLOSC_EXPORT int blosc2_chunk_uninit(blosc2_cparams cparams, int32_t nbytes,
                                      void* dest, int32_t destsize);
 
 
+/**
+ * @brief Create a virtual chunk, whose values are generated when it is decompressed.
+ *
+ * Nothing is stored for the values: the postfilter (or block postfilter) of the
+ * decompression context gets blocks of zeros and writes the actual values, in parallel
+ * as usual.  This is meant for data defined by a formula, like coordinate grids.
+ * Decompressing a virtual chunk without a postfilter is an error.
+ *
+ * @param cparams The compression parameters.
+ * @param nbytes The size (in bytes) of the chunk.
+ * @param dest The buffer where the data chunk will be put.
+ * @param destsize The size (in bytes) of the @p dest buffer;
+ * must be BLOSC_EXTENDED_HEADER_LENGTH at least.
+ *
+ * @return The number of bytes compressed (BLOSC_EXTENDED_HEADER_LENGTH).
+ * If negative, there has been an error and @p dest is unusable.
+ * */
+BLOSC_EXPORT int blosc2_chunk_virtual(blosc2_cparams cparams, int32_t nbytes,
+                                      void* dest, int32_t destsize);
+
+
 /**
  * @brief Context interface counterpart for #blosc1_getitem.
  *
+ * With a decompression context of several threads, the items that span several whole
+ * blocks are got with #blosc2_decompress_range_ctx.
+ *
  * @param context Context pointer.
  * @param src The compressed buffer from data will be decompressed.
  * @param srcsize Compressed buffer length.
@@ -1602,6 +2646,96 @@ BLOSC_EXPORT int blosc2_getitem_ctx(blosc2_context* context, const void* src,
                                     int32_t srcsize, int start, int nitems, void* dest,
                                     int32_t destsize);
 
+/**
+ * @brief Decompress a range of items of a chunk, using the threads of the context.
+ *
+ * Like #blosc2_getitem_ctx, but the blocks that are wholly inside the range are
+ * decompressed straight into @p dest by the threads of the context (only the blocks at
+ * the ends of the range, if partially needed, go through #blosc2_getitem_ctx).  A range
+ * with less than two whole blocks is got with a single thread.  A maskout set with
+ * #blosc2_set_maskout is not used (nor reset) by this function.
+ *
+ * @param context Context pointer.
+ * @param src The compressed buffer from data will be decompressed.
+ * @param srcsize Compressed buffer length.
+ * @param start The position of the first item (of @p typesize size) of the range.
+ * @param nitems The number of items (of @p typesize size) of the range.
+ * @param dest The buffer where the items will be put one after the other.
+ * @param destsize Output buffer length.
+ *
+ * @return The number of bytes copied to @p dest or a negative value if
+ * some error happens.
+ */
+BLOSC_EXPORT int blosc2_decompress_range_ctx(blosc2_context* context, const void* src,
+                                             int32_t srcsize, int start, int nitems, void* dest,
+                                             int32_t destsize);
+
+
+/*********************************************************************
+  Chunks of variable-length items.
+*********************************************************************/
+
+enum {
+  BLOSC2_VLCHUNK_HEADER_LENGTH = 20,
+  //!< The length of the header of a chunk of variable-length items.
+  BLOSC2_VLCHUNK_VERSION_FORMAT = 1,
+  //!< The version of the format of the chunks of variable-length items.
+  BLOSC2_VLCHUNK_BLOCKSIZE = 32 * 1024,
+  //!< The default payload size of the blocks of a chunk of variable-length items.
+};
+
+/**
+ * @brief Create a chunk of variable-length items, like strings or blobs.
+ *
+ * The items are put in blocks of about @p cparams.blocksize bytes
+ * (#BLOSC2_VLCHUNK_BLOCKSIZE when 0), and every block keeps the end offsets of its
+ * items and its payload as two Blosc2 chunks: the offsets with their bytes shuffled
+ * and delta encoded, and the payload with the codec and the filters of @p cparams
+ * (with a typesize of 1).  See README_VLCHUNK_FORMAT.rst for the details.
+ *
+ * @param cparams The compression parameters.
+ * @param items The pointers to the items.
+ * @param sizes The sizes (in bytes) of the items.
+ * @param nitems The number of items.
+ * @param dest The buffer where the chunk will be put.
+ * @param destsize The size (in bytes) of the @p dest buffer.
+ *
+ * @return The number of bytes of the chunk.  If 0, @p dest is not large enough
+ * for it.  If negative, there has been an error and @p dest is unusable.
+ */
+BLOSC_EXPORT int blosc2_vlchunk_compress(blosc2_cparams cparams, const void* const* items,
+                                         const int32_t* sizes, int32_t nitems,
+                                         void* dest, int32_t destsize);
+
+/**
+ * @brief Get the number of items of a chunk of variable-length items.
+ *
+ * @param chunk The chunk.
+ * @param cbytes The size (in bytes) of the @p chunk buffer.
+ *
+ * @return The number of items, or a negative value if @p chunk is not valid.
+ */
+BLOSC_EXPORT int blosc2_vlchunk_nitems(const void* chunk, int32_t cbytes);
+
+/**
+ * @brief Get an item of a chunk of variable-length items.
+ *
+ * Only the block with the item is read: the two end offsets of the item first,
+ * and then the blocks of its payload that hold its bytes.
+ *
+ * @param context The decompression context.
+ * @param chunk The chunk.
+ * @param cbytes The size (in bytes) of the @p chunk buffer.
+ * @param index The index of the item.
+ * @param dest The buffer where the item will be put; if NULL, only its size is returned.
+ * @param destsize The size (in bytes) of the @p dest buffer.
+ *
+ * @return The size (in bytes) of the item, or a negative value if some error happens.
+ */
+BLOSC_EXPORT int blosc2_vlchunk_getitem_ctx(blosc2_context* context, const void* chunk,
+                                            int32_t cbytes, int32_t index, void* dest,
+                                            int32_t destsize);
+
 
 /*********************************************************************
   Super-chunk related structures and functions.
@@ -1616,6 +2750,38 @@ BLOSC_EXPORT int blosc2_getitem_ctx(blosc2_context* context, const void* src,
 #define BLOSC2_MAX_VLMETALAYERS (8 * 1024)
 #define BLOSC2_VLMETALAYERS_NAME_MAXLEN BLOSC2_METALAYER_NAME_MAXLEN
 
+/**
+ * @brief The durability levels of the writes to contiguous frames on disk (see #blosc2_storage).
+ */
+enum {
+  BLOSC2_DURABILITY_NONE = 0,
+  //!< Nothing is synced: the operating system writes the data down when it sees fit.
+  BLOSC2_DURABILITY_CLOSE = 1,
+  //!< The frame is synced when the super-chunk is freed.
+  BLOSC2_DURABILITY_GROUP = 2,
+  //!< The appends are synced in groups (see blosc2_storage.sync_nappends and
+  //!< blosc2_storage.sync_ms), and the rest of the changes when the super-chunk is freed.
+  BLOSC2_DURABILITY_WRITE = 3,
+  //!< Every append and every other change is synced right away.
+};
+
+/**
+ * @brief The formats of the index of the chunk offsets of frames (see #blosc2_storage).
+ */
+enum {
+  BLOSC2_INDEX_CHUNK = 0,
+  //!< The offsets in a Blosc chunk.
+  BLOSC2_INDEX_TWO_LEVELS = 1,
+  //!< Like #BLOSC2_INDEX_CHUNK, but frames with more than 65536 chunks keep their offsets
+  //!< in a root chunk followed by leaf chunks of 65536 offsets, so that a lookup only
+  //!< decompresses a leaf.  It needs a frame format of
+  //!< #BLOSC2_VERSION_FRAME_FORMAT_TWO_LEVELS_INDEX to be read.
+  BLOSC2_INDEX_PACKED = 2,
+  //!< The offsets bit-packed in groups (delta + frame of reference), so that the
+  //!< offset of any chunk is read without decompressing anything.  It needs a
+  //!< frame format of #BLOSC2_VERSION_FRAME_FORMAT_PACKED_INDEX to be read.
+};
+
 /**
  * @brief This struct is meant for holding storage parameters for a
  * for a blosc2 container, allowing to specify, for example, how to interpret
@@ -1634,12 +2800,62 @@ typedef struct {
     //!< If NULL, sensible defaults are used depending on the context.
     blosc2_io *io;
     //!< Input/output backend.
+    int32_t chunk_padding;
+    //!< The bytes reserved after every chunk appended to a contiguous frame (0 by default).
+    //!< Updates with chunks that fit in the slot of the old one (including its padding)
+    //!< overwrite it in place instead of going to the end of the frame.  It is not
+    //!< kept in the frame, so set it again after opening it for updates.
+    int index_format;
+    //!< The format of the index of the chunk offsets of new frames (#BLOSC2_INDEX_CHUNK).
+    //!< It is kept in the frame, and the copies of the super-chunk keep it too.
+    int32_t chunk_align;
+    //!< The boundary (a power of 2 up to 1 GB, like 4 KB pages or 2 MB huge pages) where every
+    //!< chunk and the index of a contiguous frame start, counting from the start of the frame,
+    //!< so that they can be mapped or read (with O_DIRECT) page by page.  0 (the default)
+    //!< packs them.  It is kept in the frame, and the copies of the super-chunk keep it too.
+    int32_t shard_nchunks;
+    //!< The chunks packed in every file (shard) of a sparse frame (a power of 2 up to 32768),
+    //!< so that large super-chunks do not leave millions of files in their directory.
+    //!< 0 (the default) gives every chunk its own file.  It is kept in the frame.
+    int32_t dir_levels;
+    //!< The levels of subdirectories (up to 3) that the files of the chunks (or shards) of a
+    //!< sparse frame are spread over, so that no directory gets too many of them.  Every level
+    //!< is named after the next byte of the file id, from the lowest one on, like
+    //!< `34/AB/0012AB34.chunk`, so up to 256 subdirectories hang from every directory.
+    //!< 0 (the default) keeps every file at the top.  It is kept in the frame.
+    bool index_log;
+    //!< Whether the appends to a sparse frame only add a small entry to a log next to its index
+    //!< (`chunks.b2log`), instead of rewriting the whole index every time.  The log is merged
+    //!< into the index every few thousand appends, before any other change, and when the
+    //!< super-chunk is freed; opening the frame replays what is left in it.  It is kept
+    //!< in the frame.
+    int durability;
+    //!< When the writes to a contiguous frame on disk are synced to the storage device
+    //!< (#BLOSC2_DURABILITY_NONE by default).  With #BLOSC2_DURABILITY_GROUP and
+    //!< #BLOSC2_DURABILITY_WRITE, the appends go past the end of the frame, followed by
+    //!< the new index and trailer, which are synced before the header that points to them is
+    //!< written and synced too (see blosc2_schunk_set_versioned_commits()), so a crash leaves
+    //!< the frame as it was after the last sync.  Other changes are synced afterwards, but
+    //!< not atomically.  The io must have a sync callback (see #blosc2_io_cb_ext).  It is not
+    //!< kept in the frame, so set it again after opening it for writing.
+    int32_t sync_nappends;
+    //!< With #BLOSC2_DURABILITY_GROUP, the appends that are synced at once (0 for no limit).
+    int32_t sync_ms;
+    //!< With #BLOSC2_DURABILITY_GROUP, the milliseconds after the first append of a group
+    //!< when it is synced, at the next append (0 for no limit).  With no limits at all,
+    //!< every append is synced.
+    int32_t trailer_padding;
+    //!< The bytes reserved at the end of the trailer of frames (0 by default).  Changes to the
+    //!< variable-length metalayers that fit in the trailer (including its padding) overwrite it
+    //!< in place with a single write, instead of rewriting it along with the header.  The
+    //!< padding is kept when the trailer is rewritten, also after opening the frame.
 } blosc2_storage;
 
 /**
  * @brief Default struct for #blosc2_storage meant for user initialization.
  */
-static const blosc2_storage BLOSC2_STORAGE_DEFAULTS = {false, NULL, NULL, NULL, NULL};
+static const blosc2_storage BLOSC2_STORAGE_DEFAULTS = {false, NULL, NULL, NULL, NULL, 0, BLOSC2_INDEX_CHUNK, 0, 0, 0, false,
+                                                       BLOSC2_DURABILITY_NONE, 0, 0, 0};
 
 typedef struct blosc2_frame_s blosc2_frame;   /* opaque type */
 
@@ -1719,294 +2935,1519 @@ typedef struct blosc2_schunk {
   //<! The ndim (mainly for ZFP usage)
   int64_t *blockshape;
   //<! The blockshape (mainly for ZFP usage)
+  void *chunk_cache;
+  //!< The cache of decompressed chunks (see blosc2_schunk_set_chunk_cache()). NULL if disabled.
+  void *shared_dict;
+  //!< The dictionary shared by the chunks (see blosc2_schunk_train_dict()). NULL if none.
+  void *dctx_pool;
+  //!< The decompression contexts for concurrent reads (see blosc2_schunk_set_concurrent_reads()). NULL if disabled.
+  void *cctx_pool;
+  //!< The compression contexts for concurrent writes (see blosc2_schunk_set_concurrent_writes()). NULL if disabled.
+  void *xdelta;
+  //!< The deltas between chunks (see blosc2_schunk_set_xdelta()). NULL if disabled.
+  void *chunk_arena;
+  //!< The slabs holding the chunks of in-memory super-chunks (see blosc2_schunk_set_chunk_arena()). NULL if none.
+  void *async_appends;
+  //!< The queue and the workers of the asynchronous appends (see blosc2_schunk_set_async_appends()). NULL if disabled.
+  void *borrowed_chunks;
+  //!< The chunks that live in buffers of the caller (see blosc2_schunk_append_borrowed()). NULL if none.
+  void *tiering;
+  //!< The recompression of the cold chunks (see blosc2_schunk_set_tiering()). NULL if disabled.
 } blosc2_schunk;
 
 
 /**
- * @brief Create a new super-chunk.
+ * @brief Create a new super-chunk.
+ *
+ * @param storage The storage properties.
+ *
+ * @remark In case that storage.urlpath is not NULL, the data is stored
+ * on-disk.  If the data file(s) exist, they are *overwritten*.
+ *
+ * @return The new super-chunk.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage);
+
+/**
+ * Create a copy of a super-chunk.
+ *
+ * @param schunk The super-chunk to be copied.
+ * @param storage The storage properties.
+ *
+ * @remark When the compression parameters do not change, the chunks are copied
+ * verbatim.  Between contiguous frames, they go along with their offsets in one
+ * go (by the kernel for files on Linux, sharing the blocks on file systems with
+ * reflinks), holes included; see blosc2_schunk_compact() for reclaiming them.
+ *
+ * @return The new super-chunk.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage);
+
+/**
+ * @brief Create a copy of a super-chunk with other compression parameters,
+ * transcoding its chunks in parallel.
+ *
+ * Every chunk is read, decompressed and compressed again by one of @p nthreads
+ * jobs, while the ones already done are appended in order.  Only a few chunks
+ * per job are in flight at any time.  The jobs run in the shared pool of threads
+ * (see #blosc2_set_shared_threadpool) when there is one, or in threads of their
+ * own otherwise.  The metalayers and vlmetalayers are copied, but for the ones
+ * describing the former chunks (dictionary and stats).
+ *
+ * The appends to on-disk super-chunks are committed every 1024 chunks.  If the
+ * transcode does not complete, calling this again with the same @p storage
+ * resumes it from the last commit.  For contiguous frames, the appends after
+ * the last commit overwrite the chunk offsets, so only sparse frames can be
+ * resumed after a crash.  Other existing frames are not overwritten, as in
+ * blosc2_schunk_new().
+ *
+ * @param schunk The super-chunk to be transcoded.
+ * @param storage The storage properties of the new super-chunk.
+ * @param nthreads The number of parallel jobs (at least 1).
+ *
+ * @remark Prefilters, dictionaries and tuners other than the default one depend on
+ * the state of the new super-chunk, so the chunks are transcoded one after the
+ * other when @p storage uses them.
+ *
+ * @return The new super-chunk. NULL if fails.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_transcode(blosc2_schunk *schunk, blosc2_storage *storage,
+                                                    int nthreads);
+
+/**
+ * @brief Create a super-chunk out of a contiguous frame buffer.
+ *
+ * @param cframe The buffer of the in-memory frame.
+ * @param copy Whether the super-chunk should make a copy of
+ * the @p cframe data or not.  The copy will be made to an internal
+ * sparse frame.
+ *
+ * @remark If copy is false, the @p cframe buffer passed will be owned
+ * by the super-chunk and will be automatically freed when
+ * blosc2_schunk_free() is called.  If the user frees it after the
+ * opening, bad things will happen.  Don't do that (or set @p copy).
+ *
+ * @param len The length of the buffer (in bytes).
+ *
+ * @return The new super-chunk.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_from_buffer(uint8_t *cframe, int64_t len, bool copy);
+
+/**
+ * @brief Set the private `avoid_cframe_free` field in a frame.
+ *
+ * @param schunk The super-chunk referencing the frame.
+ * @param avoid_cframe_free The value to set in the blosc2_frame_s structure.
+ *
+ * @warning If you set it to `true` you will be responsible of freeing it.
+ */
+BLOSC_EXPORT void blosc2_schunk_avoid_cframe_free(blosc2_schunk *schunk, bool avoid_cframe_free);
+
+/**
+ * @brief Put the contiguous frame of a super-chunk in named shared memory, so that other
+ * processes can attach to it with blosc2_schunk_open_shm() instead of having a copy each.
+ *
+ * @param schunk The super-chunk.
+ * @param name The name of the shared memory object, like "/dataset" (see shm_open()).
+ * It must not exist yet.
+ *
+ * @return The length of the frame. Else a negative code is returned.
+ *
+ * @remark The object stays until blosc2_remove_shm() (or a reboot).  Only POSIX systems
+ * support it.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_to_shm(blosc2_schunk *schunk, const char *name);
+
+/**
+ * @brief Attach to a frame in named shared memory (see blosc2_schunk_to_shm()).
+ *
+ * The frame is mapped read-only, and the chunks are read (lazily too) straight from the
+ * mapping, which is shared by all the processes attached.  Any change to the super-chunk
+ * or its metalayers fails with #BLOSC2_ERROR_READ_ONLY.
+ *
+ * @param name The name of the shared memory object.
+ *
+ * @return The new super-chunk.  NULL if not found or not in frame format.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_open_shm(const char *name);
+
+/**
+ * @brief Remove the name of a frame in shared memory.  The processes attached to it
+ * can keep reading it until they free their super-chunks.
+ *
+ * @param name The name of the shared memory object.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_remove_shm(const char *name);
+
+/**
+ * @brief Open an existing super-chunk that is on-disk (frame). No in-memory copy is made.
+ *
+ * @param urlpath The file name.
+ *
+ * @return The new super-chunk.  NULL if not found or not in frame format.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_open(const char* urlpath);
+
+/**
+ * @brief Open an existing super-chunk that is on-disk (frame). No in-memory copy is made.
+ *
+ * @param urlpath The file name.
+ *
+ * @param offset The frame offset.
+ *
+ * @return The new super-chunk.  NULL if not found or not in frame format.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_open_offset(const char* urlpath, int64_t offset);
+
+/**
+ * @brief Open an existing super-chunk (no copy is made) using a user-defined I/O interface.
+ *
+ * @param urlpath The file name.
+ *
+ * @param udio The user-defined I/O interface.
+ *
+ * @return The new super-chunk.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_open_udio(const char* urlpath, const blosc2_io *udio);
+
+/* @brief Convert a super-chunk into a contiguous frame buffer.
+ *
+ * @param schunk The super-chunk to convert.
+ * @param cframe The address of the destination buffer (output).
+ * @param needs_free The pointer to a boolean indicating if it is the user's
+ * responsibility to free the resulting @p cframe buffer or not.
+ *
+ * @return If successful, return the size of the (frame) @p cframe buffer.
+ * Else, a negative value.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_to_buffer(blosc2_schunk* schunk, uint8_t** cframe, bool* needs_free);
+
+/* @brief Store a super-chunk into a file.
+ *
+ * @param schunk The super-chunk to write.
+ * @param urlpath The path for persistent storage.
+ *
+ * @return If successful, return the size of the (fileframe) in @p urlpath.
+ * Else, a negative value.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_to_file(blosc2_schunk* schunk, const char* urlpath);
+
+/* @brief Append a super-chunk into a file.
+ *
+ * @param schunk The super-chunk to write.
+ * @param urlpath The path for persistent storage.
+ *
+ * @return If successful, return the offset where @p schunk has been appended in @p urlpath.
+ * Else, a negative value.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_append_file(blosc2_schunk* schunk, const char* urlpath);
+
+/**
+ * @brief Write callback for streams of frames.  It works like `write()` on a pipe or socket:
+ * it returns the number of bytes of @p buf that have been written (which may be less than
+ * @p size), or a negative value in case of errors.
+ */
+typedef int64_t (*blosc2_stream_write_cb)(void *user_data, const void *buf, int64_t size);
+
+/**
+ * @brief Read callback for streams of frames.  It works like `read()` on a pipe or socket:
+ * it returns the number of bytes read into @p buf (which may be less than @p size), 0 at the
+ * end of the stream, or a negative value in case of errors.
+ */
+typedef int64_t (*blosc2_stream_read_cb)(void *user_data, void *buf, int64_t size);
+
+/**
+ * @brief The writer of a frame stream (see blosc2_stream_writer_new()).
+ */
+typedef struct blosc2_stream_writer_s blosc2_stream_writer;
+
+/**
+ * @brief Start writing a frame stream to media that cannot seek, like pipes or sockets.
+ *
+ * A frame stream is a frame whose chunks are written as they come, and whose index and
+ * trailer go at the end, so nothing has to be rewritten.  It is read back with
+ * blosc2_schunk_from_stream().
+ *
+ * @param schunk The super-chunk that sets the compression parameters and the metalayers
+ * of the stream (its own chunks are not written).  Its variable-length metalayers are
+ * written at blosc2_stream_writer_close(), and it must outlive the writer.
+ * @param write The callback that writes the stream.
+ * @param user_data The data passed to @p write.
+ *
+ * @return The new writer (the header has been written already), or NULL in case of errors.
+ */
+BLOSC_EXPORT blosc2_stream_writer* blosc2_stream_writer_new(blosc2_schunk *schunk, blosc2_stream_write_cb write,
+                                                            void *user_data);
+
+/**
+ * @brief Compress @p src with the compression context of the super-chunk of @p writer, and
+ * write it to the stream as a new chunk.
+ *
+ * @return The number of chunks written so far, or a negative value in case of errors.
+ */
+BLOSC_EXPORT int64_t blosc2_stream_writer_append_buffer(blosc2_stream_writer *writer, const void *src,
+                                                        int32_t nbytes);
+
+/**
+ * @brief Write an existing @p chunk to the stream.
+ *
+ * @return The number of chunks written so far, or a negative value in case of errors.
+ */
+BLOSC_EXPORT int64_t blosc2_stream_writer_append_chunk(blosc2_stream_writer *writer, const uint8_t *chunk);
+
+/**
+ * @brief Write the index and the trailer at the end of the stream, and free @p writer.
+ *
+ * @return The length of the stream, or a negative value in case of errors (the writer is
+ * freed anyway).
+ */
+BLOSC_EXPORT int64_t blosc2_stream_writer_close(blosc2_stream_writer *writer);
+
+/**
+ * @brief Write a super-chunk as a frame stream, chunk by chunk.  Unlike
+ * blosc2_schunk_to_buffer(), the frame is never held in memory as a whole.
+ *
+ * @param schunk The super-chunk to write.
+ * @param write The callback that writes the stream.
+ * @param user_data The data passed to @p write.
+ *
+ * @return The length of the stream, or a negative value in case of errors.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_to_stream(blosc2_schunk *schunk, blosc2_stream_write_cb write,
+                                             void *user_data);
+
+/**
+ * @brief Read a frame stream (see blosc2_stream_writer_new()) into a new super-chunk.
+ *
+ * The chunks are appended to the super-chunk as they are read, so with an on-disk @p storage
+ * the stream is never held in memory as a whole.  The index at the end of the stream is
+ * checked against the chunks that have been read.
+ *
+ * @param read The callback that reads the stream.
+ * @param user_data The data passed to @p read.
+ * @param storage The storage of the new super-chunk.  The compression parameters come from
+ * the stream, except for the ones that are not in frames (like the number of threads).
+ *
+ * @return The new super-chunk, or NULL in case of errors.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_from_stream(blosc2_stream_read_cb read, void *user_data,
+                                                      blosc2_storage *storage);
+
+/**
+ * @brief The writer of an archive of frames (see blosc2_archive_writer_new()).
+ */
+typedef struct blosc2_archive_writer_s blosc2_archive_writer;
+
+/**
+ * @brief An archive of frames opened for reading (see blosc2_archive_open()).
+ */
+typedef struct blosc2_archive_s blosc2_archive;
+
+/**
+ * @brief An entry of the directory of an archive.
+ */
+typedef struct {
+  const char *name;
+  //!< The name of the frame (owned by the archive).
+  int64_t offset;
+  //!< The position of the frame in the file.
+  int64_t length;
+  //!< The length of the frame.
+  int32_t typesize;
+  //!< The typesize of the super-chunk.
+  int8_t ndim;
+  //!< The number of dimensions of the array (1 for super-chunks that are not b2nd arrays).
+  int64_t shape[BLOSC2_MAX_DIM];
+  //!< The shape of the array (the number of items for super-chunks that are not b2nd arrays).
+} blosc2_archive_entry;
+
+/**
+ * @brief Start writing an archive, which is a single file holding many named frames plus a
+ * directory of them (see README_ARCHIVE_FORMAT.rst).
+ *
+ * @param urlpath The name of the file.  It is overwritten if it exists.
+ *
+ * @return The new writer, or NULL in case of errors.
+ */
+BLOSC_EXPORT blosc2_archive_writer* blosc2_archive_writer_new(const char *urlpath);
+
+/**
+ * @brief Write the frame of @p schunk to the archive under @p name.
+ *
+ * @param writer The writer of the archive.
+ * @param name The name of the frame.  The names must be unique in an archive.
+ * @param schunk The super-chunk to write (b2nd arrays get the shape in the directory too).
+ *
+ * @return The offset of the frame in the archive, or a negative value in case of errors.
+ */
+BLOSC_EXPORT int64_t blosc2_archive_writer_add_schunk(blosc2_archive_writer *writer, const char *name,
+                                                      blosc2_schunk *schunk);
+
+/**
+ * @brief Write the directory at the end of the archive, and free @p writer.
+ *
+ * @return The number of frames in the archive, or a negative value in case of errors (the
+ * writer is freed anyway).  #BLOSC2_ERROR_INVALID_PARAM is returned for repeated names.
+ */
+BLOSC_EXPORT int64_t blosc2_archive_writer_close(blosc2_archive_writer *writer);
+
+/**
+ * @brief Open an archive.  The file is mapped in memory (it is read in one go where this is
+ * not supported), and the directory is used in place, so opening costs the same whatever the
+ * number of frames.
+ *
+ * @param urlpath The name of the file.
+ *
+ * @return The archive, or NULL if not found or not an archive.
+ */
+BLOSC_EXPORT blosc2_archive* blosc2_archive_open(const char *urlpath);
+
+/**
+ * @brief Get the number of frames of an archive.
+ */
+BLOSC_EXPORT int64_t blosc2_archive_nentries(const blosc2_archive *archive);
+
+/**
+ * @brief Get the entry @p nentry of the directory of an archive (entries are sorted by name).
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_archive_get_entry(const blosc2_archive *archive, int64_t nentry,
+                                          blosc2_archive_entry *entry);
+
+/**
+ * @brief Find the entry of the frame called @p name (with a binary search of the directory).
+ *
+ * @return The index of the entry, #BLOSC2_ERROR_NOT_FOUND if there is no such frame, or
+ * another negative code in case of errors.
+ */
+BLOSC_EXPORT int64_t blosc2_archive_find(const blosc2_archive *archive, const char *name);
+
+/**
+ * @brief Open the frame called @p name of an archive without copying it.
+ *
+ * The chunks are read straight from the mapping of the archive, which must outlive the
+ * super-chunk.  Any change to the super-chunk or its metalayers fails with
+ * #BLOSC2_ERROR_READ_ONLY.
+ *
+ * @return The new super-chunk, or NULL if not found.
+ */
+BLOSC_EXPORT blosc2_schunk* blosc2_archive_open_schunk(blosc2_archive *archive, const char *name);
+
+/**
+ * @brief Close an archive.  The super-chunks opened from it must be freed before.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_archive_close(blosc2_archive *archive);
+
+/**
+ * @brief Release resources from a super-chunk.
+ *
+ * @param schunk The super-chunk to be freed.
+ *
+ * @remark All the memory resources attached to the super-chunk are freed.
+ * If the super-chunk is on-disk, the data continues there for a later
+ * re-opening (a pending bulk append is committed first).
+ *
+ * @return 0 if success.
+ */
+BLOSC_EXPORT int blosc2_schunk_free(blosc2_schunk *schunk);
+
+/**
+ * @brief Append an existing @p chunk to a super-chunk.
+ *
+ * @param schunk The super-chunk where the chunk will be appended.
+ * @param chunk The @p chunk to append.  An internal copy is made, so @p chunk can be reused or
+ * freed if desired.
+ * @param copy Whether the chunk should be copied internally or can be used as-is.
+ *
+ * @return The number of chunks in super-chunk. If some problem is
+ * detected, this number will be negative.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy);
+
+/**
+ * @brief Append the chunks of another super-chunk to a super-chunk, with no recompression.
+ *
+ * Between contiguous frames (in memory or on disk), the chunks of @p src are copied as
+ * a whole with a single I/O, and the chunk offsets of both are merged and written once
+ * (unless the chunks of @p src are not aligned like the ones of @p schunk; see
+ * blosc2_storage.chunk_align).
+ * Else the chunks are appended one by one in a bulk append (see #blosc2_schunk_begin_bulk).
+ * The zone maps of the chunks go along, when they are of the kind of the ones of @p schunk.
+ *
+ * @param schunk The super-chunk where the chunks will be appended.
+ * @param src The super-chunk whose chunks are appended.  It must have the typesize of
+ * @p schunk, and its chunksize too (unless @p schunk is empty).  The chunks keep their
+ * own compression params, but they cannot reference a shared dictionary other than the
+ * one of @p schunk.
+ *
+ * @note The last chunk of @p schunk cannot be smaller than its chunksize.
+ *
+ * @return The number of chunks in @p schunk. Else a negative code is returned.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_concat(blosc2_schunk *schunk, blosc2_schunk *src);
+
+/**
+ * @brief Start a bulk append on a super-chunk.
+ *
+ * From now on, the chunks appended to an on-disk super-chunk are written right
+ * away, but the update of its chunk offsets, header and trailer is deferred
+ * until blosc2_schunk_commit_bulk() or blosc2_schunk_free() (or any other
+ * modification of the super-chunk, like updating chunks or metalayers), so
+ * appending many chunks does not rewrite the offsets index every time.
+ * The super-chunk can be read as usual meanwhile.
+ *
+ * @remark Until the commit, the file (of a contiguous frame) is not a
+ * valid frame.  Sparse frames keep the index before the bulk append.
+ * This is a no-op for in-memory super-chunks.
+ *
+ * @param schunk The super-chunk.
+ *
+ * @return 0 if success. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_begin_bulk(blosc2_schunk *schunk);
+
+/**
+ * @brief Write down the updates deferred by a bulk append, and end it.
+ *
+ * @param schunk The super-chunk.
+ *
+ * @return 0 if success. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_commit_bulk(blosc2_schunk *schunk);
+
+/**
+  * @brief Update a chunk at a specific position in a super-chunk.
+  *
+  * @param schunk The super-chunk where the chunk will be updated.
+  * @param nchunk The position where the chunk will be updated.
+  * @param chunk The new @p chunk. If an internal copy is made, the @p chunk can be reused or
+  * freed if desired.
+  * @param copy Whether the chunk should be copied internally or can be used as-is.
+  *
+  * @return The number of chunks in super-chunk. If some problem is
+  * detected, this number will be negative.
+  */
+BLOSC_EXPORT int64_t blosc2_schunk_update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy);
+
+/**
+ * @brief Insert a chunk at a specific position in a super-chunk.
+ *
+ * @param schunk The super-chunk where the chunk will be appended.
+ * @param nchunk The position where the chunk will be inserted.
+ * @param chunk The @p chunk to insert. If an internal copy is made, the @p chunk can be reused or
+ * freed if desired.
+ * @param copy Whether the chunk should be copied internally or can be used as-is.
+ *
+ * @return The number of chunks in super-chunk. If some problem is
+ * detected, this number will be negative.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy);
+
+/**
+ * @brief Delete a chunk at a specific position in a super-chunk.
+ *
+ * @param schunk The super-chunk where the chunk will be deleted.
+ * @param nchunk The position where the chunk will be deleted.
+ *
+ * @return The number of chunks in super-chunk. If some problem is
+ * detected, this number will be negative.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_delete_chunk(blosc2_schunk *schunk, int64_t nchunk);
+
+/**
+ * @brief Append a @p src data buffer to a super-chunk.
+ *
+ * @param schunk The super-chunk where data will be appended.
+ * @param src The buffer of data to compress.
+ * @param nbytes The size of the @p src buffer.
+ *
+ * @return The number of chunks in super-chunk. If some problem is
+ * detected, this number will be negative.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_append_buffer(blosc2_schunk *schunk, void *src, int32_t nbytes);
+
+/**
+ * @brief Decompress and return the @p nchunk chunk of a super-chunk.
+ *
+ * If the chunk is uncompressed successfully, it is put in the @p *dest
+ * pointer.
+ *
+ * @param schunk The super-chunk from where the chunk will be decompressed.
+ * @param nchunk The chunk to be decompressed (0 indexed).
+ * @param dest The buffer where the decompressed data will be put.
+ * @param nbytes The size of the area pointed by @p *dest.
+ *
+ * @warning You must make sure that you have enough space to store the
+ * uncompressed data.
+ *
+ * @return The size of the decompressed chunk or 0 if it is non-initialized. If some problem is
+ * detected, a negative code is returned instead.
+ */
+BLOSC_EXPORT int blosc2_schunk_decompress_chunk(blosc2_schunk *schunk, int64_t nchunk, void *dest, int32_t nbytes);
+
+/**
+ * @brief Append several data buffers to a super-chunk, compressing them in parallel.
+ *
+ * When the shared pool of threads is active (see #blosc2_set_shared_threadpool), the
+ * buffers are compressed at the same time, one chunk per thread, which is faster than
+ * parallelizing the blocks inside each chunk when chunks are small.  The chunks are
+ * appended in order.  Without a shared pool, this is the same than calling
+ * #blosc2_schunk_append_buffer for every buffer.
+ *
+ * @param schunk The super-chunk where data will be appended.
+ * @param srcs The buffers of data to compress.
+ * @param nbytes The sizes of the @p srcs buffers.
+ * @param nbuffers The number of buffers.
+ *
+ * @return The number of chunks in super-chunk. If some problem is
+ * detected, this number will be negative.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_append_buffers(blosc2_schunk *schunk, void **srcs,
+                                                  const int32_t *nbytes, int nbuffers);
+
+/**
+ * @brief Set up the asynchronous appends of a super-chunk.
+ *
+ * Buffers handed over with #blosc2_schunk_append_buffer_async go to a queue of
+ * @p queue_len items, and @p nworkers background threads compress them in parallel
+ * (one chunk per worker) and append them in order, so the producers do not wait for
+ * the compression nor for the I/O.  When the chunks depend on the state of the
+ * super-chunk (prefilters, dicts, stateful tuners, zone maps, stats, Bloom filters or
+ * deltas between chunks), they are compressed in order while being appended, which
+ * still happens in the background.
+ *
+ * @param schunk The super-chunk.
+ * @param nworkers The number of workers.  0 waits for the queue to drain and stops them.
+ * @param queue_len The buffers that can be in flight at a time (at least 1).
+ *
+ * @return 0 if succeeds.  Else a negative code is returned (this includes an error of
+ * an append that happened in the background since the last flush).
+ *
+ * @warning While there are appends in flight, the super-chunk cannot be used but for
+ * queueing more of them.  Wait for them with #blosc2_schunk_flush_appends first.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_async_appends(blosc2_schunk *schunk, int nworkers, int32_t queue_len);
+
+/**
+ * @brief Hand a buffer over to the asynchronous appends of a super-chunk.
+ *
+ * This can be called from several threads at a time, and the buffers are appended in
+ * the order that they are queued.
+ *
+ * @param schunk The super-chunk, with asynchronous appends (see #blosc2_schunk_set_async_appends).
+ * @param src The buffer of data to compress.
+ * @param nbytes The size of @p src.
+ * @param copy Whether @p src is copied.  Else the queue takes the ownership of @p src,
+ * which has to be allocated with malloc(), and it is freed once it is not needed
+ * anymore (the ownership stays with the caller when this fails).
+ * @param wait Whether to wait for room in the queue when it is full.  Else
+ * #BLOSC2_ERROR_QUEUE_FULL is returned at once.
+ *
+ * @return The number of chunks that the super-chunk will have once the buffer is
+ * appended.  Else a negative code is returned, which is the error of a previous append
+ * until the next #blosc2_schunk_flush_appends (the buffers queued after a failed
+ * append are dropped).
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_append_buffer_async(blosc2_schunk *schunk, void *src, int32_t nbytes,
+                                                       bool copy, bool wait);
+
+/**
+ * @brief Wait for the asynchronous appends of a super-chunk to finish.
+ *
+ * @param schunk The super-chunk.
+ *
+ * @return 0 if all the buffers queued since the last flush were appended (or there are
+ * no asynchronous appends).  Else the error code of the first one that failed.
+ */
+BLOSC_EXPORT int blosc2_schunk_flush_appends(blosc2_schunk *schunk);
+
+/**
+ * @brief The policy for recompressing the chunks of a super-chunk once they turn cold.
+ */
+typedef struct {
+  blosc2_cparams *cparams;
+  //!< The compression parameters of the cold chunks (e.g. a slower codec with a higher clevel).
+  int64_t min_age;
+  //!< A chunk turns cold once this many chunks are appended after it (0 for never).
+  int64_t idle_appends;
+  //!< A chunk that is not read while this many chunks are appended after it turns cold (0 for never).
+} blosc2_tiering;
+
+/**
+ * @brief Set up the recompression of the chunks of a super-chunk that turn cold.
+ *
+ * After every append, the chunks that turn cold according to @p tiering are
+ * recompressed with its cparams in the shared pool of threads (see
+ * #blosc2_set_shared_threadpool), after the work that is queued there already, or in
+ * place without a pool.  The recompressed chunks replace the original ones (as with
+ * #blosc2_schunk_update_chunk) in the next appends or in #blosc2_schunk_flush_tiering,
+ * and only if they are smaller and the original ones have not changed in the meanwhile,
+ * so the readers never wait for a recompression.
+ *
+ * @param schunk The super-chunk, in memory or in a sparse frame, whose chunks do not
+ * depend on the super-chunk (no prefilters, dicts, deltas between chunks, stateful
+ * tuners, zone maps nor Bloom filters).
+ * @param tiering The policy.  NULL waits for the recompressions in flight, swaps them
+ * in and stops.
+ *
+ * @return 0 if succeeds.  Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_tiering(blosc2_schunk *schunk, const blosc2_tiering *tiering);
+
+/**
+ * @brief Wait for the recompressions of cold chunks in flight and swap them in.
+ *
+ * @param schunk The super-chunk.
+ *
+ * @return The number of chunks replaced by their recompressed version.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_flush_tiering(blosc2_schunk *schunk);
+
+/**
+ * @brief Decompress @p nchunks consecutive chunks of a super-chunk in parallel.
+ *
+ * When the shared pool of threads is active (see #blosc2_set_shared_threadpool), the
+ * chunks are decompressed at the same time, one chunk per thread.  Without a shared
+ * pool, this is the same than calling #blosc2_schunk_decompress_chunk for every chunk.
+ *
+ * @param schunk The super-chunk from where the chunks will be decompressed.
+ * @param nchunk The first chunk to be decompressed (0 indexed).
+ * @param nchunks The number of chunks to be decompressed.
+ * @param dests The buffers where the decompressed data will be put.
+ * @param nbytes The sizes of the areas pointed by @p dests.
+ *
+ * @return The total size of the decompressed chunks. If some problem is
+ * detected, a negative code is returned instead.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_decompress_chunks(blosc2_schunk *schunk, int64_t nchunk, int nchunks,
+                                                     void **dests, const int32_t *nbytes);
+
+/**
+ * @brief Return a compressed chunk that is part of a super-chunk in the @p chunk parameter.
+ *
+ * @param schunk The super-chunk from where to extract a chunk.
+ * @param nchunk The chunk to be extracted (0 indexed).
+ * @param chunk The pointer to the chunk of compressed data.
+ * @param needs_free The pointer to a boolean indicating if it is the user's
+ * responsibility to free the chunk returned or not.
+ *
+ * @warning If the super-chunk is backed by a frame that is disk-based, a buffer is allocated for the
+ * (compressed) chunk, and hence a free is needed.
+ * You can check whether the chunk requires a free with the @p needs_free parameter.
+ * If the chunk does not need a free, it means that a pointer to the location in the super-chunk
+ * (or the backing in-memory frame) is returned in the @p chunk parameter.
+ *
+ * @return The size of the (compressed) chunk or 0 if it is non-initialized. If some problem is
+ * detected, a negative code is returned instead.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chunk,
+                                         bool *needs_free);
+
+/**
+ * @brief Return a (lazy) compressed chunk that is part of a super-chunk in the @p chunk parameter.
+ *
+ * @param schunk The super-chunk from where to extract a chunk.
+ * @param nchunk The chunk to be extracted (0 indexed).
+ * @param chunk The pointer to the (lazy) chunk of compressed data.
+ * @param needs_free The pointer to a boolean indicating if it is the user's
+ * responsibility to free the chunk returned or not.
+ *
+ * @note For disk-based frames, a lazy chunk is always returned.
+ *
+ * @warning Currently, a lazy chunk can only be used by #blosc2_decompress_ctx and #blosc2_getitem_ctx.
+ *
+ * @warning If the super-chunk is backed by a frame that is disk-based, a buffer is allocated for the
+ * (compressed) chunk, and hence a free is needed.
+ * You can check whether requires a free with the @p needs_free parameter.
+ * If the chunk does not need a free, it means that a pointer to the location in the super-chunk
+ * (or the backing in-memory frame) is returned in the @p chunk parameter.  In this case the returned
+ * chunk is not lazy.
+ *
+ * @return The size of the (compressed) chunk or 0 if it is non-initialized. If some problem is
+ * detected, a negative code is returned instead.  Note that a lazy chunk is somewhat larger than
+ * a regular chunk because of the trailer section (for details see `README_CHUNK_FORMAT.rst`).
+ */
+BLOSC_EXPORT int blosc2_schunk_get_lazychunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chunk,
+                                             bool *needs_free);
+
+/**
+ * @brief A read-only view of a chunk of a super-chunk (see #blosc2_schunk_get_chunk_view).
+ *
+ * @warning For special chunks, @p chunk points to the @p header member, so the view
+ * must not be copied around (just get a new one for the same chunk).
+ */
+typedef struct {
+  const uint8_t *chunk;
+  //!< The (compressed) chunk, ready to be passed to #blosc2_decompress_ctx or #blosc2_getitem_ctx.
+  int32_t cbytes;
+  //!< The size of the (compressed) chunk.
+  int32_t nbytes;
+  //!< The size of the decompressed chunk.
+  int special;
+  //!< The kind of special value of the chunk (#BLOSC2_NO_SPECIAL for regular chunks).
+  uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+  //!< The storage for special chunks (internal).
+} blosc2_chunk_view;
+
+/**
+ * @brief Get a view of a chunk that is part of a super-chunk, with no copies nor allocations.
+ *
+ * Chunks with special values (zeros, NaNs...) are built in the view itself, and the
+ * rest just point to the super-chunk (or to the backing in-memory frame).  This
+ * works for every chunk of in-memory super-chunks and of frames using the
+ * memory-mapped io, and for the special chunks of any frame.
+ *
+ * @param schunk The super-chunk from where to get the chunk.
+ * @param nchunk The chunk to be viewed (0 indexed).
+ * @param view The view to fill.  It is valid until the super-chunk is modified or freed.
+ *
+ * @return The size of the (compressed) chunk. If the chunk can only be read from a file
+ * (use #blosc2_schunk_get_chunk then), or some other problem is detected, a negative code
+ * is returned instead.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_chunk_view(blosc2_schunk *schunk, int64_t nchunk, blosc2_chunk_view *view);
+
+/**
+ * @brief Get what a chunk of a super-chunk is made of (codec, filters, sizes...).
+ *
+ * Only the header of the chunk is read, so this is cheap even for chunks in big
+ * on-disk frames.
+ *
+ * @param schunk The super-chunk the chunk is part of.
+ * @param nchunk The chunk (0 indexed).
+ * @param info The pointer where the info will be put.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_chunk_info(blosc2_schunk *schunk, int64_t nchunk, blosc2_chunk_info *info);
+
+/**
+ * @brief Get what a range of chunks of a super-chunk are made of.
+ *
+ * Like #blosc2_schunk_get_chunk_info for the chunks from @p start to @p stop, but
+ * reusing the open files of on-disk frames for all of them.
+ *
+ * @param schunk The super-chunk the chunks are part of.
+ * @param start The first chunk (0 indexed).
+ * @param stop The first chunk that is not in the range.
+ * @param info The array where the info will be put (of @p stop - @p start items).
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_chunks_info(blosc2_schunk *schunk, int64_t start, int64_t stop,
+                                               blosc2_chunk_info *info);
+
+/**
+ * @brief Write the (compressed) chunks of a super-chunk to a file descriptor.
+ *
+ * The chunks from @p start to @p stop are written one after the other, just as
+ * #blosc2_schunk_get_chunk would return them, with no decompression.  The offsets of
+ * the chunks come from the (cached) index of the frame, and the chunks of frames on
+ * disk do not go through user space when the kernel can send them (copy_file_range()
+ * into plain files, sendfile() into sockets or pipes, on Linux with the filesystem
+ * io); the ones that are next to each other in the file are sent at once.  The rest
+ * of the chunks (in memory, memory-mapped or special) are just written.
+ *
+ * The sizes of the chunks, for telling them apart at the other end, can be had with
+ * #blosc2_schunk_get_chunks_info.
+ *
+ * @param schunk The super-chunk the chunks are part of.
+ * @param start The first chunk (0 indexed).
+ * @param stop The first chunk that is not in the range.
+ * @param fd The (blocking) file descriptor to write to, at its current position.
+ *
+ * @return The number of bytes written if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_send_chunks(blosc2_schunk *schunk, int64_t start, int64_t stop, int fd);
+
+/**
+ * @brief Fill buffer with a schunk slice.
+ *
+ * Only the blocks of the chunks at the edges of the slice that overlap it are
+ * decompressed.  When the shared pool of threads is active (see
+ * #blosc2_set_shared_threadpool), the chunks in between are decompressed in parallel,
+ * one chunk per thread.
+ *
+ * @param schunk The super-chunk from where to extract a slice.
+ * @param start Index (0-based) where the slice begins.
+ * @param stop The first index (0-based) that is not in the selected slice.
+ * @param buffer The buffer where the data will be stored.
+ *
+ * @warning You must make sure that you have enough space in buffer to store the
+ * uncompressed data.
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t stop, void *buffer);
+
+/**
+ * @brief Fill buffer with every @p step -th item of a schunk slice.
+ *
+ * Only the chunks and, in them, the blocks holding some of the items are read and
+ * decompressed, so when @p step spans several blocks the cost falls with it.  This is
+ * meant for previews and decimations of long super-chunks.
+ *
+ * @param schunk The super-chunk from where to extract the items.
+ * @param start Index (0-based) of the first item.
+ * @param stop The first index (0-based) that is not in the selected slice.
+ * @param step The distance between the items (1 is the same than #blosc2_schunk_get_slice_buffer).
+ * @param buffer The buffer where the items will be stored one after the other (of
+ * `(stop - start + step - 1) / step` items).
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_slice_buffer_step(blosc2_schunk *schunk, int64_t start, int64_t stop,
+                                                     int64_t step, void *buffer);
+
+/**
+ * @brief Get a single item of a schunk, for point lookups.
+ *
+ * For on-disk frames, the header, bstarts and block sizes of the chunks that are
+ * looked into are kept between calls (for the last 64 chunks or so), along with an
+ * open handle to their file, so that a lookup only reads and decompresses the block
+ * of the item.  Any change to the super-chunk drops them.
+ *
+ * @param schunk The super-chunk from where to get the item.
+ * @param index Index (0-based) of the item.
+ * @param dest The buffer where the item will be stored (of typesize bytes).
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_item(blosc2_schunk *schunk, int64_t index, void *dest);
+
+/**
+ * @brief Update a schunk slice from buffer.
+ *
+ * @param schunk The super-chunk where to set the slice.
+ * @param start Index (0-based) where the slice begins.
+ * @param stop The first index (0-based) that is not in the selected slice.
+ * @param buffer The buffer containing the data to set.
+ *
+ *
+ * @return An error code.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t stop, void *buffer);
+
+/**
+ * @brief Enable, resize or disable the cache of decompressed chunks of a super-chunk.
+ *
+ * When enabled, blosc2_schunk_get_slice_buffer() and b2nd_get_slice_cbuffer() (and
+ * friends) keep the most recently read chunks decompressed, so that repeated reads of
+ * neighbouring slices do not go through the codecs again.  The least recently used
+ * chunks are evicted when the cache would exceed @p max_nbytes.  The cached chunks
+ * are dropped when the super-chunk is modified by blosc2_schunk_update_chunk(),
+ * blosc2_schunk_insert_chunk(), blosc2_schunk_delete_chunk() or
+ * blosc2_schunk_reorder_offsets().
+ *
+ * @param schunk The super-chunk.
+ * @param max_nbytes The maximum size (in bytes) of the decompressed chunks kept.
+ * 0 disables the cache and releases its memory.
+ *
+ * @warning The cache is not thread-safe, in the same way as the super-chunk.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_chunk_cache(blosc2_schunk *schunk, int64_t max_nbytes);
+
+/**
+ * @brief The memory used by a super-chunk, by category (see #blosc2_schunk_memory_usage).
+ */
+typedef struct {
+  int64_t schunk;
+  //!< The super-chunk itself, along with its storage and params.
+  blosc2_ctx_memory contexts;
+  //!< The compression and decompression contexts (the ones of concurrent reads and writes too).
+  int64_t chunks;
+  //!< The chunks kept in memory (the buffer of in-memory frames, or the chunks and their index otherwise).
+  int64_t frame;
+  //!< The bookkeeping of the frame (decoded offsets, copies of the header and the trailer, scratch).
+  int64_t metalayers;
+  //!< The metalayers, the variable-length metalayers and the shared dictionary.
+  int64_t caches;
+  //!< The decompressed chunks of the chunk cache and of the deltas, and the chunks read ahead or for lookups.
+  int64_t total;
+  //!< The sum of all of the above.
+} blosc2_schunk_memory;
+
+/**
+ * @brief Get the memory that a super-chunk is holding.
+ *
+ * Only the memory owned by the super-chunk is counted: the buffers of frames that
+ * are borrowed (see blosc2_schunk_from_buffer()) or mapped from files, and the chunks
+ * borrowed from the caller (see blosc2_schunk_append_borrowed()), are not.
+ *
+ * @param schunk The super-chunk.
+ * @param usage The pointer where the breakdown will be stored.
+ *
+ * @warning This must not be called while the super-chunk is being read or written.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_memory_usage(blosc2_schunk *schunk, blosc2_schunk_memory *usage);
+
+/**
+ * @brief Keep the chunks of an in-memory super-chunk (without a frame) in large slabs
+ * that it owns, instead of allocating every chunk on its own.
+ *
+ * The chunks appended, inserted or updated from then on are copied into the slabs (and
+ * blosc2_schunk_append_buffer() compresses them in a scratch buffer that is reused), so
+ * appending lots of small chunks is not dominated by the allocator.  The slabs are freed
+ * in one go by blosc2_schunk_free(); the room of the chunks updated or deleted is not
+ * reused until then.
+ *
+ * @param schunk The super-chunk.
+ * @param slab_size The size of the slabs (chunks that are larger get a slab of their own).
+ * 0 stops taking new chunks into the slabs (the chunks there stay until the super-chunk is freed).
+ *
+ * @warning The chunks in the slabs must not be freed by the caller, e.g. when taken out of
+ * `schunk->data`.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_chunk_arena(blosc2_schunk *schunk, int32_t slab_size);
+
+/**
+ * @brief The callback that hands a buffer of a borrowed chunk back to its owner
+ * (see blosc2_schunk_append_borrowed()).
+ */
+typedef void (*blosc2_release_cb)(void *buffer, void *params);
+
+/**
+ * @brief Append data of the caller to an in-memory super-chunk (without a frame) as a
+ * chunk with no compression, without copying it.
+ *
+ * The data has to be in @p buffer after #BLOSC_EXTENDED_HEADER_LENGTH bytes of room,
+ * where the header of a memcpyed chunk (clevel 0) is written, so that the buffer becomes
+ * the chunk itself and appending costs the same whatever its size.  The super-chunk
+ * reads the chunk from there until it drops it (when it is updated, deleted or the
+ * super-chunk is freed), and then calls @p release with @p buffer and @p params.  The
+ * data is only copied when the super-chunk is serialized (e.g. with
+ * blosc2_schunk_to_buffer() or blosc2_schunk_to_file()) or copied.
+ *
+ * @param schunk The super-chunk.
+ * @param buffer The header room followed by the @p nbytes of data.  The caller must not
+ * modify nor free it until it is released.
+ * @param nbytes The size of the data (not counting the room for the header).
+ * @param release The callback that hands the buffer back (NULL if nothing is to be done).
+ * @param params The parameters for @p release.
+ *
+ * @return The number of chunks in the super-chunk. If some problem is detected (e.g.
+ * for super-chunks in frames, with concurrent writers or with deltas between chunks),
+ * this number will be negative, and the buffer is not taken.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_append_borrowed(blosc2_schunk *schunk, void *buffer, int32_t nbytes,
+                                                   blosc2_release_cb release, void *params);
+
+/**
+ * @brief Get the statistics of the cache of decompressed chunks of a super-chunk.
+ *
+ * @param schunk The super-chunk.
+ * @param hits The number of reads served by the cache. Can be NULL.
+ * @param misses The number of reads that had to decompress the chunk. Can be NULL.
+ * @param nbytes The current size (in bytes) of the cache. Can be NULL.
+ *
+ * @return 0 if succeeds. Else a negative code (BLOSC2_ERROR_NOT_FOUND if the cache
+ * is not enabled) is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_get_chunk_cache_stats(blosc2_schunk *schunk, int64_t *hits,
+                                                     int64_t *misses, int64_t *nbytes);
+
+/**
+ * @brief Hint that the chunks of a super-chunk are going to be read sequentially.
+ *
+ * For super-chunks backed by files, a background thread reads the next @p depth
+ * chunks while the current one is being decompressed by blosc2_schunk_decompress_chunk(),
+ * so that I/O and decompression overlap in sequential scans.  Super-chunks in memory
+ * have nothing to read ahead, and the hint is ignored for them.
+ *
+ * @param schunk The super-chunk.
+ * @param depth The number of chunks to read ahead. 0 disables the read-ahead.
+ *
+ * @warning The read-ahead thread uses the I/O callbacks of the super-chunk concurrently
+ * with the calling thread, so user-defined backends must support that.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_prefetch(blosc2_schunk *schunk, int depth);
+
+/**
+ * @brief Enable, resize or disable the concurrent reads of a super-chunk.
+ *
+ * When enabled, blosc2_schunk_decompress_chunk(), blosc2_schunk_get_slice_buffer() and
+ * the getters of b2nd arrays (b2nd_get_slice_cbuffer(), b2nd_to_cbuffer(), ...) can be
+ * called on the same super-chunk from several threads at a time.  Every call takes a
+ * free decompression context out of a pool of @p nctxs ones (with the dparams of the
+ * super-chunk) with an atomic compare-and-swap, so readers never wait for each other;
+ * when all of them are in use, a context is created just for the call.  The header and
+ * the chunk offsets of frames are read up front, so that reads do not modify them.
+ *
+ * @param schunk The super-chunk.
+ * @param nctxs The number of decompression contexts, usually the number of reader
+ * threads. 0 disables the concurrent reads and releases the contexts.
+ *
+ * @warning While enabled, the chunks of the super-chunk cannot be modified, and neither
+ * the chunk cache nor the read-ahead can be used.  This function itself must not be
+ * called while there are reads in flight.  Postfilters get the chunk being read in
+ * `nchunk`, as usual, but `current_nchunk` of the super-chunk is not updated.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_concurrent_reads(blosc2_schunk *schunk, int nctxs);
+
+/**
+ * @brief Enable, resize or disable the concurrent writes of a super-chunk on a sparse frame.
+ *
+ * When enabled, blosc2_schunk_append_buffer(), blosc2_schunk_append_chunk() and
+ * blosc2_schunk_update_chunk() can be called on the same super-chunk from several
+ * threads at a time, with no external locking.  Every chunk is written to a file of its
+ * own, with an id taken from an atomic counter, and only the update of the in-memory
+ * chunk index and of the counters of the super-chunk is serialized; the index is merged
+ * into the frame on disk once, when the concurrent writes are disabled (or the super-chunk
+ * is freed), instead of being rewritten on every write.  The file of an updated chunk is
+ * removed once the index points to the new one.  blosc2_schunk_append_buffer() takes
+ * a free compression context out of a pool of @p nctxs ones, like
+ * blosc2_schunk_set_concurrent_reads() does for reads.
+ *
+ * @param schunk The super-chunk, which must be stored in a sparse frame
+ * (`contiguous=false` and a `urlpath`).
+ * @param nctxs The number of compression contexts, usually the number of writer
+ * threads. 0 disables the concurrent writes, writes down the index and releases the contexts.
+ *
+ * @warning While enabled, the chunks cannot be read, inserted, deleted or reordered,
+ * the chunk cache, the read-ahead and the concurrent reads cannot be used, and the
+ * order of the chunks appended from different threads is the order in which their
+ * index updates happen.  Chunks smaller than the chunksize can only be the last one.
+ * The stats and zone maps of the chunks are not recorded (see blosc2_cparams.record_stats
+ * and blosc2_cparams.zonemap), the existing zone maps are dropped, and prefilters get -1
+ * in `nchunk`.  This function itself must not be called while there are writes in
+ * flight.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_concurrent_writes(blosc2_schunk *schunk, int nctxs);
+
+/**
+ * @brief Enable or disable the versioned commits of the appends to a super-chunk on a
+ * contiguous frame on disk, so that other processes can keep reading it meanwhile.
+ *
+ * Appending a chunk rewrites the offsets index and the trailer of a frame in place, so
+ * the readers of the file can find chunk data where they expect the index.  With
+ * versioned commits, the chunks, the new index and the new trailer are written past
+ * the end of the frame, and then the header is, which publishes the new version with a
+ * single write.  Every append is committed this way, or every bulk append (see
+ * #blosc2_schunk_begin_bulk) as a whole.  The readers see the version that was there
+ * when they opened the frame, until blosc2_schunk_refresh().
+ *
+ * @param schunk The super-chunk, which must be stored in a contiguous frame
+ * (`contiguous=true` and a `urlpath`).
+ * @param enable Whether the appends are published as new versions.
+ *
+ * @remark The index and trailer of every version are left behind among the chunks (and
+ * they count in `cbytes`), until blosc2_schunk_compact().  Only the appends are versioned:
+ * the readers must be stopped for any other change.  This is not a durability
+ * guarantee: nothing is synced to the storage device.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_schunk_set_versioned_commits(blosc2_schunk *schunk, bool enable);
+
+/**
+ * @brief Catch up with the appends published by a writer with versioned commits (see
+ * blosc2_schunk_set_versioned_commits()) since a super-chunk on a contiguous frame on
+ * disk was opened or last refreshed.
  *
- * @param storage The storage properties.
+ * Only the header and the end of the trailer are read; the chunks read so far are kept.
  *
- * @remark In case that storage.urlpath is not NULL, the data is stored
- * on-disk.  If the data file(s) exist, they are *overwritten*.
+ * @param schunk The super-chunk.  It must not be read (or written) from other threads
+ * meanwhile.
  *
- * @return The new super-chunk.
+ * @return The number of chunks in the super-chunk. Else a negative code is returned.
  */
-BLOSC_EXPORT blosc2_schunk* blosc2_schunk_new(blosc2_storage *storage);
+BLOSC_EXPORT int64_t blosc2_schunk_refresh(blosc2_schunk *schunk);
 
 /**
- * Create a copy of a super-chunk.
+ * @brief Train a dictionary on the first chunks of a super-chunk and share it among all its chunks.
  *
- * @param schunk The super-chunk to be copied.
- * @param storage The storage properties.
+ * The dictionary is stored once, in the "b2dict" variable-length metalayer, and the
+ * chunks reference it by id instead of embedding a dictionary of their own.  The
+ * existing chunks are recompressed with it, and so are the ones appended later on
+ * (also after reopening the super-chunk).  This pays off for small chunks, where a
+ * dictionary per chunk takes a large share of the compressed size.
  *
- * @return The new super-chunk.
+ * @param schunk The super-chunk.  Its codec must support dictionaries (ZSTD, LZ4
+ * or BLOSCLZ).
+ * @param nchunks The number of (leading) chunks to train on.
+ *
+ * @note A super-chunk can only be trained once.  Chunks that reference the dictionary
+ * can only be decompressed through their super-chunk.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
  */
-BLOSC_EXPORT blosc2_schunk* blosc2_schunk_copy(blosc2_schunk *schunk, blosc2_storage *storage);
+BLOSC_EXPORT int blosc2_schunk_train_dict(blosc2_schunk *schunk, int64_t nchunks);
 
 /**
- * @brief Create a super-chunk out of a contiguous frame buffer.
+ * @brief The statistics recorded for a chunk (see #blosc2_cparams.record_stats).
+ */
+typedef struct {
+  int64_t nchunk;
+  //!< The position of the chunk when it was appended.
+  int32_t nbytes;
+  //!< The uncompressed size of the chunk.
+  int32_t cbytes;
+  //!< The compressed size of the chunk.
+  float ctime;
+  //!< The time for compressing the chunk, in seconds.
+  uint8_t compcode;
+  //!< The codec used for the chunk.
+  uint8_t clevel;
+  //!< The compression level used for the chunk.
+  uint8_t filters[BLOSC2_MAX_FILTERS];
+  //!< The filters used for the chunk.
+  int32_t splitmode;
+  //!< Whether the blocks were split (#BLOSC_ALWAYS_SPLIT) or not (#BLOSC_NEVER_SPLIT).
+  float entropy;
+  //!< The mean of the sampled entropies of the blocks, in bits per byte.
+  int32_t nblocks;
+  //!< The number of blocks recorded for the chunk (0 for special chunks).
+} blosc2_chunk_stats;
+
+/**
+ * @brief The statistics recorded for a block of a chunk.
+ */
+typedef struct {
+  float cratio;
+  //!< The compression ratio of the block.
+  float entropy;
+  //!< The entropy of a few samples of the block (before filters), in bits per byte.
+} blosc2_block_stats;
+
+/**
+ * @brief Get the statistics recorded for the chunks appended to a super-chunk.
  *
- * @param cframe The buffer of the in-memory frame.
- * @param copy Whether the super-chunk should make a copy of
- * the @p cframe data or not.  The copy will be made to an internal
- * sparse frame.
+ * When the cparams of a super-chunk have `record_stats` set, every chunk appended with
+ * blosc2_schunk_append_buffer() gets its compression ratio, time and params, along with
+ * the compression ratio and sampled entropy of each of its blocks, recorded in the
+ * "b2stats" variable-length metalayer.  This gives a map of the compressibility of the
+ * data that needs no recompression, and the adaptive tuning of #BLOSC_STUNE starts from
+ * the best params recorded when it has no state of its own yet.  The stats of the blocks
+ * are stored quantized (the cratios within 0.3% and the entropies within 1/64 of a bit).
  *
- * @remark If copy is false, the @p cframe buffer passed will be owned
- * by the super-chunk and will be automatically freed when
- * blosc2_schunk_free() is called.  If the user frees it after the
- * opening, bad things will happen.  Don't do that (or set @p copy).
+ * @param schunk The super-chunk.
+ * @param chunks The malloc()ed stats of the chunks, in the order they were appended.
+ * @param blocks The malloc()ed stats of the blocks, for every chunk after the ones of the
+ * previous chunk (NULL if not wanted).
  *
- * @param len The length of the buffer (in bytes).
+ * @note The record is rewritten on every append, so this is meant for tuning runs.  Chunks
+ * updated, inserted or deleted afterwards are not reflected.
  *
- * @return The new super-chunk.
+ * @return The number of chunks recorded (0 if none). Else a negative code is returned.
  */
-BLOSC_EXPORT blosc2_schunk* blosc2_schunk_from_buffer(uint8_t *cframe, int64_t len, bool copy);
+BLOSC_EXPORT int64_t blosc2_schunk_get_recorded_stats(blosc2_schunk *schunk, blosc2_chunk_stats **chunks,
+                                                      blosc2_block_stats **blocks);
 
 /**
- * @brief Set the private `avoid_cframe_free` field in a frame.
- *
- * @param schunk The super-chunk referencing the frame.
- * @param avoid_cframe_free The value to set in the blosc2_frame_s structure.
- *
- * @warning If you set it to `true` you will be responsible of freeing it.
+ * @brief A bound of the values of a zone map, as interpreted by its kind (#BLOSC2_ZONEMAP_INT and friends).
  */
-BLOSC_EXPORT void blosc2_schunk_avoid_cframe_free(blosc2_schunk *schunk, bool avoid_cframe_free);
+typedef union {
+  int64_t i;
+  //!< The value for #BLOSC2_ZONEMAP_INT.
+  uint64_t u;
+  //!< The value for #BLOSC2_ZONEMAP_UINT.
+  double f;
+  //!< The value for #BLOSC2_ZONEMAP_FLOAT.
+} blosc2_zonemap_value;
 
 /**
- * @brief Open an existing super-chunk that is on-disk (frame). No in-memory copy is made.
- *
- * @param urlpath The file name.
- *
- * @return The new super-chunk.  NULL if not found or not in frame format.
+ * @brief The summary of the values of a chunk or a block (see #blosc2_cparams.zonemap).
  */
-BLOSC_EXPORT blosc2_schunk* blosc2_schunk_open(const char* urlpath);
+typedef struct {
+  blosc2_zonemap_value min;
+  //!< The minimum of the values (NaNs aside).
+  blosc2_zonemap_value max;
+  //!< The maximum of the values (NaNs aside).
+  int32_t nnans;
+  //!< The number of NaNs (always 0 for integers).
+  int32_t nitems;
+  //!< The number of items.  When they are all NaNs, the min and max are meaningless.
+} blosc2_zonemap;
 
 /**
- * @brief Open an existing super-chunk that is on-disk (frame). No in-memory copy is made.
+ * @brief Get the zone maps of a chunk of a super-chunk, without decompressing it.
  *
- * @param urlpath The file name.
+ * When the cparams of a super-chunk have a `zonemap` kind, the min, the max and the
+ * number of NaNs of every block are computed while the chunks are compressed with
+ * blosc2_schunk_append_buffer() (when the blocks are still in cache), and kept along
+ * with the ones of the whole chunk in the "b2zonemap" variable-length metalayer.  Query
+ * engines can then skip the chunks and blocks whose values cannot match a predicate
+ * (see #blosc2_schunk_zonemap_maskout).  The super-chunks opened later on keep on
+ * recording them.
  *
- * @param offset The frame offset.
+ * @param schunk The super-chunk.
+ * @param nchunk The chunk.
+ * @param chunk The zone map of the whole chunk (NULL if not wanted).
+ * @param blocks The malloc()ed zone maps of the blocks (NULL if not wanted).
  *
- * @return The new super-chunk.  NULL if not found or not in frame format.
+ * @note Chunks appended in other ways (including the ones of concurrent writers and
+ * prefiltered ones), as well as updated ones, have no zone maps.  Special chunks get the
+ * one of the chunk only.  The zone maps do not survive a recompression of the chunks.
+ *
+ * @return The number of blocks (0 for special chunks). #BLOSC2_ERROR_NOT_FOUND if the
+ * chunk has no zone maps. Else a negative code is returned.
  */
-BLOSC_EXPORT blosc2_schunk* blosc2_schunk_open_offset(const char* urlpath, int64_t offset);
+BLOSC_EXPORT int blosc2_schunk_get_zonemap(blosc2_schunk *schunk, int64_t nchunk, blosc2_zonemap *chunk,
+                                           blosc2_zonemap **blocks);
 
 /**
- * @brief Open an existing super-chunk (no copy is made) using a user-defined I/O interface.
- *
- * @param urlpath The file name.
+ * @brief Mask out the blocks of a chunk that have no values within a range, as told by its zone maps.
  *
- * @param udio The user-defined I/O interface.
+ * The @p maskout can be passed to #blosc2_set_maskout right before decompressing the chunk.
  *
- * @return The new super-chunk.
+ * @param schunk The super-chunk.
+ * @param nchunk The chunk.
+ * @param low The lowest value wanted (NULL means no lower bound).
+ * @param high The highest value wanted (NULL means no upper bound).
+ * @param maskout The mask to fill, where the blocks to skip get true.
+ * @param nblocks The number of blocks of the chunk (the items in @p maskout).
+ *
+ * @return The number of blocks masked out (@p nblocks when the whole chunk can be skipped).
+ * #BLOSC2_ERROR_NOT_FOUND if the chunk has no zone maps. Else a negative code is returned.
  */
-BLOSC_EXPORT blosc2_schunk* blosc2_schunk_open_udio(const char* urlpath, const blosc2_io *udio);
+BLOSC_EXPORT int blosc2_schunk_zonemap_maskout(blosc2_schunk *schunk, int64_t nchunk,
+                                               const blosc2_zonemap_value *low,
+                                               const blosc2_zonemap_value *high,
+                                               bool *maskout, int nblocks);
 
-/* @brief Convert a super-chunk into a contiguous frame buffer.
+/**
+ * @brief The callback that gets the items matching a range (see #blosc2_schunk_filter_range).
  *
- * @param schunk The super-chunk to convert.
- * @param cframe The address of the destination buffer (output).
- * @param needs_free The pointer to a boolean indicating if it is the user's
- * responsibility to free the resulting @p cframe buffer or not.
+ * @param user_data The user data passed to #blosc2_schunk_filter_range.
+ * @param nchunk The chunk.
+ * @param start The index of the first item of the chunk in the super-chunk.
+ * @param indices The indices of the matching items in the chunk, in ascending order.
+ * @param nindices The number of matching items (never 0).
  *
- * @return If successful, return the size of the (frame) @p cframe buffer.
- * Else, a negative value.
+ * @return 0 if succeeds. Else a negative value, which stops the scan.
  */
-BLOSC_EXPORT int64_t blosc2_schunk_to_buffer(blosc2_schunk* schunk, uint8_t** cframe, bool* needs_free);
+typedef int (*blosc2_filter_range_cb)(void *user_data, int64_t nchunk, int64_t start,
+                                      const int32_t *indices, int32_t nindices);
 
-/* @brief Store a super-chunk into a file.
+/**
+ * @brief Find the items of a super-chunk that are within a range, decompressing only the
+ * blocks that may have any.
  *
- * @param schunk The super-chunk to write.
- * @param urlpath The path for persistent storage.
+ * The zone maps of the chunks (see #blosc2_schunk_get_zonemap) tell which blocks can be
+ * skipped, and the rest are decompressed in parallel with the threads of the
+ * decompression context of the super-chunk, which compare their items while they are
+ * still in cache.  The items are read as told by the zone maps (or by the `zonemap` of
+ * the cparams when there are none yet), and NaNs never match.
  *
- * @return If successful, return the size of the (fileframe) in @p urlpath.
- * Else, a negative value.
- */
-BLOSC_EXPORT int64_t blosc2_schunk_to_file(blosc2_schunk* schunk, const char* urlpath);
-
-/* @brief Append a super-chunk into a file.
+ * @param schunk The super-chunk.
+ * @param low The lowest value wanted (NULL means no lower bound).
+ * @param high The highest value wanted (NULL means no upper bound).
+ * @param callback The function getting the matches of every chunk with any, in order.
+ * @param user_data The data passed to @p callback (optional).
  *
- * @param schunk The super-chunk to write.
- * @param urlpath The path for persistent storage.
+ * @note Chunks without zone maps are scanned as a whole.  With a postfilter in the
+ * dparams of the super-chunk, the items are compared after the whole chunk is decompressed.
  *
- * @return If successful, return the offset where @p schunk has been appended in @p urlpath.
- * Else, a negative value.
+ * @return The number of matching items. Else a negative code is returned.
  */
-BLOSC_EXPORT int64_t blosc2_schunk_append_file(blosc2_schunk* schunk, const char* urlpath);
+BLOSC_EXPORT int64_t blosc2_schunk_filter_range(blosc2_schunk *schunk, const blosc2_zonemap_value *low,
+                                                const blosc2_zonemap_value *high,
+                                                blosc2_filter_range_cb callback, void *user_data);
 
 /**
- * @brief Release resources from a super-chunk.
+ * @brief Index the keys of the chunks of a super-chunk with Bloom filters, so that the
+ * chunks that may have a key can be found without decompressing any (see
+ * #blosc2_schunk_bloom_lookup).
  *
- * @param schunk The super-chunk to be freed.
+ * The keys are the items of the super-chunk (of typesize bytes).  Every chunk gets a
+ * filter of the same size, which is built while it is compressed with
+ * blosc2_schunk_append_buffer() (the chunks that are in the super-chunk already are
+ * decompressed to build theirs now).  The filters are kept in the "b2bloom"
+ * variable-length metalayer, so they go with the frame, and the super-chunks opened
+ * later on keep on building them.
  *
- * @remark All the memory resources attached to the super-chunk are freed.
- * If the super-chunk is on-disk, the data continues there for a later
- * re-opening.
+ * @param schunk The super-chunk.
+ * @param nkeys The number of keys the filters are sized for (0 means the items of a chunk,
+ * which needs a super-chunk with chunks).  Chunks with more keys get more false positives.
+ * @param bits_per_key The bits of the filters per key (10 gives about 1% of false positives).
+ * 0 drops the filters.
  *
- * @return 0 if success.
+ * @note Chunks appended in other ways (but for the ones of #blosc2_schunk_concat
+ * with the same filters), as well as inserted and updated ones, have no filter, and
+ * they are always candidates.  Concurrent writes (see #blosc2_schunk_set_concurrent_writes)
+ * cannot be used in super-chunks with filters.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
  */
-BLOSC_EXPORT int blosc2_schunk_free(blosc2_schunk *schunk);
+BLOSC_EXPORT int blosc2_schunk_set_bloom(blosc2_schunk *schunk, int32_t nkeys, int bits_per_key);
 
 /**
- * @brief Append an existing @p chunk to a super-chunk.
+ * @brief Find the chunks of a super-chunk that may have a key, as told by their Bloom
+ * filters (see #blosc2_schunk_set_bloom).
  *
- * @param schunk The super-chunk where the chunk will be appended.
- * @param chunk The @p chunk to append.  An internal copy is made, so @p chunk can be reused or
- * freed if desired.
- * @param copy Whether the chunk should be copied internally or can be used as-is.
+ * @param schunk The super-chunk.
+ * @param key The key (typesize bytes).
+ * @param nchunks The malloc()ed candidate chunks, in ascending order.  The key is in none
+ * of the rest for sure.
  *
- * @return The number of chunks in super-chunk. If some problem is
- * detected, this number will be negative.
+ * @return The number of candidate chunks. #BLOSC2_ERROR_NOT_FOUND if the keys of the
+ * super-chunk are not indexed. Else a negative code is returned.
  */
-BLOSC_EXPORT int64_t blosc2_schunk_append_chunk(blosc2_schunk *schunk, uint8_t *chunk, bool copy);
+BLOSC_EXPORT int64_t blosc2_schunk_bloom_lookup(blosc2_schunk *schunk, const void *key, int64_t **nchunks);
 
 /**
-  * @brief Update a chunk at a specific position in a super-chunk.
-  *
-  * @param schunk The super-chunk where the chunk will be updated.
-  * @param nchunk The position where the chunk will be updated.
-  * @param chunk The new @p chunk. If an internal copy is made, the @p chunk can be reused or
-  * freed if desired.
-  * @param copy Whether the chunk should be copied internally or can be used as-is.
-  *
-  * @return The number of chunks in super-chunk. If some problem is
-  * detected, this number will be negative.
-  */
-BLOSC_EXPORT int64_t blosc2_schunk_update_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy);
-
-/**
- * @brief Insert a chunk at a specific position in a super-chunk.
+ * @brief Store the chunks of a super-chunk as deltas wrt the previous ones, which
+ * compress better for slowly varying data (e.g. time series).
  *
- * @param schunk The super-chunk where the chunk will be appended.
- * @param nchunk The position where the chunk will be inserted.
- * @param chunk The @p chunk to insert. If an internal copy is made, the @p chunk can be reused or
- * freed if desired.
- * @param copy Whether the chunk should be copied internally or can be used as-is.
+ * Every chunk is XORed with the previous one (decompressed) before it is compressed,
+ * but for the keyframes (the chunks that are a multiple of @p keyframe_interval), which
+ * are stored as they are.  Reading a chunk needs the previous ones since the keyframe,
+ * so the last chunk decompressed is kept around to make sequential reads as fast as
+ * usual, and the interval bounds the chunks to decompress for random ones.  The
+ * interval is kept in the "b2xdelta" variable-length metalayer, so it goes with the frame.
  *
- * @return The number of chunks in super-chunk. If some problem is
- * detected, this number will be negative.
+ * @param schunk The super-chunk, without chunks yet.
+ * @param keyframe_interval The chunks between keyframes (2 at least). 0 disables the deltas.
+ *
+ * @note The chunks can only be appended (and the last one deleted).  Inserting, updating,
+ * reordering, filling and concatenating chunks are not supported, as well as concurrent
+ * writes, zone maps, prefilters and postfilters.  The chunks obtained with
+ * #blosc2_schunk_get_chunk hold the deltas.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
  */
-BLOSC_EXPORT int64_t blosc2_schunk_insert_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t *chunk, bool copy);
+BLOSC_EXPORT int blosc2_schunk_set_xdelta(blosc2_schunk *schunk, int32_t keyframe_interval);
 
 /**
- * @brief Delete a chunk at a specific position in a super-chunk.
- *
- * @param schunk The super-chunk where the chunk will be deleted.
- * @param nchunk The position where the chunk will be deleted.
- *
- * @return The number of chunks in super-chunk. If some problem is
- * detected, this number will be negative.
+ * @brief The reductions that #blosc2_schunk_reduce can compute (they can be or'ed together).
  */
-BLOSC_EXPORT int64_t blosc2_schunk_delete_chunk(blosc2_schunk *schunk, int64_t nchunk);
+enum {
+  BLOSC2_REDUCE_SUM = 0x1,
+  //!< The sum of the values.
+  BLOSC2_REDUCE_MIN = 0x2,
+  //!< The minimum of the values.
+  BLOSC2_REDUCE_MAX = 0x4,
+  //!< The maximum of the values.
+  BLOSC2_REDUCE_COUNT = 0x8,
+  //!< The number of values and of NaNs.
+};
 
 /**
- * @brief Append a @p src data buffer to a super-chunk.
- *
- * @param schunk The super-chunk where data will be appended.
- * @param src The buffer of data to compress.
- * @param nbytes The size of the @p src buffer.
+ * @brief The result of the reductions of the items of a super-chunk (see #blosc2_schunk_reduce).
  *
- * @return The number of chunks in super-chunk. If some problem is
- * detected, this number will be negative.
+ * NaNs are left out of the sum, the min and the max.  The fields of the reductions that
+ * are not asked for are 0.
  */
-BLOSC_EXPORT int64_t blosc2_schunk_append_buffer(blosc2_schunk *schunk, void *src, int32_t nbytes);
+typedef struct {
+  blosc2_zonemap_value sum;
+  //!< The sum of the values.  Integers are added up in 64 bits, wrapping around on overflow.
+  blosc2_zonemap_value min;
+  //!< The minimum of the values (meaningless when there are none).
+  blosc2_zonemap_value max;
+  //!< The maximum of the values (meaningless when there are none).
+  int64_t count;
+  //!< The number of values (NaNs aside).
+  int64_t nnans;
+  //!< The number of NaNs (always 0 for integers).
+} blosc2_reduction;
 
 /**
- * @brief Decompress and return the @p nchunk chunk of a super-chunk.
+ * @brief Reduce the items of a super-chunk, decompressing only what cannot be worked out otherwise.
  *
- * If the chunk is uncompressed successfully, it is put in the @p *dest
- * pointer.
+ * The special chunks (zeros, NaNs and repeated values) are reduced without decompressing
+ * them, and so are the chunks and the blocks of a single value when the zone maps of the
+ * super-chunk (see #blosc2_schunk_get_zonemap) tell about them; the min, the max and the
+ * count come out of the zone maps alone.  The rest of the blocks are reduced in parallel
+ * with the threads of the decompression context of the super-chunk, while they are still
+ * in cache and without being copied to any destination.
  *
- * @param schunk The super-chunk from where the chunk will be decompressed.
- * @param nchunk The chunk to be decompressed (0 indexed).
- * @param dest The buffer where the decompressed data will be put.
- * @param nbytes The size of the area pointed by @p *dest.
+ * @param schunk The super-chunk.
+ * @param kind How the items are read (#BLOSC2_ZONEMAP_INT, #BLOSC2_ZONEMAP_UINT or
+ * #BLOSC2_ZONEMAP_FLOAT), which has to fit the typesize of the super-chunk.  The zone maps
+ * are only used when they are of the same kind.
+ * @param ops The reductions to compute (#BLOSC2_REDUCE_SUM and friends).
+ * @param result The pointer where the result will be put.
  *
- * @warning You must make sure that you have enough space to store the
- * uncompressed data.
+ * @note The chunks of uninitialized items (#BLOSC2_SPECIAL_UNINIT) are left out.  With a
+ * postfilter in the dparams of the super-chunk, the items are reduced after every chunk is
+ * decompressed whole.
  *
- * @return The size of the decompressed chunk or 0 if it is non-initialized. If some problem is
- * detected, a negative code is returned instead.
+ * @return 0 if succeeds. Else a negative code is returned.
  */
-BLOSC_EXPORT int blosc2_schunk_decompress_chunk(blosc2_schunk *schunk, int64_t nchunk, void *dest, int32_t nbytes);
+BLOSC_EXPORT int blosc2_schunk_reduce(blosc2_schunk *schunk, int kind, int ops, blosc2_reduction *result);
 
 /**
- * @brief Return a compressed chunk that is part of a super-chunk in the @p chunk parameter.
+ * @brief Start tracking the changes of the chunks of a super-chunk, so that its replicas
+ * can be patched with just the chunks changed since their last sync.
  *
- * @param schunk The super-chunk from where to extract a chunk.
- * @param nchunk The chunk to be extracted (0 indexed).
- * @param chunk The pointer to the chunk of compressed data.
- * @param needs_free The pointer to a boolean indicating if it is the user's
- * responsibility to free the chunk returned or not.
+ * Every append, insert, update, deletion or reordering of chunks bumps a sequence
+ * number of the super-chunk, and the chunks it touches (plus the ones shifted by
+ * inserts and deletions) keep it as the sequence number of their last change.  They
+ * are stored in a reserved variable-length metalayer, which goes with the frame and
+ * with the copies of the super-chunk (see #blosc2_schunk_copy).
  *
- * @warning If the super-chunk is backed by a frame that is disk-based, a buffer is allocated for the
- * (compressed) chunk, and hence a free is needed.
- * You can check whether the chunk requires a free with the @p needs_free parameter.
- * If the chunk does not need a free, it means that a pointer to the location in the super-chunk
- * (or the backing in-memory frame) is returned in the @p chunk parameter.
+ * @param schunk The super-chunk.  The chunks that are in it already are the ones of
+ * sequence 0.
  *
- * @return The size of the (compressed) chunk or 0 if it is non-initialized. If some problem is
- * detected, a negative code is returned instead.
+ * @note Concurrent writes (see #blosc2_schunk_set_concurrent_writes) cannot be used in
+ * super-chunks that track their changes.
+ *
+ * @return The current sequence number (0 unless the changes were tracked already).
+ * Else a negative code is returned.
  */
-BLOSC_EXPORT int blosc2_schunk_get_chunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chunk,
-                                         bool *needs_free);
+BLOSC_EXPORT int64_t blosc2_schunk_track_changes(blosc2_schunk *schunk);
 
 /**
- * @brief Return a (lazy) compressed chunk that is part of a super-chunk in the @p chunk parameter.
- *
- * @param schunk The super-chunk from where to extract a chunk.
- * @param nchunk The chunk to be extracted (0 indexed).
- * @param chunk The pointer to the (lazy) chunk of compressed data.
- * @param needs_free The pointer to a boolean indicating if it is the user's
- * responsibility to free the chunk returned or not.
- *
- * @note For disk-based frames, a lazy chunk is always returned.
+ * @brief Get the sequence number of the last change of a super-chunk (see
+ * #blosc2_schunk_track_changes).
  *
- * @warning Currently, a lazy chunk can only be used by #blosc2_decompress_ctx and #blosc2_getitem_ctx.
- *
- * @warning If the super-chunk is backed by a frame that is disk-based, a buffer is allocated for the
- * (compressed) chunk, and hence a free is needed.
- * You can check whether requires a free with the @p needs_free parameter.
- * If the chunk does not need a free, it means that a pointer to the location in the super-chunk
- * (or the backing in-memory frame) is returned in the @p chunk parameter.  In this case the returned
- * chunk is not lazy.
+ * @param schunk The super-chunk.
  *
- * @return The size of the (compressed) chunk or 0 if it is non-initialized. If some problem is
- * detected, a negative code is returned instead.  Note that a lazy chunk is somewhat larger than
- * a regular chunk because of the trailer section (for details see `README_CHUNK_FORMAT.rst`).
+ * @return The sequence number. Else a negative code is returned
+ * (BLOSC2_ERROR_NOT_FOUND if the changes of @p schunk are not tracked).
  */
-BLOSC_EXPORT int blosc2_schunk_get_lazychunk(blosc2_schunk *schunk, int64_t nchunk, uint8_t **chunk,
-                                             bool *needs_free);
+BLOSC_EXPORT int64_t blosc2_schunk_get_sequence(blosc2_schunk *schunk);
 
 /**
- * @brief Fill buffer with a schunk slice.
+ * @brief Get the chunks of a super-chunk that changed after a sequence number, as a new
+ * super-chunk (a delta) to patch its replicas with (see #blosc2_schunk_apply_changes).
  *
- * @param schunk The super-chunk from where to extract a slice.
- * @param start Index (0-based) where the slice begins.
- * @param stop The first index (0-based) that is not in the selected slice.
- * @param buffer The buffer where the data will be stored.
+ * The delta is an in-memory contiguous frame with the changed chunks, as they are
+ * (not recompressed), and their positions in a reserved variable-length metalayer.
+ * It can be sent as any other frame (see #blosc2_schunk_to_buffer or
+ * #blosc2_schunk_to_stream).
  *
- * @warning You must make sure that you have enough space in buffer to store the
- * uncompressed data.
+ * @param schunk The super-chunk, which must track its changes (see #blosc2_schunk_track_changes).
+ * @param since The sequence number the replicas are at (the one of #blosc2_schunk_get_sequence
+ * at their last sync).
  *
- * @return An error code.
+ * @return The delta, to be freed with #blosc2_schunk_free. Else NULL is returned.
  */
-BLOSC_EXPORT int blosc2_schunk_get_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t stop, void *buffer);
+BLOSC_EXPORT blosc2_schunk* blosc2_schunk_get_changes(blosc2_schunk *schunk, int64_t since);
 
 /**
- * @brief Update a schunk slice from buffer.
+ * @brief Patch a replica of a super-chunk in place with a delta of it (see
+ * #blosc2_schunk_get_changes).
  *
- * @param schunk The super-chunk where to set the slice.
- * @param start Index (0-based) where the slice begins.
- * @param stop The first index (0-based) that is not in the selected slice.
- * @param buffer The buffer containing the data to set.
+ * The chunks of the delta are put in their positions, the chunks that are gone in
+ * the source are deleted, and the replica gets the sequence numbers of the source.
  *
+ * @param schunk The replica, which must track its changes, and be at a sequence number
+ * not older than the `since` of the delta (a copy of the source made with
+ * #blosc2_schunk_copy is).
+ * @param delta The delta.
  *
- * @return An error code.
+ * @return The number of chunks patched (0 when the replica is up to date already).
+ * Else a negative code is returned.
  */
-BLOSC_EXPORT int blosc2_schunk_set_slice_buffer(blosc2_schunk *schunk, int64_t start, int64_t stop, void *buffer);
+BLOSC_EXPORT int64_t blosc2_schunk_apply_changes(blosc2_schunk *schunk, blosc2_schunk *delta);
 
 /**
  * @brief Return the @p cparams associated to a super-chunk.
@@ -2042,6 +4483,30 @@ BLOSC_EXPORT int blosc2_schunk_get_dparams(blosc2_schunk *schunk, blosc2_dparams
  */
 BLOSC_EXPORT int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *offsets_order);
 
+/**
+ * @brief Reclaim the space of the chunks of a contiguous frame that are no longer used.
+ *
+ * The chunks of contiguous frames that are updated with larger ones, or deleted, leave
+ * holes in the frame, as the new chunks are appended at the end.  This rewrites the
+ * chunks that are still referenced one after the other, in the order of their offsets
+ * in the frame, and writes the offsets, header and trailer after them.  The shard files
+ * of sparse frames (see blosc2_storage.shard_nchunks) are compacted one by one the same
+ * way.  Super-chunks in memory and on unsharded sparse frames have nothing to reclaim.
+ * The padding reserved after
+ * the chunks (see blosc2_storage.chunk_padding) is reclaimed too.
+ *
+ * @param schunk The super-chunk.
+ * @param in_place Whether the chunks are moved inside the frame, which is truncated
+ * afterwards, or copied into a new file (the urlpath plus ".compact") that replaces
+ * the frame with a rename only once it is complete.  The latter needs room for a copy,
+ * but leaves the frame untouched if anything fails in between.  In-memory frames, and
+ * the ones that do not start at the beginning of their file (see
+ * blosc2_schunk_append_file()), can only be compacted in place.
+ *
+ * @return The number of bytes reclaimed. Else a negative code is returned.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_compact(blosc2_schunk *schunk, bool in_place);
+
 /**
  * @brief Get the length (in bytes) of the internal frame of the super-chunk.
  *
@@ -2053,12 +4518,13 @@ BLOSC_EXPORT int blosc2_schunk_reorder_offsets(blosc2_schunk *schunk, int64_t *o
 BLOSC_EXPORT int64_t blosc2_schunk_frame_len(blosc2_schunk* schunk);
 
 /**
- * @brief Quickly fill an empty frame with special values (zeros, NaNs, uninit).
+ * @brief Quickly fill an empty frame with special values (zeros, NaNs, uninit, virtual).
  *
  * @param schunk The super-chunk to be filled.  This must be empty initially.
  * @param nitems The number of items to fill.
  * @param special_value The special value to use for filling.  The only values
- * supported for now are BLOSC2_SPECIAL_ZERO, BLOSC2_SPECIAL_NAN and BLOSC2_SPECIAL_UNINIT.
+ * supported for now are BLOSC2_SPECIAL_ZERO, BLOSC2_SPECIAL_NAN, BLOSC2_SPECIAL_UNINIT
+ * and BLOSC2_SPECIAL_VIRTUAL (see #blosc2_chunk_virtual).
  * @param chunksize The chunksize for the chunks that are to be added to the super-chunk.
  *
  * @return The total number of chunks that have been added to the super-chunk.
@@ -2067,6 +4533,23 @@ BLOSC_EXPORT int64_t blosc2_schunk_frame_len(blosc2_schunk* schunk);
 BLOSC_EXPORT int64_t blosc2_schunk_fill_special(blosc2_schunk* schunk, int64_t nitems,
                                             int special_value, int32_t chunksize);
 
+/**
+ * @brief Quickly fill an empty frame with chunks that repeat a value (see #blosc2_chunk_repeatval).
+ *
+ * The whole chunks of contiguous frames (in memory or on disk) share a single copy of the
+ * chunk, so only their index is written, and this takes the same time whatever @p nitems.
+ *
+ * @param schunk The super-chunk to be filled.  This must be empty initially.
+ * @param nitems The number of items to fill.
+ * @param repeatval The value to repeat, of the typesize of the super-chunk.
+ * @param chunksize The chunksize for the chunks that are to be added to the super-chunk.
+ *
+ * @return The total number of chunks that have been added to the super-chunk.
+ * If there is an error, a negative value is returned.
+ */
+BLOSC_EXPORT int64_t blosc2_schunk_fill_repeatval(blosc2_schunk* schunk, int64_t nitems,
+                                                  const void* repeatval, int32_t chunksize);
+
 
 /*********************************************************************
   Functions related with fixed-length metalayers.
@@ -2246,6 +4729,10 @@ BLOSC_EXPORT int blosc2_vlmeta_update(blosc2_schunk *schunk, const char *name,
 /**
  * @brief Get the content out of a variable-length metalayer.
  *
+ * The contents of the variable-length metalayers of on-disk frames are read from the
+ * file the first time that they are asked for (or when the frame is modified), but for
+ * frames with a fingerprint in their trailer, which are read when opening them.
+ *
  * @param schunk The super-chunk containing the variable-length metalayer.
  * @param name The name of the variable-length metalayer.
  * @param content The pointer where the content will be put.
@@ -2392,6 +4879,15 @@ typedef int (* blosc2_codec_encoder_cb) (const uint8_t *input, int32_t input_len
             uint8_t meta, blosc2_cparams *cparams, const void* chunk);
 typedef int (* blosc2_codec_decoder_cb) (const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
             uint8_t meta, blosc2_dparams *dparams, const void* chunk);
+/**
+ * @brief Decode only the @p nitems items from item @p start of the block in @p input.
+ *
+ * @return The bytes written to @p output (@p nitems times the typesize), 0 when these items
+ * cannot be decoded on their own (the whole block is decoded instead), or a negative
+ * value if the block is corrupted.
+ */
+typedef int (* blosc2_codec_getitems_cb) (const uint8_t *input, int32_t input_len, int32_t start, int32_t nitems,
+            uint8_t *output, int32_t output_len, uint8_t meta, blosc2_dparams *dparams, const void* chunk);
 
 typedef struct {
   uint8_t compcode;
@@ -2414,9 +4910,29 @@ typedef struct {
  * @param codec The codec to register.
  *
  * @return 0 if succeeds. Else a negative code is returned.
+ *
+ * @remark The codecs that are not registered, but that chunks or contexts refer
+ * to, are loaded on demand from a `libblosc2_codec_<compcode>.so` library
+ * (`.dylib` on macOS, `blosc2_codec_<compcode>.dll` on Windows) in the directories
+ * of the BLOSC_PLUGIN_PATH environment variable (separated like in PATH), which
+ * exports the `info` of a dynamic codec.  The libraries of the registered plugins
+ * are looked for there too (as `libblosc2_<compname>.so`) before their Python wheels.
  */
 BLOSC_EXPORT int blosc2_register_codec(blosc2_codec *codec);
 
+/**
+ * @brief Register the partial decoder of a user-defined codec.
+ *
+ * #blosc2_getitem_ctx uses it for the items of a block that are not the whole of it.
+ * It is only used for blocks with no filters, no postfilter and a single stream.
+ *
+ * @param compcode The identifier of a codec that is already registered.
+ * @param getitems The partial decoder (NULL if the codec only decodes whole blocks).
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_register_codec_getitems(uint8_t compcode, blosc2_codec_getitems_cb getitems);
+
 
 /*********************************************************************
   Structures and functions related with filters plugins.
@@ -2449,6 +4965,10 @@ typedef struct {
  * @param filter The filter to register.
  *
  * @return 0 if succeeds. Else a negative code is returned.
+ *
+ * @remark Like codecs (see #blosc2_register_codec), the filters that are not
+ * registered are loaded on demand from a `libblosc2_filter_<id>.so` library in
+ * BLOSC_PLUGIN_PATH.
  */
 BLOSC_EXPORT int blosc2_register_filter(blosc2_filter *filter);
 
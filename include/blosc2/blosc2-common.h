@@ -67,6 +67,9 @@
 /* Modern PowerPC systems (like POWER8) should support unaligned access
    quite efficiently. */
 #undef BLOSC_STRICT_ALIGN
+/* WebAssembly loads and stores take any alignment (it is only a hint) */
+#elif defined(__wasm__)
+#undef BLOSC_STRICT_ALIGN
 #endif
 #endif
 
@@ -76,5 +79,8 @@
 #if defined(__AVX2__)
   #include <immintrin.h>
 #endif
+#if defined(__wasm_simd128__)
+  #include <wasm_simd128.h>
+#endif
 
 #endif  /* BLOSC_BLOSC2_BLOSC2_COMMON_H */
@@ -0,0 +1,90 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*********************************************************************
+
+  Ready-made task schedulers (see blosc2_ctx_set_task_scheduler()) for
+  running the jobs of Blosc inside the scheduler of an application.
+  They are header-only, so Blosc does not depend on any of them, and
+  every one is only available when its runtime is:
+
+  * OpenMP tasks, when compiling with OpenMP.  Contexts have to be used
+    inside a parallel region for the jobs to run in parallel.
+  * oneTBB task arenas, when compiling C++ with oneTBB at hand.
+  * GCD dispatch queues, on Apple platforms.
+
+*********************************************************************/
+
+#ifndef BLOSC_BLOSC2_BLOSC2_SCHEDULERS_H
+#define BLOSC_BLOSC2_BLOSC2_SCHEDULERS_H
+
+#include "blosc2.h"
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#endif
+#if defined(__cplusplus) && defined(__has_include)
+#if __has_include(<oneapi/tbb/task_arena.h>)
+#include <oneapi/tbb/task_arena.h>
+#define BLOSC2_HAVE_TBB_SCHEDULER
+#endif
+#endif
+
+
+#if defined(_OPENMP)
+static inline int blosc2_openmp_submit(void *sched_data, void (*job)(void *), void *job_data) {
+  (void)sched_data;
+  #pragma omp task firstprivate(job, job_data)
+  job(job_data);
+  return 0;
+}
+
+/* A scheduler that runs the jobs as OpenMP tasks of the calling thread */
+static inline blosc2_task_scheduler blosc2_openmp_scheduler(void) {
+  blosc2_task_scheduler scheduler = {blosc2_openmp_submit, NULL};
+  return scheduler;
+}
+#endif  /* _OPENMP */
+
+
+#if defined(BLOSC2_HAVE_TBB_SCHEDULER)
+static inline int blosc2_tbb_submit(void *sched_data, void (*job)(void *), void *job_data) {
+  static_cast<tbb::task_arena *>(sched_data)->enqueue([job, job_data] { job(job_data); });
+  return 0;
+}
+
+/* A scheduler that enqueues the jobs in a oneTBB task arena, which has to outlive the context */
+static inline blosc2_task_scheduler blosc2_tbb_scheduler(tbb::task_arena *arena) {
+  blosc2_task_scheduler scheduler = {blosc2_tbb_submit, arena};
+  return scheduler;
+}
+#endif  /* BLOSC2_HAVE_TBB_SCHEDULER */
+
+
+#if defined(__APPLE__)
+static inline int blosc2_gcd_submit(void *sched_data, void (*job)(void *), void *job_data) {
+  dispatch_async_f((dispatch_queue_t)sched_data, job_data, job);
+  return 0;
+}
+
+/* A scheduler that runs the jobs in a GCD queue (NULL for the global concurrent one) */
+static inline blosc2_task_scheduler blosc2_gcd_scheduler(dispatch_queue_t queue) {
+  if (queue == NULL) {
+    queue = dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0);
+  }
+  blosc2_task_scheduler scheduler = {blosc2_gcd_submit, (void *)queue};
+  return scheduler;
+}
+#endif  /* __APPLE__ */
+
+#endif  /* BLOSC_BLOSC2_BLOSC2_SCHEDULERS_H */
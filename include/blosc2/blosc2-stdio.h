@@ -38,6 +38,288 @@ BLOSC_EXPORT int blosc2_stdio_seek(void *stream, int64_t offset, int whence);
 BLOSC_EXPORT int64_t blosc2_stdio_write(const void *ptr, int64_t size, int64_t nitems, void *stream);
 BLOSC_EXPORT int64_t blosc2_stdio_read(void *ptr, int64_t size, int64_t nitems, void *stream);
 BLOSC_EXPORT int blosc2_stdio_truncate(void *stream, int64_t size);
+BLOSC_EXPORT int blosc2_stdio_sync(void *stream);
+struct blosc2_io_vec;  // see blosc2.h
+#if !defined(_WIN32)
+BLOSC_EXPORT int64_t blosc2_stdio_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                         void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_preadv(const struct blosc2_io_vec *vecs, int64_t nvecs, void *stream);
+
+/**
+ * @brief Copy a range of bytes between two files opened by the filesystem io.
+ *
+ * On Linux, the copy is done by the kernel with copy_file_range(), so file systems
+ * supporting reflinks just share the blocks.  Elsewhere, or when the kernel cannot
+ * copy the range, it goes through a buffer.
+ *
+ * @param src The stream to copy from.
+ * @param src_position The position of the range in @p src.
+ * @param dest The stream to copy to (opened for writing).
+ * @param dest_position The position of the copy in @p dest.
+ * @param nbytes The number of bytes to copy.
+ *
+ * @return The number of bytes copied (less than @p nbytes on errors).
+ */
+BLOSC_EXPORT int64_t blosc2_stdio_copy_range(void *src, int64_t src_position, void *dest, int64_t dest_position,
+                                             int64_t nbytes);
+
+/**
+ * @brief Write a range of bytes of a file opened by the filesystem io to a file descriptor.
+ *
+ * On Linux, the bytes do not go through user space: copy_file_range() is used when
+ * @p fd is a plain file, and sendfile() for sockets, pipes and the rest.  Elsewhere, or
+ * when the kernel cannot send the range, it goes through a buffer.
+ *
+ * @param src The stream to read from.
+ * @param src_position The position of the range in @p src.
+ * @param fd The (blocking) file descriptor to write to, at its current position.
+ * @param nbytes The number of bytes to write.
+ *
+ * @return The number of bytes written (less than @p nbytes on errors).
+ */
+BLOSC_EXPORT int64_t blosc2_stdio_send_range(void *src, int64_t src_position, int fd, int64_t nbytes);
+#endif
+
+/**
+ * @brief Set the maximum number of idle file handles kept open by the
+ * filesystem io.
+ *
+ * Files opened for reading are not closed right away, so that the next read
+ * of the same file (the next chunk, block or header of a frame) can reuse
+ * them.  The least recently used ones are closed beyond this limit.  The
+ * default is 32 (0, i.e. disabled, on Windows).
+ *
+ * @param max_open The maximum number of idle handles.  0 disables the cache.
+ *
+ * @return The previous maximum if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_stdio_set_max_open(int max_open);
+
+
+/**
+ * @brief Parameters for the memory-mapped io (BLOSC2_IO_FILESYSTEM_MMAP).
+ *
+ * The file is mapped only once and shared by every open of it, so reads are
+ * plain copies (or no copies at all for chunks of contiguous frames).  The
+ * struct is owned by the user: it has to outlive the super-chunks using it,
+ * and be released with blosc2_stdio_mmap_destroy() after them.  Only
+ * contiguous frames are supported, and only on POSIX systems for now.
+ */
+typedef struct {
+  const char *mode;
+  //!< The opening mode of the file: "r" (read-only), "r+" (read and write) or
+  //!< "w+" (create or truncate, then read and write).
+  void *state;
+  //!< The file and its mappings (internal).  Must be NULL before the first use.
+} blosc2_stdio_mmap;
+
+static const blosc2_stdio_mmap BLOSC2_STDIO_MMAP_DEFAULTS = {"r", NULL};
+
+BLOSC_EXPORT void *blosc2_stdio_mmap_open(const char *urlpath, const char *mode, void* params);
+BLOSC_EXPORT int blosc2_stdio_mmap_close(void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_mmap_tell(void *stream);
+BLOSC_EXPORT int blosc2_stdio_mmap_seek(void *stream, int64_t offset, int whence);
+BLOSC_EXPORT int64_t blosc2_stdio_mmap_write(const void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_mmap_read(void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int blosc2_stdio_mmap_truncate(void *stream, int64_t size);
+BLOSC_EXPORT int64_t blosc2_stdio_mmap_pread(void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                             void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_mmap_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                              void *stream);
+
+/**
+ * @brief Get a pointer to @p size bytes at @p offset of a memory-mapped file.
+ *
+ * The pointer stays valid (even if the file is mapped again because it grew)
+ * until blosc2_stdio_mmap_destroy() is called, unless the file is truncated
+ * below it.  NULL is returned if the range is out of the file.
+ */
+BLOSC_EXPORT void *blosc2_stdio_mmap_map(void *stream, int64_t offset, int64_t size);
+
+/**
+ * @brief Unmap and close the file of a memory-mapped io.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_stdio_mmap_destroy(blosc2_stdio_mmap *mmap_file);
+
+
+/**
+ * @brief Parameters for the io_uring io (BLOSC2_IO_FILESYSTEM_URING).
+ *
+ * The files are accessed through plain descriptors, and the reads of a batch
+ * (e.g. the chunks of blosc2_schunk_decompress_chunks()) are all queued at once
+ * in an io_uring, so that fast devices (NVMe) can serve many of them at the
+ * same time.  The params are optional (NULL means the defaults).  When the
+ * kernel does not support io_uring (or on other POSIX systems) the reads of a
+ * batch are done one after the other.  Not supported on Windows.
+ */
+typedef struct {
+  int32_t queue_depth;
+  //!< The maximum number of reads in flight.
+} blosc2_stdio_uring;
+
+static const blosc2_stdio_uring BLOSC2_STDIO_URING_DEFAULTS = {64};
+
+BLOSC_EXPORT void *blosc2_stdio_uring_open(const char *urlpath, const char *mode, void* params);
+BLOSC_EXPORT int blosc2_stdio_uring_close(void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_uring_tell(void *stream);
+BLOSC_EXPORT int blosc2_stdio_uring_seek(void *stream, int64_t offset, int whence);
+BLOSC_EXPORT int64_t blosc2_stdio_uring_write(const void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_uring_read(void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int blosc2_stdio_uring_truncate(void *stream, int64_t size);
+BLOSC_EXPORT int64_t blosc2_stdio_uring_pread(void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                              void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_uring_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                               void *stream);
+struct blosc2_io_request;  // see blosc2.h
+BLOSC_EXPORT int blosc2_stdio_uring_pread_batch(struct blosc2_io_request *requests, int64_t nrequests,
+                                                void (*done)(struct blosc2_io_request *request));
+
+
+/**
+ * @brief Parameters for the direct io (BLOSC2_IO_FILESYSTEM_DIRECT).
+ *
+ * The file is written with O_DIRECT (bypassing the page cache), always in
+ * aligned blocks.  The start (where the header of a frame lives) and the tail
+ * of the file (its last chunk, offsets and trailer) are kept in aligned
+ * buffers, so the rewrites that every append does there stay in memory, and
+ * only full blocks of ingested data go to the device.  The rest of the file
+ * (updates in the middle) is read-modify-written in aligned blocks.
+ *
+ * As with the memory-mapped io, the struct is owned by the user and shared by
+ * every open of the file: the buffered data reaches the file with
+ * blosc2_stdio_direct_flush() or blosc2_stdio_direct_destroy(), which must be
+ * called after the super-chunks using it are freed.  Only contiguous frames
+ * are supported, and only on POSIX systems (without O_DIRECT, the file goes
+ * through the page cache, but the buffering is the same).
+ */
+typedef struct {
+  int32_t alignment;
+  //!< The alignment of the writes (a power of 2; the logical block size of the device or larger).
+  int64_t buffer_size;
+  //!< The size of the buffer for the tail of the file (rounded up to two aligned blocks at least).
+  void *state;
+  //!< The file and its buffers (internal).  Must be NULL before the first use.
+} blosc2_stdio_direct;
+
+static const blosc2_stdio_direct BLOSC2_STDIO_DIRECT_DEFAULTS = {4096, 8 * 1024 * 1024, NULL};
+
+BLOSC_EXPORT void *blosc2_stdio_direct_open(const char *urlpath, const char *mode, void* params);
+BLOSC_EXPORT int blosc2_stdio_direct_close(void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_direct_tell(void *stream);
+BLOSC_EXPORT int blosc2_stdio_direct_seek(void *stream, int64_t offset, int whence);
+BLOSC_EXPORT int64_t blosc2_stdio_direct_write(const void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_direct_read(void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int blosc2_stdio_direct_truncate(void *stream, int64_t size);
+BLOSC_EXPORT int64_t blosc2_stdio_direct_pread(void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                               void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_direct_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                                void *stream);
+
+/**
+ * @brief Write the buffered data of a direct io to its file.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_stdio_direct_flush(blosc2_stdio_direct *direct_file);
+
+/**
+ * @brief Flush and close the file of a direct io, and release its buffers.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_stdio_direct_destroy(blosc2_stdio_direct *direct_file);
+
+/**
+ * @brief Read the @p size bytes at @p offset of the object @p urlpath into @p buf, e.g. with
+ * an HTTP GET with a `Range: bytes=offset-(offset+size-1)` header.
+ *
+ * It is called from several threads at the same time for the reads of a batch.
+ *
+ * @return The number of bytes read, or a negative value in case of errors.
+ */
+typedef int64_t (*blosc2_objstore_get_cb)(void *user_data, const char *urlpath, int64_t offset, int64_t size,
+                                          void *buf);
+
+/**
+ * @brief Get the size of the object @p urlpath, e.g. with an HTTP HEAD request.
+ *
+ * @return The size of the object, or a negative value if it does not exist.
+ */
+typedef int64_t (*blosc2_objstore_size_cb)(void *user_data, const char *urlpath);
+
+/**
+ * @brief Parameters for the object store io (BLOSC2_IO_OBJECT_STORE).
+ *
+ * Frames are read out of the objects of an object store (or an HTTP server) with
+ * range requests, which the user makes in the @p get and @p size callbacks, so any
+ * transport (libcurl, an S3 SDK...) can be plugged in.  The reads go through a cache
+ * of pages of the objects: they are rounded to whole pages, and the missing pages of
+ * a read (or of all the reads of a batch, see blosc2_schunk_decompress_chunks())
+ * are coalesced into as few requests as possible, which run in parallel.  So the
+ * header and metalayers, the chunk offsets and the neighbouring blocks of the chunks
+ * take a request or two, and they are not requested again while they are cached.
+ *
+ * The objects are read-only, and they are expected not to change meanwhile.  As with
+ * the memory-mapped io, the struct is owned by the user: it has to outlive the
+ * super-chunks using it, and be released with blosc2_stdio_objstore_destroy() after
+ * them.  A sparse frame is a prefix of the objects of its chunks and its index.
+ */
+typedef struct {
+  blosc2_objstore_get_cb get;
+  //!< The callback for reading a range of an object.
+  blosc2_objstore_size_cb size;
+  //!< The callback for getting the size of an object.
+  void *user_data;
+  //!< The first argument of the callbacks.
+  int64_t page_size;
+  //!< The size of the pages the objects are requested and cached in.
+  int64_t cache_size;
+  //!< The maximum number of bytes in the cache of pages (the least recently used go first).
+  int64_t max_gap;
+  //!< The missing pages of a read that are closer than this are requested together (along with
+  //!< the cached ones in between).
+  int32_t nthreads;
+  //!< The maximum number of requests in flight for the reads of a batch.
+  void *state;
+  //!< The sizes of the objects and the cache of their pages (internal).  Must be NULL before the first use.
+} blosc2_stdio_objstore;
+
+static const blosc2_stdio_objstore BLOSC2_STDIO_OBJSTORE_DEFAULTS = {
+    NULL, NULL, NULL, 256 * 1024, 64 * 1024 * 1024, 1024 * 1024, 8, NULL};
+
+BLOSC_EXPORT void *blosc2_stdio_objstore_open(const char *urlpath, const char *mode, void* params);
+BLOSC_EXPORT int blosc2_stdio_objstore_close(void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_objstore_tell(void *stream);
+BLOSC_EXPORT int blosc2_stdio_objstore_seek(void *stream, int64_t offset, int whence);
+BLOSC_EXPORT int64_t blosc2_stdio_objstore_write(const void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_objstore_read(void *ptr, int64_t size, int64_t nitems, void *stream);
+BLOSC_EXPORT int blosc2_stdio_objstore_truncate(void *stream, int64_t size);
+BLOSC_EXPORT int64_t blosc2_stdio_objstore_pread(void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                                 void *stream);
+BLOSC_EXPORT int64_t blosc2_stdio_objstore_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position,
+                                                  void *stream);
+BLOSC_EXPORT int blosc2_stdio_objstore_pread_batch(struct blosc2_io_request *requests, int64_t nrequests,
+                                                   void (*done)(struct blosc2_io_request *request));
+BLOSC_EXPORT int64_t blosc2_stdio_objstore_preadv(const struct blosc2_io_vec *vecs, int64_t nvecs, void *stream);
+
+/**
+ * @brief Get the number of requests made by an object store io (the ones for the
+ * sizes of the objects included), and the number of bytes they got.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_stdio_objstore_get_stats(blosc2_stdio_objstore *objstore, int64_t *nrequests,
+                                                 int64_t *nbytes);
+
+/**
+ * @brief Release the cache of an object store io.
+ *
+ * @return 0 if succeeds. Else a negative code is returned.
+ */
+BLOSC_EXPORT int blosc2_stdio_objstore_destroy(blosc2_stdio_objstore *objstore);
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,8 @@ enum {
     BLOSC_CODEC_ZFP_FIXED_PRECISION = 34,
     BLOSC_CODEC_ZFP_FIXED_RATE = 35,
     BLOSC_CODEC_OPENHTJ2K = 36,
+    BLOSC_CODEC_QPL_DEFLATE = 37,
+    BLOSC_CODEC_BITPACK = 38,
 };
 
 void register_codecs(void);
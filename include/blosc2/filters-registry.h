@@ -20,6 +20,23 @@ enum {
     BLOSC_FILTER_NDMEAN = 33,
     BLOSC_FILTER_BYTEDELTA_BUGGY = 34, // buggy version. See #524
     BLOSC_FILTER_BYTEDELTA = 35,  // fixed version
+    BLOSC_FILTER_FLOATXOR = 36,
+    BLOSC_FILTER_QUANTIZE = 37,
+    BLOSC_FILTER_HALF = 38,
+    BLOSC_FILTER_DICT = 39,
+    BLOSC_FILTER_RLE = 40,
+    BLOSC_FILTER_SHUFFLE_STRIDE = 41,
+};
+
+// The meta of BLOSC_FILTER_QUANTIZE: an error bound of 10^exp (exp from -64 to 63), either
+// absolute or relative to the range of the values in every block
+#define BLOSC_QUANTIZE_ABS(exp) ((uint8_t) ((exp) & 0x7F))
+#define BLOSC_QUANTIZE_REL(exp) ((uint8_t) (0x80 | ((exp) & 0x7F)))
+
+// The meta of BLOSC_FILTER_HALF: the 16-bit format that the float32 values are converted to
+enum {
+    BLOSC_HALF_BFLOAT16 = 0,
+    BLOSC_HALF_FLOAT16 = 1,
 };
 
 void register_filters(void);
@@ -0,0 +1,546 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*
+  Frame-of-reference plus bit-packing codec for integers, after the SIMD-BP128 scheme of
+  FastPFor (Lemire and Boytsov, "Decoding billions of integers per second through
+  vectorization").
+
+  The items of a block are split in frames of BITPACK_FRAME_NITEMS.  Every frame stores its
+  minimum (the reference) and the number of bits (the width) of its largest difference to
+  it, and then the differences packed with that width.  The packing is vertical: the 16
+  bytes of a vector hold 16 / typesize lanes, item i of the frame goes to lane i % lanes,
+  and every lane packs its typesize * 8 items into `width` words.  So a frame always takes
+  `width` vectors, and a vector of items comes out of a couple of shifts.
+
+  The stream of a block is:
+
+    header   | version (1 byte), typesize (1 byte), flags (1 byte), 0, nbytes of the block (int32)
+    widths   | one byte per frame
+    refs     | one item per frame
+    frames   | 16 * width bytes per frame
+    leftover | the bytes after the last whole frame, as they are
+
+  As the frames start at the sum of the previous widths, any item can be decoded without
+  the rest of its block (see bitpack_getitems()).
+*/
+
+#include "bitpack.h"
+#include "blosc-private.h"
+#include "blosc2.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BITPACK_VERSION 1
+#define BITPACK_HEADER_SIZE 8
+#define BITPACK_FLAG_SIGNED 0x1
+#define BITPACK_FRAME_NITEMS 128
+#define BITPACK_VECTOR_SIZE 16
+
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BITPACK_HAS_SIMD
+typedef __m128i bitpack_vec;
+
+static inline bitpack_vec vec_load(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void vec_store(uint8_t* p, bitpack_vec x) { _mm_storeu_si128((__m128i*)p, x); }
+static inline bitpack_vec vec_zero(void) { return _mm_setzero_si128(); }
+static inline bitpack_vec vec_or(bitpack_vec a, bitpack_vec b) { return _mm_or_si128(a, b); }
+static inline bitpack_vec vec_and(bitpack_vec a, bitpack_vec b) { return _mm_and_si128(a, b); }
+static inline bitpack_vec vec_xor(bitpack_vec a, bitpack_vec b) { return _mm_xor_si128(a, b); }
+
+static inline bitpack_vec vec_set(uint64_t x, int32_t unit) {
+  switch (unit) {
+    case 1: return _mm_set1_epi8((char)x);
+    case 2: return _mm_set1_epi16((short)x);
+    case 4: return _mm_set1_epi32((int)x);
+    default: return _mm_set1_epi64x((long long)x);
+  }
+}
+
+static inline bitpack_vec vec_add(bitpack_vec a, bitpack_vec b, int32_t unit) {
+  switch (unit) {
+    case 1: return _mm_add_epi8(a, b);
+    case 2: return _mm_add_epi16(a, b);
+    case 4: return _mm_add_epi32(a, b);
+    default: return _mm_add_epi64(a, b);
+  }
+}
+
+static inline bitpack_vec vec_sub(bitpack_vec a, bitpack_vec b, int32_t unit) {
+  switch (unit) {
+    case 1: return _mm_sub_epi8(a, b);
+    case 2: return _mm_sub_epi16(a, b);
+    case 4: return _mm_sub_epi32(a, b);
+    default: return _mm_sub_epi64(a, b);
+  }
+}
+
+/* Shifts of every unit by n bits (less than the bits of the unit); the bytes go through the
+ * shifts of 16 bits, dropping the bits that cross them */
+static inline bitpack_vec vec_shift_up(bitpack_vec x, int n, int32_t unit) {
+  __m128i count = _mm_cvtsi32_si128(n);
+  switch (unit) {
+    case 1: return _mm_and_si128(_mm_sll_epi16(x, count), _mm_set1_epi8((char)(0xFF << n)));
+    case 2: return _mm_sll_epi16(x, count);
+    case 4: return _mm_sll_epi32(x, count);
+    default: return _mm_sll_epi64(x, count);
+  }
+}
+
+static inline bitpack_vec vec_shift_down(bitpack_vec x, int n, int32_t unit) {
+  __m128i count = _mm_cvtsi32_si128(n);
+  switch (unit) {
+    case 1: return _mm_and_si128(_mm_srl_epi16(x, count), _mm_set1_epi8((char)(0xFF >> n)));
+    case 2: return _mm_srl_epi16(x, count);
+    case 4: return _mm_srl_epi32(x, count);
+    default: return _mm_srl_epi64(x, count);
+  }
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define BITPACK_HAS_SIMD
+typedef uint8x16_t bitpack_vec;
+
+static inline bitpack_vec vec_load(const uint8_t* p) { return vld1q_u8(p); }
+static inline void vec_store(uint8_t* p, bitpack_vec x) { vst1q_u8(p, x); }
+static inline bitpack_vec vec_zero(void) { return vdupq_n_u8(0); }
+static inline bitpack_vec vec_or(bitpack_vec a, bitpack_vec b) { return vorrq_u8(a, b); }
+static inline bitpack_vec vec_and(bitpack_vec a, bitpack_vec b) { return vandq_u8(a, b); }
+static inline bitpack_vec vec_xor(bitpack_vec a, bitpack_vec b) { return veorq_u8(a, b); }
+
+static inline bitpack_vec vec_set(uint64_t x, int32_t unit) {
+  switch (unit) {
+    case 1: return vdupq_n_u8((uint8_t)x);
+    case 2: return vreinterpretq_u8_u16(vdupq_n_u16((uint16_t)x));
+    case 4: return vreinterpretq_u8_u32(vdupq_n_u32((uint32_t)x));
+    default: return vreinterpretq_u8_u64(vdupq_n_u64(x));
+  }
+}
+
+static inline bitpack_vec vec_add(bitpack_vec a, bitpack_vec b, int32_t unit) {
+  switch (unit) {
+    case 1: return vaddq_u8(a, b);
+    case 2: return vreinterpretq_u8_u16(vaddq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)));
+    case 4: return vreinterpretq_u8_u32(vaddq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
+    default: return vreinterpretq_u8_u64(vaddq_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b)));
+  }
+}
+
+static inline bitpack_vec vec_sub(bitpack_vec a, bitpack_vec b, int32_t unit) {
+  switch (unit) {
+    case 1: return vsubq_u8(a, b);
+    case 2: return vreinterpretq_u8_u16(vsubq_u16(vreinterpretq_u16_u8(a), vreinterpretq_u16_u8(b)));
+    case 4: return vreinterpretq_u8_u32(vsubq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
+    default: return vreinterpretq_u8_u64(vsubq_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b)));
+  }
+}
+
+/* The shifts of NEON go down for negative counts */
+static inline bitpack_vec vec_shift(bitpack_vec x, int n, int32_t unit) {
+  switch (unit) {
+    case 1: return vshlq_u8(x, vdupq_n_s8((int8_t)n));
+    case 2: return vreinterpretq_u8_u16(vshlq_u16(vreinterpretq_u16_u8(x), vdupq_n_s16((int16_t)n)));
+    case 4: return vreinterpretq_u8_u32(vshlq_u32(vreinterpretq_u32_u8(x), vdupq_n_s32(n)));
+    default: return vreinterpretq_u8_u64(vshlq_u64(vreinterpretq_u64_u8(x), vdupq_n_s64(n)));
+  }
+}
+
+static inline bitpack_vec vec_shift_up(bitpack_vec x, int n, int32_t unit) { return vec_shift(x, n, unit); }
+static inline bitpack_vec vec_shift_down(bitpack_vec x, int n, int32_t unit) { return vec_shift(x, -n, unit); }
+#endif
+
+
+/* The mask of the lower bits of a word (bits can be 64) */
+static inline uint64_t low_bits(int bits) {
+  return (bits >= 64) ? UINT64_MAX : (1ULL << bits) - 1ULL;
+}
+
+static inline uint64_t load_word(const uint8_t* p, int32_t unit) {
+  switch (unit) {
+    case 1:
+      return *p;
+    case 2: {
+      uint16_t x;
+      memcpy(&x, p, sizeof(x));
+      return x;
+    }
+    case 4: {
+      uint32_t x;
+      memcpy(&x, p, sizeof(x));
+      return x;
+    }
+    default: {
+      uint64_t x;
+      memcpy(&x, p, sizeof(x));
+      return x;
+    }
+  }
+}
+
+static inline void store_word(uint8_t* p, uint64_t x, int32_t unit) {
+  switch (unit) {
+    case 1:
+      *p = (uint8_t)x;
+      break;
+    case 2: {
+      uint16_t y = (uint16_t)x;
+      memcpy(p, &y, sizeof(y));
+      break;
+    }
+    case 4: {
+      uint32_t y = (uint32_t)x;
+      memcpy(p, &y, sizeof(y));
+      break;
+    }
+    default:
+      memcpy(p, &x, sizeof(x));
+  }
+}
+
+
+/* The minimum of the items of a frame and the width of their differences to it (with the
+ * sign bit flipped for signed items, so that they are ordered as unsigned ones) */
+#define FRAME_RANGE(bits)                                                              \
+static int frame_range##bits(const uint8_t* src, uint64_t sign, uint64_t* ref) {       \
+  uint##bits##_t min = UINT##bits##_MAX, max = 0;                                      \
+  for (int i = 0; i < BITPACK_FRAME_NITEMS; i++) {                                     \
+    uint##bits##_t x;                                                                  \
+    memcpy(&x, src + i * sizeof(x), sizeof(x));                                        \
+    x ^= (uint##bits##_t)sign;                                                         \
+    min = (x < min) ? x : min;                                                         \
+    max = (x > max) ? x : max;                                                         \
+  }                                                                                    \
+  *ref = min;                                                                          \
+  uint64_t range = (uint64_t)(uint##bits##_t)(max - min);                              \
+  int width = 0;                                                                       \
+  while (width < (bits) && (range >> width) != 0) {                                    \
+    width++;                                                                           \
+  }                                                                                    \
+  return width;                                                                        \
+}
+
+FRAME_RANGE(8)
+FRAME_RANGE(16)
+FRAME_RANGE(32)
+FRAME_RANGE(64)
+
+static int frame_range(const uint8_t* src, int32_t unit, uint64_t sign, uint64_t* ref) {
+  switch (unit) {
+    case 1: return frame_range8(src, sign, ref);
+    case 2: return frame_range16(src, sign, ref);
+    case 4: return frame_range32(src, sign, ref);
+    default: return frame_range64(src, sign, ref);
+  }
+}
+
+
+#if defined(BITPACK_HAS_SIMD)
+static inline void pack_frame_simd(const uint8_t* src, int32_t unit, uint64_t sign, uint64_t ref, int width,
+                                   uint8_t* dest) {
+  int bits = unit * 8;
+  bitpack_vec signv = vec_set(sign, unit);
+  bitpack_vec refv = vec_set(ref, unit);
+  bitpack_vec acc = vec_zero();
+  int shift = 0;
+  // Every lane has bits items
+  for (int pos = 0; pos < bits; pos++) {
+    bitpack_vec x = vec_sub(vec_xor(vec_load(src + pos * BITPACK_VECTOR_SIZE), signv), refv, unit);
+    acc = vec_or(acc, vec_shift_up(x, shift, unit));
+    shift += width;
+    if (shift >= bits) {
+      vec_store(dest, acc);
+      dest += BITPACK_VECTOR_SIZE;
+      shift -= bits;
+      acc = (shift > 0) ? vec_shift_down(x, width - shift, unit) : vec_zero();
+    }
+  }
+}
+#endif
+
+
+/* Pack the differences of the items of a frame to ref into width vectors */
+static void pack_frame(const uint8_t* src, int32_t unit, uint64_t sign, uint64_t ref, int width,
+                       uint8_t* dest) {
+  if (width == 0) {
+    return;
+  }
+#if defined(BITPACK_HAS_SIMD)
+  // With the unit as a constant for the vector operations
+  switch (unit) {
+    case 1: pack_frame_simd(src, 1, sign, ref, width, dest); break;
+    case 2: pack_frame_simd(src, 2, sign, ref, width, dest); break;
+    case 4: pack_frame_simd(src, 4, sign, ref, width, dest); break;
+    default: pack_frame_simd(src, 8, sign, ref, width, dest);
+  }
+#else
+  int bits = unit * 8;
+  int lanes = BITPACK_VECTOR_SIZE / unit;
+  uint64_t mask = low_bits(bits);
+  for (int lane = 0; lane < lanes; lane++) {
+    uint64_t acc = 0;
+    int shift = 0;
+    int nword = 0;
+    for (int pos = 0; pos < bits; pos++) {
+      uint64_t x = ((load_word(src + (pos * lanes + lane) * unit, unit) ^ sign) - ref) & mask;
+      acc |= (x << shift) & mask;
+      shift += width;
+      if (shift >= bits) {
+        store_word(dest + nword * BITPACK_VECTOR_SIZE + lane * unit, acc, unit);
+        nword++;
+        shift -= bits;
+        acc = (shift > 0) ? x >> (width - shift) : 0;
+      }
+    }
+  }
+#endif
+}
+
+
+#if defined(BITPACK_HAS_SIMD)
+static inline void unpack_frame_simd(const uint8_t* src, int32_t unit, uint64_t sign, uint64_t ref, int width,
+                                     uint8_t* dest) {
+  int bits = unit * 8;
+  bitpack_vec signv = vec_set(sign, unit);
+  bitpack_vec refv = vec_set(ref, unit);
+  bitpack_vec mask = vec_set(low_bits(width), unit);
+  bitpack_vec word = vec_load(src);
+  int nword = 0;
+  int shift = 0;
+  for (int pos = 0; pos < bits; pos++) {
+    bitpack_vec x = vec_shift_down(word, shift, unit);
+    shift += width;
+    if (shift >= bits) {
+      shift -= bits;
+      if (++nword < width) {
+        word = vec_load(src + nword * BITPACK_VECTOR_SIZE);
+        if (shift > 0) {
+          x = vec_or(x, vec_shift_up(word, width - shift, unit));
+        }
+      }
+    }
+    x = vec_xor(vec_add(vec_and(x, mask), refv, unit), signv);
+    vec_store(dest + pos * BITPACK_VECTOR_SIZE, x);
+  }
+}
+#endif
+
+
+/* Unpack the width vectors of a frame into its items */
+static void unpack_frame(const uint8_t* src, int32_t unit, uint64_t sign, uint64_t ref, int width,
+                         uint8_t* dest) {
+  if (width == 0) {
+    for (int i = 0; i < BITPACK_FRAME_NITEMS; i++) {
+      store_word(dest + i * unit, ref ^ sign, unit);
+    }
+    return;
+  }
+#if defined(BITPACK_HAS_SIMD)
+  switch (unit) {
+    case 1: unpack_frame_simd(src, 1, sign, ref, width, dest); break;
+    case 2: unpack_frame_simd(src, 2, sign, ref, width, dest); break;
+    case 4: unpack_frame_simd(src, 4, sign, ref, width, dest); break;
+    default: unpack_frame_simd(src, 8, sign, ref, width, dest);
+  }
+#else
+  int bits = unit * 8;
+  int lanes = BITPACK_VECTOR_SIZE / unit;
+  uint64_t mask = low_bits(width);
+  for (int lane = 0; lane < lanes; lane++) {
+    for (int pos = 0; pos < bits; pos++) {
+      int bit = pos * width;
+      const uint8_t* p = src + (bit / bits) * BITPACK_VECTOR_SIZE + lane * unit;
+      int shift = bit % bits;
+      uint64_t x = load_word(p, unit) >> shift;
+      if (shift + width > bits) {
+        x |= load_word(p + BITPACK_VECTOR_SIZE, unit) << (bits - shift);
+      }
+      store_word(dest + (pos * lanes + lane) * unit, ((x & mask) + ref) ^ sign, unit);
+    }
+  }
+#endif
+}
+
+
+int bitpack_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                     uint8_t meta, blosc2_cparams *cparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(chunk);
+
+  int32_t unit = cparams->typesize;
+  if (unit != 1 && unit != 2 && unit != 4 && unit != 8) {
+    BLOSC_TRACE_ERROR("The bitpack codec only handles items of 1, 2, 4 or 8 bytes (not %d)", unit);
+    return BLOSC2_ERROR_CODEC_PARAM;
+  }
+  if (meta > BITPACK_FLAG_SIGNED) {
+    BLOSC_TRACE_ERROR("The meta of the bitpack codec can only be 0 (unsigned) or 1 (signed integers)");
+    return BLOSC2_ERROR_CODEC_PARAM;
+  }
+  int32_t frame_size = BITPACK_FRAME_NITEMS * unit;
+  int32_t nframes = input_len / frame_size;
+  uint8_t* widths = output + BITPACK_HEADER_SIZE;
+  uint8_t* refs = widths + nframes;
+  int64_t frames_size = BITPACK_HEADER_SIZE + (int64_t)nframes * (1 + unit);
+  int32_t leftover = input_len - nframes * frame_size;
+  if (frames_size + leftover >= input_len || frames_size + leftover > output_len) {
+    return 0;
+  }
+  uint64_t sign = (meta & BITPACK_FLAG_SIGNED) ? 1ULL << (unit * 8 - 1) : 0;
+
+  // The widths and the references go first, and tell whether packing is worth it
+  for (int32_t i = 0; i < nframes; i++) {
+    uint64_t ref;
+    widths[i] = (uint8_t)frame_range(input + i * frame_size, unit, sign, &ref);
+    store_word(refs + i * unit, ref, unit);
+    frames_size += widths[i] * BITPACK_VECTOR_SIZE;
+  }
+  if (frames_size + leftover >= input_len || frames_size + leftover > output_len) {
+    return 0;
+  }
+
+  output[0] = BITPACK_VERSION;
+  output[1] = (uint8_t)unit;
+  output[2] = meta;
+  output[3] = 0;
+  _sw32(output + 4, input_len);
+  uint8_t* dest = refs + nframes * unit;
+  for (int32_t i = 0; i < nframes; i++) {
+    pack_frame(input + i * frame_size, unit, sign, load_word(refs + i * unit, unit), widths[i], dest);
+    dest += widths[i] * BITPACK_VECTOR_SIZE;
+  }
+  memcpy(dest, input + nframes * frame_size, leftover);
+  dest += leftover;
+
+  return (int)(dest - output);
+}
+
+
+/* Check the header and the sizes of a stream, and get the unit, the sign and the number of frames */
+static int read_header(const uint8_t* input, int32_t input_len, int32_t* unit, uint64_t* sign,
+                       int32_t* nframes, int32_t* nbytes) {
+  if (input_len < BITPACK_HEADER_SIZE || input[0] != BITPACK_VERSION) {
+    BLOSC_TRACE_ERROR("Not a bitpack stream (or an unsupported version of it)");
+    return BLOSC2_ERROR_DATA;
+  }
+  *unit = input[1];
+  if (*unit != 1 && *unit != 2 && *unit != 4 && *unit != 8) {
+    BLOSC_TRACE_ERROR("Wrong typesize in the bitpack stream");
+    return BLOSC2_ERROR_DATA;
+  }
+  *sign = (input[2] & BITPACK_FLAG_SIGNED) ? 1ULL << (*unit * 8 - 1) : 0;
+  *nbytes = sw32_(input + 4);
+  if (*nbytes < 0) {
+    return BLOSC2_ERROR_DATA;
+  }
+  *nframes = *nbytes / (BITPACK_FRAME_NITEMS * *unit);
+  int64_t tables_size = BITPACK_HEADER_SIZE + (int64_t)*nframes * (1 + *unit);
+  if (tables_size > input_len) {
+    BLOSC_TRACE_ERROR("The bitpack stream is truncated");
+    return BLOSC2_ERROR_DATA;
+  }
+  return 0;
+}
+
+
+int bitpack_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                       uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(chunk);
+
+  int32_t unit, nframes, nbytes;
+  uint64_t sign;
+  BLOSC_ERROR(read_header(input, input_len, &unit, &sign, &nframes, &nbytes));
+  if (nbytes > output_len) {
+    BLOSC_TRACE_ERROR("The output buffer is too small for the bitpack block");
+    return BLOSC2_ERROR_WRITE_BUFFER;
+  }
+  const uint8_t* widths = input + BITPACK_HEADER_SIZE;
+  const uint8_t* refs = widths + nframes;
+  const uint8_t* src = refs + nframes * unit;
+  const uint8_t* end = input + input_len;
+  int32_t frame_size = BITPACK_FRAME_NITEMS * unit;
+  for (int32_t i = 0; i < nframes; i++) {
+    if (widths[i] > unit * 8 || end - src < widths[i] * BITPACK_VECTOR_SIZE) {
+      return BLOSC2_ERROR_DATA;
+    }
+    unpack_frame(src, unit, sign, load_word(refs + i * unit, unit), widths[i], output + i * frame_size);
+    src += widths[i] * BITPACK_VECTOR_SIZE;
+  }
+  int32_t leftover = nbytes - nframes * frame_size;
+  if (end - src != leftover) {
+    return BLOSC2_ERROR_DATA;
+  }
+  memcpy(output + nframes * frame_size, src, leftover);
+
+  return nbytes;
+}
+
+
+int bitpack_getitems(const uint8_t *block, int32_t cbytes, int32_t start, int32_t nitems,
+                     uint8_t *dest, int32_t destsize, uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(chunk);
+  int32_t unit, nframes, nbytes;
+  uint64_t sign;
+  BLOSC_ERROR(read_header(block, cbytes, &unit, &sign, &nframes, &nbytes));
+  if (start < 0 || nitems < 0 || ((int64_t)start + nitems) * unit > nbytes || nitems * unit > destsize) {
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  const uint8_t* widths = block + BITPACK_HEADER_SIZE;
+  const uint8_t* refs = widths + nframes;
+  const uint8_t* src = refs + nframes * unit;
+  const uint8_t* end = block + cbytes;
+  int32_t stop = start + nitems;
+
+  // The frames before the first item are skipped by their widths
+  int32_t nframe = start / BITPACK_FRAME_NITEMS;
+  for (int32_t i = 0; i < nframe && i < nframes; i++) {
+    src += widths[i] * BITPACK_VECTOR_SIZE;
+  }
+  uint8_t frame[BITPACK_FRAME_NITEMS * sizeof(uint64_t)];
+  int32_t item = start;
+  for (; nframe < nframes && item < stop; nframe++) {
+    int width = widths[nframe];
+    if (width > unit * 8 || end - src < width * BITPACK_VECTOR_SIZE) {
+      return BLOSC2_ERROR_DATA;
+    }
+    int32_t frame_start = nframe * BITPACK_FRAME_NITEMS;
+    int32_t frame_stop = frame_start + BITPACK_FRAME_NITEMS;
+    int32_t n = ((stop < frame_stop) ? stop : frame_stop) - item;
+    uint64_t ref = load_word(refs + nframe * unit, unit);
+    if (item == frame_start && n == BITPACK_FRAME_NITEMS) {
+      unpack_frame(src, unit, sign, ref, width, dest + (item - start) * unit);
+    }
+    else {
+      unpack_frame(src, unit, sign, ref, width, frame);
+      memcpy(dest + (item - start) * unit, frame + (item - frame_start) * unit, n * unit);
+    }
+    item += n;
+    src += width * BITPACK_VECTOR_SIZE;
+  }
+  if (item < stop) {
+    // The leftover items are after all the frames
+    for (; nframe < nframes; nframe++) {
+      src += widths[nframe] * BITPACK_VECTOR_SIZE;
+    }
+    int32_t offset = (item - nframes * BITPACK_FRAME_NITEMS) * unit;
+    if (end - src < offset + (stop - item) * unit) {
+      return BLOSC2_ERROR_DATA;
+    }
+    memcpy(dest + (item - start) * unit, src + offset, (stop - item) * unit);
+  }
+
+  return nitems * unit;
+}
@@ -0,0 +1,29 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_PLUGINS_CODECS_BITPACK_BITPACK_H
+#define BLOSC_PLUGINS_CODECS_BITPACK_BITPACK_H
+
+#include "blosc2.h"
+
+#include <stdint.h>
+
+int bitpack_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                     uint8_t meta, blosc2_cparams *cparams, const void *chunk);
+
+int bitpack_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                       uint8_t meta, blosc2_dparams *dparams, const void *chunk);
+
+/* Decode just the nitems items from item start of a block into dest (a blosc2_codec_getitems_cb).
+ * Returns the bytes written to dest, or a negative value if the block is corrupted. */
+int bitpack_getitems(const uint8_t *block, int32_t cbytes, int32_t start, int32_t nitems,
+                     uint8_t *dest, int32_t destsize, uint8_t meta, blosc2_dparams *dparams, const void *chunk);
+
+#endif /* BLOSC_PLUGINS_CODECS_BITPACK_BITPACK_H */
@@ -0,0 +1,154 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test program for the bitpack codec.  Integer columns with every width
+    of their ranges are compressed, decompressed and read back item by item
+    with blosc2_getitem (which only decodes the frames of the items).
+
+**********************************************************************/
+
+#include "blosc2/codecs-registry.h"
+#include "blosc2.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NITEMS (30 * 1000 + 17)
+
+
+/* Items of typesize bytes whose differences to their minimum (per frame) take width bits */
+static void fill(uint8_t *data, int32_t typesize, int width, bool is_signed, int32_t nitems) {
+  uint64_t state = 42;
+  int bits = typesize * 8;
+  uint64_t range = (width >= 64) ? UINT64_MAX : (1ULL << width) - 1;
+  uint64_t base = is_signed ? (uint64_t)-1000 : 123;
+  for (int32_t i = 0; i < nitems; i++) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint64_t x = base + (state >> 11) % (range == UINT64_MAX ? range : range + 1);
+    if (width == 64) {
+      x = state;
+    }
+    if (i % 128 == 5) {
+      x = base + range;  // the whole width in every frame
+    }
+    if (bits < 64) {
+      x &= (1ULL << bits) - 1;
+    }
+    memcpy(data + i * typesize, &x, typesize);
+  }
+}
+
+
+static int test_column(int32_t typesize, int width, bool is_signed, int16_t nthreads) {
+  int32_t nbytes = NITEMS * typesize;
+  uint8_t *data = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  uint8_t *dest = malloc(nbytes);
+  fill(data, typesize, width, is_signed, NITEMS);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  cparams.compcode = BLOSC_CODEC_BITPACK;
+  cparams.compcode_meta = is_signed ? 1 : 0;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_NOFILTER;
+  cparams.blocksize = 10 * 1000 * typesize;  // a leftover block and frames
+  cparams.nthreads = nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  if (csize <= 0) {
+    printf("Compression error: %d\n", csize);
+    return -1;
+  }
+  int bits = typesize * 8;
+  if (width < bits / 2 && csize > nbytes * (width + 2) / bits + 1000) {
+    printf("Typesize %d, width %d: the chunk is too large (%d bytes)\n", typesize, width, csize);
+    return -1;
+  }
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, chunk, csize, dest, nbytes);
+  if (dsize != nbytes || memcmp(data, dest, nbytes) != 0) {
+    printf("Typesize %d, width %d: the decompressed data differs\n", typesize, width);
+    return -1;
+  }
+
+  // Items and runs of them that start and end anywhere in the frames and the blocks
+  int32_t starts[] = {0, 1, 127, 128, 300, 9999, 10000, 20001, NITEMS - 30, NITEMS - 1, 129};
+  int32_t counts[] = {1, 200, 2, 128, 10000, 2, 10000, 9000, 30, 1, NITEMS - 129};
+  for (int i = 0; i < (int)(sizeof(starts) / sizeof(starts[0])); i++) {
+    memset(dest, 0, nbytes);
+    int rc = blosc2_getitem_ctx(dctx, chunk, csize, starts[i], counts[i], dest, nbytes);
+    if (rc != counts[i] * typesize ||
+        memcmp(dest, data + starts[i] * typesize, counts[i] * typesize) != 0) {
+      printf("Typesize %d, width %d: getitem(%d, %d) differs\n", typesize, width, starts[i], counts[i]);
+      return -1;
+    }
+  }
+  blosc2_free_ctx(dctx);
+
+  free(data);
+  free(chunk);
+  free(dest);
+  return 0;
+}
+
+
+/* With a shuffle the codec sees bytes that it does not know, but still gets them back */
+static int test_filters(void) {
+  int32_t nbytes = NITEMS * 4;
+  uint8_t *data = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  uint8_t *dest = malloc(nbytes);
+  for (int i = 0; i < NITEMS; i++) {
+    ((uint32_t *) data)[i] = 1000000 + i;
+  }
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 4;
+  cparams.compcode = BLOSC_CODEC_BITPACK;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  int rc = blosc2_getitem(chunk, csize, 1000, 10, dest, nbytes);
+  if (csize <= 0 || rc != 40 || memcmp(dest, data + 4000, 40) != 0) {
+    printf("The bitpack codec fails behind the shuffle\n");
+    return -1;
+  }
+  free(data);
+  free(chunk);
+  free(dest);
+  return 0;
+}
+
+
+int main(void) {
+  blosc2_init();
+  int result = 0;
+  int32_t typesizes[] = {1, 2, 4, 8};
+  for (int i = 0; i < 4 && result == 0; i++) {
+    int32_t typesize = typesizes[i];
+    printf("typesize %d: ", typesize);
+    for (int width = 0; width <= typesize * 8 && result == 0; width++) {
+      bool is_signed = width % 2 == 1;
+      result = test_column(typesize, width, is_signed, (width % 5 == 0) ? 4 : 1);
+    }
+    printf("%s\n", result == 0 ? "ok" : "failed");
+  }
+  if (result == 0) {
+    result = test_filters();
+  }
+  blosc2_destroy();
+  return result;
+}
@@ -7,8 +7,13 @@
 #include "blosc2/codecs-registry.h"
 #include "ndlz/ndlz.h"
 #include "zfp/blosc2-zfp.h"
+#include "bitpack/bitpack.h"
 #include "blosc-private.h"
 #include "blosc2.h"
+#include "config.h"
+#if defined(HAVE_QPL)
+  #include "qpl/blosc2-qpl.h"
+#endif
 
 void register_codecs(void) {
 
@@ -47,6 +52,7 @@ void register_codecs(void) {
   zfp_rate.decoder = &zfp_rate_decompress;
   zfp_rate.compname = "zfp_rate";
   register_codec_private(&zfp_rate);
+  register_codec_getitems_private(BLOSC_CODEC_ZFP_FIXED_RATE, &zfp_getcell);
 
   blosc2_codec openhtj2k;
   openhtj2k.compcode = BLOSC_CODEC_OPENHTJ2K;
@@ -56,4 +62,30 @@ void register_codecs(void) {
   openhtj2k.decoder = NULL;
   openhtj2k.compname = "openhtj2k";
   register_codec_private(&openhtj2k);
+
+  blosc2_codec qpl_deflate;
+  qpl_deflate.compcode = BLOSC_CODEC_QPL_DEFLATE;
+  qpl_deflate.version = 1;
+  qpl_deflate.complib = BLOSC_CODEC_QPL_DEFLATE;
+#if defined(HAVE_QPL)
+  qpl_codec_init();
+  qpl_deflate.encoder = &qpl_deflate_compress;
+  qpl_deflate.decoder = &qpl_deflate_decompress;
+#else
+  // Only available when built with QPL
+  qpl_deflate.encoder = NULL;
+  qpl_deflate.decoder = NULL;
+#endif
+  qpl_deflate.compname = "qpl_deflate";
+  register_codec_private(&qpl_deflate);
+
+  blosc2_codec bitpack;
+  bitpack.compcode = BLOSC_CODEC_BITPACK;
+  bitpack.version = 1;
+  bitpack.complib = BLOSC_CODEC_BITPACK;
+  bitpack.encoder = &bitpack_compress;
+  bitpack.decoder = &bitpack_decompress;
+  bitpack.compname = "bitpack";
+  register_codec_private(&bitpack);
+  register_codec_getitems_private(BLOSC_CODEC_BITPACK, &bitpack_getitems);
 }
@@ -11,7 +11,18 @@
 #ifndef NDLZ_PRIVATE_H
 #define NDLZ_PRIVATE_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 #define XXH_INLINE_ALL
 
@@ -22,4 +33,90 @@
     }                            \
   } while (0)
 
+/* Whether the `len` bytes (a multiple of 4) in `a` and `b` are the same.  The rows and cells
+ * compared by the codecs are 4 to 64 bytes long, so go for whole vectors as much as possible. */
+static inline bool ndlz_equal(const uint8_t *a, const uint8_t *b, int len) {
+  int i = 0;
+#if defined(__AVX2__)
+  for (; i + 32 <= len; i += 32) {
+    __m256i cmp = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (a + i)),
+                                    _mm256_loadu_si256((const __m256i *) (b + i)));
+    if ((uint32_t) _mm256_movemask_epi8(cmp) != 0xFFFFFFFFU) {
+      return false;
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  for (; i + 16 <= len; i += 16) {
+    __m128i cmp = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i)),
+                                 _mm_loadu_si128((const __m128i *) (b + i)));
+    if (_mm_movemask_epi8(cmp) != 0xFFFF) {
+      return false;
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + 16 <= len; i += 16) {
+    if (vminvq_u8(vceqq_u8(vld1q_u8(a + i), vld1q_u8(b + i))) != 0xFF) {
+      return false;
+    }
+  }
+#endif
+  for (; i + 8 <= len; i += 8) {
+    uint64_t x, y;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    if (x != y) {
+      return false;
+    }
+  }
+  for (; i < len; i += 4) {
+    uint32_t x, y;
+    memcpy(&x, a + i, 4);
+    memcpy(&y, b + i, 4);
+    if (x != y) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Whether the `len` bytes (a multiple of 16) in `a` are all the same */
+static inline bool ndlz_all_equal(const uint8_t *a, int len) {
+  int i = 0;
+#if defined(__AVX2__)
+  __m256i ref32 = _mm256_set1_epi8((char) a[0]);
+  for (; i + 32 <= len; i += 32) {
+    __m256i cmp = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (a + i)), ref32);
+    if ((uint32_t) _mm256_movemask_epi8(cmp) != 0xFFFFFFFFU) {
+      return false;
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  __m128i ref16 = _mm_set1_epi8((char) a[0]);
+  for (; i < len; i += 16) {
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i)), ref16)) != 0xFFFF) {
+      return false;
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  uint8x16_t ref16 = vdupq_n_u8(a[0]);
+  for (; i < len; i += 16) {
+    if (vminvq_u8(vceqq_u8(vld1q_u8(a + i), ref16)) != 0xFF) {
+      return false;
+    }
+  }
+#else
+  uint64_t ref8 = a[0] * UINT64_C(0x0101010101010101);
+  for (; i < len; i += 8) {
+    uint64_t x;
+    memcpy(&x, a + i, 8);
+    if (x != ref8) {
+      return false;
+    }
+  }
+#endif
+  return true;
+}
+
 #endif /* NDLZ_PRIVATE_H */
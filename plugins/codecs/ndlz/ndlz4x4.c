@@ -198,14 +198,8 @@ int ndlz4_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
         if (tab_cell[hash_cell] == 0) {
           distance = 0;
         } else {
-          bool same = true;
           buf_aux = obase + tab_cell[hash_cell];
-          for (int i = 0; i < 16; i++) {
-            if (buf_cell[i] != buf_aux[i]) {
-              same = false;
-              break;
-            }
-          }
+          bool same = ndlz_equal(buf_cell, buf_aux, 16);
           if (same) {
             distance = (int32_t) (anchor - ref);
           } else {
@@ -213,13 +207,7 @@ int ndlz4_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
           }
         }
 
-        bool alleq = true;
-        for (int i = 1; i < 16; i++) {
-          if (buf_cell[i] != buf_cell[0]) {
-            alleq = false;
-            break;
-          }
-        }
+        bool alleq = ndlz_all_equal(buf_cell, 16);
         if (alleq) {                              // all elements of the cell equal
           token = (uint8_t) (1U << 6U);
           *op++ = token;
@@ -240,12 +228,7 @@ int ndlz4_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
             uint16_t offset;
             if (tab_pair[hval] != 0) {
               buf_aux = obase + tab_pair[hval];
-              for (int k = 0; k < 8; k++) {
-                if (buf_pair[k] != buf_aux[k]) {
-                  same = false;
-                  break;
-                }
-              }
+              same = ndlz_equal(buf_pair, buf_aux, 8);
               offset = (uint16_t) (anchor - obase - tab_pair[hval]);
             } else {
               same = false;
@@ -316,12 +299,7 @@ int ndlz4_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
                 uint16_t offset;
                 if (tab_triple[hval] != 0) {
                   buf_aux = obase + tab_triple[hval];
-                  for (int l = 0; l < 12; l++) {
-                    if (buf_triple[l] != buf_aux[l]) {
-                      same = false;
-                      break;
-                    }
-                  }
+                  same = ndlz_equal(buf_triple, buf_aux, 12);
                   offset = (uint16_t) (anchor - obase - tab_triple[hval]);
                 } else {
                   same = false;
@@ -372,12 +350,7 @@ int ndlz4_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
               uint16_t offset;
               if (tab_pair[hval] != 0) {
                 buf_aux = obase + tab_pair[hval];
-                for (int k = 0; k < 8; k++) {
-                  if (buf_pair[k] != buf_aux[k]) {
-                    same = false;
-                    break;
-                  }
-                }
+                same = ndlz_equal(buf_pair, buf_aux, 8);
                 offset = (uint16_t) (anchor - obase - tab_pair[hval]);
               } else {
                 same = false;
@@ -548,7 +521,6 @@ int ndlz4_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, i
   if (NDLZ_UNEXPECT_CONDITIONAL((int64_t)output_len < (int64_t)blockshape[0] * (int64_t)blockshape[1])) {
     return 0;
   }
-  memset(op, 0, blockshape[0] * blockshape[1]);
 
   uint32_t i_stop[2];
   for (int i = 0; i < 2; ++i) {
@@ -676,12 +648,20 @@ int ndlz4_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, i
       }
       // fill op with buffercpy
       uint32_t orig = ii[0] * 4 * blockshape[1] + ii[1] * 4;
-      for (uint32_t i = 0; i < 4; i++) {
-        if (i < padding[0]) {
-          ind = orig + i * blockshape[1];
-          memcpy(&op[ind], buffercpy, padding[1]);
+      if (padding[0] == 4 && padding[1] == 4) {
+        // Most cells are whole ones, which are better copied by rows of a fixed size
+        for (uint32_t i = 0; i < 4; i++) {
+          memcpy(&op[orig + i * blockshape[1]], &buffercpy[i * 4], 4);
+        }
+        ind = orig + 3 * blockshape[1];
+      } else {
+        for (uint32_t i = 0; i < 4; i++) {
+          if (i < padding[0]) {
+            ind = orig + i * blockshape[1];
+            memcpy(&op[ind], buffercpy, padding[1]);
+          }
+          buffercpy += padding[1];
         }
-        buffercpy += padding[1];
       }
       if (ind > (uint32_t) output_len) {
         BLOSC_TRACE_ERROR("Exceeding output size");
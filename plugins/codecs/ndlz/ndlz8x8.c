@@ -202,14 +202,8 @@ int ndlz8_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
         if (tab_cell[hash_cell] == 0) {
           distance = 0;
         } else {
-          bool same = true;
           buf_aux = obase + tab_cell[hash_cell];
-          for (int i = 0; i < cell_size; i++) {
-            if (buf_cell[i] != buf_aux[i]) {
-              same = false;
-              break;
-            }
-          }
+          bool same = ndlz_equal(buf_cell, buf_aux, cell_size);
           if (same) {
             distance = (int32_t) (anchor - ref);
           } else {
@@ -217,13 +211,7 @@ int ndlz8_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
           }
         }
 
-        bool alleq = true;
-        for (int i = 1; i < cell_size; i++) {
-          if (buf_cell[i] != buf_cell[0]) {
-            alleq = false;
-            break;
-          }
-        }
+        bool alleq = ndlz_all_equal(buf_cell, cell_size);
         if (alleq) {                              // all elements of the cell equal
           uint8_t token = (uint8_t) (1U << 6U);
           *op++ = token;
@@ -242,12 +230,7 @@ int ndlz8_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
             uint16_t offset;
             if (tab_triple[hval] != 0) {
               buf_aux = obase + tab_triple[hval];
-              for (int l = 0; l < 24; l++) {
-                if (buf_cell[triple_start + l] != buf_aux[l]) {
-                  same = false;
-                  break;
-                }
-              }
+              same = ndlz_equal(&buf_cell[triple_start], buf_aux, 24);
               offset = (uint16_t) (anchor - obase - tab_triple[hval]);
             } else {
               same = false;
@@ -287,12 +270,7 @@ int ndlz8_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int
             uint16_t offset;
             if (tab_pair[hval] != 0) {
               buf_aux = obase + tab_pair[hval];
-              for (int k = 0; k < 16; k++) {
-                if (buf_cell[pair_start + k] != buf_aux[k]) {
-                  same = false;
-                  break;
-                }
-              }
+              same = ndlz_equal(&buf_cell[pair_start], buf_aux, 16);
               offset = (uint16_t) (anchor - obase - tab_pair[hval]);
             } else {
               same = false;
@@ -465,7 +443,6 @@ int ndlz8_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, i
   if (NDLZ_UNEXPECT_CONDITIONAL((int64_t)output_len < (int64_t)blockshape[0] * (int64_t)blockshape[1])) {
     return 0;
   }
-  memset(op, 0, blockshape[0] * blockshape[1]);
 
   int32_t i_stop[2];
   for (int i = 0; i < 2; ++i) {
@@ -547,12 +524,20 @@ int ndlz8_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, i
       }
 
       int32_t orig = ii[0] * cell_shape * blockshape[1] + ii[1] * cell_shape;
-      for (int32_t i = 0; i < (int32_t) cell_shape; i++) {
-        if (i < padding[0]) {
-          ind = orig + i * blockshape[1];
-          memcpy(&op[ind], buffercpy, padding[1]);
+      if (padding[0] == cell_shape && padding[1] == cell_shape) {
+        // Most cells are whole ones, which are better copied by rows of a fixed size
+        for (int32_t i = 0; i < 8; i++) {
+          memcpy(&op[orig + i * blockshape[1]], &buffercpy[i * 8], 8);
+        }
+        ind = orig + 7 * blockshape[1];
+      } else {
+        for (int32_t i = 0; i < (int32_t) cell_shape; i++) {
+          if (i < padding[0]) {
+            ind = orig + i * blockshape[1];
+            memcpy(&op[ind], buffercpy, padding[1]);
+          }
+          buffercpy += padding[1];
         }
-        buffercpy += padding[1];
       }
       if (ind > output_len) {
         free(local_buffer);
@@ -0,0 +1,276 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Deflate codec offloaded to the Intel IAA accelerator through QPL.
+
+  A block is split into (up to QPL_MAX_JOBS) segments that are compressed as
+  independent deflate streams, so that all of them are submitted to the
+  accelerator at once and then waited for: the (few) threads of a context keep
+  many more hardware jobs in flight than one block per thread would.  The
+  format of a compressed block is:
+
+    | segsize (int32) | nsegments (int32) | csize of every segment (int32) | streams |
+
+  When there is no accelerator, QPL runs the same jobs in software.
+*/
+
+#include "blosc2-qpl.h"
+#include "blosc-private.h"
+#include "blosc2.h"
+
+#include <qpl/qpl.h>
+
+#if defined(_WIN32)
+#include "win32/pthread.h"
+#else
+#include <pthread.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The maximum number of jobs that a block is split into */
+#define QPL_MAX_JOBS 8
+/* The minimum size of a segment, so that small blocks are not split uselessly */
+#define QPL_MIN_SEGSIZE (32 * 1024)
+#define QPL_HEADER_LEN(nsegments) ((int32_t)sizeof(int32_t) * (2 + (nsegments)))
+
+
+/* The jobs are expensive to set up, so they are kept in a (lock protected) pool */
+typedef struct qpl_job_node {
+  qpl_job *job;
+  struct qpl_job_node *next;
+} qpl_job_node;
+
+static pthread_mutex_t g_qpl_mutex;
+static qpl_job_node *g_qpl_pool = NULL;
+static int g_qpl_initialized = 0;
+
+
+void qpl_codec_init(void) {
+  if (!g_qpl_initialized) {
+    pthread_mutex_init(&g_qpl_mutex, NULL);
+    g_qpl_initialized = 1;
+  }
+}
+
+
+static qpl_job *get_job(void) {
+  qpl_job *job = NULL;
+  pthread_mutex_lock(&g_qpl_mutex);
+  qpl_job_node *node = g_qpl_pool;
+  if (node != NULL) {
+    g_qpl_pool = node->next;
+  }
+  pthread_mutex_unlock(&g_qpl_mutex);
+  if (node != NULL) {
+    job = node->job;
+    free(node);
+    return job;
+  }
+
+  uint32_t job_size;
+  if (qpl_get_job_size(qpl_path_auto, &job_size) != QPL_STS_OK) {
+    BLOSC_TRACE_ERROR("Cannot get the size of QPL jobs.");
+    return NULL;
+  }
+  job = malloc(job_size);
+  if (job == NULL) {
+    return NULL;
+  }
+  if (qpl_init_job(qpl_path_auto, job) != QPL_STS_OK) {
+    BLOSC_TRACE_ERROR("Cannot initialize a QPL job.");
+    free(job);
+    return NULL;
+  }
+  return job;
+}
+
+
+static void put_job(qpl_job *job) {
+  qpl_job_node *node = malloc(sizeof(qpl_job_node));
+  if (node == NULL) {
+    qpl_fini_job(job);
+    free(job);
+    return;
+  }
+  node->job = job;
+  pthread_mutex_lock(&g_qpl_mutex);
+  node->next = g_qpl_pool;
+  g_qpl_pool = node;
+  pthread_mutex_unlock(&g_qpl_mutex);
+}
+
+
+/* Check out `njobs` jobs of the pool.  Returns the number of jobs checked out. */
+static int get_jobs(qpl_job **jobs, int njobs) {
+  for (int i = 0; i < njobs; i++) {
+    jobs[i] = get_job();
+    if (jobs[i] == NULL) {
+      for (int j = 0; j < i; j++) {
+        put_job(jobs[j]);
+      }
+      return 0;
+    }
+  }
+  return njobs;
+}
+
+
+static void put_jobs(qpl_job **jobs, int njobs) {
+  for (int i = 0; i < njobs; i++) {
+    put_job(jobs[i]);
+  }
+}
+
+
+/* Submit the jobs at once, and then wait for all of them */
+static qpl_status run_jobs(qpl_job **jobs, int njobs) {
+  qpl_status status = QPL_STS_OK;
+  int nsubmitted = 0;
+  for (; nsubmitted < njobs; nsubmitted++) {
+    status = qpl_submit_job(jobs[nsubmitted]);
+    if (status != QPL_STS_OK) {
+      break;
+    }
+  }
+  for (int i = 0; i < nsubmitted; i++) {
+    qpl_status status_ = qpl_wait_job(jobs[i]);
+    if (status == QPL_STS_OK) {
+      status = status_;
+    }
+  }
+  return status;
+}
+
+
+int qpl_deflate_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                         uint8_t meta, blosc2_cparams *cparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(cparams);
+  BLOSC_UNUSED_PARAM(chunk);
+
+  if (input_len <= 0) {
+    return 0;
+  }
+  int32_t segsize = (input_len + QPL_MAX_JOBS - 1) / QPL_MAX_JOBS;
+  if (segsize < QPL_MIN_SEGSIZE) {
+    segsize = QPL_MIN_SEGSIZE;
+  }
+  int nsegments = (input_len + segsize - 1) / segsize;
+  int32_t header_len = QPL_HEADER_LEN(nsegments);
+  int32_t maxout = output_len - header_len;
+  if (maxout <= 0) {
+    return 0;
+  }
+
+  qpl_job *jobs[QPL_MAX_JOBS];
+  if (get_jobs(jobs, nsegments) == 0) {
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  /* Every segment gets a share of the output that is proportional to its size */
+  int32_t out_offsets[QPL_MAX_JOBS];
+  int32_t out_offset = header_len;
+  for (int i = 0; i < nsegments; i++) {
+    int32_t seglen = (i < nsegments - 1) ? segsize : input_len - i * segsize;
+    int32_t segout = (int32_t)((int64_t)maxout * seglen / input_len);
+    qpl_job *job = jobs[i];
+    job->op = qpl_op_compress;
+    job->level = qpl_default_level;
+    job->next_in_ptr = (uint8_t *)input + (int64_t)i * segsize;
+    job->available_in = (uint32_t)seglen;
+    job->next_out_ptr = output + out_offset;
+    job->available_out = (uint32_t)segout;
+    job->flags = QPL_FLAG_FIRST | QPL_FLAG_LAST | QPL_FLAG_DYNAMIC_HUFFMAN | QPL_FLAG_OMIT_VERIFY;
+    out_offsets[i] = out_offset;
+    out_offset += segout;
+  }
+
+  int cbytes;
+  qpl_status status = run_jobs(jobs, nsegments);
+  if (status == QPL_STS_MORE_OUTPUT_NEEDED) {
+    // Incompressible data
+    cbytes = 0;
+  }
+  else if (status != QPL_STS_OK) {
+    BLOSC_TRACE_ERROR("Error %d compressing with QPL.", (int)status);
+    cbytes = BLOSC2_ERROR_FAILURE;
+  }
+  else {
+    /* Pack the streams (which can only move backwards) after the header */
+    _sw32(output, segsize);
+    _sw32(output + sizeof(int32_t), nsegments);
+    cbytes = header_len;
+    for (int i = 0; i < nsegments; i++) {
+      int32_t csize = (int32_t)jobs[i]->total_out;
+      _sw32(output + sizeof(int32_t) * (2 + i), csize);
+      memmove(output + cbytes, output + out_offsets[i], csize);
+      cbytes += csize;
+    }
+  }
+  put_jobs(jobs, nsegments);
+
+  return cbytes;
+}
+
+
+int qpl_deflate_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                           uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(chunk);
+
+  if (input_len < QPL_HEADER_LEN(1)) {
+    BLOSC_TRACE_ERROR("The QPL stream is too short.");
+    return BLOSC2_ERROR_READ_BUFFER;
+  }
+  int32_t segsize = sw32_(input);
+  int32_t nsegments = sw32_(input + sizeof(int32_t));
+  if (segsize <= 0 || nsegments <= 0 || nsegments > QPL_MAX_JOBS ||
+      input_len < QPL_HEADER_LEN(nsegments) || (int64_t)segsize * (nsegments - 1) >= output_len) {
+    BLOSC_TRACE_ERROR("The header of the QPL stream is corrupted.");
+    return BLOSC2_ERROR_DATA;
+  }
+
+  qpl_job *jobs[QPL_MAX_JOBS];
+  if (get_jobs(jobs, nsegments) == 0) {
+    return BLOSC2_ERROR_MEMORY_ALLOC;
+  }
+  int32_t in_offset = QPL_HEADER_LEN(nsegments);
+  int rc = 0;
+  for (int i = 0; i < nsegments; i++) {
+    int32_t csize = sw32_(input + sizeof(int32_t) * (2 + i));
+    if (csize <= 0 || csize > input_len - in_offset) {
+      BLOSC_TRACE_ERROR("The QPL stream is corrupted.");
+      rc = BLOSC2_ERROR_DATA;
+      break;
+    }
+    int32_t seglen = (i < nsegments - 1) ? segsize : output_len - i * segsize;
+    qpl_job *job = jobs[i];
+    job->op = qpl_op_decompress;
+    job->next_in_ptr = (uint8_t *)input + in_offset;
+    job->available_in = (uint32_t)csize;
+    job->next_out_ptr = output + (int64_t)i * segsize;
+    job->available_out = (uint32_t)seglen;
+    job->flags = QPL_FLAG_FIRST | QPL_FLAG_LAST;
+    in_offset += csize;
+  }
+
+  if (rc == 0) {
+    qpl_status status = run_jobs(jobs, nsegments);
+    if (status != QPL_STS_OK) {
+      BLOSC_TRACE_ERROR("Error %d decompressing with QPL.", (int)status);
+      rc = BLOSC2_ERROR_FAILURE;
+    }
+    else {
+      for (int i = 0; i < nsegments; i++) {
+        rc += (int)jobs[i]->total_out;
+      }
+    }
+  }
+  put_jobs(jobs, nsegments);
+
+  return rc;
+}
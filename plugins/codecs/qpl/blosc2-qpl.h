@@ -0,0 +1,27 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#ifndef BLOSC_PLUGINS_CODECS_QPL_BLOSC2_QPL_H
+#define BLOSC_PLUGINS_CODECS_QPL_BLOSC2_QPL_H
+
+#include "blosc2.h"
+
+#include <stdint.h>
+
+/* Set up the pool of QPL jobs (called once, when registering the codec) */
+void qpl_codec_init(void);
+
+int qpl_deflate_compress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                         uint8_t meta, blosc2_cparams *cparams, const void *chunk);
+
+int qpl_deflate_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                           uint8_t meta, blosc2_dparams *dparams, const void *chunk);
+
+#endif /* BLOSC_PLUGINS_CODECS_QPL_BLOSC2_QPL_H */
@@ -0,0 +1,97 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Roundtrip tests for the qpl_deflate codec, for blocks that are split
+    into a single and into several hardware jobs.
+
+**********************************************************************/
+
+#include "blosc2/codecs-registry.h"
+#include "blosc2.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NITEMS (1000 * 1000)
+
+
+static int test_roundtrip(int32_t blocksize, int16_t nthreads, int32_t *data) {
+  int32_t nbytes = NITEMS * sizeof(int32_t);
+  uint8_t *cdata = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  int32_t *rdata = malloc(nbytes);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.compcode = BLOSC_CODEC_QPL_DEFLATE;
+  cparams.clevel = 9;
+  cparams.blocksize = blocksize;
+  cparams.nthreads = nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+
+  int result = 0;
+  int csize = blosc2_compress_ctx(cctx, data, nbytes, cdata, nbytes + BLOSC2_MAX_OVERHEAD);
+  if (csize <= 0) {
+    printf("Compression error.  Error code: %d\n", csize);
+    result = -1;
+    goto out;
+  }
+  int dsize = blosc2_decompress_ctx(dctx, cdata, csize, rdata, nbytes);
+  if (dsize != nbytes) {
+    printf("Decompression error.  Error code: %d\n", dsize);
+    result = -1;
+    goto out;
+  }
+  if (memcmp(data, rdata, nbytes) != 0) {
+    printf("Decompressed data differs from original!\n");
+    result = -1;
+    goto out;
+  }
+  /* Items out of the middle of the blocks */
+  int32_t item;
+  if (blosc2_getitem_ctx(dctx, cdata, csize, NITEMS / 2 + 3, 1, &item, sizeof(item)) != sizeof(item) ||
+      item != data[NITEMS / 2 + 3]) {
+    printf("Error getting an item!\n");
+    result = -1;
+    goto out;
+  }
+  printf("Successful roundtrip (blocksize: %d, nthreads: %d): %d -> %d (%.1fx)\n",
+         blocksize, nthreads, nbytes, csize, (1. * nbytes) / csize);
+
+  out:
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  free(cdata);
+  free(rdata);
+  return result;
+}
+
+
+int main(void) {
+  blosc2_init();
+  int32_t *data = malloc(NITEMS * sizeof(int32_t));
+  for (int i = 0; i < NITEMS; i++) {
+    data[i] = (i % 1000) * (i / 1000) + i % 7;
+  }
+
+  int result = 0;
+  // Small blocks go in a single job, large ones are split in several
+  result |= test_roundtrip(16 * 1024, 1, data);
+  result |= test_roundtrip(256 * 1024, 1, data);
+  result |= test_roundtrip(2 * 1024 * 1024, 4, data);
+  result |= test_roundtrip(0, 2, data);
+
+  free(data);
+  blosc2_destroy();
+  return result;
+}
@@ -731,18 +731,17 @@ int zfp_rate_decompress(const uint8_t *input, int32_t input_len, uint8_t *output
   return (int) output_len;
 }
 
-int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint8_t *dest, int32_t destsize) {
-  struct thread_context *thread_ctx = thread_context;
-  blosc2_context *context = thread_ctx->parent_context;
+/* Fill the blockshape of the super-chunk out of the b2nd metalayer (if not done yet) */
+static int get_blockshape(blosc2_schunk *schunk) {
   bool meta = false;
   int8_t ndim = ZFP_MAX_DIM + 1;
   int32_t blockmeta[ZFP_MAX_DIM];
-  if (context->schunk->blockshape == NULL) {
+  if (schunk->blockshape == NULL) {
     // blockshape is not filled yet.  Use the Blosc2 NDim layer to populate it.
-    for (int nmetalayer = 0; nmetalayer < context->schunk->nmetalayers; nmetalayer++) {
-      if (strcmp("b2nd", context->schunk->metalayers[nmetalayer]->name) == 0) {
+    for (int nmetalayer = 0; nmetalayer < schunk->nmetalayers; nmetalayer++) {
+      if (strcmp("b2nd", schunk->metalayers[nmetalayer]->name) == 0) {
         meta = true;
-        uint8_t *pmeta = context->schunk->metalayers[nmetalayer]->content;
+        uint8_t *pmeta = schunk->metalayers[nmetalayer]->content;
         ndim = (int8_t) pmeta[2];
         assert(ndim <= ZFP_MAX_DIM);
         pmeta += (6 + ndim * 9 + ndim * 5);
@@ -756,14 +755,28 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
     if (!meta) {
       return -1;
     }
-    context->schunk->ndim = ndim;
-    context->schunk->blockshape = malloc(sizeof(int64_t) * ndim);
+    schunk->ndim = ndim;
+    schunk->blockshape = malloc(sizeof(int64_t) * ndim);
     for (int i = 0; i < ndim; ++i) {
-      context->schunk->blockshape[i] = (int64_t) blockmeta[i];
+      schunk->blockshape[i] = (int64_t) blockmeta[i];
     }
   }
-  ndim = context->schunk->ndim;
-  int64_t *blockshape = context->schunk->blockshape;
+  return 0;
+}
+
+int zfp_getcell(const uint8_t *block, int32_t cbytes, int32_t start, int32_t nitems, uint8_t *dest,
+                int32_t destsize, uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(chunk);
+  blosc2_schunk *schunk = dparams->schunk;
+  if (schunk == NULL) {
+    // No b2nd metalayer to get the cells from, so go for the whole block
+    return 0;
+  }
+  if (get_blockshape(schunk) < 0) {
+    return -1;
+  }
+  int8_t ndim = schunk->ndim;
+  int64_t *blockshape = schunk->blockshape;
 
   // Compute the coordinates of the cell
   int64_t cell_start_ndim[ZFP_MAX_DIM];
@@ -772,7 +785,7 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
   int64_t ind_strides[ZFP_MAX_DIM];
   int64_t cell_strides[ZFP_MAX_DIM];
   int64_t cell_ind, ncell;
-  blosc2_unidim_to_multidim(ndim, blockshape, thread_ctx->zfp_cell_start, cell_start_ndim);
+  blosc2_unidim_to_multidim(ndim, blockshape, start, cell_start_ndim);
   for (int i = 0; i < ndim; ++i) {
     cell_ind_ndim[i] = cell_start_ndim[i] % ZFP_MAX_DIM;
     ncell_ndim[i] = cell_start_ndim[i] / ZFP_MAX_DIM;
@@ -785,8 +798,7 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
   blosc2_multidim_to_unidim(cell_ind_ndim, (int8_t) ndim, ind_strides, &cell_ind);
   blosc2_multidim_to_unidim(ncell_ndim, (int8_t) ndim, cell_strides, &ncell);
   int cell_nitems = (int) (1u << (2 * ndim));
-  if ((thread_ctx->zfp_cell_nitems > cell_nitems) ||
-      ((cell_ind + thread_ctx->zfp_cell_nitems) > cell_nitems)) {
+  if ((nitems > cell_nitems) || ((cell_ind + nitems) > cell_nitems)) {
     return 0;
   }
 
@@ -794,7 +806,7 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
   zfp_type type;     /* array scalar type */
   zfp_stream *zfp;   /* compressed stream */
   bitstream *stream; /* bit stream to write to or read from */
-  int32_t typesize = context->typesize;
+  int32_t typesize = schunk->typesize;
   zfp = zfp_stream_open(NULL);
 
   switch (typesize) {
@@ -808,8 +820,7 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
       BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
       return BLOSC2_ERROR_FAILURE;
   }
-  uint8_t compmeta = context->compcode_meta;   // access to compressed chunk header
-  double rate = (double) (compmeta * typesize * 8) /
+  double rate = (double) (meta * typesize * 8) /
                 100.0;     // convert from output size / input size to output bits per input value
   zfp_stream_set_rate(zfp, rate, type, ndim, zfp_false);
 
@@ -867,17 +878,169 @@ int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint
       BLOSC_TRACE_ERROR("ZFP is not available for ndims: %d", ndim);
       return BLOSC2_ERROR_FAILURE;
   }
-  memcpy(dest, &cell[cell_ind * typesize], thread_ctx->zfp_cell_nitems * typesize);
+  memcpy(dest, &cell[cell_ind * typesize], nitems * typesize);
   zfp_stream_close(zfp);
   stream_close(stream);
   free(cell);
 
   if ((zfpsize == 0) || ((int32_t) zfpsize > (destsize * 8)) ||
       ((int32_t) zfpsize > (cell_nitems * typesize * 8)) ||
-      ((thread_ctx->zfp_cell_nitems * typesize * 8) > (int32_t) zfpsize)) {
+      ((nitems * typesize * 8) > (int32_t) zfpsize)) {
     BLOSC_TRACE_ERROR("ZFP error or small destsize");
     return -1;
   }
 
-  return (int) (thread_ctx->zfp_cell_nitems * typesize);
+  return (int) (nitems * typesize);
+}
+
+/* Decode a (possibly partial) cell at p, with n items and strides s (in items) for every dimension */
+static size_t decode_cell(zfp_stream *zfp, zfp_type type, int ndim, void *p, const size_t *n, const ptrdiff_t *s) {
+  bool partial = false;
+  for (int i = 0; i < ndim; ++i) {
+    partial |= n[i] < ZFP_CELL_SHAPE;
+  }
+  // ZFP dimensions go from the fastest varying one (x) to the slowest one
+  bool isfloat = type == zfp_type_float;
+  switch (ndim) {
+    case 1:
+      if (partial) {
+        return isfloat ? zfp_decode_partial_block_strided_float_1(zfp, p, n[0], s[0])
+                       : zfp_decode_partial_block_strided_double_1(zfp, p, n[0], s[0]);
+      }
+      return isfloat ? zfp_decode_block_strided_float_1(zfp, p, s[0])
+                     : zfp_decode_block_strided_double_1(zfp, p, s[0]);
+    case 2:
+      if (partial) {
+        return isfloat ? zfp_decode_partial_block_strided_float_2(zfp, p, n[1], n[0], s[1], s[0])
+                       : zfp_decode_partial_block_strided_double_2(zfp, p, n[1], n[0], s[1], s[0]);
+      }
+      return isfloat ? zfp_decode_block_strided_float_2(zfp, p, s[1], s[0])
+                     : zfp_decode_block_strided_double_2(zfp, p, s[1], s[0]);
+    case 3:
+      if (partial) {
+        return isfloat ? zfp_decode_partial_block_strided_float_3(zfp, p, n[2], n[1], n[0], s[2], s[1], s[0])
+                       : zfp_decode_partial_block_strided_double_3(zfp, p, n[2], n[1], n[0], s[2], s[1], s[0]);
+      }
+      return isfloat ? zfp_decode_block_strided_float_3(zfp, p, s[2], s[1], s[0])
+                     : zfp_decode_block_strided_double_3(zfp, p, s[2], s[1], s[0]);
+    case 4:
+      if (partial) {
+        return isfloat ? zfp_decode_partial_block_strided_float_4(zfp, p, n[3], n[2], n[1], n[0],
+                                                                  s[3], s[2], s[1], s[0])
+                       : zfp_decode_partial_block_strided_double_4(zfp, p, n[3], n[2], n[1], n[0],
+                                                                   s[3], s[2], s[1], s[0]);
+      }
+      return isfloat ? zfp_decode_block_strided_float_4(zfp, p, s[3], s[2], s[1], s[0])
+                     : zfp_decode_block_strided_double_4(zfp, p, s[3], s[2], s[1], s[0]);
+    default:
+      return 0;
+  }
+}
+
+int zfp_getbox(void *thread_context, const uint8_t *block, int32_t cbytes, int32_t nblock, uint8_t *dest,
+               int32_t destsize) {
+  struct thread_context *thread_ctx = thread_context;
+  blosc2_context *context = thread_ctx->parent_context;
+  if (get_blockshape(context->schunk) < 0) {
+    return -1;
+  }
+  int ndim = context->schunk->ndim;
+  int64_t *blockshape = context->schunk->blockshape;
+  if (ndim != context->zfp_boxes_ndim || ndim < 1 || ndim > ZFP_MAX_DIM) {
+    // Not a box that we can decode, so go for the whole block
+    return 0;
+  }
+  int32_t typesize = context->typesize;
+  zfp_type type;
+  switch (typesize) {
+    case sizeof(float):
+      type = zfp_type_float;
+      break;
+    case sizeof(double):
+      type = zfp_type_double;
+      break;
+    default:
+      BLOSC_TRACE_ERROR("ZFP is not available for typesize: %d", typesize);
+      return BLOSC2_ERROR_FAILURE;
+  }
+  int64_t blocknitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    blocknitems *= blockshape[i];
+  }
+  if (blocknitems * typesize != destsize) {
+    return 0;
+  }
+
+  // The box is made of the starts and then the stops of every dimension
+  const int64_t *box_start = context->zfp_boxes + (int64_t) nblock * 2 * ndim;
+  const int64_t *box_stop = box_start + ndim;
+  int64_t cell_first[ZFP_MAX_DIM];
+  int64_t cell_last[ZFP_MAX_DIM];
+  int64_t cell_strides[ZFP_MAX_DIM];
+  ptrdiff_t item_strides[ZFP_MAX_DIM];
+  cell_strides[ndim - 1] = 1;
+  item_strides[ndim - 1] = 1;
+  for (int i = ndim - 2; i >= 0; --i) {
+    cell_strides[i] = ((blockshape[i + 1] - 1) / ZFP_CELL_SHAPE + 1) * cell_strides[i + 1];
+    item_strides[i] = (ptrdiff_t) blockshape[i + 1] * item_strides[i + 1];
+  }
+  int64_t ncells = ((blockshape[0] - 1) / ZFP_CELL_SHAPE + 1) * cell_strides[0];
+  for (int i = 0; i < ndim; ++i) {
+    if (box_start[i] < 0 || box_stop[i] > blockshape[i] || box_start[i] >= box_stop[i]) {
+      return 0;
+    }
+    cell_first[i] = box_start[i] / ZFP_CELL_SHAPE;
+    cell_last[i] = (box_stop[i] - 1) / ZFP_CELL_SHAPE;
+  }
+
+  uint8_t compmeta = context->compcode_meta;
+  double rate = (double) (compmeta * typesize * 8) / 100.0;
+  zfp_stream *zfp = zfp_stream_open(NULL);
+  zfp_stream_set_rate(zfp, rate, type, ndim, zfp_false);
+  bitstream *stream = stream_open((void *) block, cbytes);
+  zfp_stream_set_bit_stream(zfp, stream);
+  zfp_stream_rewind(zfp);
+  int rc = destsize;
+  if ((int64_t) cbytes * 8 < ncells * (int64_t) zfp->maxbits) {
+    BLOSC_TRACE_ERROR("The block is too small for its cells");
+    rc = -1;
+  }
+
+  // Every cell is maxbits long in fixed-rate mode, so go straight to the ones in the box
+  int64_t cell[ZFP_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    cell[i] = cell_first[i];
+  }
+  while (rc > 0) {
+    int64_t ncell = 0;
+    int64_t offset = 0;
+    size_t n[ZFP_MAX_DIM];
+    for (int i = 0; i < ndim; ++i) {
+      ncell += cell[i] * cell_strides[i];
+      offset += cell[i] * ZFP_CELL_SHAPE * item_strides[i];
+      int64_t left = blockshape[i] - cell[i] * ZFP_CELL_SHAPE;
+      n[i] = (size_t) (left < ZFP_CELL_SHAPE ? left : ZFP_CELL_SHAPE);
+    }
+    stream_rseek(zfp->stream, (size_t) (ncell * zfp->maxbits));
+    if (decode_cell(zfp, type, ndim, dest + offset * typesize, n, item_strides) == 0) {
+      BLOSC_TRACE_ERROR("ZFP: Decompression of a cell failed");
+      rc = -1;
+      break;
+    }
+    // Next cell of the box, in C order
+    int i = ndim - 1;
+    for (; i >= 0; --i) {
+      if (++cell[i] <= cell_last[i]) {
+        break;
+      }
+      cell[i] = cell_first[i];
+    }
+    if (i < 0) {
+      break;
+    }
+  }
+
+  zfp_stream_close(zfp);
+  stream_close(stream);
+  return rc;
 }
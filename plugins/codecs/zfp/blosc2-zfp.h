@@ -33,6 +33,15 @@ int zfp_rate_compress(const uint8_t *input, int32_t input_len, uint8_t *output,
 int zfp_rate_decompress(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
                         uint8_t meta, blosc2_dparams *dparams, const void *chunk);
 
-int zfp_getcell(void *thread_context, const uint8_t *block, int32_t cbytes, uint8_t *dest, int32_t destsize);
+/* Decode just the nitems items from item start of a block when they are all in the same cell
+ * (a blosc2_codec_getitems_cb).  Returns the bytes written to dest, 0 when the whole block
+ * has to be decoded instead, or a negative value on errors. */
+int zfp_getcell(const uint8_t *block, int32_t cbytes, int32_t start, int32_t nitems, uint8_t *dest,
+                int32_t destsize, uint8_t meta, blosc2_dparams *dparams, const void *chunk);
+
+/* Decode just the cells of block nblock that intersect its box in the zfp_boxes of the context.
+ * Returns destsize, or 0 when the whole block has to be decoded instead. */
+int zfp_getbox(void *thread_context, const uint8_t *block, int32_t cbytes, int32_t nblock, uint8_t *dest,
+               int32_t destsize);
 
 #endif /* BLOSC_PLUGINS_CODECS_ZFP_BLOSC2_ZFP_H */
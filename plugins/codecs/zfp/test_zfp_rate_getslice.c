@@ -0,0 +1,185 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test program for getting slices out of b2nd arrays compressed with the
+    ZFP codec in fixed-rate mode.  Only the cells of the blocks in the slice
+    are decoded then, and the items have to be the same as the ones obtained
+    by decompressing the whole chunks.
+
+**********************************************************************/
+
+#include "blosc-private.h"
+#include "b2nd.h"
+#include "blosc2/codecs-registry.h"
+#include "blosc2.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define URLPATH "test_zfp_rate_getslice.b2nd"
+
+
+/* Where an item of the array is in its (whole) decompressed chunks */
+static int64_t chunks_nitem(b2nd_array_t *arr, const int64_t *index) {
+  int8_t ndim = arr->ndim;
+  int64_t nchunk = 0, nblock = 0, nitem = 0;
+  for (int i = 0; i < ndim; ++i) {
+    int64_t chunks_in_array = (arr->extshape[i] / arr->chunkshape[i]);
+    int64_t blocks_in_chunk = (arr->extchunkshape[i] / arr->blockshape[i]);
+    int64_t in_chunk = index[i] % arr->chunkshape[i];
+    nchunk = nchunk * chunks_in_array + index[i] / arr->chunkshape[i];
+    nblock = nblock * blocks_in_chunk + in_chunk / arr->blockshape[i];
+    nitem = nitem * arr->blockshape[i] + in_chunk % arr->blockshape[i];
+  }
+  return (nchunk * arr->extchunknitems) + nblock * arr->blocknitems + nitem;
+}
+
+
+static int check_slice(b2nd_array_t *arr, const uint8_t *chunks, const int64_t *start, const int64_t *stop) {
+  int8_t ndim = arr->ndim;
+  int32_t typesize = arr->sc->typesize;
+  int64_t slice_shape[B2ND_MAX_DIM];
+  int64_t slice_nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    slice_shape[i] = stop[i] - start[i];
+    slice_nitems *= slice_shape[i];
+  }
+  int64_t slice_size = slice_nitems * typesize;
+  uint8_t *slice = malloc(slice_size);
+  BLOSC_ERROR(b2nd_get_slice_cbuffer(arr, start, stop, slice, slice_shape, slice_size));
+
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int64_t nitem = 0; nitem < slice_nitems; ++nitem) {
+    int64_t index[B2ND_MAX_DIM];
+    blosc2_unidim_to_multidim(ndim, slice_shape, nitem, index);
+    for (int i = 0; i < ndim; ++i) {
+      index[i] += start[i];
+    }
+    if (memcmp(&slice[nitem * typesize], &chunks[chunks_nitem(arr, index) * typesize], typesize) != 0) {
+      printf("\nItem %" PRId64 " of the slice differs from the whole chunks\n", nitem);
+      rc = BLOSC2_ERROR_FAILURE;
+      break;
+    }
+  }
+  free(slice);
+  return rc;
+}
+
+
+static int test_getslice(int8_t ndim, const int64_t *shape, const int32_t *chunkshape,
+                         const int32_t *blockshape, int32_t typesize, int16_t nthreads, bool persistent) {
+  int64_t nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nitems *= shape[i];
+  }
+  int64_t size = nitems * typesize;
+  uint8_t *data = malloc(size);
+  for (int64_t i = 0; i < nitems; ++i) {
+    double value = (double) (i % 1000) / 7. + (double) (i / 1000) * 1.5;
+    if (typesize == sizeof(float)) {
+      ((float *) data)[i] = (float) value;
+    } else {
+      ((double *) data)[i] = value;
+    }
+  }
+
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  cparams.compcode = BLOSC_CODEC_ZFP_FIXED_RATE;
+  cparams.compcode_meta = 37;
+  cparams.splitmode = BLOSC_NEVER_SPLIT;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_NOFILTER;
+  cparams.nthreads = nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_storage b2_storage = {.cparams=&cparams, .dparams=&dparams, .contiguous=true};
+  if (persistent) {
+    b2_storage.urlpath = URLPATH;
+  }
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shape, chunkshape, blockshape, NULL, 0,
+                                        NULL, 0);
+  b2nd_array_t *arr;
+  BLOSC_ERROR(b2nd_from_cbuffer(ctx, &arr, data, size));
+  if (persistent) {
+    // Read the chunks lazily
+    BLOSC_ERROR(b2nd_free(arr));
+    BLOSC_ERROR(b2nd_open(URLPATH, &arr));
+  }
+
+  // The whole chunks get every cell decoded
+  int32_t chunksize = (int32_t) (arr->extchunknitems * typesize);
+  uint8_t *chunks = malloc(arr->sc->nchunks * chunksize);
+  for (int64_t nchunk = 0; nchunk < arr->sc->nchunks; ++nchunk) {
+    if (blosc2_schunk_decompress_chunk(arr->sc, nchunk, chunks + nchunk * chunksize, chunksize) != chunksize) {
+      printf("\nError decompressing chunk %" PRId64 "\n", nchunk);
+      return BLOSC2_ERROR_FAILURE;
+    }
+  }
+
+  // Slices that are inside a block, that cut the cells and that span several blocks and chunks
+  int64_t starts[4][B2ND_MAX_DIM];
+  int64_t stops[4][B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    starts[0][i] = 1;
+    stops[0][i] = 3;
+    starts[1][i] = 0;
+    stops[1][i] = 1;
+    starts[2][i] = 5;
+    stops[2][i] = shape[i] - 2;
+    starts[3][i] = 0;
+    stops[3][i] = shape[i];
+  }
+  starts[1][ndim - 1] = blockshape[ndim - 1] - 1;
+  stops[1][ndim - 1] = blockshape[ndim - 1] + 6;
+  int rc = BLOSC2_ERROR_SUCCESS;
+  for (int n = 0; n < 4 && rc == BLOSC2_ERROR_SUCCESS; ++n) {
+    rc = check_slice(arr, chunks, starts[n], stops[n]);
+  }
+
+  free(chunks);
+  free(data);
+  BLOSC_ERROR(b2nd_free(arr));
+  BLOSC_ERROR(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(URLPATH);
+  return rc;
+}
+
+
+int main(void) {
+  blosc2_init();   // this is mandatory for initializing the plugin mechanism
+
+  int64_t shape2[] = {40, 60};
+  int32_t chunkshape2[] = {20, 30};
+  int32_t blockshape2[] = {16, 14};
+  int64_t shape3[] = {40, 60, 20};
+  int32_t chunkshape3[] = {20, 30, 16};
+  int32_t blockshape3[] = {11, 14, 7};
+  int64_t shape1[] = {1000};
+  int32_t chunkshape1[] = {300};
+  int32_t blockshape1[] = {70};
+
+  int result = BLOSC2_ERROR_SUCCESS;
+  printf("float 2-dim: ");
+  result |= test_getslice(2, shape2, chunkshape2, blockshape2, sizeof(float), 1, false);
+  printf("%s\ndouble 2-dim, threads: ", result < 0 ? "failed" : "ok");
+  result |= test_getslice(2, shape2, chunkshape2, blockshape2, sizeof(double), 4, false);
+  printf("%s\nfloat 3-dim, lazy chunks: ", result < 0 ? "failed" : "ok");
+  result |= test_getslice(3, shape3, chunkshape3, blockshape3, sizeof(float), 1, true);
+  printf("%s\ndouble 3-dim, threads: ", result < 0 ? "failed" : "ok");
+  result |= test_getslice(3, shape3, chunkshape3, blockshape3, sizeof(double), 4, false);
+  printf("%s\ndouble 1-dim: ", result < 0 ? "failed" : "ok");
+  result |= test_getslice(1, shape1, chunkshape1, blockshape1, sizeof(double), 1, false);
+  printf("%s\n", result < 0 ? "failed" : "ok");
+
+  blosc2_destroy();
+  return result < 0 ? result : BLOSC2_ERROR_SUCCESS;
+}
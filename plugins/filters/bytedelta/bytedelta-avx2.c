@@ -0,0 +1,95 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "bytedelta-avx2.h"
+
+/* Make sure AVX2 is available for the compilation target and compiler. */
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+
+/* Prefix sum of the bytes within each 128-bit lane (Sklansky-style, as the SSSE3 one) */
+static inline __m256i prefix_sum_lanes(__m256i x) {
+  x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 8));
+  x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 16));
+  x = _mm256_add_epi8(x, _mm256_slli_epi64(x, 32));
+  x = _mm256_add_epi8(x, _mm256_shuffle_epi8(x, _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, 7, 7, 7, 7, 7, 7, 7, 7,
+      -1, -1, -1, -1, -1, -1, -1, -1, 7, 7, 7, 7, 7, 7, 7, 7)));
+  return x;
+}
+
+static inline __m128i prefix_sum_16(__m128i x) {
+  x = _mm_add_epi8(x, _mm_slli_epi64(x, 8));
+  x = _mm_add_epi8(x, _mm_slli_epi64(x, 16));
+  x = _mm_add_epi8(x, _mm_slli_epi64(x, 32));
+  x = _mm_add_epi8(x, _mm_shuffle_epi8(x, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 7, 7, 7, 7, 7, 7, 7, 7)));
+  return x;
+}
+
+
+uint8_t bytedelta_encode_avx2(const uint8_t* input, uint8_t* output, int32_t length) {
+  const int32_t nbytes = length - length % 16;
+  if (nbytes <= 0) {
+    return 0;
+  }
+
+  int32_t ip = 0;
+  __m256i prev = _mm256_setzero_si256();
+  for (; ip <= nbytes - 32; ip += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(input + ip));
+    // The bytes shifted by one, with the last one of the previous vector coming in
+    __m256i lanes = _mm256_permute2x128_si256(prev, v, 0x21);
+    __m256i shifted = _mm256_alignr_epi8(v, lanes, 15);
+    _mm256_storeu_si256((__m256i*)(output + ip), _mm256_sub_epi8(v, shifted));
+    prev = v;
+  }
+  __m128i last = _mm256_extracti128_si256(prev, 1);
+  if (ip < nbytes) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(input + ip));
+    _mm_storeu_si128((__m128i*)(output + ip), _mm_sub_epi8(v, _mm_alignr_epi8(v, last, 15)));
+    last = v;
+  }
+
+  return (uint8_t)_mm_extract_epi8(last, 15);
+}
+
+
+uint8_t bytedelta_decode_avx2(const uint8_t* input, uint8_t* output, int32_t length) {
+  const int32_t nbytes = length - length % 16;
+  if (nbytes <= 0) {
+    return 0;
+  }
+
+  const __m256i last_byte = _mm256_set1_epi8(15);
+  int32_t ip = 0;
+  // The last output byte, in every byte
+  __m256i carry = _mm256_setzero_si256();
+  for (; ip <= nbytes - 32; ip += 32) {
+    __m256i x = prefix_sum_lanes(_mm256_loadu_si256((const __m256i*)(input + ip)));
+    // Add the sum of the low lane to the high one
+    __m256i lane_sums = _mm256_shuffle_epi8(x, last_byte);
+    x = _mm256_add_epi8(x, _mm256_permute2x128_si256(lane_sums, lane_sums, 0x08));
+    // The sum of the vector does not depend on the carry, which keeps the loop chain short
+    __m256i sum = _mm256_shuffle_epi8(x, last_byte);
+    sum = _mm256_permute2x128_si256(sum, sum, 0x11);
+    _mm256_storeu_si256((__m256i*)(output + ip), _mm256_add_epi8(x, carry));
+    carry = _mm256_add_epi8(carry, sum);
+  }
+  if (ip < nbytes) {
+    __m128i x = prefix_sum_16(_mm_loadu_si128((const __m128i*)(input + ip)));
+    _mm_storeu_si128((__m128i*)(output + ip), _mm_add_epi8(x, _mm256_castsi256_si128(carry)));
+  }
+
+  return output[nbytes - 1];
+}
+
+#endif /* defined(__AVX2__) */
@@ -0,0 +1,34 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX2-accelerated routines for the bytedelta filter. */
+
+#ifndef BLOSC_PLUGINS_FILTERS_BYTEDELTA_BYTEDELTA_AVX2_H
+#define BLOSC_PLUGINS_FILTERS_BYTEDELTA_BYTEDELTA_AVX2_H
+
+#include "blosc2/blosc2-common.h"
+
+#include <stdint.h>
+
+/**
+  Delta of the bytes of a stream (a channel of the shuffled block), up to the
+  last multiple of 16 of `length`.  Returns the last of these input bytes
+  (or 0 when there is none), for going on with the rest of the stream.
+*/
+BLOSC_NO_EXPORT uint8_t bytedelta_encode_avx2(const uint8_t* input, uint8_t* output, int32_t length);
+
+/**
+  Prefix sum (undelta) of the bytes of a stream, up to the last multiple of
+  16 of `length`.  Returns the last of these output bytes (or 0 when there
+  is none), for going on with the rest of the stream.
+*/
+BLOSC_NO_EXPORT uint8_t bytedelta_decode_avx2(const uint8_t* input, uint8_t* output, int32_t length);
+
+#endif /* BLOSC_PLUGINS_FILTERS_BYTEDELTA_BYTEDELTA_AVX2_H */
@@ -0,0 +1,101 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "bytedelta-avx512.h"
+
+/* Make sure AVX512BW is available for the compilation target and compiler. */
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include <immintrin.h>
+
+
+/* Prefix sum of the bytes within each 128-bit lane (Sklansky-style, as the SSSE3 one) */
+static inline __m512i prefix_sum_lanes(__m512i x) {
+  const __m512i dup7 = _mm512_broadcast_i32x4(
+      _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 7, 7, 7, 7, 7, 7, 7, 7));
+  x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 8));
+  x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 16));
+  x = _mm512_add_epi8(x, _mm512_slli_epi64(x, 32));
+  x = _mm512_add_epi8(x, _mm512_shuffle_epi8(x, dup7));
+  return x;
+}
+
+static inline __m128i prefix_sum_16(__m128i x) {
+  x = _mm_add_epi8(x, _mm_slli_epi64(x, 8));
+  x = _mm_add_epi8(x, _mm_slli_epi64(x, 16));
+  x = _mm_add_epi8(x, _mm_slli_epi64(x, 32));
+  x = _mm_add_epi8(x, _mm_shuffle_epi8(x, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 7, 7, 7, 7, 7, 7, 7, 7)));
+  return x;
+}
+
+
+uint8_t bytedelta_encode_avx512(const uint8_t* input, uint8_t* output, int32_t length) {
+  const int32_t nbytes = length - length % 16;
+  if (nbytes <= 0) {
+    return 0;
+  }
+
+  int32_t ip = 0;
+  __m512i prev = _mm512_setzero_si512();
+  for (; ip <= nbytes - 64; ip += 64) {
+    __m512i v = _mm512_loadu_si512((const void*)(input + ip));
+    // The bytes shifted by one, with the last one of the previous vector coming in
+    __m512i lanes = _mm512_alignr_epi64(v, prev, 6);
+    __m512i shifted = _mm512_alignr_epi8(v, lanes, 15);
+    _mm512_storeu_si512((void*)(output + ip), _mm512_sub_epi8(v, shifted));
+    prev = v;
+  }
+  __m128i last = _mm512_extracti32x4_epi32(prev, 3);
+  for (; ip < nbytes; ip += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(input + ip));
+    _mm_storeu_si128((__m128i*)(output + ip), _mm_sub_epi8(v, _mm_alignr_epi8(v, last, 15)));
+    last = v;
+  }
+
+  return (uint8_t)_mm_extract_epi8(last, 15);
+}
+
+
+uint8_t bytedelta_decode_avx512(const uint8_t* input, uint8_t* output, int32_t length) {
+  const int32_t nbytes = length - length % 16;
+  if (nbytes <= 0) {
+    return 0;
+  }
+
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i last_byte = _mm512_set1_epi8(15);
+  int32_t ip = 0;
+  // The last output byte, in every byte
+  __m512i carry = zero;
+  for (; ip <= nbytes - 64; ip += 64) {
+    __m512i x = prefix_sum_lanes(_mm512_loadu_si512((const void*)(input + ip)));
+    // Add the sums of the previous lanes to each lane
+    __m512i lane_sums = _mm512_shuffle_epi8(x, last_byte);
+    __m512i prev_sums = _mm512_alignr_epi64(lane_sums, zero, 6);
+    prev_sums = _mm512_add_epi8(prev_sums, _mm512_alignr_epi64(prev_sums, zero, 6));
+    prev_sums = _mm512_add_epi8(prev_sums, _mm512_alignr_epi64(prev_sums, zero, 4));
+    x = _mm512_add_epi8(x, prev_sums);
+    // The sum of the vector does not depend on the carry, which keeps the loop chain short
+    __m512i sum = _mm512_shuffle_epi8(x, last_byte);
+    sum = _mm512_shuffle_i32x4(sum, sum, 0xFF);
+    _mm512_storeu_si512((void*)(output + ip), _mm512_add_epi8(x, carry));
+    carry = _mm512_add_epi8(carry, sum);
+  }
+  __m128i carry16 = _mm512_castsi512_si128(carry);
+  for (; ip < nbytes; ip += 16) {
+    __m128i x = _mm_add_epi8(prefix_sum_16(_mm_loadu_si128((const __m128i*)(input + ip))), carry16);
+    _mm_storeu_si128((__m128i*)(output + ip), x);
+    carry16 = _mm_shuffle_epi8(x, _mm512_castsi512_si128(last_byte));
+  }
+
+  return output[nbytes - 1];
+}
+
+#endif /* defined(__AVX512F__) && defined(__AVX512BW__) */
@@ -10,15 +10,25 @@
 
 // ByteDelta filter.  This is based on work by Aras Pranckevičius:
 // https://aras-p.info/blog/2023/03/01/Float-Compression-7-More-Filtering-Optimization/
-// This requires Intel SSE4.1 and ARM64 NEON, which should be widely available by now.
+// This requires Intel SSE4.1 and ARM64 NEON (or WebAssembly SIMD128), which should be widely available by now.
+// On Intel, the AVX2 and AVX512BW kernels (see bytedelta-avx2.c and bytedelta-avx512.c)
+// are used instead when the host processor supports them.
 
 #include "bytedelta.h"
 #include "../plugins/plugin_utils.h"
+#include "shuffle.h"
+#if defined(BYTEDELTA_AVX2_ENABLED)
+#include "bytedelta-avx2.h"
+#endif
+#if defined(BYTEDELTA_AVX512_ENABLED)
+#include "bytedelta-avx512.h"
+#endif
 #include "blosc2/filters-registry.h"
 #include "blosc2.h"
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #if defined __i386__ || defined _M_IX86 || defined __x86_64__ || defined _M_X64
 // SSSE3 code path for x64/x64
@@ -76,8 +86,106 @@ bytes16 simd_prefix_sum(bytes16 x)
 
 uint8_t simd_get_last(bytes16 x) { return vgetq_lane_u8(x, 15); }
 
+#elif defined(__wasm_simd128__)
+// WebAssembly SIMD128 code path (needs -msimd128, as there is no detection at run time)
+#define CPU_HAS_SIMD 1
+#include <wasm_simd128.h>
+typedef v128_t bytes16;
+bytes16 simd_zero() { return wasm_i8x16_splat(0); }
+bytes16 simd_set1(uint8_t v) { return wasm_i8x16_splat((int8_t)v); }
+bytes16 simd_load(const void* ptr) { return wasm_v128_load(ptr); }
+void simd_store(void* ptr, bytes16 x) { wasm_v128_store(ptr, x); }
+
+// The shuffles take the lanes of the concatenation of both vectors, as vextq_u8 does
+bytes16 simd_concat(bytes16 hi, bytes16 lo) {
+  return wasm_i8x16_shuffle(lo, hi, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30);
+}
+bytes16 simd_add(bytes16 a, bytes16 b) { return wasm_i8x16_add(a, b); }
+bytes16 simd_sub(bytes16 a, bytes16 b) { return wasm_i8x16_sub(a, b); }
+bytes16 simd_duplane15(bytes16 x) {
+  return wasm_i8x16_shuffle(x, x, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15);
+}
+
+bytes16 simd_prefix_sum(bytes16 x)
+{
+  // Kogge-Stone-style, as for NEON
+  bytes16 zero = wasm_i8x16_splat(0);
+  x = wasm_i8x16_add(x, wasm_i8x16_shuffle(zero, x, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30));
+  x = wasm_i8x16_add(x, wasm_i8x16_shuffle(zero, x, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29));
+  x = wasm_i8x16_add(x, wasm_i8x16_shuffle(zero, x, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27));
+  x = wasm_i8x16_add(x, wasm_i8x16_shuffle(zero, x, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23));
+  return x;
+}
+
+uint8_t simd_get_last(bytes16 x) { return wasm_u8x16_extract_lane(x, 15); }
+
 #endif
 
+#if defined(CPU_HAS_SIMD)
+// The kernels process the bytes of a stream up to the last multiple of 16 of its length, and
+// return the last byte of the stream (input for the delta, output for the undelta) that they
+// have got to.  All of them stop at the same byte, which the buggy variants below depend on.
+typedef uint8_t (*bytedelta_stream_func)(const uint8_t* input, uint8_t* output, int32_t length);
+
+// Fetch 16b from a stream, compute SIMD delta
+static uint8_t bytedelta_encode_simd(const uint8_t* input, uint8_t* output, int32_t length) {
+  bytes16 v2 = simd_zero();
+  if (length < 16) {
+    return 0;
+  }
+  for (int ip = 0; ip < length - 15; ip += 16) {
+    bytes16 v = simd_load(input + ip);
+    bytes16 delta = simd_sub(v, simd_concat(v, v2));
+    simd_store(output + ip, delta);
+    v2 = v;
+  }
+  return simd_get_last(v2);
+}
+
+// Fetch 16b from a stream, prefix-sum un-delta
+static uint8_t bytedelta_decode_simd(const uint8_t* input, uint8_t* output, int32_t length) {
+  bytes16 v2 = simd_zero();
+  if (length < 16) {
+    return 0;
+  }
+  for (int ip = 0; ip < length - 15; ip += 16) {
+    bytes16 v = simd_load(input + ip);
+    v2 = simd_add(simd_prefix_sum(v), simd_duplane15(v2));
+    simd_store(output + ip, v2);
+  }
+  return simd_get_last(v2);
+}
+
+/* Flag indicating whether the kernels have been chosen for the host processor */
+static int32_t implementation_initialized;
+static bytedelta_stream_func bytedelta_encode_stream;
+static bytedelta_stream_func bytedelta_decode_stream;
+
+/* Choose the widest kernels supported by the host processor, if not done yet.  As for the
+   shuffle, a concurrent initialization would just choose the same ones on every thread. */
+static void init_bytedelta_implementation(void) {
+  if (implementation_initialized) {
+    return;
+  }
+  bytedelta_encode_stream = bytedelta_encode_simd;
+  bytedelta_decode_stream = bytedelta_decode_simd;
+#if defined(BYTEDELTA_AVX2_ENABLED)
+  blosc_cpu_features cpu_features = blosc_get_cpu_features();
+  if (cpu_features & BLOSC_HAVE_AVX2) {
+    bytedelta_encode_stream = bytedelta_encode_avx2;
+    bytedelta_decode_stream = bytedelta_decode_avx2;
+  }
+#if defined(BYTEDELTA_AVX512_ENABLED)
+  if (cpu_features & BLOSC_HAVE_AVX512) {
+    bytedelta_encode_stream = bytedelta_encode_avx512;
+    bytedelta_decode_stream = bytedelta_decode_avx512;
+  }
+#endif  // BYTEDELTA_AVX512_ENABLED
+#endif  // BYTEDELTA_AVX2_ENABLED
+  implementation_initialized = 1;
+}
+#endif // #if defined(CPU_HAS_SIMD)
+
 
 // Fetch 16b from N streams, compute SIMD delta
 int bytedelta_forward(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta,
@@ -95,23 +203,18 @@ int bytedelta_forward(const uint8_t *input, uint8_t *output, int32_t length, uin
   }
 
   const int stream_len = length / typesize;
+#if defined(CPU_HAS_SIMD)
+  init_bytedelta_implementation();
+#endif
   for (int ich = 0; ich < typesize; ++ich) {
     int ip = 0;
     uint8_t _v2 = 0;
     // SIMD delta within each channel, store
 #if defined(CPU_HAS_SIMD)
-    bytes16 v2 = {0};
-    for (; ip < stream_len - 15; ip += 16) {
-      bytes16 v = simd_load(input);
-      input += 16;
-      bytes16 delta = simd_sub(v, simd_concat(v, v2));
-      simd_store(output, delta);
-      output += 16;
-      v2 = v;
-    }
-    if (stream_len > 15) {
-      _v2 = simd_get_last(v2);
-    }
+    _v2 = bytedelta_encode_stream(input, output, stream_len);
+    ip = stream_len - stream_len % 16;
+    input += ip;
+    output += ip;
 #endif // #if defined(CPU_HAS_SIMD)
     // scalar leftover
     for (; ip < stream_len ; ip++) {
@@ -122,6 +225,8 @@ int bytedelta_forward(const uint8_t *input, uint8_t *output, int32_t length, uin
       _v2 = v;
     }
   }
+  // The bytes that do not make a whole item go as they are
+  memcpy(output, input, length % typesize);
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -142,23 +247,18 @@ int bytedelta_backward(const uint8_t *input, uint8_t *output, int32_t length, ui
   }
 
   const int stream_len = length / typesize;
+#if defined(CPU_HAS_SIMD)
+  init_bytedelta_implementation();
+#endif
   for (int ich = 0; ich < typesize; ++ich) {
     int ip = 0;
     uint8_t _v2 = 0;
     // SIMD fetch 16 bytes from each channel, prefix-sum un-delta
 #if defined(CPU_HAS_SIMD)
-    bytes16 v2 = {0};
-    for (; ip < stream_len - 15; ip += 16) {
-      bytes16 v = simd_load(input);
-      input += 16;
-      // un-delta via prefix sum
-      v2 = simd_add(simd_prefix_sum(v), simd_duplane15(v2));
-      simd_store(output, v2);
-      output += 16;
-    }
-    if (stream_len > 15) {
-      _v2 = simd_get_last(v2);
-    }
+    _v2 = bytedelta_decode_stream(input, output, stream_len);
+    ip = stream_len - stream_len % 16;
+    input += ip;
+    output += ip;
 #endif // #if defined(CPU_HAS_SIMD)
     // scalar leftover
     for (; ip < stream_len; ip++) {
@@ -169,6 +269,8 @@ int bytedelta_backward(const uint8_t *input, uint8_t *output, int32_t length, ui
       _v2 = v;
     }
   }
+  // The bytes that do not make a whole item go as they are
+  memcpy(output, input, length % typesize);
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -191,19 +293,17 @@ int bytedelta_forward_buggy(const uint8_t *input, uint8_t *output, int32_t lengt
   }
 
   const int stream_len = length / typesize;
+#if defined(CPU_HAS_SIMD)
+  init_bytedelta_implementation();
+#endif
   for (int ich = 0; ich < typesize; ++ich) {
     int ip = 0;
-    // SIMD delta within each channel, store
+    // SIMD delta within each channel, store (the scalar leftover wrongly starts from 0 again)
 #if defined(CPU_HAS_SIMD)
-    bytes16 v2 = {0};
-    for (; ip < stream_len - 15; ip += 16) {
-      bytes16 v = simd_load(input);
-      input += 16;
-      bytes16 delta = simd_sub(v, simd_concat(v, v2));
-      simd_store(output, delta);
-      output += 16;
-      v2 = v;
-    }
+    bytedelta_encode_stream(input, output, stream_len);
+    ip = stream_len - stream_len % 16;
+    input += ip;
+    output += ip;
 #endif // #if defined(CPU_HAS_SIMD)
     // scalar leftover
     uint8_t _v2 = 0;
@@ -215,6 +315,8 @@ int bytedelta_forward_buggy(const uint8_t *input, uint8_t *output, int32_t lengt
       _v2 = v;
     }
   }
+  // The bytes that do not make a whole item go as they are
+  memcpy(output, input, length % typesize);
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -235,19 +337,18 @@ int bytedelta_backward_buggy(const uint8_t *input, uint8_t *output, int32_t leng
   }
 
   const int stream_len = length / typesize;
+#if defined(CPU_HAS_SIMD)
+  init_bytedelta_implementation();
+#endif
   for (int ich = 0; ich < typesize; ++ich) {
     int ip = 0;
-    // SIMD fetch 16 bytes from each channel, prefix-sum un-delta
+    // SIMD fetch 16 bytes from each channel, prefix-sum un-delta (the scalar leftover
+    // wrongly starts from 0 again)
 #if defined(CPU_HAS_SIMD)
-    bytes16 v2 = {0};
-    for (; ip < stream_len - 15; ip += 16) {
-      bytes16 v = simd_load(input);
-      input += 16;
-      // un-delta via prefix sum
-      v2 = simd_add(simd_prefix_sum(v), simd_duplane15(v2));
-      simd_store(output, v2);
-      output += 16;
-    }
+    bytedelta_decode_stream(input, output, stream_len);
+    ip = stream_len - stream_len % 16;
+    input += ip;
+    output += ip;
 #endif // #if defined(CPU_HAS_SIMD)
     // scalar leftover
     uint8_t _v2 = 0;
@@ -259,6 +360,8 @@ int bytedelta_backward_buggy(const uint8_t *input, uint8_t *output, int32_t leng
       _v2 = v;
     }
   }
+  // The bytes that do not make a whole item go as they are
+  memcpy(output, input, length % typesize);
 
   return BLOSC2_ERROR_SUCCESS;
 }
@@ -43,11 +43,13 @@
 
 #include "blosc2/filters-registry.h"
 #include "b2nd.h"
+#include "bytedelta.h"
 
 #include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
 /* The original implementation of the bytedelta filter had incorrect
  * roundtrip behavior between SIMD and non-SIMD binaries. This filter provides
@@ -226,6 +228,71 @@ static int test_bytedelta(blosc2_schunk *schunk) {
 }
 
 
+/* The SIMD kernels (which are chosen at run time) against the scalar code, for streams
+ * that end at every offset of the vectors */
+static int stream_lengths(void) {
+  const int32_t max_length = 3 * 300 + 2;
+  uint8_t *src = malloc(max_length);
+  uint8_t *delta = malloc(max_length);
+  uint8_t *expected = malloc(max_length);
+  uint8_t *dest = malloc(max_length);
+  for (int i = 0; i < max_length; i++) {
+    src[i] = (uint8_t) (i * i / 7 + rand() % 5);
+  }
+
+  int rc = 0;
+  for (uint8_t typesize = 1; typesize <= 3 && rc == 0; typesize += 2) {
+    for (int32_t stream_len = 0; stream_len <= 300 && rc == 0; stream_len++) {
+      int32_t length = stream_len * typesize;
+      // Some bytes that do not make a whole item, which go as they are
+      int32_t tail = stream_len % typesize;
+      bytedelta_forward(src, delta, length + tail, typesize, NULL, 0);
+      correct_bytedelta_forward(src, expected, length, typesize, NULL, 0);
+      memcpy(expected + length, src + length, tail);
+      if (memcmp(delta, expected, length + tail) != 0) {
+        printf("Wrong delta for streams of %d bytes\n", stream_len);
+        rc = -1;
+      }
+      bytedelta_backward(delta, dest, length + tail, typesize, NULL, 0);
+      if (memcmp(dest, src, length + tail) != 0) {
+        printf("Wrong undelta for streams of %d bytes\n", stream_len);
+        rc = -1;
+      }
+
+      // The buggy variants start the scalar leftover from 0, so they have to stop at the same byte
+      bytedelta_forward_buggy(src, delta, length + tail, typesize, NULL, 0);
+#if defined __i386__ || defined _M_IX86 || defined __x86_64__ || defined _M_X64 || defined __aarch64__ || defined _M_ARM64
+      int32_t simd_len = stream_len - stream_len % 16;
+#else
+      int32_t simd_len = 0;
+#endif
+      for (int ich = 0; ich < typesize; ich++) {
+        const uint8_t *stream = src + ich * stream_len;
+        for (int ip = 0; ip < stream_len; ip++) {
+          uint8_t prev = (ip == 0 || ip == simd_len) ? 0 : stream[ip - 1];
+          expected[ich * stream_len + ip] = stream[ip] - prev;
+        }
+      }
+      if (memcmp(delta, expected, length + tail) != 0) {
+        printf("Wrong buggy delta for streams of %d bytes\n", stream_len);
+        rc = -1;
+      }
+      bytedelta_backward_buggy(delta, dest, length + tail, typesize, NULL, 0);
+      if (memcmp(dest, src, length + tail) != 0) {
+        printf("Wrong buggy undelta for streams of %d bytes\n", stream_len);
+        rc = -1;
+      }
+    }
+  }
+
+  free(src);
+  free(delta);
+  free(expected);
+  free(dest);
+  return rc;
+}
+
+
 int rand_() {
   int8_t ndim = 3;
   int typesize = 4;
@@ -342,6 +409,11 @@ int main(void) {
   int result;
   blosc2_init();
 
+  result = stream_lengths();
+  printf("stream lengths: %s \n \n", result < 0 ? "failed" : "ok");
+  if (result < 0)
+    return result;
+
   result = rand_();
   printf("rand: saved %d bytes \n \n", result);
   if (result < 0)
@@ -0,0 +1,64 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "dict-avx2.h"
+
+/* Make sure AVX2 is available for the compilation target and compiler. */
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+
+/* The next 8 indices, as 32-bit integers */
+static inline __m256i load_indices(const uint8_t* indices, int32_t i, int32_t width) {
+  if (width == 1) {
+    return _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(indices + i)));
+  }
+  return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(indices + 2 * i)));
+}
+
+
+int32_t dict_decode_avx2(const uint8_t* dict, const uint8_t* indices, uint8_t* output,
+                         int32_t nelems, int32_t typesize, int32_t width) {
+  int32_t i = 0;
+  switch (typesize) {
+    case 2: {
+      // The 4 bytes at every value, of which the low 16 bits are gathered in the low 8 bytes of both lanes
+      const __m256i low = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+                                           0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+      for (; i + 8 <= nelems; i += 8) {
+        __m256i values = _mm256_i32gather_epi32((const int*)dict, load_indices(indices, i, width), 2);
+        values = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(values, low), 0x08);
+        _mm_storeu_si128((__m128i*)(output + i * 2), _mm256_castsi256_si128(values));
+      }
+      break;
+    }
+    case 4:
+      for (; i + 8 <= nelems; i += 8) {
+        __m256i values = _mm256_i32gather_epi32((const int*)dict, load_indices(indices, i, width), 4);
+        _mm256_storeu_si256((__m256i*)(output + i * 4), values);
+      }
+      break;
+    case 8:
+      for (; i + 8 <= nelems; i += 8) {
+        __m256i idx = load_indices(indices, i, width);
+        __m256i lo = _mm256_i32gather_epi64((const long long*)dict, _mm256_castsi256_si128(idx), 8);
+        __m256i hi = _mm256_i32gather_epi64((const long long*)dict, _mm256_extracti128_si256(idx, 1), 8);
+        _mm256_storeu_si256((__m256i*)(output + i * 8), lo);
+        _mm256_storeu_si256((__m256i*)(output + i * 8 + 32), hi);
+      }
+      break;
+    default:
+      break;
+  }
+  return i;
+}
+
+#endif /* defined(__AVX2__) */
@@ -0,0 +1,29 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX2-accelerated routines for the dict filter. */
+
+#ifndef BLOSC_PLUGINS_FILTERS_DICT_DICT_AVX2_H
+#define BLOSC_PLUGINS_FILTERS_DICT_DICT_AVX2_H
+
+#include "blosc2/blosc2-common.h"
+
+#include <stdint.h>
+
+/**
+  Gather the values of the dictionary (of `typesize` 2, 4 or 8) at the
+  indices of `width` 1 or 2, up to the last multiple of 8 of `nelems`.  The
+  dictionary must be followed by 2 readable bytes when `typesize` is 2.
+  Returns the number of elements decoded.
+*/
+BLOSC_NO_EXPORT int32_t dict_decode_avx2(const uint8_t* dict, const uint8_t* indices, uint8_t* output,
+                                         int32_t nelems, int32_t typesize, int32_t width);
+
+#endif /* BLOSC_PLUGINS_FILTERS_DICT_DICT_AVX2_H */
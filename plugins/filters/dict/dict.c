@@ -0,0 +1,272 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+// Dict filter.  A dictionary encoding for columns of integers (or other values of 2, 4 or 8
+// bytes) with few distinct values per block: the block is replaced by a header, the distinct
+// values in the order they appear, and the index of every element in them, of 1 byte (up to
+// 256 values) or 2 bytes (up to 65536).  The rest of the block (filters cannot shrink it) is
+// left as zeros, which cost nothing to the codec.
+//
+// The blocks that do not fit in their length encoded this way are kept as they are.  As there
+// is no room for telling them apart, the encoded blocks start with a magic and a hash of their
+// header (and length), and the encoder gives up on the (very unlikely) blocks that would be
+// taken for encoded ones.
+//
+// The encoder looks up every value in an open addressing hash table, after comparing it with
+// the previous one (runs of the same category are common).  The decoder gathers the values
+// with AVX2 when the host processor supports it (see dict-avx2.c).
+
+#include "dict.h"
+#include "../plugins/plugin_utils.h"
+#include "checksum.h"
+#include "shuffle.h"
+#if defined(DICT_AVX2_ENABLED)
+#include "dict-avx2.h"
+#endif
+#include "blosc2/filters-registry.h"
+#include "blosc2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DICT_MAGIC 0x54434944u  // "DICT" in little endian
+#define DICT_HEADER_SIZE 16
+#define DICT_MAX_NDICT (1 << 16)
+
+
+static inline uint32_t load_u32(const uint8_t* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline void store_u32(uint8_t* p, uint32_t u) {
+  p[0] = (uint8_t) u;
+  p[1] = (uint8_t) (u >> 8);
+  p[2] = (uint8_t) (u >> 16);
+  p[3] = (uint8_t) (u >> 24);
+}
+
+
+/* The hash of the first 12 bytes of the header and the length of the block */
+static uint32_t header_check(const uint8_t* header, int32_t length) {
+  uint8_t buffer[DICT_HEADER_SIZE];
+  memcpy(buffer, header, 12);
+  store_u32(buffer + 12, (uint32_t) length);
+  return (uint32_t) checksum_xxh3(buffer, DICT_HEADER_SIZE);
+}
+
+/* Whether the block of `length` bytes is dictionary encoded, and if so, its parameters */
+static bool parse_header(const uint8_t* block, int32_t length, int32_t* typesize, int32_t* width,
+                         int32_t* ndict) {
+  if (length < DICT_HEADER_SIZE || load_u32(block) != DICT_MAGIC ||
+      load_u32(block + 12) != header_check(block, length)) {
+    return false;
+  }
+  *typesize = block[4];
+  *width = block[5];
+  *ndict = (int32_t) load_u32(block + 8);
+  if ((*typesize != 2 && *typesize != 4 && *typesize != 8) || (*width != 1 && *width != 2) ||
+      *ndict < 1 || *ndict > (*width == 1 ? 256 : DICT_MAX_NDICT)) {
+    return false;
+  }
+  int32_t nelems = length / *typesize;
+  int64_t size = DICT_HEADER_SIZE + (int64_t) *ndict * *typesize + (int64_t) nelems * *width + length % *typesize;
+  return size <= length;
+}
+
+
+static inline uint64_t load_key(const uint8_t* p, int32_t typesize) {
+  uint64_t key = 0;
+  memcpy(&key, p, typesize);
+  return key;
+}
+
+/* Encode the block if its distinct values fit, returning whether they did */
+static bool encode(const uint8_t* input, uint8_t* output, int32_t length, int32_t typesize) {
+  int32_t nelems = length / typesize;
+  int32_t tail = length % typesize;
+  if (nelems == 0) {
+    return false;
+  }
+  // The largest dictionaries that fit with indices of 1 and 2 bytes
+  int64_t room = (int64_t) length - DICT_HEADER_SIZE - tail;
+  int64_t max1 = (room - nelems) / typesize;
+  int64_t max2 = (room - 2 * (int64_t) nelems) / typesize;
+  max1 = max1 > 256 ? 256 : max1;
+  max2 = max2 > DICT_MAX_NDICT ? DICT_MAX_NDICT : max2;
+  int32_t limit = (int32_t) (max1 > max2 ? max1 : max2);
+  if (limit < 1) {
+    return false;
+  }
+
+  // The table keeps the dictionary index + 1 of every value (0 for the empty slots)
+  int bits = 4;
+  while ((1 << bits) < 2 * limit) {
+    bits++;
+  }
+  uint32_t mask = (1u << bits) - 1;
+  uint32_t* table = calloc((size_t) 1 << bits, sizeof(uint32_t));
+  uint16_t* indices = malloc(nelems * sizeof(uint16_t));
+  uint8_t* dict = output + DICT_HEADER_SIZE;
+  int32_t ndict = 0;
+  bool fits = table != NULL && indices != NULL;
+  uint64_t last_key = 0;
+  uint16_t last_index = 0;
+  for (int32_t i = 0; fits && i < nelems; i++) {
+    uint64_t key = load_key(input + i * typesize, typesize);
+    if (i > 0 && key == last_key) {
+      indices[i] = last_index;
+      continue;
+    }
+    uint32_t slot = (uint32_t) ((key * 0x9E3779B97F4A7C15ull) >> (64 - bits));
+    for (;;) {
+      uint32_t entry = table[slot];
+      if (entry == 0) {
+        if (ndict == limit) {
+          fits = false;
+          break;
+        }
+        memcpy(dict + ndict * typesize, input + i * typesize, typesize);
+        table[slot] = (uint32_t) ++ndict;
+        last_index = (uint16_t) (ndict - 1);
+        break;
+      }
+      if (load_key(dict + (entry - 1) * typesize, typesize) == key) {
+        last_index = (uint16_t) (entry - 1);
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+    if (!fits) {
+      break;
+    }
+    indices[i] = last_index;
+    last_key = key;
+  }
+
+  if (fits) {
+    int32_t width = ndict <= max1 ? 1 : 2;
+    uint8_t* op = dict + ndict * typesize;
+    if (width == 1) {
+      for (int32_t i = 0; i < nelems; i++) {
+        op[i] = (uint8_t) indices[i];
+      }
+    }
+    else {
+      for (int32_t i = 0; i < nelems; i++) {
+        op[2 * i] = (uint8_t) indices[i];
+        op[2 * i + 1] = (uint8_t) (indices[i] >> 8);
+      }
+    }
+    op += nelems * width;
+    memcpy(op, input + nelems * typesize, tail);
+    op += tail;
+    memset(op, 0, output + length - op);
+
+    store_u32(output, DICT_MAGIC);
+    output[4] = (uint8_t) typesize;
+    output[5] = (uint8_t) width;
+    output[6] = output[7] = 0;
+    store_u32(output + 8, (uint32_t) ndict);
+    store_u32(output + 12, header_check(output, length));
+  }
+  free(table);
+  free(indices);
+  return fits;
+}
+
+
+int dict_forward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                 blosc2_cparams* cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(id);
+
+  int32_t typesize = cparams->typesize;
+  if ((typesize == 2 || typesize == 4 || typesize == 8) && encode(input, output, length, typesize)) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // Too many distinct values (or an unsupported typesize), so the block is kept as it is
+  memcpy(output, input, length);
+  int32_t ts, width, ndict;
+  if (parse_header(output, length, &ts, &width, &ndict)) {
+    BLOSC_TRACE_ERROR("The block cannot be told apart from a dictionary encoded one");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+/* Flag indicating whether the kernels have been chosen for the host processor */
+static int32_t implementation_initialized;
+#if defined(DICT_AVX2_ENABLED)
+static bool dict_avx2;
+#endif
+
+/* Choose the gather kernel if the host processor supports it, if not done yet.  As for the
+   shuffle, a concurrent initialization would just choose the same one on every thread. */
+static void init_dict_implementation(void) {
+  if (implementation_initialized) {
+    return;
+  }
+#if defined(DICT_AVX2_ENABLED)
+  dict_avx2 = (blosc_get_cpu_features() & BLOSC_HAVE_AVX2) != 0;
+#endif
+  implementation_initialized = 1;
+}
+
+
+int dict_backward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                  blosc2_dparams* dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(id);
+
+  int32_t typesize, width, ndict;
+  if (!parse_header(input, length, &typesize, &width, &ndict)) {
+    memcpy(output, input, length);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int32_t nelems = length / typesize;
+  const uint8_t* dict = input + DICT_HEADER_SIZE;
+  const uint8_t* indices = dict + ndict * typesize;
+  // Out of range indices would read beyond the dictionary
+  int32_t max_index = 0;
+  if (width == 1) {
+    for (int32_t i = 0; i < nelems; i++) {
+      max_index = indices[i] > max_index ? indices[i] : max_index;
+    }
+  }
+  else {
+    for (int32_t i = 0; i < nelems; i++) {
+      int32_t index = indices[2 * i] | indices[2 * i + 1] << 8;
+      max_index = index > max_index ? index : max_index;
+    }
+  }
+  if (max_index >= ndict) {
+    BLOSC_TRACE_ERROR("The dictionary index %d is out of range", max_index);
+    return BLOSC2_ERROR_DATA;
+  }
+
+  init_dict_implementation();
+  int32_t i = 0;
+#if defined(DICT_AVX2_ENABLED)
+  if (dict_avx2) {
+    i = dict_decode_avx2(dict, indices, output, nelems, typesize, width);
+  }
+#endif
+  for (; i < nelems; i++) {
+    int32_t index = width == 1 ? indices[i] : indices[2 * i] | indices[2 * i + 1] << 8;
+    memcpy(output + i * typesize, dict + index * typesize, typesize);
+  }
+  memcpy(output + nelems * typesize, indices + nelems * width, length % typesize);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
@@ -0,0 +1,211 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test program for the dict filter.  Blocks with few and many distinct
+    values (of 1 and 2 byte indices, or kept as they are) are encoded and
+    decoded for every typesize, and a column of 64-bit identifiers is
+    compressed with the filter and with the shuffle.
+
+    To run:
+
+    $ ./test_dict
+    dict: 8000000 -> 1084522 (7.4x), shuffle: 8000000 -> 6000870 (1.3x)
+    Successful roundtrip!
+
+**********************************************************************/
+
+#include "blosc2/filters-registry.h"
+#include "dict.h"
+#include "blosc2.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NELEMS (1000 * 1000)
+
+static uint32_t seed = 1;
+
+static uint32_t next_random(void) {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+
+/* Encode and decode a block of `nelems` values among `ncategories`, with a few bytes more, and
+   check whether it is `encoded` (if not negative) */
+static int roundtrip(int32_t typesize, int32_t nelems, int32_t ncategories, int encoded) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  int32_t length = nelems * typesize + typesize / 2;
+  uint8_t* input = malloc(length);
+  uint8_t* encoded_block = malloc(length);
+  uint8_t* output = malloc(length);
+  for (int32_t i = 0; i < nelems; i++) {
+    uint64_t value = (uint64_t) (next_random() % ncategories) * 0x9E3779B97F4A7C15ull;
+    memcpy(input + i * typesize, &value, typesize);
+  }
+  for (int32_t i = nelems * typesize; i < length; i++) {
+    input[i] = (uint8_t) i;
+  }
+  if (dict_forward(input, encoded_block, length, 0, &cparams, BLOSC_FILTER_DICT) < 0 ||
+      dict_backward(encoded_block, output, length, 0, &dparams, BLOSC_FILTER_DICT) < 0) {
+    printf("Cannot encode the block\n");
+    return -1;
+  }
+  if (memcmp(input, output, length) != 0) {
+    printf("The block of %d values of %d bytes is not decoded right\n", nelems, typesize);
+    return -1;
+  }
+  if (encoded >= 0 && (length >= 4 && memcmp(encoded_block, "DICT", 4) == 0) != encoded) {
+    printf("The block of %d values among %d should%s be encoded\n", nelems, ncategories, encoded ? "" : " not");
+    return -1;
+  }
+  free(input);
+  free(encoded_block);
+  free(output);
+  return 0;
+}
+
+
+static int test_blocks(void) {
+  int32_t typesizes[] = {2, 4, 8};
+  for (int n = 0; n < 3; n++) {
+    int32_t typesize = typesizes[n];
+    for (int32_t nelems = 0; nelems < 40; nelems++) {
+      // The header and a dictionary of one value only fit in blocks large enough
+      bool encoded = nelems > 0 && 16 + typesize + nelems <= nelems * typesize;
+      if (roundtrip(typesize, nelems, 1, encoded) < 0 || roundtrip(typesize, nelems, 3, -1) < 0) {
+        return -1;
+      }
+    }
+    if (roundtrip(typesize, 10000, 256, 1) < 0 ||
+        roundtrip(typesize, 10000, 257, typesize > 2) < 0 ||
+        roundtrip(typesize, 10000, 3000, typesize > 2) < 0 ||
+        roundtrip(typesize, 10000, 1 << 24, 0) < 0) {
+      return -1;
+    }
+  }
+  // Other typesizes are kept as they are
+  return roundtrip(3, 1000, 2, 0);
+}
+
+
+/* The blocks kept as they are cannot look like encoded ones */
+static int test_ambiguous(void) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 4;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  int32_t nelems = 1000;
+  uint32_t* values = malloc(nelems * 4);
+  uint8_t* encoded_block = malloc(nelems * 4);
+  for (int32_t i = 0; i < nelems; i++) {
+    values[i] = i % 10;
+  }
+  if (dict_forward((uint8_t*) values, encoded_block, nelems * 4, 0, &cparams, BLOSC_FILTER_DICT) < 0) {
+    printf("Cannot encode the block\n");
+    return -1;
+  }
+  // Distinct values after an encoded header, which do not fit in a dictionary
+  memcpy(values, encoded_block, 16);
+  for (int32_t i = 4; i < nelems; i++) {
+    values[i] = i * 2654435761u;
+  }
+  if (dict_forward((uint8_t*) values, encoded_block, nelems * 4, 0, &cparams, BLOSC_FILTER_DICT) >= 0) {
+    printf("An ambiguous block is kept\n");
+    return -1;
+  }
+
+  // Indices out of the dictionary are detected
+  for (int32_t i = 0; i < nelems; i++) {
+    values[i] = i % 10;
+  }
+  dict_forward((uint8_t*) values, encoded_block, nelems * 4, 0, &cparams, BLOSC_FILTER_DICT);
+  encoded_block[16 + 10 * 4 + 500] = 10;
+  if (dict_backward(encoded_block, (uint8_t*) values, nelems * 4, 0, &dparams, BLOSC_FILTER_DICT) >= 0) {
+    printf("An index out of the dictionary is decoded\n");
+    return -1;
+  }
+  free(values);
+  free(encoded_block);
+  return 0;
+}
+
+
+static int64_t compress(int64_t* values, int64_t* dest, uint8_t filter) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 8;
+  cparams.compcode = BLOSC_LZ4;
+  cparams.nthreads = 2;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter;
+  blosc2_storage storage = {.cparams = &cparams};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  if (blosc2_schunk_append_buffer(schunk, values, NELEMS * 8) < 0 ||
+      blosc2_schunk_decompress_chunk(schunk, 0, dest, NELEMS * 8) != NELEMS * 8) {
+    printf("Cannot compress the values\n");
+    return -1;
+  }
+  int64_t cbytes = schunk->cbytes;
+  blosc2_schunk_free(schunk);
+  return cbytes;
+}
+
+
+/* A column of identifiers of 100 categories, which the shuffle cannot reduce to a stream */
+static int test_compression(void) {
+  int64_t* values = malloc(NELEMS * 8);
+  int64_t* dest = malloc(NELEMS * 8);
+  int64_t ids[100];
+  for (int i = 0; i < 100; i++) {
+    ids[i] = (int64_t) ((uint64_t) next_random() << 40 | next_random());
+  }
+  for (int32_t i = 0; i < NELEMS; i++) {
+    values[i] = ids[next_random() % 100];
+  }
+  int64_t cbytes = compress(values, dest, BLOSC_FILTER_DICT);
+  if (cbytes < 0 || memcmp(values, dest, NELEMS * 8) != 0) {
+    printf("The identifiers are not decoded right\n");
+    return -1;
+  }
+  int64_t shuffle_cbytes = compress(values, dest, BLOSC_SHUFFLE);
+  if (shuffle_cbytes < 0) {
+    return -1;
+  }
+  printf("dict: %d -> %" PRId64 " (%.1fx), shuffle: %d -> %" PRId64 " (%.1fx)\n",
+         NELEMS * 8, cbytes, (double) NELEMS * 8 / (double) cbytes,
+         NELEMS * 8, shuffle_cbytes, (double) NELEMS * 8 / (double) shuffle_cbytes);
+  if (2 * cbytes > shuffle_cbytes) {
+    printf("The dict filter should compress the identifiers much better than the shuffle\n");
+    return -1;
+  }
+  free(values);
+  free(dest);
+  return 0;
+}
+
+
+int main(void) {
+  blosc2_init();
+  int rc = test_blocks();
+  if (rc == 0) {
+    rc = test_ambiguous();
+  }
+  if (rc == 0) {
+    rc = test_compression();
+  }
+  if (rc == 0) {
+    printf("Successful roundtrip!\n");
+  }
+  blosc2_destroy();
+  return rc;
+}
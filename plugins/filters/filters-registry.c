@@ -8,6 +8,12 @@
 #include "ndmean/ndmean.h"
 #include "ndcell/ndcell.h"
 #include "bytedelta/bytedelta.h"
+#include "floatxor/floatxor.h"
+#include "quantize/quantize.h"
+#include "half/half.h"
+#include "dict/dict.h"
+#include "rle/rle.h"
+#include "shuffle_stride/shuffle_stride.h"
 #include "blosc-private.h"
 #include "blosc2.h"
 
@@ -46,4 +52,52 @@ void register_filters(void) {
   bytedelta.forward = &bytedelta_forward;
   bytedelta.backward = &bytedelta_backward;
   register_filter_private(&bytedelta);
+
+  blosc2_filter floatxor;
+  floatxor.id = BLOSC_FILTER_FLOATXOR;
+  floatxor.name = "floatxor";
+  floatxor.version = 1;
+  floatxor.forward = &floatxor_forward;
+  floatxor.backward = &floatxor_backward;
+  register_filter_private(&floatxor);
+
+  blosc2_filter quantize;
+  quantize.id = BLOSC_FILTER_QUANTIZE;
+  quantize.name = "quantize";
+  quantize.version = 1;
+  quantize.forward = &quantize_forward;
+  quantize.backward = &quantize_backward;
+  register_filter_private(&quantize);
+
+  blosc2_filter half;
+  half.id = BLOSC_FILTER_HALF;
+  half.name = "half";
+  half.version = 1;
+  half.forward = &half_forward;
+  half.backward = &half_backward;
+  register_filter_private(&half);
+
+  blosc2_filter dict;
+  dict.id = BLOSC_FILTER_DICT;
+  dict.name = "dict";
+  dict.version = 1;
+  dict.forward = &dict_forward;
+  dict.backward = &dict_backward;
+  register_filter_private(&dict);
+
+  blosc2_filter rle;
+  rle.id = BLOSC_FILTER_RLE;
+  rle.name = "rle";
+  rle.version = 1;
+  rle.forward = &rle_forward;
+  rle.backward = &rle_backward;
+  register_filter_private(&rle);
+
+  blosc2_filter shuffle_stride;
+  shuffle_stride.id = BLOSC_FILTER_SHUFFLE_STRIDE;
+  shuffle_stride.name = "shuffle_stride";
+  shuffle_stride.version = 1;
+  shuffle_stride.forward = &shuffle_stride_forward;
+  shuffle_stride.backward = &shuffle_stride_backward;
+  register_filter_private(&shuffle_stride);
 }
@@ -0,0 +1,198 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+// FloatXOR filter.  Every element is XORed with the previous one in the block, as in the
+// Gorilla and Chimp encodings of time series, so that the sign, the exponent and the upper
+// bits of the mantissa of slowly varying floats become zeros.  The lengths of the zero fields
+// are not stored here (the filters keep the size of the blocks): a shuffle (or a bitshuffle)
+// after this filter gathers them into the long runs of zeros that the codecs are good at.
+//
+// The XOR of two elements is the XOR of their bytes, so everything below works on bytes
+// with a lag of typesize, whatever the endianness.
+
+#include "floatxor.h"
+#include "blosc2/filters-registry.h"
+#include "blosc2.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#define FLOATXOR_HAS_SIMD
+typedef __m128i xor_vec;
+
+static inline xor_vec vec_load(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void vec_store(uint8_t* p, xor_vec x) { _mm_storeu_si128((__m128i*)p, x); }
+static inline xor_vec vec_xor(xor_vec a, xor_vec b) { return _mm_xor_si128(a, b); }
+
+/* The vector moved up by n bytes (a constant), with zeros coming in */
+#define VEC_SHIFT_UP(x, n) _mm_slli_si128(x, n)
+
+/* The last unit of x in every unit */
+static inline xor_vec vec_last(xor_vec x, int32_t unit) {
+  switch (unit) {
+    case 4:
+      return _mm_shuffle_epi32(x, 0xFF);
+    case 1:
+      x = _mm_unpackhi_epi8(x, x);
+      // fallthrough
+    case 2:
+      x = _mm_shufflehi_epi16(x, 0xFF);
+      // fallthrough
+    default:
+      return _mm_unpackhi_epi64(x, x);
+  }
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FLOATXOR_HAS_SIMD
+typedef uint8x16_t xor_vec;
+
+static inline xor_vec vec_load(const uint8_t* p) { return vld1q_u8(p); }
+static inline void vec_store(uint8_t* p, xor_vec x) { vst1q_u8(p, x); }
+static inline xor_vec vec_xor(xor_vec a, xor_vec b) { return veorq_u8(a, b); }
+
+#define VEC_SHIFT_UP(x, n) vextq_u8(vdupq_n_u8(0), x, 16 - (n))
+
+static inline xor_vec vec_last(xor_vec x, int32_t unit) {
+  switch (unit) {
+    case 1: return vdupq_laneq_u8(x, 15);
+    case 2: return vreinterpretq_u8_u16(vdupq_laneq_u16(vreinterpretq_u16_u8(x), 7));
+    case 4: return vreinterpretq_u8_u32(vdupq_laneq_u32(vreinterpretq_u32_u8(x), 3));
+    default: return vreinterpretq_u8_u64(vdupq_laneq_u64(vreinterpretq_u64_u8(x), 1));
+  }
+}
+#endif
+
+#if defined(FLOATXOR_HAS_SIMD)
+/* The unit at p in every unit */
+static inline xor_vec vec_load_unit(const uint8_t* p, int32_t unit) {
+  uint8_t units[16];
+  for (int32_t i = 0; i < 16; i += unit) {
+    memcpy(units + i, p, unit);
+  }
+  return vec_load(units);
+}
+
+/* The XOR of every unit of x with all the previous ones (Kogge-Stone) */
+static inline xor_vec vec_prefix_xor(xor_vec x, int32_t unit) {
+  switch (unit) {
+    case 1:
+      x = vec_xor(x, VEC_SHIFT_UP(x, 1));
+      // fallthrough
+    case 2:
+      x = vec_xor(x, VEC_SHIFT_UP(x, 2));
+      // fallthrough
+    case 4:
+      x = vec_xor(x, VEC_SHIFT_UP(x, 4));
+      // fallthrough
+    default:
+      x = vec_xor(x, VEC_SHIFT_UP(x, 8));
+  }
+  return x;
+}
+#endif  /* FLOATXOR_HAS_SIMD */
+
+
+/* output[i] = input[i] ^ input[i - lag] for the bytes from lag to length */
+static void xor_lagged(const uint8_t* input, uint8_t* output, int32_t length, int32_t lag) {
+  int32_t i = lag;
+#if defined(__AVX2__)
+  for (; i <= length - 32; i += 32) {
+    __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(input + i)),
+                                 _mm256_loadu_si256((const __m256i*)(input + i - lag)));
+    _mm256_storeu_si256((__m256i*)(output + i), x);
+  }
+#endif
+#if defined(FLOATXOR_HAS_SIMD)
+  for (; i <= length - 16; i += 16) {
+    vec_store(output + i, vec_xor(vec_load(input + i), vec_load(input + i - lag)));
+  }
+#endif
+  for (; i < length; i++) {
+    output[i] = input[i] ^ input[i - lag];
+  }
+}
+
+
+/* output[i] = input[i] ^ output[i - lag] for the bytes from lag to length */
+static void xor_scan(const uint8_t* input, uint8_t* output, int32_t length, int32_t lag) {
+  int32_t i = lag;
+#if defined(FLOATXOR_HAS_SIMD)
+  if (lag >= 16) {
+    // The previous elements are decoded already for all the bytes of a vector
+    for (; i <= length - 16; i += 16) {
+      vec_store(output + i, vec_xor(vec_load(input + i), vec_load(output + i - lag)));
+    }
+  }
+  else if ((lag & (lag - 1)) == 0 && length - i >= 16) {
+    // Only the carry (the previous element in every unit) is in the dependency chain
+    xor_vec carry = vec_load_unit(output, lag);
+    for (; i <= length - 16; i += 16) {
+      xor_vec x = vec_prefix_xor(vec_load(input + i), lag);
+      vec_store(output + i, vec_xor(x, carry));
+      carry = vec_xor(carry, vec_last(x, lag));
+    }
+  }
+#endif
+  for (; i < length; i++) {
+    output[i] = input[i] ^ output[i - lag];
+  }
+}
+
+
+static int get_typesize(uint8_t meta, blosc2_schunk* schunk) {
+  int typesize = meta;
+  if (typesize == 0) {
+    if (schunk == NULL) {
+      BLOSC_TRACE_ERROR("When meta is 0, you need to be on a schunk!");
+      BLOSC_ERROR(BLOSC2_ERROR_FAILURE);
+    }
+    typesize = schunk->typesize;
+  }
+  return typesize;
+}
+
+
+int floatxor_forward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                     blosc2_cparams* cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(id);
+
+  int typesize = get_typesize(meta, (blosc2_schunk*)cparams->schunk);
+  BLOSC_ERROR(typesize);
+  // The bytes after the last whole element (and the first element) are kept as they are
+  int32_t nbytes = length - length % typesize;
+  memcpy(output, input, typesize < length ? typesize : length);
+  memcpy(output + nbytes, input + nbytes, length - nbytes);
+  xor_lagged(input, output, nbytes, typesize);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int floatxor_backward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                      blosc2_dparams* dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(id);
+
+  int typesize = get_typesize(meta, (blosc2_schunk*)dparams->schunk);
+  BLOSC_ERROR(typesize);
+  int32_t nbytes = length - length % typesize;
+  memcpy(output, input, typesize < length ? typesize : length);
+  memcpy(output + nbytes, input + nbytes, length - nbytes);
+  xor_scan(input, output, nbytes, typesize);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
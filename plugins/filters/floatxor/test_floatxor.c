@@ -0,0 +1,167 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test program for the floatxor filter.  The (vector) kernels are checked
+    against the scalar XOR for every typesize and length, and then a time
+    series of doubles is compressed in a super-chunk.
+
+    To run:
+
+    $ ./test_floatxor
+    Kernels: ok
+    floatxor + bitshuffle: 800000 -> 112599 (7.1x), bitshuffle alone: 800000 -> 125368 (6.4x)
+    Successful roundtrip!
+
+**********************************************************************/
+
+#include "blosc2/filters-registry.h"
+#include "floatxor.h"
+#include "blosc2.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NELEMS (100 * 1000)
+
+
+static int test_kernels(void) {
+  const int32_t max_length = 24 * 40 + 7;
+  uint8_t *src = malloc(max_length);
+  uint8_t *xored = malloc(max_length);
+  uint8_t *dest = malloc(max_length);
+  for (int i = 0; i < max_length; i++) {
+    src[i] = (uint8_t) (i * i / 7 + rand() % 5);
+  }
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+
+  int32_t typesizes[] = {1, 2, 3, 4, 8, 12, 16, 24};
+  for (int n = 0; n < (int) (sizeof(typesizes) / sizeof(typesizes[0])); n++) {
+    int32_t typesize = typesizes[n];
+    for (int32_t length = 0; length <= max_length; length++) {
+      if (floatxor_forward(src, xored, length, (uint8_t) typesize, &cparams, BLOSC_FILTER_FLOATXOR) < 0) {
+        printf("Error in the encoder\n");
+        return -1;
+      }
+      int32_t nbytes = length - length % typesize;
+      for (int32_t i = 0; i < length; i++) {
+        uint8_t expected = (i >= typesize && i < nbytes) ? src[i] ^ src[i - typesize] : src[i];
+        if (xored[i] != expected) {
+          printf("Typesize %d, length %d: byte %d differs from the scalar XOR\n", typesize, length, i);
+          return -1;
+        }
+      }
+      if (floatxor_backward(xored, dest, length, (uint8_t) typesize, &dparams, BLOSC_FILTER_FLOATXOR) < 0) {
+        printf("Error in the decoder\n");
+        return -1;
+      }
+      if (memcmp(dest, src, length) != 0) {
+        printf("Typesize %d, length %d: the decoder does not give the data back\n", typesize, length);
+        return -1;
+      }
+    }
+  }
+
+  free(src);
+  free(xored);
+  free(dest);
+  printf("Kernels: ok\n");
+  return 0;
+}
+
+
+static int64_t compress_series(const double *data, uint8_t filter, int16_t nthreads, double *dest) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(double);
+  cparams.compcode = BLOSC_LZ4;
+  cparams.nthreads = nthreads;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = filter;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 2] = 0;  // the typesize of the super-chunk
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_BITSHUFFLE;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_storage storage = {.cparams = &cparams, .dparams = &dparams};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  if (schunk == NULL) {
+    printf("Cannot create the super-chunk\n");
+    return -1;
+  }
+
+  int32_t chunk_nitems = NELEMS / 4;
+  for (int nchunk = 0; nchunk < 4; nchunk++) {
+    BLOSC_ERROR((int) blosc2_schunk_append_buffer(schunk, (void *) (data + nchunk * chunk_nitems),
+                                                  chunk_nitems * (int32_t) sizeof(double)));
+  }
+  for (int nchunk = 0; nchunk < 4; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, dest + nchunk * chunk_nitems,
+                                               chunk_nitems * (int32_t) sizeof(double));
+    if (dsize != chunk_nitems * (int32_t) sizeof(double)) {
+      printf("Error decompressing chunk %d\n", nchunk);
+      return -1;
+    }
+  }
+  int64_t cbytes = schunk->cbytes;
+  blosc2_schunk_free(schunk);
+  return cbytes;
+}
+
+
+static int test_series(void) {
+  // A slowly varying signal, with the two decimals (and some jitter) of a sensor
+  double *data = malloc(NELEMS * sizeof(double));
+  double *dest = malloc(NELEMS * sizeof(double));
+  for (int i = 0; i < NELEMS; i++) {
+    data[i] = round((20. + 5. * sin(i * 1e-4)) * 100.) / 100. + 0.01 * (i % 3);
+  }
+
+  int64_t nbytes = NELEMS * (int64_t) sizeof(double);
+  int64_t cbytes = compress_series(data, BLOSC_FILTER_FLOATXOR, 1, dest);
+  if (cbytes < 0 || memcmp(data, dest, nbytes) != 0) {
+    printf("The data differs after the roundtrip\n");
+    return -1;
+  }
+  int64_t cbytes_plain = compress_series(data, BLOSC_NOFILTER, 1, dest);
+  if (cbytes_plain < 0) {
+    return -1;
+  }
+  printf("floatxor + bitshuffle: %" PRId64 " -> %" PRId64 " (%.1fx), bitshuffle alone: %" PRId64 " -> %"
+         PRId64 " (%.1fx)\n", nbytes, cbytes, (double) nbytes / (double) cbytes,
+         nbytes, cbytes_plain, (double) nbytes / (double) cbytes_plain);
+  if (cbytes >= cbytes_plain) {
+    printf("The XOR of the elements should compress better\n");
+    return -1;
+  }
+
+  // With threads too
+  memset(dest, 0, nbytes);
+  if (compress_series(data, BLOSC_FILTER_FLOATXOR, 4, dest) < 0 || memcmp(data, dest, nbytes) != 0) {
+    printf("The data differs after the roundtrip with threads\n");
+    return -1;
+  }
+
+  free(data);
+  free(dest);
+  printf("Successful roundtrip!\n");
+  return 0;
+}
+
+
+int main(void) {
+  blosc2_init();
+  int rc = test_kernels();
+  if (rc == 0) {
+    rc = test_series();
+  }
+  blosc2_destroy();
+  return rc;
+}
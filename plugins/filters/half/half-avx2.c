@@ -0,0 +1,71 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "half-avx2.h"
+
+/* Make sure AVX2 and F16C are available for the compilation target and compiler. */
+#if defined(__AVX2__) && (defined(__F16C__) || defined(_MSC_VER))
+
+#include <immintrin.h>
+
+
+/* The bfloat16 of every float (rounded to nearest even, and NaNs kept quiet) */
+static inline __m256i to_bfloat(__m256i u) {
+  __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(1));
+  __m256i bias = _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7FFF));
+  __m256i rounded = _mm256_srli_epi32(_mm256_add_epi32(u, bias), 16);
+  __m256i quiet = _mm256_or_si256(_mm256_srli_epi32(u, 16), _mm256_set1_epi32(0x40));
+  __m256 f = _mm256_castsi256_ps(u);
+  __m256i nan = _mm256_castps_si256(_mm256_cmp_ps(f, f, _CMP_UNORD_Q));
+  return _mm256_blendv_epi8(rounded, quiet, nan);
+}
+
+
+int32_t half_encode_avx2(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat) {
+  int32_t i = 0;
+  if (bfloat) {
+    for (; i + 8 <= nelems; i += 8) {
+      __m256i u = _mm256_loadu_si256((const __m256i*)(input + i * 4));
+      _mm256_storeu_si256((__m256i*)(output + i * 4), to_bfloat(u));
+    }
+  }
+  else {
+    for (; i + 8 <= nelems; i += 8) {
+      __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps((const float*)(input + i * 4)),
+                                  _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+      _mm256_storeu_si256((__m256i*)(output + i * 4), _mm256_cvtepu16_epi32(h));
+    }
+  }
+  return i;
+}
+
+
+int32_t half_decode_avx2(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat) {
+  int32_t i = 0;
+  if (bfloat) {
+    for (; i + 8 <= nelems; i += 8) {
+      __m256i u = _mm256_loadu_si256((const __m256i*)(input + i * 4));
+      _mm256_storeu_si256((__m256i*)(output + i * 4), _mm256_slli_epi32(u, 16));
+    }
+  }
+  else {
+    // The low 16 bits of every slot, gathered in the low 8 bytes of both lanes
+    const __m256i low = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+                                         0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+    for (; i + 8 <= nelems; i += 8) {
+      __m256i u = _mm256_loadu_si256((const __m256i*)(input + i * 4));
+      u = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(u, low), 0x08);
+      _mm256_storeu_ps((float*)(output + i * 4), _mm256_cvtph_ps(_mm256_castsi256_si128(u)));
+    }
+  }
+  return i;
+}
+
+#endif /* defined(__AVX2__) && (defined(__F16C__) || defined(_MSC_VER)) */
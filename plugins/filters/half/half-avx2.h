@@ -0,0 +1,34 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* AVX2-accelerated routines for the half filter. */
+
+#ifndef BLOSC_PLUGINS_FILTERS_HALF_HALF_AVX2_H
+#define BLOSC_PLUGINS_FILTERS_HALF_HALF_AVX2_H
+
+#include "blosc2/blosc2-common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+  Convert the floats to bfloat16 (or to float16) values, each one in the low
+  bytes of a 32-bit slot, up to the last multiple of 8 of `nelems`.
+  Returns the number of elements converted.
+*/
+BLOSC_NO_EXPORT int32_t half_encode_avx2(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat);
+
+/**
+  Convert the slots of bfloat16 (or float16) values back to floats, up to
+  the last multiple of 8 of `nelems`.  Returns the number of elements converted.
+*/
+BLOSC_NO_EXPORT int32_t half_decode_avx2(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat);
+
+#endif /* BLOSC_PLUGINS_FILTERS_HALF_HALF_AVX2_H */
@@ -0,0 +1,67 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "half-avx512.h"
+
+/* Make sure AVX512 is available for the compilation target and compiler. */
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+
+#include <immintrin.h>
+
+
+/* The bfloat16 of every float (rounded to nearest even, and NaNs kept quiet) */
+static inline __m512i to_bfloat(__m512i u) {
+  __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(1));
+  __m512i bias = _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7FFF));
+  __m512i rounded = _mm512_srli_epi32(_mm512_add_epi32(u, bias), 16);
+  __m512i quiet = _mm512_or_si512(_mm512_srli_epi32(u, 16), _mm512_set1_epi32(0x40));
+  __m512 f = _mm512_castsi512_ps(u);
+  __mmask16 nan = _mm512_cmp_ps_mask(f, f, _CMP_UNORD_Q);
+  return _mm512_mask_blend_epi32(nan, rounded, quiet);
+}
+
+
+int32_t half_encode_avx512(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat) {
+  int32_t i = 0;
+  if (bfloat) {
+    for (; i + 16 <= nelems; i += 16) {
+      __m512i u = _mm512_loadu_si512((const void*)(input + i * 4));
+      _mm512_storeu_si512((void*)(output + i * 4), to_bfloat(u));
+    }
+  }
+  else {
+    for (; i + 16 <= nelems; i += 16) {
+      __m256i h = _mm512_cvtps_ph(_mm512_loadu_ps((const void*)(input + i * 4)),
+                                  _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+      _mm512_storeu_si512((void*)(output + i * 4), _mm512_cvtepu16_epi32(h));
+    }
+  }
+  return i;
+}
+
+
+int32_t half_decode_avx512(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat) {
+  int32_t i = 0;
+  if (bfloat) {
+    for (; i + 16 <= nelems; i += 16) {
+      __m512i u = _mm512_loadu_si512((const void*)(input + i * 4));
+      _mm512_storeu_si512((void*)(output + i * 4), _mm512_slli_epi32(u, 16));
+    }
+  }
+  else {
+    for (; i + 16 <= nelems; i += 16) {
+      __m256i h = _mm512_cvtepi32_epi16(_mm512_loadu_si512((const void*)(input + i * 4)));
+      _mm512_storeu_ps((void*)(output + i * 4), _mm512_cvtph_ps(h));
+    }
+  }
+  return i;
+}
+
+#endif /* defined(__AVX512F__) && defined(__AVX512BW__) */
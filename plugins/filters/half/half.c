@@ -0,0 +1,283 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+// Half filter.  A lossy filter that converts every float32 into a bfloat16 (meta 0) or an
+// IEEE float16 (meta 1), rounding to the nearest even.  As filters cannot shrink the blocks,
+// the 16-bit value is kept in the low bytes of the 32-bit slot of the float (little endian) and
+// its upper bytes are zeros, so a following shuffle makes half of the byte streams zeros, which
+// are stored as runs and never reach the codec.
+//
+// The conversions are vectorized with SSE2 or NEON, and with the F16C (or AVX512F) conversion
+// instructions for float16 when the host processor supports them (see half-avx2.c and
+// half-avx512.c).
+
+#include "half.h"
+#include "../plugins/plugin_utils.h"
+#include "shuffle.h"
+#if defined(HALF_AVX2_ENABLED)
+#include "half-avx2.h"
+#endif
+#if defined(HALF_AVX512_ENABLED)
+#include "half-avx512.h"
+#endif
+#include "blosc2/filters-registry.h"
+#include "blosc2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HALF_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define HALF_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+static inline uint32_t load_u32(const uint8_t* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline void store_u32(uint8_t* p, uint32_t u) {
+  p[0] = (uint8_t) u;
+  p[1] = (uint8_t) (u >> 8);
+  p[2] = (uint8_t) (u >> 16);
+  p[3] = (uint8_t) (u >> 24);
+}
+
+
+static inline uint32_t float_to_bfloat(uint32_t u) {
+  if ((u & 0x7FFFFFFF) > 0x7F800000) {
+    return (u >> 16) | 0x40;  // keep the NaN quiet, as its payload may be in the lost bits
+  }
+  return (u + 0x7FFF + ((u >> 16) & 1)) >> 16;
+}
+
+static inline uint32_t float_to_half(uint32_t u) {
+  uint32_t sign = (u >> 16) & 0x8000;
+  uint32_t abs = u & 0x7FFFFFFF;
+  if (abs > 0x7F800000) {
+    return sign | 0x7E00 | ((abs >> 13) & 0x3FF);
+  }
+  if (abs >= 0x477FF000) {
+    return sign | 0x7C00;  // at least 65520, which rounds to infinity
+  }
+  if (abs < 0x38800000) {
+    // Subnormal in float16 (below 2^-14)
+    int32_t shift = 126 - (int32_t) (abs >> 23);
+    if (shift > 24) {
+      return sign;
+    }
+    uint32_t mant = (abs & 0x7FFFFF) | 0x800000;
+    uint32_t h = mant >> shift;
+    uint32_t rest = mant & ((1u << shift) - 1);
+    uint32_t half = 1u << (shift - 1);
+    if (rest > half || (rest == half && (h & 1))) {
+      h++;
+    }
+    return sign | h;
+  }
+  uint32_t r = abs - 0x38000000;  // rebias the exponent from 127 to 15
+  r += 0xFFF + ((r >> 13) & 1);
+  return sign | (r >> 13);
+}
+
+static inline uint32_t half_to_float(uint32_t h) {
+  uint32_t sign = (h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1F;
+  uint32_t mant = h & 0x3FF;
+  if (exp == 0x1F) {
+    // Infinity, or a NaN that is made quiet (as the conversion instructions do)
+    return sign | (mant ? 0x7FC00000 : 0x7F800000) | (mant << 13);
+  }
+  if (exp == 0) {
+    // Zero or subnormal, which are exact floats
+    float f = (float) mant * (1.f / 16777216.f);
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return sign | u;
+  }
+  return sign | ((exp + 112) << 23) | (mant << 13);
+}
+
+
+/* The element-wise conversions, from the element `i` on */
+static void encode_scalar(const uint8_t* input, uint8_t* output, int32_t i, int32_t nelems, bool bfloat) {
+  for (; i < nelems; i++) {
+    uint32_t u = load_u32(input + i * 4);
+    store_u32(output + i * 4, bfloat ? float_to_bfloat(u) : float_to_half(u));
+  }
+}
+
+static void decode_scalar(const uint8_t* input, uint8_t* output, int32_t i, int32_t nelems, bool bfloat) {
+  for (; i < nelems; i++) {
+    uint32_t h = load_u32(input + i * 4) & 0xFFFF;
+    store_u32(output + i * 4, bfloat ? h << 16 : half_to_float(h));
+  }
+}
+
+
+/* The 128-bit conversions, which return the number of elements done */
+static int32_t encode_simd(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat) {
+  int32_t i = 0;
+#if defined(HALF_SSE2)
+  if (bfloat) {
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i bias = _mm_set1_epi32(0x7FFF);
+    const __m128i quiet = _mm_set1_epi32(0x40);
+    for (; i + 4 <= nelems; i += 4) {
+      __m128i u = _mm_loadu_si128((const __m128i*) (input + i * 4));
+      __m128i high = _mm_srli_epi32(u, 16);
+      __m128i rounded = _mm_srli_epi32(_mm_add_epi32(u, _mm_add_epi32(bias, _mm_and_si128(high, one))), 16);
+      __m128 f = _mm_castsi128_ps(u);
+      __m128i nan = _mm_castps_si128(_mm_cmpunord_ps(f, f));
+      __m128i h = _mm_or_si128(_mm_andnot_si128(nan, rounded), _mm_and_si128(nan, _mm_or_si128(high, quiet)));
+      _mm_storeu_si128((__m128i*) (output + i * 4), h);
+    }
+  }
+#elif defined(HALF_NEON)
+  if (bfloat) {
+    const uint32x4_t one = vdupq_n_u32(1);
+    const uint32x4_t bias = vdupq_n_u32(0x7FFF);
+    const uint32x4_t quiet = vdupq_n_u32(0x40);
+    for (; i + 4 <= nelems; i += 4) {
+      uint32x4_t u = vld1q_u32((const uint32_t*) (input + i * 4));
+      uint32x4_t high = vshrq_n_u32(u, 16);
+      uint32x4_t rounded = vshrq_n_u32(vaddq_u32(u, vaddq_u32(bias, vandq_u32(high, one))), 16);
+      float32x4_t f = vreinterpretq_f32_u32(u);
+      uint32x4_t ordered = vceqq_f32(f, f);
+      vst1q_u32((uint32_t*) (output + i * 4), vbslq_u32(ordered, rounded, vorrq_u32(high, quiet)));
+    }
+  }
+  else {
+    for (; i + 4 <= nelems; i += 4) {
+      float16x4_t h = vcvt_f16_f32(vld1q_f32((const float*) (input + i * 4)));
+      vst1q_u32((uint32_t*) (output + i * 4), vmovl_u16(vreinterpret_u16_f16(h)));
+    }
+  }
+#else
+  BLOSC_UNUSED_PARAM(input);
+  BLOSC_UNUSED_PARAM(output);
+  BLOSC_UNUSED_PARAM(nelems);
+  BLOSC_UNUSED_PARAM(bfloat);
+#endif
+  return i;
+}
+
+static int32_t decode_simd(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat) {
+  int32_t i = 0;
+#if defined(HALF_SSE2)
+  if (bfloat) {
+    for (; i + 4 <= nelems; i += 4) {
+      __m128i u = _mm_loadu_si128((const __m128i*) (input + i * 4));
+      _mm_storeu_si128((__m128i*) (output + i * 4), _mm_slli_epi32(u, 16));
+    }
+  }
+#elif defined(HALF_NEON)
+  if (bfloat) {
+    for (; i + 4 <= nelems; i += 4) {
+      uint32x4_t u = vld1q_u32((const uint32_t*) (input + i * 4));
+      vst1q_u32((uint32_t*) (output + i * 4), vshlq_n_u32(u, 16));
+    }
+  }
+  else {
+    for (; i + 4 <= nelems; i += 4) {
+      uint16x4_t h = vmovn_u32(vld1q_u32((const uint32_t*) (input + i * 4)));
+      vst1q_f32((float*) (output + i * 4), vcvt_f32_f16(vreinterpret_f16_u16(h)));
+    }
+  }
+#else
+  BLOSC_UNUSED_PARAM(input);
+  BLOSC_UNUSED_PARAM(output);
+  BLOSC_UNUSED_PARAM(nelems);
+  BLOSC_UNUSED_PARAM(bfloat);
+#endif
+  return i;
+}
+
+
+typedef int32_t (*half_func)(const uint8_t* input, uint8_t* output, int32_t nelems, bool bfloat);
+
+/* Flag indicating whether the kernels have been chosen for the host processor */
+static int32_t implementation_initialized;
+static half_func half_encode;
+static half_func half_decode;
+
+/* Choose the widest kernels supported by the host processor, if not done yet.  As for the
+   shuffle, a concurrent initialization would just choose the same ones on every thread. */
+static void init_half_implementation(void) {
+  if (implementation_initialized) {
+    return;
+  }
+  half_encode = encode_simd;
+  half_decode = decode_simd;
+#if defined(HALF_AVX2_ENABLED)
+  blosc_cpu_features cpu_features = blosc_get_cpu_features();
+  if ((cpu_features & BLOSC_HAVE_AVX2) && (cpu_features & BLOSC_HAVE_F16C)) {
+    half_encode = half_encode_avx2;
+    half_decode = half_decode_avx2;
+  }
+#if defined(HALF_AVX512_ENABLED)
+  if (cpu_features & BLOSC_HAVE_AVX512) {
+    half_encode = half_encode_avx512;
+    half_decode = half_decode_avx512;
+  }
+#endif  // HALF_AVX512_ENABLED
+#endif  // HALF_AVX2_ENABLED
+  implementation_initialized = 1;
+}
+
+
+int half_forward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                 blosc2_cparams* cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(id);
+
+  if (cparams->typesize != 4) {
+    BLOSC_TRACE_ERROR("The half filter only works for float32");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  if (meta != BLOSC_HALF_BFLOAT16 && meta != BLOSC_HALF_FLOAT16) {
+    BLOSC_TRACE_ERROR("Unknown half format: %d", meta);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  // The bytes after the last whole element are kept as they are
+  int32_t nelems = length / 4;
+  memcpy(output + nelems * 4, input + nelems * 4, length % 4);
+
+  init_half_implementation();
+  bool bfloat = meta == BLOSC_HALF_BFLOAT16;
+  int32_t i = half_encode(input, output, nelems, bfloat);
+  encode_scalar(input, output, i, nelems, bfloat);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int half_backward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                  blosc2_dparams* dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(id);
+
+  if (meta != BLOSC_HALF_BFLOAT16 && meta != BLOSC_HALF_FLOAT16) {
+    BLOSC_TRACE_ERROR("Unknown half format: %d", meta);
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int32_t nelems = length / 4;
+  memcpy(output + nelems * 4, input + nelems * 4, length % 4);
+
+  init_half_implementation();
+  bool bfloat = meta == BLOSC_HALF_BFLOAT16;
+  int32_t i = half_decode(input, output, nelems, bfloat);
+  decode_scalar(input, output, i, nelems, bfloat);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
@@ -0,0 +1,258 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test program for the half filter.  The conversions are checked against
+    a reference rounding to the nearest even (done with doubles) for every
+    length up to a few SIMD widths, every 16-bit value is converted back and
+    forth, and the compressed size must be at most half of the one of the
+    plain shuffle.
+
+    To run:
+
+    $ ./test_half
+    float16: 4000000 -> 797150 (5.0x), trunc_prec: 4000000 -> 1191346 (3.4x)
+    bfloat16: 4000000 -> 599357 (6.7x), trunc_prec: 4000000 -> 599357 (6.7x)
+    Successful roundtrip!
+
+**********************************************************************/
+
+#include "blosc2/filters-registry.h"
+#include "half.h"
+#include "blosc2.h"
+
+#include <float.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NELEMS (1000 * 1000)
+
+
+/* Round to `mbits` bits of mantissa and exponents down to `emin`, to nearest even */
+static double reference(double x, int mbits, int emin, double inf) {
+  double ax = fabs(x);
+  if (isnan(x) || isinf(x)) {
+    return x;
+  }
+  if (ax >= inf) {
+    return copysign(INFINITY, x);
+  }
+  int e;
+  frexp(ax, &e);
+  e = e - 1 < emin ? emin : e - 1;
+  double q = ldexp(1., e - mbits);
+  return copysign(nearbyint(ax / q) * q, x);
+}
+
+
+static int convert(const float* values, float* dest, int32_t nelems, uint8_t meta) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 4;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  int32_t length = nelems * 4 + 3;  // with a few bytes after the last float
+  uint8_t* input = malloc(length);
+  uint8_t* halves = malloc(length);
+  uint8_t* output = malloc(length);
+  memcpy(input, values, nelems * 4);
+  memcpy(input + nelems * 4, "xyz", 3);
+  if (half_forward(input, halves, length, meta, &cparams, BLOSC_FILTER_HALF) < 0 ||
+      half_backward(halves, output, length, meta, &dparams, BLOSC_FILTER_HALF) < 0) {
+    printf("Cannot convert the values\n");
+    return -1;
+  }
+  for (int32_t i = 0; i < nelems; i++) {
+    uint32_t slot;
+    memcpy(&slot, halves + i * 4, 4);
+    if (slot >> 16 != 0) {
+      printf("The upper bytes of the slot %d are not zeros\n", i);
+      return -1;
+    }
+  }
+  if (memcmp(output + nelems * 4, "xyz", 3) != 0) {
+    printf("The bytes after the last float are lost\n");
+    return -1;
+  }
+  memcpy(dest, output, nelems * 4);
+  free(input);
+  free(halves);
+  free(output);
+  return 0;
+}
+
+
+static bool same(float a, float b) {
+  return (isnan(a) && isnan(b)) || (a == b && signbit(a) == signbit(b));
+}
+
+
+/* Every length up to a few SIMD widths, with special values and random exponents */
+static int test_lengths(uint8_t meta) {
+  bool bfloat = meta == BLOSC_HALF_BFLOAT16;
+  int mbits = bfloat ? 7 : 10;
+  int emin = bfloat ? -126 : -14;
+  double inf = bfloat ? ldexp(2. - ldexp(1., -8), 127) : 65520.;
+  float specials[] = {0.f, -0.f, INFINITY, -INFINITY, NAN, 65504.f, 65519.99f, 65520.f, 6.1035156e-05f,
+                      5.9604645e-08f, 2.9802322e-08f, 2.9802326e-08f, 1.5f + 1.f / 2048, 1.f + 1.f / 256,
+                      1.f + 3.f / 256, FLT_MAX, FLT_MIN, 1e-40f};
+  int nspecials = sizeof(specials) / sizeof(specials[0]);
+  float values[70];
+  float dest[70];
+  uint32_t seed = 1;
+  for (int32_t nelems = 0; nelems <= 70; nelems++) {
+    for (int i = 0; i < nelems; i++) {
+      seed = seed * 1103515245 + 12345;
+      if (i % 3 == 0) {
+        values[i] = specials[(seed >> 16) % nspecials];
+      }
+      else {
+        float mant = (float) (seed >> 8) / 16777216.f + 1.f;
+        int e = (int) ((seed >> 4) % 40) - 30 + (bfloat ? (int) (seed % 200) - 100 : 0);
+        values[i] = ldexpf((seed & 1) ? -mant : mant, e);
+      }
+    }
+    if (convert(values, dest, nelems, meta) < 0) {
+      return -1;
+    }
+    for (int i = 0; i < nelems; i++) {
+      float expected = (float) reference(values[i], mbits, emin, inf);
+      if (!same(dest[i], expected)) {
+        printf("%s of %.9g is %.9g instead of %.9g\n", bfloat ? "bfloat16" : "float16", values[i],
+               dest[i], expected);
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+
+/* Every 16-bit value is kept when converted to float and back (quieting the NaNs) */
+static int test_exhaustive(uint8_t meta) {
+  bool bfloat = meta == BLOSC_HALF_BFLOAT16;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 4;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  uint32_t* slots = malloc(65536 * 4);
+  uint32_t* floats = malloc(65536 * 4);
+  uint32_t* back = malloc(65536 * 4);
+  for (uint32_t h = 0; h < 65536; h++) {
+    slots[h] = h;
+  }
+  if (half_backward((uint8_t*) slots, (uint8_t*) floats, 65536 * 4, meta, &dparams, BLOSC_FILTER_HALF) < 0 ||
+      half_forward((uint8_t*) floats, (uint8_t*) back, 65536 * 4, meta, &cparams, BLOSC_FILTER_HALF) < 0) {
+    printf("Cannot convert the 16-bit values\n");
+    return -1;
+  }
+  uint32_t quiet = bfloat ? 0x40 : 0x200;
+  uint32_t exp_mask = bfloat ? 0x7F80 : 0x7C00;
+  for (uint32_t h = 0; h < 65536; h++) {
+    bool nan = (h & exp_mask) == exp_mask && (h & ~exp_mask & 0x7FFF) != 0;
+    uint32_t expected = nan ? h | quiet : h;
+    if (back[h] != expected) {
+      printf("%s 0x%04x is 0x%04x after the roundtrip\n", bfloat ? "bfloat16" : "float16", h, back[h]);
+      return -1;
+    }
+  }
+  free(slots);
+  free(floats);
+  free(back);
+  return 0;
+}
+
+
+static int64_t compress(float* values, float* dest, uint8_t filter, uint8_t meta) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 4;
+  cparams.compcode = BLOSC_LZ4;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = filter;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 2] = meta;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_SHUFFLE;
+  blosc2_storage storage = {.cparams = &cparams};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  if (blosc2_schunk_append_buffer(schunk, values, NELEMS * 4) < 0 ||
+      blosc2_schunk_decompress_chunk(schunk, 0, dest, NELEMS * 4) != NELEMS * 4) {
+    printf("Cannot compress the values\n");
+    return -1;
+  }
+  int64_t cbytes = schunk->cbytes;
+  blosc2_schunk_free(schunk);
+  return cbytes;
+}
+
+
+/* The zero streams after the shuffle are not passed to the codec, so the data is halved at least */
+static int test_compression(uint8_t meta) {
+  bool bfloat = meta == BLOSC_HALF_BFLOAT16;
+  float* values = malloc(NELEMS * 4);
+  float* dest = malloc(NELEMS * 4);
+  for (int32_t i = 0; i < NELEMS; i++) {
+    values[i] = (float) (20. + 5. * sin(i * 1e-4) + 0.01 * ((int64_t) i * 7919 % 100));
+  }
+  int64_t cbytes = compress(values, dest, BLOSC_FILTER_HALF, meta);
+  if (cbytes < 0) {
+    return -1;
+  }
+  int mbits = bfloat ? 7 : 10;
+  for (int32_t i = 0; i < NELEMS; i++) {
+    if (fabsf(dest[i] - values[i]) > ldexpf(fabsf(values[i]), -mbits - 1)) {
+      printf("The value %d is not rounded to the nearest\n", i);
+      return -1;
+    }
+  }
+  int64_t plain_cbytes = compress(values, dest, BLOSC_NOFILTER, 0);
+  if (plain_cbytes < 0) {
+    return -1;
+  }
+  printf("%s: %d -> %" PRId64 " (%.1fx), shuffle only: %d -> %" PRId64 " (%.1fx)\n",
+         bfloat ? "bfloat16" : "float16", NELEMS * 4, cbytes, (double) NELEMS * 4 / (double) cbytes,
+         NELEMS * 4, plain_cbytes, (double) NELEMS * 4 / (double) plain_cbytes);
+  if (2 * cbytes > plain_cbytes) {
+    printf("The half filter should at least halve the compressed size\n");
+    return -1;
+  }
+  free(values);
+  free(dest);
+  return 0;
+}
+
+
+int main(void) {
+  blosc2_init();
+  int rc = 0;
+  uint8_t metas[] = {BLOSC_HALF_FLOAT16, BLOSC_HALF_BFLOAT16};
+  for (int n = 0; n < 2 && rc == 0; n++) {
+    rc = test_lengths(metas[n]);
+    if (rc == 0) {
+      rc = test_exhaustive(metas[n]);
+    }
+    if (rc == 0) {
+      rc = test_compression(metas[n]);
+    }
+  }
+  if (rc == 0) {
+    // Only float32 can be converted
+    blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+    cparams.typesize = 8;
+    uint8_t input[16] = {0};
+    uint8_t output[16];
+    if (half_forward(input, output, 16, BLOSC_HALF_FLOAT16, &cparams, BLOSC_FILTER_HALF) >= 0) {
+      printf("Doubles are converted\n");
+      rc = -1;
+    }
+  }
+  if (rc == 0) {
+    printf("Successful roundtrip!\n");
+  }
+  blosc2_destroy();
+  return rc;
+}
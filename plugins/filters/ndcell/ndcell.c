@@ -19,6 +19,31 @@
 #include <stdio.h>
 
 
+/* Go to the next index of a `ndim`-dim array with `shape`, in C order */
+static inline void next_index(int ndim, int64_t *index, const int64_t *shape) {
+  for (int i = ndim - 1; i >= 0; --i) {
+    if (++index[i] < shape[i]) {
+      return;
+    }
+    index[i] = 0;
+  }
+}
+
+/* Go to the next row of a cell (`index` in the `ndim - 1` first dims of `shape`), with `ind` the
+ * (block) item where it starts */
+static inline void next_row(int ndim, int64_t *index, const int64_t *shape, const int64_t *strides,
+                            int64_t *ind) {
+  for (int i = ndim - 2; i >= 0; --i) {
+    *ind += strides[i];
+    if (++index[i] < shape[i]) {
+      return;
+    }
+    *ind -= index[i] * strides[i];
+    index[i] = 0;
+  }
+}
+
+
 int ndcell_forward(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta, blosc2_cparams *cparams,
                    uint8_t id) {
   BLOSC_UNUSED_PARAM(id);
@@ -76,16 +101,22 @@ int ndcell_forward(const uint8_t *input, uint8_t *output, int32_t length, uint8_
     ncells *= i_shape[i];
   }
 
+  int64_t blockstrides[NDCELL_MAX_DIM];
+  blockstrides[ndim - 1] = 1;
+  for (int i = ndim - 2; i >= 0; --i) {
+    blockstrides[i] = blockstrides[i + 1] * blockshape[i + 1];
+  }
+
   /* main loop */
   int64_t pad_shape[NDCELL_MAX_DIM];
-  int64_t ii[NDCELL_MAX_DIM];
+  int64_t ii[NDCELL_MAX_DIM] = {0};
   for (int cell_ind = 0; cell_ind < ncells; cell_ind++) {      // for each cell
-    blosc2_unidim_to_multidim(ndim, i_shape, cell_ind, ii);
-    uint32_t orig = 0;
-    int64_t nd_aux = (int64_t) cell_shape;
-    for (int i = ndim - 1; i >= 0; i--) {
-      orig += ii[i] * nd_aux;
-      nd_aux *= blockshape[i];
+    if (cell_ind > 0) {
+      next_index(ndim, ii, i_shape);
+    }
+    int64_t orig = 0;
+    for (int i = 0; i < ndim; i++) {
+      orig += ii[i] * cell_shape * blockstrides[i];
     }
 
     for (int dim_ind = 0; dim_ind < ndim; dim_ind++) {
@@ -99,17 +130,14 @@ int ndcell_forward(const uint8_t *input, uint8_t *output, int32_t length, uint8_
     for (int i = 0; i < ndim - 1; ++i) {
       ncopies *= pad_shape[i];
     }
-    int64_t kk[NDCELL_MAX_DIM];
+    // Gather the rows of the cell, without working the index out of copy_ind every time
+    int64_t kk[NDCELL_MAX_DIM] = {0};
+    int64_t ind = orig;
+    int64_t row_size = pad_shape[ndim - 1] * typesize;
     for (int copy_ind = 0; copy_ind < ncopies; ++copy_ind) {
-      blosc2_unidim_to_multidim(ndim - 1, pad_shape, copy_ind, kk);
-      nd_aux = blockshape[ndim - 1];
-      int64_t ind = orig;
-      for (int i = ndim - 2; i >= 0; i--) {
-        ind += kk[i] * nd_aux;
-        nd_aux *= blockshape[i];
-      }
-      memcpy(op, &ip[ind * typesize], pad_shape[ndim - 1] * typesize);
-      op += pad_shape[ndim - 1] * typesize;
+      memcpy(op, &ip[ind * typesize], row_size);
+      op += row_size;
+      next_row(ndim, kk, pad_shape, blockstrides, &ind);
     }
 
     if (op > op_limit) {
@@ -194,9 +222,15 @@ int ndcell_backward(const uint8_t *input, uint8_t *output, int32_t length, uint8
     ncells *= i_shape[i];
   }
 
+  int64_t blockstrides[NDCELL_MAX_DIM];
+  blockstrides[ndim - 1] = 1;
+  for (int i = ndim - 2; i >= 0; --i) {
+    blockstrides[i] = blockstrides[i + 1] * blockshape[i + 1];
+  }
+
   /* main loop */
   int64_t pad_shape[NDCELL_MAX_DIM] = {0};
-  int64_t ii[NDCELL_MAX_DIM];
+  int64_t ii[NDCELL_MAX_DIM] = {0};
   int32_t ind = 0;
   for (int cell_ind = 0; cell_ind < ncells; cell_ind++) {      // for each cell
 
@@ -207,12 +241,12 @@ int ndcell_backward(const uint8_t *input, uint8_t *output, int32_t length, uint8
       BLOSC_TRACE_ERROR("Exceeding input length!");
       return BLOSC2_ERROR_FAILURE;
     }
-    blosc2_unidim_to_multidim(ndim, i_shape, cell_ind, ii);
-    uint32_t orig = 0;
-    int64_t nd_aux = (int64_t) cell_shape;
-    for (int i = ndim - 1; i >= 0; i--) {
-      orig += ii[i] * nd_aux;
-      nd_aux *= blockshape[i];
+    if (cell_ind > 0) {
+      next_index(ndim, ii, i_shape);
+    }
+    int64_t orig = 0;
+    for (int i = 0; i < ndim; i++) {
+      orig += ii[i] * cell_shape * blockstrides[i];
     }
 
     for (int dim_ind = 0; dim_ind < ndim; dim_ind++) {
@@ -227,17 +261,15 @@ int ndcell_backward(const uint8_t *input, uint8_t *output, int32_t length, uint8
     for (int i = 0; i < ndim - 1; ++i) {
       ncopies *= pad_shape[i];
     }
-    int64_t kk[NDCELL_MAX_DIM];
+    // Scatter the rows of the cell
+    int64_t kk[NDCELL_MAX_DIM] = {0};
+    int64_t row_ind = orig;
+    int64_t row_size = pad_shape[ndim - 1] * typesize;
     for (int copy_ind = 0; copy_ind < ncopies; ++copy_ind) {
-      blosc2_unidim_to_multidim(ndim - 1, pad_shape, copy_ind, kk);
-      nd_aux = blockshape[ndim - 1];
-      ind = (int32_t) orig;
-      for (int i = ndim - 2; i >= 0; i--) {
-        ind += (int32_t) (kk[i] * nd_aux);
-        nd_aux *= blockshape[i];
-      }
-      memcpy(&op[ind * typesize], ip, pad_shape[ndim - 1] * typesize);
-      ip += pad_shape[ndim - 1] * typesize;
+      ind = (int32_t) row_ind;
+      memcpy(&op[ind * typesize], ip, row_size);
+      ip += row_size;
+      next_row(ndim, kk, pad_shape, blockstrides, &row_ind);
     }
   }
   ind += (int32_t) pad_shape[ndim - 1];
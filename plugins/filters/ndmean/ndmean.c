@@ -13,6 +13,88 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+/* The number of partial sums for the means, so that the compiler can vectorize them */
+#define NDMEAN_LANES 8
+
+
+/* Go to the next index of a `ndim`-dim array with `shape`, in C order */
+static inline void next_index(int ndim, int64_t *index, const int64_t *shape) {
+  for (int i = ndim - 1; i >= 0; --i) {
+    if (++index[i] < shape[i]) {
+      return;
+    }
+    index[i] = 0;
+  }
+}
+
+/* Go to the next row of a cell (`index` in the `ndim - 1` first dims of `shape`), with `ind` the
+ * (block) item where it starts */
+static inline void next_row(int ndim, int64_t *index, const int64_t *shape, const int64_t *strides,
+                            int64_t *ind) {
+  for (int i = ndim - 2; i >= 0; --i) {
+    *ind += strides[i];
+    if (++index[i] < shape[i]) {
+      return;
+    }
+    *ind -= index[i] * strides[i];
+    index[i] = 0;
+  }
+}
+
+/* Replace the `n` floats of a (gathered) cell by their mean */
+static void fill_mean_float(uint8_t *cell, int64_t n) {
+  float sums[NDMEAN_LANES] = {0};
+  int64_t i = 0;
+  for (; i + NDMEAN_LANES <= n; i += NDMEAN_LANES) {
+    float values[NDMEAN_LANES];
+    memcpy(values, &cell[i * sizeof(float)], sizeof(values));
+    for (int l = 0; l < NDMEAN_LANES; l++) {
+      sums[l] += values[l];
+    }
+  }
+  float mean = 0;
+  for (int l = 0; l < NDMEAN_LANES; l++) {
+    mean += sums[l];
+  }
+  for (; i < n; i++) {
+    float value;
+    memcpy(&value, &cell[i * sizeof(float)], sizeof(float));
+    mean += value;
+  }
+  mean /= (float) n;
+  for (i = 0; i < n; i++) {
+    memcpy(&cell[i * sizeof(float)], &mean, sizeof(float));
+  }
+}
+
+/* Replace the `n` doubles of a (gathered) cell by their mean */
+static void fill_mean_double(uint8_t *cell, int64_t n) {
+  double sums[NDMEAN_LANES] = {0};
+  int64_t i = 0;
+  for (; i + NDMEAN_LANES <= n; i += NDMEAN_LANES) {
+    double values[NDMEAN_LANES];
+    memcpy(values, &cell[i * sizeof(double)], sizeof(values));
+    for (int l = 0; l < NDMEAN_LANES; l++) {
+      sums[l] += values[l];
+    }
+  }
+  double mean = 0;
+  for (int l = 0; l < NDMEAN_LANES; l++) {
+    mean += sums[l];
+  }
+  for (; i < n; i++) {
+    double value;
+    memcpy(&value, &cell[i * sizeof(double)], sizeof(double));
+    mean += value;
+  }
+  mean /= (double) n;
+  for (i = 0; i < n; i++) {
+    memcpy(&cell[i * sizeof(double)], &mean, sizeof(double));
+  }
+}
+
 
 int ndmean_forward(const uint8_t *input, uint8_t *output, int32_t length, uint8_t meta, blosc2_cparams *cparams,
                    uint8_t id) {
@@ -69,13 +151,9 @@ int ndmean_forward(const uint8_t *input, uint8_t *output, int32_t length, uint8_
   }
 
   uint8_t *ip = (uint8_t *) input;
-  float *ip_float = (float *) ip;
-  double *ip_double = (double *) ip;
   uint8_t *op = (uint8_t *) output;
   uint8_t *op_limit = op + length;
   int64_t cell_length;
-  float mean_float = 0;
-  double mean_double = 0;
 
 
   if (length < cell_size * typesize) {
@@ -98,16 +176,22 @@ int ndmean_forward(const uint8_t *input, uint8_t *output, int32_t length, uint8_
     ncells *= i_shape[i];
   }
 
+  int64_t blockstrides[NDMEAN_MAX_DIM];
+  blockstrides[ndim - 1] = 1;
+  for (int i = ndim - 2; i >= 0; --i) {
+    blockstrides[i] = blockstrides[i + 1] * blockshape[i + 1];
+  }
+
   /* main loop */
   int64_t pad_shape[NDMEAN_MAX_DIM];
-  int64_t ii[NDMEAN_MAX_DIM];
+  int64_t ii[NDMEAN_MAX_DIM] = {0};
   for (int cell_ind = 0; cell_ind < ncells; cell_ind++) {      // for each cell
-    blosc2_unidim_to_multidim(ndim, i_shape, cell_ind, ii);
-    uint32_t orig = 0;
-    int64_t nd_aux = (int64_t) (cellshape[0]);
-    for (int i = ndim - 1; i >= 0; i--) {
-      orig += ii[i] * nd_aux;
-      nd_aux *= blockshape[i];
+    if (cell_ind > 0) {
+      next_index(ndim, ii, i_shape);
+    }
+    int64_t orig = 0;
+    for (int i = 0; i < ndim; i++) {
+      orig += ii[i] * cellshape[0] * blockstrides[i];
     }
 
     for (int dim_ind = 0; dim_ind < ndim; dim_ind++) {
@@ -121,62 +205,30 @@ int ndmean_forward(const uint8_t *input, uint8_t *output, int32_t length, uint8_
     for (int i = 0; i < ndim - 1; ++i) {
       ncopies *= pad_shape[i];
     }
-    int64_t kk[8];
-    mean_float = 0;
-    mean_double = 0;
-    for (int copy_ind = 0; copy_ind < ncopies; ++copy_ind) {
-      blosc2_unidim_to_multidim((int8_t) (ndim - 1), pad_shape, copy_ind, kk);
-      nd_aux = blockshape[ndim - 1];
-      int64_t ind = orig;
-      for (int i = ndim - 2; i >= 0; i--) {
-        ind += kk[i] * nd_aux;
-        nd_aux *= blockshape[i];
-      }
-
-      switch (typesize) {
-        case 4:
-          for (int i = 0; i < pad_shape[ndim - 1]; i++) {
-            mean_float += ip_float[ind + i];
-          }
-          break;
-        case 8:
-          for (int i = 0; i < pad_shape[ndim - 1]; i++) {
-            mean_double += ip_double[ind + i];
-          }
-          break;
-        default :
-          break;
-      }
-
-    }
     cell_length = ncopies * pad_shape[ndim - 1];
-
-    switch (typesize) {
-      case 4:
-        mean_float /= (float) cell_length;
-        for (int i = 0; i < cell_length; i++) {
-          memcpy(op, &mean_float, typesize);
-          op += typesize;
-        }
-        break;
-      case 8:
-        mean_double /= (double) cell_length;
-        for (int i = 0; i < cell_length; i++) {
-          memcpy(op, &mean_double, typesize);
-          op += typesize;
-        }
-        break;
-      default :
-        break;
-    }
-
-    if (op > op_limit) {
+    if (op + cell_length * typesize > op_limit) {
       free(shape);
       free(chunkshape);
       free(blockshape);
       BLOSC_TRACE_ERROR("Exceeding output buffer limits!");
       return BLOSC2_ERROR_FAILURE;
     }
+
+    // Gather the rows of the cell in the output, and then get the mean out of it while it is hot
+    int64_t kk[NDMEAN_MAX_DIM] = {0};
+    int64_t ind = orig;
+    int64_t row_size = pad_shape[ndim - 1] * typesize;
+    uint8_t *cell = op;
+    for (int copy_ind = 0; copy_ind < ncopies; ++copy_ind) {
+      memcpy(op, &ip[ind * typesize], row_size);
+      op += row_size;
+      next_row(ndim, kk, pad_shape, blockstrides, &ind);
+    }
+    if (typesize == 4) {
+      fill_mean_float(cell, cell_length);
+    } else {
+      fill_mean_double(cell, cell_length);
+    }
   }
 
   free(shape);
@@ -260,9 +312,15 @@ int ndmean_backward(const uint8_t *input, uint8_t *output, int32_t length, uint8
     ncells *= i_shape[i];
   }
 
+  int64_t blockstrides[NDMEAN_MAX_DIM];
+  blockstrides[ndim - 1] = 1;
+  for (int i = ndim - 2; i >= 0; --i) {
+    blockstrides[i] = blockstrides[i + 1] * blockshape[i + 1];
+  }
+
   /* main loop */
   int64_t pad_shape[NDMEAN_MAX_DIM] = {0};
-  int64_t ii[NDMEAN_MAX_DIM];
+  int64_t ii[NDMEAN_MAX_DIM] = {0};
   int32_t ind = 0;
   for (int cell_ind = 0; cell_ind < ncells; cell_ind++) {      // for each cell
 
@@ -273,12 +331,12 @@ int ndmean_backward(const uint8_t *input, uint8_t *output, int32_t length, uint8
       BLOSC_TRACE_ERROR("Exceeding input length!");
       return BLOSC2_ERROR_FAILURE;
     }
-    blosc2_unidim_to_multidim(ndim, i_shape, cell_ind, ii);
-    uint32_t orig = 0;
-    int64_t nd_aux = (int64_t) (cellshape[0]);
-    for (int i = ndim - 1; i >= 0; i--) {
-      orig += ii[i] * nd_aux;
-      nd_aux *= blockshape[i];
+    if (cell_ind > 0) {
+      next_index(ndim, ii, i_shape);
+    }
+    int64_t orig = 0;
+    for (int i = 0; i < ndim; i++) {
+      orig += ii[i] * cellshape[0] * blockstrides[i];
     }
 
     for (int dim_ind = 0; dim_ind < ndim; dim_ind++) {
@@ -293,17 +351,15 @@ int ndmean_backward(const uint8_t *input, uint8_t *output, int32_t length, uint8
     for (int i = 0; i < ndim - 1; ++i) {
       ncopies *= pad_shape[i];
     }
-    int64_t kk[NDMEAN_MAX_DIM];
+    // Scatter the rows of the cell
+    int64_t kk[NDMEAN_MAX_DIM] = {0};
+    int64_t row_ind = orig;
+    int64_t row_size = pad_shape[ndim - 1] * typesize;
     for (int copy_ind = 0; copy_ind < ncopies; ++copy_ind) {
-      blosc2_unidim_to_multidim((int8_t) (ndim - 1), pad_shape, copy_ind, kk);
-      nd_aux = blockshape[ndim - 1];
-      ind = (int32_t) orig;
-      for (int i = ndim - 2; i >= 0; i--) {
-        ind += (int32_t) (kk[i] * nd_aux);
-        nd_aux *= blockshape[i];
-      }
-      memcpy(&op[ind * typesize], ip, pad_shape[ndim - 1] * typesize);
-      ip += pad_shape[ndim - 1] * typesize;
+      ind = (int32_t) row_ind;
+      memcpy(&op[ind * typesize], ip, row_size);
+      ip += row_size;
+      next_row(ndim, kk, pad_shape, blockstrides, &row_ind);
     }
   }
   ind += (int32_t) pad_shape[ndim - 1];
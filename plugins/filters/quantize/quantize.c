@@ -0,0 +1,531 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+// Quantize filter.  A lossy filter with an error bound, in the style of SZ: every float is
+// rounded to a multiple of a step (a power of two, so that the rounding is exact and the error
+// is at most half a step), and the integer multiples are predicted with the Lorenzo predictor
+// over the blockshape of the b2nd array.  Only the residuals of the prediction are kept, as
+// zigzagged integers of the size of the floats, so for smooth data most of their upper bytes
+// are zeros that a shuffle gathers for the codec.
+//
+// The Lorenzo residual is the composition of the differences along every dim, so the encoder
+// and the decoder are a lagged difference and a lagged (prefix) sum per dim, which are
+// vectorized.  Every value is checked against the bound in the encoder, with the same
+// arithmetic as the decoder, and the blocks that cannot keep it (non-finite values, or values
+// too large for the step) make the compression fail instead of losing more than asked.
+
+#include "quantize.h"
+#include "../plugins/plugin_utils.h"
+#include "blosc2/filters-registry.h"
+#include "blosc2.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#define QUANTIZE_HAS_SIMD
+typedef __m128i code_vec;
+
+static inline code_vec vec_load(const uint8_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void vec_store(uint8_t* p, code_vec x) { _mm_storeu_si128((__m128i*)p, x); }
+static inline code_vec vec_add(code_vec a, code_vec b, int32_t unit) {
+  return unit == 4 ? _mm_add_epi32(a, b) : _mm_add_epi64(a, b);
+}
+static inline code_vec vec_sub(code_vec a, code_vec b, int32_t unit) {
+  return unit == 4 ? _mm_sub_epi32(a, b) : _mm_sub_epi64(a, b);
+}
+
+/* The vector moved up by n bytes (a constant), with zeros coming in */
+#define VEC_SHIFT_UP(x, n) _mm_slli_si128(x, n)
+
+/* The last unit of x in every unit */
+static inline code_vec vec_last(code_vec x, int32_t unit) {
+  return unit == 4 ? _mm_shuffle_epi32(x, 0xFF) : _mm_unpackhi_epi64(x, x);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define QUANTIZE_HAS_SIMD
+typedef uint8x16_t code_vec;
+
+static inline code_vec vec_load(const uint8_t* p) { return vld1q_u8(p); }
+static inline void vec_store(uint8_t* p, code_vec x) { vst1q_u8(p, x); }
+static inline code_vec vec_add(code_vec a, code_vec b, int32_t unit) {
+  if (unit == 4) {
+    return vreinterpretq_u8_u32(vaddq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
+  }
+  return vreinterpretq_u8_u64(vaddq_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b)));
+}
+static inline code_vec vec_sub(code_vec a, code_vec b, int32_t unit) {
+  if (unit == 4) {
+    return vreinterpretq_u8_u32(vsubq_u32(vreinterpretq_u32_u8(a), vreinterpretq_u32_u8(b)));
+  }
+  return vreinterpretq_u8_u64(vsubq_u64(vreinterpretq_u64_u8(a), vreinterpretq_u64_u8(b)));
+}
+
+#define VEC_SHIFT_UP(x, n) vextq_u8(vdupq_n_u8(0), x, 16 - (n))
+
+static inline code_vec vec_last(code_vec x, int32_t unit) {
+  if (unit == 4) {
+    return vreinterpretq_u8_u32(vdupq_laneq_u32(vreinterpretq_u32_u8(x), 3));
+  }
+  return vreinterpretq_u8_u64(vdupq_laneq_u64(vreinterpretq_u64_u8(x), 1));
+}
+#endif
+
+#if defined(QUANTIZE_HAS_SIMD)
+/* The unit at p in every unit */
+static inline code_vec vec_load_unit(const uint8_t* p, int32_t unit) {
+  uint8_t units[16];
+  for (int32_t i = 0; i < 16; i += unit) {
+    memcpy(units + i, p, unit);
+  }
+  return vec_load(units);
+}
+
+/* The sum of every unit of x with all the previous ones (Kogge-Stone) */
+static inline code_vec vec_prefix_sum(code_vec x, int32_t unit) {
+  if (unit == 4) {
+    x = vec_add(x, VEC_SHIFT_UP(x, 4), unit);
+  }
+  return vec_add(x, VEC_SHIFT_UP(x, 8), unit);
+}
+#endif  /* QUANTIZE_HAS_SIMD */
+
+/* The meta: the exponent of the bound (10^exp) in the low 7 bits, and whether it is relative */
+#define QUANTIZE_RELATIVE 0x80
+
+/* The step of relative bounds is kept in the low bits of the second code, with an offset */
+#define KBITS(unit) ((unit) == 4 ? 8 : 16)
+#define KOFFSET(unit) ((unit) == 4 ? 192 : 32768)
+
+/* Values (in steps) that give exact integers when rounded */
+#define LIMIT_FLOAT 2147483647.
+#define LIMIT_DOUBLE 2251799813685248.  // 2^51
+#define ROUND_MAGIC 6755399441055744.  // 1.5 * 2^52
+
+
+static inline int bound_exponent(uint8_t meta) {
+  return (int8_t) (uint8_t) (meta << 1) >> 1;
+}
+
+
+/* v rounded to the nearest integer (ties to even), for |v| < 2^51 */
+static inline double round_even(double v) {
+#if FLT_EVAL_METHOD == 0
+  // Vectorizable, unlike rint()
+  return (v + ROUND_MAGIC) - ROUND_MAGIC;
+#else
+  return rint(v);
+#endif
+}
+
+
+static inline uint64_t get_code(const uint8_t* codes, int64_t i, int32_t unit) {
+  if (unit == 4) {
+    uint32_t code;
+    memcpy(&code, codes + i * 4, sizeof(code));
+    return code;
+  }
+  uint64_t code;
+  memcpy(&code, codes + i * 8, sizeof(code));
+  return code;
+}
+
+static inline void set_code(uint8_t* codes, int64_t i, uint64_t code, int32_t unit) {
+  if (unit == 4) {
+    uint32_t code32 = (uint32_t) code;
+    memcpy(codes + i * 4, &code32, sizeof(code32));
+  }
+  else {
+    memcpy(codes + i * 8, &code, sizeof(code));
+  }
+}
+
+
+/* Round the floats to multiples of 2^k from base, checking that they keep the bound */
+static bool quantize_float(const uint8_t* input, uint8_t* codes, int64_t nelems, double base, int k,
+                           double bound) {
+  double scale = ldexp(1, -k);
+  double step = ldexp(1, k);
+  bool ok = true;
+  for (int64_t i = 0; i < nelems; i++) {
+    float x;
+    memcpy(&x, input + i * sizeof(float), sizeof(float));
+    double v = ((double) x - base) * scale;
+    bool in_range = fabs(v) < LIMIT_FLOAT;  // false for NaNs
+    double q = round_even(in_range ? v : 0);
+    float rec = (float) (base + q * step);
+    ok &= in_range & (fabs((double) rec - (double) x) <= bound);
+    int32_t code = (int32_t) q;
+    memcpy(codes + i * sizeof(int32_t), &code, sizeof(code));
+  }
+  return ok;
+}
+
+static bool quantize_double(const uint8_t* input, uint8_t* codes, int64_t nelems, double base, int k,
+                            double bound) {
+  double scale = ldexp(1, -k);
+  double step = ldexp(1, k);
+  bool ok = true;
+  for (int64_t i = 0; i < nelems; i++) {
+    double x;
+    memcpy(&x, input + i * sizeof(double), sizeof(double));
+    double v = (x - base) * scale;
+    bool in_range = fabs(v) < LIMIT_DOUBLE;
+    double q = round_even(in_range ? v : 0);
+    double rec = base + q * step;
+    ok &= in_range & (fabs(rec - x) <= bound);
+    int64_t code = (int64_t) q;
+    memcpy(codes + i * sizeof(int64_t), &code, sizeof(code));
+  }
+  return ok;
+}
+
+
+/* The inverse of the quantization, in place (with the same arithmetic as the check above) */
+static void dequantize_float(uint8_t* data, int64_t nelems, double base, int k) {
+  double step = ldexp(1, k);
+  for (int64_t i = 0; i < nelems; i++) {
+    int32_t code;
+    memcpy(&code, data + i * sizeof(int32_t), sizeof(code));
+    float x = (float) (base + (double) code * step);
+    memcpy(data + i * sizeof(float), &x, sizeof(x));
+  }
+}
+
+static void dequantize_double(uint8_t* data, int64_t nelems, double base, int k) {
+  double step = ldexp(1, k);
+  for (int64_t i = 0; i < nelems; i++) {
+    int64_t code;
+    memcpy(&code, data + i * sizeof(int64_t), sizeof(code));
+    double x = base + (double) code * step;
+    memcpy(data + i * sizeof(double), &x, sizeof(x));
+  }
+}
+
+
+/* codes[i] -= codes[i - lag] for the elements from lag to nelems, in place (from the end, so
+ * that the previous elements are still the original ones when they are read) */
+static void diff_lagged(uint8_t* codes, int64_t nelems, int64_t lag, int32_t unit) {
+  int64_t i = nelems;  // the elements from i on are done
+#if defined(__AVX2__)
+  for (; i - 32 / unit >= lag; i -= 32 / unit) {
+    uint8_t* p = codes + (i - 32 / unit) * unit;
+    __m256i x = _mm256_loadu_si256((const __m256i*)p);
+    __m256i prev = _mm256_loadu_si256((const __m256i*)(p - lag * unit));
+    x = unit == 4 ? _mm256_sub_epi32(x, prev) : _mm256_sub_epi64(x, prev);
+    _mm256_storeu_si256((__m256i*)p, x);
+  }
+#endif
+#if defined(QUANTIZE_HAS_SIMD)
+  for (; i - 16 / unit >= lag; i -= 16 / unit) {
+    uint8_t* p = codes + (i - 16 / unit) * unit;
+    vec_store(p, vec_sub(vec_load(p), vec_load(p - lag * unit), unit));
+  }
+#endif
+  for (i--; i >= lag; i--) {
+    set_code(codes, i, get_code(codes, i, unit) - get_code(codes, i - lag, unit), unit);
+  }
+}
+
+
+/* codes[i] += codes[i - lag] for the elements from lag to nelems, in place */
+static void sum_lagged(uint8_t* codes, int64_t nelems, int64_t lag, int32_t unit) {
+  int64_t i = lag;
+#if defined(QUANTIZE_HAS_SIMD)
+  int64_t lanes = 16 / unit;
+  if (lag >= lanes) {
+    // The previous elements are summed already for all the lanes of a vector
+#if defined(__AVX2__)
+    if (lag >= 32 / unit) {
+      for (; i + 32 / unit <= nelems; i += 32 / unit) {
+        uint8_t* p = codes + i * unit;
+        __m256i x = _mm256_loadu_si256((const __m256i*)p);
+        __m256i prev = _mm256_loadu_si256((const __m256i*)(p - lag * unit));
+        x = unit == 4 ? _mm256_add_epi32(x, prev) : _mm256_add_epi64(x, prev);
+        _mm256_storeu_si256((__m256i*)p, x);
+      }
+    }
+#endif
+    for (; i + lanes <= nelems; i += lanes) {
+      uint8_t* p = codes + i * unit;
+      vec_store(p, vec_add(vec_load(p), vec_load(p - lag * unit), unit));
+    }
+  }
+  else if (lag == 1 && nelems - i >= lanes) {
+    // Only the carry (the previous element in every lane) is in the dependency chain
+    code_vec carry = vec_load_unit(codes, unit);
+    for (; i + lanes <= nelems; i += lanes) {
+      uint8_t* p = codes + i * unit;
+      code_vec x = vec_add(vec_prefix_sum(vec_load(p), unit), carry, unit);
+      vec_store(p, x);
+      carry = vec_last(x, unit);
+    }
+  }
+#endif
+  for (; i < nelems; i++) {
+    set_code(codes, i, get_code(codes, i, unit) + get_code(codes, i - lag, unit), unit);
+  }
+}
+
+
+/* The Lorenzo residuals of the codes in a block of `shape` (or the codes back from them) */
+static void lorenzo(uint8_t* codes, int64_t nelems, int8_t ndim, const int64_t* shape, int32_t unit,
+                    bool inverse) {
+  int64_t stride = 1;
+  for (int i = ndim - 1; i >= 0; i--) {
+    int64_t slab = stride * shape[i];
+    if (shape[i] > 1) {
+      for (int64_t start = 0; start < nelems; start += slab) {
+        if (inverse) {
+          sum_lagged(codes + start * unit, slab, stride, unit);
+        }
+        else {
+          diff_lagged(codes + start * unit, slab, stride, unit);
+        }
+      }
+    }
+    stride = slab;
+  }
+}
+
+
+/* Small residuals of both signs to small unsigned codes: 0, -1, 1, -2, 2... */
+static void zigzag(uint8_t* codes, int64_t nelems, int32_t unit) {
+  if (unit == 4) {
+    for (int64_t i = 0; i < nelems; i++) {
+      uint32_t code;
+      memcpy(&code, codes + i * 4, sizeof(code));
+      code = (code << 1) ^ (0u - (code >> 31));
+      memcpy(codes + i * 4, &code, sizeof(code));
+    }
+  }
+  else {
+    for (int64_t i = 0; i < nelems; i++) {
+      uint64_t code;
+      memcpy(&code, codes + i * 8, sizeof(code));
+      code = (code << 1) ^ (0u - (code >> 63));
+      memcpy(codes + i * 8, &code, sizeof(code));
+    }
+  }
+}
+
+static void unzigzag(uint8_t* codes, int64_t nelems, int32_t unit) {
+  if (unit == 4) {
+    for (int64_t i = 0; i < nelems; i++) {
+      uint32_t code;
+      memcpy(&code, codes + i * 4, sizeof(code));
+      code = (code >> 1) ^ (0u - (code & 1));
+      memcpy(codes + i * 4, &code, sizeof(code));
+    }
+  }
+  else {
+    for (int64_t i = 0; i < nelems; i++) {
+      uint64_t code;
+      memcpy(&code, codes + i * 8, sizeof(code));
+      code = (code >> 1) ^ (0u - (code & 1));
+      memcpy(codes + i * 8, &code, sizeof(code));
+    }
+  }
+}
+
+
+/* The shape of a block: the blockshape of the b2nd array or, for other data, a single dim */
+static int8_t get_blockshape(blosc2_schunk* schunk, int64_t nelems, int64_t* shape) {
+  uint8_t* smeta;
+  int32_t smeta_len;
+  if (schunk != NULL && blosc2_meta_exists(schunk, "b2nd") >= 0 &&
+      blosc2_meta_get(schunk, "b2nd", &smeta, &smeta_len) >= 0) {
+    int8_t ndim;
+    int64_t array_shape[QUANTIZE_MAX_DIM];
+    int32_t chunkshape[QUANTIZE_MAX_DIM];
+    int32_t blockshape[QUANTIZE_MAX_DIM];
+    deserialize_meta(smeta, smeta_len, &ndim, array_shape, chunkshape, blockshape);
+    free(smeta);
+    int64_t block_nitems = 1;
+    for (int i = 0; i < ndim; i++) {
+      block_nitems *= blockshape[i];
+    }
+    if (block_nitems == nelems) {
+      for (int i = 0; i < ndim; i++) {
+        shape[i] = blockshape[i];
+      }
+      return ndim;
+    }
+  }
+  shape[0] = nelems;
+  return 1;
+}
+
+
+/* The first element and the range of the values (NaNs aside) */
+static void get_range(const uint8_t* input, int64_t nelems, int32_t typesize, double* first,
+                      double* range) {
+  double min = INFINITY;
+  double max = -INFINITY;
+  for (int64_t i = 0; i < nelems; i++) {
+    double x;
+    if (typesize == 4) {
+      float xf;
+      memcpy(&xf, input + i * 4, sizeof(xf));
+      x = xf;
+    }
+    else {
+      memcpy(&x, input + i * 8, sizeof(x));
+    }
+    min = x < min ? x : min;
+    max = x > max ? x : max;
+    if (i == 0) {
+      *first = x;
+    }
+  }
+  *range = max - min;
+}
+
+
+int quantize_forward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                     blosc2_cparams* cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(id);
+
+  int32_t typesize = cparams->typesize;
+  if (typesize != 4 && typesize != 8) {
+    BLOSC_TRACE_ERROR("The quantize filter only works for float or double");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  // The bytes after the last whole element are kept as they are
+  int64_t nelems = length / typesize;
+  int32_t nbytes = (int32_t) nelems * typesize;
+  memcpy(output + nbytes, input + nbytes, length - nbytes);
+  if (nelems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  bool relative = meta & QUANTIZE_RELATIVE;
+  double bound = pow(10, bound_exponent(meta));
+  double base = 0;
+  int k;
+  if (relative) {
+    // Relative to the range of the block, from its first element (which is kept as it is)
+    double range;
+    get_range(input, nelems, typesize, &base, &range);
+    if (!isfinite(range)) {
+      BLOSC_TRACE_ERROR("The values of the block have no finite range");
+      return BLOSC2_ERROR_FAILURE;
+    }
+    bound *= range;
+    k = 0;
+    if (range > 0) {
+      frexp(bound, &k);
+      k--;  // the largest power of two not above the bound, which leaves room for the roundings
+    }
+    int32_t kmax = (1 << KBITS(typesize)) - 1 - KOFFSET(typesize);
+    k = k < -KOFFSET(typesize) ? -KOFFSET(typesize) : k > kmax ? kmax : k;
+  }
+  else {
+    frexp(bound, &k);  // the largest power of two not above twice the bound
+  }
+
+  bool ok = typesize == 4 ? quantize_float(input, output, nelems, base, k, bound) :
+                            quantize_double(input, output, nelems, base, k, bound);
+  if (!ok) {
+    BLOSC_TRACE_ERROR("Some values cannot keep the error bound (they are not finite or they are "
+                      "too large for it)");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  int64_t shape[QUANTIZE_MAX_DIM];
+  int8_t ndim = get_blockshape(cparams->schunk, nelems, shape);
+  lorenzo(output, nelems, ndim, shape, typesize, false);
+  zigzag(output, nelems, typesize);
+
+  if (relative) {
+    // The residual of the second element is the code of its value, so there is room for the step
+    if (nelems > 1) {
+      uint64_t code = get_code(output, 1, typesize);
+      if (code >> (8 * typesize - KBITS(typesize)) != 0) {
+        BLOSC_TRACE_ERROR("The values of the block are too far apart for the relative bound");
+        return BLOSC2_ERROR_FAILURE;
+      }
+      set_code(output, 1, (code << KBITS(typesize)) | (uint64_t) (k + KOFFSET(typesize)), typesize);
+    }
+    memcpy(output, input, typesize);
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int quantize_backward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                      blosc2_dparams* dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(id);
+
+  blosc2_schunk* schunk = dparams->schunk;
+  if (schunk == NULL) {
+    BLOSC_TRACE_ERROR("The quantize filter needs a super-chunk for the typesize");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  int32_t typesize = schunk->typesize;
+  if (typesize != 4 && typesize != 8) {
+    BLOSC_TRACE_ERROR("The quantize filter only works for float or double");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  int64_t nelems = length / typesize;
+  memcpy(output, input, length);
+  if (nelems == 0) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+
+  bool relative = meta & QUANTIZE_RELATIVE;
+  double base = 0;
+  int k = 0;
+  if (relative) {
+    if (typesize == 4) {
+      float first;
+      memcpy(&first, input, sizeof(first));
+      base = first;
+    }
+    else {
+      memcpy(&base, input, sizeof(base));
+    }
+    if (nelems > 1) {
+      uint64_t code = get_code(output, 1, typesize);
+      k = (int) (code & ((1u << KBITS(typesize)) - 1)) - KOFFSET(typesize);
+      set_code(output, 1, code >> KBITS(typesize), typesize);
+    }
+    set_code(output, 0, 0, typesize);
+  }
+  else {
+    frexp(pow(10, bound_exponent(meta)), &k);
+  }
+
+  unzigzag(output, nelems, typesize);
+  int64_t shape[QUANTIZE_MAX_DIM];
+  int8_t ndim = get_blockshape(schunk, nelems, shape);
+  lorenzo(output, nelems, ndim, shape, typesize, true);
+  if (typesize == 4) {
+    dequantize_float(output, nelems, base, k);
+  }
+  else {
+    dequantize_double(output, nelems, base, k);
+  }
+  if (relative) {
+    memcpy(output, input, typesize);  // with the sign of zeros too
+  }
+
+  return BLOSC2_ERROR_SUCCESS;
+}
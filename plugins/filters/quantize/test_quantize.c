@@ -0,0 +1,211 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test program for the quantize filter.  A smooth 3-dim field (like the
+    output of a simulation) is compressed in b2nd arrays with absolute and
+    relative error bounds, and a time series in a plain super-chunk.  The
+    errors are checked against the bounds, and the values that cannot keep
+    them must make the compression fail.
+
+    To run:
+
+    $ ./test_quantize
+    float, bound 1e-03: 1920000 -> 133523 (14.4x), max error 9.77e-04
+    ...
+    Successful roundtrip!
+
+**********************************************************************/
+
+#include "blosc2/filters-registry.h"
+#include "b2nd.h"
+#include "blosc2.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define D0 60
+#define D1 80
+#define D2 100
+#define NELEMS (D0 * D1 * D2)
+
+
+static double field(int64_t i, int64_t j, int64_t k) {
+  return sin((double) i / 9.) * cos((double) j / 13.) + 0.3 * sin((double) (j + k) / 21.) + 2.;
+}
+
+
+static void set_item(int32_t typesize, void *buffer, int64_t i, double value) {
+  if (typesize == 4) {
+    ((float *) buffer)[i] = (float) value;
+  }
+  else {
+    ((double *) buffer)[i] = value;
+  }
+}
+
+static double get_item(int32_t typesize, const void *buffer, int64_t i) {
+  return typesize == 4 ? ((const float *) buffer)[i] : ((const double *) buffer)[i];
+}
+
+
+static b2nd_context_t *create_ctx(int32_t typesize, uint8_t meta, blosc2_cparams *cparams,
+                                  blosc2_storage *storage) {
+  *cparams = (blosc2_cparams) BLOSC2_CPARAMS_DEFAULTS;
+  cparams->typesize = typesize;
+  cparams->compcode = BLOSC_ZSTD;
+  cparams->clevel = 5;
+  cparams->nthreads = 2;
+  cparams->filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_FILTER_QUANTIZE;
+  cparams->filters_meta[BLOSC2_MAX_FILTERS - 2] = meta;
+  cparams->filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_SHUFFLE;
+  *storage = (blosc2_storage) {.cparams = cparams};
+  int64_t shape[] = {D0, D1, D2};
+  int32_t chunkshape[] = {30, 40, 50};
+  int32_t blockshape[] = {10, 20, 25};
+  return b2nd_create_ctx(storage, 3, shape, chunkshape, blockshape,
+                         typesize == 4 ? "<f4" : "<f8", DTYPE_NUMPY_FORMAT, NULL, 0);
+}
+
+
+/* Compress the field with the bound in meta, and check the errors against `bound` */
+static int test_field(int32_t typesize, uint8_t meta, double bound, double min_ratio) {
+  blosc2_cparams cparams;
+  blosc2_storage storage;
+  b2nd_context_t *ctx = create_ctx(typesize, meta, &cparams, &storage);
+  int64_t nbytes = NELEMS * (int64_t) typesize;
+  uint8_t *buffer = malloc(nbytes);
+  uint8_t *dest = malloc(nbytes);
+  for (int64_t i = 0, n = 0; i < D0; i++) {
+    for (int64_t j = 0; j < D1; j++) {
+      for (int64_t k = 0; k < D2; k++, n++) {
+        set_item(typesize, buffer, n, field(i, j, k));
+      }
+    }
+  }
+
+  b2nd_array_t *array;
+  if (b2nd_from_cbuffer(ctx, &array, buffer, nbytes) < 0 || b2nd_to_cbuffer(array, dest, nbytes) < 0) {
+    printf("Cannot compress the field\n");
+    return -1;
+  }
+  double max_error = 0;
+  for (int64_t n = 0; n < NELEMS; n++) {
+    double error = fabs(get_item(typesize, dest, n) - get_item(typesize, buffer, n));
+    max_error = error > max_error ? error : max_error;
+  }
+  int64_t cbytes = array->sc->cbytes;
+  printf("%s, bound %.0e: %" PRId64 " -> %" PRId64 " (%.1fx), max error %.2e\n",
+         typesize == 4 ? "float" : "double", bound, nbytes, cbytes, (double) nbytes / (double) cbytes,
+         max_error);
+  if (max_error > bound) {
+    printf("The error bound is not kept\n");
+    return -1;
+  }
+  if ((double) nbytes / (double) cbytes < min_ratio) {
+    printf("The ratio should be at least %.0fx\n", min_ratio);
+    return -1;
+  }
+
+  // Values that cannot keep the bound are not compressed
+  set_item(typesize, buffer, 12345, NAN);
+  b2nd_array_t *wrong = NULL;
+  if (b2nd_from_cbuffer(ctx, &wrong, buffer, nbytes) >= 0) {
+    printf("NaNs are compressed\n");
+    return -1;
+  }
+  // The array is still created when its data cannot be set
+  if (wrong != NULL) {
+    b2nd_free(wrong);
+  }
+
+  b2nd_free(array);
+  b2nd_free_ctx(ctx);
+  free(buffer);
+  free(dest);
+  return 0;
+}
+
+
+/* A noisy time series in a super-chunk without b2nd metalayers, with a relative bound */
+static int test_series(int32_t typesize) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  cparams.compcode = BLOSC_LZ4;
+  cparams.blocksize = 4096 * typesize;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_FILTER_QUANTIZE;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 2] = BLOSC_QUANTIZE_REL(-4);
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_SHUFFLE;
+  blosc2_storage storage = {.cparams = &cparams};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+
+  int32_t nitems = 100 * 1000 + 3;
+  uint8_t *buffer = malloc(nitems * typesize);
+  uint8_t *dest = malloc(nitems * typesize);
+  for (int32_t i = 0; i < nitems; i++) {
+    set_item(typesize, buffer, i, 1e5 + 300. * sin(i * 1e-3) + (double) (i * 7919 % 1000) / 100.);
+  }
+  // A constant block and a block of zeros, which are kept as they are
+  for (int32_t i = 4096; i < 3 * 4096; i++) {
+    set_item(typesize, buffer, i, i < 2 * 4096 ? 3.25 : 0.);
+  }
+  int32_t chunk_nitems = nitems - nitems / 2;  // the last chunk cannot be larger
+  for (int nchunk = 0; nchunk < 2; nchunk++) {
+    int32_t size = (nchunk == 0 ? chunk_nitems : nitems - chunk_nitems) * typesize;
+    if (blosc2_schunk_append_buffer(schunk, buffer + nchunk * chunk_nitems * typesize, size) < 0 ||
+        blosc2_schunk_decompress_chunk(schunk, nchunk, dest + nchunk * chunk_nitems * typesize, size) != size) {
+      printf("Cannot compress the series\n");
+      return -1;
+    }
+  }
+  // Relative to the range of every block, which is at most the range of the series
+  double max_error = 0;
+  for (int32_t i = 0; i < nitems; i++) {
+    double error = fabs(get_item(typesize, dest, i) - get_item(typesize, buffer, i));
+    max_error = error > max_error ? error : max_error;
+  }
+  if (max_error > 1e-4 * 610. || memcmp(dest + 4096 * typesize, buffer + 4096 * typesize, 2 * 4096 * typesize) != 0) {
+    printf("The relative bound is not kept (max error %.2e)\n", max_error);
+    return -1;
+  }
+  printf("%s series, relative bound 1e-04: %d -> %" PRId64 " (%.1fx)\n", typesize == 4 ? "float" : "double",
+         nitems * typesize, schunk->cbytes, (double) nitems * typesize / (double) schunk->cbytes);
+
+  blosc2_schunk_free(schunk);
+  free(buffer);
+  free(dest);
+  return 0;
+}
+
+
+int main(void) {
+  blosc2_init();
+  int rc = 0;
+  int32_t typesizes[] = {4, 8};
+  for (int n = 0; n < 2 && rc == 0; n++) {
+    rc = test_field(typesizes[n], BLOSC_QUANTIZE_ABS(-3), 1e-3, 10.);
+    if (rc == 0) {
+      rc = test_field(typesizes[n], BLOSC_QUANTIZE_ABS(-5), 1e-5, 3.);
+    }
+    if (rc == 0) {
+      rc = test_field(typesizes[n], BLOSC_QUANTIZE_REL(-3), 1e-3 * 2.6, 10.);
+    }
+    if (rc == 0) {
+      rc = test_series(typesizes[n]);
+    }
+  }
+  if (rc == 0) {
+    printf("Successful roundtrip!\n");
+  }
+  blosc2_destroy();
+  return rc;
+}
@@ -0,0 +1,369 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+// RLE filter.  A run-length encoding of the elements (of the typesize) of a block, for the
+// runs of the same value inside the blocks (like padding, or the masked regions of rasters),
+// which the special values of chunks and the runs of whole blocks do not cover.  The block is
+// replaced by segments: the values (the element of every run, and the literal elements) from
+// the start of the block, so that they keep the alignment of the elements for the split of the
+// streams (or a shuffle), then the token of every segment (a LEB128 varint of its count of
+// elements, and whether they are a run), and a header at the end of the block.  The rest of
+// the block (filters cannot shrink it) is left as zeros.
+//
+// The blocks that do not fit in their length encoded this way are kept as they are.  As there
+// is no room for telling them apart, the encoded blocks end with a magic and a hash of their
+// header (and length), and the encoder gives up on the (very unlikely) blocks that would be
+// taken for encoded ones.
+//
+// The encoder compares every element with the previous one a vector at a time (for the
+// typesizes that divide 16), and the decoder fills the runs a vector of copies at a time.
+
+#include "rle.h"
+#include "../plugins/plugin_utils.h"
+#include "checksum.h"
+#include "blosc2/filters-registry.h"
+#include "blosc2.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#define RLE_HAS_SIMD
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define RLE_HAS_SIMD
+#endif
+
+#define RLE_MAGIC 0x454C5254u  // "TRLE" in little endian
+#define RLE_HEADER_SIZE 20
+// Runs are only worth their token when they save more bytes than these
+#define RLE_MIN_SAVING 8
+
+
+#if defined(RLE_HAS_SIMD)
+#if defined(__AVX2__)
+#define RLE_VEC_BYTES 32
+#define RLE_BITS_PER_BYTE 1
+#else
+#define RLE_VEC_BYTES 16
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define RLE_BITS_PER_BYTE 4
+#else
+#define RLE_BITS_PER_BYTE 1
+#endif
+#endif
+
+/* The mask of the bytes at p that are equal to the ones `typesize` bytes before,
+   with RLE_BITS_PER_BYTE bits per byte */
+static inline uint64_t equal_bytes(const uint8_t* p, int32_t typesize) {
+#if defined(__AVX2__)
+  __m256i cmp = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p),
+                                  _mm256_loadu_si256((const __m256i*)(p - typesize)));
+  return (uint32_t) _mm256_movemask_epi8(cmp);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  uint8x16_t cmp = vceqq_u8(vld1q_u8(p), vld1q_u8(p - typesize));
+  /* Narrow the comparison to 4 bits per byte, as NEON lacks a movemask */
+  uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+#else
+  __m128i cmp = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p),
+                               _mm_loadu_si128((const __m128i*)(p - typesize)));
+  return (uint32_t) _mm_movemask_epi8(cmp);
+#endif
+}
+#endif  // RLE_HAS_SIMD
+
+
+/* Number of trailing zero bits of a non-zero value */
+static inline int32_t rle_ctz(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long r;
+  _BitScanForward64(&r, x);
+  return (int32_t) r;
+#elif defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  int32_t r = 0;
+  while (!(x & 1U)) {
+    x >>= 1U;
+    r++;
+  }
+  return r;
+#endif
+}
+
+
+/* The first element from `i` (at least 1) that is (or is not, if `!equal`) the same as the
+   previous one, or `nelems` if there is none */
+static int32_t find_change(const uint8_t* x, int32_t nelems, int32_t typesize, int32_t i, bool equal) {
+#if defined(RLE_HAS_SIMD)
+  if (RLE_VEC_BYTES % typesize == 0) {
+    const int32_t bits = typesize * RLE_BITS_PER_BYTE;
+    const uint64_t valid = RLE_VEC_BYTES * RLE_BITS_PER_BYTE == 64 ? UINT64_MAX :
+                           (UINT64_C(1) << (RLE_VEC_BYTES * RLE_BITS_PER_BYTE)) - 1;
+    // The first bit of every element
+    uint64_t starts = 0;
+    for (int32_t k = 0; k < RLE_VEC_BYTES * RLE_BITS_PER_BYTE; k += bits) {
+      starts |= UINT64_C(1) << k;
+    }
+    for (; (int64_t) (i + RLE_VEC_BYTES / typesize) <= nelems; i += RLE_VEC_BYTES / typesize) {
+      uint64_t mask = equal_bytes(x + i * typesize, typesize);
+      uint64_t found;
+      if (equal) {
+        // The elements whose bytes are all equal
+        for (int32_t shift = RLE_BITS_PER_BYTE; shift < bits; shift <<= 1) {
+          mask &= mask >> shift;
+        }
+        found = mask & starts;
+      }
+      else {
+        found = ~mask & valid;
+      }
+      if (found != 0) {
+        return i + rle_ctz(found) / bits;
+      }
+    }
+  }
+#endif
+  for (; i < nelems; i++) {
+    if ((memcmp(x + i * typesize, x + (i - 1) * typesize, typesize) == 0) == equal) {
+      return i;
+    }
+  }
+  return nelems;
+}
+
+
+/* Fill `count` copies of the element at `value` */
+static void fill_run(uint8_t* dest, const uint8_t* value, int32_t count, int32_t typesize) {
+  int64_t nbytes = (int64_t) count * typesize;
+  if (16 % typesize == 0 && nbytes >= 16) {
+    uint8_t pattern[16];
+    for (int32_t k = 0; k < 16; k += typesize) {
+      memcpy(pattern + k, value, typesize);
+    }
+    int64_t k = 0;
+    for (; k + 16 <= nbytes; k += 16) {
+      memcpy(dest + k, pattern, 16);
+    }
+    memcpy(dest + k, pattern, nbytes - k);
+    return;
+  }
+  // Double the copies made so far
+  memcpy(dest, value, typesize);
+  for (int64_t done = typesize; done < nbytes; done *= 2) {
+    memcpy(dest + done, dest, done < nbytes - done ? done : nbytes - done);
+  }
+}
+
+
+static inline uint32_t load_u32(const uint8_t* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static inline void store_u32(uint8_t* p, uint32_t u) {
+  p[0] = (uint8_t) u;
+  p[1] = (uint8_t) (u >> 8);
+  p[2] = (uint8_t) (u >> 16);
+  p[3] = (uint8_t) (u >> 24);
+}
+
+
+/* The hash of the first 16 bytes of the header and the length of the block */
+static uint32_t header_check(const uint8_t* header, int32_t length) {
+  uint8_t buffer[RLE_HEADER_SIZE];
+  memcpy(buffer, header, 16);
+  store_u32(buffer + 16, (uint32_t) length);
+  return (uint32_t) checksum_xxh3(buffer, RLE_HEADER_SIZE);
+}
+
+/* Whether the block of `length` bytes is run-length encoded, and if so, its parameters */
+static bool parse_header(const uint8_t* block, int32_t length, int32_t* typesize, int32_t* nvalues,
+                         int32_t* ntokens) {
+  if (length < RLE_HEADER_SIZE) {
+    return false;
+  }
+  const uint8_t* header = block + length - RLE_HEADER_SIZE;
+  if (load_u32(header) != RLE_MAGIC || load_u32(header + 16) != header_check(header, length)) {
+    return false;
+  }
+  *typesize = header[4];
+  *nvalues = (int32_t) load_u32(header + 8);
+  *ntokens = (int32_t) load_u32(header + 12);
+  return *typesize > 0 && *nvalues >= 0 && *ntokens >= 0 &&
+         (int64_t) *nvalues * *typesize + *ntokens + length % *typesize + RLE_HEADER_SIZE <= length;
+}
+
+
+/* The segments of the block, with the values (the element of every run, and the literal
+   elements) in `vp` and the tokens in `tp`, up to `vend` and `tend` */
+typedef struct {
+  uint8_t* vp;
+  uint8_t* tp;
+  const uint8_t* vend;
+  const uint8_t* tend;
+} rle_segments;
+
+/* Append a segment of `count` elements from `x`, which are a run or literal ones */
+static bool put_segment(rle_segments* seg, const uint8_t* x, int32_t count, bool run, int32_t typesize) {
+  if (count == 0) {
+    return true;
+  }
+  int64_t nbytes = run ? typesize : (int64_t) count * typesize;
+  if (seg->vend - seg->vp < nbytes) {
+    return false;
+  }
+  memcpy(seg->vp, x, nbytes);
+  seg->vp += nbytes;
+  uint32_t token = (uint32_t) count << 1 | run;
+  do {
+    if (seg->tp == seg->tend) {
+      return false;
+    }
+    uint8_t byte = token & 0x7F;
+    token >>= 7;
+    *seg->tp++ = (uint8_t) (byte | (token ? 0x80 : 0));
+  } while (token);
+  return true;
+}
+
+/* Encode the block if its segments fit, returning whether they did */
+static bool encode(const uint8_t* input, uint8_t* output, int32_t length, int32_t typesize) {
+  int32_t nelems = length / typesize;
+  int32_t tail = length % typesize;
+  int32_t room = length - tail - RLE_HEADER_SIZE;
+  if (nelems == 0 || room <= 0) {
+    return false;
+  }
+  // The tokens go after the values, so they are gathered apart
+  uint8_t* tokens = malloc(room);
+  if (tokens == NULL) {
+    return false;
+  }
+  rle_segments seg = {output, tokens, output + room, tokens + room};
+  int32_t literal = 0;  // the start of the literal elements
+  int32_t i = 1;
+  bool fits = true;
+  while (fits && i < nelems) {
+    int32_t start = find_change(input, nelems, typesize, i, true) - 1;
+    if (start + 1 == nelems) {
+      break;
+    }
+    int32_t stop = find_change(input, nelems, typesize, start + 2, false);
+    if ((int64_t) (stop - start - 1) * typesize > RLE_MIN_SAVING) {
+      fits = put_segment(&seg, input + literal * typesize, start - literal, false, typesize) &&
+             put_segment(&seg, input + start * typesize, stop - start, true, typesize);
+      literal = stop;
+    }
+    i = stop + 1;
+  }
+  fits = fits && put_segment(&seg, input + literal * typesize, nelems - literal, false, typesize);
+  int32_t ntokens = (int32_t) (seg.tp - tokens);
+  fits = fits && seg.vend - seg.vp >= ntokens;
+
+  if (fits) {
+    int32_t nvalues = (int32_t) (seg.vp - output) / typesize;
+    uint8_t* op = seg.vp;
+    memcpy(op, tokens, ntokens);
+    op += ntokens;
+    memcpy(op, input + nelems * typesize, tail);
+    op += tail;
+    uint8_t* header = output + length - RLE_HEADER_SIZE;
+    memset(op, 0, header - op);
+    store_u32(header, RLE_MAGIC);
+    header[4] = (uint8_t) typesize;
+    header[5] = header[6] = header[7] = 0;
+    store_u32(header + 8, (uint32_t) nvalues);
+    store_u32(header + 12, (uint32_t) ntokens);
+    store_u32(header + 16, header_check(header, length));
+  }
+  free(tokens);
+  return fits;
+}
+
+
+int rle_forward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                blosc2_cparams* cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(id);
+
+  int32_t typesize = cparams->typesize;
+  if (typesize <= 255 && encode(input, output, length, typesize)) {
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  // Not enough runs, so the block is kept as it is
+  memcpy(output, input, length);
+  int32_t ts, nvalues, ntokens;
+  if (parse_header(output, length, &ts, &nvalues, &ntokens)) {
+    BLOSC_TRACE_ERROR("The block cannot be told apart from a run-length encoded one");
+    return BLOSC2_ERROR_FAILURE;
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int rle_backward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                 blosc2_dparams* dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(id);
+
+  int32_t typesize, nvalues, ntokens;
+  if (!parse_header(input, length, &typesize, &nvalues, &ntokens)) {
+    memcpy(output, input, length);
+    return BLOSC2_ERROR_SUCCESS;
+  }
+  int32_t nelems = length / typesize;
+  const uint8_t* vp = input;
+  const uint8_t* vend = input + nvalues * typesize;
+  const uint8_t* ip = vend;
+  const uint8_t* end = ip + ntokens;
+  int32_t n = 0;
+  while (ip < end) {
+    uint32_t token = 0;
+    int shift = 0;
+    do {
+      if (ip == end || shift > 28) {
+        BLOSC_TRACE_ERROR("Truncated token of a segment");
+        return BLOSC2_ERROR_DATA;
+      }
+      token |= (uint32_t) (*ip & 0x7F) << shift;
+      shift += 7;
+    } while (*ip++ & 0x80);
+    int32_t count = (int32_t) (token >> 1);
+    bool run = token & 1;
+    int64_t nbytes = run ? typesize : (int64_t) count * typesize;
+    if (count == 0 || count > nelems - n || vend - vp < nbytes) {
+      BLOSC_TRACE_ERROR("The segments do not match the length of the block");
+      return BLOSC2_ERROR_DATA;
+    }
+    if (run) {
+      fill_run(output + n * typesize, vp, count, typesize);
+    }
+    else {
+      memcpy(output + n * typesize, vp, nbytes);
+    }
+    vp += nbytes;
+    n += count;
+  }
+  if (n != nelems || vp != vend) {
+    BLOSC_TRACE_ERROR("The segments do not match the length of the block");
+    return BLOSC2_ERROR_DATA;
+  }
+  memcpy(output + nelems * typesize, end, length % typesize);
+
+  return BLOSC2_ERROR_SUCCESS;
+}
@@ -0,0 +1,217 @@
+/*********************************************************************
+    Blosc - Blocked Shuffling and Compression Library
+
+    Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+    https://blosc.org
+    License: BSD 3-Clause (see LICENSE.txt)
+
+    See LICENSE.txt for details about copyright and rights to use.
+
+    Test program for the rle filter.  Blocks with runs of every length (or
+    none) are encoded and decoded for several typesizes, and a masked
+    raster (with nodata values out of a circle) is compressed with the
+    filter and without it.
+
+    To run:
+
+    $ ./test_rle
+    rle: 4000000 -> 1537286 (2.6x), shuffle: 4000000 -> 1551506 (2.6x)
+    Successful roundtrip!
+
+**********************************************************************/
+
+#include "blosc2/filters-registry.h"
+#include "rle.h"
+#include "blosc2.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SIDE 1000
+
+static uint32_t seed = 1;
+
+static uint32_t next_random(void) {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+
+/* Encode and decode a block of `nelems` elements in runs of up to `max_run`, with a few
+   bytes more, and check whether it is `encoded` (if not negative) */
+static int roundtrip(int32_t typesize, int32_t nelems, int32_t max_run, int encoded) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  int32_t length = nelems * typesize + typesize / 2;
+  uint8_t* input = malloc(length + 1);
+  uint8_t* encoded_block = malloc(length + 1);
+  uint8_t* output = malloc(length + 1);
+  for (int32_t i = 0; i < nelems;) {
+    int32_t run = (int32_t) (next_random() % max_run) + 1;
+    uint8_t value[16];
+    for (int32_t k = 0; k < typesize; k++) {
+      value[k] = (uint8_t) next_random();
+    }
+    for (; run > 0 && i < nelems; run--, i++) {
+      memcpy(input + i * typesize, value, typesize);
+    }
+  }
+  for (int32_t i = nelems * typesize; i < length; i++) {
+    input[i] = (uint8_t) i;
+  }
+  if (rle_forward(input, encoded_block, length, 0, &cparams, BLOSC_FILTER_RLE) < 0 ||
+      rle_backward(encoded_block, output, length, 0, &dparams, BLOSC_FILTER_RLE) < 0) {
+    printf("Cannot encode the block\n");
+    return -1;
+  }
+  if (memcmp(input, output, length) != 0) {
+    printf("The block of %d elements of %d bytes is not decoded right\n", nelems, typesize);
+    return -1;
+  }
+  bool is_encoded = length >= 20 && memcmp(encoded_block + length - 20, "TRLE", 4) == 0;
+  if (encoded >= 0 && is_encoded != encoded) {
+    printf("The block of %d elements in runs of up to %d should%s be encoded\n", nelems, max_run,
+           encoded ? "" : " not");
+    return -1;
+  }
+  free(input);
+  free(encoded_block);
+  free(output);
+  return 0;
+}
+
+
+static int test_blocks(void) {
+  int32_t typesizes[] = {1, 2, 3, 4, 8, 12, 16};
+  for (int n = 0; n < 7; n++) {
+    int32_t typesize = typesizes[n];
+    for (int32_t nelems = 0; nelems < 100; nelems++) {
+      if (roundtrip(typesize, nelems, 1, 0) < 0 || roundtrip(typesize, nelems, 5, -1) < 0 ||
+          roundtrip(typesize, nelems, 1000, -1) < 0) {
+        return -1;
+      }
+    }
+    if (roundtrip(typesize, 10000, 1, 0) < 0 || roundtrip(typesize, 10000, 100, 1) < 0 ||
+        roundtrip(typesize, 10000, 10000, 1) < 0 || roundtrip(typesize, 10000, 40, -1) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+/* The blocks kept as they are cannot look like encoded ones, and wrong segments are detected */
+static int test_wrong(void) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 4;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  int32_t nelems = 1000;
+  uint32_t* values = malloc(nelems * 4);
+  uint8_t* encoded_block = malloc(nelems * 4);
+  for (int32_t i = 0; i < nelems; i++) {
+    values[i] = i < 500 ? 0 : 1;
+  }
+  if (rle_forward((uint8_t*) values, encoded_block, nelems * 4, 0, &cparams, BLOSC_FILTER_RLE) < 0) {
+    printf("Cannot encode the block\n");
+    return -1;
+  }
+  // Distinct values before an encoded header
+  for (int32_t i = 0; i < nelems - 5; i++) {
+    values[i] = i;
+  }
+  memcpy(values + nelems - 5, encoded_block + nelems * 4 - 20, 20);
+  if (rle_forward((uint8_t*) values, encoded_block, nelems * 4, 0, &cparams, BLOSC_FILTER_RLE) >= 0) {
+    printf("An ambiguous block is kept\n");
+    return -1;
+  }
+
+  // A run too long for the block
+  for (int32_t i = 0; i < nelems; i++) {
+    values[i] = i < 500 ? 0 : 1;
+  }
+  rle_forward((uint8_t*) values, encoded_block, nelems * 4, 0, &cparams, BLOSC_FILTER_RLE);
+  encoded_block[2 * 4] ^= 0x02;  // the first token, after the values of the two runs
+  if (rle_backward(encoded_block, (uint8_t*) values, nelems * 4, 0, &dparams, BLOSC_FILTER_RLE) >= 0) {
+    printf("Wrong segments are decoded\n");
+    return -1;
+  }
+  free(values);
+  free(encoded_block);
+  return 0;
+}
+
+
+static int64_t compress(float* values, float* dest, uint8_t filter) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 4;
+  cparams.compcode = BLOSC_LZ4;
+  cparams.nthreads = 2;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = filter;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_SHUFFLE;
+  blosc2_storage storage = {.cparams = &cparams};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  if (blosc2_schunk_append_buffer(schunk, values, SIDE * SIDE * 4) < 0 ||
+      blosc2_schunk_decompress_chunk(schunk, 0, dest, SIDE * SIDE * 4) != SIDE * SIDE * 4) {
+    printf("Cannot compress the raster\n");
+    return -1;
+  }
+  int64_t cbytes = schunk->cbytes;
+  blosc2_schunk_free(schunk);
+  return cbytes;
+}
+
+
+/* A raster of a noisy slope in a circle, with nodata values out of it.  The runs of nodata
+   values would be spread over the shuffled streams, and are collapsed before instead. */
+static int test_raster(void) {
+  float* values = malloc(SIDE * SIDE * 4);
+  float* dest = malloc(SIDE * SIDE * 4);
+  for (int32_t i = 0; i < SIDE; i++) {
+    for (int32_t j = 0; j < SIDE; j++) {
+      int32_t di = i - SIDE / 2, dj = j - SIDE / 2;
+      bool masked = di * di + dj * dj > SIDE * SIDE / 5;
+      values[i * SIDE + j] = masked ? -9999.f : 100.f + (float) (i * 0.37 + j * 0.21) + (float) (next_random() % 100) / 100.f;
+    }
+  }
+  int64_t cbytes = compress(values, dest, BLOSC_FILTER_RLE);
+  if (cbytes < 0 || memcmp(values, dest, SIDE * SIDE * 4) != 0) {
+    printf("The raster is not decoded right\n");
+    return -1;
+  }
+  int64_t shuffle_cbytes = compress(values, dest, BLOSC_NOFILTER);
+  if (shuffle_cbytes < 0) {
+    return -1;
+  }
+  printf("rle: %d -> %" PRId64 " (%.1fx), shuffle: %d -> %" PRId64 " (%.1fx)\n",
+         SIDE * SIDE * 4, cbytes, (double) SIDE * SIDE * 4 / (double) cbytes,
+         SIDE * SIDE * 4, shuffle_cbytes, (double) SIDE * SIDE * 4 / (double) shuffle_cbytes);
+  if (cbytes > shuffle_cbytes) {
+    printf("The rle filter should not compress the raster worse than the shuffle\n");
+    return -1;
+  }
+  free(values);
+  free(dest);
+  return 0;
+}
+
+
+int main(void) {
+  blosc2_init();
+  int rc = test_blocks();
+  if (rc == 0) {
+    rc = test_wrong();
+  }
+  if (rc == 0) {
+    rc = test_raster();
+  }
+  if (rc == 0) {
+    printf("Successful roundtrip!\n");
+  }
+  blosc2_destroy();
+  return rc;
+}
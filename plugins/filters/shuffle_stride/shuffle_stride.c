@@ -0,0 +1,46 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+// Shuffle stride filter.  The byte-wise shuffle, with the size of the items in the meta instead
+// of the typesize of the chunk, so that a chunk of bytes (typesize 1) of wider items can still be
+// shuffled and keep counting bytes for getitem and slices.  This is what the chunks go with when
+// the stride is guessed (see blosc2_cparams.detect_typesize).
+
+#include "shuffle_stride.h"
+#include "shuffle.h"
+#include "blosc2.h"
+
+#include <stdint.h>
+
+
+int shuffle_stride_forward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                           blosc2_cparams* cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(cparams);
+  BLOSC_UNUSED_PARAM(id);
+  if (meta == 0) {
+    BLOSC_TRACE_ERROR("The stride of the shuffle cannot be 0");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  shuffle(meta, length, input, output);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+int shuffle_stride_backward(const uint8_t* input, uint8_t* output, int32_t length, uint8_t meta,
+                            blosc2_dparams* dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(id);
+  if (meta == 0) {
+    BLOSC_TRACE_ERROR("The stride of the shuffle cannot be 0");
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  unshuffle(meta, length, input, output);
+  return BLOSC2_ERROR_SUCCESS;
+}
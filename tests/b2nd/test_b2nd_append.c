@@ -45,6 +45,8 @@ CUTEST_TEST_SETUP(append) {
       {2, {18, 6}, {6, 6}, {3, 3}, {18, 12}, 1},
       {3, {12, 10, 14}, {3, 5, 9}, {3, 4, 4}, {12, 10, 18}, 2},
       {4, {10, 10, 5, 5}, {5, 7, 3, 3}, {2, 2, 1, 1}, {10, 10, 5, 30}, 3},
+      {3, {12, 10, 14}, {6, 5, 7}, {3, 5, 4}, {20, 10, 14}, 0},  // whole new chunks
+      {2, {0, 6}, {4, 6}, {2, 3}, {10, 6}, 0},  // into an empty array
 
   ));
 }
@@ -0,0 +1,142 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* The chunks and blocks chosen for arrays */
+
+#include "test_common.h"
+
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+} test_auto_shape;
+
+CUTEST_TEST_SETUP(auto_shapes) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(tshape, test_auto_shape, CUTEST_DATA(
+      {1, {1000 * 1000}},
+      {2, {3000, 2000}},
+      {3, {500, 7, 800}},
+      {3, {50, 60, 70}},
+      {4, {0, 30, 40, 50}},
+  ));
+  CUTEST_PARAMETRIZE(pattern, int8_t, CUTEST_DATA(
+      B2ND_ACCESS_SCANS,
+      B2ND_ACCESS_AXIS_SLICES,
+      B2ND_ACCESS_CUBES,
+  ));
+}
+
+CUTEST_TEST_TEST(auto_shapes) {
+  CUTEST_GET_PARAMETER(tshape, test_auto_shape);
+  CUTEST_GET_PARAMETER(pattern, int8_t);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  int8_t ndim = tshape.ndim;
+  int8_t axis = (int8_t) (ndim - 1);
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, tshape.shape, NULL, NULL, NULL, 0, NULL, 0);
+  CUTEST_ASSERT("Cannot create the context", ctx != NULL);
+  CUTEST_ASSERT("Unknown patterns are accepted", b2nd_ctx_set_access_pattern(ctx, 3, 0) < 0);
+  CUTEST_ASSERT("Axes out of the array are accepted",
+                b2nd_ctx_set_access_pattern(ctx, B2ND_ACCESS_AXIS_SLICES, ndim) < 0);
+  B2ND_TEST_ASSERT(b2nd_ctx_set_access_pattern(ctx, pattern, axis));
+
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  B2ND_TEST_ASSERT(b2nd_ctx_get_shapes(ctx, chunkshape, blockshape));
+  int64_t chunk_nbytes = cparams.typesize;
+  int64_t block_nbytes = cparams.typesize;
+  int32_t min_edge = INT32_MAX;
+  int32_t max_edge = 0;
+  int partial = -1;  // the last dimension that the chunks do not take whole
+  for (int i = 0; i < ndim; ++i) {
+    int64_t bound = tshape.shape[i] > 0 ? tshape.shape[i] : 1;
+    CUTEST_ASSERT("Wrong chunk shape", chunkshape[i] >= 1 && chunkshape[i] <= bound);
+    CUTEST_ASSERT("Wrong block shape", blockshape[i] >= 1 && blockshape[i] <= chunkshape[i]);
+    chunk_nbytes *= chunkshape[i];
+    block_nbytes *= blockshape[i];
+    if (chunkshape[i] < bound) {
+      partial = i;
+      min_edge = chunkshape[i] < min_edge ? chunkshape[i] : min_edge;
+      max_edge = chunkshape[i] > max_edge ? chunkshape[i] : max_edge;
+    }
+  }
+  CUTEST_ASSERT("Chunks too large", chunk_nbytes <= 64 * 1024 * 1024);
+  CUTEST_ASSERT("Blocks too large", block_nbytes <= 4 * 1024 * 1024);
+
+  switch (pattern) {
+    case B2ND_ACCESS_SCANS:
+      // Whole rows from the last dimensions on
+      for (int i = 0; i < partial; ++i) {
+        CUTEST_ASSERT("The chunks do not go along rows", chunkshape[i] == 1);
+      }
+      break;
+    case B2ND_ACCESS_AXIS_SLICES:
+      CUTEST_ASSERT("The chunks do not take a slice", chunkshape[axis] == 1);
+      break;
+    default:
+      // The dimensions cut are about the same
+      if (partial >= 0) {
+        CUTEST_ASSERT("The chunks are not cubes", max_edge <= 2 * min_edge + 1);
+      }
+  }
+
+  /* The arrays with the shapes chosen work */
+  int64_t nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nitems *= tshape.shape[i];
+  }
+  int64_t buffersize = nitems * cparams.typesize;
+  int32_t *buffer = malloc(buffersize + 1);
+  for (int64_t i = 0; i < nitems; ++i) {
+    buffer[i] = (int32_t) (i % 1000);
+  }
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, buffersize));
+  for (int i = 0; i < ndim; ++i) {
+    CUTEST_ASSERT("Wrong chunk shape", array->chunkshape[i] == chunkshape[i]);
+  }
+  int32_t *dest = malloc(buffersize + 1);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, dest, buffersize));
+  CUTEST_ASSERT("Wrong items", memcmp(dest, buffer, buffersize) == 0);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  /* The shapes given are kept */
+  int32_t halves[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    halves[i] = chunkshape[i] > 1 ? chunkshape[i] / 2 : 1;
+  }
+  ctx = b2nd_create_ctx(&b2_storage, ndim, tshape.shape, halves, NULL, NULL, 0, NULL, 0);
+  B2ND_TEST_ASSERT(b2nd_ctx_set_access_pattern(ctx, pattern, axis));
+  int32_t blockshape2[B2ND_MAX_DIM];
+  B2ND_TEST_ASSERT(b2nd_ctx_get_shapes(ctx, chunkshape, blockshape2));
+  for (int i = 0; i < ndim; ++i) {
+    CUTEST_ASSERT("The chunk shape is not kept", chunkshape[i] == halves[i]);
+    CUTEST_ASSERT("Wrong block shape", blockshape2[i] >= 1 && blockshape2[i] <= halves[i]);
+  }
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  free(buffer);
+  free(dest);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(auto_shapes) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(auto_shapes);
+}
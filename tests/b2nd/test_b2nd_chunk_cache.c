@@ -0,0 +1,107 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+
+#include "test_common.h"
+
+
+CUTEST_TEST_SETUP(chunk_cache) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(8));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {true, true},
+  ));
+}
+
+CUTEST_TEST_TEST(chunk_cache) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+
+  char *urlpath = "test_b2nd_chunk_cache.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  if (backend.persistent) {
+    b2_storage.urlpath = urlpath;
+  }
+  b2_storage.contiguous = backend.contiguous;
+
+  int8_t ndim = 2;
+  int64_t shape[] = {40, 30};
+  int32_t chunkshape[] = {20, 15};
+  int32_t blockshape[] = {7, 4};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shape, chunkshape, blockshape,
+                                        NULL, 0, NULL, 0);
+
+  size_t buffersize = typesize * shape[0] * shape[1];
+  uint64_t *buffer = malloc(buffersize);
+  CUTEST_ASSERT("Buffer filled incorrectly", fill_buf(buffer, typesize, buffersize / typesize));
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, buffersize));
+  B2ND_TEST_ASSERT(blosc2_schunk_set_chunk_cache(array->sc, 4 * array->sc->chunksize));
+
+  /* Overlapping windows sliding through the array */
+  int64_t destshape[] = {6, 5};
+  int64_t destbuffersize = typesize * destshape[0] * destshape[1];
+  uint64_t destbuffer[6 * 5];
+  int nreads = 0;
+  for (int round = 0; round < 2; round++) {
+    for (int64_t i = 0; i + destshape[0] <= shape[0]; i += 3) {
+      for (int64_t j = 0; j + destshape[1] <= shape[1]; j += 2) {
+        int64_t start[] = {i, j};
+        int64_t stop[] = {i + destshape[0], j + destshape[1]};
+        B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(array, start, stop, destbuffer, destshape,
+                                                destbuffersize));
+        for (int64_t k = 0; k < destshape[0]; k++) {
+          for (int64_t l = 0; l < destshape[1]; l++) {
+            CUTEST_ASSERT("Elements are not equals!",
+                          destbuffer[k * destshape[1] + l] == buffer[(i + k) * shape[1] + j + l]);
+          }
+        }
+        nreads++;
+      }
+    }
+    if (round == 0) {
+      /* Writes are seen by the following reads */
+      for (size_t k = 0; k < buffersize / typesize; k++) {
+        buffer[k] += 1000;
+      }
+      int64_t start[] = {0, 0};
+      B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer(buffer, shape, (int64_t) buffersize, start, shape, array));
+    }
+  }
+
+  int64_t hits, misses;
+  B2ND_TEST_ASSERT(blosc2_schunk_get_chunk_cache_stats(array->sc, &hits, &misses, NULL));
+  CUTEST_ASSERT("Each chunk is decompressed once per round", misses == 2 * array->sc->nchunks);
+  CUTEST_ASSERT("The cache is not used", hits > nreads);
+
+  free(buffer);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(chunk_cache) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(chunk_cache);
+}
@@ -0,0 +1,191 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* The chunks of arrays laid out along space-filling curves */
+
+#include "test_common.h"
+
+#define NROWS 8  // chunks per dimension
+
+
+CUTEST_TEST_SETUP(chunk_order) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(order, int8_t, CUTEST_DATA(
+      B2ND_CHUNK_ORDER_C,
+      B2ND_CHUNK_ORDER_MORTON,
+      B2ND_CHUNK_ORDER_HILBERT,
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {true, true},
+      {false, true},
+  ));
+}
+
+/* Whether the chunks are one after the other in the frame in the given order */
+static bool chunks_in_order(b2nd_array_t *array, int8_t order) {
+  int64_t *offsets = blosc2_frame_get_offsets(array->sc);
+  if (offsets == NULL) {
+    return false;
+  }
+  int64_t layout[NROWS * NROWS];
+  for (int64_t i = 0; i < NROWS * NROWS; ++i) {
+    // Insertion by offset
+    int64_t j = i;
+    for (; j > 0 && offsets[layout[j - 1]] > offsets[i]; --j) {
+      layout[j] = layout[j - 1];
+    }
+    layout[j] = i;
+  }
+  free(offsets);
+
+  bool ok = true;
+  for (int64_t k = 0; k < NROWS * NROWS; ++k) {
+    int64_t row = layout[k] / NROWS;
+    int64_t col = layout[k] % NROWS;
+    switch (order) {
+      case B2ND_CHUNK_ORDER_MORTON: {
+        int64_t morton_row = 0;
+        int64_t morton_col = 0;
+        for (int b = 0; b < 3; ++b) {
+          morton_row |= ((k >> (2 * b + 1)) & 1) << b;
+          morton_col |= ((k >> (2 * b)) & 1) << b;
+        }
+        ok &= row == morton_row && col == morton_col;
+        break;
+      }
+      case B2ND_CHUNK_ORDER_HILBERT:
+        // Every chunk is next to the previous one
+        if (k == 0) {
+          ok &= row == 0 && col == 0;
+        }
+        else {
+          int64_t drow = row - layout[k - 1] / NROWS;
+          int64_t dcol = col - layout[k - 1] % NROWS;
+          ok &= drow * drow + dcol * dcol == 1;
+        }
+        break;
+      default:
+        ok &= layout[k] == k;
+    }
+  }
+  return ok;
+}
+
+CUTEST_TEST_TEST(chunk_order) {
+  CUTEST_GET_PARAMETER(order, int8_t);
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+
+  char *urlpath = "test_b2nd_chunk_order.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = sizeof(int64_t);
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  if (backend.persistent) {
+    b2_storage.urlpath = urlpath;
+  }
+  int8_t ndim = 2;
+  int64_t shape[] = {NROWS * 10 - 3, NROWS * 10};
+  int32_t chunkshape[] = {10, 10};
+  int32_t blockshape[] = {5, 4};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shape, chunkshape, blockshape, NULL, 0, NULL, 0);
+  CUTEST_ASSERT("Unknown orders are accepted", b2nd_ctx_set_chunk_order(ctx, 3) < 0);
+  B2ND_TEST_ASSERT(b2nd_ctx_set_chunk_order(ctx, order));
+
+  int64_t nitems = shape[0] * shape[1];
+  int64_t buffersize = nitems * (int64_t) sizeof(int64_t);
+  int64_t *buffer = malloc(buffersize);
+  for (int64_t i = 0; i < nitems; ++i) {
+    buffer[i] = i;
+  }
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, buffersize));
+  CUTEST_ASSERT("Wrong chunk order", array->chunk_order == order);
+  if (backend.contiguous) {
+    CUTEST_ASSERT("The chunks are not laid out in order", chunks_in_order(array, order));
+  }
+
+  /* The chunks updated go to the end, until they are laid out again */
+  int64_t start[] = {25, 3};
+  int64_t stop[] = {26, 75};
+  int64_t slice_shape[] = {1, 72};
+  int64_t slice[72];
+  for (int i = 0; i < 72; ++i) {
+    slice[i] = -i;
+    buffer[25 * shape[1] + 3 + i] = -i;
+  }
+  B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer(slice, slice_shape, sizeof(slice), start, stop, array));
+  B2ND_TEST_ASSERT(b2nd_reorder_chunks(array));
+  if (backend.contiguous) {
+    CUTEST_ASSERT("The chunks are not laid out again", chunks_in_order(array, order));
+  }
+  int64_t *dest = malloc(buffersize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, dest, buffersize));
+  CUTEST_ASSERT("Wrong items", memcmp(dest, buffer, buffersize) == 0);
+
+  /* The order is kept in the metalayer */
+  b2nd_array_t *other;
+  if (backend.persistent) {
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &other));
+  }
+  else {
+    uint8_t *cframe;
+    int64_t cframe_len;
+    bool needs_free;
+    B2ND_TEST_ASSERT(b2nd_to_cframe(array, &cframe, &cframe_len, &needs_free));
+    B2ND_TEST_ASSERT(b2nd_from_cframe(cframe, cframe_len, true, &other));
+    if (needs_free) {
+      free(cframe);
+    }
+  }
+  CUTEST_ASSERT("The order is not recorded", other->chunk_order == order);
+  memset(dest, 0, buffersize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(other, dest, buffersize));
+  CUTEST_ASSERT("Wrong items read", memcmp(dest, buffer, buffersize) == 0);
+  B2ND_TEST_ASSERT(b2nd_free(other));
+
+  /* Copies into contiguous frames are laid out in the order of their context */
+  blosc2_storage copy_storage = {.cparams=&cparams, .contiguous=true};
+  b2nd_context_t *copy_ctx = b2nd_create_ctx(&copy_storage, ndim, shape, chunkshape, blockshape,
+                                             NULL, 0, NULL, 0);
+  int8_t copy_order = (int8_t) ((order + 1) % 3);
+  B2ND_TEST_ASSERT(b2nd_ctx_set_chunk_order(copy_ctx, copy_order));
+  B2ND_TEST_ASSERT(b2nd_copy(copy_ctx, array, &other));
+  CUTEST_ASSERT("The copy is not laid out in order", chunks_in_order(other, copy_order));
+  B2ND_TEST_ASSERT(b2nd_free(other));
+  B2ND_TEST_ASSERT(b2nd_ctx_set_chunk_order(copy_ctx, order));
+  B2ND_TEST_ASSERT(b2nd_copy(copy_ctx, array, &other));
+  CUTEST_ASSERT("The copy is not laid out in order", chunks_in_order(other, order));
+  memset(dest, 0, buffersize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(other, dest, buffersize));
+  CUTEST_ASSERT("Wrong items copied", memcmp(dest, buffer, buffersize) == 0);
+  B2ND_TEST_ASSERT(b2nd_free(other));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(copy_ctx));
+
+  free(buffer);
+  free(dest);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(chunk_order) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(chunk_order);
+}
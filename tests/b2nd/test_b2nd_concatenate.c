@@ -0,0 +1,201 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int64_t shape2[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int32_t chunkshape2[B2ND_MAX_DIM];
+  int32_t blockshape2[B2ND_MAX_DIM];
+  int8_t axis;
+  bool moved;  // whether the chunks of the second array go as they are
+} test_shapes_t;
+
+
+CUTEST_TEST_SETUP(concatenate) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(
+      2,
+      4,
+  ));
+  CUTEST_PARAMETRIZE(shapes, test_shapes_t, CUTEST_DATA(
+      {2, {20, 30}, {13, 30}, {10, 10}, {5, 5}, {10, 10}, {5, 5}, 0, true},  // chunks after the others
+      {3, {12, 10, 14}, {12, 6, 14}, {6, 5, 7}, {3, 5, 4}, {6, 5, 7}, {3, 5, 4}, 1, true},
+      {3, {12, 10, 14}, {12, 10, 3}, {6, 5, 7}, {3, 5, 4}, {6, 5, 7}, {3, 5, 4}, 2, true},
+      {2, {17, 30}, {13, 30}, {10, 10}, {5, 5}, {10, 10}, {5, 5}, 0, false},  // across a chunk
+      {3, {12, 10, 14}, {12, 10, 9}, {6, 5, 7}, {3, 5, 4}, {4, 5, 5}, {2, 5, 5}, 2, false},
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {false, true},
+      {true, true},
+  ));
+  CUTEST_PARAMETRIZE(copy, bool, CUTEST_DATA(
+      false,
+      true,
+  ));
+}
+
+CUTEST_TEST_TEST(concatenate) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(shapes, test_shapes_t);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(copy, bool);
+
+  char *urlpath = "test_concatenate.b2frame";
+  char *urlpath2 = "test_concatenate2.b2frame";
+  char *urlpath3 = "test_concatenate3.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  blosc2_remove_urlpath(urlpath2);
+  blosc2_remove_urlpath(urlpath3);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  b2_storage.urlpath = backend.persistent ? urlpath : NULL;
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape,
+                                        shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+  b2_storage.urlpath = backend.persistent ? urlpath2 : NULL;
+  b2nd_context_t *ctx2 = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape2,
+                                         shapes.chunkshape2, shapes.blockshape2, NULL, 0, NULL, 0);
+  b2_storage.urlpath = backend.persistent ? urlpath3 : NULL;
+  b2nd_context_t *ctx3 = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape,
+                                         shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+
+  /* Create the arrays, with different items */
+  int64_t nitems = 1;
+  int64_t nitems2 = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    nitems *= shapes.shape[i];
+    nitems2 *= shapes.shape2[i];
+  }
+  uint8_t *buffer = malloc(nitems * typesize);
+  uint8_t *buffer2 = malloc(nitems2 * typesize);
+  fill_buf(buffer, typesize, nitems);
+  fill_buf(buffer2, typesize, nitems2);
+  for (int64_t i = 0; i < nitems2 * typesize; ++i) {
+    buffer2[i] ^= 0x55;
+  }
+  b2nd_array_t *src;
+  b2nd_array_t *src2;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &src, buffer, nitems * typesize));
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx2, &src2, buffer2, nitems2 * typesize));
+
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_concatenate(ctx3, src, src2, shapes.axis, copy, &array));
+  CUTEST_ASSERT("The array is not extended in place", copy || array == src);
+  CUTEST_ASSERT("Wrong shape", array->shape[shapes.axis] == shapes.shape[shapes.axis] + shapes.shape2[shapes.axis]);
+
+  /* The items of the second array go after the ones of the first one along the axis */
+  int64_t shape[B2ND_MAX_DIM];
+  memcpy(shape, array->shape, sizeof(shape));
+  int64_t size = array->nitems * typesize;
+  uint8_t *result = malloc(size);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, result, size));
+  int errors = 0;
+  int64_t index[B2ND_MAX_DIM];
+  for (int64_t i = 0; i < array->nitems; ++i) {
+    blosc2_unidim_to_multidim(shapes.ndim, shape, i, index);
+    bool first = index[shapes.axis] < shapes.shape[shapes.axis];
+    const int64_t *src_shape = first ? shapes.shape : shapes.shape2;
+    if (!first) {
+      index[shapes.axis] -= shapes.shape[shapes.axis];
+    }
+    int64_t j = 0;
+    for (int k = 0; k < shapes.ndim; ++k) {
+      j = j * src_shape[k] + index[k];
+    }
+    errors += memcmp(result + i * typesize, (first ? buffer : buffer2) + j * typesize, typesize) != 0;
+  }
+  CUTEST_ASSERT("Wrong items", errors == 0);
+
+  /* The chunks of the second array were not recompressed */
+  if (shapes.moved) {
+    uint8_t *chunk;
+    uint8_t *chunk2;
+    bool needs_free;
+    bool needs_free2;
+    int cbytes = blosc2_schunk_get_chunk(array->sc, array->sc->nchunks - 1, &chunk, &needs_free);
+    int cbytes2 = blosc2_schunk_get_chunk(src2->sc, src2->sc->nchunks - 1, &chunk2, &needs_free2);
+    CUTEST_ASSERT("The chunk was recompressed", cbytes == cbytes2 && memcmp(chunk, chunk2, cbytes) == 0);
+    if (needs_free) {
+      free(chunk);
+    }
+    if (needs_free2) {
+      free(chunk2);
+    }
+  }
+
+  /* The new shape persists */
+  if (backend.persistent) {
+    char *path = copy ? urlpath3 : urlpath;
+    if (copy) {
+      B2ND_TEST_ASSERT(b2nd_free(array));
+    }
+    else {
+      B2ND_TEST_ASSERT(b2nd_free(src));
+    }
+    B2ND_TEST_ASSERT(b2nd_open(path, &array));
+    CUTEST_ASSERT("Wrong shape after reopening", memcmp(array->shape, shape, shapes.ndim * sizeof(int64_t)) == 0);
+    if (!copy) {
+      src = array;
+    }
+  }
+
+  /* Arrays of other shapes cannot be concatenated */
+  b2nd_array_t *other;
+  if (shapes.ndim > 1) {
+    blosc2_storage storage = {.cparams=&cparams};
+    b2nd_context_t *ctx4 = b2nd_create_ctx(&storage, shapes.ndim, shapes.shape2,
+                                           shapes.chunkshape2, shapes.blockshape2, NULL, 0, NULL, 0);
+    B2ND_TEST_ASSERT(b2nd_zeros(ctx4, &other));
+    B2ND_TEST_ASSERT(b2nd_free_ctx(ctx4));
+    b2nd_array_t *res;
+    CUTEST_ASSERT("Arrays of other shapes are concatenated",
+                  b2nd_concatenate(NULL, array, other, (int8_t) ((shapes.axis + 1) % shapes.ndim), false,
+                                   &res) < 0);
+    B2ND_TEST_ASSERT(b2nd_free(other));
+  }
+
+  /* Free mallocs */
+  free(result);
+  free(buffer);
+  free(buffer2);
+  if (copy) {
+    B2ND_TEST_ASSERT(b2nd_free(array));
+  }
+  B2ND_TEST_ASSERT(b2nd_free(src));
+  B2ND_TEST_ASSERT(b2nd_free(src2));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx2));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx3));
+
+  blosc2_remove_urlpath(urlpath);
+  blosc2_remove_urlpath(urlpath2);
+  blosc2_remove_urlpath(urlpath3);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(concatenate) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(concatenate);
+}
@@ -0,0 +1,154 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Selections of arbitrary points, and of the items under a mask */
+
+#include "test_common.h"
+
+#define NPOINTS 300
+
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+} test_points_shapes;
+
+CUTEST_TEST_SETUP(coordinate_selection) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(shapes, test_points_shapes, CUTEST_DATA(
+      {1, {1000}, {100}, {30}},
+      {2, {40, 55}, {10, 20}, {5, 7}},
+      {3, {21, 17, 13}, {10, 10, 5}, {5, 3, 5}},
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {true, true},
+      {false, true},
+  ));
+  // Chunks in turns, or in parallel on the shared pool
+  CUTEST_PARAMETRIZE(pool, int, CUTEST_DATA(0, 4));
+}
+
+CUTEST_TEST_TEST(coordinate_selection) {
+  CUTEST_GET_PARAMETER(shapes, test_points_shapes);
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(pool, int);
+
+  char *urlpath = "test_b2nd_coordinate_selection.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  blosc2_set_shared_threadpool(pool);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = sizeof(int64_t);
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  if (backend.persistent) {
+    b2_storage.urlpath = urlpath;
+  }
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape, shapes.chunkshape,
+                                        shapes.blockshape, NULL, 0, NULL, 0);
+
+  int64_t nitems = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    nitems *= shapes.shape[i];
+  }
+  int64_t buffersize = nitems * (int64_t) sizeof(int64_t);
+  int64_t *buffer = malloc(buffersize);
+  for (int64_t i = 0; i < nitems; ++i) {
+    buffer[i] = i;
+  }
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, buffersize));
+
+  /* Scattered points, some of them repeated */
+  int64_t coords[NPOINTS * B2ND_MAX_DIM];
+  int64_t linear[NPOINTS];
+  uint64_t seed = 12345;
+  for (int p = 0; p < NPOINTS; ++p) {
+    linear[p] = 0;
+    for (int i = 0; i < shapes.ndim; ++i) {
+      seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+      int64_t coord = (p % 10 == 9) ? coords[(p - 1) * shapes.ndim + i] : (int64_t) ((seed >> 33) % shapes.shape[i]);
+      coords[p * shapes.ndim + i] = coord;
+      linear[p] = linear[p] * shapes.shape[i] + coord;
+    }
+  }
+  int64_t points[NPOINTS];
+  B2ND_TEST_ASSERT(b2nd_get_coordinate_selection(array, coords, NPOINTS, points, sizeof(points)));
+  for (int p = 0; p < NPOINTS; ++p) {
+    CUTEST_ASSERT("Wrong point", points[p] == buffer[linear[p]]);
+  }
+  for (int p = 0; p < NPOINTS; ++p) {
+    points[p] = -p;
+    buffer[linear[p]] = -p;  // the last of the repeated points wins
+  }
+  B2ND_TEST_ASSERT(b2nd_set_coordinate_selection(array, coords, NPOINTS, points, sizeof(points)));
+  int64_t *dest = malloc(buffersize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, dest, buffersize));
+  CUTEST_ASSERT("Wrong points set", memcmp(dest, buffer, buffersize) == 0);
+
+  /* Wrong points and buffers */
+  int64_t out[B2ND_MAX_DIM] = {0};
+  out[shapes.ndim - 1] = shapes.shape[shapes.ndim - 1];
+  CUTEST_ASSERT("Points out of the array are accepted",
+                b2nd_get_coordinate_selection(array, out, 1, points, sizeof(points)) < 0);
+  CUTEST_ASSERT("Small buffers are accepted",
+                b2nd_get_coordinate_selection(array, coords, NPOINTS, points, sizeof(int64_t)) < 0);
+  B2ND_TEST_ASSERT(b2nd_get_coordinate_selection(array, coords, 0, points, 0));
+
+  /* Masks */
+  bool *mask = malloc(nitems);
+  int64_t nmask = 0;
+  for (int64_t i = 0; i < nitems; ++i) {
+    mask[i] = i % 7 == 3 || i % 11 == 0;
+    nmask += mask[i];
+  }
+  int64_t *selected = malloc(nmask * sizeof(int64_t));
+  int64_t nselected;
+  B2ND_TEST_ASSERT(b2nd_get_mask_selection(array, mask, selected, nmask * (int64_t) sizeof(int64_t), &nselected));
+  CUTEST_ASSERT("Wrong number of selected items", nselected == nmask);
+  for (int64_t i = 0, j = 0; i < nitems; ++i) {
+    if (mask[i]) {
+      CUTEST_ASSERT("Wrong selected item", selected[j++] == buffer[i]);
+      buffer[i] = 1000000 + i;
+    }
+  }
+  for (int64_t i = 0, j = 0; i < nitems; ++i) {
+    if (mask[i]) {
+      selected[j++] = 1000000 + i;
+    }
+  }
+  B2ND_TEST_ASSERT(b2nd_set_mask_selection(array, mask, selected, nmask * (int64_t) sizeof(int64_t)));
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, dest, buffersize));
+  CUTEST_ASSERT("Wrong items set", memcmp(dest, buffer, buffersize) == 0);
+
+  free(mask);
+  free(selected);
+  free(buffer);
+  free(dest);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(coordinate_selection) {
+  blosc2_set_shared_threadpool(0);
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(coordinate_selection);
+}
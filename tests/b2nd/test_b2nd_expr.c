@@ -0,0 +1,216 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Element-wise expressions evaluated while compressing their result */
+
+#include "test_common.h"
+
+#define NEXPRS 3
+
+
+typedef struct {
+  char *dtype;
+  int32_t typesize;
+} test_expr_dtype;
+
+CUTEST_TEST_SETUP(expr) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(dtype, test_expr_dtype, CUTEST_DATA(
+      {"<f8", 8},
+      {"<f4", 4},
+      {"<i8", 8},
+      {"<i4", 4},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 3));
+}
+
+static void set_item(const test_expr_dtype *dtype, void *buffer, int64_t i, double value) {
+  switch (dtype->dtype[1] * 10 + dtype->typesize) {
+    case 'f' * 10 + 8:
+      ((double *) buffer)[i] = value;
+      break;
+    case 'f' * 10 + 4:
+      ((float *) buffer)[i] = (float) value;
+      break;
+    case 'i' * 10 + 8:
+      ((int64_t *) buffer)[i] = (int64_t) value;
+      break;
+    default:
+      ((int32_t *) buffer)[i] = (int32_t) value;
+  }
+}
+
+static double get_item(const test_expr_dtype *dtype, const void *buffer, int64_t i) {
+  switch (dtype->dtype[1] * 10 + dtype->typesize) {
+    case 'f' * 10 + 8:
+      return ((const double *) buffer)[i];
+    case 'f' * 10 + 4:
+      return ((const float *) buffer)[i];
+    case 'i' * 10 + 8:
+      return (double) ((const int64_t *) buffer)[i];
+    default:
+      return ((const int32_t *) buffer)[i];
+  }
+}
+
+/* The value of the expression n at the items a and b */
+static double expected(const test_expr_dtype *dtype, int n, double a, double b) {
+  switch (n) {
+    case 0:
+      return a * b + 5;
+    case 1:
+      return (a > b ? a : b) - 3 * b;
+    default: {
+      double quotient = (a * b + 5) / 4;
+      if (dtype->dtype[1] == 'i') {
+        return (double) (int64_t) quotient;  // truncated
+      }
+      return dtype->typesize == 4 ? (float) quotient : quotient;
+    }
+  }
+}
+
+CUTEST_TEST_TEST(expr) {
+  CUTEST_GET_PARAMETER(dtype, test_expr_dtype);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = nthreads;
+  cparams.typesize = dtype.typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  int8_t ndim = 2;
+  int64_t shape[] = {53, 47};
+  int32_t chunkshape[] = {20, 16};
+  int32_t blockshape[] = {7, 5};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shape, chunkshape, blockshape,
+                                        dtype.dtype, DTYPE_NUMPY_FORMAT, NULL, 0);
+
+  int64_t nitems = shape[0] * shape[1];
+  int64_t buffersize = nitems * dtype.typesize;
+  uint8_t *buffer_a = malloc(buffersize);
+  uint8_t *buffer_b = malloc(buffersize);
+  for (int64_t i = 0; i < nitems; ++i) {
+    set_item(&dtype, buffer_a, i, (double) (i % 100));
+    set_item(&dtype, buffer_b, i, (double) ((i * 7) % 13 - 6));
+  }
+  b2nd_array_t *a;
+  b2nd_array_t *b;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &a, buffer_a, buffersize));
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &b, buffer_b, buffersize));
+
+  /* a * b + 5, max(a, b) - 3 * b and (a * b + 5) / 4 */
+  b2nd_expr_t *exprs[NEXPRS];
+  for (int n = 0; n < NEXPRS; ++n) {
+    B2ND_TEST_ASSERT(b2nd_expr_new(&exprs[n]));
+  }
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(exprs[0], a));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(exprs[0], b));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[0], B2ND_EXPR_MUL));
+  B2ND_TEST_ASSERT(b2nd_expr_push_scalar(exprs[0], 5));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[0], B2ND_EXPR_ADD));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(exprs[1], a));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(exprs[1], b));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[1], B2ND_EXPR_MAX));
+  B2ND_TEST_ASSERT(b2nd_expr_push_scalar(exprs[1], 3));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(exprs[1], b));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[1], B2ND_EXPR_MUL));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[1], B2ND_EXPR_SUB));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(exprs[2], a));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(exprs[2], b));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[2], B2ND_EXPR_MUL));
+  B2ND_TEST_ASSERT(b2nd_expr_push_scalar(exprs[2], 2));
+  B2ND_TEST_ASSERT(b2nd_expr_push_scalar(exprs[2], 3));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[2], B2ND_EXPR_ADD));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[2], B2ND_EXPR_ADD));
+  B2ND_TEST_ASSERT(b2nd_expr_push_scalar(exprs[2], 4));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(exprs[2], B2ND_EXPR_DIV));
+
+  uint8_t *dest = malloc(buffersize);
+  for (int n = 0; n < NEXPRS; ++n) {
+    // The shapes of the context are the ones of the operands
+    int64_t other_shape[] = {10, 10};
+    int32_t other_chunkshape[] = {5, 5};
+    blosc2_storage out_storage = {.cparams=&cparams, .contiguous=n % 2 == 0};
+    b2nd_context_t *out_ctx = b2nd_create_ctx(&out_storage, ndim, other_shape, other_chunkshape, NULL,
+                                              NULL, 0, NULL, 0);
+    b2nd_array_t *result;
+    B2ND_TEST_ASSERT(b2nd_expr_eval(exprs[n], out_ctx, &result));
+    CUTEST_ASSERT("Wrong shape", result->shape[0] == shape[0] && result->shape[1] == shape[1]);
+    CUTEST_ASSERT("Wrong dtype", strcmp(result->dtype, dtype.dtype) == 0);
+    B2ND_TEST_ASSERT(b2nd_to_cbuffer(result, dest, buffersize));
+    for (int64_t i = 0; i < nitems; ++i) {
+      double value = expected(&dtype, n, get_item(&dtype, buffer_a, i), get_item(&dtype, buffer_b, i));
+      CUTEST_ASSERT("Wrong item", get_item(&dtype, dest, i) == value);
+    }
+    B2ND_TEST_ASSERT(b2nd_free(result));
+    B2ND_TEST_ASSERT(b2nd_free_ctx(out_ctx));
+  }
+
+  /* Operands with special chunks */
+  b2nd_array_t *zeros;
+  B2ND_TEST_ASSERT(b2nd_zeros(ctx, &zeros));
+  b2nd_expr_t *expr;
+  B2ND_TEST_ASSERT(b2nd_expr_new(&expr));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(expr, a));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(expr, zeros));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(expr, B2ND_EXPR_MIN));
+  b2nd_array_t *result;
+  B2ND_TEST_ASSERT(b2nd_expr_eval(expr, ctx, &result));
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(result, dest, buffersize));
+  for (int64_t i = 0; i < nitems; ++i) {
+    CUTEST_ASSERT("Wrong minimum", get_item(&dtype, dest, i) == 0);
+  }
+  B2ND_TEST_ASSERT(b2nd_free(result));
+  B2ND_TEST_ASSERT(b2nd_expr_free(expr));
+
+  /* Wrong expressions */
+  B2ND_TEST_ASSERT(b2nd_expr_new(&expr));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(expr, a));
+  CUTEST_ASSERT("Operations without operands are accepted", b2nd_expr_push_op(expr, B2ND_EXPR_ADD) < 0);
+  CUTEST_ASSERT("Unknown operations are accepted", b2nd_expr_push_op(expr, 6) < 0);
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(expr, a));
+  CUTEST_ASSERT("Incomplete expressions are evaluated", b2nd_expr_eval(expr, ctx, &result) < 0);
+  B2ND_TEST_ASSERT(b2nd_expr_free(expr));
+  int64_t small_shape[] = {53, 46};
+  b2nd_context_t *small_ctx = b2nd_create_ctx(&b2_storage, ndim, small_shape, chunkshape, blockshape,
+                                              dtype.dtype, DTYPE_NUMPY_FORMAT, NULL, 0);
+  b2nd_array_t *small;
+  B2ND_TEST_ASSERT(b2nd_zeros(small_ctx, &small));
+  B2ND_TEST_ASSERT(b2nd_expr_new(&expr));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(expr, a));
+  B2ND_TEST_ASSERT(b2nd_expr_push_array(expr, small));
+  B2ND_TEST_ASSERT(b2nd_expr_push_op(expr, B2ND_EXPR_ADD));
+  CUTEST_ASSERT("Arrays of different shapes are accepted", b2nd_expr_eval(expr, ctx, &result) < 0);
+  B2ND_TEST_ASSERT(b2nd_expr_free(expr));
+  B2ND_TEST_ASSERT(b2nd_free(small));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(small_ctx));
+
+  for (int n = 0; n < NEXPRS; ++n) {
+    B2ND_TEST_ASSERT(b2nd_expr_free(exprs[n]));
+  }
+  free(buffer_a);
+  free(buffer_b);
+  free(dest);
+  B2ND_TEST_ASSERT(b2nd_free(zeros));
+  B2ND_TEST_ASSERT(b2nd_free(a));
+  B2ND_TEST_ASSERT(b2nd_free(b));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(expr) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(expr);
+}
@@ -0,0 +1,128 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Narrow slices of on-disk arrays only have to read the blocks that they touch */
+
+#include "test_common.h"
+
+#define COUNTING_IO 246
+
+static int64_t nbytes_read = 0;
+
+static void *counting_open(const char *urlpath, const char *mode, void *params) {
+  BLOSC_UNUSED_PARAM(params);
+  return blosc2_stdio_open(urlpath, mode, NULL);
+}
+
+static int64_t counting_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  int64_t rbytes = blosc2_stdio_read(ptr, size, nitems, stream);
+  nbytes_read += rbytes * size;
+  return rbytes;
+}
+
+static int64_t counting_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  int64_t rbytes = blosc2_stdio_pread(ptr, size, nitems, position, stream);
+  nbytes_read += rbytes * size;
+  return rbytes;
+}
+
+
+typedef struct {
+  bool contiguous;
+  int16_t nthreads;
+} test_blocks_backend;
+
+CUTEST_TEST_SETUP(get_slice_blocks) {
+  blosc2_init();
+
+  blosc2_io_cb io_cb = {0};
+  io_cb.id = COUNTING_IO;
+  io_cb.name = "counting";
+  io_cb.open = (blosc2_open_cb) counting_open;
+  io_cb.close = (blosc2_close_cb) blosc2_stdio_close;
+  io_cb.read = (blosc2_read_cb) counting_read;
+  io_cb.tell = (blosc2_tell_cb) blosc2_stdio_tell;
+  io_cb.seek = (blosc2_seek_cb) blosc2_stdio_seek;
+  io_cb.write = (blosc2_write_cb) blosc2_stdio_write;
+  io_cb.truncate = (blosc2_truncate_cb) blosc2_stdio_truncate;
+  blosc2_register_io_cb(&io_cb);
+  blosc2_io_cb_ext io_cb_ext = {0};
+  io_cb_ext.pread = (blosc2_pread_cb) counting_pread;
+  io_cb_ext.pwrite = (blosc2_pwrite_cb) blosc2_stdio_pwrite;
+  blosc2_register_io_cb_ext(io_cb.id, &io_cb_ext);
+
+  CUTEST_PARAMETRIZE(backend, test_blocks_backend, CUTEST_DATA(
+      {true, 1},
+      {false, 1},
+      {true, 2},
+  ));
+}
+
+CUTEST_TEST_TEST(get_slice_blocks) {
+  CUTEST_GET_PARAMETER(backend, test_blocks_backend);
+
+  char *urlpath = "test_b2nd_get_slice_blocks.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = backend.nthreads;
+  cparams.typesize = sizeof(double);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = backend.nthreads;
+  blosc2_io io = {.id = COUNTING_IO, .name = "counting"};
+  blosc2_storage b2_storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=urlpath,
+                               .contiguous=backend.contiguous, .io=&io};
+
+  int8_t ndim = 3;
+  int64_t shape[] = {40, 40, 40};
+  int32_t chunkshape[] = {20, 20, 20};
+  int32_t blockshape[] = {5, 5, 20};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shape, chunkshape, blockshape,
+                                        NULL, 0, NULL, 0);
+
+  int64_t nitems = shape[0] * shape[1] * shape[2];
+  double *buffer = malloc(nitems * sizeof(double));
+  uint32_t seed = 1;
+  for (int64_t i = 0; i < nitems; i++) {
+    // Not too compressible, so that the blocks that are read show
+    seed = seed * 1664525 + 1013904223;
+    buffer[i] = (double) (seed >> 20);
+  }
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, nitems * sizeof(double)));
+
+  /* One row along the last dimension, which touches one block of two chunks */
+  int64_t start[] = {13, 27, 0};
+  int64_t stop[] = {14, 28, 40};
+  int64_t destshape[] = {1, 1, 40};
+  double dest[40];
+  nbytes_read = 0;
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(array, start, stop, dest, destshape, sizeof(dest)));
+  for (int64_t k = 0; k < 40; k++) {
+    CUTEST_ASSERT("Elements are not equals!", dest[k] == buffer[(13 * shape[1] + 27) * shape[2] + k]);
+  }
+  int64_t chunk_cbytes = array->sc->cbytes / array->sc->nchunks;
+  CUTEST_ASSERT("Blocks out of the slice are read", nbytes_read < chunk_cbytes / 2);
+
+  free(buffer);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(get_slice_blocks) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(get_slice_blocks);
+}
@@ -0,0 +1,156 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Slices with their dimensions permuted (e.g. in Fortran order) */
+
+#include "test_common.h"
+
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int64_t start[B2ND_MAX_DIM];
+  int64_t stop[B2ND_MAX_DIM];
+  int8_t axes[B2ND_MAX_DIM];
+} test_permuted_shapes;
+
+
+CUTEST_TEST_SETUP(get_slice_permuted) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(1, 2, 8));
+  CUTEST_PARAMETRIZE(shapes, test_permuted_shapes, CUTEST_DATA(
+      {1, {100}, {30}, {7}, {5}, {93}, {0}},
+      {2, {140, 150}, {70, 80}, {35, 40}, {0, 0}, {140, 150}, {1, 0}},  // Fortran
+      {2, {140, 150}, {70, 80}, {35, 40}, {3, 17}, {138, 98}, {1, 0}},
+      {3, {40, 55, 23}, {10, 10, 10}, {5, 5, 5}, {3, 2, 0}, {37, 51, 23}, {2, 1, 0}},
+      {3, {40, 55, 23}, {20, 20, 20}, {10, 5, 10}, {0, 5, 1}, {40, 40, 23}, {1, 2, 0}},
+      {4, {20, 16, 12, 10}, {5, 8, 6, 5}, {5, 4, 3, 5}, {1, 0, 5, 2}, {19, 16, 7, 9}, {2, 0, 3, 1}},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(0, 4));  // 0 means no shared pool
+}
+
+CUTEST_TEST_TEST(get_slice_permuted) {
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(shapes, test_permuted_shapes);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+  blosc2_set_shared_threadpool(nthreads);
+  int8_t ndim = shapes.ndim;
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shapes.shape, shapes.chunkshape,
+                                        shapes.blockshape, NULL, 0, NULL, 0);
+
+  int64_t nitems = 1;
+  int64_t slice_shape[B2ND_MAX_DIM] = {0};
+  int64_t slice_nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nitems *= shapes.shape[i];
+    slice_shape[i] = shapes.stop[i] - shapes.start[i];
+    slice_nitems *= slice_shape[i];
+  }
+  uint8_t *buffer = malloc(nitems * typesize);
+  CUTEST_ASSERT("Buffer filled incorrectly", fill_buf(buffer, typesize, nitems));
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, nitems * typesize));
+
+  uint8_t *dense = malloc(slice_nitems * typesize);
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(array, shapes.start, shapes.stop, dense, slice_shape,
+                                          slice_nitems * typesize));
+  uint8_t *permuted = malloc(slice_nitems * typesize);
+  CUTEST_ASSERT("A too small buffer should be refused",
+                b2nd_get_slice_cbuffer_permuted(array, shapes.start, shapes.stop, shapes.axes, permuted,
+                                                slice_nitems * typesize - 1) < 0);
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer_permuted(array, shapes.start, shapes.stop, shapes.axes, permuted,
+                                                   slice_nitems * typesize));
+
+  // Item n of the buffer is the one at its index in the permuted shape
+  int64_t permuted_shape[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    permuted_shape[i] = slice_shape[shapes.axes[i]];
+  }
+  int64_t slice_strides[B2ND_MAX_DIM];
+  slice_strides[ndim - 1] = 1;
+  for (int i = ndim - 2; i >= 0; --i) {
+    slice_strides[i] = slice_strides[i + 1] * slice_shape[i + 1];
+  }
+  for (int64_t n = 0; n < slice_nitems; ++n) {
+    int64_t permuted_index[B2ND_MAX_DIM];
+    int64_t index[B2ND_MAX_DIM];
+    blosc2_unidim_to_multidim(ndim, permuted_shape, n, permuted_index);
+    for (int i = 0; i < ndim; ++i) {
+      index[shapes.axes[i]] = permuted_index[i];
+    }
+    int64_t m;
+    blosc2_multidim_to_unidim(index, ndim, slice_strides, &m);
+    CUTEST_ASSERT("Elements are not equals!", memcmp(permuted + n * typesize, dense + m * typesize, typesize) == 0);
+  }
+
+  // The whole array
+  uint8_t *whole = malloc(nitems * typesize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer_permuted(array, shapes.axes, whole, nitems * typesize));
+  int64_t whole_start[B2ND_MAX_DIM] = {0};
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer_permuted(array, whole_start, shapes.shape, shapes.axes, buffer,
+                                                   nitems * typesize));
+  CUTEST_ASSERT("Elements are not equals!", memcmp(whole, buffer, nitems * typesize) == 0);
+
+  free(buffer);
+  free(dense);
+  free(permuted);
+  free(whole);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(get_slice_permuted) {
+  blosc2_set_shared_threadpool(0);
+  blosc2_destroy();
+}
+
+
+static int test_invalid_axes(void) {
+  blosc2_init();
+  int64_t shape[] = {10, 10};
+  int32_t chunkshape[] = {5, 5};
+  int32_t blockshape[] = {5, 5};
+  blosc2_storage b2_storage = BLOSC2_STORAGE_DEFAULTS;
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, 2, shape, chunkshape, blockshape, NULL, 0, NULL, 0);
+  b2nd_array_t *array;
+  int rc = b2nd_zeros(ctx, &array);
+  if (rc < 0) {
+    return rc;
+  }
+  uint8_t buffer[100];
+  int8_t repeated[] = {0, 0};
+  int8_t out_of_range[] = {1, 2};
+  if (b2nd_to_cbuffer_permuted(array, repeated, buffer, sizeof(buffer)) >= 0 ||
+      b2nd_to_cbuffer_permuted(array, out_of_range, buffer, sizeof(buffer)) >= 0) {
+    printf("Axes that are not a permutation should be refused\n");
+    rc = 1;
+  }
+  b2nd_free(array);
+  b2nd_free_ctx(ctx);
+  blosc2_destroy();
+  return rc;
+}
+
+
+int main() {
+  if (test_invalid_axes() != 0) {
+    return 1;
+  }
+  CUTEST_TEST_RUN(get_slice_permuted);
+}
@@ -0,0 +1,153 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+} test_shapes_t;
+
+
+CUTEST_TEST_SETUP(iter_blocks) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(
+      1,
+      8,
+  ));
+  CUTEST_PARAMETRIZE(shapes, test_shapes_t, CUTEST_DATA(
+      {2, {40, 40}, {20, 20}, {10, 10}},
+      {2, {43, 37}, {20, 15}, {7, 6}},  // with padding in chunks and blocks
+      {3, {12, 10, 27}, {6, 5, 9}, {4, 4, 4}},
+      {1, {1000}, {300}, {64}},
+      {2, {0, 12}, {10, 6}, {5, 3}},  // no items
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {false, true},
+      {true, true},
+  ));
+  // With the chunks read ahead on the shared pool, or in threads of their own
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(
+      0,
+      2,
+  ));
+}
+
+CUTEST_TEST_TEST(iter_blocks) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(shapes, test_shapes_t);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  blosc2_set_shared_threadpool(nthreads);
+  char *urlpath = "test_iter_blocks.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  b2_storage.urlpath = backend.persistent ? urlpath : NULL;
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape,
+                                        shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+
+  int64_t nitems = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    nitems *= shapes.shape[i];
+  }
+  int64_t size = nitems * typesize;
+  uint8_t *buffer = malloc(size + 1);
+  fill_buf(buffer, typesize, nitems);
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, size));
+  if (backend.persistent) {
+    B2ND_TEST_ASSERT(b2nd_free(array));
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &array));
+  }
+
+  /* Every item comes once, in the block that holds it */
+  uint8_t *result = malloc(size + 1);
+  uint8_t *visits = calloc(nitems + 1, 1);
+  b2nd_block_iter_t *iter;
+  B2ND_TEST_ASSERT(b2nd_iter_blocks(array, &iter));
+  int64_t start[B2ND_MAX_DIM];
+  int64_t stop[B2ND_MAX_DIM];
+  void *data;
+  int64_t nblocks = 0;
+  int errors = 0;
+  int rc;
+  while ((rc = b2nd_block_iter_next(iter, start, stop, &data)) == 1) {
+    nblocks++;
+    int64_t block_shape[B2ND_MAX_DIM];
+    int64_t block_nitems = 1;
+    for (int i = 0; i < shapes.ndim; ++i) {
+      errors += start[i] % shapes.chunkshape[i] % shapes.blockshape[i] != 0;
+      block_shape[i] = stop[i] - start[i];
+      block_nitems *= block_shape[i];
+    }
+    int64_t index[B2ND_MAX_DIM];
+    for (int64_t i = 0; i < block_nitems; ++i) {
+      blosc2_unidim_to_multidim(shapes.ndim, block_shape, i, index);
+      int64_t j = 0;
+      int64_t k = 0;
+      for (int d = 0; d < shapes.ndim; ++d) {
+        j = j * shapes.shape[d] + start[d] + index[d];
+        k = k * shapes.blockshape[d] + index[d];
+      }
+      memcpy(result + j * typesize, (uint8_t *) data + k * typesize, typesize);
+      visits[j]++;
+    }
+  }
+  B2ND_TEST_ASSERT(rc);
+  CUTEST_ASSERT("The blocks are not aligned", errors == 0);
+  CUTEST_ASSERT("Wrong items", memcmp(result, buffer, size) == 0);
+  for (int64_t i = 0; i < nitems; ++i) {
+    errors += visits[i] != 1;
+  }
+  CUTEST_ASSERT("Items come more than once, or never", errors == 0);
+  CUTEST_ASSERT("The iterator goes on", b2nd_block_iter_next(iter, start, stop, &data) == 0);
+  B2ND_TEST_ASSERT(b2nd_block_iter_free(iter));
+
+  /* The iterator can be left halfway */
+  B2ND_TEST_ASSERT(b2nd_iter_blocks(array, &iter));
+  if (nblocks > 0) {
+    CUTEST_ASSERT("Cannot get the first block", b2nd_block_iter_next(iter, start, stop, &data) == 1);
+    for (int i = 0; i < shapes.ndim; ++i) {
+      CUTEST_ASSERT("Wrong first block", start[i] == 0);
+    }
+  }
+  B2ND_TEST_ASSERT(b2nd_block_iter_free(iter));
+
+  /* Free mallocs */
+  free(visits);
+  free(result);
+  free(buffer);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_set_shared_threadpool(0);
+
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(iter_blocks) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(iter_blocks);
+}
@@ -0,0 +1,141 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Slices processing their chunks in parallel on the shared thread pool */
+
+#include "test_common.h"
+
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int64_t start[B2ND_MAX_DIM];
+  int64_t stop[B2ND_MAX_DIM];
+} test_parallel_shapes;
+
+CUTEST_TEST_SETUP(parallel_slice) {
+  blosc2_init();
+  blosc2_set_shared_threadpool(4);
+
+  CUTEST_PARAMETRIZE(shapes, test_parallel_shapes, CUTEST_DATA(
+      {3, {40, 55, 23}, {10, 10, 10}, {5, 5, 5}, {3, 2, 0}, {37, 51, 23}},
+      {3, {40, 55, 23}, {10, 10, 10}, {5, 5, 5}, {0, 0, 0}, {40, 55, 23}},  // whole chunks
+      {4, {20, 16, 12, 10}, {5, 8, 6, 5}, {5, 4, 3, 5}, {1, 0, 5, 2}, {19, 16, 7, 9}},
+      {2, {100, 100}, {10, 100}, {5, 50}, {42, 0}, {43, 100}},  // a single chunk
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {true, true},
+      {false, true},
+  ));
+}
+
+CUTEST_TEST_TEST(parallel_slice) {
+  CUTEST_GET_PARAMETER(shapes, test_parallel_shapes);
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+
+  char *urlpath = "test_b2nd_parallel_slice.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  if (backend.persistent) {
+    b2_storage.urlpath = urlpath;
+  }
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape, shapes.chunkshape,
+                                        shapes.blockshape, NULL, 0, NULL, 0);
+
+  int64_t nitems = 1;
+  int64_t slice_shape[B2ND_MAX_DIM] = {0};
+  int64_t slice_nitems = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    nitems *= shapes.shape[i];
+    slice_shape[i] = shapes.stop[i] - shapes.start[i];
+    slice_nitems *= slice_shape[i];
+  }
+  int32_t *buffer = malloc(nitems * sizeof(int32_t));
+  CUTEST_ASSERT("Buffer filled incorrectly", fill_buf(buffer, sizeof(int32_t), nitems));
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, nitems * sizeof(int32_t)));
+
+  /* Write a slice of negative values, and read it (and the whole array) back */
+  int32_t *slice = malloc(slice_nitems * sizeof(int32_t));
+  for (int64_t i = 0; i < slice_nitems; ++i) {
+    slice[i] = (int32_t) -i;
+  }
+  B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer(slice, slice_shape, slice_nitems * sizeof(int32_t),
+                                          shapes.start, shapes.stop, array));
+  int32_t *slice2 = malloc(slice_nitems * sizeof(int32_t));
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(array, shapes.start, shapes.stop, slice2, slice_shape,
+                                          slice_nitems * sizeof(int32_t)));
+  CUTEST_ASSERT("The slice differs", memcmp(slice, slice2, slice_nitems * sizeof(int32_t)) == 0);
+
+  int32_t *buffer2 = malloc(nitems * sizeof(int32_t));
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, buffer2, nitems * sizeof(int32_t)));
+  int64_t strides[B2ND_MAX_DIM];
+  strides[shapes.ndim - 1] = 1;
+  for (int i = shapes.ndim - 2; i >= 0; --i) {
+    strides[i] = strides[i + 1] * shapes.shape[i + 1];
+  }
+  for (int64_t i = 0; i < nitems; ++i) {
+    int64_t index[B2ND_MAX_DIM];
+    bool in_slice = true;
+    int64_t nslice = 0;
+    int64_t rest = i;
+    for (int j = 0; j < shapes.ndim; ++j) {
+      index[j] = rest / strides[j];
+      rest %= strides[j];
+      in_slice &= index[j] >= shapes.start[j] && index[j] < shapes.stop[j];
+      nslice = nslice * slice_shape[j] + index[j] - shapes.start[j];
+    }
+    int32_t expected = in_slice ? (int32_t) -nslice : buffer[i];
+    CUTEST_ASSERT("Elements are not equals!", buffer2[i] == expected);
+  }
+
+  /* Append new chunks (and a part of one) along the first axis */
+  int64_t nappended = (2 * shapes.chunkshape[0] + 1) * (nitems / shapes.shape[0]);
+  int32_t *appended = malloc(nappended * sizeof(int32_t));
+  for (int64_t i = 0; i < nappended; ++i) {
+    appended[i] = (int32_t) (i * 3);
+  }
+  B2ND_TEST_ASSERT(b2nd_append(array, appended, nappended * sizeof(int32_t), 0));
+  CUTEST_ASSERT("Wrong shape", array->shape[0] == shapes.shape[0] + 2 * shapes.chunkshape[0] + 1);
+  int32_t *buffer3 = malloc((nitems + nappended) * sizeof(int32_t));
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, buffer3, (nitems + nappended) * sizeof(int32_t)));
+  CUTEST_ASSERT("The array changed", memcmp(buffer3, buffer2, nitems * sizeof(int32_t)) == 0);
+  CUTEST_ASSERT("The appended items differ",
+                memcmp(buffer3 + nitems, appended, nappended * sizeof(int32_t)) == 0);
+
+  free(buffer);
+  free(buffer2);
+  free(buffer3);
+  free(appended);
+  free(slice);
+  free(slice2);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(parallel_slice) {
+  blosc2_set_shared_threadpool(0);
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(parallel_slice);
+}
@@ -0,0 +1,229 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Pyramids of levels of lower resolution */
+
+#include <math.h>
+
+#include "test_common.h"
+
+#define NLEVELS 2
+#define NROWS 50
+#define NCOLS 37
+#define NAPPENDED 11
+
+
+CUTEST_TEST_SETUP(pyramid) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(reduction, int8_t, CUTEST_DATA(B2ND_PYRAMID_NEAREST, B2ND_PYRAMID_MEAN, B2ND_PYRAMID_MAX));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {false, true},
+  ));
+}
+
+
+/* Reduce a level by hand into the next one, returning the items of it */
+static int32_t *reduce_level(const int32_t *src, const int64_t *shape, const int32_t *factors, int8_t reduction,
+                             int64_t *level_shape) {
+  level_shape[0] = (shape[0] + factors[0] - 1) / factors[0];
+  level_shape[1] = (shape[1] + factors[1] - 1) / factors[1];
+  int32_t *dst = malloc(level_shape[0] * level_shape[1] * sizeof(int32_t));
+  for (int64_t i = 0; i < level_shape[0]; ++i) {
+    for (int64_t j = 0; j < level_shape[1]; ++j) {
+      double sum = 0;
+      int64_t count = 0;
+      int32_t best = src[i * factors[0] * shape[1] + j * factors[1]];
+      for (int64_t k = i * factors[0]; k < (i + 1) * factors[0] && k < shape[0]; ++k) {
+        for (int64_t l = j * factors[1]; l < (j + 1) * factors[1] && l < shape[1]; ++l) {
+          int32_t x = src[k * shape[1] + l];
+          sum += x;
+          count++;
+          best = x > best ? x : best;
+        }
+      }
+      int32_t *item = &dst[i * level_shape[1] + j];
+      switch (reduction) {
+        case B2ND_PYRAMID_MEAN:
+          *item = (int32_t) round(sum / (double) count);
+          break;
+        case B2ND_PYRAMID_MAX:
+          *item = best;
+          break;
+        default:
+          *item = src[i * factors[0] * shape[1] + j * factors[1]];
+      }
+    }
+  }
+  return dst;
+}
+
+/* Check every level of the pyramid of an array against the reductions by hand of `values` */
+static int check_levels(b2nd_array_t *array, const int32_t *values, const int32_t *factors, int8_t reduction) {
+  CUTEST_ASSERT("Wrong number of levels", b2nd_pyramid_nlevels(array) == NLEVELS);
+  int64_t shape[2] = {array->shape[0], array->shape[1]};
+  const int32_t *src = values;
+  for (int level = 1; level <= NLEVELS; ++level) {
+    int64_t level_shape[2];
+    int32_t *expected = reduce_level(src, shape, factors, reduction, level_shape);
+    if (src != values) {
+      free((void *) src);
+    }
+    b2nd_array_t *level_array;
+    B2ND_TEST_ASSERT(b2nd_pyramid_get_level(array, level, &level_array));
+    CUTEST_ASSERT("Wrong shape of the level",
+                  level_array->shape[0] == level_shape[0] && level_array->shape[1] == level_shape[1]);
+    int64_t nitems = level_shape[0] * level_shape[1];
+    int32_t *items = malloc(nitems * sizeof(int32_t));
+    int64_t start[2] = {0, 0};
+    B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(level_array, start, level_shape, items, level_shape,
+                                            nitems * (int64_t) sizeof(int32_t)));
+    bool equal = memcmp(items, expected, nitems * sizeof(int32_t)) == 0;
+    free(items);
+    if (!equal) {
+      free(expected);
+    }
+    CUTEST_ASSERT("Wrong items of the level", equal);
+    src = expected;
+    shape[0] = level_shape[0];
+    shape[1] = level_shape[1];
+  }
+  free((void *) src);
+  return 0;
+}
+
+
+CUTEST_TEST_TEST(pyramid) {
+  CUTEST_GET_PARAMETER(reduction, int8_t);
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+
+  char *urlpath = "test_pyramid.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous,
+                               .urlpath=backend.persistent ? urlpath : NULL};
+  int64_t shape[2] = {NROWS, NCOLS};
+  int32_t chunkshape[2] = {20, 20};
+  int32_t blockshape[2] = {10, 10};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, 2, shape, chunkshape, blockshape, "<i4",
+                                        DTYPE_NUMPY_FORMAT, NULL, 0);
+  int64_t nitems = (NROWS + NAPPENDED) * NCOLS;
+  int32_t *values = malloc(nitems * sizeof(int32_t));
+  for (int64_t n = 0; n < nitems; ++n) {
+    values[n] = (int32_t) ((n * 7919) % 1001) - 500;
+  }
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, values, NROWS * NCOLS * sizeof(int32_t)));
+  int32_t factors[2] = {2, 3};
+  CUTEST_ASSERT("A pyramid without reduction is built", b2nd_pyramid_new(array, NLEVELS, (int32_t[]) {1, 1},
+                                                                        reduction) < 0);
+  B2ND_TEST_ASSERT(b2nd_pyramid_new(array, NLEVELS, factors, reduction));
+  CUTEST_ASSERT("Wrong levels", check_levels(array, values, factors, reduction) == 0);
+
+  /* The windows of the items set are recomputed */
+  int64_t start[2] = {5, 11};
+  int64_t stop[2] = {17, 36};
+  int64_t slice_shape[2] = {stop[0] - start[0], stop[1] - start[1]};
+  int32_t *slice = malloc(slice_shape[0] * slice_shape[1] * sizeof(int32_t));
+  for (int64_t i = 0; i < slice_shape[0]; ++i) {
+    for (int64_t j = 0; j < slice_shape[1]; ++j) {
+      slice[i * slice_shape[1] + j] = (int32_t) (i * j + 1000);
+      values[(start[0] + i) * NCOLS + start[1] + j] = (int32_t) (i * j + 1000);
+    }
+  }
+  B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer(slice, slice_shape, slice_shape[0] * slice_shape[1] * sizeof(int32_t),
+                                          start, stop, array));
+  free(slice);
+  CUTEST_ASSERT("Wrong levels after setting a slice", check_levels(array, values, factors, reduction) == 0);
+
+  /* And the levels grow along with the array */
+  B2ND_TEST_ASSERT(b2nd_append(array, values + NROWS * NCOLS, NAPPENDED * NCOLS * sizeof(int32_t), 0));
+  CUTEST_ASSERT("Wrong levels after appending", check_levels(array, values, factors, reduction) == 0);
+
+  if (backend.persistent) {
+    B2ND_TEST_ASSERT(b2nd_free(array));
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &array));
+    CUTEST_ASSERT("Wrong levels after opening", check_levels(array, values, factors, reduction) == 0);
+  }
+
+  /* Steps that are multiples of the factors of a level read it as is, and the rest gather from it */
+  int64_t steps[][2] = {{1, 1}, {2, 3}, {4, 9}, {5, 7}, {9, 4}};
+  int64_t full_start[2] = {3, 1};
+  int64_t full_stop[2] = {NROWS + NAPPENDED, NCOLS - 2};
+  for (int s = 0; s < (int) (sizeof(steps) / sizeof(steps[0])); ++s) {
+    int64_t *step = steps[s];
+    int level = 0;
+    int64_t scale[2] = {1, 1};
+    while (level < NLEVELS && scale[0] * factors[0] <= step[0] && scale[1] * factors[1] <= step[1]) {
+      scale[0] *= factors[0];
+      scale[1] *= factors[1];
+      level++;
+    }
+    b2nd_array_t *level_array;
+    B2ND_TEST_ASSERT(b2nd_pyramid_get_level(array, level, &level_array));
+    int64_t level_nitems = level_array->shape[0] * level_array->shape[1];
+    int32_t *level_items = malloc(level_nitems * sizeof(int32_t));
+    int64_t zeros[2] = {0, 0};
+    B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(level_array, zeros, level_array->shape, level_items,
+                                            level_array->shape, level_nitems * (int64_t) sizeof(int32_t)));
+    int64_t buffershape[2] = {(full_stop[0] - full_start[0] + step[0] - 1) / step[0],
+                              (full_stop[1] - full_start[1] + step[1] - 1) / step[1]};
+    int64_t buffersize = buffershape[0] * buffershape[1] * (int64_t) sizeof(int32_t);
+    int32_t *buffer = malloc(buffersize);
+    B2ND_TEST_ASSERT(b2nd_pyramid_get_slice_cbuffer(array, full_start, full_stop, step, buffer, buffershape,
+                                                    buffersize));
+    for (int64_t i = 0; i < buffershape[0]; ++i) {
+      for (int64_t j = 0; j < buffershape[1]; ++j) {
+        int64_t li = (full_start[0] + i * step[0]) / scale[0];
+        int64_t lj = (full_start[1] + j * step[1]) / scale[1];
+        CUTEST_ASSERT("Wrong item of the pyramid",
+                      buffer[i * buffershape[1] + j] == level_items[li * level_array->shape[1] + lj]);
+      }
+    }
+    free(buffer);
+    free(level_items);
+  }
+
+  /* The pyramid goes away for good */
+  B2ND_TEST_ASSERT(b2nd_pyramid_new(array, 0, NULL, reduction));
+  CUTEST_ASSERT("The pyramid is not removed", b2nd_pyramid_nlevels(array) == 0);
+  if (backend.persistent) {
+    B2ND_TEST_ASSERT(b2nd_free(array));
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &array));
+    CUTEST_ASSERT("The pyramid is opened again", b2nd_pyramid_nlevels(array) == 0);
+  }
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  /* Items that are not numbers cannot be averaged */
+  blosc2_storage mem_storage = {.cparams=&cparams};
+  ctx = b2nd_create_ctx(&mem_storage, 2, shape, chunkshape, blockshape, "|V4", DTYPE_NUMPY_FORMAT, NULL, 0);
+  B2ND_TEST_ASSERT(b2nd_zeros(ctx, &array));
+  int rc = b2nd_pyramid_new(array, NLEVELS, factors, reduction);
+  CUTEST_ASSERT("Wrong reduction of raw items", reduction == B2ND_PYRAMID_NEAREST ? rc == 0 : rc < 0);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  free(values);
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(pyramid) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(pyramid);
+}
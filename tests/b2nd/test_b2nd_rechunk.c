@@ -0,0 +1,138 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int32_t chunkshape2[B2ND_MAX_DIM];
+  int32_t blockshape2[B2ND_MAX_DIM];
+} test_shapes_t;
+
+
+CUTEST_TEST_SETUP(rechunk) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(
+      2,
+      8,
+  ));
+  CUTEST_PARAMETRIZE(shapes, test_shapes_t, CUTEST_DATA(
+      {2, {200, 60}, {200, 1}, {50, 1}, {1, 60}, {1, 20}},  // from columns to rows
+      {3, {40, 15, 23}, {31, 5, 22}, {4, 4, 4}, {30, 5, 20}, {10, 4, 4}},
+      {3, {20, 32, 32}, {20, 4, 4}, {5, 4, 4}, {1, 32, 32}, {1, 16, 16}},
+      {1, {1000}, {300}, {70}, {128}, {32}},
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {false, true},
+      {true, true},
+  ));
+  // A bound that lets the smallest regions through, and one that does not
+  CUTEST_PARAMETRIZE(max_mem, int64_t, CUTEST_DATA(
+      B2ND_DEFAULT_RECHUNK_MEM,
+      2000,
+  ));
+  CUTEST_PARAMETRIZE(tmp_urlpath, char *, CUTEST_DATA(
+      NULL,
+      "test_rechunk_tmp.b2frame",
+  ));
+}
+
+CUTEST_TEST_TEST(rechunk) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(shapes, test_shapes_t);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(max_mem, int64_t);
+  CUTEST_GET_PARAMETER(tmp_urlpath, char *);
+
+  char *urlpath = "test_rechunk.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage storage = {.cparams=&cparams};
+  blosc2_metalayer metalayers[1] = {{.name="random", .content=(uint8_t *) "12345678", .content_len=8}};
+  b2nd_context_t *ctx = b2nd_create_ctx(&storage, shapes.ndim, shapes.shape,
+                                        shapes.chunkshape, shapes.blockshape, NULL, 0, metalayers, 1);
+
+  int64_t nitems = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    nitems *= shapes.shape[i];
+  }
+  int64_t buffersize = nitems * typesize;
+  uint8_t *buffer = malloc(buffersize);
+  fill_buf(buffer, typesize, nitems);
+  b2nd_array_t *src;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &src, buffer, buffersize));
+  B2ND_TEST_ASSERT(blosc2_vlmeta_add(src->sc, "info", (uint8_t *) "rechunked", 9, NULL));
+
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  b2_storage.urlpath = backend.persistent ? urlpath : NULL;
+  b2nd_context_t *ctx2 = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape,
+                                         shapes.chunkshape2, shapes.blockshape2, NULL, 0, NULL, 0);
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_rechunk(ctx2, src, max_mem, tmp_urlpath, &array));
+  for (int i = 0; i < shapes.ndim; ++i) {
+    CUTEST_ASSERT("Wrong chunkshape", array->chunkshape[i] == shapes.chunkshape2[i]);
+  }
+
+  /* The items, the metalayers and the vlmetalayers are the ones of the source */
+  if (backend.persistent) {
+    B2ND_TEST_ASSERT(b2nd_free(array));
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &array));
+  }
+  uint8_t *result = malloc(buffersize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, result, buffersize));
+  CUTEST_ASSERT("Wrong items", memcmp(result, buffer, buffersize) == 0);
+  uint8_t *content;
+  int32_t content_len;
+  B2ND_TEST_ASSERT(blosc2_meta_get(array->sc, "random", &content, &content_len));
+  CUTEST_ASSERT("Wrong metalayer", content_len == 8 && memcmp(content, "12345678", 8) == 0);
+  free(content);
+  B2ND_TEST_ASSERT(blosc2_vlmeta_get(array->sc, "info", &content, &content_len));
+  CUTEST_ASSERT("Wrong vlmetalayer", content_len == 9 && memcmp(content, "rechunked", 9) == 0);
+  free(content);
+
+  /* The intermediate array is gone */
+  if (tmp_urlpath != NULL) {
+    FILE *file = fopen(tmp_urlpath, "rb");
+    CUTEST_ASSERT("The intermediate array is left", file == NULL);
+  }
+
+  b2nd_array_t *res;
+  CUTEST_ASSERT("A copy is made with no memory", b2nd_rechunk(ctx2, src, 0, tmp_urlpath, &res) < 0);
+
+  /* Free mallocs */
+  free(result);
+  free(buffer);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free(src));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx2));
+
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(rechunk) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(rechunk);
+}
@@ -0,0 +1,133 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <math.h>
+
+#include "test_common.h"
+
+#define ALL_OPS (BLOSC2_REDUCE_SUM | BLOSC2_REDUCE_MIN | BLOSC2_REDUCE_MAX | BLOSC2_REDUCE_COUNT)
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+} test_shapes_t;
+
+
+CUTEST_TEST_SETUP(reduce) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(dtype, char *, CUTEST_DATA(
+      "<i4",
+      "|u1",
+      "<f8",
+  ));
+  CUTEST_PARAMETRIZE(shapes, test_shapes_t, CUTEST_DATA(
+      {2, {40, 40}, {20, 20}, {10, 10}},
+      {2, {43, 37}, {20, 15}, {7, 6}},  // with padding in chunks and blocks
+      {3, {12, 10, 27}, {6, 5, 9}, {4, 4, 4}},
+      {1, {1000}, {300}, {64}},
+      {2, {0, 12}, {10, 6}, {5, 3}},  // no items
+  ));
+  CUTEST_PARAMETRIZE(zonemap, bool, CUTEST_DATA(false, true));
+}
+
+CUTEST_TEST_TEST(reduce) {
+  CUTEST_GET_PARAMETER(dtype, char *);
+  CUTEST_GET_PARAMETER(shapes, test_shapes_t);
+  CUTEST_GET_PARAMETER(zonemap, bool);
+
+  int8_t typesize = (int8_t) atoi(dtype + 2);
+  int kind = dtype[1] == 'i' ? BLOSC2_ZONEMAP_INT : dtype[1] == 'u' ? BLOSC2_ZONEMAP_UINT : BLOSC2_ZONEMAP_FLOAT;
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  cparams.zonemap = zonemap ? kind : BLOSC2_ZONEMAP_NONE;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape, shapes.chunkshape,
+                                        shapes.blockshape, dtype, DTYPE_NUMPY_FORMAT, NULL, 0);
+
+  /* Items that vary, with runs of a single value and a few NaNs for floats */
+  int64_t nitems = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    nitems *= shapes.shape[i];
+  }
+  uint8_t *buffer = malloc(nitems * typesize + 1);
+  double sum = 0;
+  double min = INFINITY;
+  double max = -INFINITY;
+  int64_t count = 0;
+  for (int64_t i = 0; i < nitems; ++i) {
+    int64_t value = (i / 100) % 2 == 0 ? 7 : (i * 13) % 101 - (kind == BLOSC2_ZONEMAP_UINT ? 0 : 50);
+    switch (typesize) {
+      case 1:
+        buffer[i] = (uint8_t) value;
+        break;
+      case 4:
+        ((int32_t *) buffer)[i] = (int32_t) value;
+        break;
+      default:
+        ((double *) buffer)[i] = i % 31 == 0 ? NAN : (double) value;
+    }
+    if (typesize == 8 && i % 31 == 0) {
+      continue;
+    }
+    sum += (double) value;
+    min = (double) value < min ? (double) value : min;
+    max = (double) value > max ? (double) value : max;
+    count++;
+  }
+  b2nd_array_t *src;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &src, buffer, nitems * typesize));
+
+  /* The padding is left out */
+  blosc2_reduction result;
+  B2ND_TEST_ASSERT(b2nd_reduce(src, ALL_OPS, &result));
+  CUTEST_ASSERT("Wrong count", result.count == count && result.nnans == nitems - count);
+  switch (kind) {
+    case BLOSC2_ZONEMAP_INT:
+      CUTEST_ASSERT("Wrong reductions", result.sum.i == (int64_t) sum &&
+                    (count == 0 || (result.min.i == (int64_t) min && result.max.i == (int64_t) max)));
+      break;
+    case BLOSC2_ZONEMAP_UINT:
+      CUTEST_ASSERT("Wrong reductions", result.sum.u == (uint64_t) sum &&
+                    (count == 0 || (result.min.u == (uint64_t) min && result.max.u == (uint64_t) max)));
+      break;
+    default:
+      CUTEST_ASSERT("Wrong reductions", fabs(result.sum.f - sum) <= 1e-9 * fabs(sum) &&
+                    (count == 0 || (result.min.f == min && result.max.f == max)));
+  }
+  B2ND_TEST_ASSERT(b2nd_reduce(src, BLOSC2_REDUCE_COUNT, &result));
+  CUTEST_ASSERT("Wrong count alone", result.count == count && result.sum.u == 0);
+
+  B2ND_TEST_ASSERT(b2nd_free(src));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  /* Items that are not numbers are refused */
+  ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape, shapes.chunkshape,
+                        shapes.blockshape, typesize == 1 ? "|S1" : ">f8", DTYPE_NUMPY_FORMAT, NULL, 0);
+  B2ND_TEST_ASSERT(b2nd_zeros(ctx, &src));
+  CUTEST_ASSERT("Wrong dtype taken", b2nd_reduce(src, ALL_OPS, &result) < 0);
+  B2ND_TEST_ASSERT(b2nd_free(src));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  free(buffer);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(reduce) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(reduce);
+}
@@ -0,0 +1,153 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int8_t axis;
+  int64_t start;
+  int64_t len;  // items deleted when positive, zeros inserted when negative
+  bool reused;  // whether the last chunk goes as it is
+} test_shapes_t;
+
+
+CUTEST_TEST_SETUP(shift) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(
+      2,
+      4,
+  ));
+  CUTEST_PARAMETRIZE(shapes, test_shapes_t, CUTEST_DATA(
+      {2, {50, 12}, {10, 6}, {5, 3}, 0, 3, 4, false},  // the first few rows
+      {2, {50, 12}, {10, 6}, {5, 3}, 0, 3, 20, true},  // whole chunks past the first one
+      {2, {50, 12}, {10, 6}, {5, 3}, 0, 7, 25, false},
+      {3, {12, 10, 27}, {3, 5, 9}, {3, 4, 4}, 2, 4, 9, true},
+      {3, {12, 10, 25}, {3, 5, 9}, {3, 4, 4}, 2, 13, 11, false},  // up to the last chunk
+      {2, {50, 12}, {10, 6}, {5, 3}, 0, 3, -4, false},
+      {2, {50, 12}, {10, 6}, {5, 3}, 0, 3, -20, true},
+      {3, {12, 10, 25}, {3, 5, 9}, {3, 4, 4}, 1, 5, -10, true},
+      {3, {12, 10, 25}, {3, 5, 9}, {3, 4, 4}, 2, 22, -9, false},  // in the last chunk
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {false, true},
+      {true, true},
+  ));
+}
+
+CUTEST_TEST_TEST(shift) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(shapes, test_shapes_t);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+
+  char *urlpath = "test_shift.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  b2_storage.urlpath = backend.persistent ? urlpath : NULL;
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape,
+                                        shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+
+  int64_t nitems = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    nitems *= shapes.shape[i];
+  }
+  uint8_t *buffer = malloc(nitems * typesize);
+  fill_buf(buffer, typesize, nitems);
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, nitems * typesize));
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_chunk(array->sc, array->sc->nchunks - 1, &chunk, &needs_free);
+  uint8_t *last = malloc(cbytes);
+  memcpy(last, chunk, cbytes);
+  if (needs_free) {
+    free(chunk);
+  }
+
+  int64_t new_shape[B2ND_MAX_DIM];
+  memcpy(new_shape, shapes.shape, sizeof(new_shape));
+  new_shape[shapes.axis] -= shapes.len;
+  if (shapes.len > 0) {
+    B2ND_TEST_ASSERT(b2nd_delete(array, shapes.axis, shapes.start, shapes.len));
+  }
+  else {
+    int64_t start[B2ND_MAX_DIM] = {0};
+    start[shapes.axis] = shapes.start;
+    B2ND_TEST_ASSERT(b2nd_resize(array, new_shape, start));
+  }
+  CUTEST_ASSERT("Wrong shape", memcmp(array->shape, new_shape, shapes.ndim * sizeof(int64_t)) == 0);
+
+  /* The items past the deleted ones (or the zeros) come `len` positions before (or after) */
+  if (backend.persistent) {
+    B2ND_TEST_ASSERT(b2nd_free(array));
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &array));
+  }
+  uint8_t *result = malloc(array->nitems * typesize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, result, array->nitems * typesize));
+  uint8_t *zero = calloc(1, typesize);
+  int errors = 0;
+  int64_t index[B2ND_MAX_DIM];
+  for (int64_t i = 0; i < array->nitems; ++i) {
+    blosc2_unidim_to_multidim(shapes.ndim, new_shape, i, index);
+    const uint8_t *expected = zero;
+    bool inserted = shapes.len < 0 && index[shapes.axis] >= shapes.start &&
+                    index[shapes.axis] < shapes.start - shapes.len;
+    if (!inserted) {
+      if (index[shapes.axis] >= shapes.start) {
+        index[shapes.axis] += shapes.len;
+      }
+      int64_t j = 0;
+      for (int k = 0; k < shapes.ndim; ++k) {
+        j = j * shapes.shape[k] + index[k];
+      }
+      expected = buffer + j * typesize;
+    }
+    errors += memcmp(result + i * typesize, expected, typesize) != 0;
+  }
+  CUTEST_ASSERT("Wrong items", errors == 0);
+
+  /* The chunks past the affected ones go as they are */
+  cbytes = blosc2_schunk_get_chunk(array->sc, array->sc->nchunks - 1, &chunk, &needs_free);
+  CUTEST_ASSERT("The last chunk was rewritten", !shapes.reused || memcmp(chunk, last, cbytes) == 0);
+  if (needs_free) {
+    free(chunk);
+  }
+
+  /* Free mallocs */
+  free(zero);
+  free(last);
+  free(result);
+  free(buffer);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(shift) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(shift);
+}
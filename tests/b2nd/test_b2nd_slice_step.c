@@ -0,0 +1,121 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Slices with a step along every dimension */
+
+#include "test_common.h"
+
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int64_t start[B2ND_MAX_DIM];
+  int64_t stop[B2ND_MAX_DIM];
+  int64_t step[B2ND_MAX_DIM];
+} test_step_shapes;
+
+CUTEST_TEST_SETUP(slice_step) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(1, 4, 8));
+  CUTEST_PARAMETRIZE(shapes, test_step_shapes, CUTEST_DATA(
+      {1, {1000}, {300}, {20}, {5}, {993}, {7}},
+      {1, {1000}, {100}, {10}, {3}, {1000}, {250}},  // most of the blocks and chunks are skipped
+      {2, {40, 40}, {20, 20}, {10, 10}, {3, 17}, {38, 40}, {1, 3}},
+      {2, {40, 40}, {20, 20}, {5, 5}, {0, 0}, {40, 40}, {12, 11}},
+      {3, {40, 55, 23}, {10, 10, 10}, {5, 5, 5}, {3, 2, 0}, {37, 51, 23}, {4, 1, 6}},
+      {4, {20, 16, 12, 10}, {5, 8, 6, 5}, {5, 4, 3, 5}, {1, 0, 5, 2}, {19, 16, 7, 9}, {2, 5, 1, 3}},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(0, 4));  // 0 means no shared pool
+}
+
+CUTEST_TEST_TEST(slice_step) {
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(shapes, test_step_shapes);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+  blosc2_set_shared_threadpool(nthreads);
+  int8_t ndim = shapes.ndim;
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shapes.shape, shapes.chunkshape,
+                                        shapes.blockshape, NULL, 0, NULL, 0);
+
+  int64_t nitems = 1;
+  int64_t slice_shape[B2ND_MAX_DIM] = {0};
+  int64_t slice_nitems = 1;
+  int64_t step_shape[B2ND_MAX_DIM] = {0};
+  int64_t step_nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nitems *= shapes.shape[i];
+    slice_shape[i] = shapes.stop[i] - shapes.start[i];
+    slice_nitems *= slice_shape[i];
+    step_shape[i] = (slice_shape[i] + shapes.step[i] - 1) / shapes.step[i];
+    step_nitems *= step_shape[i];
+  }
+  uint8_t *buffer = malloc(nitems * typesize);
+  CUTEST_ASSERT("Buffer filled incorrectly", fill_buf(buffer, typesize, nitems));
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, nitems * typesize));
+
+  /* Get the whole slice and the items with the steps, and compare every item */
+  uint8_t *dense = malloc(slice_nitems * typesize);
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(array, shapes.start, shapes.stop, dense, slice_shape,
+                                          slice_nitems * typesize));
+  uint8_t *sampled = calloc(step_nitems, typesize);
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer_step(array, shapes.start, shapes.stop, shapes.step, sampled,
+                                               step_shape, step_nitems * typesize));
+  for (int64_t n = 0; n < step_nitems; ++n) {
+    int64_t index[B2ND_MAX_DIM];
+    blosc2_unidim_to_multidim(ndim, step_shape, n, index);
+    int64_t offset = 0;
+    for (int i = 0; i < ndim; ++i) {
+      offset = offset * slice_shape[i] + index[i] * shapes.step[i];
+    }
+    CUTEST_ASSERT("Elements are not equals!",
+                  memcmp(sampled + n * typesize, dense + offset * typesize, typesize) == 0);
+  }
+
+  /* A buffer that is too small, and a wrong step */
+  int64_t small_shape[B2ND_MAX_DIM];
+  int64_t zero_step[B2ND_MAX_DIM];
+  for (int i = 0; i < ndim; ++i) {
+    small_shape[i] = step_shape[i];
+    zero_step[i] = shapes.step[i];
+  }
+  small_shape[0]--;
+  zero_step[ndim - 1] = 0;
+  CUTEST_ASSERT("A small buffer is taken",
+                b2nd_get_slice_cbuffer_step(array, shapes.start, shapes.stop, shapes.step, sampled,
+                                            small_shape, step_nitems * typesize) < 0);
+  CUTEST_ASSERT("A zero step is taken",
+                b2nd_get_slice_cbuffer_step(array, shapes.start, shapes.stop, zero_step, sampled,
+                                            step_shape, step_nitems * typesize) < 0);
+
+  free(buffer);
+  free(dense);
+  free(sampled);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(slice_step) {
+  blosc2_set_shared_threadpool(0);
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(slice_step);
+}
@@ -0,0 +1,148 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Slices from and into buffers that are not C-ordered */
+
+#include "test_common.h"
+
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int64_t start[B2ND_MAX_DIM];
+  int64_t stop[B2ND_MAX_DIM];
+} test_strided_shapes;
+
+/* The layouts of the strided buffers */
+enum {
+  LAYOUT_FORTRAN,  // the first dimension is the fastest one
+  LAYOUT_SPACED,  // C order with a gap of one item after every item
+  LAYOUT_REVERSED,  // C order with the last dimension reversed
+};
+
+CUTEST_TEST_SETUP(slice_strided) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(1, 4, 8));
+  CUTEST_PARAMETRIZE(shapes, test_strided_shapes, CUTEST_DATA(
+      {1, {100}, {30}, {7}, {5}, {93}},
+      {2, {40, 40}, {20, 20}, {10, 10}, {3, 17}, {38, 40}},
+      {3, {40, 55, 23}, {10, 10, 10}, {5, 5, 5}, {3, 2, 0}, {37, 51, 23}},
+      {4, {20, 16, 12, 10}, {5, 8, 6, 5}, {5, 4, 3, 5}, {1, 0, 5, 2}, {19, 16, 7, 9}},
+  ));
+  CUTEST_PARAMETRIZE(layout, int, CUTEST_DATA(LAYOUT_FORTRAN, LAYOUT_SPACED, LAYOUT_REVERSED));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(0, 4));  // 0 means no shared pool
+}
+
+CUTEST_TEST_TEST(slice_strided) {
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(shapes, test_strided_shapes);
+  CUTEST_GET_PARAMETER(layout, int);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+  blosc2_set_shared_threadpool(nthreads);
+  int8_t ndim = shapes.ndim;
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shapes.shape, shapes.chunkshape,
+                                        shapes.blockshape, NULL, 0, NULL, 0);
+
+  int64_t nitems = 1;
+  int64_t slice_shape[B2ND_MAX_DIM] = {0};
+  int64_t slice_nitems = 1;
+  for (int i = 0; i < ndim; ++i) {
+    nitems *= shapes.shape[i];
+    slice_shape[i] = shapes.stop[i] - shapes.start[i];
+    slice_nitems *= slice_shape[i];
+  }
+  uint8_t *buffer = malloc(nitems * typesize);
+  CUTEST_ASSERT("Buffer filled incorrectly", fill_buf(buffer, typesize, nitems));
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, nitems * typesize));
+
+  /* The strides of the layout, and where the first item is */
+  int64_t c_strides[B2ND_MAX_DIM];
+  int64_t strides[B2ND_MAX_DIM];
+  c_strides[ndim - 1] = typesize;
+  for (int i = ndim - 2; i >= 0; --i) {
+    c_strides[i] = c_strides[i + 1] * slice_shape[i + 1];
+  }
+  int64_t strided_nbytes = slice_nitems * typesize;
+  int64_t first = 0;
+  switch (layout) {
+    case LAYOUT_FORTRAN:
+      strides[0] = typesize;
+      for (int i = 1; i < ndim; ++i) {
+        strides[i] = strides[i - 1] * slice_shape[i - 1];
+      }
+      break;
+    case LAYOUT_SPACED:
+      for (int i = 0; i < ndim; ++i) {
+        strides[i] = 2 * c_strides[i];
+      }
+      strided_nbytes *= 2;
+      break;
+    default:
+      for (int i = 0; i < ndim; ++i) {
+        strides[i] = c_strides[i];
+      }
+      strides[ndim - 1] = -typesize;
+      first = (slice_shape[ndim - 1] - 1) * typesize;
+  }
+
+  /* Get the slice in C order and with the layout, and compare every item */
+  uint8_t *dense = malloc(slice_nitems * typesize);
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(array, shapes.start, shapes.stop, dense, slice_shape,
+                                          slice_nitems * typesize));
+  uint8_t *strided = calloc(strided_nbytes, 1);
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer_strided(array, shapes.start, shapes.stop, strided + first, strides));
+  for (int64_t n = 0; n < slice_nitems; ++n) {
+    int64_t index[B2ND_MAX_DIM];
+    blosc2_unidim_to_multidim(ndim, slice_shape, n, index);
+    int64_t offset = first;
+    for (int i = 0; i < ndim; ++i) {
+      offset += index[i] * strides[i];
+    }
+    CUTEST_ASSERT("Elements are not equals!", memcmp(strided + offset, dense + n * typesize, typesize) == 0);
+  }
+
+  /* Set it back with a different value, and get it in C order */
+  for (int64_t n = 0; n < strided_nbytes; ++n) {
+    strided[n] = (uint8_t) ~strided[n];
+  }
+  B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer_strided(strided + first, strides, shapes.start, shapes.stop, array));
+  uint8_t *dense2 = malloc(slice_nitems * typesize);
+  B2ND_TEST_ASSERT(b2nd_get_slice_cbuffer(array, shapes.start, shapes.stop, dense2, slice_shape,
+                                          slice_nitems * typesize));
+  for (int64_t n = 0; n < slice_nitems * typesize; ++n) {
+    CUTEST_ASSERT("Elements are not set!", (uint8_t) (dense2[n] ^ dense[n]) == 0xFF);
+  }
+
+  free(buffer);
+  free(dense);
+  free(dense2);
+  free(strided);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(slice_strided) {
+  blosc2_set_shared_threadpool(0);
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(slice_strided);
+}
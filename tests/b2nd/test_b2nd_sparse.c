@@ -0,0 +1,192 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int64_t start[B2ND_MAX_DIM];  // of the items that are set
+  int64_t stop[B2ND_MAX_DIM];
+  int32_t chunkshape2[B2ND_MAX_DIM];  // of the copy
+  int32_t blockshape2[B2ND_MAX_DIM];
+} test_shapes_t;
+
+
+/* Count the chunks (and the items in them) that intersect the items that are set */
+static void count_set(const test_shapes_t *shapes, const int32_t *chunkshape, int64_t *nchunks,
+                      int64_t *nset_chunks, int64_t *nset_items) {
+  int64_t chunks_in_array[B2ND_MAX_DIM];
+  *nchunks = 1;
+  for (int i = 0; i < shapes->ndim; ++i) {
+    chunks_in_array[i] = (shapes->shape[i] + chunkshape[i] - 1) / chunkshape[i];
+    *nchunks *= chunks_in_array[i];
+  }
+  *nset_chunks = 0;
+  *nset_items = 0;
+  for (int64_t nchunk = 0; nchunk < *nchunks; ++nchunk) {
+    int64_t coords[B2ND_MAX_DIM];
+    blosc2_unidim_to_multidim(shapes->ndim, chunks_in_array, nchunk, coords);
+    bool touched = true;
+    int64_t chunk_nitems = 1;
+    for (int i = 0; i < shapes->ndim; ++i) {
+      int64_t start = coords[i] * chunkshape[i];
+      int64_t stop = start + chunkshape[i] < shapes->shape[i] ? start + chunkshape[i] : shapes->shape[i];
+      touched &= start < shapes->stop[i] && stop > shapes->start[i];
+      chunk_nitems *= stop - start;
+    }
+    if (touched) {
+      (*nset_chunks)++;
+      *nset_items += chunk_nitems;
+    }
+  }
+}
+
+
+CUTEST_TEST_SETUP(sparse) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(
+      1,
+      4,
+  ));
+  CUTEST_PARAMETRIZE(shapes, test_shapes_t, CUTEST_DATA(
+      {2, {100, 80}, {20, 20}, {10, 5}, {25, 30}, {38, 43}, {50, 40}, {10, 10}},
+      {3, {40, 37, 25}, {10, 10, 10}, {5, 5, 5}, {0, 0, 0}, {3, 37, 4}, {20, 20, 5}, {5, 5, 5}},
+      {1, {10000}, {1000}, {200}, {9990}, {10000}, {300}, {100}},  // in the last chunk
+      {2, {100, 80}, {20, 20}, {10, 5}, {0, 0}, {0, 0}, {50, 40}, {10, 10}},  // nothing is set
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {false, true},
+      {true, true},
+  ));
+}
+
+CUTEST_TEST_TEST(sparse) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(shapes, test_shapes_t);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+
+  char *urlpath = "test_sparse.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  b2_storage.urlpath = backend.persistent ? urlpath : NULL;
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, shapes.ndim, shapes.shape,
+                                        shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_zeros(ctx, &array));
+
+  /* Set some items, which makes the chunks around them regular */
+  int64_t shape[B2ND_MAX_DIM];
+  int64_t nitems = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    shape[i] = shapes.stop[i] - shapes.start[i];
+    nitems *= shape[i];
+  }
+  uint8_t *items = malloc(nitems * typesize + 1);
+  fill_buf(items, typesize, nitems);
+  for (int64_t i = 0; i < nitems * typesize; ++i) {
+    items[i] |= 1;  // no zeros
+  }
+  B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer(items, shape, nitems * typesize, shapes.start, shapes.stop, array));
+
+  /* The chunks that were not touched are counted as fill */
+  int64_t nchunks;
+  int64_t nset_chunks;
+  int64_t nset_items;
+  count_set(&shapes, shapes.chunkshape, &nchunks, &nset_chunks, &nset_items);
+  if (backend.persistent) {
+    B2ND_TEST_ASSERT(b2nd_free(array));
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &array));
+  }
+  int64_t nfill_chunks;
+  int64_t nfill_items;
+  B2ND_TEST_ASSERT(b2nd_count_fill(array, &nfill_chunks, &nfill_items));
+  CUTEST_ASSERT("Wrong fill chunks", nfill_chunks == nchunks - nset_chunks);
+  CUTEST_ASSERT("Wrong fill items", nfill_items == array->nitems - nset_items);
+
+  /* The iterator goes through the items that are set, and the rest are zeros */
+  uint8_t *expected = calloc(array->nitems, typesize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, expected, array->nitems * typesize));
+  uint8_t *result = calloc(array->nitems, typesize);
+  b2nd_sparse_iter_t *iter;
+  B2ND_TEST_ASSERT(b2nd_sparse_iter_new(array, &iter));
+  int64_t start[B2ND_MAX_DIM];
+  int64_t stop[B2ND_MAX_DIM];
+  void *data;
+  int64_t niter_chunks = 0;
+  int rc;
+  while ((rc = b2nd_sparse_iter_next(iter, start, stop, &data)) == 1) {
+    niter_chunks++;
+    int64_t chunk_shape[B2ND_MAX_DIM];
+    int64_t chunk_nitems = 1;
+    for (int i = 0; i < shapes.ndim; ++i) {
+      chunk_shape[i] = stop[i] - start[i];
+      chunk_nitems *= chunk_shape[i];
+    }
+    int64_t index[B2ND_MAX_DIM];
+    for (int64_t i = 0; i < chunk_nitems; ++i) {
+      blosc2_unidim_to_multidim(shapes.ndim, chunk_shape, i, index);
+      int64_t j = 0;
+      for (int k = 0; k < shapes.ndim; ++k) {
+        j = j * shapes.shape[k] + start[k] + index[k];
+      }
+      memcpy(result + j * typesize, (uint8_t *) data + i * typesize, typesize);
+    }
+  }
+  B2ND_TEST_ASSERT(rc);
+  CUTEST_ASSERT("Wrong chunks iterated", niter_chunks == nset_chunks);
+  CUTEST_ASSERT("Wrong items iterated", memcmp(result, expected, array->nitems * typesize) == 0);
+  CUTEST_ASSERT("The iterator goes on", b2nd_sparse_iter_next(iter, start, stop, &data) == 0);
+  B2ND_TEST_ASSERT(b2nd_sparse_iter_free(iter));
+
+  /* A copy into other chunks (in small regions) keeps the regions with no items set as fill chunks */
+  blosc2_storage storage = {.cparams=&cparams};
+  b2nd_context_t *ctx2 = b2nd_create_ctx(&storage, shapes.ndim, shapes.shape,
+                                         shapes.chunkshape2, shapes.blockshape2, NULL, 0, NULL, 0);
+  b2nd_array_t *copy;
+  B2ND_TEST_ASSERT(b2nd_rechunk(ctx2, array, 4096, NULL, &copy));
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(copy, result, array->nitems * typesize));
+  CUTEST_ASSERT("Wrong items copied", memcmp(result, expected, array->nitems * typesize) == 0);
+  count_set(&shapes, shapes.chunkshape2, &nchunks, &nset_chunks, &nset_items);
+  B2ND_TEST_ASSERT(b2nd_count_fill(copy, &nfill_chunks, &nfill_items));
+  CUTEST_ASSERT("The fill chunks are not copied as such",
+                nfill_chunks == nchunks - nset_chunks && nfill_items == array->nitems - nset_items);
+
+  /* Free mallocs */
+  free(result);
+  free(expected);
+  free(items);
+  B2ND_TEST_ASSERT(b2nd_free(copy));
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx2));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(sparse) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(sparse);
+}
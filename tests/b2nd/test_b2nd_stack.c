@@ -0,0 +1,176 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+#define NSRCS 3
+
+typedef struct {
+  int8_t ndim;
+  int64_t shape[B2ND_MAX_DIM];
+  int32_t chunkshape[B2ND_MAX_DIM];
+  int32_t blockshape[B2ND_MAX_DIM];
+  int8_t axis;
+  int32_t chunkshape2[B2ND_MAX_DIM];  // of the result
+  int32_t blockshape2[B2ND_MAX_DIM];
+  bool moved;  // whether the chunks of the arrays go as they are
+} test_shapes_t;
+
+
+CUTEST_TEST_SETUP(stack) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(
+      2,
+      8,
+  ));
+  CUTEST_PARAMETRIZE(shapes, test_shapes_t, CUTEST_DATA(
+      {2, {20, 30}, {10, 10}, {5, 5}, 0, {1, 10, 10}, {1, 5, 5}, true},
+      {2, {20, 30}, {10, 10}, {5, 5}, 1, {10, 1, 10}, {5, 1, 5}, true},
+      {2, {17, 23}, {10, 10}, {5, 5}, 2, {10, 10, 1}, {5, 5, 1}, true},
+      {2, {20, 30}, {10, 10}, {5, 5}, 0, {2, 10, 10}, {1, 5, 5}, false},
+      {1, {100}, {30}, {10}, 1, {20, 2}, {10, 2}, false},
+  ));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {false, true},
+      {true, true},
+  ));
+}
+
+CUTEST_TEST_TEST(stack) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(shapes, test_shapes_t);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+
+  char *urlpath = "test_stack.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage storage = {.cparams=&cparams};
+  b2nd_context_t *ctx = b2nd_create_ctx(&storage, shapes.ndim, shapes.shape,
+                                        shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+  // The shape of the result is set by the stack
+  int64_t shape2[B2ND_MAX_DIM] = {0};
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  b2_storage.urlpath = backend.persistent ? urlpath : NULL;
+  b2nd_context_t *ctx2 = b2nd_create_ctx(&b2_storage, (int8_t) (shapes.ndim + 1), shape2,
+                                         shapes.chunkshape2, shapes.blockshape2, NULL, 0, NULL, 0);
+
+  /* Create the arrays, with different items */
+  int64_t nitems = 1;
+  for (int i = 0; i < shapes.ndim; ++i) {
+    nitems *= shapes.shape[i];
+  }
+  uint8_t *buffers[NSRCS];
+  b2nd_array_t *srcs[NSRCS];
+  for (int n = 0; n < NSRCS; ++n) {
+    buffers[n] = malloc(nitems * typesize);
+    fill_buf(buffers[n], typesize, nitems);
+    for (int64_t i = 0; i < nitems * typesize; ++i) {
+      buffers[n][i] ^= (uint8_t) (0x11 * n);
+    }
+    B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &srcs[n], buffers[n], nitems * typesize));
+  }
+
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_stack(ctx2, (const b2nd_array_t **) srcs, NSRCS, shapes.axis, &array));
+  CUTEST_ASSERT("Wrong ndim", array->ndim == shapes.ndim + 1);
+  CUTEST_ASSERT("Wrong shape", array->shape[shapes.axis] == NSRCS);
+
+  /* The items of every array are at its index along the new axis */
+  int64_t size = array->nitems * typesize;
+  uint8_t *result = malloc(size);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, result, size));
+  int errors = 0;
+  int64_t index[B2ND_MAX_DIM];
+  for (int64_t i = 0; i < array->nitems; ++i) {
+    blosc2_unidim_to_multidim(array->ndim, array->shape, i, index);
+    int64_t j = 0;
+    for (int k = 0, l = 0; k < array->ndim; ++k) {
+      if (k != shapes.axis) {
+        j = j * shapes.shape[l++] + index[k];
+      }
+    }
+    errors += memcmp(result + i * typesize, buffers[index[shapes.axis]] + j * typesize, typesize) != 0;
+  }
+  CUTEST_ASSERT("Wrong items", errors == 0);
+
+  /* The chunks of the arrays were not recompressed */
+  if (shapes.moved) {
+    uint8_t *chunk;
+    uint8_t *chunk2;
+    bool needs_free;
+    bool needs_free2;
+    int cbytes = blosc2_schunk_get_chunk(array->sc, array->sc->nchunks - 1, &chunk, &needs_free);
+    int cbytes2 = blosc2_schunk_get_chunk(srcs[NSRCS - 1]->sc, srcs[NSRCS - 1]->sc->nchunks - 1,
+                                          &chunk2, &needs_free2);
+    CUTEST_ASSERT("The chunk was recompressed", cbytes == cbytes2 && memcmp(chunk, chunk2, cbytes) == 0);
+    if (needs_free) {
+      free(chunk);
+    }
+    if (needs_free2) {
+      free(chunk2);
+    }
+  }
+
+  /* The shape persists */
+  if (backend.persistent) {
+    int64_t shape[B2ND_MAX_DIM];
+    memcpy(shape, array->shape, sizeof(shape));
+    B2ND_TEST_ASSERT(b2nd_free(array));
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &array));
+    CUTEST_ASSERT("Wrong shape after reopening",
+                  array->ndim == shapes.ndim + 1 && memcmp(array->shape, shape, array->ndim * sizeof(int64_t)) == 0);
+  }
+
+  /* Arrays of other shapes cannot be stacked */
+  b2nd_context_t *ctx3 = b2nd_create_ctx(&storage, (int8_t) (shapes.ndim + 1), shape2,
+                                         shapes.chunkshape2, shapes.blockshape2, NULL, 0, NULL, 0);
+  b2nd_array_t *res;
+  CUTEST_ASSERT("Arrays are stacked along a wrong axis",
+                b2nd_stack(ctx3, (const b2nd_array_t **) srcs, NSRCS, (int8_t) (shapes.ndim + 1), &res) < 0);
+  shapes.shape[0]++;
+  b2nd_context_t *ctx4 = b2nd_create_ctx(&storage, shapes.ndim, shapes.shape,
+                                         shapes.chunkshape, shapes.blockshape, NULL, 0, NULL, 0);
+  b2nd_array_t *other;
+  B2ND_TEST_ASSERT(b2nd_zeros(ctx4, &other));
+  const b2nd_array_t *others[] = {srcs[0], other};
+  CUTEST_ASSERT("An array of another shape is stacked", b2nd_stack(ctx3, others, 2, shapes.axis, &res) < 0);
+  B2ND_TEST_ASSERT(b2nd_free(other));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx4));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx3));
+
+  /* Free mallocs */
+  free(result);
+  for (int n = 0; n < NSRCS; ++n) {
+    free(buffers[n]);
+    B2ND_TEST_ASSERT(b2nd_free(srcs[n]));
+  }
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx2));
+
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(stack) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(stack);
+}
@@ -0,0 +1,141 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/* Lazy views of arrays, sliced and squeezed before reading */
+
+#include "test_common.h"
+
+#define D0 30
+#define D1 25
+#define D2 20
+
+
+CUTEST_TEST_SETUP(views) {
+  blosc2_init();
+
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {true, true},
+      {false, true},
+  ));
+}
+
+CUTEST_TEST_TEST(views) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+
+  char *urlpath = "test_b2nd_views.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage b2_storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  if (backend.persistent) {
+    b2_storage.urlpath = urlpath;
+  }
+  int64_t shape[] = {D0, D1, D2};
+  int32_t chunkshape[] = {10, 10, 7};
+  int32_t blockshape[] = {4, 5, 3};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, 3, shape, chunkshape, blockshape, NULL, 0, NULL, 0);
+  int32_t *buffer = malloc(D0 * D1 * D2 * sizeof(int32_t));
+  for (int32_t i = 0; i < D0 * D1 * D2; ++i) {
+    buffer[i] = i;
+  }
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, D0 * D1 * D2 * sizeof(int32_t)));
+  int32_t dest[D0 * D1 * D2];
+
+  /* A slice with steps of the whole array */
+  b2nd_view_t *view;
+  B2ND_TEST_ASSERT(b2nd_view_new(array, &view));
+  b2nd_view_t *stepped;
+  int64_t start[] = {2, 0, 1};
+  int64_t stop[] = {29, 25, 20};
+  int64_t step[] = {3, 1, 2};
+  B2ND_TEST_ASSERT(b2nd_view_slice(view, start, stop, step, &stepped));
+  int8_t ndim;
+  int64_t view_shape[B2ND_MAX_DIM];
+  B2ND_TEST_ASSERT(b2nd_view_get_shape(stepped, &ndim, view_shape));
+  CUTEST_ASSERT("Wrong shape", ndim == 3 && view_shape[0] == 9 && view_shape[1] == 25 && view_shape[2] == 10);
+  B2ND_TEST_ASSERT(b2nd_view_to_cbuffer(stepped, dest, sizeof(dest)));
+  for (int64_t i = 0, n = 0; i < 9; ++i) {
+    for (int64_t j = 0; j < 25; ++j) {
+      for (int64_t k = 0; k < 10; ++k, ++n) {
+        CUTEST_ASSERT("Wrong item", dest[n] == buffer[((2 + 3 * i) * D1 + j) * D2 + 1 + 2 * k]);
+      }
+    }
+  }
+
+  /* Slices of slices, squeezed */
+  b2nd_view_t *sliced;
+  int64_t start2[] = {1, 5, 0};
+  int64_t stop2[] = {8, 6, 9};
+  int64_t step2[] = {2, 1, 1};
+  B2ND_TEST_ASSERT(b2nd_view_slice(stepped, start2, stop2, step2, &sliced));
+  B2ND_TEST_ASSERT(b2nd_view_squeeze(sliced));
+  B2ND_TEST_ASSERT(b2nd_view_get_shape(sliced, &ndim, view_shape));
+  CUTEST_ASSERT("Wrong squeezed shape", ndim == 2 && view_shape[0] == 4 && view_shape[1] == 9);
+  B2ND_TEST_ASSERT(b2nd_view_to_cbuffer(sliced, dest, sizeof(dest)));
+  for (int64_t i = 0, n = 0; i < 4; ++i) {
+    for (int64_t k = 0; k < 9; ++k, ++n) {
+      CUTEST_ASSERT("Wrong composed item", dest[n] == buffer[((2 + 3 * (1 + 2 * i)) * D1 + 5) * D2 + 1 + 2 * k]);
+    }
+  }
+  int64_t start3[] = {1, 2};
+  int64_t stop3[] = {3, 7};
+  B2ND_TEST_ASSERT(b2nd_view_get_slice_cbuffer(sliced, start3, stop3, dest, sizeof(dest)));
+  for (int64_t i = 0, n = 0; i < 2; ++i) {
+    for (int64_t k = 0; k < 5; ++k, ++n) {
+      CUTEST_ASSERT("Wrong item of the slice",
+                    dest[n] == buffer[((2 + 3 * (1 + 2 * (1 + i))) * D1 + 5) * D2 + 1 + 2 * (2 + k)]);
+    }
+  }
+
+  /* Slices with no steps are read as such */
+  b2nd_view_t *plain;
+  int64_t start4[] = {5, 3, 2};
+  int64_t stop4[] = {15, 20, 19};
+  B2ND_TEST_ASSERT(b2nd_view_slice(view, start4, stop4, NULL, &plain));
+  B2ND_TEST_ASSERT(b2nd_view_to_cbuffer(plain, dest, sizeof(dest)));
+  for (int64_t i = 0, n = 0; i < 10; ++i) {
+    for (int64_t j = 0; j < 17; ++j) {
+      for (int64_t k = 0; k < 17; ++k, ++n) {
+        CUTEST_ASSERT("Wrong plain item", dest[n] == buffer[((5 + i) * D1 + 3 + j) * D2 + 2 + k]);
+      }
+    }
+  }
+
+  /* Wrong slices and buffers */
+  b2nd_view_t *wrong;
+  int64_t out[] = {0, 0, 11};
+  CUTEST_ASSERT("Slices out of the view are accepted", b2nd_view_slice(stepped, start2, out, NULL, &wrong) < 0);
+  int64_t zero_step[] = {1, 0, 1};
+  CUTEST_ASSERT("Null steps are accepted", b2nd_view_slice(view, start, stop, zero_step, &wrong) < 0);
+  CUTEST_ASSERT("Small buffers are accepted", b2nd_view_to_cbuffer(sliced, dest, 35 * sizeof(int32_t)) < 0);
+
+  B2ND_TEST_ASSERT(b2nd_view_free(plain));
+  B2ND_TEST_ASSERT(b2nd_view_free(sliced));
+  B2ND_TEST_ASSERT(b2nd_view_free(stepped));
+  B2ND_TEST_ASSERT(b2nd_view_free(view));
+  free(buffer);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(views) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(views);
+}
@@ -0,0 +1,158 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+
+#include "test_common.h"
+
+
+CUTEST_TEST_SETUP(write_cache) {
+  blosc2_init();
+
+  // Add parametrizations
+  CUTEST_PARAMETRIZE(typesize, uint8_t, CUTEST_DATA(8));
+  // The number of chunks that the cache holds
+  CUTEST_PARAMETRIZE(cache_chunks, int, CUTEST_DATA(1, 3, 100));
+  CUTEST_PARAMETRIZE(backend, _test_backend, CUTEST_DATA(
+      {false, false},
+      {true, false},
+      {true, true},
+      {false, true},
+  ));
+}
+
+CUTEST_TEST_TEST(write_cache) {
+  CUTEST_GET_PARAMETER(backend, _test_backend);
+  CUTEST_GET_PARAMETER(typesize, uint8_t);
+  CUTEST_GET_PARAMETER(cache_chunks, int);
+
+  char *urlpath = "test_b2nd_write_cache.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.nthreads = 2;
+  cparams.typesize = typesize;
+  blosc2_storage b2_storage = {.cparams=&cparams};
+  if (backend.persistent) {
+    b2_storage.urlpath = urlpath;
+  }
+  b2_storage.contiguous = backend.contiguous;
+
+  int8_t ndim = 2;
+  int64_t shape[] = {40, 30};
+  int32_t chunkshape[] = {20, 12};
+  int32_t blockshape[] = {7, 4};
+  b2nd_context_t *ctx = b2nd_create_ctx(&b2_storage, ndim, shape, chunkshape, blockshape,
+                                        NULL, 0, NULL, 0);
+
+  size_t buffersize = typesize * shape[0] * shape[1];
+  uint64_t *buffer = malloc(buffersize);
+  CUTEST_ASSERT("Buffer filled incorrectly", fill_buf(buffer, typesize, buffersize / typesize));
+  b2nd_array_t *array;
+  B2ND_TEST_ASSERT(b2nd_from_cbuffer(ctx, &array, buffer, buffersize));
+  int64_t chunk_nbytes = array->extchunknitems * typesize;
+  CUTEST_ASSERT("Caches smaller than a chunk are accepted",
+                b2nd_set_write_cache(array, chunk_nbytes - 1) < 0);
+  B2ND_TEST_ASSERT(b2nd_set_write_cache(array, cache_chunks * chunk_nbytes));
+
+  /* Scattered small writes, with reads in between that see them */
+  uint64_t *dest = malloc(buffersize);
+  for (int i = 0; i < 500; i++) {
+    int64_t start[] = {(i * 7919) % shape[0], (i * 104729) % shape[1]};
+    int64_t stop[] = {start[0] + 1 + i % 3, start[1] + 1 + i % 2};
+    stop[0] = stop[0] > shape[0] ? shape[0] : stop[0];
+    stop[1] = stop[1] > shape[1] ? shape[1] : stop[1];
+    int64_t slice_shape[] = {stop[0] - start[0], stop[1] - start[1]};
+    uint64_t slice[3 * 2];
+    for (int64_t k = 0; k < slice_shape[0]; k++) {
+      for (int64_t l = 0; l < slice_shape[1]; l++) {
+        slice[k * slice_shape[1] + l] = (uint64_t) (i * 1000 + k * 10 + l);
+        buffer[(start[0] + k) * shape[1] + start[1] + l] = slice[k * slice_shape[1] + l];
+      }
+    }
+    int64_t slice_size = slice_shape[0] * slice_shape[1] * typesize;
+    B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer(slice, slice_shape, slice_size, start, stop, array));
+    if (i % 50 == 0) {
+      B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, dest, buffersize));
+      CUTEST_ASSERT("Reads do not see the writes", memcmp(dest, buffer, buffersize) == 0);
+    }
+  }
+
+  /* The super-chunk only sees the last chunks once they are flushed */
+  int64_t nchunks = array->sc->nchunks;
+  if (cache_chunks >= nchunks) {
+    blosc2_schunk *sc = array->sc;
+    bool stale = false;
+    uint64_t *chunk = malloc(sc->chunksize);
+    for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+      B2ND_TEST_ASSERT(blosc2_schunk_decompress_chunk(sc, nchunk, chunk, sc->chunksize));
+      int64_t row = nchunk / 3 * chunkshape[0];
+      int64_t col = nchunk % 3 * chunkshape[1];
+      stale |= chunk[0] != buffer[row * shape[1] + col];
+    }
+    CUTEST_ASSERT("The chunks are written before flushing", stale);
+    B2ND_TEST_ASSERT(b2nd_flush(array));
+    for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+      B2ND_TEST_ASSERT(blosc2_schunk_decompress_chunk(sc, nchunk, chunk, sc->chunksize));
+      int64_t row = nchunk / 3 * chunkshape[0];
+      int64_t col = nchunk % 3 * chunkshape[1];
+      CUTEST_ASSERT("Wrong chunk flushed", chunk[0] == buffer[row * shape[1] + col]);
+    }
+    free(chunk);
+  }
+
+  /* Functions working on the super-chunk see the writes */
+  int64_t start[] = {3, 5};
+  uint64_t item = 12345;
+  buffer[3 * shape[1] + 5] = item;
+  int64_t item_shape[] = {1, 1};
+  int64_t item_stop[] = {4, 6};
+  B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer(&item, item_shape, typesize, start, item_stop, array));
+  b2nd_array_t *copy;
+  blosc2_storage copy_storage = {.cparams=&cparams};
+  b2nd_context_t *copy_ctx = b2nd_create_ctx(&copy_storage, ndim, shape, chunkshape, blockshape,
+                                             NULL, 0, NULL, 0);
+  B2ND_TEST_ASSERT(b2nd_copy(copy_ctx, array, &copy));
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(copy, dest, buffersize));
+  CUTEST_ASSERT("The copy does not see the writes", memcmp(dest, buffer, buffersize) == 0);
+  B2ND_TEST_ASSERT(b2nd_free(copy));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(copy_ctx));
+
+  /* The chunks in the cache are written when freeing the array */
+  item = 54321;
+  buffer[3 * shape[1] + 5] = item;
+  B2ND_TEST_ASSERT(b2nd_set_slice_cbuffer(&item, item_shape, typesize, start, item_stop, array));
+  if (backend.persistent) {
+    B2ND_TEST_ASSERT(b2nd_free(array));
+    B2ND_TEST_ASSERT(b2nd_open(urlpath, &array));
+  }
+  else {
+    B2ND_TEST_ASSERT(b2nd_set_write_cache(array, 0));
+    CUTEST_ASSERT("The cache is not disabled", array->write_cache == NULL);
+  }
+  memset(dest, 0, buffersize);
+  B2ND_TEST_ASSERT(b2nd_to_cbuffer(array, dest, buffersize));
+  CUTEST_ASSERT("The writes are lost", memcmp(dest, buffer, buffersize) == 0);
+
+  free(buffer);
+  free(dest);
+  B2ND_TEST_ASSERT(b2nd_free(array));
+  B2ND_TEST_ASSERT(b2nd_free_ctx(ctx));
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(write_cache) {
+  blosc2_destroy();
+}
+
+int main() {
+  CUTEST_TEST_RUN(write_cache);
+}
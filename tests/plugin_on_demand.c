@@ -0,0 +1,89 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  A codec and a filter plugin that test_plugin_path loads on demand, by id, from
+  BLOSC_PLUGIN_PATH (as libblosc2_codec_250 and libblosc2_filter_250).
+*/
+
+#include "blosc2.h"
+#include "blosc2/codecs-registry.h"
+#include "blosc2/filters-registry.h"
+
+#if defined(_WIN32)
+#define PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+#if defined(PLUGIN_FILTER)
+
+/* Add one to every byte */
+PLUGIN_EXPORT int plugin_forward(const uint8_t *src, uint8_t *dest, int32_t size, uint8_t meta,
+                                 blosc2_cparams *cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(cparams);
+  BLOSC_UNUSED_PARAM(id);
+  for (int32_t i = 0; i < size; i++) {
+    dest[i] = (uint8_t) (src[i] + 1);
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+PLUGIN_EXPORT int plugin_backward(const uint8_t *src, uint8_t *dest, int32_t size, uint8_t meta,
+                                  blosc2_dparams *dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(id);
+  for (int32_t i = 0; i < size; i++) {
+    dest[i] = (uint8_t) (src[i] - 1);
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+PLUGIN_EXPORT filter_info info = {"plugin_forward", "plugin_backward"};
+
+#else
+
+/* Store the runs of bytes as (length, byte) pairs */
+PLUGIN_EXPORT int plugin_encoder(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                                 uint8_t meta, blosc2_cparams *cparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(cparams);
+  BLOSC_UNUSED_PARAM(chunk);
+  int32_t csize = 0;
+  for (int32_t i = 0; i < input_len;) {
+    int32_t run = 1;
+    while (i + run < input_len && run < 255 && input[i + run] == input[i]) {
+      run++;
+    }
+    if (csize + 2 > output_len) {
+      return 0;
+    }
+    output[csize++] = (uint8_t) run;
+    output[csize++] = input[i];
+    i += run;
+  }
+  return csize;
+}
+
+PLUGIN_EXPORT int plugin_decoder(const uint8_t *input, int32_t input_len, uint8_t *output, int32_t output_len,
+                                 uint8_t meta, blosc2_dparams *dparams, const void *chunk) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(chunk);
+  int32_t size = 0;
+  for (int32_t i = 0; i + 1 < input_len; i += 2) {
+    if (size + input[i] > output_len) {
+      return BLOSC2_ERROR_WRITE_BUFFER;
+    }
+    memset(output + size, input[i + 1], input[i]);
+    size += input[i];
+  }
+  return size;
+}
+
+PLUGIN_EXPORT codec_info info = {"plugin_encoder", "plugin_decoder"};
+
+#endif
@@ -0,0 +1,182 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the allocators of the internal buffers (blosc2_set_allocator()).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (20 * 1000)
+#define NCHUNKS 10
+
+
+typedef struct {
+  int16_t nthreads;
+  bool contiguous;
+} test_allocator_backend;
+
+CUTEST_TEST_DATA(allocator) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(allocator) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_allocator_backend, CUTEST_DATA(
+      {1, false},
+      {4, false},
+      {1, true},
+      {4, true},
+  ));
+}
+
+
+/* Counts the live buffers (and checks their alignment) */
+typedef struct {
+  int64_t nallocs;
+  int64_t nfrees;
+  bool misaligned;
+} allocator_stats;
+
+static void *counting_malloc(size_t size, size_t alignment, void *params) {
+  allocator_stats *stats = params;
+  void *ptr = NULL;
+#if defined(_WIN32)
+  ptr = _aligned_malloc(size, alignment);
+#else
+  if (posix_memalign(&ptr, alignment, size) != 0) {
+    return NULL;
+  }
+#endif
+  if ((uintptr_t) ptr % alignment != 0) {
+    stats->misaligned = true;
+  }
+  __atomic_fetch_add(&stats->nallocs, 1, __ATOMIC_RELAXED);
+  return ptr;
+}
+
+static void counting_free(void *ptr, void *params) {
+  allocator_stats *stats = params;
+  __atomic_fetch_add(&stats->nfrees, 1, __ATOMIC_RELAXED);
+#if defined(_WIN32)
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+
+CUTEST_TEST_TEST(allocator) {
+  CUTEST_GET_PARAMETER(backend, test_allocator_backend);
+
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  int32_t *rec_buffer = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data_buffer[j] = j;
+  }
+
+  blosc2_allocator bad = {counting_malloc, NULL, NULL};
+  CUTEST_ASSERT("An allocator without free must be refused", blosc2_set_allocator(&bad) < 0);
+
+  /* The global allocator serves the contexts without one of their own */
+  allocator_stats global_stats = {0};
+  blosc2_allocator global = {counting_malloc, counting_free, &global_stats};
+  CUTEST_ASSERT("Cannot set the allocator", blosc2_set_allocator(&global) == 0);
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = backend.nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = backend.nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int cbytes = blosc2_compress_ctx(cctx, data_buffer, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Error compressing", cbytes > 0);
+  CUTEST_ASSERT("Error decompressing", blosc2_decompress_ctx(dctx, chunk, cbytes, rec_buffer, nbytes) == nbytes);
+  CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, nbytes) == 0);
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  CUTEST_ASSERT("The global allocator was not used", global_stats.nallocs > 0);
+  CUTEST_ASSERT("Buffers were leaked", global_stats.nallocs == global_stats.nfrees);
+  CUTEST_ASSERT("Buffers are not aligned", !global_stats.misaligned);
+
+  /* The allocator of a super-chunk is used for all its contexts and index updates */
+  allocator_stats schunk_stats = {0};
+  blosc2_allocator own = {counting_malloc, counting_free, &schunk_stats};
+  cparams.allocator = &own;
+  dparams.allocator = &own;
+  int64_t global_nallocs = global_stats.nallocs;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .contiguous=backend.contiguous};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; ++i) {
+    CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data_buffer, nbytes) == i + 1);
+  }
+  int64_t nallocs = schunk_stats.nallocs;
+  CUTEST_ASSERT("Error updating", blosc2_schunk_update_chunk(schunk, 1, chunk, true) == NCHUNKS);
+  CUTEST_ASSERT("Error deleting", blosc2_schunk_delete_chunk(schunk, 2) == NCHUNKS - 1);
+  if (backend.contiguous) {
+    CUTEST_ASSERT("The index updates did not use the allocator", schunk_stats.nallocs > nallocs);
+  }
+  for (int i = 0; i < NCHUNKS - 1; ++i) {
+    CUTEST_ASSERT("Error decompressing", blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes) == nbytes);
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, nbytes) == 0);
+  }
+  blosc2_cparams *cparams_out;
+  CUTEST_ASSERT("Cannot get the cparams", blosc2_schunk_get_cparams(schunk, &cparams_out) == 0);
+  CUTEST_ASSERT("The allocator is not kept in the cparams", cparams_out->allocator == &own);
+  free(cparams_out);
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Buffers were leaked", schunk_stats.nallocs > 0 && schunk_stats.nallocs == schunk_stats.nfrees);
+  CUTEST_ASSERT("Buffers are not aligned", !schunk_stats.misaligned);
+  CUTEST_ASSERT("The global allocator was used", global_stats.nallocs == global_nallocs);
+
+  /* The chunks read from frames on disk come from the allocator of the super-chunk too */
+  char *urlpath = backend.contiguous ? "test_allocator.b2frame" : "test_allocator_s.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  memset(&schunk_stats, 0, sizeof(schunk_stats));
+  storage.urlpath = urlpath;
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; ++i) {
+    CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data_buffer, nbytes) == i + 1);
+  }
+  for (int i = 0; i < NCHUNKS; ++i) {
+    nallocs = schunk_stats.nallocs;
+    CUTEST_ASSERT("Error decompressing", blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes) == nbytes);
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, nbytes) == 0);
+    CUTEST_ASSERT("The chunk did not use the allocator", schunk_stats.nallocs > nallocs);
+  }
+  nallocs = schunk_stats.nallocs;
+  CUTEST_ASSERT("Error getting the slice",
+                blosc2_schunk_get_slice_buffer(schunk, CHUNKSIZE / 2, CHUNKSIZE / 2 + 10, rec_buffer) == 0);
+  CUTEST_ASSERT("Data are not equal", memcmp(data_buffer + CHUNKSIZE / 2, rec_buffer, 10 * sizeof(int32_t)) == 0);
+  CUTEST_ASSERT("The slice did not use the allocator", schunk_stats.nallocs > nallocs);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+  CUTEST_ASSERT("Buffers were leaked", schunk_stats.nallocs == schunk_stats.nfrees);
+  CUTEST_ASSERT("The global allocator was used", global_stats.nallocs == global_nallocs);
+
+  CUTEST_ASSERT("Cannot restore the allocator", blosc2_set_allocator(NULL) == 0);
+  free(data_buffer);
+  free(rec_buffer);
+  free(chunk);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(allocator) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(allocator);
+}
@@ -0,0 +1,145 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for archives of many named frames in a single file.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+#include "b2nd.h"
+
+#define NSCHUNKS 200
+#define CHUNKITEMS 100
+
+
+CUTEST_TEST_DATA(archive) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(archive) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(nchunks, int, CUTEST_DATA(1, 3));
+}
+
+
+static void fill_chunk(int64_t nschunk, int64_t nchunk, int32_t *values) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    values[i] = (int32_t) (nschunk * 1000 + nchunk * 100 + i);
+  }
+}
+
+
+CUTEST_TEST_TEST(archive) {
+  CUTEST_GET_PARAMETER(nchunks, int);
+
+  char *urlpath = "test_archive.b2archive";
+  blosc2_remove_urlpath(urlpath);
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  int32_t *values = malloc(chunksize);
+  int32_t *expected = malloc(chunksize);
+  char name[32];
+
+  // Many tiny super-chunks (added out of order) and an array
+  blosc2_archive_writer *writer = blosc2_archive_writer_new(urlpath);
+  CUTEST_ASSERT("Cannot create the archive", writer != NULL);
+  for (int64_t nschunk = NSCHUNKS - 1; nschunk >= 0; nschunk--) {
+    blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+    for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+      fill_chunk(nschunk, nchunk, values);
+      CUTEST_ASSERT("Cannot append", blosc2_schunk_append_buffer(schunk, values, chunksize) == nchunk + 1);
+    }
+    sprintf(name, "schunk%03d", (int) nschunk);
+    CUTEST_ASSERT("Cannot add the super-chunk", blosc2_archive_writer_add_schunk(writer, name, schunk) > 0);
+    blosc2_schunk_free(schunk);
+  }
+  int64_t shape[2] = {10, 7};
+  int32_t chunkshape[2] = {5, 5};
+  int32_t blockshape[2] = {5, 5};
+  b2nd_context_t *ctx = b2nd_create_ctx(&storage, 2, shape, chunkshape, blockshape, "<i4", DTYPE_NUMPY_FORMAT,
+                                        NULL, 0);
+  b2nd_array_t *array;
+  int32_t fill = 3;
+  CUTEST_ASSERT("Cannot create the array", b2nd_full(ctx, &array, &fill) == 0);
+  CUTEST_ASSERT("Cannot add the array", b2nd_archive_add(writer, "array", array) == 0);
+  b2nd_free(array);
+  b2nd_free_ctx(ctx);
+  CUTEST_ASSERT("Cannot close the archive", blosc2_archive_writer_close(writer) == NSCHUNKS + 1);
+
+  // The directory is sorted by name, with the shapes
+  blosc2_archive *archive = blosc2_archive_open(urlpath);
+  CUTEST_ASSERT("Cannot open the archive", archive != NULL);
+  CUTEST_ASSERT("Wrong number of entries", blosc2_archive_nentries(archive) == NSCHUNKS + 1);
+  blosc2_archive_entry entry;
+  CUTEST_ASSERT("Cannot get the entry", blosc2_archive_get_entry(archive, 0, &entry) == 0);
+  CUTEST_ASSERT("Wrong array entry", strcmp(entry.name, "array") == 0 && entry.ndim == 2 &&
+                                     entry.shape[0] == 10 && entry.shape[1] == 7 && entry.typesize == 4);
+  CUTEST_ASSERT("Cannot get the entry", blosc2_archive_get_entry(archive, 1, &entry) == 0);
+  CUTEST_ASSERT("Wrong super-chunk entry", strcmp(entry.name, "schunk000") == 0 && entry.ndim == 1 &&
+                                           entry.shape[0] == (int64_t) nchunks * CHUNKITEMS &&
+                                           entry.offset % 8 == 0);
+  CUTEST_ASSERT("Found a missing frame", blosc2_archive_find(archive, "schunk") == BLOSC2_ERROR_NOT_FOUND);
+  CUTEST_ASSERT("Found a missing frame", blosc2_archive_open_schunk(archive, "zzz") == NULL);
+
+  for (int64_t nschunk = 0; nschunk < NSCHUNKS; nschunk += 7) {
+    sprintf(name, "schunk%03d", (int) nschunk);
+    CUTEST_ASSERT("Wrong entry found", blosc2_archive_find(archive, name) == nschunk + 1);
+    blosc2_schunk *schunk = blosc2_archive_open_schunk(archive, name);
+    CUTEST_ASSERT("Cannot open the super-chunk", schunk != NULL && schunk->nchunks == nchunks);
+    for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+      fill_chunk(nschunk, nchunk, expected);
+      CUTEST_ASSERT("Cannot decompress",
+                    blosc2_schunk_decompress_chunk(schunk, nchunk, values, chunksize) == chunksize);
+      CUTEST_ASSERT("Wrong chunk", memcmp(values, expected, chunksize) == 0);
+    }
+    // The frames are borrowed from the archive
+    CUTEST_ASSERT("A frame of the archive changes",
+                  blosc2_schunk_append_buffer(schunk, values, chunksize) == BLOSC2_ERROR_READ_ONLY);
+    blosc2_schunk_free(schunk);
+  }
+
+  CUTEST_ASSERT("Cannot open the array", b2nd_archive_open(archive, "array", &array) == 0);
+  int32_t items[70];
+  int64_t start[2] = {0, 0};
+  CUTEST_ASSERT("Cannot get the items",
+                b2nd_get_slice_cbuffer(array, start, shape, items, shape, sizeof(items)) == 0);
+  for (int i = 0; i < 70; i++) {
+    CUTEST_ASSERT("Wrong item", items[i] == 3);
+  }
+  b2nd_free(array);
+  blosc2_archive_close(archive);
+
+  // Repeated names break the archive
+  writer = blosc2_archive_writer_new(urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot add", blosc2_archive_writer_add_schunk(writer, "twice", schunk) > 0);
+  CUTEST_ASSERT("Cannot add", blosc2_archive_writer_add_schunk(writer, "twice", schunk) > 0);
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Repeated names are taken", blosc2_archive_writer_close(writer) == BLOSC2_ERROR_INVALID_PARAM);
+  CUTEST_ASSERT("A broken archive is opened", blosc2_archive_open(urlpath) == NULL);
+
+  blosc2_remove_urlpath(urlpath);
+  free(expected);
+  free(values);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(archive) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(archive);
+}
@@ -0,0 +1,154 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the asynchronous compression/decompression API.
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+#include <poll.h>
+#include <pthread.h>
+
+int tests_run = 0;
+
+#define NITEMS (200 * 1000)
+#define NFUTURES 6
+
+/* Global vars */
+int32_t *src;
+int bytesize = NITEMS * (int)sizeof(int32_t);
+int16_t pool_nthreads;
+pthread_mutex_t count_mutex = PTHREAD_MUTEX_INITIALIZER;
+int ncallbacks;
+
+
+static void count_callback(blosc2_future *future, int result, void *user_data) {
+  BLOSC_UNUSED_PARAM(future);
+  pthread_mutex_lock(&count_mutex);
+  ncallbacks++;
+  *(int *)user_data = result;
+  pthread_mutex_unlock(&count_mutex);
+}
+
+
+static char *test_roundtrip(void) {
+  blosc2_context *cctxs[NFUTURES];
+  blosc2_context *dctxs[NFUTURES];
+  blosc2_future *futures[NFUTURES];
+  uint8_t *dests[NFUTURES];
+  int32_t *dests2[NFUTURES];
+  int results[NFUTURES];
+  int cbytes[NFUTURES];
+
+  mu_assert("ERROR: cannot set the shared pool", blosc2_set_shared_threadpool(pool_nthreads) == 0);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = 2;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 2;
+
+  ncallbacks = 0;
+  for (int i = 0; i < NFUTURES; i++) {
+    cctxs[i] = blosc2_create_cctx(cparams);
+    dctxs[i] = blosc2_create_dctx(dparams);
+    dests[i] = malloc(bytesize + BLOSC2_MAX_OVERHEAD);
+    dests2[i] = malloc(bytesize);
+    futures[i] = blosc2_compress_ctx_async(cctxs[i], src, bytesize, dests[i],
+                                           bytesize + BLOSC2_MAX_OVERHEAD, count_callback, &results[i]);
+    mu_assert("ERROR: cannot start compression", futures[i] != NULL);
+  }
+  for (int i = 0; i < NFUTURES; i++) {
+    cbytes[i] = blosc2_future_free(futures[i]);
+    mu_assert("ERROR: cbytes is not correct", cbytes[i] > 0);
+    mu_assert("ERROR: bad result in callback", results[i] == cbytes[i]);
+  }
+  mu_assert("ERROR: bad number of callbacks", ncallbacks == NFUTURES);
+
+  // Decompression, waiting with poll()
+  for (int i = 0; i < NFUTURES; i++) {
+    futures[i] = blosc2_decompress_ctx_async(dctxs[i], dests[i], cbytes[i], dests2[i], bytesize,
+                                             NULL, NULL);
+    mu_assert("ERROR: cannot start decompression", futures[i] != NULL);
+  }
+  for (int i = 0; i < NFUTURES; i++) {
+    struct pollfd pfd = {.fd = blosc2_future_get_fd(futures[i]), .events = POLLIN};
+    mu_assert("ERROR: cannot get the poll fd", pfd.fd >= 0);
+    mu_assert("ERROR: poll failed", poll(&pfd, 1, -1) == 1);
+    int result;
+    mu_assert("ERROR: future not finished after notification", blosc2_future_test(futures[i], &result));
+    mu_assert("ERROR: nbytes is not correct", result == bytesize);
+    mu_assert("ERROR: bad result when freeing", blosc2_future_free(futures[i]) == bytesize);
+    mu_assert("ERROR: wrong values in dest", memcmp(src, dests2[i], bytesize) == 0);
+  }
+
+  for (int i = 0; i < NFUTURES; i++) {
+    blosc2_free_ctx(cctxs[i]);
+    blosc2_free_ctx(dctxs[i]);
+    free(dests[i]);
+    free(dests2[i]);
+  }
+  return 0;
+}
+
+
+/* Errors are reported through the future, as with the synchronous calls */
+static char *test_error(void) {
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int32_t dest;
+  uint8_t garbage[BLOSC_EXTENDED_HEADER_LENGTH] = {0};
+
+  blosc2_future *future = blosc2_decompress_ctx_async(dctx, garbage, sizeof(garbage), &dest,
+                                                      sizeof(dest), NULL, NULL);
+  mu_assert("ERROR: cannot start decompression", future != NULL);
+  mu_assert("ERROR: error not reported", blosc2_future_wait(future) < 0);
+  mu_assert("ERROR: error not reported when freeing", blosc2_future_free(future) < 0);
+  blosc2_free_ctx(dctx);
+  return 0;
+}
+
+
+static char *all_tests(void) {
+  int16_t pool_sizes[] = {0, 1, 3};
+  for (int i = 0; i < (int)ARRAY_SIZE(pool_sizes); i++) {
+    pool_nthreads = pool_sizes[i];
+    mu_run_test(test_roundtrip);
+    mu_run_test(test_error);
+  }
+
+  return 0;
+}
+
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  src = malloc(bytesize);
+  for (int i = 0; i < NITEMS; i++) {
+    src[i] = i;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  free(src);
+  blosc2_destroy();
+
+  return result != 0;
+}
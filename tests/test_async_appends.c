@@ -0,0 +1,200 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the asynchronous appends of super-chunks.
+*/
+
+#include <pthread.h>
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (10 * 1000)
+#define NPRODUCERS 3
+#define NCHUNKS 40  // per producer
+#define URLPATH "test_async_appends.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+typedef struct {
+  blosc2_schunk *schunk;
+  int producer;
+  bool copy;
+  int64_t rc;
+} producer_data;
+
+CUTEST_TEST_DATA(async_appends) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(async_appends) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.nthreads = 2;
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(nworkers, int, CUTEST_DATA(1, 4));
+  CUTEST_PARAMETRIZE(queue_len, int32_t, CUTEST_DATA(1, 8));
+  // Chunks compressed by the workers, or in order by the super-chunk (deltas between chunks)
+  CUTEST_PARAMETRIZE(xdelta, bool, CUTEST_DATA(false, true));
+}
+
+
+/* The chunks of every producer hold its number and their order */
+static void fill_chunk(int producer, int nchunk, int32_t *buffer) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = producer * 1000000 + nchunk * 100 + i % 37;
+  }
+}
+
+static void* produce(void *arg) {
+  producer_data *pd = (producer_data *) arg;
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  int32_t *buffer = pd->copy ? malloc(chunksize) : NULL;
+  pd->rc = 0;
+  for (int nchunk = 0; nchunk < NCHUNKS && pd->rc >= 0; nchunk++) {
+    if (!pd->copy) {
+      buffer = malloc(chunksize);
+    }
+    fill_chunk(pd->producer, nchunk, buffer);
+    pd->rc = blosc2_schunk_append_buffer_async(pd->schunk, buffer, chunksize, pd->copy, true);
+  }
+  if (pd->copy || pd->rc < 0) {
+    free(buffer);
+  }
+  return NULL;
+}
+
+
+CUTEST_TEST_TEST(async_appends) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(nworkers, int);
+  CUTEST_GET_PARAMETER(queue_len, int32_t);
+  CUTEST_GET_PARAMETER(xdelta, bool);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tstorage.urlpath, .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+  if (xdelta) {
+    CUTEST_ASSERT("Cannot set up the deltas", blosc2_schunk_set_xdelta(schunk, 4) == 0);
+  }
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  int32_t *buffer = malloc(chunksize);
+  int32_t *expected = malloc(chunksize);
+  CUTEST_ASSERT("Appends without a queue are accepted",
+                blosc2_schunk_append_buffer_async(schunk, buffer, chunksize, true, true) < 0);
+  CUTEST_ASSERT("Empty queues are accepted", blosc2_schunk_set_async_appends(schunk, nworkers, 0) < 0);
+  CUTEST_ASSERT("Cannot set up the appends", blosc2_schunk_set_async_appends(schunk, nworkers, queue_len) == 0);
+
+  // Several producers at a time, copying the buffers or handing them over
+  pthread_t threads[NPRODUCERS];
+  producer_data pdata[NPRODUCERS];
+  for (int i = 0; i < NPRODUCERS; i++) {
+    pdata[i] = (producer_data) {.schunk=schunk, .producer=i, .copy=(i % 2 == 0)};
+    pthread_create(&threads[i], NULL, produce, &pdata[i]);
+  }
+  for (int i = 0; i < NPRODUCERS; i++) {
+    pthread_join(threads[i], NULL);
+    CUTEST_ASSERT("Cannot queue the buffers", pdata[i].rc > 0 && pdata[i].rc <= NPRODUCERS * NCHUNKS);
+  }
+  CUTEST_ASSERT("Cannot flush the appends", blosc2_schunk_flush_appends(schunk) == 0);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NPRODUCERS * NCHUNKS);
+
+  // The chunks of every producer are in the order that they were queued
+  int next_nchunk[NPRODUCERS] = {0};
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    CUTEST_ASSERT("Cannot decompress the chunk",
+                  blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, chunksize) == chunksize);
+    int producer = buffer[0] / 1000000;
+    CUTEST_ASSERT("Wrong producer", producer >= 0 && producer < NPRODUCERS);
+    fill_chunk(producer, next_nchunk[producer]++, expected);
+    CUTEST_ASSERT("Wrong chunk", memcmp(buffer, expected, chunksize) == 0);
+  }
+
+  // No waiting for room in the queue
+  int nfull = 0;
+  int64_t nchunks = schunk->nchunks;
+  for (int i = 0; i < 4 * queue_len; i++) {
+    fill_chunk(0, i, buffer);
+    int64_t rc = blosc2_schunk_append_buffer_async(schunk, buffer, chunksize, true, false);
+    if (rc == BLOSC2_ERROR_QUEUE_FULL) {
+      nfull++;
+      continue;
+    }
+    CUTEST_ASSERT("Cannot queue the buffer", rc == ++nchunks);
+  }
+  CUTEST_ASSERT("Cannot flush the appends", blosc2_schunk_flush_appends(schunk) == 0);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == nchunks);
+  CUTEST_ASSERT("Wrong number of full queues", nfull < 4 * queue_len);
+
+  // Failed appends are reported until the next flush, and the rest are dropped
+  int32_t *large = malloc(2 * chunksize);
+  memset(large, 0, 2 * chunksize);
+  CUTEST_ASSERT("Cannot queue the buffer",
+                blosc2_schunk_append_buffer_async(schunk, large, 2 * chunksize, true, true) == nchunks + 1);
+  // Queued, or rejected when the failure comes first
+  int64_t rc = blosc2_schunk_append_buffer_async(schunk, buffer, chunksize, true, true);
+  CUTEST_ASSERT("Cannot queue the buffer", rc == nchunks + 2 || rc == BLOSC2_ERROR_CHUNK_APPEND);
+  CUTEST_ASSERT("The failed append is not reported", blosc2_schunk_flush_appends(schunk) < 0);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == nchunks);
+  CUTEST_ASSERT("The error is reported twice", blosc2_schunk_flush_appends(schunk) == 0);
+  free(large);
+
+  // Buffers in flight are appended before freeing the super-chunk
+  for (int i = 0; i < queue_len; i++) {
+    fill_chunk(1, i, buffer);
+    CUTEST_ASSERT("Cannot queue the buffer",
+                  blosc2_schunk_append_buffer_async(schunk, buffer, chunksize, true, true) == nchunks + i + 1);
+  }
+  nchunks += queue_len;
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  }
+  else {
+    CUTEST_ASSERT("Cannot stop the appends", blosc2_schunk_set_async_appends(schunk, 0, 0) == 0);
+    CUTEST_ASSERT("The appends are not stopped", schunk->async_appends == NULL);
+  }
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == nchunks);
+  for (int i = 0; i < queue_len; i++) {
+    fill_chunk(1, i, expected);
+    CUTEST_ASSERT("Cannot decompress the chunk",
+                  blosc2_schunk_decompress_chunk(schunk, nchunks - queue_len + i, buffer, chunksize) == chunksize);
+    CUTEST_ASSERT("Wrong chunk", memcmp(buffer, expected, chunksize) == 0);
+  }
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+  free(buffer);
+  free(expected);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(async_appends) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(async_appends);
+}
@@ -0,0 +1,191 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for reducing the blocks of chunks while they are decompressed.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define SIZE (200 * 1000)
+#define BLOCKSIZE (16 * 1024)
+
+
+typedef struct {
+  int64_t sum;
+  int64_t nitems;
+  int64_t misaligned;
+  int64_t bad_outputs;
+} test_state;
+
+typedef struct {
+  test_state total;
+  int nstates;  // the states that are combined and not freed yet
+  bool fail;
+} test_reduction;
+
+CUTEST_TEST_DATA(block_postfilter) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(block_postfilter) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(clevel, int, CUTEST_DATA(0, 5));
+  CUTEST_PARAMETRIZE(zeros, bool, CUTEST_DATA(false, true));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 3));
+  CUTEST_PARAMETRIZE(shared_pool, bool, CUTEST_DATA(false, true));
+}
+
+
+static int sum_init(void *user_data, int32_t tid, void **state) {
+  BLOSC_UNUSED_PARAM(user_data);
+  BLOSC_UNUSED_PARAM(tid);
+  *state = calloc(1, sizeof(test_state));
+  return *state == NULL ? -1 : 0;
+}
+
+
+static int sum_block(blosc2_block_postfilter_params *params) {
+  test_reduction *reduction = params->user_data;
+  if (reduction->fail) {
+    return -1;
+  }
+  // Every thread has its own state, so there is no need for atomics
+  test_state *state = params->state;
+  if ((uintptr_t) params->input % BLOSC2_BLOCK_POSTFILTER_ALIGN != 0 ||
+      params->typesize != sizeof(int32_t)) {
+    state->misaligned++;
+  }
+  const int32_t *input = (const int32_t *) params->input;
+  for (int32_t i = 0; i < params->nitems; i++) {
+    state->sum += input[i];
+  }
+  state->nitems += params->nitems;
+  if (memcmp(input, params->output, params->nitems * sizeof(int32_t)) != 0) {
+    state->bad_outputs++;
+  }
+  return 0;
+}
+
+
+static int sum_combine(void *user_data, void **states, int32_t nstates) {
+  test_reduction *reduction = user_data;
+  for (int32_t i = 0; i < nstates; i++) {
+    test_state *state = states[i];
+    reduction->total.sum += state->sum;
+    reduction->total.nitems += state->nitems;
+    reduction->total.misaligned += state->misaligned;
+    reduction->total.bad_outputs += state->bad_outputs;
+  }
+  reduction->nstates = nstates;
+  return 0;
+}
+
+
+static void sum_free(void *user_data, void *state) {
+  test_reduction *reduction = user_data;
+  reduction->nstates--;
+  free(state);
+}
+
+
+static int copy_postfilter(blosc2_postfilter_params *params) {
+  memcpy(params->output, params->input, params->size);
+  return 0;
+}
+
+
+CUTEST_TEST_TEST(block_postfilter) {
+  CUTEST_GET_PARAMETER(clevel, int);
+  CUTEST_GET_PARAMETER(zeros, bool);
+  CUTEST_GET_PARAMETER(nthreads, int);
+  CUTEST_GET_PARAMETER(shared_pool, bool);
+
+  blosc2_set_shared_threadpool(shared_pool ? 2 : 0);
+
+  int32_t *src = malloc(SIZE * sizeof(int32_t));
+  int32_t *data_dest = malloc(SIZE * sizeof(int32_t));
+  int32_t csize_max = SIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD;
+  uint8_t *chunk = malloc(csize_max);
+  int64_t expected = 0;
+  for (int i = 0; i < SIZE; i++) {
+    src[i] = zeros ? 0 : i - SIZE / 2;
+    expected += src[i];
+  }
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.clevel = (uint8_t) clevel;
+  cparams.blocksize = BLOCKSIZE;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, src, SIZE * sizeof(int32_t), chunk, csize_max);
+  CUTEST_ASSERT("Cannot compress the chunk", csize > 0);
+  blosc2_free_ctx(cctx);
+
+  test_reduction reduction = {0};
+  blosc2_block_postfilter block_postfilter = {&reduction, sum_init, sum_block, sum_combine, sum_free, false};
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  dparams.block_postfilter = &block_postfilter;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  CUTEST_ASSERT("Cannot create the context", dctx != NULL);
+
+  // The states are not kept from a decompression to the next
+  for (int i = 0; i < 2; i++) {
+    memset(&reduction, 0, sizeof(reduction));
+    memset(data_dest, 0xff, SIZE * sizeof(int32_t));
+    int dsize = blosc2_decompress_ctx(dctx, chunk, csize, data_dest, SIZE * sizeof(int32_t));
+    CUTEST_ASSERT("Cannot decompress the chunk", dsize == SIZE * (int) sizeof(int32_t));
+    CUTEST_ASSERT("Wrong decompressed data", memcmp(src, data_dest, SIZE * sizeof(int32_t)) == 0);
+    CUTEST_ASSERT("Wrong sum", reduction.total.sum == expected);
+    CUTEST_ASSERT("Wrong number of items", reduction.total.nitems == SIZE);
+    CUTEST_ASSERT("Misaligned input", reduction.total.misaligned == 0);
+    CUTEST_ASSERT("The output is not the input", reduction.total.bad_outputs == 0);
+    CUTEST_ASSERT("The states are not freed", reduction.nstates == 0);
+  }
+
+  // Getting items does not reduce anything
+  memset(&reduction, 0, sizeof(reduction));
+  CUTEST_ASSERT("Cannot get the items",
+                blosc2_getitem_ctx(dctx, chunk, csize, 10, 5, data_dest, 5 * sizeof(int32_t)) ==
+                5 * sizeof(int32_t));
+  CUTEST_ASSERT("Wrong items", memcmp(data_dest, src + 10, 5 * sizeof(int32_t)) == 0);
+  CUTEST_ASSERT("Items are reduced", reduction.total.nitems == 0);
+
+  // A failing kernel makes the decompression fail
+  memset(&reduction, 0, sizeof(reduction));
+  reduction.fail = true;
+  CUTEST_ASSERT("The kernel failure is not reported",
+                blosc2_decompress_ctx(dctx, chunk, csize, data_dest, SIZE * sizeof(int32_t)) < 0);
+  CUTEST_ASSERT("Combined after a failure", reduction.total.nitems == 0);
+
+  blosc2_free_ctx(dctx);
+
+  // The block postfilter does not go along with a regular one
+  dparams.postfilter = copy_postfilter;
+  CUTEST_ASSERT("Both postfilters are accepted", blosc2_create_dctx(dparams) == NULL);
+
+  free(src);
+  free(data_dest);
+  free(chunk);
+  blosc2_set_shared_threadpool(0);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(block_postfilter) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(block_postfilter);
+}
@@ -0,0 +1,223 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the Bloom filters of the keys of the chunks of super-chunks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (10 * 1000)
+#define NCHUNKS 8
+#define RUN_CHUNK 5
+#define URLPATH "test_bloom.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(bloom) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(bloom) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(typesize, int32_t, CUTEST_DATA(4, 8));
+  // Whether the first chunks are indexed after they are in the super-chunk
+  CUTEST_PARAMETRIZE(late, bool, CUTEST_DATA(false, true));
+}
+
+
+/* The keys are scattered ids, unique across the super-chunk but for a run */
+static int64_t key_value(int64_t nchunk, int32_t i) {
+  if (nchunk == RUN_CHUNK) {
+    return 7;
+  }
+  return (nchunk * CHUNKITEMS + i) * 7919 + 13;
+}
+
+static void fill_chunk(int32_t typesize, int64_t nchunk, uint8_t *buffer) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    int64_t value = key_value(nchunk, i);
+    if (typesize == 4) {
+      ((int32_t *) buffer)[i] = (int32_t) value;
+    }
+    else {
+      ((int64_t *) buffer)[i] = value;
+    }
+  }
+}
+
+/* Whether `nchunk` is among the candidates for the key, which must be few */
+static bool lookup(blosc2_schunk *schunk, int32_t typesize, int64_t value, int64_t nchunk) {
+  uint8_t key[8];
+  if (typesize == 4) {
+    int32_t value32 = (int32_t) value;
+    memcpy(key, &value32, sizeof(value32));
+  }
+  else {
+    memcpy(key, &value, sizeof(value));
+  }
+  int64_t *candidates;
+  int64_t ncandidates = blosc2_schunk_bloom_lookup(schunk, key, &candidates);
+  if (ncandidates < 0) {
+    return false;
+  }
+  bool found = false;
+  for (int64_t i = 0; i < ncandidates; i++) {
+    found |= candidates[i] == nchunk;
+  }
+  free(candidates);
+  return found && ncandidates <= 3;
+}
+
+/* Whether the keys of the chunks, as originally appended in `order`, are all found */
+static int check_lookups(blosc2_schunk *schunk, int32_t typesize, const int64_t *order) {
+  int errors = 0;
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    for (int32_t i = 0; i < CHUNKITEMS; i += 997) {
+      if (!lookup(schunk, typesize, key_value(order[nchunk], i), nchunk)) {
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+/* The number of chunks that are candidates for keys that are nowhere */
+static int64_t count_false_positives(blosc2_schunk *schunk, int32_t typesize) {
+  int64_t nfalse = 0;
+  for (int64_t i = 0; i < 1000; i++) {
+    // The ids are multiples of 7919 plus 13
+    int64_t value = i * 7919 + 14;
+    uint8_t key[8];
+    if (typesize == 4) {
+      int32_t value32 = (int32_t) value;
+      memcpy(key, &value32, sizeof(value32));
+    }
+    else {
+      memcpy(key, &value, sizeof(value));
+    }
+    int64_t *candidates;
+    int64_t ncandidates = blosc2_schunk_bloom_lookup(schunk, key, &candidates);
+    if (ncandidates < 0) {
+      return ncandidates;
+    }
+    free(candidates);
+    nfalse += ncandidates;
+  }
+  return nfalse;
+}
+
+
+CUTEST_TEST_TEST(bloom) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(typesize, int32_t);
+  CUTEST_GET_PARAMETER(late, bool);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.typesize = typesize;
+  cparams.nthreads = 2;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tstorage.urlpath, .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int64_t *candidates;
+  CUTEST_ASSERT("The keys are indexed",
+                blosc2_schunk_bloom_lookup(schunk, "key", &candidates) == BLOSC2_ERROR_NOT_FOUND);
+  if (!late) {
+    CUTEST_ASSERT("The number of keys is not known",
+                  blosc2_schunk_set_bloom(schunk, 0, 10) == BLOSC2_ERROR_INVALID_PARAM);
+    CUTEST_ASSERT("Cannot index the keys", blosc2_schunk_set_bloom(schunk, CHUNKITEMS, 10) == 0);
+  }
+
+  int32_t chunksize = CHUNKITEMS * typesize;
+  uint8_t *buffer = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(typesize, nchunk, buffer);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+  }
+  if (late) {
+    CUTEST_ASSERT("Cannot index the keys", blosc2_schunk_set_bloom(schunk, 0, 10) == 0);
+  }
+  int64_t order[NCHUNKS] = {0, 1, 2, 3, 4, 5, 6, 7};
+  CUTEST_ASSERT("Keys not found", check_lookups(schunk, typesize, order) == 0);
+  // About 1% of false positives per chunk
+  int64_t nfalse = count_false_positives(schunk, typesize);
+  CUTEST_ASSERT("Too many false positives", nfalse >= 0 && nfalse < 1000 * NCHUNKS / 25);
+
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("Keys not found after reopening", check_lookups(schunk, typesize, order) == 0);
+  }
+
+  // The filters follow the chunks around
+  int64_t reordered[NCHUNKS] = {2, 0, 1, 3, 4, 5, 7, 6};
+  CUTEST_ASSERT("Cannot reorder the chunks", blosc2_schunk_reorder_offsets(schunk, reordered) == 0);
+  CUTEST_ASSERT("Keys not found after reordering", check_lookups(schunk, typesize, reordered) == 0);
+
+  // Chunks that come without a filter are always candidates
+  bool needs_free;
+  uint8_t *chunk_;
+  int cbytes = blosc2_schunk_get_chunk(schunk, 4, &chunk_, &needs_free);
+  CUTEST_ASSERT("Cannot get the chunk", cbytes > 0);
+  // The chunks of contiguous frames in memory move around
+  uint8_t *chunk = malloc(cbytes);
+  memcpy(chunk, chunk_, cbytes);
+  if (needs_free) {
+    free(chunk_);
+  }
+  CUTEST_ASSERT("Cannot insert the chunk", blosc2_schunk_insert_chunk(schunk, 1, chunk, true) == NCHUNKS + 1);
+  CUTEST_ASSERT("The inserted chunk is not a candidate", lookup(schunk, typesize, key_value(4, 0), 1));
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, 1) == NCHUNKS);
+  CUTEST_ASSERT("Keys not found after deleting", check_lookups(schunk, typesize, reordered) == 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 0, chunk, true) == NCHUNKS);
+  free(chunk);
+  CUTEST_ASSERT("The updated chunk is not a candidate", lookup(schunk, typesize, key_value(0, 1), 0));
+
+  // Appending again indexes the new chunks
+  fill_chunk(typesize, NCHUNKS, buffer);
+  CUTEST_ASSERT("Cannot append the chunk",
+                blosc2_schunk_append_buffer(schunk, buffer, chunksize) == NCHUNKS + 1);
+  CUTEST_ASSERT("Key of the new chunk not found", lookup(schunk, typesize, key_value(NCHUNKS, 5), NCHUNKS));
+  free(buffer);
+
+  // Without filters, there is nothing to look up
+  CUTEST_ASSERT("Cannot drop the filters", blosc2_schunk_set_bloom(schunk, 0, 0) == 0);
+  CUTEST_ASSERT("The keys are indexed",
+                blosc2_schunk_bloom_lookup(schunk, "key", &candidates) == BLOSC2_ERROR_NOT_FOUND);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(bloom) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(bloom);
+}
@@ -0,0 +1,144 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the chunks of in-memory super-chunks that live in buffers of the caller.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS 5000
+#define NCHUNKS 10
+
+
+CUTEST_TEST_DATA(borrowed_chunks) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(borrowed_chunks) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(slab_size, int32_t, CUTEST_DATA(0, 1024));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 2));
+}
+
+
+static int nreleased;
+
+static void release_buffer(void *buffer, void *params) {
+  if (params == &nreleased) {
+    nreleased++;
+  }
+  free(buffer);
+}
+
+static void fill_chunk(int64_t nchunk, int32_t *data) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    data[i] = (int32_t) (nchunk * 1000 + i);
+  }
+}
+
+static bool check_chunk(blosc2_schunk *schunk, int64_t nchunk, int64_t value, int32_t *buffer, int32_t *expected) {
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  fill_chunk(value, expected);
+  return blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, chunksize) == chunksize &&
+         memcmp(buffer, expected, chunksize) == 0;
+}
+
+
+CUTEST_TEST_TEST(borrowed_chunks) {
+  CUTEST_GET_PARAMETER(slab_size, int32_t);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = (int16_t) nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .contiguous=true};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  uint8_t *buffer = malloc(BLOSC_EXTENDED_HEADER_LENGTH + chunksize);
+  CUTEST_ASSERT("A frame takes borrowed chunks",
+                blosc2_schunk_append_borrowed(schunk, buffer, chunksize, release_buffer, &nreleased) < 0);
+  blosc2_schunk_free(schunk);
+  free(buffer);
+
+  storage.contiguous = false;
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot set up the arena", blosc2_schunk_set_chunk_arena(schunk, slab_size) == 0);
+  nreleased = 0;
+  // Borrowed chunks in between regular ones
+  int32_t *values = malloc(chunksize);
+  int32_t *expected = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    if (nchunk % 3 == 2) {
+      fill_chunk(nchunk, values);
+      CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_buffer(schunk, values, chunksize) == nchunk + 1);
+      continue;
+    }
+    buffer = malloc(BLOSC_EXTENDED_HEADER_LENGTH + chunksize);
+    fill_chunk(nchunk, (int32_t *) (buffer + BLOSC_EXTENDED_HEADER_LENGTH));
+    CUTEST_ASSERT("Cannot append the borrowed chunk",
+                  blosc2_schunk_append_borrowed(schunk, buffer, chunksize, release_buffer, &nreleased) == nchunk + 1);
+    CUTEST_ASSERT("The chunk is copied", schunk->data[nchunk] == buffer);
+  }
+  CUTEST_ASSERT("A buffer is taken twice",
+                blosc2_schunk_append_borrowed(schunk, schunk->data[0], chunksize, release_buffer, &nreleased) < 0);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    CUTEST_ASSERT("Wrong chunk", check_chunk(schunk, nchunk, nchunk, values, expected));
+  }
+  CUTEST_ASSERT("Wrong nbytes", schunk->nbytes == (int64_t) NCHUNKS * chunksize);
+
+  // The borrowed chunks are copied when serialized
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  CUTEST_ASSERT("Cannot serialize", cframe_len > 0);
+  blosc2_schunk *schunk2 = blosc2_schunk_from_buffer(cframe, cframe_len, true);
+  if (needs_free) {
+    free(cframe);
+  }
+  CUTEST_ASSERT("Cannot deserialize", schunk2 != NULL);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    CUTEST_ASSERT("Wrong serialized chunk", check_chunk(schunk2, nchunk, nchunk, values, expected));
+  }
+  blosc2_schunk_free(schunk2);
+  CUTEST_ASSERT("Released while serializing", nreleased == 0);
+
+  // The borrowed chunks that are dropped go back to the caller
+  fill_chunk(100, values);
+  uint8_t *chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, values, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", cbytes > 0);
+  CUTEST_ASSERT("Cannot update", blosc2_schunk_update_chunk(schunk, 1, chunk, true) == NCHUNKS);
+  CUTEST_ASSERT("The updated chunk is not released", nreleased == 1);
+  CUTEST_ASSERT("Cannot delete", blosc2_schunk_delete_chunk(schunk, 0) == NCHUNKS - 1);
+  CUTEST_ASSERT("The deleted chunk is not released", nreleased == 2);
+  CUTEST_ASSERT("Wrong updated chunk", check_chunk(schunk, 0, 100, values, expected));
+  CUTEST_ASSERT("Wrong chunk after deleting", check_chunk(schunk, 2, 3, values, expected));
+  free(chunk);
+
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Not every borrowed chunk is released", nreleased == NCHUNKS - NCHUNKS / 3);
+  free(expected);
+  free(values);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(borrowed_chunks) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(borrowed_chunks);
+}
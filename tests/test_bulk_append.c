@@ -0,0 +1,160 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the bulk appends of super-chunks (blosc2_schunk_begin_bulk()).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (5 * 1000)
+#define NCHUNKS 50
+#define NCHUNKS_MORE 10
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+} test_bulk_append_backend;
+
+CUTEST_TEST_DATA(bulk_append) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(bulk_append) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.clevel = 5;
+
+  CUTEST_PARAMETRIZE(backend, test_bulk_append_backend, CUTEST_DATA(
+      {true, "test_bulk_append.b2frame"},
+      {false, "test_bulk_append_s.b2frame"},
+      {true, NULL},
+  ));
+}
+
+
+/* Every seventh chunk is a special (zeros) one */
+static int fill_chunk(int32_t *buffer, int nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = nchunk % 7 == 6 ? 0 : nchunk * CHUNKSIZE + j;
+  }
+  return 0;
+}
+
+static int64_t append_chunk(blosc2_schunk *schunk, int32_t *buffer, int nchunk) {
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  if (nchunk % 7 == 6) {
+    uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+    blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+    cparams.typesize = sizeof(int32_t);
+    blosc2_chunk_zeros(cparams, nbytes, zeros, sizeof(zeros));
+    return blosc2_schunk_append_chunk(schunk, zeros, true);
+  }
+  fill_chunk(buffer, nchunk);
+  return blosc2_schunk_append_buffer(schunk, buffer, nbytes);
+}
+
+/* The chunk in position i holds the data for chunk order[i] */
+static int check_chunks(blosc2_schunk *schunk, const int *order, int nchunks) {
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  int32_t *rec_buffer = malloc(nbytes);
+  int rc = schunk->nchunks == nchunks ? 0 : -1;
+  for (int i = 0; i < nchunks && rc == 0; ++i) {
+    int32_t dbytes = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes);
+    fill_chunk(data_buffer, order[i]);
+    if (dbytes != nbytes || memcmp(data_buffer, rec_buffer, nbytes) != 0) {
+      rc = -1;
+    }
+  }
+  free(data_buffer);
+  free(rec_buffer);
+  return rc;
+}
+
+
+CUTEST_TEST_TEST(bulk_append) {
+  CUTEST_GET_PARAMETER(backend, test_bulk_append_backend);
+
+  int order[NCHUNKS + 2 * NCHUNKS_MORE + 1];
+  int nchunks = 0;
+  int32_t *data_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  blosc2_remove_urlpath(backend.urlpath);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Cannot add a metalayer", blosc2_meta_add(schunk, "meta", (uint8_t *) "1234", 4) >= 0);
+
+  /* The chunks can be read back before the commit */
+  CUTEST_ASSERT("Cannot start the bulk append", blosc2_schunk_begin_bulk(schunk) == 0);
+  for (; nchunks < NCHUNKS; ++nchunks) {
+    CUTEST_ASSERT("Error during compression", append_chunk(schunk, data_buffer, nchunks) == nchunks + 1);
+    order[nchunks] = nchunks;
+  }
+  CUTEST_ASSERT("Data are not equal before the commit", check_chunks(schunk, order, nchunks) == 0);
+  CUTEST_ASSERT("Cannot commit the bulk append", blosc2_schunk_commit_bulk(schunk) == 0);
+  CUTEST_ASSERT("Data are not equal after the commit", check_chunks(schunk, order, nchunks) == 0);
+
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(backend.urlpath);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("Data are not equal after reopening", check_chunks(schunk, order, nchunks) == 0);
+  }
+
+  /* Other modifications write down the deferred updates first */
+  CUTEST_ASSERT("Cannot start the bulk append", blosc2_schunk_begin_bulk(schunk) == 0);
+  for (int i = 0; i < NCHUNKS_MORE; ++i, ++nchunks) {
+    CUTEST_ASSERT("Error during compression", append_chunk(schunk, data_buffer, nchunks) == nchunks + 1);
+    order[nchunks] = nchunks;
+  }
+  CUTEST_ASSERT("Error deleting a chunk", blosc2_schunk_delete_chunk(schunk, 1) == nchunks - 1);
+  memmove(&order[1], &order[2], (nchunks - 2) * sizeof(int));
+  nchunks--;
+  CUTEST_ASSERT("Cannot update a metalayer", blosc2_meta_update(schunk, "meta", (uint8_t *) "5678", 4) >= 0);
+  CUTEST_ASSERT("Cannot add a vlmetalayer", blosc2_vlmeta_add(schunk, "vlmeta", (uint8_t *) "content", 7, NULL) >= 0);
+  for (int i = 0; i < NCHUNKS_MORE; ++i, ++nchunks) {
+    CUTEST_ASSERT("Error during compression", append_chunk(schunk, data_buffer, nchunks + 1) == nchunks + 1);
+    order[nchunks] = nchunks + 1;
+  }
+  CUTEST_ASSERT("Data are not equal", check_chunks(schunk, order, nchunks) == 0);
+
+  /* Freeing the super-chunk commits the last appends */
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(backend.urlpath);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  }
+  CUTEST_ASSERT("Data are not equal at the end", check_chunks(schunk, order, nchunks) == 0);
+  uint8_t *content;
+  int32_t content_len;
+  CUTEST_ASSERT("Cannot get the metalayer", blosc2_meta_get(schunk, "meta", &content, &content_len) >= 0);
+  CUTEST_ASSERT("Wrong metalayer", content_len == 4 && memcmp(content, "5678", 4) == 0);
+  free(content);
+  CUTEST_ASSERT("Cannot get the vlmetalayer", blosc2_vlmeta_get(schunk, "vlmeta", &content, &content_len) >= 0);
+  CUTEST_ASSERT("Wrong vlmetalayer", content_len == 7 && memcmp(content, "content", 7) == 0);
+  free(content);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+  free(data_buffer);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(bulk_append) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(bulk_append);
+}
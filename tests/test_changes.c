@@ -0,0 +1,194 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for tracking the changes of the chunks of super-chunks, and patching their replicas.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (20 * 1000)
+#define NCHUNKS 10
+#define URLPATH "test_changes.b2frame"
+#define URLPATH2 "test_changes_replica.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  char *urlpath2;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(changes) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(changes) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, NULL, false},
+      {NULL, NULL, true},
+      {URLPATH, URLPATH2, true},
+      {URLPATH, URLPATH2, false},
+  ));
+}
+
+
+static void fill_chunk(int32_t *buffer, int32_t value) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = value * CHUNKITEMS + i % 1000;
+  }
+}
+
+static int update_chunk(blosc2_schunk *schunk, int64_t nchunk, int32_t value) {
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  uint8_t *chunk = malloc(CHUNKITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  fill_chunk(buffer, value);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, buffer, CHUNKITEMS * sizeof(int32_t), chunk,
+                                   CHUNKITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  int64_t rc = cbytes < 0 ? cbytes : blosc2_schunk_update_chunk(schunk, nchunk, chunk, true);
+  free(chunk);
+  free(buffer);
+  return rc < 0 ? (int) rc : 0;
+}
+
+/* The number of chunks of `replica` that are not the ones of `schunk` */
+static int compare_schunks(blosc2_schunk *schunk, blosc2_schunk *replica) {
+  if (schunk->nchunks != replica->nchunks) {
+    return 1;
+  }
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  int32_t *buffer2 = malloc(CHUNKITEMS * sizeof(int32_t));
+  int errors = 0;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    int rc = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKITEMS * sizeof(int32_t));
+    int rc2 = blosc2_schunk_decompress_chunk(replica, nchunk, buffer2, CHUNKITEMS * sizeof(int32_t));
+    errors += rc < 0 || rc != rc2 || memcmp(buffer, buffer2, rc) != 0;
+  }
+  free(buffer2);
+  free(buffer);
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(changes) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tstorage.urlpath, .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  int32_t *buffer = malloc(chunksize);
+  for (int32_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(buffer, nchunk);
+    CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+  }
+  CUTEST_ASSERT("The changes are tracked", blosc2_schunk_get_sequence(schunk) == BLOSC2_ERROR_NOT_FOUND);
+  CUTEST_ASSERT("The changes are tracked", blosc2_schunk_get_changes(schunk, 0) == NULL);
+  CUTEST_ASSERT("Cannot track the changes", blosc2_schunk_track_changes(schunk) == 0);
+
+  // The replica is a copy
+  blosc2_storage storage2 = {.urlpath=tstorage.urlpath2, .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage2.urlpath);
+  blosc2_schunk *replica = blosc2_schunk_copy(schunk, &storage2);
+  CUTEST_ASSERT("Cannot copy the super-chunk", replica != NULL);
+  CUTEST_ASSERT("Wrong sequence of the replica", blosc2_schunk_get_sequence(replica) == 0);
+  blosc2_schunk *delta = blosc2_schunk_get_changes(schunk, 0);
+  CUTEST_ASSERT("Wrong delta", delta != NULL && delta->nchunks == 0);
+  CUTEST_ASSERT("Cannot apply the delta", blosc2_schunk_apply_changes(replica, delta) == 0);
+  blosc2_schunk_free(delta);
+
+  // Only the changed chunks go in the delta
+  CUTEST_ASSERT("Cannot update the chunk", update_chunk(schunk, 2, 100) == 0);
+  CUTEST_ASSERT("Cannot update the chunk", update_chunk(schunk, 7, 101) == 0);
+  CUTEST_ASSERT("Cannot update the chunk", update_chunk(schunk, 2, 102) == 0);
+  int64_t sequence = blosc2_schunk_get_sequence(schunk);
+  CUTEST_ASSERT("Wrong sequence", sequence == 3);
+  delta = blosc2_schunk_get_changes(schunk, 0);
+  CUTEST_ASSERT("Wrong delta", delta != NULL && delta->nchunks == 2);
+  CUTEST_ASSERT("Cannot apply the delta", blosc2_schunk_apply_changes(replica, delta) == 2);
+  CUTEST_ASSERT("Wrong replica", compare_schunks(schunk, replica) == 0);
+  CUTEST_ASSERT("Wrong sequence of the replica", blosc2_schunk_get_sequence(replica) == sequence);
+  // A delta is applied once
+  CUTEST_ASSERT("The delta is applied again", blosc2_schunk_apply_changes(replica, delta) == 0);
+  blosc2_schunk_free(delta);
+
+  // Appends, inserts and deletions, through a serialized delta
+  fill_chunk(buffer, 200);
+  CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_buffer(schunk, buffer, chunksize) == NCHUNKS + 1);
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, 8) == NCHUNKS);
+  CUTEST_ASSERT("Cannot update the chunk", update_chunk(schunk, 1, 201) == 0);
+  delta = blosc2_schunk_get_changes(schunk, sequence);
+  // The chunks from the deleted one on were shifted
+  CUTEST_ASSERT("Wrong delta", delta != NULL && delta->nchunks == 3);
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(delta, &cframe, &needs_free);
+  CUTEST_ASSERT("Cannot serialize the delta", cframe_len > 0);
+  blosc2_schunk *delta2 = blosc2_schunk_from_buffer(cframe, cframe_len, true);
+  CUTEST_ASSERT("Cannot apply the delta", blosc2_schunk_apply_changes(replica, delta2) == 3);
+  CUTEST_ASSERT("Wrong replica", compare_schunks(schunk, replica) == 0);
+  blosc2_schunk_free(delta2);
+  if (needs_free) {
+    free(cframe);
+  }
+  blosc2_schunk_free(delta);
+
+  // The replica cannot miss the changes before the delta
+  sequence = blosc2_schunk_get_sequence(schunk);
+  CUTEST_ASSERT("Cannot update the chunk", update_chunk(schunk, 0, 300) == 0);
+  sequence++;
+  CUTEST_ASSERT("Cannot update the chunk", update_chunk(schunk, 4, 301) == 0);
+  delta = blosc2_schunk_get_changes(schunk, sequence);
+  CUTEST_ASSERT("Wrong delta", delta != NULL && delta->nchunks == 1);
+  CUTEST_ASSERT("The delta is applied", blosc2_schunk_apply_changes(replica, delta) < 0);
+  blosc2_schunk_free(delta);
+
+  // Shrinking super-chunks, and reopened ones
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, schunk->nchunks - 1) >= 0);
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, schunk->nchunks - 1) >= 0);
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    blosc2_schunk_free(replica);
+    replica = blosc2_schunk_open(tstorage.urlpath2);
+    CUTEST_ASSERT("Cannot reopen the super-chunks", schunk != NULL && replica != NULL);
+  }
+  delta = blosc2_schunk_get_changes(schunk, blosc2_schunk_get_sequence(replica));
+  CUTEST_ASSERT("Wrong delta", delta != NULL && delta->nchunks == 2);
+  CUTEST_ASSERT("Cannot apply the delta", blosc2_schunk_apply_changes(replica, delta) == 2);
+  CUTEST_ASSERT("Wrong replica", compare_schunks(schunk, replica) == 0);
+  CUTEST_ASSERT("Wrong sequence of the replica",
+                blosc2_schunk_get_sequence(replica) == blosc2_schunk_get_sequence(schunk));
+  blosc2_schunk_free(delta);
+
+  // Tracking the changes rules out concurrent writes
+  CUTEST_ASSERT("Concurrent writes are set", blosc2_schunk_set_concurrent_writes(schunk, 2) < 0);
+
+  free(buffer);
+  blosc2_schunk_free(replica);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+  blosc2_remove_urlpath(tstorage.urlpath2);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(changes) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(changes);
+}
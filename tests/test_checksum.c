@@ -0,0 +1,239 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the checksums of the blocks of the chunks, and the fingerprint of the frames.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (50 * 1000)
+#define NCHUNKS 5
+#define BLOCKSIZE (16 * 1024)
+#define URLPATH "test_checksum.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(checksum) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(checksum) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(clevel, int, CUTEST_DATA(0, 5));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 3));
+}
+
+
+static void fill_chunk(int32_t *buffer, int64_t nchunk) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = (int32_t) (nchunk * CHUNKITEMS + i % 1000);
+  }
+}
+
+static int check_chunks(blosc2_schunk *schunk) {
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  int32_t *expected = malloc(CHUNKITEMS * sizeof(int32_t));
+  int errors = 0;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    fill_chunk(expected, nchunk);
+    int rc = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKITEMS * sizeof(int32_t));
+    if (rc != CHUNKITEMS * (int) sizeof(int32_t) || memcmp(buffer, expected, rc) != 0) {
+      errors++;
+    }
+  }
+  free(expected);
+  free(buffer);
+  return errors;
+}
+
+/* The kind of the checksums of the nchunk chunk */
+static int chunk_checksum(blosc2_schunk *schunk, int64_t nchunk) {
+  uint8_t *chunk;
+  bool needs_free;
+  if (blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free) < 0) {
+    return -1;
+  }
+  int checksum = chunk[BLOSC2_CHUNK_CHECKSUM];
+  if (needs_free) {
+    free(chunk);
+  }
+  return checksum;
+}
+
+/* Flip a byte of the file that follows the first occurrence of `pattern` */
+static bool corrupt_file(const char *path, const char *pattern) {
+  FILE *fp = fopen(path, "r+b");
+  if (fp == NULL) {
+    return false;
+  }
+  fseek(fp, 0, SEEK_END);
+  long len = ftell(fp);
+  uint8_t *content = malloc(len);
+  fseek(fp, 0, SEEK_SET);
+  bool found = false;
+  if (fread(content, 1, len, fp) == (size_t) len) {
+    size_t plen = strlen(pattern);
+    for (long i = 0; i + (long) plen < len && !found; i++) {
+      if (memcmp(content + i, pattern, plen) == 0) {
+        content[i + plen] ^= 0xff;
+        fseek(fp, 0, SEEK_SET);
+        found = fwrite(content, 1, len, fp) == (size_t) len;
+      }
+    }
+  }
+  free(content);
+  fclose(fp);
+  return found;
+}
+
+
+CUTEST_TEST_TEST(checksum) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(clevel, int);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = data->cparams;
+  cparams.clevel = clevel;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = (int16_t) nthreads;
+  cparams.checksum = BLOSC2_CHECKSUM_XXH3;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  dparams.verify_checksums = true;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tstorage.urlpath,
+                            .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int32_t *buffer = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(buffer, nchunk);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+    CUTEST_ASSERT("The chunk has no checksums", chunk_checksum(schunk, nchunk) == BLOSC2_CHECKSUM_XXH3);
+  }
+  CUTEST_ASSERT("Wrong values", check_chunks(schunk) == 0);
+  int32_t items[10];
+  CUTEST_ASSERT("Cannot get the slice",
+                blosc2_schunk_get_slice_buffer(schunk, CHUNKITEMS - 5, CHUNKITEMS + 5, items) == 0);
+
+  // A corrupted chunk is caught (in the lazy chunks of frames on disk too)
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_chunk(schunk, 1, &chunk, &needs_free);
+  CUTEST_ASSERT("Cannot get the chunk", cbytes > 0);
+  uint8_t *corrupted = malloc(cbytes);
+  memcpy(corrupted, chunk, cbytes);
+  if (needs_free) {
+    free(chunk);
+  }
+  corrupted[cbytes - 1] ^= 0xff;
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 1, corrupted, true) == NCHUNKS);
+  CUTEST_ASSERT("The corrupted chunk is not caught",
+                blosc2_schunk_decompress_chunk(schunk, 1, buffer, chunksize) == BLOSC2_ERROR_CHECKSUM);
+  CUTEST_ASSERT("The other chunks are fine",
+                blosc2_schunk_decompress_chunk(schunk, 2, buffer, chunksize) == chunksize);
+
+  // The checksums are only verified when asked for
+  blosc2_dparams dparams2 = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_context *dctx = blosc2_create_dctx(dparams2);
+  CUTEST_ASSERT("The chunk is not verified",
+                blosc2_decompress_ctx(dctx, corrupted, cbytes, buffer, chunksize) == chunksize);
+  blosc2_free_ctx(dctx);
+  dparams2.verify_checksums = true;
+  dctx = blosc2_create_dctx(dparams2);
+  CUTEST_ASSERT("The chunk is verified",
+                blosc2_decompress_ctx(dctx, corrupted, cbytes, buffer, chunksize) == BLOSC2_ERROR_CHECKSUM);
+  blosc2_free_ctx(dctx);
+  free(corrupted);
+  fill_chunk(buffer, 1);
+  chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD + 1024);
+  CUTEST_ASSERT("Cannot compress the chunk",
+                blosc2_compress_ctx(schunk->cctx, buffer, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD + 1024) > 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 1, chunk, true) == NCHUNKS);
+  free(chunk);
+  CUTEST_ASSERT("Wrong values after updating", check_chunks(schunk) == 0);
+
+  if (tstorage.urlpath != NULL) {
+    uint8_t info[] = "checksummed";
+    CUTEST_ASSERT("Cannot add the vlmetalayer", blosc2_vlmeta_add(schunk, "info", info, sizeof(info), NULL) >= 0);
+    blosc2_schunk_free(schunk);
+
+    // The frame keeps on checksumming its chunks
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+    blosc2_cparams *cparams2;
+    blosc2_schunk_get_cparams(schunk, &cparams2);
+    CUTEST_ASSERT("The chunks are not checksummed anymore", cparams2->checksum == BLOSC2_CHECKSUM_XXH3);
+    free(cparams2);
+    fill_chunk(buffer, NCHUNKS);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == NCHUNKS + 1);
+    CUTEST_ASSERT("The chunk has no checksums", chunk_checksum(schunk, NCHUNKS) == BLOSC2_CHECKSUM_XXH3);
+    blosc2_free_ctx(schunk->dctx);
+    dparams.schunk = schunk;
+    schunk->dctx = blosc2_create_dctx(dparams);
+    CUTEST_ASSERT("Wrong values after reopening", check_chunks(schunk) == 0);
+    blosc2_schunk_free(schunk);
+
+    // A corrupted trailer cannot be opened
+    char path[64];
+    sprintf(path, tstorage.contiguous ? "%s" : "%s/chunks.b2frame", tstorage.urlpath);
+    CUTEST_ASSERT("Cannot corrupt the frame", corrupt_file(path, "info"));
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("The corrupted frame is opened", schunk == NULL);
+  }
+  else {
+    blosc2_schunk_free(schunk);
+  }
+
+  // Without room for them, the chunks go without checksums
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = (int32_t) (i * 2654435761U);
+  }
+  cparams.clevel = 1;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  uint8_t *dest = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  cbytes = blosc2_compress_ctx(cctx, buffer, chunksize, dest, chunksize + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", cbytes > 0);
+  CUTEST_ASSERT("Wrong checksums", dest[BLOSC2_CHUNK_CHECKSUM] == BLOSC2_CHECKSUM_NONE ||
+                                   cbytes < chunksize + BLOSC2_MAX_OVERHEAD);
+  free(dest);
+  blosc2_free_ctx(cctx);
+  free(buffer);
+
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(checksum) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(checksum);
+}
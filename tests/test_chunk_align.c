@@ -0,0 +1,206 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for contiguous frames with the chunks aligned to a boundary (blosc2_storage.chunk_align).
+*/
+
+#include "test_common.h"
+#include "frame.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 5000
+#define NCHUNKS 20
+#define NCONCAT 3
+
+
+typedef struct {
+  char *urlpath;
+  char *urlpath2;
+} test_chunk_align_backend;
+
+CUTEST_TEST_DATA(chunk_align) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(chunk_align) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_chunk_align_backend, CUTEST_DATA(
+      {NULL, NULL},
+      {"test_chunk_align.b2frame", "test_chunk_align2.b2frame"},
+  ));
+  CUTEST_PARAMETRIZE(align, int32_t, CUTEST_DATA(512, 4096));
+  CUTEST_PARAMETRIZE(index_format, int, CUTEST_DATA(BLOSC2_INDEX_CHUNK, BLOSC2_INDEX_PACKED));
+}
+
+
+/* Chunks of other sizes every time */
+static void fill_chunk(int32_t *buffer, int64_t nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = (int32_t)(j % (1 + nchunk % 7) == 0 ? nchunk * 7919 + j * 31 : nchunk);
+  }
+}
+
+static int64_t add_chunk(blosc2_schunk *schunk, int64_t nchunk, bool insert) {
+  int32_t data[CHUNKSIZE];
+  fill_chunk(data, nchunk);
+  uint8_t *chunk = malloc(sizeof(data) + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, data, sizeof(data), chunk, sizeof(data) + BLOSC2_MAX_OVERHEAD);
+  int64_t rc = cbytes;
+  if (cbytes > 0) {
+    rc = insert ? blosc2_schunk_insert_chunk(schunk, nchunk, chunk, true) :
+                  blosc2_schunk_update_chunk(schunk, nchunk, chunk, true);
+  }
+  free(chunk);
+  return rc;
+}
+
+/* The chunks of `schunk` hold the ones in `ids` (zeros if negative) */
+static bool check_chunks(blosc2_schunk *schunk, const int64_t *ids, int64_t nchunks) {
+  int32_t data[CHUNKSIZE];
+  int32_t rec[CHUNKSIZE];
+  if (schunk->nchunks != nchunks) {
+    return false;
+  }
+  for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+    if (ids[nchunk] < 0) {
+      memset(data, 0, sizeof(data));
+    }
+    else {
+      fill_chunk(data, ids[nchunk]);
+    }
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, rec, sizeof(rec));
+    if (dsize != (int)sizeof(rec) || memcmp(data, rec, sizeof(rec)) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int64_t load_big(const uint8_t *src, int nbytes) {
+  int64_t value = 0;
+  for (int i = 0; i < nbytes; i++) {
+    value = (value << 8) | src[i];
+  }
+  return value;
+}
+
+/* Every chunk stored and the index start at the boundary, counting from the start of the frame */
+static bool check_aligned(blosc2_schunk *schunk, int32_t align) {
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  int64_t header_len = load_big(cframe + FRAME_HEADER_LEN, sizeof(int32_t));
+  int64_t cbytes = load_big(cframe + FRAME_CBYTES, sizeof(int64_t));
+  bool aligned = len > 0 && ((cframe[FRAME_OTHER_FLAGS] >> FRAME_CHUNK_ALIGN_SHIFT) & FRAME_CHUNK_ALIGN_MASK) > 0 &&
+                 (header_len + cbytes) % align == 0;
+  if (needs_free) {
+    free(cframe);
+  }
+  int64_t *offsets = blosc2_frame_get_offsets(schunk);
+  for (int64_t i = 0; aligned && i < schunk->nchunks; i++) {
+    aligned = offsets[i] < 0 || (header_len + offsets[i]) % align == 0;
+  }
+  free(offsets);
+  return aligned;
+}
+
+
+CUTEST_TEST_TEST(chunk_align) {
+  CUTEST_GET_PARAMETER(backend, test_chunk_align_backend);
+  CUTEST_GET_PARAMETER(align, int32_t);
+  CUTEST_GET_PARAMETER(index_format, int);
+
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_remove_urlpath(backend.urlpath2);
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true, .urlpath=backend.urlpath,
+                            .index_format=index_format, .chunk_align=align};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+
+  /* Special chunks, then updates, inserts and appends */
+  int64_t ids[2 * NCHUNKS + 2 * NCONCAT];
+  CUTEST_ASSERT("Error filling the super-chunk",
+                blosc2_schunk_fill_special(schunk, 2 * NCHUNKS * CHUNKSIZE, BLOSC2_SPECIAL_ZERO,
+                                           CHUNKSIZE * sizeof(int32_t)) == 2 * NCHUNKS);
+  for (int64_t i = 0; i < 2 * NCHUNKS; i++) {
+    if (i < NCHUNKS) {
+      CUTEST_ASSERT("Error updating a chunk", add_chunk(schunk, i, false) == 2 * NCHUNKS);
+    }
+    ids[i] = i < NCHUNKS ? i : -1;
+  }
+  CUTEST_ASSERT("Chunks not aligned after updating", check_aligned(schunk, align));
+  CUTEST_ASSERT("Error inserting a chunk", add_chunk(schunk, 3, true) == 2 * NCHUNKS + 1);
+  memmove(ids + 4, ids + 3, (2 * NCHUNKS - 3) * sizeof(int64_t));
+  ids[3] = 3;
+  CUTEST_ASSERT("Error updating a chunk", add_chunk(schunk, NCHUNKS + 5, false) == 2 * NCHUNKS + 1);
+  ids[NCHUNKS + 5] = NCHUNKS + 5;
+  CUTEST_ASSERT("Chunks not aligned after the changes", check_aligned(schunk, align));
+  CUTEST_ASSERT("Wrong data", check_chunks(schunk, ids, 2 * NCHUNKS + 1));
+
+  /* The alignment is kept in the frame */
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(backend.urlpath);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("Wrong data after reopening", check_chunks(schunk, ids, 2 * NCHUNKS + 1));
+  }
+  CUTEST_ASSERT("Wrong alignment", schunk->storage->chunk_align == align);
+  CUTEST_ASSERT("Error appending a chunk", add_chunk(schunk, 2 * NCHUNKS + 1, true) == 2 * NCHUNKS + 2);
+  CUTEST_ASSERT("Chunks not aligned after appending", check_aligned(schunk, align));
+  CUTEST_ASSERT("Error deleting a chunk", blosc2_schunk_delete_chunk(schunk, 2 * NCHUNKS + 1) == 2 * NCHUNKS + 1);
+
+  /* Compacting keeps the boundaries */
+  CUTEST_ASSERT("Error deleting a chunk", blosc2_schunk_delete_chunk(schunk, 1) == 2 * NCHUNKS);
+  memmove(ids + 1, ids + 2, (2 * NCHUNKS - 1) * sizeof(int64_t));
+  CUTEST_ASSERT("Error compacting", blosc2_schunk_compact(schunk, true) >= 0);
+  CUTEST_ASSERT("Chunks not aligned after compacting", check_aligned(schunk, align));
+  CUTEST_ASSERT("Wrong data after compacting", check_chunks(schunk, ids, 2 * NCHUNKS));
+
+  /* The chunks of other frames are aligned when concatenated, whether they are aligned
+     already (in one go) or not (one by one) */
+  int32_t src_aligns[] = {2 * align, 0};
+  int64_t nchunks = 2 * NCHUNKS;
+  for (int n = 0; n < 2; n++) {
+    blosc2_remove_urlpath(backend.urlpath2);
+    storage.urlpath = backend.urlpath2;
+    storage.chunk_align = src_aligns[n];
+    blosc2_schunk *src = blosc2_schunk_new(&storage);
+    CUTEST_ASSERT("Error creating the super-chunk", src != NULL);
+    for (int64_t i = 0; i < NCONCAT; i++) {
+      CUTEST_ASSERT("Error appending a chunk", add_chunk(src, i, true) == i + 1);
+      ids[nchunks + i] = i;
+    }
+    nchunks += NCONCAT;
+    CUTEST_ASSERT("Error concatenating", blosc2_schunk_concat(schunk, src) == nchunks);
+    CUTEST_ASSERT("Chunks not aligned after concatenating", check_aligned(schunk, align));
+    CUTEST_ASSERT("Wrong data after concatenating", check_chunks(schunk, ids, nchunks));
+    blosc2_schunk_free(src);
+  }
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_remove_urlpath(backend.urlpath2);
+
+  /* Boundaries that are not powers of 2 are refused */
+  storage.chunk_align = 1000;
+  CUTEST_ASSERT("A wrong alignment is taken", blosc2_schunk_new(&storage) == NULL);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(chunk_align) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(chunk_align);
+}
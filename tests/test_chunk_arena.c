@@ -0,0 +1,133 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the slabs holding the chunks of in-memory super-chunks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS 200
+#define NCHUNKS 3000
+
+
+CUTEST_TEST_DATA(chunk_arena) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(chunk_arena) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.nthreads = 1;
+
+  CUTEST_PARAMETRIZE(slab_size, int32_t, CUTEST_DATA(0, 1024, 64 * 1024));
+}
+
+
+static void fill_chunk(int64_t nchunk, int32_t *buffer) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = (int32_t) (nchunk * 31 + i % 17);
+  }
+}
+
+static bool check_chunk(blosc2_schunk *schunk, int64_t nchunk, int64_t value, int32_t *buffer, int32_t *expected) {
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  fill_chunk(value, expected);
+  return blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, chunksize) == chunksize &&
+         memcmp(buffer, expected, chunksize) == 0;
+}
+
+/* A chunk compressed on its own, in `chunk` */
+static int compress_chunk(int64_t value, int32_t *buffer, uint8_t *chunk) {
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  fill_chunk(value, buffer);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int cbytes = blosc2_compress_ctx(cctx, buffer, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  return cbytes;
+}
+
+
+CUTEST_TEST_TEST(chunk_arena) {
+  CUTEST_GET_PARAMETER(slab_size, int32_t);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("The chunks of frames go to the arena", blosc2_schunk_set_chunk_arena(schunk, 1024) < 0);
+  blosc2_schunk_free(schunk);
+
+  storage.contiguous = false;
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Negative slabs are accepted", blosc2_schunk_set_chunk_arena(schunk, -1) < 0);
+  CUTEST_ASSERT("Cannot set up the arena", blosc2_schunk_set_chunk_arena(schunk, slab_size) == 0);
+  CUTEST_ASSERT("Wrong arena", (schunk->chunk_arena != NULL) == (slab_size > 0));
+
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  int32_t *buffer = malloc(chunksize);
+  int32_t *expected = malloc(chunksize);
+  uint8_t *chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  // More chunk pointers than the first page of them
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(nchunk, buffer);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+  }
+  CUTEST_ASSERT("Wrong room for the chunks", schunk->data_len >= NCHUNKS * sizeof(void *));
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk += 7) {
+    CUTEST_ASSERT("Wrong chunk", check_chunk(schunk, nchunk, nchunk, buffer, expected));
+  }
+
+  // The chunks given and copied, inserted and updated
+  int cbytes = compress_chunk(NCHUNKS, buffer, chunk);
+  CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_chunk(schunk, chunk, true) == NCHUNKS + 1);
+  cbytes = compress_chunk(NCHUNKS + 1, buffer, chunk);
+  uint8_t *given = malloc(cbytes);
+  memcpy(given, chunk, cbytes);
+  CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_chunk(schunk, given, false) == NCHUNKS + 2);
+  compress_chunk(-1, buffer, chunk);
+  CUTEST_ASSERT("Cannot insert the chunk", blosc2_schunk_insert_chunk(schunk, 5, chunk, true) == NCHUNKS + 3);
+  compress_chunk(-2, buffer, chunk);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 1, chunk, true) == NCHUNKS + 3);
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, 2) == NCHUNKS + 2);
+  CUTEST_ASSERT("Wrong chunk", check_chunk(schunk, 0, 0, buffer, expected));
+  CUTEST_ASSERT("Wrong updated chunk", check_chunk(schunk, 1, -2, buffer, expected));
+  CUTEST_ASSERT("Wrong chunk after deleting", check_chunk(schunk, 2, 3, buffer, expected));
+  CUTEST_ASSERT("Wrong inserted chunk", check_chunk(schunk, 4, -1, buffer, expected));
+  CUTEST_ASSERT("Wrong chunk after inserting", check_chunk(schunk, 5, 5, buffer, expected));
+  CUTEST_ASSERT("Wrong chunk copied", check_chunk(schunk, NCHUNKS, NCHUNKS, buffer, expected));
+  CUTEST_ASSERT("Wrong chunk given", check_chunk(schunk, NCHUNKS + 1, NCHUNKS + 1, buffer, expected));
+
+  // The chunks in the slabs stay there once it takes no more
+  CUTEST_ASSERT("Cannot stop the arena", blosc2_schunk_set_chunk_arena(schunk, 0) == 0);
+  fill_chunk(NCHUNKS + 2, buffer);
+  CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_buffer(schunk, buffer, chunksize) == NCHUNKS + 3);
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, 0) == NCHUNKS + 2);
+  CUTEST_ASSERT("Wrong chunk", check_chunk(schunk, NCHUNKS + 1, NCHUNKS + 2, buffer, expected));
+  CUTEST_ASSERT("Wrong chunk in the arena", check_chunk(schunk, 9, 10, buffer, expected));
+
+  blosc2_schunk_free(schunk);
+  free(buffer);
+  free(expected);
+  free(chunk);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(chunk_arena) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(chunk_arena);
+}
@@ -0,0 +1,159 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the cache of decompressed chunks of super-chunks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 1000
+#define NCHUNKS 10
+#define WINDOW 300
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+} test_chunk_cache_backend;
+
+CUTEST_TEST_DATA(chunk_cache) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(chunk_cache) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_chunk_cache_backend, CUTEST_DATA(
+      {false, NULL},
+      {true, NULL},
+      {true, "test_chunk_cache.b2frame"},
+      {false, "test_chunk_cache_s.b2frame"},
+  ));
+}
+
+
+static bool check_slice(blosc2_schunk *schunk, int64_t start, int32_t *buffer, int32_t value0) {
+  if (blosc2_schunk_get_slice_buffer(schunk, start, start + WINDOW, buffer) < 0) {
+    return false;
+  }
+  for (int i = 0; i < WINDOW; i++) {
+    int64_t item = start + i;
+    int32_t expected = (int32_t) item;
+    if (item / CHUNKSIZE == 0) {
+      expected += value0;
+    }
+    if (buffer[i] != expected) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+CUTEST_TEST_TEST(chunk_cache) {
+  CUTEST_GET_PARAMETER(backend, test_chunk_cache_backend);
+
+  int32_t data_buffer[CHUNKSIZE];
+  int32_t rec_buffer[WINDOW];
+  int64_t hits, misses, nbytes;
+  blosc2_remove_urlpath(backend.urlpath);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous,
+                            .urlpath=backend.urlpath};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data_buffer[j] = i * CHUNKSIZE + j;
+    }
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, sizeof(data_buffer));
+    CUTEST_ASSERT("Error appending", nchunks == i + 1);
+  }
+
+  CUTEST_ASSERT("Stats without a cache",
+                blosc2_schunk_get_chunk_cache_stats(schunk, &hits, &misses, &nbytes) == BLOSC2_ERROR_NOT_FOUND);
+  CUTEST_ASSERT("Negative cache size", blosc2_schunk_set_chunk_cache(schunk, -1) < 0);
+  /* Room for 3 chunks */
+  CUTEST_ASSERT("Error enabling the cache",
+                blosc2_schunk_set_chunk_cache(schunk, 3 * sizeof(data_buffer)) == 0);
+
+  /* Overlapping windows that slide through the first 2 chunks */
+  int64_t nreads = 0;
+  for (int64_t start = 0; start + WINDOW <= 2 * CHUNKSIZE; start += WINDOW / 3) {
+    CUTEST_ASSERT("Wrong slice", check_slice(schunk, start, rec_buffer, 0));
+    nreads += (start / CHUNKSIZE == (start + WINDOW - 1) / CHUNKSIZE) ? 1 : 2;
+  }
+  blosc2_schunk_get_chunk_cache_stats(schunk, &hits, &misses, &nbytes);
+  CUTEST_ASSERT("Each chunk is decompressed once", misses == 2);
+  CUTEST_ASSERT("Wrong number of hits", hits == nreads - 2);
+  CUTEST_ASSERT("Wrong size of the cache", nbytes == 2 * sizeof(data_buffer));
+
+  /* The cache is bounded; the least recently used chunks are evicted */
+  for (int64_t start = 0; start < NCHUNKS * CHUNKSIZE; start += CHUNKSIZE) {
+    CUTEST_ASSERT("Wrong slice", check_slice(schunk, start, rec_buffer, 0));
+  }
+  blosc2_schunk_get_chunk_cache_stats(schunk, &hits, &misses, &nbytes);
+  CUTEST_ASSERT("The cache is not bounded", nbytes == 3 * sizeof(data_buffer));
+  CUTEST_ASSERT("Wrong number of misses", misses == 2 + NCHUNKS - 2);
+  CUTEST_ASSERT("Wrong slice", check_slice(schunk, 0, rec_buffer, 0));
+  blosc2_schunk_get_chunk_cache_stats(schunk, NULL, &misses, NULL);
+  CUTEST_ASSERT("The first chunk is not evicted", misses == NCHUNKS + 1);
+
+  /* Updates are seen */
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data_buffer[j] = j + 7;
+  }
+  uint8_t *chunk = malloc(sizeof(data_buffer) + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, data_buffer, sizeof(data_buffer), chunk,
+                                   sizeof(data_buffer) + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Error compressing", cbytes > 0);
+  CUTEST_ASSERT("Error updating", blosc2_schunk_update_chunk(schunk, 0, chunk, true) >= 0);
+  CUTEST_ASSERT("Update not seen", check_slice(schunk, 0, rec_buffer, 7));
+
+  /* Inserts and deletes too */
+  CUTEST_ASSERT("Error inserting", blosc2_schunk_insert_chunk(schunk, 0, chunk, true) == NCHUNKS + 1);
+  CUTEST_ASSERT("Error deleting", blosc2_schunk_delete_chunk(schunk, 1) == NCHUNKS);
+  blosc2_schunk_get_chunk_cache_stats(schunk, NULL, NULL, &nbytes);
+  CUTEST_ASSERT("The cache is not cleared", nbytes == 0);
+  CUTEST_ASSERT("Insert not seen", check_slice(schunk, 0, rec_buffer, 7));
+  CUTEST_ASSERT("Delete not seen", check_slice(schunk, CHUNKSIZE + 100, rec_buffer, 7));
+  free(chunk);
+
+  /* Chunks larger than the cache are not cached */
+  CUTEST_ASSERT("Error resizing the cache", blosc2_schunk_set_chunk_cache(schunk, 100) == 0);
+  blosc2_schunk_get_chunk_cache_stats(schunk, &hits, &misses, &nbytes);
+  CUTEST_ASSERT("The cache is not shrunk", nbytes == 0);
+  CUTEST_ASSERT("Wrong slice", check_slice(schunk, 3 * CHUNKSIZE, rec_buffer, 7));
+  int64_t misses2;
+  blosc2_schunk_get_chunk_cache_stats(schunk, NULL, &misses2, &nbytes);
+  CUTEST_ASSERT("A chunk larger than the cache is cached", nbytes == 0 && misses2 == misses);
+
+  CUTEST_ASSERT("Error disabling the cache", blosc2_schunk_set_chunk_cache(schunk, 0) == 0);
+  CUTEST_ASSERT("The cache is not disabled", schunk->chunk_cache == NULL);
+  CUTEST_ASSERT("Wrong slice", check_slice(schunk, 2 * CHUNKSIZE - 100, rec_buffer, 7));
+
+  /* The cache is released with the super-chunk */
+  CUTEST_ASSERT("Error enabling the cache", blosc2_schunk_set_chunk_cache(schunk, 1000000) == 0);
+  CUTEST_ASSERT("Wrong slice", check_slice(schunk, 100, rec_buffer, 7));
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(chunk_cache) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(chunk_cache);
+}
@@ -0,0 +1,121 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the views of chunks (blosc2_schunk_get_chunk_view()).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS 10
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  bool mmap;
+} test_chunk_view_backend;
+
+CUTEST_TEST_DATA(chunk_view) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(chunk_view) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_chunk_view_backend, CUTEST_DATA(
+      {false, NULL, false},  // no frame
+      {true, NULL, false},  // in-memory frame
+      {true, "test_chunk_view.b2frame", true},
+      {true, "test_chunk_view.b2frame", false},  // only the special chunks can be viewed
+  ));
+}
+
+
+/* Every third chunk is a special (zeros) one, and the last one is shorter */
+static int32_t fill_chunk(int32_t *buffer, int nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = nchunk % 3 == 2 ? 0 : nchunk * CHUNKSIZE + j;
+  }
+  return (nchunk == NCHUNKS - 1 ? CHUNKSIZE / 2 : CHUNKSIZE) * (int32_t) sizeof(int32_t);
+}
+
+
+CUTEST_TEST_TEST(chunk_view) {
+  CUTEST_GET_PARAMETER(backend, test_chunk_view_backend);
+
+  blosc2_remove_urlpath(backend.urlpath);
+  int32_t *data_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *rec_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_stdio_mmap mmap_file = BLOSC2_STDIO_MMAP_DEFAULTS;
+  mmap_file.mode = "w+";
+  blosc2_io io = {.id = BLOSC2_IO_FILESYSTEM_MMAP, .name = "filesystem_mmap", .params = &mmap_file};
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath};
+  if (backend.mmap) {
+    storage.io = &io;
+  }
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+  for (int i = 0; i < NCHUNKS; ++i) {
+    int32_t nbytes = fill_chunk(data_buffer, i);
+    int64_t nchunks;
+    if (i % 3 == 2) {
+      CUTEST_ASSERT("Error creating a zeros chunk", blosc2_chunk_zeros(cparams, nbytes, zeros, sizeof(zeros)) > 0);
+      nchunks = blosc2_schunk_append_chunk(schunk, zeros, true);
+    }
+    else {
+      nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, nbytes);
+    }
+    CUTEST_ASSERT("Error during compression", nchunks == i + 1);
+  }
+
+  for (int i = 0; i < NCHUNKS; ++i) {
+    blosc2_chunk_view view;
+    int cbytes = blosc2_schunk_get_chunk_view(schunk, i, &view);
+    if (backend.urlpath != NULL && !backend.mmap && i % 3 != 2) {
+      CUTEST_ASSERT("Chunks in files cannot be viewed", cbytes < 0);
+      continue;
+    }
+    int32_t nbytes = fill_chunk(data_buffer, i);
+    CUTEST_ASSERT("Cannot get the view", cbytes > 0 && cbytes == view.cbytes);
+    CUTEST_ASSERT("Wrong nbytes", view.nbytes == nbytes);
+    CUTEST_ASSERT("Wrong special value", view.special == (i % 3 == 2 ? BLOSC2_SPECIAL_ZERO : BLOSC2_NO_SPECIAL));
+    int dsize = blosc2_decompress_ctx(schunk->dctx, view.chunk, view.cbytes, rec_buffer, nbytes);
+    CUTEST_ASSERT("Error decompressing the view", dsize == nbytes);
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, nbytes) == 0);
+    dsize = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, CHUNKSIZE * sizeof(int32_t));
+    CUTEST_ASSERT("Error decompressing the chunk", dsize == nbytes);
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, nbytes) == 0);
+  }
+  blosc2_chunk_view view;
+  CUTEST_ASSERT("Chunk out of range", blosc2_schunk_get_chunk_view(schunk, NCHUNKS, &view) < 0);
+
+  blosc2_schunk_free(schunk);
+  if (backend.mmap) {
+    CUTEST_ASSERT("Error unmapping the frame", blosc2_stdio_mmap_destroy(&mmap_file) == 0);
+  }
+  blosc2_remove_urlpath(backend.urlpath);
+  free(data_buffer);
+  free(rec_buffer);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(chunk_view) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(chunk_view);
+}
@@ -0,0 +1,237 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the encryption of the blocks of the chunks with a cipher.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (50 * 1000)
+#define NCHUNKS 5
+#define BLOCKSIZE (16 * 1024)
+#define URLPATH "test_cipher.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(cipher) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(cipher) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(clevel, int, CUTEST_DATA(0, 5));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 3));
+}
+
+
+static const uint8_t key[BLOSC2_CIPHER_KEY_SIZE] = {
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8e, 0x8f,
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b, 0x9c, 0x9d, 0x9e, 0x9f,
+};
+
+/* Every other chunk is incompressible (a hash of the index), so that it is stored as it is */
+static void fill_chunk(int32_t *buffer, int64_t nchunk) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    uint32_t x = (uint32_t) (nchunk * CHUNKITEMS + i);
+    x = (x ^ (x >> 16)) * 0x7feb352dU;
+    x = (x ^ (x >> 15)) * 0x846ca68bU;
+    buffer[i] = nchunk % 2 ? (int32_t) (x ^ (x >> 16)) : (int32_t) (nchunk * CHUNKITEMS + i % 1000);
+  }
+}
+
+static int check_chunks(blosc2_schunk *schunk) {
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  int32_t *expected = malloc(CHUNKITEMS * sizeof(int32_t));
+  int errors = 0;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    fill_chunk(expected, nchunk);
+    int rc = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKITEMS * sizeof(int32_t));
+    if (rc != CHUNKITEMS * (int) sizeof(int32_t) || memcmp(buffer, expected, rc) != 0) {
+      errors++;
+    }
+  }
+  free(expected);
+  free(buffer);
+  return errors;
+}
+
+/* The cipher of the nchunk chunk, and whether it keeps any run of 64 bytes of buffer */
+static int chunk_cipher(blosc2_schunk *schunk, int64_t nchunk, const int32_t *buffer, bool *in_clear) {
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free);
+  if (cbytes < 0) {
+    return -1;
+  }
+  *in_clear = false;
+  for (int32_t i = 0; i + 64 <= CHUNKITEMS * (int32_t) sizeof(int32_t) && !*in_clear; i += 4096) {
+    for (int j = 0; j + 64 <= cbytes; j++) {
+      if (memcmp(chunk + j, (uint8_t *) buffer + i, 64) == 0) {
+        *in_clear = true;
+        break;
+      }
+    }
+  }
+  int cipher = chunk[BLOSC2_CHUNK_CHECKSUM] >> 4;
+  if (needs_free) {
+    free(chunk);
+  }
+  return cipher;
+}
+
+/* Decompress chunk with a context for key */
+static int decompress_with(const uint8_t *chunk_key, const uint8_t *chunk, int32_t cbytes, int32_t *buffer) {
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.cipher_key = chunk_key;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int rc = blosc2_decompress_ctx(dctx, chunk, cbytes, buffer, CHUNKITEMS * sizeof(int32_t));
+  blosc2_free_ctx(dctx);
+  return rc;
+}
+
+
+CUTEST_TEST_TEST(cipher) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(clevel, int);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = data->cparams;
+  cparams.clevel = clevel;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = (int16_t) nthreads;
+  cparams.cipher = BLOSC2_CIPHER_CHACHA20_POLY1305;
+  cparams.cipher_key = key;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  dparams.cipher_key = key;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tstorage.urlpath,
+                            .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int32_t *buffer = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(buffer, nchunk);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+    bool in_clear;
+    CUTEST_ASSERT("The chunk is not encrypted",
+                  chunk_cipher(schunk, nchunk, buffer, &in_clear) == BLOSC2_CIPHER_CHACHA20_POLY1305);
+    CUTEST_ASSERT("The chunk keeps the data in the clear", !in_clear);
+  }
+  CUTEST_ASSERT("Wrong values", check_chunks(schunk) == 0);
+  int32_t items[10];
+  CUTEST_ASSERT("Cannot get the slice",
+                blosc2_schunk_get_slice_buffer(schunk, CHUNKITEMS - 5, CHUNKITEMS + 5, items) == 0);
+  fill_chunk(buffer, 0);
+  CUTEST_ASSERT("Wrong slice", memcmp(items, buffer + CHUNKITEMS - 5, 5 * sizeof(int32_t)) == 0);
+  fill_chunk(buffer, 1);
+  CUTEST_ASSERT("Wrong slice", memcmp(items + 5, buffer, 5 * sizeof(int32_t)) == 0);
+
+  // The chunks only decrypt with their key, and a tampered chunk does not authenticate
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_chunk(schunk, 1, &chunk, &needs_free);
+  CUTEST_ASSERT("Cannot get the chunk", cbytes > 0);
+  uint8_t *tampered = malloc(cbytes);
+  memcpy(tampered, chunk, cbytes);
+  if (needs_free) {
+    free(chunk);
+  }
+  if (!(tampered[BLOSC2_CHUNK_BLOSC2_FLAGS] & 0x08)) {
+    // Not a lazy chunk
+    CUTEST_ASSERT("Cannot decrypt the chunk", decompress_with(key, tampered, cbytes, buffer) == chunksize);
+    uint8_t wrong_key[BLOSC2_CIPHER_KEY_SIZE];
+    memcpy(wrong_key, key, sizeof(wrong_key));
+    wrong_key[7] ^= 1;
+    CUTEST_ASSERT("The chunk decrypts with a wrong key",
+                  decompress_with(wrong_key, tampered, cbytes, buffer) == BLOSC2_ERROR_AUTHENTICATION);
+    CUTEST_ASSERT("The chunk decrypts without a key",
+                  decompress_with(NULL, tampered, cbytes, buffer) == BLOSC2_ERROR_INVALID_PARAM);
+    tampered[BLOSC2_CHUNK_FILTER_META + 1] ^= 1;
+    CUTEST_ASSERT("The header is not authenticated",
+                  decompress_with(key, tampered, cbytes, buffer) == BLOSC2_ERROR_AUTHENTICATION);
+    tampered[BLOSC2_CHUNK_FILTER_META + 1] ^= 1;
+  }
+  tampered[cbytes / 2] ^= 0x10;
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 1, tampered, true) == NCHUNKS);
+  CUTEST_ASSERT("The tampered chunk is not caught",
+                blosc2_schunk_decompress_chunk(schunk, 1, buffer, chunksize) == BLOSC2_ERROR_AUTHENTICATION);
+  CUTEST_ASSERT("The other chunks are fine",
+                blosc2_schunk_decompress_chunk(schunk, 2, buffer, chunksize) == chunksize);
+  free(tampered);
+  fill_chunk(buffer, 1);
+  chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD + 4096);
+  CUTEST_ASSERT("Cannot compress the chunk",
+                blosc2_compress_ctx(schunk->cctx, buffer, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD + 4096) > 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 1, chunk, true) == NCHUNKS);
+  free(chunk);
+  CUTEST_ASSERT("Wrong values after updating", check_chunks(schunk) == 0);
+
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+
+    // The frame needs the key again
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("The chunks decrypt without a key",
+                  blosc2_schunk_decompress_chunk(schunk, 0, buffer, chunksize) == BLOSC2_ERROR_INVALID_PARAM);
+    blosc2_free_ctx(schunk->dctx);
+    dparams.schunk = schunk;
+    schunk->dctx = blosc2_create_dctx(dparams);
+    CUTEST_ASSERT("Wrong values after reopening", check_chunks(schunk) == 0);
+  }
+  blosc2_schunk_free(schunk);
+
+  // A chunk needs room for its cipher data
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  uint8_t *dest = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  fill_chunk(buffer, 1);
+  CUTEST_ASSERT("A chunk without room is compressed",
+                blosc2_compress_ctx(cctx, buffer, chunksize, dest, chunksize + BLOSC2_MAX_OVERHEAD) == 0);
+  free(dest);
+  blosc2_free_ctx(cctx);
+
+  // What would leak the data is not taken
+  cparams.checksum = BLOSC2_CHECKSUM_XXH3;
+  CUTEST_ASSERT("A cipher takes checksums", blosc2_create_cctx(cparams) == NULL);
+  cparams.checksum = BLOSC2_CHECKSUM_NONE;
+  cparams.cipher_key = NULL;
+  CUTEST_ASSERT("A cipher takes no key", blosc2_create_cctx(cparams) == NULL);
+  free(buffer);
+
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(cipher) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(cipher);
+}
@@ -0,0 +1,107 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the ZSTD, LZ4 and zlib states that are reused from a chunk to the next.
+  Changing levels and codecs on the same context must give the same chunks
+  as fresh contexts.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NITEMS (64 * 1000)
+#define NROUNDS 18
+
+
+typedef struct {
+  int16_t nthreads;
+  int32_t blocksize;
+} test_codec_state_backend;
+
+CUTEST_TEST_DATA(codec_state) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(codec_state) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+
+  CUTEST_PARAMETRIZE(backend, test_codec_state_backend, CUTEST_DATA(
+      {1, 32 * 1024},
+      {4, 32 * 1024},
+      {1, 0},
+  ));
+}
+
+
+CUTEST_TEST_TEST(codec_state) {
+  CUTEST_GET_PARAMETER(backend, test_codec_state_backend);
+
+  int32_t nbytes = NITEMS * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  int32_t *rec_buffer = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  uint8_t *chunk2 = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+
+  int compcodes[] = {BLOSC_ZSTD, BLOSC_LZ4, BLOSC_ZSTD, BLOSC_ZLIB, BLOSC_ZSTD, BLOSC_LZ4, BLOSC_ZLIB, BLOSC_ZLIB,
+                     BLOSC_BLOSCLZ};
+  int clevels[] = {1, 5, 9, 1, 1, 3, 5, 9, 5};
+  int ncodecs = sizeof(compcodes) / sizeof(compcodes[0]);
+
+  /* The global context is kept from a call to the next */
+  blosc2_set_nthreads(backend.nthreads);
+  blosc1_set_blocksize(backend.blocksize);
+  for (int i = 0; i < NROUNDS; i++) {
+    for (int j = 0; j < NITEMS; j++) {
+      data_buffer[j] = (j + i) / (i + 1) ^ (j >> 9);
+    }
+    int compcode = compcodes[i % ncodecs];
+    int clevel = clevels[i % ncodecs];
+    const char *compname;
+    blosc2_compcode_to_compname(compcode, &compname);
+    blosc1_set_compressor(compname);
+    int cbytes = blosc2_compress(clevel, BLOSC_SHUFFLE, sizeof(int32_t), data_buffer, nbytes,
+                                 chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+    CUTEST_ASSERT("Error compressing", cbytes > 0);
+
+    blosc2_cparams cparams = data->cparams;
+    cparams.compcode = (uint8_t) compcode;
+    cparams.clevel = (uint8_t) clevel;
+    cparams.typesize = sizeof(int32_t);
+    cparams.blocksize = backend.blocksize;
+    cparams.nthreads = backend.nthreads;
+    blosc2_context *cctx = blosc2_create_cctx(cparams);
+    int cbytes2 = blosc2_compress_ctx(cctx, data_buffer, nbytes, chunk2, nbytes + BLOSC2_MAX_OVERHEAD);
+    blosc2_free_ctx(cctx);
+    CUTEST_ASSERT("Error compressing", cbytes2 > 0);
+    if (backend.nthreads == 1) {
+      /* The blocks are laid out in the order that threads finish them otherwise */
+      CUTEST_ASSERT("The chunks are not equal", cbytes == cbytes2 && memcmp(chunk, chunk2, cbytes) == 0);
+    }
+
+    int dbytes = blosc2_decompress(chunk, cbytes, rec_buffer, nbytes);
+    CUTEST_ASSERT("Error decompressing", dbytes == nbytes);
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, nbytes) == 0);
+  }
+  blosc1_set_blocksize(0);
+
+  free(data_buffer);
+  free(rec_buffer);
+  free(chunk);
+  free(chunk2);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(codec_state) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(codec_state);
+}
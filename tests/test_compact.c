@@ -0,0 +1,165 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for reclaiming the space of the chunks no longer used in frames.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS 8
+#define URLPATH "test_compact.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+  bool in_place;
+} test_storage;
+
+CUTEST_TEST_DATA(compact) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(compact) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false, true},
+      {NULL, true, true},
+      {NULL, true, false},
+      {URLPATH, true, true},
+      {URLPATH, true, false},
+      {URLPATH, false, true},
+  ));
+}
+
+
+/* Noise does not compress, so updating with it leaves the old chunk behind */
+static void fill_chunk(int32_t *buffer, int64_t nchunk, bool noise) {
+  uint32_t state = (uint32_t) nchunk + 1;
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    state = state * 1664525u + 1013904223u;
+    buffer[i] = noise ? (int32_t) state : (int32_t) (nchunk * CHUNKSIZE + i);
+  }
+}
+
+
+static int check_chunks(blosc2_schunk *schunk, const bool *noise) {
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *expected = malloc(CHUNKSIZE * sizeof(int32_t));
+  int errors = 0;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKSIZE * sizeof(int32_t));
+    if (dsize != CHUNKSIZE * (int) sizeof(int32_t)) {
+      errors++;
+      continue;
+    }
+    if (nchunk == 0) {
+      memset(expected, 0, CHUNKSIZE * sizeof(int32_t));
+    }
+    else {
+      // The chunk 2 is deleted, so the ones after it are shifted
+      int64_t tag = nchunk < 2 ? nchunk : nchunk + 1;
+      fill_chunk(expected, tag, noise[tag]);
+    }
+    if (memcmp(buffer, expected, CHUNKSIZE * sizeof(int32_t)) != 0) {
+      errors++;
+    }
+  }
+  free(buffer);
+  free(expected);
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(compact) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tstorage.urlpath, .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  bool noise[NCHUNKS] = {false};
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(buffer, nchunk, false);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, CHUNKSIZE * sizeof(int32_t)) == nchunk + 1);
+  }
+
+  // Leave some holes: larger chunks go to the end, and deleted and special ones free their space
+  uint8_t *chunk = malloc(CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  for (int64_t nchunk = 1; nchunk < NCHUNKS; nchunk += 3) {
+    fill_chunk(buffer, nchunk, true);
+    noise[nchunk] = true;
+    int cbytes = blosc2_compress_ctx(schunk->cctx, buffer, CHUNKSIZE * sizeof(int32_t), chunk,
+                                     CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+    CUTEST_ASSERT("Cannot compress the chunk", cbytes > 0);
+    CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, nchunk, chunk, true) == NCHUNKS);
+  }
+  int cbytes = blosc2_chunk_zeros(cparams, CHUNKSIZE * sizeof(int32_t), chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+  CUTEST_ASSERT("Cannot create the zeros chunk", cbytes > 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 0, chunk, true) == NCHUNKS);
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, 2) == NCHUNKS - 1);
+  free(chunk);
+  free(buffer);
+  CUTEST_ASSERT("Wrong chunks before compacting", check_chunks(schunk, noise) == 0);
+
+  int64_t frame_len = blosc2_schunk_frame_len(schunk);
+  int64_t reclaimed = blosc2_schunk_compact(schunk, tstorage.in_place);
+  if (!tstorage.in_place && tstorage.urlpath == NULL) {
+    CUTEST_ASSERT("In-memory frames can only be compacted in place", reclaimed < 0);
+    reclaimed = blosc2_schunk_compact(schunk, true);
+  }
+  CUTEST_ASSERT("Cannot compact the super-chunk", reclaimed >= 0);
+  if (tstorage.contiguous) {
+    CUTEST_ASSERT("Nothing reclaimed", reclaimed > 0);
+    CUTEST_ASSERT("Wrong frame length", blosc2_schunk_frame_len(schunk) == frame_len - reclaimed);
+    CUTEST_ASSERT("The chunks do not add up", schunk->cbytes < frame_len - reclaimed);
+  }
+  else {
+    CUTEST_ASSERT("Nothing to reclaim without contiguous frames", reclaimed == 0);
+  }
+  CUTEST_ASSERT("Wrong chunks after compacting", check_chunks(schunk, noise) == 0);
+  CUTEST_ASSERT("Nothing to reclaim twice", blosc2_schunk_compact(schunk, true) == 0);
+
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("Wrong chunks after reopening", check_chunks(schunk, noise) == 0);
+    if (tstorage.contiguous) {
+      CUTEST_ASSERT("The file is not truncated", blosc2_schunk_frame_len(schunk) == frame_len - reclaimed);
+      FILE *fp = fopen(tstorage.urlpath, "rb");
+      fseek(fp, 0, SEEK_END);
+      CUTEST_ASSERT("The file is not truncated", ftell(fp) == frame_len - reclaimed);
+      fclose(fp);
+    }
+  }
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(compact) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(compact);
+}
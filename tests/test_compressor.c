@@ -34,6 +34,7 @@ static char *test_compressor(void) {
 
   /* Activate the BLOSC_COMPRESSOR variable */
   setenv("BLOSC_COMPRESSOR", "lz4", 0);
+  blosc2_reload_env();
 
   /* Get a compressed buffer */
   cbytes = blosc1_compress(clevel, doshuffle, typesize, size, src,
@@ -46,6 +47,7 @@ static char *test_compressor(void) {
 
   /* Reset envvar */
   unsetenv("BLOSC_COMPRESSOR");
+  blosc2_reload_env();
   return 0;
 }
 
@@ -56,6 +58,7 @@ static char *test_compress_decompress(void) {
 
   /* Activate the BLOSC_COMPRESSOR variable */
   setenv("BLOSC_COMPRESSOR", "lz4", 0);
+  blosc2_reload_env();
 
   compressor = blosc1_get_compressor();
   mu_assert("ERROR: get_compressor incorrect",
@@ -80,6 +83,7 @@ static char *test_compress_decompress(void) {
 
   /* Reset envvar */
   unsetenv("BLOSC_COMPRESSOR");
+  blosc2_reload_env();
   return 0;
 }
 
@@ -93,14 +97,19 @@ static char *test_clevel(void) {
                            dest, size + BLOSC2_MAX_OVERHEAD);
   mu_assert("ERROR: cbytes is not correct", cbytes < size);
 
-  /* Activate the BLOSC_CLEVEL variable */
+  /* Activate the BLOSC_CLEVEL variable, which is only seen after reloading the environment */
   setenv("BLOSC_CLEVEL", "9", 0);
+  cbytes2 = blosc1_compress(clevel, doshuffle, typesize, size, src,
+                            dest, size + BLOSC2_MAX_OVERHEAD);
+  mu_assert("ERROR: BLOSC_CLEVEL is seen with no reloading", cbytes2 == cbytes);
+  blosc2_reload_env();
   cbytes2 = blosc1_compress(clevel, doshuffle, typesize, size, src,
                             dest, size + BLOSC2_MAX_OVERHEAD);
   mu_assert("ERROR: BLOSC_CLEVEL does not work correctly", cbytes2 != cbytes);
 
   /* Reset envvar */
   unsetenv("BLOSC_CLEVEL");
+  blosc2_reload_env();
   return 0;
 }
 
@@ -115,6 +124,7 @@ static char *test_noshuffle(void) {
 
   /* Activate the BLOSC_SHUFFLE variable */
   setenv("BLOSC_SHUFFLE", "NOSHUFFLE", 0);
+  blosc2_reload_env();
   cbytes2 = blosc1_compress(clevel, doshuffle, typesize, size, src,
                             dest, size + BLOSC2_MAX_OVERHEAD);
   mu_assert("ERROR: BLOSC_SHUFFLE=NOSHUFFLE does not work correctly",
@@ -122,6 +132,7 @@ static char *test_noshuffle(void) {
 
   /* Reset env var */
   unsetenv("BLOSC_SHUFFLE");
+  blosc2_reload_env();
   return 0;
 }
 
@@ -137,6 +148,7 @@ static char *test_shuffle(void) {
 
   /* Activate the BLOSC_SHUFFLE variable */
   setenv("BLOSC_SHUFFLE", "SHUFFLE", 0);
+  blosc2_reload_env();
   cbytes2 = blosc1_compress(clevel, doshuffle, typesize, size, src,
                             dest, size + BLOSC2_MAX_OVERHEAD);
   mu_assert("ERROR: BLOSC_SHUFFLE=SHUFFLE does not work correctly",
@@ -144,6 +156,7 @@ static char *test_shuffle(void) {
 
   /* Reset env var */
   unsetenv("BLOSC_SHUFFLE");
+  blosc2_reload_env();
   return 0;
 }
 
@@ -162,6 +175,7 @@ static char *test_bitshuffle(void) {
 
   /* Activate the BLOSC_BITSHUFFLE variable */
   setenv("BLOSC_SHUFFLE", "BITSHUFFLE", 0);
+  blosc2_reload_env();
   cbytes2 = blosc1_compress(clevel, doshuffle, typesize, size, src,
                             dest, size + BLOSC2_MAX_OVERHEAD);
   mu_assert("ERROR: BLOSC_SHUFFLE=BITSHUFFLE does not work correctly",
@@ -169,6 +183,7 @@ static char *test_bitshuffle(void) {
 
   /* Reset env var */
   unsetenv("BLOSC_SHUFFLE");
+  blosc2_reload_env();
   return 0;
 }
 
@@ -186,6 +201,7 @@ static char *test_delta(void) {
 
   /* Activate the BLOSC_DELTA variable */
   setenv("BLOSC_DELTA", "1", 0);
+  blosc2_reload_env();
   cbytes2 = blosc1_compress(clevel, doshuffle, typesize, size, src,
                             dest, size + BLOSC2_MAX_OVERHEAD);
   mu_assert("ERROR: BLOSC_DELTA=1 does not work correctly",
@@ -193,6 +209,7 @@ static char *test_delta(void) {
 
   /* Reset env var */
   unsetenv("BLOSC_DELTA");
+  blosc2_reload_env();
   return 0;
 }
 
@@ -208,12 +225,14 @@ static char *test_typesize(void) {
 
   /* Activate the BLOSC_TYPESIZE variable */
   setenv("BLOSC_TYPESIZE", "9", 0);
+  blosc2_reload_env();
   cbytes2 = blosc1_compress(clevel, doshuffle, typesize, size, src,
                             dest, size + BLOSC2_MAX_OVERHEAD);
   mu_assert("ERROR: BLOSC_TYPESIZE does not work correctly", cbytes2 > cbytes);
 
   /* Reset envvar */
   unsetenv("BLOSC_TYPESIZE");
+  blosc2_reload_env();
   return 0;
 }
 
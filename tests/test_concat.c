@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for concatenating super-chunks with no recompression.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (20 * 1000)
+#define NCHUNKS 5
+#define NCHUNKS2 4
+#define URLPATH "test_concat.b2frame"
+#define URLPATH2 "test_concat2.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(concat) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(concat) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = 8;
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(tstorage2, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH2, true},
+      {URLPATH2, false},
+  ));
+}
+
+
+static void fill_chunk(int32_t *buffer, int64_t nchunk) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = (int32_t) (nchunk * CHUNKITEMS + i % 1000);
+  }
+}
+
+/* A super-chunk with `nchunks` chunks from `first` on, but for the `zeros` one, which is special */
+static blosc2_schunk *new_schunk(test_storage tstorage, char *urlpath, int64_t first, int64_t nchunks,
+                                 int64_t zeros) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.zonemap = BLOSC2_ZONEMAP_INT;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tstorage.urlpath == NULL ? NULL : urlpath,
+                            .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  for (int64_t nchunk = first; nchunk < first + nchunks; nchunk++) {
+    fill_chunk(buffer, nchunk);
+    if (nchunk == zeros) {
+      memset(buffer, 0, CHUNKITEMS * sizeof(int32_t));
+      uint8_t chunk[BLOSC_EXTENDED_HEADER_LENGTH];
+      blosc2_chunk_zeros(cparams, CHUNKITEMS * sizeof(int32_t), chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+      blosc2_schunk_append_chunk(schunk, chunk, true);
+    }
+    else {
+      blosc2_schunk_append_buffer(schunk, buffer, CHUNKITEMS * sizeof(int32_t));
+    }
+  }
+  free(buffer);
+  return schunk;
+}
+
+static int check_chunks(blosc2_schunk *schunk, int64_t nchunks, int64_t zeros) {
+  int errors = schunk->nchunks != nchunks;
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  int32_t *expected = malloc(CHUNKITEMS * sizeof(int32_t));
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    fill_chunk(expected, nchunk);
+    if (nchunk == zeros) {
+      memset(expected, 0, CHUNKITEMS * sizeof(int32_t));
+    }
+    int rc = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKITEMS * sizeof(int32_t));
+    errors += rc != CHUNKITEMS * (int) sizeof(int32_t) || memcmp(buffer, expected, rc) != 0;
+  }
+  free(expected);
+  free(buffer);
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(concat) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(tstorage2, test_storage);
+
+  int64_t zeros = NCHUNKS + 1;
+  blosc2_schunk *schunk = new_schunk(tstorage, URLPATH, 0, NCHUNKS, -1);
+  blosc2_schunk *src = new_schunk(tstorage2, URLPATH2, NCHUNKS, NCHUNKS2, zeros);
+  int64_t cbytes = schunk->cbytes + src->cbytes;
+
+  CUTEST_ASSERT("Cannot concatenate", blosc2_schunk_concat(schunk, src) == NCHUNKS + NCHUNKS2);
+  CUTEST_ASSERT("Wrong chunks", check_chunks(schunk, NCHUNKS + NCHUNKS2, zeros) == 0);
+  CUTEST_ASSERT("Wrong nbytes", schunk->nbytes == (NCHUNKS + NCHUNKS2) * CHUNKITEMS * (int64_t) sizeof(int32_t));
+  // The chunks of contiguous frames go verbatim
+  CUTEST_ASSERT("Wrong cbytes", schunk->cbytes == cbytes || !tstorage.contiguous || !tstorage2.contiguous);
+  // The zone maps go along
+  blosc2_zonemap zonemap;
+  CUTEST_ASSERT("Cannot get the zone map",
+                blosc2_schunk_get_zonemap(schunk, NCHUNKS + NCHUNKS2 - 1, &zonemap, NULL) >= 0);
+  CUTEST_ASSERT("Wrong zone map", zonemap.min.i == (NCHUNKS + NCHUNKS2 - 1) * CHUNKITEMS);
+
+  // The super-chunk can be appended to and reopened
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  fill_chunk(buffer, NCHUNKS + NCHUNKS2);
+  CUTEST_ASSERT("Cannot append the chunk",
+                blosc2_schunk_append_buffer(schunk, buffer, CHUNKITEMS * sizeof(int32_t)) == NCHUNKS + NCHUNKS2 + 1);
+  free(buffer);
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  }
+  CUTEST_ASSERT("Wrong chunks", check_chunks(schunk, NCHUNKS + NCHUNKS2 + 1, zeros) == 0);
+  blosc2_schunk_free(src);
+  blosc2_schunk_free(schunk);
+
+  // Into an empty super-chunk
+  blosc2_schunk *empty = new_schunk(tstorage, URLPATH, 0, 0, -1);
+  blosc2_schunk *src2 = new_schunk(tstorage2, URLPATH2, 0, NCHUNKS, -1);
+  CUTEST_ASSERT("Cannot concatenate", blosc2_schunk_concat(empty, src2) == NCHUNKS);
+  CUTEST_ASSERT("Wrong chunks", check_chunks(empty, NCHUNKS, -1) == 0);
+  CUTEST_ASSERT("Cannot concatenate", blosc2_schunk_concat(empty, src2) == 2 * NCHUNKS);
+  blosc2_schunk_free(src2);
+
+  // The chunks must fit
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams};
+  blosc2_schunk *other = blosc2_schunk_new(&storage);
+  uint8_t *items = calloc(CHUNKITEMS, sizeof(int32_t));
+  blosc2_schunk_append_buffer(other, items, CHUNKITEMS * sizeof(int32_t));
+  CUTEST_ASSERT("Chunks of another typesize are concatenated", blosc2_schunk_concat(empty, other) < 0);
+  blosc2_schunk_free(other);
+  cparams.typesize = sizeof(int32_t);
+  other = blosc2_schunk_new(&storage);
+  blosc2_schunk_append_buffer(other, items, CHUNKITEMS * sizeof(int32_t));
+  blosc2_schunk_append_buffer(other, items, CHUNKITEMS * sizeof(int32_t) / 2);
+  CUTEST_ASSERT("Cannot concatenate", blosc2_schunk_concat(empty, other) == 2 * NCHUNKS + 2);
+  CUTEST_ASSERT("Chunks are concatenated after a smaller one", blosc2_schunk_concat(empty, other) < 0);
+  CUTEST_ASSERT("A super-chunk is concatenated to itself", blosc2_schunk_concat(other, other) < 0);
+  blosc2_schunk_free(other);
+  free(items);
+  blosc2_schunk_free(empty);
+
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_remove_urlpath(URLPATH2);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(concat) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(concat);
+}
@@ -0,0 +1,223 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the concurrent reads of a super-chunk from several threads.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#include <pthread.h>
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS 12
+#define ZEROS_CHUNK 5
+#define NREADERS 8
+#define NCTXS 4
+#define NREADS 40
+#define URLPATH "test_concurrent_reads.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(concurrent_reads) {
+  blosc2_cparams cparams;
+};
+
+typedef struct {
+  blosc2_schunk *schunk;
+  int id;
+  int errors;
+} reader;
+
+/* Whether some postfilter got the wrong chunk */
+static volatile int nchunk_errors = 0;
+
+
+static int32_t expected_item(int64_t nitem) {
+  return (nitem / CHUNKSIZE == ZEROS_CHUNK) ? 0 : (int32_t) nitem;
+}
+
+
+/* Check that the chunk in postparams is the one that is being decompressed */
+static int check_nchunk(blosc2_postfilter_params *postparams) {
+  memcpy(postparams->output, postparams->input, postparams->size);
+  int32_t item = ((int32_t *) postparams->input)[0];
+  int64_t nitem = postparams->nchunk * CHUNKSIZE + postparams->offset / (int32_t) sizeof(int32_t);
+  if (item != expected_item(nitem)) {
+    nchunk_errors++;
+  }
+  return 0;
+}
+
+
+CUTEST_TEST_SETUP(concurrent_reads) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 2));
+}
+
+
+static void *read_chunks(void *arg) {
+  reader *r = (reader *) arg;
+  int32_t *chunk = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *slice = malloc(2 * CHUNKSIZE * sizeof(int32_t));
+  for (int i = 0; i < NREADS; i++) {
+    int64_t nchunk = (r->id * 7 + i) % NCHUNKS;
+    int dsize = blosc2_schunk_decompress_chunk(r->schunk, nchunk, chunk, CHUNKSIZE * sizeof(int32_t));
+    if (dsize != CHUNKSIZE * (int) sizeof(int32_t)) {
+      r->errors++;
+      continue;
+    }
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      if (chunk[j] != expected_item(nchunk * CHUNKSIZE + j)) {
+        r->errors++;
+        break;
+      }
+    }
+
+    // A slice across chunks
+    int64_t start = nchunk * CHUNKSIZE + CHUNKSIZE / 3 + r->id;
+    int64_t stop = start + CHUNKSIZE + 17;
+    if (stop > (int64_t) NCHUNKS * CHUNKSIZE) {
+      stop = (int64_t) NCHUNKS * CHUNKSIZE;
+    }
+    if (blosc2_schunk_get_slice_buffer(r->schunk, start, stop, slice) < 0) {
+      r->errors++;
+      continue;
+    }
+    for (int64_t j = start; j < stop; j++) {
+      if (slice[j - start] != expected_item(j)) {
+        r->errors++;
+        break;
+      }
+    }
+  }
+  free(chunk);
+  free(slice);
+  return NULL;
+}
+
+
+CUTEST_TEST_TEST(concurrent_reads) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = nthreads;
+  cparams.blocksize = 16 * 1024;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams,
+                            .urlpath=tstorage.urlpath, .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  for (int nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    if (nchunk == ZEROS_CHUNK) {
+      uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+      blosc2_chunk_zeros(cparams, CHUNKSIZE * sizeof(int32_t), zeros, sizeof(zeros));
+      CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_chunk(schunk, zeros, true) == nchunk + 1);
+      continue;
+    }
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      buffer[i] = nchunk * CHUNKSIZE + i;
+    }
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, CHUNKSIZE * sizeof(int32_t)) == nchunk + 1);
+  }
+  free(buffer);
+
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open_udio(tstorage.urlpath, &BLOSC2_IO_DEFAULTS);
+    CUTEST_ASSERT("Cannot open the super-chunk", schunk != NULL);
+  }
+
+  // The postfilters get the chunk of each reader
+  blosc2_dparams pf_dparams = BLOSC2_DPARAMS_DEFAULTS;
+  pf_dparams.nthreads = nthreads;
+  pf_dparams.schunk = schunk;
+  pf_dparams.postfilter = check_nchunk;
+  blosc2_postfilter_params postparams = {0};
+  pf_dparams.postparams = &postparams;
+  blosc2_free_ctx(schunk->dctx);
+  schunk->dctx = blosc2_create_dctx(pf_dparams);
+  nchunk_errors = 0;
+
+  CUTEST_ASSERT("Cannot enable the concurrent reads", blosc2_schunk_set_concurrent_reads(schunk, NCTXS) == 0);
+  CUTEST_ASSERT("The chunk cache cannot be used with concurrent reads",
+                blosc2_schunk_set_chunk_cache(schunk, 1 << 20) < 0);
+  if (tstorage.urlpath != NULL) {
+    CUTEST_ASSERT("The read-ahead cannot be used with concurrent reads",
+                  blosc2_schunk_set_prefetch(schunk, 2) < 0);
+  }
+
+  pthread_t threads[NREADERS];
+  reader readers[NREADERS];
+  for (int i = 0; i < NREADERS; i++) {
+    readers[i].schunk = schunk;
+    readers[i].id = i;
+    readers[i].errors = 0;
+    CUTEST_ASSERT("Cannot start the reader", pthread_create(&threads[i], NULL, read_chunks, &readers[i]) == 0);
+  }
+  int errors = 0;
+  for (int i = 0; i < NREADERS; i++) {
+    pthread_join(threads[i], NULL);
+    errors += readers[i].errors;
+  }
+  CUTEST_ASSERT("Wrong data read concurrently", errors == 0);
+  CUTEST_ASSERT("Postfilters got the wrong chunk", nchunk_errors == 0);
+
+  // The chunks cannot be modified meanwhile
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_chunk(schunk, 0, &chunk, &needs_free);
+  CUTEST_ASSERT("Cannot get the chunk", cbytes > 0);
+  CUTEST_ASSERT("Chunks cannot be updated with concurrent reads",
+                blosc2_schunk_update_chunk(schunk, 1, chunk, true) < 0);
+  CUTEST_ASSERT("Chunks cannot be deleted with concurrent reads",
+                blosc2_schunk_delete_chunk(schunk, 1) < 0);
+
+  // And they can once disabled
+  CUTEST_ASSERT("Cannot disable the concurrent reads", blosc2_schunk_set_concurrent_reads(schunk, 0) == 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 1, chunk, true) == NCHUNKS);
+  if (needs_free) {
+    free(chunk);
+  }
+  int32_t item;
+  CUTEST_ASSERT("Cannot read the updated chunk",
+                blosc2_schunk_get_slice_buffer(schunk, CHUNKSIZE + 1, CHUNKSIZE + 2, &item) == 0);
+  CUTEST_ASSERT("Wrong updated chunk", item == 1);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(concurrent_reads) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(concurrent_reads);
+}
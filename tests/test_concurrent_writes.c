@@ -0,0 +1,205 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the concurrent appends and updates of a super-chunk on a sparse frame.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#include <pthread.h>
+
+#define CHUNKSIZE (20 * 1000)
+#define NWRITERS 4
+#define NAPPENDS 6
+#define NCHUNKS (NWRITERS * NAPPENDS + 1)
+#define NCTXS 2
+#define UPDATED 1000
+#define URLPATH "test_concurrent_writes.b2frame"
+
+
+CUTEST_TEST_DATA(concurrent_writes) {
+  blosc2_cparams cparams;
+};
+
+typedef struct {
+  blosc2_schunk *schunk;
+  int id;
+  int errors;
+} writer;
+
+
+CUTEST_TEST_SETUP(concurrent_writes) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 2));
+}
+
+
+/* The chunks are tagged by their first item, as their order depends on the writers */
+static void fill_chunk(int32_t *buffer, int32_t tag) {
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    buffer[i] = tag * CHUNKSIZE + i;
+  }
+}
+
+
+static void *append_chunks(void *arg) {
+  writer *w = (writer *) arg;
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  for (int i = 0; i < NAPPENDS; i++) {
+    fill_chunk(buffer, w->id * NAPPENDS + i);
+    if (blosc2_schunk_append_buffer(w->schunk, buffer, CHUNKSIZE * sizeof(int32_t)) <= 0) {
+      w->errors++;
+    }
+  }
+  if (w->id == 0) {
+    uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+    blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+    cparams.typesize = sizeof(int32_t);
+    blosc2_chunk_zeros(cparams, CHUNKSIZE * sizeof(int32_t), zeros, sizeof(zeros));
+    if (blosc2_schunk_append_chunk(w->schunk, zeros, true) <= 0) {
+      w->errors++;
+    }
+  }
+  free(buffer);
+  return NULL;
+}
+
+
+static void *update_chunks(void *arg) {
+  writer *w = (writer *) arg;
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  uint8_t *chunk = malloc(CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  for (int64_t nchunk = w->id; nchunk < NCHUNKS; nchunk += NWRITERS) {
+    fill_chunk(buffer, UPDATED + (int32_t) nchunk);
+    int cbytes = blosc2_compress_ctx(cctx, buffer, CHUNKSIZE * sizeof(int32_t), chunk,
+                                     CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+    if (cbytes <= 0 || blosc2_schunk_update_chunk(w->schunk, nchunk, chunk, true) != NCHUNKS) {
+      w->errors++;
+    }
+  }
+  blosc2_free_ctx(cctx);
+  free(chunk);
+  free(buffer);
+  return NULL;
+}
+
+
+static int run_writers(blosc2_schunk *schunk, void *(*write)(void *)) {
+  pthread_t threads[NWRITERS];
+  writer writers[NWRITERS];
+  for (int i = 0; i < NWRITERS; i++) {
+    writers[i].schunk = schunk;
+    writers[i].id = i;
+    writers[i].errors = 0;
+    if (pthread_create(&threads[i], NULL, write, &writers[i]) != 0) {
+      return -1;
+    }
+  }
+  int errors = 0;
+  for (int i = 0; i < NWRITERS; i++) {
+    pthread_join(threads[i], NULL);
+    errors += writers[i].errors;
+  }
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(concurrent_writes) {
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+
+  // Only sparse frames can be written concurrently
+  blosc2_storage cstorage = {.cparams=&cparams, .dparams=&dparams, .contiguous=true};
+  blosc2_schunk *schunk = blosc2_schunk_new(&cstorage);
+  CUTEST_ASSERT("Only sparse frames can be written concurrently",
+                blosc2_schunk_set_concurrent_writes(schunk, NCTXS) < 0);
+  blosc2_schunk_free(schunk);
+
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=URLPATH, .contiguous=false};
+  blosc2_remove_urlpath(URLPATH);
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot enable the concurrent writes", blosc2_schunk_set_concurrent_writes(schunk, NCTXS) == 0);
+  CUTEST_ASSERT("Concurrent reads cannot be used with concurrent writes",
+                blosc2_schunk_set_concurrent_reads(schunk, NCTXS) < 0);
+  CUTEST_ASSERT("The chunk cache cannot be used with concurrent writes",
+                blosc2_schunk_set_chunk_cache(schunk, 1 << 20) < 0);
+
+  CUTEST_ASSERT("Errors in the concurrent appends", run_writers(schunk, append_chunks) == 0);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS);
+  CUTEST_ASSERT("Wrong nbytes", schunk->nbytes == (int64_t) NCHUNKS * CHUNKSIZE * sizeof(int32_t));
+  CUTEST_ASSERT("Chunks cannot be deleted with concurrent writes", blosc2_schunk_delete_chunk(schunk, 0) < 0);
+
+  // Every chunk appended is there, only once
+  bool seen[NCHUNKS] = {false};
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  CUTEST_ASSERT("Cannot disable the concurrent writes", blosc2_schunk_set_concurrent_writes(schunk, 0) == 0);
+  for (int nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKSIZE * sizeof(int32_t));
+    CUTEST_ASSERT("Cannot decompress the chunk", dsize == CHUNKSIZE * (int) sizeof(int32_t));
+    int32_t tag = buffer[0] == 0 && buffer[1] == 0 ? NCHUNKS - 1 : buffer[0] / CHUNKSIZE;
+    CUTEST_ASSERT("Wrong chunk", tag >= 0 && tag < NCHUNKS && !seen[tag]);
+    seen[tag] = true;
+  }
+
+  // The updates replace the chunks in place, from any thread
+  CUTEST_ASSERT("Cannot enable the concurrent writes", blosc2_schunk_set_concurrent_writes(schunk, NCTXS) == 0);
+  CUTEST_ASSERT("Errors in the concurrent updates", run_writers(schunk, update_chunks) == 0);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS);
+  int64_t cbytes = schunk->cbytes;
+  blosc2_schunk_free(schunk);
+
+  // The index is in the frame
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot open the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS);
+  CUTEST_ASSERT("Wrong cbytes", schunk->cbytes == cbytes);
+  int64_t stored = 0;
+  for (int nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKSIZE * sizeof(int32_t));
+    CUTEST_ASSERT("Cannot decompress the chunk", dsize == CHUNKSIZE * (int) sizeof(int32_t));
+    CUTEST_ASSERT("Wrong updated chunk", buffer[0] == (UPDATED + nchunk) * CHUNKSIZE);
+    CUTEST_ASSERT("Wrong updated chunk", buffer[CHUNKSIZE - 1] == (UPDATED + nchunk + 1) * CHUNKSIZE - 1);
+    uint8_t *chunk;
+    bool needs_free;
+    int chunk_cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
+    CUTEST_ASSERT("Cannot get the chunk", chunk_cbytes > 0);
+    int32_t chunk_cbytes_;
+    blosc2_cbuffer_sizes(chunk, NULL, &chunk_cbytes_, NULL);
+    stored += chunk_cbytes_;
+    if (needs_free) {
+      free(chunk);
+    }
+  }
+  CUTEST_ASSERT("The cbytes do not add up", stored == cbytes);
+  free(buffer);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(concurrent_writes) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(concurrent_writes);
+}
@@ -132,6 +132,9 @@ CUTEST_TEST_TEST(copy) {
 
   /* Append the chunks */
   for (int nchunk = 0; nchunk < nchunks; nchunk++) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      data_buffer[i] = nchunk * CHUNKSIZE + i;
+    }
     int64_t nc = blosc2_schunk_append_buffer(schunk, data_buffer, isize);
     CUTEST_ASSERT("Error appending chunk", nc >= 0);
   }
@@ -168,6 +171,26 @@ CUTEST_TEST_TEST(copy) {
     dsize = blosc2_schunk_decompress_chunk(schunk_copy, nchunk, rec_buffer, isize);
     CUTEST_ASSERT("Decompression error", dsize >= 0);
     CUTEST_ASSERT("Decompression size is not equal to input size", dsize == (int) isize);
+    CUTEST_ASSERT("The copied data is not equal", memcmp(data_buffer, rec_buffer, isize) == 0);
+  }
+  CUTEST_ASSERT("Wrong number of chunks", schunk_copy->nchunks == nchunks);
+  CUTEST_ASSERT("Wrong nbytes", schunk_copy->nbytes == schunk->nbytes);
+  if (!different_cparams && backend.contiguous && backend2.contiguous) {
+    // The chunks are copied verbatim
+    CUTEST_ASSERT("Wrong cbytes", schunk_copy->cbytes == schunk->cbytes);
+  }
+
+  if (backend2.urlpath != NULL) {
+    blosc2_schunk_free(schunk_copy);
+    schunk_copy = blosc2_schunk_open(backend2.urlpath);
+    CUTEST_ASSERT("Cannot reopen the copy", schunk_copy != NULL);
+    CUTEST_ASSERT("Wrong number of chunks", schunk_copy->nchunks == nchunks);
+    for (int nchunk = 0; nchunk < nchunks; nchunk++) {
+      int dsize = blosc2_schunk_decompress_chunk(schunk_copy, nchunk, rec_buffer, isize);
+      CUTEST_ASSERT("Decompression size is not equal to input size", dsize == (int) isize);
+      CUTEST_ASSERT("The copied data is not equal", rec_buffer[0] == nchunk * CHUNKSIZE);
+      CUTEST_ASSERT("The copied data is not equal", rec_buffer[CHUNKSIZE - 1] == (nchunk + 1) * CHUNKSIZE - 1);
+    }
   }
 
   /* Free resources */
@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the statistics of the contexts (blosc2_ctx_get_stats()).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NITEMS (1000 * 1000)
+#define BLOCKSIZE (64 * 1024)
+#define NBYTES (NITEMS * (int32_t)sizeof(int32_t))
+#define NBLOCKS ((NBYTES + BLOCKSIZE - 1) / BLOCKSIZE)
+#define URLPATH "test_ctx_stats.b2frame"
+
+
+CUTEST_TEST_DATA(ctx_stats) {
+  int32_t *src;
+  uint8_t *chunk;
+  int32_t *dest;
+};
+
+
+CUTEST_TEST_SETUP(ctx_stats) {
+  blosc2_init();
+  data->src = malloc(NBYTES);
+  data->chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(NBYTES);
+
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 4));
+}
+
+
+static blosc2_context *create_cctx(int16_t nthreads) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = BLOCKSIZE;
+  cparams.splitmode = BLOSC_NEVER_SPLIT;
+  cparams.nthreads = nthreads;
+  return blosc2_create_cctx(cparams);
+}
+
+static blosc2_context *create_dctx(int16_t nthreads) {
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  return blosc2_create_dctx(dparams);
+}
+
+
+CUTEST_TEST_TEST(ctx_stats) {
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+  blosc2_ctx_stats stats;
+
+  // Regular data
+  for (int i = 0; i < NITEMS; i++) {
+    data->src[i] = i;
+  }
+  blosc2_context *cctx = create_cctx(nthreads);
+  blosc2_context *dctx = create_dctx(nthreads);
+  CUTEST_ASSERT("Error getting the stats", blosc2_ctx_get_stats(cctx, &stats) == 0);
+  CUTEST_ASSERT("New contexts should have no stats", stats.ncalls == 0 && stats.nblocks == 0);
+  int csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  blosc2_ctx_get_stats(cctx, &stats);
+  CUTEST_ASSERT("Wrong calls", stats.ncalls == 1);
+  CUTEST_ASSERT("Wrong bytes", stats.nbytes_in == NBYTES && stats.nbytes_out == csize);
+  CUTEST_ASSERT("Wrong blocks", stats.nblocks == NBLOCKS && stats.nblocks_raw == 0);
+  CUTEST_ASSERT("No time in the codec", stats.codec_ns > 0 && stats.filters_ns > 0);
+  CUTEST_ASSERT("Wrong special chunks", stats.nspecial_chunks == 0);
+  CUTEST_ASSERT("Threads cannot wait a negative time", stats.idle_ns >= 0);
+  CUTEST_ASSERT("Threads cannot synchronize in a negative time",
+                stats.wakeup_ns >= 0 && stats.sync_ns >= 0 && stats.sched_ns >= 0);
+  if (nthreads == 1) {
+    CUTEST_ASSERT("A single thread never waits", stats.idle_ns == 0);
+    CUTEST_ASSERT("A single thread never synchronizes",
+                  stats.wakeup_ns == 0 && stats.sync_ns == 0 && stats.sched_ns == 0);
+  }
+
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Decompression error", dsize == NBYTES);
+  blosc2_ctx_get_stats(dctx, &stats);
+  CUTEST_ASSERT("Wrong calls", stats.ncalls == 1);
+  CUTEST_ASSERT("Wrong bytes", stats.nbytes_in == csize && stats.nbytes_out == NBYTES);
+  CUTEST_ASSERT("Wrong blocks", stats.nblocks == NBLOCKS && stats.nblocks_raw == 0);
+  CUTEST_ASSERT("No time in the codec", stats.codec_ns > 0 && stats.filters_ns > 0);
+  CUTEST_ASSERT("No lazy reads expected", stats.lazy_reads == 0 && stats.lazy_read_bytes == 0);
+
+  // Getting items only decompresses the blocks they are in
+  int nbytes = blosc2_getitem_ctx(dctx, data->chunk, csize, BLOCKSIZE / 4 - 10, 20, data->dest, NBYTES);
+  CUTEST_ASSERT("Getitem error", nbytes == 20 * (int)sizeof(int32_t));
+  blosc2_ctx_get_stats(dctx, &stats);
+  CUTEST_ASSERT("Wrong calls", stats.ncalls == 2);
+  CUTEST_ASSERT("Wrong bytes", stats.nbytes_in == csize && stats.nbytes_out == NBYTES + nbytes);
+  CUTEST_ASSERT("Wrong blocks", stats.nblocks == NBLOCKS + 2);
+
+  // The counters start over
+  blosc2_ctx_reset_stats(dctx);
+  blosc2_ctx_get_stats(dctx, &stats);
+  CUTEST_ASSERT("Stats not reset", stats.ncalls == 0 && stats.nblocks == 0 && stats.codec_ns == 0);
+
+  // Incompressible data goes as it is
+  blosc2_ctx_reset_stats(cctx);
+  uint32_t seed = 1;
+  for (int i = 0; i < NITEMS; i++) {
+    seed = seed * 1103515245u + 12345u;
+    data->src[i] = (int32_t)seed;
+  }
+  csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Compression error", csize == NBYTES + BLOSC2_MAX_OVERHEAD);
+  blosc2_ctx_get_stats(cctx, &stats);
+  CUTEST_ASSERT("Wrong calls", stats.ncalls == 1);
+  CUTEST_ASSERT("The final blocks should be raw", stats.nblocks_raw >= NBLOCKS);
+  dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Decompression error", dsize == NBYTES);
+  blosc2_ctx_get_stats(dctx, &stats);
+  CUTEST_ASSERT("Wrong blocks", stats.nblocks == NBLOCKS && stats.nblocks_raw == NBLOCKS);
+  CUTEST_ASSERT("No time copying", stats.memcpy_ns > 0 && stats.codec_ns == 0);
+
+  // Zeros make special chunks
+  blosc2_ctx_reset_stats(cctx);
+  blosc2_ctx_reset_stats(dctx);
+  memset(data->src, 0, NBYTES);
+  csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Compression error", csize == BLOSC_EXTENDED_HEADER_LENGTH);
+  blosc2_ctx_get_stats(cctx, &stats);
+  CUTEST_ASSERT("Wrong special chunks", stats.nspecial_chunks == 1);
+  dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Decompression error", dsize == NBYTES);
+  blosc2_ctx_get_stats(dctx, &stats);
+  CUTEST_ASSERT("Wrong special chunks", stats.nspecial_chunks == 1 && stats.nblocks == 0);
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+
+  // The blocks of lazy chunks are read ahead in a few large reads
+  for (int i = 0; i < NITEMS; i++) {
+    data->src[i] = i;
+  }
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_storage storage = {.contiguous=true, .urlpath=URLPATH, .cparams=&cparams, .dparams=&dparams};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data->src, NBYTES) == 1);
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open_udio(URLPATH, &BLOSC2_IO_DEFAULTS);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  blosc2_ctx_reset_stats(schunk->dctx);
+  dsize = blosc2_schunk_decompress_chunk(schunk, 0, data->dest, NBYTES);
+  CUTEST_ASSERT("Decompression error", dsize == NBYTES);
+  blosc2_ctx_get_stats(schunk->dctx, &stats);
+  CUTEST_ASSERT("Wrong lazy reads", stats.lazy_reads >= 1 && stats.lazy_reads < NBLOCKS);
+  CUTEST_ASSERT("Wrong lazy bytes", stats.lazy_read_bytes > 0 && stats.lazy_read_bytes < stats.nbytes_out);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(ctx_stats) {
+  free(data->src);
+  free(data->chunk);
+  free(data->dest);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(ctx_stats);
+}
@@ -0,0 +1,164 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for reconfiguring contexts (blosc2_ctx_update_cparams() and
+  blosc2_ctx_update_dparams()).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NITEMS (500 * 1000)
+#define NBYTES (NITEMS * (int32_t)sizeof(int32_t))
+
+
+CUTEST_TEST_DATA(ctx_update) {
+  int32_t *src;
+  uint8_t *chunk;
+  uint8_t *chunk2;
+  int32_t *dest;
+};
+
+
+CUTEST_TEST_SETUP(ctx_update) {
+  blosc2_init();
+  data->src = malloc(NBYTES);
+  data->chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  data->chunk2 = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(NBYTES);
+  for (int i = 0; i < NITEMS; i++) {
+    data->src[i] = i % 1000 + i / 1000;
+  }
+
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 4));
+}
+
+
+static int prefilter_double(blosc2_prefilter_params *preparams) {
+  int32_t nitems = preparams->output_size / (int32_t)sizeof(int32_t);
+  for (int32_t i = 0; i < nitems; i++) {
+    ((int32_t *) preparams->output)[i] = ((int32_t *) preparams->input)[i] * 2;
+  }
+  return 0;
+}
+
+static int postfilter_negate(blosc2_postfilter_params *postparams) {
+  int32_t nitems = postparams->size / (int32_t)sizeof(int32_t);
+  for (int32_t i = 0; i < nitems; i++) {
+    ((int32_t *) postparams->output)[i] = -((int32_t *) postparams->input)[i];
+  }
+  return 0;
+}
+
+
+CUTEST_TEST_TEST(ctx_update) {
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.compcode = BLOSC_LZ4;
+  cparams.clevel = 5;
+  cparams.nthreads = nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Compression error", csize > 0);
+
+  /* Other codec, level, filters, typesize, blocksize and threads, as in a new context */
+  blosc2_cparams cparams2 = BLOSC2_CPARAMS_DEFAULTS;
+  cparams2.typesize = 8;
+  cparams2.compcode = BLOSC_ZSTD;
+  cparams2.clevel = 3;
+  cparams2.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_BITSHUFFLE;
+  cparams2.blocksize = 32 * 1024;
+  cparams2.nthreads = (int16_t) (nthreads + 1);
+  CUTEST_ASSERT("Cannot update the cparams", blosc2_ctx_update_cparams(cctx, &cparams2) == 0);
+  blosc2_cparams cparams3;
+  blosc2_ctx_get_cparams(cctx, &cparams3);
+  CUTEST_ASSERT("Wrong cparams", cparams3.compcode == BLOSC_ZSTD && cparams3.clevel == 3 &&
+                                 cparams3.typesize == 8 && cparams3.blocksize == 32 * 1024 &&
+                                 cparams3.filters[BLOSC2_MAX_FILTERS - 1] == BLOSC_BITSHUFFLE);
+  csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  blosc2_context *cctx2 = blosc2_create_cctx(cparams2);
+  int csize2 = blosc2_compress_ctx(cctx2, data->src, NBYTES, data->chunk2, NBYTES + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx2);
+  // The threads may lay the blocks out in other orders, but not in other headers
+  CUTEST_ASSERT("Not the chunk of a new context",
+                csize == csize2 && memcmp(data->chunk, data->chunk2, BLOSC_EXTENDED_HEADER_LENGTH) == 0);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Wrong roundtrip", dsize == NBYTES && memcmp(data->src, data->dest, NBYTES) == 0);
+
+  /* Invalid cparams leave the context as it was */
+  blosc2_cparams bad = cparams2;
+  bad.compcode = BLOSC_LZ4;
+  bad.scheduler = 99;
+  CUTEST_ASSERT("Invalid cparams are taken", blosc2_ctx_update_cparams(cctx, &bad) < 0);
+  blosc2_ctx_get_cparams(cctx, &cparams3);
+  CUTEST_ASSERT("Invalid cparams change the context", cparams3.compcode == BLOSC_ZSTD);
+  CUTEST_ASSERT("A decompression context takes cparams", blosc2_ctx_update_cparams(dctx, &cparams2) < 0);
+
+  /* A prefilter comes and goes */
+  blosc2_prefilter_params preparams = {0};
+  cparams.prefilter = prefilter_double;
+  cparams.preparams = &preparams;
+  CUTEST_ASSERT("Cannot update the cparams", blosc2_ctx_update_cparams(cctx, &cparams) == 0);
+  csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Decompression error", dsize == NBYTES);
+  int errors = 0;
+  for (int i = 0; i < NITEMS; i++) {
+    errors += data->dest[i] != data->src[i] * 2;
+  }
+  CUTEST_ASSERT("The prefilter is not applied", errors == 0);
+  cparams.prefilter = NULL;
+  cparams.preparams = NULL;
+  CUTEST_ASSERT("Cannot update the cparams", blosc2_ctx_update_cparams(cctx, &cparams) == 0);
+  csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+
+  /* A postfilter comes and goes, with other threads */
+  blosc2_postfilter_params postparams = {0};
+  dparams.postfilter = postfilter_negate;
+  dparams.postparams = &postparams;
+  dparams.nthreads = (int16_t) (nthreads + 1);
+  CUTEST_ASSERT("Cannot update the dparams", blosc2_ctx_update_dparams(dctx, &dparams) == 0);
+  dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Decompression error", dsize == NBYTES);
+  errors = 0;
+  for (int i = 0; i < NITEMS; i++) {
+    errors += data->dest[i] != -data->src[i];
+  }
+  CUTEST_ASSERT("The postfilter is not applied", errors == 0);
+  dparams.postfilter = NULL;
+  dparams.postparams = NULL;
+  CUTEST_ASSERT("Cannot update the dparams", blosc2_ctx_update_dparams(dctx, &dparams) == 0);
+  dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Wrong roundtrip", dsize == NBYTES && memcmp(data->src, data->dest, NBYTES) == 0);
+  blosc2_dparams bad_dparams = dparams;
+  bad_dparams.device = 99;
+  CUTEST_ASSERT("Invalid dparams are taken", blosc2_ctx_update_dparams(dctx, &bad_dparams) < 0);
+  CUTEST_ASSERT("A compression context takes dparams", blosc2_ctx_update_dparams(cctx, &dparams) < 0);
+
+  blosc2_free_ctx(dctx);
+  blosc2_free_ctx(cctx);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(ctx_update) {
+  free(data->dest);
+  free(data->chunk2);
+  free(data->chunk);
+  free(data->src);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(ctx_update);
+}
@@ -0,0 +1,127 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for decompressing into CUDA device memory.  Without CUDA support,
+  the contexts for the device are just refused.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+#include "config.h"
+
+#ifdef HAVE_CUDA
+#include <cuda_runtime.h>
+#endif
+
+/* Neither a multiple of the blocksize nor of the typesize */
+#define NBYTES (8 * 100003 + 5)
+#define BLOCKSIZE (32 * 1024)
+
+
+typedef struct {
+  int compcode;
+  uint8_t filter;
+  int32_t typesize;
+  int clevel;
+} test_cuda_backend;
+
+CUTEST_TEST_DATA(cuda_decompress) {
+  uint8_t *src;
+  uint8_t *chunk;
+};
+
+CUTEST_TEST_SETUP(cuda_decompress) {
+  blosc2_init();
+  data->src = malloc(NBYTES);
+  data->chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  for (int i = 0; i < NBYTES; i++) {
+    data->src[i] = (uint8_t)((i % 1031) * (i / 4096) + (i % 7 == 0 ? 0 : i / 1000));
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_cuda_backend, CUTEST_DATA(
+      {BLOSC_LZ4, BLOSC_SHUFFLE, 4, 5},
+      {BLOSC_LZ4, BLOSC_NOSHUFFLE, 4, 5},
+      {BLOSC_ZSTD, BLOSC_SHUFFLE, 8, 3},
+      {BLOSC_ZSTD, BLOSC_NOSHUFFLE, 1, 3},
+      {BLOSC_LZ4, BLOSC_BITSHUFFLE, 4, 5},  // on the host, then copied
+      {BLOSC_BLOSCLZ, BLOSC_SHUFFLE, 4, 5},  // on the host, then copied
+      {BLOSC_LZ4, BLOSC_SHUFFLE, 4, 0},  // memcpyed
+  ));
+}
+
+
+CUTEST_TEST_TEST(cuda_decompress) {
+  CUTEST_GET_PARAMETER(backend, test_cuda_backend);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.compcode = backend.compcode;
+  cparams.clevel = backend.clevel;
+  cparams.typesize = backend.typesize;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = backend.filter;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  CUTEST_ASSERT("Compression error", csize > 0);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.device = BLOSC2_DEVICE_CUDA;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+#ifndef HAVE_CUDA
+  CUTEST_ASSERT("Contexts for CUDA need CUDA support", dctx == NULL);
+#else
+  CUTEST_ASSERT("Error creating the context", dctx != NULL);
+  blosc2_dparams dparams2;
+  blosc2_ctx_get_dparams(dctx, &dparams2);
+  CUTEST_ASSERT("The device is not kept", dparams2.device == BLOSC2_DEVICE_CUDA);
+
+  uint8_t *d_dest;
+  CUTEST_ASSERT("Error allocating device memory", cudaMalloc((void**)&d_dest, NBYTES) == cudaSuccess);
+  uint8_t *dest = malloc(NBYTES);
+  // Twice for reusing the device buffers of the context
+  for (int i = 0; i < 2; i++) {
+    int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, d_dest, NBYTES);
+    CUTEST_ASSERT("Decompression error", dsize == NBYTES);
+    CUTEST_ASSERT("Error copying from the device",
+                  cudaMemcpy(dest, d_dest, NBYTES, cudaMemcpyDeviceToHost) == cudaSuccess);
+    CUTEST_ASSERT("Decompressed data differs", memcmp(dest, data->src, NBYTES) == 0);
+  }
+
+  // Special chunks (made of whole items)
+  int32_t nzeros = NBYTES - NBYTES % backend.typesize;
+  int zsize = blosc2_chunk_zeros(cparams, nzeros, data->chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+  CUTEST_ASSERT("Error creating a zeros chunk", zsize > 0);
+  CUTEST_ASSERT("Decompression error", blosc2_decompress_ctx(dctx, data->chunk, zsize, d_dest, NBYTES) == nzeros);
+  cudaMemcpy(dest, d_dest, nzeros, cudaMemcpyDeviceToHost);
+  for (int i = 0; i < nzeros; i++) {
+    CUTEST_ASSERT("The zeros chunk is not zeroed", dest[i] == 0);
+  }
+
+  int32_t item;
+  CUTEST_ASSERT("Getting items should fail",
+                blosc2_getitem_ctx(dctx, data->chunk, zsize, 0, 1, &item, sizeof(item)) < 0);
+
+  free(dest);
+  cudaFree(d_dest);
+  blosc2_free_ctx(dctx);
+#endif
+
+  dparams.device = BLOSC2_DEVICE_CUDA + 1;
+  CUTEST_ASSERT("Unknown devices should be refused", blosc2_create_dctx(dparams) == NULL);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(cuda_decompress) {
+  free(data->src);
+  free(data->chunk);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(cuda_decompress);
+}
@@ -0,0 +1,136 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the decompression of ranges of items with the threads of the context.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (100 * 1000 + 3)
+#define BLOCKSIZE (16 * 1024)
+
+
+typedef struct {
+  uint8_t filter;
+  uint8_t filter_meta;
+} test_filter;
+
+CUTEST_TEST_DATA(decompress_range) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(decompress_range) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(filter, test_filter, CUTEST_DATA(
+      {BLOSC_NOFILTER, 0},
+      {BLOSC_SHUFFLE, 0},
+      {BLOSC_DELTA, BLOSC_DELTA_DREF},
+      {BLOSC_DELTA, BLOSC_DELTA_ELEMENTS},
+  ));
+  CUTEST_PARAMETRIZE(clevel, int, CUTEST_DATA(0, 5));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 4));
+}
+
+
+CUTEST_TEST_TEST(decompress_range) {
+  CUTEST_GET_PARAMETER(filter, test_filter);
+  CUTEST_GET_PARAMETER(clevel, int);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  int32_t nbytes = CHUNKITEMS * sizeof(int32_t);
+  int32_t *src = malloc(nbytes);
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    src[i] = i * 3 + (i % 7);
+  }
+  blosc2_cparams cparams = data->cparams;
+  cparams.clevel = clevel;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = (int16_t) nthreads;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter.filter;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 1] = filter.filter_meta;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(cctx, src, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", cbytes > 0);
+  blosc2_free_ctx(cctx);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int32_t *dest = malloc(nbytes + sizeof(int32_t));
+  int32_t blockitems = BLOCKSIZE / sizeof(int32_t);
+  // Ranges within a block, across a few, aligned to the blocks or not, up to the end and the whole chunk
+  int32_t ranges[][2] = {
+      {5, 10}, {blockitems - 3, 6}, {blockitems - 3, 2 * blockitems + 6}, {blockitems, 3 * blockitems},
+      {0, 2 * blockitems + 1}, {7, 5 * blockitems}, {CHUNKITEMS - 3 * blockitems - 11, 3 * blockitems + 11},
+      {0, CHUNKITEMS}, {100, 0},
+  };
+  for (int i = 0; i < (int) ARRAY_SIZE(ranges); i++) {
+    int32_t start = ranges[i][0];
+    int32_t nitems = ranges[i][1];
+    dest[nitems] = -1;
+    int rc = blosc2_decompress_range_ctx(dctx, chunk, cbytes, start, nitems, dest, nbytes);
+    CUTEST_ASSERT("Cannot decompress the range", rc == nitems * (int) sizeof(int32_t));
+    CUTEST_ASSERT("Wrong items", memcmp(dest, src + start, nitems * sizeof(int32_t)) == 0);
+    CUTEST_ASSERT("Past the range is written", dest[nitems] == -1);
+
+    // A getitem spanning several blocks goes to the threads too
+    memset(dest, 0, nitems * sizeof(int32_t));
+    rc = blosc2_getitem_ctx(dctx, chunk, cbytes, start, nitems, dest, nbytes);
+    CUTEST_ASSERT("Cannot get the items", rc == nitems * (int) sizeof(int32_t));
+    CUTEST_ASSERT("Wrong items got", memcmp(dest, src + start, nitems * sizeof(int32_t)) == 0);
+    CUTEST_ASSERT("Past the items is written", dest[nitems] == -1);
+  }
+
+  // A maskout of the user is still there for the next decompression
+  int32_t nblocks = (nbytes + BLOCKSIZE - 1) / BLOCKSIZE;
+  bool *maskout = malloc(nblocks);
+  for (int32_t i = 0; i < nblocks; i++) {
+    maskout[i] = i % 2 == 1;
+  }
+  CUTEST_ASSERT("Cannot set the maskout", blosc2_set_maskout(dctx, maskout, nblocks) == 0);
+  CUTEST_ASSERT("Cannot decompress the range",
+                blosc2_decompress_range_ctx(dctx, chunk, cbytes, 11, 4 * blockitems, dest, nbytes) > 0);
+  CUTEST_ASSERT("Wrong items", memcmp(dest, src + 11, 4 * blockitems * sizeof(int32_t)) == 0);
+  memset(dest, 0, nbytes);
+  CUTEST_ASSERT("Cannot decompress", blosc2_decompress_ctx(dctx, chunk, cbytes, dest, nbytes) == nbytes);
+  CUTEST_ASSERT("Wrong block", memcmp(dest, src, BLOCKSIZE) == 0);
+  CUTEST_ASSERT("The maskout is not used", dest[blockitems] == 0);
+  free(maskout);
+
+  // Ranges out of the chunk or of dest
+  CUTEST_ASSERT("A range past the end is taken",
+                blosc2_decompress_range_ctx(dctx, chunk, cbytes, CHUNKITEMS - 2, 3, dest, nbytes) ==
+                BLOSC2_ERROR_INVALID_PARAM);
+  CUTEST_ASSERT("A negative range is taken",
+                blosc2_decompress_range_ctx(dctx, chunk, cbytes, -1, 3, dest, nbytes) == BLOSC2_ERROR_INVALID_PARAM);
+  CUTEST_ASSERT("A small dest is taken",
+                blosc2_decompress_range_ctx(dctx, chunk, cbytes, 0, 4 * blockitems, dest, BLOCKSIZE) ==
+                BLOSC2_ERROR_WRITE_BUFFER);
+
+  blosc2_free_ctx(dctx);
+  free(dest);
+  free(chunk);
+  free(src);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(decompress_range) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(decompress_range);
+}
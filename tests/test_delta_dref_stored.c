@@ -0,0 +1,145 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the delta filter with the reference block stored in the chunk
+  (BLOSC_DELTA_DREF_STORED), and for getting items out of delta chunks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NITEMS (100 * 1000)
+#define NCHUNKS 3
+#define URLPATH "test_delta_dref_stored.b2frame"
+
+
+CUTEST_TEST_DATA(delta_dref_stored) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(delta_dref_stored) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+
+  CUTEST_PARAMETRIZE(mode, uint8_t, CUTEST_DATA(BLOSC_DELTA_DREF, BLOSC_DELTA_DREF_STORED));
+  CUTEST_PARAMETRIZE(typesize, int32_t, CUTEST_DATA(4, 8, 3));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 4));
+  CUTEST_PARAMETRIZE(shuffle, uint8_t, CUTEST_DATA(BLOSC_NOSHUFFLE, BLOSC_SHUFFLE));
+}
+
+
+static void fill_buffer(uint8_t *buffer, int32_t typesize, int64_t nchunk) {
+  for (int32_t i = 0; i < NITEMS; i++) {
+    int64_t value = nchunk * NITEMS + i * 3 + (i % 7);
+    memcpy(buffer + i * typesize, &value, typesize);
+  }
+}
+
+
+CUTEST_TEST_TEST(delta_dref_stored) {
+  CUTEST_GET_PARAMETER(mode, uint8_t);
+  CUTEST_GET_PARAMETER(typesize, int32_t);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+  CUTEST_GET_PARAMETER(shuffle, uint8_t);
+
+  int32_t nbytes = NITEMS * typesize;
+  uint8_t *src = malloc(nbytes);
+  uint8_t *dest = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  fill_buffer(src, typesize, 0);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.typesize = typesize;
+  cparams.nthreads = nthreads;
+  cparams.blocksize = 16 * 1024;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = shuffle;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_DELTA;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 2] = mode;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  CUTEST_ASSERT("Cannot create the contexts", cctx != NULL && dctx != NULL);
+
+  int cbytes = blosc2_compress_ctx(cctx, src, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", cbytes > 0);
+  if (mode == BLOSC_DELTA_DREF_STORED) {
+    CUTEST_ASSERT("The reference block is not in the chunk", cbytes > cparams.blocksize);
+  }
+  CUTEST_ASSERT("Cannot decompress", blosc2_decompress_ctx(dctx, chunk, cbytes, dest, nbytes) == nbytes);
+  CUTEST_ASSERT("Wrong decompressed data", memcmp(src, dest, nbytes) == 0);
+
+  // The items of every block, and across blocks
+  int32_t blockitems = cparams.blocksize / typesize;
+  int starts[] = {0, 3, blockitems - 2, blockitems + 5, 3 * blockitems - 1, NITEMS - 10};
+  for (int i = 0; i < (int)(sizeof(starts) / sizeof(int)); i++) {
+    memset(dest, 0, 10 * typesize);
+    int rc = blosc2_getitem_ctx(dctx, chunk, cbytes, starts[i], 10, dest, nbytes);
+    CUTEST_ASSERT("Cannot get the items", rc == 10 * typesize);
+    CUTEST_ASSERT("Wrong items", memcmp(src + starts[i] * typesize, dest, rc) == 0);
+  }
+  // Also with the (serial) global context
+  int rc = blosc2_getitem(chunk, cbytes, 2 * blockitems + 1, 10, dest, nbytes);
+  CUTEST_ASSERT("Cannot get the items", rc == 10 * typesize);
+  CUTEST_ASSERT("Wrong items", memcmp(src + (2 * blockitems + 1) * typesize, dest, rc) == 0);
+
+  // Chunks that are too small for the reference block are stored as is
+  cbytes = blosc2_compress_ctx(cctx, src, nbytes, chunk, nbytes / 2);
+  CUTEST_ASSERT("Cannot compress into a small buffer", cbytes >= 0);
+
+  // The chunks of a frame on disk are read lazily
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=URLPATH, .contiguous=true};
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_buffer(src, typesize, nchunk);
+    CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_buffer(schunk, src, nbytes) == nchunk + 1);
+  }
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_buffer(src, typesize, nchunk);
+    CUTEST_ASSERT("Cannot decompress the chunk",
+                  blosc2_schunk_decompress_chunk(schunk, nchunk, dest, nbytes) == nbytes);
+    CUTEST_ASSERT("Wrong chunk", memcmp(src, dest, nbytes) == 0);
+  }
+  int64_t start = NITEMS + blockitems + 7;
+  CUTEST_ASSERT("Cannot get the items", blosc2_schunk_get_slice_buffer(schunk, start, start + 10, dest) == 0);
+  fill_buffer(src, typesize, 1);
+  CUTEST_ASSERT("Wrong items of the super-chunk", memcmp(src + (blockitems + 7) * typesize, dest, 10 * typesize) == 0);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  // The reference block cannot go along with dictionaries
+  cparams.use_dict = 1;
+  blosc2_context *dict_cctx = blosc2_create_cctx(cparams);
+  CUTEST_ASSERT("Dictionaries are accepted", (dict_cctx == NULL) == (mode == BLOSC_DELTA_DREF_STORED));
+  if (dict_cctx != NULL) {
+    blosc2_free_ctx(dict_cctx);
+  }
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  free(src);
+  free(dest);
+  free(chunk);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(delta_dref_stored) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(delta_dref_stored);
+}
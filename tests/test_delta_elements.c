@@ -0,0 +1,202 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the BLOSC_DELTA_ELEMENTS mode of the delta filter.  The chunks have
+  to be the same as the ones of a plain scalar filter in its place, whatever
+  the (vector or fused) code that is used for the delta.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NELEMS (40 * 1000)
+#define SCALAR_FILTER 250
+
+
+typedef struct {
+  int32_t typesize;
+  int32_t blocksize;
+  int16_t nthreads;
+  uint8_t shuffle;
+} test_delta_backend;
+
+CUTEST_TEST_DATA(delta_elements) {
+  uint8_t *src;
+  uint8_t *chunk;
+  uint8_t *ref_chunk;
+  uint8_t *dest;
+};
+
+
+/* The units of the delta, as in delta.c */
+static int32_t delta_unit(int32_t typesize) {
+  if (typesize == 1 || typesize == 2 || typesize == 4 || typesize == 8) {
+    return typesize;
+  }
+  return (typesize % 8) == 0 ? 8 : 1;
+}
+
+static uint64_t load_unit(const uint8_t *p, int32_t unit) {
+  uint64_t value = 0;
+  memcpy(&value, p, unit);
+  return value;
+}
+
+static void store_unit(uint8_t *p, uint64_t value, int32_t unit) {
+  memcpy(p, &value, unit);
+}
+
+static int scalar_forward(const uint8_t *src, uint8_t *dest, int32_t size, uint8_t meta,
+                          blosc2_cparams *cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(id);
+  BLOSC_UNUSED_PARAM(meta);
+  int32_t typesize = cparams->typesize;
+  int32_t unit = delta_unit(typesize);
+  memcpy(dest, src, size);
+  for (int32_t i = typesize; i + unit <= size; i += unit) {
+    store_unit(dest + i, load_unit(src + i, unit) - load_unit(src + i - typesize, unit), unit);
+  }
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+/* The chunks of the scalar filter are never decompressed */
+static int scalar_backward(const uint8_t *src, uint8_t *dest, int32_t size, uint8_t meta,
+                           blosc2_dparams *dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(src);
+  BLOSC_UNUSED_PARAM(dest);
+  BLOSC_UNUSED_PARAM(size);
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(id);
+  return BLOSC2_ERROR_FAILURE;
+}
+
+
+CUTEST_TEST_SETUP(delta_elements) {
+  blosc2_init();
+  blosc2_filter urfilter = {0};
+  urfilter.id = SCALAR_FILTER;
+  urfilter.name = "scalar_delta";
+  urfilter.version = 1;
+  urfilter.forward = scalar_forward;
+  urfilter.backward = scalar_backward;
+  blosc2_register_filter(&urfilter);
+
+  int32_t nbytes = NELEMS * 24;
+  data->src = malloc(nbytes);
+  data->chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  data->ref_chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(nbytes);
+
+  CUTEST_PARAMETRIZE(backend, test_delta_backend, CUTEST_DATA(
+      {8, 0, 1, BLOSC_SHUFFLE},
+      {8, 0, 4, BLOSC_SHUFFLE},
+      {8, 10 * 1000, 1, BLOSC_SHUFFLE},  // blocks that are not a multiple of the tiles
+      {8, 0, 1, BLOSC_NOSHUFFLE},
+      {4, 0, 4, BLOSC_SHUFFLE},
+      {4, 0, 1, BLOSC_NOSHUFFLE},
+      {2, 0, 1, BLOSC_SHUFFLE},
+      {1, 0, 1, BLOSC_NOSHUFFLE},
+      {3, 0, 2, BLOSC_SHUFFLE},
+      {16, 0, 1, BLOSC_SHUFFLE},
+      {24, 0, 1, BLOSC_NOSHUFFLE},
+      {12, 0, 1, BLOSC_SHUFFLE},
+  ));
+}
+
+
+static int compress(test_delta_backend backend, uint8_t filter, uint8_t meta, int16_t nthreads,
+                    const uint8_t *src, int32_t nbytes, uint8_t *dest) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = backend.typesize;
+  cparams.blocksize = backend.blocksize;
+  cparams.nthreads = nthreads;
+  cparams.compcode = BLOSC_LZ4;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = filter;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 2] = meta;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = backend.shuffle;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  if (cctx == NULL) {
+    return BLOSC2_ERROR_NULL_POINTER;
+  }
+  int csize = blosc2_compress_ctx(cctx, src, nbytes, dest, nbytes + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  return csize;
+}
+
+
+CUTEST_TEST_TEST(delta_elements) {
+  CUTEST_GET_PARAMETER(backend, test_delta_backend);
+
+  // Timestamps with some jitter (the bytes beyond the first 8 ones are constant)
+  int32_t typesize = backend.typesize;
+  int32_t nbytes = NELEMS * typesize;
+  for (int i = 0; i < NELEMS; i++) {
+    uint64_t timestamp = 1600000000000ULL + (uint64_t)i * 1000 + (i * 7) % 13;
+    memset(data->src + i * typesize, 0x5a, typesize);
+    memcpy(data->src + i * typesize, &timestamp, typesize < 8 ? typesize : 8);
+  }
+
+  // Threads store the blocks in the order they finish, so compare the chunks of a single one
+  int csize = compress(backend, BLOSC_DELTA, BLOSC_DELTA_ELEMENTS, 1, data->src, nbytes, data->chunk);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  int ref_csize = compress(backend, SCALAR_FILTER, 0, 1, data->src, nbytes, data->ref_chunk);
+  CUTEST_ASSERT("Compression error", ref_csize > 0);
+  CUTEST_ASSERT("The delta gives a different chunk", csize == ref_csize);
+  CUTEST_ASSERT("The delta gives a different chunk",
+                memcmp(data->chunk + BLOSC_EXTENDED_HEADER_LENGTH, data->ref_chunk + BLOSC_EXTENDED_HEADER_LENGTH,
+                       csize - BLOSC_EXTENDED_HEADER_LENGTH) == 0);
+
+  if (typesize == 8 && backend.shuffle == BLOSC_SHUFFLE) {
+    int dref_csize = compress(backend, BLOSC_DELTA, BLOSC_DELTA_DREF, 1, data->src, nbytes, data->dest);
+    CUTEST_ASSERT("Compression error", dref_csize > 0);
+    CUTEST_ASSERT("Timestamps should compress better with the delta of the elements", csize < dref_csize);
+  }
+
+  // The chunks compressed with threads too
+  csize = compress(backend, BLOSC_DELTA, BLOSC_DELTA_ELEMENTS, backend.nthreads, data->src, nbytes, data->chunk);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = backend.nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, nbytes);
+  blosc2_free_ctx(dctx);
+  CUTEST_ASSERT("Decompression error", dsize == nbytes);
+  CUTEST_ASSERT("Decompressed data differs", memcmp(data->dest, data->src, nbytes) == 0);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(delta_elements) {
+  free(data->src);
+  free(data->chunk);
+  free(data->ref_chunk);
+  free(data->dest);
+  blosc2_destroy();
+}
+
+
+static int test_unknown_mode(void) {
+  blosc2_init();
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_DELTA;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 2] = BLOSC_DELTA_DREF_STORED + 1;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_destroy();
+  if (cctx != NULL) {
+    printf("Contexts with an unknown delta mode should be refused\n");
+    return 1;
+  }
+  return 0;
+}
+
+
+int main() {
+  if (test_unknown_mode() != 0) {
+    return 1;
+  }
+  CUTEST_TEST_RUN(delta_elements);
+}
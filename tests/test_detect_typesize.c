@@ -0,0 +1,179 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for guessing the stride of the shuffle of the chunks with a typesize of 1.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+#include "blosc2/filters-registry.h"
+
+#define CHUNKSIZE (256 * 1024)
+#define BLOCKSIZE (32 * 1024)
+
+enum {
+  DATA_FLOAT32,
+  DATA_INT64,
+  DATA_STRUCT12,
+  DATA_RANDOM,
+};
+
+typedef struct {
+  int kind;
+  int stride;  // the stride expected in the header (0 for no shuffle)
+} test_data;
+
+CUTEST_TEST_DATA(detect_typesize) {
+  uint8_t *src;
+  uint8_t *dest;
+  uint8_t *chunk;
+};
+
+
+CUTEST_TEST_SETUP(detect_typesize) {
+  blosc2_init();
+  data->src = malloc(CHUNKSIZE);
+  data->dest = malloc(CHUNKSIZE);
+  data->chunk = malloc(CHUNKSIZE + BLOSC2_MAX_OVERHEAD);
+
+  CUTEST_PARAMETRIZE(tdata, test_data, CUTEST_DATA(
+      {DATA_FLOAT32, 4},
+      {DATA_INT64, 8},
+      {DATA_STRUCT12, 12},
+      {DATA_RANDOM, 0},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 4));
+}
+
+
+static void fill_data(uint8_t *buffer, int kind) {
+  uint32_t seed = 1234567;
+  switch (kind) {
+    case DATA_FLOAT32:
+      for (int32_t i = 0; i < CHUNKSIZE / 4; i++) {
+        float value = 100.f * sinf((float) i / 1000.f) + (float) i / 7.f;
+        memcpy(buffer + i * 4, &value, 4);
+      }
+      break;
+    case DATA_INT64:
+      for (int32_t i = 0; i < CHUNKSIZE / 8; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int64_t value = (int64_t) i * 1000 + (seed >> 20);
+        memcpy(buffer + i * 8, &value, 8);
+      }
+      break;
+    case DATA_STRUCT12:
+      memset(buffer, 0, CHUNKSIZE);
+      for (int32_t i = 0; i < CHUNKSIZE / 12; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int32_t id = i;
+        float x = (float) (seed >> 8) / 16777216.f;
+        uint8_t flags[4] = {(uint8_t) (i % 3), 0xAB, (uint8_t) (seed >> 28), 0};
+        memcpy(buffer + i * 12, &id, 4);
+        memcpy(buffer + i * 12 + 4, &x, 4);
+        memcpy(buffer + i * 12 + 8, flags, 4);
+      }
+      break;
+    default:
+      for (int32_t i = 0; i < CHUNKSIZE; i++) {
+        seed = seed * 1103515245u + 12345u;
+        buffer[i] = (uint8_t) (seed >> 24);
+      }
+  }
+}
+
+
+CUTEST_TEST_TEST(detect_typesize) {
+  CUTEST_GET_PARAMETER(tdata, test_data);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  fill_data(data->src, tdata.kind);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 1;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = (int16_t) nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+
+  // Without the detection, the shuffle of the bytes does nothing
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int plain_cbytes = blosc2_compress_ctx(cctx, data->src, CHUNKSIZE, data->chunk, CHUNKSIZE + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", plain_cbytes > 0);
+  CUTEST_ASSERT("The stride is guessed without detect_typesize",
+                data->chunk[BLOSC2_CHUNK_FILTER_CODES + BLOSC2_MAX_FILTERS - 1] == BLOSC_SHUFFLE);
+  blosc2_free_ctx(cctx);
+
+  cparams.detect_typesize = true;
+  cctx = blosc2_create_cctx(cparams);
+  blosc2_cparams cparams2;
+  blosc2_ctx_get_cparams(cctx, &cparams2);
+  CUTEST_ASSERT("detect_typesize is not kept", cparams2.detect_typesize);
+  int cbytes = blosc2_compress_ctx(cctx, data->src, CHUNKSIZE, data->chunk, CHUNKSIZE + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", cbytes > 0);
+  blosc2_free_ctx(cctx);
+
+  uint8_t code = data->chunk[BLOSC2_CHUNK_FILTER_CODES + BLOSC2_MAX_FILTERS - 1];
+  uint8_t meta = data->chunk[BLOSC2_CHUNK_FILTER_META + BLOSC2_MAX_FILTERS - 1];
+  if (tdata.stride > 0) {
+    CUTEST_ASSERT("The stride is not guessed", code == BLOSC_FILTER_SHUFFLE_STRIDE);
+    CUTEST_ASSERT("Wrong stride", meta == tdata.stride);
+    CUTEST_ASSERT("The guessed stride does not pay off", cbytes < plain_cbytes);
+  }
+  else {
+    CUTEST_ASSERT("A stride is guessed for random bytes", code == BLOSC_SHUFFLE);
+  }
+  CUTEST_ASSERT("The typesize of the chunk changed", data->chunk[BLOSC2_CHUNK_TYPESIZE] == 1);
+
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, cbytes, data->dest, CHUNKSIZE);
+  CUTEST_ASSERT("Cannot decompress", dsize == CHUNKSIZE);
+  CUTEST_ASSERT("Wrong values", memcmp(data->src, data->dest, CHUNKSIZE) == 0);
+
+  // The items of the chunk are still bytes
+  uint8_t items[100];
+  int start = BLOCKSIZE - 37;
+  CUTEST_ASSERT("Cannot get the items",
+                blosc2_getitem_ctx(dctx, data->chunk, cbytes, start, 100, items, sizeof(items)) == 100);
+  CUTEST_ASSERT("Wrong items", memcmp(items, data->src + start, 100) == 0);
+  blosc2_free_ctx(dctx);
+
+  // The shuffle with an explicit stride
+  cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 1;
+  cparams.nthreads = (int16_t) nthreads;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_FILTER_SHUFFLE_STRIDE;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 1] = 4;
+  cctx = blosc2_create_cctx(cparams);
+  cbytes = blosc2_compress_ctx(cctx, data->src, CHUNKSIZE - 3, data->chunk, CHUNKSIZE + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress with an explicit stride", cbytes > 0);
+  blosc2_free_ctx(cctx);
+  CUTEST_ASSERT("Cannot decompress",
+                blosc2_decompress(data->chunk, cbytes, data->dest, CHUNKSIZE) == CHUNKSIZE - 3);
+  CUTEST_ASSERT("Wrong values", memcmp(data->src, data->dest, CHUNKSIZE - 3) == 0);
+
+  // A stride of 0 makes no sense
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 1] = 0;
+  cctx = blosc2_create_cctx(cparams);
+  CUTEST_ASSERT("Cannot create the context", cctx != NULL);
+  cbytes = blosc2_compress_ctx(cctx, data->src, CHUNKSIZE, data->chunk, CHUNKSIZE + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("A stride of 0 is accepted", cbytes < 0);
+  blosc2_free_ctx(cctx);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(detect_typesize) {
+  free(data->src);
+  free(data->dest);
+  free(data->chunk);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(detect_typesize);
+}
@@ -15,6 +15,8 @@
 int tests_run = 0;
 int blocksize;
 int use_dict;
+int compcode;
+float cratio_nodict;
 
 static char* test_dict(void) {
   static int32_t data[CHUNKSIZE];
@@ -34,7 +36,7 @@ static char* test_dict(void) {
 
   /* Create a super-chunk container */
   cparams.typesize = sizeof(int32_t);
-  cparams.compcode = BLOSC_ZSTD;
+  cparams.compcode = (uint8_t)compcode;
   cparams.use_dict = use_dict;
   cparams.clevel = 5;
   cparams.nthreads = NTHREADS;
@@ -71,12 +73,29 @@ static char* test_dict(void) {
   float cspeed = (float)nbytes / ((float)cttotal * MB);
   float dspeed = (float)nbytes / ((float)dttotal * MB);
   if (tests_run == 0) printf("\n");
+  const char* compname;
+  blosc2_compcode_to_compname(compcode, &compname);
+  printf("[%s] ", compname);
   if (blocksize > 0) {
     printf("[blocksize: %d KB] ", blocksize / 1024);
   } else {
     printf("[blocksize: automatic] ");
   }
-  if (!use_dict) {
+  if (compcode != BLOSC_ZSTD) {
+    printf("cratio %s dict: %.1fx (compr @ %.1f MB/s, decompr @ %.1f MB/s)\n",
+           use_dict ? "with" : "w/o", cratio, cspeed, dspeed);
+    if (!use_dict) {
+      cratio_nodict = cratio;
+    }
+    else if (blocksize > 0 && blocksize <= 32 * KB) {
+      // Small blocks are where dicts help (blocks are not split with dicts)
+      mu_assert("ERROR: Dict does not improve the compression ratio", cratio > 1.2 * cratio_nodict);
+    }
+    else {
+      mu_assert("ERROR: Dict harms the compression ratio too much", cratio > 0.9 * cratio_nodict);
+    }
+  }
+  else if (!use_dict) {
     printf("cratio w/o dict: %.1fx (compr @ %.1f MB/s, decompr @ %.1f MB/s)\n",
             cratio, cspeed, dspeed);
     switch (blocksize) {
@@ -185,8 +204,13 @@ int main(void) {
 
   blosc2_init();
 
-  /* Run all the suite */
-  result = all_tests();
+  /* Run all the suite for the codecs supporting dicts */
+  int compcodes[] = {BLOSC_ZSTD, BLOSC_LZ4, BLOSC_BLOSCLZ};
+  result = EXIT_SUCCESS;
+  for (int i = 0; i < 3 && result == EXIT_SUCCESS; i++) {
+    compcode = compcodes[i];
+    result = all_tests();
+  }
   if (result != EXIT_SUCCESS) {
     printf(" (%s)\n", result);
   }
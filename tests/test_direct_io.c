@@ -0,0 +1,146 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the direct io (BLOSC2_IO_FILESYSTEM_DIRECT).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (20 * 1000)
+#define NCHUNKS 20
+#define NCHUNKS_APPEND 5
+
+
+typedef struct {
+  int64_t buffer_size;
+} test_direct_io_backend;
+
+CUTEST_TEST_DATA(direct_io) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(direct_io) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.clevel = 5;
+
+  CUTEST_PARAMETRIZE(backend, test_direct_io_backend, CUTEST_DATA(
+      {8 * 1024},  // smaller than a chunk, so most of the frame goes to the file while appending
+      {BLOSC2_STDIO_DIRECT_DEFAULTS.buffer_size},  // the whole frame in the buffer
+  ));
+}
+
+
+/* Poorly compressible data, so that chunks are larger than the smaller buffer */
+static int fill_chunk(int32_t *buffer, int nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = (int32_t) ((uint32_t) (nchunk * CHUNKSIZE + j) * 2654435761U);
+  }
+  return 0;
+}
+
+static int check_chunks(blosc2_schunk *schunk, int nchunks, int updated) {
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  int32_t *rec_buffer = malloc(nbytes);
+  int rc = 0;
+  for (int i = 0; i < nchunks && rc == 0; ++i) {
+    int32_t dbytes = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes);
+    fill_chunk(data_buffer, i == updated ? -1 : i);
+    if (dbytes != nbytes || memcmp(data_buffer, rec_buffer, nbytes) != 0) {
+      rc = -1;
+    }
+  }
+  free(data_buffer);
+  free(rec_buffer);
+  return rc;
+}
+
+
+CUTEST_TEST_TEST(direct_io) {
+  CUTEST_GET_PARAMETER(backend, test_direct_io_backend);
+
+  char *urlpath = "test_direct_io.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_stdio_direct direct = BLOSC2_STDIO_DIRECT_DEFAULTS;
+  direct.buffer_size = backend.buffer_size;
+  blosc2_io io = {.id = BLOSC2_IO_FILESYSTEM_DIRECT, .name = "filesystem_direct", .params = &direct};
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true, .urlpath=urlpath, .io=&io};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; ++i) {
+    fill_chunk(data_buffer, i);
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, nbytes);
+    CUTEST_ASSERT("Error during compression", nchunks == i + 1);
+  }
+  CUTEST_ASSERT("Cannot add a vlmetalayer", blosc2_vlmeta_add(schunk, "vlmeta", (uint8_t *) "content", 7, NULL) >= 0);
+
+  /* Update a chunk in the middle of the frame (which is in the file for the small buffer) */
+  int updated = 2;
+  fill_chunk(data_buffer, -1);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, data_buffer, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Error compressing a chunk", cbytes > 0);
+  CUTEST_ASSERT("Error updating a chunk", blosc2_schunk_update_chunk(schunk, updated, chunk, true) == NCHUNKS);
+  free(chunk);
+  CUTEST_ASSERT("Data are not equal", check_chunks(schunk, NCHUNKS, updated) == 0);
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Error flushing the frame", blosc2_stdio_direct_destroy(&direct) == 0);
+
+  /* The file is a regular frame now */
+  schunk = blosc2_schunk_open(urlpath);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS);
+  CUTEST_ASSERT("Data are not equal", check_chunks(schunk, NCHUNKS, updated) == 0);
+  uint8_t *content;
+  int32_t content_len;
+  CUTEST_ASSERT("Cannot get the vlmetalayer", blosc2_vlmeta_get(schunk, "vlmeta", &content, &content_len) >= 0);
+  CUTEST_ASSERT("Wrong vlmetalayer", content_len == 7 && memcmp(content, "content", 7) == 0);
+  free(content);
+  blosc2_schunk_free(schunk);
+
+  /* Append some more chunks to the existing file */
+  blosc2_stdio_direct direct_append = BLOSC2_STDIO_DIRECT_DEFAULTS;
+  direct_append.buffer_size = backend.buffer_size;
+  io.params = &direct_append;
+  schunk = blosc2_schunk_open_udio(urlpath, &io);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  for (int i = NCHUNKS; i < NCHUNKS + NCHUNKS_APPEND; ++i) {
+    fill_chunk(data_buffer, i);
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, nbytes);
+    CUTEST_ASSERT("Error during compression", nchunks == i + 1);
+  }
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Error flushing the frame", blosc2_stdio_direct_destroy(&direct_append) == 0);
+
+  schunk = blosc2_schunk_open(urlpath);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS + NCHUNKS_APPEND);
+  CUTEST_ASSERT("Data are not equal", check_chunks(schunk, NCHUNKS + NCHUNKS_APPEND, updated) == 0);
+  blosc2_schunk_free(schunk);
+
+  blosc2_remove_urlpath(urlpath);
+  free(data_buffer);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(direct_io) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(direct_io);
+}
@@ -0,0 +1,206 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the durability levels of the writes to contiguous frames on disk.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 1000
+#define NAPPENDS 10
+#define URLPATH "test_durability.b2frame"
+
+
+typedef struct {
+  int32_t sync;
+} test_sync_params;
+
+
+typedef struct {
+  blosc2_stdio_file *bfile;
+  test_sync_params *params;
+} test_file;
+
+
+static void* test_open(const char *urlpath, const char *mode, void *params) {
+  blosc2_stdio_file *bfile = blosc2_stdio_open(urlpath, mode, NULL);
+  if (bfile == NULL) {
+    return NULL;
+  }
+  test_file *my = malloc(sizeof(test_file));
+  my->bfile = bfile;
+  my->params = params;
+  return my;
+}
+
+static int test_close(void *stream) {
+  test_file *my = (test_file *) stream;
+  int err = blosc2_stdio_close(my->bfile);
+  free(my);
+  return err;
+}
+
+static int64_t test_tell(void *stream) {
+  return blosc2_stdio_tell(((test_file *) stream)->bfile);
+}
+
+static int test_seek(void *stream, int64_t offset, int whence) {
+  return blosc2_stdio_seek(((test_file *) stream)->bfile, offset, whence);
+}
+
+static int64_t test_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  return blosc2_stdio_write(ptr, size, nitems, ((test_file *) stream)->bfile);
+}
+
+static int64_t test_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  return blosc2_stdio_read(ptr, size, nitems, ((test_file *) stream)->bfile);
+}
+
+static int test_truncate(void *stream, int64_t size) {
+  return blosc2_stdio_truncate(((test_file *) stream)->bfile, size);
+}
+
+static int test_sync(void *stream) {
+  test_file *my = (test_file *) stream;
+  my->params->sync++;
+  return blosc2_stdio_sync(my->bfile);
+}
+
+
+typedef struct {
+  int durability;
+  int32_t sync_nappends;
+  int32_t sync_ms;
+  int32_t nsyncs;  // for the appends, an update and the free
+} test_durability_level;
+
+CUTEST_TEST_DATA(durability) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(durability) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  blosc2_io_cb io_cb = {0};
+  io_cb.id = 246;
+  io_cb.name = "test_sync";
+  io_cb.open = (blosc2_open_cb) test_open;
+  io_cb.close = (blosc2_close_cb) test_close;
+  io_cb.read = (blosc2_read_cb) test_read;
+  io_cb.tell = (blosc2_tell_cb) test_tell;
+  io_cb.seek = (blosc2_seek_cb) test_seek;
+  io_cb.write = (blosc2_write_cb) test_write;
+  io_cb.truncate = (blosc2_truncate_cb) test_truncate;
+  blosc2_register_io_cb(&io_cb);
+  // The same io, able to sync
+  io_cb.id = 247;
+  blosc2_register_io_cb(&io_cb);
+  blosc2_io_cb_ext io_cb_ext = {0};
+  io_cb_ext.sync = (blosc2_sync_cb) test_sync;
+  blosc2_register_io_cb_ext(io_cb.id, &io_cb_ext);
+
+  CUTEST_PARAMETRIZE(level, test_durability_level, CUTEST_DATA(
+      {BLOSC2_DURABILITY_NONE, 0, 0, 0},
+      {BLOSC2_DURABILITY_CLOSE, 0, 0, 1},
+      {BLOSC2_DURABILITY_GROUP, 4, 0, 7},  // two groups, the rest before the update, and the free
+      {BLOSC2_DURABILITY_GROUP, 0, 3600 * 1000, 3},  // the appends before the update, and the free
+      {BLOSC2_DURABILITY_WRITE, 0, 0, 1 + 2 * NAPPENDS + 2},  // the creation too
+  ));
+}
+
+
+static int check_chunks(blosc2_schunk *schunk, int64_t nchunks) {
+  int32_t buffer[CHUNKSIZE];
+  int errors = schunk->nchunks != nchunks;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, sizeof(buffer));
+    int32_t first = nchunk == 0 ? -1 : (int32_t) (nchunk * CHUNKSIZE);
+    if (dsize != (int) sizeof(buffer) || buffer[0] != first ||
+        buffer[CHUNKSIZE - 1] != nchunk * CHUNKSIZE + CHUNKSIZE - 1) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(durability) {
+  CUTEST_GET_PARAMETER(level, test_durability_level);
+
+  blosc2_cparams cparams = data->cparams;
+  test_sync_params sync_params = {0};
+  blosc2_io io = {.id = 246, .params = &sync_params};
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true, .urlpath=URLPATH, .io=&io,
+                            .durability=level.durability, .sync_nappends=level.sync_nappends,
+                            .sync_ms=level.sync_ms};
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  if (level.durability != BLOSC2_DURABILITY_NONE) {
+    CUTEST_ASSERT("Ios that cannot sync are accepted", schunk == NULL);
+    io.id = 247;
+    schunk = blosc2_schunk_new(&storage);
+  }
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int32_t buffer[CHUNKSIZE];
+  for (int64_t nchunk = 0; nchunk < NAPPENDS; nchunk++) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      buffer[i] = (int32_t) (nchunk * CHUNKSIZE + i);
+    }
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, sizeof(buffer)) == nchunk + 1);
+    if (nchunk == 5) {
+      // The frame on disk is always a valid one, with the appends synced so far
+      blosc2_schunk *other = blosc2_schunk_open_udio(URLPATH, &io);
+      CUTEST_ASSERT("Cannot open the frame during the appends", other != NULL);
+      int64_t nsynced = level.sync_nappends > 0 ? 4 : level.sync_ms > 0 ? 0 : 6;
+      if (level.durability >= BLOSC2_DURABILITY_GROUP) {
+        CUTEST_ASSERT("Wrong appends on disk", other->nchunks == nsynced);
+      }
+      blosc2_schunk_free(other);
+    }
+  }
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    buffer[i] = i;
+  }
+  buffer[0] = -1;
+  uint8_t chunk[sizeof(buffer) + BLOSC2_MAX_OVERHEAD];
+  int cbytes = blosc2_compress_ctx(schunk->cctx, buffer, sizeof(buffer), chunk, sizeof(chunk));
+  CUTEST_ASSERT("Cannot compress the chunk", cbytes > 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 0, chunk, true) == NAPPENDS);
+  CUTEST_ASSERT("Wrong chunks", check_chunks(schunk, NAPPENDS) == 0);
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Wrong number of syncs", sync_params.sync == level.nsyncs);
+
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong chunks after reopening", check_chunks(schunk, NAPPENDS) == 0);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  // Wrong levels
+  storage.durability = BLOSC2_DURABILITY_WRITE + 1;
+  CUTEST_ASSERT("Unknown levels are accepted", blosc2_schunk_new(&storage) == NULL);
+  storage.durability = BLOSC2_DURABILITY_GROUP;
+  storage.sync_nappends = -1;
+  CUTEST_ASSERT("Negative limits are accepted", blosc2_schunk_new(&storage) == NULL);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(durability) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(durability);
+}
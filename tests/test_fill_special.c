@@ -22,6 +22,7 @@ enum {
   CHECK_ZEROS = 1,
   CHECK_NANS = 2,
   CHECK_UNINIT = 3,
+  CHECK_VALUE = 4,
 };
 
 typedef struct {
@@ -49,6 +50,7 @@ CUTEST_TEST_SETUP(fill_special) {
           CHECK_ZEROS,
           CHECK_NANS,
           CHECK_UNINIT,
+          CHECK_VALUE,
   ));
   CUTEST_PARAMETRIZE(leftover_items, int, CUTEST_DATA(
           0,
@@ -87,6 +89,7 @@ CUTEST_TEST_TEST(fill_special) {
 
   int ret;
   int special_value;
+  float repeatval = 3.5f;
   switch (svalue) {
     case CHECK_ZEROS:
       special_value = BLOSC2_SPECIAL_ZERO;
@@ -100,6 +103,10 @@ CUTEST_TEST_TEST(fill_special) {
       special_value = BLOSC2_SPECIAL_UNINIT;
       ret = blosc2_chunk_uninit(*cparams, isize, data_dest, isize);
       break;
+    case CHECK_VALUE:
+      special_value = BLOSC2_SPECIAL_VALUE;
+      ret = blosc2_chunk_repeatval(*cparams, isize, data_dest, isize, &repeatval) - sizeof(float);
+      break;
     default:
       CUTEST_ASSERT("Unrecognized case", false);
   }
@@ -110,7 +117,13 @@ CUTEST_TEST_TEST(fill_special) {
   // Make nitems a non-divisible number of CHUNKSHAPE
   nitems = (int64_t)NCHUNKS * CHUNKSHAPE + leftover_items;
   int32_t leftover_bytes = (int32_t)(nitems % CHUNKSHAPE) * cparams->typesize;
-  int64_t nchunks = blosc2_schunk_fill_special(schunk, nitems, special_value, isize);
+  int64_t nchunks;
+  if (special_value == BLOSC2_SPECIAL_VALUE) {
+    nchunks = blosc2_schunk_fill_repeatval(schunk, nitems, &repeatval, isize);
+  }
+  else {
+    nchunks = blosc2_schunk_fill_special(schunk, nitems, special_value, isize);
+  }
   if (leftover_items != 0) {
     CUTEST_ASSERT("Error in fill special", nchunks == NCHUNKS + 1);
   }
@@ -139,16 +152,20 @@ CUTEST_TEST_TEST(fill_special) {
     else {
       cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free);
     }
-    CUTEST_ASSERT("Wrong chunk size!", cbytes == BLOSC_EXTENDED_HEADER_LENGTH);
+    CUTEST_ASSERT("Wrong chunk size!",
+                  cbytes == BLOSC_EXTENDED_HEADER_LENGTH + (svalue == CHECK_VALUE ? (int32_t)sizeof(float) : 0));
     dsize = blosc2_getitem_ctx(schunk->dctx, chunk, cbytes, 0, 1, &fvalue, sizeof(float));
     CUTEST_ASSERT("Wrong decompressed item size!", dsize == sizeof(float));
-    switch (special_value) {
+    switch (svalue) {
       case CHECK_ZEROS:
         CUTEST_ASSERT("Wrong value!", fvalue == 0.);
         break;
       case CHECK_NANS:
         CUTEST_ASSERT("Wrong value!", isnan(fvalue));
         break;
+      case CHECK_VALUE:
+        CUTEST_ASSERT("Wrong value!", fvalue == repeatval);
+        break;
       default:
         // We cannot check non initialized values
         break;
@@ -159,6 +176,19 @@ CUTEST_TEST_TEST(fill_special) {
     }
   }
 
+  /* The chunks that share a stored one are updated on their own */
+  if (special_value == BLOSC2_SPECIAL_VALUE) {
+    float newval = -1.f;
+    uint8_t chunk[BLOSC_EXTENDED_HEADER_LENGTH + sizeof(float)];
+    CUTEST_ASSERT("Creation error in special chunk",
+                  blosc2_chunk_repeatval(*cparams, isize, chunk, sizeof(chunk), &newval) == sizeof(chunk));
+    CUTEST_ASSERT("Error updating", blosc2_schunk_update_chunk(schunk, 0, chunk, true) == nchunks);
+    float fvalues[2];
+    CUTEST_ASSERT("Error getting items", blosc2_schunk_get_slice_buffer(schunk, CHUNKSHAPE - 1, CHUNKSHAPE + 1,
+                                                                       fvalues) == 0);
+    CUTEST_ASSERT("Wrong values after updating", fvalues[0] == newval && fvalues[1] == repeatval);
+  }
+
   /* Free resources */
   blosc2_schunk_free(schunk);
   free(data_dest);
@@ -0,0 +1,228 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for finding the items of super-chunks within a range, out of their zone maps.
+*/
+
+#include <math.h>
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (20 * 1000)
+#define NCHUNKS 6
+#define RUN_CHUNK 4
+#define ZEROS_CHUNK 5
+#define BLOCKSIZE (16 * 1024)
+#define URLPATH "test_filter_range.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+typedef struct {
+  int kind;
+  int32_t typesize;
+  double low;
+  double high;
+  int64_t nmatches;
+  int64_t last;  // the last match, for checking the order
+  int errors;
+  int64_t nchunks;  // the chunks with any match
+} test_scan;
+
+CUTEST_TEST_DATA(filter_range) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(filter_range) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(kind, int, CUTEST_DATA(BLOSC2_ZONEMAP_INT, BLOSC2_ZONEMAP_FLOAT));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 3));
+  CUTEST_PARAMETRIZE(postfilter, bool, CUTEST_DATA(false, true));
+}
+
+
+/* The values go up along the super-chunk with some noise, but for a run, a few NaNs and the
+   zeros of a chunk without zone maps */
+static double item_value(int kind, int64_t index) {
+  int64_t nchunk = index / CHUNKITEMS;
+  if (nchunk == RUN_CHUNK) {
+    return 7;
+  }
+  if (nchunk == ZEROS_CHUNK) {
+    return 0;
+  }
+  if (kind == BLOSC2_ZONEMAP_FLOAT && nchunk == 1 && index % 100 == 0) {
+    return nan("");
+  }
+  return (double) (index + index % 3);
+}
+
+static int check_matches(void *user_data, int64_t nchunk, int64_t start, const int32_t *indices,
+                         int32_t nindices) {
+  test_scan *scan = user_data;
+  if (start != nchunk * CHUNKITEMS || nindices <= 0) {
+    scan->errors++;
+  }
+  for (int32_t i = 0; i < nindices; i++) {
+    int64_t index = start + indices[i];
+    double value = item_value(scan->kind, index);
+    if (index <= scan->last || !(value >= scan->low && value <= scan->high)) {
+      scan->errors++;
+    }
+    scan->last = index;
+  }
+  scan->nmatches += nindices;
+  scan->nchunks++;
+  return 0;
+}
+
+static int stop_scan(void *user_data, int64_t nchunk, int64_t start, const int32_t *indices,
+                     int32_t nindices) {
+  BLOSC_UNUSED_PARAM(user_data);
+  BLOSC_UNUSED_PARAM(nchunk);
+  BLOSC_UNUSED_PARAM(start);
+  BLOSC_UNUSED_PARAM(indices);
+  BLOSC_UNUSED_PARAM(nindices);
+  return -42;
+}
+
+static int copy_postfilter(blosc2_postfilter_params *params) {
+  memcpy(params->output, params->input, params->size);
+  return 0;
+}
+
+static blosc2_zonemap_value make_value(int kind, double value) {
+  blosc2_zonemap_value bound;
+  if (kind == BLOSC2_ZONEMAP_INT) {
+    bound.i = (int64_t) value;
+  }
+  else {
+    bound.f = value;
+  }
+  return bound;
+}
+
+/* Scan for [low, high] and check the matches against the ones of a plain scan */
+static int check_scan(blosc2_schunk *schunk, int kind, double low, double high) {
+  test_scan scan = {kind, (int32_t) schunk->typesize, low, high, 0, -1, 0, 0};
+  blosc2_zonemap_value low_ = make_value(kind, low);
+  blosc2_zonemap_value high_ = make_value(kind, high);
+  int64_t nmatches = blosc2_schunk_filter_range(schunk, &low_, &high_, check_matches, &scan);
+  int64_t expected = 0;
+  int64_t nchunks = 0;
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int64_t expected_ = expected;
+    for (int64_t i = nchunk * CHUNKITEMS; i < (nchunk + 1) * CHUNKITEMS; i++) {
+      double value = item_value(kind, i);
+      expected += value >= low && value <= high;
+    }
+    nchunks += expected > expected_;
+  }
+  if (nmatches != expected || scan.nmatches != expected || scan.nchunks != nchunks) {
+    scan.errors++;
+  }
+  return scan.errors;
+}
+
+
+CUTEST_TEST_TEST(filter_range) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(kind, int);
+  CUTEST_GET_PARAMETER(nthreads, int);
+  CUTEST_GET_PARAMETER(postfilter, bool);
+
+  int32_t typesize = kind == BLOSC2_ZONEMAP_INT ? sizeof(int32_t) : sizeof(double);
+  blosc2_cparams cparams = data->cparams;
+  cparams.typesize = typesize;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.zonemap = kind;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  blosc2_postfilter_params postparams = {0};
+  if (postfilter) {
+    dparams.postfilter = copy_postfilter;
+    dparams.postparams = &postparams;
+  }
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tstorage.urlpath,
+                            .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int32_t chunksize = CHUNKITEMS * typesize;
+  uint8_t *buffer = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < ZEROS_CHUNK; nchunk++) {
+    for (int32_t i = 0; i < CHUNKITEMS; i++) {
+      double value = item_value(kind, nchunk * CHUNKITEMS + i);
+      if (kind == BLOSC2_ZONEMAP_INT) {
+        ((int32_t *) buffer)[i] = (int32_t) value;
+      }
+      else {
+        ((double *) buffer)[i] = value;
+      }
+    }
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+  }
+  free(buffer);
+  uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+  blosc2_chunk_zeros(cparams, chunksize, zeros, sizeof(zeros));
+  CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_chunk(schunk, zeros, true) == NCHUNKS);
+  CUTEST_ASSERT("The chunk has zone maps",
+                blosc2_schunk_get_zonemap(schunk, ZEROS_CHUNK, NULL, NULL) == BLOSC2_ERROR_NOT_FOUND);
+
+  // Across a few blocks of two chunks
+  CUTEST_ASSERT("Wrong matches", check_scan(schunk, kind, 2 * CHUNKITEMS + 5000, 3 * CHUNKITEMS + 1000) == 0);
+  // The run, and the chunk without zone maps
+  CUTEST_ASSERT("Wrong matches", check_scan(schunk, kind, 0, 10) == 0);
+  // Nothing
+  CUTEST_ASSERT("Wrong matches", check_scan(schunk, kind, -10, -1) == 0);
+  // Everything but NaNs
+  CUTEST_ASSERT("Wrong matches", check_scan(schunk, kind, -1, NCHUNKS * CHUNKITEMS) == 0);
+  if (kind == BLOSC2_ZONEMAP_FLOAT) {
+    CUTEST_ASSERT("Wrong matches", check_scan(schunk, kind, CHUNKITEMS, CHUNKITEMS + 300) == 0);
+  }
+
+  // An unbounded range has everything but NaNs
+  int64_t nans = kind == BLOSC2_ZONEMAP_FLOAT ? CHUNKITEMS / 100 : 0;
+  test_scan scan = {kind, typesize, -INFINITY, INFINITY, 0, -1, 0, 0};
+  CUTEST_ASSERT("Wrong number of matches",
+                blosc2_schunk_filter_range(schunk, NULL, NULL, check_matches, &scan) ==
+                NCHUNKS * CHUNKITEMS - nans);
+  CUTEST_ASSERT("Wrong matches", scan.errors == 0);
+
+  // The callback can stop the scan
+  CUTEST_ASSERT("The scan is not stopped", blosc2_schunk_filter_range(schunk, NULL, NULL, stop_scan, NULL) == -42);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(filter_range) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(filter_range);
+}
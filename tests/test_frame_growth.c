@@ -0,0 +1,106 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the (geometric) growth of the buffer of in-memory frames.
+*/
+
+#include "test_common.h"
+#include "frame.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 1000
+#define NCHUNKS 2000
+
+
+typedef struct {
+  bool delete;
+} test_frame_growth_backend;
+
+CUTEST_TEST_DATA(frame_growth) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(frame_growth) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_frame_growth_backend, CUTEST_DATA(
+      {false},
+      {true},
+  ));
+}
+
+
+CUTEST_TEST_TEST(frame_growth) {
+  CUTEST_GET_PARAMETER(backend, test_frame_growth_backend);
+
+  int32_t data_buffer[CHUNKSIZE];
+  int32_t rec_buffer[CHUNKSIZE];
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+
+  /* The buffer only grows now and then */
+  int ngrowths = 0;
+  int64_t cap = frame->cframe_cap;
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data_buffer[j] = i * CHUNKSIZE + j * j;
+    }
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, sizeof(data_buffer));
+    CUTEST_ASSERT("Error appending", nchunks == i + 1);
+    CUTEST_ASSERT("The capacity is too small", frame->cframe_cap >= frame->len);
+    if (frame->cframe_cap != cap) {
+      ngrowths++;
+      cap = frame->cframe_cap;
+    }
+  }
+  CUTEST_ASSERT("The buffer grows at every append", ngrowths < NCHUNKS / 20);
+  if (backend.delete) {
+    CUTEST_ASSERT("Error deleting", blosc2_schunk_delete_chunk(schunk, 0) == NCHUNKS - 1);
+  }
+
+  /* The buffer handed over is not larger than the frame */
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  CUTEST_ASSERT("Error serializing the frame", len > 0 && !needs_free);
+  CUTEST_ASSERT("The buffer is not shrunk", frame->cframe_cap == len && cframe == frame->cframe);
+
+  blosc2_schunk *schunk2 = blosc2_schunk_from_buffer(cframe, len, true);
+  CUTEST_ASSERT("Error reading the frame", schunk2 != NULL);
+  int first = backend.delete ? 1 : 0;
+  for (int i = first; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data_buffer[j] = i * CHUNKSIZE + j * j;
+    }
+    int dsize = blosc2_schunk_decompress_chunk(schunk2, i - first, rec_buffer, sizeof(rec_buffer));
+    CUTEST_ASSERT("Error decompressing", dsize == sizeof(rec_buffer));
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, sizeof(rec_buffer)) == 0);
+  }
+
+  /* Appends after shrinking keep working */
+  CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data_buffer, sizeof(data_buffer)) > 0);
+  CUTEST_ASSERT("The capacity is too small", frame->cframe_cap >= frame->len);
+
+  blosc2_schunk_free(schunk2);
+  blosc2_schunk_free(schunk);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(frame_growth) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(frame_growth);
+}
@@ -0,0 +1,198 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the two-level chunk offsets index of frames with many chunks (BLOSC2_INDEX_TWO_LEVELS).
+*/
+
+#include "test_common.h"
+#include "frame.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 100
+#define NCHUNKS FRAME_INDEX_LEAF_NOFFSETS
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+} test_frame_index_backend;
+
+CUTEST_TEST_DATA(frame_index) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(frame_index) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_frame_index_backend, CUTEST_DATA(
+      {true, NULL},
+      {true, "test_frame_index.b2frame"},
+      {false, "test_frame_index_s.b2frame"},
+  ));
+}
+
+
+static void fill_chunk(int32_t *buffer, int64_t nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = (int32_t)(nchunk * CHUNKSIZE + j);
+  }
+}
+
+static int64_t add_chunk(blosc2_schunk *schunk, int64_t nchunk, bool insert) {
+  int32_t data[CHUNKSIZE];
+  uint8_t chunk[CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD];
+  fill_chunk(data, nchunk);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, data, sizeof(data), chunk, sizeof(chunk));
+  if (cbytes < 0) {
+    return cbytes;
+  }
+  if (insert) {
+    return blosc2_schunk_insert_chunk(schunk, nchunk, chunk, true);
+  }
+  return blosc2_schunk_update_chunk(schunk, nchunk, chunk, true);
+}
+
+/* Chunk nchunk has to hold the data for chunk `id`, or zeros if `id` is negative */
+static bool check_chunk(blosc2_schunk *schunk, int64_t nchunk, int64_t id) {
+  int32_t data[CHUNKSIZE];
+  int32_t rec[CHUNKSIZE];
+  if (id < 0) {
+    memset(data, 0, sizeof(data));
+  }
+  else {
+    fill_chunk(data, id);
+  }
+  int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, rec, sizeof(rec));
+  return dsize == (int)sizeof(rec) && memcmp(data, rec, sizeof(rec)) == 0;
+}
+
+static bool check_index(blosc2_schunk *schunk, bool two_levels) {
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  uint8_t header[FRAME_HEADER_MINLEN];
+  if (frame->cframe != NULL) {
+    memcpy(header, frame->cframe, FRAME_HEADER_MINLEN);
+  }
+  else {
+    char path[256];
+    snprintf(path, sizeof(path), frame->sframe ? "%s/chunks.b2frame" : "%s", frame->urlpath);
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+      return false;
+    }
+    size_t rbytes = fread(header, 1, FRAME_HEADER_MINLEN, fp);
+    fclose(fp);
+    if (rbytes != FRAME_HEADER_MINLEN) {
+      return false;
+    }
+  }
+  int version = header[FRAME_FLAGS] & 0x0f;
+  if (version != (schunk->storage->index_format == BLOSC2_INDEX_TWO_LEVELS ?
+                  BLOSC2_VERSION_FRAME_FORMAT_TWO_LEVELS_INDEX : BLOSC2_VERSION_FRAME_FORMAT)) {
+    return false;
+  }
+  return ((header[FRAME_FLAGS] & FRAME_INDEX_TWO_LEVELS) != 0) == two_levels;
+}
+
+
+CUTEST_TEST_TEST(frame_index) {
+  CUTEST_GET_PARAMETER(backend, test_frame_index_backend);
+
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath};
+
+  /* The two-level index has to be asked for */
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  int64_t nchunks = blosc2_schunk_fill_special(schunk, (int64_t)(NCHUNKS + 1) * CHUNKSIZE, BLOSC2_SPECIAL_ZERO,
+                                               CHUNKSIZE * sizeof(int32_t));
+  CUTEST_ASSERT("Error filling the super-chunk", nchunks == NCHUNKS + 1);
+  CUTEST_ASSERT("Wrong index", check_index(schunk, false));
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, NCHUNKS, -1));
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+
+  storage.index_format = BLOSC2_INDEX_TWO_LEVELS;
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+
+  /* As many chunks as fit in a single index chunk */
+  nchunks = blosc2_schunk_fill_special(schunk, (int64_t)NCHUNKS * CHUNKSIZE, BLOSC2_SPECIAL_ZERO,
+                                       CHUNKSIZE * sizeof(int32_t));
+  CUTEST_ASSERT("Error filling the super-chunk", nchunks == NCHUNKS);
+  CUTEST_ASSERT("Wrong index", check_index(schunk, false));
+
+  /* One more chunk turns it into a two-level index */
+  CUTEST_ASSERT("Error inserting a chunk", add_chunk(schunk, 1, true) == NCHUNKS + 1);
+  CUTEST_ASSERT("Wrong index", check_index(schunk, true));
+  CUTEST_ASSERT("Error updating a chunk", add_chunk(schunk, NCHUNKS - 1, false) == NCHUNKS + 1);
+  CUTEST_ASSERT("Error updating a chunk", add_chunk(schunk, NCHUNKS, false) == NCHUNKS + 1);
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, 0, -1));
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, 1, 1));
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, 2, -1));
+  CUTEST_ASSERT("Wrong data in the first leaf", check_chunk(schunk, NCHUNKS - 1, NCHUNKS - 1));
+  CUTEST_ASSERT("Wrong data in the second leaf", check_chunk(schunk, NCHUNKS, NCHUNKS));
+
+  /* The two-level index is read back (and decoded in one go for on-disk frames) */
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(backend.urlpath);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS + 1);
+    CUTEST_ASSERT("The format of the index is not kept", schunk->storage->index_format == BLOSC2_INDEX_TWO_LEVELS);
+    CUTEST_ASSERT("Wrong data after reopening", check_chunk(schunk, 1, 1));
+    CUTEST_ASSERT("Wrong data after reopening", check_chunk(schunk, NCHUNKS, NCHUNKS));
+  }
+  int64_t *offsets = blosc2_frame_get_offsets(schunk);
+  CUTEST_ASSERT("Cannot get the offsets", offsets != NULL);
+  CUTEST_ASSERT("Wrong offsets", offsets[0] < 0 && offsets[1] >= 0 && offsets[NCHUNKS] >= 0);
+  free(offsets);
+
+  /* Back to a single index chunk */
+  CUTEST_ASSERT("Error deleting a chunk", blosc2_schunk_delete_chunk(schunk, 0) == NCHUNKS);
+  CUTEST_ASSERT("Wrong index", check_index(schunk, false));
+  CUTEST_ASSERT("Wrong data after deleting", check_chunk(schunk, 0, 1));
+  CUTEST_ASSERT("Wrong data after deleting", check_chunk(schunk, NCHUNKS - 1, NCHUNKS));
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+
+  /* A special frame with several leaves (the last one only partially used) */
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  nchunks = blosc2_schunk_fill_special(schunk, (int64_t)(2 * NCHUNKS + 10) * CHUNKSIZE, BLOSC2_SPECIAL_ZERO,
+                                       CHUNKSIZE * sizeof(int32_t));
+  CUTEST_ASSERT("Error filling the super-chunk", nchunks == 2 * NCHUNKS + 10);
+  CUTEST_ASSERT("Wrong index", check_index(schunk, true));
+  CUTEST_ASSERT("Wrong data in the last leaf", check_chunk(schunk, 2 * NCHUNKS + 9, -1));
+  CUTEST_ASSERT("Error updating a chunk", add_chunk(schunk, 2 * NCHUNKS + 9, false) == 2 * NCHUNKS + 10);
+  CUTEST_ASSERT("Error updating a chunk", add_chunk(schunk, NCHUNKS + 1, false) == 2 * NCHUNKS + 10);
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(backend.urlpath);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  }
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, NCHUNKS, -1));
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, NCHUNKS + 1, NCHUNKS + 1));
+  CUTEST_ASSERT("Wrong data in the last leaf", check_chunk(schunk, 2 * NCHUNKS + 9, 2 * NCHUNKS + 9));
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(frame_index) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(frame_index);
+}
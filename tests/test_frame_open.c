@@ -0,0 +1,177 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for opening on-disk frames, whose header, metalayers, chunk offsets and
+  trailer are fetched with a single read at each end when they are small.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS 10
+#define COUNTING_IO 245
+
+
+static int nopens = 0;
+static int nreads = 0;
+
+static void *counting_open(const char *urlpath, const char *mode, void *params) {
+  BLOSC_UNUSED_PARAM(params);
+  nopens++;
+  return blosc2_stdio_open(urlpath, mode, NULL);
+}
+
+static int64_t counting_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  nreads++;
+  return blosc2_stdio_read(ptr, size, nitems, stream);
+}
+
+static int64_t counting_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  nreads++;
+  return blosc2_stdio_pread(ptr, size, nitems, position, stream);
+}
+
+
+typedef struct {
+  bool contiguous;
+  int nchunks;
+} test_open_backend;
+
+CUTEST_TEST_DATA(frame_open) {
+  int32_t *buffer;
+  int32_t *rec_buffer;
+};
+
+CUTEST_TEST_SETUP(frame_open) {
+  blosc2_init();
+  blosc2_io_cb io_cb = {0};
+  io_cb.id = COUNTING_IO;
+  io_cb.name = "counting";
+  io_cb.open = (blosc2_open_cb) counting_open;
+  io_cb.close = (blosc2_close_cb) blosc2_stdio_close;
+  io_cb.read = (blosc2_read_cb) counting_read;
+  io_cb.tell = (blosc2_tell_cb) blosc2_stdio_tell;
+  io_cb.seek = (blosc2_seek_cb) blosc2_stdio_seek;
+  io_cb.write = (blosc2_write_cb) blosc2_stdio_write;
+  io_cb.truncate = (blosc2_truncate_cb) blosc2_stdio_truncate;
+  blosc2_register_io_cb(&io_cb);
+  blosc2_io_cb_ext io_cb_ext = {0};
+  io_cb_ext.pread = (blosc2_pread_cb) counting_pread;
+  io_cb_ext.pwrite = (blosc2_pwrite_cb) blosc2_stdio_pwrite;
+  blosc2_register_io_cb_ext(io_cb.id, &io_cb_ext);
+
+  data->buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  data->rec_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+
+  CUTEST_PARAMETRIZE(backend, test_open_backend, CUTEST_DATA(
+      {true, NCHUNKS},
+      {true, 0},
+      {false, NCHUNKS},
+  ));
+}
+
+
+CUTEST_TEST_TEST(frame_open) {
+  CUTEST_GET_PARAMETER(backend, test_open_backend);
+
+  char *urlpath = "test_frame_open.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_io io = {.id = COUNTING_IO, .name = "counting"};
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=urlpath, .io=&io};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  uint8_t meta[] = {1, 2, 3, 4};
+  CUTEST_ASSERT("Error adding the metalayer", blosc2_meta_add(schunk, "meta", meta, sizeof(meta)) >= 0);
+  for (int i = 0; i < backend.nchunks; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data->buffer[j] = i * CHUNKSIZE + j;
+    }
+    CUTEST_ASSERT("Error appending",
+                  blosc2_schunk_append_buffer(schunk, data->buffer, CHUNKSIZE * sizeof(int32_t)) == i + 1);
+  }
+  CUTEST_ASSERT("Error adding the vlmetalayer",
+                blosc2_vlmeta_add(schunk, "vlmeta", meta, sizeof(meta), NULL) >= 0);
+  blosc2_schunk_free(schunk);
+
+  // One open (and one read at each end at most) for everything but the chunks
+  nopens = 0;
+  nreads = 0;
+  schunk = blosc2_schunk_open_udio(urlpath, &io);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Too many opens", nopens == 1);
+  CUTEST_ASSERT("Too many reads", nreads <= 2);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == backend.nchunks);
+  uint8_t *content;
+  int32_t content_len;
+  CUTEST_ASSERT("Error getting the metalayer", blosc2_meta_get(schunk, "meta", &content, &content_len) >= 0);
+  CUTEST_ASSERT("Wrong metalayer", content_len == sizeof(meta) && memcmp(content, meta, sizeof(meta)) == 0);
+  free(content);
+  CUTEST_ASSERT("Error getting the vlmetalayer",
+                blosc2_vlmeta_get(schunk, "vlmeta", &content, &content_len) >= 0);
+  CUTEST_ASSERT("Wrong vlmetalayer", content_len == sizeof(meta) && memcmp(content, meta, sizeof(meta)) == 0);
+  free(content);
+  if (backend.nchunks > 0 && backend.contiguous) {
+    // The offsets are there already, so the first chunk takes as many reads as the next ones
+    int reads[2];
+    for (int i = 0; i < 2; i++) {
+      nreads = 0;
+      int dsize = blosc2_schunk_decompress_chunk(schunk, 3 + i, data->rec_buffer, CHUNKSIZE * sizeof(int32_t));
+      CUTEST_ASSERT("Decompression error", dsize == CHUNKSIZE * (int)sizeof(int32_t));
+      CUTEST_ASSERT("Decompressed data differs", data->rec_buffer[0] == (3 + i) * CHUNKSIZE);
+      reads[i] = nreads;
+    }
+    CUTEST_ASSERT("The offsets are read again", reads[0] == reads[1]);
+  }
+
+  // Changes made after opening do not use what was read when opening
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data->buffer[j] = -j;
+  }
+  CUTEST_ASSERT("Error appending",
+                blosc2_schunk_append_buffer(schunk, data->buffer, CHUNKSIZE * sizeof(int32_t)) ==
+                backend.nchunks + 1);
+  meta[0] = 10;
+  CUTEST_ASSERT("Error updating the vlmetalayer",
+                blosc2_vlmeta_update(schunk, "vlmeta", meta, sizeof(meta), NULL) >= 0);
+  CUTEST_ASSERT("Error updating the metalayer", blosc2_meta_update(schunk, "meta", meta, sizeof(meta)) >= 0);
+  blosc2_schunk_free(schunk);
+
+  schunk = blosc2_schunk_open_udio(urlpath, &io);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == backend.nchunks + 1);
+  CUTEST_ASSERT("Error getting the metalayer", blosc2_meta_get(schunk, "meta", &content, &content_len) >= 0);
+  CUTEST_ASSERT("Wrong metalayer", content[0] == 10);
+  free(content);
+  CUTEST_ASSERT("Error getting the vlmetalayer",
+                blosc2_vlmeta_get(schunk, "vlmeta", &content, &content_len) >= 0);
+  CUTEST_ASSERT("Wrong vlmetalayer", content[0] == 10);
+  free(content);
+  for (int i = 0; i <= backend.nchunks; i++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, data->rec_buffer, CHUNKSIZE * sizeof(int32_t));
+    CUTEST_ASSERT("Decompression error", dsize == CHUNKSIZE * (int)sizeof(int32_t));
+    int32_t expected = i == backend.nchunks ? -1 : i * CHUNKSIZE + 1;
+    CUTEST_ASSERT("Decompressed data differs", data->rec_buffer[1] == expected);
+  }
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(frame_open) {
+  free(data->buffer);
+  free(data->rec_buffer);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(frame_open);
+}
@@ -0,0 +1,168 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the element-wise filters that are fused with the shuffle.  The
+  chunks have to be the same as when the filters run as separate passes
+  (which is forced by an identity filter in between).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NELEMS (50 * 1000 + 7)
+#define IDENTITY_FILTER 250
+
+
+typedef struct {
+  uint8_t filter;
+  int32_t typesize;
+  int32_t blocksize;
+  int16_t nthreads;
+} test_fused_backend;
+
+CUTEST_TEST_DATA(fused_filters) {
+  uint8_t *src;
+  uint8_t *fused;
+  uint8_t *separate;
+  uint8_t *dest;
+};
+
+
+static int identity_forward(const uint8_t *src, uint8_t *dest, int32_t size, uint8_t meta,
+                            blosc2_cparams *cparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(cparams);
+  BLOSC_UNUSED_PARAM(id);
+  memcpy(dest, src, size);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+static int identity_backward(const uint8_t *src, uint8_t *dest, int32_t size, uint8_t meta,
+                             blosc2_dparams *dparams, uint8_t id) {
+  BLOSC_UNUSED_PARAM(meta);
+  BLOSC_UNUSED_PARAM(dparams);
+  BLOSC_UNUSED_PARAM(id);
+  memcpy(dest, src, size);
+  return BLOSC2_ERROR_SUCCESS;
+}
+
+
+CUTEST_TEST_SETUP(fused_filters) {
+  blosc2_init();
+  blosc2_filter urfilter = {0};
+  urfilter.id = IDENTITY_FILTER;
+  urfilter.name = "identity";
+  urfilter.version = 1;
+  urfilter.forward = identity_forward;
+  urfilter.backward = identity_backward;
+  blosc2_register_filter(&urfilter);
+
+  int32_t nbytes = NELEMS * 16;
+  data->src = malloc(nbytes);
+  data->fused = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  data->separate = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(nbytes);
+  // Slowly varying doubles (which also look fine as smaller integers)
+  for (int i = 0; i < nbytes / 8; i++) {
+    ((double *)data->src)[i] = 100. + i * 0.001 + (i % 17) * 1e-7;
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_fused_backend, CUTEST_DATA(
+      {BLOSC_DELTA, 2, 0, 1},
+      {BLOSC_DELTA, 4, 0, 1},
+      {BLOSC_DELTA, 8, 0, 4},
+      {BLOSC_DELTA, 16, 0, 1},
+      {BLOSC_DELTA, 4, 10 * 1000, 4},  // blocks that are not a multiple of the tiles
+      {BLOSC_DELTA, 3, 0, 1},  // not fused
+      {BLOSC_TRUNC_PREC, 4, 0, 1},
+      {BLOSC_TRUNC_PREC, 8, 0, 4},
+      {BLOSC_TRUNC_PREC, 8, 10 * 1000, 1},
+  ));
+}
+
+
+static int compress(test_fused_backend backend, bool separate, int16_t nthreads, void *src, int32_t nbytes,
+                    uint8_t *dest) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = backend.typesize;
+  cparams.blocksize = backend.blocksize;
+  cparams.nthreads = nthreads;
+  cparams.compcode = BLOSC_LZ4;
+  cparams.filters[BLOSC2_MAX_FILTERS - 3] = backend.filter;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 3] = (backend.filter == BLOSC_TRUNC_PREC) ? 10 : 0;
+  if (separate) {
+    cparams.filters[BLOSC2_MAX_FILTERS - 2] = IDENTITY_FILTER;
+  }
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_SHUFFLE;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, src, nbytes, dest, nbytes + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  return csize;
+}
+
+
+static int decompress(int16_t nthreads, uint8_t *chunk, int32_t csize, void *dest, int32_t nbytes) {
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, chunk, csize, dest, nbytes);
+  blosc2_free_ctx(dctx);
+  return dsize;
+}
+
+
+CUTEST_TEST_TEST(fused_filters) {
+  CUTEST_GET_PARAMETER(backend, test_fused_backend);
+
+  int32_t nbytes = NELEMS * backend.typesize;
+  // Threads store the blocks in the order they finish, so compare the chunks of a single one
+  int csize = compress(backend, false, 1, data->src, nbytes, data->fused);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  int csize2 = compress(backend, true, 1, data->src, nbytes, data->separate);
+  CUTEST_ASSERT("Compression error", csize2 > 0);
+
+  // Only the filters in the header can differ
+  CUTEST_ASSERT("Fused filters give a different chunk", csize == csize2);
+  CUTEST_ASSERT("Fused filters give a different chunk",
+                memcmp(data->fused + BLOSC_EXTENDED_HEADER_LENGTH, data->separate + BLOSC_EXTENDED_HEADER_LENGTH,
+                       csize - BLOSC_EXTENDED_HEADER_LENGTH) == 0);
+
+  for (int i = 0; i < 3; i++) {
+    if (i == 2) {
+      // The fused filters with threads
+      csize = compress(backend, false, backend.nthreads, data->src, nbytes, data->fused);
+      CUTEST_ASSERT("Compression error", csize > 0);
+    }
+    uint8_t *chunk = (i == 1) ? data->separate : data->fused;
+    int dsize = decompress(backend.nthreads, chunk, csize, data->dest, nbytes);
+    CUTEST_ASSERT("Decompression error", dsize == nbytes);
+    if (backend.filter == BLOSC_DELTA) {
+      CUTEST_ASSERT("Decompressed data differs", memcmp(data->dest, data->src, nbytes) == 0);
+    }
+    else if (backend.typesize == 8) {
+      double *dest = (double *)data->dest;
+      double *src = (double *)data->src;
+      for (int j = 0; j < NELEMS; j++) {
+        CUTEST_ASSERT("Truncated data is too far from the original", fabs(dest[j] - src[j]) < 1e-3 * src[j]);
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(fused_filters) {
+  free(data->src);
+  free(data->fused);
+  free(data->separate);
+  free(data->dest);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(fused_filters);
+}
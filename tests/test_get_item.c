@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the point lookups of items of super-chunks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (50 * 1000)
+#define NCHUNKS 100
+#define ZEROS_CHUNK 7
+#define BLOCKSIZE (16 * 1024)
+#define NLOOKUPS 2000
+#define URLPATH "test_get_item.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(get_item) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(get_item) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int64_t);
+  data->cparams.blocksize = BLOCKSIZE;
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 3));
+}
+
+
+static int64_t item_value(int64_t index) {
+  return index / CHUNKITEMS == ZEROS_CHUNK ? 0 : index * 3 + 1;
+}
+
+/* Look up items all over the super-chunk (more chunks than the ones that are kept) */
+static int check_lookups(blosc2_schunk *schunk, int64_t nitems, int64_t updated, int64_t value) {
+  int errors = 0;
+  uint64_t seed = 12345;
+  for (int i = 0; i < NLOOKUPS; i++) {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    int64_t index = (int64_t) ((seed >> 16) % (uint64_t) nitems);
+    int64_t item;
+    if (blosc2_schunk_get_item(schunk, index, &item) < 0) {
+      errors++;
+      continue;
+    }
+    int64_t expected = index / CHUNKITEMS == updated ? value : item_value(index);
+    errors += item != expected;
+  }
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(get_item) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  int32_t chunksize = CHUNKITEMS * sizeof(int64_t);
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = (int16_t) nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tstorage.urlpath,
+                            .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int64_t *buffer = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    for (int32_t i = 0; i < CHUNKITEMS; i++) {
+      buffer[i] = item_value(nchunk * CHUNKITEMS + i);
+    }
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+  }
+  int64_t nitems = (int64_t) NCHUNKS * CHUNKITEMS;
+
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  }
+
+  blosc2_ctx_reset_stats(schunk->dctx);
+  CUTEST_ASSERT("Wrong items", check_lookups(schunk, nitems, -1, 0) == 0);
+  // The items of lazy chunks only need their block to be read
+  blosc2_ctx_stats stats;
+  blosc2_ctx_get_stats(schunk->dctx, &stats);
+  CUTEST_ASSERT("Too many reads", stats.lazy_reads <= NLOOKUPS);
+  CUTEST_ASSERT("Too many bytes read", stats.lazy_read_bytes <= (int64_t) NLOOKUPS * BLOCKSIZE);
+
+  // The chunks that are kept are dropped when the super-chunk changes
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = -5;
+  }
+  int64_t item;
+  CUTEST_ASSERT("Cannot get the item", blosc2_schunk_get_item(schunk, 3 * CHUNKITEMS + 10, &item) == 0);
+  uint8_t *chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, buffer, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress the chunk", cbytes > 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 3, chunk, true) == NCHUNKS);
+  free(chunk);
+  CUTEST_ASSERT("Wrong items after updating", check_lookups(schunk, nitems, 3, -5) == 0);
+
+  // Out of the super-chunk
+  CUTEST_ASSERT("The item is out of the super-chunk", blosc2_schunk_get_item(schunk, nitems, &item) < 0);
+  CUTEST_ASSERT("The item is out of the super-chunk", blosc2_schunk_get_item(schunk, -1, &item) < 0);
+
+  free(buffer);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(get_item) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(get_item);
+}
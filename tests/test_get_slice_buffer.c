@@ -22,6 +22,7 @@ typedef struct {
     char* urlpath;
     bool contiguous;
     bool shorter_last_chunk;
+    int16_t pool_nthreads;
 } test_data;
 
 test_data tdata;
@@ -41,8 +42,11 @@ test_ndata tndata[] = {
         {2, 200 * 100, CHUNKSIZE * 2, false}, // 1 chunk
         {5, 0, CHUNKSIZE * 5 + 200 * 100 + 300, true}, // last chunk shorter
         {2, 10, CHUNKSIZE * 2 + 400, true}, // start != 0, last chunk shorter
+        {12, CHUNKSIZE / 2 + 7, CHUNKSIZE * 10 + 333, false}, // partial edges around whole chunks
 };
 
+int16_t pool_nthreads[] = {0, 3};  // without and with a shared pool of threads
+
 typedef struct {
     bool contiguous;
     char *urlpath;
@@ -67,6 +71,7 @@ static char* test_get_slice_buffer(void) {
 
   /* Initialize the Blosc compressor */
   blosc2_init();
+  mu_assert("ERROR: cannot create the shared pool", blosc2_set_shared_threadpool(tdata.pool_nthreads) == 0);
 
   /* Create a super-chunk container */
   blosc2_remove_urlpath(tdata.urlpath);
@@ -137,13 +142,16 @@ static char* test_get_slice_buffer(void) {
 static char *all_tests(void) {
   for (int i = 0; i < (int) ARRAY_SIZE(tstorage); ++i) {
     for (int j = 0; j < (int) ARRAY_SIZE(tndata); ++j) {
-      tdata.contiguous = tstorage[i].contiguous;
-      tdata.urlpath = tstorage[i].urlpath;
-      tdata.nchunks = tndata[j].nchunks;
-      tdata.start = tndata[j].start;
-      tdata.stop = tndata[j].stop;
-      tdata.shorter_last_chunk = tndata[j].shorter_last_chunk;
-      mu_run_test(test_get_slice_buffer);
+      for (int k = 0; k < (int) ARRAY_SIZE(pool_nthreads); ++k) {
+        tdata.contiguous = tstorage[i].contiguous;
+        tdata.urlpath = tstorage[i].urlpath;
+        tdata.nchunks = tndata[j].nchunks;
+        tdata.start = tndata[j].start;
+        tdata.stop = tndata[j].stop;
+        tdata.shorter_last_chunk = tndata[j].shorter_last_chunk;
+        tdata.pool_nthreads = pool_nthreads[k];
+        mu_run_test(test_get_slice_buffer);
+      }
     }
   }
 
@@ -0,0 +1,100 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the huge pages backing the large temporaries and in-memory frames
+  (BLOSC_HUGEPAGES).  Systems without reserved huge pages exercise the fallback.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (4 * 1024 * 1024)
+#define NCHUNKS 4
+
+
+typedef struct {
+  int16_t nthreads;
+  int32_t blocksize;
+} test_hugepages_backend;
+
+CUTEST_TEST_DATA(hugepages) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(hugepages) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.clevel = 1;
+
+  CUTEST_PARAMETRIZE(backend, test_hugepages_backend, CUTEST_DATA(
+      {1, 4 * 1024 * 1024},
+      {4, 1024 * 1024},
+      {2, 0},
+  ));
+}
+
+
+CUTEST_TEST_TEST(hugepages) {
+  CUTEST_GET_PARAMETER(backend, test_hugepages_backend);
+
+  int32_t *data_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *rec_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.blocksize = backend.blocksize;
+  cparams.nthreads = backend.nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = backend.nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .contiguous=true};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data_buffer[j] = (i * CHUNKSIZE + j) ^ (j >> 7);
+    }
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, CHUNKSIZE * sizeof(int32_t));
+    CUTEST_ASSERT("Error appending", nchunks == i + 1);
+  }
+
+  /* Also the copy of the frame into a new in-memory one */
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  CUTEST_ASSERT("Error serializing the frame", len > 0);
+  blosc2_schunk *schunk2 = blosc2_schunk_from_buffer(cframe, len, true);
+  CUTEST_ASSERT("Error copying the frame", schunk2 != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    for (int j = 0; j < CHUNKSIZE; j++) {
+      data_buffer[j] = (i * CHUNKSIZE + j) ^ (j >> 7);
+    }
+    int dsize = blosc2_schunk_decompress_chunk(schunk2, i, rec_buffer, CHUNKSIZE * sizeof(int32_t));
+    CUTEST_ASSERT("Error decompressing", dsize == CHUNKSIZE * (int)sizeof(int32_t));
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, dsize) == 0);
+  }
+
+  blosc2_schunk_free(schunk2);
+  if (needs_free) {
+    free(cframe);
+  }
+  blosc2_schunk_free(schunk);
+  free(data_buffer);
+  free(rec_buffer);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(hugepages) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  /* The mode is read at the first blosc2_init() */
+  setenv("BLOSC_HUGEPAGES", "explicit", 1);
+  CUTEST_TEST_RUN(hugepages);
+}
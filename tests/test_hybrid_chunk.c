@@ -0,0 +1,160 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for hybrid chunks, which pick the codec of every block (blosc2_cparams.block_codec).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NBYTES (1000 * 1000)
+#define BLOCKSIZE (32 * 1024)
+#define NBLOCKS ((NBYTES + BLOCKSIZE - 1) / BLOCKSIZE)
+
+
+CUTEST_TEST_DATA(hybrid_chunk) {
+  uint8_t *src;
+  uint8_t *chunk;
+  uint8_t *dest;
+};
+
+
+CUTEST_TEST_SETUP(hybrid_chunk) {
+  blosc2_init();
+  data->src = malloc(NBYTES);
+  data->chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(NBYTES);
+  int32_t *items = (int32_t *) data->src;
+  for (int i = 0; i < NBYTES / (int) sizeof(int32_t); i++) {
+    // Blocks of noise (like headers) among blocks of smooth items
+    items[i] = (i * 4 / BLOCKSIZE) % 4 == 3 ? rand() : i / 10;
+  }
+
+  CUTEST_PARAMETRIZE(scheduler, int, CUTEST_DATA(BLOSC_DEFAULT_SCHED, BLOSC_STREAMS_SCHED));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 4));
+  CUTEST_PARAMETRIZE(filter, uint8_t, CUTEST_DATA(BLOSC_NOFILTER, BLOSC_SHUFFLE));
+}
+
+
+/* The codec that every block is expected to get */
+static int expected_codec(int32_t nblock) {
+  switch (nblock % 4) {
+    case 0: return BLOSC_LZ4;
+    case 1: return BLOSC_ZSTD;
+    case 2: return BLOSC_BLOSCLZ;
+    default: return BLOSC2_BLOCK_MEMCPY;
+  }
+}
+
+static int pick_codec(blosc2_block_codec_params *params) {
+  int *ncalls = (int *) params->user_data;
+  if (params->size != BLOCKSIZE && params->nblock != NBLOCKS - 1) {
+    return BLOSC2_ERROR_FAILURE;
+  }
+  ncalls[params->nblock]++;
+  return expected_codec(params->nblock);
+}
+
+static int pick_failure(blosc2_block_codec_params *params) {
+  return params->nblock == 3 ? BLOSC2_ERROR_FAILURE : BLOSC_LZ4;
+}
+
+static int pick_unsupported(blosc2_block_codec_params *params) {
+  BLOSC_UNUSED_PARAM(params);
+  return BLOSC_LAST_CODEC;
+}
+
+
+CUTEST_TEST_TEST(hybrid_chunk) {
+  CUTEST_GET_PARAMETER(scheduler, int);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+  CUTEST_GET_PARAMETER(filter, uint8_t);
+
+  int ncalls[NBLOCKS] = {0};
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.splitmode = BLOSC_ALWAYS_SPLIT;
+  cparams.scheduler = scheduler;
+  cparams.nthreads = nthreads;
+  cparams.block_codec = pick_codec;
+  cparams.block_codec_params = ncalls;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  blosc2_free_ctx(cctx);
+
+  /* Every block keeps its codec after the bstarts, and the header keeps the one of cparams */
+  int errors = 0;
+  for (int32_t i = 0; i < NBLOCKS; i++) {
+    errors += ncalls[i] != 1;
+    errors += data->chunk[BLOSC_EXTENDED_HEADER_LENGTH + NBLOCKS * sizeof(int32_t) + i] != expected_codec(i);
+  }
+  CUTEST_ASSERT("Wrong codecs of the blocks", errors == 0);
+  CUTEST_ASSERT("Not a hybrid chunk", strcmp(blosc2_cbuffer_complib(data->chunk), BLOSC_HYBRID_LIBNAME) == 0);
+  blosc2_chunk_info info;
+  CUTEST_ASSERT("Cannot get the info", blosc2_cbuffer_info(data->chunk, csize, &info) == 0);
+  CUTEST_ASSERT("Wrong codec of the header", info.compcode == BLOSC_BLOSCLZ && !info.memcpyed);
+
+  /* Decompression dispatches on the codec of every block */
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Wrong roundtrip", dsize == NBYTES && memcmp(data->src, data->dest, NBYTES) == 0);
+  int32_t start = BLOCKSIZE / 4 - 10;  // across the first blocks
+  int32_t nitems = 3 * BLOCKSIZE / 4;
+  dsize = blosc2_getitem_ctx(dctx, data->chunk, csize, start, nitems, data->dest, NBYTES);
+  CUTEST_ASSERT("Wrong items", dsize == nitems * 4 && memcmp(data->src + start * 4, data->dest, dsize) == 0);
+  blosc2_free_ctx(dctx);
+
+  /* The chunks are lazy in the frames on disk */
+  char *urlpath = "test_hybrid_chunk.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  blosc2_storage storage = {.contiguous=true, .urlpath=urlpath, .cparams=&cparams};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_buffer(schunk, data->src, NBYTES) == 1);
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open(urlpath);
+  dsize = blosc2_schunk_decompress_chunk(schunk, 0, data->dest, NBYTES);
+  CUTEST_ASSERT("Wrong lazy roundtrip", dsize == NBYTES && memcmp(data->src, data->dest, NBYTES) == 0);
+  CUTEST_ASSERT("Cannot get the slice",
+                blosc2_schunk_get_slice_buffer(schunk, start, start + nitems, data->dest) == 0);
+  CUTEST_ASSERT("Wrong lazy items", memcmp(data->src + start * 4, data->dest, nitems * 4) == 0);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+
+  /* The errors of the block codec function, or codecs that do not fit */
+  cparams.block_codec = pick_failure;
+  cctx = blosc2_create_cctx(cparams);
+  csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("The error is not passed on", csize == BLOSC2_ERROR_FAILURE);
+  blosc2_free_ctx(cctx);
+  cparams.block_codec = pick_unsupported;
+  cctx = blosc2_create_cctx(cparams);
+  csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("An unsupported codec is taken", csize == BLOSC2_ERROR_CODEC_SUPPORT);
+  blosc2_free_ctx(cctx);
+  cparams.use_dict = 1;
+  cparams.compcode = BLOSC_ZSTD;
+  CUTEST_ASSERT("Dicts are taken", blosc2_create_cctx(cparams) == NULL);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(hybrid_chunk) {
+  free(data->dest);
+  free(data->chunk);
+  free(data->src);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(hybrid_chunk);
+}
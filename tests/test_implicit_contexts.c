@@ -0,0 +1,131 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the concurrent use of the non-contextual API, where every thread has
+  an implicit context of its own.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#include <pthread.h>
+
+#define NITEMS (100 * 1000)
+#define NWORKERS 4
+#define NROUNDS 20
+
+
+typedef struct {
+  int id;
+  int errors;
+} worker;
+
+CUTEST_TEST_DATA(implicit_contexts) {
+  worker caller;
+};
+
+
+CUTEST_TEST_SETUP(implicit_contexts) {
+  blosc2_init();
+
+  // The calling thread works with the last id
+  data->caller.id = NWORKERS;
+
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 3));
+}
+
+
+/* Compress and decompress buffers with items that depend on the worker */
+static void *roundtrips(void *arg) {
+  worker *w = (worker *) arg;
+  int32_t *src = malloc(NITEMS * sizeof(int32_t));
+  int32_t *dest = malloc(NITEMS * sizeof(int32_t));
+  uint8_t *chunk = malloc(NITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  for (int round = 0; round < NROUNDS; round++) {
+    for (int i = 0; i < NITEMS; i++) {
+      src[i] = w->id * NITEMS + round * 7 + i % 1000;
+    }
+    // Other typesizes and filters in every worker
+    int32_t typesize = w->id % 2 == 0 ? 4 : 8;
+    int cbytes = blosc2_compress(5, w->id % 3, typesize, src, NITEMS * sizeof(int32_t),
+                                 chunk, NITEMS * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+    if (cbytes <= 0) {
+      w->errors++;
+      continue;
+    }
+    memset(dest, 0, NITEMS * sizeof(int32_t));
+    int nbytes = blosc2_decompress(chunk, cbytes, dest, NITEMS * sizeof(int32_t));
+    w->errors += nbytes != NITEMS * (int) sizeof(int32_t) || memcmp(src, dest, NITEMS * sizeof(int32_t)) != 0;
+  }
+  free(chunk);
+  free(dest);
+  free(src);
+  return NULL;
+}
+
+
+static int run_workers(void) {
+  pthread_t threads[NWORKERS];
+  worker workers[NWORKERS];
+  for (int i = 0; i < NWORKERS; i++) {
+    workers[i].id = i;
+    workers[i].errors = 0;
+    pthread_create(&threads[i], NULL, roundtrips, &workers[i]);
+  }
+  int errors = 0;
+  for (int i = 0; i < NWORKERS; i++) {
+    pthread_join(threads[i], NULL);
+    errors += workers[i].errors;
+  }
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(implicit_contexts) {
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  blosc2_set_nthreads(nthreads);
+  CUTEST_ASSERT("Wrong roundtrips in parallel", run_workers() == 0);
+  // The contexts of the threads that are gone are released, and new threads get new ones
+  CUTEST_ASSERT("Wrong roundtrips in new threads", run_workers() == 0);
+
+  // The calling thread keeps its context, which takes the new number of threads
+  worker w = data->caller;
+  w.errors = 0;
+  roundtrips(&w);
+  CUTEST_ASSERT("Wrong roundtrips", w.errors == 0);
+  blosc2_set_nthreads((int16_t) (nthreads + 1));
+  roundtrips(&w);
+  CUTEST_ASSERT("Wrong roundtrips with other threads", w.errors == 0);
+  CUTEST_ASSERT("Cannot free the resources", blosc2_free_resources() == 0);
+  roundtrips(&w);
+  CUTEST_ASSERT("Wrong roundtrips after freeing the resources", w.errors == 0);
+
+  // Freeing the resources in a thread leaves the context of the others alone
+  worker other = {.id = 1};
+  pthread_t thread;
+  pthread_create(&thread, NULL, roundtrips, &other);
+  int rc = 0;
+  for (int i = 0; i < NROUNDS; i++) {
+    rc |= blosc2_free_resources();
+  }
+  pthread_join(thread, NULL);
+  CUTEST_ASSERT("Cannot free the resources", rc == 0);
+  CUTEST_ASSERT("Wrong roundtrips while other threads free theirs", other.errors == 0);
+  blosc2_set_nthreads(1);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(implicit_contexts) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(implicit_contexts);
+}
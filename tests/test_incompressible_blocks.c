@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for chunks that mix incompressible blocks (which LZ4 gives up early
+  on) with compressible ones, including blocks that only compress past
+  their start.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define BLOCKSIZE (64 * 1024)
+#define NBLOCKS 12
+#define NBYTES (NBLOCKS * BLOCKSIZE + 1000)
+
+
+typedef struct {
+  int compcode;
+  uint8_t filter;
+  int16_t nthreads;
+} test_incompressible_backend;
+
+CUTEST_TEST_DATA(incompressible_blocks) {
+  uint8_t *src;
+  uint8_t *chunk;
+  uint8_t *dest;
+};
+
+
+CUTEST_TEST_SETUP(incompressible_blocks) {
+  blosc2_init();
+  data->src = malloc(NBYTES);
+  data->chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(NBYTES);
+
+  // Random blocks, blocks of counters and random blocks that end with zeros
+  uint64_t x = 88172645463325252ULL;
+  for (int i = 0; i < NBYTES / 8; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    int32_t in_block = (i * 8) % BLOCKSIZE;
+    switch ((i * 8 / BLOCKSIZE) % 3) {
+      case 0:
+        ((uint64_t *)data->src)[i] = x;
+        break;
+      case 1:
+        ((uint64_t *)data->src)[i] = i / 3;
+        break;
+      default:
+        ((uint64_t *)data->src)[i] = (in_block < BLOCKSIZE / 4) ? x : 0;
+    }
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_incompressible_backend, CUTEST_DATA(
+      {BLOSC_LZ4, BLOSC_NOSHUFFLE, 1},
+      {BLOSC_LZ4, BLOSC_SHUFFLE, 1},
+      {BLOSC_LZ4, BLOSC_BITSHUFFLE, 4},
+      {BLOSC_LZ4HC, BLOSC_NOSHUFFLE, 4},
+      {BLOSC_LZ4HC, BLOSC_SHUFFLE, 1},
+      {BLOSC_BLOSCLZ, BLOSC_SHUFFLE, 1},
+  ));
+}
+
+
+CUTEST_TEST_TEST(incompressible_blocks) {
+  CUTEST_GET_PARAMETER(backend, test_incompressible_backend);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = 8;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.compcode = backend.compcode;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = backend.filter;
+  cparams.nthreads = backend.nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  // The random third of the data is stored as is, and the rest has to compress by half at least
+  CUTEST_ASSERT("Compressible blocks have not been compressed", csize < NBYTES / 3 + NBYTES / 3);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = backend.nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Decompression error", dsize == NBYTES);
+  CUTEST_ASSERT("Decompressed data differs", memcmp(data->dest, data->src, NBYTES) == 0);
+
+  // Items across a random block and a compressible one
+  int start = BLOCKSIZE / 8 - 10;
+  dsize = blosc2_getitem_ctx(dctx, data->chunk, csize, start, 20, data->dest, 20 * 8);
+  blosc2_free_ctx(dctx);
+  CUTEST_ASSERT("Error getting items", dsize == 20 * 8);
+  CUTEST_ASSERT("Items differ", memcmp(data->dest, data->src + start * 8, 20 * 8) == 0);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(incompressible_blocks) {
+  free(data->src);
+  free(data->chunk);
+  free(data->dest);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(incompressible_blocks);
+}
@@ -100,6 +100,34 @@ static char* test_lazy_chunk(void) {
     }
   }
 
+  // Check that the blocks not masked out are read in a few large reads (at once for small chunks)
+  bool maskout[NBLOCKS];
+  for (int i = 0; i < NBLOCKS; i++) {
+    maskout[i] = (i % 3 == 0);
+  }
+  for (int nchunk = 0; nchunk < nchunks; nchunk++) {
+    memset(data_dest, 0, isize);
+    cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &lazy_chunk, &needs_free);
+    mu_assert("ERROR: cannot get lazy chunk.", cbytes > 0);
+    mu_assert("ERROR: cannot set the maskout.", blosc2_set_maskout(schunk->dctx, maskout, NBLOCKS) == 0);
+    blosc2_ctx_reset_stats(schunk->dctx);
+    dsize = blosc2_decompress_ctx(schunk->dctx, lazy_chunk, cbytes, data_dest, isize);
+    if (needs_free) {
+      free(lazy_chunk);
+    }
+    mu_assert("ERROR: chunk cannot be decompressed correctly.", dsize >= 0);
+    blosc2_ctx_stats stats;
+    blosc2_ctx_get_stats(schunk->dctx, &stats);
+    mu_assert("ERROR: the blocks are not read together.",
+              stats.lazy_reads >= 1 && stats.lazy_reads < NBLOCKS - (NBLOCKS + 2) / 3);
+    for (int i = 0; i < NBLOCKS; i++) {
+      for (int j = 0; j < BLOCKSIZE; j++) {
+        int32_t expected = maskout[i] ? 0 : j + i * BLOCKSIZE + nchunk * CHUNKSIZE;
+        mu_assert("ERROR: bad roundtrip (maskout)", data_dest[j + i * BLOCKSIZE] == expected);
+      }
+    }
+  }
+
   /* Free resources */
   blosc2_schunk_free(schunk);
   /* Destroy the Blosc environment */
@@ -0,0 +1,144 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the global memory budget shared by the chunk caches, the idle file handles,
+  the pooled scratch and the chunks read ahead.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (100 * 1000)
+#define NCHUNKS 6
+
+
+CUTEST_TEST_DATA(memory_budget) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(memory_budget) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.clevel = 1;
+
+  CUTEST_PARAMETRIZE(persistent, bool, CUTEST_DATA(false, true));
+}
+
+
+static void fill_chunk(int64_t nschunk, int64_t nchunk, int32_t *values) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    values[i] = (int32_t) ((nschunk * NCHUNKS + nchunk) * 7919 + i * 31);
+  }
+}
+
+/* Read the chunk `nchunk` through the chunk cache (if any), and check it */
+static bool read_chunk(blosc2_schunk *schunk, int64_t nschunk, int64_t nchunk, int32_t *values, int32_t *expected) {
+  fill_chunk(nschunk, nchunk, expected);
+  if (blosc2_schunk_get_slice_buffer(schunk, nchunk * CHUNKITEMS, (nchunk + 1) * CHUNKITEMS, values) < 0) {
+    return false;
+  }
+  return memcmp(values, expected, CHUNKITEMS * sizeof(int32_t)) == 0;
+}
+
+static int64_t cache_nbytes(blosc2_schunk *schunk) {
+  int64_t nbytes;
+  if (blosc2_schunk_get_chunk_cache_stats(schunk, NULL, NULL, &nbytes) < 0) {
+    return -1;
+  }
+  return nbytes;
+}
+
+
+CUTEST_TEST_TEST(memory_budget) {
+  CUTEST_GET_PARAMETER(persistent, bool);
+
+  char *urlpaths[2] = {"test_memory_budget_a.b2frame", "test_memory_budget_b.b2frame"};
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  int32_t *values = malloc(chunksize);
+  int32_t *expected = malloc(chunksize);
+  blosc2_cparams cparams = data->cparams;
+  blosc2_schunk *schunks[2];
+  for (int n = 0; n < 2; n++) {
+    blosc2_remove_urlpath(urlpaths[n]);
+    blosc2_storage storage = {.cparams=&cparams, .contiguous=true, .urlpath=persistent ? urlpaths[n] : NULL};
+    schunks[n] = blosc2_schunk_new(&storage);
+    CUTEST_ASSERT("Cannot create the super-chunk", schunks[n] != NULL);
+    for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+      fill_chunk(n, nchunk, values);
+      CUTEST_ASSERT("Cannot append", blosc2_schunk_append_buffer(schunks[n], values, chunksize) == nchunk + 1);
+    }
+    // The scratch of the contexts at work is charged too
+    CUTEST_ASSERT("Wrong chunk", read_chunk(schunks[n], n, 0, values, expected));
+  }
+
+  /* Room for two chunks and a half, to be shared by both caches */
+  int64_t budget = blosc2_get_memory_usage() + 5 * (int64_t) chunksize / 2;
+  CUTEST_ASSERT("Cannot set the budget", blosc2_set_memory_budget(budget) == 0);
+  for (int n = 0; n < 2; n++) {
+    CUTEST_ASSERT("Cannot enable the cache", blosc2_schunk_set_chunk_cache(schunks[n], 10 * (int64_t) chunksize) == 0);
+  }
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    CUTEST_ASSERT("Wrong chunk", read_chunk(schunks[0], 0, nchunk, values, expected));
+    CUTEST_ASSERT("Over the budget", blosc2_get_memory_usage() <= budget);
+  }
+  CUTEST_ASSERT("Wrong size of the cache", cache_nbytes(schunks[0]) > 0 &&
+                                           cache_nbytes(schunks[0]) <= 5 * (int64_t) chunksize / 2);
+  /* The first cache gives room to the second one as it is used */
+  for (int round = 0; round < 2; round++) {
+    for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+      CUTEST_ASSERT("Wrong chunk", read_chunk(schunks[1], 1, nchunk, values, expected));
+      CUTEST_ASSERT("Over the budget", blosc2_get_memory_usage() <= budget);
+      CUTEST_ASSERT("Wrong chunk", read_chunk(schunks[0], 0, NCHUNKS - 1, values, expected));
+      CUTEST_ASSERT("Over the budget", blosc2_get_memory_usage() <= budget);
+    }
+  }
+  CUTEST_ASSERT("The second cache is starved", cache_nbytes(schunks[1]) > 0);
+  CUTEST_ASSERT("Wrong size of the caches",
+                cache_nbytes(schunks[0]) + cache_nbytes(schunks[1]) <= 5 * (int64_t) chunksize / 2);
+
+  /* The chunks read ahead that do not fit are read as usual */
+  if (persistent) {
+    CUTEST_ASSERT("Cannot disable the cache", blosc2_schunk_set_chunk_cache(schunks[0], 0) == 0);
+    budget = blosc2_get_memory_usage() + 16;
+    blosc2_set_memory_budget(budget);
+    CUTEST_ASSERT("Cannot read ahead", blosc2_schunk_set_prefetch(schunks[0], 2) == 0);
+    for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+      fill_chunk(0, nchunk, expected);
+      CUTEST_ASSERT("Cannot decompress",
+                    blosc2_schunk_decompress_chunk(schunks[0], nchunk, values, chunksize) == chunksize);
+      CUTEST_ASSERT("Wrong chunk", memcmp(values, expected, chunksize) == 0);
+      CUTEST_ASSERT("Over the budget", blosc2_get_memory_usage() <= budget);
+    }
+    CUTEST_ASSERT("Cannot stop reading ahead", blosc2_schunk_set_prefetch(schunks[0], 0) == 0);
+  }
+
+  /* Everything is given back, and the idle memory is released along with a smaller budget */
+  for (int n = 0; n < 2; n++) {
+    blosc2_schunk_free(schunks[n]);
+    blosc2_remove_urlpath(urlpaths[n]);
+  }
+  CUTEST_ASSERT("Wrong previous budget", blosc2_set_memory_budget(1) == budget);
+  CUTEST_ASSERT("Memory is still charged", blosc2_get_memory_usage() == 0);
+  CUTEST_ASSERT("A negative budget is set", blosc2_set_memory_budget(-1) < 0);
+  blosc2_set_memory_budget(0);
+  free(expected);
+  free(values);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(memory_budget) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(memory_budget);
+}
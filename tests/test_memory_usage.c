@@ -0,0 +1,139 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the breakdown of the memory used by super-chunks and contexts.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (50 * 1000)
+#define NCHUNKS 5
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+} test_memory_usage_backend;
+
+CUTEST_TEST_DATA(memory_usage) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(memory_usage) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.compcode = BLOSC_ZSTD;
+  data->cparams.clevel = 1;
+
+  CUTEST_PARAMETRIZE(backend, test_memory_usage_backend, CUTEST_DATA(
+      {false, NULL},
+      {true, NULL},
+      {true, "test_memory_usage.b2frame"},
+      {false, "test_memory_usage_s.b2frame"},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 4));
+}
+
+
+static bool ctx_total_adds_up(blosc2_ctx_memory *usage) {
+  return usage->total == usage->context + usage->scratch + usage->codecs + usage->dicts + usage->blocks;
+}
+
+
+CUTEST_TEST_TEST(memory_usage) {
+  CUTEST_GET_PARAMETER(backend, test_memory_usage_backend);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  blosc2_remove_urlpath(backend.urlpath);
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  int32_t *values = malloc(chunksize);
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    values[i] = i * 31;
+  }
+
+  /* A context holds its scratch and the states of its codecs once used */
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = (int16_t) nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_ctx_memory ctx_usage;
+  CUTEST_ASSERT("Cannot get the usage", blosc2_ctx_memory_usage(cctx, &ctx_usage) == 0);
+  CUTEST_ASSERT("Wrong usage of a new context", ctx_usage.context > 0 && ctx_usage.codecs == 0 &&
+                                                ctx_total_adds_up(&ctx_usage));
+  uint8_t *cchunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", blosc2_compress_ctx(cctx, values, chunksize, cchunk,
+                                                       chunksize + BLOSC2_MAX_OVERHEAD) > 0);
+  CUTEST_ASSERT("Cannot get the usage", blosc2_ctx_memory_usage(cctx, &ctx_usage) == 0);
+  CUTEST_ASSERT("Wrong usage of a used context", ctx_usage.scratch > 0 && ctx_usage.codecs > 0 &&
+                                                 ctx_total_adds_up(&ctx_usage));
+  blosc2_free_ctx(cctx);
+  free(cchunk);
+  CUTEST_ASSERT("A NULL context is taken", blosc2_ctx_memory_usage(NULL, &ctx_usage) < 0);
+
+  /* A super-chunk holds its contexts, chunks and metalayers */
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+  uint8_t content[1000] = {0};
+  CUTEST_ASSERT("Cannot add the metalayer", blosc2_meta_add(schunk, "meta", content, 100) >= 0);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    CUTEST_ASSERT("Cannot append", blosc2_schunk_append_buffer(schunk, values, chunksize) == nchunk + 1);
+  }
+  CUTEST_ASSERT("Cannot add the vlmetalayer", blosc2_vlmeta_add(schunk, "vlmeta", content, sizeof(content), NULL) >= 0);
+  blosc2_schunk_memory usage;
+  CUTEST_ASSERT("Cannot get the usage", blosc2_schunk_memory_usage(schunk, &usage) == 0);
+  CUTEST_ASSERT("Wrong total", usage.total == usage.schunk + usage.contexts.total + usage.chunks + usage.frame +
+                                              usage.metalayers + usage.caches);
+  CUTEST_ASSERT("Wrong contexts", usage.contexts.scratch > 0 && usage.contexts.codecs > 0 &&
+                                  ctx_total_adds_up(&usage.contexts));
+  CUTEST_ASSERT("Wrong metalayers", usage.metalayers >= 100);
+  if (backend.urlpath == NULL) {
+    CUTEST_ASSERT("Wrong chunks in memory", usage.chunks >= schunk->cbytes);
+  }
+  else {
+    CUTEST_ASSERT("Chunks on disk are counted", usage.chunks == 0);
+  }
+  CUTEST_ASSERT("Wrong frame", backend.contiguous || backend.urlpath != NULL ? usage.frame > 0 : usage.frame == 0);
+  CUTEST_ASSERT("Wrong caches", usage.caches == 0);
+
+  /* The chunk cache is counted as long as it lasts */
+  CUTEST_ASSERT("Cannot enable the cache", blosc2_schunk_set_chunk_cache(schunk, 3 * (int64_t) chunksize) == 0);
+  for (int64_t nchunk = 0; nchunk < 2; nchunk++) {
+    CUTEST_ASSERT("Cannot read", blosc2_schunk_get_slice_buffer(schunk, nchunk * CHUNKITEMS, (nchunk + 1) * CHUNKITEMS,
+                                                                values) == 0);
+  }
+  CUTEST_ASSERT("Cannot get the usage", blosc2_schunk_memory_usage(schunk, &usage) == 0);
+  CUTEST_ASSERT("Wrong caches", usage.caches >= 2 * (int64_t) chunksize);
+  CUTEST_ASSERT("Cannot disable the cache", blosc2_schunk_set_chunk_cache(schunk, 0) == 0);
+  CUTEST_ASSERT("Cannot get the usage", blosc2_schunk_memory_usage(schunk, &usage) == 0);
+  CUTEST_ASSERT("Wrong caches", usage.caches == 0);
+
+  /* And so are the contexts of the concurrent reads */
+  int64_t contexts = usage.contexts.total;
+  CUTEST_ASSERT("Cannot enable concurrent reads", blosc2_schunk_set_concurrent_reads(schunk, 2) == 0);
+  CUTEST_ASSERT("Cannot get the usage", blosc2_schunk_memory_usage(schunk, &usage) == 0);
+  CUTEST_ASSERT("Wrong contexts", usage.contexts.total > contexts);
+  CUTEST_ASSERT("Cannot disable concurrent reads", blosc2_schunk_set_concurrent_reads(schunk, 0) == 0);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+  free(values);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(memory_usage) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(memory_usage);
+}
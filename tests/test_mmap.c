@@ -0,0 +1,171 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the memory-mapped io (BLOSC2_IO_FILESYSTEM_MMAP).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS 10
+#define NCHUNKS_APPEND 3
+
+
+typedef struct {
+  int nthreads;
+  bool created_with_mmap;
+} test_mmap_backend;
+
+CUTEST_TEST_DATA(mmap) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(mmap) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.clevel = 5;
+
+  CUTEST_PARAMETRIZE(backend, test_mmap_backend, CUTEST_DATA(
+      {1, true},
+      {2, true},
+      {1, false},
+      {2, false},
+  ));
+}
+
+
+static int fill_chunk(int32_t *buffer, int nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = nchunk * CHUNKSIZE + j;
+  }
+  return 0;
+}
+
+
+CUTEST_TEST_TEST(mmap) {
+  CUTEST_GET_PARAMETER(backend, test_mmap_backend);
+
+  char *urlpath = "test_mmap.b2frame";
+  blosc2_remove_urlpath(urlpath);
+
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  int32_t *rec_buffer = malloc(nbytes);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = backend.nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = backend.nthreads;
+
+  /* Create the frame, either through a mapping or with regular files */
+  blosc2_stdio_mmap mmap_write = BLOSC2_STDIO_MMAP_DEFAULTS;
+  mmap_write.mode = "w+";
+  blosc2_io io_write = {.id = BLOSC2_IO_FILESYSTEM_MMAP, .name = "filesystem_mmap", .params = &mmap_write};
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .contiguous=true, .urlpath=urlpath};
+  if (backend.created_with_mmap) {
+    storage.io = &io_write;
+  }
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; ++i) {
+    fill_chunk(data_buffer, i);
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, nbytes);
+    CUTEST_ASSERT("Error during compression", nchunks == i + 1);
+  }
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Error unmapping the frame", blosc2_stdio_mmap_destroy(&mmap_write) == 0);
+
+  /* Read it back through a read-only mapping */
+  blosc2_stdio_mmap mmap_read = BLOSC2_STDIO_MMAP_DEFAULTS;
+  blosc2_io io_read = {.id = BLOSC2_IO_FILESYSTEM_MMAP, .name = "filesystem_mmap", .params = &mmap_read};
+  schunk = blosc2_schunk_open_udio(urlpath, &io_read);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS);
+
+  for (int i = 0; i < NCHUNKS; ++i) {
+    uint8_t *chunk;
+    bool needs_free;
+    int cbytes = blosc2_schunk_get_chunk(schunk, i, &chunk, &needs_free);
+    CUTEST_ASSERT("Error getting the chunk", cbytes > 0);
+    CUTEST_ASSERT("Chunks of a mapped frame must not be copied", !needs_free);
+
+    int32_t dbytes = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes);
+    CUTEST_ASSERT("Error during decompression", dbytes == nbytes);
+    fill_chunk(data_buffer, i);
+    for (int j = 0; j < CHUNKSIZE; ++j) {
+      CUTEST_ASSERT("Data are not equal", data_buffer[j] == rec_buffer[j]);
+    }
+  }
+
+  /* A slice crossing chunks (and blocks) */
+  int64_t start = CHUNKSIZE / 2;
+  int64_t stop = 2 * CHUNKSIZE + CHUNKSIZE / 3;
+  int32_t *slice = malloc((stop - start) * sizeof(int32_t));
+  CUTEST_ASSERT("Error getting the slice", blosc2_schunk_get_slice_buffer(schunk, start, stop, slice) >= 0);
+  for (int64_t j = start; j < stop; ++j) {
+    CUTEST_ASSERT("Slice data are not equal", slice[j - start] == (int32_t) j);
+  }
+  free(slice);
+
+  /* The read-only mapping cannot be written */
+  fill_chunk(data_buffer, NCHUNKS);
+  CUTEST_ASSERT("Appending to a read-only mapping must fail",
+                blosc2_schunk_append_buffer(schunk, data_buffer, nbytes) < 0);
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Error unmapping the frame", blosc2_stdio_mmap_destroy(&mmap_read) == 0);
+
+  /* Grow the frame through a read-write mapping */
+  blosc2_stdio_mmap mmap_update = BLOSC2_STDIO_MMAP_DEFAULTS;
+  mmap_update.mode = "r+";
+  blosc2_io io_update = {.id = BLOSC2_IO_FILESYSTEM_MMAP, .name = "filesystem_mmap", .params = &mmap_update};
+  schunk = blosc2_schunk_open_udio(urlpath, &io_update);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  for (int i = NCHUNKS; i < NCHUNKS + NCHUNKS_APPEND; ++i) {
+    /* Read a chunk first, so that a mapping of the smaller file exists */
+    int32_t dbytes = blosc2_schunk_decompress_chunk(schunk, i - 1, rec_buffer, nbytes);
+    CUTEST_ASSERT("Error during decompression", dbytes == nbytes);
+    fill_chunk(data_buffer, i);
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, nbytes);
+    CUTEST_ASSERT("Error during compression", nchunks == i + 1);
+  }
+  for (int i = 0; i < NCHUNKS + NCHUNKS_APPEND; ++i) {
+    int32_t dbytes = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes);
+    CUTEST_ASSERT("Error during decompression", dbytes == nbytes);
+    fill_chunk(data_buffer, i);
+    for (int j = 0; j < CHUNKSIZE; ++j) {
+      CUTEST_ASSERT("Data are not equal", data_buffer[j] == rec_buffer[j]);
+    }
+  }
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("Error unmapping the frame", blosc2_stdio_mmap_destroy(&mmap_update) == 0);
+
+  /* And check the result with the regular io */
+  schunk = blosc2_schunk_open(urlpath);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS + NCHUNKS_APPEND);
+  int32_t dbytes = blosc2_schunk_decompress_chunk(schunk, NCHUNKS + NCHUNKS_APPEND - 1, rec_buffer, nbytes);
+  CUTEST_ASSERT("Error during decompression", dbytes == nbytes);
+  CUTEST_ASSERT("Data are not equal", rec_buffer[CHUNKSIZE - 1] == data_buffer[CHUNKSIZE - 1]);
+  blosc2_schunk_free(schunk);
+
+  blosc2_remove_urlpath(urlpath);
+  free(data_buffer);
+  free(rec_buffer);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(mmap) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(mmap);
+}
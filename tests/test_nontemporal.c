@@ -0,0 +1,113 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the decompression into dest with non-temporal stores.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (200 * 1000 + 3)
+#define BLOCKSIZE (32 * 1024)
+
+
+typedef struct {
+  uint8_t filter;
+  uint8_t filter_meta;
+} test_filter;
+
+CUTEST_TEST_DATA(nontemporal) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(nontemporal) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int64_t);
+
+  CUTEST_PARAMETRIZE(filter, test_filter, CUTEST_DATA(
+      {BLOSC_NOFILTER, 0},
+      {BLOSC_SHUFFLE, 0},
+      {BLOSC_SHUFFLE, 1},
+      {BLOSC_BITSHUFFLE, 0},
+      {BLOSC_DELTA, 0},
+  ));
+  CUTEST_PARAMETRIZE(clevel, int, CUTEST_DATA(0, 5));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 4));
+  CUTEST_PARAMETRIZE(misalign, int, CUTEST_DATA(0, 5));
+}
+
+
+CUTEST_TEST_TEST(nontemporal) {
+  CUTEST_GET_PARAMETER(filter, test_filter);
+  CUTEST_GET_PARAMETER(clevel, int);
+  CUTEST_GET_PARAMETER(nthreads, int);
+  CUTEST_GET_PARAMETER(misalign, int);
+
+  int32_t nbytes = CHUNKITEMS * sizeof(int64_t);
+  int64_t *src = malloc(nbytes);
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    src[i] = i * 3 + (i % 7);
+  }
+  blosc2_cparams cparams = data->cparams;
+  cparams.clevel = clevel;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = (int16_t) nthreads;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter.filter;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 1] = filter.filter_meta;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(cctx, src, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", cbytes > 0);
+  blosc2_free_ctx(cctx);
+
+  // Whatever the hint, the chunk decompresses the same (a misaligned dest too)
+  uint8_t *buffer = malloc(nbytes + misalign);
+  int modes[] = {BLOSC2_NONTEMPORAL_AUTO, BLOSC2_NONTEMPORAL_NEVER, BLOSC2_NONTEMPORAL_ALWAYS};
+  for (int m = 0; m < 3; m++) {
+    blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+    dparams.nthreads = (int16_t) nthreads;
+    dparams.nontemporal = modes[m];
+    blosc2_context *dctx = blosc2_create_dctx(dparams);
+    memset(buffer, 0, nbytes + misalign);
+    CUTEST_ASSERT("Cannot decompress",
+                  blosc2_decompress_ctx(dctx, chunk, cbytes, buffer + misalign, nbytes) == nbytes);
+    CUTEST_ASSERT("Wrong values", memcmp(buffer + misalign, src, nbytes) == 0);
+
+    // A getitem after a streamed decompression goes as usual
+    int64_t items[10];
+    CUTEST_ASSERT("Cannot get the items",
+                  blosc2_getitem_ctx(dctx, chunk, cbytes, CHUNKITEMS / 2, 10, items, sizeof(items)) == sizeof(items));
+    CUTEST_ASSERT("Wrong items", memcmp(items, src + CHUNKITEMS / 2, sizeof(items)) == 0);
+
+    blosc2_dparams dparams2;
+    blosc2_ctx_get_dparams(dctx, &dparams2);
+    CUTEST_ASSERT("The hint is not kept", dparams2.nontemporal == modes[m]);
+    blosc2_free_ctx(dctx);
+  }
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nontemporal = BLOSC2_NONTEMPORAL_ALWAYS + 1;
+  CUTEST_ASSERT("A wrong hint is taken", blosc2_create_dctx(dparams) == NULL);
+
+  free(buffer);
+  free(chunk);
+  free(src);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(nontemporal) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(nontemporal);
+}
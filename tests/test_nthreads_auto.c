@@ -0,0 +1,123 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the contexts that decide in every call how many threads to engage (BLOSC2_NTHREADS_AUTO).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define BLOCKSIZE (8 * 1024)
+
+
+CUTEST_TEST_DATA(nthreads_auto) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(nthreads_auto) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  // Calls of 2 blocks and of 256 blocks, one after the other
+  CUTEST_PARAMETRIZE(nblocks, int32_t, CUTEST_DATA(2, 256));
+  CUTEST_PARAMETRIZE(scheduler, int, CUTEST_DATA(BLOSC_DEFAULT_SCHED, BLOSC_WORKSTEALING_SCHED));
+  CUTEST_PARAMETRIZE(from_env, bool, CUTEST_DATA(false, true));
+  // Threads of the contexts, or of the shared pool
+  CUTEST_PARAMETRIZE(pool, bool, CUTEST_DATA(false, true));
+}
+
+
+CUTEST_TEST_TEST(nthreads_auto) {
+  CUTEST_GET_PARAMETER(nblocks, int32_t);
+  CUTEST_GET_PARAMETER(scheduler, int);
+  CUTEST_GET_PARAMETER(from_env, bool);
+  CUTEST_GET_PARAMETER(pool, bool);
+
+  if (from_env) {
+    setenv("BLOSC_NTHREADS", "AUTO", 1);
+    blosc2_reload_env();
+  }
+  if (pool) {
+    CUTEST_ASSERT("Cannot create the shared pool", blosc2_set_shared_threadpool(4) == 0);
+  }
+
+  int32_t nbytes = 256 * BLOCKSIZE;
+  int32_t *src = malloc(nbytes);
+  int32_t *dest = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  for (int32_t i = 0; i < nbytes / (int32_t) sizeof(int32_t); i++) {
+    src[i] = i * 3 + (i % 11);
+  }
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = from_env ? 2 : BLOSC2_NTHREADS_AUTO;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.scheduler = scheduler;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = from_env ? 2 : BLOSC2_NTHREADS_AUTO;
+  dparams.scheduler = scheduler;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+
+  blosc2_cparams cparams2;
+  CUTEST_ASSERT("Cannot get the cparams", blosc2_ctx_get_cparams(cctx, &cparams2) == 0);
+  CUTEST_ASSERT("The cparams are not automatic", cparams2.nthreads == BLOSC2_NTHREADS_AUTO);
+  blosc2_dparams dparams2;
+  CUTEST_ASSERT("Cannot get the dparams", blosc2_ctx_get_dparams(dctx, &dparams2) == 0);
+  CUTEST_ASSERT("The dparams are not automatic", dparams2.nthreads == BLOSC2_NTHREADS_AUTO);
+
+  // Mixed sizes: the estimate of the time per block carries over from a call to the next
+  int32_t sizes[] = {nblocks * BLOCKSIZE, (258 - nblocks) * BLOCKSIZE, nblocks * BLOCKSIZE};
+  for (int i = 0; i < (int) (sizeof(sizes) / sizeof(int32_t)); i++) {
+    for (int j = 0; j < 20; j++) {
+      src[0] = i * 100 + j;
+      int cbytes = blosc2_compress_ctx(cctx, src, sizes[i], chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+      CUTEST_ASSERT("Cannot compress", cbytes > 0);
+      CUTEST_ASSERT("Cannot decompress", blosc2_decompress_ctx(dctx, chunk, cbytes, dest, nbytes) == sizes[i]);
+      CUTEST_ASSERT("Wrong decompressed data", memcmp(src, dest, sizes[i]) == 0);
+    }
+  }
+  int32_t item;
+  int cbytes = blosc2_compress_ctx(cctx, src, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot get the item", blosc2_getitem_ctx(dctx, chunk, cbytes, 12345, 1, &item, sizeof(item)) == sizeof(item));
+  CUTEST_ASSERT("Wrong item", item == src[12345]);
+
+  // The calls of 2 blocks are not worth more than a thread
+  blosc2_context *dctx2 = blosc2_create_dctx(dparams);
+  cbytes = blosc2_compress_ctx(cctx, src, 2 * BLOCKSIZE, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  for (int j = 0; j < 20; j++) {
+    CUTEST_ASSERT("Cannot decompress", blosc2_decompress_ctx(dctx2, chunk, cbytes, dest, nbytes) == 2 * BLOCKSIZE);
+  }
+  blosc2_ctx_stats stats;
+  CUTEST_ASSERT("Cannot get the stats", blosc2_ctx_get_stats(dctx2, &stats) == 0);
+  CUTEST_ASSERT("Small calls go parallel", stats.idle_ns == 0);
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  blosc2_free_ctx(dctx2);
+  free(src);
+  free(dest);
+  free(chunk);
+  if (pool) {
+    blosc2_set_shared_threadpool(0);
+  }
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(nthreads_auto) {
+  BLOSC_UNUSED_PARAM(data);
+  unsetenv("BLOSC_NTHREADS");
+  blosc2_reload_env();
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(nthreads_auto);
+}
@@ -0,0 +1,224 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for reading frames out of an object store, with range requests.
+*/
+
+#include "test_common.h"
+#include "b2nd.h"
+#include "cutest.h"
+
+#if defined(_WIN32) && !defined(__GNUC__)
+#include "win32/pthread.h"
+#else
+#include <pthread.h>
+#endif
+
+#define NROWS 400
+#define NCOLS 500
+#define CHUNKROWS 100
+#define CHUNKCOLS 100
+#define BLOCKROWS 25
+#define BLOCKCOLS 25
+#define URLPATH "test_objstore.b2nd"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+/* The object store is the local filesystem, and the requests are counted */
+typedef struct {
+  int64_t ngets;
+  int64_t nsizes;
+  pthread_mutex_t mutex;
+} test_store;
+
+CUTEST_TEST_DATA(objstore) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(objstore) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 4));
+}
+
+
+static int64_t store_get(void *user_data, const char *urlpath, int64_t offset, int64_t size, void *buf) {
+  test_store *store = user_data;
+  pthread_mutex_lock(&store->mutex);
+  store->ngets++;
+  pthread_mutex_unlock(&store->mutex);
+  FILE *fp = fopen(urlpath, "rb");
+  if (fp == NULL) {
+    return -1;
+  }
+  int64_t nread = -1;
+  if (fseek(fp, (long) offset, SEEK_SET) == 0) {
+    nread = (int64_t) fread(buf, 1, (size_t) size, fp);
+  }
+  fclose(fp);
+  return nread;
+}
+
+static int64_t store_size(void *user_data, const char *urlpath) {
+  test_store *store = user_data;
+  pthread_mutex_lock(&store->mutex);
+  store->nsizes++;
+  pthread_mutex_unlock(&store->mutex);
+  struct stat path_stat;
+  if (stat(urlpath, &path_stat) < 0 || (path_stat.st_mode & S_IFDIR)) {
+    return -1;
+  }
+  return (int64_t) path_stat.st_size;
+}
+
+static int32_t item_value(int64_t row, int64_t col) {
+  return (int32_t) (row * NCOLS + col);
+}
+
+static int check_slice(b2nd_array_t *array, int64_t row0, int64_t col0, int64_t row1, int64_t col1) {
+  int64_t start[2] = {row0, col0};
+  int64_t stop[2] = {row1, col1};
+  int64_t shape[2] = {row1 - row0, col1 - col0};
+  int64_t size = shape[0] * shape[1] * (int64_t) sizeof(int32_t);
+  int32_t *buffer = malloc(size);
+  int errors = 0;
+  if (b2nd_get_slice_cbuffer(array, start, stop, buffer, shape, size) < 0) {
+    errors++;
+  }
+  else {
+    for (int64_t i = 0; i < shape[0]; i++) {
+      for (int64_t j = 0; j < shape[1]; j++) {
+        errors += buffer[i * shape[1] + j] != item_value(row0 + i, col0 + j);
+      }
+    }
+  }
+  free(buffer);
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(objstore) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tstorage.urlpath,
+                            .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  int64_t shape[2] = {NROWS, NCOLS};
+  int32_t chunkshape[2] = {CHUNKROWS, CHUNKCOLS};
+  int32_t blockshape[2] = {BLOCKROWS, BLOCKCOLS};
+  b2nd_context_t *ctx = b2nd_create_ctx(&storage, 2, shape, chunkshape, blockshape, NULL, 0, NULL, 0);
+  int32_t *buffer = malloc(NROWS * NCOLS * sizeof(int32_t));
+  for (int64_t i = 0; i < NROWS; i++) {
+    for (int64_t j = 0; j < NCOLS; j++) {
+      buffer[i * NCOLS + j] = item_value(i, j);
+    }
+  }
+  b2nd_array_t *array;
+  CUTEST_ASSERT("Cannot create the array",
+                b2nd_from_cbuffer(ctx, &array, buffer, NROWS * NCOLS * sizeof(int32_t)) == 0);
+  int64_t nchunks = array->sc->nchunks;
+  b2nd_free(array);
+  b2nd_free_ctx(ctx);
+
+  test_store store = {0};
+  pthread_mutex_init(&store.mutex, NULL);
+  blosc2_stdio_objstore objstore = BLOSC2_STDIO_OBJSTORE_DEFAULTS;
+  objstore.get = store_get;
+  objstore.size = store_size;
+  objstore.user_data = &store;
+  objstore.page_size = 16 * 1024;
+  objstore.nthreads = nthreads;
+  blosc2_io io = {.id = BLOSC2_IO_OBJECT_STORE, .name = "object_store", .params = &objstore};
+
+  // The objects are read-only
+  CUTEST_ASSERT("An object is opened for writing", blosc2_stdio_objstore_open(URLPATH, "wb", &objstore) == NULL);
+  CUTEST_ASSERT("A missing array is opened", b2nd_open_udio("missing.b2nd", &array, &io) < 0);
+
+  // Opening the array and getting a slice across 6 chunks takes a handful of requests
+  int64_t nrequests0;
+  int64_t nrequests;
+  blosc2_stdio_objstore_get_stats(&objstore, &nrequests0, NULL);
+  CUTEST_ASSERT("Cannot open the array", b2nd_open_udio(tstorage.urlpath, &array, &io) == 0);
+  CUTEST_ASSERT("Wrong slice", check_slice(array, 80, 90, 130, 260) == 0);
+  blosc2_stdio_objstore_get_stats(&objstore, &nrequests, NULL);
+  CUTEST_ASSERT("Wrong stats", nrequests == store.ngets + store.nsizes);
+  // Both ends of the frame, and at most a request per chunk (plus their sizes in sparse frames)
+  CUTEST_ASSERT("Too many requests", nrequests - nrequests0 <= (tstorage.contiguous ? 1 + 2 + 6 : 2 + 2 * (1 + 6)));
+
+  // What is cached is not requested again
+  int64_t nrequests2;
+  CUTEST_ASSERT("Wrong slice", check_slice(array, 85, 95, 125, 255) == 0);
+  blosc2_stdio_objstore_get_stats(&objstore, &nrequests2, NULL);
+  CUTEST_ASSERT("The slice is requested again", nrequests2 == nrequests);
+  CUTEST_ASSERT("Wrong slice", check_slice(array, 0, 0, NROWS, NCOLS) == 0);
+
+  // The chunks of a batch are requested together
+  b2nd_free(array);
+  blosc2_stdio_objstore_destroy(&objstore);
+  CUTEST_ASSERT("Cannot set the shared pool", blosc2_set_shared_threadpool(4) == 0);
+  blosc2_schunk *schunk = blosc2_schunk_open_udio(tstorage.urlpath, &io);
+  CUTEST_ASSERT("Cannot open the super-chunk", schunk != NULL);
+  blosc2_stdio_objstore_get_stats(&objstore, &nrequests, NULL);
+  void **dests = malloc(nchunks * sizeof(void *));
+  int32_t *nbytes = malloc(nchunks * sizeof(int32_t));
+  for (int64_t i = 0; i < nchunks; i++) {
+    dests[i] = malloc(schunk->chunksize);
+    nbytes[i] = schunk->chunksize;
+  }
+  CUTEST_ASSERT("Cannot decompress the chunks",
+                blosc2_schunk_decompress_chunks(schunk, 0, (int) nchunks, dests, nbytes) ==
+                nchunks * schunk->chunksize);
+  blosc2_stdio_objstore_get_stats(&objstore, &nrequests2, NULL);
+  // The chunks of a sparse frame are objects of their own
+  CUTEST_ASSERT("Too many requests", nrequests2 - nrequests <= (tstorage.contiguous ? 4 : 2 * nchunks + 2));
+  // The first chunk is the (0, 0) one
+  int errors = 0;
+  for (int64_t i = 0; i < CHUNKROWS * CHUNKCOLS; i++) {
+    int64_t row = (i / (BLOCKROWS * BLOCKCOLS)) / (CHUNKCOLS / BLOCKCOLS) * BLOCKROWS + i % (BLOCKROWS * BLOCKCOLS) / BLOCKCOLS;
+    int64_t col = (i / (BLOCKROWS * BLOCKCOLS)) % (CHUNKCOLS / BLOCKCOLS) * BLOCKCOLS + i % BLOCKCOLS;
+    errors += ((int32_t *) dests[0])[i] != item_value(row, col);
+  }
+  CUTEST_ASSERT("Wrong values", errors == 0);
+  for (int64_t i = 0; i < nchunks; i++) {
+    free(dests[i]);
+  }
+  free(dests);
+  free(nbytes);
+  blosc2_schunk_free(schunk);
+  blosc2_set_shared_threadpool(0);
+
+  blosc2_stdio_objstore_destroy(&objstore);
+  pthread_mutex_destroy(&store.mutex);
+  free(buffer);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(objstore) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(objstore);
+}
@@ -0,0 +1,211 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the bit-packed chunk offsets index of frames (BLOSC2_INDEX_PACKED).
+*/
+
+#include "test_common.h"
+#include "frame.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 1000
+#define NCHUNKS 300
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  char *urlpath2;
+} test_packed_index_backend;
+
+CUTEST_TEST_DATA(packed_index) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(packed_index) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_packed_index_backend, CUTEST_DATA(
+      {true, NULL, NULL},
+      {true, "test_packed_index.b2frame", "test_packed_index2.b2frame"},
+      {false, "test_packed_index_s.b2frame", "test_packed_index2_s.b2frame"},
+  ));
+}
+
+
+/* Chunks of other sizes every time, so that the offsets do not go in a line */
+static void fill_chunk(int32_t *buffer, int64_t nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = (int32_t)(j % (1 + nchunk % 17) == 0 ? nchunk * 7919 + j * 31 : nchunk);
+  }
+}
+
+static int64_t add_chunk(blosc2_schunk *schunk, int64_t nchunk, bool insert) {
+  int32_t data[CHUNKSIZE];
+  uint8_t chunk[CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD];
+  fill_chunk(data, nchunk);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, data, sizeof(data), chunk, sizeof(chunk));
+  if (cbytes < 0) {
+    return cbytes;
+  }
+  if (insert) {
+    return blosc2_schunk_insert_chunk(schunk, nchunk, chunk, true);
+  }
+  return blosc2_schunk_update_chunk(schunk, nchunk, chunk, true);
+}
+
+/* Chunk nchunk has to hold the data for chunk `id`, or zeros if `id` is negative */
+static bool check_chunk(blosc2_schunk *schunk, int64_t nchunk, int64_t id) {
+  int32_t data[CHUNKSIZE];
+  int32_t rec[CHUNKSIZE];
+  if (id < 0) {
+    memset(data, 0, sizeof(data));
+  }
+  else {
+    fill_chunk(data, id);
+  }
+  int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, rec, sizeof(rec));
+  return dsize == (int)sizeof(rec) && memcmp(data, rec, sizeof(rec)) == 0;
+}
+
+/* The offsets of both super-chunks, which only differ in their index, have to be the same */
+static bool same_offsets(blosc2_schunk *schunk, blosc2_schunk *schunk2) {
+  if (schunk->nchunks != schunk2->nchunks) {
+    return false;
+  }
+  int64_t *offsets = blosc2_frame_get_offsets(schunk);
+  int64_t *offsets2 = blosc2_frame_get_offsets(schunk2);
+  bool same = offsets != NULL && offsets2 != NULL &&
+              memcmp(offsets, offsets2, (size_t)schunk->nchunks * sizeof(int64_t)) == 0;
+  free(offsets2);
+  free(offsets);
+  return same;
+}
+
+static bool check_version(blosc2_schunk *schunk, int version) {
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  if (len < FRAME_HEADER_MINLEN) {
+    return false;
+  }
+  bool ok = (cframe[FRAME_FLAGS] & 0x0f) == version && (cframe[FRAME_FLAGS] & FRAME_INDEX_TWO_LEVELS) == 0;
+  if (needs_free) {
+    free(cframe);
+  }
+  return ok;
+}
+
+
+CUTEST_TEST_TEST(packed_index) {
+  CUTEST_GET_PARAMETER(backend, test_packed_index_backend);
+
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_remove_urlpath(backend.urlpath2);
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath,
+                            .index_format=BLOSC2_INDEX_PACKED};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  // The same super-chunk with an index chunk
+  storage.urlpath = backend.urlpath2;
+  storage.index_format = BLOSC2_INDEX_CHUNK;
+  blosc2_schunk *schunk2 = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk2 != NULL);
+
+  /* Special chunks, then appends, inserts, updates and deletes */
+  int64_t nchunks = blosc2_schunk_fill_special(schunk, 10 * CHUNKSIZE, BLOSC2_SPECIAL_ZERO,
+                                               CHUNKSIZE * sizeof(int32_t));
+  CUTEST_ASSERT("Error filling the super-chunk", nchunks == 10);
+  CUTEST_ASSERT("Wrong data of a special chunk", check_chunk(schunk, 9, -1));
+  blosc2_schunk_fill_special(schunk2, 10 * CHUNKSIZE, BLOSC2_SPECIAL_ZERO, CHUNKSIZE * sizeof(int32_t));
+  for (int64_t i = 10; i < NCHUNKS; i++) {
+    CUTEST_ASSERT("Error appending a chunk", add_chunk(schunk, i, true) == i + 1);
+    add_chunk(schunk2, i, true);
+  }
+  CUTEST_ASSERT("Error inserting a chunk", add_chunk(schunk, 3, true) == NCHUNKS + 1);
+  CUTEST_ASSERT("Error updating a chunk", add_chunk(schunk, 200, false) == NCHUNKS + 1);
+  CUTEST_ASSERT("Error deleting a chunk", blosc2_schunk_delete_chunk(schunk, 100) == NCHUNKS);
+  add_chunk(schunk2, 3, true);
+  add_chunk(schunk2, 200, false);
+  blosc2_schunk_delete_chunk(schunk2, 100);
+  CUTEST_ASSERT("Wrong offsets", same_offsets(schunk, schunk2));
+  CUTEST_ASSERT("Wrong version", check_version(schunk, BLOSC2_VERSION_FRAME_FORMAT_PACKED_INDEX));
+  CUTEST_ASSERT("Wrong version", check_version(schunk2, BLOSC2_VERSION_FRAME_FORMAT));
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, 2, -1));
+  CUTEST_ASSERT("Wrong data of the inserted chunk", check_chunk(schunk, 3, 3));
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, 11, 10));
+  CUTEST_ASSERT("Wrong data after deleting", check_chunk(schunk, 100, 100));
+  CUTEST_ASSERT("Wrong data of the updated chunk", check_chunk(schunk, 200, 200));
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, NCHUNKS - 1, NCHUNKS - 1));
+
+  /* The index is read back, and the format is kept */
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(backend.urlpath);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS);
+    CUTEST_ASSERT("Wrong data after reopening", check_chunk(schunk, NCHUNKS - 1, NCHUNKS - 1));
+    CUTEST_ASSERT("Wrong offsets after reopening", same_offsets(schunk, schunk2));
+    CUTEST_ASSERT("Error appending a chunk", add_chunk(schunk, NCHUNKS, true) == NCHUNKS + 1);
+    CUTEST_ASSERT("Wrong data after appending", check_chunk(schunk, NCHUNKS, NCHUNKS));
+  }
+  CUTEST_ASSERT("Wrong format", schunk->storage->index_format == BLOSC2_INDEX_PACKED);
+  CUTEST_ASSERT("Wrong version", check_version(schunk, BLOSC2_VERSION_FRAME_FORMAT_PACKED_INDEX));
+
+  /* The copies into buffers keep the packed index */
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  CUTEST_ASSERT("Error getting the buffer", len > 0);
+  blosc2_schunk *schunk3 = blosc2_schunk_from_buffer(cframe, len, false);
+  CUTEST_ASSERT("Error reading the buffer", schunk3 != NULL);
+  CUTEST_ASSERT("Wrong format of the copy", schunk3->storage->index_format == BLOSC2_INDEX_PACKED);
+  // Sparse frames go to contiguous ones, with offsets of another kind
+  CUTEST_ASSERT("Wrong offsets of the copy", !backend.contiguous || same_offsets(schunk, schunk3));
+  CUTEST_ASSERT("Wrong data of the copy", check_chunk(schunk3, 3, 3));
+  CUTEST_ASSERT("Wrong data of the copy", check_chunk(schunk3, NCHUNKS - 1, NCHUNKS - 1));
+  blosc2_schunk_free(schunk3);
+  if (needs_free) {
+    free(cframe);
+  }
+
+  blosc2_schunk_free(schunk2);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_remove_urlpath(backend.urlpath2);
+
+  /* A frame of special chunks only, with groups that have no bits at all */
+  storage.urlpath = backend.urlpath;
+  storage.index_format = BLOSC2_INDEX_PACKED;
+  schunk = blosc2_schunk_new(&storage);
+  nchunks = blosc2_schunk_fill_special(schunk, (int64_t)(FRAME_PACKED_INDEX_NOFFSETS * 3 + 5) * CHUNKSIZE,
+                                       BLOSC2_SPECIAL_ZERO, CHUNKSIZE * sizeof(int32_t));
+  CUTEST_ASSERT("Error filling the super-chunk", nchunks == FRAME_PACKED_INDEX_NOFFSETS * 3 + 5);
+  CUTEST_ASSERT("Error updating a chunk", add_chunk(schunk, nchunks - 1, false) == nchunks);
+  CUTEST_ASSERT("Wrong data", check_chunk(schunk, 0, -1));
+  CUTEST_ASSERT("Wrong data in the last group", check_chunk(schunk, nchunks - 1, nchunks - 1));
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+
+  /* Unknown formats are refused */
+  storage.index_format = BLOSC2_INDEX_PACKED + 1;
+  CUTEST_ASSERT("An unknown format is taken", blosc2_schunk_new(&storage) == NULL);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(packed_index) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(packed_index);
+}
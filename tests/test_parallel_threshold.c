@@ -0,0 +1,104 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the calls that run serially when the threads would get too little work
+  (BLOSC_PARALLEL_THRESHOLD), and for the threads synchronizing on lots of short calls.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NCALLS 500
+
+
+CUTEST_TEST_DATA(parallel_threshold) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(parallel_threshold) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.nthreads = 4;
+
+  CUTEST_PARAMETRIZE(nbytes, int32_t, CUTEST_DATA(64 * 1024, 256 * 1024, 4 * 1024 * 1024));
+  CUTEST_PARAMETRIZE(threshold, char *, CUTEST_DATA("", "0", "1000000000"));
+  // Threads of the contexts, or of the shared pool
+  CUTEST_PARAMETRIZE(pool, bool, CUTEST_DATA(false, true));
+}
+
+
+CUTEST_TEST_TEST(parallel_threshold) {
+  CUTEST_GET_PARAMETER(nbytes, int32_t);
+  CUTEST_GET_PARAMETER(threshold, char *);
+  CUTEST_GET_PARAMETER(pool, bool);
+
+  if (threshold[0] == '\0') {
+    unsetenv("BLOSC_PARALLEL_THRESHOLD");
+  }
+  else {
+    setenv("BLOSC_PARALLEL_THRESHOLD", threshold, 1);
+  }
+  blosc2_reload_env();
+  if (pool) {
+    CUTEST_ASSERT("Cannot create the shared pool", blosc2_set_shared_threadpool(4) == 0);
+  }
+
+  int32_t *src = malloc(nbytes);
+  int32_t *dest = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  for (int32_t i = 0; i < nbytes / (int32_t) sizeof(int32_t); i++) {
+    src[i] = i * 3 + (i % 11);
+  }
+  blosc2_cparams cparams = data->cparams;
+  cparams.blocksize = 8 * 1024;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 4;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+
+  // Lots of short calls in a row
+  int ncalls = nbytes > 1024 * 1024 ? 10 : NCALLS;
+  for (int i = 0; i < ncalls; i++) {
+    src[0] = i;
+    int cbytes = blosc2_compress_ctx(cctx, src, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+    CUTEST_ASSERT("Cannot compress", cbytes > 0);
+    CUTEST_ASSERT("Cannot decompress", blosc2_decompress_ctx(dctx, chunk, cbytes, dest, nbytes) == nbytes);
+    CUTEST_ASSERT("Wrong decompressed data", memcmp(src, dest, nbytes) == 0);
+  }
+
+  // The threads only wait for each other in parallel calls
+  blosc2_ctx_stats stats;
+  CUTEST_ASSERT("Cannot get the stats", blosc2_ctx_get_stats(dctx, &stats) == 0);
+  int64_t per_thread = threshold[0] == '\0' ? 32 * 1024 : strtoll(threshold, NULL, 10);
+  if (nbytes / 4 < per_thread) {
+    CUTEST_ASSERT("Small calls go parallel", stats.idle_ns == 0);
+  }
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  free(src);
+  free(dest);
+  free(chunk);
+  if (pool) {
+    blosc2_set_shared_threadpool(0);
+  }
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(parallel_threshold) {
+  BLOSC_UNUSED_PARAM(data);
+  unsetenv("BLOSC_PARALLEL_THRESHOLD");
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(parallel_threshold);
+}
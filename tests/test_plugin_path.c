@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the codecs and filters that are loaded on demand, by id, from the
+  BLOSC_PLUGIN_PATH directories.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NITEMS (100 * 1000)
+#define NBYTES (NITEMS * (int32_t)sizeof(int32_t))
+#define PLUGIN_ID 250
+
+
+CUTEST_TEST_DATA(plugin_path) {
+  int32_t *src;
+  uint8_t *chunk;
+  int32_t *dest;
+};
+
+
+CUTEST_TEST_SETUP(plugin_path) {
+  setenv("BLOSC_PLUGIN_PATH", "/nonexistent:" PLUGIN_DIR, 1);
+  blosc2_init();
+  data->src = malloc(NBYTES);
+  data->chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(NBYTES);
+  for (int i = 0; i < NITEMS; i++) {
+    data->src[i] = i / 1000;
+  }
+
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 4));
+}
+
+
+CUTEST_TEST_TEST(plugin_path) {
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  // Nothing is loaded by a previous run
+  blosc2_destroy();
+  blosc2_init();
+  const char *compname;
+  blosc2_compcode_to_compname(PLUGIN_ID, &compname);
+  CUTEST_ASSERT("The codec is loaded at init", compname == NULL);
+
+  /* The codec and the filter that a context refers to are loaded */
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.compcode = PLUGIN_ID;
+  cparams.filters[0] = PLUGIN_ID;
+  cparams.nthreads = nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  CUTEST_ASSERT("Compression error", csize > 0 && csize < NBYTES / 10);
+  blosc2_compcode_to_compname(PLUGIN_ID, &compname);
+  CUTEST_ASSERT("The codec is not registered", compname != NULL && strcmp(compname, "codec_250") == 0);
+
+  /* And the ones that a chunk refers to */
+  blosc2_destroy();
+  blosc2_init();
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  blosc2_free_ctx(dctx);
+  CUTEST_ASSERT("Wrong roundtrip", dsize == NBYTES && memcmp(data->src, data->dest, NBYTES) == 0);
+
+  /* The ids with no library fail as before */
+  cparams.compcode = PLUGIN_ID + 1;
+  cctx = blosc2_create_cctx(cparams);
+  csize = blosc2_compress_ctx(cctx, data->src, NBYTES, data->chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  CUTEST_ASSERT("A codec with no library is used", csize < 0);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(plugin_path) {
+  free(data->dest);
+  free(data->chunk);
+  free(data->src);
+  blosc2_destroy();
+  unsetenv("BLOSC_PLUGIN_PATH");
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(plugin_path);
+}
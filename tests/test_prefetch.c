@@ -0,0 +1,145 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the read-ahead of chunks in sequential scans of on-disk super-chunks.
+*/
+
+#include "test_common.h"
+#include "frame.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS 20
+#define NZEROS 3
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+} test_prefetch_backend;
+
+CUTEST_TEST_DATA(prefetch) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(prefetch) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.nthreads = 2;
+
+  CUTEST_PARAMETRIZE(backend, test_prefetch_backend, CUTEST_DATA(
+      {true, "test_prefetch.b2frame"},
+      {false, "test_prefetch_s.b2frame"},
+      {true, NULL},
+  ));
+  CUTEST_PARAMETRIZE(depth, int, CUTEST_DATA(1, 4));
+}
+
+
+static void fill_data(int32_t *data_buffer, int nchunk, int32_t shift) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data_buffer[j] = nchunk < NCHUNKS - NZEROS ? nchunk * CHUNKSIZE + j + shift : 0;
+  }
+}
+
+
+CUTEST_TEST_TEST(prefetch) {
+  CUTEST_GET_PARAMETER(backend, test_prefetch_backend);
+  CUTEST_GET_PARAMETER(depth, int);
+
+  int32_t *data_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *rec_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  blosc2_remove_urlpath(backend.urlpath);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous,
+                            .urlpath=backend.urlpath};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS - NZEROS; i++) {
+    fill_data(data_buffer, i, 0);
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, nbytes);
+    CUTEST_ASSERT("Error appending", nchunks == i + 1);
+  }
+  /* Special chunks are not read at all */
+  uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+  CUTEST_ASSERT("Error creating the zeros chunk",
+                blosc2_chunk_zeros(cparams, nbytes, zeros, sizeof(zeros)) > 0);
+  for (int i = NCHUNKS - NZEROS; i < NCHUNKS; i++) {
+    CUTEST_ASSERT("Error appending", blosc2_schunk_append_chunk(schunk, zeros, true) == i + 1);
+  }
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(backend.urlpath);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  }
+
+  CUTEST_ASSERT("Negative depth", blosc2_schunk_set_prefetch(schunk, -1) < 0);
+  CUTEST_ASSERT("Error setting the read-ahead", blosc2_schunk_set_prefetch(schunk, depth) == 0);
+  blosc2_frame_s *frame = (blosc2_frame_s *) schunk->frame;
+  if (backend.urlpath == NULL) {
+    CUTEST_ASSERT("In-memory frames are read ahead", frame->prefetcher == NULL);
+  }
+
+  /* Sequential scans, with a chunk updated in the middle of the second one */
+  int32_t shift = 0;
+  for (int scan = 0; scan < 2; scan++) {
+    for (int i = 0; i < NCHUNKS; i++) {
+      if (scan == 1 && i == NCHUNKS / 2) {
+        shift = 7;
+        fill_data(data_buffer, i + 1, shift);
+        uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+        int cbytes = blosc2_compress_ctx(schunk->cctx, data_buffer, nbytes, chunk,
+                                         nbytes + BLOSC2_MAX_OVERHEAD);
+        CUTEST_ASSERT("Error compressing", cbytes > 0);
+        CUTEST_ASSERT("Error updating", blosc2_schunk_update_chunk(schunk, i + 1, chunk, false) >= 0);
+      }
+      fill_data(data_buffer, i, (scan == 1 && i == NCHUNKS / 2 + 1) ? shift : 0);
+      int dsize = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes);
+      CUTEST_ASSERT("Error decompressing", dsize == nbytes);
+      CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, nbytes) == 0);
+    }
+  }
+  if (backend.urlpath != NULL) {
+    int64_t hits, misses;
+    CUTEST_ASSERT("Error getting the stats", frame_get_prefetch_stats(frame, &hits, &misses) == 0);
+    /* Only the first chunk of every scan and the updated one are missed */
+    CUTEST_ASSERT("Chunks are not read ahead", hits == 2 * (NCHUNKS - NZEROS) - 3);
+    CUTEST_ASSERT("Wrong number of misses", misses == 3);
+  }
+
+  /* Random accesses keep working */
+  for (int i = NCHUNKS - 1; i >= 0; i -= 3) {
+    fill_data(data_buffer, i, i == NCHUNKS / 2 + 1 ? shift : 0);
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes);
+    CUTEST_ASSERT("Error decompressing", dsize == nbytes);
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, nbytes) == 0);
+  }
+
+  CUTEST_ASSERT("Error disabling the read-ahead", blosc2_schunk_set_prefetch(schunk, 0) == 0);
+  CUTEST_ASSERT("The read-ahead is not disabled", frame->prefetcher == NULL);
+  /* The read-ahead is stopped with the super-chunk */
+  CUTEST_ASSERT("Error setting the read-ahead", blosc2_schunk_set_prefetch(schunk, depth) == 0);
+  CUTEST_ASSERT("Error decompressing", blosc2_schunk_decompress_chunk(schunk, 0, rec_buffer, nbytes) == nbytes);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+  free(data_buffer);
+  free(rec_buffer);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(prefetch) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(prefetch);
+}
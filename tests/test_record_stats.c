@@ -0,0 +1,160 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for recording the stats of the chunks of super-chunks (the record_stats
+  cparam), and for the adaptive tuning starting from them.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (200 * 1000)
+#define BLOCKSIZE (32 * 1000)
+#define NBYTES (CHUNKSIZE * (int32_t)sizeof(int32_t))
+#define NBLOCKS ((NBYTES + BLOCKSIZE - 1) / BLOCKSIZE)
+#define URLPATH "test_record_stats.b2frame"
+
+
+CUTEST_TEST_DATA(record_stats) {
+  int32_t *zeros;
+  int32_t *noise;
+  int32_t *ramp;
+};
+
+
+CUTEST_TEST_SETUP(record_stats) {
+  blosc2_init();
+  data->zeros = calloc(CHUNKSIZE, sizeof(int32_t));
+  data->noise = malloc(NBYTES);
+  data->ramp = malloc(NBYTES);
+  uint32_t state = 1;
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    state = state * 1664525u + 1013904223u;
+    data->noise[i] = (int32_t)(state ^ (state >> 16) * 2654435761u);
+    data->ramp[i] = i / 3;
+  }
+
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 4));
+}
+
+
+static int32_t chunk_cbytes(blosc2_schunk *schunk, int64_t nchunk) {
+  uint8_t *chunk;
+  bool needs_free;
+  int32_t cbytes = 0;
+  if (blosc2_schunk_get_lazychunk(schunk, nchunk, &chunk, &needs_free) >= 0) {
+    blosc2_cbuffer_sizes(chunk, NULL, &cbytes, NULL);
+    if (needs_free) {
+      free(chunk);
+    }
+  }
+  return cbytes;
+}
+
+
+CUTEST_TEST_TEST(record_stats) {
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = nthreads;
+  cparams.record_stats = true;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true, .urlpath=URLPATH};
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data->zeros, NBYTES) == 1);
+  CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data->noise, NBYTES) == 2);
+  CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data->ramp, NBYTES) == 3);
+  blosc2_schunk_free(schunk);
+
+  // The stats are kept in the frame
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Error reopening the super-chunk", schunk != NULL);
+  blosc2_chunk_stats *chunks;
+  blosc2_block_stats *blocks;
+  int64_t nchunks = blosc2_schunk_get_recorded_stats(schunk, &chunks, &blocks);
+  CUTEST_ASSERT("Wrong number of chunks recorded", nchunks == 3);
+  for (int i = 0; i < 3; i++) {
+    CUTEST_ASSERT("Wrong chunk position", chunks[i].nchunk == i);
+    CUTEST_ASSERT("Wrong chunk nbytes", chunks[i].nbytes == NBYTES);
+    CUTEST_ASSERT("Wrong chunk cbytes", chunks[i].cbytes == chunk_cbytes(schunk, i));
+    CUTEST_ASSERT("Wrong chunk codec", chunks[i].compcode == BLOSC_BLOSCLZ);
+    CUTEST_ASSERT("Wrong chunk filters", chunks[i].filters[BLOSC2_MAX_FILTERS - 1] == BLOSC_SHUFFLE);
+    CUTEST_ASSERT("Wrong chunk ctime", chunks[i].ctime >= 0);
+  }
+
+  // Special chunks have no blocks
+  CUTEST_ASSERT("Special chunks should have no blocks", chunks[0].nblocks == 0);
+
+  // Noise is stored as is
+  CUTEST_ASSERT("Wrong number of blocks", chunks[1].nblocks == NBLOCKS);
+  CUTEST_ASSERT("Memcpyed chunks should have no clevel", chunks[1].clevel == 0);
+  CUTEST_ASSERT("Wrong chunk entropy", chunks[1].entropy > 7.5);
+  for (int j = 0; j < NBLOCKS; j++) {
+    CUTEST_ASSERT("Wrong block cratio", fabs(blocks[j].cratio - 1) < 0.003);
+    CUTEST_ASSERT("Wrong block entropy", blocks[j].entropy > 7.5);
+  }
+
+  // The blocks of the ramp add up to the chunk
+  CUTEST_ASSERT("Wrong number of blocks", chunks[2].nblocks == NBLOCKS);
+  CUTEST_ASSERT("Wrong chunk clevel", chunks[2].clevel == 5);
+  CUTEST_ASSERT("Wrong chunk entropy", chunks[2].entropy < chunks[1].entropy);
+  double csize = 0;
+  for (int j = 0; j < NBLOCKS; j++) {
+    blosc2_block_stats *block = &blocks[NBLOCKS + j];
+    int32_t bsize = j < NBLOCKS - 1 ? BLOCKSIZE : NBYTES - (NBLOCKS - 1) * BLOCKSIZE;
+    CUTEST_ASSERT("Wrong block cratio", block->cratio > 2);
+    csize += bsize / block->cratio;
+  }
+  int32_t overhead = BLOSC_EXTENDED_HEADER_LENGTH + NBLOCKS * (int32_t)sizeof(int32_t);
+  CUTEST_ASSERT("The blocks do not add up to the chunk",
+                fabs(csize + overhead - chunks[2].cbytes) < 0.003 * chunks[2].cbytes);
+  free(chunks);
+  free(blocks);
+
+  // The adaptive tuning starts from the best params recorded (and not from the predicted ones)
+  blosc2_stune_config config = {.objective=BLOSC_STUNE_CRATIO};
+  cparams.tuner_params = &config;
+  cparams.schunk = schunk;
+  blosc2_free_ctx(schunk->cctx);
+  schunk->cctx = blosc2_create_cctx(cparams);
+  CUTEST_ASSERT("Error creating the context", schunk->cctx != NULL);
+  CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data->ramp, NBYTES) == 4);
+  nchunks = blosc2_schunk_get_recorded_stats(schunk, &chunks, NULL);
+  CUTEST_ASSERT("Wrong number of chunks recorded", nchunks == 4);
+  CUTEST_ASSERT("The tuning does not start from the recorded stats",
+                chunks[3].compcode == BLOSC_BLOSCLZ && chunks[3].clevel == 5);
+  free(chunks);
+
+  // Recompressed copies do not keep the stats
+  blosc2_cparams copy_cparams = BLOSC2_CPARAMS_DEFAULTS;
+  copy_cparams.typesize = sizeof(int32_t);
+  copy_cparams.compcode = BLOSC_LZ4;
+  blosc2_storage copy_storage = {.cparams=&copy_cparams, .contiguous=true};
+  blosc2_schunk *copy = blosc2_schunk_copy(schunk, &copy_storage);
+  CUTEST_ASSERT("Error copying the super-chunk", copy != NULL);
+  CUTEST_ASSERT("Copies should not keep stale stats", blosc2_schunk_get_recorded_stats(copy, &chunks, NULL) == 0);
+  blosc2_schunk_free(copy);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(record_stats) {
+  free(data->zeros);
+  free(data->noise);
+  free(data->ramp);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(record_stats);
+}
@@ -0,0 +1,259 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the reductions (sum, min, max and count) of the items of super-chunks.
+*/
+
+#include <math.h>
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (20 * 1000)
+#define LASTITEMS (7 * 1000 + 3)
+#define NCHUNKS 6
+#define BLOCKSIZE (16 * 1024)
+#define ALL_OPS (BLOSC2_REDUCE_SUM | BLOSC2_REDUCE_MIN | BLOSC2_REDUCE_MAX | BLOSC2_REDUCE_COUNT)
+
+
+typedef struct {
+  int kind;
+  int32_t typesize;
+} test_type;
+
+CUTEST_TEST_DATA(reduce) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(reduce) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+
+  CUTEST_PARAMETRIZE(type, test_type, CUTEST_DATA(
+      {BLOSC2_ZONEMAP_INT, 4},
+      {BLOSC2_ZONEMAP_UINT, 1},
+      {BLOSC2_ZONEMAP_FLOAT, 4},
+      {BLOSC2_ZONEMAP_FLOAT, 8},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 3));
+  CUTEST_PARAMETRIZE(zonemap, bool, CUTEST_DATA(false, true));
+  CUTEST_PARAMETRIZE(filter, uint8_t, CUTEST_DATA(BLOSC_SHUFFLE, BLOSC_DELTA));
+}
+
+
+static void set_item(test_type type, uint8_t *dest, double value) {
+  int8_t i8 = (int8_t) value;
+  uint8_t u8 = (uint8_t) value;
+  int32_t i32 = (int32_t) value;
+  float f32 = (float) value;
+  switch (type.kind * 10 + type.typesize) {
+    case BLOSC2_ZONEMAP_INT * 10 + 1: memcpy(dest, &i8, 1); break;
+    case BLOSC2_ZONEMAP_UINT * 10 + 1: memcpy(dest, &u8, 1); break;
+    case BLOSC2_ZONEMAP_INT * 10 + 4: memcpy(dest, &i32, 4); break;
+    case BLOSC2_ZONEMAP_FLOAT * 10 + 4: memcpy(dest, &f32, 4); break;
+    default: memcpy(dest, &value, 8); break;
+  }
+}
+
+static double get_item(test_type type, const uint8_t *src) {
+  uint8_t u8;
+  int32_t i32;
+  float f32;
+  double f64;
+  switch (type.kind * 10 + type.typesize) {
+    case BLOSC2_ZONEMAP_UINT * 10 + 1: memcpy(&u8, src, 1); return u8;
+    case BLOSC2_ZONEMAP_INT * 10 + 4: memcpy(&i32, src, 4); return i32;
+    case BLOSC2_ZONEMAP_FLOAT * 10 + 4: memcpy(&f32, src, 4); return f32;
+    default: memcpy(&f64, src, 8); return f64;
+  }
+}
+
+/* Values that vary, with a few NaNs for floats */
+static double varying(test_type type, int64_t i) {
+  if (type.kind == BLOSC2_ZONEMAP_FLOAT && i % 97 == 0) {
+    return NAN;
+  }
+  if (type.kind == BLOSC2_ZONEMAP_UINT) {
+    return (double) ((i * 7) % 200);
+  }
+  return (double) ((i * 7) % 1000 - 300);
+}
+
+static int append_special(blosc2_schunk *schunk, blosc2_cparams cparams, test_type type, int special,
+                          double value) {
+  int32_t nbytes = CHUNKITEMS * type.typesize;
+  uint8_t chunk[BLOSC_EXTENDED_HEADER_LENGTH + 8];
+  uint8_t item[8];
+  int rc;
+  switch (special) {
+    case BLOSC2_SPECIAL_ZERO:
+      rc = blosc2_chunk_zeros(cparams, nbytes, chunk, sizeof(chunk));
+      break;
+    case BLOSC2_SPECIAL_NAN:
+      rc = blosc2_chunk_nans(cparams, nbytes, chunk, sizeof(chunk));
+      break;
+    default:
+      set_item(type, item, value);
+      rc = blosc2_chunk_repeatval(cparams, nbytes, chunk, sizeof(chunk), item);
+  }
+  if (rc < 0) {
+    return rc;
+  }
+  return (int) blosc2_schunk_append_chunk(schunk, chunk, true);
+}
+
+/* Reduce the items one by one */
+static void reduce_ref(test_type type, const uint8_t *items, int64_t nitems, blosc2_reduction *ref) {
+  memset(ref, 0, sizeof(blosc2_reduction));
+  double sum = 0;
+  double min = INFINITY;
+  double max = -INFINITY;
+  for (int64_t i = 0; i < nitems; i++) {
+    double v = get_item(type, items + i * type.typesize);
+    if (v != v) {
+      ref->nnans++;
+      continue;
+    }
+    ref->count++;
+    sum += v;
+    min = v < min ? v : min;
+    max = v > max ? v : max;
+  }
+  switch (type.kind) {
+    case BLOSC2_ZONEMAP_INT:
+      ref->sum.i = (int64_t) sum;
+      ref->min.i = (int64_t) min;
+      ref->max.i = (int64_t) max;
+      break;
+    case BLOSC2_ZONEMAP_UINT:
+      ref->sum.u = (uint64_t) sum;
+      ref->min.u = (uint64_t) min;
+      ref->max.u = (uint64_t) max;
+      break;
+    default:
+      ref->sum.f = sum;
+      ref->min.f = min;
+      ref->max.f = max;
+  }
+}
+
+static bool same_reduction(test_type type, const blosc2_reduction *result, const blosc2_reduction *ref) {
+  if (result->count != ref->count || result->nnans != ref->nnans) {
+    return false;
+  }
+  if (type.kind != BLOSC2_ZONEMAP_FLOAT) {
+    return result->sum.u == ref->sum.u && result->min.u == ref->min.u && result->max.u == ref->max.u;
+  }
+  // The items are added up in another order
+  return fabs(result->sum.f - ref->sum.f) <= 1e-9 * fabs(ref->sum.f) + 1e-6 &&
+         result->min.f == ref->min.f && result->max.f == ref->max.f;
+}
+
+
+CUTEST_TEST_TEST(reduce) {
+  CUTEST_GET_PARAMETER(type, test_type);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+  CUTEST_GET_PARAMETER(zonemap, bool);
+  CUTEST_GET_PARAMETER(filter, uint8_t);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.typesize = type.typesize;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter;
+  cparams.zonemap = zonemap ? type.kind : BLOSC2_ZONEMAP_NONE;
+  cparams.nthreads = nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+
+  /* Regular chunks, chunks with blocks of a single value and special chunks */
+  int64_t nitems = (int64_t) (NCHUNKS - 1) * CHUNKITEMS + LASTITEMS;
+  uint8_t *items = malloc(nitems * type.typesize);
+  int32_t block_items = BLOCKSIZE / type.typesize;
+  for (int64_t i = 0; i < nitems; i++) {
+    int64_t nchunk = i / CHUNKITEMS;
+    int64_t nblock = (i % CHUNKITEMS) / block_items;
+    double value = varying(type, i);
+    if (nchunk == 1 && nblock % 2 == 0) {
+      value = nblock == 2 && type.kind == BLOSC2_ZONEMAP_FLOAT ? NAN : (double) (5 + nblock);
+    }
+    else if (nchunk == 2) {
+      value = 0;
+    }
+    else if (nchunk == 3) {
+      value = 9;
+    }
+    else if (nchunk == 4) {
+      value = type.kind == BLOSC2_ZONEMAP_FLOAT ? NAN : 0;
+    }
+    set_item(type, items + i * type.typesize, value);
+  }
+  for (int nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int64_t rc;
+    if (nchunk == 2 || (nchunk == 4 && type.kind != BLOSC2_ZONEMAP_FLOAT)) {
+      rc = append_special(schunk, cparams, type, BLOSC2_SPECIAL_ZERO, 0);
+    }
+    else if (nchunk == 3) {
+      rc = append_special(schunk, cparams, type, BLOSC2_SPECIAL_VALUE, 9);
+    }
+    else if (nchunk == 4) {
+      rc = append_special(schunk, cparams, type, BLOSC2_SPECIAL_NAN, 0);
+    }
+    else {
+      int32_t n = nchunk == NCHUNKS - 1 ? LASTITEMS : CHUNKITEMS;
+      rc = blosc2_schunk_append_buffer(schunk, items + (int64_t) nchunk * CHUNKITEMS * type.typesize,
+                                       n * type.typesize);
+    }
+    CUTEST_ASSERT("Error appending a chunk", rc == nchunk + 1);
+  }
+
+  /* All the reductions at once, and some of them */
+  blosc2_reduction ref;
+  reduce_ref(type, items, nitems, &ref);
+  blosc2_reduction result;
+  CUTEST_ASSERT("Error reducing", blosc2_schunk_reduce(schunk, type.kind, ALL_OPS, &result) == 0);
+  CUTEST_ASSERT("Wrong reductions", same_reduction(type, &result, &ref));
+  int ops[] = {BLOSC2_REDUCE_MIN | BLOSC2_REDUCE_MAX | BLOSC2_REDUCE_COUNT, BLOSC2_REDUCE_COUNT, BLOSC2_REDUCE_SUM};
+  for (int i = 0; i < 3; i++) {
+    CUTEST_ASSERT("Error reducing", blosc2_schunk_reduce(schunk, type.kind, ops[i], &result) == 0);
+    blosc2_reduction expected = ref;
+    if (!(ops[i] & BLOSC2_REDUCE_SUM)) {
+      memset(&expected.sum, 0, sizeof(expected.sum));
+    }
+    if (!(ops[i] & BLOSC2_REDUCE_MIN)) {
+      memset(&expected.min, 0, sizeof(expected.min));
+      memset(&expected.max, 0, sizeof(expected.max));
+    }
+    if (!(ops[i] & BLOSC2_REDUCE_COUNT)) {
+      expected.count = 0;
+      expected.nnans = 0;
+    }
+    CUTEST_ASSERT("Wrong partial reductions", same_reduction(type, &result, &expected));
+  }
+
+  /* The kind has to fit the items */
+  int kind = type.typesize == 1 ? BLOSC2_ZONEMAP_FLOAT : BLOSC2_ZONEMAP_NONE;
+  CUTEST_ASSERT("A wrong kind is taken", blosc2_schunk_reduce(schunk, kind, ALL_OPS, &result) < 0);
+
+  free(items);
+  blosc2_schunk_free(schunk);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(reduce) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(reduce);
+}
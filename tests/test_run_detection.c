@@ -0,0 +1,137 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the detection of chunks made of a single repeated value, which are
+  encoded as special chunks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define MAXSIZE (2 * 1000 * 1000)
+
+enum {
+  RUN_ZEROS = 0,
+  RUN_VALUE = 1,
+  BREAK_FIRST = 2,  // the second value differs
+  BREAK_MIDDLE = 3,
+  BREAK_LAST = 4,   // the very last byte differs
+  RUN_NAN = 5,
+};
+
+
+CUTEST_TEST_DATA(run_detection) {
+  uint8_t *src;
+  uint8_t *dest;
+  uint8_t *rec;
+};
+
+CUTEST_TEST_SETUP(run_detection) {
+  blosc2_init();
+  data->src = malloc(MAXSIZE);
+  data->dest = malloc(MAXSIZE + BLOSC2_MAX_OVERHEAD);
+  data->rec = malloc(MAXSIZE);
+
+  CUTEST_PARAMETRIZE(typesize, int32_t, CUTEST_DATA(1, 2, 4, 8, 12, 33, 255));
+  CUTEST_PARAMETRIZE(nitems, int32_t, CUTEST_DATA(200, 777, 4099));
+  CUTEST_PARAMETRIZE(pattern, int, CUTEST_DATA(
+      RUN_ZEROS, RUN_VALUE, BREAK_FIRST, BREAK_MIDDLE, BREAK_LAST, RUN_NAN));
+  CUTEST_PARAMETRIZE(detection, int, CUTEST_DATA(BLOSC_SPECIAL_DETECT_RUNS, BLOSC_SPECIAL_DETECT_NONE));
+}
+
+
+CUTEST_TEST_TEST(run_detection) {
+  CUTEST_GET_PARAMETER(typesize, int32_t);
+  CUTEST_GET_PARAMETER(nitems, int32_t);
+  CUTEST_GET_PARAMETER(pattern, int);
+  CUTEST_GET_PARAMETER(detection, int);
+
+  int32_t nbytes = typesize * nitems;
+  for (int32_t i = 0; i < nbytes; i++) {
+    data->src[i] = pattern == RUN_ZEROS ? 0 : (uint8_t) (i % typesize + 3);
+  }
+  bool nans = pattern == RUN_NAN && (typesize == 4 || typesize == 8);
+  for (int32_t i = 0; nans && i < nitems; i++) {
+    if (typesize == 4) {
+      ((float *) data->src)[i] = nanf("");
+    }
+    else {
+      ((double *) data->src)[i] = nan("");
+    }
+  }
+  bool run = false;
+  switch (pattern) {
+    case BREAK_FIRST:
+      data->src[typesize]++;
+      break;
+    case BREAK_MIDDLE:
+      data->src[nbytes / 2]++;
+      break;
+    case BREAK_LAST:
+      data->src[nbytes - 1]++;
+      break;
+    default:
+      run = true;
+  }
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  cparams.clevel = 5;
+  cparams.special_detection = detection;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+
+  int cbytes = blosc2_compress_ctx(cctx, data->src, nbytes, data->dest, nbytes + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Error compressing", cbytes > 0);
+  int special = (data->dest[BLOSC2_CHUNK_BLOSC2_FLAGS] >> 4) & BLOSC2_SPECIAL_MASK;
+  if (detection == BLOSC_SPECIAL_DETECT_NONE) {
+    /* Streams of zeros still make a zeros chunk after going through the pipeline */
+    CUTEST_ASSERT("Detection is not disabled",
+                  special == (pattern == RUN_ZEROS ? BLOSC2_SPECIAL_ZERO : 0));
+  }
+  else if (nans) {
+    CUTEST_ASSERT("NaNs are not detected", special == BLOSC2_SPECIAL_NAN);
+    CUTEST_ASSERT("Wrong size", cbytes == BLOSC_EXTENDED_HEADER_LENGTH);
+  }
+  else if (run && pattern == RUN_ZEROS) {
+    CUTEST_ASSERT("Zeros are not detected", special == BLOSC2_SPECIAL_ZERO);
+    CUTEST_ASSERT("Wrong size", cbytes == BLOSC_EXTENDED_HEADER_LENGTH);
+  }
+  else if (run) {
+    CUTEST_ASSERT("The run is not detected", special == BLOSC2_SPECIAL_VALUE);
+    CUTEST_ASSERT("Wrong size", cbytes == BLOSC_EXTENDED_HEADER_LENGTH + typesize);
+  }
+  else {
+    CUTEST_ASSERT("Not a run", special == 0);
+  }
+
+  int dbytes = blosc2_decompress_ctx(dctx, data->dest, cbytes, data->rec, nbytes);
+  CUTEST_ASSERT("Error decompressing", dbytes == nbytes);
+  CUTEST_ASSERT("Data are not equal", memcmp(data->src, data->rec, nbytes) == 0);
+
+  /* And a single item */
+  int item = nitems / 2;
+  CUTEST_ASSERT("Error in getitem",
+                blosc2_getitem_ctx(dctx, data->dest, cbytes, item, 1, data->rec, typesize) == typesize);
+  CUTEST_ASSERT("Wrong item", memcmp(data->src + item * typesize, data->rec, typesize) == 0);
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(run_detection) {
+  free(data->src);
+  free(data->dest);
+  free(data->rec);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(run_detection);
+}
@@ -0,0 +1,167 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the different block schedulers in Blosc.
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *dest, *dest2;
+int scheduler;
+int16_t nthreads;
+int clevel;
+#define NITEMS (1000 * 1000 + 13)
+#define TYPESIZE 4
+const int bytesize = NITEMS * TYPESIZE;
+const int blocksize = 16 * 1024;
+
+
+static char *test_roundtrip(void) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = TYPESIZE;
+  cparams.clevel = clevel;
+  cparams.nthreads = nthreads;
+  cparams.blocksize = blocksize;
+  cparams.scheduler = scheduler;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_DELTA;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  mu_assert("ERROR: cannot create cctx", cctx != NULL);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  dparams.scheduler = scheduler;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  mu_assert("ERROR: cannot create dctx", dctx != NULL);
+
+  /* Several runs so that the thread pool gets reused */
+  for (int i = 0; i < 3; i++) {
+    int cbytes = blosc2_compress_ctx(cctx, src, bytesize, dest, bytesize + BLOSC2_MAX_OVERHEAD);
+    mu_assert("ERROR: cbytes is not correct", cbytes > 0 && cbytes <= bytesize + BLOSC2_MAX_OVERHEAD);
+
+    memset(dest2, 0, bytesize);
+    int nbytes = blosc2_decompress_ctx(dctx, dest, cbytes, dest2, bytesize);
+    mu_assert("ERROR: nbytes is not correct", nbytes == bytesize);
+    mu_assert("ERROR: wrong values in dest", memcmp(src, dest2, bytesize) == 0);
+  }
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  return 0;
+}
+
+
+static char *test_maskout(void) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = TYPESIZE;
+  cparams.clevel = clevel;
+  cparams.nthreads = nthreads;
+  cparams.blocksize = blocksize;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int cbytes = blosc2_compress_ctx(cctx, src, bytesize, dest, bytesize + BLOSC2_MAX_OVERHEAD);
+  mu_assert("ERROR: cbytes is not correct", cbytes > 0);
+  blosc2_free_ctx(cctx);
+
+  int nblocks = (bytesize + blocksize - 1) / blocksize;
+  bool *maskout = malloc(nblocks);
+  for (int i = 0; i < nblocks; i++) {
+    maskout[i] = i % 3 == 0;
+  }
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  dparams.scheduler = scheduler;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  memset(dest2, 0, bytesize);
+  mu_assert("ERROR: setting maskout", blosc2_set_maskout(dctx, maskout, nblocks) == 0);
+  int nbytes = blosc2_decompress_ctx(dctx, dest, cbytes, dest2, bytesize);
+  mu_assert("ERROR: nbytes is not correct", nbytes == bytesize);
+  for (int i = 0; i < nblocks; i++) {
+    int32_t bsize = (i == nblocks - 1) ? bytesize - i * blocksize : blocksize;
+    uint8_t *dblock = (uint8_t *)dest2 + i * blocksize;
+    if (!maskout[i]) {
+      mu_assert("ERROR: wrong values in dest", memcmp((uint8_t *)src + i * blocksize, dblock, bsize) == 0);
+    }
+  }
+  blosc2_free_ctx(dctx);
+  free(maskout);
+  return 0;
+}
+
+
+static char *test_invalid_scheduler(void) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.scheduler = BLOSC_STREAMS_SCHED + 1;
+  mu_assert("ERROR: invalid scheduler accepted", blosc2_create_cctx(cparams) == NULL);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.scheduler = -1;
+  mu_assert("ERROR: invalid scheduler accepted", blosc2_create_dctx(dparams) == NULL);
+  return 0;
+}
+
+
+static char *all_tests(void) {
+  int schedulers[] = {BLOSC_DEFAULT_SCHED, BLOSC_DYNAMIC_SCHED, BLOSC_WORKSTEALING_SCHED, BLOSC_STREAMS_SCHED};
+  int16_t nthreads_[] = {1, 2, 3, 7};
+  int clevels[] = {0, 5};
+
+  for (int i = 0; i < (int)ARRAY_SIZE(schedulers); i++) {
+    for (int j = 0; j < (int)ARRAY_SIZE(nthreads_); j++) {
+      for (int k = 0; k < (int)ARRAY_SIZE(clevels); k++) {
+        scheduler = schedulers[i];
+        nthreads = nthreads_[j];
+        clevel = clevels[k];
+        mu_run_test(test_roundtrip);
+      }
+      mu_run_test(test_maskout);
+    }
+  }
+  mu_run_test(test_invalid_scheduler);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+  blosc2_init();
+
+  /* Initialize buffers with some blocks much more compressible than others */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, bytesize);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, bytesize + BLOSC2_MAX_OVERHEAD);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, bytesize);
+  int32_t *_src = (int32_t *)src;
+  srand(1);
+  for (int i = 0; i < NITEMS; i++) {
+    _src[i] = ((i / 10000) % 2) ? rand() : i;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+
+  blosc2_destroy();
+
+  return result != 0;
+}
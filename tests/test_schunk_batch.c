@@ -0,0 +1,135 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+
+  Unit tests for appending and decompressing several chunks at once.
+*/
+
+#include <stdio.h>
+#include "test_common.h"
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS (10)
+
+/* Global vars */
+int tests_run = 0;
+int16_t pool_nthreads;
+bool contiguous;
+char *urlpath;
+
+
+static char* test_schunk_batch(void) {
+  int32_t isize = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data[NCHUNKS];
+  int32_t *data_dest[NCHUNKS];
+  int32_t nbytes[NCHUNKS];
+
+  blosc2_init();
+  mu_assert("ERROR: cannot set the shared pool", blosc2_set_shared_threadpool(pool_nthreads) == 0);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.clevel = 5;
+  cparams.nthreads = 2;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=contiguous, .urlpath=urlpath};
+  blosc2_remove_urlpath(urlpath);
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  mu_assert("ERROR: cannot create the super-chunk", schunk != NULL);
+
+  for (int nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    data[nchunk] = malloc(isize);
+    data_dest[nchunk] = malloc(isize);
+    nbytes[nchunk] = isize;
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      data[nchunk][i] = (nchunk % 3 == 0) ? 0 : i + nchunk * CHUNKSIZE;
+    }
+  }
+
+  // Feed it with two batches
+  int64_t nchunks = blosc2_schunk_append_buffers(schunk, (void **)data, nbytes, NCHUNKS / 2);
+  mu_assert("ERROR: bad append of the first batch", nchunks == NCHUNKS / 2);
+  nchunks = blosc2_schunk_append_buffers(schunk, (void **)(data + NCHUNKS / 2), nbytes,
+                                         NCHUNKS - NCHUNKS / 2);
+  mu_assert("ERROR: bad append of the second batch", nchunks == NCHUNKS);
+  mu_assert("ERROR: bad nbytes in super-chunk", schunk->nbytes == (int64_t)NCHUNKS * isize);
+
+  if (urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(urlpath);
+    mu_assert("ERROR: cannot open the super-chunk", schunk != NULL);
+  }
+
+  // Decompress all the chunks at once
+  int64_t dsize = blosc2_schunk_decompress_chunks(schunk, 0, NCHUNKS, (void **)data_dest, nbytes);
+  mu_assert("ERROR: chunks cannot be decompressed correctly", dsize == (int64_t)NCHUNKS * isize);
+  for (int nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    mu_assert("ERROR: bad roundtrip", memcmp(data[nchunk], data_dest[nchunk], isize) == 0);
+  }
+
+  // ...and a range of them, checking against the single chunk version
+  dsize = blosc2_schunk_decompress_chunks(schunk, 3, 4, (void **)data_dest, nbytes);
+  mu_assert("ERROR: chunk range cannot be decompressed correctly", dsize == 4 * (int64_t)isize);
+  for (int nchunk = 0; nchunk < 4; nchunk++) {
+    mu_assert("ERROR: bad roundtrip in range", memcmp(data[3 + nchunk], data_dest[nchunk], isize) == 0);
+  }
+  mu_assert("ERROR: range out of bounds accepted",
+            blosc2_schunk_decompress_chunks(schunk, 8, 4, (void **)data_dest, nbytes) < 0);
+
+  /* Free resources */
+  for (int nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    free(data[nchunk]);
+    free(data_dest[nchunk]);
+  }
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+  blosc2_destroy();
+
+  return EXIT_SUCCESS;
+}
+
+static char *all_tests(void) {
+  int16_t pool_sizes[] = {0, 3};
+  for (int i = 0; i < (int)ARRAY_SIZE(pool_sizes); i++) {
+    pool_nthreads = pool_sizes[i];
+
+    contiguous = false;
+    urlpath = NULL;
+    mu_run_test(test_schunk_batch);
+
+    contiguous = true;
+    urlpath = NULL;
+    mu_run_test(test_schunk_batch);
+
+    contiguous = true;
+    urlpath = "test_schunk_batch.b2frame";
+    mu_run_test(test_schunk_batch);
+
+    contiguous = false;
+    urlpath = "test_schunk_batch_s.b2frame";
+    mu_run_test(test_schunk_batch);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+
+int main(void) {
+  char *result;
+
+  install_blosc_callback_test(); /* optionally install callback test */
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  return result != EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for getting what the chunks of super-chunks are made of out of their headers.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (40 * 1000)
+#define NCHUNKS 6
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  bool mmap;
+} test_info_backend;
+
+/* The params of the chunks (the last ones are made of zeros) */
+typedef struct {
+  int compcode;
+  uint8_t filter;
+  int32_t blocksize;
+  int splitmode;
+} chunk_params;
+
+static chunk_params chunks_params[NCHUNKS - 1] = {
+    {BLOSC_BLOSCLZ, BLOSC_SHUFFLE, 0, BLOSC_ALWAYS_SPLIT},
+    {BLOSC_LZ4, BLOSC_BITSHUFFLE, 8 * 1024, BLOSC_NEVER_SPLIT},
+    {BLOSC_LZ4HC, BLOSC_NOSHUFFLE, 16 * 1024, BLOSC_NEVER_SPLIT},
+    {BLOSC_ZSTD, BLOSC_SHUFFLE, 32 * 1024, BLOSC_ALWAYS_SPLIT},
+    {BLOSC_ZLIB, BLOSC_SHUFFLE, 0, BLOSC_NEVER_SPLIT},
+};
+
+CUTEST_TEST_DATA(schunk_chunk_info) {
+  int32_t *buffer;
+  uint8_t *chunk;
+};
+
+CUTEST_TEST_SETUP(schunk_chunk_info) {
+  blosc2_init();
+  data->buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  data->chunk = malloc(CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    data->buffer[i] = i / 3;
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_info_backend, CUTEST_DATA(
+      {false, NULL, false},  // memory - schunk
+      {true, NULL, false},  // memory - cframe
+      {true, "test_schunk_chunk_info.b2frame", false},  // disk - cframe
+      {false, "test_schunk_chunk_info.b2frame", false},  // disk - sframe
+      {true, "test_schunk_chunk_info.b2frame", true},  // disk - cframe with mmap
+  ));
+}
+
+
+CUTEST_TEST_TEST(schunk_chunk_info) {
+  CUTEST_GET_PARAMETER(backend, test_info_backend);
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath};
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+
+  // Every chunk with its own params
+  int32_t cbytes[NCHUNKS];
+  for (int i = 0; i < NCHUNKS - 1; i++) {
+    cparams.compcode = chunks_params[i].compcode;
+    cparams.filters[BLOSC2_MAX_FILTERS - 1] = chunks_params[i].filter;
+    cparams.blocksize = chunks_params[i].blocksize;
+    cparams.splitmode = chunks_params[i].splitmode;
+    blosc2_context *cctx = blosc2_create_cctx(cparams);
+    cbytes[i] = blosc2_compress_ctx(cctx, data->buffer, nbytes, data->chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+    blosc2_free_ctx(cctx);
+    CUTEST_ASSERT("Compression error", cbytes[i] > 0);
+    CUTEST_ASSERT("Error appending", blosc2_schunk_append_chunk(schunk, data->chunk, true) == i + 1);
+  }
+  cbytes[NCHUNKS - 1] = blosc2_chunk_zeros(cparams, nbytes, data->chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+  CUTEST_ASSERT("Error creating the zeros", cbytes[NCHUNKS - 1] > 0);
+  CUTEST_ASSERT("Error appending", blosc2_schunk_append_chunk(schunk, data->chunk, true) == NCHUNKS);
+
+  // Reopen the on-disk ones, so that the headers are read from the files (or their mappings)
+  blosc2_stdio_mmap mmap_read = BLOSC2_STDIO_MMAP_DEFAULTS;
+  blosc2_io io_read = {.id = BLOSC2_IO_FILESYSTEM_MMAP, .name = "filesystem_mmap", .params = &mmap_read};
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = backend.mmap ? blosc2_schunk_open_udio(backend.urlpath, &io_read) : blosc2_schunk_open(backend.urlpath);
+    CUTEST_ASSERT("Error reopening the super-chunk", schunk != NULL);
+  }
+
+  blosc2_chunk_info info[NCHUNKS];
+  CUTEST_ASSERT("Error getting the info", blosc2_schunk_get_chunks_info(schunk, 0, NCHUNKS, info) == 0);
+  for (int i = 0; i < NCHUNKS - 1; i++) {
+    chunk_params params = chunks_params[i];
+    int compcode = (params.compcode == BLOSC_LZ4HC) ? BLOSC_LZ4 : params.compcode;
+    CUTEST_ASSERT("Wrong codec", info[i].compcode == compcode);
+    CUTEST_ASSERT("Wrong filter", info[i].filters[BLOSC2_MAX_FILTERS - 1] == params.filter);
+    CUTEST_ASSERT("Wrong nbytes", info[i].nbytes == nbytes);
+    CUTEST_ASSERT("Wrong cbytes", info[i].cbytes == cbytes[i]);
+    CUTEST_ASSERT("Wrong typesize", info[i].typesize == sizeof(int32_t));
+    if (params.blocksize > 0) {
+      CUTEST_ASSERT("Wrong blocksize", info[i].blocksize == params.blocksize);
+    }
+    CUTEST_ASSERT("Wrong split", info[i].split == (params.splitmode == BLOSC_ALWAYS_SPLIT));
+    CUTEST_ASSERT("Wrong special", info[i].special == BLOSC2_NO_SPECIAL);
+    CUTEST_ASSERT("Nothing should be memcpyed", !info[i].memcpyed);
+
+    blosc2_chunk_info info1;
+    CUTEST_ASSERT("Error getting the info", blosc2_schunk_get_chunk_info(schunk, i, &info1) == 0);
+    CUTEST_ASSERT("The info of the chunk differs", info1.cbytes == info[i].cbytes &&
+                  info1.blocksize == info[i].blocksize && info1.compcode == info[i].compcode);
+  }
+  CUTEST_ASSERT("Wrong special", info[NCHUNKS - 1].special == BLOSC2_SPECIAL_ZERO);
+  CUTEST_ASSERT("Wrong nbytes", info[NCHUNKS - 1].nbytes == nbytes);
+
+  // A part of the chunks
+  CUTEST_ASSERT("Error getting the info", blosc2_schunk_get_chunks_info(schunk, 2, 4, info) == 0);
+  CUTEST_ASSERT("Wrong codec", info[0].compcode == BLOSC_LZ4 && info[1].compcode == BLOSC_ZSTD);
+  CUTEST_ASSERT("Empty ranges should work", blosc2_schunk_get_chunks_info(schunk, 3, 3, info) == 0);
+
+  CUTEST_ASSERT("Chunks out of the super-chunk should fail",
+                blosc2_schunk_get_chunk_info(schunk, NCHUNKS, info) < 0);
+  CUTEST_ASSERT("Chunks out of the super-chunk should fail",
+                blosc2_schunk_get_chunks_info(schunk, -1, 2, info) < 0);
+
+  blosc2_schunk_free(schunk);
+  if (backend.mmap) {
+    CUTEST_ASSERT("Error unmapping the frame", blosc2_stdio_mmap_destroy(&mmap_read) == 0);
+  }
+  blosc2_remove_urlpath(backend.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(schunk_chunk_info) {
+  free(data->buffer);
+  free(data->chunk);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(schunk_chunk_info);
+}
@@ -0,0 +1,102 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for getting every step-th item of a slice of a super-chunk.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS 10000
+#define NCHUNKS 9
+#define BLOCKSIZE 4096
+
+
+CUTEST_TEST_DATA(schunk_slice_step) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(schunk_slice_step) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.blocksize = BLOCKSIZE;
+
+  CUTEST_PARAMETRIZE(storage_kind, int, CUTEST_DATA(0, 1, 2));  // in memory, frame on disk, deltas
+  CUTEST_PARAMETRIZE(step, int64_t, CUTEST_DATA(1, 3, 1024, 1025, 25000));
+}
+
+
+CUTEST_TEST_TEST(schunk_slice_step) {
+  CUTEST_GET_PARAMETER(storage_kind, int);
+  CUTEST_GET_PARAMETER(step, int64_t);
+
+  char *urlpath = "test_schunk_slice_step.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true, .urlpath=storage_kind == 1 ? urlpath : NULL};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  if (storage_kind == 2) {
+    CUTEST_ASSERT("Cannot set up the deltas", blosc2_schunk_set_xdelta(schunk, 4) == 0);
+  }
+
+  // A last chunk shorter than the rest, and a zeroed one in between
+  int64_t nitems = NCHUNKS * CHUNKITEMS - 123;
+  int32_t *values = malloc(nitems * sizeof(int32_t));
+  for (int64_t i = 0; i < nitems; i++) {
+    values[i] = i / CHUNKITEMS == 4 ? 0 : (int32_t) (i * 7 + i % 13);
+  }
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int32_t nbytes = (int32_t) ((nchunk == NCHUNKS - 1 ? nitems % CHUNKITEMS : CHUNKITEMS) * sizeof(int32_t));
+    int64_t rc;
+    if (nchunk == 4 && storage_kind != 2) {
+      uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+      CUTEST_ASSERT("Cannot create the zeros", blosc2_chunk_zeros(cparams, nbytes, zeros, sizeof(zeros)) > 0);
+      rc = blosc2_schunk_append_chunk(schunk, zeros, true);
+      CUTEST_ASSERT("Cannot append the zeros", rc == nchunk + 1);
+      continue;
+    }
+    rc = blosc2_schunk_append_buffer(schunk, values + nchunk * CHUNKITEMS, nbytes);
+    CUTEST_ASSERT("Cannot append", rc == nchunk + 1);
+  }
+
+  int32_t *sampled = malloc((nitems + 1) * sizeof(int32_t));
+  int64_t slices[][2] = {{0, nitems}, {5, nitems - 5}, {CHUNKITEMS - 1, 3 * CHUNKITEMS + 2}, {17, 18}, {40, 40}};
+  for (int s = 0; s < (int) ARRAY_SIZE(slices); s++) {
+    int64_t start = slices[s][0];
+    int64_t stop = slices[s][1];
+    int64_t nsampled = (stop - start + step - 1) / step;
+    sampled[nsampled] = -1;
+    CUTEST_ASSERT("Cannot get the items", blosc2_schunk_get_slice_buffer_step(schunk, start, stop, step, sampled) == 0);
+    for (int64_t i = 0; i < nsampled; i++) {
+      CUTEST_ASSERT("Wrong item", sampled[i] == values[start + i * step]);
+    }
+    CUTEST_ASSERT("Past the items is written", sampled[nsampled] == -1);
+  }
+
+  CUTEST_ASSERT("A zero step is taken", blosc2_schunk_get_slice_buffer_step(schunk, 0, 10, 0, sampled) < 0);
+  CUTEST_ASSERT("A slice past the end is taken",
+                blosc2_schunk_get_slice_buffer_step(schunk, 0, nitems + 1, step, sampled) < 0);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+  free(sampled);
+  free(values);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(schunk_slice_step) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(schunk_slice_step);
+}
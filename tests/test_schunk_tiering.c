@@ -0,0 +1,184 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the recompression of the chunks of super-chunks that turn cold.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS 20000
+#define NCHUNKS 12
+
+
+CUTEST_TEST_DATA(schunk_tiering) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(schunk_tiering) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.compcode = BLOSC_BLOSCLZ;
+  data->cparams.clevel = 1;
+
+  CUTEST_PARAMETRIZE(storage_kind, int, CUTEST_DATA(0, 1));  // in memory, sparse frame
+  CUTEST_PARAMETRIZE(shared_pool, int, CUTEST_DATA(0, 2));
+}
+
+
+static void fill_chunk(int64_t nchunk, int32_t *values) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    values[i] = (int32_t) (nchunk * 1000 + i / 10);
+  }
+}
+
+static bool check_chunk(blosc2_schunk *schunk, int64_t nchunk, int32_t *buffer, int32_t *expected) {
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  fill_chunk(nchunk, expected);
+  return blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, chunksize) == chunksize &&
+         memcmp(buffer, expected, chunksize) == 0;
+}
+
+/* The size of a chunk as appended (asking the super-chunk for it would count as a read) */
+static int32_t hot_cbytes(blosc2_cparams cparams, int64_t nchunk, int32_t *values) {
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  fill_chunk(nchunk, values);
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  uint8_t *chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(cctx, values, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+  free(chunk);
+  blosc2_free_ctx(cctx);
+  return cbytes;
+}
+
+static int32_t chunk_cbytes(blosc2_schunk *schunk, int64_t nchunk) {
+  uint8_t *chunk;
+  bool needs_free;
+  int cbytes = blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free);
+  if (needs_free) {
+    free(chunk);
+  }
+  return cbytes;
+}
+
+
+CUTEST_TEST_TEST(schunk_tiering) {
+  CUTEST_GET_PARAMETER(storage_kind, int);
+  CUTEST_GET_PARAMETER(shared_pool, int);
+
+  char *urlpath = "test_schunk_tiering.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  if (shared_pool > 0) {
+    CUTEST_ASSERT("Cannot set up the pool", blosc2_set_shared_threadpool(shared_pool) == 0);
+  }
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = data->cparams;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_NOFILTER;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=false, .urlpath=storage_kind ? urlpath : NULL};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+
+  blosc2_cparams cold = BLOSC2_CPARAMS_DEFAULTS;
+  cold.compcode = BLOSC_ZSTD;
+  cold.clevel = 9;
+  cold.filters[BLOSC2_MAX_FILTERS - 1] = BLOSC_SHUFFLE;
+  blosc2_tiering tiering = {.cparams=&cold, .min_age=0, .idle_appends=3};
+  CUTEST_ASSERT("Cannot set up the tiering", blosc2_schunk_set_tiering(schunk, &tiering) == 0);
+
+  int32_t *values = malloc(chunksize);
+  int32_t *expected = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(nchunk, values);
+    CUTEST_ASSERT("Cannot append", blosc2_schunk_append_buffer(schunk, values, chunksize) == nchunk + 1);
+    // The chunks that are read stay as they are
+    if (nchunk % 4 == 1) {
+      CUTEST_ASSERT("Wrong chunk", check_chunk(schunk, nchunk, values, expected));
+    }
+  }
+  CUTEST_ASSERT("Cannot flush", blosc2_schunk_flush_tiering(schunk) >= 0);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int32_t cbytes = chunk_cbytes(schunk, nchunk);
+    if (nchunk % 4 == 1 || nchunk >= NCHUNKS - tiering.idle_appends) {
+      CUTEST_ASSERT("A hot chunk is recompressed", cbytes == hot_cbytes(cparams, nchunk, values));
+    }
+    else {
+      CUTEST_ASSERT("A cold chunk is not recompressed", cbytes < hot_cbytes(cparams, nchunk, values));
+    }
+    CUTEST_ASSERT("Wrong chunk after the tiering", check_chunk(schunk, nchunk, values, expected));
+  }
+
+  // By age, every chunk turns cold
+  tiering.min_age = 2;
+  tiering.idle_appends = 0;
+  CUTEST_ASSERT("Cannot set up the tiering", blosc2_schunk_set_tiering(schunk, &tiering) == 0);
+  for (int64_t nchunk = NCHUNKS; nchunk < 2 * NCHUNKS; nchunk++) {
+    fill_chunk(nchunk, values);
+    CUTEST_ASSERT("Cannot append", blosc2_schunk_append_buffer(schunk, values, chunksize) == nchunk + 1);
+    CUTEST_ASSERT("Wrong chunk", check_chunk(schunk, nchunk, values, expected));
+  }
+  CUTEST_ASSERT("Cannot stop the tiering", blosc2_schunk_set_tiering(schunk, NULL) == 0);
+  for (int64_t nchunk = NCHUNKS; nchunk < 2 * NCHUNKS; nchunk++) {
+    int32_t cbytes = chunk_cbytes(schunk, nchunk);
+    CUTEST_ASSERT("Wrong recompression by age",
+                  (nchunk < 2 * NCHUNKS - 2) == (cbytes < hot_cbytes(cparams, nchunk, values)));
+    CUTEST_ASSERT("Wrong chunk after the tiering", check_chunk(schunk, nchunk, values, expected));
+  }
+
+  // A chunk updated in the meanwhile is not replaced
+  CUTEST_ASSERT("Cannot set up the tiering", blosc2_schunk_set_tiering(schunk, &tiering) == 0);
+  fill_chunk(2 * NCHUNKS, values);
+  CUTEST_ASSERT("Cannot append", blosc2_schunk_append_buffer(schunk, values, chunksize) > 0);
+  fill_chunk(2 * NCHUNKS + 1, values);
+  CUTEST_ASSERT("Cannot append", blosc2_schunk_append_buffer(schunk, values, chunksize) > 0);
+  fill_chunk(2 * NCHUNKS + 2, values);
+  CUTEST_ASSERT("Cannot append", blosc2_schunk_append_buffer(schunk, values, chunksize) > 0);
+  fill_chunk(7, values);
+  uint8_t *chunk = malloc(chunksize + BLOSC2_MAX_OVERHEAD);
+  int cbytes = blosc2_compress_ctx(schunk->cctx, values, chunksize, chunk, chunksize + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot update", blosc2_schunk_update_chunk(schunk, 2 * NCHUNKS, chunk, true) > 0);
+  free(chunk);
+  blosc2_schunk_flush_tiering(schunk);
+  CUTEST_ASSERT("The updated chunk is replaced", chunk_cbytes(schunk, 2 * NCHUNKS) == cbytes);
+  fill_chunk(7, expected);
+  CUTEST_ASSERT("Wrong updated chunk",
+                blosc2_schunk_decompress_chunk(schunk, 2 * NCHUNKS, values, chunksize) == chunksize &&
+                memcmp(values, expected, chunksize) == 0);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+  free(expected);
+  free(values);
+
+  // Chunks that depend on the super-chunk are not recompressed
+  storage.urlpath = NULL;
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot set up the deltas", blosc2_schunk_set_xdelta(schunk, 4) == 0);
+  CUTEST_ASSERT("The tiering is set up with deltas", blosc2_schunk_set_tiering(schunk, &tiering) < 0);
+  blosc2_schunk_free(schunk);
+
+  // Nor contiguous frames
+  storage.contiguous = true;
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("The tiering is set up in a frame", blosc2_schunk_set_tiering(schunk, &tiering) < 0);
+  blosc2_schunk_free(schunk);
+  if (shared_pool > 0) {
+    blosc2_set_shared_threadpool(0);
+  }
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(schunk_tiering) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(schunk_tiering);
+}
@@ -0,0 +1,135 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the serialization of super-chunks into contiguous buffers by several threads.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (100 * 1000)
+#define NCHUNKS 30
+
+
+CUTEST_TEST_DATA(schunk_to_buffer) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(schunk_to_buffer) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.clevel = 1;
+
+  CUTEST_PARAMETRIZE(storage_kind, int, CUTEST_DATA(0, 1, 2));  // in memory, sparse frame, contiguous frame
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 4));
+  CUTEST_PARAMETRIZE(shared_pool, int, CUTEST_DATA(0, 3));
+}
+
+
+static void fill_chunk(int64_t nchunk, int32_t *values) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    values[i] = (int32_t) (nchunk * 7919 + i * 31);
+  }
+}
+
+
+CUTEST_TEST_TEST(schunk_to_buffer) {
+  CUTEST_GET_PARAMETER(storage_kind, int);
+  CUTEST_GET_PARAMETER(nthreads, int);
+  CUTEST_GET_PARAMETER(shared_pool, int);
+
+  char *urlpath = "test_schunk_to_buffer.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  if (shared_pool > 0) {
+    CUTEST_ASSERT("Cannot set up the pool", blosc2_set_shared_threadpool(shared_pool) == 0);
+  }
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = (int16_t) nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=storage_kind == 2,
+                            .urlpath=storage_kind > 0 ? urlpath : NULL};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  // Regular chunks with a few special ones in between
+  int32_t *values = malloc(chunksize);
+  int32_t *expected = malloc(chunksize);
+  uint8_t *zeros = malloc(BLOSC_EXTENDED_HEADER_LENGTH);
+  CUTEST_ASSERT("Cannot create the zeros",
+                blosc2_chunk_zeros(cparams, chunksize, zeros, BLOSC_EXTENDED_HEADER_LENGTH) > 0);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int64_t rc;
+    if (nchunk % 7 == 3) {
+      rc = blosc2_schunk_append_chunk(schunk, zeros, true);
+    }
+    else {
+      fill_chunk(nchunk, values);
+      rc = blosc2_schunk_append_buffer(schunk, values, chunksize);
+    }
+    CUTEST_ASSERT("Cannot append", rc == nchunk + 1);
+  }
+  free(zeros);
+
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  CUTEST_ASSERT("Cannot serialize", cframe_len > 0);
+  blosc2_schunk *schunk2 = blosc2_schunk_from_buffer(cframe, cframe_len, true);
+  CUTEST_ASSERT("Cannot deserialize", schunk2 != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", schunk2->nchunks == NCHUNKS);
+  CUTEST_ASSERT("Wrong nbytes", schunk2->nbytes == schunk->nbytes);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    if (nchunk % 7 == 3) {
+      memset(expected, 0, chunksize);
+    }
+    else {
+      fill_chunk(nchunk, expected);
+    }
+    CUTEST_ASSERT("Cannot decompress",
+                  blosc2_schunk_decompress_chunk(schunk2, nchunk, values, chunksize) == chunksize);
+    CUTEST_ASSERT("Wrong chunk", memcmp(values, expected, chunksize) == 0);
+  }
+
+  // The super-chunk serialized again (from a contiguous frame now) gives the same buffer
+  uint8_t *cframe2;
+  bool needs_free2;
+  int64_t cframe2_len = blosc2_schunk_to_buffer(schunk2, &cframe2, &needs_free2);
+  CUTEST_ASSERT("Cannot serialize again", cframe2_len > 0);
+  blosc2_schunk *schunk3 = blosc2_schunk_from_buffer(cframe2, cframe2_len, true);
+  CUTEST_ASSERT("Wrong serialization again", schunk3 != NULL && schunk3->nchunks == NCHUNKS &&
+                                             schunk3->cbytes == schunk2->cbytes);
+  blosc2_schunk_free(schunk3);
+  if (needs_free2) {
+    free(cframe2);
+  }
+  blosc2_schunk_free(schunk2);
+  if (needs_free) {
+    free(cframe);
+  }
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+  free(expected);
+  free(values);
+  if (shared_pool > 0) {
+    blosc2_set_shared_threadpool(0);
+  }
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(schunk_to_buffer) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(schunk_to_buffer);
+}
@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the reuse of the scratch blocks and ZSTD contexts of short-lived contexts.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NITEMS (256 * 1000)
+#define NROUNDS 20
+
+
+typedef struct {
+  int16_t nthreads;
+  int compcode;
+} test_scratch_pool_backend;
+
+CUTEST_TEST_DATA(scratch_pool) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(scratch_pool) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+
+  CUTEST_PARAMETRIZE(backend, test_scratch_pool_backend, CUTEST_DATA(
+      {1, BLOSC_ZSTD},
+      {4, BLOSC_ZSTD},
+      {1, BLOSC_LZ4},
+      {4, BLOSC_BLOSCLZ},
+  ));
+}
+
+
+CUTEST_TEST_TEST(scratch_pool) {
+  CUTEST_GET_PARAMETER(backend, test_scratch_pool_backend);
+
+  int32_t nbytes = NITEMS * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  int32_t *rec_buffer = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  for (int j = 0; j < NITEMS; j++) {
+    data_buffer[j] = j / 3;
+  }
+
+  /* Blocksizes (and typesizes) change from a context to the next, so that the blocks
+   * that are checked out of the pool are of different classes and sizes */
+  int32_t blocksizes[] = {0, 4 * 1024, 64 * 1024, 12 * 1000, 1024 * 1024, 300};
+  int32_t typesizes[] = {4, 2, 8, 1, 4, 255};
+  int nsizes = sizeof(blocksizes) / sizeof(blocksizes[0]);
+  for (int i = 0; i < NROUNDS; i++) {
+    blosc2_cparams cparams = data->cparams;
+    cparams.compcode = (uint8_t) backend.compcode;
+    cparams.typesize = typesizes[i % nsizes];
+    cparams.blocksize = blocksizes[i % nsizes];
+    cparams.nthreads = backend.nthreads;
+    blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+    dparams.nthreads = backend.nthreads;
+    blosc2_context *cctx = blosc2_create_cctx(cparams);
+    blosc2_context *dctx = blosc2_create_dctx(dparams);
+    int32_t size = nbytes - (nbytes % cparams.typesize);
+    int cbytes = blosc2_compress_ctx(cctx, data_buffer, size, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+    CUTEST_ASSERT("Error compressing", cbytes > 0);
+    int dbytes = blosc2_decompress_ctx(dctx, chunk, cbytes, rec_buffer, nbytes);
+    CUTEST_ASSERT("Error decompressing", dbytes == size);
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffer, size) == 0);
+    blosc2_free_ctx(cctx);
+    blosc2_free_ctx(dctx);
+    if (i == NROUNDS / 2) {
+      /* Releasing the resources empties the pool */
+      CUTEST_ASSERT("Error releasing the resources", blosc2_free_resources() == 0);
+    }
+  }
+
+  free(data_buffer);
+  free(rec_buffer);
+  free(chunk);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(scratch_pool) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(scratch_pool);
+}
@@ -0,0 +1,142 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for writing chunks to file descriptors (blosc2_schunk_send_chunks()).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS 10
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  bool mmap;
+} test_send_chunks_backend;
+
+CUTEST_TEST_DATA(send_chunks) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(send_chunks) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_send_chunks_backend, CUTEST_DATA(
+      {false, NULL, false},  // no frame
+      {true, NULL, false},  // in-memory frame
+      {true, "test_send_chunks.b2frame", false},
+      {true, "test_send_chunks.b2frame", true},
+      {false, "test_send_chunks_s.b2frame", false},
+  ));
+  CUTEST_PARAMETRIZE(range, int, CUTEST_DATA(0, 1, 2));
+}
+
+
+/* Every third chunk is a special (zeros) one, and the last one is shorter */
+static int32_t fill_chunk(int32_t *buffer, int nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = nchunk % 3 == 2 ? 0 : nchunk * CHUNKSIZE + j;
+  }
+  return (nchunk == NCHUNKS - 1 ? CHUNKSIZE / 2 : CHUNKSIZE) * (int32_t) sizeof(int32_t);
+}
+
+
+CUTEST_TEST_TEST(send_chunks) {
+  CUTEST_GET_PARAMETER(backend, test_send_chunks_backend);
+  CUTEST_GET_PARAMETER(range, int);
+
+  // All the chunks, a single one and an empty range
+  int64_t starts[] = {0, 4, 3};
+  int64_t stops[] = {NCHUNKS, 5, 3};
+  int64_t start = starts[range];
+  int64_t stop = stops[range];
+
+  blosc2_remove_urlpath(backend.urlpath);
+  int32_t *data_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_stdio_mmap mmap_file = BLOSC2_STDIO_MMAP_DEFAULTS;
+  mmap_file.mode = "w+";
+  blosc2_io io = {.id = BLOSC2_IO_FILESYSTEM_MMAP, .name = "filesystem_mmap", .params = &mmap_file};
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath};
+  if (backend.mmap) {
+    storage.io = &io;
+  }
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+  for (int i = 0; i < NCHUNKS; ++i) {
+    int32_t nbytes = fill_chunk(data_buffer, i);
+    int64_t nchunks;
+    if (i % 3 == 2) {
+      CUTEST_ASSERT("Error creating a zeros chunk", blosc2_chunk_zeros(cparams, nbytes, zeros, sizeof(zeros)) > 0);
+      nchunks = blosc2_schunk_append_chunk(schunk, zeros, true);
+    }
+    else {
+      nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, nbytes);
+    }
+    CUTEST_ASSERT("Error during compression", nchunks == i + 1);
+  }
+
+  // What blosc2_schunk_get_chunk() gives, one chunk after the other
+  int64_t expected_len = 0;
+  uint8_t *expected = malloc(NCHUNKS * (CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD));
+  for (int64_t nchunk = start; nchunk < stop; nchunk++) {
+    uint8_t *chunk;
+    bool needs_free;
+    int cbytes = blosc2_schunk_get_chunk(schunk, nchunk, &chunk, &needs_free);
+    CUTEST_ASSERT("Cannot get the chunk", cbytes > 0);
+    memcpy(expected + expected_len, chunk, cbytes);
+    expected_len += cbytes;
+    if (needs_free) {
+      free(chunk);
+    }
+  }
+
+  FILE *out = tmpfile();
+  CUTEST_ASSERT("Cannot create the output file", out != NULL);
+  int fd = fileno(out);
+  int64_t sent = blosc2_schunk_send_chunks(schunk, start, stop, fd);
+  CUTEST_ASSERT("Wrong number of bytes sent", sent == expected_len);
+  // The chunks go after what is already in the file
+  sent = blosc2_schunk_send_chunks(schunk, start, stop, fd);
+  CUTEST_ASSERT("Wrong number of bytes sent", sent == expected_len);
+
+  uint8_t *received = malloc(2 * expected_len + 1);
+  rewind(out);
+  CUTEST_ASSERT("Wrong size of the output", (int64_t) fread(received, 1, 2 * expected_len + 1, out) == 2 * expected_len);
+  CUTEST_ASSERT("The chunks are not equal", memcmp(received, expected, expected_len) == 0);
+  CUTEST_ASSERT("The chunks are not equal", memcmp(received + expected_len, expected, expected_len) == 0);
+  CUTEST_ASSERT("Chunks out of range", blosc2_schunk_send_chunks(schunk, 0, NCHUNKS + 1, fd) < 0);
+  CUTEST_ASSERT("Chunks out of range", blosc2_schunk_send_chunks(schunk, 5, 4, fd) < 0);
+  fclose(out);
+
+  blosc2_schunk_free(schunk);
+  if (backend.mmap) {
+    CUTEST_ASSERT("Error unmapping the frame", blosc2_stdio_mmap_destroy(&mmap_file) == 0);
+  }
+  blosc2_remove_urlpath(backend.urlpath);
+  free(data_buffer);
+  free(expected);
+  free(received);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(send_chunks) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(send_chunks);
+}
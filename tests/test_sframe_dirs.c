@@ -0,0 +1,137 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for sparse frames that spread their files over subdirectories.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 1000
+#define NCHUNKS 300
+#define URLPATH "test_sframe_dirs.b2frame"
+
+
+typedef struct {
+  int32_t dir_levels;
+  int32_t shard_nchunks;
+} test_dirs;
+
+CUTEST_TEST_DATA(sframe_dirs) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(sframe_dirs) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(tdirs, test_dirs, CUTEST_DATA(
+      {0, 0},
+      {1, 0},
+      {2, 0},
+      {3, 4},
+  ));
+}
+
+
+static int check_chunks(blosc2_schunk *schunk, int64_t updated) {
+  int32_t buffer[CHUNKSIZE];
+  int errors = 0;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, sizeof(buffer));
+    if (dsize != (int) sizeof(buffer)) {
+      errors++;
+      continue;
+    }
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      int32_t value = nchunk == updated ? -i : (int32_t) (nchunk * CHUNKSIZE + i);
+      if (buffer[i] != value) {
+        errors++;
+        break;
+      }
+    }
+  }
+  return errors;
+}
+
+
+static bool file_exists(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return false;
+  }
+  fclose(fp);
+  return true;
+}
+
+
+CUTEST_TEST_TEST(sframe_dirs) {
+  CUTEST_GET_PARAMETER(tdirs, test_dirs);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=URLPATH, .dir_levels=4};
+  blosc2_remove_urlpath(URLPATH);
+  CUTEST_ASSERT("Too many levels are accepted", blosc2_schunk_new(&storage) == NULL);
+  storage.dir_levels = tdirs.dir_levels;
+  storage.shard_nchunks = tdirs.shard_nchunks;
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int32_t buffer[CHUNKSIZE];
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      buffer[i] = (int32_t) (nchunk * CHUNKSIZE + i);
+    }
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, sizeof(buffer)) == nchunk + 1);
+  }
+  CUTEST_ASSERT("Wrong chunks", check_chunks(schunk, -1) == 0);
+
+  // The file with id 0x4A, named after its lowest bytes
+  int64_t nchunk = tdirs.shard_nchunks > 0 ? 0x4A * tdirs.shard_nchunks : 0x4A;
+  const char *ext = tdirs.shard_nchunks > 0 ? "shard" : "chunk";
+  const char *dirs[] = {"", "/4A", "/4A/00", "/4A/00/00"};
+  char path[256];
+  sprintf(path, "%s%s/0000004A.%s", URLPATH, dirs[tdirs.dir_levels], ext);
+  CUTEST_ASSERT("The file is not in its subdirectory", file_exists(path));
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, nchunk) == NCHUNKS - 1);
+  if (tdirs.shard_nchunks == 0) {
+    CUTEST_ASSERT("The file is not deleted", !file_exists(path));
+  }
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    buffer[i] = -i;
+  }
+  uint8_t chunk[sizeof(buffer) + BLOSC2_MAX_OVERHEAD];
+  int cbytes = blosc2_compress_ctx(schunk->cctx, buffer, sizeof(buffer), chunk, sizeof(chunk));
+  CUTEST_ASSERT("Cannot compress the chunk", cbytes > 0);
+  CUTEST_ASSERT("Cannot insert the chunk", blosc2_schunk_insert_chunk(schunk, nchunk, chunk, true) == NCHUNKS);
+  CUTEST_ASSERT("Wrong chunks after updating", check_chunks(schunk, nchunk) == 0);
+
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("The levels are not kept", schunk->storage->dir_levels == tdirs.dir_levels);
+  CUTEST_ASSERT("Wrong chunks after reopening", check_chunks(schunk, nchunk) == 0);
+  blosc2_schunk_free(schunk);
+
+  CUTEST_ASSERT("Cannot remove the frame", blosc2_remove_urlpath(URLPATH) == BLOSC2_ERROR_SUCCESS);
+  CUTEST_ASSERT("The subdirectories are left", !file_exists(URLPATH "/chunks.b2frame"));
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(sframe_dirs) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(sframe_dirs);
+}
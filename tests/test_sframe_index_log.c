@@ -0,0 +1,138 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for sparse frames that record their appends in an index log.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 100
+#define NCHUNKS 50
+#define NMANY 4200  // more than the appends kept in the log
+#define URLPATH "test_sframe_index_log.b2frame"
+
+
+CUTEST_TEST_DATA(sframe_index_log) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(sframe_index_log) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(shard_nchunks, int32_t, CUTEST_DATA(0, 64));
+}
+
+
+static int64_t file_len(const char *name) {
+  FILE *fp = fopen(name, "rb");
+  if (fp == NULL) {
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  int64_t len = ftell(fp);
+  fclose(fp);
+  return len;
+}
+
+
+static int append_chunks(blosc2_schunk *schunk, int64_t nchunks) {
+  int32_t buffer[CHUNKSIZE];
+  for (int64_t nchunk = schunk->nchunks; nchunks > 0; nchunk++, nchunks--) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      buffer[i] = (int32_t) (nchunk * CHUNKSIZE + i);
+    }
+    if (blosc2_schunk_append_buffer(schunk, buffer, sizeof(buffer)) != nchunk + 1) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+static int check_chunks(blosc2_schunk *schunk, int64_t nchunks) {
+  int32_t buffer[CHUNKSIZE];
+  int errors = schunk->nchunks != nchunks;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, sizeof(buffer));
+    if (dsize != (int) sizeof(buffer) || buffer[CHUNKSIZE - 1] != nchunk * CHUNKSIZE + CHUNKSIZE - 1) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(sframe_index_log) {
+  CUTEST_GET_PARAMETER(shard_nchunks, int32_t);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=URLPATH, .shard_nchunks=shard_nchunks,
+                            .index_log=true};
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong log", file_len(URLPATH "/chunks.b2log") == 0);
+
+  // The index is not rewritten by the appends
+  CUTEST_ASSERT("Cannot append the chunks", append_chunks(schunk, 1) == 0);
+  int64_t index_len = file_len(URLPATH "/chunks.b2frame");
+  int64_t entry_len = file_len(URLPATH "/chunks.b2log");
+  CUTEST_ASSERT("The append is not in the log", entry_len > 0);
+  CUTEST_ASSERT("Cannot append the chunks", append_chunks(schunk, NCHUNKS - 1) == 0);
+  CUTEST_ASSERT("The index is rewritten", file_len(URLPATH "/chunks.b2frame") == index_len);
+  CUTEST_ASSERT("Wrong log", file_len(URLPATH "/chunks.b2log") == NCHUNKS * entry_len);
+  CUTEST_ASSERT("Wrong chunks", check_chunks(schunk, NCHUNKS) == 0);
+
+  // Another opening (like after a crash) replays the log
+  blosc2_schunk *other = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot open the super-chunk", other != NULL);
+  CUTEST_ASSERT("Wrong chunks replayed", check_chunks(other, NCHUNKS) == 0);
+  CUTEST_ASSERT("Wrong sizes replayed", other->nbytes == schunk->nbytes && other->cbytes == schunk->cbytes);
+  blosc2_schunk_free(other);
+  CUTEST_ASSERT("The log is not merged", file_len(URLPATH "/chunks.b2log") == 0);
+
+  // Other changes merge the log first
+  CUTEST_ASSERT("Cannot append the chunks", append_chunks(schunk, 1) == 0);
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, NCHUNKS) == NCHUNKS);
+  CUTEST_ASSERT("The log is not merged", file_len(URLPATH "/chunks.b2log") == 0);
+
+  // The log is merged from time to time
+  CUTEST_ASSERT("Cannot append the chunks", append_chunks(schunk, NMANY) == 0);
+  CUTEST_ASSERT("The log is not merged", file_len(URLPATH "/chunks.b2log") < NMANY * entry_len);
+  CUTEST_ASSERT("Wrong chunks", check_chunks(schunk, NCHUNKS + NMANY) == 0);
+  blosc2_schunk_free(schunk);
+  CUTEST_ASSERT("The log is not merged", file_len(URLPATH "/chunks.b2log") == 0);
+
+  // The reopened frame keeps logging the appends
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong chunks after reopening", check_chunks(schunk, NCHUNKS + NMANY) == 0);
+  CUTEST_ASSERT("Cannot append the chunks", append_chunks(schunk, 2) == 0);
+  CUTEST_ASSERT("The appends are not in the log", file_len(URLPATH "/chunks.b2log") == 2 * entry_len);
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Wrong chunks after reopening", check_chunks(schunk, NCHUNKS + NMANY + 2) == 0);
+  blosc2_schunk_free(schunk);
+
+  blosc2_remove_urlpath(URLPATH);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(sframe_index_log) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(sframe_index_log);
+}
@@ -0,0 +1,175 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for sparse frames that pack their chunks into shard files.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS 40
+#define SHARD_NCHUNKS 8
+#define URLPATH "test_sframe_shards.b2frame"
+
+
+CUTEST_TEST_DATA(sframe_shards) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(sframe_shards) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(in_place, bool, CUTEST_DATA(true, false));
+}
+
+
+/* Noise does not compress, so updating with it leaves the old chunk behind in its shard */
+static void fill_chunk(int32_t *buffer, int64_t tag, bool noise) {
+  uint32_t state = (uint32_t) tag + 1;
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    state = state * 1664525u + 1013904223u;
+    buffer[i] = tag < 0 ? 0 : noise ? (int32_t) state : (int32_t) (tag * CHUNKSIZE + i);
+  }
+}
+
+
+/* The tag of every chunk (-1 for zeros), and whether it is noise */
+static int check_chunks(blosc2_schunk *schunk, const int64_t *tags, const bool *noise) {
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *expected = malloc(CHUNKSIZE * sizeof(int32_t));
+  int errors = 0;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    fill_chunk(expected, tags[nchunk], noise[nchunk]);
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKSIZE * sizeof(int32_t));
+    if (dsize != CHUNKSIZE * (int) sizeof(int32_t) ||
+        memcmp(buffer, expected, CHUNKSIZE * sizeof(int32_t)) != 0) {
+      errors++;
+      continue;
+    }
+    // Blocks read from the shard files
+    uint8_t *lazy_chunk;
+    bool needs_free;
+    int cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &lazy_chunk, &needs_free);
+    int start = CHUNKSIZE / 2 + 17;
+    dsize = cbytes < 0 ? cbytes : blosc2_getitem_ctx(schunk->dctx, lazy_chunk, cbytes, start, 100,
+                                                     buffer, 100 * sizeof(int32_t));
+    if (dsize != 100 * (int) sizeof(int32_t) ||
+        memcmp(buffer, expected + start, 100 * sizeof(int32_t)) != 0) {
+      errors++;
+    }
+    if (cbytes >= 0 && needs_free) {
+      free(lazy_chunk);
+    }
+  }
+  free(buffer);
+  free(expected);
+  return errors;
+}
+
+
+static bool file_exists(const char *name) {
+  char path[256];
+  sprintf(path, "%s/%s", URLPATH, name);
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return false;
+  }
+  fclose(fp);
+  return true;
+}
+
+
+CUTEST_TEST_TEST(sframe_shards) {
+  CUTEST_GET_PARAMETER(in_place, bool);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.blocksize = 4 * 1000;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=URLPATH, .shard_nchunks=12};
+  blosc2_remove_urlpath(URLPATH);
+  CUTEST_ASSERT("Shards of any size are accepted", blosc2_schunk_new(&storage) == NULL);
+  storage.shard_nchunks = SHARD_NCHUNKS;
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int64_t tags[NCHUNKS + 1];
+  bool noise[NCHUNKS + 1] = {false};
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(buffer, nchunk, false);
+    tags[nchunk] = nchunk;
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, CHUNKSIZE * sizeof(int32_t)) == nchunk + 1);
+  }
+  CUTEST_ASSERT("Wrong chunks", check_chunks(schunk, tags, noise) == 0);
+  char name[32];
+  for (int shard = 0; shard < NCHUNKS / SHARD_NCHUNKS; shard++) {
+    sprintf(name, "%08X.shard", shard);
+    CUTEST_ASSERT("Missing shard", file_exists(name));
+  }
+  sprintf(name, "%08X.shard", NCHUNKS / SHARD_NCHUNKS);
+  CUTEST_ASSERT("Too many shards", !file_exists(name));
+  CUTEST_ASSERT("The chunks have their own files", !file_exists("00000000.chunk"));
+
+  // Updates with larger and special chunks, inserts and deletes
+  uint8_t *chunk = malloc(CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  for (int64_t nchunk = 1; nchunk < NCHUNKS; nchunk += 3) {
+    fill_chunk(buffer, nchunk, true);
+    noise[nchunk] = true;
+    int cbytes = blosc2_compress_ctx(schunk->cctx, buffer, CHUNKSIZE * sizeof(int32_t), chunk,
+                                     CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+    CUTEST_ASSERT("Cannot compress the chunk", cbytes > 0);
+    CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, nchunk, chunk, true) == NCHUNKS);
+  }
+  int cbytes = blosc2_chunk_zeros(cparams, CHUNKSIZE * sizeof(int32_t), chunk, BLOSC_EXTENDED_HEADER_LENGTH);
+  CUTEST_ASSERT("Cannot create the zeros chunk", cbytes > 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 9, chunk, true) == NCHUNKS);
+  tags[9] = -1;
+  fill_chunk(buffer, 100, false);
+  cbytes = blosc2_compress_ctx(schunk->cctx, buffer, CHUNKSIZE * sizeof(int32_t), chunk,
+                               CHUNKSIZE * sizeof(int32_t) + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot insert the chunk", blosc2_schunk_insert_chunk(schunk, 5, chunk, true) == NCHUNKS + 1);
+  memmove(tags + 6, tags + 5, (NCHUNKS - 5) * sizeof(int64_t));
+  memmove(noise + 6, noise + 5, (NCHUNKS - 5) * sizeof(bool));
+  tags[5] = 100;
+  noise[5] = false;
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, 20) == NCHUNKS);
+  memmove(tags + 20, tags + 21, (NCHUNKS - 20) * sizeof(int64_t));
+  memmove(noise + 20, noise + 21, (NCHUNKS - 20) * sizeof(bool));
+  free(chunk);
+  free(buffer);
+  CUTEST_ASSERT("Wrong chunks before compacting", check_chunks(schunk, tags, noise) == 0);
+
+  int64_t reclaimed = blosc2_schunk_compact(schunk, in_place);
+  CUTEST_ASSERT("Nothing reclaimed", reclaimed > 0);
+  CUTEST_ASSERT("Wrong chunks after compacting", check_chunks(schunk, tags, noise) == 0);
+  CUTEST_ASSERT("Nothing to reclaim twice", blosc2_schunk_compact(schunk, in_place) == 0);
+
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("The shards are not kept", schunk->storage->shard_nchunks == SHARD_NCHUNKS);
+  CUTEST_ASSERT("Wrong chunks after reopening", check_chunks(schunk, tags, noise) == 0);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(sframe_shards) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(sframe_shards);
+}
@@ -0,0 +1,185 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the dictionary shared by the chunks of a super-chunk.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (8 * 1000)
+#define NCHUNKS 50
+#define NTRAIN 10
+
+
+typedef struct {
+  int compcode;
+  bool contiguous;
+  char *urlpath;
+} test_shared_dict_backend;
+
+CUTEST_TEST_DATA(shared_dict) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(shared_dict) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(backend, test_shared_dict_backend, CUTEST_DATA(
+      {BLOSC_ZSTD, false, NULL},
+      {BLOSC_ZSTD, true, NULL},
+      {BLOSC_ZSTD, true, "test_shared_dict.b2frame"},
+      {BLOSC_ZSTD, false, "test_shared_dict_s.b2frame"},
+      {BLOSC_LZ4, true, NULL},
+      {BLOSC_LZ4, true, "test_shared_dict.b2frame"},
+      {BLOSC_BLOSCLZ, false, NULL},
+      {BLOSC_BLOSCLZ, true, "test_shared_dict.b2frame"},
+  ));
+}
+
+
+static void fill_buffer(int32_t *buffer, int nchunk) {
+  // Small chunks of text-like records, which is where dictionaries pay off
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = (nchunk * 7 + j) % 311 + ((j / 16) % 3) * 1000;
+  }
+}
+
+static int64_t append_chunks(blosc2_schunk *schunk, int32_t *buffer, int start, int stop) {
+  for (int i = start; i < stop; i++) {
+    fill_buffer(buffer, i);
+    int64_t nchunks = blosc2_schunk_append_buffer(schunk, buffer, CHUNKSIZE * sizeof(int32_t));
+    if (nchunks != i + 1) {
+      return -1;
+    }
+  }
+  return schunk->cbytes;
+}
+
+static int check_chunks(blosc2_schunk *schunk, int32_t *buffer, int32_t *rec_buffer, int nchunks) {
+  for (int i = 0; i < nchunks; i++) {
+    fill_buffer(buffer, i);
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, CHUNKSIZE * sizeof(int32_t));
+    if (dsize != CHUNKSIZE * (int)sizeof(int32_t) ||
+        memcmp(buffer, rec_buffer, dsize) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+CUTEST_TEST_TEST(shared_dict) {
+  CUTEST_GET_PARAMETER(backend, test_shared_dict_backend);
+
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int32_t *rec_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  blosc2_remove_urlpath(backend.urlpath);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.compcode = (uint8_t) backend.compcode;
+  cparams.clevel = 5;
+  cparams.blocksize = 8 * 1024;
+  cparams.nthreads = 2;
+
+  /* The reference: a dictionary per chunk */
+  cparams.use_dict = 1;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  int64_t cbytes_chunk_dicts = append_chunks(schunk, buffer, 0, NCHUNKS);
+  CUTEST_ASSERT("Error appending", cbytes_chunk_dicts > 0);
+  blosc2_schunk_free(schunk);
+
+  /* Train the dictionary on the first chunks, and append the rest afterwards */
+  cparams.use_dict = 0;
+  storage.urlpath = backend.urlpath;
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Error appending", append_chunks(schunk, buffer, 0, NTRAIN) > 0);
+  CUTEST_ASSERT("Training on no chunks should fail", blosc2_schunk_train_dict(schunk, 0) < 0);
+  CUTEST_ASSERT("Error training", blosc2_schunk_train_dict(schunk, NTRAIN) == 0);
+  CUTEST_ASSERT("Training twice should fail", blosc2_schunk_train_dict(schunk, NTRAIN) < 0);
+  CUTEST_ASSERT("The dictionary is not stored",
+                blosc2_vlmeta_exists(schunk, "b2dict") >= 0);
+  int64_t cbytes = append_chunks(schunk, buffer, NTRAIN, NCHUNKS);
+  CUTEST_ASSERT("Error appending", cbytes > 0);
+  CUTEST_ASSERT("Error decompressing", check_chunks(schunk, buffer, rec_buffer, NCHUNKS) == 0);
+  if (backend.urlpath == NULL) {
+    // Updates on disk leave the space of the replaced chunks behind
+    CUTEST_ASSERT("The shared dictionary does not pay off", cbytes < cbytes_chunk_dicts);
+  }
+
+  /* Chunks referencing the dictionary cannot be decompressed out of their super-chunk */
+  uint8_t *chunk;
+  bool needs_free;
+  CUTEST_ASSERT("Error getting the chunk", blosc2_schunk_get_chunk(schunk, 1, &chunk, &needs_free) > 0);
+  CUTEST_ASSERT("Decompressing with no dictionary should fail",
+                blosc2_decompress(chunk, INT32_MAX, rec_buffer, CHUNKSIZE * sizeof(int32_t)) < 0);
+  if (needs_free) {
+    free(chunk);
+  }
+
+  /* The dictionary survives the serialization and reopening */
+  blosc2_schunk *schunk2;
+  uint8_t *cframe = NULL;
+  needs_free = false;
+  if (backend.urlpath != NULL) {
+    schunk2 = blosc2_schunk_open(backend.urlpath);
+  }
+  else {
+    int64_t len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+    CUTEST_ASSERT("Error serializing the frame", len > 0);
+    schunk2 = blosc2_schunk_from_buffer(cframe, len, true);
+  }
+  CUTEST_ASSERT("Error reopening the super-chunk", schunk2 != NULL);
+  CUTEST_ASSERT("The dictionary is not loaded", schunk2->shared_dict != NULL);
+  CUTEST_ASSERT("Error decompressing", check_chunks(schunk2, buffer, rec_buffer, NCHUNKS) == 0);
+  int64_t cbytes2 = schunk2->cbytes;
+  CUTEST_ASSERT("Error appending", append_chunks(schunk2, buffer, NCHUNKS, NCHUNKS + 1) > 0);
+  CUTEST_ASSERT("New chunks do not reference the dictionary",
+                schunk2->cbytes - cbytes2 < (cbytes_chunk_dicts / NCHUNKS));
+  CUTEST_ASSERT("Error decompressing", check_chunks(schunk2, buffer, rec_buffer, NCHUNKS + 1) == 0);
+
+  /* So does the copy of the super-chunk, with the same and with other cparams */
+  blosc2_storage storage2 = {.contiguous=true};
+  blosc2_schunk *schunk3 = blosc2_schunk_copy(schunk2, &storage2);
+  CUTEST_ASSERT("Error copying the super-chunk", schunk3 != NULL);
+  CUTEST_ASSERT("The dictionary is not copied", schunk3->shared_dict != NULL);
+  CUTEST_ASSERT("Error decompressing", check_chunks(schunk3, buffer, rec_buffer, NCHUNKS + 1) == 0);
+  blosc2_schunk_free(schunk3);
+  blosc2_cparams cparams2 = BLOSC2_CPARAMS_DEFAULTS;
+  cparams2.typesize = sizeof(int32_t);
+  storage2.cparams = &cparams2;
+  schunk3 = blosc2_schunk_copy(schunk2, &storage2);
+  CUTEST_ASSERT("Error copying the super-chunk", schunk3 != NULL);
+  CUTEST_ASSERT("The dictionary should not be copied", schunk3->shared_dict == NULL);
+  CUTEST_ASSERT("Error decompressing", check_chunks(schunk3, buffer, rec_buffer, NCHUNKS + 1) == 0);
+  blosc2_schunk_free(schunk3);
+
+  blosc2_schunk_free(schunk2);
+  if (needs_free) {
+    free(cframe);
+  }
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(backend.urlpath);
+  free(buffer);
+  free(rec_buffer);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(shared_dict) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(shared_dict);
+}
@@ -0,0 +1,177 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the process-wide pool of threads shared among contexts.
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+#include <pthread.h>
+
+int tests_run = 0;
+
+#define NITEMS (500 * 1000)
+#define NCONTEXTS 8
+#define NCALLERS 4
+
+/* Global vars */
+int32_t *src;
+int bytesize = NITEMS * (int)sizeof(int32_t);
+int scheduler;
+
+
+/* Roundtrip a buffer with a couple of fresh contexts.  Returns 0 on success. */
+static int roundtrip(int16_t nthreads) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = nthreads;
+  cparams.blocksize = 8 * 1024;
+  cparams.scheduler = scheduler;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  dparams.scheduler = scheduler;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  uint8_t *dest = malloc(bytesize + BLOSC2_MAX_OVERHEAD);
+  int32_t *dest2 = malloc(bytesize);
+  int rc = 0;
+
+  int cbytes = blosc2_compress_ctx(cctx, src, bytesize, dest, bytesize + BLOSC2_MAX_OVERHEAD);
+  if (cbytes <= 0) {
+    rc = -1;
+  }
+  else {
+    int nbytes = blosc2_decompress_ctx(dctx, dest, cbytes, dest2, bytesize);
+    if (nbytes != bytesize || memcmp(src, dest2, bytesize) != 0) {
+      rc = -1;
+    }
+  }
+
+  free(dest);
+  free(dest2);
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  return rc;
+}
+
+
+static void *caller(void *arg) {
+  int *result = (int *)arg;
+  *result = 0;
+  for (int i = 0; i < NCONTEXTS; i++) {
+    if (roundtrip((int16_t)(2 + i % 4)) < 0) {
+      *result = -1;
+    }
+  }
+  return NULL;
+}
+
+
+static char *test_single_caller(void) {
+  mu_assert("ERROR: cannot create the shared pool", blosc2_set_shared_threadpool(3) == 0);
+  mu_assert("ERROR: wrong size for the shared pool", blosc2_get_shared_threadpool() == 3);
+  for (int i = 0; i < NCONTEXTS; i++) {
+    mu_assert("ERROR: bad roundtrip", roundtrip(4) == 0);
+  }
+  return 0;
+}
+
+
+static char *test_concurrent_callers(void) {
+  pthread_t threads[NCALLERS];
+  int results[NCALLERS];
+
+  mu_assert("ERROR: cannot create the shared pool", blosc2_set_shared_threadpool(2) == 0);
+  for (int i = 0; i < NCALLERS; i++) {
+    pthread_create(&threads[i], NULL, caller, &results[i]);
+  }
+  for (int i = 0; i < NCALLERS; i++) {
+    pthread_join(threads[i], NULL);
+    mu_assert("ERROR: bad roundtrip in concurrent caller", results[i] == 0);
+  }
+  return 0;
+}
+
+
+/* Contexts created while the pool is active should keep working after it is gone */
+static char *test_switch_backend(void) {
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = 4;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 4;
+  uint8_t *dest = malloc(bytesize + BLOSC2_MAX_OVERHEAD);
+  int32_t *dest2 = malloc(bytesize);
+
+  mu_assert("ERROR: cannot create the shared pool", blosc2_set_shared_threadpool(2) == 0);
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  for (int i = 0; i < 4; i++) {
+    if (i == 2) {
+      mu_assert("ERROR: cannot destroy the shared pool", blosc2_set_shared_threadpool(0) == 0);
+      mu_assert("ERROR: the shared pool still exists", blosc2_get_shared_threadpool() == 0);
+    }
+    int cbytes = blosc2_compress_ctx(cctx, src, bytesize, dest, bytesize + BLOSC2_MAX_OVERHEAD);
+    mu_assert("ERROR: cbytes is not correct", cbytes > 0);
+    int nbytes = blosc2_decompress_ctx(dctx, dest, cbytes, dest2, bytesize);
+    mu_assert("ERROR: nbytes is not correct", nbytes == bytesize);
+    mu_assert("ERROR: wrong values in dest", memcmp(src, dest2, bytesize) == 0);
+  }
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  free(dest);
+  free(dest2);
+  return 0;
+}
+
+
+static char *all_tests(void) {
+  int schedulers[] = {BLOSC_DEFAULT_SCHED, BLOSC_WORKSTEALING_SCHED};
+  for (int i = 0; i < (int)ARRAY_SIZE(schedulers); i++) {
+    scheduler = schedulers[i];
+    mu_run_test(test_single_caller);
+    mu_run_test(test_concurrent_callers);
+  }
+  mu_run_test(test_switch_backend);
+  mu_assert("ERROR: invalid number of threads accepted", blosc2_set_shared_threadpool(-1) < 0);
+
+  return 0;
+}
+
+
+int main(void) {
+  char *result;
+
+  if (getenv("BLOSC_TEST_CALLBACK") != NULL) {
+    /* The shared pool and the threads callback are different backends */
+    printf(" SKIPPED (callback backend active)\n");
+    return 0;
+  }
+  blosc2_init();
+
+  src = malloc(bytesize);
+  for (int i = 0; i < NITEMS; i++) {
+    src[i] = (i % 1000 < 500) ? i : rand();
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  free(src);
+  blosc2_destroy();
+
+  return result != 0;
+}
@@ -0,0 +1,126 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for contiguous frames shared between processes through named shared memory.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS 10
+#define SHM_NAME "/test_shm.b2frame"
+
+
+CUTEST_TEST_DATA(shm) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(shm) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(contiguous, bool, CUTEST_DATA(true, false));
+}
+
+
+static int check_chunks(blosc2_schunk *schunk) {
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int errors = schunk->nchunks != NCHUNKS;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKSIZE * sizeof(int32_t));
+    if (dsize != CHUNKSIZE * (int) sizeof(int32_t) || buffer[CHUNKSIZE - 1] != nchunk * CHUNKSIZE + CHUNKSIZE - 1) {
+      errors++;
+      continue;
+    }
+    // Blocks read straight from the shared memory
+    uint8_t *lazy_chunk;
+    bool needs_free;
+    int cbytes = blosc2_schunk_get_lazychunk(schunk, nchunk, &lazy_chunk, &needs_free);
+    dsize = cbytes < 0 ? cbytes : blosc2_getitem_ctx(schunk->dctx, lazy_chunk, cbytes, 1234, 10,
+                                                     buffer, 10 * sizeof(int32_t));
+    if (dsize != 10 * (int) sizeof(int32_t) || buffer[9] != nchunk * CHUNKSIZE + 1243) {
+      errors++;
+    }
+    if (cbytes >= 0 && needs_free) {
+      free(lazy_chunk);
+    }
+  }
+  free(buffer);
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(shm) {
+  CUTEST_GET_PARAMETER(contiguous, bool);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.blocksize = 4 * 1000;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=contiguous};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  uint8_t content[] = {1, 2, 3};
+  CUTEST_ASSERT("Cannot add the metalayer", blosc2_meta_add(schunk, "meta", content, 3) >= 0);
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      buffer[i] = (int32_t) (nchunk * CHUNKSIZE + i);
+    }
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, CHUNKSIZE * sizeof(int32_t)) == nchunk + 1);
+  }
+
+  blosc2_remove_shm(SHM_NAME);
+  int64_t len = blosc2_schunk_to_shm(schunk, SHM_NAME);
+  CUTEST_ASSERT("Cannot put the frame in shared memory", len > 0);
+  CUTEST_ASSERT("The shared memory is created twice", blosc2_schunk_to_shm(schunk, SHM_NAME) < 0);
+  blosc2_schunk_free(schunk);
+
+  // Two attachments see the same frame
+  blosc2_schunk *attached = blosc2_schunk_open_shm(SHM_NAME);
+  CUTEST_ASSERT("Cannot attach to the shared memory", attached != NULL);
+  blosc2_schunk *other = blosc2_schunk_open_shm(SHM_NAME);
+  CUTEST_ASSERT("Cannot attach twice to the shared memory", other != NULL);
+  CUTEST_ASSERT("Wrong chunks", check_chunks(attached) == 0);
+  CUTEST_ASSERT("Wrong chunks of the other attachment", check_chunks(other) == 0);
+  uint8_t *meta;
+  int32_t meta_len;
+  CUTEST_ASSERT("Cannot get the metalayer", blosc2_meta_get(attached, "meta", &meta, &meta_len) >= 0);
+  CUTEST_ASSERT("Wrong metalayer", meta_len == 3 && meta[2] == 3);
+  free(meta);
+
+  // Nothing can change
+  CUTEST_ASSERT("Appends are accepted",
+                blosc2_schunk_append_buffer(attached, buffer, CHUNKSIZE * sizeof(int32_t)) == BLOSC2_ERROR_READ_ONLY);
+  CUTEST_ASSERT("Deletes are accepted", blosc2_schunk_delete_chunk(attached, 0) == BLOSC2_ERROR_READ_ONLY);
+  CUTEST_ASSERT("Metalayer updates are accepted",
+                blosc2_meta_update(attached, "meta", content, 3) == BLOSC2_ERROR_READ_ONLY);
+  CUTEST_ASSERT("Variable-length metalayers are accepted",
+                blosc2_vlmeta_add(attached, "vlmeta", content, 3, NULL) == BLOSC2_ERROR_READ_ONLY);
+  CUTEST_ASSERT("Wrong chunks after the failed changes", check_chunks(attached) == 0);
+  free(buffer);
+
+  // The attachments outlive the name
+  CUTEST_ASSERT("Cannot remove the shared memory", blosc2_remove_shm(SHM_NAME) == BLOSC2_ERROR_SUCCESS);
+  CUTEST_ASSERT("Removed shared memory can be attached", blosc2_schunk_open_shm(SHM_NAME) == NULL);
+  CUTEST_ASSERT("Wrong chunks after removing", check_chunks(other) == 0);
+  blosc2_schunk_free(attached);
+  blosc2_schunk_free(other);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(shm) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(shm);
+}
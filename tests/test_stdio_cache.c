@@ -0,0 +1,148 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the cache of file handles of the filesystem io.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (20 * 1000)
+#define NCHUNKS 8
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+  int max_open;
+} test_stdio_cache_backend;
+
+CUTEST_TEST_DATA(stdio_cache) {
+  blosc2_cparams cparams;
+  blosc2_dparams dparams;
+};
+
+CUTEST_TEST_SETUP(stdio_cache) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.nthreads = 2;
+  data->dparams = BLOSC2_DPARAMS_DEFAULTS;
+  data->dparams.nthreads = 2;
+
+  CUTEST_PARAMETRIZE(backend, test_stdio_cache_backend, CUTEST_DATA(
+      {true, "test_stdio_cache.b2frame", 0},
+      {true, "test_stdio_cache.b2frame", 1},
+      {true, "test_stdio_cache.b2frame", 32},
+      {false, "test_stdio_cache_s.b2frame", 0},
+      {false, "test_stdio_cache_s.b2frame", 2},
+      {false, "test_stdio_cache_s.b2frame", 32},
+  ));
+}
+
+
+static void fill_chunk(int32_t *buffer, int nchunk, int32_t seed) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = seed + nchunk * CHUNKSIZE + j;
+  }
+}
+
+static blosc2_schunk *create_frame(blosc2_cparams *cparams, blosc2_dparams *dparams,
+                                   test_stdio_cache_backend backend, int32_t seed) {
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  blosc2_storage storage = {.cparams=cparams, .dparams=dparams,
+                            .contiguous=backend.contiguous, .urlpath=backend.urlpath};
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  for (int i = 0; i < NCHUNKS && schunk != NULL; ++i) {
+    fill_chunk(data_buffer, i, seed);
+    if (blosc2_schunk_append_buffer(schunk, data_buffer, nbytes) != i + 1) {
+      blosc2_schunk_free(schunk);
+      schunk = NULL;
+    }
+  }
+  free(data_buffer);
+  return schunk;
+}
+
+static bool check_frame(blosc2_schunk *schunk, int32_t seed) {
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *rec_buffer = malloc(nbytes);
+  bool ok = true;
+  /* Twice, so that the second pass reuses the cached handles */
+  for (int pass = 0; pass < 2 && ok; pass++) {
+    for (int i = 0; i < schunk->nchunks && ok; ++i) {
+      int32_t dbytes = blosc2_schunk_decompress_chunk(schunk, i, rec_buffer, nbytes);
+      ok = dbytes == nbytes;
+      for (int j = 0; j < CHUNKSIZE && ok; ++j) {
+        ok = rec_buffer[j] == seed + i * CHUNKSIZE + j;
+      }
+    }
+  }
+  free(rec_buffer);
+  return ok;
+}
+
+
+CUTEST_TEST_TEST(stdio_cache) {
+  CUTEST_GET_PARAMETER(backend, test_stdio_cache_backend);
+
+  int previous = blosc2_stdio_set_max_open(backend.max_open);
+  CUTEST_ASSERT("Wrong previous maximum", previous >= 0);
+  CUTEST_ASSERT("Negative maximums must fail", blosc2_stdio_set_max_open(-1) < 0);
+
+  blosc2_schunk *schunk = create_frame(&data->cparams, &data->dparams, backend, 0);
+  CUTEST_ASSERT("Error creating the frame", schunk != NULL);
+  blosc2_schunk_free(schunk);
+
+  schunk = blosc2_schunk_open(backend.urlpath);
+  CUTEST_ASSERT("Error opening the frame", schunk != NULL);
+  CUTEST_ASSERT("Data are not equal", check_frame(schunk, 0));
+
+  /* Updates must be seen by (cached) readers */
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  fill_chunk(data_buffer, 3, 7);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  int csize = blosc2_compress_ctx(schunk->cctx, data_buffer, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Error compressing", csize > 0);
+  CUTEST_ASSERT("Error updating", blosc2_schunk_update_chunk(schunk, 3, chunk, true) >= 0);
+  int32_t *rec_buffer = malloc(nbytes);
+  CUTEST_ASSERT("Error decompressing",
+                blosc2_schunk_decompress_chunk(schunk, 3, rec_buffer, nbytes) == nbytes);
+  for (int j = 0; j < CHUNKSIZE; ++j) {
+    CUTEST_ASSERT("Updated data are not equal", rec_buffer[j] == data_buffer[j]);
+  }
+  free(chunk);
+  free(rec_buffer);
+  free(data_buffer);
+  blosc2_schunk_free(schunk);
+
+  /* A removed and recreated frame must not be read through old handles */
+  schunk = create_frame(&data->cparams, &data->dparams, backend, 1000);
+  CUTEST_ASSERT("Error recreating the frame", schunk != NULL);
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open(backend.urlpath);
+  CUTEST_ASSERT("Error opening the frame", schunk != NULL);
+  CUTEST_ASSERT("Recreated data are not equal", check_frame(schunk, 1000));
+  blosc2_schunk_free(schunk);
+
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_stdio_set_max_open(previous);
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(stdio_cache) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(stdio_cache);
+}
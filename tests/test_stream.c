@@ -0,0 +1,215 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for writing and reading super-chunks as frame streams, with no seeks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (20 * 1000)
+#define NCHUNKS 10
+#define URLPATH "test_stream.b2frame"
+#define MAX_WRITE 1000
+#define MAX_READ 777
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+/* A pipe-like stream, in memory, with short writes and reads */
+typedef struct {
+  uint8_t *buf;
+  int64_t len;
+  int64_t cap;
+  int64_t pos;
+  int64_t nwrites;
+} test_stream;
+
+CUTEST_TEST_DATA(stream) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(stream) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.clevel = 5;
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(nchunks, int, CUTEST_DATA(0, NCHUNKS));
+  CUTEST_PARAMETRIZE(checksum, int, CUTEST_DATA(BLOSC2_CHECKSUM_NONE, BLOSC2_CHECKSUM_XXH3));
+}
+
+
+static int64_t stream_write(void *user_data, const void *buf, int64_t size) {
+  test_stream *stream = user_data;
+  size = size < MAX_WRITE ? size : MAX_WRITE;
+  if (stream->len + size > stream->cap) {
+    stream->cap = 2 * (stream->len + size);
+    stream->buf = realloc(stream->buf, stream->cap);
+  }
+  memcpy(stream->buf + stream->len, buf, size);
+  stream->len += size;
+  stream->nwrites++;
+  return size;
+}
+
+static int64_t stream_read(void *user_data, void *buf, int64_t size) {
+  test_stream *stream = user_data;
+  size = size < MAX_READ ? size : MAX_READ;
+  size = size < stream->len - stream->pos ? size : stream->len - stream->pos;
+  memcpy(buf, stream->buf + stream->pos, size);
+  stream->pos += size;
+  return size;
+}
+
+static void fill_chunk(int32_t *buffer, int64_t nchunk) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = (int32_t) (nchunk * CHUNKITEMS + i % 1000);
+  }
+}
+
+/* Check the chunks, the metalayers and the variable-length metalayers of a read stream */
+static int check_schunk(blosc2_schunk *schunk, int nchunks) {
+  int errors = schunk->nchunks != nchunks;
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  int32_t *expected = malloc(CHUNKITEMS * sizeof(int32_t));
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    fill_chunk(expected, nchunk);
+    int rc = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKITEMS * sizeof(int32_t));
+    errors += rc != CHUNKITEMS * (int) sizeof(int32_t) || memcmp(buffer, expected, rc) != 0;
+  }
+  free(expected);
+  free(buffer);
+
+  uint8_t *content;
+  int32_t content_len;
+  if (blosc2_meta_get(schunk, "shape", &content, &content_len) < 0) {
+    return errors + 1;
+  }
+  errors += content_len != 5 || memcmp(content, "10x20", 5) != 0;
+  free(content);
+  if (blosc2_vlmeta_get(schunk, "info", &content, &content_len) < 0) {
+    return errors + 1;
+  }
+  errors += content_len != 8 || memcmp(content, "streamed", 8) != 0;
+  free(content);
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(stream) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(nchunks, int);
+  CUTEST_GET_PARAMETER(checksum, int);
+
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  blosc2_cparams cparams = data->cparams;
+  cparams.checksum = checksum;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot add the metalayer", blosc2_meta_add(schunk, "shape", (uint8_t *) "10x20", 5) >= 0);
+  int32_t *buffer = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+    fill_chunk(buffer, nchunk);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+  }
+  CUTEST_ASSERT("Cannot add the vlmetalayer",
+                blosc2_vlmeta_add(schunk, "info", (uint8_t *) "streamed", 8, NULL) >= 0);
+
+  // A super-chunk goes through the stream chunk by chunk
+  test_stream stream = {0};
+  int64_t len = blosc2_schunk_to_stream(schunk, stream_write, &stream);
+  CUTEST_ASSERT("Cannot write the stream", len == stream.len);
+  CUTEST_ASSERT("The stream is not written piecewise", stream.nwrites > len / MAX_WRITE);
+  blosc2_storage storage2 = {.urlpath=tstorage.urlpath, .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage2.urlpath);
+  blosc2_schunk *schunk2 = blosc2_schunk_from_stream(stream_read, &stream, &storage2);
+  CUTEST_ASSERT("Cannot read the stream", schunk2 != NULL);
+  CUTEST_ASSERT("The stream is not read up to the end", stream.pos == stream.len);
+  CUTEST_ASSERT("Wrong super-chunk", check_schunk(schunk2, nchunks) == 0);
+  blosc2_cparams *cparams2;
+  blosc2_schunk_get_cparams(schunk2, &cparams2);
+  CUTEST_ASSERT("Wrong compression params",
+                cparams2->clevel == 5 && cparams2->typesize == sizeof(int32_t) && cparams2->checksum == checksum);
+  free(cparams2);
+  blosc2_schunk_free(schunk2);
+  if (tstorage.urlpath != NULL) {
+    schunk2 = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk2 != NULL);
+    CUTEST_ASSERT("Wrong super-chunk after reopening", check_schunk(schunk2, nchunks) == 0);
+    blosc2_schunk_free(schunk2);
+  }
+  blosc2_remove_urlpath(storage2.urlpath);
+
+  // The chunks can be compressed as they are written
+  test_stream stream2 = {0};
+  blosc2_schunk *empty = blosc2_schunk_new(&storage);
+  blosc2_meta_add(empty, "shape", (uint8_t *) "10x20", 5);
+  blosc2_stream_writer *writer = blosc2_stream_writer_new(empty, stream_write, &stream2);
+  CUTEST_ASSERT("Cannot create the writer", writer != NULL);
+  for (int64_t nchunk = 0; nchunk < nchunks; nchunk++) {
+    fill_chunk(buffer, nchunk);
+    CUTEST_ASSERT("Cannot append the buffer",
+                  blosc2_stream_writer_append_buffer(writer, buffer, chunksize) == nchunk + 1);
+  }
+  blosc2_vlmeta_add(empty, "info", (uint8_t *) "streamed", 8, NULL);
+  CUTEST_ASSERT("Cannot close the writer", blosc2_stream_writer_close(writer) == stream2.len);
+  blosc2_schunk_free(empty);
+  schunk2 = blosc2_schunk_from_stream(stream_read, &stream2, NULL);
+  CUTEST_ASSERT("Cannot read the stream", schunk2 != NULL);
+  CUTEST_ASSERT("Wrong super-chunk", check_schunk(schunk2, nchunks) == 0);
+  blosc2_schunk_free(schunk2);
+
+  // A truncated or corrupted stream is not read
+  stream.pos = 0;
+  stream.len -= 10;
+  CUTEST_ASSERT("The truncated stream is read", blosc2_schunk_from_stream(stream_read, &stream, NULL) == NULL);
+  stream.len += 10;
+  // The number of chunks after them, in the marker that ends them
+  int32_t header_len = (stream.buf[11] << 24) | (stream.buf[12] << 16) | (stream.buf[13] << 8) | stream.buf[14];
+  stream.pos = 0;
+  stream.buf[header_len + schunk->cbytes + 19] ^= 0x01;
+  CUTEST_ASSERT("The corrupted stream is read", blosc2_schunk_from_stream(stream_read, &stream, NULL) == NULL);
+
+  // Frames are not streams
+  uint8_t *cframe;
+  bool needs_free;
+  int64_t cframe_len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+  test_stream stream3 = {cframe, cframe_len, cframe_len, 0, 0};
+  CUTEST_ASSERT("The frame is read as a stream", blosc2_schunk_from_stream(stream_read, &stream3, NULL) == NULL);
+  if (needs_free) {
+    free(cframe);
+  }
+
+  free(stream.buf);
+  free(stream2.buf);
+  free(buffer);
+  blosc2_schunk_free(schunk);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(stream) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(stream);
+}
@@ -0,0 +1,108 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for compressing the streams of the blocks in parallel (BLOSC_STREAMS_SCHED).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define MAXBYTES (1000 * 1000)
+
+typedef struct {
+  int32_t nbytes;
+  int32_t blocksize;
+} test_sizes_t;
+
+
+CUTEST_TEST_DATA(streams_sched) {
+  uint8_t *src;
+  uint8_t *chunk;
+  uint8_t *chunk2;
+  uint8_t *dest;
+};
+
+
+CUTEST_TEST_SETUP(streams_sched) {
+  blosc2_init();
+  data->src = malloc(MAXBYTES);
+  data->chunk = malloc(MAXBYTES + BLOSC2_MAX_OVERHEAD);
+  data->chunk2 = malloc(MAXBYTES + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(MAXBYTES);
+  int32_t *items = (int32_t *) data->src;
+  for (int i = 0; i < MAXBYTES / (int) sizeof(int32_t); i++) {
+    // Some runs, and some items that do not compress well
+    items[i] = i < 20000 ? 7 : (i % 3 == 0 ? rand() : i / 10);
+  }
+
+  CUTEST_PARAMETRIZE(compcode, uint8_t, CUTEST_DATA(BLOSC_BLOSCLZ, BLOSC_LZ4, BLOSC_ZSTD));
+  CUTEST_PARAMETRIZE(typesize, int32_t, CUTEST_DATA(4, 8));
+  CUTEST_PARAMETRIZE(filter, uint8_t, CUTEST_DATA(BLOSC_NOFILTER, BLOSC_SHUFFLE));
+  CUTEST_PARAMETRIZE(sizes, test_sizes_t, CUTEST_DATA(
+      {MAXBYTES, 0},  // automatic blocksize
+      {256 * 1024, 256 * 1024},  // a single block
+      {MAXBYTES - 8 * 100, 128 * 1024},  // with a leftover block
+  ));
+}
+
+
+CUTEST_TEST_TEST(streams_sched) {
+  CUTEST_GET_PARAMETER(compcode, uint8_t);
+  CUTEST_GET_PARAMETER(typesize, int32_t);
+  CUTEST_GET_PARAMETER(filter, uint8_t);
+  CUTEST_GET_PARAMETER(sizes, test_sizes_t);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.compcode = compcode;
+  cparams.typesize = typesize;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter;
+  cparams.blocksize = sizes.blocksize;
+  cparams.splitmode = BLOSC_ALWAYS_SPLIT;
+  cparams.nthreads = 1;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data->src, sizes.nbytes, data->chunk, MAXBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  blosc2_free_ctx(cctx);
+
+  /* The streams compressed by different threads are laid out as a single thread does */
+  cparams.scheduler = BLOSC_STREAMS_SCHED;
+  cparams.nthreads = 4;
+  cctx = blosc2_create_cctx(cparams);
+  for (int i = 0; i < 2; i++) {
+    // The buffers of the context are reused by the next chunk
+    int csize2 = blosc2_compress_ctx(cctx, data->src, sizes.nbytes, data->chunk2, MAXBYTES + BLOSC2_MAX_OVERHEAD);
+    CUTEST_ASSERT("Not the chunk of a single thread",
+                  csize2 == csize && memcmp(data->chunk, data->chunk2, csize) == 0);
+  }
+
+  /* A destination with no room for the chunk */
+  int csize2 = blosc2_compress_ctx(cctx, data->src, sizes.nbytes, data->chunk2, csize / 2);
+  CUTEST_ASSERT("A chunk that does not fit", csize2 <= 0);
+  blosc2_free_ctx(cctx);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.scheduler = BLOSC_STREAMS_SCHED;
+  dparams.nthreads = 4;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, sizes.nbytes);
+  CUTEST_ASSERT("Wrong roundtrip", dsize == sizes.nbytes && memcmp(data->src, data->dest, sizes.nbytes) == 0);
+  blosc2_free_ctx(dctx);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(streams_sched) {
+  free(data->dest);
+  free(data->chunk2);
+  free(data->chunk);
+  free(data->src);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(streams_sched);
+}
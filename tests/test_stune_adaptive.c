@@ -0,0 +1,233 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the adaptive tuning of the codec params in stune, and for the
+  sampling of the chunks that it is based on.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS 30
+#define SAMPLING_TUNER 200
+
+
+typedef struct {
+  int objective;
+  double min_speed;
+  int nchunks;
+  int16_t nthreads;
+} test_stune_backend;
+
+CUTEST_TEST_DATA(stune_adaptive) {
+  int32_t *buffer;
+  int32_t *rec_buffer;
+};
+
+CUTEST_TEST_SETUP(stune_adaptive) {
+  blosc2_init();
+  data->buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  data->rec_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  // The same data for every chunk, so that the chunk sizes only depend on the params
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    data->buffer[i] = i / 3 + (i % 5) * 100;
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_stune_backend, CUTEST_DATA(
+      {BLOSC_STUNE_CRATIO, 0, 0, 1},
+      {BLOSC_STUNE_CRATIO, 0, 5, 1},
+      {BLOSC_STUNE_CRATIO, 0.001, 0, 2},
+      {BLOSC_STUNE_SPEED, 0, 0, 1},
+      {BLOSC_STUNE_BALANCED, 0, 0, 2},
+  ));
+}
+
+
+CUTEST_TEST_TEST(stune_adaptive) {
+  CUTEST_GET_PARAMETER(backend, test_stune_backend);
+
+  blosc2_stune_config config = {.objective=backend.objective, .min_speed=backend.min_speed,
+                                .nchunks=backend.nchunks};
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = backend.nthreads;
+  cparams.tuner_params = &config;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+
+  int32_t cbytes[NCHUNKS];
+  for (int i = 0; i < NCHUNKS; i++) {
+    int64_t cbytes_before = schunk->cbytes;
+    CUTEST_ASSERT("Error appending",
+                  blosc2_schunk_append_buffer(schunk, data->buffer, CHUNKSIZE * sizeof(int32_t)) == i + 1);
+    cbytes[i] = (int32_t)(schunk->cbytes - cbytes_before);
+  }
+
+  bool tried = false;
+  int32_t min_cbytes = cbytes[0];
+  for (int i = 0; i < NCHUNKS; i++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, data->rec_buffer, CHUNKSIZE * sizeof(int32_t));
+    CUTEST_ASSERT("Decompression error", dsize == CHUNKSIZE * (int)sizeof(int32_t));
+    CUTEST_ASSERT("Decompressed data differs",
+                  memcmp(data->buffer, data->rec_buffer, CHUNKSIZE * sizeof(int32_t)) == 0);
+    tried |= cbytes[i] != cbytes[0];
+    min_cbytes = cbytes[i] < min_cbytes ? cbytes[i] : min_cbytes;
+  }
+  CUTEST_ASSERT("No other params have been tried", tried);
+
+  // The tuning is over by the last chunks, which all get the chosen params
+  CUTEST_ASSERT("The tuning does not converge", cbytes[NCHUNKS - 1] == cbytes[NCHUNKS - 2]);
+  if (backend.nchunks > 0) {
+    for (int i = backend.nchunks; i < NCHUNKS; i++) {
+      CUTEST_ASSERT("The tuning goes on for too many chunks", cbytes[i] == cbytes[backend.nchunks]);
+    }
+  }
+  if (backend.objective == BLOSC_STUNE_CRATIO && backend.min_speed == 0) {
+    CUTEST_ASSERT("The best cratio is not chosen", cbytes[NCHUNKS - 1] == min_cbytes);
+  }
+  blosc2_schunk_free(schunk);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(stune_adaptive) {
+  free(data->buffer);
+  free(data->rec_buffer);
+  blosc2_destroy();
+}
+
+
+static int test_invalid_config(void) {
+  blosc2_init();
+  blosc2_stune_config config = {.objective=BLOSC_STUNE_BALANCED + 1};
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.tuner_params = &config;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_destroy();
+  if (cctx != NULL) {
+    printf("Contexts with an unknown tuning objective should be refused\n");
+    return 1;
+  }
+  return 0;
+}
+
+
+/* A tuner that just samples the chunks (the blocksize is set by the user) */
+static blosc2_sample_stats sampled_stats;
+static int sampling_rc;
+
+static int sampling_init(void *config, blosc2_context *cctx, blosc2_context *dctx) {
+  BLOSC_UNUSED_PARAM(config);
+  BLOSC_UNUSED_PARAM(cctx);
+  BLOSC_UNUSED_PARAM(dctx);
+  return 0;
+}
+
+static int sampling_next_blocksize(blosc2_context *context) {
+  sampling_rc = blosc2_sample_chunk(context, &sampled_stats);
+  return sampling_rc;
+}
+
+static int sampling_update(blosc2_context *context, double ctime) {
+  BLOSC_UNUSED_PARAM(context);
+  BLOSC_UNUSED_PARAM(ctime);
+  return 0;
+}
+
+static int sampling_free(blosc2_context *context) {
+  BLOSC_UNUSED_PARAM(context);
+  return 0;
+}
+
+static int test_sampling(void) {
+  blosc2_init();
+  blosc2_tuner tuner;
+  tuner.id = SAMPLING_TUNER;
+  tuner.name = "sampling";
+  tuner.init = sampling_init;
+  tuner.next_blocksize = sampling_next_blocksize;
+  tuner.next_cparams = sampling_next_blocksize;
+  tuner.update = sampling_update;
+  tuner.free = sampling_free;
+  if (blosc2_register_tuner(&tuner) < 0) {
+    printf("Error registering the tuner\n");
+    return 1;
+  }
+
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *values = malloc(nbytes);
+  uint8_t *chunk = malloc(nbytes + BLOSC2_MAX_OVERHEAD);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = 32 * 1024;
+  cparams.tuner_id = SAMPLING_TUNER;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int rc = 0;
+
+  // There is no source to sample out of the compression
+  if (blosc2_sample_chunk(cctx, &sampled_stats) >= 0) {
+    printf("Sampling with no source should fail\n");
+    rc = 1;
+  }
+
+  // Slowly growing integers are all about the shuffle
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    values[i] = i * 3;
+  }
+  if (blosc2_compress_ctx(cctx, values, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD) <= 0 || sampling_rc < 0 ||
+      sampled_stats.incompressible || sampled_stats.filter != BLOSC_SHUFFLE ||
+      sampled_stats.shuffled_entropy >= sampled_stats.entropy) {
+    printf("Wrong stats for integers: entropy %g, shuffled entropy %g, match ratio %g\n",
+           sampled_stats.entropy, sampled_stats.shuffled_entropy, sampled_stats.match_ratio);
+    rc = 1;
+  }
+
+  // Random bytes
+  uint32_t seed = 1;
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    seed = seed * 1664525 + 1013904223;
+    values[i] = (int32_t)seed;
+  }
+  if (blosc2_compress_ctx(cctx, values, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD) <= 0 || sampling_rc < 0 ||
+      !sampled_stats.incompressible || sampled_stats.entropy < 7.9) {
+    printf("Wrong stats for random bytes: entropy %g, shuffled entropy %g, match ratio %g\n",
+           sampled_stats.entropy, sampled_stats.shuffled_entropy, sampled_stats.match_ratio);
+    rc = 1;
+  }
+  blosc2_free_ctx(cctx);
+
+  // The adaptive stune stores them as they are
+  blosc2_stune_config config = {.objective=BLOSC_STUNE_CRATIO};
+  cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.tuner_params = &config;
+  cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, values, nbytes, chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  if (csize != nbytes + BLOSC_EXTENDED_HEADER_LENGTH || !(chunk[BLOSC2_CHUNK_FLAGS] & BLOSC_MEMCPYED)) {
+    printf("Incompressible chunks should be memcpyed\n");
+    rc = 1;
+  }
+  if (blosc2_decompress(chunk, csize, values, nbytes) != nbytes) {
+    printf("Error decompressing the memcpyed chunk\n");
+    rc = 1;
+  }
+  blosc2_free_ctx(cctx);
+
+  free(values);
+  free(chunk);
+  blosc2_destroy();
+  return rc;
+}
+
+
+int main() {
+  if (test_invalid_config() != 0 || test_sampling() != 0) {
+    return 1;
+  }
+  CUTEST_TEST_RUN(stune_adaptive);
+}
@@ -0,0 +1,96 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the automatic blocksizes, which depend on the caches and the threads.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+#include "../blosc/stune.h"
+
+#define MAX_NBYTES (16 * 1024 * 1024)
+
+
+typedef struct {
+  int compcode;
+  int clevel;
+  uint8_t filter;
+  int16_t nthreads;
+  int32_t nbytes;
+} test_blocksize_backend;
+
+CUTEST_TEST_DATA(stune_blocksize) {
+  uint8_t *src;
+  uint8_t *dest;
+};
+
+CUTEST_TEST_SETUP(stune_blocksize) {
+  blosc2_init();
+  data->src = malloc(MAX_NBYTES);
+  data->dest = malloc(MAX_NBYTES + BLOSC2_MAX_OVERHEAD);
+  for (int i = 0; i < MAX_NBYTES / 4; i++) {
+    ((int32_t *)data->src)[i] = i;
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_blocksize_backend, CUTEST_DATA(
+      {BLOSC_LZ4, 9, BLOSC_SHUFFLE, 1, MAX_NBYTES},  // split
+      {BLOSC_LZ4, 9, BLOSC_NOSHUFFLE, 1, MAX_NBYTES},
+      {BLOSC_BLOSCLZ, 5, BLOSC_SHUFFLE, 4, MAX_NBYTES},
+      {BLOSC_LZ4, 5, BLOSC_SHUFFLE, 4, 64 * 1024},  // small chunks
+      {BLOSC_BLOSCLZ, 9, BLOSC_NOSHUFFLE, 8, 200 * 1000},
+      {BLOSC_LZ4, 5, BLOSC_SHUFFLE, 8, 20 * 1000},  // too small for every thread
+      {BLOSC_ZSTD, 9, BLOSC_SHUFFLE, 4, 1024 * 1024},
+  ));
+}
+
+
+CUTEST_TEST_TEST(stune_blocksize) {
+  CUTEST_GET_PARAMETER(backend, test_blocksize_backend);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.compcode = backend.compcode;
+  cparams.clevel = backend.clevel;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = backend.filter;
+  cparams.nthreads = backend.nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data->src, backend.nbytes, data->dest,
+                                  backend.nbytes + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  int32_t blocksize;
+  CUTEST_ASSERT("Error getting the sizes", blosc2_cbuffer_sizes(data->dest, NULL, NULL, &blocksize) >= 0);
+
+  const blosc_cpu_info *cpu = blosc_stune_cpu_info();
+  if (cpu->l2 > 0 && backend.compcode != BLOSC_ZSTD) {
+    int32_t max_blocksize = cpu->l2 / STUNE_THREAD_BUFFERS;
+    CUTEST_ASSERT("The working set of a block does not fit in L2",
+                  blocksize <= (max_blocksize > L1 ? max_blocksize : L1));
+  }
+  int32_t nblocks = (backend.nbytes + blocksize - 1) / blocksize;
+  if (backend.nbytes / backend.nthreads >= STUNE_MIN_THREAD_BLOCKSIZE) {
+    CUTEST_ASSERT("Not enough blocks for the threads", nblocks >= backend.nthreads);
+  }
+  else {
+    CUTEST_ASSERT("Blocks are too small", blocksize >= STUNE_MIN_THREAD_BLOCKSIZE);
+  }
+
+  int dsize = blosc2_decompress(data->dest, csize, data->src, backend.nbytes);
+  CUTEST_ASSERT("Decompression error", dsize == backend.nbytes);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(stune_blocksize) {
+  free(data->src);
+  free(data->dest);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(stune_blocksize);
+}
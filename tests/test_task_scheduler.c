@@ -0,0 +1,171 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for running the jobs of contexts in task schedulers of the application.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#include <pthread.h>
+
+#define NBYTES (1024 * 1024)
+#define MAX_JOBS 1000
+
+enum {
+  SCHED_THREADS,  // every job in a thread of its own
+  SCHED_LAZY,     // the jobs only run when the scheduler gets around to it, after the calls
+  SCHED_FAILING,  // no job can be submitted
+};
+
+typedef struct {
+  int kind;
+  int njobs;
+  pthread_t threads[MAX_JOBS];
+  void (*jobs[MAX_JOBS])(void *);
+  void *jobs_data[MAX_JOBS];
+} test_scheduler;
+
+static void *run_job(void *arg) {
+  test_scheduler *sched = (test_scheduler *) ((void **) arg)[0];
+  intptr_t njob = (intptr_t) ((void **) arg)[1];
+  free(arg);
+  sched->jobs[njob](sched->jobs_data[njob]);
+  return NULL;
+}
+
+static int submit(void *sched_data, void (*job)(void *), void *job_data) {
+  test_scheduler *sched = (test_scheduler *) sched_data;
+  if (sched->kind == SCHED_FAILING || sched->njobs == MAX_JOBS) {
+    return -1;
+  }
+  int njob = sched->njobs++;
+  sched->jobs[njob] = job;
+  sched->jobs_data[njob] = job_data;
+  if (sched->kind == SCHED_THREADS) {
+    void **arg = malloc(2 * sizeof(void *));
+    arg[0] = sched;
+    arg[1] = (void *) (intptr_t) njob;
+    if (pthread_create(&sched->threads[njob], NULL, run_job, arg) != 0) {
+      free(arg);
+      sched->njobs--;
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* Let the scheduler finish the jobs it has (they have nothing left to do by now) */
+static void drain(test_scheduler *sched) {
+  for (int i = 0; i < sched->njobs; i++) {
+    if (sched->kind == SCHED_THREADS) {
+      pthread_join(sched->threads[i], NULL);
+    }
+    else {
+      sched->jobs[i](sched->jobs_data[i]);
+    }
+  }
+  sched->njobs = 0;
+}
+
+
+CUTEST_TEST_DATA(task_scheduler) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(task_scheduler) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.nthreads = 4;
+  // Even on a single core
+  setenv("BLOSC_PARALLEL_THRESHOLD", "0", 1);
+  blosc2_reload_env();
+
+  CUTEST_PARAMETRIZE(kind, int, CUTEST_DATA(SCHED_THREADS, SCHED_LAZY, SCHED_FAILING));
+  CUTEST_PARAMETRIZE(scheduler, int, CUTEST_DATA(BLOSC_DEFAULT_SCHED, BLOSC_WORKSTEALING_SCHED));
+  CUTEST_PARAMETRIZE(filter, int, CUTEST_DATA(BLOSC_SHUFFLE, BLOSC_DELTA));
+}
+
+
+CUTEST_TEST_TEST(task_scheduler) {
+  CUTEST_GET_PARAMETER(kind, int);
+  CUTEST_GET_PARAMETER(scheduler, int);
+  CUTEST_GET_PARAMETER(filter, int);
+
+  int32_t *src = malloc(NBYTES);
+  int32_t *dest = malloc(NBYTES);
+  uint8_t *chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  for (int32_t i = 0; i < NBYTES / (int32_t) sizeof(int32_t); i++) {
+    src[i] = i * 3 + (i % 11);
+  }
+  blosc2_cparams cparams = data->cparams;
+  cparams.blocksize = 16 * 1024;
+  cparams.scheduler = scheduler;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = (uint8_t) filter;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = 4;
+  dparams.scheduler = scheduler;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+
+  blosc2_task_scheduler no_submit = {NULL, NULL};
+  CUTEST_ASSERT("Schedulers without submit are accepted", blosc2_ctx_set_task_scheduler(cctx, &no_submit) < 0);
+
+  test_scheduler *sched = calloc(1, sizeof(test_scheduler));
+  sched->kind = kind;
+  blosc2_task_scheduler task_scheduler = {submit, sched};
+  // The threads of the context are stopped on the way
+  for (int round = 0; round < 3; round++) {
+    bool use_sched = round != 1;
+    CUTEST_ASSERT("Cannot set the scheduler",
+                  blosc2_ctx_set_task_scheduler(cctx, use_sched ? &task_scheduler : NULL) == 0);
+    CUTEST_ASSERT("Cannot set the scheduler",
+                  blosc2_ctx_set_task_scheduler(dctx, use_sched ? &task_scheduler : NULL) == 0);
+    for (int i = 0; i < 5; i++) {
+      src[0] = round * 10 + i;
+      int cbytes = blosc2_compress_ctx(cctx, src, NBYTES, chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+      CUTEST_ASSERT("Cannot compress", cbytes > 0);
+      memset(dest, 0, NBYTES);
+      CUTEST_ASSERT("Cannot decompress", blosc2_decompress_ctx(dctx, chunk, cbytes, dest, NBYTES) == NBYTES);
+      CUTEST_ASSERT("Wrong decompressed data", memcmp(src, dest, NBYTES) == 0);
+    }
+    if (use_sched && kind != SCHED_FAILING) {
+      CUTEST_ASSERT("No jobs went to the scheduler", sched->njobs > 0);
+    }
+    if (!use_sched) {
+      CUTEST_ASSERT("Jobs went to the scheduler", sched->njobs == 0);
+    }
+    drain(sched);
+  }
+
+  // The jobs that the scheduler runs after the contexts are gone
+  int cbytes = blosc2_compress_ctx(cctx, src, NBYTES, chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  CUTEST_ASSERT("Cannot compress", cbytes > 0);
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  drain(sched);
+
+  free(sched);
+  free(src);
+  free(dest);
+  free(chunk);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(task_scheduler) {
+  BLOSC_UNUSED_PARAM(data);
+  unsetenv("BLOSC_PARALLEL_THRESHOLD");
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(task_scheduler);
+}
@@ -0,0 +1,198 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the tracing hooks (blosc2_set_trace_cb()).
+
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  See LICENSE.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+#include <pthread.h>
+
+#define NITEMS (500 * 1000)
+#define BLOCKSIZE (32 * 1024)
+#define NBYTES (NITEMS * (int)sizeof(int32_t))
+#define NBLOCKS ((NBYTES + BLOCKSIZE - 1) / BLOCKSIZE)
+#define NSTAGES (BLOSC2_TRACE_CIPHER + 1)
+#define URLPATH "test_trace_hooks.b2frame"
+
+int tests_run = 0;
+
+/* Global vars */
+int32_t *src, *dest;
+uint8_t *chunk;
+int16_t nthreads;
+pthread_mutex_t events_mutex = PTHREAD_MUTEX_INITIALIZER;
+int nevents[NSTAGES];
+int nbad_events;
+int64_t block_nbytes;
+bool tid_seen[4];
+
+
+static void count_event(const blosc2_trace_event *event, void *user_data) {
+  int *ncalls = (int *)user_data;
+  pthread_mutex_lock(&events_mutex);
+  (*ncalls)++;
+  if (event->stage < 0 || event->stage >= NSTAGES || event->end_ns < event->start_ns) {
+    nbad_events++;
+  }
+  else {
+    nevents[event->stage]++;
+    bool is_io = event->stage == BLOSC2_TRACE_IO_READ || event->stage == BLOSC2_TRACE_IO_WRITE;
+    if (is_io != (event->ctx == NULL) || (is_io && event->tid != -1) ||
+        (event->stage == BLOSC2_TRACE_BLOCK && (event->nblock < 0 || event->nblock >= NBLOCKS))) {
+      nbad_events++;
+    }
+    if (event->stage == BLOSC2_TRACE_BLOCK) {
+      block_nbytes += event->nbytes;
+    }
+    if (!is_io && event->tid >= 0 && event->tid < 4) {
+      tid_seen[event->tid] = true;
+    }
+  }
+  pthread_mutex_unlock(&events_mutex);
+}
+
+static void reset_events(void) {
+  memset(nevents, 0, sizeof(nevents));
+  memset(tid_seen, 0, sizeof(tid_seen));
+  nbad_events = 0;
+  block_nbytes = 0;
+}
+
+
+static char *test_chunk(void) {
+  int ncalls = 0;
+  mu_assert("ERROR: cannot set the hook", blosc2_set_trace_cb(count_event, &ncalls) == 0);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+
+  reset_events();
+  int csize = blosc2_compress_ctx(cctx, src, NBYTES, chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  mu_assert("ERROR: compression error", csize > 0);
+  mu_assert("ERROR: bad events", nbad_events == 0);
+  mu_assert("ERROR: wrong block events", nevents[BLOSC2_TRACE_BLOCK] == NBLOCKS);
+  mu_assert("ERROR: wrong block bytes", block_nbytes == NBYTES);
+  mu_assert("ERROR: wrong stage events", nevents[BLOSC2_TRACE_FILTERS] == NBLOCKS &&
+                                         nevents[BLOSC2_TRACE_CODEC] == NBLOCKS);
+  mu_assert("ERROR: wrong job events", nevents[BLOSC2_TRACE_JOB] == nthreads);
+
+  reset_events();
+  int dsize = blosc2_decompress_ctx(dctx, chunk, csize, dest, NBYTES);
+  mu_assert("ERROR: decompression error", dsize == NBYTES);
+  mu_assert("ERROR: bad events", nbad_events == 0);
+  mu_assert("ERROR: wrong block events", nevents[BLOSC2_TRACE_BLOCK] == NBLOCKS);
+  mu_assert("ERROR: wrong stage events", nevents[BLOSC2_TRACE_FILTERS] == NBLOCKS &&
+                                         nevents[BLOSC2_TRACE_CODEC] == NBLOCKS);
+  mu_assert("ERROR: wrong job events", nevents[BLOSC2_TRACE_JOB] == nthreads);
+  for (int i = 0; i < nthreads; i++) {
+    mu_assert("ERROR: thread not seen", tid_seen[i]);
+  }
+
+  // No more events once the hook is removed
+  mu_assert("ERROR: cannot remove the hook", blosc2_set_trace_cb(NULL, NULL) == 0);
+  int ncalls_ = ncalls;
+  dsize = blosc2_decompress_ctx(dctx, chunk, csize, dest, NBYTES);
+  mu_assert("ERROR: decompression error", dsize == NBYTES);
+  mu_assert("ERROR: events without a hook", ncalls == ncalls_);
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  return EXIT_SUCCESS;
+}
+
+
+static char *test_frame(void) {
+  int ncalls = 0;
+  blosc2_remove_urlpath(URLPATH);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_storage storage = {.contiguous=true, .urlpath=URLPATH, .cparams=&cparams, .dparams=&dparams};
+
+  mu_assert("ERROR: cannot set the hook", blosc2_set_trace_cb(count_event, &ncalls) == 0);
+  reset_events();
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  mu_assert("ERROR: cannot create the super-chunk", schunk != NULL);
+  mu_assert("ERROR: cannot append", blosc2_schunk_append_buffer(schunk, src, NBYTES) == 1);
+  blosc2_schunk_free(schunk);
+  mu_assert("ERROR: no write events", nevents[BLOSC2_TRACE_IO_WRITE] > 0);
+
+  // The blocks of the lazy chunk are read one by one
+  reset_events();
+  schunk = blosc2_schunk_open(URLPATH);
+  mu_assert("ERROR: cannot open the super-chunk", schunk != NULL);
+  int dsize = blosc2_schunk_decompress_chunk(schunk, 0, dest, NBYTES);
+  mu_assert("ERROR: decompression error", dsize == NBYTES);
+  mu_assert("ERROR: bad events", nbad_events == 0);
+  mu_assert("ERROR: wrong lazy read events", nevents[BLOSC2_TRACE_LAZY_READ] == NBLOCKS);
+  mu_assert("ERROR: wrong read events", nevents[BLOSC2_TRACE_IO_READ] > NBLOCKS);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  blosc2_set_trace_cb(NULL, NULL);
+  return EXIT_SUCCESS;
+}
+
+
+static char *all_tests(void) {
+  nthreads = 1;
+  mu_run_test(test_chunk);
+  mu_run_test(test_frame);
+  nthreads = 4;
+  mu_run_test(test_chunk);
+  mu_run_test(test_frame);
+  return EXIT_SUCCESS;
+}
+
+
+int main(void) {
+  char *result;
+
+  blosc2_init();
+  // The hooks are optional, so there is nothing to test without them
+  if (blosc2_set_trace_cb(NULL, NULL) < 0) {
+    printf("Tracing hooks not built; skipping the tests\n");
+    blosc2_destroy();
+    return EXIT_SUCCESS;
+  }
+
+  src = malloc(NBYTES);
+  dest = malloc(NBYTES);
+  chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  for (int i = 0; i < NITEMS; i++) {
+    src[i] = i;
+  }
+
+  /* Run all the suite */
+  result = all_tests();
+  if (result != EXIT_SUCCESS) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  free(src);
+  free(dest);
+  free(chunk);
+  blosc2_destroy();
+
+  return result != EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for transcoding super-chunks to other compression parameters in parallel.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (20 * 1000)
+#define NCHUNKS 25
+#define NKEPT 10
+#define URLPATH "test_transcode.b2frame"
+#define URLPATH2 "test_transcode2.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(transcode) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(transcode) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.compcode = BLOSC_BLOSCLZ;
+
+  CUTEST_PARAMETRIZE(src_storage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(dest_storage, test_storage, CUTEST_DATA(
+      {NULL, true},
+      {URLPATH2, true},
+      {URLPATH2, false},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 3));
+  CUTEST_PARAMETRIZE(shared_pool, bool, CUTEST_DATA(false, true));
+}
+
+
+static int check_chunks(blosc2_schunk *schunk, int64_t skipped) {
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  int errors = 0;
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, CHUNKSIZE * sizeof(int32_t));
+    if (dsize != CHUNKSIZE * (int) sizeof(int32_t)) {
+      errors++;
+      continue;
+    }
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      int32_t expected = nchunk == skipped ? 0 : (int32_t) (nchunk * CHUNKSIZE + i);
+      if (buffer[i] != expected) {
+        errors++;
+        break;
+      }
+    }
+  }
+  free(buffer);
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(transcode) {
+  CUTEST_GET_PARAMETER(src_storage, test_storage);
+  CUTEST_GET_PARAMETER(dest_storage, test_storage);
+  CUTEST_GET_PARAMETER(nthreads, int);
+  CUTEST_GET_PARAMETER(shared_pool, bool);
+
+  blosc2_set_shared_threadpool(shared_pool ? 2 : 0);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=src_storage.urlpath,
+                            .contiguous=src_storage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int64_t meta = 42;
+  CUTEST_ASSERT("Cannot add the metalayer",
+                blosc2_meta_add(schunk, "meta", (uint8_t *) &meta, sizeof(meta)) >= 0);
+  int32_t *buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      buffer[i] = (int32_t) (nchunk * CHUNKSIZE + i);
+    }
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, CHUNKSIZE * sizeof(int32_t)) == nchunk + 1);
+  }
+  free(buffer);
+  CUTEST_ASSERT("Cannot add the vlmetalayer",
+                blosc2_vlmeta_add(schunk, "vlmeta", (uint8_t *) &meta, sizeof(meta), NULL) >= 0);
+
+  blosc2_cparams cparams2 = BLOSC2_CPARAMS_DEFAULTS;
+  cparams2.typesize = sizeof(int32_t);
+  cparams2.compcode = BLOSC_ZSTD;
+  cparams2.clevel = 3;
+  cparams2.filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_DELTA;
+  blosc2_storage storage2 = {.cparams=&cparams2, .urlpath=dest_storage.urlpath,
+                             .contiguous=dest_storage.contiguous};
+  blosc2_remove_urlpath(storage2.urlpath);
+  blosc2_schunk *transcoded = blosc2_schunk_transcode(schunk, &storage2, nthreads);
+  CUTEST_ASSERT("Cannot transcode the super-chunk", transcoded != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", transcoded->nchunks == NCHUNKS);
+  CUTEST_ASSERT("Wrong nbytes", transcoded->nbytes == schunk->nbytes);
+  CUTEST_ASSERT("Wrong codec", transcoded->compcode == BLOSC_ZSTD);
+  CUTEST_ASSERT("Wrong chunks", check_chunks(transcoded, -1) == 0);
+
+  uint8_t *content;
+  int32_t content_len;
+  CUTEST_ASSERT("The metalayer is not copied",
+                blosc2_meta_get(transcoded, "meta", &content, &content_len) >= 0 &&
+                *(int64_t *) content == meta);
+  free(content);
+  CUTEST_ASSERT("The vlmetalayer is not copied",
+                blosc2_vlmeta_get(transcoded, "vlmeta", &content, &content_len) >= 0 &&
+                *(int64_t *) content == meta);
+  free(content);
+  CUTEST_ASSERT("The transcode is not complete", blosc2_vlmeta_exists(transcoded, "b2transcode") < 0);
+
+  if (dest_storage.urlpath != NULL) {
+    // Leave it as if it was interrupted, with a chunk that tells whether it is transcoded again
+    CUTEST_ASSERT("Cannot delete the vlmetalayer", blosc2_vlmeta_delete(transcoded, "vlmeta") >= 0);
+    int64_t marker[2] = {schunk->nchunks, schunk->nbytes};
+    CUTEST_ASSERT("Cannot add the vlmetalayer",
+                  blosc2_vlmeta_add(transcoded, "b2transcode", (uint8_t *) marker, sizeof(marker), NULL) >= 0);
+    for (int64_t nchunk = NCHUNKS - 1; nchunk >= NKEPT; nchunk--) {
+      CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(transcoded, nchunk) == nchunk);
+    }
+    uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+    blosc2_chunk_zeros(cparams2, CHUNKSIZE * sizeof(int32_t), zeros, sizeof(zeros));
+    CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(transcoded, 1, zeros, true) == NKEPT);
+    blosc2_schunk_free(transcoded);
+
+    transcoded = blosc2_schunk_transcode(schunk, &storage2, nthreads);
+    CUTEST_ASSERT("Cannot resume the transcode", transcoded != NULL);
+    CUTEST_ASSERT("Wrong number of chunks", transcoded->nchunks == NCHUNKS);
+    CUTEST_ASSERT("The transcode is not resumed", check_chunks(transcoded, 1) == 0);
+    CUTEST_ASSERT("The vlmetalayer is not copied", blosc2_vlmeta_exists(transcoded, "vlmeta") >= 0);
+    CUTEST_ASSERT("The transcode is not complete", blosc2_vlmeta_exists(transcoded, "b2transcode") < 0);
+    blosc2_schunk_free(transcoded);
+
+    // A complete transcode is not resumed
+    CUTEST_ASSERT("A complete transcode cannot be overwritten",
+                  blosc2_schunk_transcode(schunk, &storage2, nthreads) == NULL);
+
+    transcoded = blosc2_schunk_open(dest_storage.urlpath);
+    CUTEST_ASSERT("Cannot open the super-chunk", transcoded != NULL);
+    CUTEST_ASSERT("Wrong chunks", check_chunks(transcoded, 1) == 0);
+  }
+
+  blosc2_schunk_free(transcoded);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(src_storage.urlpath);
+  blosc2_remove_urlpath(dest_storage.urlpath);
+  blosc2_set_shared_threadpool(0);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(transcode) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(transcode);
+}
@@ -0,0 +1,188 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the truncation and the rounding of the TRUNC_PREC filter, which
+  have to give the same elements as the scalar reference below, fused with
+  the shuffle or not.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#include <inttypes.h>
+
+#define NELEMS (20 * 1000 + 3)
+
+
+typedef struct {
+  int32_t typesize;
+  int8_t prec;
+  bool round;
+  uint8_t shuffle;
+} test_trunc_prec_backend;
+
+CUTEST_TEST_DATA(trunc_prec) {
+  uint8_t *src;
+  uint8_t *chunk;
+  uint8_t *dest;
+};
+
+
+/* The element with zeroed_bits less bits, as the kept value plus one unit if the
+ * removed bits are more than a half (or a half and the kept value is odd) */
+static uint64_t reference(uint64_t x, int32_t typesize, int zeroed_bits, bool round) {
+  uint64_t exponent = (typesize == 4) ? 0x7F800000ULL : 0x7FF0000000000000ULL;
+  uint64_t ulp = 1ULL << zeroed_bits;
+  uint64_t kept = x & ~(ulp - 1);
+  if (!round || zeroed_bits == 0 || (x & exponent) == exponent) {
+    return kept;
+  }
+  uint64_t removed = x & (ulp - 1);
+  uint64_t half = ulp >> 1;
+  if (removed > half || (removed == half && (kept & ulp) != 0)) {
+    kept += ulp;
+  }
+  return kept;
+}
+
+
+CUTEST_TEST_SETUP(trunc_prec) {
+  blosc2_init();
+  data->src = malloc(NELEMS * 8);
+  data->chunk = malloc(NELEMS * 8 + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(NELEMS * 8);
+
+  CUTEST_PARAMETRIZE(backend, test_trunc_prec_backend, CUTEST_DATA(
+      {4, 10, false, BLOSC_SHUFFLE},
+      {4, 10, true, BLOSC_SHUFFLE},
+      {4, -7, true, BLOSC_NOSHUFFLE},
+      {4, 1, true, BLOSC_SHUFFLE},
+      {4, 23, true, BLOSC_NOSHUFFLE},  // nothing to round
+      {8, 20, false, BLOSC_NOSHUFFLE},
+      {8, 20, true, BLOSC_SHUFFLE},
+      {8, -40, true, BLOSC_NOSHUFFLE},
+      {8, 3, true, BLOSC_SHUFFLE},
+  ));
+}
+
+
+CUTEST_TEST_TEST(trunc_prec) {
+  CUTEST_GET_PARAMETER(backend, test_trunc_prec_backend);
+
+  int32_t typesize = backend.typesize;
+  int32_t nbytes = NELEMS * typesize;
+  // Random bits (repeated so that the chunk compresses and the filter is kept), and then
+  // floats of any sign and size with some NaNs, infinities and ties
+  uint64_t state = 12345;
+  for (int i = 0; i < NELEMS; i++) {
+    if (i % 256 == 0) {
+      state = 12345;
+    }
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint64_t bits = state;
+    if (i % 3 == 0) {
+      double value = ((double)(i % 1000) - 500.) * pow(10., i % 40 - 20);
+      if (typesize == 4) {
+        float fvalue = (float)value;
+        uint32_t fbits;
+        memcpy(&fbits, &fvalue, 4);
+        bits = fbits;
+      }
+      else {
+        memcpy(&bits, &value, 8);
+      }
+    }
+    if (i % 101 == 0) {
+      bits = (typesize == 4) ? 0x7FC00000ULL + i : 0xFFF8000000000000ULL + i;  // NaN
+    }
+    if (i % 103 == 0) {
+      bits = (typesize == 4) ? 0xFF800000ULL : 0x7FF0000000000000ULL;  // infinity
+    }
+    if (i % 7 == 1) {
+      // A tie when removing at least two bits
+      bits = (bits & ~0xFFFFULL) | (1ULL << (i % 13));
+    }
+    if (i % 211 == 0) {
+      bits = (typesize == 4) ? 0x7F7FFFFFULL : 0x7FEFFFFFFFFFFFFFULL;  // the largest value
+    }
+    memcpy(data->src + i * typesize, &bits, typesize);
+  }
+
+  int8_t meta = backend.prec;
+  if (backend.round) {
+    meta = (int8_t)(meta >= 0 ? meta + BLOSC_TRUNC_PREC_ROUND : meta - BLOSC_TRUNC_PREC_ROUND);
+  }
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = typesize;
+  cparams.compcode = BLOSC_LZ4;
+  cparams.filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_TRUNC_PREC;
+  cparams.filters_meta[BLOSC2_MAX_FILTERS - 2] = (uint8_t)meta;
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = backend.shuffle;
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  int csize = blosc2_compress_ctx(cctx, data->src, nbytes, data->chunk, nbytes + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, nbytes);
+  blosc2_free_ctx(dctx);
+  CUTEST_ASSERT("Decompression error", dsize == nbytes);
+
+  int bits_mantissa = (typesize == 4) ? 23 : 52;
+  int zeroed_bits = (backend.prec >= 0) ? bits_mantissa - backend.prec : -backend.prec;
+  for (int i = 0; i < NELEMS; i++) {
+    uint64_t x = 0, y = 0;
+    memcpy(&x, data->src + i * typesize, typesize);
+    memcpy(&y, data->dest + i * typesize, typesize);
+    if (y != reference(x, typesize, zeroed_bits, backend.round)) {
+      printf("Element %d: %" PRIx64 " gives %" PRIx64 "\n", i, x, y);
+      CUTEST_ASSERT("The element is not the reference one", false);
+    }
+  }
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(trunc_prec) {
+  free(data->src);
+  free(data->chunk);
+  free(data->dest);
+  blosc2_destroy();
+}
+
+
+static int test_bad_precision(void) {
+  blosc2_init();
+  float src[4000];
+  uint8_t dest[sizeof(src) + BLOSC2_MAX_OVERHEAD];
+  for (int i = 0; i < 4000; i++) {
+    src[i] = (float)i / 3.f;
+  }
+  int8_t metas[] = {24, -23, 24 + BLOSC_TRUNC_PREC_ROUND, -23 - BLOSC_TRUNC_PREC_ROUND};
+  int rc = 0;
+  for (int i = 0; i < 4; i++) {
+    blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+    cparams.typesize = 4;
+    cparams.filters[BLOSC2_MAX_FILTERS - 2] = BLOSC_TRUNC_PREC;
+    cparams.filters_meta[BLOSC2_MAX_FILTERS - 2] = (uint8_t)metas[i];
+    blosc2_context *cctx = blosc2_create_cctx(cparams);
+    if (blosc2_compress_ctx(cctx, src, sizeof(src), dest, sizeof(dest)) >= 0) {
+      printf("The precision %d should be refused for floats\n", metas[i]);
+      rc = 1;
+    }
+    blosc2_free_ctx(cctx);
+  }
+  blosc2_destroy();
+  return rc;
+}
+
+
+int main() {
+  if (test_bad_precision() != 0) {
+    return 1;
+  }
+  CUTEST_TEST_RUN(trunc_prec);
+}
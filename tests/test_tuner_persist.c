@@ -0,0 +1,121 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for keeping the state of the tuner in super-chunks.  The tuning has to
+  go on after reopening a super-chunk as if it had never been closed.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS 30
+#define URLPATH "test_tuner_persist.b2frame"
+
+
+typedef struct {
+  int objective;
+  int nreopen;  // the chunks appended before reopening the super-chunk
+} test_persist_backend;
+
+CUTEST_TEST_DATA(tuner_persist) {
+  int32_t *buffer;
+  int32_t *rec_buffer;
+};
+
+CUTEST_TEST_SETUP(tuner_persist) {
+  blosc2_init();
+  data->buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  data->rec_buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  for (int i = 0; i < CHUNKSIZE; i++) {
+    data->buffer[i] = i / 3 + (i % 5) * 100;
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_persist_backend, CUTEST_DATA(
+      {BLOSC_STUNE_CRATIO, 1},
+      {BLOSC_STUNE_CRATIO, 7},  // in the middle of the tuning
+      {BLOSC_STUNE_CRATIO, 25},  // after the tuning
+      {BLOSC_STUNE_BALANCED, 7},
+  ));
+}
+
+
+static blosc2_schunk* new_schunk(int objective, bool persistent) {
+  blosc2_stune_config config = {.objective=objective};
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.nthreads = 1;
+  cparams.tuner_params = &config;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true, .urlpath=persistent ? URLPATH : NULL};
+  return blosc2_schunk_new(&storage);
+}
+
+
+CUTEST_TEST_TEST(tuner_persist) {
+  CUTEST_GET_PARAMETER(backend, test_persist_backend);
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+
+  // The chunk sizes of an uninterrupted tuning
+  int32_t cbytes[NCHUNKS];
+  blosc2_schunk *schunk = new_schunk(backend.objective, false);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    int64_t cbytes_before = schunk->cbytes;
+    CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data->buffer, nbytes) == i + 1);
+    cbytes[i] = (int32_t)(schunk->cbytes - cbytes_before);
+  }
+  blosc2_schunk_free(schunk);
+
+  blosc2_remove_urlpath(URLPATH);
+  schunk = new_schunk(backend.objective, true);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    if (i == backend.nreopen) {
+      CUTEST_ASSERT("The state of the tuner is not kept", blosc2_vlmeta_exists(schunk, "b2tuner") >= 0);
+      blosc2_schunk_free(schunk);
+      schunk = blosc2_schunk_open(URLPATH);
+      CUTEST_ASSERT("Error reopening the super-chunk", schunk != NULL);
+    }
+    int64_t cbytes_before = schunk->cbytes;
+    CUTEST_ASSERT("Error appending", blosc2_schunk_append_buffer(schunk, data->buffer, nbytes) == i + 1);
+    // The speeds differ between runs, so only the cratio is reproducible
+    if (backend.objective == BLOSC_STUNE_CRATIO) {
+      CUTEST_ASSERT("The tuning does not go on where it was",
+                    schunk->cbytes - cbytes_before == cbytes[i]);
+    }
+  }
+  CUTEST_ASSERT("The tuning does not converge", schunk->cbytes / NCHUNKS > cbytes[NCHUNKS - 1] ||
+                backend.objective != BLOSC_STUNE_CRATIO);
+
+  for (int i = 0; i < NCHUNKS; i++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, i, data->rec_buffer, nbytes);
+    CUTEST_ASSERT("Decompression error", dsize == nbytes);
+    CUTEST_ASSERT("Decompressed data differs", memcmp(data->buffer, data->rec_buffer, nbytes) == 0);
+  }
+
+  // Copies start their own tuning
+  blosc2_storage storage = {.contiguous=true};
+  blosc2_schunk *copy = blosc2_schunk_copy(schunk, &storage);
+  CUTEST_ASSERT("Error copying the super-chunk", copy != NULL);
+  CUTEST_ASSERT("Copies should not keep the state of the tuner", blosc2_vlmeta_exists(copy, "b2tuner") < 0);
+  blosc2_schunk_free(copy);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(tuner_persist) {
+  free(data->buffer);
+  free(data->rec_buffer);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(tuner_persist);
+}
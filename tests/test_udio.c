@@ -19,6 +19,8 @@ typedef struct {
   int32_t write;
   int32_t read;
   int32_t truncate;
+  int32_t pread;
+  int32_t pwrite;
 } test_udio_params;
 
 
@@ -75,10 +77,25 @@ int test_truncate(void *stream, int64_t size) {
   return blosc2_stdio_truncate(my->bfile, size);
 }
 
+#if !defined(_WIN32)
+int64_t test_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  test_file *my = (test_file *) stream;
+  my->params->pread++;
+  return blosc2_stdio_pread(ptr, size, nitems, position, my->bfile);
+}
+
+int64_t test_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  test_file *my = (test_file *) stream;
+  my->params->pwrite++;
+  return blosc2_stdio_pwrite(ptr, size, nitems, position, my->bfile);
+}
+#endif
+
 
 typedef struct {
   bool contiguous;
   char *urlpath;
+  bool positional;
 } test_udio_backend;
 
 CUTEST_TEST_DATA(udio) {
@@ -101,6 +118,16 @@ CUTEST_TEST_SETUP(udio) {
 
   blosc2_register_io_cb(&io_cb);
 
+#if !defined(_WIN32)
+  // The same io, with positional reads and writes
+  io_cb.id = 245;
+  blosc2_register_io_cb(&io_cb);
+  blosc2_io_cb_ext io_cb_ext = {0};
+  io_cb_ext.pread = (blosc2_pread_cb) test_pread;
+  io_cb_ext.pwrite = (blosc2_pwrite_cb) test_pwrite;
+  blosc2_register_io_cb_ext(io_cb.id, &io_cb_ext);
+#endif
+
   data->cparams = BLOSC2_CPARAMS_DEFAULTS;
   data->cparams.typesize = sizeof(int32_t);
   data->cparams.compcode = BLOSC_BLOSCLZ;
@@ -108,8 +135,12 @@ CUTEST_TEST_SETUP(udio) {
   data->cparams.nthreads = 2;
 
   CUTEST_PARAMETRIZE(backend, test_udio_backend, CUTEST_DATA(
-      {true, "test_udio.b2frame"}, // disk - cframe
-      {false, "test_udio_s.b2frame"}, // disk - sframe
+      {true, "test_udio.b2frame", false}, // disk - cframe
+      {false, "test_udio_s.b2frame", false}, // disk - sframe
+#if !defined(_WIN32)
+      {true, "test_udio.b2frame", true}, // disk - cframe, positional io
+      {false, "test_udio_s.b2frame", true}, // disk - sframe, positional io
+#endif
   ));
 }
 
@@ -133,7 +164,7 @@ CUTEST_TEST_TEST(udio) {
   cparams.nthreads = 2;
 
   test_udio_params io_params = {0};
-  blosc2_io io = {.id = 244, .params = &io_params};
+  blosc2_io io = {.id = backend.positional ? 245 : 244, .params = &io_params};
   blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath = backend.urlpath, .io=&io};
 
   blosc2_schunk *schunk = blosc2_schunk_new(&storage);
@@ -160,6 +191,10 @@ CUTEST_TEST_TEST(udio) {
   CUTEST_ASSERT("Write must be positive", io_params.write > 0);
   CUTEST_ASSERT("Read must be positive", io_params.read > 0);
   CUTEST_ASSERT("Truncate must be positive", io_params.truncate > 0);
+  if (backend.positional) {
+    CUTEST_ASSERT("Pread must be positive", io_params.pread > 0);
+    CUTEST_ASSERT("Pwrite must be positive", io_params.pwrite > 0);
+  }
 
   blosc2_schunk_free(schunk);
   blosc2_schunk_free(schunk2);
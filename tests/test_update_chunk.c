@@ -149,6 +149,77 @@ static char* test_update_chunk(void) {
   return EXIT_SUCCESS;
 }
 
+/* Updates with chunks that fit in the slot of the old one do not grow contiguous frames */
+static char* test_update_in_place(void) {
+  blosc2_remove_urlpath(tdata.urlpath);
+
+  int32_t isize = CHUNKSIZE * sizeof(int64_t);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int64_t);
+  cparams.nthreads = NTHREADS;
+  int32_t chunksize = isize + BLOSC2_MAX_OVERHEAD;
+  uint8_t *small = malloc(chunksize);
+  uint8_t *large = malloc(chunksize);
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  for (int64_t i = 0; i < CHUNKSIZE; i++) {
+    data[i] = 3;
+  }
+  int small_cbytes = blosc2_compress_ctx(cctx, data, isize, small, chunksize);
+  for (int64_t i = 0; i < CHUNKSIZE; i++) {
+    data[i] = i * i;
+  }
+  int large_cbytes = blosc2_compress_ctx(cctx, data, isize, large, chunksize);
+  blosc2_free_ctx(cctx);
+  cparams.clevel = 0;
+  cctx = blosc2_create_cctx(cparams);
+  uint8_t *huge = malloc(chunksize);
+  int huge_cbytes = blosc2_compress_ctx(cctx, data, isize, huge, chunksize);
+  blosc2_free_ctx(cctx);
+  cparams.clevel = BLOSC2_CPARAMS_DEFAULTS.clevel;
+  mu_assert("ERROR: chunk cannot be compressed", huge_cbytes > large_cbytes);
+  mu_assert("ERROR: chunks cannot be compressed", small_cbytes > 0 && large_cbytes > small_cbytes);
+
+  // The padding makes room for the large chunk after the small ones
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tdata.urlpath, .contiguous=true,
+                            .chunk_padding=large_cbytes - small_cbytes};
+  blosc2_schunk* schunk = blosc2_schunk_new(&storage);
+  for (int nchunk = 0; nchunk < 3; nchunk++) {
+    mu_assert("ERROR: bad append", blosc2_schunk_append_chunk(schunk, small, true) == nchunk + 1);
+  }
+  int64_t frame_len = blosc2_schunk_frame_len(schunk);
+  mu_assert("ERROR: chunk cannot be updated", blosc2_schunk_update_chunk(schunk, 1, large, true) == 3);
+  mu_assert("ERROR: the frame grows with chunks that fit", blosc2_schunk_frame_len(schunk) == frame_len);
+  // Back and forth in the same slot
+  mu_assert("ERROR: chunk cannot be updated", blosc2_schunk_update_chunk(schunk, 1, small, true) == 3);
+  mu_assert("ERROR: chunk cannot be updated", blosc2_schunk_update_chunk(schunk, 1, large, true) == 3);
+  mu_assert("ERROR: the frame grows with chunks that fit", blosc2_schunk_frame_len(schunk) == frame_len);
+
+  // Larger chunks go to the end
+  mu_assert("ERROR: chunk cannot be updated", blosc2_schunk_update_chunk(schunk, 0, huge, true) == 3);
+  mu_assert("ERROR: the chunk does not fit", blosc2_schunk_frame_len(schunk) > frame_len);
+
+  if (tdata.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tdata.urlpath);
+    mu_assert("ERROR: cannot reopen the super-chunk", schunk != NULL);
+  }
+  for (int nchunk = 0; nchunk < 3; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, data_dest, isize);
+    mu_assert("ERROR: chunk cannot be decompressed correctly", dsize == isize);
+    for (int64_t i = 0; i < CHUNKSIZE; i++) {
+      mu_assert("ERROR: bad roundtrip", data_dest[i] == (nchunk == 2 ? 3 : i * i));
+    }
+  }
+
+  free(small);
+  free(large);
+  free(huge);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tdata.urlpath);
+
+  return EXIT_SUCCESS;
+}
+
 static char *all_tests(void) {
   for (int i = 0; i < (int) ARRAY_SIZE(tstorage); ++i) {
     for (int j = 0; j < (int) ARRAY_SIZE(tndata); ++j) {
@@ -159,6 +230,11 @@ static char *all_tests(void) {
 
       mu_run_test(test_update_chunk);
     }
+    if (tstorage[i].contiguous) {
+      tdata.contiguous = true;
+      tdata.urlpath = tstorage[i].urlpath;
+      mu_run_test(test_update_in_place);
+    }
   }
 
   return EXIT_SUCCESS;
@@ -0,0 +1,145 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the io_uring io (BLOSC2_IO_FILESYSTEM_URING) and the batched
+  reads of chunks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (50 * 1000)
+#define NCHUNKS 10
+
+
+typedef struct {
+  bool contiguous;
+  int16_t pool_nthreads;
+} test_uring_backend;
+
+CUTEST_TEST_DATA(uring) {
+  blosc2_cparams cparams;
+};
+
+CUTEST_TEST_SETUP(uring) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+  data->cparams.clevel = 5;
+
+  CUTEST_PARAMETRIZE(backend, test_uring_backend, CUTEST_DATA(
+      {true, 0},
+      {true, 3},
+      {false, 0},
+      {false, 3},
+  ));
+}
+
+
+static int fill_chunk(int32_t *buffer, int nchunk) {
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    buffer[j] = nchunk * CHUNKSIZE + j;
+  }
+  return 0;
+}
+
+
+CUTEST_TEST_TEST(uring) {
+  CUTEST_GET_PARAMETER(backend, test_uring_backend);
+
+  char *urlpath = backend.contiguous ? "test_uring.b2frame" : "test_uring_s.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  CUTEST_ASSERT("Cannot set the shared pool", blosc2_set_shared_threadpool(backend.pool_nthreads) == 0);
+
+  int32_t nbytes = CHUNKSIZE * sizeof(int32_t);
+  int32_t *data_buffer = malloc(nbytes);
+  int32_t *rec_buffers[NCHUNKS];
+  int32_t rec_nbytes[NCHUNKS];
+  for (int i = 0; i < NCHUNKS; ++i) {
+    rec_buffers[i] = malloc(nbytes);
+    rec_nbytes[i] = nbytes;
+  }
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_stdio_uring uring = BLOSC2_STDIO_URING_DEFAULTS;
+  uring.queue_depth = 4;  // less than the chunks, so that the ring is refilled
+  blosc2_io io = {.id = BLOSC2_IO_FILESYSTEM_URING, .name = "filesystem_uring", .params = &uring};
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=urlpath, .io=&io};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+
+  /* Every third chunk is a special (zeros) one, which is not stored in the file */
+  uint8_t zeros[BLOSC_EXTENDED_HEADER_LENGTH];
+  CUTEST_ASSERT("Error creating a zeros chunk",
+                blosc2_chunk_zeros(cparams, nbytes, zeros, sizeof(zeros)) == BLOSC_EXTENDED_HEADER_LENGTH);
+  for (int i = 0; i < NCHUNKS; ++i) {
+    int64_t nchunks;
+    if (i % 3 == 2) {
+      nchunks = blosc2_schunk_append_chunk(schunk, zeros, true);
+    }
+    else {
+      fill_chunk(data_buffer, i);
+      nchunks = blosc2_schunk_append_buffer(schunk, data_buffer, nbytes);
+    }
+    CUTEST_ASSERT("Error during compression", nchunks == i + 1);
+  }
+  blosc2_schunk_free(schunk);
+
+  schunk = blosc2_schunk_open_udio(urlpath, &io);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong number of chunks", schunk->nchunks == NCHUNKS);
+
+  /* All the chunks at once, and a range of them */
+  int64_t dsize = blosc2_schunk_decompress_chunks(schunk, 0, NCHUNKS, (void **) rec_buffers, rec_nbytes);
+  CUTEST_ASSERT("Error decompressing the chunks", dsize == (int64_t) NCHUNKS * nbytes);
+  for (int i = 0; i < NCHUNKS; ++i) {
+    if (i % 3 == 2) {
+      memset(data_buffer, 0, nbytes);
+    }
+    else {
+      fill_chunk(data_buffer, i);
+    }
+    CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffers[i], nbytes) == 0);
+  }
+  dsize = blosc2_schunk_decompress_chunks(schunk, 3, 4, (void **) rec_buffers, rec_nbytes);
+  CUTEST_ASSERT("Error decompressing a range of chunks", dsize == 4 * (int64_t) nbytes);
+  fill_chunk(data_buffer, 6);
+  CUTEST_ASSERT("Data in range are not equal", memcmp(data_buffer, rec_buffers[3], nbytes) == 0);
+
+  /* The regular (non-batched) paths */
+  int32_t dbytes = blosc2_schunk_decompress_chunk(schunk, 4, rec_buffers[0], nbytes);
+  CUTEST_ASSERT("Error during decompression", dbytes == nbytes);
+  fill_chunk(data_buffer, 4);
+  CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffers[0], nbytes) == 0);
+  blosc2_schunk_free(schunk);
+
+  /* The frame is a regular one */
+  schunk = blosc2_schunk_open(urlpath);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  dbytes = blosc2_schunk_decompress_chunk(schunk, NCHUNKS - 1, rec_buffers[0], nbytes);
+  CUTEST_ASSERT("Error during decompression", dbytes == nbytes);
+  fill_chunk(data_buffer, NCHUNKS - 1);
+  CUTEST_ASSERT("Data are not equal", memcmp(data_buffer, rec_buffers[0], nbytes) == 0);
+  blosc2_schunk_free(schunk);
+
+  blosc2_remove_urlpath(urlpath);
+  free(data_buffer);
+  for (int i = 0; i < NCHUNKS; ++i) {
+    free(rec_buffers[i]);
+  }
+
+  return 0;
+}
+
+CUTEST_TEST_TEARDOWN(uring) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(uring);
+}
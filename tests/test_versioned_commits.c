@@ -0,0 +1,131 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the appends to contiguous frames on disk that are published as new versions,
+  while other super-chunks (like the ones of other processes) keep reading the frame.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE 1000
+#define URLPATH "test_versioned_commits.b2frame"
+
+
+CUTEST_TEST_DATA(versioned_commits) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(versioned_commits) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(chunk_align, int32_t, CUTEST_DATA(0, 512));
+}
+
+
+static int append_chunks(blosc2_schunk *schunk, int64_t nchunks) {
+  int32_t buffer[CHUNKSIZE];
+  for (int64_t nchunk = schunk->nchunks; nchunks > 0; nchunk++, nchunks--) {
+    for (int i = 0; i < CHUNKSIZE; i++) {
+      buffer[i] = (int32_t) (nchunk * CHUNKSIZE + i);
+    }
+    if (blosc2_schunk_append_buffer(schunk, buffer, sizeof(buffer)) != nchunk + 1) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+
+static int check_chunks(blosc2_schunk *schunk, int64_t nchunks) {
+  int32_t buffer[CHUNKSIZE];
+  int errors = schunk->nchunks != nchunks;
+  for (int64_t nchunk = 0; nchunk < schunk->nchunks; nchunk++) {
+    int dsize = blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, sizeof(buffer));
+    if (dsize != (int) sizeof(buffer) || buffer[0] != nchunk * CHUNKSIZE ||
+        buffer[CHUNKSIZE - 1] != nchunk * CHUNKSIZE + CHUNKSIZE - 1) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(versioned_commits) {
+  CUTEST_GET_PARAMETER(chunk_align, int32_t);
+
+  blosc2_cparams cparams = data->cparams;
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=true};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Versioned commits in memory are accepted",
+                blosc2_schunk_set_versioned_commits(schunk, true) < 0);
+  CUTEST_ASSERT("Frames in memory are refreshed", blosc2_schunk_refresh(schunk) < 0);
+  blosc2_schunk_free(schunk);
+
+  storage.urlpath = URLPATH;
+  storage.chunk_align = chunk_align;
+  blosc2_remove_urlpath(URLPATH);
+  schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Cannot append the chunks", append_chunks(schunk, 5) == 0);
+  CUTEST_ASSERT("Cannot enable the versioned commits", blosc2_schunk_set_versioned_commits(schunk, true) == 0);
+
+  // The reader does not look at the index before the writer appends
+  blosc2_schunk *reader = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot open the reader", reader != NULL);
+  CUTEST_ASSERT("Cannot append the chunks", append_chunks(schunk, 3) == 0);
+  CUTEST_ASSERT("Wrong chunks of the writer", check_chunks(schunk, 8) == 0);
+  CUTEST_ASSERT("Wrong chunks of the previous version", check_chunks(reader, 5) == 0);
+  CUTEST_ASSERT("Cannot refresh the reader", blosc2_schunk_refresh(reader) == 8);
+  CUTEST_ASSERT("Wrong chunks of the new version", check_chunks(reader, 8) == 0);
+  CUTEST_ASSERT("Wrong sizes of the new version",
+                reader->nbytes == schunk->nbytes && reader->cbytes == schunk->cbytes);
+  CUTEST_ASSERT("Nothing to refresh twice", blosc2_schunk_refresh(reader) == 8);
+
+  // A bulk append is a single version, which is not visible until the commit
+  CUTEST_ASSERT("Cannot begin the bulk append", blosc2_schunk_begin_bulk(schunk) == 0);
+  CUTEST_ASSERT("Cannot append the chunks", append_chunks(schunk, 4) == 0);
+  CUTEST_ASSERT("The bulk append is visible", blosc2_schunk_refresh(reader) == 8);
+  blosc2_schunk *other = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot open the frame during the bulk append", other != NULL);
+  CUTEST_ASSERT("Wrong chunks during the bulk append", check_chunks(other, 8) == 0);
+  CUTEST_ASSERT("Cannot commit the bulk append", blosc2_schunk_commit_bulk(schunk) == 0);
+  CUTEST_ASSERT("Wrong chunks of the reader before refreshing", check_chunks(reader, 8) == 0);
+  CUTEST_ASSERT("Cannot refresh the reader", blosc2_schunk_refresh(reader) == 12);
+  CUTEST_ASSERT("Wrong chunks after the bulk append", check_chunks(reader, 12) == 0);
+  CUTEST_ASSERT("Cannot refresh the other reader", blosc2_schunk_refresh(other) == 12);
+  CUTEST_ASSERT("Wrong chunks of the other reader", check_chunks(other, 12) == 0);
+  blosc2_schunk_free(other);
+  blosc2_schunk_free(reader);
+
+  // The previous versions are reclaimed
+  int64_t reclaimed = blosc2_schunk_compact(schunk, true);
+  CUTEST_ASSERT("Nothing reclaimed", reclaimed > 0);
+  CUTEST_ASSERT("Wrong chunks after compacting", check_chunks(schunk, 12) == 0);
+  blosc2_schunk_free(schunk);
+
+  schunk = blosc2_schunk_open(URLPATH);
+  CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong chunks after reopening", check_chunks(schunk, 12) == 0);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(URLPATH);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(versioned_commits) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(versioned_commits);
+}
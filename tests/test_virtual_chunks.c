@@ -0,0 +1,151 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the virtual chunks, whose values are generated by a postfilter on read.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (50 * 1000)
+#define NITEMS (7 * CHUNKITEMS + 1234)
+#define URLPATH "test_virtual_chunks.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(virtual_chunks) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(virtual_chunks) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int64_t);
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 3));
+  CUTEST_PARAMETRIZE(block_postfilter, bool, CUTEST_DATA(false, true));
+}
+
+
+/* A linspace: every item is its index in the super-chunk */
+static int linspace_postfilter(blosc2_postfilter_params *params) {
+  int64_t start = params->nchunk * CHUNKITEMS + params->offset / params->typesize;
+  int64_t *output = (int64_t *) params->output;
+  for (int32_t i = 0; i < params->size / params->typesize; i++) {
+    output[i] = start + i;
+  }
+  return 0;
+}
+
+
+static int linspace_block(blosc2_block_postfilter_params *params) {
+  int64_t start = params->nchunk * CHUNKITEMS + params->start;
+  int64_t *output = (int64_t *) params->output;
+  for (int32_t i = 0; i < params->nitems; i++) {
+    output[i] = start + i;
+  }
+  return 0;
+}
+
+
+static int check_linspace(blosc2_schunk *schunk) {
+  int64_t *buffer = malloc(NITEMS * sizeof(int64_t));
+  int errors = 0;
+  if (blosc2_schunk_get_slice_buffer(schunk, 0, NITEMS, buffer) < 0) {
+    errors++;
+  }
+  for (int64_t i = 0; i < NITEMS && errors == 0; i++) {
+    if (buffer[i] != i) {
+      errors++;
+    }
+  }
+  free(buffer);
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(virtual_chunks) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(nthreads, int);
+  CUTEST_GET_PARAMETER(block_postfilter, bool);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.blocksize = 16 * 1024;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  blosc2_postfilter_params postparams = {0};
+  blosc2_block_postfilter block = {.block=linspace_block};
+  if (block_postfilter) {
+    dparams.block_postfilter = &block;
+  }
+  else {
+    dparams.postfilter = linspace_postfilter;
+    dparams.postparams = &postparams;
+  }
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tstorage.urlpath,
+                            .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int64_t nchunks = blosc2_schunk_fill_special(schunk, NITEMS, BLOSC2_SPECIAL_VIRTUAL,
+                                               CHUNKITEMS * sizeof(int64_t));
+  CUTEST_ASSERT("Cannot fill the super-chunk", nchunks == NITEMS / CHUNKITEMS + 1);
+  CUTEST_ASSERT("Wrong nbytes", schunk->nbytes == NITEMS * (int64_t) sizeof(int64_t));
+  CUTEST_ASSERT("The values are stored", schunk->cbytes <= nchunks * BLOSC_EXTENDED_HEADER_LENGTH);
+  CUTEST_ASSERT("Wrong values", check_linspace(schunk) == 0);
+
+  // The chunks can be added one by one too
+  uint8_t chunk[BLOSC_EXTENDED_HEADER_LENGTH];
+  int cbytes = blosc2_chunk_virtual(cparams, CHUNKITEMS * sizeof(int64_t), chunk, sizeof(chunk));
+  CUTEST_ASSERT("Cannot create the virtual chunk", cbytes == BLOSC_EXTENDED_HEADER_LENGTH);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 2, chunk, true) == nchunks);
+  CUTEST_ASSERT("Wrong values after updating", check_linspace(schunk) == 0);
+
+  // Nothing can be generated without a postfilter, which is not stored
+  int64_t *buffer = malloc(CHUNKITEMS * sizeof(int64_t));
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("The virtual chunks need a postfilter",
+                  blosc2_schunk_decompress_chunk(schunk, 0, buffer, CHUNKITEMS * sizeof(int64_t)) < 0);
+    CUTEST_ASSERT("The virtual chunks need a postfilter",
+                  blosc2_getitem_ctx(schunk->dctx, chunk, cbytes, 0, 1, buffer, sizeof(int64_t)) < 0);
+    blosc2_free_ctx(schunk->dctx);
+    dparams.schunk = schunk;
+    schunk->dctx = blosc2_create_dctx(dparams);
+    CUTEST_ASSERT("Wrong values after reopening", check_linspace(schunk) == 0);
+  }
+  free(buffer);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(virtual_chunks) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(virtual_chunks);
+}
@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the chunks of variable-length items.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NITEMS 2000
+#define BIGITEM (3 * BLOSC2_VLCHUNK_BLOCKSIZE)
+
+
+CUTEST_TEST_DATA(vlchunk) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(vlchunk) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+
+  CUTEST_PARAMETRIZE(clevel, int, CUTEST_DATA(0, 5));
+  CUTEST_PARAMETRIZE(blocksize, int32_t, CUTEST_DATA(0, 1024));
+  CUTEST_PARAMETRIZE(nthreads, int, CUTEST_DATA(1, 2));
+}
+
+
+/* Log-like lines of varying lengths, with some empty items and a big one */
+static int32_t make_item(int32_t i, char *item) {
+  if (i % 97 == 13) {
+    return 0;
+  }
+  if (i == NITEMS / 2) {
+    for (int32_t j = 0; j < BIGITEM; j++) {
+      item[j] = (char) ('a' + j % 23);
+    }
+    return BIGITEM;
+  }
+  return sprintf(item, "{\"id\": %d, \"level\": \"%s\", \"msg\": \"%.*s\"}", i, i % 3 ? "info" : "warning",
+                 (i * 7) % 40, "the quick brown fox jumps over the lazy dog");
+}
+
+
+CUTEST_TEST_TEST(vlchunk) {
+  CUTEST_GET_PARAMETER(clevel, int);
+  CUTEST_GET_PARAMETER(blocksize, int32_t);
+  CUTEST_GET_PARAMETER(nthreads, int);
+
+  char **items = malloc(NITEMS * sizeof(char *));
+  int32_t *sizes = malloc(NITEMS * sizeof(int32_t));
+  int64_t nbytes = 0;
+  for (int32_t i = 0; i < NITEMS; i++) {
+    items[i] = malloc(BIGITEM + 1);
+    sizes[i] = make_item(i, items[i]);
+    nbytes += sizes[i];
+  }
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.clevel = clevel;
+  cparams.blocksize = blocksize;
+  cparams.nthreads = (int16_t) nthreads;
+  int32_t destsize = (int32_t) nbytes + NITEMS * (2 * BLOSC2_MAX_OVERHEAD + 16);
+  uint8_t *chunk = malloc(destsize);
+  int cbytes = blosc2_vlchunk_compress(cparams, (const void *const *) items, sizes, NITEMS, chunk, destsize);
+  CUTEST_ASSERT("Cannot compress the items", cbytes > 0);
+  if (clevel > 0 && blocksize == 0) {
+    CUTEST_ASSERT("The items are not compressed", cbytes < nbytes);
+  }
+  CUTEST_ASSERT("Wrong number of items", blosc2_vlchunk_nitems(chunk, cbytes) == NITEMS);
+
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = (int16_t) nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  char *item = malloc(BIGITEM + 1);
+  for (int32_t i = 0; i < NITEMS; i++) {
+    int size = blosc2_vlchunk_getitem_ctx(dctx, chunk, cbytes, i, item, BIGITEM + 1);
+    CUTEST_ASSERT("Wrong item size", size == sizes[i]);
+    CUTEST_ASSERT("Wrong item", memcmp(item, items[i], size) == 0);
+    CUTEST_ASSERT("Wrong size query", blosc2_vlchunk_getitem_ctx(dctx, chunk, cbytes, i, NULL, 0) == sizes[i]);
+  }
+  CUTEST_ASSERT("An item past the end is got",
+                blosc2_vlchunk_getitem_ctx(dctx, chunk, cbytes, NITEMS, item, BIGITEM) == BLOSC2_ERROR_INVALID_INDEX);
+  CUTEST_ASSERT("An item is got into a small buffer",
+                blosc2_vlchunk_getitem_ctx(dctx, chunk, cbytes, NITEMS / 2, item, BIGITEM - 1) ==
+                BLOSC2_ERROR_WRITE_BUFFER);
+
+  // The items of a block do not need the rest of the blocks
+  int32_t nblocks;
+  memcpy(&nblocks, chunk + 12, sizeof(nblocks));
+  if (nblocks > 1) {
+    int32_t last_item;
+    int32_t last_block;
+    memcpy(&last_item, chunk + BLOSC2_VLCHUNK_HEADER_LENGTH + (nblocks - 1) * 8, sizeof(last_item));
+    memcpy(&last_block, chunk + BLOSC2_VLCHUNK_HEADER_LENGTH + (nblocks - 1) * 8 + 4, sizeof(last_block));
+    uint8_t *truncated = malloc(cbytes);
+    memcpy(truncated, chunk, cbytes);
+    memset(truncated + BLOSC2_VLCHUNK_HEADER_LENGTH + nblocks * 8, 0xff,
+           last_block - BLOSC2_VLCHUNK_HEADER_LENGTH - nblocks * 8);
+    for (int32_t i = last_item; i < NITEMS; i++) {
+      int size = blosc2_vlchunk_getitem_ctx(dctx, truncated, cbytes, i, item, BIGITEM + 1);
+      CUTEST_ASSERT("Wrong item of the last block", size == sizes[i] && memcmp(item, items[i], size) == 0);
+    }
+    free(truncated);
+  }
+
+  // A chunk that does not fit, and something that is not a chunk of items
+  CUTEST_ASSERT("A chunk without room is created",
+                blosc2_vlchunk_compress(cparams, (const void *const *) items, sizes, NITEMS, chunk, cbytes / 2) == 0);
+  chunk[0] = 'x';
+  CUTEST_ASSERT("A wrong chunk is taken", blosc2_vlchunk_nitems(chunk, cbytes) == BLOSC2_ERROR_INVALID_HEADER);
+  CUTEST_ASSERT("An empty chunk is not created",
+                blosc2_vlchunk_compress(cparams, NULL, NULL, 0, chunk, destsize) == BLOSC2_VLCHUNK_HEADER_LENGTH);
+  CUTEST_ASSERT("Wrong number of items of an empty chunk",
+                blosc2_vlchunk_nitems(chunk, BLOSC2_VLCHUNK_HEADER_LENGTH) == 0);
+
+  blosc2_free_ctx(dctx);
+  free(item);
+  free(chunk);
+  for (int32_t i = 0; i < NITEMS; i++) {
+    free(items[i]);
+  }
+  free(items);
+  free(sizes);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(vlchunk) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(vlchunk);
+}
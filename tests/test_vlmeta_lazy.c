@@ -0,0 +1,173 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the vlmetalayers of on-disk frames, whose contents are read when they are
+  needed instead of when opening the frame.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS 5
+#define BIGSIZE (1000 * 1000)
+#define COUNTING_IO 246
+
+
+static int64_t nbytes_read = 0;
+
+static int64_t counting_read(void *ptr, int64_t size, int64_t nitems, void *stream) {
+  nbytes_read += size * nitems;
+  return blosc2_stdio_read(ptr, size, nitems, stream);
+}
+
+static int64_t counting_pread(void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  nbytes_read += size * nitems;
+  return blosc2_stdio_pread(ptr, size, nitems, position, stream);
+}
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+} test_vlmeta_lazy_backend;
+
+CUTEST_TEST_DATA(vlmeta_lazy) {
+  int32_t *buffer;
+  uint8_t *big;
+};
+
+CUTEST_TEST_SETUP(vlmeta_lazy) {
+  blosc2_init();
+  blosc2_io_cb io_cb = {0};
+  io_cb.id = COUNTING_IO;
+  io_cb.name = "counting";
+  io_cb.open = (blosc2_open_cb) blosc2_stdio_open;
+  io_cb.close = (blosc2_close_cb) blosc2_stdio_close;
+  io_cb.read = (blosc2_read_cb) counting_read;
+  io_cb.tell = (blosc2_tell_cb) blosc2_stdio_tell;
+  io_cb.seek = (blosc2_seek_cb) blosc2_stdio_seek;
+  io_cb.write = (blosc2_write_cb) blosc2_stdio_write;
+  io_cb.truncate = (blosc2_truncate_cb) blosc2_stdio_truncate;
+  blosc2_register_io_cb(&io_cb);
+  blosc2_io_cb_ext io_cb_ext = {0};
+  io_cb_ext.pread = (blosc2_pread_cb) counting_pread;
+  io_cb_ext.pwrite = (blosc2_pwrite_cb) blosc2_stdio_pwrite;
+  blosc2_register_io_cb_ext(io_cb.id, &io_cb_ext);
+
+  data->buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data->buffer[j] = j;
+  }
+  // Noise, so that the content stays large when compressed
+  data->big = malloc(BIGSIZE);
+  uint32_t state = 12345;
+  for (int i = 0; i < BIGSIZE; i++) {
+    state = state * 1103515245 + 12345;
+    data->big[i] = (uint8_t) (state >> 16);
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_vlmeta_lazy_backend, CUTEST_DATA(
+      {true, "test_vlmeta_lazy.b2frame"},
+      {false, "test_vlmeta_lazy_s.b2frame"},
+  ));
+  CUTEST_PARAMETRIZE(checksum, int, CUTEST_DATA(BLOSC2_CHECKSUM_NONE, BLOSC2_CHECKSUM_XXH3));
+}
+
+
+static bool check_vlmeta(blosc2_schunk *schunk, const char *name, const uint8_t *expected, int32_t expected_len) {
+  uint8_t *content;
+  int32_t content_len;
+  if (blosc2_vlmeta_get(schunk, name, &content, &content_len) < 0) {
+    return false;
+  }
+  bool ok = content_len == expected_len && memcmp(content, expected, expected_len) == 0;
+  free(content);
+  return ok;
+}
+
+
+CUTEST_TEST_TEST(vlmeta_lazy) {
+  CUTEST_GET_PARAMETER(backend, test_vlmeta_lazy_backend);
+  CUTEST_GET_PARAMETER(checksum, int);
+
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.checksum = checksum;
+  blosc2_io io = {.id = COUNTING_IO, .name = "counting"};
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath,
+                            .io=&io};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    CUTEST_ASSERT("Error appending",
+                  blosc2_schunk_append_buffer(schunk, data->buffer, CHUNKSIZE * sizeof(int32_t)) == i + 1);
+  }
+  uint8_t small[] = {1, 2, 3, 4};
+  uint8_t small2[] = {5, 6, 7, 8, 9};
+  CUTEST_ASSERT("Error adding the vlmetalayer",
+                blosc2_vlmeta_add(schunk, "big", data->big, BIGSIZE, NULL) >= 0);
+  CUTEST_ASSERT("Error adding the vlmetalayer",
+                blosc2_vlmeta_add(schunk, "small", small, sizeof(small), NULL) >= 0);
+  blosc2_schunk_free(schunk);
+
+  /* The large content is not read when opening, nor when getting the small one */
+  nbytes_read = 0;
+  schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+  CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Wrong number of vlmetalayers", schunk->nvlmetalayers == 2);
+  CUTEST_ASSERT("Wrong small vlmetalayer", check_vlmeta(schunk, "small", small, sizeof(small)));
+  // The whole trailer is read when its fingerprint has to be checked
+  CUTEST_ASSERT("The large vlmetalayer is read", checksum != BLOSC2_CHECKSUM_NONE || nbytes_read < BIGSIZE / 10);
+  CUTEST_ASSERT("Wrong large vlmetalayer", check_vlmeta(schunk, "big", data->big, BIGSIZE));
+  CUTEST_ASSERT("Wrong large vlmetalayer", check_vlmeta(schunk, "big", data->big, BIGSIZE));
+  blosc2_schunk_free(schunk);
+
+  /* Updating a vlmetalayer keeps the ones that were not read */
+  schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+  CUTEST_ASSERT("Error updating the vlmetalayer",
+                blosc2_vlmeta_update(schunk, "small", small2, sizeof(small2), NULL) >= 0);
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+  CUTEST_ASSERT("Wrong updated vlmetalayer", check_vlmeta(schunk, "small", small2, sizeof(small2)));
+  CUTEST_ASSERT("Wrong large vlmetalayer after updating", check_vlmeta(schunk, "big", data->big, BIGSIZE));
+  blosc2_schunk_free(schunk);
+
+  /* And so do the chunks that are added, which overwrite the trailer */
+  schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+  CUTEST_ASSERT("Error appending",
+                blosc2_schunk_append_buffer(schunk, data->buffer, CHUNKSIZE * sizeof(int32_t)) == NCHUNKS + 1);
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+  CUTEST_ASSERT("Wrong large vlmetalayer after appending", check_vlmeta(schunk, "big", data->big, BIGSIZE));
+  CUTEST_ASSERT("Wrong small vlmetalayer after appending", check_vlmeta(schunk, "small", small2, sizeof(small2)));
+  blosc2_schunk_free(schunk);
+
+  /* And deleting a vlmetalayer */
+  schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+  CUTEST_ASSERT("Error deleting the vlmetalayer", blosc2_vlmeta_delete(schunk, "small") == 1);
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+  CUTEST_ASSERT("Wrong number of vlmetalayers", schunk->nvlmetalayers == 1);
+  CUTEST_ASSERT("Wrong large vlmetalayer after deleting", check_vlmeta(schunk, "big", data->big, BIGSIZE));
+  blosc2_schunk_free(schunk);
+
+  blosc2_remove_urlpath(backend.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(vlmeta_lazy) {
+  free(data->big);
+  free(data->buffer);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(vlmeta_lazy);
+}
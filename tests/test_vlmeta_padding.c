@@ -0,0 +1,198 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the vlmetalayers that are overwritten in place in the padding of the trailer
+  of frames.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKSIZE (10 * 1000)
+#define NCHUNKS 3
+#define NUPDATES 50
+#define PADDING 200
+#define COUNTING_IO 247
+
+
+static int64_t nwrites = 0;
+
+static int64_t counting_write(const void *ptr, int64_t size, int64_t nitems, void *stream) {
+  nwrites++;
+  return blosc2_stdio_write(ptr, size, nitems, stream);
+}
+
+static int64_t counting_pwrite(const void *ptr, int64_t size, int64_t nitems, int64_t position, void *stream) {
+  nwrites++;
+  return blosc2_stdio_pwrite(ptr, size, nitems, position, stream);
+}
+
+
+typedef struct {
+  bool contiguous;
+  char *urlpath;
+} test_vlmeta_padding_backend;
+
+CUTEST_TEST_DATA(vlmeta_padding) {
+  int32_t *buffer;
+};
+
+CUTEST_TEST_SETUP(vlmeta_padding) {
+  blosc2_init();
+  blosc2_io_cb io_cb = {0};
+  io_cb.id = COUNTING_IO;
+  io_cb.name = "counting";
+  io_cb.open = (blosc2_open_cb) blosc2_stdio_open;
+  io_cb.close = (blosc2_close_cb) blosc2_stdio_close;
+  io_cb.read = (blosc2_read_cb) blosc2_stdio_read;
+  io_cb.tell = (blosc2_tell_cb) blosc2_stdio_tell;
+  io_cb.seek = (blosc2_seek_cb) blosc2_stdio_seek;
+  io_cb.write = (blosc2_write_cb) counting_write;
+  io_cb.truncate = (blosc2_truncate_cb) blosc2_stdio_truncate;
+  blosc2_register_io_cb(&io_cb);
+  blosc2_io_cb_ext io_cb_ext = {0};
+  io_cb_ext.pread = (blosc2_pread_cb) blosc2_stdio_pread;
+  io_cb_ext.pwrite = (blosc2_pwrite_cb) counting_pwrite;
+  blosc2_register_io_cb_ext(io_cb.id, &io_cb_ext);
+
+  data->buffer = malloc(CHUNKSIZE * sizeof(int32_t));
+  for (int j = 0; j < CHUNKSIZE; j++) {
+    data->buffer[j] = j;
+  }
+
+  CUTEST_PARAMETRIZE(backend, test_vlmeta_padding_backend, CUTEST_DATA(
+      {true, NULL},
+      {true, "test_vlmeta_padding.b2frame"},
+      {false, "test_vlmeta_padding_s.b2frame"},
+  ));
+  CUTEST_PARAMETRIZE(checksum, int, CUTEST_DATA(BLOSC2_CHECKSUM_NONE, BLOSC2_CHECKSUM_XXH3));
+}
+
+
+static bool check_counter(blosc2_schunk *schunk, int64_t expected) {
+  uint8_t *content;
+  int32_t content_len;
+  if (blosc2_vlmeta_get(schunk, "counter", &content, &content_len) < 0) {
+    return false;
+  }
+  bool ok = content_len == sizeof(int64_t) && memcmp(content, &expected, sizeof(int64_t)) == 0;
+  free(content);
+  return ok;
+}
+
+/* The length of the frame, or of the index of sparse frames (which has the trailer) */
+static int64_t frame_len(blosc2_schunk *schunk) {
+  if (schunk->storage->urlpath == NULL) {
+    uint8_t *cframe;
+    bool needs_free;
+    int64_t len = blosc2_schunk_to_buffer(schunk, &cframe, &needs_free);
+    if (needs_free) {
+      free(cframe);
+    }
+    return len;
+  }
+  char path[256];
+  sprintf(path, schunk->storage->contiguous ? "%s" : "%s/chunks.b2frame", schunk->storage->urlpath);
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return -1;
+  }
+  fseek(fp, 0, SEEK_END);
+  int64_t len = ftell(fp);
+  fclose(fp);
+  return len;
+}
+
+
+CUTEST_TEST_TEST(vlmeta_padding) {
+  CUTEST_GET_PARAMETER(backend, test_vlmeta_padding_backend);
+  CUTEST_GET_PARAMETER(checksum, int);
+
+  blosc2_remove_urlpath(backend.urlpath);
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.typesize = sizeof(int32_t);
+  cparams.checksum = checksum;
+  blosc2_io io = {.id = COUNTING_IO, .name = "counting"};
+  blosc2_storage storage = {.cparams=&cparams, .contiguous=backend.contiguous, .urlpath=backend.urlpath,
+                            .io=&io, .trailer_padding=PADDING};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Error creating the super-chunk", schunk != NULL);
+  for (int i = 0; i < NCHUNKS; i++) {
+    CUTEST_ASSERT("Error appending",
+                  blosc2_schunk_append_buffer(schunk, data->buffer, CHUNKSIZE * sizeof(int32_t)) == i + 1);
+  }
+  int64_t counter = 0;
+  CUTEST_ASSERT("Error adding the vlmetalayer",
+                blosc2_vlmeta_add(schunk, "counter", (uint8_t *) &counter, sizeof(counter), NULL) == 0);
+  int64_t len = frame_len(schunk);
+
+  /* Updates of the same size are a single write, and the frame keeps its length */
+  for (counter = 1; counter <= NUPDATES; counter++) {
+    nwrites = 0;
+    CUTEST_ASSERT("Error updating the vlmetalayer",
+                  blosc2_vlmeta_update(schunk, "counter", (uint8_t *) &counter, sizeof(counter), NULL) == 0);
+    CUTEST_ASSERT("The update is not a single write", backend.urlpath == NULL || nwrites == 1);
+  }
+  CUTEST_ASSERT("The frame changes its length", frame_len(schunk) == len);
+  CUTEST_ASSERT("Wrong counter", check_counter(schunk, NUPDATES));
+
+  /* So are the ones that fit in the padding, once the frame is opened again */
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("Wrong counter after opening", check_counter(schunk, NUPDATES));
+  }
+  uint8_t small[] = {1, 2, 3};
+  nwrites = 0;
+  CUTEST_ASSERT("Error adding the vlmetalayer", blosc2_vlmeta_add(schunk, "small", small, sizeof(small), NULL) == 1);
+  CUTEST_ASSERT("The addition is not a single write", backend.urlpath == NULL || nwrites == 1);
+  CUTEST_ASSERT("The frame changes its length", frame_len(schunk) == len);
+  CUTEST_ASSERT("Error deleting the vlmetalayer", blosc2_vlmeta_delete(schunk, "small") == 1);
+  CUTEST_ASSERT("The frame changes its length", frame_len(schunk) == len);
+
+  /* The ones that do not fit go on as usual */
+  uint8_t *large = malloc(PADDING * 4);
+  for (int i = 0; i < PADDING * 4; i++) {
+    large[i] = (uint8_t) (i * 7919 >> 3);
+  }
+  CUTEST_ASSERT("Error adding the vlmetalayer",
+                blosc2_vlmeta_add(schunk, "large", large, PADDING * 4, NULL) == 1);
+  CUTEST_ASSERT("The frame does not grow", frame_len(schunk) > len);
+  CUTEST_ASSERT("Error appending",
+                blosc2_schunk_append_buffer(schunk, data->buffer, CHUNKSIZE * sizeof(int32_t)) == NCHUNKS + 1);
+  if (backend.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open_udio(backend.urlpath, &io);
+    CUTEST_ASSERT("Error opening the super-chunk", schunk != NULL);
+  }
+  CUTEST_ASSERT("Wrong counter after growing", check_counter(schunk, NUPDATES));
+  uint8_t *content;
+  int32_t content_len;
+  CUTEST_ASSERT("Wrong large vlmetalayer", blosc2_vlmeta_get(schunk, "large", &content, &content_len) == 1 &&
+                                           content_len == PADDING * 4 && memcmp(content, large, content_len) == 0);
+  free(content);
+  free(large);
+  int32_t *chunk = malloc(CHUNKSIZE * sizeof(int32_t));
+  CUTEST_ASSERT("Wrong chunk", blosc2_schunk_decompress_chunk(schunk, NCHUNKS, chunk, CHUNKSIZE * sizeof(int32_t)) ==
+                               CHUNKSIZE * sizeof(int32_t) && memcmp(chunk, data->buffer, CHUNKSIZE * sizeof(int32_t)) == 0);
+  free(chunk);
+  blosc2_schunk_free(schunk);
+
+  blosc2_remove_urlpath(backend.urlpath);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(vlmeta_padding) {
+  free(data->buffer);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(vlmeta_padding);
+}
@@ -0,0 +1,209 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the deltas between the chunks of super-chunks.
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (20 * 1000)
+#define NCHUNKS 10
+#define INTERVAL 4
+#define URLPATH "test_xdelta.b2frame"
+#define URLPATH_COPY "test_xdelta_copy.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+CUTEST_TEST_DATA(xdelta) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(xdelta) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+  data->cparams.typesize = sizeof(int32_t);
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 4));
+}
+
+
+/* A slowly varying series: scattered values that barely change from a chunk to the next */
+static void fill_chunk(int64_t nchunk, int32_t *buffer) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    buffer[i] = (int32_t) (((int64_t) i * 7919 * 7919) % 1000003) * 64 + (int32_t) ((nchunk + i % 3) / 3);
+  }
+}
+
+static bool check_chunk(blosc2_schunk *schunk, int64_t nchunk, int32_t *buffer, int32_t *expected) {
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  fill_chunk(nchunk, expected);
+  return blosc2_schunk_decompress_chunk(schunk, nchunk, buffer, chunksize) == chunksize &&
+         memcmp(buffer, expected, chunksize) == 0;
+}
+
+static int64_t schunk_cbytes(blosc2_cparams *cparams, int32_t interval) {
+  blosc2_storage storage = {.cparams=cparams};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  if (blosc2_schunk_set_xdelta(schunk, interval) < 0) {
+    return -1;
+  }
+  int32_t *buffer = malloc(CHUNKITEMS * sizeof(int32_t));
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(nchunk, buffer);
+    blosc2_schunk_append_buffer(schunk, buffer, CHUNKITEMS * sizeof(int32_t));
+  }
+  free(buffer);
+  int64_t cbytes = schunk->cbytes;
+  blosc2_schunk_free(schunk);
+  return cbytes;
+}
+
+
+CUTEST_TEST_TEST(xdelta) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.nthreads = nthreads;
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_storage storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tstorage.urlpath,
+                            .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Keyframes of a chunk are accepted", blosc2_schunk_set_xdelta(schunk, 1) < 0);
+  CUTEST_ASSERT("Cannot set up the deltas", blosc2_schunk_set_xdelta(schunk, INTERVAL) == 0);
+
+  int32_t chunksize = CHUNKITEMS * sizeof(int32_t);
+  int32_t *buffer = malloc(chunksize);
+  int32_t *expected = malloc(chunksize);
+  // The first chunks one by one, and the rest in a batch
+  for (int64_t nchunk = 0; nchunk < NCHUNKS / 2; nchunk++) {
+    fill_chunk(nchunk, buffer);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+  }
+  void *srcs[NCHUNKS];
+  int32_t nbytes[NCHUNKS];
+  for (int i = 0; i < NCHUNKS - NCHUNKS / 2; i++) {
+    srcs[i] = malloc(chunksize);
+    nbytes[i] = chunksize;
+    fill_chunk(NCHUNKS / 2 + i, srcs[i]);
+  }
+  CUTEST_ASSERT("Cannot append the chunks",
+                blosc2_schunk_append_buffers(schunk, srcs, nbytes, NCHUNKS - NCHUNKS / 2) == NCHUNKS);
+  CUTEST_ASSERT("The deltas are set up with chunks", blosc2_schunk_set_xdelta(schunk, 0) < 0);
+
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL && schunk->xdelta != NULL);
+  }
+
+  // Sequential and random reads
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    CUTEST_ASSERT("Wrong chunk", check_chunk(schunk, nchunk, buffer, expected));
+  }
+  int64_t order[] = {7, 2, 2, 9, 0, 5, 4, 3, 8};
+  for (int i = 0; i < (int) (sizeof(order) / sizeof(int64_t)); i++) {
+    CUTEST_ASSERT("Wrong chunk out of order", check_chunk(schunk, order[i], buffer, expected));
+  }
+  for (int i = 0; i < NCHUNKS - NCHUNKS / 2; i++) {
+    memset(srcs[i], 0, chunksize);
+  }
+  CUTEST_ASSERT("Cannot decompress the chunks",
+                blosc2_schunk_decompress_chunks(schunk, 2, NCHUNKS - NCHUNKS / 2, srcs, nbytes) ==
+                (int64_t) (NCHUNKS - NCHUNKS / 2) * chunksize);
+  for (int i = 0; i < NCHUNKS - NCHUNKS / 2; i++) {
+    fill_chunk(2 + i, expected);
+    CUTEST_ASSERT("Wrong chunk of the batch", memcmp(srcs[i], expected, chunksize) == 0);
+    free(srcs[i]);
+  }
+
+  // Slices and items
+  int64_t start = 6 * CHUNKITEMS + 17;
+  CUTEST_ASSERT("Cannot get the slice",
+                blosc2_schunk_get_slice_buffer(schunk, start, start + CHUNKITEMS, buffer) == 0);
+  fill_chunk(6, expected);
+  CUTEST_ASSERT("Wrong slice", memcmp(buffer, expected + 17, (CHUNKITEMS - 17) * sizeof(int32_t)) == 0);
+  fill_chunk(7, expected);
+  CUTEST_ASSERT("Wrong slice", memcmp(buffer + CHUNKITEMS - 17, expected, 17 * sizeof(int32_t)) == 0);
+  int32_t item;
+  CUTEST_ASSERT("Cannot get the item", blosc2_schunk_get_item(schunk, 3 * CHUNKITEMS + 5, &item) == 0);
+  fill_chunk(3, expected);
+  CUTEST_ASSERT("Wrong item", item == expected[5]);
+
+  // Only appends, and deletions of the last chunk
+  bool needs_free;
+  uint8_t *chunk;
+  int cbytes = blosc2_schunk_get_chunk(schunk, 1, &chunk, &needs_free);
+  CUTEST_ASSERT("Cannot get the chunk", cbytes > 0);
+  CUTEST_ASSERT("Chunks are inserted", blosc2_schunk_insert_chunk(schunk, 1, chunk, true) < 0);
+  CUTEST_ASSERT("Chunks are updated", blosc2_schunk_update_chunk(schunk, 1, chunk, true) < 0);
+  if (needs_free) {
+    free(chunk);
+  }
+  CUTEST_ASSERT("Chunks are deleted", blosc2_schunk_delete_chunk(schunk, 1) < 0);
+  CUTEST_ASSERT("Concurrent writes are set up", blosc2_schunk_set_concurrent_writes(schunk, 2) < 0);
+  CUTEST_ASSERT("Cannot delete the last chunk", blosc2_schunk_delete_chunk(schunk, NCHUNKS - 1) == NCHUNKS - 1);
+  fill_chunk(NCHUNKS - 1, buffer);
+  CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_buffer(schunk, buffer, chunksize) == NCHUNKS);
+  CUTEST_ASSERT("Wrong chunk appended again", check_chunk(schunk, NCHUNKS - 1, buffer, expected));
+
+  // Copies keep the deltas, or decode them when recompressed
+  for (int clevel = 5; clevel <= 9; clevel += 4) {
+    cparams.clevel = clevel;
+    blosc2_storage copy_storage = {.cparams=&cparams, .dparams=&dparams, .urlpath=tstorage.urlpath ? URLPATH_COPY : NULL,
+                                   .contiguous=tstorage.contiguous};
+    blosc2_remove_urlpath(copy_storage.urlpath);
+    blosc2_schunk *copy = blosc2_schunk_copy(schunk, &copy_storage);
+    CUTEST_ASSERT("Cannot copy the super-chunk", copy != NULL);
+    CUTEST_ASSERT("Wrong deltas of the copy", (copy->xdelta != NULL) == (clevel == 5));
+    for (int64_t nchunk = NCHUNKS - 1; nchunk >= 0; nchunk -= 3) {
+      CUTEST_ASSERT("Wrong chunk of the copy", check_chunk(copy, nchunk, buffer, expected));
+    }
+    blosc2_schunk_free(copy);
+    blosc2_remove_urlpath(copy_storage.urlpath);
+  }
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  // Slowly varying series compress better
+  cparams.clevel = 5;
+  int64_t cbytes_plain = schunk_cbytes(&cparams, 0);
+  int64_t cbytes_xdelta = schunk_cbytes(&cparams, INTERVAL);
+  CUTEST_ASSERT("The deltas do not compress better", cbytes_xdelta > 0 && cbytes_xdelta < cbytes_plain);
+
+  free(buffer);
+  free(expected);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(xdelta) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(xdelta);
+}
@@ -0,0 +1,279 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for the zone maps (min, max and NaNs) of the chunks and blocks of super-chunks.
+*/
+
+#include <math.h>
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define CHUNKITEMS (10 * 1000)
+#define NCHUNKS 5
+#define RUN_CHUNK 3
+#define BLOCKSIZE (8 * 1024)
+#define URLPATH "test_zonemap.b2frame"
+
+
+typedef struct {
+  char *urlpath;
+  bool contiguous;
+} test_storage;
+
+typedef struct {
+  int kind;
+  int32_t typesize;
+} test_type;
+
+CUTEST_TEST_DATA(zonemap) {
+  blosc2_cparams cparams;
+};
+
+
+CUTEST_TEST_SETUP(zonemap) {
+  blosc2_init();
+
+  data->cparams = BLOSC2_CPARAMS_DEFAULTS;
+
+  CUTEST_PARAMETRIZE(tstorage, test_storage, CUTEST_DATA(
+      {NULL, false},
+      {NULL, true},
+      {URLPATH, true},
+      {URLPATH, false},
+  ));
+  CUTEST_PARAMETRIZE(ttype, test_type, CUTEST_DATA(
+      {BLOSC2_ZONEMAP_INT, 4},
+      {BLOSC2_ZONEMAP_UINT, 2},
+      {BLOSC2_ZONEMAP_FLOAT, 8},
+  ));
+  CUTEST_PARAMETRIZE(clevel, int, CUTEST_DATA(0, 5));
+}
+
+
+/* The values go up along the super-chunk, but for a run and a few NaNs */
+static double item_value(test_type ttype, int64_t nchunk, int32_t i) {
+  if (nchunk == RUN_CHUNK) {
+    return 7;
+  }
+  if (ttype.kind == BLOSC2_ZONEMAP_FLOAT && nchunk == 1 && i % 100 == 0) {
+    return nan("");
+  }
+  double value = (double) (nchunk * CHUNKITEMS + i);
+  return ttype.kind == BLOSC2_ZONEMAP_INT ? value - NCHUNKS * CHUNKITEMS / 2 : value;
+}
+
+static void fill_chunk(test_type ttype, int64_t nchunk, uint8_t *buffer) {
+  for (int32_t i = 0; i < CHUNKITEMS; i++) {
+    double value = item_value(ttype, nchunk, i);
+    switch (ttype.kind) {
+      case BLOSC2_ZONEMAP_INT:
+        ((int32_t *) buffer)[i] = (int32_t) value;
+        break;
+      case BLOSC2_ZONEMAP_UINT:
+        ((uint16_t *) buffer)[i] = (uint16_t) value;
+        break;
+      default:
+        ((double *) buffer)[i] = value;
+    }
+  }
+}
+
+static double bound_value(test_type ttype, blosc2_zonemap_value value) {
+  switch (ttype.kind) {
+    case BLOSC2_ZONEMAP_INT:
+      return (double) value.i;
+    case BLOSC2_ZONEMAP_UINT:
+      return (double) value.u;
+    default:
+      return value.f;
+  }
+}
+
+static blosc2_zonemap_value make_value(test_type ttype, double value) {
+  blosc2_zonemap_value bound;
+  switch (ttype.kind) {
+    case BLOSC2_ZONEMAP_INT:
+      bound.i = (int64_t) value;
+      break;
+    case BLOSC2_ZONEMAP_UINT:
+      bound.u = (uint64_t) value;
+      break;
+    default:
+      bound.f = value;
+  }
+  return bound;
+}
+
+/* Whether the zone map is the one of the items [start, stop) of the chunk */
+static bool check_zonemap(test_type ttype, int64_t nchunk, int32_t start, int32_t stop, blosc2_zonemap *zonemap) {
+  double min = INFINITY, max = -INFINITY;
+  int32_t nnans = 0;
+  for (int32_t i = start; i < stop; i++) {
+    double value = item_value(ttype, nchunk, i);
+    if (isnan(value)) {
+      nnans++;
+      continue;
+    }
+    min = value < min ? value : min;
+    max = value > max ? value : max;
+  }
+  return zonemap->nitems == stop - start && zonemap->nnans == nnans &&
+         bound_value(ttype, zonemap->min) == min && bound_value(ttype, zonemap->max) == max;
+}
+
+/* Check the zone maps of the chunks, as originally appended in `order` */
+static int check_zonemaps(blosc2_schunk *schunk, test_type ttype, const int64_t *order) {
+  int errors = 0;
+  int32_t blockitems = BLOCKSIZE / ttype.typesize;
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    int64_t orig = order[nchunk];
+    blosc2_zonemap chunk;
+    blosc2_zonemap *blocks;
+    int nblocks = blosc2_schunk_get_zonemap(schunk, nchunk, &chunk, &blocks);
+    if (nblocks < 0 || !check_zonemap(ttype, orig, 0, CHUNKITEMS, &chunk)) {
+      errors++;
+      continue;
+    }
+    if (nblocks == 0 && orig != RUN_CHUNK) {
+      errors++;
+    }
+    for (int i = 0; i < nblocks; i++) {
+      int32_t stop = (i + 1) * blockitems < CHUNKITEMS ? (i + 1) * blockitems : CHUNKITEMS;
+      if (!check_zonemap(ttype, orig, i * blockitems, stop, &blocks[i])) {
+        errors++;
+      }
+    }
+    free(blocks);
+  }
+  return errors;
+}
+
+
+CUTEST_TEST_TEST(zonemap) {
+  CUTEST_GET_PARAMETER(tstorage, test_storage);
+  CUTEST_GET_PARAMETER(ttype, test_type);
+  CUTEST_GET_PARAMETER(clevel, int);
+
+  blosc2_cparams cparams = data->cparams;
+  cparams.typesize = ttype.typesize;
+  cparams.clevel = (uint8_t) clevel;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = 2;
+  cparams.zonemap = ttype.kind;
+  blosc2_storage storage = {.cparams=&cparams, .urlpath=tstorage.urlpath, .contiguous=tstorage.contiguous};
+  blosc2_remove_urlpath(storage.urlpath);
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+
+  int32_t chunksize = CHUNKITEMS * ttype.typesize;
+  uint8_t *buffer = malloc(chunksize);
+  for (int64_t nchunk = 0; nchunk < NCHUNKS; nchunk++) {
+    fill_chunk(ttype, nchunk, buffer);
+    CUTEST_ASSERT("Cannot append the chunk",
+                  blosc2_schunk_append_buffer(schunk, buffer, chunksize) == nchunk + 1);
+  }
+  int64_t order[NCHUNKS] = {0, 1, 2, 3, 4};
+  CUTEST_ASSERT("Wrong zone maps", check_zonemaps(schunk, ttype, order) == 0);
+
+  // The blocks out of a range are masked out, and the whole chunks too
+  int32_t blockitems = BLOCKSIZE / ttype.typesize;
+  int nblocks = CHUNKITEMS / blockitems + (CHUNKITEMS % blockitems > 0);
+  bool *maskout = malloc(nblocks);
+  blosc2_zonemap_value low = make_value(ttype, item_value(ttype, 2, blockitems + 1));
+  blosc2_zonemap_value high = make_value(ttype, item_value(ttype, 2, blockitems + 2));
+  int nmasked = blosc2_schunk_zonemap_maskout(schunk, 2, &low, &high, maskout, nblocks);
+  CUTEST_ASSERT("Wrong number of blocks masked out", nmasked == nblocks - 1);
+  CUTEST_ASSERT("Wrong block masked out", !maskout[1]);
+  CUTEST_ASSERT("The chunk is not masked out",
+                blosc2_schunk_zonemap_maskout(schunk, 0, &low, &high, maskout, nblocks) == nblocks);
+  blosc2_zonemap_value below_run = make_value(ttype, 6);
+  CUTEST_ASSERT("The run is not masked out",
+                blosc2_schunk_zonemap_maskout(schunk, RUN_CHUNK, NULL, &below_run, maskout, nblocks) == nblocks);
+  CUTEST_ASSERT("The unbounded range masks out",
+                blosc2_schunk_zonemap_maskout(schunk, 1, NULL, NULL, maskout, nblocks) == 0);
+
+  // The masked out blocks are skipped on decompression
+  nmasked = blosc2_schunk_zonemap_maskout(schunk, 2, &low, &high, maskout, nblocks);
+  CUTEST_ASSERT("Cannot set the maskout", blosc2_set_maskout(schunk->dctx, maskout, nblocks) == 0);
+  memset(buffer, 0, chunksize);
+  CUTEST_ASSERT("Cannot decompress the chunk",
+                blosc2_schunk_decompress_chunk(schunk, 2, buffer, chunksize) == chunksize);
+  uint8_t *expected = malloc(chunksize);
+  fill_chunk(ttype, 2, expected);
+  CUTEST_ASSERT("Wrong unmasked block",
+                memcmp(buffer + BLOCKSIZE, expected + BLOCKSIZE, BLOCKSIZE) == 0);
+  free(expected);
+  free(maskout);
+
+  if (tstorage.urlpath != NULL) {
+    blosc2_schunk_free(schunk);
+    schunk = blosc2_schunk_open(tstorage.urlpath);
+    CUTEST_ASSERT("Cannot reopen the super-chunk", schunk != NULL);
+    CUTEST_ASSERT("Wrong zone maps after reopening", check_zonemaps(schunk, ttype, order) == 0);
+  }
+
+  // The zone maps follow the chunks around
+  int64_t reordered[NCHUNKS] = {2, 0, 1, 3, 4};
+  CUTEST_ASSERT("Cannot reorder the chunks", blosc2_schunk_reorder_offsets(schunk, reordered) == 0);
+  CUTEST_ASSERT("Wrong zone maps after reordering", check_zonemaps(schunk, ttype, reordered) == 0);
+
+  // Chunks that come without zone maps have none
+  bool needs_free;
+  uint8_t *chunk_;
+  int cbytes = blosc2_schunk_get_chunk(schunk, 4, &chunk_, &needs_free);
+  CUTEST_ASSERT("Cannot get the chunk", cbytes > 0);
+  // The chunks of contiguous frames in memory move around
+  uint8_t *chunk = malloc(cbytes);
+  memcpy(chunk, chunk_, cbytes);
+  if (needs_free) {
+    free(chunk_);
+  }
+  CUTEST_ASSERT("Cannot insert the chunk", blosc2_schunk_insert_chunk(schunk, 1, chunk, true) == NCHUNKS + 1);
+  CUTEST_ASSERT("The inserted chunk has zone maps",
+                blosc2_schunk_get_zonemap(schunk, 1, NULL, NULL) == BLOSC2_ERROR_NOT_FOUND);
+  CUTEST_ASSERT("Cannot delete the chunk", blosc2_schunk_delete_chunk(schunk, 1) == NCHUNKS);
+  CUTEST_ASSERT("Wrong zone maps after deleting", check_zonemaps(schunk, ttype, reordered) == 0);
+  CUTEST_ASSERT("Cannot update the chunk", blosc2_schunk_update_chunk(schunk, 4, chunk, true) == NCHUNKS);
+  CUTEST_ASSERT("The updated chunk has zone maps",
+                blosc2_schunk_get_zonemap(schunk, 4, NULL, NULL) == BLOSC2_ERROR_NOT_FOUND);
+  free(chunk);
+  bool mask[1];
+  CUTEST_ASSERT("The chunk has zone maps",
+                blosc2_schunk_zonemap_maskout(schunk, 4, NULL, NULL, mask, 1) == BLOSC2_ERROR_NOT_FOUND);
+  blosc2_zonemap zonemap;
+  CUTEST_ASSERT("The zone map is wrong", blosc2_schunk_get_zonemap(schunk, 0, &zonemap, NULL) > 0 &&
+                                         check_zonemap(ttype, 2, 0, CHUNKITEMS, &zonemap));
+
+  // Appending again records the zone maps of the new chunks only
+  fill_chunk(ttype, 0, buffer);
+  CUTEST_ASSERT("Cannot append the chunk",
+                blosc2_schunk_append_buffer(schunk, buffer, chunksize) == NCHUNKS + 1);
+  CUTEST_ASSERT("The zone map is wrong", blosc2_schunk_get_zonemap(schunk, NCHUNKS, &zonemap, NULL) > 0 &&
+                                         check_zonemap(ttype, 0, 0, CHUNKITEMS, &zonemap));
+  CUTEST_ASSERT("The updated chunk has zone maps",
+                blosc2_schunk_get_zonemap(schunk, 4, NULL, NULL) == BLOSC2_ERROR_NOT_FOUND);
+  free(buffer);
+
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(tstorage.urlpath);
+
+  // Not every typesize can be summarized
+  cparams.typesize = 3;
+  CUTEST_ASSERT("A zone map of an unsupported typesize", blosc2_create_cctx(cparams) == NULL);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(zonemap) {
+  BLOSC_UNUSED_PARAM(data);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(zonemap);
+}
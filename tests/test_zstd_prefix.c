@@ -0,0 +1,145 @@
+/*
+  Copyright (c) 2021  The Blosc Development Team <blosc@blosc.org>
+  https://blosc.org
+  License: BSD 3-Clause (see LICENSE.txt)
+
+  Tests for chunks whose zstd blocks reference the previous block as a prefix
+  (blosc2_cparams.zstd_window).
+*/
+
+#include "test_common.h"
+#include "cutest.h"
+
+#define NBYTES (1000 * 1000)
+#define BLOCKSIZE (32 * 1024)
+#define NBLOCKS ((NBYTES + BLOCKSIZE - 1) / BLOCKSIZE)
+
+
+CUTEST_TEST_DATA(zstd_prefix) {
+  uint8_t *src;
+  uint8_t *chunk;
+  uint8_t *dest;
+};
+
+
+CUTEST_TEST_SETUP(zstd_prefix) {
+  blosc2_init();
+  data->src = malloc(NBYTES);
+  data->chunk = malloc(NBYTES + BLOSC2_MAX_OVERHEAD);
+  data->dest = malloc(NBYTES);
+  // Noise that every block repeats with a few changes, so that it only compresses across blocks
+  int32_t *items = (int32_t *) data->src;
+  for (int i = 0; i < BLOCKSIZE / (int) sizeof(int32_t); i++) {
+    items[i] = rand();
+  }
+  for (int i = BLOCKSIZE / (int) sizeof(int32_t); i < NBYTES / (int) sizeof(int32_t); i++) {
+    items[i] = i % 97 == 0 ? rand() : items[i - BLOCKSIZE / (int) sizeof(int32_t)];
+  }
+  // And a block of zeros in between, whose streams are runs
+  memset(data->src + 3 * BLOCKSIZE, 0, BLOCKSIZE);
+
+  CUTEST_PARAMETRIZE(window, int, CUTEST_DATA(BLOSC2_ZSTD_PREFIX_WINDOW, BLOSC2_ZSTD_LDM_WINDOW));
+  CUTEST_PARAMETRIZE(nthreads, int16_t, CUTEST_DATA(1, 4));
+  CUTEST_PARAMETRIZE(filter, uint8_t, CUTEST_DATA(BLOSC_NOFILTER, BLOSC_SHUFFLE));
+}
+
+
+static int compress(blosc2_cparams cparams, uint8_t *src, uint8_t *chunk) {
+  blosc2_context *cctx = blosc2_create_cctx(cparams);
+  if (cctx == NULL) {
+    return BLOSC2_ERROR_INVALID_PARAM;
+  }
+  int csize = blosc2_compress_ctx(cctx, src, NBYTES, chunk, NBYTES + BLOSC2_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+  return csize;
+}
+
+
+CUTEST_TEST_TEST(zstd_prefix) {
+  CUTEST_GET_PARAMETER(window, int);
+  CUTEST_GET_PARAMETER(nthreads, int16_t);
+  CUTEST_GET_PARAMETER(filter, uint8_t);
+
+  blosc2_cparams cparams = BLOSC2_CPARAMS_DEFAULTS;
+  cparams.compcode = BLOSC_ZSTD;
+  cparams.clevel = 3;
+  cparams.typesize = sizeof(int32_t);
+  cparams.filters[BLOSC2_MAX_FILTERS - 1] = filter;
+  cparams.blocksize = BLOCKSIZE;
+  cparams.nthreads = nthreads;
+  int csize_blocks = compress(cparams, data->src, data->chunk);
+  CUTEST_ASSERT("Compression error", csize_blocks > 0);
+  CUTEST_ASSERT("The blocks have a prefix", !(data->chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] & BLOSC2_ZSTD_PREFIX));
+
+  /* The blocks match against the previous one */
+  cparams.zstd_window = window;
+  int csize = compress(cparams, data->src, data->chunk);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  CUTEST_ASSERT("The blocks have no prefix", data->chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] & BLOSC2_ZSTD_PREFIX);
+  CUTEST_ASSERT("The prefix does not help", csize < csize_blocks / 4);
+
+  /* Decompression goes block after block, whatever the threads */
+  blosc2_dparams dparams = BLOSC2_DPARAMS_DEFAULTS;
+  dparams.nthreads = nthreads;
+  blosc2_context *dctx = blosc2_create_dctx(dparams);
+  int dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  CUTEST_ASSERT("Wrong roundtrip", dsize == NBYTES && memcmp(data->src, data->dest, NBYTES) == 0);
+  int32_t start = 5 * BLOCKSIZE / 4 - 10;  // across later blocks
+  int32_t nitems = 3 * BLOCKSIZE / 4;
+  dsize = blosc2_getitem_ctx(dctx, data->chunk, csize, start, nitems, data->dest, NBYTES);
+  CUTEST_ASSERT("Wrong items", dsize == nitems * 4 && memcmp(data->src + start * 4, data->dest, dsize) == 0);
+  // The blocks that are masked out are still needed by the next ones
+  bool maskout[NBLOCKS] = {false};
+  for (int i = 0; i < NBLOCKS - 1; i++) {
+    maskout[i] = true;
+  }
+  CUTEST_ASSERT("Cannot set the maskout", blosc2_set_maskout(dctx, maskout, NBLOCKS) == 0);
+  dsize = blosc2_decompress_ctx(dctx, data->chunk, csize, data->dest, NBYTES);
+  int32_t last = (NBLOCKS - 1) * BLOCKSIZE;
+  CUTEST_ASSERT("Wrong last block", dsize == NBYTES && memcmp(data->src + last, data->dest + last, NBYTES - last) == 0);
+  blosc2_free_ctx(dctx);
+
+  /* The chunks are lazy in the frames on disk */
+  char *urlpath = "test_zstd_prefix.b2frame";
+  blosc2_remove_urlpath(urlpath);
+  blosc2_storage storage = {.contiguous=true, .urlpath=urlpath, .cparams=&cparams};
+  blosc2_schunk *schunk = blosc2_schunk_new(&storage);
+  CUTEST_ASSERT("Cannot create the super-chunk", schunk != NULL);
+  CUTEST_ASSERT("Cannot append the chunk", blosc2_schunk_append_buffer(schunk, data->src, NBYTES) == 1);
+  blosc2_schunk_free(schunk);
+  schunk = blosc2_schunk_open(urlpath);
+  dsize = blosc2_schunk_decompress_chunk(schunk, 0, data->dest, NBYTES);
+  CUTEST_ASSERT("Wrong lazy roundtrip", dsize == NBYTES && memcmp(data->src, data->dest, NBYTES) == 0);
+  CUTEST_ASSERT("Cannot get the slice",
+                blosc2_schunk_get_slice_buffer(schunk, start, start + nitems, data->dest) == 0);
+  CUTEST_ASSERT("Wrong lazy items", memcmp(data->src + start * 4, data->dest, nitems * 4) == 0);
+  blosc2_schunk_free(schunk);
+  blosc2_remove_urlpath(urlpath);
+
+  /* Other codecs ignore the window, and dicts do not go with it */
+  cparams.compcode = BLOSC_LZ4;
+  csize = compress(cparams, data->src, data->chunk);
+  CUTEST_ASSERT("Compression error", csize > 0);
+  CUTEST_ASSERT("LZ4 blocks have a prefix", !(data->chunk[BLOSC2_CHUNK_BLOSC2_FLAGS] & BLOSC2_ZSTD_PREFIX));
+  cparams.compcode = BLOSC_ZSTD;
+  cparams.use_dict = 1;
+  CUTEST_ASSERT("Dicts are taken", blosc2_create_cctx(cparams) == NULL);
+  cparams.use_dict = 0;
+  cparams.zstd_window = BLOSC2_ZSTD_LDM_WINDOW + 1;
+  CUTEST_ASSERT("An unknown window is taken", blosc2_create_cctx(cparams) == NULL);
+
+  return 0;
+}
+
+
+CUTEST_TEST_TEARDOWN(zstd_prefix) {
+  free(data->dest);
+  free(data->chunk);
+  free(data->src);
+  blosc2_destroy();
+}
+
+
+int main() {
+  CUTEST_TEST_RUN(zstd_prefix);
+}